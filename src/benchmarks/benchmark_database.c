@@ -0,0 +1,664 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <src/fsearch.h>
+#include <src/fsearch_config.h>
+#include <src/fsearch_database.h>
+#include <src/fsearch_database_search.h>
+#include <src/fsearch_database_view.h>
+#include <src/fsearch_index.h>
+
+// Builds a synthetic tree with a fixed seed, so every run and every build sees the same names, depths and sizes,
+// and measures how long the database takes for it. The results are written as JSON.
+
+#define BENCH_MAX_DEPTH 16
+// the newest modification time of the tree, fixed so the saved databases don't depend on the day of the run
+#define BENCH_BASE_TIME 1700000000
+#define BENCH_TIME_SPAN (10 * 365 * 24 * 3600)
+#define BENCH_VIEW_TIMEOUT (10 * 60 * G_USEC_PER_SEC)
+
+static const char *bench_folder_words[] = {
+    "src",     "docs",         "images",    "Photos",   "Music",     "backup",  "projects", "build",  "cache",
+    "lib",     "include",      "share",     "Downloads", "Documents", "tmp",     "assets",   "test",   "2019",
+    "2020",    "2021",         "2022",      "2023",     "old",       "archive", "config",   "data",   "Fotos",
+    "objects", "node_modules", "Übersicht", "résumés",  "проекты",   "写真",    ".git",     "vendor", "icons",
+};
+
+static const char *bench_file_words[] = {
+    "report",   "notes",       "main",         "index", "README", "Makefile", "invoice",   "budget", "draft",
+    "final",    "summary",     "config",       "utils", "test",   "setup",    "photo",     "song",   "video",
+    "letter",   "scan",        "output",       "backup", "changelog", "license", "module", "data",   "schema",
+    "Rechnung", "Überweisung", "présentation", "отчёт", "写真",   "memo",     "thumbnail", "style",  "script",
+};
+
+// the more common ones are listed several times
+static const char *bench_extensions[] = {
+    ".jpg", ".jpg", ".jpg",  ".png",  ".png", ".c",   ".c",    ".h",   ".h",  ".txt", ".txt", ".pdf",
+    ".pdf", ".mp3", ".mp3",  ".js",   ".js",  ".py",  ".html", ".css", ".json", ".xml", ".o", ".so",
+    ".gz",  ".zip", ".docx", ".xlsx", ".mkv", ".mp4", ".flac", ".svg", ".md", ".log", ".JPG", "",
+};
+
+static const char *bench_prefixes[] = {"IMG_", "DSC", "track_", "Screenshot_", "page-", "part"};
+
+typedef struct {
+    uint64_t state;
+} BenchRandom;
+
+static uint64_t
+bench_random_next(BenchRandom *random) {
+    // xorshift64*
+    random->state ^= random->state >> 12;
+    random->state ^= random->state << 25;
+    random->state ^= random->state >> 27;
+    return random->state * UINT64_C(2685821657736338717);
+}
+
+static uint32_t
+bench_random_range(BenchRandom *random, uint32_t n) {
+    return (uint32_t)(bench_random_next(random) % n);
+}
+
+static double
+bench_random_double(BenchRandom *random) {
+    return (double)(bench_random_next(random) >> 11) * 0x1.0p-53;
+}
+
+#define bench_random_pick(random, array) ((array)[bench_random_range((random), G_N_ELEMENTS(array))])
+
+typedef struct {
+    BenchRandom random;
+    GString *path;
+    uint64_t num_remaining;
+    uint64_t num_folders;
+    uint64_t num_files;
+} BenchTree;
+
+static void
+bench_tree_append_file_name(BenchTree *tree) {
+    BenchRandom *r = &tree->random;
+    const uint32_t kind = bench_random_range(r, 100);
+    if (kind < 30) {
+        g_string_append(tree->path, bench_random_pick(r, bench_file_words));
+    }
+    else if (kind < 60) {
+        g_string_append_printf(tree->path,
+                               "%s%04u",
+                               bench_random_pick(r, bench_prefixes),
+                               bench_random_range(r, 10000));
+    }
+    else if (kind < 80) {
+        g_string_append_printf(tree->path,
+                               "%s-%s",
+                               bench_random_pick(r, bench_file_words),
+                               bench_random_pick(r, bench_file_words));
+    }
+    else if (kind < 90) {
+        g_string_append_printf(tree->path,
+                               "%s (%u)",
+                               bench_random_pick(r, bench_file_words),
+                               bench_random_range(r, 20));
+    }
+    else {
+        // e.g. the contents of caches
+        g_string_append_printf(tree->path, "%016" PRIx64, bench_random_next(r));
+        return;
+    }
+    g_string_append(tree->path, bench_random_pick(r, bench_extensions));
+}
+
+static void
+bench_tree_add_file(BenchTree *tree) {
+    BenchRandom *r = &tree->random;
+    const gsize len = tree->path->len;
+    g_string_append_c(tree->path, '/');
+    bench_tree_append_file_name(tree);
+
+    int fd = open(tree->path->str, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        g_string_append_printf(tree->path, "_%" G_GUINT64_FORMAT, tree->num_files);
+        fd = open(tree->path->str, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd < 0) {
+        g_printerr("[benchmark] failed to create %s: %s\n", tree->path->str, g_strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    // mostly small files and a few huge ones, they're sparse so they don't take up any memory of the tmpfs
+    const uint32_t bits = (uint32_t)(pow(bench_random_double(r), 1.5) * 34);
+    const off_t size = (off_t)((UINT64_C(1) << bits) + bench_random_range(r, 1u << MIN(bits, 20u)));
+    const time_t mtime = BENCH_BASE_TIME - (time_t)(pow(bench_random_double(r), 2) * BENCH_TIME_SPAN);
+    const struct timespec times[2] = {{mtime, 0}, {mtime, 0}};
+    if (ftruncate(fd, size) != 0 || futimens(fd, times) != 0) {
+        g_printerr("[benchmark] failed to set up %s: %s\n", tree->path->str, g_strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    tree->num_files++;
+    tree->num_remaining--;
+    g_string_truncate(tree->path, len);
+}
+
+static uint32_t
+bench_tree_get_num_subfolders(BenchTree *tree, uint32_t depth) {
+    BenchRandom *r = &tree->random;
+    if (depth == 0) {
+        return UINT32_MAX;
+    }
+    if (depth < 3) {
+        return 3 + bench_random_range(r, 10);
+    }
+    if (depth < 7) {
+        return bench_random_range(r, 4);
+    }
+    if (depth < BENCH_MAX_DEPTH) {
+        return bench_random_range(r, 3) == 0 ? 1 + bench_random_range(r, 2) : 0;
+    }
+    return 0;
+}
+
+static uint32_t
+bench_tree_get_num_files(BenchTree *tree) {
+    BenchRandom *r = &tree->random;
+    const uint32_t kind = bench_random_range(r, 100);
+    if (kind < 25) {
+        return 0;
+    }
+    if (kind < 98) {
+        return 1 + (uint32_t)(-log(1 - bench_random_double(r)) * 12);
+    }
+    // e.g. photo collections or object files
+    return 200 + bench_random_range(r, 1800);
+}
+
+static void
+bench_tree_add_folder(BenchTree *tree, uint32_t depth) {
+    BenchRandom *r = &tree->random;
+    const gsize len = tree->path->len;
+    if (depth > 0) {
+        g_string_append_c(tree->path, '/');
+        g_string_append(tree->path, bench_random_pick(r, bench_folder_words));
+        if (bench_random_range(r, 3) == 0) {
+            g_string_append_printf(tree->path, "_%u", bench_random_range(r, 100));
+        }
+        if (g_mkdir(tree->path->str, 0755) != 0 && errno == EEXIST) {
+            g_string_append_printf(tree->path, "-%" G_GUINT64_FORMAT, tree->num_folders);
+            g_mkdir(tree->path->str, 0755);
+        }
+        tree->num_folders++;
+        tree->num_remaining--;
+    }
+
+    const uint32_t num_files = depth > 0 ? bench_tree_get_num_files(tree) : 0;
+    for (uint32_t i = 0; i < num_files && tree->num_remaining > 0; i++) {
+        bench_tree_add_file(tree);
+    }
+    const uint32_t num_subfolders = bench_tree_get_num_subfolders(tree, depth);
+    for (uint32_t i = 0; i < num_subfolders && tree->num_remaining > 0; i++) {
+        bench_tree_add_folder(tree, depth + 1);
+    }
+    g_string_truncate(tree->path, len);
+}
+
+static int
+bench_remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    return remove(path);
+}
+
+typedef struct {
+    char *name;
+    uint64_t num_results;
+    GArray *samples;
+} BenchResult;
+
+static GPtrArray *bench_results;
+
+static BenchResult *
+bench_result_new(const char *name) {
+    BenchResult *result = calloc(1, sizeof(BenchResult));
+    g_assert(result);
+    result->name = g_strdup(name);
+    result->samples = g_array_new(FALSE, FALSE, sizeof(double));
+    g_ptr_array_add(bench_results, result);
+    return result;
+}
+
+static void
+bench_result_free(BenchResult *result) {
+    g_clear_pointer(&result->name, g_free);
+    g_clear_pointer(&result->samples, g_array_unref);
+    g_clear_pointer(&result, free);
+}
+
+static void
+bench_result_add(BenchResult *result, double ms) {
+    g_array_append_val(result->samples, ms);
+}
+
+static int
+compare_samples(gconstpointer a, gconstpointer b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// nearest rank of a sorted array of samples
+static double
+get_percentile(GArray *sorted, double percentile) {
+    const uint32_t rank = (uint32_t)ceil(percentile / 100 * sorted->len);
+    return g_array_index(sorted, double, MAX(rank, 1) - 1);
+}
+
+static void
+json_append_string(GString *json, const char *str) {
+    g_string_append_c(json, '"');
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            g_string_append_c(json, '\\');
+            g_string_append_c(json, *c);
+        }
+        else if ((unsigned char)*c < 0x20) {
+            g_string_append_printf(json, "\\u%04x", (unsigned char)*c);
+        }
+        else {
+            g_string_append_c(json, *c);
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+static void
+json_append_result(GString *json, BenchResult *result) {
+    g_autoptr(GArray) sorted = g_array_sized_new(FALSE, FALSE, sizeof(double), result->samples->len);
+    g_array_append_vals(sorted, result->samples->data, result->samples->len);
+    g_array_sort(sorted, compare_samples);
+    double sum = 0;
+    for (uint32_t i = 0; i < sorted->len; i++) {
+        sum += g_array_index(sorted, double, i);
+    }
+
+    g_string_append(json, "    {\"name\": ");
+    json_append_string(json, result->name);
+    g_string_append_printf(json, ", \"num_results\": %" G_GUINT64_FORMAT ", \"samples\": [", result->num_results);
+    for (uint32_t i = 0; i < result->samples->len; i++) {
+        g_string_append_printf(json, "%s%.3f", i > 0 ? ", " : "", g_array_index(result->samples, double, i));
+    }
+    g_string_append(json, "]");
+    if (sorted->len > 0) {
+        g_string_append_printf(json,
+                               ", \"min_ms\": %.3f, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f"
+                               ", \"p99_ms\": %.3f, \"max_ms\": %.3f",
+                               g_array_index(sorted, double, 0),
+                               sum / sorted->len,
+                               get_percentile(sorted, 50),
+                               get_percentile(sorted, 90),
+                               get_percentile(sorted, 99),
+                               g_array_index(sorted, double, sorted->len - 1));
+    }
+    g_string_append(json, "}");
+}
+
+static const struct {
+    const char *text;
+    FsearchQueryFlags flags;
+} bench_queries[] = {
+    {"a", 0},
+    {"report", 0},
+    {"img jpg", 0},
+    {"*.jpg", 0},
+    {"ext:pdf;docx", 0},
+    {"size:>100mb", 0},
+    {"regex:^IMG_[0-9]+\\.jpg$", 0},
+    {"photos", QUERY_FLAG_SEARCH_IN_PATH},
+    {"README", QUERY_FLAG_MATCH_CASE},
+    {"folder:src", 0},
+    {"überweisung", 0},
+    {"rprt", QUERY_FLAG_FUZZY},
+    {"zzqxv", 0},
+};
+
+static const struct {
+    const char *name;
+    FsearchDatabaseIndexType sort_order;
+} bench_sort_orders[] = {
+    {"name", DATABASE_INDEX_TYPE_NAME},
+    {"path", DATABASE_INDEX_TYPE_PATH},
+    {"size", DATABASE_INDEX_TYPE_SIZE},
+    {"modified", DATABASE_INDEX_TYPE_MODIFICATION_TIME},
+    {"accessed", DATABASE_INDEX_TYPE_ACCESS_TIME},
+    {"created", DATABASE_INDEX_TYPE_CREATION_TIME},
+    {"changed", DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME},
+    {"type", DATABASE_INDEX_TYPE_FILETYPE},
+    {"extension", DATABASE_INDEX_TYPE_EXTENSION},
+    {"owner", DATABASE_INDEX_TYPE_OWNER},
+};
+
+static void
+bench_search(FsearchDatabase *db, FsearchFilterManager *filters, uint32_t num_runs) {
+    FsearchDatabaseSnapshot *snapshot = db_get_snapshot(db);
+    DynamicArray *folders = NULL;
+    DynamicArray *files = NULL;
+    FsearchDatabaseIndexType sort_order = DATABASE_INDEX_TYPE_NAME;
+    db_snapshot_get_entries_sorted(snapshot, DATABASE_INDEX_TYPE_NAME, &sort_order, &folders, &files);
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(bench_queries); i++) {
+        g_autofree char *name = g_strdup_printf("search/%s", bench_queries[i].text);
+        BenchResult *result = bench_result_new(name);
+        FsearchQuery *query =
+            fsearch_query_new(bench_queries[i].text, NULL, filters, bench_queries[i].flags, "benchmark");
+        for (uint32_t run = 0; run < num_runs; run++) {
+            g_autoptr(GTimer) timer = g_timer_new();
+            DatabaseSearchResult *search_result = db_search(query,
+                                                            db_get_thread_pool(db),
+                                                            folders,
+                                                            files,
+                                                            db_snapshot_get_folder_trigram_index(snapshot),
+                                                            db_snapshot_get_file_trigram_index(snapshot),
+                                                            db_snapshot_get_folder_name_index(snapshot),
+                                                            db_snapshot_get_file_name_index(snapshot),
+                                                            db_snapshot_get_subtree_filter(snapshot),
+                                                            db_snapshot_get_folder_paths(snapshot),
+                                                            db_snapshot_get_folded_names(snapshot),
+                                                            NULL,
+                                                            sort_order,
+                                                            NULL,
+                                                            NULL,
+                                                            NULL);
+            bench_result_add(result, g_timer_elapsed(timer, NULL) * 1000);
+            if (search_result) {
+                result->num_results = (search_result->folders ? darray_get_num_items(search_result->folders) : 0)
+                                    + (search_result->files ? darray_get_num_items(search_result->files) : 0);
+                g_clear_pointer(&search_result->folders, darray_unref);
+                g_clear_pointer(&search_result->files, darray_unref);
+                g_clear_pointer(&search_result, free);
+            }
+        }
+        g_clear_pointer(&query, fsearch_query_unref);
+    }
+    g_clear_pointer(&snapshot, db_snapshot_unref);
+}
+
+static void
+bench_sort(FsearchDatabase *db, uint32_t num_runs, bool indexed[NUM_DATABASE_INDEX_TYPES]) {
+    for (uint32_t i = 0; i < G_N_ELEMENTS(bench_sort_orders); i++) {
+        const FsearchDatabaseIndexType sort_order = bench_sort_orders[i].sort_order;
+        if (db_time_sort(db, sort_order) < 0) {
+            // not indexed with the default settings
+            continue;
+        }
+        indexed[sort_order] = true;
+        g_autofree char *name = g_strdup_printf("sort/%s", bench_sort_orders[i].name);
+        BenchResult *result = bench_result_new(name);
+        result->num_results = db_get_num_entries(db);
+        for (uint32_t run = 0; run < num_runs; run++) {
+            bench_result_add(result, db_time_sort(db, sort_order));
+        }
+    }
+}
+
+typedef struct {
+    GMutex mutex;
+    GCond cond;
+    uint32_t num_searches;
+    uint32_t num_sorts;
+} BenchViewContext;
+
+static void
+on_bench_view_notify(FsearchDatabaseView *view, FsearchDatabaseViewNotify id, gpointer user_data) {
+    BenchViewContext *ctx = user_data;
+    if (id != DATABASE_VIEW_NOTIFY_SEARCH_FINISHED && id != DATABASE_VIEW_NOTIFY_SORT_FINISHED) {
+        return;
+    }
+    g_mutex_lock(&ctx->mutex);
+    if (id == DATABASE_VIEW_NOTIFY_SEARCH_FINISHED) {
+        ctx->num_searches++;
+    }
+    else {
+        ctx->num_sorts++;
+    }
+    g_cond_broadcast(&ctx->cond);
+    g_mutex_unlock(&ctx->mutex);
+}
+
+static void
+bench_view_wait(BenchViewContext *ctx, uint32_t num_searches, uint32_t num_sorts) {
+    const gint64 end_time = g_get_monotonic_time() + BENCH_VIEW_TIMEOUT;
+    g_mutex_lock(&ctx->mutex);
+    while (ctx->num_searches < num_searches || ctx->num_sorts < num_sorts) {
+        if (!g_cond_wait_until(&ctx->cond, &ctx->mutex, end_time)) {
+            g_printerr("[benchmark] the view didn't finish in time\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    g_mutex_unlock(&ctx->mutex);
+}
+
+static void
+bench_view_set_sort_order(FsearchDatabaseView *view, BenchViewContext *ctx, FsearchDatabaseIndexType sort_order) {
+    g_mutex_lock(&ctx->mutex);
+    const uint32_t num_sorts = ctx->num_sorts;
+    g_mutex_unlock(&ctx->mutex);
+    db_view_set_sort_order(view, sort_order, GTK_SORT_ASCENDING);
+    bench_view_wait(ctx, 0, num_sorts + 1);
+}
+
+static double
+bench_view_sort_once(FsearchDatabaseView *view, BenchViewContext *ctx, FsearchDatabaseIndexType sort_order) {
+    if (db_view_get_sort_order(view) == sort_order) {
+        // the view doesn't sort again if the order stays the same
+        bench_view_set_sort_order(view,
+                                  ctx,
+                                  sort_order == DATABASE_INDEX_TYPE_NAME ? DATABASE_INDEX_TYPE_PATH
+                                                                         : DATABASE_INDEX_TYPE_NAME);
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    bench_view_set_sort_order(view, ctx, sort_order);
+    return g_timer_elapsed(timer, NULL) * 1000;
+}
+
+static void
+bench_view_sort(FsearchDatabase *db,
+                FsearchFilterManager *filters,
+                const char *query_text,
+                uint32_t num_runs,
+                bool indexed[NUM_DATABASE_INDEX_TYPES]) {
+    BenchViewContext ctx = {};
+    g_mutex_init(&ctx.mutex);
+    g_cond_init(&ctx.cond);
+    FsearchDatabaseView *view = db_view_new(query_text,
+                                            0,
+                                            NULL,
+                                            filters,
+                                            DATABASE_INDEX_TYPE_PATH,
+                                            GTK_SORT_ASCENDING,
+                                            on_bench_view_notify,
+                                            &ctx);
+    // registering searches and then sorts the results
+    db_view_register_database(view, db);
+    bench_view_wait(&ctx, 1, 1);
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(bench_sort_orders); i++) {
+        const FsearchDatabaseIndexType sort_order = bench_sort_orders[i].sort_order;
+        if (!indexed[sort_order]) {
+            continue;
+        }
+        g_autofree char *name =
+            g_strdup_printf("view_sort/%s/%s", query_text[0] ? query_text : "*", bench_sort_orders[i].name);
+        BenchResult *result = bench_result_new(name);
+        result->num_results = db_view_get_num_entries(view);
+        for (uint32_t run = 0; run < num_runs; run++) {
+            bench_result_add(result, bench_view_sort_once(view, &ctx, sort_order));
+        }
+    }
+
+    db_view_unregister_database(view);
+    g_clear_pointer(&view, db_view_unref);
+    g_mutex_clear(&ctx.mutex);
+    g_cond_clear(&ctx.cond);
+}
+
+static char *
+get_default_tmp_dir(void) {
+    // the scan should measure the database rather than the disk
+    if (g_access("/dev/shm", W_OK) == 0) {
+        return g_strdup("/dev/shm");
+    }
+    return g_strdup(g_get_tmp_dir());
+}
+
+int
+main(int argc, char *argv[]) {
+    gint64 num_entries = 1000000;
+    gint64 seed = 1;
+    gint num_runs = 5;
+    g_autofree char *tmp_dir = NULL;
+    g_autofree char *output = NULL;
+    gboolean keep_tree = FALSE;
+    const GOptionEntry entries[] = {
+        {"entries", 'n', 0, G_OPTION_ARG_INT64, &num_entries, "Number of files and folders of the tree", "N"},
+        {"seed", 0, 0, G_OPTION_ARG_INT64, &seed, "Seed of the tree", "SEED"},
+        {"runs", 'r', 0, G_OPTION_ARG_INT, &num_runs, "Number of runs of every operation", "N"},
+        {"tmp-dir", 0, 0, G_OPTION_ARG_FILENAME, &tmp_dir, "Create the tree in DIR, /dev/shm by default", "DIR"},
+        {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the results to FILE instead of stdout", "FILE"},
+        {"keep-tree", 0, 0, G_OPTION_ARG_NONE, &keep_tree, "Don't remove the tree and the database file", NULL},
+        {NULL}};
+
+    g_autoptr(GOptionContext) context = g_option_context_new("- benchmark the database");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_autoptr(GError) error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("[benchmark] %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (num_entries <= 0 || num_runs <= 0) {
+        g_printerr("[benchmark] the number of entries and runs must be positive\n");
+        return EXIT_FAILURE;
+    }
+    if (!tmp_dir) {
+        tmp_dir = get_default_tmp_dir();
+    }
+
+    g_autofree char *root = g_build_filename(tmp_dir, "fsearch_benchmark_XXXXXX", NULL);
+    if (!g_mkdtemp(root)) {
+        g_printerr("[benchmark] failed to create a directory in %s: %s\n", tmp_dir, g_strerror(errno));
+        return EXIT_FAILURE;
+    }
+    g_autofree char *tree_dir = g_build_filename(root, "tree", NULL);
+    g_autofree char *db_dir = g_build_filename(root, "database", NULL);
+    g_mkdir(tree_dir, 0755);
+    g_mkdir(db_dir, 0755);
+
+    bench_results = g_ptr_array_new_with_free_func((GDestroyNotify)bench_result_free);
+
+    g_printerr("[benchmark] creating %" G_GINT64_FORMAT " entries in %s...\n", num_entries, tree_dir);
+    BenchTree tree = {
+        .random = {.state = (uint64_t)seed * UINT64_C(0x9E3779B97F4A7C15) + 1},
+        .path = g_string_new(tree_dir),
+        .num_remaining = (uint64_t)num_entries,
+    };
+    bench_tree_add_folder(&tree, 0);
+    g_string_free(tree.path, TRUE);
+
+    // the default settings of the preferences, but only the tree gets indexed
+    FsearchConfig *config = calloc(1, sizeof(FsearchConfig));
+    g_assert(config);
+    config_load_default(config);
+    g_list_free_full(g_steal_pointer(&config->indexes), (GDestroyNotify)fsearch_index_free);
+    config->indexes = g_list_append(NULL, fsearch_index_new(FSEARCH_INDEX_FOLDER_TYPE, tree_dir, true, true, false, 0));
+
+    g_printerr("[benchmark] scanning...\n");
+    FsearchDatabase *db = NULL;
+    BenchResult *result = bench_result_new("scan");
+    for (int32_t run = 0; run < num_runs; run++) {
+        g_clear_pointer(&db, db_unref);
+        db = fsearch_application_new_database(config);
+        g_autoptr(GTimer) timer = g_timer_new();
+        db_scan(db, NULL, NULL);
+        bench_result_add(result, g_timer_elapsed(timer, NULL) * 1000);
+    }
+    result->num_results = db_get_num_entries(db);
+
+    g_printerr("[benchmark] saving...\n");
+    result = bench_result_new("save");
+    result->num_results = db_get_num_entries(db);
+    for (int32_t run = 0; run < num_runs; run++) {
+        g_autoptr(GTimer) timer = g_timer_new();
+        db_lock(db);
+        db_save(db, db_dir, NULL, NULL);
+        db_unlock(db);
+        bench_result_add(result, g_timer_elapsed(timer, NULL) * 1000);
+    }
+
+    g_printerr("[benchmark] loading...\n");
+    g_autofree char *db_file = g_build_filename(db_dir, "fsearch.db", NULL);
+    result = bench_result_new("load");
+    for (int32_t run = 0; run < num_runs; run++) {
+        FsearchDatabase *loaded_db = fsearch_application_new_database(config);
+        // the daemon would write to the journal of the file otherwise
+        db_set_read_only_file(loaded_db, true);
+        g_autoptr(GTimer) timer = g_timer_new();
+        if (!db_load(loaded_db, db_file, NULL, NULL)) {
+            g_printerr("[benchmark] failed to load %s\n", db_file);
+            return EXIT_FAILURE;
+        }
+        bench_result_add(result, g_timer_elapsed(timer, NULL) * 1000);
+        result->num_results = db_get_num_entries(loaded_db);
+        g_clear_pointer(&loaded_db, db_unref);
+    }
+
+    g_printerr("[benchmark] searching...\n");
+    bench_search(db, config->filters, num_runs);
+
+    g_printerr("[benchmark] sorting...\n");
+    bool indexed[NUM_DATABASE_INDEX_TYPES] = {false};
+    bench_sort(db, num_runs, indexed);
+    bench_view_sort(db, config->filters, "", num_runs, indexed);
+    bench_view_sort(db, config->filters, "a", num_runs, indexed);
+
+    GString *json = g_string_new("{\n");
+    g_string_append_printf(json,
+                           "  \"entries\": %" G_GINT64_FORMAT ",\n  \"folders\": %" G_GUINT64_FORMAT
+                           ",\n  \"files\": %" G_GUINT64_FORMAT ",\n  \"seed\": %" G_GINT64_FORMAT
+                           ",\n  \"runs\": %d,\n  \"processors\": %u,\n  \"results\": [\n",
+                           num_entries,
+                           tree.num_folders,
+                           tree.num_files,
+                           seed,
+                           num_runs,
+                           g_get_num_processors());
+    for (uint32_t i = 0; i < bench_results->len; i++) {
+        json_append_result(json, g_ptr_array_index(bench_results, i));
+        g_string_append(json, i + 1 < bench_results->len ? ",\n" : "\n");
+    }
+    g_string_append(json, "  ]\n}\n");
+
+    int status = EXIT_SUCCESS;
+    if (output) {
+        if (!g_file_set_contents(output, json->str, (gssize)json->len, &error)) {
+            g_printerr("[benchmark] failed to write %s: %s\n", output, error->message);
+            status = EXIT_FAILURE;
+        }
+    }
+    else {
+        fputs(json->str, stdout);
+    }
+    g_string_free(json, TRUE);
+
+    g_clear_pointer(&db, db_unref);
+    db_save_wait_for_background_saves();
+    g_clear_pointer(&config, config_free);
+    g_clear_pointer(&bench_results, g_ptr_array_unref);
+    if (!keep_tree) {
+        nftw(root, bench_remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+    }
+    return status;
+}
@@ -0,0 +1,476 @@
+#include <glib.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_query_match_data.h>
+#include <src/fsearch_query_matchers.h>
+#include <src/fsearch_query_node.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLE_COUNTER
+#endif
+
+// Runs single query nodes against a fixed corpus of entries and reports how long their search and highlight
+// functions take per entry and how many cycles they need per byte of the haystack. The corpus is generated from a
+// fixed seed, once with ASCII names only and once where every name has non-ASCII characters.
+
+#define BENCH_MAX_DEPTH 8
+#define BENCH_BASE_TIME 1700000000
+#define BENCH_TIME_SPAN (10 * 365 * 24 * 3600)
+
+static const char *bench_ascii_words[] = {
+    "report", "notes",  "main",    "index",  "README", "Makefile", "invoice", "budget", "draft",  "final",
+    "src",    "docs",   "images",  "Photos", "Music",  "backup",   "build",   "cache",  "config", "data",
+    "setup",  "photo",  "summary", "letter", "scan",   "output",   "module",  "schema", "script", "style",
+};
+
+static const char *bench_utf_words[] = {
+    "Rechnung", "Überweisung", "présentation", "résumé", "отчёт",  "проекты", "写真",  "Übersicht",
+    "Fotoğraf", "Ελληνικά",    "naïve",        "Straße", "año",    "città",   "ﬁnal", "ÅRSREDOVISNING",
+};
+
+static const char *bench_extensions[] = {
+    ".jpg",  ".jpg",  ".png", ".c",  ".h",   ".txt",  ".pdf", ".mp3", ".js",  ".py",
+    ".html", ".json", ".o",   ".gz", ".zip", ".docx", ".mkv", ".md",  ".JPG", "",
+};
+
+static const char *bench_prefixes[] = {"IMG_", "DSC", "track_", "Screenshot_"};
+
+typedef struct {
+    uint64_t state;
+} BenchRandom;
+
+static uint64_t
+bench_random_next(BenchRandom *random) {
+    // xorshift64*
+    random->state ^= random->state >> 12;
+    random->state ^= random->state << 25;
+    random->state ^= random->state >> 27;
+    return random->state * UINT64_C(2685821657736338717);
+}
+
+static uint32_t
+bench_random_range(BenchRandom *random, uint32_t n) {
+    return (uint32_t)(bench_random_next(random) % n);
+}
+
+#define bench_random_pick(random, array) ((array)[bench_random_range((random), G_N_ELEMENTS(array))])
+
+typedef struct {
+    const char *name;
+    FsearchMemoryPool *file_pool;
+    FsearchMemoryPool *folder_pool;
+    GPtrArray *folders;
+    // every entry of the corpus, folders and files mixed like in a search over both
+    GPtrArray *entries;
+    uint64_t name_bytes;
+    uint64_t path_bytes;
+} BenchCorpus;
+
+static void
+bench_corpus_append_name(GString *name, BenchRandom *random, bool utf, bool is_folder) {
+    const uint32_t kind = bench_random_range(random, 100);
+    if (kind < 25 && !utf) {
+        g_string_append_printf(name,
+                               "%s%04u",
+                               bench_random_pick(random, bench_prefixes),
+                               bench_random_range(random, 10000));
+    }
+    else {
+        const uint32_t num_words = 1 + bench_random_range(random, 3);
+        for (uint32_t i = 0; i < num_words; i++) {
+            if (i > 0) {
+                g_string_append_c(name, bench_random_range(random, 2) ? '_' : ' ');
+            }
+            // utf names get at least one non-ASCII word
+            const bool pick_utf = utf && (i == 0 || bench_random_range(random, 2));
+            g_string_append(name,
+                            pick_utf ? bench_random_pick(random, bench_utf_words)
+                                     : bench_random_pick(random, bench_ascii_words));
+        }
+        if (kind < 50) {
+            g_string_append_printf(name, "_%u", bench_random_range(random, 100));
+        }
+    }
+    if (!is_folder) {
+        g_string_append(name, bench_random_pick(random, bench_extensions));
+    }
+}
+
+static FsearchDatabaseEntry *
+bench_corpus_add_entry(BenchCorpus *corpus,
+                       FsearchDatabaseEntryFolder *parent,
+                       FsearchDatabaseEntryType type,
+                       const char *name,
+                       BenchRandom *random) {
+    const bool is_folder = type == DATABASE_ENTRY_TYPE_FOLDER;
+    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(is_folder ? corpus->folder_pool : corpus->file_pool);
+    db_entry_set_type(entry, type);
+    db_entry_set_name(entry, name);
+    db_entry_set_parent(entry, parent);
+    db_entry_set_mtime(entry, BENCH_BASE_TIME - bench_random_range(random, BENCH_TIME_SPAN));
+    if (!is_folder) {
+        // mostly small files, some large ones
+        const uint32_t shift = bench_random_range(random, 100) < 5 ? 20 + bench_random_range(random, 12) : 12;
+        db_entry_set_size(entry, (off_t)bench_random_range(random, 1u << shift));
+        db_entry_update_parent_size(entry);
+    }
+    else {
+        g_ptr_array_add(corpus->folders, entry);
+    }
+    return entry;
+}
+
+static BenchCorpus *
+bench_corpus_new(const char *name, uint32_t num_entries, uint64_t seed, bool utf) {
+    BenchCorpus *corpus = g_new0(BenchCorpus, 1);
+    corpus->name = name;
+    corpus->file_pool =
+        fsearch_memory_pool_new(4096, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    corpus->folder_pool =
+        fsearch_memory_pool_new(4096, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    corpus->folders = g_ptr_array_new();
+    corpus->entries = g_ptr_array_sized_new(num_entries);
+
+    BenchRandom random = {.state = seed ? seed : 1};
+    g_autoptr(GString) entry_name = g_string_new(NULL);
+
+    bench_corpus_add_entry(corpus, NULL, DATABASE_ENTRY_TYPE_FOLDER, "", &random);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        // one in ten entries is a folder, its parent is one of the folders created so far
+        FsearchDatabaseEntryFolder *parent = NULL;
+        do {
+            parent = g_ptr_array_index(corpus->folders, bench_random_range(&random, corpus->folders->len));
+        } while (db_entry_get_depth((FsearchDatabaseEntry *)parent) >= BENCH_MAX_DEPTH);
+
+        const bool is_folder = bench_random_range(&random, 10) == 0;
+        g_string_truncate(entry_name, 0);
+        bench_corpus_append_name(entry_name, &random, utf, is_folder);
+        FsearchDatabaseEntry *entry = bench_corpus_add_entry(corpus,
+                                                             parent,
+                                                             is_folder ? DATABASE_ENTRY_TYPE_FOLDER
+                                                                       : DATABASE_ENTRY_TYPE_FILE,
+                                                             entry_name->str,
+                                                             &random);
+        g_ptr_array_add(corpus->entries, entry);
+
+        corpus->name_bytes += entry_name->len;
+        g_autoptr(GString) path = db_entry_get_path_full(entry);
+        corpus->path_bytes += path->len;
+    }
+    return corpus;
+}
+
+static void
+bench_corpus_free(BenchCorpus *corpus) {
+    g_clear_pointer(&corpus->entries, g_ptr_array_unref);
+    g_clear_pointer(&corpus->folders, g_ptr_array_unref);
+    g_clear_pointer(&corpus->file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&corpus->folder_pool, fsearch_memory_pool_free_pool);
+    g_free(corpus);
+}
+
+typedef enum {
+    BENCH_NODE_STRING,
+    BENCH_NODE_EXTENSION,
+    BENCH_NODE_SIZE,
+    BENCH_NODE_DATE_MODIFIED,
+    BENCH_NODE_DEPTH,
+    BENCH_NODE_CHILDCOUNT,
+} BenchNodeKind;
+
+typedef struct {
+    const char *label;
+    BenchNodeKind kind;
+    const char *needle;
+    FsearchQueryFlags flags;
+} BenchCase;
+
+static const BenchCase bench_cases[] = {
+    {"substring", BENCH_NODE_STRING, "report", 0},
+    {"substring, short", BENCH_NODE_STRING, "a", 0},
+    {"substring, match case", BENCH_NODE_STRING, "README", QUERY_FLAG_MATCH_CASE},
+    {"substring, path", BENCH_NODE_STRING, "src/main", QUERY_FLAG_SEARCH_IN_PATH},
+    {"substring, path, match case", BENCH_NODE_STRING, "src/main", QUERY_FLAG_SEARCH_IN_PATH | QUERY_FLAG_MATCH_CASE},
+    {"substring, utf", BENCH_NODE_STRING, "überweisung", 0},
+    {"substring, utf, match case", BENCH_NODE_STRING, "Überweisung", QUERY_FLAG_MATCH_CASE},
+    {"substring, utf, path", BENCH_NODE_STRING, "проекты/отчёт", QUERY_FLAG_SEARCH_IN_PATH},
+    {"exact", BENCH_NODE_STRING, "readme.md", QUERY_FLAG_EXACT_MATCH},
+    {"exact, match case", BENCH_NODE_STRING, "README.md", QUERY_FLAG_EXACT_MATCH | QUERY_FLAG_MATCH_CASE},
+    {"exact, utf", BENCH_NODE_STRING, "straße.pdf", QUERY_FLAG_EXACT_MATCH},
+    {"wildcard", BENCH_NODE_STRING, "img_*.jpg", 0},
+    {"wildcard, path", BENCH_NODE_STRING, "*/photos/*.jpg", QUERY_FLAG_SEARCH_IN_PATH},
+    {"regex", BENCH_NODE_STRING, "^IMG_[0-9]+\\.jpg$", QUERY_FLAG_REGEX},
+    {"regex, match case", BENCH_NODE_STRING, "^IMG_[0-9]+\\.jpg$", QUERY_FLAG_REGEX | QUERY_FLAG_MATCH_CASE},
+    {"regex, path", BENCH_NODE_STRING, "/src/.*\\.c$", QUERY_FLAG_REGEX | QUERY_FLAG_SEARCH_IN_PATH},
+    {"regex, utf", BENCH_NODE_STRING, "r[eé]sum[eé]", QUERY_FLAG_REGEX},
+    {"fuzzy", BENCH_NODE_STRING, "rprt", QUERY_FLAG_FUZZY},
+    {"fuzzy, utf", BENCH_NODE_STRING, "übrw", QUERY_FLAG_FUZZY},
+    {"extension", BENCH_NODE_EXTENSION, "jpg", 0},
+    {"extension, list", BENCH_NODE_EXTENSION, "pdf;docx;md", 0},
+    {"size", BENCH_NODE_SIZE, NULL, 0},
+    {"date modified", BENCH_NODE_DATE_MODIFIED, NULL, 0},
+    {"depth", BENCH_NODE_DEPTH, NULL, 0},
+    {"childcount", BENCH_NODE_CHILDCOUNT, NULL, 0},
+};
+
+static FsearchQueryNode *
+bench_case_new_node(const BenchCase *bench_case) {
+    switch (bench_case->kind) {
+    case BENCH_NODE_STRING:
+        return fsearch_query_node_new(bench_case->needle, bench_case->flags);
+    case BENCH_NODE_EXTENSION:
+        return fsearch_query_node_new_extension(bench_case->needle, bench_case->flags);
+    case BENCH_NODE_SIZE:
+        return fsearch_query_node_new_size(bench_case->flags, 1024 * 1024, 0, FSEARCH_QUERY_NODE_COMPARISON_GREATER);
+    case BENCH_NODE_DATE_MODIFIED:
+        return fsearch_query_node_new_date_modified(bench_case->flags,
+                                                    BENCH_BASE_TIME - 365 * 24 * 3600,
+                                                    BENCH_BASE_TIME,
+                                                    FSEARCH_QUERY_NODE_COMPARISON_RANGE);
+    case BENCH_NODE_DEPTH:
+        return fsearch_query_node_new_depth(bench_case->flags, 3, 0, FSEARCH_QUERY_NODE_COMPARISON_SMALLER_EQ);
+    case BENCH_NODE_CHILDCOUNT:
+        return fsearch_query_node_new_childcount(bench_case->flags, 10, 0, FSEARCH_QUERY_NODE_COMPARISON_GREATER);
+    }
+    return NULL;
+}
+
+#define BENCH_MATCHER(name) {fsearch_query_matcher_##name, #name}
+
+// to tell which matcher a node ended up with
+static const struct {
+    FsearchQueryNodeMatchFunc *func;
+    const char *name;
+} bench_matchers[] = {
+    BENCH_MATCHER(false),
+    BENCH_MATCHER(true),
+    BENCH_MATCHER(extension),
+    BENCH_MATCHER(date_modified),
+    BENCH_MATCHER(date_accessed),
+    BENCH_MATCHER(date_created),
+    BENCH_MATCHER(date_changed),
+    BENCH_MATCHER(owner),
+    BENCH_MATCHER(group),
+    BENCH_MATCHER(perm),
+    BENCH_MATCHER(perm_any),
+    BENCH_MATCHER(depth),
+    BENCH_MATCHER(childcount),
+    BENCH_MATCHER(childfilecount),
+    BENCH_MATCHER(childfoldercount),
+    BENCH_MATCHER(size),
+    BENCH_MATCHER(content),
+    BENCH_MATCHER(xattr),
+    BENCH_MATCHER(regex),
+    BENCH_MATCHER(fuzzy),
+    BENCH_MATCHER(utf_strcasecmp),
+    BENCH_MATCHER(utf_strcasestr),
+    BENCH_MATCHER(strstr),
+    BENCH_MATCHER(ascii_strcasestr),
+    BENCH_MATCHER(aho_corasick),
+    BENCH_MATCHER(path_substring),
+    BENCH_MATCHER(parent),
+    BENCH_MATCHER(strcmp),
+    BENCH_MATCHER(strcasecmp),
+    BENCH_MATCHER(highlight_none),
+    BENCH_MATCHER(highlight_extension),
+    BENCH_MATCHER(highlight_size),
+    BENCH_MATCHER(highlight_regex),
+    BENCH_MATCHER(highlight_ascii),
+    BENCH_MATCHER(highlight_fuzzy),
+};
+
+static const char *
+bench_get_matcher_name(FsearchQueryNode *node, FsearchQueryNodeMatchFunc *func) {
+    for (uint32_t i = 0; i < G_N_ELEMENTS(bench_matchers); i++) {
+        if (bench_matchers[i].func == func) {
+            return bench_matchers[i].name;
+        }
+    }
+    return node->description ? node->description->str : "";
+}
+
+static uint64_t
+bench_get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+bench_get_cycles(void) {
+#ifdef BENCH_HAVE_CYCLE_COUNTER
+    // the time stamp counter, which ticks at the nominal frequency of the CPU
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    uint64_t ns;
+    uint64_t cycles;
+} BenchSample;
+
+static int
+bench_sample_compare(const void *a, const void *b) {
+    const BenchSample *sample_a = a;
+    const BenchSample *sample_b = b;
+    return sample_a->ns < sample_b->ns ? -1 : sample_a->ns > sample_b->ns;
+}
+
+// Returns the median of runs passes over the corpus and the number of entries func matched
+static BenchSample
+bench_run(FsearchQueryNode *node,
+          FsearchQueryNodeMatchFunc *func,
+          BenchCorpus *corpus,
+          FsearchQueryMatchData *match_data,
+          uint32_t runs,
+          uint32_t *num_matches) {
+    g_autofree BenchSample *samples = g_new0(BenchSample, runs);
+    for (uint32_t run = 0; run < runs; run++) {
+        // the folder verdicts of the previous run must not make this one faster
+        fsearch_query_match_data_reset(match_data);
+
+        uint32_t matches = 0;
+        const uint64_t start_ns = bench_get_time_ns();
+        const uint64_t start_cycles = bench_get_cycles();
+        for (uint32_t i = 0; i < corpus->entries->len; i++) {
+            FsearchDatabaseEntry *entry = g_ptr_array_index(corpus->entries, i);
+            const FsearchDatabaseEntryType type = db_entry_get_type(entry);
+            if ((node->flags & QUERY_FLAG_FOLDERS_ONLY && type != DATABASE_ENTRY_TYPE_FOLDER)
+                || (node->flags & QUERY_FLAG_FILES_ONLY && type != DATABASE_ENTRY_TYPE_FILE)) {
+                continue;
+            }
+            fsearch_query_match_data_set_entry(match_data, entry);
+            if (func(node, match_data)) {
+                matches++;
+            }
+        }
+        samples[run].cycles = bench_get_cycles() - start_cycles;
+        samples[run].ns = bench_get_time_ns() - start_ns;
+        *num_matches = matches;
+    }
+    qsort(samples, runs, sizeof(BenchSample), bench_sample_compare);
+    return samples[runs / 2];
+}
+
+// The numeric matchers don't look at any string, so they have no haystack
+static uint64_t
+bench_case_get_haystack_bytes(const BenchCase *bench_case, FsearchQueryNode *node, BenchCorpus *corpus) {
+    if (bench_case->kind != BENCH_NODE_STRING && bench_case->kind != BENCH_NODE_EXTENSION) {
+        return 0;
+    }
+    return node->flags & QUERY_FLAG_SEARCH_IN_PATH ? corpus->path_bytes : corpus->name_bytes;
+}
+
+static void
+bench_print_result(const BenchCase *bench_case,
+                   FsearchQueryNode *node,
+                   BenchCorpus *corpus,
+                   const char *mode,
+                   FsearchQueryNodeMatchFunc *func,
+                   BenchSample sample,
+                   uint32_t num_matches) {
+    const uint32_t num_entries = corpus->entries->len;
+    const double ns_per_entry = (double)sample.ns / num_entries;
+    const uint64_t bytes = bench_case_get_haystack_bytes(bench_case, node, corpus);
+    g_autofree char *cycles_per_byte = NULL;
+#ifdef BENCH_HAVE_CYCLE_COUNTER
+    cycles_per_byte = bytes > 0 ? g_strdup_printf("%.3f", (double)sample.cycles / bytes) : g_strdup("-");
+#else
+    cycles_per_byte = g_strdup("-");
+#endif
+    printf("%-30s %-6s %-9s %-24s %10.2f %12s %10u\n",
+           bench_case->label,
+           corpus->name,
+           mode,
+           bench_get_matcher_name(node, func),
+           ns_per_entry,
+           cycles_per_byte,
+           num_matches);
+}
+
+static void
+bench_case_run(const BenchCase *bench_case, BenchCorpus *corpus, FsearchQueryMatchData *match_data, uint32_t runs) {
+    FsearchQueryNode *node = bench_case_new_node(bench_case);
+    if (!node) {
+        printf("%-30s %-6s failed to create the node\n", bench_case->label, corpus->name);
+        return;
+    }
+    uint32_t num_matches = 0;
+    BenchSample sample = bench_run(node, node->search_func, corpus, match_data, runs, &num_matches);
+    bench_print_result(bench_case, node, corpus, "search", node->search_func, sample, num_matches);
+    if (node->highlight_func) {
+        sample = bench_run(node, node->highlight_func, corpus, match_data, runs, &num_matches);
+        bench_print_result(bench_case, node, corpus, "highlight", node->highlight_func, sample, num_matches);
+    }
+    g_clear_pointer(&node, fsearch_query_node_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    setlocale(LC_ALL, "");
+
+    gint num_entries = 200000;
+    gint runs = 9;
+    gint64 seed = 1;
+    g_autofree char *filter = NULL;
+
+    GOptionEntry entries[] = {
+        {"entries", 'n', 0, G_OPTION_ARG_INT, &num_entries, "Number of entries in each corpus", "N"},
+        {"runs", 'r', 0, G_OPTION_ARG_INT, &runs, "Passes over the corpus per matcher, the median is reported", "N"},
+        {"seed", 0, 0, G_OPTION_ARG_INT64, &seed, "Seed of the generated corpus", "SEED"},
+        {"filter", 'f', 0, G_OPTION_ARG_STRING, &filter, "Only run cases whose label contains TEXT", "TEXT"},
+        {NULL},
+    };
+    g_autoptr(GOptionContext) context = g_option_context_new("- benchmark the query matchers");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_autoptr(GError) error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (num_entries < 1 || runs < 1) {
+        g_printerr("--entries and --runs must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    BenchCorpus *corpora[] = {
+        bench_corpus_new("ascii", num_entries, seed, false),
+        bench_corpus_new("utf", num_entries, seed, true),
+    };
+    FsearchQueryMatchData *match_data = fsearch_query_match_data_new();
+
+#ifndef BENCH_HAVE_CYCLE_COUNTER
+    printf("no cycle counter on this platform, cycles/byte are not available\n");
+#endif
+    printf("%-30s %-6s %-9s %-24s %10s %12s %10s\n",
+           "case",
+           "names",
+           "mode",
+           "matcher",
+           "ns/entry",
+           "cycles/byte",
+           "matches");
+    for (uint32_t i = 0; i < G_N_ELEMENTS(bench_cases); i++) {
+        if (filter && !strstr(bench_cases[i].label, filter)) {
+            continue;
+        }
+        for (uint32_t j = 0; j < G_N_ELEMENTS(corpora); j++) {
+            bench_case_run(&bench_cases[i], corpora[j], match_data, runs);
+        }
+    }
+
+    g_clear_pointer(&match_data, fsearch_query_match_data_free);
+    for (uint32_t j = 0; j < G_N_ELEMENTS(corpora); j++) {
+        g_clear_pointer(&corpora[j], bench_corpus_free);
+    }
+    return EXIT_SUCCESS;
+}
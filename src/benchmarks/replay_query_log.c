@@ -0,0 +1,366 @@
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch.h>
+#include <src/fsearch_config.h>
+#include <src/fsearch_database.h>
+#include <src/fsearch_database_view.h>
+#include <src/fsearch_query_log.h>
+
+// Replays a query log (see fsearch_query_log.h) against a database with the timing it was recorded with. For every
+// search it measures the latency from the keystroke which requested it until the view shows the results of it or of
+// a newer search, which replaced it while it was still waiting, and how many searches were waiting at that keystroke.
+
+// how long to wait for the results of the last searches
+#define REPLAY_TIMEOUT_SECONDS 60
+
+typedef struct {
+    char *query;
+    FsearchQueryFlags flags;
+    char *filter;
+    int64_t request_time;
+    // the searches which were still waiting for their results when it was requested
+    uint32_t queue_depth;
+} ReplaySearch;
+
+typedef struct {
+    GMainLoop *loop;
+    FsearchDatabaseView *view;
+    FsearchFilterManager *filters;
+    GArray *records;
+    uint32_t next_record;
+    double speed;
+    int64_t start_time;
+
+    // the state of the view as set by the replay
+    char *query_text;
+    FsearchQueryFlags flags;
+    FsearchFilter *filter;
+
+    // the searches waiting for their results, oldest first
+    GQueue *pending;
+    GArray *latencies;
+    GArray *queue_depths;
+    GArray *recorded;
+    // the finish time of the latest search which wasn't cancelled
+    int64_t finish_time;
+    uint32_t num_finished;
+    uint32_t num_replayed;
+    uint32_t num_unknown_filters;
+    bool timed_out;
+} ReplayContext;
+
+static void
+replay_search_free(ReplaySearch *search) {
+    g_clear_pointer(&search->query, g_free);
+    g_clear_pointer(&search->filter, g_free);
+    g_clear_pointer(&search, free);
+}
+
+static bool
+replay_search_is_query(ReplaySearch *search, FsearchQuery *query) {
+    return !strcmp(search->query, query->search_term) && search->flags == query->flags
+        && !g_strcmp0(search->filter, query->filter ? query->filter->name : NULL);
+}
+
+static gboolean
+on_replay_timeout(gpointer user_data) {
+    ReplayContext *ctx = user_data;
+    ctx->timed_out = true;
+    g_main_loop_quit(ctx->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+replay_request(ReplayContext *ctx, FsearchQueryLogRecord *record) {
+    FsearchFilter *filter = NULL;
+    if (record->filter) {
+        filter = fsearch_filter_manager_get_filter_for_name(ctx->filters, record->filter);
+        if (!filter) {
+            // e.g. the names in anonymized logs, it gets searched without a filter
+            ctx->num_unknown_filters++;
+        }
+    }
+    const bool filter_changed = filter != ctx->filter;
+    const bool flags_changed = record->flags != ctx->flags;
+    const bool query_changed = strcmp(record->query, ctx->query_text) != 0;
+    if (!filter_changed && !flags_changed && !query_changed) {
+        // the view searched again for something else, like a changed database
+        g_clear_pointer(&filter, fsearch_filter_unref);
+        return;
+    }
+
+    ReplaySearch *search = calloc(1, sizeof(ReplaySearch));
+    g_assert(search);
+    search->query = g_strdup(record->query);
+    search->flags = record->flags;
+    search->filter = filter ? g_strdup(filter->name) : NULL;
+    search->request_time = g_get_monotonic_time();
+    search->queue_depth = g_queue_get_length(ctx->pending);
+    g_queue_push_tail(ctx->pending, search);
+
+    if (filter_changed) {
+        db_view_set_filter(ctx->view, filter);
+    }
+    if (flags_changed) {
+        db_view_set_query_flags(ctx->view, record->flags);
+    }
+    if (query_changed) {
+        db_view_set_query_text(ctx->view, record->query);
+    }
+    g_clear_pointer(&ctx->filter, fsearch_filter_unref);
+    ctx->filter = filter;
+    ctx->flags = record->flags;
+    g_free(ctx->query_text);
+    ctx->query_text = g_strdup(record->query);
+    ctx->num_replayed++;
+}
+
+static gboolean
+on_replay_next_record(gpointer user_data) {
+    ReplayContext *ctx = user_data;
+    FsearchQueryLogRecord *record = &g_array_index(ctx->records, FsearchQueryLogRecord, ctx->next_record++);
+    if (record->status == FSEARCH_QUERY_LOG_STATUS_FINISHED) {
+        const double recorded_ms = record->queued_ms + record->search_ms;
+        g_array_append_val(ctx->recorded, recorded_ms);
+    }
+    replay_request(ctx, record);
+
+    if (ctx->next_record < ctx->records->len) {
+        const double first_time_ms = g_array_index(ctx->records, FsearchQueryLogRecord, 0).time_ms;
+        const double next_time_ms = g_array_index(ctx->records, FsearchQueryLogRecord, ctx->next_record).time_ms;
+        const int64_t next_time = ctx->start_time + (int64_t)((next_time_ms - first_time_ms) / ctx->speed * 1000);
+        // relative to the start, so the delays of the main loop don't add up
+        const int64_t delay = MAX(next_time - g_get_monotonic_time(), 0);
+        g_timeout_add((guint)(delay / 1000), on_replay_next_record, ctx);
+    }
+    else if (g_queue_is_empty(ctx->pending)) {
+        g_main_loop_quit(ctx->loop);
+    }
+    else {
+        g_timeout_add_seconds(REPLAY_TIMEOUT_SECONDS, on_replay_timeout, ctx);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+on_replay_search_finished(gpointer user_data) {
+    ReplayContext *ctx = user_data;
+    const int64_t now = g_get_monotonic_time();
+    FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS] = {};
+    db_view_get_operation_stats(ctx->view, stats);
+    // cancelled searches finish as well, but their results don't get shown
+    if (stats[FSEARCH_OPERATION_SEARCH].finish_time == ctx->finish_time) {
+        return G_SOURCE_REMOVE;
+    }
+    ctx->finish_time = stats[FSEARCH_OPERATION_SEARCH].finish_time;
+    if (ctx->num_finished++ == 0) {
+        // the search for everything after registering the database, the replay starts now
+        ctx->start_time = g_get_monotonic_time();
+        g_idle_add(on_replay_next_record, ctx);
+        return G_SOURCE_REMOVE;
+    }
+
+    FsearchQuery *query = db_view_get_query(ctx->view);
+    // the newest search with that query, everything before it was replaced by it
+    int32_t idx = -1;
+    for (GList *l = ctx->pending->tail; l && query; l = l->prev) {
+        if (replay_search_is_query(l->data, query)) {
+            idx = g_queue_link_index(ctx->pending, l);
+            break;
+        }
+    }
+    g_clear_pointer(&query, fsearch_query_unref);
+    for (int32_t i = 0; i <= idx; i++) {
+        ReplaySearch *search = g_queue_pop_head(ctx->pending);
+        const double latency = (double)(now - search->request_time) / 1000;
+        const double queue_depth = search->queue_depth;
+        g_array_append_val(ctx->latencies, latency);
+        g_array_append_val(ctx->queue_depths, queue_depth);
+        g_clear_pointer(&search, replay_search_free);
+    }
+    if (ctx->next_record == ctx->records->len && g_queue_is_empty(ctx->pending)) {
+        g_main_loop_quit(ctx->loop);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_replay_view_notify(FsearchDatabaseView *view, FsearchDatabaseViewNotify id, gpointer user_data) {
+    // like the window, the view may still be locked when it notifies
+    if (id == DATABASE_VIEW_NOTIFY_SEARCH_FINISHED) {
+        g_idle_add(on_replay_search_finished, user_data);
+    }
+}
+
+static int
+compare_samples(gconstpointer a, gconstpointer b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// nearest rank of a sorted array of samples
+static double
+get_percentile(GArray *sorted, double percentile) {
+    const uint32_t rank = (uint32_t)ceil(percentile / 100 * sorted->len);
+    return g_array_index(sorted, double, MAX(rank, 1) - 1);
+}
+
+static void
+print_samples(const char *name, GArray *samples, const char *unit) {
+    if (samples->len == 0) {
+        printf("%-14s -\n", name);
+        return;
+    }
+    g_array_sort(samples, compare_samples);
+    double sum = 0;
+    for (uint32_t i = 0; i < samples->len; i++) {
+        sum += g_array_index(samples, double, i);
+    }
+    printf("%-14s mean %8.2f%s  p50 %8.2f%s  p95 %8.2f%s  p99 %8.2f%s  max %8.2f%s\n",
+           name,
+           sum / samples->len,
+           unit,
+           get_percentile(samples, 50),
+           unit,
+           get_percentile(samples, 95),
+           unit,
+           get_percentile(samples, 99),
+           unit,
+           g_array_index(samples, double, samples->len - 1),
+           unit);
+}
+
+static GArray *
+replay_read_log(const char *file_path, uint32_t *num_malformed, GError **error) {
+    g_autofree char *contents = NULL;
+    if (!g_file_get_contents(file_path, &contents, NULL, error)) {
+        return NULL;
+    }
+    GArray *records = g_array_new(FALSE, FALSE, sizeof(FsearchQueryLogRecord));
+    g_array_set_clear_func(records, (GDestroyNotify)fsearch_query_log_record_clear);
+    g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+    for (uint32_t i = 0; lines[i]; i++) {
+        if (lines[i][0] == '\0' || lines[i][0] == '#') {
+            continue;
+        }
+        FsearchQueryLogRecord record = {};
+        if (fsearch_query_log_parse_record(lines[i], &record)) {
+            g_array_append_val(records, record);
+        }
+        else {
+            (*num_malformed)++;
+        }
+    }
+    return records;
+}
+
+int
+main(int argc, char *argv[]) {
+    g_autofree char *db_file = NULL;
+    double speed = 1;
+    const GOptionEntry entries[] = {
+        {"database", 'd', 0, G_OPTION_ARG_FILENAME, &db_file, "Search FILE instead of the database of fsearch", "FILE"},
+        {"speed", 's', 0, G_OPTION_ARG_DOUBLE, &speed, "Replay the log SPEED times as fast as recorded", "SPEED"},
+        {NULL}};
+
+    g_autoptr(GOptionContext) context = g_option_context_new("LOG - replay a query log against a database");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_autoptr(GError) error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("[replay] %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (argc != 2) {
+        g_printerr("[replay] expected the query log as the only argument\n");
+        return EXIT_FAILURE;
+    }
+    if (speed <= 0) {
+        g_printerr("[replay] the speed must be positive\n");
+        return EXIT_FAILURE;
+    }
+    if (!db_file) {
+        db_file = fsearch_application_get_database_file_path();
+    }
+
+    uint32_t num_malformed = 0;
+    g_autoptr(GArray) records = replay_read_log(argv[1], &num_malformed, &error);
+    if (!records) {
+        g_printerr("[replay] failed to read %s: %s\n", argv[1], error->message);
+        return EXIT_FAILURE;
+    }
+    if (records->len == 0) {
+        g_printerr("[replay] %s has no searches\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    FsearchConfig *config = calloc(1, sizeof(FsearchConfig));
+    g_assert(config);
+    if (!config_load(config) && !config_load_default(config)) {
+        g_printerr("[replay] failed to load config\n");
+        return EXIT_FAILURE;
+    }
+    FsearchDatabase *db = fsearch_application_new_database(config);
+    // the daemon would write to the journal of the file otherwise
+    db_set_read_only_file(db, true);
+    g_printerr("[replay] loading %s...\n", db_file);
+    if (!db_load(db, db_file, NULL, NULL)) {
+        g_printerr("[replay] failed to load %s\n", db_file);
+        return EXIT_FAILURE;
+    }
+
+    ReplayContext ctx = {
+        .loop = g_main_loop_new(NULL, FALSE),
+        .filters = config->filters,
+        .records = records,
+        .speed = speed,
+        .query_text = g_strdup(""),
+        .pending = g_queue_new(),
+        .latencies = g_array_new(FALSE, FALSE, sizeof(double)),
+        .queue_depths = g_array_new(FALSE, FALSE, sizeof(double)),
+        .recorded = g_array_new(FALSE, FALSE, sizeof(double)),
+    };
+    ctx.view = db_view_new("",
+                           0,
+                           NULL,
+                           config->filters,
+                           DATABASE_INDEX_TYPE_NAME,
+                           GTK_SORT_ASCENDING,
+                           on_replay_view_notify,
+                           &ctx);
+    g_printerr("[replay] replaying %u searches...\n", records->len);
+    // the replay starts once the first search finished
+    db_view_register_database(ctx.view, db);
+    g_main_loop_run(ctx.loop);
+
+    printf("searches       %u replayed, %u without changes, %u malformed lines\n",
+           ctx.num_replayed,
+           records->len - ctx.num_replayed,
+           num_malformed);
+    if (ctx.num_unknown_filters > 0) {
+        printf("filters        %u searches with an unknown filter ran without one\n", ctx.num_unknown_filters);
+    }
+    if (ctx.timed_out) {
+        printf("unfinished     %u searches didn't get their results\n", g_queue_get_length(ctx.pending));
+    }
+    print_samples("latency", ctx.latencies, "ms");
+    print_samples("queue depth", ctx.queue_depths, "");
+    print_samples("recorded", ctx.recorded, "ms");
+
+    db_view_unregister_database(ctx.view);
+    g_clear_pointer(&ctx.view, db_view_unref);
+    g_clear_pointer(&ctx.filter, fsearch_filter_unref);
+    g_clear_pointer(&ctx.query_text, g_free);
+    g_queue_free_full(ctx.pending, (GDestroyNotify)replay_search_free);
+    g_clear_pointer(&ctx.latencies, g_array_unref);
+    g_clear_pointer(&ctx.queue_depths, g_array_unref);
+    g_clear_pointer(&ctx.recorded, g_array_unref);
+    g_clear_pointer(&ctx.loop, g_main_loop_unref);
+    g_clear_pointer(&db, db_unref);
+    g_clear_pointer(&config, config_free);
+    return ctx.timed_out ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -23,9 +23,12 @@
 #endif
 
 #include "fsearch.h"
+#include "fsearch_cli.h"
 #include "fsearch_clipboard.h"
 #include "fsearch_config.h"
+#include "fsearch_daemon.h"
 #include "fsearch_database.h"
+#include "fsearch_database_monitor.h"
 #include "fsearch_file_utils.h"
 #include "fsearch_limits.h"
 #include "fsearch_preferences_ui.h"
@@ -44,6 +47,9 @@
 struct _FsearchApplication {
     GtkApplication parent;
     FsearchDatabase *db;
+    FsearchDatabaseMonitor *db_monitor;
+    // the rows new windows show until the first database is there, see fsearch_warm_start_load
+    FsearchWarmStart *warm_start;
     FsearchConfig *config;
     FsearchThreadPool *pool;
 
@@ -55,6 +61,13 @@ struct _FsearchApplication {
     guint file_manager_watch_id;
     bool has_file_manager_on_bus;
 
+    guint search_object_id;
+
+    // while fsearchd runs it keeps the database file up to date, which only gets loaded from then on
+    guint daemon_watch_id;
+    guint daemon_signal_id;
+    bool has_daemon_on_bus;
+
     FsearchDatabaseState db_state;
     guint db_timeout_id;
 
@@ -78,13 +91,20 @@ enum {
 
 typedef enum FsearchDatabaseActionType {
     FSEARCH_DATABASE_ACTION_SCAN,
+    // a scan which was started by the update timer and not by the user
+    FSEARCH_DATABASE_ACTION_SCHEDULED_SCAN,
+    // a scan of a single index, the others are carried over from the current database
+    FSEARCH_DATABASE_ACTION_SCAN_INDEX,
     FSEARCH_DATABASE_ACTION_LOAD,
     NUM_FSEARCH_DATABASE_ACTION_TYPES,
 } FsearchDatabaseActionType;
 
 typedef struct {
     FsearchDatabaseActionType action;
-    void (*update_func)(FsearchApplication *, FsearchDatabase *);
+    bool scheduled;
+    // the index which gets scanned by FSEARCH_DATABASE_ACTION_SCAN_INDEX
+    FsearchIndex *index;
+    void (*update_func)(FsearchApplication *, FsearchDatabase *, FsearchIndex *);
     void (*started_cb)(void *);
     void *started_cb_data;
     void (*finished_cb)(void *);
@@ -105,11 +125,25 @@ on_database_scan_enqueue(gpointer data);
 static void
 set_accels_for_escape(GApplication *app);
 
+static void
+database_scan_or_load_enqueue(FsearchDatabaseActionType action);
+
+static void
+database_scan_index_enqueue(FsearchIndex *index);
+
 static gboolean
 on_database_auto_update(gpointer user_data) {
     FsearchApplication *self = FSEARCH_APPLICATION(user_data);
+    if (!g_action_group_get_action_enabled(G_ACTION_GROUP(self), "update_database")) {
+        // another update is still running
+        return G_SOURCE_CONTINUE;
+    }
     g_debug("[app] scheduled database update started");
-    g_action_group_activate_action(G_ACTION_GROUP(self), "update_database", NULL);
+    GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(self));
+    if (self->has_daemon_on_bus && connection && fsearch_daemon_request_update(connection)) {
+        return G_SOURCE_CONTINUE;
+    }
+    database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_SCHEDULED_SCAN);
     return G_SOURCE_CONTINUE;
 }
 
@@ -169,6 +203,21 @@ prepare_windows_for_db_update(FsearchApplication *app) {
     }
 }
 
+static void
+on_database_monitor_overflow(gpointer user_data) {
+    // events got lost, only a rescan can bring the database up to date again
+    g_idle_add(on_database_scan_enqueue, NULL);
+}
+
+static void
+database_monitor_restart(FsearchApplication *self) {
+    g_clear_pointer(&self->db_monitor, fsearch_database_monitor_free);
+    if (self->config->monitor_filesystem && self->db) {
+        self->db_monitor =
+            fsearch_database_monitor_new(self->db, self->config->indexes, on_database_monitor_overflow, NULL);
+    }
+}
+
 static gboolean
 on_database_update_finished(gpointer user_data) {
     FsearchApplication *self = FSEARCH_APPLICATION_DEFAULT;
@@ -181,16 +230,20 @@ on_database_update_finished(gpointer user_data) {
     fsearch_application_state_lock(self);
     if (!g_cancellable_is_cancelled(self->db_thread_cancellable)) {
         prepare_windows_for_db_update(self);
-        g_clear_pointer(&self->db, db_unref);
+        // freeing the previous database can take a while, it's not needed for anything anymore
+        g_clear_pointer(&self->db, db_unref_in_background);
         self->db = g_steal_pointer(&db);
+        g_clear_pointer(&self->warm_start, fsearch_warm_start_unref);
     }
     else if (db) {
         g_clear_pointer(&db, db_unref);
     }
     g_cancellable_reset(self->db_thread_cancellable);
+    database_monitor_restart(self);
     self->num_database_update_active--;
     if (self->num_database_update_active == 0) {
         action_set_enabled("update_database", TRUE);
+        action_set_enabled("update_index", TRUE);
         action_set_enabled("cancel_update_database", FALSE);
     }
     fsearch_application_state_unlock(self);
@@ -234,37 +287,73 @@ database_scan_started_cb(gpointer user_data) {
 }
 
 static void
-database_scan_and_save(FsearchApplication *app, FsearchDatabase *db) {
-    const bool scan_successful =
-        db_scan(db, app->db_thread_cancellable, app->config->show_indexing_status ? database_notify_status_cb : NULL);
-    if (scan_successful && !g_cancellable_is_cancelled(app->db_thread_cancellable)) {
+database_scan_and_save(FsearchApplication *app, FsearchDatabase *db, FsearchIndex *index) {
+    fsearch_application_state_lock(app);
+    FsearchDatabase *old_db = db_ref(app->db);
+    // the database file belongs to fsearchd then
+    const bool save_database = !app->has_daemon_on_bus;
+    fsearch_application_state_unlock(app);
+
+    bool scan_successful = false;
+    if (old_db && index) {
+        // the other indexes are carried over without looking at the filesystem
+        scan_successful = db_rescan_index(db,
+                                          old_db,
+                                          index,
+                                          app->db_thread_cancellable,
+                                          app->config->show_indexing_status ? database_notify_status_cb : NULL);
+        g_clear_pointer(&old_db, db_unref);
+    }
+    else if (old_db) {
+        // only read folders again which changed since the current database was built
+        scan_successful = db_rescan(db,
+                                    old_db,
+                                    app->db_thread_cancellable,
+                                    app->config->show_indexing_status ? database_notify_status_cb : NULL);
+        g_clear_pointer(&old_db, db_unref);
+    }
+    else {
+        scan_successful = db_scan(db,
+                                  app->db_thread_cancellable,
+                                  app->config->show_indexing_status ? database_notify_status_cb : NULL);
+    }
+    if (scan_successful && save_database && !g_cancellable_is_cancelled(app->db_thread_cancellable)) {
         g_autofree gchar *db_path = fsearch_application_get_database_dir();
         if (db_path) {
-            if (app->config->show_indexing_status) {
-                database_notify_status_cb(_("Saving…"));
-            }
-            db_save(db, db_path);
+            // the file is written by a background thread, so the new database can be used right away
+            db_lock(db);
+            db_save_in_background(db, db_path);
+            db_unlock(db);
         }
     }
 }
 
 static void
-database_load(FsearchApplication *app, FsearchDatabase *db) {
+database_load(FsearchApplication *app, FsearchDatabase *db, FsearchIndex *index) {
     g_autofree char *db_file_path = fsearch_application_get_database_file_path();
     if (!db_file_path) {
         return;
     }
-    if (!db_load(db, db_file_path, app->config->show_indexing_status ? database_notify_status_cb : NULL)
-        && !app->config->update_database_on_launch) {
+    fsearch_application_state_lock(app);
+    // fsearchd writes the file then
+    const bool can_scan = !app->has_daemon_on_bus;
+    fsearch_application_state_unlock(app);
+    if (!db_load(db,
+                 db_file_path,
+                 app->db_thread_cancellable,
+                 app->config->show_indexing_status ? database_notify_status_cb : NULL)
+        && !app->config->update_database_on_launch && can_scan
+        && !g_cancellable_is_cancelled(app->db_thread_cancellable)) {
         // load failed -> trigger rescan
         g_idle_add(on_database_scan_enqueue, NULL);
     }
 }
 
 static void
-database_scan_or_load_enqueue(FsearchDatabaseActionType action) {
+database_update_enqueue(FsearchDatabaseActionType action, FsearchIndex *index) {
     FsearchApplication *app = FSEARCH_APPLICATION_DEFAULT;
     action_set_enabled("update_database", FALSE);
+    action_set_enabled("update_index", FALSE);
     action_set_enabled("cancel_update_database", TRUE);
 
     g_cancellable_reset(app->db_thread_cancellable);
@@ -273,8 +362,15 @@ database_scan_or_load_enqueue(FsearchDatabaseActionType action) {
     DatabaseUpdateContext *ctx = calloc(1, sizeof(DatabaseUpdateContext));
     g_assert(ctx);
 
+    ctx->scheduled = action == FSEARCH_DATABASE_ACTION_SCHEDULED_SCAN;
+    ctx->index = index ? fsearch_index_copy(index) : NULL;
     switch (action) {
+    case FSEARCH_DATABASE_ACTION_SCHEDULED_SCAN:
     case FSEARCH_DATABASE_ACTION_SCAN:
+    case FSEARCH_DATABASE_ACTION_SCAN_INDEX:
+        // The rescan carries over entries of the current database, so it must not be modified
+        // by the monitor in the meantime. The monitor gets restarted once the scan is finished.
+        g_clear_pointer(&app->db_monitor, fsearch_database_monitor_free);
         ctx->update_func = database_scan_and_save;
         ctx->started_cb = database_scan_started_cb;
         break;
@@ -292,6 +388,16 @@ database_scan_or_load_enqueue(FsearchDatabaseActionType action) {
     g_thread_pool_push(app->db_pool, g_steal_pointer(&ctx), NULL);
 }
 
+static void
+database_scan_or_load_enqueue(FsearchDatabaseActionType action) {
+    database_update_enqueue(action, NULL);
+}
+
+static void
+database_scan_index_enqueue(FsearchIndex *index) {
+    database_update_enqueue(FSEARCH_DATABASE_ACTION_SCAN_INDEX, index);
+}
+
 static gboolean
 on_database_scan_enqueue(gpointer data) {
     database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_SCAN);
@@ -312,13 +418,15 @@ database_pool_func(gpointer data, gpointer user_data) {
     g_timer_start(timer);
 
     fsearch_application_state_lock(app);
-    FsearchDatabase *db = db_new(app->config->indexes,
-                                 app->config->exclude_locations,
-                                 app->config->exclude_files,
-                                 app->config->exclude_hidden_items);
+    FsearchDatabase *db = fsearch_application_new_database(app->config);
+    db_set_read_only_file(db, app->has_daemon_on_bus);
+    if (ctx->scheduled) {
+        fsearch_application_throttle_scheduled_scan(db, app->config);
+    }
     fsearch_application_state_unlock(app);
 
-    ctx->update_func(app, db);
+    ctx->update_func(app, db, ctx->index);
+    g_clear_pointer(&ctx->index, fsearch_index_free);
 
     g_timer_stop(timer);
     const double seconds = g_timer_elapsed(timer, NULL);
@@ -467,7 +575,10 @@ on_preferences_ui_finished(FsearchConfig *new_config) {
     g_object_set(gtk_settings_get_default(), "gtk-application-prefer-dark-theme", new_config->enable_dark_theme, NULL);
     database_auto_update_init(app);
 
-    if (config_diff.database_config_changed) {
+    if (config_diff.changed_index) {
+        database_scan_index_enqueue(config_diff.changed_index);
+    }
+    else if (config_diff.database_config_changed) {
         database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_SCAN);
     }
 
@@ -508,9 +619,46 @@ action_cancel_update_database_activated(GSimpleAction *action, GVariant *paramet
 
 static void
 action_update_database_activated(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    FsearchApplication *self = FSEARCH_APPLICATION(user_data);
+    GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(self));
+    if (self->has_daemon_on_bus && connection && fsearch_daemon_request_update(connection)) {
+        // the new database gets loaded once fsearchd saved it
+        g_debug("[app] database update requested from fsearchd");
+        return;
+    }
     database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_SCAN);
 }
 
+// Rescans only the included location with the path given as parameter, e.g. with:
+// gapplication action io.github.cboxdoerfer.FSearch update_index "'/home/user/build'"
+static void
+action_update_index_activated(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    FsearchApplication *self = FSEARCH_APPLICATION(user_data);
+    const char *path = g_variant_get_string(parameter, NULL);
+    GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(self));
+    if (self->has_daemon_on_bus && connection && fsearch_daemon_request_update(connection)) {
+        g_debug("[app] database update requested from fsearchd");
+        return;
+    }
+    for (GList *l = self->config->indexes; l != NULL; l = l->next) {
+        FsearchIndex *index = l->data;
+        if (index->enabled && !g_strcmp0(index->path, path)) {
+            database_scan_index_enqueue(index);
+            return;
+        }
+    }
+    g_debug("[app] no enabled index with the path: %s", path);
+}
+
+// Also available over D-Bus, e.g. with: gapplication action io.github.cboxdoerfer.FSearch memory_usage
+static void
+action_memory_usage_activated(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    g_autofree char *report = fsearch_application_get_memory_usage_report(FSEARCH_APPLICATION_DEFAULT);
+    if (report) {
+        g_message("[memory_usage]\n%s", report);
+    }
+}
+
 static void
 action_new_window_activated(GSimpleAction *action, GVariant *parameter, gpointer app) {
     GtkWindow *window = GTK_WINDOW(fsearch_application_window_new(FSEARCH_APPLICATION(app)));
@@ -548,6 +696,14 @@ fsearch_application_shutdown(GApplication *app) {
         g_bus_unwatch_name(fsearch->file_manager_watch_id);
         fsearch->file_manager_watch_id = 0;
     }
+    if (fsearch->daemon_watch_id) {
+        g_bus_unwatch_name(fsearch->daemon_watch_id);
+        fsearch->daemon_watch_id = 0;
+    }
+    if (fsearch->daemon_signal_id) {
+        g_dbus_connection_signal_unsubscribe(g_application_get_dbus_connection(app), fsearch->daemon_signal_id);
+        fsearch->daemon_signal_id = 0;
+    }
 
     if (fsearch->db_pool) {
         g_debug("[app] waiting for database thread to exit...");
@@ -560,7 +716,11 @@ fsearch_application_shutdown(GApplication *app) {
     // close the preview
     fsearch_preview_call_close();
 
-    g_clear_pointer(&fsearch->db, db_unref);
+    g_clear_pointer(&fsearch->db_monitor, fsearch_database_monitor_free);
+    // don't exit before the database file is complete
+    db_save_wait_for_background_saves();
+    g_clear_pointer(&fsearch->db, db_unref_on_exit);
+    g_clear_pointer(&fsearch->warm_start, fsearch_warm_start_unref);
     g_clear_object(&fsearch->db_thread_cancellable);
 
     g_clear_pointer(&fsearch->option_search_term, g_free);
@@ -592,6 +752,52 @@ on_file_manager_name_vanished(GDBusConnection *connection, const gchar *name, gp
     app->has_file_manager_on_bus = false;
 }
 
+static void
+on_daemon_database_changed(GDBusConnection *connection,
+                           const gchar *sender_name,
+                           const gchar *object_path,
+                           const gchar *interface_name,
+                           const gchar *signal_name,
+                           GVariant *parameters,
+                           gpointer user_data) {
+    g_debug("[app] fsearchd saved a new database");
+    database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_LOAD);
+}
+
+static void
+on_daemon_name_appeared(GDBusConnection *connection, const gchar *name, const gchar *name_owner, gpointer user_data) {
+    FsearchApplication *app = FSEARCH_APPLICATION_DEFAULT;
+    g_return_if_fail(app);
+    fsearch_application_state_lock(app);
+    app->has_daemon_on_bus = true;
+    fsearch_application_state_unlock(app);
+    if (!app->daemon_signal_id) {
+        app->daemon_signal_id = g_dbus_connection_signal_subscribe(connection,
+                                                                   FSEARCH_DAEMON_BUS_NAME,
+                                                                   FSEARCH_DAEMON_INTERFACE,
+                                                                   FSEARCH_DAEMON_SIGNAL_DATABASE_CHANGED,
+                                                                   FSEARCH_DAEMON_OBJECT_PATH,
+                                                                   NULL,
+                                                                   G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                   on_daemon_database_changed,
+                                                                   NULL,
+                                                                   NULL);
+    }
+}
+
+static void
+on_daemon_name_vanished(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+    FsearchApplication *app = FSEARCH_APPLICATION_DEFAULT;
+    g_return_if_fail(app);
+    fsearch_application_state_lock(app);
+    app->has_daemon_on_bus = false;
+    fsearch_application_state_unlock(app);
+    if (app->daemon_signal_id && connection) {
+        g_dbus_connection_signal_unsubscribe(connection, app->daemon_signal_id);
+    }
+    app->daemon_signal_id = 0;
+}
+
 static void
 set_accel_for_action(GApplication *app, const char *action, const char *accel) {
     gtk_application_set_accels_for_action(GTK_APPLICATION(app), action, (const gchar *const[]){accel, NULL});
@@ -638,6 +844,9 @@ fsearch_application_startup(GApplication *app) {
     }
     fsearch->db = NULL;
     fsearch->db_state = FSEARCH_DATABASE_STATE_IDLE;
+    // it's small enough to be read right away, so the first window can show it while the database loads
+    g_autofree char *warm_start_path = fsearch_application_get_warm_start_file_path();
+    fsearch->warm_start = fsearch_warm_start_load(warm_start_path);
 
     fsearch->file_manager_watch_id = g_bus_watch_name(G_BUS_TYPE_SESSION,
                                                       "org.freedesktop.FileManager1",
@@ -647,6 +856,17 @@ fsearch_application_startup(GApplication *app) {
                                                       NULL,
                                                       NULL);
 
+    // activate decides whether to scan before the watch reports the daemon for the first time
+    GDBusConnection *connection = g_application_get_dbus_connection(app);
+    fsearch->has_daemon_on_bus = connection && fsearch_daemon_is_running(connection);
+    fsearch->daemon_watch_id = g_bus_watch_name(G_BUS_TYPE_SESSION,
+                                                FSEARCH_DAEMON_BUS_NAME,
+                                                G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                on_daemon_name_appeared,
+                                                on_daemon_name_vanished,
+                                                NULL,
+                                                NULL);
+
     g_autoptr(GtkCssProvider) provider = gtk_css_provider_new();
     gtk_css_provider_load_from_resource(provider, "/io/github/cboxdoerfer/fsearch/ui/shared.css");
     gtk_style_context_add_provider_for_screen(gdk_screen_get_default(),
@@ -694,7 +914,9 @@ static GActionEntry fsearch_app_entries[] = {
     {"bug_report", action_bug_report_activated, NULL, NULL, NULL},
     {"forum", action_forum_activated, NULL, NULL, NULL},
     {"update_database", action_update_database_activated, NULL, NULL, NULL},
+    {"update_index", action_update_index_activated, "s", NULL, NULL},
     {"cancel_update_database", action_cancel_update_database_activated, NULL, NULL, NULL},
+    {"memory_usage", action_memory_usage_activated, NULL, NULL, NULL},
     {"preferences", action_preferences_activated, "u", NULL, NULL},
     {"quit", action_quit_activated, NULL, NULL, NULL}};
 
@@ -726,7 +948,8 @@ fsearch_application_activate(GApplication *app) {
 
     g_cancellable_reset(self->db_thread_cancellable);
     database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_LOAD);
-    if (self->config->update_database_on_launch) {
+    // fsearchd scans on its own
+    if (self->config->update_database_on_launch && !self->has_daemon_on_bus) {
         database_scan_or_load_enqueue(FSEARCH_DATABASE_ACTION_SCAN);
     }
 }
@@ -846,14 +1069,15 @@ database_scan_in_local_instance() {
     g_autoptr(GTimer) timer = g_timer_new();
     g_timer_start(timer);
 
-    FsearchDatabase *db =
-        db_new(config->indexes, config->exclude_locations, config->exclude_files, config->exclude_hidden_items);
+    FsearchDatabase *db = fsearch_application_new_database(config);
 
     int res = EXIT_FAILURE;
     if (db_scan(db, NULL, NULL)) {
         g_autofree char *db_path = fsearch_application_get_database_dir();
         if (db_path) {
-            res = db_save(db, db_path) ? EXIT_SUCCESS : EXIT_FAILURE;
+            db_lock(db);
+            res = db_save(db, db_path, NULL, NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+            db_unlock(db);
         }
     }
 
@@ -894,10 +1118,14 @@ fsearch_application_local_database_scan() {
         // triggered update in primary instance, we're done here
         return 0;
     }
-    else {
-        // no primary instance found, perform update
-        return database_scan_in_local_instance();
+    g_autoptr(GDBusConnection) connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    if (connection && fsearch_daemon_request_update(connection)) {
+        // fsearchd owns the database file, so it mustn't be written here at the same time
+        g_print("[fsearch] database update requested from fsearchd\n");
+        return 0;
     }
+    // no primary instance found, perform update
+    return database_scan_in_local_instance();
 }
 
 static gint
@@ -905,6 +1133,9 @@ fsearch_application_handle_local_options(GApplication *application, GVariantDict
     if (g_variant_dict_contains(options, "update-database")) {
         return fsearch_application_local_database_scan();
     }
+    if (g_variant_dict_contains(options, "print")) {
+        return fsearch_cli_print_search_results(options, fsearch_bus_name, fsearch_object_path);
+    }
     if (g_variant_dict_contains(options, "version")) {
         g_autoptr(GString) version = get_application_version();
         g_print("FSearch %s\n", version->str);
@@ -917,9 +1148,15 @@ fsearch_application_handle_local_options(GApplication *application, GVariantDict
 static void
 fsearch_application_add_option_entries(FsearchApplication *self) {
     static const GOptionEntry main_entries[] = {
+        {"filter", 0, 0, G_OPTION_ARG_STRING, NULL, N_("Apply the filter NAME to the printed results"), "NAME"},
+        {"group-by", 0, 0, G_OPTION_ARG_STRING, NULL, N_("Print the count and size of the results per KEY"), "KEY"},
+        {"limit", 0, 0, G_OPTION_ARG_INT, NULL, N_("Print at most N results"), "N"},
         {"new-window", 0, 0, G_OPTION_ARG_NONE, NULL, N_("Open a new application window")},
+        {"null", '0', 0, G_OPTION_ARG_NONE, NULL, N_("Separate the printed results by NUL characters")},
         {"preferences", 0, 0, G_OPTION_ARG_NONE, NULL, N_("Show the application preferences")},
+        {"print", 'p', 0, G_OPTION_ARG_NONE, NULL, N_("Print the results of the search pattern and exit")},
         {"search", 's', 0, G_OPTION_ARG_STRING, NULL, N_("Set the search pattern"), "PATTERN"},
+        {"sort", 0, 0, G_OPTION_ARG_STRING, NULL, N_("Sort the printed results by ORDER"), "ORDER"},
         {"update-database", 'u', 0, G_OPTION_ARG_NONE, NULL, N_("Update the database and exit")},
         {"version", 'v', 0, G_OPTION_ARG_NONE, NULL, N_("Print version information and exit")},
         {NULL}};
@@ -929,6 +1166,43 @@ fsearch_application_add_option_entries(FsearchApplication *self) {
     g_application_add_main_option_entries(G_APPLICATION(self), main_entries);
 }
 
+static FsearchDatabase *
+search_source_get_db(gpointer user_data) {
+    return fsearch_application_get_db(FSEARCH_APPLICATION(user_data));
+}
+
+static FsearchConfig *
+search_source_get_config(gpointer user_data) {
+    return fsearch_application_get_config(FSEARCH_APPLICATION(user_data));
+}
+
+static gboolean
+fsearch_application_dbus_register(GApplication *application,
+                                  GDBusConnection *connection,
+                                  const gchar *object_path,
+                                  GError **error) {
+    GApplicationClass *parent_class = G_APPLICATION_CLASS(fsearch_application_parent_class);
+    if (!parent_class->dbus_register(application, connection, object_path, error)) {
+        return FALSE;
+    }
+    FsearchApplication *self = FSEARCH_APPLICATION(application);
+    const FsearchCliSearchSource source = {search_source_get_db, search_source_get_config};
+    self->search_object_id = fsearch_cli_register_search_object(connection, object_path, &source, self, error);
+    return self->search_object_id != 0;
+}
+
+static void
+fsearch_application_dbus_unregister(GApplication *application,
+                                    GDBusConnection *connection,
+                                    const gchar *object_path) {
+    FsearchApplication *self = FSEARCH_APPLICATION(application);
+    if (self->search_object_id) {
+        g_dbus_connection_unregister_object(connection, self->search_object_id);
+        self->search_object_id = 0;
+    }
+    G_APPLICATION_CLASS(fsearch_application_parent_class)->dbus_unregister(application, connection, object_path);
+}
+
 static void
 fsearch_application_win_added(GtkApplication *app, GtkWindow *win) {
     GTK_APPLICATION_CLASS(fsearch_application_parent_class)->window_added(app, win);
@@ -954,6 +1228,8 @@ fsearch_application_class_init(FsearchApplicationClass *klass) {
     g_app_class->shutdown = fsearch_application_shutdown;
     g_app_class->command_line = fsearch_application_command_line;
     g_app_class->handle_local_options = fsearch_application_handle_local_options;
+    g_app_class->dbus_register = fsearch_application_dbus_register;
+    g_app_class->dbus_unregister = fsearch_application_dbus_unregister;
 
     gtk_app_class->window_added = fsearch_application_win_added;
     gtk_app_class->window_removed = fsearch_application_win_removed;
@@ -1020,6 +1296,25 @@ fsearch_application_get_db(FsearchApplication *fsearch) {
     return db_ref(fsearch->db);
 }
 
+FsearchWarmStart *
+fsearch_application_get_warm_start(FsearchApplication *fsearch) {
+    g_assert(FSEARCH_IS_APPLICATION(fsearch));
+    return fsearch_warm_start_ref(fsearch->warm_start);
+}
+
+char *
+fsearch_application_get_memory_usage_report(FsearchApplication *fsearch) {
+    g_assert(FSEARCH_IS_APPLICATION(fsearch));
+    FsearchDatabase *db = fsearch_application_get_db(fsearch);
+    if (!db) {
+        return NULL;
+    }
+    FsearchDatabaseMemoryUsage usage = {};
+    db_get_memory_usage(db, &usage);
+    g_clear_pointer(&db, db_unref);
+    return db_memory_usage_to_string(&usage);
+}
+
 FsearchConfig *
 fsearch_application_get_config(FsearchApplication *fsearch) {
     g_assert(FSEARCH_IS_APPLICATION(fsearch));
@@ -1037,6 +1332,17 @@ fsearch_application_get_database_file_path() {
     return g_string_free(file_path, FALSE);
 }
 
+char *
+fsearch_application_get_warm_start_file_path() {
+    GString *file_path = g_string_new(g_get_user_data_dir());
+    g_string_append_c(file_path, G_DIR_SEPARATOR);
+    g_string_append(file_path, "fsearch");
+    g_string_append_c(file_path, G_DIR_SEPARATOR);
+    g_string_append(file_path, "warm_start");
+
+    return g_string_free(file_path, FALSE);
+}
+
 char *
 fsearch_application_get_database_dir() {
     GString *db_dir = g_string_new(g_get_user_data_dir());
@@ -1045,6 +1351,49 @@ fsearch_application_get_database_dir() {
     return g_string_free(db_dir, FALSE);
 }
 
+FsearchDatabase *
+fsearch_application_new_database(FsearchConfig *config) {
+    g_assert(config);
+    FsearchDatabase *db =
+        db_new(config->indexes, config->exclude_locations, config->exclude_files, config->exclude_hidden_items);
+    db_set_num_scan_threads(db, config->scan_threads);
+    db_set_worker_threads(db, config->worker_threads, config->worker_cpu_list, config->numa_aware);
+    db_set_huge_pages(db, config->huge_pages);
+    db_set_optional_times(db,
+                          (config->index_access_time ? DATABASE_INDEX_FLAG_ACCESS_TIME : 0)
+                              | (config->index_creation_time ? DATABASE_INDEX_FLAG_CREATION_TIME : 0)
+                              | (config->index_status_change_time ? DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME : 0));
+    db_set_index_owners(db, config->index_owners);
+    db_set_xattrs(db, config->xattr_names, config->xattr_paths);
+    db_set_memory_budget(db, (size_t)config->memory_budget * 1024 * 1024);
+    db_set_front_coded_names(db, config->front_coded_names);
+    db_set_compact_indexes(db, config->compact_indexes);
+    if (config->restore_sort_order && config->sort_by) {
+        // the windows restore that order, so its sorted array is the first one built after scanning
+        db_set_index_priority(db, db_index_type_from_name(config->sort_by));
+    }
+    db_set_trigram_indexes(db, config->trigram_index);
+    db_set_name_indexes(db, config->name_index);
+    db_set_folder_path_cache(db, config->folder_path_cache);
+    db_set_folded_name_cache(db, config->folded_name_cache);
+    db_set_subtree_filters(db, config->subtree_filters);
+    db_set_compression(db, config->database_compression);
+    return db;
+}
+
+void
+fsearch_application_throttle_scheduled_scan(FsearchDatabase *db, FsearchConfig *config) {
+    g_assert(db);
+    g_assert(config);
+    if (!config->throttle_scheduled_updates) {
+        return;
+    }
+    FsearchScanThrottle *throttle =
+        fsearch_scan_throttle_new(config->scheduled_update_max_ops, config->scheduled_update_max_kib);
+    db_set_scan_throttle(db, throttle);
+    g_clear_pointer(&throttle, fsearch_scan_throttle_unref);
+}
+
 gboolean
 fsearch_application_has_file_manager_on_bus(FsearchApplication *fsearch) {
     g_assert(FSEARCH_IS_APPLICATION(fsearch));
@@ -21,6 +21,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "fsearch_config.h"
 #include "fsearch_database.h"
 #include "fsearch_thread_pool.h"
+#include "fsearch_warm_start.h"
 #include <glib.h>
 #include <gtk/gtk.h>
 #include <inttypes.h>
@@ -54,6 +55,14 @@ fsearch_application_get_num_db_entries(FsearchApplication *fsearch);
 FsearchDatabase *
 fsearch_application_get_db(FsearchApplication *fsearch);
 
+// Returns the rows of the last launch, NULL once a database is there or if there are none
+FsearchWarmStart *
+fsearch_application_get_warm_start(FsearchApplication *fsearch);
+
+// Returns a report of the memory used by the current database and its views, NULL if there's no database yet
+char *
+fsearch_application_get_memory_usage_report(FsearchApplication *fsearch);
+
 FsearchConfig *
 fsearch_application_get_config(FsearchApplication *fsearch);
 
@@ -69,5 +78,16 @@ fsearch_application_get_database_file_path(void);
 char *
 fsearch_application_get_database_dir(void);
 
+char *
+fsearch_application_get_warm_start_file_path(void);
+
+// Returns a new database without entries, which uses the locations and database settings of config
+FsearchDatabase *
+fsearch_application_new_database(FsearchConfig *config);
+
+// Paces the scans of db as configured for scheduled updates, does nothing if they aren't throttled
+void
+fsearch_application_throttle_scheduled_scan(FsearchDatabase *db, FsearchConfig *config);
+
 gboolean
 fsearch_application_has_file_manager_on_bus(FsearchApplication *fsearch);
@@ -0,0 +1,269 @@
+#define G_LOG_DOMAIN "fsearch-aggregate"
+
+#include "fsearch_aggregate.h"
+#include "fsearch_database_entry.h"
+
+#include <glib.h>
+#include <pwd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// the entries are handed out to the threads in blocks of this many entries
+#define AGGREGATE_BLOCK_SIZE (1 << 14)
+
+typedef struct {
+    uint64_t num_entries;
+    uint64_t size;
+} AggregateSums;
+
+typedef struct {
+    DynamicArray *entries;
+    uint32_t num_entries;
+    FsearchAggregateKey key;
+    uint32_t depth;
+    FsearchThreadPoolRanges *blocks;
+} AggregateContext;
+
+typedef struct {
+    AggregateContext *ctx;
+    // the keys of the groups to their AggregateSums
+    GHashTable *groups;
+} AggregateWorker;
+
+bool
+fsearch_aggregate_key_parse(const char *text, FsearchAggregateKey *key, uint32_t *depth) {
+    g_assert(key);
+    g_assert(depth);
+    if (!text) {
+        return false;
+    }
+    *depth = 0;
+    if (!strcmp(text, "extension")) {
+        *key = FSEARCH_AGGREGATE_BY_EXTENSION;
+        return true;
+    }
+    if (!strcmp(text, "owner")) {
+        *key = FSEARCH_AGGREGATE_BY_OWNER;
+        return true;
+    }
+    if (!strcmp(text, "folder")) {
+        *key = FSEARCH_AGGREGATE_BY_FOLDER;
+        *depth = 1;
+        return true;
+    }
+    if (!g_str_has_prefix(text, "folder:") || !g_ascii_isdigit(text[strlen("folder:")])) {
+        return false;
+    }
+    char *end = NULL;
+    const guint64 value = g_ascii_strtoull(text + strlen("folder:"), &end, 10);
+    if (*end != '\0' || value > UINT16_MAX) {
+        return false;
+    }
+    *key = FSEARCH_AGGREGATE_BY_FOLDER;
+    *depth = (uint32_t)value;
+    return true;
+}
+
+static GHashTable *
+aggregate_groups_new(FsearchAggregateKey key) {
+    if (key == FSEARCH_AGGREGATE_BY_EXTENSION) {
+        // the extensions point into names which might only be decoded for a moment, so the groups keep copies
+        return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+    return g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+}
+
+// Entries in folders above depth are grouped by their own folder
+static FsearchDatabaseEntry *
+get_folder_at_depth(FsearchDatabaseEntry *entry, uint32_t depth) {
+    FsearchDatabaseEntry *folder = (FsearchDatabaseEntry *)db_entry_get_parent(entry);
+    while (folder && db_entry_get_depth(folder) > depth) {
+        folder = (FsearchDatabaseEntry *)db_entry_get_parent(folder);
+    }
+    return folder;
+}
+
+static AggregateSums *
+aggregate_get_sums(AggregateWorker *worker, FsearchDatabaseEntry *entry) {
+    const char *extension = NULL;
+    gpointer key = NULL;
+    switch (worker->ctx->key) {
+    case FSEARCH_AGGREGATE_BY_EXTENSION:
+        extension = db_entry_get_extension(entry);
+        key = (gpointer)(extension ? extension : "");
+        break;
+    case FSEARCH_AGGREGATE_BY_FOLDER:
+        key = get_folder_at_depth(entry, worker->ctx->depth);
+        break;
+    case FSEARCH_AGGREGATE_BY_OWNER: {
+        // 0 stands for entries without an owner
+        uint32_t uid = 0;
+        key = db_entry_get_uid(entry, &uid) ? GSIZE_TO_POINTER((gsize)uid + 1) : NULL;
+        break;
+    }
+    default:
+        g_assert_not_reached();
+    }
+
+    AggregateSums *sums = g_hash_table_lookup(worker->groups, key);
+    if (!sums) {
+        sums = g_new0(AggregateSums, 1);
+        if (worker->ctx->key == FSEARCH_AGGREGATE_BY_EXTENSION) {
+            key = g_strdup(key);
+        }
+        g_hash_table_insert(worker->groups, key, sums);
+    }
+    return sums;
+}
+
+static void
+aggregate_worker(void *data) {
+    AggregateWorker *worker = data;
+    AggregateContext *ctx = worker->ctx;
+    uint32_t block = 0;
+    while (fsearch_thread_pool_ranges_next(ctx->blocks, &block)) {
+        const uint32_t start = block * AGGREGATE_BLOCK_SIZE;
+        const uint32_t end = MIN(start + AGGREGATE_BLOCK_SIZE, ctx->num_entries);
+        for (uint32_t i = start; i < end; i++) {
+            FsearchDatabaseEntry *entry = darray_get_item(ctx->entries, i);
+            if (!entry || db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER) {
+                continue;
+            }
+            AggregateSums *sums = aggregate_get_sums(worker, entry);
+            sums->num_entries++;
+            sums->size += (uint64_t)MAX(db_entry_get_size(entry), 0);
+        }
+    }
+}
+
+// Adds the groups of other to groups, other is left empty
+static void
+aggregate_groups_merge(GHashTable *groups, GHashTable *other) {
+    GHashTableIter iter;
+    gpointer key = NULL;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, other);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        AggregateSums *other_sums = value;
+        AggregateSums *sums = g_hash_table_lookup(groups, key);
+        if (sums) {
+            sums->num_entries += other_sums->num_entries;
+            sums->size += other_sums->size;
+            continue;
+        }
+        // the key and sums move over to groups
+        g_hash_table_iter_steal(&iter);
+        g_hash_table_insert(groups, key, other_sums);
+    }
+}
+
+static char *
+get_owner_name(gpointer key) {
+    if (!key) {
+        return g_strdup("-");
+    }
+    const uid_t uid = (uid_t)(GPOINTER_TO_SIZE(key) - 1);
+    const long buffer_size = sysconf(_SC_GETPW_R_SIZE_MAX);
+    g_autofree char *buffer = g_malloc(buffer_size > 0 ? (size_t)buffer_size : 16384);
+    struct passwd pw;
+    struct passwd *res = NULL;
+    if (getpwuid_r(uid, &pw, buffer, buffer_size > 0 ? (size_t)buffer_size : 16384, &res) == 0 && res) {
+        return g_strdup(res->pw_name);
+    }
+    return g_strdup_printf("%u", (uint32_t)uid);
+}
+
+static char *
+get_group_name(FsearchAggregateKey key, gpointer group_key, FsearchFolderPaths *folder_paths) {
+    switch (key) {
+    case FSEARCH_AGGREGATE_BY_EXTENSION:
+        return g_strdup(group_key);
+    case FSEARCH_AGGREGATE_BY_FOLDER: {
+        if (!group_key) {
+            return g_strdup("");
+        }
+        GString *path = g_string_new(NULL);
+        fsearch_folder_paths_append_full_path(folder_paths, group_key, path);
+        return g_string_free(path, FALSE);
+    }
+    case FSEARCH_AGGREGATE_BY_OWNER:
+        return get_owner_name(group_key);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static gint
+compare_groups(gconstpointer a, gconstpointer b) {
+    const FsearchAggregateGroup *group_a = a;
+    const FsearchAggregateGroup *group_b = b;
+    if (group_a->size != group_b->size) {
+        return group_a->size > group_b->size ? -1 : 1;
+    }
+    if (group_a->num_entries != group_b->num_entries) {
+        return group_a->num_entries > group_b->num_entries ? -1 : 1;
+    }
+    return strcmp(group_a->name, group_b->name);
+}
+
+static void
+group_clear(gpointer data) {
+    FsearchAggregateGroup *group = data;
+    g_clear_pointer(&group->name, g_free);
+}
+
+GArray *
+fsearch_aggregate_entries(DynamicArray *entries,
+                          FsearchAggregateKey key,
+                          uint32_t depth,
+                          FsearchFolderPaths *folder_paths,
+                          FsearchThreadPool *pool) {
+    AggregateContext ctx = {
+        .entries = entries,
+        .num_entries = entries ? darray_get_num_items(entries) : 0,
+        .key = key,
+        .depth = depth,
+    };
+    uint32_t num_blocks = (ctx.num_entries + AGGREGATE_BLOCK_SIZE - 1) / AGGREGATE_BLOCK_SIZE;
+    const uint32_t num_threads = pool ? fsearch_thread_pool_get_num_threads(pool) : 1;
+    const uint32_t num_workers = CLAMP(num_blocks, 1, num_threads);
+
+    AggregateWorker workers[num_workers];
+    for (uint32_t i = 0; i < num_workers; i++) {
+        workers[i].ctx = &ctx;
+        workers[i].groups = aggregate_groups_new(key);
+    }
+    ctx.blocks = fsearch_thread_pool_ranges_new(num_workers > 1 ? pool : NULL, &num_blocks, 1);
+    fsearch_thread_pool_run(num_workers > 1 ? pool : NULL,
+                            aggregate_worker,
+                            workers,
+                            sizeof(AggregateWorker),
+                            num_workers);
+    g_clear_pointer(&ctx.blocks, fsearch_thread_pool_ranges_free);
+
+    GHashTable *groups = workers[0].groups;
+    for (uint32_t i = 1; i < num_workers; i++) {
+        aggregate_groups_merge(groups, workers[i].groups);
+        g_clear_pointer(&workers[i].groups, g_hash_table_unref);
+    }
+
+    GArray *result = g_array_sized_new(FALSE, FALSE, sizeof(FsearchAggregateGroup), g_hash_table_size(groups));
+    g_array_set_clear_func(result, group_clear);
+    GHashTableIter iter;
+    gpointer group_key = NULL;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, groups);
+    while (g_hash_table_iter_next(&iter, &group_key, &value)) {
+        AggregateSums *sums = value;
+        FsearchAggregateGroup group = {
+            .name = get_group_name(key, group_key, folder_paths),
+            .num_entries = sums->num_entries,
+            .size = sums->size,
+        };
+        g_array_append_val(result, group);
+    }
+    g_clear_pointer(&groups, g_hash_table_unref);
+    g_array_sort(result, compare_groups);
+    return result;
+}
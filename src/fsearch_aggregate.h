@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_folder_paths.h"
+#include "fsearch_thread_pool.h"
+
+// What the entries of an aggregate query (e.g. fsearch --print --group-by=extension) are grouped by
+typedef enum {
+    FSEARCH_AGGREGATE_BY_EXTENSION,
+    // the folder at a given depth the entries are in, depth 0 is the root of their index
+    FSEARCH_AGGREGATE_BY_FOLDER,
+    FSEARCH_AGGREGATE_BY_OWNER,
+} FsearchAggregateKey;
+
+typedef struct {
+    // the extension (empty for files without one), the full path of the folder or the name of the owner (its uid
+    // if it has no name, "-" if the owner isn't indexed)
+    char *name;
+    uint64_t num_entries;
+    uint64_t size;
+} FsearchAggregateGroup;
+
+// Parses "extension", "owner", "folder" or "folder:N", "folder" stands for the folders right below the roots of the
+// indexes (depth 1). Returns false if text is none of them.
+bool
+fsearch_aggregate_key_parse(const char *text, FsearchAggregateKey *key, uint32_t *depth);
+
+// Counts the entries of every group and sums up their sizes. Every thread of pool (if it's not NULL) aggregates
+// ranges of the entries into groups of its own, which get merged at the end. Folders are left out: their sizes are
+// the sums of their contents already, so they'd be counted twice.
+//
+// Returns an array of FsearchAggregateGroup, the largest groups first. Freeing it frees the names as well.
+GArray *
+fsearch_aggregate_entries(DynamicArray *entries,
+                          FsearchAggregateKey key,
+                          uint32_t depth,
+                          FsearchFolderPaths *folder_paths,
+                          FsearchThreadPool *pool);
@@ -0,0 +1,133 @@
+#define G_LOG_DOMAIN "fsearch-aho-corasick"
+
+#include "fsearch_aho_corasick.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct FsearchAhoCorasick {
+    // maps every byte of the haystack to its class, bytes which aren't part of any pattern share class 0
+    uint16_t byte_classes[256];
+    uint32_t num_classes;
+    // transitions[state * num_classes + class] is the state after reading a byte of class in state
+    uint32_t *transitions;
+    // set if a pattern ends in the state (or in one of its suffixes)
+    bool *is_match;
+    uint32_t num_states;
+};
+
+static uint8_t
+fold_byte(uint8_t c, bool ignore_case) {
+    return ignore_case ? (uint8_t)g_ascii_tolower(c) : c;
+}
+
+FsearchAhoCorasick *
+fsearch_aho_corasick_new(const char **patterns, uint32_t num_patterns, bool ignore_case) {
+    g_assert(patterns || num_patterns == 0);
+
+    FsearchAhoCorasick *ac = calloc(1, sizeof(FsearchAhoCorasick));
+    g_assert(ac);
+
+    size_t max_states = 1;
+    ac->num_classes = 1;
+    for (uint32_t i = 0; i < num_patterns; i++) {
+        for (const char *s = patterns[i]; *s != '\0'; s++) {
+            const uint8_t c = fold_byte((uint8_t)*s, ignore_case);
+            if (ac->byte_classes[c] == 0) {
+                ac->byte_classes[c] = (uint16_t)ac->num_classes++;
+            }
+            max_states++;
+        }
+    }
+    if (ignore_case) {
+        for (uint32_t c = 'A'; c <= 'Z'; c++) {
+            ac->byte_classes[c] = ac->byte_classes[(uint8_t)g_ascii_tolower(c)];
+        }
+    }
+
+    // Build the trie, 0 (the root) marks missing transitions until the failure links are known
+    const uint32_t num_classes = ac->num_classes;
+    ac->transitions = calloc(max_states * num_classes, sizeof(uint32_t));
+    g_assert(ac->transitions);
+    ac->is_match = calloc(max_states, sizeof(bool));
+    g_assert(ac->is_match);
+    ac->num_states = 1;
+    for (uint32_t i = 0; i < num_patterns; i++) {
+        uint32_t state = 0;
+        for (const char *s = patterns[i]; *s != '\0'; s++) {
+            uint32_t *next = &ac->transitions[state * num_classes + ac->byte_classes[(uint8_t)*s]];
+            if (*next == 0) {
+                *next = ac->num_states++;
+            }
+            state = *next;
+        }
+        ac->is_match[state] = true;
+    }
+
+    // Turn the trie into the automaton in breadth first order, so the failure link of every state (the state
+    // of its longest proper suffix which is in the trie) is complete before its children get visited
+    uint32_t *failure = calloc(ac->num_states, sizeof(uint32_t));
+    g_assert(failure);
+    uint32_t *queue = calloc(ac->num_states, sizeof(uint32_t));
+    g_assert(queue);
+    uint32_t queue_start = 0;
+    uint32_t queue_end = 0;
+    for (uint32_t c = 0; c < num_classes; c++) {
+        const uint32_t child = ac->transitions[c];
+        if (child != 0) {
+            failure[child] = 0;
+            queue[queue_end++] = child;
+        }
+    }
+    while (queue_start < queue_end) {
+        const uint32_t state = queue[queue_start++];
+        if (ac->is_match[failure[state]]) {
+            ac->is_match[state] = true;
+        }
+        for (uint32_t c = 0; c < num_classes; c++) {
+            uint32_t *next = &ac->transitions[state * num_classes + c];
+            const uint32_t fallback = ac->transitions[failure[state] * num_classes + c];
+            if (*next == 0) {
+                *next = fallback;
+            }
+            else {
+                failure[*next] = fallback;
+                queue[queue_end++] = *next;
+            }
+        }
+    }
+    g_clear_pointer(&queue, free);
+    g_clear_pointer(&failure, free);
+
+    return ac;
+}
+
+void
+fsearch_aho_corasick_free(FsearchAhoCorasick *ac) {
+    if (!ac) {
+        return;
+    }
+    g_clear_pointer(&ac->transitions, free);
+    g_clear_pointer(&ac->is_match, free);
+    g_clear_pointer(&ac, free);
+}
+
+bool
+fsearch_aho_corasick_contains_any(const FsearchAhoCorasick *ac, const char *haystack, size_t haystack_len) {
+    g_assert(ac);
+    if (ac->is_match[0]) {
+        // there's an empty pattern
+        return true;
+    }
+    const uint32_t *transitions = ac->transitions;
+    const uint32_t num_classes = ac->num_classes;
+    uint32_t state = 0;
+    for (size_t i = 0; i < haystack_len; i++) {
+        state = transitions[state * num_classes + ac->byte_classes[(uint8_t)haystack[i]]];
+        if (ac->is_match[state]) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A set of patterns compiled into an Aho-Corasick automaton, which finds out whether a haystack contains
+// any of them in a single pass over the haystack, no matter how many patterns there are. The automaton is
+// a complete transition table over the classes of bytes which are used by the patterns, so every byte of
+// the haystack costs a single table lookup.
+typedef struct FsearchAhoCorasick FsearchAhoCorasick;
+
+// If ignore_case is set, ASCII letters match regardless of their case, all other bytes must match exactly.
+FsearchAhoCorasick *
+fsearch_aho_corasick_new(const char **patterns, uint32_t num_patterns, bool ignore_case);
+
+void
+fsearch_aho_corasick_free(FsearchAhoCorasick *ac);
+
+// Returns true if haystack contains at least one of the patterns, it doesn't need to be NUL terminated
+bool
+fsearch_aho_corasick_contains_any(const FsearchAhoCorasick *ac, const char *haystack, size_t haystack_len);
@@ -19,13 +19,13 @@
 #define G_LOG_DOMAIN "fsearch-dynamic-array"
 
 #include "fsearch_array.h"
+#include "fsearch_trace.h"
+
 #include <glib.h>
-#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 
-#define MAX_SORT_THREADS 8
 
 struct DynamicArray {
     // number of items in array
@@ -35,9 +35,47 @@ struct DynamicArray {
     // data
     void **data;
 
+    // Compact arrays don't store the items themselves, but their positions in base
+    // (in which case data is NULL). That needs only half the memory on 64-bit systems.
+    DynamicArray *base;
+    uint32_t *indices;
+
+    // data derived from the content of the array, dropped whenever the content changes
+    void *user_data;
+    GDestroyNotify user_data_destroy_func;
+
     volatile int ref_count;
 };
 
+static void
+darray_clear_user_data(DynamicArray *array) {
+    void *user_data = g_steal_pointer(&array->user_data);
+    GDestroyNotify destroy_func = g_steal_pointer(&array->user_data_destroy_func);
+    if (user_data && destroy_func) {
+        destroy_func(user_data);
+    }
+}
+
+static inline void *
+darray_get_item_unchecked(DynamicArray *array, uint32_t idx) {
+    return array->indices ? array->base->data[array->indices[idx]] : array->data[idx];
+}
+
+// Turns a compact array back into a regular one, which is required before its content can be modified
+static void
+darray_uncompact(DynamicArray *array) {
+    if (!array->indices) {
+        return;
+    }
+    array->data = calloc(array->max_items + 1, sizeof(void *));
+    g_assert(array->data);
+    for (uint32_t i = 0; i < array->num_items; i++) {
+        array->data[i] = array->base->data[array->indices[i]];
+    }
+    g_clear_pointer(&array->indices, free);
+    g_clear_pointer(&array->base, darray_unref);
+}
+
 static void
 darray_free(DynamicArray *array) {
     if (array == NULL) {
@@ -46,7 +84,10 @@ darray_free(DynamicArray *array) {
 
     g_debug("[darray_free] freed");
 
+    darray_clear_user_data(array);
     g_clear_pointer(&array->data, free);
+    g_clear_pointer(&array->indices, free);
+    g_clear_pointer(&array->base, darray_unref);
     g_clear_pointer(&array, free);
 }
 
@@ -71,15 +112,6 @@ darray_unref(DynamicArray *array) {
     }
 }
 
-typedef struct {
-    DynamicArray *m1;
-    DynamicArray *m2;
-    DynamicArray *dest;
-    gpointer user_data;
-    DynamicArrayCompareDataFunc comp_func;
-
-} DynamicArraySortContext;
-
 static void
 insertion_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func, void *data) {
     for (uint32_t i = 0; i < array->num_items; ++i) {
@@ -151,53 +183,6 @@ merge_sort(DynamicArray *to_sort,
     split_merge(tmp, to_sort, 0, to_sort->num_items, cancellable, comp_func, comp_data);
 }
 
-static void
-sort_thread(gpointer data, gpointer user_data) {
-    DynamicArraySortContext *ctx = data;
-    DynamicArray *tmp = darray_copy(ctx->dest);
-    merge_sort(ctx->dest, tmp, user_data, (DynamicArrayCompareDataFunc)ctx->comp_func, ctx->user_data);
-    g_clear_pointer(&tmp, darray_unref);
-}
-
-static void
-merge_thread(gpointer data, gpointer user_data) {
-    DynamicArraySortContext *ctx = data;
-    int i = 0;
-    int j = 0;
-    const uint32_t n1 = ctx->m1->num_items;
-    const uint32_t n2 = ctx->m2->num_items;
-
-    while (true) {
-        void *d1 = darray_get_item(ctx->m1, i);
-        void *d2 = darray_get_item(ctx->m2, j);
-
-        if (i < n1 && j < n2) {
-            const int res = ctx->comp_func(&d1, &d2, user_data);
-            if (res <= 0) {
-                darray_add_item(ctx->dest, d1);
-                i++;
-            }
-            else {
-                darray_add_item(ctx->dest, d2);
-                j++;
-            }
-        }
-        else {
-            if (i < n1) {
-                darray_add_items(ctx->dest, &ctx->m1->data[i], ctx->m1->num_items - i);
-                return;
-            }
-            else if (j < n2) {
-                darray_add_items(ctx->dest, &ctx->m2->data[j], ctx->m2->num_items - j);
-                return;
-            }
-            else {
-                return;
-            }
-        }
-    }
-}
-
 DynamicArray *
 darray_new(size_t num_items) {
     DynamicArray *new = calloc(1, sizeof(DynamicArray));
@@ -232,9 +217,11 @@ darray_expand(DynamicArray *array, size_t min) {
 void
 darray_add_items(DynamicArray *array, void **items, uint32_t num_items) {
     g_assert(array);
-    g_assert(array->data);
     g_assert(items);
 
+    darray_clear_user_data(array);
+    darray_uncompact(array);
+
     if (array->num_items + num_items > array->max_items) {
         darray_expand(array, array->num_items + num_items);
     }
@@ -243,12 +230,37 @@ darray_add_items(DynamicArray *array, void **items, uint32_t num_items) {
     array->num_items += num_items;
 }
 
+void
+darray_add_array(DynamicArray *dest, DynamicArray *source) {
+    g_assert(dest);
+    g_assert(source);
+
+    if (source->num_items == 0) {
+        return;
+    }
+    if (!source->indices) {
+        darray_add_items(dest, source->data, source->num_items);
+        return;
+    }
+
+    darray_clear_user_data(dest);
+    darray_uncompact(dest);
+    if (dest->num_items + source->num_items > dest->max_items) {
+        darray_expand(dest, dest->num_items + source->num_items);
+    }
+    for (uint32_t i = 0; i < source->num_items; i++) {
+        dest->data[dest->num_items++] = darray_get_item_unchecked(source, i);
+    }
+}
+
 void
 darray_add_item(DynamicArray *array, void *data) {
     g_assert(array);
-    g_assert(array->data);
     // g_assert(data );
 
+    darray_clear_user_data(array);
+    darray_uncompact(array);
+
     if (array->num_items >= array->max_items) {
         darray_expand(array, array->num_items + 1);
     }
@@ -267,7 +279,7 @@ darray_get_item_idx(DynamicArray *array, void *item, DynamicArrayCompareDataFunc
 
     bool found = false;
     for (uint32_t i = 0; i < array->num_items; i++) {
-        if (item == array->data[i]) {
+        if (item == darray_get_item_unchecked(array, i)) {
             found = true;
             *index = i;
             break;
@@ -293,25 +305,23 @@ darray_get_item_next(DynamicArray *array,
     if (next_idx) {
         *next_idx = index + 1;
     }
-    return array->data[index + 1];
+    return darray_get_item_unchecked(array, index + 1);
 }
 
 void *
 darray_get_item(DynamicArray *array, uint32_t idx) {
     g_assert(array);
-    g_assert(array->data);
 
     if (idx >= array->num_items) {
         return NULL;
     }
 
-    return array->data[idx];
+    return darray_get_item_unchecked(array, idx);
 }
 
 uint32_t
 darray_get_num_items(DynamicArray *array) {
     g_assert(array);
-    g_assert(array->data);
 
     return array->num_items;
 }
@@ -319,11 +329,20 @@ darray_get_num_items(DynamicArray *array) {
 uint32_t
 darray_get_size(DynamicArray *array) {
     g_assert(array);
-    g_assert(array->data);
 
     return array->max_items;
 }
 
+size_t
+darray_get_memory_usage(DynamicArray *array) {
+    g_assert(array);
+
+    if (array->indices) {
+        return sizeof(DynamicArray) + (array->num_items + 1) * sizeof(uint32_t);
+    }
+    return sizeof(DynamicArray) + (array->max_items + 1) * sizeof(void *);
+}
+
 static DynamicArray *
 new_array_from_data(void **data, uint32_t num_items) {
     DynamicArray *array = darray_new(num_items);
@@ -331,119 +350,551 @@ new_array_from_data(void **data, uint32_t num_items) {
     return array;
 }
 
-static GArray *
-merge_sorted(GArray *merge_me, DynamicArrayCompareDataFunc comp_func, GCancellable *cancellable) {
-    if (merge_me->len == 1) {
-        return merge_me;
+void
+darray_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func, GCancellable *cancellable, void *data) {
+    g_assert(array);
+    g_assert(comp_func);
+
+    darray_clear_user_data(array);
+    darray_uncompact(array);
+
+    const int64_t span = fsearch_trace_begin();
+    if (array->num_items < 64) {
+        g_debug("[sort] insertion sort: %d\n", array->num_items);
+        insertion_sort(array, comp_func, data);
     }
-    if (cancellable && g_cancellable_is_cancelled(cancellable)) {
-        return merge_me;
+    else {
+        g_debug("[sort] merge sort: %d\n", array->num_items);
+        DynamicArray *src = darray_copy(array);
+        merge_sort(array, src, cancellable, comp_func, data);
+        g_clear_pointer(&src, darray_unref);
     }
-    const uint32_t num_threads = merge_me->len / 2;
+    fsearch_trace_end(span, "sort", "sort");
+}
 
-    g_debug("[sort] merge with %d thread(s)", num_threads);
+// arrays with fewer items than this per thread are sorted by fewer threads
+#define MERGE_SORT_MIN_ITEMS_PER_THREAD (1 << 14)
 
-    GArray *merged_data = g_array_sized_new(TRUE, TRUE, sizeof(DynamicArraySortContext), num_threads);
-    GThreadPool *merge_pool = g_thread_pool_new(merge_thread, NULL, (gint)num_threads, FALSE, NULL);
+static uint32_t
+get_num_sort_threads(FsearchThreadPool *pool, uint32_t num_items, uint32_t min_items_per_thread) {
+    const uint32_t max_threads = pool ? fsearch_thread_pool_get_num_threads(pool) : 1;
+    return CLAMP(num_items / min_items_per_thread, 1, MAX(max_threads, 1));
+}
 
-    for (int i = 0; i < num_threads; ++i) {
-        DynamicArraySortContext *c1 = &g_array_index(merge_me, DynamicArraySortContext, 2 * i);
-        DynamicArraySortContext *c2 = &g_array_index(merge_me, DynamicArraySortContext, 2 * i + 1);
-        DynamicArray *i1 = c1->dest;
-        DynamicArray *i2 = c2->dest;
+// Stable sort of num_items items in place
+static void
+sort_range(void **items,
+           uint32_t num_items,
+           DynamicArrayCompareDataFunc comp_func,
+           GCancellable *cancellable,
+           void *data) {
+    DynamicArray range = {.num_items = num_items, .max_items = num_items, .data = items};
+    if (num_items < 64) {
+        insertion_sort(&range, comp_func, data);
+    }
+    else {
+        DynamicArray *src = new_array_from_data(items, num_items);
+        merge_sort(&range, src, cancellable, comp_func, data);
+        g_clear_pointer(&src, darray_unref);
+    }
+}
 
-        DynamicArraySortContext merge_ctx = {};
-        merge_ctx.m1 = i1;
-        merge_ctx.m2 = i2;
-        merge_ctx.comp_func = comp_func;
-        merge_ctx.dest = darray_new(i1->num_items + i2->num_items);
+static inline void
+swap_items(void **items, uint32_t a, uint32_t b) {
+    void *tmp = items[a];
+    items[a] = items[b];
+    items[b] = tmp;
+}
 
-        g_array_insert_val(merged_data, i, merge_ctx);
+static void *
+median_of_three(void *a, void *b, void *c, DynamicArrayCompareDataFunc comp_func, void *data) {
+    if (comp_func(&a, &b, data) > 0) {
+        void *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    // a <= b
+    if (comp_func(&b, &c, data) <= 0) {
+        return b;
+    }
+    return comp_func(&a, &c, data) > 0 ? a : c;
+}
 
-        g_thread_pool_push(merge_pool, &g_array_index(merged_data, DynamicArraySortContext, i), NULL);
+// Quickselect: moves the item which belongs to position n of items[lo, hi) there, smaller items go before it and
+// larger ones after it
+static void
+select_nth(void **items, uint32_t lo, uint32_t hi, uint32_t n, DynamicArrayCompareDataFunc comp_func, void *data) {
+    while (hi - lo > 1) {
+        void *pivot = median_of_three(items[lo], items[lo + (hi - lo) / 2], items[hi - 1], comp_func, data);
+        // three way partition, so many equal items don't slow it down:
+        // [lo, lt) is smaller than the pivot, [lt, gt) equal and [gt, hi) larger
+        uint32_t lt = lo;
+        uint32_t gt = hi;
+        uint32_t i = lo;
+        while (i < gt) {
+            const int32_t res = comp_func(&items[i], &pivot, data);
+            if (res < 0) {
+                swap_items(items, lt++, i++);
+            }
+            else if (res > 0) {
+                swap_items(items, i, --gt);
+            }
+            else {
+                i++;
+            }
+        }
+        if (n < lt) {
+            hi = lt;
+        }
+        else if (n >= gt) {
+            lo = gt;
+        }
+        else {
+            return;
+        }
     }
+}
+
+void
+darray_partial_sort(DynamicArray *array,
+                    uint32_t start,
+                    uint32_t end,
+                    DynamicArrayCompareDataFunc comp_func,
+                    void *data) {
+    g_assert(array);
+    g_assert(comp_func);
 
-    g_thread_pool_free(g_steal_pointer(&merge_pool), FALSE, TRUE);
+    darray_clear_user_data(array);
+    darray_uncompact(array);
 
-    for (int i = 0; i < merge_me->len; i++) {
-        DynamicArraySortContext *c = &g_array_index(merge_me, DynamicArraySortContext, i);
-        if (c && c->dest) {
-            g_clear_pointer(&c->dest, darray_free);
-        }
+    end = MIN(end, array->num_items);
+    if (start >= end) {
+        return;
     }
+    // first everything before start is moved before it, then the items of the range in front of the rest
+    select_nth(array->data, 0, array->num_items, start, comp_func, data);
+    select_nth(array->data, start, array->num_items, end - 1, comp_func, data);
+    sort_range(array->data + start, end - start, comp_func, NULL, data);
+}
 
-    return merge_sorted(merged_data, comp_func, cancellable);
+// Returns how many of the first k items of the stable merge of a and b come from a (merge path partitioning).
+// Items of a go first if they're equal to items of b.
+static uint32_t
+merge_path_split(void **a,
+                 uint32_t num_a,
+                 void **b,
+                 uint32_t num_b,
+                 uint32_t k,
+                 DynamicArrayCompareDataFunc comp_func,
+                 void *data) {
+    uint32_t lo = k > num_b ? k - num_b : 0;
+    uint32_t hi = MIN(k, num_a);
+    while (lo < hi) {
+        const uint32_t i = lo + (hi - lo) / 2;
+        const uint32_t j = k - i;
+        // a[i] goes before b[j - 1], so more items of a are part of the first k
+        if (comp_func(&a[i], &b[j - 1], data) <= 0) {
+            lo = i + 1;
+        }
+        else {
+            hi = i;
+        }
+    }
+    return lo;
 }
 
-static int
-get_ideal_thread_count() {
-    // int num_processors = 1;
-    const int num_processors = (int)g_get_num_processors();
+typedef struct {
+    void **src;
+    void **dest;
+    // the sorted runs of src with their start positions, the last entry is the number of items
+    uint32_t *run_starts;
+    uint32_t num_runs;
+    // the part of the merged items this thread writes, [start, end) of dest
+    uint32_t start;
+    uint32_t end;
+    DynamicArrayCompareDataFunc comp_func;
+    GCancellable *cancellable;
+    void *data;
+} DynamicArrayMergeSortContext;
 
-    const int e = floor(log2(num_processors));
-    const int num_threads = (int)pow(2, e);
-    return MAX(num_threads, MAX_SORT_THREADS);
+static void
+merge_sort_chunk_thread(void *data) {
+    DynamicArrayMergeSortContext *ctx = data;
+    const int64_t span = fsearch_trace_begin();
+    sort_range(ctx->src + ctx->start, ctx->end - ctx->start, ctx->comp_func, ctx->cancellable, ctx->data);
+    fsearch_trace_end(span, "sort", "sort chunk");
+}
+
+// Merges pairs of neighbouring runs, this thread writes dest[start, end), which can span several pairs
+static void
+merge_sort_merge_thread(void *data) {
+    DynamicArrayMergeSortContext *ctx = data;
+    const int64_t span = fsearch_trace_begin();
+    for (uint32_t r = 0; r < ctx->num_runs; r += 2) {
+        const uint32_t pair_start = ctx->run_starts[r];
+        const uint32_t pair_center = ctx->run_starts[MIN(r + 1, ctx->num_runs)];
+        const uint32_t pair_end = ctx->run_starts[MIN(r + 2, ctx->num_runs)];
+        if (pair_end <= ctx->start || pair_start >= ctx->end) {
+            continue;
+        }
+        void **a = ctx->src + pair_start;
+        void **b = ctx->src + pair_center;
+        const uint32_t num_a = pair_center - pair_start;
+        const uint32_t num_b = pair_end - pair_center;
+        const uint32_t k_start = MAX(ctx->start, pair_start) - pair_start;
+        const uint32_t k_end = MIN(ctx->end, pair_end) - pair_start;
+
+        uint32_t i = merge_path_split(a, num_a, b, num_b, k_start, ctx->comp_func, ctx->data);
+        uint32_t j = k_start - i;
+        for (uint32_t k = k_start; k < k_end; k++) {
+            if (i < num_a && (j >= num_b || ctx->comp_func(&a[i], &b[j], ctx->data) <= 0)) {
+                ctx->dest[pair_start + k] = a[i++];
+            }
+            else {
+                ctx->dest[pair_start + k] = b[j++];
+            }
+        }
+    }
+    fsearch_trace_end(span, "sort", "merge");
 }
 
 void
 darray_sort_multi_threaded(DynamicArray *array,
                            DynamicArrayCompareDataFunc comp_func,
+                           FsearchThreadPool *pool,
                            GCancellable *cancellable,
                            void *data) {
-    const int num_threads = get_ideal_thread_count();
-    if (num_threads < 2 || num_threads > array->num_items) {
-        return darray_sort(array, comp_func, NULL, data);
+    g_assert(array);
+    g_assert(comp_func);
+
+    const uint32_t num_items = array->num_items;
+    const uint32_t num_threads = get_num_sort_threads(pool, num_items, MERGE_SORT_MIN_ITEMS_PER_THREAD);
+    if (num_threads < 2) {
+        return darray_sort(array, comp_func, cancellable, data);
     }
 
     g_debug("[sort] sorting with %d threads", num_threads);
 
-    const int num_items_per_thread = (int)(array->num_items / num_threads);
-    GThreadPool *sort_pool = g_thread_pool_new(sort_thread, cancellable, num_threads, FALSE, NULL);
+    darray_clear_user_data(array);
+    darray_uncompact(array);
+
+    void **src = array->data;
+    void **dest = calloc(array->max_items, sizeof(void *));
+    g_assert(dest);
+    g_autofree uint32_t *run_starts = calloc(num_threads + 1, sizeof(uint32_t));
+    g_autofree DynamicArrayMergeSortContext *ctxs = calloc(num_threads, sizeof(DynamicArrayMergeSortContext));
+    g_assert(run_starts);
+    g_assert(ctxs);
+
+    // every thread sorts a chunk of the array first
+    const uint32_t num_items_per_thread = num_items / num_threads;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        run_starts[t] = t * num_items_per_thread;
+        ctxs[t].start = run_starts[t];
+        ctxs[t].end = t == num_threads - 1 ? num_items : (t + 1) * num_items_per_thread;
+        ctxs[t].src = src;
+        ctxs[t].comp_func = comp_func;
+        ctxs[t].cancellable = cancellable;
+        ctxs[t].data = data;
+    }
+    run_starts[num_threads] = num_items;
+    fsearch_thread_pool_run(pool, merge_sort_chunk_thread, ctxs, sizeof(DynamicArrayMergeSortContext), num_threads);
+
+    // Then neighbouring runs get merged until only one is left. In every round the merged items are split evenly
+    // across all threads, each one finds where its part starts in the two runs it merges with merge_path_split.
+    uint32_t num_runs = num_threads;
+    while (num_runs > 1) {
+        if (cancellable && g_cancellable_is_cancelled(cancellable)) {
+            break;
+        }
+        for (uint32_t t = 0; t < num_threads; t++) {
+            ctxs[t].src = src;
+            ctxs[t].dest = dest;
+            ctxs[t].run_starts = run_starts;
+            ctxs[t].num_runs = num_runs;
+        }
+        fsearch_thread_pool_run(pool, merge_sort_merge_thread, ctxs, sizeof(DynamicArrayMergeSortContext), num_threads);
 
-    g_autoptr(GArray) sort_ctx_array = g_array_sized_new(TRUE, TRUE, sizeof(DynamicArraySortContext), num_threads);
+        // every pair is one run now
+        uint32_t num_merged_runs = 0;
+        for (uint32_t r = 0; r < num_runs; r += 2) {
+            run_starts[num_merged_runs++] = run_starts[r];
+        }
+        run_starts[num_merged_runs] = num_items;
+        num_runs = num_merged_runs;
 
-    int start = 0;
-    for (int i = 0; i < num_threads; ++i) {
-        DynamicArraySortContext sort_ctx;
-        sort_ctx.dest = new_array_from_data(array->data + start,
-                                            i == num_threads - 1 ? array->num_items - start : num_items_per_thread);
-        sort_ctx.comp_func = comp_func;
-        sort_ctx.user_data = data;
-        start += num_items_per_thread;
-        g_array_insert_val(sort_ctx_array, i, sort_ctx);
-        g_thread_pool_push(sort_pool, &g_array_index(sort_ctx_array, DynamicArraySortContext, i), NULL);
+        void **tmp = src;
+        src = dest;
+        dest = tmp;
     }
-    g_thread_pool_free(g_steal_pointer(&sort_pool), FALSE, TRUE);
 
-    g_autoptr(GArray) result = merge_sorted(sort_ctx_array, comp_func, cancellable);
+    // src holds the result, which is either the original data or the other buffer
+    array->data = src;
+    g_clear_pointer(&dest, free);
+}
+
+// arrays with fewer items than this per thread are filtered by fewer threads
+#define FILTER_MIN_ITEMS_PER_THREAD (1 << 16)
+
+typedef struct {
+    DynamicArray *array;
+    uint32_t start;
+    uint32_t end;
+    DynamicArrayFilterFunc filter_func;
+    void *data;
+    DynamicArray *result;
+} DynamicArrayFilterContext;
 
-    if (result) {
-        g_clear_pointer(&array->data, free);
+static void
+filter_chunk_thread(void *data) {
+    DynamicArrayFilterContext *ctx = data;
+    ctx->result = darray_new(MIN(ctx->end - ctx->start, 1024) + 1);
+    for (uint32_t i = ctx->start; i < ctx->end; i++) {
+        void *item = darray_get_item_unchecked(ctx->array, i);
+        if (ctx->filter_func(item, ctx->data)) {
+            darray_add_item(ctx->result, item);
+        }
+    }
+}
 
-        DynamicArraySortContext *c = &g_array_index(result, DynamicArraySortContext, 0);
-        array->data = g_steal_pointer(&c->dest->data);
-        array->num_items = c->dest->num_items;
-        array->max_items = c->dest->max_items;
+DynamicArray *
+darray_filter(DynamicArray *array, DynamicArrayFilterFunc filter_func, FsearchThreadPool *pool, void *data) {
+    g_assert(array);
+    g_assert(filter_func);
+
+    const uint32_t num_items = array->num_items;
+    const uint32_t num_threads = get_num_sort_threads(pool, num_items, FILTER_MIN_ITEMS_PER_THREAD);
+    g_autofree DynamicArrayFilterContext *ctxs = calloc(num_threads, sizeof(DynamicArrayFilterContext));
+    g_assert(ctxs);
+
+    const uint32_t num_items_per_thread = num_items / num_threads;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        ctxs[t].array = array;
+        ctxs[t].start = t * num_items_per_thread;
+        ctxs[t].end = t == num_threads - 1 ? num_items : (t + 1) * num_items_per_thread;
+        ctxs[t].filter_func = filter_func;
+        ctxs[t].data = data;
+    }
+    fsearch_thread_pool_run(pool, filter_chunk_thread, ctxs, sizeof(DynamicArrayFilterContext), num_threads);
 
-        g_clear_pointer(&c->dest, free);
+    if (num_threads == 1) {
+        return ctxs[0].result;
+    }
+    uint32_t num_filtered = 0;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        num_filtered += ctxs[t].result->num_items;
+    }
+    DynamicArray *filtered = darray_new(num_filtered + 1);
+    for (uint32_t t = 0; t < num_threads; t++) {
+        darray_add_array(filtered, ctxs[t].result);
+        g_clear_pointer(&ctxs[t].result, darray_unref);
     }
+    return filtered;
+}
+
+#define RADIX_SORT_BITS 8
+#define RADIX_SORT_NUM_BUCKETS (1 << RADIX_SORT_BITS)
+// arrays with fewer items than this per thread are sorted by a single thread
+#define RADIX_SORT_MIN_ITEMS_PER_THREAD (1 << 16)
+
+typedef struct {
+    uint64_t key;
+    void *item;
+} DynamicArrayKeyedItem;
+
+typedef struct {
+    DynamicArrayKeyedItem *src;
+    DynamicArrayKeyedItem *dest;
+    // the last pass also writes the items to the array directly
+    void **dest_items;
+    uint32_t start;
+    uint32_t end;
+    uint32_t shift;
+
+    // for computing the keys
+    void **items;
+    DynamicArrayKeyFunc key_func;
+    void *key_func_data;
+    uint64_t keys_and;
+    uint64_t keys_or;
+
+    // the number of items in [start, end) per digit, then the positions in dest they're moved to
+    uint32_t offsets[RADIX_SORT_NUM_BUCKETS];
+} DynamicArrayRadixSortContext;
+
+static void
+radix_sort_key_thread(void *data) {
+    DynamicArrayRadixSortContext *ctx = data;
+    uint64_t keys_and = UINT64_MAX;
+    uint64_t keys_or = 0;
+    for (uint32_t i = ctx->start; i < ctx->end; i++) {
+        const uint64_t key = ctx->key_func(ctx->items[i], ctx->key_func_data);
+        ctx->src[i].key = key;
+        ctx->src[i].item = ctx->items[i];
+        keys_and &= key;
+        keys_or |= key;
+    }
+    ctx->keys_and = keys_and;
+    ctx->keys_or = keys_or;
+}
+
+static void
+radix_sort_count_thread(void *data) {
+    DynamicArrayRadixSortContext *ctx = data;
+    memset(ctx->offsets, 0, sizeof(ctx->offsets));
+    for (uint32_t i = ctx->start; i < ctx->end; i++) {
+        ctx->offsets[(ctx->src[i].key >> ctx->shift) & (RADIX_SORT_NUM_BUCKETS - 1)]++;
+    }
+}
+
+static void
+radix_sort_scatter_thread(void *data) {
+    DynamicArrayRadixSortContext *ctx = data;
+    for (uint32_t i = ctx->start; i < ctx->end; i++) {
+        const uint32_t digit = (ctx->src[i].key >> ctx->shift) & (RADIX_SORT_NUM_BUCKETS - 1);
+        const uint32_t pos = ctx->offsets[digit]++;
+        ctx->dest[pos] = ctx->src[i];
+        if (ctx->dest_items) {
+            ctx->dest_items[pos] = ctx->src[i].item;
+        }
+    }
+}
+
+// Sorts the items of array by their keys and returns them with their keys in that order,
+// NULL if the sort got cancelled or there's nothing to sort
+static DynamicArrayKeyedItem *
+radix_sort(DynamicArray *array,
+           DynamicArrayKeyFunc key_func,
+           FsearchThreadPool *pool,
+           GCancellable *cancellable,
+           void *data) {
+    darray_clear_user_data(array);
+    darray_uncompact(array);
+
+    const uint32_t num_items = array->num_items;
+    if (num_items < 2) {
+        return NULL;
+    }
+    const uint32_t num_threads = get_num_sort_threads(pool, num_items, RADIX_SORT_MIN_ITEMS_PER_THREAD);
+    g_debug("[sort] radix sort with %d thread(s): %d", num_threads, num_items);
+
+    DynamicArrayKeyedItem *src = malloc(num_items * sizeof(DynamicArrayKeyedItem));
+    g_autofree DynamicArrayKeyedItem *dest = malloc(num_items * sizeof(DynamicArrayKeyedItem));
+    g_autofree DynamicArrayRadixSortContext *ctxs = calloc(num_threads, sizeof(DynamicArrayRadixSortContext));
+    g_assert(src);
+    g_assert(dest);
+    g_assert(ctxs);
+
+    const uint32_t num_items_per_thread = num_items / num_threads;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        ctxs[t].start = t * num_items_per_thread;
+        ctxs[t].end = t == num_threads - 1 ? num_items : (t + 1) * num_items_per_thread;
+        ctxs[t].items = array->data;
+        ctxs[t].key_func = key_func;
+        ctxs[t].key_func_data = data;
+        ctxs[t].src = src;
+    }
+    fsearch_thread_pool_run(pool, radix_sort_key_thread, ctxs, sizeof(DynamicArrayRadixSortContext), num_threads);
+
+    // digits which are the same for all keys don't need a pass
+    uint64_t keys_and = UINT64_MAX;
+    uint64_t keys_or = 0;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        keys_and &= ctxs[t].keys_and;
+        keys_or |= ctxs[t].keys_or;
+    }
+    const uint64_t varying_bits = keys_or & ~keys_and;
+    if (!varying_bits) {
+        // all keys are the same, so the array is in order already
+        return src;
+    }
+    uint32_t last_shift = 0;
+    for (uint32_t shift = 0; shift < 64; shift += RADIX_SORT_BITS) {
+        if ((varying_bits >> shift) & (RADIX_SORT_NUM_BUCKETS - 1)) {
+            last_shift = shift;
+        }
+    }
+
+    for (uint32_t shift = 0; shift <= last_shift; shift += RADIX_SORT_BITS) {
+        if (!((varying_bits >> shift) & (RADIX_SORT_NUM_BUCKETS - 1))) {
+            continue;
+        }
+        if (cancellable && g_cancellable_is_cancelled(cancellable)) {
+            g_clear_pointer(&src, free);
+            return NULL;
+        }
+        for (uint32_t t = 0; t < num_threads; t++) {
+            ctxs[t].src = src;
+            ctxs[t].dest = dest;
+            ctxs[t].dest_items = shift == last_shift ? array->data : NULL;
+            ctxs[t].shift = shift;
+        }
+        fsearch_thread_pool_run(pool, radix_sort_count_thread, ctxs, sizeof(DynamicArrayRadixSortContext), num_threads);
+
+        // the items with the lowest digit come first, those of earlier threads before those of later ones
+        uint32_t pos = 0;
+        for (uint32_t digit = 0; digit < RADIX_SORT_NUM_BUCKETS; digit++) {
+            for (uint32_t t = 0; t < num_threads; t++) {
+                const uint32_t count = ctxs[t].offsets[digit];
+                ctxs[t].offsets[digit] = pos;
+                pos += count;
+            }
+        }
+        fsearch_thread_pool_run(pool,
+                                radix_sort_scatter_thread,
+                                ctxs,
+                                sizeof(DynamicArrayRadixSortContext),
+                                num_threads);
+
+        DynamicArrayKeyedItem *tmp = src;
+        src = dest;
+        dest = tmp;
+    }
+    return src;
 }
 
 void
-darray_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func, GCancellable *cancellable, void *data) {
+darray_sort_by_key(DynamicArray *array,
+                   DynamicArrayKeyFunc key_func,
+                   FsearchThreadPool *pool,
+                   GCancellable *cancellable,
+                   void *data) {
     g_assert(array);
-    g_assert(array->data);
+    g_assert(key_func);
+
+    DynamicArrayKeyedItem *sorted = radix_sort(array, key_func, pool, cancellable, data);
+    g_clear_pointer(&sorted, free);
+}
+
+void
+darray_sort_by_key_and_compare(DynamicArray *array,
+                               DynamicArrayKeyFunc key_func,
+                               DynamicArrayCompareDataFunc comp_func,
+                               FsearchThreadPool *pool,
+                               GCancellable *cancellable,
+                               void *data) {
+    g_assert(array);
+    g_assert(key_func);
     g_assert(comp_func);
 
-    if (array->num_items < 64) {
-        g_debug("[sort] insertion sort: %d\n", array->num_items);
-        insertion_sort(array, comp_func, data);
+    g_autofree DynamicArrayKeyedItem *sorted = radix_sort(array, key_func, pool, cancellable, data);
+    if (!sorted) {
+        return;
     }
-    else {
-        g_debug("[sort] merge sort: %d\n", array->num_items);
-        DynamicArray *src = darray_copy(array);
-        merge_sort(array, src, cancellable, comp_func, data);
-        g_clear_pointer(&src, darray_unref);
+
+    const uint32_t num_items = array->num_items;
+    for (uint32_t start = 0; start < num_items;) {
+        uint32_t end = start + 1;
+        while (end < num_items && sorted[end].key == sorted[start].key) {
+            end++;
+        }
+        if (end - start > 1) {
+            if (cancellable && g_cancellable_is_cancelled(cancellable)) {
+                return;
+            }
+            sort_range(array->data + start, end - start, comp_func, cancellable, data);
+        }
+        start = end;
     }
 }
 
@@ -454,7 +905,6 @@ darray_binary_search_with_data(DynamicArray *array,
                                void *data,
                                uint32_t *matched_index) {
     g_assert(array);
-    g_assert(array->data);
     g_assert(comp_func);
 
     if (array->num_items <= 0) {
@@ -470,7 +920,8 @@ darray_binary_search_with_data(DynamicArray *array,
     while (left <= right) {
         middle = left + (right - left) / 2;
 
-        int32_t match = comp_func(&array->data[middle], &item, data);
+        void *middle_item = darray_get_item_unchecked(array, middle);
+        int32_t match = comp_func(&middle_item, &item, data);
         if (match == 0) {
             result = true;
             break;
@@ -495,6 +946,20 @@ darray_binary_search_with_data(DynamicArray *array,
     return result;
 }
 
+void
+darray_set_user_data(DynamicArray *array, void *user_data, GDestroyNotify destroy_func) {
+    g_assert(array);
+    darray_clear_user_data(array);
+    array->user_data = user_data;
+    array->user_data_destroy_func = destroy_func;
+}
+
+void *
+darray_get_user_data(DynamicArray *array) {
+    g_assert(array);
+    return array->user_data;
+}
+
 DynamicArray *
 darray_copy(DynamicArray *array) {
     if (!array) {
@@ -511,7 +976,76 @@ darray_copy(DynamicArray *array) {
 
     new->ref_count = 1;
 
-    memcpy(new->data, array->data, new->max_items * sizeof(void *));
+    if (array->indices) {
+        for (uint32_t i = 0; i < array->num_items; i++) {
+            new->data[i] = darray_get_item_unchecked(array, i);
+        }
+    }
+    else {
+        memcpy(new->data, array->data, new->max_items * sizeof(void *));
+    }
+
+    return new;
+}
+
+DynamicArray *
+darray_new_compact(DynamicArray *base, uint32_t *indices, uint32_t num_items) {
+    g_assert(base);
+    g_assert(indices);
+
+    if (base->indices) {
+        g_clear_pointer(&indices, free);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < num_items; i++) {
+        if (indices[i] >= base->num_items) {
+            g_clear_pointer(&indices, free);
+            return NULL;
+        }
+    }
+
+    DynamicArray *new = calloc(1, sizeof(DynamicArray));
+    g_assert(new);
+
+    new->max_items = num_items;
+    new->num_items = num_items;
+    new->indices = indices;
+    new->base = darray_ref(base);
+    new->ref_count = 1;
 
     return new;
 }
+
+bool
+darray_compact(DynamicArray *array, DynamicArray *base, DynamicArrayIndexFunc index_func, void *data) {
+    g_assert(array);
+    g_assert(base);
+    g_assert(index_func);
+
+    if (array->indices) {
+        return array->base == base;
+    }
+    if (array == base || base->indices) {
+        return false;
+    }
+
+    uint32_t *indices = calloc(array->num_items + 1, sizeof(uint32_t));
+    g_assert(indices);
+    for (uint32_t i = 0; i < array->num_items; i++) {
+        void *item = array->data[i];
+        const uint32_t idx = index_func(item, data);
+        if (idx >= base->num_items || base->data[idx] != item) {
+            // not every item is part of base, keep the array as it is
+            g_clear_pointer(&indices, free);
+            return false;
+        }
+        indices[i] = idx;
+    }
+
+    darray_clear_user_data(array);
+    g_clear_pointer(&array->data, free);
+    array->indices = indices;
+    array->base = darray_ref(base);
+    array->max_items = array->num_items;
+    return true;
+}
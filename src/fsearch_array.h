@@ -23,10 +23,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "fsearch_thread_pool.h"
+
 typedef struct DynamicArray DynamicArray;
 
 typedef int32_t (*DynamicArrayCompareFunc)(void *a, void *b);
 typedef int32_t (*DynamicArrayCompareDataFunc)(void *a, void *b, void *data);
+typedef uint32_t (*DynamicArrayIndexFunc)(void *item, void *data);
+typedef uint64_t (*DynamicArrayKeyFunc)(void *item, void *data);
+typedef bool (*DynamicArrayFilterFunc)(void *item, void *data);
 
 bool
 darray_binary_search_with_data(DynamicArray *array,
@@ -35,21 +40,65 @@ darray_binary_search_with_data(DynamicArray *array,
                                void *data,
                                uint32_t *matched_index);
 
+// Stable sort on the threads of pool, which must not be used by anything else in the meantime.
+// With pool being NULL, this is the same as darray_sort.
 void
 darray_sort_multi_threaded(DynamicArray *array,
                            DynamicArrayCompareDataFunc comp_func,
+                           FsearchThreadPool *pool,
                            GCancellable *cancellable,
                            void *data);
 
 void
 darray_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func, GCancellable *cancellable, void *data);
 
+// Sorts the items in ascending order of the keys key_func returns for them, items with the same key keep their
+// order. This is a radix sort on the threads of pool (if it's not NULL), which computes every key only once and
+// doesn't compare the items, so it's much faster than sorting with a compare function for orders which can be
+// expressed by integer keys. The array is left unchanged if the sort gets cancelled.
+void
+darray_sort_by_key(DynamicArray *array,
+                   DynamicArrayKeyFunc key_func,
+                   FsearchThreadPool *pool,
+                   GCancellable *cancellable,
+                   void *data);
+
+// Like darray_sort_by_key, but the items with the same key are then sorted with comp_func (which keeps the order of
+// equal items too). The keys must be consistent with comp_func, i.e. an item with a smaller key than another one
+// must also compare smaller. The order of the items is undefined if the sort gets cancelled.
+void
+darray_sort_by_key_and_compare(DynamicArray *array,
+                               DynamicArrayKeyFunc key_func,
+                               DynamicArrayCompareDataFunc comp_func,
+                               FsearchThreadPool *pool,
+                               GCancellable *cancellable,
+                               void *data);
+
+// Only puts the items into place which end up in [start, end) when sorting the array with comp_func, in order (equal
+// items might be in a different order though). The other items are only moved to the correct side of that range.
+// Takes O(n) comparisons on average, so it's a fast way to find e.g. the first few items of the sorted array.
+void
+darray_partial_sort(DynamicArray *array,
+                    uint32_t start,
+                    uint32_t end,
+                    DynamicArrayCompareDataFunc comp_func,
+                    void *data);
+
+// Returns a new array with the items for which filter_func returns true, in the same order. Large arrays are split
+// into ranges which get filtered on the threads of pool (if it's not NULL), so filter_func must be thread safe.
+DynamicArray *
+darray_filter(DynamicArray *array, DynamicArrayFilterFunc filter_func, FsearchThreadPool *pool, void *data);
+
 uint32_t
 darray_get_size(DynamicArray *array);
 
 uint32_t
 darray_get_num_items(DynamicArray *array);
 
+// Returns the number of bytes allocated for the items of array, without the ones of its base or user data
+size_t
+darray_get_memory_usage(DynamicArray *array);
+
 void *
 darray_get_item(DynamicArray *array, uint32_t idx);
 
@@ -66,6 +115,9 @@ darray_get_item_idx(DynamicArray *array, void *item, DynamicArrayCompareDataFunc
 void
 darray_add_items(DynamicArray *array, void **items, uint32_t num_items);
 
+void
+darray_add_array(DynamicArray *dest, DynamicArray *source);
+
 void
 darray_add_item(DynamicArray *array, void *data);
 
@@ -80,3 +132,25 @@ darray_ref(DynamicArray *array);
 
 DynamicArray *
 darray_copy(DynamicArray *array);
+
+// Attaches data which was derived from the current content of the array (e.g. a cache).
+// It gets freed with destroy_func as soon as the array gets modified or freed.
+// The array doesn't synchronize access to it, that's up to the caller.
+// Creates a compact array (see darray_compact) from a list of positions in base and takes
+// ownership of indices, which must have been allocated with malloc.
+// Returns NULL if one of the positions is out of range.
+DynamicArray *
+darray_new_compact(DynamicArray *base, uint32_t *indices, uint32_t num_items);
+
+// Replaces the items of array by their positions in base, as returned by index_func.
+// This halves the memory usage of arrays which hold other orderings of the items of base.
+// base must not be modified as long as array is compact, array itself turns back into
+// a regular array once it gets modified. Returns false if an item of array isn't in base.
+bool
+darray_compact(DynamicArray *array, DynamicArray *base, DynamicArrayIndexFunc index_func, void *data);
+
+void
+darray_set_user_data(DynamicArray *array, void *user_data, GDestroyNotify destroy_func);
+
+void *
+darray_get_user_data(DynamicArray *array);
@@ -0,0 +1,169 @@
+#define G_LOG_DOMAIN "fsearch-array-merge"
+
+#include "fsearch_array_merge.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+// the splits of the blocks are computed in ranges of this many blocks
+#define ARRAY_MERGE_GRAIN_SIZE 256
+
+struct FsearchArrayMerge {
+    DynamicArray *first;
+    DynamicArray *second;
+    uint32_t num_first;
+    uint32_t num_second;
+    DynamicArrayCompareDataFunc compare_func;
+    void *compare_data;
+
+    // splits[b] is the number of items of the first array among the first b * FSEARCH_ARRAY_MERGE_BLOCK_SIZE items
+    // of the merged array
+    uint32_t *splits;
+    uint32_t num_splits;
+};
+
+static inline bool
+first_comes_before(FsearchArrayMerge *merge, uint32_t first_idx, uint32_t second_idx) {
+    void *a = darray_get_item(merge->first, first_idx);
+    void *b = darray_get_item(merge->second, second_idx);
+    return merge->compare_func(&a, &b, merge->compare_data) <= 0;
+}
+
+// Returns the number of items of the first array among the first idx items of the merged array, which is known to be
+// in [lo, hi]. The first items of the first array come before the remaining items of the second one, so it's the
+// number of items of the first array which come before their counterpart in the second one.
+static uint32_t
+find_split(FsearchArrayMerge *merge, uint32_t idx, uint32_t lo, uint32_t hi) {
+    // arrays which aren't sorted (e.g. while only the visible rows are put into place) still get a valid split
+    const uint32_t min_split = idx > merge->num_second ? idx - merge->num_second : 0;
+    const uint32_t max_split = MIN(idx, merge->num_first);
+    lo = CLAMP(lo, min_split, max_split);
+    hi = CLAMP(hi, lo, max_split);
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (first_comes_before(merge, mid, idx - mid - 1)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void
+find_splits_range(uint32_t start, uint32_t end, void *data) {
+    FsearchArrayMerge *merge = data;
+    for (uint32_t b = start; b < end; b++) {
+        merge->splits[b] = find_split(merge, b * FSEARCH_ARRAY_MERGE_BLOCK_SIZE, 0, merge->num_first);
+    }
+}
+
+FsearchArrayMerge *
+fsearch_array_merge_new(DynamicArray *first,
+                        DynamicArray *second,
+                        DynamicArrayCompareDataFunc compare_func,
+                        void *compare_data,
+                        FsearchThreadPool *pool) {
+    g_assert(first);
+    g_assert(second);
+    g_assert(compare_func);
+
+    FsearchArrayMerge *merge = calloc(1, sizeof(FsearchArrayMerge));
+    g_assert(merge);
+    merge->first = darray_ref(first);
+    merge->second = darray_ref(second);
+    merge->num_first = darray_get_num_items(first);
+    merge->num_second = darray_get_num_items(second);
+    merge->compare_func = compare_func;
+    merge->compare_data = compare_data;
+
+    // the blocks start at every block size items up to and including the end of the merged array
+    merge->num_splits = fsearch_array_merge_get_num_items(merge) / FSEARCH_ARRAY_MERGE_BLOCK_SIZE + 1;
+    merge->splits = calloc(merge->num_splits, sizeof(uint32_t));
+    g_assert(merge->splits);
+    fsearch_thread_pool_parallel_for(pool, 0, merge->num_splits, ARRAY_MERGE_GRAIN_SIZE, find_splits_range, merge);
+    return merge;
+}
+
+void
+fsearch_array_merge_free(FsearchArrayMerge *merge) {
+    if (!merge) {
+        return;
+    }
+    g_clear_pointer(&merge->first, darray_unref);
+    g_clear_pointer(&merge->second, darray_unref);
+    g_clear_pointer(&merge->splits, free);
+    g_clear_pointer(&merge, free);
+}
+
+DynamicArray *
+fsearch_array_merge_get_first(FsearchArrayMerge *merge) {
+    g_assert(merge);
+    return merge->first;
+}
+
+DynamicArray *
+fsearch_array_merge_get_second(FsearchArrayMerge *merge) {
+    g_assert(merge);
+    return merge->second;
+}
+
+uint32_t
+fsearch_array_merge_get_num_items(FsearchArrayMerge *merge) {
+    g_assert(merge);
+    return merge->num_first + merge->num_second;
+}
+
+size_t
+fsearch_array_merge_get_memory_usage(FsearchArrayMerge *merge) {
+    g_assert(merge);
+    return sizeof(FsearchArrayMerge) + merge->num_splits * sizeof(uint32_t);
+}
+
+static uint32_t
+get_split(FsearchArrayMerge *merge, uint32_t idx) {
+    const uint32_t block = idx / FSEARCH_ARRAY_MERGE_BLOCK_SIZE;
+    const uint32_t hi = block + 1 < merge->num_splits ? merge->splits[block + 1] : merge->num_first;
+    return find_split(merge, idx, merge->splits[block], hi);
+}
+
+void *
+fsearch_array_merge_get_item(FsearchArrayMerge *merge, uint32_t idx) {
+    g_assert(merge);
+    if (idx >= fsearch_array_merge_get_num_items(merge)) {
+        return NULL;
+    }
+    const uint32_t first_idx = get_split(merge, idx);
+    const uint32_t second_idx = idx - first_idx;
+    if (first_idx < merge->num_first
+        && (second_idx >= merge->num_second || first_comes_before(merge, first_idx, second_idx))) {
+        return darray_get_item(merge->first, first_idx);
+    }
+    return darray_get_item(merge->second, second_idx);
+}
+
+uint32_t
+fsearch_array_merge_get_items(FsearchArrayMerge *merge, uint32_t start, uint32_t num_items, void **items) {
+    g_assert(merge);
+    g_assert(items);
+    const uint32_t num_merged = fsearch_array_merge_get_num_items(merge);
+    if (start >= num_merged) {
+        return 0;
+    }
+    num_items = MIN(num_items, num_merged - start);
+
+    // only the first item needs a search, the following ones are merged one after the other
+    uint32_t first_idx = get_split(merge, start);
+    uint32_t second_idx = start - first_idx;
+    for (uint32_t i = 0; i < num_items; i++) {
+        if (first_idx < merge->num_first
+            && (second_idx >= merge->num_second || first_comes_before(merge, first_idx, second_idx))) {
+            items[i] = darray_get_item(merge->first, first_idx++);
+        }
+        else {
+            items[i] = darray_get_item(merge->second, second_idx++);
+        }
+    }
+    return num_items;
+}
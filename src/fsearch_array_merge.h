@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_thread_pool.h"
+
+// Two arrays which are sorted in the same order, seen as a single array in that order without merging them into a
+// copy. Items of the first array come before equal items of the second one.
+//
+// The merge only remembers how many items of the first array come before every FSEARCH_ARRAY_MERGE_BLOCK_SIZE-th
+// item of the merged array (its merge path), so an item is found with a binary search over a single block.
+typedef struct FsearchArrayMerge FsearchArrayMerge;
+
+#define FSEARCH_ARRAY_MERGE_BLOCK_SIZE 1024
+
+// compare_func gets pointers to the items, like the compare functions of darray_sort. The merge path is computed
+// by the threads of pool (if it's not NULL).
+FsearchArrayMerge *
+fsearch_array_merge_new(DynamicArray *first,
+                        DynamicArray *second,
+                        DynamicArrayCompareDataFunc compare_func,
+                        void *compare_data,
+                        FsearchThreadPool *pool);
+
+void
+fsearch_array_merge_free(FsearchArrayMerge *merge);
+
+DynamicArray *
+fsearch_array_merge_get_first(FsearchArrayMerge *merge);
+
+DynamicArray *
+fsearch_array_merge_get_second(FsearchArrayMerge *merge);
+
+uint32_t
+fsearch_array_merge_get_num_items(FsearchArrayMerge *merge);
+
+size_t
+fsearch_array_merge_get_memory_usage(FsearchArrayMerge *merge);
+
+// Returns the item at idx of the merged array, NULL if it's out of range
+void *
+fsearch_array_merge_get_item(FsearchArrayMerge *merge, uint32_t idx);
+
+// Stores the items [start, start + num_items) of the merged array in items, which is faster than looking them up one
+// by one. Returns how many of them there are.
+uint32_t
+fsearch_array_merge_get_items(FsearchArrayMerge *merge, uint32_t start, uint32_t num_items, void **items);
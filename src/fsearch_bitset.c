@@ -0,0 +1,358 @@
+#define G_LOG_DOMAIN "fsearch-bitset"
+
+#include "fsearch_bitset.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BITSET_CONTAINER_SIZE 65536
+#define BITSET_BITMAP_NUM_WORDS (BITSET_CONTAINER_SIZE / 64)
+// An array of this many members takes as much memory as a bitmap
+#define BITSET_MAX_ARRAY_CARDINALITY 4096
+// Bitmaps only turn back into arrays well below the limit, so toggling a single member doesn't convert
+// the container back and forth all the time
+#define BITSET_MIN_BITMAP_CARDINALITY (BITSET_MAX_ARRAY_CARDINALITY / 2)
+
+typedef struct {
+    // the upper 16 bits of all members
+    uint16_t key;
+    uint32_t cardinality;
+    // the lower 16 bits of the members in ascending order, if bitmap is NULL
+    uint16_t *array;
+    uint32_t capacity;
+    uint64_t *bitmap;
+} FsearchBitsetContainer;
+
+struct FsearchBitset {
+    // sorted by key
+    GArray *containers;
+};
+
+static void
+container_clear(FsearchBitsetContainer *c) {
+    g_clear_pointer(&c->array, free);
+    g_clear_pointer(&c->bitmap, free);
+}
+
+static void
+container_convert_to_bitmap(FsearchBitsetContainer *c) {
+    c->bitmap = calloc(BITSET_BITMAP_NUM_WORDS, sizeof(uint64_t));
+    g_assert(c->bitmap);
+    for (uint32_t i = 0; i < c->cardinality; i++) {
+        c->bitmap[c->array[i] / 64] |= UINT64_C(1) << (c->array[i] % 64);
+    }
+    g_clear_pointer(&c->array, free);
+    c->capacity = 0;
+}
+
+static void
+container_convert_to_array(FsearchBitsetContainer *c) {
+    c->capacity = MAX(c->cardinality, 4);
+    c->array = malloc(c->capacity * sizeof(uint16_t));
+    g_assert(c->array);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < BITSET_BITMAP_NUM_WORDS; i++) {
+        uint64_t word = c->bitmap[i];
+        while (word) {
+            c->array[n++] = (uint16_t)(i * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    g_clear_pointer(&c->bitmap, free);
+}
+
+// Returns the position of the first array member which isn't smaller than low
+static uint32_t
+container_array_lower_bound(const FsearchBitsetContainer *c, uint16_t low) {
+    uint32_t left = 0;
+    uint32_t right = c->cardinality;
+    while (left < right) {
+        const uint32_t mid = left + (right - left) / 2;
+        if (c->array[mid] < low) {
+            left = mid + 1;
+        }
+        else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+static bool
+container_contains(const FsearchBitsetContainer *c, uint16_t low) {
+    if (c->bitmap) {
+        return c->bitmap[low / 64] & (UINT64_C(1) << (low % 64));
+    }
+    const uint32_t pos = container_array_lower_bound(c, low);
+    return pos < c->cardinality && c->array[pos] == low;
+}
+
+static bool
+container_add(FsearchBitsetContainer *c, uint16_t low) {
+    if (c->bitmap) {
+        const uint64_t bit = UINT64_C(1) << (low % 64);
+        if (c->bitmap[low / 64] & bit) {
+            return false;
+        }
+        c->bitmap[low / 64] |= bit;
+        c->cardinality++;
+        return true;
+    }
+
+    const uint32_t pos = container_array_lower_bound(c, low);
+    if (pos < c->cardinality && c->array[pos] == low) {
+        return false;
+    }
+    if (c->cardinality == BITSET_MAX_ARRAY_CARDINALITY) {
+        container_convert_to_bitmap(c);
+        return container_add(c, low);
+    }
+    if (c->cardinality == c->capacity) {
+        c->capacity = MAX(c->capacity * 2, 4);
+        c->array = realloc(c->array, c->capacity * sizeof(uint16_t));
+        g_assert(c->array);
+    }
+    memmove(c->array + pos + 1, c->array + pos, (c->cardinality - pos) * sizeof(uint16_t));
+    c->array[pos] = low;
+    c->cardinality++;
+    return true;
+}
+
+static bool
+container_remove(FsearchBitsetContainer *c, uint16_t low) {
+    if (c->bitmap) {
+        const uint64_t bit = UINT64_C(1) << (low % 64);
+        if (!(c->bitmap[low / 64] & bit)) {
+            return false;
+        }
+        c->bitmap[low / 64] &= ~bit;
+        c->cardinality--;
+        if (c->cardinality < BITSET_MIN_BITMAP_CARDINALITY) {
+            container_convert_to_array(c);
+        }
+        return true;
+    }
+
+    const uint32_t pos = container_array_lower_bound(c, low);
+    if (pos == c->cardinality || c->array[pos] != low) {
+        return false;
+    }
+    memmove(c->array + pos, c->array + pos + 1, (c->cardinality - pos - 1) * sizeof(uint16_t));
+    c->cardinality--;
+    return true;
+}
+
+// Sets or toggles the bits in [start, end) of a bitmap container
+static void
+container_bitmap_apply_range(FsearchBitsetContainer *c, uint32_t start, uint32_t end, bool toggle) {
+    for (uint32_t i = start; i < end;) {
+        const uint32_t bit = i % 64;
+        const uint32_t n = MIN(64 - bit, end - i);
+        const uint64_t mask = (n == 64 ? UINT64_MAX : (UINT64_C(1) << n) - 1) << bit;
+        if (toggle) {
+            c->bitmap[i / 64] ^= mask;
+        }
+        else {
+            c->bitmap[i / 64] |= mask;
+        }
+        i += n;
+    }
+    uint32_t cardinality = 0;
+    for (uint32_t i = 0; i < BITSET_BITMAP_NUM_WORDS; i++) {
+        cardinality += __builtin_popcountll(c->bitmap[i]);
+    }
+    c->cardinality = cardinality;
+    if (c->cardinality < BITSET_MIN_BITMAP_CARDINALITY) {
+        container_convert_to_array(c);
+    }
+}
+
+static void
+container_apply_range(FsearchBitsetContainer *c, uint32_t start, uint32_t end, bool toggle) {
+    if (!c->bitmap && c->cardinality + (end - start) > BITSET_MAX_ARRAY_CARDINALITY) {
+        container_convert_to_bitmap(c);
+    }
+    if (c->bitmap) {
+        container_bitmap_apply_range(c, start, end, toggle);
+        return;
+    }
+    for (uint32_t i = start; i < end; i++) {
+        if (!toggle || !container_remove(c, (uint16_t)i)) {
+            container_add(c, (uint16_t)i);
+        }
+    }
+}
+
+// Returns true if there's a container for key, *pos is set to its position then, otherwise to the
+// position where it would have to be inserted
+static bool
+find_container(const FsearchBitset *set, uint16_t key, uint32_t *pos) {
+    const FsearchBitsetContainer *containers = (const FsearchBitsetContainer *)set->containers->data;
+    uint32_t left = 0;
+    uint32_t right = set->containers->len;
+    while (left < right) {
+        const uint32_t mid = left + (right - left) / 2;
+        if (containers[mid].key < key) {
+            left = mid + 1;
+        }
+        else {
+            right = mid;
+        }
+    }
+    *pos = left;
+    return left < set->containers->len && containers[left].key == key;
+}
+
+static FsearchBitsetContainer *
+get_or_add_container(FsearchBitset *set, uint16_t key, uint32_t *pos) {
+    if (!find_container(set, key, pos)) {
+        FsearchBitsetContainer c = {.key = key};
+        g_array_insert_val(set->containers, *pos, c);
+    }
+    return &g_array_index(set->containers, FsearchBitsetContainer, *pos);
+}
+
+static void
+remove_container_if_empty(FsearchBitset *set, uint32_t pos) {
+    FsearchBitsetContainer *c = &g_array_index(set->containers, FsearchBitsetContainer, pos);
+    if (c->cardinality == 0) {
+        container_clear(c);
+        g_array_remove_index(set->containers, pos);
+    }
+}
+
+FsearchBitset *
+fsearch_bitset_new(void) {
+    FsearchBitset *set = calloc(1, sizeof(FsearchBitset));
+    g_assert(set);
+    set->containers = g_array_new(FALSE, FALSE, sizeof(FsearchBitsetContainer));
+    return set;
+}
+
+void
+fsearch_bitset_free(FsearchBitset *set) {
+    if (!set) {
+        return;
+    }
+    fsearch_bitset_clear(set);
+    g_clear_pointer(&set->containers, g_array_unref);
+    g_clear_pointer(&set, free);
+}
+
+bool
+fsearch_bitset_add(FsearchBitset *set, uint32_t value) {
+    g_assert(set);
+    uint32_t pos = 0;
+    return container_add(get_or_add_container(set, value >> 16, &pos), value & 0xffff);
+}
+
+bool
+fsearch_bitset_remove(FsearchBitset *set, uint32_t value) {
+    g_assert(set);
+    uint32_t pos = 0;
+    if (!find_container(set, value >> 16, &pos)) {
+        return false;
+    }
+    const bool removed = container_remove(&g_array_index(set->containers, FsearchBitsetContainer, pos), value & 0xffff);
+    remove_container_if_empty(set, pos);
+    return removed;
+}
+
+void
+fsearch_bitset_toggle(FsearchBitset *set, uint32_t value) {
+    if (!fsearch_bitset_remove(set, value)) {
+        fsearch_bitset_add(set, value);
+    }
+}
+
+bool
+fsearch_bitset_contains(const FsearchBitset *set, uint32_t value) {
+    g_assert(set);
+    uint32_t pos = 0;
+    if (!find_container(set, value >> 16, &pos)) {
+        return false;
+    }
+    return container_contains(&g_array_index(set->containers, FsearchBitsetContainer, pos), value & 0xffff);
+}
+
+static void
+apply_range(FsearchBitset *set, uint32_t start, uint32_t end, bool toggle) {
+    g_assert(set);
+    if (start >= end) {
+        return;
+    }
+    const uint32_t first_key = start >> 16;
+    const uint32_t last_key = (end - 1) >> 16;
+    for (uint32_t key = first_key; key <= last_key; key++) {
+        const uint32_t container_start = key == first_key ? start & 0xffff : 0;
+        const uint32_t container_end = key == last_key ? ((end - 1) & 0xffff) + 1 : BITSET_CONTAINER_SIZE;
+        uint32_t pos = 0;
+        FsearchBitsetContainer *c = get_or_add_container(set, key, &pos);
+        container_apply_range(c, container_start, container_end, toggle);
+        remove_container_if_empty(set, pos);
+    }
+}
+
+void
+fsearch_bitset_add_range(FsearchBitset *set, uint32_t start, uint32_t end) {
+    apply_range(set, start, end, false);
+}
+
+void
+fsearch_bitset_toggle_range(FsearchBitset *set, uint32_t start, uint32_t end) {
+    apply_range(set, start, end, true);
+}
+
+void
+fsearch_bitset_clear(FsearchBitset *set) {
+    g_assert(set);
+    for (uint32_t i = 0; i < set->containers->len; i++) {
+        container_clear(&g_array_index(set->containers, FsearchBitsetContainer, i));
+    }
+    g_array_set_size(set->containers, 0);
+}
+
+uint32_t
+fsearch_bitset_get_cardinality(const FsearchBitset *set) {
+    g_assert(set);
+    uint32_t cardinality = 0;
+    for (uint32_t i = 0; i < set->containers->len; i++) {
+        cardinality += g_array_index(set->containers, FsearchBitsetContainer, i).cardinality;
+    }
+    return cardinality;
+}
+
+size_t
+fsearch_bitset_get_memory_usage(const FsearchBitset *set) {
+    g_assert(set);
+    size_t size = sizeof(FsearchBitset) + set->containers->len * sizeof(FsearchBitsetContainer);
+    for (uint32_t i = 0; i < set->containers->len; i++) {
+        const FsearchBitsetContainer *c = &g_array_index(set->containers, FsearchBitsetContainer, i);
+        size += c->bitmap ? BITSET_BITMAP_NUM_WORDS * sizeof(uint64_t) : c->capacity * sizeof(uint16_t);
+    }
+    return size;
+}
+
+void
+fsearch_bitset_for_each(const FsearchBitset *set, FsearchBitsetForEachFunc func, void *user_data) {
+    g_assert(set);
+    g_assert(func);
+    for (uint32_t i = 0; i < set->containers->len; i++) {
+        const FsearchBitsetContainer *c = &g_array_index(set->containers, FsearchBitsetContainer, i);
+        const uint32_t base = (uint32_t)c->key << 16;
+        if (!c->bitmap) {
+            for (uint32_t j = 0; j < c->cardinality; j++) {
+                func(base | c->array[j], user_data);
+            }
+            continue;
+        }
+        for (uint32_t j = 0; j < BITSET_BITMAP_NUM_WORDS; j++) {
+            uint64_t word = c->bitmap[j];
+            while (word) {
+                func(base + j * 64 + __builtin_ctzll(word), user_data);
+                word &= word - 1;
+            }
+        }
+    }
+}
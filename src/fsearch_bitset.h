@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A compressed set of 32 bit numbers. The numbers are grouped by their upper 16 bits and each group
+// is stored in its own container: a sorted array of the lower 16 bits while it has only a few
+// members, a bitmap of all 65536 possible members once that takes less memory. This way sparse sets
+// of e.g. selected entries cost a few bytes per member and dense ones a single bit.
+typedef struct FsearchBitset FsearchBitset;
+
+typedef void (*FsearchBitsetForEachFunc)(uint32_t value, void *user_data);
+
+FsearchBitset *
+fsearch_bitset_new(void);
+
+void
+fsearch_bitset_free(FsearchBitset *set);
+
+// Returns true if value wasn't part of set yet
+bool
+fsearch_bitset_add(FsearchBitset *set, uint32_t value);
+
+// Returns true if value was part of set
+bool
+fsearch_bitset_remove(FsearchBitset *set, uint32_t value);
+
+// Adds value if it's not part of set, otherwise removes it
+void
+fsearch_bitset_toggle(FsearchBitset *set, uint32_t value);
+
+bool
+fsearch_bitset_contains(const FsearchBitset *set, uint32_t value);
+
+// Adds all values in [start, end)
+void
+fsearch_bitset_add_range(FsearchBitset *set, uint32_t start, uint32_t end);
+
+// Toggles all values in [start, end)
+void
+fsearch_bitset_toggle_range(FsearchBitset *set, uint32_t start, uint32_t end);
+
+void
+fsearch_bitset_clear(FsearchBitset *set);
+
+uint32_t
+fsearch_bitset_get_cardinality(const FsearchBitset *set);
+
+// Returns the number of bytes allocated for the containers of set
+size_t
+fsearch_bitset_get_memory_usage(const FsearchBitset *set);
+
+// Calls func for every value of set in ascending order, set must not be modified meanwhile
+void
+fsearch_bitset_for_each(const FsearchBitset *set, FsearchBitsetForEachFunc func, void *user_data);
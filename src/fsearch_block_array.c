@@ -0,0 +1,383 @@
+#define G_LOG_DOMAIN "fsearch-block-array"
+
+#include "fsearch_block_array.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_ARRAY_BLOCK_SIZE 512
+// New blocks are only filled this far, so the first few insertions don't split them right away
+#define BLOCK_ARRAY_BLOCK_FILL (BLOCK_ARRAY_BLOCK_SIZE * 3 / 4)
+// Blocks with fewer items get merged with one of their neighbours, if the result isn't fuller than a new block
+#define BLOCK_ARRAY_BLOCK_MIN (BLOCK_ARRAY_BLOCK_SIZE / 4)
+
+typedef struct {
+    uint32_t num_items;
+    void *items[BLOCK_ARRAY_BLOCK_SIZE];
+} FsearchBlockArrayBlock;
+
+struct FsearchBlockArray {
+    FsearchBlockArrayBlock **blocks;
+    uint32_t num_blocks;
+    uint32_t max_blocks;
+    // Fenwick tree of the number of items in every block (1-based), used to find the block of a position.
+    // It's rebuilt whenever blocks get added or removed, which only happens every few hundred modifications.
+    uint32_t *block_counts;
+
+    uint32_t num_items;
+
+    DynamicArrayCompareDataFunc comp_func;
+    void *data;
+};
+
+static void
+block_counts_rebuild(FsearchBlockArray *array) {
+    memset(array->block_counts, 0, (array->num_blocks + 1) * sizeof(uint32_t));
+    for (uint32_t i = 1; i <= array->num_blocks; i++) {
+        array->block_counts[i] += array->blocks[i - 1]->num_items;
+        const uint32_t parent = i + (i & -i);
+        if (parent <= array->num_blocks) {
+            array->block_counts[parent] += array->block_counts[i];
+        }
+    }
+}
+
+static void
+block_counts_add(FsearchBlockArray *array, uint32_t block_idx, int32_t diff) {
+    for (uint32_t i = block_idx + 1; i <= array->num_blocks; i += i & -i) {
+        array->block_counts[i] += diff;
+    }
+}
+
+// Number of items in the blocks in front of block_idx
+static uint32_t
+block_counts_get_start(FsearchBlockArray *array, uint32_t block_idx) {
+    uint32_t start = 0;
+    for (uint32_t i = block_idx; i > 0; i -= i & -i) {
+        start += array->block_counts[i];
+    }
+    return start;
+}
+
+// Returns the block which holds the item at position idx and sets idx to its position in that block
+static uint32_t
+block_counts_find(FsearchBlockArray *array, uint32_t *idx) {
+    uint32_t step = 1;
+    while (step * 2 <= array->num_blocks) {
+        step *= 2;
+    }
+    uint32_t block_idx = 0;
+    uint32_t remaining = *idx;
+    for (; step > 0; step /= 2) {
+        const uint32_t next = block_idx + step;
+        if (next <= array->num_blocks && array->block_counts[next] <= remaining) {
+            block_idx = next;
+            remaining -= array->block_counts[next];
+        }
+    }
+    *idx = remaining;
+    return block_idx;
+}
+
+static FsearchBlockArrayBlock *
+block_array_add_block(FsearchBlockArray *array, uint32_t block_idx) {
+    if (array->num_blocks == array->max_blocks) {
+        array->max_blocks = MAX(array->max_blocks * 2, 16);
+        array->blocks = realloc(array->blocks, array->max_blocks * sizeof(FsearchBlockArrayBlock *));
+        array->block_counts = realloc(array->block_counts, (array->max_blocks + 1) * sizeof(uint32_t));
+        g_assert(array->blocks);
+        g_assert(array->block_counts);
+    }
+    FsearchBlockArrayBlock *block = calloc(1, sizeof(FsearchBlockArrayBlock));
+    g_assert(block);
+    memmove(array->blocks + block_idx + 1,
+            array->blocks + block_idx,
+            (array->num_blocks - block_idx) * sizeof(FsearchBlockArrayBlock *));
+    array->blocks[block_idx] = block;
+    array->num_blocks++;
+    return block;
+}
+
+static void
+block_array_remove_block(FsearchBlockArray *array, uint32_t block_idx) {
+    g_clear_pointer(&array->blocks[block_idx], free);
+    memmove(array->blocks + block_idx,
+            array->blocks + block_idx + 1,
+            (array->num_blocks - block_idx - 1) * sizeof(FsearchBlockArrayBlock *));
+    array->num_blocks--;
+}
+
+// Moves the upper half of a full block into a new block behind it
+static void
+block_array_split_block(FsearchBlockArray *array, uint32_t block_idx) {
+    FsearchBlockArrayBlock *next = block_array_add_block(array, block_idx + 1);
+    FsearchBlockArrayBlock *block = array->blocks[block_idx];
+    const uint32_t half = block->num_items / 2;
+    next->num_items = block->num_items - half;
+    memcpy(next->items, block->items + half, next->num_items * sizeof(void *));
+    block->num_items = half;
+    block_counts_rebuild(array);
+}
+
+static void
+block_array_merge_blocks(FsearchBlockArray *array, uint32_t block_idx) {
+    FsearchBlockArrayBlock *block = array->blocks[block_idx];
+    FsearchBlockArrayBlock *next = array->blocks[block_idx + 1];
+    memcpy(block->items + block->num_items, next->items, next->num_items * sizeof(void *));
+    block->num_items += next->num_items;
+    block_array_remove_block(array, block_idx + 1);
+    block_counts_rebuild(array);
+}
+
+// Returns the first block whose last item compares greater (or greater or equal, if upper is false) than item.
+// That's num_blocks if there's none.
+static uint32_t
+block_array_find_block(FsearchBlockArray *array, void *item, bool upper) {
+    uint32_t lo = 0;
+    uint32_t hi = array->num_blocks;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        FsearchBlockArrayBlock *block = array->blocks[mid];
+        const int32_t res = array->comp_func(&block->items[block->num_items - 1], &item, array->data);
+        if (upper ? res > 0 : res >= 0) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+// Like block_array_find_block, but for the items of a single block
+static uint32_t
+block_array_find_in_block(FsearchBlockArray *array, FsearchBlockArrayBlock *block, void *item, bool upper) {
+    uint32_t lo = 0;
+    uint32_t hi = block->num_items;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        const int32_t res = array->comp_func(&block->items[mid], &item, array->data);
+        if (upper ? res > 0 : res >= 0) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+// Finds the position of item itself, not only of an item which compares equal
+static bool
+block_array_find_item(FsearchBlockArray *array, void *item, uint32_t *block_idx, uint32_t *item_idx) {
+    for (uint32_t b = block_array_find_block(array, item, false); b < array->num_blocks; b++) {
+        FsearchBlockArrayBlock *block = array->blocks[b];
+        for (uint32_t i = block_array_find_in_block(array, block, item, false); i < block->num_items; i++) {
+            if (block->items[i] == item) {
+                *block_idx = b;
+                *item_idx = i;
+                return true;
+            }
+            if (array->comp_func(&block->items[i], &item, array->data) != 0) {
+                goto not_found;
+            }
+        }
+    }
+
+not_found:
+    // The order of the array doesn't match comp_func (e.g. because the items changed in the meantime),
+    // the only way to find the item is to look at all of them.
+    for (uint32_t b = 0; b < array->num_blocks; b++) {
+        FsearchBlockArrayBlock *block = array->blocks[b];
+        for (uint32_t i = 0; i < block->num_items; i++) {
+            if (block->items[i] == item) {
+                g_debug("item isn't where it's supposed to be, the array might not be sorted");
+                *block_idx = b;
+                *item_idx = i;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+FsearchBlockArray *
+fsearch_block_array_new(DynamicArray *items, DynamicArrayCompareDataFunc comp_func, void *data) {
+    g_assert(comp_func);
+
+    FsearchBlockArray *array = calloc(1, sizeof(FsearchBlockArray));
+    g_assert(array);
+    array->comp_func = comp_func;
+    array->data = data;
+
+    const uint32_t num_items = items ? darray_get_num_items(items) : 0;
+    array->max_blocks = MAX(num_items / BLOCK_ARRAY_BLOCK_FILL + 1, 16);
+    array->blocks = calloc(array->max_blocks, sizeof(FsearchBlockArrayBlock *));
+    array->block_counts = calloc(array->max_blocks + 1, sizeof(uint32_t));
+    g_assert(array->blocks);
+    g_assert(array->block_counts);
+
+    FsearchBlockArrayBlock *block = NULL;
+    for (uint32_t i = 0; i < num_items; i++) {
+        void *item = darray_get_item(items, i);
+        if (!item) {
+            continue;
+        }
+        if (!block || block->num_items == BLOCK_ARRAY_BLOCK_FILL) {
+            block = block_array_add_block(array, array->num_blocks);
+        }
+        block->items[block->num_items++] = item;
+        array->num_items++;
+    }
+    block_counts_rebuild(array);
+
+    return array;
+}
+
+void
+fsearch_block_array_free(FsearchBlockArray *array) {
+    if (!array) {
+        return;
+    }
+    for (uint32_t i = 0; i < array->num_blocks; i++) {
+        g_clear_pointer(&array->blocks[i], free);
+    }
+    g_clear_pointer(&array->blocks, free);
+    g_clear_pointer(&array->block_counts, free);
+    g_clear_pointer(&array, free);
+}
+
+uint32_t
+fsearch_block_array_get_num_items(FsearchBlockArray *array) {
+    g_assert(array);
+    return array->num_items;
+}
+
+void *
+fsearch_block_array_get_item(FsearchBlockArray *array, uint32_t idx) {
+    g_assert(array);
+    if (idx >= array->num_items) {
+        return NULL;
+    }
+    const uint32_t block_idx = block_counts_find(array, &idx);
+    return array->blocks[block_idx]->items[idx];
+}
+
+uint32_t
+fsearch_block_array_get_items(FsearchBlockArray *array, uint32_t start, uint32_t num_items, void **dest) {
+    g_assert(array);
+    g_assert(dest);
+    if (start >= array->num_items) {
+        return 0;
+    }
+    num_items = MIN(num_items, array->num_items - start);
+
+    uint32_t item_idx = start;
+    uint32_t num_copied = 0;
+    for (uint32_t b = block_counts_find(array, &item_idx); num_copied < num_items; b++, item_idx = 0) {
+        FsearchBlockArrayBlock *block = array->blocks[b];
+        const uint32_t n = MIN(block->num_items - item_idx, num_items - num_copied);
+        memcpy(dest + num_copied, block->items + item_idx, n * sizeof(void *));
+        num_copied += n;
+    }
+    return num_copied;
+}
+
+bool
+fsearch_block_array_get_item_idx(FsearchBlockArray *array, void *item, uint32_t *idx) {
+    g_assert(array);
+    uint32_t block_idx = 0;
+    uint32_t item_idx = 0;
+    if (!block_array_find_item(array, item, &block_idx, &item_idx)) {
+        return false;
+    }
+    if (idx) {
+        *idx = block_counts_get_start(array, block_idx) + item_idx;
+    }
+    return true;
+}
+
+void
+fsearch_block_array_insert(FsearchBlockArray *array, void *item) {
+    g_assert(array);
+    uint32_t block_idx = 0;
+    if (array->num_blocks == 0) {
+        block_array_add_block(array, 0);
+        block_counts_rebuild(array);
+    }
+    else {
+        block_idx = block_array_find_block(array, item, true);
+        if (block_idx == array->num_blocks) {
+            // item is greater than all others, append it to the last block
+            block_idx--;
+        }
+    }
+    FsearchBlockArrayBlock *block = array->blocks[block_idx];
+    uint32_t item_idx = block_array_find_in_block(array, block, item, true);
+    if (block->num_items == BLOCK_ARRAY_BLOCK_SIZE) {
+        block_array_split_block(array, block_idx);
+        if (item_idx > block->num_items) {
+            item_idx -= block->num_items;
+            block_idx++;
+            block = array->blocks[block_idx];
+        }
+    }
+
+    memmove(block->items + item_idx + 1, block->items + item_idx, (block->num_items - item_idx) * sizeof(void *));
+    block->items[item_idx] = item;
+    block->num_items++;
+    array->num_items++;
+    block_counts_add(array, block_idx, 1);
+}
+
+bool
+fsearch_block_array_remove(FsearchBlockArray *array, void *item) {
+    g_assert(array);
+    uint32_t block_idx = 0;
+    uint32_t item_idx = 0;
+    if (!block_array_find_item(array, item, &block_idx, &item_idx)) {
+        return false;
+    }
+
+    FsearchBlockArrayBlock *block = array->blocks[block_idx];
+    memmove(block->items + item_idx, block->items + item_idx + 1, (block->num_items - item_idx - 1) * sizeof(void *));
+    block->num_items--;
+    array->num_items--;
+
+    if (block->num_items == 0) {
+        block_array_remove_block(array, block_idx);
+        block_counts_rebuild(array);
+    }
+    else if (block->num_items < BLOCK_ARRAY_BLOCK_MIN && block_idx + 1 < array->num_blocks
+             && block->num_items + array->blocks[block_idx + 1]->num_items <= BLOCK_ARRAY_BLOCK_FILL) {
+        block_array_merge_blocks(array, block_idx);
+    }
+    else if (block->num_items < BLOCK_ARRAY_BLOCK_MIN && block_idx > 0
+             && block->num_items + array->blocks[block_idx - 1]->num_items <= BLOCK_ARRAY_BLOCK_FILL) {
+        block_array_merge_blocks(array, block_idx - 1);
+    }
+    else {
+        block_counts_add(array, block_idx, -1);
+    }
+    return true;
+}
+
+DynamicArray *
+fsearch_block_array_to_darray(FsearchBlockArray *array) {
+    g_assert(array);
+    DynamicArray *items = darray_new(array->num_items + 1);
+    for (uint32_t i = 0; i < array->num_blocks; i++) {
+        darray_add_items(items, array->blocks[i]->items, array->blocks[i]->num_items);
+    }
+    return items;
+}
+
+size_t
+fsearch_block_array_get_memory_usage(FsearchBlockArray *array) {
+    if (!array) {
+        return 0;
+    }
+    return sizeof(FsearchBlockArray) + array->num_blocks * sizeof(FsearchBlockArrayBlock)
+         + array->max_blocks * (sizeof(FsearchBlockArrayBlock *) + sizeof(uint32_t));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+
+// A sorted sequence of items, which is stored in blocks of up to a few hundred items. Items get inserted into or
+// removed from a single block, so unlike with a sorted DynamicArray that doesn't move all items behind them.
+// A tree of the number of items in every block finds the block of a position, so the items can still be accessed
+// by their position in O(log n).
+typedef struct FsearchBlockArray FsearchBlockArray;
+
+// items must be sorted by comp_func already, it can be NULL to create an empty array. comp_func must define a
+// total order: only the same items may compare equal, otherwise removing items gets slow.
+FsearchBlockArray *
+fsearch_block_array_new(DynamicArray *items, DynamicArrayCompareDataFunc comp_func, void *data);
+
+void
+fsearch_block_array_free(FsearchBlockArray *array);
+
+uint32_t
+fsearch_block_array_get_num_items(FsearchBlockArray *array);
+
+void *
+fsearch_block_array_get_item(FsearchBlockArray *array, uint32_t idx);
+
+// Copies up to num_items items, starting with the one at position start, to dest. Returns the number of copied items.
+uint32_t
+fsearch_block_array_get_items(FsearchBlockArray *array, uint32_t start, uint32_t num_items, void **dest);
+
+// Returns true if item is part of array, idx is set to its position then
+bool
+fsearch_block_array_get_item_idx(FsearchBlockArray *array, void *item, uint32_t *idx);
+
+// Inserts item behind all items which don't compare greater
+void
+fsearch_block_array_insert(FsearchBlockArray *array, void *item);
+
+// Returns true if item was part of array
+bool
+fsearch_block_array_remove(FsearchBlockArray *array, void *item);
+
+// Returns a new DynamicArray with all items in order
+DynamicArray *
+fsearch_block_array_to_darray(FsearchBlockArray *array);
+
+// Returns the number of bytes allocated for the blocks of array
+size_t
+fsearch_block_array_get_memory_usage(FsearchBlockArray *array);
@@ -0,0 +1,1261 @@
+#define G_LOG_DOMAIN "fsearch-cli"
+
+#include <config.h>
+
+#include "fsearch_cli.h"
+#include "fsearch.h"
+#include "fsearch_daemon.h"
+#include "fsearch_database_search.h"
+
+#include <errno.h>
+#include <gio/gunixfdlist.h>
+#include <glib/gi18n.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CLI_DBUS_IFACE "io.github.cboxdoerfer.FSearch.Search"
+// the paths are written in pieces of about this size
+#define CLI_WRITE_BUFFER_SIZE (64 * 1024)
+// the rows which are sent with one Results signal or pushed to a merger at once
+#define CLI_ROWS_PER_BATCH 1024
+
+static const char *cli_introspection_xml = "<node>"
+                                           "  <interface name='" CLI_DBUS_IFACE "'>"
+                                           "    <method name='Search'>"
+                                           "      <arg type='a{sv}' name='options' direction='in'/>"
+                                           "      <arg type='h' name='fd' direction='in'/>"
+                                           "      <arg type='u' name='num_results' direction='out'/>"
+                                           "    </method>"
+                                           "    <method name='SearchStream'>"
+                                           "      <arg type='a{sv}' name='options' direction='in'/>"
+                                           "      <arg type='u' name='num_results' direction='out'/>"
+                                           "    </method>"
+                                           "    <signal name='Results'>"
+                                           "      <arg type='a(bst)' name='rows'/>"
+                                           "    </signal>"
+                                           "  </interface>"
+                                           "</node>";
+
+static const struct {
+    const char *name;
+    FsearchDatabaseIndexType sort_order;
+} cli_sort_orders[] = {
+    {"name", DATABASE_INDEX_TYPE_NAME},
+    {"path", DATABASE_INDEX_TYPE_PATH},
+    {"size", DATABASE_INDEX_TYPE_SIZE},
+    {"modified", DATABASE_INDEX_TYPE_MODIFICATION_TIME},
+    {"accessed", DATABASE_INDEX_TYPE_ACCESS_TIME},
+    {"created", DATABASE_INDEX_TYPE_CREATION_TIME},
+    {"changed", DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME},
+    {"type", DATABASE_INDEX_TYPE_FILETYPE},
+    {"extension", DATABASE_INDEX_TYPE_EXTENSION},
+    {"owner", DATABASE_INDEX_TYPE_OWNER},
+    {"relevance", DATABASE_INDEX_TYPE_RELEVANCE},
+};
+
+static const char *
+get_sort_name(FsearchDatabaseIndexType sort_order) {
+    for (uint32_t i = 0; i < G_N_ELEMENTS(cli_sort_orders); i++) {
+        if (cli_sort_orders[i].sort_order == sort_order) {
+            return cli_sort_orders[i].name;
+        }
+    }
+    return cli_sort_orders[0].name;
+}
+
+static bool
+get_sort_order_for_name(const char *name, FsearchDatabaseIndexType *sort_order) {
+    for (uint32_t i = 0; i < G_N_ELEMENTS(cli_sort_orders); i++) {
+        if (!g_ascii_strcasecmp(cli_sort_orders[i].name, name)) {
+            *sort_order = cli_sort_orders[i].sort_order;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+fsearch_cli_search_init(FsearchCliSearch *search, GVariantDict *options, GError **error) {
+    g_assert(search);
+    g_assert(options);
+
+    memset(search, 0, sizeof(FsearchCliSearch));
+
+    const char *search_term = NULL;
+    g_variant_dict_lookup(options, "search", "&s", &search_term);
+    search->search_term = g_strdup(search_term ? search_term : "");
+
+    const char *filter_name = NULL;
+    if (g_variant_dict_lookup(options, "filter", "&s", &filter_name)) {
+        search->filter_name = g_strdup(filter_name);
+    }
+
+    search->sort_order = DATABASE_INDEX_TYPE_NAME;
+    const char *sort_name = NULL;
+    if (g_variant_dict_lookup(options, "sort", "&s", &sort_name)
+        && !get_sort_order_for_name(sort_name, &search->sort_order)) {
+        g_set_error(error,
+                    G_IO_ERROR,
+                    G_IO_ERROR_INVALID_ARGUMENT,
+                    _("Unknown sort order “%s”, use name, path, size, modified, accessed, created, changed, type, "
+                      "extension, owner or relevance"),
+                    sort_name);
+        return false;
+    }
+
+    gint32 limit = 0;
+    if (g_variant_dict_lookup(options, "limit", "i", &limit) && limit < 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, _("The limit must not be negative"));
+        return false;
+    }
+    search->max_results = (uint32_t)limit;
+    search->null_separated = g_variant_dict_contains(options, "null");
+
+    const char *group_by = NULL;
+    if (g_variant_dict_lookup(options, "group-by", "&s", &group_by)) {
+        if (!fsearch_aggregate_key_parse(group_by, &search->group_by, &search->group_depth)) {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        _("Unknown group “%s”, use extension, owner, folder or folder:DEPTH"),
+                        group_by);
+            return false;
+        }
+        search->has_group_by = true;
+        search->group_by_name = g_strdup(group_by);
+    }
+
+    guint32 flags = 0;
+    if (g_variant_dict_lookup(options, "flags", "u", &flags)) {
+        search->has_query_flags = true;
+        search->query_flags = flags;
+    }
+    const char *filter_query = NULL;
+    if (g_variant_dict_lookup(options, "filter_query", "&s", &filter_query)) {
+        search->filter_query = g_strdup(filter_query);
+        g_variant_dict_lookup(options, "filter_flags", "u", &flags);
+        search->filter_flags = flags;
+    }
+    return true;
+}
+
+void
+fsearch_cli_search_clear(FsearchCliSearch *search) {
+    g_assert(search);
+    g_clear_pointer(&search->search_term, g_free);
+    g_clear_pointer(&search->filter_name, g_free);
+    g_clear_pointer(&search->filter_query, g_free);
+    g_clear_pointer(&search->group_by_name, g_free);
+}
+
+// The same options the command line has, so fsearch_cli_search_init can read them in the other instance
+static GVariant *
+cli_search_to_variant(const FsearchCliSearch *search) {
+    g_autoptr(GVariantDict) options = g_variant_dict_new(NULL);
+    g_variant_dict_insert(options, "search", "s", search->search_term);
+    if (search->filter_name) {
+        g_variant_dict_insert(options, "filter", "s", search->filter_name);
+    }
+    g_variant_dict_insert(options, "sort", "s", get_sort_name(search->sort_order));
+    g_variant_dict_insert(options, "limit", "i", (gint32)search->max_results);
+    if (search->null_separated) {
+        g_variant_dict_insert(options, "null", "b", TRUE);
+    }
+    if (search->has_group_by) {
+        g_variant_dict_insert(options, "group-by", "s", search->group_by_name);
+    }
+    if (search->has_query_flags) {
+        g_variant_dict_insert(options, "flags", "u", (guint32)search->query_flags);
+    }
+    if (search->filter_query) {
+        g_variant_dict_insert(options, "filter_query", "s", search->filter_query);
+        g_variant_dict_insert(options, "filter_flags", "u", (guint32)search->filter_flags);
+    }
+    return g_variant_dict_end(options);
+}
+
+FsearchQuery *
+fsearch_cli_search_new_query(const FsearchCliSearch *search, FsearchConfig *config, GError **error) {
+    g_assert(search);
+    g_assert(config);
+
+    FsearchFilter *filter = NULL;
+    if (search->filter_query) {
+        filter = fsearch_filter_new(search->filter_name ? search->filter_name : "",
+                                    NULL,
+                                    search->filter_query,
+                                    search->filter_flags);
+    }
+    else if (search->filter_name) {
+        filter = fsearch_filter_manager_get_filter_for_name(config->filters, search->filter_name);
+        if (!filter) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("Unknown filter “%s”"), search->filter_name);
+            return NULL;
+        }
+    }
+    const FsearchQueryFlags flags = search->has_query_flags ? search->query_flags : config_get_query_flags(config);
+    FsearchQuery *query = fsearch_query_new(search->search_term, filter, config->filters, flags, "cli_query");
+    g_clear_pointer(&filter, fsearch_filter_unref);
+    return query;
+}
+
+typedef enum {
+    // the paths are written to fd
+    CLI_OUTPUT_FD,
+    // the rows are sent as Results signals to the caller of SearchStream
+    CLI_OUTPUT_SIGNAL,
+    // the rows are pushed to a merger of the same process
+    CLI_OUTPUT_MERGER,
+} CliOutput;
+
+typedef struct {
+    CliOutput output;
+    int fd;
+    // sockets are written with send, so a reader which went away doesn't raise SIGPIPE
+    bool is_socket;
+    GDBusConnection *connection;
+    // NULL on peer connections
+    const char *destination;
+    const char *object_path;
+    FsearchFederationMerger *merger;
+    uint32_t source;
+    // the rows which weren't sent or pushed yet
+    GArray *rows;
+    DynamicArrayKeyFunc key_func;
+    char separator;
+    FsearchFolderPaths *folder_paths;
+    GString *buffer;
+    // the results of the array which is searched at the moment which were written already
+    uint32_t num_written;
+    bool searching_folders;
+    // cancels the search once writing failed
+    GCancellable *cancellable;
+    GError *error;
+} CliWriter;
+
+static void
+cli_writer_set_error(CliWriter *writer, GError *error) {
+    if (!writer->error) {
+        writer->error = error;
+    }
+    else {
+        g_error_free(error);
+    }
+    g_cancellable_cancel(writer->cancellable);
+}
+
+static void
+cli_writer_clear_rows(CliWriter *writer) {
+    for (uint32_t i = 0; i < writer->rows->len; i++) {
+        g_free(g_array_index(writer->rows, FsearchFederationRow, i).path);
+    }
+    g_array_set_size(writer->rows, 0);
+}
+
+static void
+cli_writer_flush_rows(CliWriter *writer) {
+    if (writer->rows->len == 0) {
+        return;
+    }
+    if (writer->error) {
+        cli_writer_clear_rows(writer);
+        return;
+    }
+    if (writer->output == CLI_OUTPUT_MERGER) {
+        // the merger takes over the paths
+        FsearchFederationRow *rows = (FsearchFederationRow *)writer->rows->data;
+        const bool pushed = fsearch_federation_merger_push(writer->merger, writer->source, rows, writer->rows->len);
+        g_array_set_size(writer->rows, 0);
+        if (!pushed) {
+            cli_writer_set_error(writer, g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "The search was cancelled"));
+        }
+        return;
+    }
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(bst)"));
+    for (uint32_t i = 0; i < writer->rows->len; i++) {
+        FsearchFederationRow *row = &g_array_index(writer->rows, FsearchFederationRow, i);
+        g_variant_builder_add(&builder, "(bst)", row->is_folder, row->path, (guint64)row->key);
+    }
+    cli_writer_clear_rows(writer);
+    GError *error = NULL;
+    if (!g_dbus_connection_emit_signal(writer->connection,
+                                       writer->destination,
+                                       writer->object_path,
+                                       CLI_DBUS_IFACE,
+                                       "Results",
+                                       g_variant_new("(a(bst))", &builder),
+                                       &error)) {
+        cli_writer_set_error(writer, error);
+    }
+}
+
+static void
+cli_writer_flush(CliWriter *writer) {
+    if (writer->output != CLI_OUTPUT_FD) {
+        cli_writer_flush_rows(writer);
+        return;
+    }
+    size_t offset = 0;
+    while (!writer->error && offset < writer->buffer->len) {
+        const char *data = writer->buffer->str + offset;
+        const size_t len = writer->buffer->len - offset;
+        const ssize_t written = writer->is_socket ? send(writer->fd, data, len, MSG_NOSIGNAL)
+                                                  : write(writer->fd, data, len);
+        if (written >= 0) {
+            offset += (size_t)written;
+        }
+        else if (errno != EINTR) {
+            const int error_code = errno;
+            cli_writer_set_error(writer,
+                                 g_error_new(G_IO_ERROR,
+                                             g_io_error_from_errno(error_code),
+                                             _("Failed to write the results: %s"),
+                                             g_strerror(error_code)));
+        }
+    }
+    g_string_truncate(writer->buffer, 0);
+}
+
+static void
+cli_writer_write_results(CliWriter *writer, DynamicArray *results, uint32_t num_results) {
+    for (uint32_t i = writer->num_written; i < num_results && !writer->error; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(results, i);
+        if (writer->output != CLI_OUTPUT_FD) {
+            g_string_truncate(writer->buffer, 0);
+            fsearch_folder_paths_append_full_path(writer->folder_paths, entry, writer->buffer);
+            FsearchFederationRow row = {
+                .path = g_strndup(writer->buffer->str, writer->buffer->len),
+                .key = writer->key_func ? writer->key_func(entry, NULL) : 0,
+                .is_folder = writer->searching_folders,
+            };
+            g_array_append_val(writer->rows, row);
+            if (writer->rows->len >= CLI_ROWS_PER_BATCH) {
+                cli_writer_flush(writer);
+            }
+            continue;
+        }
+        fsearch_folder_paths_append_full_path(writer->folder_paths, entry, writer->buffer);
+        g_string_append_c(writer->buffer, writer->separator);
+        if (writer->buffer->len >= CLI_WRITE_BUFFER_SIZE) {
+            cli_writer_flush(writer);
+        }
+    }
+    writer->num_written = MAX(writer->num_written, num_results);
+}
+
+// The results found so far are a prefix of the final ones, so they can be written right away
+static void
+cli_writer_on_search_progress(DynamicArray *folders, DynamicArray *files, void *user_data) {
+    CliWriter *writer = user_data;
+    DynamicArray *results = writer->searching_folders ? folders : files;
+    if (results) {
+        cli_writer_write_results(writer, results, darray_get_num_items(results));
+        cli_writer_flush(writer);
+    }
+}
+
+// Orders by integer attributes are merged by their sort keys
+static DynamicArrayKeyFunc
+get_sort_key_func(FsearchDatabaseIndexType sort_order) {
+    switch (sort_order) {
+    case DATABASE_INDEX_TYPE_SIZE:
+        return (DynamicArrayKeyFunc)db_entry_get_size_sort_key;
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_modification_time_sort_key;
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_access_time_sort_key;
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_creation_time_sort_key;
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_status_change_time_sort_key;
+    case DATABASE_INDEX_TYPE_OWNER:
+        return (DynamicArrayKeyFunc)db_entry_get_owner_sort_key;
+    default:
+        return NULL;
+    }
+}
+
+// Aggregates the files among the results and writes their groups to the fd of writer, the largest first
+static bool
+cli_search_run_grouped(const FsearchCliSearch *search,
+                       FsearchQuery *query,
+                       FsearchDatabase *db,
+                       CliWriter *writer_output,
+                       uint32_t *num_results,
+                       GError **error) {
+    if (num_results) {
+        *num_results = 0;
+    }
+    if (writer_output->output != CLI_OUTPUT_FD) {
+        // the groups of several databases can't be merged like their paths
+        g_set_error(error,
+                    G_IO_ERROR,
+                    G_IO_ERROR_NOT_SUPPORTED,
+                    _("Grouped results can only be printed for a single database"));
+        return false;
+    }
+
+    FsearchDatabaseSnapshot *snapshot = db_get_snapshot(db);
+    FsearchDatabaseIndexType sort_order = DATABASE_INDEX_TYPE_NAME;
+    DynamicArray *entries[2] = {NULL};
+    if (!db_snapshot_get_entries_sorted(snapshot, sort_order, &sort_order, &entries[0], &entries[1])) {
+        g_clear_pointer(&snapshot, db_snapshot_unref);
+        return true;
+    }
+    FsearchFolderPaths *folder_paths = db_snapshot_get_folder_paths(snapshot);
+
+    // the groups only count files, so the folders don't need to be searched
+    DynamicArray *files = NULL;
+    if (fsearch_query_matches_everything(query)) {
+        files = darray_ref(entries[1]);
+    }
+    else {
+        DynamicArray *empty = darray_new(0);
+        const DatabaseSearchLimit limit = {};
+        DatabaseSearchResult *result = db_search(query,
+                                                 db_get_thread_pool(db),
+                                                 empty,
+                                                 entries[1],
+                                                 db_snapshot_get_folder_trigram_index(snapshot),
+                                                 db_snapshot_get_file_trigram_index(snapshot),
+                                                 db_snapshot_get_folder_name_index(snapshot),
+                                                 db_snapshot_get_file_name_index(snapshot),
+                                                 db_snapshot_get_subtree_filter(snapshot),
+                                                 folder_paths,
+                                                 db_snapshot_get_folded_names(snapshot),
+                                                 &limit,
+                                                 sort_order,
+                                                 NULL,
+                                                 NULL,
+                                                 NULL);
+        if (result) {
+            files = g_steal_pointer(&result->files);
+            g_clear_pointer(&result->folders, darray_unref);
+            g_clear_pointer(&result, free);
+        }
+        g_clear_pointer(&empty, darray_unref);
+    }
+
+    GArray *groups =
+        fsearch_aggregate_entries(files, search->group_by, search->group_depth, folder_paths, db_get_thread_pool(db));
+    const uint32_t num_groups = search->max_results > 0 ? MIN(groups->len, search->max_results) : groups->len;
+
+    CliWriter writer = *writer_output;
+    writer.buffer = g_string_sized_new(CLI_WRITE_BUFFER_SIZE);
+    const char separator = search->null_separated ? '\0' : '\n';
+    for (uint32_t i = 0; i < num_groups && !writer.error; i++) {
+        FsearchAggregateGroup *group = &g_array_index(groups, FsearchAggregateGroup, i);
+        g_string_append_printf(writer.buffer,
+                               "%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%s",
+                               (guint64)group->size,
+                               (guint64)group->num_entries,
+                               group->name);
+        g_string_append_c(writer.buffer, separator);
+        if (writer.buffer->len >= CLI_WRITE_BUFFER_SIZE) {
+            cli_writer_flush(&writer);
+        }
+    }
+    cli_writer_flush(&writer);
+
+    g_clear_pointer(&groups, g_array_unref);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&entries[0], darray_unref);
+    g_clear_pointer(&entries[1], darray_unref);
+    g_clear_pointer(&snapshot, db_snapshot_unref);
+    g_string_free(g_steal_pointer(&writer.buffer), TRUE);
+
+    if (writer.error) {
+        g_propagate_error(error, writer.error);
+        return false;
+    }
+    if (num_results) {
+        *num_results = num_groups;
+    }
+    return true;
+}
+
+// Runs the search and hands the results to writer, whose output was set up by the caller
+static bool
+cli_search_run(const FsearchCliSearch *search,
+               FsearchQuery *query,
+               FsearchDatabase *db,
+               CliWriter *writer_output,
+               uint32_t *num_results,
+               GError **error) {
+    g_assert(search);
+    g_assert(query);
+    g_assert(db);
+
+    if (search->has_group_by) {
+        return cli_search_run_grouped(search, query, db, writer_output, num_results, error);
+    }
+
+    // the snapshot stays the same while the database gets updated, so it doesn't need to be locked
+    FsearchDatabaseSnapshot *snapshot = db_get_snapshot(db);
+    FsearchDatabaseIndexType sort_order = DATABASE_INDEX_TYPE_NAME;
+    DynamicArray *entries[2] = {NULL};
+    if (!db_snapshot_get_entries_sorted(snapshot, search->sort_order, &sort_order, &entries[0], &entries[1])) {
+        // the database is empty
+        g_clear_pointer(&snapshot, db_snapshot_unref);
+        if (num_results) {
+            *num_results = 0;
+        }
+        return true;
+    }
+    const bool by_relevance = search->sort_order == DATABASE_INDEX_TYPE_RELEVANCE;
+    if (by_relevance) {
+        // the scores are only known while searching
+        sort_order = search->sort_order;
+    }
+    else if (sort_order != search->sort_order) {
+        g_debug("entries sorted by %s aren't indexed, using %s",
+                get_sort_name(search->sort_order),
+                get_sort_name(sort_order));
+    }
+
+    CliWriter writer = *writer_output;
+    writer.separator = search->null_separated ? '\0' : '\n';
+    writer.folder_paths = db_snapshot_get_folder_paths(snapshot);
+    writer.buffer = g_string_sized_new(CLI_WRITE_BUFFER_SIZE);
+    writer.rows = g_array_sized_new(FALSE, FALSE, sizeof(FsearchFederationRow), CLI_ROWS_PER_BATCH);
+    writer.key_func = get_sort_key_func(sort_order);
+    writer.cancellable = g_cancellable_new();
+
+    // folders come first, like in the result list. They're searched on their own, so files can be written while
+    // they're found too, instead of only once the last folder is known.
+    DynamicArray *empty = darray_new(0);
+    uint32_t num_written = 0;
+    for (uint32_t i = 0; i < G_N_ELEMENTS(entries) && !writer.error; i++) {
+        if (search->max_results > 0 && num_written >= search->max_results) {
+            break;
+        }
+        const uint32_t max_results = search->max_results > 0 ? search->max_results - num_written : 0;
+        writer.searching_folders = i == 0;
+        writer.num_written = 0;
+
+        DynamicArray *results = NULL;
+        if (fsearch_query_matches_everything(query)) {
+            results = darray_ref(entries[i]);
+        }
+        else {
+            DatabaseSearchLimit limit = {.max_results = max_results, .by_relevance = by_relevance};
+            DatabaseSearchResult *result = db_search(query,
+                                                     db_get_thread_pool(db),
+                                                     writer.searching_folders ? entries[i] : empty,
+                                                     writer.searching_folders ? empty : entries[i],
+                                                     db_snapshot_get_folder_trigram_index(snapshot),
+                                                     db_snapshot_get_file_trigram_index(snapshot),
+                                                     db_snapshot_get_folder_name_index(snapshot),
+                                                     db_snapshot_get_file_name_index(snapshot),
+                                                     db_snapshot_get_subtree_filter(snapshot),
+                                                     writer.folder_paths,
+                                                     db_snapshot_get_folded_names(snapshot),
+                                                     &limit,
+                                                     sort_order,
+                                                     cli_writer_on_search_progress,
+                                                     &writer,
+                                                     writer.cancellable);
+            if (result) {
+                results = g_steal_pointer(writer.searching_folders ? &result->folders : &result->files);
+                g_clear_pointer(&result->folders, darray_unref);
+                g_clear_pointer(&result->files, darray_unref);
+                g_clear_pointer(&result, free);
+            }
+        }
+        if (results) {
+            const uint32_t num_items = darray_get_num_items(results);
+            cli_writer_write_results(&writer, results, max_results > 0 ? MIN(num_items, max_results) : num_items);
+            cli_writer_flush(&writer);
+            num_written += writer.num_written;
+            g_clear_pointer(&results, darray_unref);
+        }
+    }
+    g_clear_pointer(&empty, darray_unref);
+    g_clear_pointer(&entries[0], darray_unref);
+    g_clear_pointer(&entries[1], darray_unref);
+    g_clear_pointer(&snapshot, db_snapshot_unref);
+    g_string_free(g_steal_pointer(&writer.buffer), TRUE);
+    cli_writer_clear_rows(&writer);
+    g_clear_pointer(&writer.rows, g_array_unref);
+    g_clear_object(&writer.cancellable);
+
+    if (num_results) {
+        *num_results = num_written;
+    }
+    if (writer.error) {
+        g_propagate_error(error, writer.error);
+        return false;
+    }
+    return true;
+}
+
+bool
+fsearch_cli_search_write_results(const FsearchCliSearch *search,
+                                 FsearchQuery *query,
+                                 FsearchDatabase *db,
+                                 int fd,
+                                 uint32_t *num_results,
+                                 GError **error) {
+    struct stat st = {};
+    CliWriter writer = {
+        .output = CLI_OUTPUT_FD,
+        .fd = fd,
+        .is_socket = fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode),
+    };
+    return cli_search_run(search, query, db, &writer, num_results, error);
+}
+
+bool
+fsearch_cli_search_push_results(const FsearchCliSearch *search,
+                                FsearchQuery *query,
+                                FsearchDatabase *db,
+                                FsearchFederationMerger *merger,
+                                uint32_t source,
+                                uint32_t *num_results,
+                                GError **error) {
+    g_assert(merger);
+    CliWriter writer = {
+        .output = CLI_OUTPUT_MERGER,
+        .fd = -1,
+        .merger = merger,
+        .source = source,
+    };
+    return cli_search_run(search, query, db, &writer, num_results, error);
+}
+
+typedef struct {
+    FsearchCliSearch search;
+    FsearchQuery *query;
+    FsearchDatabase *db;
+    // -1 if the results are sent as signals
+    int fd;
+    GDBusMethodInvocation *invocation;
+} CliSearchContext;
+
+static void
+cli_search_context_free(CliSearchContext *ctx) {
+    fsearch_cli_search_clear(&ctx->search);
+    g_clear_pointer(&ctx->query, fsearch_query_unref);
+    g_clear_pointer(&ctx->db, db_unref);
+    if (ctx->fd >= 0) {
+        close(ctx->fd);
+    }
+    g_clear_object(&ctx->invocation);
+    g_clear_pointer(&ctx, free);
+}
+
+static void
+cli_search_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    CliSearchContext *ctx = task_data;
+    g_autoptr(GError) error = NULL;
+    uint32_t num_results = 0;
+    bool written = false;
+    if (ctx->fd >= 0) {
+        written = fsearch_cli_search_write_results(&ctx->search, ctx->query, ctx->db, ctx->fd, &num_results, &error);
+        // the client reads until the end of the stream, before it waits for the reply
+        close(ctx->fd);
+        ctx->fd = -1;
+    }
+    else {
+        // the signals are sent before the reply, so the client has all rows once it gets the reply
+        CliWriter writer = {
+            .output = CLI_OUTPUT_SIGNAL,
+            .fd = -1,
+            .connection = g_dbus_method_invocation_get_connection(ctx->invocation),
+            .destination = g_dbus_method_invocation_get_sender(ctx->invocation),
+            .object_path = g_dbus_method_invocation_get_object_path(ctx->invocation),
+        };
+        written = cli_search_run(&ctx->search, ctx->query, ctx->db, &writer, &num_results, &error);
+    }
+    if (written) {
+        g_dbus_method_invocation_return_value(g_steal_pointer(&ctx->invocation), g_variant_new("(u)", num_results));
+    }
+    else {
+        g_dbus_method_invocation_return_gerror(g_steal_pointer(&ctx->invocation), error);
+    }
+}
+
+typedef struct {
+    FsearchCliSearchSource source;
+    gpointer user_data;
+} CliSearchObject;
+
+// Search writes the paths to the socket it gets, SearchStream sends them as Results signals instead. The latter also
+// works on connections which can't send file descriptors, e.g. the TCP connections of other machines.
+static void
+cli_handle_search(CliSearchObject *object, GVariant *parameters, GDBusMethodInvocation *invocation, bool stream) {
+    g_autoptr(GVariant) options_variant = NULL;
+    gint32 fd_idx = -1;
+    if (stream) {
+        g_variant_get(parameters, "(@a{sv})", &options_variant);
+    }
+    else {
+        g_variant_get(parameters, "(@a{sv}h)", &options_variant, &fd_idx);
+    }
+
+    CliSearchContext *ctx = calloc(1, sizeof(CliSearchContext));
+    g_assert(ctx);
+    ctx->fd = -1;
+    ctx->invocation = invocation;
+
+    g_autoptr(GError) error = NULL;
+    GUnixFDList *fd_list = g_dbus_message_get_unix_fd_list(g_dbus_method_invocation_get_message(invocation));
+    if (stream) {
+        // the results don't need a file descriptor
+    }
+    else if (!fd_list || (ctx->fd = g_unix_fd_list_get(fd_list, fd_idx, &error)) < 0) {
+        if (!error) {
+            g_set_error(&error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "No file descriptor was sent");
+        }
+        goto fail;
+    }
+    struct stat st = {};
+    if (!stream && (fstat(ctx->fd, &st) != 0 || !S_ISSOCK(st.st_mode))) {
+        // writing to a pipe whose reader went away would terminate the application
+        g_set_error(&error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "The results can only be written to a socket");
+        goto fail;
+    }
+
+    g_autoptr(GVariantDict) options = g_variant_dict_new(options_variant);
+    if (!fsearch_cli_search_init(&ctx->search, options, &error)) {
+        goto fail;
+    }
+    ctx->db = object->source.get_database(object->user_data);
+    if (!ctx->db) {
+        g_set_error(&error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED, _("The database isn't loaded yet"));
+        goto fail;
+    }
+    // the config may only be used on the main thread
+    ctx->query = fsearch_cli_search_new_query(&ctx->search, object->source.get_config(object->user_data), &error);
+    if (!ctx->query) {
+        goto fail;
+    }
+
+    g_autoptr(GTask) task = g_task_new(NULL, NULL, NULL, NULL);
+    g_task_set_task_data(task, ctx, (GDestroyNotify)cli_search_context_free);
+    g_task_run_in_thread(task, cli_search_thread);
+    return;
+
+fail:
+    g_dbus_method_invocation_return_gerror(g_steal_pointer(&ctx->invocation), error);
+    g_clear_pointer(&ctx, cli_search_context_free);
+}
+
+static void
+cli_handle_method_call(GDBusConnection *connection,
+                       const gchar *sender,
+                       const gchar *object_path,
+                       const gchar *interface_name,
+                       const gchar *method_name,
+                       GVariant *parameters,
+                       GDBusMethodInvocation *invocation,
+                       gpointer user_data) {
+    if (!g_strcmp0(method_name, "Search")) {
+        cli_handle_search(user_data, parameters, invocation, false);
+    }
+    else if (!g_strcmp0(method_name, "SearchStream")) {
+        cli_handle_search(user_data, parameters, invocation, true);
+    }
+    else {
+        g_dbus_method_invocation_return_error(invocation,
+                                              G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method %s",
+                                              method_name);
+    }
+}
+
+guint
+fsearch_cli_register_search_object(GDBusConnection *connection,
+                                   const char *object_path,
+                                   const FsearchCliSearchSource *source,
+                                   gpointer user_data,
+                                   GError **error) {
+    g_assert(source);
+    static GDBusNodeInfo *introspection_data = NULL;
+    static const GDBusInterfaceVTable vtable = {cli_handle_method_call, NULL, NULL};
+    if (!introspection_data) {
+        introspection_data = g_dbus_node_info_new_for_xml(cli_introspection_xml, NULL);
+        g_assert(introspection_data);
+    }
+    CliSearchObject *object = calloc(1, sizeof(CliSearchObject));
+    g_assert(object);
+    object->source = *source;
+    object->user_data = user_data;
+    return g_dbus_connection_register_object(connection,
+                                             object_path,
+                                             introspection_data->interfaces[0],
+                                             &vtable,
+                                             object,
+                                             free,
+                                             error);
+}
+
+typedef struct {
+    GDBusConnection *connection;
+    const char *bus_name;
+    const char *object_path;
+    GVariant *parameters;
+    GUnixFDList *fd_list;
+    GError *error;
+} CliRemoteCall;
+
+static gpointer
+cli_remote_call_thread(gpointer data) {
+    CliRemoteCall *call = data;
+    GVariant *reply = g_dbus_connection_call_with_unix_fd_list_sync(call->connection,
+                                                                    call->bus_name,
+                                                                    call->object_path,
+                                                                    CLI_DBUS_IFACE,
+                                                                    "Search",
+                                                                    call->parameters,
+                                                                    G_VARIANT_TYPE("(u)"),
+                                                                    G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                                    G_MAXINT,
+                                                                    call->fd_list,
+                                                                    NULL,
+                                                                    NULL,
+                                                                    &call->error);
+    g_clear_pointer(&reply, g_variant_unref);
+    return NULL;
+}
+
+static bool
+write_to_stdout(const char *data, size_t len) {
+    for (size_t offset = 0; offset < len;) {
+        const ssize_t written = write(STDOUT_FILENO, data + offset, len - offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += (size_t)written;
+    }
+    return true;
+}
+
+static bool
+copy_to_stdout(int fd) {
+    char buffer[CLI_WRITE_BUFFER_SIZE];
+    while (true) {
+        const ssize_t num_read = read(fd, buffer, sizeof(buffer));
+        if (num_read == 0) {
+            return true;
+        }
+        if (num_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (!write_to_stdout(buffer, num_read)) {
+            return false;
+        }
+    }
+}
+
+// No instance owns the name or it doesn't support searching (yet)
+static bool
+is_missing_instance_error(const GError *error) {
+    return g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN)
+        || g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER)
+        || g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT)
+        || g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE)
+        || g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD);
+}
+
+// Returns false if there's no instance which could run the search
+static bool
+search_in_remote_instance(const FsearchCliSearch *search, const char *bus_name, const char *object_path, int *status) {
+    g_autoptr(GDBusConnection) connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    if (!connection) {
+        return false;
+    }
+    int fds[2] = {-1, -1};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return false;
+    }
+    CliRemoteCall call = {
+        .connection = connection,
+        .bus_name = bus_name,
+        .object_path = object_path,
+        .fd_list = g_unix_fd_list_new(),
+    };
+    const gint fd_idx = g_unix_fd_list_append(call.fd_list, fds[1], NULL);
+    call.parameters = g_variant_new("(@a{sv}h)", cli_search_to_variant(search), fd_idx);
+    // the list holds a copy, so the stream ends as soon as the other instance closes it
+    close(fds[1]);
+
+    // the results are read while the call is running, otherwise the other instance would wait for them to be read
+    GThread *thread = g_thread_new("fsearch_cli_search", cli_remote_call_thread, &call);
+    const bool copied = copy_to_stdout(fds[0]);
+    close(fds[0]);
+    g_thread_join(thread);
+    g_clear_object(&call.fd_list);
+
+    bool found_instance = true;
+    if (call.error) {
+        if (is_missing_instance_error(call.error)) {
+            found_instance = false;
+        }
+        else {
+            g_dbus_error_strip_remote_error(call.error);
+            g_printerr("[fsearch] %s\n", call.error->message);
+        }
+        g_clear_error(&call.error);
+        *status = EXIT_FAILURE;
+    }
+    else {
+        *status = copied ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    return found_instance;
+}
+
+static FsearchConfig *
+cli_load_config(void) {
+    FsearchConfig *config = calloc(1, sizeof(FsearchConfig));
+    g_assert(config);
+    if (!config_load(config) && !config_load_default(config)) {
+        g_clear_pointer(&config, config_free);
+    }
+    return config;
+}
+
+static int
+search_in_local_instance(const FsearchCliSearch *search, FsearchConfig *config) {
+    if (!config) {
+        g_printerr("[fsearch] failed to load config\n");
+        return EXIT_FAILURE;
+    }
+
+    int res = EXIT_FAILURE;
+    g_autoptr(GError) error = NULL;
+    FsearchQuery *query = fsearch_cli_search_new_query(search, config, &error);
+    g_autofree char *db_file_path = fsearch_application_get_database_file_path();
+    FsearchDatabase *db = query ? fsearch_application_new_database(config) : NULL;
+    if (db && !db_load(db, db_file_path, NULL, NULL)) {
+        g_set_error(&error,
+                    G_IO_ERROR,
+                    G_IO_ERROR_NOT_FOUND,
+                    _("Failed to load the database, try fsearch --update-database"));
+    }
+    else if (db && fsearch_cli_search_write_results(search, query, db, STDOUT_FILENO, NULL, &error)) {
+        res = EXIT_SUCCESS;
+    }
+    if (error) {
+        g_printerr("[fsearch] %s\n", error->message);
+    }
+
+    g_clear_pointer(&db, db_unref);
+    g_clear_pointer(&query, fsearch_query_unref);
+    return res;
+}
+
+// One of the databases of a federated search, which pushes its results to the merger from its own thread
+typedef struct {
+    const FsearchCliSearch *search;
+    // only read
+    FsearchConfig *config;
+    FsearchQuery *query;
+    FsearchFederationMerger *merger;
+    uint32_t idx;
+    // NULL for the database of this machine
+    FsearchFederationSource *source;
+    // where the instance which might hold the database of this machine can be found
+    const char *bus_name;
+    const char *object_path;
+    GThread *thread;
+    // stops waiting for the results of other processes
+    GCancellable *cancellable;
+    GError *error;
+
+    // the state of the SearchStream call which runs at the moment
+    GVariant *reply;
+    bool replied;
+    uint32_t num_received;
+} CliFederatedSource;
+
+static void
+on_federated_source_results(GDBusConnection *connection,
+                            const gchar *sender_name,
+                            const gchar *object_path,
+                            const gchar *interface_name,
+                            const gchar *signal_name,
+                            GVariant *parameters,
+                            gpointer user_data) {
+    CliFederatedSource *ctx = user_data;
+    if (g_cancellable_is_cancelled(ctx->cancellable)) {
+        return;
+    }
+    g_autoptr(GVariant) rows_variant = g_variant_get_child_value(parameters, 0);
+    const uint32_t num_rows = (uint32_t)g_variant_n_children(rows_variant);
+    FsearchFederationRow *rows = calloc(MAX(num_rows, 1), sizeof(FsearchFederationRow));
+    g_assert(rows);
+
+    GVariantIter iter;
+    g_variant_iter_init(&iter, rows_variant);
+    gboolean is_folder = FALSE;
+    const char *path = NULL;
+    guint64 key = 0;
+    for (uint32_t i = 0; i < num_rows && g_variant_iter_next(&iter, "(b&st)", &is_folder, &path, &key); i++) {
+        rows[i].path = g_strdup(path);
+        rows[i].key = key;
+        rows[i].is_folder = is_folder;
+    }
+    ctx->num_received += num_rows;
+    if (!fsearch_federation_merger_push(ctx->merger, ctx->idx, rows, num_rows)) {
+        // the reply arrives with an error then
+        g_cancellable_cancel(ctx->cancellable);
+    }
+    g_clear_pointer(&rows, free);
+}
+
+static void
+on_federated_source_replied(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    CliFederatedSource *ctx = user_data;
+    ctx->reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &ctx->error);
+    ctx->replied = true;
+}
+
+// Pushes the results of the instance at bus_name (NULL on peer connections) to the merger.
+// Returns false if there's no such instance.
+static bool
+cli_federated_source_stream(CliFederatedSource *ctx,
+                            GDBusConnection *connection,
+                            const char *bus_name,
+                            const char *object_path) {
+    GMainContext *context = g_main_context_new();
+    g_main_context_push_thread_default(context);
+    ctx->replied = false;
+    ctx->num_received = 0;
+
+    // the signals are only sent to this connection, so they don't need to be filtered by their sender
+    const guint subscription_id = g_dbus_connection_signal_subscribe(connection,
+                                                                     NULL,
+                                                                     CLI_DBUS_IFACE,
+                                                                     "Results",
+                                                                     object_path,
+                                                                     NULL,
+                                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                     on_federated_source_results,
+                                                                     ctx,
+                                                                     NULL);
+    g_dbus_connection_call(connection,
+                           bus_name,
+                           object_path,
+                           CLI_DBUS_IFACE,
+                           "SearchStream",
+                           g_variant_new("(@a{sv})", cli_search_to_variant(ctx->search)),
+                           G_VARIANT_TYPE("(u)"),
+                           G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                           G_MAXINT,
+                           ctx->cancellable,
+                           on_federated_source_replied,
+                           ctx);
+    while (!ctx->replied) {
+        g_main_context_iteration(context, TRUE);
+    }
+    if (ctx->reply) {
+        guint32 num_results = 0;
+        g_variant_get(ctx->reply, "(u)", &num_results);
+        // the signals were sent before the reply, but they might not have been dispatched yet
+        while (ctx->num_received < num_results && !g_cancellable_is_cancelled(ctx->cancellable)) {
+            g_main_context_iteration(context, TRUE);
+        }
+    }
+    g_dbus_connection_signal_unsubscribe(connection, subscription_id);
+    g_main_context_pop_thread_default(context);
+    g_clear_pointer(&context, g_main_context_unref);
+    g_clear_pointer(&ctx->reply, g_variant_unref);
+
+    if (ctx->error && is_missing_instance_error(ctx->error)) {
+        g_clear_error(&ctx->error);
+        return false;
+    }
+    if (ctx->error) {
+        g_dbus_error_strip_remote_error(ctx->error);
+    }
+    return true;
+}
+
+static void
+cli_federated_source_search_file(CliFederatedSource *ctx, const char *path) {
+    FsearchDatabase *db = fsearch_application_new_database(ctx->config);
+    if (ctx->source) {
+        // the file belongs to another machine, which keeps it up to date
+        db_set_read_only_file(db, true);
+    }
+    if (!db_load(db, path, NULL, NULL)) {
+        if (ctx->source) {
+            g_set_error(&ctx->error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("Failed to load the database “%s”"), path);
+        }
+        else {
+            g_set_error(&ctx->error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_NOT_FOUND,
+                        _("Failed to load the database, try fsearch --update-database"));
+        }
+    }
+    else {
+        fsearch_cli_search_push_results(ctx->search, ctx->query, db, ctx->merger, ctx->idx, NULL, &ctx->error);
+    }
+    g_clear_pointer(&db, db_unref);
+}
+
+static gpointer
+cli_federated_source_thread(gpointer data) {
+    CliFederatedSource *ctx = data;
+    if (!ctx->source) {
+        // like a search of this machine alone, it runs in the running instance or fsearchd if possible
+        g_autoptr(GDBusConnection) connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+        const bool streamed = connection
+                           && (cli_federated_source_stream(ctx, connection, ctx->bus_name, ctx->object_path)
+                               || cli_federated_source_stream(ctx,
+                                                              connection,
+                                                              FSEARCH_DAEMON_BUS_NAME,
+                                                              FSEARCH_DAEMON_OBJECT_PATH));
+        if (!streamed) {
+            g_autofree char *db_file_path = fsearch_application_get_database_file_path();
+            cli_federated_source_search_file(ctx, db_file_path);
+        }
+    }
+    else if (fsearch_federation_source_is_remote(ctx->source)) {
+        g_autoptr(GDBusConnection) connection =
+            g_dbus_connection_new_for_address_sync(ctx->source->location,
+                                                   G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                   NULL,
+                                                   ctx->cancellable,
+                                                   &ctx->error);
+        if (connection && !cli_federated_source_stream(ctx, connection, NULL, FSEARCH_DAEMON_OBJECT_PATH)) {
+            g_set_error(&ctx->error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_NOT_FOUND,
+                        _("The remote fsearchd doesn't support searching"));
+        }
+    }
+    else {
+        cli_federated_source_search_file(ctx, ctx->source->location);
+    }
+    fsearch_federation_merger_finish(ctx->merger, ctx->idx);
+    return NULL;
+}
+
+// Searches the database of this machine and all federated sources at once and prints their merged results, with the
+// name of their source and a tab in front. Sources which fail are reported, the results of the others are printed
+// nonetheless.
+static int
+search_federated(FsearchCliSearch *search, FsearchConfig *config, const char *bus_name, const char *object_path) {
+    g_autoptr(GError) error = NULL;
+    FsearchQuery *query = fsearch_cli_search_new_query(search, config, &error);
+    if (!query) {
+        g_printerr("[fsearch] %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    // all sources search with the settings and filter of this machine
+    search->has_query_flags = true;
+    search->query_flags = config_get_query_flags(config);
+    if (search->filter_name) {
+        FsearchFilter *filter = fsearch_filter_manager_get_filter_for_name(config->filters, search->filter_name);
+        search->filter_query = g_strdup(filter->query);
+        search->filter_flags = filter->flags;
+        g_clear_pointer(&filter, fsearch_filter_unref);
+    }
+
+    const uint32_t num_sources = 1 + g_list_length(config->federated_sources);
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(num_sources, search->sort_order);
+    CliFederatedSource *sources = calloc(num_sources, sizeof(CliFederatedSource));
+    g_assert(sources);
+    GList *l = config->federated_sources;
+    for (uint32_t i = 0; i < num_sources; i++) {
+        CliFederatedSource *ctx = &sources[i];
+        ctx->search = search;
+        ctx->config = config;
+        ctx->query = query;
+        ctx->merger = merger;
+        ctx->idx = i;
+        ctx->bus_name = bus_name;
+        ctx->object_path = object_path;
+        ctx->cancellable = g_cancellable_new();
+        if (i > 0) {
+            ctx->source = l->data;
+            l = l->next;
+        }
+        ctx->thread = g_thread_new("fsearch_federated_source", cli_federated_source_thread, ctx);
+    }
+
+    const char *local_name = g_get_host_name();
+    const char separator = search->null_separated ? '\0' : '\n';
+    GString *buffer = g_string_sized_new(CLI_WRITE_BUFFER_SIZE);
+    bool written = true;
+    uint32_t num_written = 0;
+    FsearchFederationRow row = {};
+    uint32_t idx = 0;
+    while (written && (search->max_results == 0 || num_written < search->max_results)
+           && fsearch_federation_merger_pop(merger, &row, &idx)) {
+        g_string_append(buffer, idx > 0 ? sources[idx].source->name : local_name);
+        g_string_append_c(buffer, '\t');
+        g_string_append(buffer, row.path);
+        g_string_append_c(buffer, separator);
+        g_clear_pointer(&row.path, g_free);
+        num_written++;
+        if (buffer->len >= CLI_WRITE_BUFFER_SIZE) {
+            written = write_to_stdout(buffer->str, buffer->len);
+            g_string_truncate(buffer, 0);
+        }
+    }
+    written = written && write_to_stdout(buffer->str, buffer->len);
+    g_string_free(g_steal_pointer(&buffer), TRUE);
+
+    // stops the sources which are still searching, e.g. because the limit was reached
+    fsearch_federation_merger_cancel(merger);
+    int status = written ? EXIT_SUCCESS : EXIT_FAILURE;
+    for (uint32_t i = 0; i < num_sources; i++) {
+        CliFederatedSource *ctx = &sources[i];
+        g_cancellable_cancel(ctx->cancellable);
+        g_thread_join(g_steal_pointer(&ctx->thread));
+        if (ctx->error && !g_error_matches(ctx->error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_printerr("[fsearch] %s: %s\n", i > 0 ? ctx->source->name : local_name, ctx->error->message);
+            status = EXIT_FAILURE;
+        }
+        g_clear_error(&ctx->error);
+        g_clear_object(&ctx->cancellable);
+    }
+    g_clear_pointer(&sources, free);
+    g_clear_pointer(&merger, fsearch_federation_merger_free);
+    g_clear_pointer(&query, fsearch_query_unref);
+    return status;
+}
+
+int
+fsearch_cli_print_search_results(GVariantDict *options, const char *bus_name, const char *object_path) {
+    FsearchCliSearch search = {};
+    g_autoptr(GError) error = NULL;
+    if (!fsearch_cli_search_init(&search, options, &error)) {
+        g_printerr("[fsearch] %s\n", error->message);
+        fsearch_cli_search_clear(&search);
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_FAILURE;
+    FsearchConfig *config = cli_load_config();
+    if (config && config->federated_sources && search.has_group_by) {
+        g_printerr("[fsearch] %s\n", _("Grouped results can only be printed for a single database"));
+    }
+    else if (config && config->federated_sources) {
+        status = search_federated(&search, config, bus_name, object_path);
+    }
+    else if (!search_in_remote_instance(&search, bus_name, object_path, &status)
+             && !search_in_remote_instance(&search, FSEARCH_DAEMON_BUS_NAME, FSEARCH_DAEMON_OBJECT_PATH, &status)) {
+        g_debug("no running instance found, loading the database");
+        status = search_in_local_instance(&search, config);
+    }
+    g_clear_pointer(&config, config_free);
+    fsearch_cli_search_clear(&search);
+    return status;
+}
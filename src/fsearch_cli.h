@@ -0,0 +1,93 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_aggregate.h"
+#include "fsearch_config.h"
+#include "fsearch_database.h"
+#include "fsearch_federation.h"
+#include "fsearch_query.h"
+
+// A search requested with --print, its results are written as full paths to a file descriptor
+typedef struct {
+    char *search_term;
+    // the name of the filter which gets applied, NULL for none
+    char *filter_name;
+    FsearchDatabaseIndexType sort_order;
+    // 0 for all results
+    uint32_t max_results;
+    // the paths are separated by NUL characters instead of newlines
+    bool null_separated;
+    // --group-by: the count and size of the files of every group get printed instead of the paths, max_results
+    // limits the number of groups then
+    bool has_group_by;
+    FsearchAggregateKey group_by;
+    uint32_t group_depth;
+    char *group_by_name;
+    // set when the results of several databases get merged, so all of them are searched with the settings and
+    // filter of the instance which merges them instead of their own
+    bool has_query_flags;
+    FsearchQueryFlags query_flags;
+    char *filter_query;
+    FsearchQueryFlags filter_flags;
+} FsearchCliSearch;
+
+// Sets up search from the command line options (or the options sent by fsearch_cli_print_search_results).
+// Returns false and sets error if one of them is invalid.
+bool
+fsearch_cli_search_init(FsearchCliSearch *search, GVariantDict *options, GError **error);
+
+void
+fsearch_cli_search_clear(FsearchCliSearch *search);
+
+// Returns the query for search with the filters and search settings of config, NULL if the filter doesn't exist
+FsearchQuery *
+fsearch_cli_search_new_query(const FsearchCliSearch *search, FsearchConfig *config, GError **error);
+
+// Searches the current snapshot of db and writes the results to fd while they're found, folders first. With
+// --group-by the groups are written once the search is done, as lines of their size, count and name separated by tabs.
+// Returns false and sets error if writing fails, the search is stopped then.
+bool
+fsearch_cli_search_write_results(const FsearchCliSearch *search,
+                                 FsearchQuery *query,
+                                 FsearchDatabase *db,
+                                 int fd,
+                                 uint32_t *num_results,
+                                 GError **error);
+
+// Like fsearch_cli_search_write_results, but the results are pushed to merger as rows of source. Stops with a
+// G_IO_ERROR_CANCELLED error once the merger got cancelled.
+bool
+fsearch_cli_search_push_results(const FsearchCliSearch *search,
+                                FsearchQuery *query,
+                                FsearchDatabase *db,
+                                FsearchFederationMerger *merger,
+                                uint32_t source,
+                                uint32_t *num_results,
+                                GError **error);
+
+// Where the searches which arrive over D-Bus get their database and settings from, both are called on the main thread
+typedef struct {
+    // returns a new reference to the database, NULL if it isn't loaded yet
+    FsearchDatabase *(*get_database)(gpointer user_data);
+    FsearchConfig *(*get_config)(gpointer user_data);
+} FsearchCliSearchSource;
+
+// Exports the search interface at object_path, on the session bus or on a peer connection of another machine.
+// Returns the registration id, 0 if it failed.
+guint
+fsearch_cli_register_search_object(GDBusConnection *connection,
+                                   const char *object_path,
+                                   const FsearchCliSearchSource *source,
+                                   gpointer user_data,
+                                   GError **error);
+
+// Handles --print: the search runs in the instance which owns bus_name or else in fsearchd, so their database is
+// used and doesn't need to be loaded. If neither runs the database gets loaded from disk first. Returns the exit
+// status.
+// If databases to search as well are configured (federated_sources), the search runs on all of them at once and
+// their results are merged and printed with the name of their database in front.
+int
+fsearch_cli_print_search_results(GVariantDict *options, const char *bus_name, const char *object_path);
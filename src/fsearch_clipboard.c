@@ -24,7 +24,8 @@
 #include <string.h>
 
 static GdkDragAction clipboard_action = GDK_ACTION_DEFAULT;
-static GList *clipboard_file_list = NULL;
+static char *clipboard_uris = NULL;
+static size_t clipboard_uris_len = 0;
 
 enum { URI_LIST = 1, NAUTILUS_WORKAROUND, GNOME_COPIED_FILES, KDE_CUT_SELECTION, N_CLIPBOARD_TARGETS };
 
@@ -36,15 +37,14 @@ static GtkTargetEntry targets[] = {{"text/uri-list", 0, URI_LIST},
 static void
 clipboard_clean_data(GtkClipboard *clipboard, gpointer user_data) {
     /* g_debug("clean clipboard!"); */
-    if (clipboard_file_list) {
-        g_list_free_full(g_steal_pointer(&clipboard_file_list), (GDestroyNotify)g_free);
-    }
+    g_clear_pointer(&clipboard_uris, g_free);
+    clipboard_uris_len = 0;
     clipboard_action = GDK_ACTION_DEFAULT;
 }
 
 static void
 clipboard_get_data(GtkClipboard *clipboard, GtkSelectionData *selection_data, guint info, gpointer user_data) {
-    if (!clipboard_file_list) {
+    if (!clipboard_uris) {
         return;
     }
 
@@ -56,7 +56,7 @@ clipboard_get_data(GtkClipboard *clipboard, GtkSelectionData *selection_data, gu
         return;
     }
 
-    g_autoptr(GString) list = g_string_sized_new(8192);
+    g_autoptr(GString) list = g_string_sized_new(clipboard_uris_len + 64);
 
     if (info == GNOME_COPIED_FILES) {
         g_debug("[get_data] GNOME_COPIED_FILES");
@@ -77,19 +77,22 @@ clipboard_get_data(GtkClipboard *clipboard, GtkSelectionData *selection_data, gu
         return;
     }
 
-    for (GList *l = clipboard_file_list; l; l = l->next) {
-        g_autofree gchar *file_name = g_filename_to_uri((char *)l->data, NULL, NULL);
-        g_string_append(list, file_name);
-
-        if (l->next != NULL) {
-            if (info == URI_LIST) {
-                g_string_append(list, "\r\n");
-            }
-            else {
-                g_string_append_c(list, '\n');
+    if (info == URI_LIST) {
+        const char *end = clipboard_uris + clipboard_uris_len;
+        for (const char *uri = clipboard_uris; uri < end;) {
+            const char *uri_end = memchr(uri, '\n', end - uri);
+            if (!uri_end) {
+                g_string_append_len(list, uri, end - uri);
+                break;
             }
+            g_string_append_len(list, uri, uri_end - uri);
+            g_string_append(list, "\r\n");
+            uri = uri_end + 1;
         }
     }
+    else {
+        g_string_append_len(list, clipboard_uris, (gssize)clipboard_uris_len);
+    }
     if (info == NAUTILUS_WORKAROUND) {
         g_string_append_c(list, '\n');
     }
@@ -102,10 +105,11 @@ clipboard_get_data(GtkClipboard *clipboard, GtkSelectionData *selection_data, gu
 }
 
 void
-clipboard_copy_file_list(GList *file_list, bool copy) {
+clipboard_copy_uri_list(char *uris, size_t len, bool copy) {
     GtkClipboard *clip = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
     gtk_clipboard_set_with_data(clip, targets, G_N_ELEMENTS(targets), clipboard_get_data, clipboard_clean_data, NULL);
 
-    clipboard_file_list = file_list;
+    clipboard_uris = uris;
+    clipboard_uris_len = len;
     clipboard_action = copy ? GDK_ACTION_COPY : GDK_ACTION_MOVE;
 }
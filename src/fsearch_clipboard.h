@@ -20,6 +20,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include <glib.h>
 #include <stdbool.h>
+#include <stddef.h>
 
+// Takes ownership of uris, the newline separated URIs of the files
 void
-clipboard_copy_file_list(GList *file_list, bool copy);
+clipboard_copy_uri_list(char *uris, size_t len, bool copy);
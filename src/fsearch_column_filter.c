@@ -0,0 +1,165 @@
+#define G_LOG_DOMAIN "fsearch-column-filter"
+
+#include "fsearch_column_filter.h"
+
+#include <glib.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FSEARCH_COLUMN_FILTER_AVX2
+#endif
+
+typedef uint64_t(FsearchColumnFilterFunc)(const int64_t *, uint64_t, uint64_t);
+typedef uint64_t(FsearchColumnFilterMaskedFunc)(const uint16_t *, uint16_t, uint16_t);
+
+// A value is within [min, max] exactly if value - min, as an unsigned number, isn't larger than
+// max - min. Values below min wrap around to huge numbers, so a single comparison covers both bounds.
+
+static uint64_t
+filter_word_scalar(const int64_t *values, uint64_t min, uint64_t width) {
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < 64; i++) {
+        mask |= (uint64_t)((uint64_t)values[i] - min <= width) << i;
+    }
+    return mask;
+}
+
+#ifdef FSEARCH_COLUMN_FILTER_AVX2
+__attribute__((target("avx2"))) static uint64_t
+filter_word_avx2(const int64_t *values, uint64_t min, uint64_t width) {
+    // AVX2 only compares signed numbers, flipping the sign bit of both sides gives the unsigned order
+    const __m256i sign_bit = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i min_vec = _mm256_set1_epi64x((int64_t)min);
+    const __m256i width_vec = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)width), sign_bit);
+    uint64_t outside = 0;
+    for (uint32_t i = 0; i < 64; i += 4) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        const __m256i offset = _mm256_xor_si256(_mm256_sub_epi64(v, min_vec), sign_bit);
+        const __m256i gt = _mm256_cmpgt_epi64(offset, width_vec);
+        outside |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(gt)) << i;
+    }
+    return ~outside;
+}
+#endif
+
+static uint64_t
+filter_masked_word_scalar(const uint16_t *values, uint16_t mask, uint16_t value) {
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < 64; i++) {
+        result |= (uint64_t)((values[i] & mask) == value) << i;
+    }
+    return result;
+}
+
+#ifdef FSEARCH_COLUMN_FILTER_AVX2
+__attribute__((target("avx2"))) static uint64_t
+filter_masked_word_avx2(const uint16_t *values, uint16_t mask, uint16_t value) {
+    const __m256i mask_vec = _mm256_set1_epi16((int16_t)mask);
+    const __m256i value_vec = _mm256_set1_epi16((int16_t)value);
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < 64; i += 32) {
+        const __m256i v1 = _mm256_loadu_si256((const __m256i *)(values + i));
+        const __m256i v2 = _mm256_loadu_si256((const __m256i *)(values + i + 16));
+        const __m256i eq1 = _mm256_cmpeq_epi16(_mm256_and_si256(v1, mask_vec), value_vec);
+        const __m256i eq2 = _mm256_cmpeq_epi16(_mm256_and_si256(v2, mask_vec), value_vec);
+        // packing works on 128 bit lanes, the permutation restores the order of the values
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(eq1, eq2), 0xD8);
+        result |= (uint64_t)(uint32_t)_mm256_movemask_epi8(packed) << i;
+    }
+    return result;
+}
+#endif
+
+static FsearchColumnFilterMaskedFunc *
+get_filter_masked_word_func(void) {
+    static FsearchColumnFilterMaskedFunc *filter_func = NULL;
+    FsearchColumnFilterMaskedFunc *func = g_atomic_pointer_get(&filter_func);
+    if (G_LIKELY(func)) {
+        return func;
+    }
+#if defined(FSEARCH_COLUMN_FILTER_AVX2)
+    __builtin_cpu_init();
+    func = __builtin_cpu_supports("avx2") ? filter_masked_word_avx2 : filter_masked_word_scalar;
+#else
+    func = filter_masked_word_scalar;
+#endif
+    g_atomic_pointer_set(&filter_func, func);
+    return func;
+}
+
+static FsearchColumnFilterFunc *
+get_filter_word_func(void) {
+    static FsearchColumnFilterFunc *filter_func = NULL;
+    FsearchColumnFilterFunc *func = g_atomic_pointer_get(&filter_func);
+    if (G_LIKELY(func)) {
+        return func;
+    }
+#if defined(FSEARCH_COLUMN_FILTER_AVX2)
+    __builtin_cpu_init();
+    func = __builtin_cpu_supports("avx2") ? filter_word_avx2 : filter_word_scalar;
+#else
+    func = filter_word_scalar;
+#endif
+    g_atomic_pointer_set(&filter_func, func);
+    return func;
+}
+
+void
+fsearch_column_filter_range(const int64_t *values, uint32_t num_values, int64_t min, int64_t max, uint64_t *bitmap) {
+    const uint32_t num_words = (num_values + 63) / 64;
+    if (min > max) {
+        for (uint32_t i = 0; i < num_words; i++) {
+            bitmap[i] = 0;
+        }
+        return;
+    }
+
+    const uint64_t umin = (uint64_t)min;
+    const uint64_t width = (uint64_t)max - umin;
+    FsearchColumnFilterFunc *filter_word = get_filter_word_func();
+    const uint32_t num_full_words = num_values / 64;
+    for (uint32_t i = 0; i < num_full_words; i++) {
+        if (bitmap[i]) {
+            bitmap[i] &= filter_word(values + (size_t)i * 64, umin, width);
+        }
+    }
+
+    if (num_full_words < num_words) {
+        const int64_t *tail = values + (size_t)num_full_words * 64;
+        uint64_t mask = 0;
+        for (uint32_t i = 0; i < num_values % 64; i++) {
+            mask |= (uint64_t)((uint64_t)tail[i] - umin <= width) << i;
+        }
+        bitmap[num_full_words] &= mask;
+    }
+}
+
+void
+fsearch_column_filter_masked(const uint16_t *values,
+                             uint32_t num_values,
+                             uint16_t mask,
+                             uint16_t value,
+                             bool equal,
+                             uint64_t *bitmap) {
+    const uint32_t num_words = (num_values + 63) / 64;
+    // inverting the result of the matching values gives the ones which don't match
+    const uint64_t invert = equal ? 0 : UINT64_MAX;
+    FsearchColumnFilterMaskedFunc *filter_word = get_filter_masked_word_func();
+    const uint32_t num_full_words = num_values / 64;
+    for (uint32_t i = 0; i < num_full_words; i++) {
+        if (bitmap[i]) {
+            bitmap[i] &= filter_word(values + (size_t)i * 64, mask, value) ^ invert;
+        }
+    }
+
+    if (num_full_words < num_words) {
+        const uint16_t *tail = values + (size_t)num_full_words * 64;
+        const uint32_t num_tail_values = num_values % 64;
+        uint64_t result = 0;
+        for (uint32_t i = 0; i < num_tail_values; i++) {
+            result |= (uint64_t)((tail[i] & mask) == value) << i;
+        }
+        bitmap[num_full_words] &= (result ^ invert) & ((UINT64_C(1) << num_tail_values) - 1);
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Clears bit i of bitmap for every i < num_values where values[i] isn't within [min, max], as well as
+// the remaining bits of the last word. Large batches of values are compared a whole vector at once,
+// the fastest implementation the CPU supports (AVX2 or scalar) is picked at runtime.
+void
+fsearch_column_filter_range(const int64_t *values, uint32_t num_values, int64_t min, int64_t max, uint64_t *bitmap);
+
+// Like fsearch_column_filter_range, for 16 bit values: clears the bits of the values for which
+// (values[i] & mask) == value doesn't hold, or the ones for which it holds if equal is false.
+void
+fsearch_column_filter_masked(const uint16_t *values,
+                             uint32_t num_values,
+                             uint16_t mask,
+                             uint16_t value,
+                             bool equal,
+                             uint64_t *bitmap);
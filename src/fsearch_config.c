@@ -26,6 +26,7 @@
 
 #include "fsearch_config.h"
 #include "fsearch_exclude_path.h"
+#include "fsearch_federation.h"
 #include "fsearch_index.h"
 #include "fsearch_limits.h"
 
@@ -180,6 +181,27 @@ config_load_indexes(GKeyFile *key_file, GList *indexes, const char *prefix) {
     return indexes;
 }
 
+static GList *
+config_load_federated_sources(GKeyFile *key_file, GList *sources) {
+    uint32_t pos = 1;
+    while (true) {
+        char key[100] = "";
+        snprintf(key, sizeof(key), "federated_source_%d", pos);
+        g_autofree char *location = config_load_string(key_file, "Database", key, NULL);
+        snprintf(key, sizeof(key), "federated_source_name_%d", pos);
+        g_autofree char *name = config_load_string(key_file, "Database", key, NULL);
+
+        pos++;
+        if (location) {
+            sources = g_list_append(sources, fsearch_federation_source_new(name ? name : location, location));
+        }
+        else {
+            break;
+        }
+    }
+    return sources;
+}
+
 static GList *
 config_load_exclude_locations(GKeyFile *key_file, GList *locations, const char *prefix) {
     uint32_t pos = 1;
@@ -276,6 +298,7 @@ config_load(FsearchConfig *config) {
         // Column Sort
         config->sort_ascending = config_load_boolean(key_file, "Interface", "sort_ascending", true);
         config->sort_by = config_load_string(key_file, "Interface", "sort_by", "Name");
+        config->mix_files_and_folders = config_load_boolean(key_file, "Interface", "mix_files_and_folders", false);
 
         // Column Size
         config->name_column_width = config_load_integer(key_file, "Interface", "name_column_width", 250);
@@ -294,6 +317,7 @@ config_load(FsearchConfig *config) {
 
         // Search
         config->search_as_you_type = config_load_boolean(key_file, "Search", "search_as_you_type", true);
+        config->result_cache_size = config_load_integer(key_file, "Search", "result_cache_size", 64);
         config->auto_match_case = config_load_boolean(key_file, "Search", "auto_match_case", true);
         config->auto_search_in_path = config_load_boolean(key_file, "Search", "auto_search_in_path", true);
         config->match_case = config_load_boolean(key_file, "Search", "match_case", false);
@@ -308,17 +332,56 @@ config_load(FsearchConfig *config) {
         config->update_database_every_hours = config_load_integer(key_file, "Database", "update_database_every_hours", 0);
         config->update_database_every_minutes =
             config_load_integer(key_file, "Database", "update_database_every_minutes", 15);
+        config->throttle_scheduled_updates =
+            config_load_boolean(key_file, "Database", "throttle_scheduled_updates", false);
+        config->scheduled_update_max_ops = config_load_integer(key_file, "Database", "scheduled_update_max_ops", 1000);
+        config->scheduled_update_max_kib = config_load_integer(key_file, "Database", "scheduled_update_max_kib", 0);
         config->exclude_hidden_items =
             config_load_boolean(key_file, "Database", "exclude_hidden_files_and_folders", false);
         config->follow_symlinks = config_load_boolean(key_file, "Database", "follow_symbolic_links", false);
+        config->scan_threads = config_load_integer(key_file, "Database", "scan_threads", 1);
+        config->worker_threads = config_load_integer(key_file, "Database", "worker_threads", 0);
+        config->worker_cpu_list = config_load_string(key_file, "Database", "worker_cpu_list", NULL);
+        config->numa_aware = config_load_boolean(key_file, "Database", "numa_aware", false);
+        config->huge_pages = config_load_boolean(key_file, "Database", "huge_pages", false);
+        config->memory_budget = config_load_integer(key_file, "Database", "memory_budget", 0);
+        config->front_coded_names = config_load_boolean(key_file, "Database", "front_coded_names", false);
+        config->monitor_filesystem = config_load_boolean(key_file, "Database", "monitor_filesystem", false);
+        config->compact_indexes = config_load_boolean(key_file, "Database", "compact_indexes", false);
+        config->trigram_index = config_load_boolean(key_file, "Database", "trigram_index", false);
+        config->name_index = config_load_boolean(key_file, "Database", "name_index", false);
+        config->folder_path_cache = config_load_boolean(key_file, "Database", "folder_path_cache", true);
+        config->folded_name_cache = config_load_boolean(key_file, "Database", "folded_name_cache", false);
+        config->subtree_filters = config_load_boolean(key_file, "Database", "subtree_filters", false);
+        config->index_access_time = config_load_boolean(key_file, "Database", "index_access_time", false);
+        config->index_creation_time = config_load_boolean(key_file, "Database", "index_creation_time", false);
+        config->index_status_change_time =
+            config_load_boolean(key_file, "Database", "index_status_change_time", false);
+        config->index_owners = config_load_boolean(key_file, "Database", "index_owners", false);
+        config->database_compression =
+            config_load_integer(key_file, "Database", "compression", DATABASE_COMPRESSION_NONE);
+        if (config->database_compression >= NUM_DATABASE_COMPRESSION_TYPES) {
+            config->database_compression = DATABASE_COMPRESSION_NONE;
+        }
 
         g_autofree char *exclude_files_str = config_load_string(key_file, "Database", "exclude_files", NULL);
         if (exclude_files_str) {
             config->exclude_files = g_strsplit(exclude_files_str, ";", -1);
         }
+        g_autofree char *xattr_names_str = config_load_string(key_file, "Database", "xattr_names", NULL);
+        if (xattr_names_str) {
+            config->xattr_names = g_strsplit(xattr_names_str, ";", -1);
+        }
+        g_autofree char *xattr_paths_str = config_load_string(key_file, "Database", "xattr_paths", NULL);
+        if (xattr_paths_str) {
+            config->xattr_paths = g_strsplit(xattr_paths_str, ";", -1);
+        }
+
+        config->remote_search_address = config_load_string(key_file, "Database", "remote_search_address", NULL);
 
         config->indexes = config_load_indexes(key_file, config->indexes, "location");
         config->exclude_locations = config_load_exclude_locations(key_file, config->exclude_locations, "exclude_location");
+        config->federated_sources = config_load_federated_sources(key_file, config->federated_sources);
 
         config->filters = config_load_filters(key_file);
 
@@ -344,6 +407,7 @@ config_load_default(FsearchConfig *config) {
     config->auto_search_in_path = true;
     config->auto_match_case = true;
     config->search_as_you_type = true;
+    config->result_cache_size = 64;
     config->match_case = false;
     config->enable_regex = false;
     config->search_in_path = false;
@@ -379,6 +443,7 @@ config_load_default(FsearchConfig *config) {
 
     config->sort_by = NULL;
     config->sort_ascending = true;
+    config->mix_files_and_folders = false;
 
     config->name_column_pos = 0;
     config->path_column_pos = 1;
@@ -406,8 +471,30 @@ config_load_default(FsearchConfig *config) {
     config->update_database_every = false;
     config->update_database_every_hours = 0;
     config->update_database_every_minutes = 15;
+    config->throttle_scheduled_updates = false;
+    config->scheduled_update_max_ops = 1000;
+    config->scheduled_update_max_kib = 0;
     config->exclude_hidden_items = false;
     config->follow_symlinks = false;
+    config->scan_threads = 1;
+    config->worker_threads = 0;
+    config->worker_cpu_list = NULL;
+    config->numa_aware = false;
+    config->huge_pages = false;
+    config->memory_budget = 0;
+    config->front_coded_names = false;
+    config->monitor_filesystem = false;
+    config->compact_indexes = false;
+    config->trigram_index = false;
+    config->name_index = false;
+    config->folder_path_cache = true;
+    config->folded_name_cache = false;
+    config->subtree_filters = false;
+    config->index_access_time = false;
+    config->index_creation_time = false;
+    config->index_status_change_time = false;
+    config->index_owners = false;
+    config->database_compression = DATABASE_COMPRESSION_NONE;
 
     // Locations
     config->indexes = NULL;
@@ -456,6 +543,22 @@ config_save_filters(GKeyFile *key_file, FsearchFilterManager *filters) {
     }
 }
 
+static void
+config_save_federated_sources(GKeyFile *key_file, GList *sources) {
+    uint32_t pos = 1;
+    for (GList *l = sources; l != NULL; l = l->next) {
+        FsearchFederationSource *source = l->data;
+        char key[100] = "";
+        snprintf(key, sizeof(key), "federated_source_%d", pos);
+        g_key_file_set_string(key_file, "Database", key, source->location);
+
+        snprintf(key, sizeof(key), "federated_source_name_%d", pos);
+        g_key_file_set_string(key_file, "Database", key, source->name);
+
+        pos++;
+    }
+}
+
 static void
 config_save_indexes(GKeyFile *key_file, GList *indexes, const char *prefix) {
     if (!indexes) {
@@ -566,6 +669,7 @@ config_save(FsearchConfig *config) {
     if (config->sort_by) {
         g_key_file_set_string(key_file, "Interface", "sort_by", config->sort_by);
     }
+    g_key_file_set_boolean(key_file, "Interface", "mix_files_and_folders", config->mix_files_and_folders);
 
     // Column width
     g_key_file_set_integer(key_file, "Interface", "name_column_width", config->name_column_width);
@@ -589,6 +693,7 @@ config_save(FsearchConfig *config) {
 
     // Search
     g_key_file_set_boolean(key_file, "Search", "search_as_you_type", config->search_as_you_type);
+    g_key_file_set_integer(key_file, "Search", "result_cache_size", config->result_cache_size);
     g_key_file_set_boolean(key_file, "Search", "auto_search_in_path", config->auto_search_in_path);
     g_key_file_set_boolean(key_file, "Search", "auto_match_case", config->auto_match_case);
     g_key_file_set_boolean(key_file, "Search", "search_in_path", config->search_in_path);
@@ -601,18 +706,54 @@ config_save(FsearchConfig *config) {
     g_key_file_set_boolean(key_file, "Database", "update_database_every", config->update_database_every);
     g_key_file_set_integer(key_file, "Database", "update_database_every_hours", config->update_database_every_hours);
     g_key_file_set_integer(key_file, "Database", "update_database_every_minutes", config->update_database_every_minutes);
+    g_key_file_set_boolean(key_file, "Database", "throttle_scheduled_updates", config->throttle_scheduled_updates);
+    g_key_file_set_integer(key_file, "Database", "scheduled_update_max_ops", config->scheduled_update_max_ops);
+    g_key_file_set_integer(key_file, "Database", "scheduled_update_max_kib", config->scheduled_update_max_kib);
     g_key_file_set_boolean(key_file, "Database", "exclude_hidden_files_and_folders", config->exclude_hidden_items);
     g_key_file_set_boolean(key_file, "Database", "follow_symbolic_links", config->follow_symlinks);
+    g_key_file_set_integer(key_file, "Database", "scan_threads", config->scan_threads);
+    g_key_file_set_integer(key_file, "Database", "worker_threads", config->worker_threads);
+    if (config->worker_cpu_list) {
+        g_key_file_set_string(key_file, "Database", "worker_cpu_list", config->worker_cpu_list);
+    }
+    g_key_file_set_boolean(key_file, "Database", "numa_aware", config->numa_aware);
+    g_key_file_set_boolean(key_file, "Database", "huge_pages", config->huge_pages);
+    g_key_file_set_integer(key_file, "Database", "memory_budget", config->memory_budget);
+    g_key_file_set_boolean(key_file, "Database", "front_coded_names", config->front_coded_names);
+    g_key_file_set_boolean(key_file, "Database", "monitor_filesystem", config->monitor_filesystem);
+    g_key_file_set_boolean(key_file, "Database", "compact_indexes", config->compact_indexes);
+    g_key_file_set_boolean(key_file, "Database", "trigram_index", config->trigram_index);
+    g_key_file_set_boolean(key_file, "Database", "name_index", config->name_index);
+    g_key_file_set_boolean(key_file, "Database", "folder_path_cache", config->folder_path_cache);
+    g_key_file_set_boolean(key_file, "Database", "folded_name_cache", config->folded_name_cache);
+    g_key_file_set_boolean(key_file, "Database", "subtree_filters", config->subtree_filters);
+    g_key_file_set_boolean(key_file, "Database", "index_access_time", config->index_access_time);
+    g_key_file_set_boolean(key_file, "Database", "index_creation_time", config->index_creation_time);
+    g_key_file_set_boolean(key_file, "Database", "index_status_change_time", config->index_status_change_time);
+    g_key_file_set_boolean(key_file, "Database", "index_owners", config->index_owners);
+    g_key_file_set_integer(key_file, "Database", "compression", config->database_compression);
 
     config_save_filters(key_file, config->filters);
 
     config_save_indexes(key_file, config->indexes, "location");
     config_save_exclude_locations(key_file, config->exclude_locations, "exclude_location");
+    config_save_federated_sources(key_file, config->federated_sources);
+    if (config->remote_search_address) {
+        g_key_file_set_string(key_file, "Database", "remote_search_address", config->remote_search_address);
+    }
 
     if (config->exclude_files) {
         g_autofree char *exclude_files_str = g_strjoinv(";", config->exclude_files);
         g_key_file_set_string(key_file, "Database", "exclude_files", exclude_files_str);
     }
+    if (config->xattr_names) {
+        g_autofree char *xattr_names_str = g_strjoinv(";", config->xattr_names);
+        g_key_file_set_string(key_file, "Database", "xattr_names", xattr_names_str);
+    }
+    if (config->xattr_paths) {
+        g_autofree char *xattr_paths_str = g_strjoinv(";", config->xattr_paths);
+        g_key_file_set_string(key_file, "Database", "xattr_paths", xattr_paths_str);
+    }
 
     gchar config_path[PATH_MAX] = "";
     config_build_path(config_path, sizeof(config_path));
@@ -704,6 +845,39 @@ config_list_compare(GList *l1, GList *l2, bool (*cmp_func)(void *, void *)) {
     return true;
 }
 
+static bool
+config_list_contains(GList *list, void *data, bool (*cmp_func)(void *, void *)) {
+    for (GList *l = list; l != NULL; l = l->next) {
+        if (cmp_func(l->data, data)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the only index of new_indexes which isn't part of old_indexes, if at most one index of old_indexes was
+// changed or removed along with it
+static FsearchIndex *
+config_get_changed_index(GList *old_indexes, GList *new_indexes) {
+    FsearchIndex *changed_index = NULL;
+    for (GList *l = new_indexes; l != NULL; l = l->next) {
+        if (config_list_contains(old_indexes, l->data, config_indexes_compare)) {
+            continue;
+        }
+        if (changed_index) {
+            return NULL;
+        }
+        changed_index = l->data;
+    }
+    uint32_t num_removed = 0;
+    for (GList *l = old_indexes; l != NULL; l = l->next) {
+        if (!config_list_contains(new_indexes, l->data, config_indexes_compare)) {
+            num_removed++;
+        }
+    }
+    return num_removed <= 1 ? changed_index : NULL;
+}
+
 #if !GLIB_CHECK_VERSION(2, 60, 0)
 // Copied from glib for backwards compatibility
 static gboolean
@@ -723,6 +897,14 @@ g_strv_equal(const gchar *const *strv1, const gchar *const *strv2) {
 }
 #endif
 
+static bool
+config_strv_changed(char **v1, char **v2) {
+    if (!v1 || !v2) {
+        return v1 != v2;
+    }
+    return !g_strv_equal((const gchar *const *)v1, (const gchar *const *)v2);
+}
+
 FsearchConfigCompareResult
 config_cmp(FsearchConfig *c1, FsearchConfig *c2) {
     FsearchConfigCompareResult result = {};
@@ -737,27 +919,33 @@ config_cmp(FsearchConfig *c1, FsearchConfig *c2) {
         result.search_config_changed = true;
     }
     if (c1->highlight_search_terms != c2->highlight_search_terms || c1->show_listview_icons != c2->show_listview_icons
-        || c1->single_click_open != c2->single_click_open || c1->enable_list_tooltips != c2->enable_list_tooltips) {
+        || c1->single_click_open != c2->single_click_open || c1->enable_list_tooltips != c2->enable_list_tooltips
+        || c1->mix_files_and_folders != c2->mix_files_and_folders) {
         result.listview_config_changed = true;
     }
 
-    bool exclude_files_changed = false;
-    if (c1->exclude_files && c2->exclude_files
-        && !g_strv_equal((const gchar *const *)c1->exclude_files, (const gchar *const *)c2->exclude_files)) {
-        exclude_files_changed = true;
-    }
-    else if ((c1->exclude_files && !c2->exclude_files) || (!c1->exclude_files && c2->exclude_files)) {
-        exclude_files_changed = true;
-    }
+    const bool exclude_files_changed = config_strv_changed(c1->exclude_files, c2->exclude_files);
+    const bool xattrs_changed =
+        config_strv_changed(c1->xattr_names, c2->xattr_names) || config_strv_changed(c1->xattr_paths, c2->xattr_paths);
 
     bool indexes_changed = !config_list_compare(c1->indexes, c2->indexes, config_indexes_compare);
     bool exclude_locations_changed =
         !config_list_compare(c1->exclude_locations, c2->exclude_locations, config_excludes_compare);
 
-    if (c1->exclude_hidden_items != c2->exclude_hidden_items || exclude_files_changed || exclude_locations_changed
-        || indexes_changed) {
+    if (c1->exclude_hidden_items != c2->exclude_hidden_items || c1->monitor_filesystem != c2->monitor_filesystem
+        || c1->compact_indexes != c2->compact_indexes || c1->trigram_index != c2->trigram_index
+        || c1->name_index != c2->name_index || c1->folder_path_cache != c2->folder_path_cache
+        || c1->folded_name_cache != c2->folded_name_cache || c1->subtree_filters != c2->subtree_filters
+        || c1->index_access_time != c2->index_access_time || c1->index_creation_time != c2->index_creation_time
+        || c1->index_status_change_time != c2->index_status_change_time || c1->index_owners != c2->index_owners
+        || exclude_files_changed || xattrs_changed || exclude_locations_changed) {
         result.database_config_changed = true;
     }
+    else if (indexes_changed) {
+        result.database_config_changed = true;
+        // only this index needs to be scanned then, the others stay as they are
+        result.changed_index = config_get_changed_index(c1->indexes, c2->indexes);
+    }
 
     return result;
 }
@@ -775,6 +963,9 @@ config_copy(FsearchConfig *config) {
     if (config->sort_by) {
         copy->sort_by = g_strdup(config->sort_by);
     }
+    if (config->worker_cpu_list) {
+        copy->worker_cpu_list = g_strdup(config->worker_cpu_list);
+    }
     if (config->indexes) {
         copy->indexes = g_list_copy_deep(config->indexes, (GCopyFunc)fsearch_index_copy, NULL);
     }
@@ -784,6 +975,19 @@ config_copy(FsearchConfig *config) {
     if (config->exclude_files) {
         copy->exclude_files = g_strdupv(config->exclude_files);
     }
+    if (config->xattr_names) {
+        copy->xattr_names = g_strdupv(config->xattr_names);
+    }
+    if (config->xattr_paths) {
+        copy->xattr_paths = g_strdupv(config->xattr_paths);
+    }
+    if (config->federated_sources) {
+        copy->federated_sources =
+            g_list_copy_deep(config->federated_sources, (GCopyFunc)fsearch_federation_source_copy, NULL);
+    }
+    if (config->remote_search_address) {
+        copy->remote_search_address = g_strdup(config->remote_search_address);
+    }
     if (config->filters) {
         copy->filters = fsearch_filter_manager_copy(config->filters);
     }
@@ -796,6 +1000,7 @@ config_free(FsearchConfig *config) {
 
     g_clear_pointer(&config->folder_open_cmd, free);
     g_clear_pointer(&config->sort_by, free);
+    g_clear_pointer(&config->worker_cpu_list, free);
     g_clear_pointer(&config->filters, fsearch_filter_manager_free);
     if (config->indexes) {
         g_list_free_full(g_steal_pointer(&config->indexes), (GDestroyNotify)fsearch_index_free);
@@ -804,5 +1009,34 @@ config_free(FsearchConfig *config) {
         g_list_free_full(g_steal_pointer(&config->exclude_locations), (GDestroyNotify)fsearch_exclude_path_free);
     }
     g_clear_pointer(&config->exclude_files, g_strfreev);
+    g_clear_pointer(&config->xattr_names, g_strfreev);
+    g_clear_pointer(&config->xattr_paths, g_strfreev);
+    if (config->federated_sources) {
+        g_list_free_full(g_steal_pointer(&config->federated_sources), (GDestroyNotify)fsearch_federation_source_free);
+    }
+    g_clear_pointer(&config->remote_search_address, free);
     g_clear_pointer(&config, free);
 }
+
+FsearchQueryFlags
+config_get_query_flags(FsearchConfig *config) {
+    g_assert(config);
+
+    FsearchQueryFlags flags = 0;
+    if (config->match_case) {
+        flags |= QUERY_FLAG_MATCH_CASE;
+    }
+    if (config->auto_match_case) {
+        flags |= QUERY_FLAG_AUTO_MATCH_CASE;
+    }
+    if (config->enable_regex) {
+        flags |= QUERY_FLAG_REGEX;
+    }
+    if (config->search_in_path) {
+        flags |= QUERY_FLAG_SEARCH_IN_PATH;
+    }
+    if (config->auto_search_in_path) {
+        flags |= QUERY_FLAG_AUTO_SEARCH_IN_PATH;
+    }
+    return flags;
+}
@@ -22,7 +22,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "fsearch_database_compression.h"
 #include "fsearch_filter_manager.h"
+#include "fsearch_index.h"
 
 typedef struct _FsearchConfig FsearchConfig;
 
@@ -37,6 +39,8 @@ typedef struct {
     bool database_config_changed;
     bool listview_config_changed;
     bool search_config_changed;
+    // the index of the second config which was added or changed, if that's the only change of the database config
+    FsearchIndex *changed_index;
 } FsearchConfigCompareResult;
 
 struct _FsearchConfig {
@@ -48,6 +52,8 @@ struct _FsearchConfig {
     bool auto_search_in_path;
     bool auto_match_case;
     bool search_as_you_type;
+    // memory the results of recent queries of each window may use in MiB (0 disables the cache)
+    uint32_t result_cache_size;
     bool show_base_2_units;
 
     // Applications
@@ -92,6 +98,8 @@ struct _FsearchConfig {
 
     char *sort_by;
     bool sort_ascending;
+    // show folders and files mixed in the sort order instead of the folders first
+    bool mix_files_and_folders;
 
     uint32_t name_column_width;
     uint32_t path_column_width;
@@ -111,14 +119,62 @@ struct _FsearchConfig {
     bool update_database_every;
     uint32_t update_database_every_hours;
     uint32_t update_database_every_minutes;
+    // pace the filesystem calls of scheduled updates, see FsearchScanThrottle
+    bool throttle_scheduled_updates;
+    // filesystem calls and KiB of directory entries per second scheduled updates may use (0 = no limit)
+    uint32_t scheduled_update_max_ops;
+    uint32_t scheduled_update_max_kib;
 
     bool exclude_hidden_items;
     bool follow_symlinks;
+    // number of threads used to scan the filesystem (0 = one per CPU)
+    uint32_t scan_threads;
+    // number of threads used to load, sort and search the database (0 = one per CPU)
+    uint32_t worker_threads;
+    // the CPUs all threads of the database may run on, e.g. "0-3,8" (empty = no restriction)
+    char *worker_cpu_list;
+    // bind every worker thread to one CPU and keep the entries they load on the NUMA node of their CPU
+    bool numa_aware;
+    // allocate the database entries from memory backed by huge pages
+    bool huge_pages;
+    // keep the memory usage of the database below this many MiB by dropping secondary sorted indexes, 0 for no limit
+    uint32_t memory_budget;
+    // front code the names of the entries after a scan or load, saves memory but makes accessing names slower
+    bool front_coded_names;
+    // keep the database up to date by watching the filesystem for changes
+    bool monitor_filesystem;
+    // store the sorted indexes as 32-bit positions instead of pointers to save memory
+    bool compact_indexes;
+    // maintain a trigram index of the entry names to speed up substring searches, at the cost of memory
+    bool trigram_index;
+    // maintain an index of the whole entry names, so searches for exact names don't compare every entry
+    bool name_index;
+    // keep the paths of all folders in memory, so the paths of entries are built faster
+    bool folder_path_cache;
+    // keep the case folded forms of all non-ASCII names in memory, so searches for non-ASCII text are faster
+    bool folded_name_cache;
+    // keep Bloom filters of the names below every folder, so substring searches skip the folders they can't match
+    bool subtree_filters;
+    // also index the access, creation and status change times, each costs 8 bytes per entry
+    bool index_access_time;
+    bool index_creation_time;
+    bool index_status_change_time;
+    // also index the owner, group and permissions, costs 8 bytes per entry
+    bool index_owners;
+    // compression of the database file, only applies to files which get saved after changing it
+    FsearchDatabaseCompression database_compression;
 
     FsearchFilterManager *filters;
     GList *indexes;
     GList *exclude_locations;
     char **exclude_files;
+    // the extended attributes which get indexed and the folders whose entries they're read for (all if NULL)
+    char **xattr_names;
+    char **xattr_paths;
+    // databases which fsearch --print searches as well, see FsearchFederationSource
+    GList *federated_sources;
+    // the D-Bus address fsearchd accepts searches of other machines on, e.g. unix:path=/run/user/1000/fsearch-remote
+    char *remote_search_address;
 };
 
 bool
@@ -144,3 +200,7 @@ config_copy(FsearchConfig *config);
 
 void
 config_free(FsearchConfig *config);
+
+// The flags new queries get from the search settings of config (e.g. match_case)
+FsearchQueryFlags
+config_get_query_flags(FsearchConfig *config);
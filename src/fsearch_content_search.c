@@ -0,0 +1,311 @@
+#define G_LOG_DOMAIN "fsearch-content-search"
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+#include "fsearch_content_search.h"
+#include "fsearch_string_search.h"
+#include "fsearch_string_utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <pcre2.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// files with a NUL byte in their first bytes are considered binary
+#define BINARY_CHECK_LEN 8192
+// smaller files are read into a buffer, mapping them would cost more than copying their contents
+#define MIN_MAP_SIZE (1024 * 1024)
+#define CONTENT_CACHE_MAX_SIZE (1024 * 1024)
+
+typedef enum {
+    CONTENT_PATTERN_LITERAL,
+    CONTENT_PATTERN_LITERAL_ASCII_ICASE,
+    CONTENT_PATTERN_REGEX,
+} ContentPatternType;
+
+struct FsearchContentSearch {
+    ContentPatternType type;
+    char *needle;
+    size_t needle_len;
+
+    pcre2_code *regex;
+    bool regex_jit_available;
+
+    // identifies the needle and how it's matched in the content cache
+    uint32_t cache_id;
+};
+
+typedef struct {
+    uint32_t cache_id;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} ContentCacheKey;
+
+// ContentCacheKey -> GINT_TO_POINTER(whether the file matches)
+static GHashTable *content_cache = NULL;
+// the cache key of a needle -> its cache id, so a needle keeps its id across searches
+static GHashTable *content_cache_ids = NULL;
+static uint32_t content_cache_next_id = 0;
+static GMutex content_cache_mutex;
+
+static guint
+content_cache_key_hash(gconstpointer key) {
+    const ContentCacheKey *k = key;
+    guint hash = k->cache_id;
+    hash = hash * 31 + (guint)k->ino;
+    hash = hash * 31 + (guint)k->dev;
+    hash = hash * 31 + (guint)k->mtime_nsec;
+    return hash;
+}
+
+static gboolean
+content_cache_key_equal(gconstpointer a, gconstpointer b) {
+    const ContentCacheKey *k1 = a;
+    const ContentCacheKey *k2 = b;
+    return k1->cache_id == k2->cache_id && k1->dev == k2->dev && k1->ino == k2->ino && k1->size == k2->size
+        && k1->mtime_sec == k2->mtime_sec && k1->mtime_nsec == k2->mtime_nsec;
+}
+
+static uint32_t
+content_cache_get_id(ContentPatternType type, const char *needle) {
+    g_autofree char *key = g_strdup_printf("%d:%s", type, needle);
+
+    g_mutex_lock(&content_cache_mutex);
+    if (!content_cache_ids) {
+        content_cache_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+    gpointer id = NULL;
+    if (!g_hash_table_lookup_extended(content_cache_ids, key, NULL, &id)) {
+        id = GUINT_TO_POINTER(content_cache_next_id++);
+        g_hash_table_insert(content_cache_ids, g_steal_pointer(&key), id);
+    }
+    g_mutex_unlock(&content_cache_mutex);
+    return GPOINTER_TO_UINT(id);
+}
+
+static bool
+content_cache_lookup(const ContentCacheKey *key, bool *matches) {
+    g_mutex_lock(&content_cache_mutex);
+    gpointer value = NULL;
+    const bool found = content_cache && g_hash_table_lookup_extended(content_cache, key, NULL, &value);
+    g_mutex_unlock(&content_cache_mutex);
+    if (found) {
+        *matches = GPOINTER_TO_INT(value);
+    }
+    return found;
+}
+
+static void
+content_cache_insert(const ContentCacheKey *key, bool matches) {
+    g_mutex_lock(&content_cache_mutex);
+    if (!content_cache) {
+        content_cache = g_hash_table_new_full(content_cache_key_hash, content_cache_key_equal, free, NULL);
+    }
+    else if (g_hash_table_size(content_cache) >= CONTENT_CACHE_MAX_SIZE) {
+        g_hash_table_remove_all(content_cache);
+    }
+    ContentCacheKey *new_key = malloc(sizeof(ContentCacheKey));
+    g_assert(new_key);
+    *new_key = *key;
+    g_hash_table_replace(content_cache, new_key, GINT_TO_POINTER(matches));
+    g_mutex_unlock(&content_cache_mutex);
+}
+
+static bool
+compile_regex(FsearchContentSearch *search, const char *pattern, uint32_t options) {
+    int error_code = 0;
+    PCRE2_SIZE error_offset = 0;
+#ifdef PCRE2_MATCH_INVALID_UTF
+    // files aren't necessarily valid UTF-8
+    options |= PCRE2_MATCH_INVALID_UTF;
+#endif
+    search->regex = pcre2_compile((PCRE2_SPTR)pattern,
+                                  (PCRE2_SIZE)strlen(pattern),
+                                  options,
+                                  &error_code,
+                                  &error_offset,
+                                  NULL);
+    if (!search->regex) {
+        PCRE2_UCHAR buffer[256] = "";
+        pcre2_get_error_message(error_code, buffer, sizeof(buffer));
+        g_debug("PCRE2 compilation failed at offset %d. Error message: %s", (int)error_offset, buffer);
+        return false;
+    }
+    search->regex_jit_available = pcre2_jit_compile(search->regex, PCRE2_JIT_COMPLETE) == 0;
+    return true;
+}
+
+FsearchContentSearch *
+fsearch_content_search_new(const char *needle, bool match_case, bool regex) {
+    g_assert(needle);
+
+    FsearchContentSearch *search = calloc(1, sizeof(FsearchContentSearch));
+    g_assert(search);
+    search->needle = g_strdup(needle);
+    search->needle_len = strlen(needle);
+
+    const uint32_t case_options = match_case ? 0 : PCRE2_CASELESS;
+    if (regex) {
+        search->type = CONTENT_PATTERN_REGEX;
+        // ^ and $ match at the start and end of every line, like in grep
+        if (!compile_regex(search, needle, PCRE2_UTF | PCRE2_MULTILINE | case_options)) {
+            g_clear_pointer(&search, fsearch_content_search_free);
+            return NULL;
+        }
+    }
+    else if (match_case) {
+        search->type = CONTENT_PATTERN_LITERAL;
+    }
+    else if (fsearch_string_is_ascii_icase(needle)) {
+        search->type = CONTENT_PATTERN_LITERAL_ASCII_ICASE;
+    }
+    else {
+        // case folding of non-ASCII text is left to PCRE2
+        search->type = CONTENT_PATTERN_REGEX;
+        g_autofree char *pattern = g_regex_escape_string(needle, -1);
+        if (!compile_regex(search, pattern, PCRE2_UTF | case_options)) {
+            g_clear_pointer(&search, fsearch_content_search_free);
+            return NULL;
+        }
+    }
+    search->cache_id = content_cache_get_id(search->type, needle);
+    return search;
+}
+
+void
+fsearch_content_search_free(FsearchContentSearch *search) {
+    if (!search) {
+        return;
+    }
+    g_clear_pointer(&search->regex, pcre2_code_free);
+    g_clear_pointer(&search->needle, g_free);
+    g_clear_pointer(&search, free);
+}
+
+static bool
+regex_matches(FsearchContentSearch *search, const char *text, size_t text_len) {
+    pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(search->regex, NULL);
+    if (!match_data) {
+        return false;
+    }
+    int res = PCRE2_ERROR_NOMATCH;
+    if (search->regex_jit_available) {
+        res = pcre2_jit_match(search->regex, (PCRE2_SPTR)text, (PCRE2_SIZE)text_len, 0, 0, match_data, NULL);
+    }
+    if (!search->regex_jit_available || res == PCRE2_ERROR_JIT_STACKLIMIT) {
+        // the JIT stack isn't large enough for some patterns and files
+        res = pcre2_match(search->regex, (PCRE2_SPTR)text, (PCRE2_SIZE)text_len, 0, 0, match_data, NULL);
+    }
+    pcre2_match_data_free(match_data);
+    return res > 0;
+}
+
+static bool
+text_matches(FsearchContentSearch *search, const char *text, size_t text_len) {
+    if (memchr(text, '\0', MIN(text_len, BINARY_CHECK_LEN))) {
+        return false;
+    }
+    switch (search->type) {
+    case CONTENT_PATTERN_LITERAL:
+        return memmem(text, text_len, search->needle, search->needle_len) != NULL;
+    case CONTENT_PATTERN_LITERAL_ASCII_ICASE:
+        return fsearch_string_search_ascii_icase(text, text_len, search->needle, search->needle_len) != NULL;
+    case CONTENT_PATTERN_REGEX:
+        return regex_matches(search, text, text_len);
+    }
+    return false;
+}
+
+static bool
+read_file(int fd, char *buffer, size_t size) {
+    size_t bytes_read = 0;
+    while (bytes_read < size) {
+        const ssize_t res = pread(fd, buffer + bytes_read, size - bytes_read, (off_t)bytes_read);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        bytes_read += res;
+    }
+    return true;
+}
+
+// Returns false if the file couldn't be read
+static bool
+file_matches(FsearchContentSearch *search, int fd, size_t size, bool *matches) {
+    if (size < MIN_MAP_SIZE) {
+        char *buffer = g_malloc(size);
+        const bool read = read_file(fd, buffer, size);
+        *matches = read && text_matches(search, buffer, size);
+        g_free(buffer);
+        return read;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        g_debug("failed to map file: %s", g_strerror(errno));
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    *matches = text_matches(search, map, size);
+    munmap(map, size);
+    return true;
+}
+
+bool
+fsearch_content_search_matches_file(FsearchContentSearch *search, const char *path, GCancellable *cancellable) {
+    g_assert(search);
+    g_assert(path);
+
+    if (g_cancellable_is_cancelled(cancellable)) {
+        return false;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0
+        || st.st_size > FSEARCH_CONTENT_SEARCH_MAX_FILE_SIZE) {
+        return false;
+    }
+
+    ContentCacheKey key = {
+        .cache_id = search->cache_id,
+        .dev = st.st_dev,
+        .ino = st.st_ino,
+        .size = st.st_size,
+        .mtime_sec = st.st_mtim.tv_sec,
+        .mtime_nsec = st.st_mtim.tv_nsec,
+    };
+    bool matches = false;
+    if (content_cache_lookup(&key, &matches)) {
+        return matches;
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) {
+        return false;
+    }
+    // the file might have changed since it was looked up in the cache
+    struct stat fd_st;
+    if (fstat(fd, &fd_st) != 0 || fd_st.st_ino != st.st_ino || fd_st.st_size != st.st_size) {
+        close(fd);
+        return false;
+    }
+    const bool read = file_matches(search, fd, (size_t)st.st_size, &matches);
+    close(fd);
+
+    if (read) {
+        content_cache_insert(&key, matches);
+    }
+    return matches;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <stdbool.h>
+
+// Searches the contents of files for a string or a regex. Binary files, files which can't be read and files larger
+// than FSEARCH_CONTENT_SEARCH_MAX_FILE_SIZE never match.
+typedef struct FsearchContentSearch FsearchContentSearch;
+
+#define FSEARCH_CONTENT_SEARCH_MAX_FILE_SIZE (64 * 1024 * 1024)
+
+// Returns NULL if needle is an invalid regex
+FsearchContentSearch *
+fsearch_content_search_new(const char *needle, bool match_case, bool regex);
+
+void
+fsearch_content_search_free(FsearchContentSearch *search);
+
+// Returns true if the file at path contains a match. Can be called by several threads at once.
+// The results are cached by the device, inode, size and modification time of the file, so files which didn't
+// change since they were searched last time (by this or an earlier search for the same needle) aren't read again.
+// Returns false without reading the file once cancellable is cancelled.
+bool
+fsearch_content_search_matches_file(FsearchContentSearch *search, const char *path, GCancellable *cancellable);
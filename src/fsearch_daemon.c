@@ -0,0 +1,530 @@
+#define G_LOG_DOMAIN "fsearch-daemon"
+
+#include <config.h>
+
+#include "fsearch_daemon.h"
+#include "fsearch.h"
+#include "fsearch_cli.h"
+#include "fsearch_config.h"
+#include "fsearch_database.h"
+#include "fsearch_database_monitor.h"
+#include "fsearch_file_utils.h"
+
+#include <glib-unix.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char *daemon_introspection_xml = "<node>"
+                                              "  <interface name='" FSEARCH_DAEMON_INTERFACE "'>"
+                                              "    <method name='Update'/>"
+                                              "    <signal name='" FSEARCH_DAEMON_SIGNAL_DATABASE_CHANGED "'/>"
+                                              "  </interface>"
+                                              "</node>";
+
+typedef enum {
+    DAEMON_ACTION_LOAD = 1,
+    DAEMON_ACTION_SCAN,
+} DaemonAction;
+
+typedef struct {
+    GMainLoop *loop;
+    FsearchConfig *config;
+    // only replaced on the main thread, guarded by mutex
+    FsearchDatabase *db;
+    GMutex mutex;
+    FsearchDatabaseMonitor *monitor;
+    // loads and scans run one after another on a single thread
+    GThreadPool *db_pool;
+    GCancellable *db_thread_cancellable;
+    GDBusConnection *connection;
+    guint search_object_id;
+    guint daemon_object_id;
+    // accepts the searches of other machines on config->remote_search_address
+    GDBusServer *remote_server;
+    GList *remote_connections;
+    guint update_timeout_id;
+    // scans which were requested, but didn't finish yet
+    int num_scans_active;
+    int exit_status;
+    bool is_shutting_down;
+} FsearchDaemon;
+
+typedef struct {
+    FsearchDaemon *daemon;
+    DaemonAction action;
+    // started by the update timer, so the scan is paced if throttle_scheduled_updates is set
+    bool scheduled;
+    // the new database, NULL if the action failed
+    FsearchDatabase *db;
+    bool saved_file;
+} DaemonTask;
+
+static void
+daemon_enqueue(FsearchDaemon *daemon, DaemonAction action);
+
+static void
+daemon_task_free(DaemonTask *task) {
+    g_clear_pointer(&task->db, db_unref);
+    g_clear_pointer(&task, free);
+}
+
+static FsearchDatabase *
+daemon_get_database(gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    g_mutex_lock(&daemon->mutex);
+    FsearchDatabase *db = db_ref(daemon->db);
+    g_mutex_unlock(&daemon->mutex);
+    return db;
+}
+
+static gboolean
+on_daemon_scan_enqueue(gpointer user_data) {
+    daemon_enqueue(user_data, DAEMON_ACTION_SCAN);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_daemon_monitor_overflow(gpointer user_data) {
+    // events got lost, only a rescan can bring the database up to date again
+    g_idle_add(on_daemon_scan_enqueue, user_data);
+}
+
+static void
+daemon_monitor_restart(FsearchDaemon *daemon) {
+    g_clear_pointer(&daemon->monitor, fsearch_database_monitor_free);
+    // a queued rescan would carry over entries the monitor modifies, it gets restarted after the scan
+    if (daemon->config->monitor_filesystem && daemon->db && daemon->num_scans_active == 0) {
+        daemon->monitor =
+            fsearch_database_monitor_new(daemon->db, daemon->config->indexes, on_daemon_monitor_overflow, daemon);
+    }
+}
+
+static gboolean
+on_daemon_task_finished(gpointer user_data) {
+    DaemonTask *task = user_data;
+    FsearchDaemon *daemon = task->daemon;
+    if (daemon->is_shutting_down) {
+        g_clear_pointer(&task, daemon_task_free);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (task->action == DAEMON_ACTION_SCAN) {
+        daemon->num_scans_active--;
+    }
+    if (task->db) {
+        g_mutex_lock(&daemon->mutex);
+        g_clear_pointer(&daemon->db, db_unref_in_background);
+        daemon->db = g_steal_pointer(&task->db);
+        g_mutex_unlock(&daemon->mutex);
+    }
+    else if (task->action == DAEMON_ACTION_LOAD && !daemon->config->update_database_on_launch) {
+        // there's no database file yet or it can't be read
+        daemon_enqueue(daemon, DAEMON_ACTION_SCAN);
+    }
+    daemon_monitor_restart(daemon);
+
+    if (task->saved_file && daemon->connection) {
+        // the other processes can load the new file now
+        g_dbus_connection_emit_signal(daemon->connection,
+                                      NULL,
+                                      FSEARCH_DAEMON_OBJECT_PATH,
+                                      FSEARCH_DAEMON_INTERFACE,
+                                      FSEARCH_DAEMON_SIGNAL_DATABASE_CHANGED,
+                                      NULL,
+                                      NULL);
+    }
+    g_clear_pointer(&task, daemon_task_free);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+daemon_pool_func(gpointer data, gpointer user_data) {
+    DaemonTask *task = data;
+    FsearchDaemon *daemon = user_data;
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_timer_start(timer);
+
+    FsearchDatabase *db = fsearch_application_new_database(daemon->config);
+    if (task->scheduled) {
+        fsearch_application_throttle_scheduled_scan(db, daemon->config);
+    }
+    FsearchDatabase *old_db = daemon_get_database(daemon);
+    bool success = false;
+    if (task->action == DAEMON_ACTION_LOAD) {
+        g_autofree char *db_file_path = fsearch_application_get_database_file_path();
+        success = db_load(db, db_file_path, daemon->db_thread_cancellable, NULL);
+    }
+    else if (old_db) {
+        // only read folders again which changed since the current database was built
+        success = db_rescan(db, old_db, daemon->db_thread_cancellable, NULL);
+    }
+    else {
+        success = db_scan(db, daemon->db_thread_cancellable, NULL);
+    }
+    g_clear_pointer(&old_db, db_unref);
+    success = success && !g_cancellable_is_cancelled(daemon->db_thread_cancellable);
+
+    if (success && task->action == DAEMON_ACTION_SCAN) {
+        // the file is written right away, other processes get notified once it's complete
+        g_autofree char *db_path = fsearch_application_get_database_dir();
+        db_lock(db);
+        task->saved_file = db_path && db_save(db, db_path, daemon->db_thread_cancellable, NULL);
+        db_unlock(db);
+    }
+    if (success) {
+        task->db = g_steal_pointer(&db);
+    }
+    g_clear_pointer(&db, db_unref);
+
+    g_timer_stop(timer);
+    g_debug("%s %s in %.2f ms",
+            task->action == DAEMON_ACTION_LOAD ? "load" : "scan",
+            success ? "finished" : "failed",
+            g_timer_elapsed(timer, NULL) * 1000);
+
+    g_idle_add(on_daemon_task_finished, task);
+}
+
+static void
+daemon_enqueue_task(FsearchDaemon *daemon, DaemonAction action, bool scheduled) {
+    if (daemon->is_shutting_down) {
+        return;
+    }
+    if (action == DAEMON_ACTION_SCAN) {
+        if (daemon->num_scans_active > 1) {
+            // the queued scan will pick up the changes as well
+            return;
+        }
+        daemon->num_scans_active++;
+        // The rescan carries over entries of the current database, so it must not be modified
+        // by the monitor in the meantime. The monitor gets restarted once the scan is finished.
+        g_clear_pointer(&daemon->monitor, fsearch_database_monitor_free);
+    }
+    DaemonTask *task = calloc(1, sizeof(DaemonTask));
+    g_assert(task);
+    task->daemon = daemon;
+    task->action = action;
+    task->scheduled = scheduled;
+    g_thread_pool_push(daemon->db_pool, task, NULL);
+}
+
+static void
+daemon_enqueue(FsearchDaemon *daemon, DaemonAction action) {
+    daemon_enqueue_task(daemon, action, false);
+}
+
+static gboolean
+on_daemon_auto_update(gpointer user_data) {
+    g_debug("scheduled database update started");
+    daemon_enqueue_task(user_data, DAEMON_ACTION_SCAN, true);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+daemon_auto_update_init(FsearchDaemon *daemon) {
+    if (!daemon->config->update_database_every) {
+        return;
+    }
+    guint seconds =
+        daemon->config->update_database_every_hours * 3600 + daemon->config->update_database_every_minutes * 60;
+    if (seconds < 60) {
+        seconds = 60;
+    }
+    g_debug("update database every %d seconds", seconds);
+    daemon->update_timeout_id = g_timeout_add_seconds(seconds, on_daemon_auto_update, daemon);
+}
+
+static FsearchConfig *
+daemon_get_config(gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    return daemon->config;
+}
+
+static void
+daemon_handle_method_call(GDBusConnection *connection,
+                          const gchar *sender,
+                          const gchar *object_path,
+                          const gchar *interface_name,
+                          const gchar *method_name,
+                          GVariant *parameters,
+                          GDBusMethodInvocation *invocation,
+                          gpointer user_data) {
+    if (!g_strcmp0(method_name, "Update")) {
+        daemon_enqueue(user_data, DAEMON_ACTION_SCAN);
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+    else {
+        g_dbus_method_invocation_return_error(invocation,
+                                              G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method %s",
+                                              method_name);
+    }
+}
+
+static void
+on_bus_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    daemon->connection = g_object_ref(connection);
+
+    static const GDBusInterfaceVTable vtable = {daemon_handle_method_call, NULL, NULL};
+    g_autoptr(GDBusNodeInfo) introspection_data = g_dbus_node_info_new_for_xml(daemon_introspection_xml, NULL);
+    g_assert(introspection_data);
+
+    g_autoptr(GError) error = NULL;
+    daemon->daemon_object_id = g_dbus_connection_register_object(connection,
+                                                                 FSEARCH_DAEMON_OBJECT_PATH,
+                                                                 introspection_data->interfaces[0],
+                                                                 &vtable,
+                                                                 daemon,
+                                                                 NULL,
+                                                                 &error);
+    const FsearchCliSearchSource source = {daemon_get_database, daemon_get_config};
+    if (daemon->daemon_object_id) {
+        daemon->search_object_id =
+            fsearch_cli_register_search_object(connection, FSEARCH_DAEMON_OBJECT_PATH, &source, daemon, &error);
+    }
+    if (error) {
+        g_printerr("[fsearchd] failed to export the D-Bus interfaces: %s\n", error->message);
+        daemon->exit_status = EXIT_FAILURE;
+        g_main_loop_quit(daemon->loop);
+    }
+}
+
+static gboolean
+on_remote_allow_mechanism(GDBusAuthObserver *observer, const gchar *mechanism, gpointer user_data) {
+    // everyone who can reach the address could search the database otherwise
+    return g_strcmp0(mechanism, "ANONYMOUS") != 0;
+}
+
+static gboolean
+on_remote_authorize_peer(GDBusAuthObserver *observer,
+                         GIOStream *stream,
+                         GCredentials *credentials,
+                         gpointer user_data) {
+    if (!credentials) {
+        // DBUS_COOKIE_SHA1, the peer proved that it can read our keyring
+        return TRUE;
+    }
+    return g_credentials_get_unix_user(credentials, NULL) == getuid();
+}
+
+static void
+on_remote_connection_closed(GDBusConnection *connection,
+                            gboolean remote_peer_vanished,
+                            GError *error,
+                            gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    GList *link = g_list_find(daemon->remote_connections, connection);
+    if (!link) {
+        return;
+    }
+    g_debug("remote peer disconnected");
+    daemon->remote_connections = g_list_delete_link(daemon->remote_connections, link);
+    g_signal_handlers_disconnect_by_data(connection, daemon);
+    g_object_unref(connection);
+}
+
+static gboolean
+on_remote_new_connection(GDBusServer *server, GDBusConnection *connection, gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    const FsearchCliSearchSource source = {daemon_get_database, daemon_get_config};
+    g_autoptr(GError) error = NULL;
+    // the object stays registered until the connection is gone
+    if (!fsearch_cli_register_search_object(connection, FSEARCH_DAEMON_OBJECT_PATH, &source, daemon, &error)) {
+        g_printerr("[fsearchd] failed to export the search interface to a remote peer: %s\n", error->message);
+        return FALSE;
+    }
+    g_debug("remote peer connected");
+    daemon->remote_connections = g_list_prepend(daemon->remote_connections, g_object_ref(connection));
+    g_signal_connect(connection, "closed", G_CALLBACK(on_remote_connection_closed), daemon);
+    return TRUE;
+}
+
+static void
+daemon_remote_server_start(FsearchDaemon *daemon) {
+    if (!daemon->config->remote_search_address || !daemon->config->remote_search_address[0]) {
+        return;
+    }
+    g_autofree char *guid = g_dbus_generate_guid();
+    g_autoptr(GDBusAuthObserver) observer = g_dbus_auth_observer_new();
+    g_signal_connect(observer, "allow-mechanism", G_CALLBACK(on_remote_allow_mechanism), daemon);
+    g_signal_connect(observer, "authorize-authenticated-peer", G_CALLBACK(on_remote_authorize_peer), daemon);
+
+    g_autoptr(GError) error = NULL;
+    daemon->remote_server = g_dbus_server_new_sync(daemon->config->remote_search_address,
+                                                   G_DBUS_SERVER_FLAGS_NONE,
+                                                   guid,
+                                                   observer,
+                                                   NULL,
+                                                   &error);
+    if (!daemon->remote_server) {
+        // local clients can keep using the daemon
+        g_printerr("[fsearchd] failed to listen on %s: %s\n", daemon->config->remote_search_address, error->message);
+        return;
+    }
+    g_signal_connect(daemon->remote_server, "new-connection", G_CALLBACK(on_remote_new_connection), daemon);
+    g_dbus_server_start(daemon->remote_server);
+    g_debug("accepting remote searches on %s", daemon->config->remote_search_address);
+}
+
+static void
+daemon_remote_server_stop(FsearchDaemon *daemon) {
+    if (daemon->remote_server) {
+        g_dbus_server_stop(daemon->remote_server);
+        g_signal_handlers_disconnect_by_data(daemon->remote_server, daemon);
+        g_clear_object(&daemon->remote_server);
+    }
+    for (GList *c = daemon->remote_connections; c; c = c->next) {
+        GDBusConnection *connection = c->data;
+        g_signal_handlers_disconnect_by_data(connection, daemon);
+        g_dbus_connection_close_sync(connection, NULL, NULL);
+    }
+    g_list_free_full(g_steal_pointer(&daemon->remote_connections), g_object_unref);
+}
+
+static void
+on_name_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    g_debug("acquired %s", name);
+
+    daemon_enqueue(daemon, DAEMON_ACTION_LOAD);
+    if (daemon->config->update_database_on_launch) {
+        daemon_enqueue(daemon, DAEMON_ACTION_SCAN);
+    }
+    daemon_auto_update_init(daemon);
+    daemon_remote_server_start(daemon);
+}
+
+static void
+on_name_lost(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    if (!connection) {
+        g_printerr("[fsearchd] failed to connect to the session bus\n");
+    }
+    else {
+        g_printerr("[fsearchd] %s is owned by another process already\n", name);
+    }
+    daemon->exit_status = EXIT_FAILURE;
+    g_main_loop_quit(daemon->loop);
+}
+
+static gboolean
+on_quit_signal(gpointer user_data) {
+    FsearchDaemon *daemon = user_data;
+    g_debug("quit");
+    g_main_loop_quit(daemon->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+int
+fsearch_daemon_run(void) {
+    config_make_dir();
+    char data_dir[PATH_MAX] = "";
+    fsearch_file_utils_init_data_dir_path(data_dir, sizeof(data_dir));
+    fsearch_file_utils_create_dir(data_dir);
+
+    FsearchDaemon daemon = {
+        .exit_status = EXIT_SUCCESS,
+    };
+    daemon.config = calloc(1, sizeof(FsearchConfig));
+    g_assert(daemon.config);
+    if (!config_load(daemon.config) && !config_load_default(daemon.config)) {
+        g_printerr("[fsearchd] failed to load config\n");
+        g_clear_pointer(&daemon.config, config_free);
+        return EXIT_FAILURE;
+    }
+
+    g_mutex_init(&daemon.mutex);
+    daemon.loop = g_main_loop_new(NULL, FALSE);
+    daemon.db_thread_cancellable = g_cancellable_new();
+    daemon.db_pool = g_thread_pool_new(daemon_pool_func, &daemon, 1, TRUE, NULL);
+    const guint sigint_id = g_unix_signal_add(SIGINT, on_quit_signal, &daemon);
+    const guint sigterm_id = g_unix_signal_add(SIGTERM, on_quit_signal, &daemon);
+    const guint owner_id = g_bus_own_name(G_BUS_TYPE_SESSION,
+                                          FSEARCH_DAEMON_BUS_NAME,
+                                          G_BUS_NAME_OWNER_FLAGS_NONE,
+                                          on_bus_acquired,
+                                          on_name_acquired,
+                                          on_name_lost,
+                                          &daemon,
+                                          NULL);
+
+    g_main_loop_run(daemon.loop);
+
+    daemon.is_shutting_down = true;
+    g_bus_unown_name(owner_id);
+    daemon_remote_server_stop(&daemon);
+    if (daemon.connection) {
+        if (daemon.search_object_id) {
+            g_dbus_connection_unregister_object(daemon.connection, daemon.search_object_id);
+        }
+        if (daemon.daemon_object_id) {
+            g_dbus_connection_unregister_object(daemon.connection, daemon.daemon_object_id);
+        }
+    }
+    g_source_remove(sigint_id);
+    g_source_remove(sigterm_id);
+    if (daemon.update_timeout_id) {
+        g_source_remove(daemon.update_timeout_id);
+    }
+
+    g_debug("waiting for database thread to exit...");
+    g_cancellable_cancel(daemon.db_thread_cancellable);
+    g_thread_pool_free(g_steal_pointer(&daemon.db_pool), FALSE, TRUE);
+    // free the results of the tasks which finished in the meantime
+    while (g_main_context_iteration(NULL, FALSE)) {
+    }
+
+    g_clear_pointer(&daemon.monitor, fsearch_database_monitor_free);
+    // don't exit before the journal got compacted into a complete database file
+    db_save_wait_for_background_saves();
+    g_clear_pointer(&daemon.db, db_unref_on_exit);
+    g_clear_object(&daemon.db_thread_cancellable);
+    g_clear_object(&daemon.connection);
+    g_clear_pointer(&daemon.loop, g_main_loop_unref);
+    g_clear_pointer(&daemon.config, config_free);
+    g_mutex_clear(&daemon.mutex);
+    return daemon.exit_status;
+}
+
+bool
+fsearch_daemon_request_update(GDBusConnection *connection) {
+    g_return_val_if_fail(connection, false);
+    g_autoptr(GVariant) reply = g_dbus_connection_call_sync(connection,
+                                                            FSEARCH_DAEMON_BUS_NAME,
+                                                            FSEARCH_DAEMON_OBJECT_PATH,
+                                                            FSEARCH_DAEMON_INTERFACE,
+                                                            "Update",
+                                                            NULL,
+                                                            NULL,
+                                                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                            -1,
+                                                            NULL,
+                                                            NULL);
+    return reply != NULL;
+}
+
+bool
+fsearch_daemon_is_running(GDBusConnection *connection) {
+    g_return_val_if_fail(connection, false);
+    g_autoptr(GVariant) reply = g_dbus_connection_call_sync(connection,
+                                                            "org.freedesktop.DBus",
+                                                            "/org/freedesktop/DBus",
+                                                            "org.freedesktop.DBus",
+                                                            "NameHasOwner",
+                                                            g_variant_new("(s)", FSEARCH_DAEMON_BUS_NAME),
+                                                            G_VARIANT_TYPE("(b)"),
+                                                            G_DBUS_CALL_FLAGS_NONE,
+                                                            -1,
+                                                            NULL,
+                                                            NULL);
+    gboolean has_owner = FALSE;
+    if (reply) {
+        g_variant_get(reply, "(b)", &has_owner);
+    }
+    return has_owner;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <stdbool.h>
+
+// fsearchd owns this name while it runs. It keeps the database file up to date (scans, monitoring and regular
+// updates) and runs searches of the CLI on the database it holds in memory. Other processes load the file it writes,
+// so they don't need to scan themselves. Each of them still decodes its own copy of the entries.
+#define FSEARCH_DAEMON_BUS_NAME "io.github.cboxdoerfer.FSearchDaemon"
+#define FSEARCH_DAEMON_OBJECT_PATH "/io/github/cboxdoerfer/FSearchDaemon"
+#define FSEARCH_DAEMON_INTERFACE "io.github.cboxdoerfer.FSearch.Daemon"
+// emitted once a newer database file was written
+#define FSEARCH_DAEMON_SIGNAL_DATABASE_CHANGED "DatabaseChanged"
+
+// Runs the daemon until it gets SIGINT or SIGTERM. Returns the exit status.
+int
+fsearch_daemon_run(void);
+
+// Asks the running daemon to rescan the database, returns false if there's none
+bool
+fsearch_daemon_request_update(GDBusConnection *connection);
+
+bool
+fsearch_daemon_is_running(GDBusConnection *connection);
@@ -24,7 +24,6 @@
 
 #include <dirent.h>
 #include <fcntl.h>
-#include <fnmatch.h>
 #include <glib/gi18n.h>
 
 #ifdef HAVE_MALLOC_TRIM
@@ -37,43 +36,231 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+#include "fsearch_array_merge.h"
+#include "fsearch_block_array.h"
 #include "fsearch_database.h"
 #include "fsearch_database_entry.h"
+#include "fsearch_database_entry_columns.h"
+#include "fsearch_database_journal.h"
+#include "fsearch_database_view.h"
+#include "fsearch_directory_reader.h"
+#include "fsearch_exclude_matcher.h"
 #include "fsearch_exclude_path.h"
 #include "fsearch_index.h"
+#include "fsearch_limits.h"
 #include "fsearch_memory_pool.h"
+#include "fsearch_name_blocks.h"
+#include "fsearch_operation_stats.h"
+#include "fsearch_scan_throttle.h"
+#include "fsearch_shared_results.h"
+#include "fsearch_string_pool.h"
 #include "fsearch_task.h"
+#include "fsearch_task_ids.h"
+#include "fsearch_trace.h"
+#include "fsearch_trigram_index.h"
+#include "fsearch_xattr.h"
 
+// the number of entries of the first block of the memory pools, they grow with the database from there
 #define NUM_DB_ENTRIES_FOR_POOL_BLOCK 10000
 
 #define DATABASE_MAJOR_VERSION 0
-#define DATABASE_MINOR_VERSION 9
+#define DATABASE_MINOR_VERSION 13
 #define DATABASE_MAGIC_NUMBER "FSDB"
+// first minor version which stores a chunk table for the folder and file blocks
+#define DATABASE_MINOR_VERSION_CHUNKS 10
+// first minor version which supports compressed blocks and stores the sorted indexes as varints
+#define DATABASE_MINOR_VERSION_COMPRESSION 11
+// first minor version which can store the optional access, creation and status change times
+#define DATABASE_MINOR_VERSION_OPTIONAL_TIMES 12
+// first minor version which can store the owner, group and mode
+#define DATABASE_MINOR_VERSION_OWNER 13
+// Every chunk of entries starts with a full name, so chunks can be loaded independently
+#define DATABASE_CHUNK_NUM_ENTRIES 65536
+// uid, gid and mode of an entry
+#define DATABASE_OWNER_SIZE (4 + 4 + 2)
+// upper bound of the size of a single encoded entry: db_index, name offset and length, name, size,
+// modification time, optional times, owner and parent index
+#define DATABASE_MAX_ENTRY_SIZE (2 + 1 + 1 + UINT8_MAX + 8 + 8 + 3 * 8 + DATABASE_OWNER_SIZE + 4)
+// used when the database file can't be mapped into memory
+#define DATABASE_READ_BLOCK_SIZE (4 * 1024 * 1024)
+#define DATABASE_WRITE_BUFFER_SIZE (1024 * 1024)
+// Optional blocks which follow the sorted arrays, they're made up of an id and their size. Loaders skip the
+// ones they don't know about.
+#define DATABASE_BLOCK_TRIGRAM_INDEX 1
+#define DATABASE_BLOCK_XATTRS 2
+#define DATABASE_BLOCK_FOLDER_IDENTITIES 3
+
+// the journal gets compacted into a new database file once it's larger or older than this
+#define DATABASE_JOURNAL_MAX_SIZE (16 * 1024 * 1024)
+#define DATABASE_JOURNAL_MAX_AGE (24 * 60 * 60)
+
+// malloc_trim walks the whole heap, that's only worth it once a database of at least this size was freed
+#define DATABASE_MALLOC_TRIM_MIN_SIZE (16 * 1024 * 1024)
+
+// the optional times in the order they're stored after the modification time of an entry
+static const struct {
+    FsearchDatabaseIndexFlags flag;
+    FsearchDatabaseIndexType type;
+} db_optional_times[] = {
+    {DATABASE_INDEX_FLAG_ACCESS_TIME, DATABASE_INDEX_TYPE_ACCESS_TIME},
+    {DATABASE_INDEX_FLAG_CREATION_TIME, DATABASE_INDEX_TYPE_CREATION_TIME},
+    {DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME},
+};
+
+// Sorted arrays which are still only stored in the mapped database file, they get decoded when they're
+// requested for the first time
+typedef struct {
+    GMappedFile *mapped_file;
+    // position of the sorted arrays in the file, 0 if they're not pending
+    size_t offsets[NUM_DATABASE_INDEX_TYPES];
+    bool encoded;
+    FsearchDatabaseCompression compression;
+} DatabasePendingSortedArrays;
+
+struct FsearchDatabaseSnapshot {
+    // only used to add sorted arrays which weren't created yet when the snapshot was published
+    FsearchDatabase *db;
+    uint64_t version;
+
+    // the sorted arrays are set once and never change afterwards
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES];
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES];
+    // built from the sorted arrays on the first request, see db_snapshot_get_folder_ranks
+    uint32_t *folder_ranks[NUM_DATABASE_INDEX_TYPES];
+    uint32_t *file_ranks[NUM_DATABASE_INDEX_TYPES];
+    FsearchTrigramIndex *folder_trigram_index;
+    FsearchTrigramIndex *file_trigram_index;
+    FsearchNameIndex *folder_name_index;
+    FsearchNameIndex *file_name_index;
+    FsearchFolderPaths *folder_paths;
+    FsearchFoldedNames *folded_names;
+    FsearchSubtreeFilter *subtree_filter;
+
+    volatile int ref_count;
+};
 
 struct FsearchDatabase {
     DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES];
     DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES];
+    DatabasePendingSortedArrays *pending_sorted_arrays;
+    // Once the database receives updates, they're applied to block arrays of all indexes, so they don't need to be
+    // rebuilt every time. The name and path arrays are created from them after every update, all other sorted
+    // arrays only when they're requested (until then they're NULL).
+    FsearchBlockArray *file_blocks[NUM_DATABASE_INDEX_TYPES];
+    FsearchBlockArray *folder_blocks[NUM_DATABASE_INDEX_TYPES];
+    // built for the name sorted arrays
+    FsearchTrigramIndex *folder_trigram_index;
+    FsearchTrigramIndex *file_trigram_index;
+    // also built for the name sorted arrays, NULL unless name_indexes is set
+    FsearchNameIndex *folder_name_index;
+    FsearchNameIndex *file_name_index;
+    // the paths of the name sorted folders, NULL unless folder_path_cache is set
+    FsearchFolderPaths *folder_paths;
+    // the folded non-ASCII names of the name sorted arrays, NULL unless folded_name_cache is set
+    FsearchFoldedNames *folded_names;
+    // built for the path sorted arrays, NULL unless subtree_filters is set
+    FsearchSubtreeFilter *subtree_filter;
 
     FsearchMemoryPool *file_pool;
     FsearchMemoryPool *folder_pool;
+    // the names of all entries, apart from the front coded ones
+    FsearchStringPool *name_pool;
+    // see db_set_front_coded_names, NULL unless the names were front coded
+    FsearchNameBlocks *name_blocks;
 
     GList *db_views;
     FsearchThreadPool *thread_pool;
+    // the CPUs the threads of all pools may run on, see fsearch_thread_pool_new_with_affinity
+    char *worker_cpu_list;
 
     FsearchDatabaseIndexFlags index_flags;
+    // the optional times db_scan indexes, see db_set_optional_times
+    FsearchDatabaseIndexFlags optional_times;
+    // whether db_scan indexes the owners, see db_set_index_owners
+    bool index_owners;
+    // the extended attributes db_scan indexes and the folders it reads them in, see db_set_xattrs
+    char **xattr_names;
+    char **xattr_paths;
+    // the entries were loaded without the extended attributes of xattr_names, so they can't be carried over
+    bool xattrs_outdated;
+    // the optional values (DATABASE_INDEX_FLAGS_OPTIONAL) the entries of file_pool and folder_pool have room for
+    FsearchDatabaseIndexFlags entry_optional_values;
 
     GList *indexes;
     GList *excludes;
     char **exclude_files;
+    // compiled from excludes and exclude_files, used while scanning
+    FsearchExcludeMatcher *exclude_matcher;
 
     bool exclude_hidden;
+    uint32_t num_scan_threads;
+    // NULL if scans run at full speed, see db_set_scan_throttle
+    FsearchScanThrottle *scan_throttle;
+    // store the sorted arrays other than the name ones as positions in the name arrays
+    bool compact_indexes;
+    bool trigram_indexes;
+    bool name_indexes;
+    bool folder_path_cache;
+    bool folded_name_cache;
+    bool subtree_filters;
+    // back the entry memory pools with huge pages
+    bool huge_pages;
+    bool front_coded_names;
+    // see db_set_memory_budget, 0 if there's no limit
+    size_t memory_budget;
+    // used by db_save
+    FsearchDatabaseCompression compression;
     time_t timestamp;
 
+    // paths updated since the database was loaded from or saved to save_dir
+    FsearchDatabaseJournal *journal;
+    char *save_dir;
+    // see db_set_read_only_file
+    bool read_only_file;
+    // the journal gets compacted by a background save which hasn't finished yet
+    bool background_save_pending;
+
+    // the sorted arrays db_sort leaves out are built by a background task, see db_build_indexes_in_background
+    bool background_indexes_pending;
+    // the sorted array that task builds first, see db_set_index_priority
+    volatile gint index_priority;
+    // where db_save_in_background saves the database once that task is done, NULL if it doesn't
+    char *pending_save_path;
+
+    // memory and name pools of previous databases, which hold the names of the entries copied by db_rescan and the
+    // entries themselves if it took over the sorted arrays of the previous database
+    GList *shared_pools;
+    GList *shared_name_pools;
+    GList *shared_name_blocks;
+    // number of entries in the pools, or whose names are in the shared pools, which aren't part of the database
+    // anymore
+    uint32_t num_stale_entries;
+
+    // the version readers get from db_get_snapshot, replaced by db_publish_snapshot under snapshot_mutex
+    FsearchDatabaseSnapshot *snapshot;
+    GMutex snapshot_mutex;
+
+    // the search results and sorts its views compute, so views with the same query don't repeat them
+    FsearchSharedResults *shared_results;
+
+    // how the latest scan, load and save went, see db_get_operation_stats
+    FsearchOperationStats operation_stats[NUM_FSEARCH_OPERATIONS];
+    GMutex operation_stats_mutex;
+
+    // what happens once the last reference is gone, see db_unref_in_background and db_unref_on_exit
+    bool free_in_background;
+    bool release_on_exit;
     volatile int ref_count;
 
     GMutex mutex;
@@ -105,12 +292,200 @@ db_unregister_view(FsearchDatabase *db, gpointer view) {
     return true;
 }
 
+static void
+db_pending_sorted_arrays_free(DatabasePendingSortedArrays *pending) {
+    if (!pending) {
+        return;
+    }
+    g_clear_pointer(&pending->mapped_file, g_mapped_file_unref);
+    g_clear_pointer(&pending, free);
+}
+
 static void
 db_sorted_entries_free(FsearchDatabase *db) {
     for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
         g_clear_pointer(&db->sorted_files[i], darray_unref);
         g_clear_pointer(&db->sorted_folders[i], darray_unref);
+        g_clear_pointer(&db->file_blocks[i], fsearch_block_array_free);
+        g_clear_pointer(&db->folder_blocks[i], fsearch_block_array_free);
+    }
+    g_clear_pointer(&db->pending_sorted_arrays, db_pending_sorted_arrays_free);
+    g_clear_pointer(&db->folder_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&db->file_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&db->folder_name_index, fsearch_name_index_unref);
+    g_clear_pointer(&db->file_name_index, fsearch_name_index_unref);
+    g_clear_pointer(&db->folder_paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&db->folded_names, fsearch_folded_names_unref);
+    g_clear_pointer(&db->subtree_filter, fsearch_subtree_filter_unref);
+}
+
+FsearchDatabaseSnapshot *
+db_snapshot_ref(FsearchDatabaseSnapshot *snapshot) {
+    if (!snapshot || g_atomic_int_get(&snapshot->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&snapshot->ref_count);
+    return snapshot;
+}
+
+void
+db_snapshot_unref(FsearchDatabaseSnapshot *snapshot) {
+    if (!snapshot || g_atomic_int_get(&snapshot->ref_count) <= 0) {
+        return;
+    }
+    if (!g_atomic_int_dec_and_test(&snapshot->ref_count)) {
+        return;
+    }
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_clear_pointer(&snapshot->sorted_files[i], darray_unref);
+        g_clear_pointer(&snapshot->sorted_folders[i], darray_unref);
+        g_clear_pointer(&snapshot->file_ranks[i], free);
+        g_clear_pointer(&snapshot->folder_ranks[i], free);
+    }
+    g_clear_pointer(&snapshot->folder_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&snapshot->file_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&snapshot->folder_name_index, fsearch_name_index_unref);
+    g_clear_pointer(&snapshot->file_name_index, fsearch_name_index_unref);
+    g_clear_pointer(&snapshot->folder_paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&snapshot->folded_names, fsearch_folded_names_unref);
+    g_clear_pointer(&snapshot->subtree_filter, fsearch_subtree_filter_unref);
+    g_clear_pointer(&snapshot, free);
+}
+
+// Makes the current sorted arrays and indexes the version readers get. They only share references with the
+// database, so the previous snapshot stays intact for readers which still use it and gets released with their
+// last reference. The database must be locked or not shared yet.
+static size_t
+db_memory_usage_add_array(FsearchDatabaseMemoryUsage *usage, GHashTable *counted_arrays, DynamicArray *array) {
+    // arrays which are shared by several indexes or with views are only counted once
+    if (!array || !g_hash_table_add(counted_arrays, array)) {
+        return 0;
     }
+    usage->entry_columns += db_entry_columns_get_memory_usage(array);
+    return darray_get_memory_usage(array);
+}
+
+// The database must be locked
+static void
+db_get_memory_usage_locked(FsearchDatabase *db, FsearchDatabaseMemoryUsage *usage, GHashTable *counted_arrays) {
+    usage->entries += fsearch_memory_pool_get_memory_usage(db->file_pool);
+    usage->entries += fsearch_memory_pool_get_memory_usage(db->folder_pool);
+    for (GList *p = db->shared_pools; p != NULL; p = p->next) {
+        usage->entries += fsearch_memory_pool_get_memory_usage(p->data);
+    }
+    usage->names += fsearch_string_pool_get_memory_usage(db->name_pool);
+    for (GList *p = db->shared_name_pools; p != NULL; p = p->next) {
+        usage->names += fsearch_string_pool_get_memory_usage(p->data);
+    }
+    usage->names += fsearch_name_blocks_get_memory_usage(db->name_blocks);
+    for (GList *p = db->shared_name_blocks; p != NULL; p = p->next) {
+        usage->names += fsearch_name_blocks_get_memory_usage(p->data);
+    }
+
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        usage->sorted_arrays[i] += db_memory_usage_add_array(usage, counted_arrays, db->sorted_files[i]);
+        usage->sorted_arrays[i] += db_memory_usage_add_array(usage, counted_arrays, db->sorted_folders[i]);
+        usage->sorted_arrays[i] += fsearch_block_array_get_memory_usage(db->file_blocks[i]);
+        usage->sorted_arrays[i] += fsearch_block_array_get_memory_usage(db->folder_blocks[i]);
+    }
+    usage->trigram_indexes += fsearch_trigram_index_get_memory_usage(db->folder_trigram_index);
+    usage->trigram_indexes += fsearch_trigram_index_get_memory_usage(db->file_trigram_index);
+    usage->name_indexes += fsearch_name_index_get_memory_usage(db->folder_name_index);
+    usage->name_indexes += fsearch_name_index_get_memory_usage(db->file_name_index);
+    usage->folder_paths += fsearch_folder_paths_get_memory_usage(db->folder_paths);
+    usage->folded_names += fsearch_folded_names_get_memory_usage(db->folded_names);
+    usage->subtree_filters += fsearch_subtree_filter_get_memory_usage(db->subtree_filter);
+}
+
+// The memory used by the database itself, without its views. The database must be locked.
+static size_t
+db_get_own_memory_usage(FsearchDatabase *db) {
+    FsearchDatabaseMemoryUsage usage = {};
+    GHashTable *counted_arrays = g_hash_table_new(g_direct_hash, g_direct_equal);
+    db_get_memory_usage_locked(db, &usage, counted_arrays);
+    g_clear_pointer(&counted_arrays, g_hash_table_unref);
+    return db_memory_usage_get_total(&usage);
+}
+
+static void
+db_drop_sorted_array(DynamicArray **array, DynamicArray *name_array, size_t *usage) {
+    // the extension and type sorted folders are the name sorted ones, which stay
+    if (*array && *array != name_array) {
+        *usage -= MIN(*usage, darray_get_memory_usage(*array));
+    }
+    g_clear_pointer(array, darray_unref);
+}
+
+// Drops sorted arrays other than the name and path ones until the database fits into its memory budget, the ones
+// at the end of FsearchDatabaseIndexType first. Arrays which can be flattened from their block arrays go before
+// everything else, they're created again when they're requested. After that whole indexes get dropped, views then
+// sort their results by those types on their own.
+static void
+db_apply_memory_budget(FsearchDatabase *db) {
+    if (db->memory_budget == 0) {
+        return;
+    }
+    size_t usage = db_get_own_memory_usage(db);
+    if (usage <= db->memory_budget) {
+        return;
+    }
+    const size_t usage_before = usage;
+
+    for (int32_t i = NUM_DATABASE_INDEX_TYPES - 1; i > DATABASE_INDEX_TYPE_PATH && usage > db->memory_budget; i--) {
+        if (db->file_blocks[i]) {
+            db_drop_sorted_array(&db->sorted_files[i], db->sorted_files[DATABASE_INDEX_TYPE_NAME], &usage);
+        }
+        if (db->folder_blocks[i]) {
+            db_drop_sorted_array(&db->sorted_folders[i], db->sorted_folders[DATABASE_INDEX_TYPE_NAME], &usage);
+        }
+    }
+    for (int32_t i = NUM_DATABASE_INDEX_TYPES - 1; i > DATABASE_INDEX_TYPE_PATH && usage > db->memory_budget; i--) {
+        db_drop_sorted_array(&db->sorted_files[i], db->sorted_files[DATABASE_INDEX_TYPE_NAME], &usage);
+        db_drop_sorted_array(&db->sorted_folders[i], db->sorted_folders[DATABASE_INDEX_TYPE_NAME], &usage);
+        usage -= MIN(usage, fsearch_block_array_get_memory_usage(db->file_blocks[i]));
+        usage -= MIN(usage, fsearch_block_array_get_memory_usage(db->folder_blocks[i]));
+        g_clear_pointer(&db->file_blocks[i], fsearch_block_array_free);
+        g_clear_pointer(&db->folder_blocks[i], fsearch_block_array_free);
+        if (db->pending_sorted_arrays) {
+            db->pending_sorted_arrays->offsets[i] = 0;
+        }
+    }
+    g_debug("[db_memory_budget] dropped sorted arrays: %zu -> %zu bytes (budget: %zu bytes)",
+            usage_before,
+            usage,
+            db->memory_budget);
+}
+
+static void
+db_publish_snapshot(FsearchDatabase *db) {
+    // arrays which get dropped now aren't part of the new version
+    db_apply_memory_budget(db);
+
+    FsearchDatabaseSnapshot *snapshot = calloc(1, sizeof(FsearchDatabaseSnapshot));
+    g_assert(snapshot);
+
+    snapshot->db = db;
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        snapshot->sorted_files[i] = darray_ref(db->sorted_files[i]);
+        snapshot->sorted_folders[i] = darray_ref(db->sorted_folders[i]);
+    }
+    snapshot->folder_trigram_index = fsearch_trigram_index_ref(db->folder_trigram_index);
+    snapshot->file_trigram_index = fsearch_trigram_index_ref(db->file_trigram_index);
+    snapshot->folder_name_index = fsearch_name_index_ref(db->folder_name_index);
+    snapshot->file_name_index = fsearch_name_index_ref(db->file_name_index);
+    snapshot->folder_paths = fsearch_folder_paths_ref(db->folder_paths);
+    snapshot->folded_names = fsearch_folded_names_ref(db->folded_names);
+    snapshot->subtree_filter = fsearch_subtree_filter_ref(db->subtree_filter);
+    snapshot->ref_count = 1;
+
+    g_mutex_lock(&db->snapshot_mutex);
+    FsearchDatabaseSnapshot *old_snapshot = db->snapshot;
+    snapshot->version = old_snapshot ? old_snapshot->version + 1 : 0;
+    db->snapshot = snapshot;
+    g_mutex_unlock(&db->snapshot_mutex);
+
+    g_debug("[db_snapshot] published version %" PRIu64, snapshot->version);
+    g_clear_pointer(&old_snapshot, db_snapshot_unref);
 }
 
 static bool
@@ -121,45 +496,144 @@ is_cancelled(GCancellable *cancellable) {
     return false;
 }
 
+static uint32_t
+db_entry_get_name_array_idx(FsearchDatabaseEntry *entry, gpointer data) {
+    return db_entry_get_idx(entry);
+}
+
 static void
-db_sort_entries(FsearchDatabase *db, DynamicArray *entries, DynamicArray **sorted_entries, GCancellable *cancellable) {
-    // first sort by path
-    darray_sort_multi_threaded(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path, cancellable, NULL);
-    if (is_cancelled(cancellable)) {
+db_compact_sorted_entries_of_type(DynamicArray **sorted_entries) {
+    DynamicArray *entries = sorted_entries[DATABASE_INDEX_TYPE_NAME];
+    if (!entries) {
         return;
     }
-    sorted_entries[DATABASE_INDEX_TYPE_PATH] = darray_copy(entries);
+    // the idx of an entry is its position in the name array
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (entry) {
+            db_entry_set_idx(entry, i);
+        }
+    }
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (sorted_entries[i] && sorted_entries[i] != entries) {
+            darray_compact(sorted_entries[i], entries, (DynamicArrayIndexFunc)db_entry_get_name_array_idx, NULL);
+        }
+    }
+}
 
-    // then by name
-    darray_sort(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_name, cancellable, NULL);
-    if (is_cancelled(cancellable)) {
+static void
+db_compact_sorted_entries(FsearchDatabase *db) {
+    if (!db->compact_indexes) {
         return;
     }
+    g_autoptr(GTimer) timer = g_timer_new();
+    db_compact_sorted_entries_of_type(db->sorted_files);
+    db_compact_sorted_entries_of_type(db->sorted_folders);
+    g_debug("[db_compact] compacted sorted arrays in %f s", g_timer_elapsed(timer, NULL));
+}
 
-    // now build individual lists sorted by all of the indexed metadata
-    if ((db->index_flags & DATABASE_INDEX_FLAG_SIZE) != 0) {
-        sorted_entries[DATABASE_INDEX_TYPE_SIZE] = darray_copy(entries);
-        darray_sort_multi_threaded(sorted_entries[DATABASE_INDEX_TYPE_SIZE],
-                                   (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_size,
-                                   cancellable,
-                                   NULL);
-        if (is_cancelled(cancellable)) {
-            return;
+static gint
+compare_file_types(const char **a, const char **b) {
+    return strcmp(*a, *b);
+}
+
+// Sorts files by type, entries of the same type keep the order they have in files. The types are only looked up
+// once per entry instead of with every comparison, since that involves a hash table lookup.
+static DynamicArray *
+db_sort_files_by_file_type(DynamicArray *files, GCancellable *cancellable) {
+    const uint32_t num_files = darray_get_num_items(files);
+    g_autofree const char **file_types = calloc(num_files + 1, sizeof(char *));
+    g_assert(file_types);
+
+    // the type strings are unique, so they can be ranked by their address
+    g_autoptr(GHashTable) type_ranks = g_hash_table_new(NULL, NULL);
+    for (uint32_t i = 0; i < num_files; i++) {
+        file_types[i] = db_entry_get_file_type(darray_get_item(files, i));
+        g_hash_table_add(type_ranks, (gpointer)file_types[i]);
+        if (G_UNLIKELY(i % 65536 == 0 && is_cancelled(cancellable))) {
+            return NULL;
         }
     }
 
-    if ((db->index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) != 0) {
-        sorted_entries[DATABASE_INDEX_TYPE_MODIFICATION_TIME] = darray_copy(entries);
-        darray_sort_multi_threaded(sorted_entries[DATABASE_INDEX_TYPE_MODIFICATION_TIME],
-                                   (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_modification_time,
+    g_autoptr(GPtrArray) types = g_ptr_array_sized_new(g_hash_table_size(type_ranks));
+    GHashTableIter iter;
+    gpointer type = NULL;
+    g_hash_table_iter_init(&iter, type_ranks);
+    while (g_hash_table_iter_next(&iter, &type, NULL)) {
+        g_ptr_array_add(types, type);
+    }
+    g_ptr_array_sort(types, (GCompareFunc)compare_file_types);
+    g_autofree uint32_t *offsets = calloc(types->len + 1, sizeof(uint32_t));
+    g_assert(offsets);
+    for (uint32_t i = 0; i < types->len; i++) {
+        g_hash_table_insert(type_ranks, g_ptr_array_index(types, i), GUINT_TO_POINTER(i));
+    }
+    for (uint32_t i = 0; i < num_files; i++) {
+        offsets[GPOINTER_TO_UINT(g_hash_table_lookup(type_ranks, file_types[i])) + 1]++;
+    }
+    for (uint32_t i = 1; i < types->len; i++) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    g_autofree void **sorted = calloc(num_files + 1, sizeof(void *));
+    g_assert(sorted);
+    for (uint32_t i = 0; i < num_files; i++) {
+        const uint32_t rank = GPOINTER_TO_UINT(g_hash_table_lookup(type_ranks, file_types[i]));
+        sorted[offsets[rank]++] = darray_get_item(files, i);
+    }
+
+    DynamicArray *sorted_files = darray_new(num_files);
+    darray_add_items(sorted_files, sorted, num_files);
+    return sorted_files;
+}
+
+// The orders by integer attributes, which get sorted by key
+static const struct {
+    FsearchDatabaseIndexFlags flag;
+    FsearchDatabaseIndexType type;
+    DynamicArrayKeyFunc key_func;
+} db_key_sorted_types[] = {
+    {DATABASE_INDEX_FLAG_SIZE, DATABASE_INDEX_TYPE_SIZE, (DynamicArrayKeyFunc)db_entry_get_size_sort_key},
+    {DATABASE_INDEX_FLAG_MODIFICATION_TIME,
+     DATABASE_INDEX_TYPE_MODIFICATION_TIME,
+     (DynamicArrayKeyFunc)db_entry_get_modification_time_sort_key},
+    {DATABASE_INDEX_FLAG_ACCESS_TIME,
+     DATABASE_INDEX_TYPE_ACCESS_TIME,
+     (DynamicArrayKeyFunc)db_entry_get_access_time_sort_key},
+    {DATABASE_INDEX_FLAG_CREATION_TIME,
+     DATABASE_INDEX_TYPE_CREATION_TIME,
+     (DynamicArrayKeyFunc)db_entry_get_creation_time_sort_key},
+    {DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME,
+     DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME,
+     (DynamicArrayKeyFunc)db_entry_get_status_change_time_sort_key},
+    {DATABASE_INDEX_FLAG_OWNER, DATABASE_INDEX_TYPE_OWNER, (DynamicArrayKeyFunc)db_entry_get_owner_sort_key},
+};
+
+static void
+db_sort_entries(FsearchDatabase *db, DynamicArray *entries, DynamicArray **sorted_entries, GCancellable *cancellable) {
+    // first sort by path
+    darray_sort_multi_threaded(entries,
+                               (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path,
+                               db->thread_pool,
+                               cancellable,
+                               NULL);
+    if (is_cancelled(cancellable)) {
+        return;
+    }
+    sorted_entries[DATABASE_INDEX_TYPE_PATH] = darray_copy(entries);
+
+    // then by name, most entries are already ordered by the start of their names, only the rest gets compared
+    darray_sort_by_key_and_compare(entries,
+                                   (DynamicArrayKeyFunc)db_entry_get_name_sort_key,
+                                   (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_name,
+                                   db->thread_pool,
                                    cancellable,
                                    NULL);
-        if (is_cancelled(cancellable)) {
-            return;
-        }
-    }
 }
 
+// Only sorts the entries by path and name, that's all searches need. The other sorted arrays get built by
+// db_build_indexes_in_background once the database is published.
 static void
 db_sort(FsearchDatabase *db, GCancellable *cancellable) {
     g_assert(db);
@@ -174,16 +648,6 @@ db_sort(FsearchDatabase *db, GCancellable *cancellable) {
             return;
         }
 
-        // now build extension sort array
-        db->sorted_files[DATABASE_INDEX_TYPE_EXTENSION] = darray_copy(files);
-        darray_sort_multi_threaded(db->sorted_files[DATABASE_INDEX_TYPE_EXTENSION],
-                                   (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_extension,
-                                   cancellable,
-                                   NULL);
-        if (is_cancelled(cancellable)) {
-            return;
-        }
-
         const double seconds = g_timer_elapsed(timer, NULL);
         g_timer_reset(timer);
         g_debug("[db_sort] sorted files: %f s", seconds);
@@ -197,12 +661,11 @@ db_sort(FsearchDatabase *db, GCancellable *cancellable) {
             return;
         }
 
-        // Folders don't have a file extension -> use the name array instead
-        db->sorted_folders[DATABASE_INDEX_TYPE_EXTENSION] = darray_ref(folders);
-
         const double seconds = g_timer_elapsed(timer, NULL);
         g_debug("[db_sort] sorted folders: %f s", seconds);
     }
+
+    db_compact_sorted_entries(db);
 }
 
 static void
@@ -211,21 +674,218 @@ db_update_timestamp(FsearchDatabase *db) {
     db->timestamp = time(NULL);
 }
 
+// entries which get their idx set by one task
+#define DB_UPDATE_INDICES_GRAIN_SIZE (1 << 16)
+
+static void
+db_entry_update_indices_range(uint32_t start, uint32_t end, void *data) {
+    DynamicArray *entries = data;
+    for (uint32_t i = start; i < end; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry) {
+            continue;
+        }
+        db_entry_set_idx(entry, i);
+    }
+}
+
+static void
+db_entry_update_indices(FsearchDatabase *db, DynamicArray *entries) {
+    if (!entries) {
+        return;
+    }
+    fsearch_thread_pool_parallel_for(db->thread_pool,
+                                     0,
+                                     darray_get_num_items(entries),
+                                     DB_UPDATE_INDICES_GRAIN_SIZE,
+                                     db_entry_update_indices_range,
+                                     entries);
+}
+
 static void
 db_entry_update_folder_indices(FsearchDatabase *db) {
-    if (!db || !db->sorted_folders[DATABASE_INDEX_TYPE_NAME]) {
+    if (!db) {
         return;
     }
-    const uint32_t num_folders = darray_get_num_items(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
-    for (uint32_t i = 0; i < num_folders; i++) {
-        FsearchDatabaseEntryFolder *folder = darray_get_item(db->sorted_folders[DATABASE_INDEX_TYPE_NAME], i);
-        if (!folder) {
-            continue;
+    db_entry_update_indices(db, db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+}
+
+static void
+db_entry_update_file_indices(FsearchDatabase *db) {
+    if (!db) {
+        return;
+    }
+    db_entry_update_indices(db, db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+}
+
+// The trigram indexes resolve their entries through the idx, which must be the position in the name arrays
+static void
+db_update_trigram_indexes(FsearchDatabase *db, DynamicArray *new_folders, DynamicArray *new_files) {
+    if (!db->trigram_indexes) {
+        return;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    db_entry_update_folder_indices(db);
+    db_entry_update_file_indices(db);
+
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    FsearchTrigramIndex *folder_index = folders ? fsearch_trigram_index_new_updated(db->folder_trigram_index,
+                                                                                    folders,
+                                                                                    new_folders,
+                                                                                    db->thread_pool)
+                                                : NULL;
+    FsearchTrigramIndex *file_index =
+        files ? fsearch_trigram_index_new_updated(db->file_trigram_index, files, new_files, db->thread_pool) : NULL;
+    g_clear_pointer(&db->folder_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&db->file_trigram_index, fsearch_trigram_index_unref);
+    db->folder_trigram_index = folder_index;
+    db->file_trigram_index = file_index;
+    g_debug("[db_trigram_index] updated trigram indexes in %f s", g_timer_elapsed(timer, NULL));
+}
+
+static void
+db_build_trigram_indexes(FsearchDatabase *db) {
+    g_clear_pointer(&db->folder_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&db->file_trigram_index, fsearch_trigram_index_unref);
+    db_update_trigram_indexes(db, NULL, NULL);
+}
+
+// Like the trigram indexes, the name indexes resolve their entries through the idx
+static void
+db_update_name_indexes(FsearchDatabase *db, DynamicArray *new_folders, DynamicArray *new_files) {
+    if (!db->name_indexes) {
+        return;
+    }
+    db_entry_update_folder_indices(db);
+    db_entry_update_file_indices(db);
+
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    FsearchNameIndex *folder_index =
+        folders ? fsearch_name_index_new_updated(db->folder_name_index, folders, new_folders, db->thread_pool) : NULL;
+    FsearchNameIndex *file_index =
+        files ? fsearch_name_index_new_updated(db->file_name_index, files, new_files, db->thread_pool) : NULL;
+    g_clear_pointer(&db->folder_name_index, fsearch_name_index_unref);
+    g_clear_pointer(&db->file_name_index, fsearch_name_index_unref);
+    db->folder_name_index = folder_index;
+    db->file_name_index = file_index;
+}
+
+static void
+db_build_name_indexes(FsearchDatabase *db) {
+    g_clear_pointer(&db->folder_name_index, fsearch_name_index_unref);
+    g_clear_pointer(&db->file_name_index, fsearch_name_index_unref);
+    db_update_name_indexes(db, NULL, NULL);
+}
+
+// The paths are looked up by the idx of the folders, so it must be their position in the name array. Updates can
+// move whole subtrees, so the paths are always built from scratch, which only takes a single pass over the folders.
+static void
+db_build_folder_paths(FsearchDatabase *db) {
+    g_clear_pointer(&db->folder_paths, fsearch_folder_paths_unref);
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    if (!db->folder_path_cache || !folders) {
+        return;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    db->folder_paths = fsearch_folder_paths_new(folders);
+    g_debug("[db_folder_paths] built folder paths in %f s", g_timer_elapsed(timer, NULL));
+}
+
+// Like the folder paths, the folded names are looked up by idx and always built from scratch
+static void
+db_build_folded_names(FsearchDatabase *db) {
+    g_clear_pointer(&db->folded_names, fsearch_folded_names_unref);
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    if (!db->folded_name_cache || (!folders && !files)) {
+        return;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    db->folded_names = fsearch_folded_names_new(folders, files);
+    g_debug("[db_folded_names] built folded names in %f s", g_timer_elapsed(timer, NULL));
+}
+
+static void
+db_load_pending_sorted_arrays(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
+
+// The subtrees of the path arrays change with every update as well, so the filters are always built from scratch
+static void
+db_build_subtree_filter(FsearchDatabase *db) {
+    g_clear_pointer(&db->subtree_filter, fsearch_subtree_filter_unref);
+    if (!db->subtree_filters) {
+        return;
+    }
+    // the filters need the path arrays right away, even if the others are loaded once they're requested
+    db_load_pending_sorted_arrays(db, DATABASE_INDEX_TYPE_PATH);
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_PATH];
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_PATH];
+    if (!folders || !files) {
+        return;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    db->subtree_filter = fsearch_subtree_filter_new(folders, files);
+    g_debug("[db_subtree_filter] built subtree filters in %f s", g_timer_elapsed(timer, NULL));
+}
+
+static void
+db_front_code_entry_names(DynamicArray *entries,
+                          FsearchNameBlocks *name_blocks,
+                          FsearchStringPool *name_pool,
+                          uint32_t *num_plain) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        const char *name = db_entry_get_name_raw(entry);
+        const char *handle = fsearch_name_blocks_add(name_blocks, name);
+        if (handle) {
+            db_entry_set_name_front_coded(entry, handle);
+        }
+        else {
+            // too long to be front coded
+            db_entry_set_name_no_copy(entry, fsearch_string_pool_add(name_pool, name, strlen(name)));
+            (*num_plain)++;
         }
-        db_entry_set_idx((FsearchDatabaseEntry *)folder, i);
     }
 }
 
+// Moves the names of all entries into front coded name blocks, in the order of the name sorted arrays, so
+// neighbouring names share long prefixes. Entries must not be shared with another database, their names change.
+static void
+db_front_code_names(FsearchDatabase *db) {
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    if (!db->front_coded_names || (!folders && !files)) {
+        return;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    const size_t old_size =
+        fsearch_string_pool_get_memory_usage(db->name_pool) + fsearch_name_blocks_get_memory_usage(db->name_blocks);
+
+    FsearchNameBlocks *name_blocks = fsearch_name_blocks_new();
+    FsearchStringPool *name_pool = fsearch_string_pool_new(false);
+    uint32_t num_plain = 0;
+    db_front_code_entry_names(folders, name_blocks, name_pool, &num_plain);
+    db_front_code_entry_names(files, name_blocks, name_pool, &num_plain);
+
+    g_clear_pointer(&db->name_pool, fsearch_string_pool_unref);
+    g_clear_pointer(&db->name_blocks, fsearch_name_blocks_unref);
+    db->name_pool = name_pool;
+    db->name_blocks = name_blocks;
+
+    g_debug("[db_front_code_names] %zu -> %zu bytes, %d names not front coded, in %f s",
+            old_size,
+            fsearch_string_pool_get_memory_usage(db->name_pool) + fsearch_name_blocks_get_memory_usage(db->name_blocks),
+            num_plain,
+            g_timer_elapsed(timer, NULL));
+}
+
+static void
+db_entry_set_pooled_name(FsearchStringPool *name_pool, FsearchDatabaseEntry *entry, const char *name, size_t name_len) {
+    db_entry_set_name_no_copy(entry, fsearch_string_pool_add(name_pool, name, name_len));
+}
+
 static uint8_t
 get_name_offset(const char *old, const char *new) {
     if (!old || !new) {
@@ -257,36 +917,111 @@ db_file_open_locked(const char *file_path, const char *mode) {
     return file_pointer;
 }
 
+// The database file gets mapped into memory (or read into a buffer if that fails) and every entry is decoded from it
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} DatabaseFileReader;
+
+static const uint8_t *
+db_file_reader_get_block(DatabaseFileReader *reader, size_t len) {
+    if (len > reader->size - reader->pos) {
+        return NULL;
+    }
+    const uint8_t *block = reader->data + reader->pos;
+    reader->pos += len;
+    return block;
+}
+
+static bool
+db_file_reader_read(DatabaseFileReader *reader, void *dest, size_t len) {
+    const uint8_t *block = db_file_reader_get_block(reader, len);
+    if (!block) {
+        return false;
+    }
+    memcpy(dest, block, len);
+    return true;
+}
+
+static uint8_t *
+db_file_read_contents(FILE *fp, size_t *size) {
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || st.st_size < 0) {
+        g_debug("[db_load] failed to get size of database file");
+        return NULL;
+    }
+    const size_t file_size = (size_t)st.st_size;
+    uint8_t *buffer = malloc(file_size + 1);
+    g_assert(buffer);
+
+    size_t bytes_read = 0;
+    while (bytes_read < file_size) {
+        const size_t len = MIN(file_size - bytes_read, DATABASE_READ_BLOCK_SIZE);
+        if (fread(buffer + bytes_read, 1, len, fp) != len) {
+            g_debug("[db_load] failed to read database file");
+            g_clear_pointer(&buffer, free);
+            return NULL;
+        }
+        bytes_read += len;
+    }
+    *size = file_size;
+    return buffer;
+}
+
 static const uint8_t *
 copy_bytes_and_return_new_src(void *dest, const uint8_t *src, size_t len) {
     memcpy(dest, src, len);
     return src + len;
 }
 
+// Returns NULL if the entry would extend past block_end
 static const uint8_t *
 db_load_entry_super_elements_from_memory(const uint8_t *data_block,
+                                         const uint8_t *block_end,
                                          FsearchDatabaseIndexFlags index_flags,
+                                         FsearchStringPool *name_pool,
                                          FsearchDatabaseEntry *entry,
                                          GString *previous_entry_name) {
+    if (block_end - data_block < 2) {
+        return NULL;
+    }
     // name_offset: character position after which previous_entry_name and entry_name differ
     uint8_t name_offset = *data_block++;
 
     // name_len: length of the new name characters
     uint8_t name_len = *data_block++;
 
+    size_t num_bytes = name_len;
+    if ((index_flags & DATABASE_INDEX_FLAG_SIZE) != 0) {
+        num_bytes += 8;
+    }
+    if ((index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) != 0) {
+        num_bytes += 8;
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_optional_times); i++) {
+        if ((index_flags & db_optional_times[i].flag) != 0) {
+            num_bytes += 8;
+        }
+    }
+    if ((index_flags & DATABASE_INDEX_FLAG_OWNER) != 0) {
+        num_bytes += DATABASE_OWNER_SIZE;
+    }
+    if ((size_t)(block_end - data_block) < num_bytes || name_offset > previous_entry_name->len) {
+        return NULL;
+    }
+
     // erase previous name starting at name_offset
-    g_string_erase(previous_entry_name, name_offset, -1);
+    g_string_truncate(previous_entry_name, name_offset);
 
-    char name[256] = "";
     // name: new characters to be appended to previous_entry_name
     if (name_len > 0) {
-        data_block = copy_bytes_and_return_new_src(name, data_block, name_len);
-        name[name_len] = '\0';
+        g_string_append_len(previous_entry_name, (const char *)data_block, name_len);
+        data_block += name_len;
     }
 
     // now we can build the new full file name
-    g_string_append(previous_entry_name, name);
-    db_entry_set_name(entry, previous_entry_name->str);
+    db_entry_set_pooled_name(name_pool, entry, previous_entry_name->str, previous_entry_name->len);
 
     if ((index_flags & DATABASE_INDEX_FLAG_SIZE) != 0) {
         // size: size of file/folder
@@ -304,62 +1039,34 @@ db_load_entry_super_elements_from_memory(const uint8_t *data_block,
         db_entry_set_mtime(entry, (time_t)mtime);
     }
 
-    return data_block;
-}
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_optional_times); i++) {
+        if ((index_flags & db_optional_times[i].flag) != 0) {
+            int64_t time = 0;
+            data_block = copy_bytes_and_return_new_src(&time, data_block, 8);
 
-static bool
-read_element_from_file(void *restrict ptr, size_t size, FILE *restrict stream) {
-    return fread(ptr, size, 1, stream) == 1 ? true : false;
-}
+            db_entry_set_time(entry, db_optional_times[i].type, (time_t)time);
+        }
+    }
 
-static bool
-db_load_entry_super_elements(FILE *fp, FsearchDatabaseEntry *entry, GString *previous_entry_name) {
-    // name_offset: character position after which previous_entry_name and entry_name differ
-    uint8_t name_offset = 0;
-    if (!read_element_from_file(&name_offset, 1, fp)) {
-        g_debug("[db_load] failed to load name offset");
-        return false;
+    if ((index_flags & DATABASE_INDEX_FLAG_OWNER) != 0) {
+        // owner: uid, gid and mode
+        uint32_t uid = 0;
+        uint32_t gid = 0;
+        uint16_t mode = 0;
+        data_block = copy_bytes_and_return_new_src(&uid, data_block, 4);
+        data_block = copy_bytes_and_return_new_src(&gid, data_block, 4);
+        data_block = copy_bytes_and_return_new_src(&mode, data_block, 2);
+
+        db_entry_set_owner(entry, uid, gid, mode);
     }
 
-    // name_len: length of the new name characters
-    uint8_t name_len = 0;
-    if (!read_element_from_file(&name_len, 1, fp)) {
-        g_debug("[db_load] failed to load name length");
-        return false;
-    }
-
-    // erase previous name starting at name_offset
-    g_string_erase(previous_entry_name, name_offset, -1);
-
-    char name[256] = "";
-    // name: new characters to be appended to previous_entry_name
-    if (name_len > 0) {
-        if (!read_element_from_file(name, name_len, fp)) {
-            g_debug("[db_load] failed to load name");
-            return false;
-        }
-        name[name_len] = '\0';
-    }
-
-    // now we can build the new full file name
-    g_string_append(previous_entry_name, name);
-    db_entry_set_name(entry, previous_entry_name->str);
-
-    // size: size of file/folder
-    uint64_t size = 0;
-    if (!read_element_from_file(&size, 8, fp)) {
-        g_debug("[db_load] failed to load size");
-        return false;
-    }
-    db_entry_set_size(entry, (off_t)size);
-
-    return true;
+    return data_block;
 }
 
 static bool
-db_load_header(FILE *fp) {
+db_load_header(DatabaseFileReader *reader, uint8_t *minor_version) {
     char magic[5] = "";
-    if (!read_element_from_file(magic, strlen(DATABASE_MAGIC_NUMBER), fp)) {
+    if (!db_file_reader_read(reader, magic, strlen(DATABASE_MAGIC_NUMBER))) {
         return false;
     }
     magic[4] = '\0';
@@ -369,7 +1076,7 @@ db_load_header(FILE *fp) {
     }
 
     uint8_t majorver = 0;
-    if (!read_element_from_file(&majorver, 1, fp)) {
+    if (!db_file_reader_read(reader, &majorver, 1)) {
         return false;
     }
     if (majorver != DATABASE_MAJOR_VERSION) {
@@ -379,7 +1086,7 @@ db_load_header(FILE *fp) {
     }
 
     uint8_t minorver = 0;
-    if (!read_element_from_file(&minorver, 1, fp)) {
+    if (!db_file_reader_read(reader, &minorver, 1)) {
         return false;
     }
     if (minorver > DATABASE_MINOR_VERSION) {
@@ -387,55 +1094,325 @@ db_load_header(FILE *fp) {
         g_debug("[db_load] expected minor version: <= %d", DATABASE_MINOR_VERSION);
         return false;
     }
+    *minor_version = minorver;
 
     return true;
 }
 
+// How many entries of a load or save are done, it's stopped once cancellable gets cancelled
+typedef struct {
+    GCancellable *cancellable;
+    void (*status_cb)(const char *);
+    // what's done right now, the percentage gets appended to it
+    const char *status_text;
+    uint32_t num_entries;
+    volatile gint num_entries_done;
+
+    GTimer *timer;
+    GMutex mutex;
+} DatabaseProgress;
+
+static void
+db_progress_init(DatabaseProgress *progress,
+                 GCancellable *cancellable,
+                 void (*status_cb)(const char *),
+                 uint32_t num_entries) {
+    progress->cancellable = cancellable;
+    progress->status_cb = status_cb;
+    progress->status_text = NULL;
+    progress->num_entries = num_entries;
+    progress->num_entries_done = 0;
+    progress->timer = g_timer_new();
+    g_mutex_init(&progress->mutex);
+}
+
+static void
+db_progress_clear(DatabaseProgress *progress) {
+    g_clear_pointer(&progress->timer, g_timer_destroy);
+    g_mutex_clear(&progress->mutex);
+}
+
+static bool
+db_progress_is_cancelled(DatabaseProgress *progress) {
+    return progress && g_cancellable_is_cancelled(progress->cancellable);
+}
+
+static void
+db_progress_notify(DatabaseProgress *progress, bool force) {
+    if (!progress->status_cb || !progress->status_text) {
+        return;
+    }
+    // the other threads report their progress soon enough, no need to wait for the lock
+    if (!g_mutex_trylock(&progress->mutex)) {
+        return;
+    }
+    if (force || g_timer_elapsed(progress->timer, NULL) > 0.1) {
+        const uint64_t num_entries_done = (uint32_t)g_atomic_int_get(&progress->num_entries_done);
+        const uint32_t percent =
+            progress->num_entries > 0 ? MIN(num_entries_done * 100 / progress->num_entries, 100) : 100;
+        g_autofree char *text = g_strdup_printf("%s %u%%", progress->status_text, percent);
+        progress->status_cb(text);
+        g_timer_start(progress->timer);
+    }
+    g_mutex_unlock(&progress->mutex);
+}
+
+// Starts the next step, which gets reported right away
+static void
+db_progress_set_status(DatabaseProgress *progress, const char *status_text) {
+    if (!progress) {
+        return;
+    }
+    progress->status_text = status_text;
+    db_progress_notify(progress, true);
+}
+
+// Returns false once the load or save should stop
+static bool
+db_progress_add(DatabaseProgress *progress, uint32_t num_entries) {
+    if (!progress) {
+        return true;
+    }
+    g_atomic_int_add(&progress->num_entries_done, (gint)num_entries);
+    db_progress_notify(progress, false);
+    return !db_progress_is_cancelled(progress);
+}
+
+typedef struct {
+    const uint8_t *block;
+    uint64_t block_size;
+    // offsets of the chunks within block
+    uint64_t *chunk_offsets;
+    uint32_t num_chunks;
+    uint32_t chunk_size;
+
+    FsearchDatabaseIndexFlags index_flags;
+    FsearchDatabaseCompression compression;
+    FsearchDatabaseEntryType type;
+    DynamicArray *entries;
+    // the parent indexes are resolved once all chunks are loaded
+    uint32_t *parent_indexes;
+    uint32_t num_entries;
+    // the chunks which are left to be decoded
+    FsearchThreadPoolRanges *chunks;
+    DatabaseProgress *progress;
+
+    volatile int failed;
+} DatabaseLoadBlockContext;
+
+static void
+db_load_block_context_clear(DatabaseLoadBlockContext *ctx) {
+    g_clear_pointer(&ctx->chunk_offsets, free);
+    g_clear_pointer(&ctx->parent_indexes, free);
+}
+
+typedef struct {
+    DatabaseLoadBlockContext *ctx;
+    FsearchStringPool *name_pool;
+} DatabaseLoadWorker;
+
 static bool
-db_load_parent_idx(FILE *fp, uint32_t *parent_idx) {
-    if (!read_element_from_file(parent_idx, 4, fp)) {
-        g_debug("[db_load] failed to load parent_idx");
+db_load_chunk_table(DatabaseFileReader *reader, DatabaseLoadBlockContext *ctx, bool has_chunk_table) {
+    if (!has_chunk_table) {
+        // older files consist of a single chunk
+        ctx->chunk_size = MAX(ctx->num_entries, 1);
+        ctx->num_chunks = ctx->num_entries > 0 ? 1 : 0;
+        ctx->chunk_offsets = calloc(ctx->num_chunks + 1, sizeof(uint64_t));
+        g_assert(ctx->chunk_offsets);
+        return true;
+    }
+
+    ctx->num_chunks = ctx->num_entries / ctx->chunk_size + (ctx->num_entries % ctx->chunk_size ? 1 : 0);
+    ctx->chunk_offsets = calloc(ctx->num_chunks + 1, sizeof(uint64_t));
+    g_assert(ctx->chunk_offsets);
+    if (!db_file_reader_read(reader, ctx->chunk_offsets, (size_t)ctx->num_chunks * 8)) {
+        g_debug("[db_load] failed to load chunk offsets");
         return false;
     }
     return true;
 }
 
 static bool
-db_load_folders(FILE *fp,
-                FsearchDatabaseIndexFlags index_flags,
-                DynamicArray *folders,
-                uint32_t num_folders,
-                uint64_t folder_block_size) {
+db_load_chunk_offsets_are_valid(DatabaseLoadBlockContext *ctx) {
+    for (uint32_t i = 0; i < ctx->num_chunks; i++) {
+        if ((i == 0 && ctx->chunk_offsets[i] != 0) || ctx->chunk_offsets[i] > ctx->block_size
+            || (i > 0 && ctx->chunk_offsets[i] < ctx->chunk_offsets[i - 1])) {
+            g_debug("[db_load] invalid chunk offset: %" PRIu64, ctx->chunk_offsets[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads data stored by db_save_compressed, returns a newly allocated buffer with the uncompressed data
+static uint8_t *
+db_load_compressed(DatabaseFileReader *reader, FsearchDatabaseCompression compression, size_t max_len, size_t *len) {
+    uint32_t uncompressed_len = 0;
+    uint32_t compressed_len = 0;
+    if (!db_file_reader_read(reader, &uncompressed_len, 4) || !db_file_reader_read(reader, &compressed_len, 4)) {
+        return NULL;
+    }
+    const uint8_t *data = db_file_reader_get_block(reader, compressed_len);
+    if (!data || uncompressed_len > max_len) {
+        g_debug("[db_load] invalid size of compressed data: %d, %d", uncompressed_len, compressed_len);
+        return NULL;
+    }
+
+    uint8_t *dest = malloc(uncompressed_len + 1);
+    g_assert(dest);
+    if (!db_compression_decompress(compression, data, compressed_len, dest, uncompressed_len)) {
+        g_debug("[db_load] failed to decompress data");
+        g_clear_pointer(&dest, free);
+        return NULL;
+    }
+    *len = uncompressed_len;
+    return dest;
+}
+
+static bool
+db_load_chunk(DatabaseLoadBlockContext *ctx, uint32_t chunk, FsearchStringPool *name_pool) {
     g_autoptr(GString) previous_entry_name = g_string_sized_new(256);
 
-    g_autofree uint8_t *folder_block = calloc(folder_block_size + 1, sizeof(uint8_t));
-    g_assert(folder_block);
+    const uint32_t start = chunk * ctx->chunk_size;
+    const uint32_t end = MIN(start + ctx->chunk_size, ctx->num_entries);
+    const uint8_t *fb = ctx->block + ctx->chunk_offsets[chunk];
+    const uint64_t chunk_end_offset = chunk + 1 < ctx->num_chunks ? ctx->chunk_offsets[chunk + 1] : ctx->block_size;
+    const uint8_t *chunk_end = ctx->block + chunk_end_offset;
+
+    g_autofree uint8_t *uncompressed = NULL;
+    if (ctx->compression != DATABASE_COMPRESSION_NONE) {
+        DatabaseFileReader chunk_reader = {.data = fb, .size = chunk_end - fb, .pos = 0};
+        const size_t max_len = (size_t)(end - start) * DATABASE_MAX_ENTRY_SIZE;
+        size_t uncompressed_len = 0;
+        uncompressed = db_load_compressed(&chunk_reader, ctx->compression, max_len, &uncompressed_len);
+        if (!uncompressed || chunk_reader.pos != chunk_reader.size) {
+            return false;
+        }
+        fb = uncompressed;
+        chunk_end = uncompressed + uncompressed_len;
+    }
+    const uint8_t *chunk_start = fb;
 
-    if (fread(folder_block, sizeof(uint8_t), folder_block_size, fp) != folder_block_size) {
-        g_debug("[db_load] failed to read file block");
+    for (uint32_t idx = start; idx < end; idx++) {
+        // the entries are initialized here instead of when they're allocated, so their memory gets first touched
+        // by the thread which decodes the chunk
+        FsearchDatabaseEntry *entry = darray_get_item(ctx->entries, idx);
+        db_entry_set_idx(entry, idx);
+        db_entry_set_type(entry, ctx->type);
+        db_entry_init_optional_values(entry, ctx->index_flags);
+
+        if (ctx->type == DATABASE_ENTRY_TYPE_FOLDER) {
+            db_entry_set_parent(entry, NULL);
+            if (chunk_end - fb < 2) {
+                return false;
+            }
+            // TODO: db_index is currently unused
+            // db_index: the database index this folder belongs to
+            uint16_t db_index = 0;
+            fb = copy_bytes_and_return_new_src(&db_index, fb, 2);
+        }
+
+        fb = db_load_entry_super_elements_from_memory(fb,
+                                                      chunk_end,
+                                                      ctx->index_flags,
+                                                      name_pool,
+                                                      entry,
+                                                      previous_entry_name);
+        if (!fb || chunk_end - fb < 4) {
+            return false;
+        }
+
+        // parent_idx: index of parent folder
+        fb = copy_bytes_and_return_new_src(&ctx->parent_indexes[idx], fb, 4);
+    }
+
+    // fail if we didn't read the correct number of bytes
+    if (fb != chunk_end) {
+        g_debug("[db_load] wrong amount of memory read: %zd != %zd", fb - chunk_start, chunk_end - chunk_start);
         return false;
     }
+    return true;
+}
 
-    const uint8_t *fb = folder_block;
-    // load folders
-    uint32_t idx = 0;
-    for (idx = 0; idx < num_folders; idx++) {
-        FsearchDatabaseEntryFolder *folder = darray_get_item(folders, idx);
-        FsearchDatabaseEntry *entry = (FsearchDatabaseEntry *)folder;
+// Returns false once the block failed to load or the load got cancelled
+static bool
+db_load_chunk_done(DatabaseLoadBlockContext *ctx, uint32_t chunk) {
+    const uint32_t start = chunk * ctx->chunk_size;
+    const uint32_t end = MIN(start + ctx->chunk_size, ctx->num_entries);
+    return db_progress_add(ctx->progress, end - start);
+}
+
+static void
+db_load_worker(void *data) {
+    DatabaseLoadWorker *worker = data;
+    DatabaseLoadBlockContext *ctx = worker->ctx;
+    uint32_t chunk = 0;
+    while (fsearch_thread_pool_ranges_next(ctx->chunks, &chunk)) {
+        if (g_atomic_int_get(&ctx->failed)) {
+            break;
+        }
+        if (!db_load_chunk(ctx, chunk, worker->name_pool) || !db_load_chunk_done(ctx, chunk)) {
+            g_atomic_int_set(&ctx->failed, 1);
+            break;
+        }
+    }
+}
+
+// Decodes all entries of a block, multiple chunks are decoded in parallel
+static bool
+db_load_block(DatabaseLoadBlockContext *ctx, FsearchThreadPool *thread_pool, FsearchStringPool *name_pool) {
+    if (!db_load_chunk_offsets_are_valid(ctx)) {
+        return false;
+    }
+    const uint32_t num_threads = thread_pool ? fsearch_thread_pool_get_num_threads(thread_pool) : 1;
+    const uint32_t num_workers = MIN(num_threads, ctx->num_chunks);
+    if (num_workers < 2) {
+        for (uint32_t chunk = 0; chunk < ctx->num_chunks; chunk++) {
+            if (!db_load_chunk(ctx, chunk, name_pool) || !db_load_chunk_done(ctx, chunk)) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-        // TODO: db_index is currently unused
-        // db_index: the database index this folder belongs to
-        uint16_t db_index = 0;
-        fb = copy_bytes_and_return_new_src(&db_index, fb, 2);
+    g_debug("[db_load] loading %d chunks with %d threads", ctx->num_chunks, num_workers);
+    DatabaseLoadWorker workers[num_workers];
+    for (uint32_t i = 0; i < num_workers; i++) {
+        workers[i].ctx = ctx;
+        // the string pools aren't thread safe
+        workers[i].name_pool = fsearch_string_pool_new(true);
+    }
+    // in NUMA aware pools every thread decodes its own range of chunks, which is searched by the same thread later
+    ctx->chunks = fsearch_thread_pool_ranges_new(thread_pool, &ctx->num_chunks, 1);
+    fsearch_thread_pool_run(thread_pool, db_load_worker, workers, sizeof(DatabaseLoadWorker), num_workers);
+    g_clear_pointer(&ctx->chunks, fsearch_thread_pool_ranges_free);
+    for (uint32_t i = 0; i < num_workers; i++) {
+        fsearch_string_pool_stop_interning(workers[i].name_pool);
+        fsearch_string_pool_merge(name_pool, g_steal_pointer(&workers[i].name_pool));
+    }
 
-        fb = db_load_entry_super_elements_from_memory(fb, index_flags, entry, previous_entry_name);
+    return !g_atomic_int_get(&ctx->failed);
+}
 
-        // parent_idx: index of parent folder
-        uint32_t parent_idx = 0;
-        fb = copy_bytes_and_return_new_src(&parent_idx, fb, 4);
+static bool
+db_load_folders(DatabaseLoadBlockContext *ctx,
+                FsearchThreadPool *thread_pool,
+                FsearchStringPool *name_pool,
+                DynamicArray *folders) {
+    if (!db_load_block(ctx, thread_pool, name_pool)) {
+        g_debug("[db_load] failed to load folders");
+        return false;
+    }
 
+    for (uint32_t idx = 0; idx < ctx->num_entries; idx++) {
+        FsearchDatabaseEntry *entry = darray_get_item(folders, idx);
+        const uint32_t parent_idx = ctx->parent_indexes[idx];
         if (parent_idx != db_entry_get_idx(entry)) {
             FsearchDatabaseEntryFolder *parent = darray_get_item(folders, parent_idx);
+            if (!parent) {
+                g_debug("[db_load] invalid parent index: %d", parent_idx);
+                return false;
+            }
             db_entry_set_parent(entry, parent);
         }
         else {
@@ -444,108 +1421,138 @@ db_load_folders(FILE *fp,
         }
     }
 
-    // fail if we didn't read the correct number of bytes
-    if (fb - folder_block != folder_block_size) {
-        g_debug("[db_load] wrong amount of memory read: %zd != %" PRIu64, fb - folder_block, folder_block_size);
-        return false;
-    }
-
-    // fail if we didn't read the correct number of folders
-    if (idx != num_folders) {
-        g_debug("[db_load] failed to read folders (read %d of %d)", idx, num_folders);
-        return false;
+    // folders are stored sorted by name, so the parent of a folder might have been loaded after it
+    for (uint32_t idx = 0; idx < ctx->num_entries; idx++) {
+        db_entry_update_depth(darray_get_item(folders, idx));
     }
 
     return true;
 }
 
 static bool
-db_load_files(FILE *fp,
-              FsearchDatabaseIndexFlags index_flags,
-              FsearchMemoryPool *pool,
+db_load_files(DatabaseLoadBlockContext *ctx,
+              FsearchThreadPool *thread_pool,
+              FsearchStringPool *name_pool,
               DynamicArray *folders,
-              DynamicArray *files,
-              uint32_t num_files,
-              uint64_t file_block_size) {
-    g_autoptr(GString) previous_entry_name = g_string_sized_new(256);
-    g_autofree uint8_t *file_block = calloc(file_block_size + 1, sizeof(uint8_t));
-    g_assert(file_block);
-
-    if (fread(file_block, sizeof(uint8_t), file_block_size, fp) != file_block_size) {
-        g_debug("[db_load] failed to read file block");
+              DynamicArray *files) {
+    if (!db_load_block(ctx, thread_pool, name_pool)) {
+        g_debug("[db_load] failed to load files");
         return false;
     }
 
-    const uint8_t *fb = file_block;
-    // load folders
-    uint32_t idx = 0;
-    for (idx = 0; idx < num_files; idx++) {
-        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
-        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
-        db_entry_set_idx(entry, idx);
-
-        fb = db_load_entry_super_elements_from_memory(fb, index_flags, entry, previous_entry_name);
+    for (uint32_t idx = 0; idx < ctx->num_entries; idx++) {
+        const uint32_t parent_idx = ctx->parent_indexes[idx];
+        FsearchDatabaseEntryFolder *parent = darray_get_item(folders, parent_idx);
+        if (!parent) {
+            g_debug("[db_load] invalid parent index: %d", parent_idx);
+            return false;
+        }
+        db_entry_set_parent(darray_get_item(files, idx), parent);
+    }
 
-        // parent_idx: index of parent folder
-        uint32_t parent_idx = 0;
-        fb = copy_bytes_and_return_new_src(&parent_idx, fb, 4);
+    return true;
+}
 
-        FsearchDatabaseEntryFolder *parent = darray_get_item(folders, parent_idx);
-        db_entry_set_parent(entry, parent);
+static uint32_t *
+db_load_sorted_index_list(DatabaseFileReader *reader,
+                          uint32_t num_indexes,
+                          bool encoded,
+                          FsearchDatabaseCompression compression) {
+    uint32_t *indexes = calloc(num_indexes + 1, sizeof(uint32_t));
+    g_assert(indexes);
 
-        darray_add_item(files, entry);
+    if (!encoded) {
+        if (!db_file_reader_read(reader, indexes, (size_t)num_indexes * 4)) {
+            g_clear_pointer(&indexes, free);
+        }
+        return indexes;
     }
-    if (fb - file_block != file_block_size) {
-        g_debug("[db_load] wrong amount of memory read: %zd != %" PRIu64, fb - file_block, file_block_size);
-        return false;
+    if (num_indexes == 0) {
+        return indexes;
     }
 
-    // fail if we didn't read the correct number of files
-    if (idx != num_files) {
-        g_debug("[db_load] failed to read files (read %d of %d)", idx, num_files);
-        return false;
+    const size_t max_len = db_compression_get_max_encoded_indexes_size(num_indexes);
+    size_t encoded_len = 0;
+    g_autofree uint8_t *encoded_indexes = db_load_compressed(reader, compression, max_len, &encoded_len);
+    if (!encoded_indexes) {
+        g_clear_pointer(&indexes, free);
+        return NULL;
     }
 
-    return true;
+    if (!db_compression_decode_indexes(encoded_indexes, encoded_len, indexes, num_indexes)) {
+        g_debug("[db_load] failed to decode sorted indexes");
+        g_clear_pointer(&indexes, free);
+        return NULL;
+    }
+    return indexes;
 }
 
-static bool
-db_load_sorted_entries(FILE *fp, DynamicArray *src, uint32_t num_src_entries, DynamicArray *dest) {
-
-    g_autofree uint32_t *indexes = calloc(num_src_entries + 1, sizeof(uint32_t));
-    g_assert(indexes);
+static DynamicArray *
+db_load_sorted_entries(DatabaseFileReader *reader,
+                       DynamicArray *src,
+                       uint32_t num_src_entries,
+                       bool compact,
+                       bool encoded,
+                       FsearchDatabaseCompression compression) {
+    // the indexes are the positions of the entries in the name sorted arrays
+    uint32_t *indexes = db_load_sorted_index_list(reader, num_src_entries, encoded, compression);
+    if (!indexes) {
+        return NULL;
+    }
 
-    if (fread(indexes, 4, num_src_entries, fp) != num_src_entries) {
-        return false;
+    if (compact) {
+        // the list can be used as it is
+        return darray_new_compact(src, indexes, num_src_entries);
     }
-    else {
-        for (uint32_t i = 0; i < num_src_entries; i++) {
-            uint32_t idx = indexes[i];
-            void *entry = darray_get_item(src, idx);
-            if (!entry) {
-                return false;
-            }
-            darray_add_item(dest, entry);
+
+    DynamicArray *dest = darray_new(num_src_entries);
+    for (uint32_t i = 0; i < num_src_entries; i++) {
+        void *entry = darray_get_item(src, indexes[i]);
+        if (!entry) {
+            g_clear_pointer(&indexes, free);
+            g_clear_pointer(&dest, darray_unref);
+            return NULL;
         }
+        darray_add_item(dest, entry);
     }
-    return true;
+    g_clear_pointer(&indexes, free);
+    return dest;
+}
+
+static bool
+db_skip_sorted_index_list(DatabaseFileReader *reader, uint32_t num_indexes, bool encoded) {
+    if (!encoded) {
+        return db_file_reader_get_block(reader, (size_t)num_indexes * 4) != NULL;
+    }
+    if (num_indexes == 0) {
+        return true;
+    }
+    uint32_t lengths[2] = {0};
+    return db_file_reader_read(reader, lengths, 8) && db_file_reader_get_block(reader, lengths[1]) != NULL;
 }
 
+// If pending is set the sorted arrays are only located in the file, but not loaded
 static bool
-db_load_sorted_arrays(FILE *fp, DynamicArray **sorted_folders, DynamicArray **sorted_files) {
+db_load_sorted_arrays(DatabaseFileReader *reader,
+                      DynamicArray **sorted_folders,
+                      DynamicArray **sorted_files,
+                      bool compact,
+                      bool encoded,
+                      FsearchDatabaseCompression compression,
+                      DatabasePendingSortedArrays *pending) {
     uint32_t num_sorted_arrays = 0;
 
     DynamicArray *files = sorted_files[0];
     DynamicArray *folders = sorted_folders[0];
 
-    if (!read_element_from_file(&num_sorted_arrays, 4, fp)) {
+    if (!db_file_reader_read(reader, &num_sorted_arrays, 4)) {
         g_debug("[db_load] failed to load number of sorted arrays");
         return false;
     }
 
     for (uint32_t i = 0; i < num_sorted_arrays; i++) {
         uint32_t sorted_array_id = 0;
-        if (!read_element_from_file(&sorted_array_id, 4, fp)) {
+        if (!db_file_reader_read(reader, &sorted_array_id, 4)) {
             g_debug("[db_load] failed to load sorted array id");
             return false;
         }
@@ -555,16 +1562,28 @@ db_load_sorted_arrays(FILE *fp, DynamicArray **sorted_folders, DynamicArray **so
             return false;
         }
 
-        const uint32_t num_folders = darray_get_num_items(folders);
-        sorted_folders[sorted_array_id] = darray_new(num_folders);
-        if (!db_load_sorted_entries(fp, folders, num_folders, sorted_folders[sorted_array_id])) {
+        if (pending) {
+            pending->offsets[sorted_array_id] = reader->pos;
+            if (!db_skip_sorted_index_list(reader, darray_get_num_items(folders), encoded)
+                || !db_skip_sorted_index_list(reader, darray_get_num_items(files), encoded)) {
+                g_debug("[db_load] failed to locate sorted indexes: %d", sorted_array_id);
+                return false;
+            }
+            continue;
+        }
+
+        g_clear_pointer(&sorted_folders[sorted_array_id], darray_unref);
+        sorted_folders[sorted_array_id] =
+            db_load_sorted_entries(reader, folders, darray_get_num_items(folders), compact, encoded, compression);
+        if (!sorted_folders[sorted_array_id]) {
             g_debug("[db_load] failed to load sorted folder indexes: %d", sorted_array_id);
             return false;
         }
 
-        const uint32_t num_files = darray_get_num_items(files);
-        sorted_files[sorted_array_id] = darray_new(num_files);
-        if (!db_load_sorted_entries(fp, files, num_files, sorted_files[sorted_array_id])) {
+        g_clear_pointer(&sorted_files[sorted_array_id], darray_unref);
+        sorted_files[sorted_array_id] =
+            db_load_sorted_entries(reader, files, darray_get_num_items(files), compact, encoded, compression);
+        if (!sorted_files[sorted_array_id]) {
             g_debug("[db_load] failed to load sorted file indexes: %d", sorted_array_id);
             return false;
         }
@@ -573,98 +1592,459 @@ db_load_sorted_arrays(FILE *fp, DynamicArray **sorted_folders, DynamicArray **so
     return true;
 }
 
-bool
-db_load(FsearchDatabase *db, const char *file_path, void (*status_cb)(const char *)) {
-    g_assert(file_path);
-    g_assert(db);
-
-    FILE *fp = db_file_open_locked(file_path, "rb");
-    if (!fp) {
+static bool
+db_load_trigram_indexes(FsearchDatabase *db, const uint8_t *block, size_t block_size) {
+    size_t folder_index_size = 0;
+    size_t file_index_size = 0;
+    FsearchTrigramIndex *folder_index = fsearch_trigram_index_new_from_data(db->sorted_folders[DATABASE_INDEX_TYPE_NAME],
+                                                                            block,
+                                                                            block_size,
+                                                                            &folder_index_size);
+    if (!folder_index) {
         return false;
     }
-
-    DynamicArray *folders = NULL;
-    DynamicArray *files = NULL;
-    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
-    DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
-
-    if (!db_load_header(fp)) {
-        goto load_fail;
+    FsearchTrigramIndex *file_index = fsearch_trigram_index_new_from_data(db->sorted_files[DATABASE_INDEX_TYPE_NAME],
+                                                                          block + folder_index_size,
+                                                                          block_size - folder_index_size,
+                                                                          &file_index_size);
+    if (!file_index) {
+        g_clear_pointer(&folder_index, fsearch_trigram_index_unref);
+        return false;
     }
+    g_clear_pointer(&db->folder_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&db->file_trigram_index, fsearch_trigram_index_unref);
+    db->folder_trigram_index = folder_index;
+    db->file_trigram_index = file_index;
+    return true;
+}
 
-    uint64_t index_flags = 0;
-    if (!read_element_from_file(&index_flags, 8, fp)) {
-        goto load_fail;
-    }
+// The settings the extended attributes of a database file were read with, they're only valid for the same settings
+static char *
+db_get_xattr_settings(FsearchDatabase *db) {
+    g_autofree char *names = db->xattr_names ? g_strjoinv(";", db->xattr_names) : g_strdup("");
+    g_autofree char *paths = db->xattr_paths ? g_strjoinv(";", db->xattr_paths) : g_strdup("");
+    return g_strconcat(names, "\n", paths, NULL);
+}
 
-    uint32_t num_folders = 0;
-    if (!read_element_from_file(&num_folders, 4, fp)) {
-        goto load_fail;
+static bool
+db_block_read_u32(const uint8_t *block, size_t block_size, size_t *pos, uint32_t *value) {
+    if (block_size - *pos < 4) {
+        return false;
     }
+    memcpy(value, block + *pos, 4);
+    *pos += 4;
+    return true;
+}
 
-    uint32_t num_files = 0;
-    if (!read_element_from_file(&num_files, 4, fp)) {
-        goto load_fail;
+static bool
+db_xattrs_block_read_ids(const uint8_t *block,
+                         size_t block_size,
+                         size_t *pos,
+                         DynamicArray *entries,
+                         const uint32_t *ids,
+                         uint32_t num_ids) {
+    uint32_t num_entries = 0;
+    if (!db_block_read_u32(block, block_size, pos, &num_entries)
+        || num_entries != darray_get_num_items(entries) || (block_size - *pos) / 4 < num_entries) {
+        return false;
     }
-    g_debug("[db_load] load %d folders, %d files", num_folders, num_files);
-
-    uint64_t folder_block_size = 0;
-    if (!read_element_from_file(&folder_block_size, 8, fp)) {
-        goto load_fail;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        uint32_t local_id = 0;
+        db_block_read_u32(block, block_size, pos, &local_id);
+        if (local_id > num_ids) {
+            return false;
+        }
+        db_entry_set_xattrs_id(darray_get_item(entries, i), ids[local_id]);
     }
+    return true;
+}
 
-    uint64_t file_block_size = 0;
-    if (!read_element_from_file(&file_block_size, 8, fp)) {
-        goto load_fail;
+// The block starts with the settings the attributes were read with, followed by the distinct attribute lists and the
+// list of every folder and file in name order. Lists are referred to by their position in the block, starting at 1.
+static bool
+db_load_xattrs(FsearchDatabase *db, const uint8_t *block, size_t block_size) {
+    size_t pos = 0;
+    uint32_t settings_len = 0;
+    if (!db_block_read_u32(block, block_size, &pos, &settings_len) || block_size - pos < settings_len) {
+        return false;
     }
-    g_debug("[db_load] folder size: %" PRIu64 ", file size: %" PRIu64, folder_block_size, file_block_size);
-
-    // TODO: implement index loading
-    uint32_t num_indexes = 0;
-    if (!read_element_from_file(&num_indexes, 4, fp)) {
-        goto load_fail;
+    g_autofree char *settings = db_get_xattr_settings(db);
+    if (strlen(settings) != settings_len || memcmp(settings, block + pos, settings_len) != 0) {
+        g_debug("[db_load] extended attributes were read with different settings");
+        return false;
     }
+    pos += settings_len;
 
-    // TODO: implement exclude loading
-    uint32_t num_excludes = 0;
-    if (!read_element_from_file(&num_excludes, 4, fp)) {
-        goto load_fail;
+    uint32_t num_lists = 0;
+    if (!db_block_read_u32(block, block_size, &pos, &num_lists) || num_lists > (block_size - pos) / 4) {
+        return false;
+    }
+    g_autofree uint32_t *ids = calloc(num_lists + 1, sizeof(uint32_t));
+    g_assert(ids);
+    ids[0] = FSEARCH_STRING_TABLE_NO_ID;
+    for (uint32_t i = 1; i <= num_lists; i++) {
+        uint32_t len = 0;
+        if (!db_block_read_u32(block, block_size, &pos, &len) || block_size - pos < len) {
+            return false;
+        }
+        ids[i] = db_entry_get_xattrs_id_for_xattrs((const char *)block + pos, len);
+        pos += len;
     }
 
-    // pre-allocate the folders array so we can later map parent indices to the corresponding pointers
-    sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(num_folders);
-    folders = sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    return db_xattrs_block_read_ids(block, block_size, &pos, db->sorted_folders[DATABASE_INDEX_TYPE_NAME], ids, num_lists)
+        && db_xattrs_block_read_ids(block, block_size, &pos, db->sorted_files[DATABASE_INDEX_TYPE_NAME], ids, num_lists);
+}
 
+// The block holds the number of folders, followed by the identity of every folder in name order
+static bool
+db_load_folder_identities(FsearchDatabase *db, const uint8_t *block, size_t block_size) {
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    size_t pos = 0;
+    uint32_t num_folders = 0;
+    if (!db_block_read_u32(block, block_size, &pos, &num_folders) || num_folders != darray_get_num_items(folders)
+        || (block_size - pos) / 4 < num_folders) {
+        return false;
+    }
     for (uint32_t i = 0; i < num_folders; i++) {
-        FsearchDatabaseEntryFolder *folder = fsearch_memory_pool_malloc(db->folder_pool);
-        FsearchDatabaseEntry *entry = (FsearchDatabaseEntry *)folder;
-        db_entry_set_idx(entry, i);
-        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
-        db_entry_set_parent(entry, NULL);
-        darray_add_item(folders, folder);
+        uint32_t identity = 0;
+        db_block_read_u32(block, block_size, &pos, &identity);
+        db_entry_folder_set_identity(darray_get_item(folders, i), identity);
     }
+    return true;
+}
 
-    if (status_cb) {
-        status_cb(_("Loading folders…"));
+// Whether the optional blocks which follow the position of reader end with the file. A file which was cut off
+// wasn't written completely or got damaged, so the data before the blocks can't be trusted either. A complete block
+// which is unknown or invalid is fine: other versions write other blocks, and it doesn't affect the rest.
+static bool
+db_load_optional_blocks_are_complete(const DatabaseFileReader *reader) {
+    DatabaseFileReader blocks = *reader;
+    while (blocks.pos < blocks.size) {
+        uint32_t block_id = 0;
+        uint64_t block_size = 0;
+        if (!db_file_reader_read(&blocks, &block_id, 4) || !db_file_reader_read(&blocks, &block_size, 8)
+            || !db_file_reader_get_block(&blocks, block_size)) {
+            g_debug("[db_load] optional block is truncated: %d", block_id);
+            return false;
+        }
     }
-    // load folders
-    if (!db_load_folders(fp, index_flags, folders, num_folders, folder_block_size)) {
+    return true;
+}
+
+// Older versions don't write any blocks after the sorted arrays, so a missing or broken block is no reason to
+// reject the whole file
+static void
+db_load_optional_blocks(FsearchDatabase *db, DatabaseFileReader *reader) {
+    while (reader->pos < reader->size) {
+        uint32_t block_id = 0;
+        uint64_t block_size = 0;
+        if (!db_file_reader_read(reader, &block_id, 4) || !db_file_reader_read(reader, &block_size, 8)) {
+            g_debug("[db_load] failed to read optional block header");
+            return;
+        }
+        const uint8_t *block = db_file_reader_get_block(reader, block_size);
+        if (!block) {
+            g_debug("[db_load] optional block is truncated: %d", block_id);
+            return;
+        }
+        if (block_id == DATABASE_BLOCK_TRIGRAM_INDEX && db->trigram_indexes) {
+            if (!db_load_trigram_indexes(db, block, block_size)) {
+                g_debug("[db_load] failed to load trigram indexes");
+            }
+        }
+        else if (block_id == DATABASE_BLOCK_XATTRS && (db->index_flags & DATABASE_INDEX_FLAG_XATTRS)) {
+            if (db_load_xattrs(db, block, block_size)) {
+                db->xattrs_outdated = false;
+            }
+            else {
+                g_debug("[db_load] failed to load extended attributes");
+            }
+        }
+        else if (block_id == DATABASE_BLOCK_FOLDER_IDENTITIES) {
+            // without them the next rescan only compares the modification times of the folders
+            if (!db_load_folder_identities(db, block, block_size)) {
+                g_debug("[db_load] failed to load folder identities");
+            }
+        }
+    }
+}
+
+static char *
+db_get_journal_path(const char *db_file_path) {
+    return g_strconcat(db_file_path, ".journal", NULL);
+}
+
+// From now on updated paths are recorded in the journal of the database file at db_file_path
+static void
+db_journal_start(FsearchDatabase *db, const char *db_file_path, bool clear) {
+    g_clear_pointer(&db->journal, db_journal_close);
+    g_clear_pointer(&db->save_dir, g_free);
+    if (db->read_only_file) {
+        return;
+    }
+
+    g_autofree char *journal_path = db_get_journal_path(db_file_path);
+    if (clear) {
+        unlink(journal_path);
+    }
+    db->journal = db_journal_open(journal_path);
+    db->save_dir = g_path_get_dirname(db_file_path);
+}
+
+static void
+db_journal_replay(FsearchDatabase *db, const char *db_file_path) {
+    g_autofree char *journal_path = db_get_journal_path(db_file_path);
+    g_autoptr(GPtrArray) paths = db_journal_read_paths(journal_path);
+    if (paths && paths->len > 0) {
+        g_debug("[db_load] replaying %d journal records", paths->len);
+        db_update_paths(db, paths);
+    }
+}
+
+static void
+db_finish_operation(FsearchDatabase *db,
+                    FsearchOperation operation,
+                    FsearchOperationTimer *timer,
+                    uint64_t num_entries,
+                    uint64_t num_results) {
+    g_mutex_lock(&db->operation_stats_mutex);
+    fsearch_operation_timer_finish(timer, num_entries, num_results, &db->operation_stats[operation]);
+    g_mutex_unlock(&db->operation_stats_mutex);
+}
+
+// Replaces the entry pools, which must still be empty, with ones whose entries have room for the optional values
+// in index_flags
+static void
+db_set_entry_optional_values(FsearchDatabase *db, FsearchDatabaseIndexFlags index_flags) {
+    index_flags &= DATABASE_INDEX_FLAGS_OPTIONAL;
+    if (index_flags == db->entry_optional_values) {
+        return;
+    }
+    g_clear_pointer(&db->file_pool, fsearch_memory_pool_unref);
+    g_clear_pointer(&db->folder_pool, fsearch_memory_pool_unref);
+    db->file_pool = fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK,
+                                            db_entry_get_sizeof_file_entry_with_optional_values(index_flags),
+                                            NULL);
+    db->folder_pool = fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK,
+                                              db_entry_get_sizeof_folder_entry_with_optional_values(index_flags),
+                                              NULL);
+    fsearch_memory_pool_set_huge_pages(db->file_pool, db->huge_pages);
+    fsearch_memory_pool_set_huge_pages(db->folder_pool, db->huge_pages);
+    db->entry_optional_values = index_flags;
+}
+
+static bool
+db_load_from_file(FsearchDatabase *db,
+                  const char *file_path,
+                  GCancellable *cancellable,
+                  void (*status_cb)(const char *)) {
+    g_assert(file_path);
+    g_assert(db);
+
+    FILE *fp = db_file_open_locked(file_path, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    // Mapping the file avoids copying it into memory (which doubles the memory usage while loading)
+    // and lets the kernel read ahead while it's parsed
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GMappedFile) mapped_file = g_mapped_file_new_from_fd(fileno(fp), FALSE, &error);
+    g_autofree uint8_t *buffer = NULL;
+    DatabaseFileReader reader = {0};
+    if (mapped_file) {
+        reader.data = (const uint8_t *)g_mapped_file_get_contents(mapped_file);
+        reader.size = g_mapped_file_get_length(mapped_file);
+        if (reader.data && reader.size > 0) {
+            posix_madvise((void *)reader.data, reader.size, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+    else {
+        // some file systems don't support mapping files, read the whole file in large blocks instead
+        g_debug("[db_load] failed to map database file, reading it instead: %s", error->message);
+        buffer = db_file_read_contents(fp, &reader.size);
+        if (!buffer) {
+            g_clear_pointer(&fp, fclose);
+            return false;
+        }
+        reader.data = buffer;
+    }
+
+    DynamicArray *folders = NULL;
+    DynamicArray *files = NULL;
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    DatabaseLoadBlockContext folder_ctx = {0};
+    DatabaseLoadBlockContext file_ctx = {0};
+    DatabasePendingSortedArrays *pending = NULL;
+    DatabaseProgress progress = {0};
+    db_progress_init(&progress, cancellable, status_cb, 0);
+
+    uint8_t minor_version = 0;
+    if (!db_load_header(&reader, &minor_version)) {
         goto load_fail;
     }
 
-    if (status_cb) {
-        status_cb(_("Loading files…"));
+    uint64_t index_flags = 0;
+    if (!db_file_reader_read(&reader, &index_flags, 8)) {
+        goto load_fail;
+    }
+    if (minor_version < DATABASE_MINOR_VERSION_OPTIONAL_TIMES) {
+        index_flags &= ~(uint64_t)DATABASE_INDEX_FLAGS_OPTIONAL_TIMES;
+    }
+    if (minor_version < DATABASE_MINOR_VERSION_OWNER) {
+        index_flags &= ~(uint64_t)DATABASE_INDEX_FLAG_OWNER;
+    }
+    // the entries need room for the optional values the file was saved with
+    db_set_entry_optional_values(db, index_flags);
+
+    uint32_t num_folders = 0;
+    if (!db_file_reader_read(&reader, &num_folders, 4)) {
+        goto load_fail;
+    }
+
+    uint32_t num_files = 0;
+    if (!db_file_reader_read(&reader, &num_files, 4)) {
+        goto load_fail;
+    }
+    g_debug("[db_load] load %d folders, %d files", num_folders, num_files);
+    progress.num_entries = num_folders + num_files;
+
+    uint64_t folder_block_size = 0;
+    if (!db_file_reader_read(&reader, &folder_block_size, 8)) {
+        goto load_fail;
+    }
+
+    uint64_t file_block_size = 0;
+    if (!db_file_reader_read(&reader, &file_block_size, 8)) {
+        goto load_fail;
+    }
+    g_debug("[db_load] folder size: %" PRIu64 ", file size: %" PRIu64, folder_block_size, file_block_size);
+
+    // TODO: implement index loading
+    uint32_t num_indexes = 0;
+    if (!db_file_reader_read(&reader, &num_indexes, 4)) {
+        goto load_fail;
+    }
+
+    // TODO: implement exclude loading
+    uint32_t num_excludes = 0;
+    if (!db_file_reader_read(&reader, &num_excludes, 4)) {
+        goto load_fail;
+    }
+
+    const bool has_chunk_table = minor_version >= DATABASE_MINOR_VERSION_CHUNKS;
+    uint32_t chunk_size = 0;
+    if (has_chunk_table && (!db_file_reader_read(&reader, &chunk_size, 4) || chunk_size == 0)) {
+        g_debug("[db_load] failed to load chunk size");
+        goto load_fail;
+    }
+    const bool has_compression = minor_version >= DATABASE_MINOR_VERSION_COMPRESSION;
+    uint8_t compression_id = DATABASE_COMPRESSION_NONE;
+    if (has_compression && !db_file_reader_read(&reader, &compression_id, 1)) {
+        goto load_fail;
+    }
+    const FsearchDatabaseCompression compression = compression_id;
+    if (!db_compression_is_supported(compression)) {
+        g_debug("[db_load] compression isn't supported: %d", compression_id);
+        goto load_fail;
+    }
+    folder_ctx.compression = compression;
+    file_ctx.compression = compression;
+    folder_ctx.progress = &progress;
+    file_ctx.progress = &progress;
+
+    folder_ctx.num_entries = num_folders;
+    folder_ctx.chunk_size = chunk_size;
+    if (!db_load_chunk_table(&reader, &folder_ctx, has_chunk_table)) {
+        goto load_fail;
+    }
+    file_ctx.num_entries = num_files;
+    file_ctx.chunk_size = chunk_size;
+    if (!db_load_chunk_table(&reader, &file_ctx, has_chunk_table)) {
+        goto load_fail;
+    }
+
+    // pre-allocate the folders array so we can later map parent indices to the corresponding pointers
+    sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(num_folders);
+    folders = sorted_folders[DATABASE_INDEX_TYPE_NAME];
+
+    // the number of entries is known, so they can all be allocated from a single block
+    fsearch_memory_pool_reserve(db->folder_pool, num_folders);
+    for (uint32_t i = 0; i < num_folders; i++) {
+        // the entries get initialized when their chunk is decoded
+        darray_add_item(folders, fsearch_memory_pool_malloc(db->folder_pool));
+    }
+
+    db_progress_set_status(&progress, _("Loading folders…"));
+    int64_t span = fsearch_trace_begin();
+    // load folders
+    folder_ctx.block = db_file_reader_get_block(&reader, folder_block_size);
+    if (!folder_ctx.block) {
+        g_debug("[db_load] failed to read folder block");
+        goto load_fail;
+    }
+    folder_ctx.block_size = folder_block_size;
+    folder_ctx.index_flags = index_flags;
+    folder_ctx.type = DATABASE_ENTRY_TYPE_FOLDER;
+    folder_ctx.entries = folders;
+    folder_ctx.parent_indexes = calloc(num_folders + 1, sizeof(uint32_t));
+    g_assert(folder_ctx.parent_indexes);
+    if (!db_load_folders(&folder_ctx, db->thread_pool, db->name_pool, folders)) {
+        goto load_fail;
     }
+    fsearch_trace_end(span, "load", "folders");
+
+    db_progress_set_status(&progress, _("Loading files…"));
+    span = fsearch_trace_begin();
     // load files
     sorted_files[DATABASE_INDEX_TYPE_NAME] = darray_new(num_files);
     files = sorted_files[DATABASE_INDEX_TYPE_NAME];
-    if (!db_load_files(fp, index_flags, db->file_pool, folders, files, num_files, file_block_size)) {
+    fsearch_memory_pool_reserve(db->file_pool, num_files);
+    for (uint32_t i = 0; i < num_files; i++) {
+        darray_add_item(files, fsearch_memory_pool_malloc(db->file_pool));
+    }
+    file_ctx.block = db_file_reader_get_block(&reader, file_block_size);
+    if (!file_ctx.block) {
+        g_debug("[db_load] failed to read file block");
         goto load_fail;
     }
-
-    if (!db_load_sorted_arrays(fp, sorted_folders, sorted_files)) {
+    file_ctx.block_size = file_block_size;
+    file_ctx.index_flags = index_flags;
+    file_ctx.type = DATABASE_ENTRY_TYPE_FILE;
+    file_ctx.entries = files;
+    file_ctx.parent_indexes = calloc(num_files + 1, sizeof(uint32_t));
+    g_assert(file_ctx.parent_indexes);
+    if (!db_load_files(&file_ctx, db->thread_pool, db->name_pool, folders, files)) {
+        goto load_fail;
+    }
+    fsearch_trace_end(span, "load", "files");
+    span = fsearch_trace_begin();
+
+    // Only the name sorted arrays are needed to search, the other ones are decoded on first use. This
+    // requires the file to stay mapped, the contents of a file which was read into memory get loaded right away.
+    if (mapped_file) {
+        pending = calloc(1, sizeof(DatabasePendingSortedArrays));
+        g_assert(pending);
+        pending->encoded = has_compression;
+        pending->compression = compression;
+    }
+    if (!db_load_sorted_arrays(&reader,
+                               sorted_folders,
+                               sorted_files,
+                               db->compact_indexes,
+                               has_compression,
+                               compression,
+                               pending)
+        || !db_load_optional_blocks_are_complete(&reader)) {
+        goto load_fail;
+    }
+    fsearch_trace_end(span, "load", "sorted arrays");
+    // the database is still empty up to here, so a cancelled load leaves it as it was
+    if (db_progress_is_cancelled(&progress)) {
         goto load_fail;
     }
+    span = fsearch_trace_begin();
 
     db_sorted_entries_free(db);
 
@@ -673,25 +2053,192 @@ db_load(FsearchDatabase *db, const char *file_path, void (*status_cb)(const char
         db->sorted_folders[i] = sorted_folders[i];
     }
 
+    if (pending) {
+        pending->mapped_file = g_mapped_file_ref(mapped_file);
+        db->pending_sorted_arrays = g_steal_pointer(&pending);
+    }
+
     db->index_flags = index_flags;
+    db_compact_sorted_entries(db);
+    fsearch_string_pool_stop_interning(db->name_pool);
+    db_front_code_names(db);
+
+    // the extended attributes need to be read again, unless they're part of the file
+    db->xattrs_outdated = (index_flags & DATABASE_INDEX_FLAG_XATTRS) != 0;
+    db_load_optional_blocks(db, &reader);
+    if (db->trigram_indexes && (!db->folder_trigram_index || !db->file_trigram_index)) {
+        db_build_trigram_indexes(db);
+    }
+    db_build_name_indexes(db);
+    db_build_folder_paths(db);
+    db_build_folded_names(db);
+    db_build_subtree_filter(db);
+    fsearch_trace_end(span, "load", "indexes");
 
     g_clear_pointer(&fp, fclose);
+    db_load_block_context_clear(&folder_ctx);
+    db_load_block_context_clear(&file_ctx);
+    db_progress_clear(&progress);
+    db_publish_snapshot(db);
+
+    // changes which happened after the database file was written
+    span = fsearch_trace_begin();
+    db_journal_replay(db, file_path);
+    db_journal_start(db, file_path, false);
+    fsearch_trace_end(span, "load", "journal");
 
     return true;
 
 load_fail:
-    g_debug("[db_load] load failed");
+    g_debug(db_progress_is_cancelled(&progress) ? "[db_load] load cancelled" : "[db_load] load failed");
 
     g_clear_pointer(&fp, fclose);
+    db_load_block_context_clear(&folder_ctx);
+    db_load_block_context_clear(&file_ctx);
+    db_progress_clear(&progress);
 
     for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
         g_clear_pointer(&sorted_folders[i], darray_unref);
         g_clear_pointer(&sorted_files[i], darray_unref);
     }
+    g_clear_pointer(&pending, free);
+    // databases are loaded while they're still empty, so all entries belong to the failed load
+    fsearch_memory_pool_reset(db->folder_pool);
+    fsearch_memory_pool_reset(db->file_pool);
 
     return false;
 }
 
+bool
+db_load(FsearchDatabase *db, const char *file_path, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    g_assert(db);
+
+    FsearchOperationTimer timer = {};
+    fsearch_operation_timer_start(&timer, db->thread_pool);
+    const bool res = db_load_from_file(db, file_path, cancellable, status_cb);
+    if (res) {
+        const uint32_t num_entries = db_get_num_entries(db);
+        db_finish_operation(db, FSEARCH_OPERATION_LOAD, &timer, num_entries, num_entries);
+    }
+    return res;
+}
+
+// Decodes the sorted arrays of sort_type if they weren't loaded by db_load yet. The pending indexes are positions
+// in the name sorted arrays, so they must be loaded before those get modified.
+static void
+db_build_missing_file_type_sorted_arrays(FsearchDatabase *db) {
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DatabasePendingSortedArrays *pending = db->pending_sorted_arrays;
+    if (!files || !folders || db->sorted_files[DATABASE_INDEX_TYPE_FILETYPE]
+        || (pending && pending->offsets[DATABASE_INDEX_TYPE_FILETYPE] != 0)) {
+        return;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_clear_pointer(&db->sorted_folders[DATABASE_INDEX_TYPE_FILETYPE], darray_unref);
+    db->sorted_folders[DATABASE_INDEX_TYPE_FILETYPE] = darray_ref(folders);
+    db->sorted_files[DATABASE_INDEX_TYPE_FILETYPE] = db_sort_files_by_file_type(files, NULL);
+    db_compact_sorted_entries(db);
+    g_debug("[db_load] built type sorted arrays in %f ms", g_timer_elapsed(timer, NULL) * 1000);
+}
+
+static DynamicArray *
+db_flatten_sorted_array(FsearchDatabase *db, DynamicArray **sorted_entries, FsearchBlockArray *blocks, uint32_t id) {
+    DynamicArray *entries = fsearch_block_array_to_darray(blocks);
+    if (db->compact_indexes && id != DATABASE_INDEX_TYPE_NAME && sorted_entries[DATABASE_INDEX_TYPE_NAME]) {
+        darray_compact(entries,
+                       sorted_entries[DATABASE_INDEX_TYPE_NAME],
+                       (DynamicArrayIndexFunc)db_entry_get_name_array_idx,
+                       NULL);
+    }
+    return entries;
+}
+
+// Creates the sorted arrays which were dropped by an update from the block arrays again
+static void
+db_flatten_sorted_arrays(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    if (sort_type < 0 || sort_type >= NUM_DATABASE_INDEX_TYPES) {
+        return;
+    }
+    if (!db->sorted_files[sort_type] && db->file_blocks[sort_type]) {
+        db->sorted_files[sort_type] =
+            db_flatten_sorted_array(db, db->sorted_files, db->file_blocks[sort_type], sort_type);
+    }
+    if (!db->sorted_folders[sort_type] && db->folder_blocks[sort_type]) {
+        db->sorted_folders[sort_type] =
+            db_flatten_sorted_array(db, db->sorted_folders, db->folder_blocks[sort_type], sort_type);
+    }
+}
+
+static void
+db_load_pending_sorted_arrays(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    db_flatten_sorted_arrays(db, sort_type);
+
+    if (sort_type == DATABASE_INDEX_TYPE_FILETYPE) {
+        // database files of older versions don't contain them
+        db_build_missing_file_type_sorted_arrays(db);
+    }
+
+    DatabasePendingSortedArrays *pending = db->pending_sorted_arrays;
+    if (!pending || sort_type < 0 || sort_type >= NUM_DATABASE_INDEX_TYPES || pending->offsets[sort_type] == 0) {
+        return;
+    }
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_timer_start(timer);
+
+    DatabaseFileReader reader = {
+        .data = (const uint8_t *)g_mapped_file_get_contents(pending->mapped_file),
+        .size = g_mapped_file_get_length(pending->mapped_file),
+        .pos = pending->offsets[sort_type],
+    };
+    pending->offsets[sort_type] = 0;
+
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *sorted_folders = db_load_sorted_entries(&reader,
+                                                          folders,
+                                                          darray_get_num_items(folders),
+                                                          db->compact_indexes,
+                                                          pending->encoded,
+                                                          pending->compression);
+    DynamicArray *sorted_files = sorted_folders ? db_load_sorted_entries(&reader,
+                                                                         files,
+                                                                         darray_get_num_items(files),
+                                                                         db->compact_indexes,
+                                                                         pending->encoded,
+                                                                         pending->compression)
+                                                : NULL;
+    if (sorted_folders && sorted_files) {
+        g_clear_pointer(&db->sorted_folders[sort_type], darray_unref);
+        g_clear_pointer(&db->sorted_files[sort_type], darray_unref);
+        db->sorted_folders[sort_type] = sorted_folders;
+        db->sorted_files[sort_type] = sorted_files;
+        g_debug("[db_load] loaded sorted arrays %d in %f ms", sort_type, g_timer_elapsed(timer, NULL) * 1000);
+    }
+    else {
+        // views will sort the results themselves
+        g_warning("[db_load] failed to load sorted arrays: %d", sort_type);
+        g_clear_pointer(&sorted_folders, darray_unref);
+        g_clear_pointer(&sorted_files, darray_unref);
+    }
+
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (pending->offsets[i] != 0) {
+            return;
+        }
+    }
+    // everything is loaded, the file doesn't need to be mapped anymore
+    g_clear_pointer(&db->pending_sorted_arrays, db_pending_sorted_arrays_free);
+}
+
+static void
+db_load_all_pending_sorted_arrays(FsearchDatabase *db) {
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES && db->pending_sorted_arrays; i++) {
+        db_load_pending_sorted_arrays(db, i);
+    }
+}
+
 size_t
 write_data_to_file(FILE *fp, const void *data, size_t data_size, size_t num_elements, bool *write_failed) {
     if (data_size == 0 || num_elements == 0) {
@@ -767,6 +2314,33 @@ db_save_entry_super_elements(FILE *fp,
         }
     }
 
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_optional_times); i++) {
+        if ((index_flags & db_optional_times[i].flag) != 0) {
+            const uint64_t time = db_entry_get_time(entry, db_optional_times[i].type);
+            bytes_written += write_data_to_file(fp, &time, 8, 1, write_failed);
+            if (*write_failed == true) {
+                g_debug("[db_save] failed to save optional times");
+                goto out;
+            }
+        }
+    }
+
+    if ((index_flags & DATABASE_INDEX_FLAG_OWNER) != 0) {
+        // owner: uid, gid and mode, owners which didn't get an id of their own are lost
+        uint32_t uid = UINT32_MAX;
+        uint32_t gid = UINT32_MAX;
+        db_entry_get_uid(entry, &uid);
+        db_entry_get_gid(entry, &gid);
+        const uint16_t mode = db_entry_get_mode(entry);
+        bytes_written += write_data_to_file(fp, &uid, 4, 1, write_failed);
+        bytes_written += write_data_to_file(fp, &gid, 4, 1, write_failed);
+        bytes_written += write_data_to_file(fp, &mode, 2, 1, write_failed);
+        if (*write_failed == true) {
+            g_debug("[db_save] failed to save owner");
+            goto out;
+        }
+    }
+
     // parent_idx: index of parent folder
     bytes_written += write_data_to_file(fp, &parent_idx, 4, 1, write_failed);
     if (*write_failed == true) {
@@ -807,24 +2381,50 @@ out:
     return bytes_written;
 }
 
+// Stores data as [uncompressed size][compressed size][compressed data], both sizes are 4 bytes
 static size_t
-db_save_files(FILE *fp, FsearchDatabaseIndexFlags index_flags, DynamicArray *files, uint32_t num_files, bool *write_failed) {
-    size_t bytes_written = 0;
+db_save_compressed(FILE *fp,
+                   FsearchDatabaseCompression compression,
+                   const uint8_t *data,
+                   size_t data_len,
+                   bool *write_failed) {
+    size_t compressed_len = 0;
+    g_autofree uint8_t *compressed = db_compression_compress(compression, data, data_len, &compressed_len);
+    if (!compressed || data_len > UINT32_MAX || compressed_len > UINT32_MAX) {
+        g_debug("[db_save] failed to compress data");
+        *write_failed = true;
+        return 0;
+    }
+    const uint32_t len = (uint32_t)data_len;
+    const uint32_t stored_len = (uint32_t)compressed_len;
+    size_t bytes_written = write_data_to_file(fp, &len, 4, 1, write_failed);
+    if (*write_failed == true) {
+        return bytes_written;
+    }
+    bytes_written += write_data_to_file(fp, &stored_len, 4, 1, write_failed);
+    if (*write_failed == true) {
+        return bytes_written;
+    }
+    bytes_written += write_data_to_file(fp, compressed, 1, compressed_len, write_failed);
+    return bytes_written;
+}
 
-    g_autoptr(GString) name_prev = g_string_sized_new(256);
-    g_autoptr(GString) name_new = g_string_sized_new(256);
+static size_t
+db_save_files(FILE *fp,
+              FsearchDatabaseIndexFlags index_flags,
+              DynamicArray *files,
+              const uint32_t *parent_indexes,
+              uint32_t start,
+              uint32_t end,
+              GString *name_prev,
+              GString *name_new,
+              bool *write_failed) {
+    size_t bytes_written = 0;
 
-    for (uint32_t i = 0; i < num_files; i++) {
+    for (uint32_t i = start; i < end; i++) {
         FsearchDatabaseEntry *entry = darray_get_item(files, i);
-
-        // let's also update the idx of the file here while we're at it to make sure we have the correct
-        // idx set when we store the fast sort indexes
-        db_entry_set_idx(entry, i);
-
-        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
-        const uint32_t parent_idx = db_entry_get_idx((FsearchDatabaseEntry *)parent);
         bytes_written +=
-            db_save_entry_super_elements(fp, index_flags, entry, parent_idx, name_prev, name_new, write_failed);
+            db_save_entry_super_elements(fp, index_flags, entry, parent_indexes[i], name_prev, name_new, write_failed);
         if (*write_failed == true)
             return bytes_written;
     }
@@ -846,54 +2446,178 @@ build_sorted_entry_index_list(DynamicArray *entries, uint32_t num_entries) {
     return indexes;
 }
 
-static size_t
-db_save_sorted_entries(FILE *fp, DynamicArray *entries, uint32_t num_entries, bool *write_failed) {
-    if (num_entries < 1) {
-        // nothing to write, we're done here
-        return 0;
-    }
+static uint32_t *
+build_parent_index_list(DynamicArray *entries, uint32_t num_entries) {
+    uint32_t *indexes = calloc(num_entries + 1, sizeof(uint32_t));
+    g_assert(indexes);
 
-    g_autofree uint32_t *sorted_entry_index_list = build_sorted_entry_index_list(entries, num_entries);
-    if (!sorted_entry_index_list) {
-        *write_failed = true;
-        g_debug("[db_save] failed to create sorted index list");
-        return 0;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+        // root folders are their own parent
+        indexes[i] = parent ? db_entry_get_idx((FsearchDatabaseEntry *)parent) : db_entry_get_idx(entry);
     }
+    return indexes;
+}
 
-    size_t bytes_written = write_data_to_file(fp, sorted_entry_index_list, 4, num_entries, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save sorted index list");
-    }
+// Everything which is needed to write the database file. The entry arrays are never modified in place, so
+// holding references to them is enough to make sure their content doesn't change while the file is written.
+// Only the attributes of the entries themselves (e.g. size and modification time) might get updated in the
+// meantime, their positions and parents are taken in advance.
+typedef struct {
+    FsearchDatabase *db;
+    char *path;
+
+    DynamicArray *folders;
+    DynamicArray *files;
+    uint32_t num_folders;
+    uint32_t num_files;
+    uint32_t *folder_parent_indexes;
+    uint32_t *file_parent_indexes;
+    // positions of the entries of the other sorted arrays in the name sorted arrays
+    uint32_t *sorted_folder_indexes[NUM_DATABASE_INDEX_TYPES];
+    uint32_t *sorted_file_indexes[NUM_DATABASE_INDEX_TYPES];
+    // NULL if the database doesn't maintain trigram indexes
+    FsearchTrigramIndex *folder_trigram_index;
+    FsearchTrigramIndex *file_trigram_index;
+    // NULL if the database doesn't index extended attributes
+    char *xattr_settings;
 
-    return bytes_written;
+    FsearchDatabaseIndexFlags index_flags;
+    FsearchDatabaseCompression compression;
+    // the journal records up to this size are part of the snapshot
+    uint64_t journal_size;
+} DatabaseSaveSnapshot;
+
+static void
+db_save_snapshot_free(DatabaseSaveSnapshot *snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    g_clear_pointer(&snapshot->folders, darray_unref);
+    g_clear_pointer(&snapshot->files, darray_unref);
+    g_clear_pointer(&snapshot->folder_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&snapshot->file_trigram_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&snapshot->xattr_settings, g_free);
+    g_clear_pointer(&snapshot->folder_parent_indexes, free);
+    g_clear_pointer(&snapshot->file_parent_indexes, free);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_clear_pointer(&snapshot->sorted_folder_indexes[i], free);
+        g_clear_pointer(&snapshot->sorted_file_indexes[i], free);
+    }
+    g_clear_pointer(&snapshot->path, g_free);
+    g_clear_pointer(&snapshot->db, db_unref);
+    g_clear_pointer(&snapshot, free);
 }
 
-static size_t
-db_save_sorted_arrays(FILE *fp, FsearchDatabase *db, uint32_t num_files, uint32_t num_folders, bool *write_failed) {
-    size_t bytes_written = 0;
-    uint32_t num_sorted_arrays = 0;
-    for (uint32_t i = 1; i < NUM_DATABASE_INDEX_TYPES; i++) {
-        if (db->sorted_folders[i] && db->sorted_files[i]) {
-            num_sorted_arrays++;
-        }
+// The database must be locked or not be shared with other threads yet
+static DatabaseSaveSnapshot *
+db_save_snapshot_new(FsearchDatabase *db, const char *path) {
+    // all sorted arrays get saved
+    db_load_all_pending_sorted_arrays(db);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        db_flatten_sorted_arrays(db, i);
     }
 
-    bytes_written += write_data_to_file(fp, &num_sorted_arrays, 4, 1, write_failed);
-    if (*write_failed == true) {
-        g_debug("[db_save] failed to save number of sorted arrays: %d", num_sorted_arrays);
-        goto out;
+    DatabaseSaveSnapshot *snapshot = calloc(1, sizeof(DatabaseSaveSnapshot));
+    g_assert(snapshot);
+    snapshot->db = db_ref(db);
+    snapshot->path = g_strdup(path);
+    snapshot->index_flags = db->index_flags;
+    snapshot->compression = db->compression;
+    if (!db_compression_is_supported(snapshot->compression)) {
+        g_debug("[db_save] compression isn't supported, saving uncompressed: %d", snapshot->compression);
+        snapshot->compression = DATABASE_COMPRESSION_NONE;
     }
+    snapshot->journal_size = db->journal ? db_journal_get_size(db->journal) : 0;
 
-    if (num_sorted_arrays < 1) {
-        goto out;
+    // the sorted index lists and parent indexes refer to the positions of the entries in the name arrays
+    db_entry_update_folder_indices(db);
+    snapshot->folders = darray_ref(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    snapshot->files = darray_ref(db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    snapshot->num_folders = darray_get_num_items(snapshot->folders);
+    snapshot->num_files = darray_get_num_items(snapshot->files);
+    for (uint32_t i = 0; i < snapshot->num_files; i++) {
+        db_entry_set_idx(darray_get_item(snapshot->files, i), i);
     }
 
-    for (uint32_t id = 1; id < NUM_DATABASE_INDEX_TYPES; id++) {
-        DynamicArray *folders = db->sorted_folders[id];
+    if (db->folder_trigram_index && db->file_trigram_index) {
+        snapshot->folder_trigram_index = fsearch_trigram_index_ref(db->folder_trigram_index);
+        snapshot->file_trigram_index = fsearch_trigram_index_ref(db->file_trigram_index);
+    }
+    if (snapshot->index_flags & DATABASE_INDEX_FLAG_XATTRS) {
+        snapshot->xattr_settings = db_get_xattr_settings(db);
+    }
+
+    snapshot->folder_parent_indexes = build_parent_index_list(snapshot->folders, snapshot->num_folders);
+    snapshot->file_parent_indexes = build_parent_index_list(snapshot->files, snapshot->num_files);
+
+    for (uint32_t id = 1; id < NUM_DATABASE_INDEX_TYPES; id++) {
+        DynamicArray *folders = db->sorted_folders[id];
         DynamicArray *files = db->sorted_files[id];
         if (!files || !folders) {
             continue;
         }
+        // the lists of empty arrays are NULL, those are marked as available with an empty list
+        snapshot->sorted_folder_indexes[id] = build_sorted_entry_index_list(folders, snapshot->num_folders);
+        if (!snapshot->sorted_folder_indexes[id]) {
+            snapshot->sorted_folder_indexes[id] = calloc(1, sizeof(uint32_t));
+        }
+        snapshot->sorted_file_indexes[id] = build_sorted_entry_index_list(files, snapshot->num_files);
+        if (!snapshot->sorted_file_indexes[id]) {
+            snapshot->sorted_file_indexes[id] = calloc(1, sizeof(uint32_t));
+        }
+    }
+    return snapshot;
+}
+
+static size_t
+db_save_sorted_entries(FILE *fp,
+                       FsearchDatabaseCompression compression,
+                       const uint32_t *sorted_entry_index_list,
+                       uint32_t num_entries,
+                       bool *write_failed) {
+    if (num_entries < 1) {
+        // nothing to write, we're done here
+        return 0;
+    }
+
+    size_t encoded_len = 0;
+    g_autofree uint8_t *encoded = db_compression_encode_indexes(sorted_entry_index_list, num_entries, &encoded_len);
+    size_t bytes_written = db_save_compressed(fp, compression, encoded, encoded_len, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save sorted index list");
+    }
+
+    return bytes_written;
+}
+
+static size_t
+db_save_sorted_arrays(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
+    size_t bytes_written = 0;
+    uint32_t num_sorted_arrays = 0;
+    for (uint32_t i = 1; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (snapshot->sorted_folder_indexes[i] && snapshot->sorted_file_indexes[i]) {
+            num_sorted_arrays++;
+        }
+    }
+
+    bytes_written += write_data_to_file(fp, &num_sorted_arrays, 4, 1, write_failed);
+    if (*write_failed == true) {
+        g_debug("[db_save] failed to save number of sorted arrays: %d", num_sorted_arrays);
+        goto out;
+    }
+
+    if (num_sorted_arrays < 1) {
+        goto out;
+    }
+
+    for (uint32_t id = 1; id < NUM_DATABASE_INDEX_TYPES; id++) {
+        const uint32_t *folders = snapshot->sorted_folder_indexes[id];
+        const uint32_t *files = snapshot->sorted_file_indexes[id];
+        if (!files || !folders) {
+            continue;
+        }
 
         // id: this is the id of the sorted files
         bytes_written += write_data_to_file(fp, &id, 4, 1, write_failed);
@@ -902,12 +2626,12 @@ db_save_sorted_arrays(FILE *fp, FsearchDatabase *db, uint32_t num_files, uint32_
             goto out;
         }
 
-        bytes_written += db_save_sorted_entries(fp, folders, num_folders, write_failed);
+        bytes_written += db_save_sorted_entries(fp, snapshot->compression, folders, snapshot->num_folders, write_failed);
         if (*write_failed == true) {
             g_debug("[db_save] failed to save sorted folders");
             goto out;
         }
-        bytes_written += db_save_sorted_entries(fp, files, num_files, write_failed);
+        bytes_written += db_save_sorted_entries(fp, snapshot->compression, files, snapshot->num_files, write_failed);
         if (*write_failed == true) {
             g_debug("[db_save] failed to save sorted files");
             goto out;
@@ -918,18 +2642,155 @@ out:
     return bytes_written;
 }
 
+static FsearchTrigramIndex *
+db_save_get_trigram_index(FsearchTrigramIndex *index, DynamicArray *entries) {
+    if (fsearch_trigram_index_is_built_for(index, entries)) {
+        return fsearch_trigram_index_ref(index);
+    }
+    // Entries were added since the index was built, those are indexed separately. The saved index must
+    // be built for the saved entries only though. This runs in the background, so it's done single threaded.
+    return fsearch_trigram_index_new(entries, NULL);
+}
+
+static size_t
+db_save_trigram_indexes(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
+    if (!snapshot->folder_trigram_index || !snapshot->file_trigram_index) {
+        return 0;
+    }
+    FsearchTrigramIndex *folder_index = db_save_get_trigram_index(snapshot->folder_trigram_index, snapshot->folders);
+    FsearchTrigramIndex *file_index = db_save_get_trigram_index(snapshot->file_trigram_index, snapshot->files);
+
+    size_t bytes_written = 0;
+    const uint32_t block_id = DATABASE_BLOCK_TRIGRAM_INDEX;
+    const uint64_t block_size =
+        fsearch_trigram_index_get_write_size(folder_index) + fsearch_trigram_index_get_write_size(file_index);
+    bytes_written += write_data_to_file(fp, &block_id, 4, 1, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    bytes_written += write_data_to_file(fp, &block_size, 8, 1, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    bytes_written += fsearch_trigram_index_write(folder_index, fp, write_failed);
+    if (*write_failed == true) {
+        goto out;
+    }
+    bytes_written += fsearch_trigram_index_write(file_index, fp, write_failed);
+
+out:
+    g_clear_pointer(&folder_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&file_index, fsearch_trigram_index_unref);
+    return bytes_written;
+}
+
+static void
+db_save_xattr_ids(GByteArray *block, GHashTable *local_ids, DynamicArray *entries, uint32_t num_entries) {
+    g_byte_array_append(block, (const guint8 *)&num_entries, 4);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        const uint32_t id = db_entry_get_xattrs_id(darray_get_item(entries, i));
+        uint32_t local_id = 0;
+        if (id != FSEARCH_STRING_TABLE_NO_ID) {
+            local_id = GPOINTER_TO_UINT(g_hash_table_lookup(local_ids, GUINT_TO_POINTER(id)));
+            if (local_id == 0) {
+                local_id = g_hash_table_size(local_ids) + 1;
+                g_hash_table_insert(local_ids, GUINT_TO_POINTER(id), GUINT_TO_POINTER(local_id));
+            }
+        }
+        g_byte_array_append(block, (const guint8 *)&local_id, 4);
+    }
+}
+
+static void
+db_save_xattr_list(gpointer key, gpointer value, gpointer user_data) {
+    GPtrArray *lists = user_data;
+    g_ptr_array_index(lists, GPOINTER_TO_UINT(value) - 1) = key;
+}
+
+// See db_load_xattrs for the layout of the block
+static size_t
+db_save_xattrs(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
+    if (!snapshot->xattr_settings) {
+        return 0;
+    }
+    // the entry ids are collected first, they decide which lists are part of the block
+    g_autoptr(GHashTable) local_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_autoptr(GByteArray) entry_ids = g_byte_array_new();
+    db_save_xattr_ids(entry_ids, local_ids, snapshot->folders, snapshot->num_folders);
+    db_save_xattr_ids(entry_ids, local_ids, snapshot->files, snapshot->num_files);
+
+    const uint32_t num_lists = g_hash_table_size(local_ids);
+    g_autoptr(GPtrArray) lists = g_ptr_array_sized_new(num_lists);
+    g_ptr_array_set_size(lists, (gint)num_lists);
+    g_hash_table_foreach(local_ids, db_save_xattr_list, lists);
+
+    g_autoptr(GByteArray) block = g_byte_array_new();
+    const uint32_t settings_len = (uint32_t)strlen(snapshot->xattr_settings);
+    g_byte_array_append(block, (const guint8 *)&settings_len, 4);
+    g_byte_array_append(block, (const guint8 *)snapshot->xattr_settings, settings_len);
+    g_byte_array_append(block, (const guint8 *)&num_lists, 4);
+    for (uint32_t i = 0; i < num_lists; i++) {
+        size_t len = 0;
+        const char *xattrs = db_entry_get_xattrs_for_id(GPOINTER_TO_UINT(g_ptr_array_index(lists, i)), &len);
+        const uint32_t list_len = (uint32_t)len;
+        g_byte_array_append(block, (const guint8 *)&list_len, 4);
+        g_byte_array_append(block, (const guint8 *)xattrs, list_len);
+    }
+    g_byte_array_append(block, entry_ids->data, entry_ids->len);
+
+    size_t bytes_written = 0;
+    const uint32_t block_id = DATABASE_BLOCK_XATTRS;
+    const uint64_t block_size = block->len;
+    bytes_written += write_data_to_file(fp, &block_id, 4, 1, write_failed);
+    if (*write_failed == true) {
+        return bytes_written;
+    }
+    bytes_written += write_data_to_file(fp, &block_size, 8, 1, write_failed);
+    if (*write_failed == true) {
+        return bytes_written;
+    }
+    bytes_written += write_data_to_file(fp, block->data, 1, block->len, write_failed);
+    return bytes_written;
+}
+
+// See db_load_folder_identities for the layout of the block
+static size_t
+db_save_folder_identities(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
+    g_autoptr(GByteArray) block = g_byte_array_sized_new(4 + 4 * snapshot->num_folders);
+    g_byte_array_append(block, (const guint8 *)&snapshot->num_folders, 4);
+    for (uint32_t i = 0; i < snapshot->num_folders; i++) {
+        const uint32_t identity = db_entry_folder_get_identity(darray_get_item(snapshot->folders, i));
+        g_byte_array_append(block, (const guint8 *)&identity, 4);
+    }
+
+    size_t bytes_written = 0;
+    const uint32_t block_id = DATABASE_BLOCK_FOLDER_IDENTITIES;
+    const uint64_t block_size = block->len;
+    bytes_written += write_data_to_file(fp, &block_id, 4, 1, write_failed);
+    if (*write_failed == true) {
+        return bytes_written;
+    }
+    bytes_written += write_data_to_file(fp, &block_size, 8, 1, write_failed);
+    if (*write_failed == true) {
+        return bytes_written;
+    }
+    bytes_written += write_data_to_file(fp, block->data, 1, block->len, write_failed);
+    return bytes_written;
+}
+
 static size_t
 db_save_folders(FILE *fp,
                 FsearchDatabaseIndexFlags index_flags,
                 DynamicArray *folders,
-                uint32_t num_folders,
+                const uint32_t *parent_indexes,
+                uint32_t start,
+                uint32_t end,
+                GString *name_prev,
+                GString *name_new,
                 bool *write_failed) {
     size_t bytes_written = 0;
 
-    g_autoptr(GString) name_prev = g_string_sized_new(256);
-    g_autoptr(GString) name_new = g_string_sized_new(256);
-
-    for (uint32_t i = 0; i < num_folders; i++) {
+    for (uint32_t i = start; i < end; i++) {
         FsearchDatabaseEntry *entry = darray_get_item(folders, i);
 
         // TODO: actually store the folders db_index instead of always 0
@@ -940,20 +2801,110 @@ db_save_folders(FILE *fp,
             return bytes_written;
         }
 
-        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
-        const uint32_t parent_idx = parent ? db_entry_get_idx((FsearchDatabaseEntry *)parent) : db_entry_get_idx(entry);
         bytes_written +=
-            db_save_entry_super_elements(fp, index_flags, entry, parent_idx, name_prev, name_new, write_failed);
+            db_save_entry_super_elements(fp, index_flags, entry, parent_indexes[i], name_prev, name_new, write_failed);
+        if (*write_failed == true) {
+            return bytes_written;
+        }
+    }
+
+    return bytes_written;
+}
+
+// Starts writing back what was written so far, so the kernel doesn't have to write the whole file at once
+// when it gets synced
+static void
+db_file_start_write_back(FILE *fp) {
+#ifdef SYNC_FILE_RANGE_WRITE
+    if (fflush(fp) == 0) {
+        sync_file_range(fileno(fp), 0, 0, SYNC_FILE_RANGE_WRITE);
+    }
+#endif
+}
+
+// Stores the entries in chunks of DATABASE_CHUNK_NUM_ENTRIES, which can be decoded independently of each other
+static size_t
+db_save_block(FILE *fp,
+              FsearchDatabaseIndexFlags index_flags,
+              FsearchDatabaseCompression compression,
+              FsearchDatabaseEntryType type,
+              DynamicArray *entries,
+              const uint32_t *parent_indexes,
+              uint32_t num_entries,
+              uint64_t *chunk_offsets,
+              DatabaseProgress *progress,
+              bool *write_failed) {
+    size_t bytes_written = 0;
+
+    g_autoptr(GString) name_prev = g_string_sized_new(256);
+    g_autoptr(GString) name_new = g_string_sized_new(256);
+
+    for (uint32_t start = 0; start < num_entries; start += DATABASE_CHUNK_NUM_ENTRIES) {
+        const uint32_t end = MIN(start + DATABASE_CHUNK_NUM_ENTRIES, num_entries);
+        chunk_offsets[start / DATABASE_CHUNK_NUM_ENTRIES] = bytes_written;
+        // every chunk starts with a full name
+        g_string_truncate(name_prev, 0);
+
+        // compressed chunks are written to memory first
+        g_autofree char *chunk_data = NULL;
+        size_t chunk_data_len = 0;
+        FILE *chunk_fp = compression == DATABASE_COMPRESSION_NONE ? fp : open_memstream(&chunk_data, &chunk_data_len);
+        if (!chunk_fp) {
+            *write_failed = true;
+            return bytes_written;
+        }
+
+        size_t chunk_bytes_written = 0;
+        if (type == DATABASE_ENTRY_TYPE_FOLDER) {
+            chunk_bytes_written = db_save_folders(chunk_fp,
+                                                  index_flags,
+                                                  entries,
+                                                  parent_indexes,
+                                                  start,
+                                                  end,
+                                                  name_prev,
+                                                  name_new,
+                                                  write_failed);
+        }
+        else {
+            chunk_bytes_written = db_save_files(chunk_fp,
+                                                index_flags,
+                                                entries,
+                                                parent_indexes,
+                                                start,
+                                                end,
+                                                name_prev,
+                                                name_new,
+                                                write_failed);
+        }
+
+        if (chunk_fp == fp) {
+            bytes_written += chunk_bytes_written;
+        }
+        else {
+            if (fclose(chunk_fp) != 0) {
+                *write_failed = true;
+            }
+            if (*write_failed == false) {
+                bytes_written +=
+                    db_save_compressed(fp, compression, (uint8_t *)chunk_data, chunk_data_len, write_failed);
+            }
+        }
         if (*write_failed == true) {
             return bytes_written;
         }
+        db_file_start_write_back(fp);
+        if (!db_progress_add(progress, end - start)) {
+            *write_failed = true;
+            return bytes_written;
+        }
     }
 
     return bytes_written;
 }
 
 static size_t
-db_save_indexes(FILE *fp, FsearchDatabase *db, bool *write_failed) {
+db_save_indexes(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
     size_t bytes_written = 0;
 
     // TODO: actually implement storing all index information
@@ -968,7 +2919,7 @@ out:
 }
 
 static size_t
-db_save_excludes(FILE *fp, FsearchDatabase *db, bool *write_failed) {
+db_save_excludes(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
     size_t bytes_written = 0;
 
     // TODO: actually implement storing all exclude information
@@ -983,15 +2934,20 @@ out:
 }
 
 static size_t
-db_save_exclude_pattern(FILE *fp, FsearchDatabase *db, bool *write_failed) {
+db_save_exclude_pattern(FILE *fp, DatabaseSaveSnapshot *snapshot, bool *write_failed) {
     // TODO
     return 0;
 }
 
-bool
-db_save(FsearchDatabase *db, const char *path) {
-    g_assert(path);
-    g_assert(db);
+static char *
+db_get_file_path(const char *dir) {
+    return g_build_filename(dir, "fsearch.db", NULL);
+}
+
+// Writes the database file, this doesn't access the database the snapshot was taken from
+static bool
+db_save_snapshot_write_file(DatabaseSaveSnapshot *snapshot, DatabaseProgress *progress) {
+    const char *path = snapshot->path;
 
     g_debug("[db_save] saving database to file...");
 
@@ -1003,13 +2959,17 @@ db_save(FsearchDatabase *db, const char *path) {
     g_autoptr(GTimer) timer = g_timer_new();
     g_timer_start(timer);
 
-    g_autoptr(GString) path_full = g_string_new(path);
-    g_string_append_c(path_full, G_DIR_SEPARATOR);
-    g_string_append(path_full, "fsearch.db");
+    g_autofree char *file_path = db_get_file_path(path);
+    g_autoptr(GString) path_full = g_string_new(file_path);
 
     g_autoptr(GString) path_full_temp = g_string_new(path_full->str);
     g_string_append(path_full_temp, ".tmp");
 
+    uint64_t *folder_chunk_offsets = NULL;
+    uint64_t *file_chunk_offsets = NULL;
+    uint32_t num_folder_chunks = 0;
+    uint32_t num_file_chunks = 0;
+
     g_debug("[db_save] trying to open temporary database file: %s", path_full_temp->str);
 
     FILE *fp = db_file_open_locked(path_full_temp->str, "wb");
@@ -1017,9 +2977,9 @@ db_save(FsearchDatabase *db, const char *path) {
         g_debug("[db_save] failed to open temporary database file: %s", path_full_temp->str);
         goto save_fail;
     }
-
-    g_debug("[db_save] updating folder indices...");
-    db_entry_update_folder_indices(db);
+    // the file is written in lots of small pieces
+    setvbuf(fp, NULL, _IOFBF, DATABASE_WRITE_BUFFER_SIZE);
+    db_progress_set_status(progress, _("Saving database…"));
 
     bool write_failed = false;
 
@@ -1032,23 +2992,23 @@ db_save(FsearchDatabase *db, const char *path) {
     }
 
     g_debug("[db_save] saving database index flags...");
-    const uint64_t index_flags = db->index_flags;
+    const uint64_t index_flags = snapshot->index_flags;
     bytes_written += write_data_to_file(fp, &index_flags, 8, 1, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
 
-    DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
-    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files = snapshot->files;
+    DynamicArray *folders = snapshot->folders;
 
-    const uint32_t num_folders = darray_get_num_items(folders);
+    const uint32_t num_folders = snapshot->num_folders;
     g_debug("[db_save] saving number of folders: %d", num_folders);
     bytes_written += write_data_to_file(fp, &num_folders, 4, 1, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
 
-    const uint32_t num_files = darray_get_num_items(files);
+    const uint32_t num_files = snapshot->num_files;
     g_debug("[db_save] saving number of files: %d", num_files);
     bytes_written += write_data_to_file(fp, &num_files, 4, 1, &write_failed);
     if (write_failed == true) {
@@ -1072,34 +3032,97 @@ db_save(FsearchDatabase *db, const char *path) {
     }
 
     g_debug("[db_save] saving indices...");
-    bytes_written += db_save_indexes(fp, db, &write_failed);
+    bytes_written += db_save_indexes(fp, snapshot, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
     g_debug("[db_save] saving excludes...");
-    bytes_written += db_save_excludes(fp, db, &write_failed);
+    bytes_written += db_save_excludes(fp, snapshot, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
     g_debug("[db_save] saving exclude pattern...");
-    bytes_written += db_save_exclude_pattern(fp, db, &write_failed);
+    bytes_written += db_save_exclude_pattern(fp, snapshot, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    const uint32_t chunk_size = DATABASE_CHUNK_NUM_ENTRIES;
+    g_debug("[db_save] saving chunk size...");
+    bytes_written += write_data_to_file(fp, &chunk_size, 4, 1, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    const FsearchDatabaseCompression compression = snapshot->compression;
+    const uint8_t compression_id = compression;
+    g_debug("[db_save] saving compression: %d", compression_id);
+    bytes_written += write_data_to_file(fp, &compression_id, 1, 1, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    // the chunk offsets are only known after the blocks were written, reserve space for them here
+    num_folder_chunks = num_folders / chunk_size + (num_folders % chunk_size ? 1 : 0);
+    num_file_chunks = num_files / chunk_size + (num_files % chunk_size ? 1 : 0);
+    folder_chunk_offsets = calloc(num_folder_chunks + 1, sizeof(uint64_t));
+    g_assert(folder_chunk_offsets);
+    file_chunk_offsets = calloc(num_file_chunks + 1, sizeof(uint64_t));
+    g_assert(file_chunk_offsets);
+    const uint64_t chunk_table_offset = bytes_written;
+    g_debug("[db_save] saving chunk tables...");
+    bytes_written += write_data_to_file(fp, folder_chunk_offsets, 8, num_folder_chunks, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    bytes_written += write_data_to_file(fp, file_chunk_offsets, 8, num_file_chunks, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
     g_debug("[db_save] saving folders...");
-    folder_block_size = db_save_folders(fp, index_flags, folders, num_folders, &write_failed);
+    folder_block_size = db_save_block(fp,
+                                      index_flags,
+                                      compression,
+                                      DATABASE_ENTRY_TYPE_FOLDER,
+                                      folders,
+                                      snapshot->folder_parent_indexes,
+                                      num_folders,
+                                      folder_chunk_offsets,
+                                      progress,
+                                      &write_failed);
     bytes_written += folder_block_size;
     if (write_failed == true) {
         goto save_fail;
     }
     g_debug("[db_save] saving files...");
-    file_block_size = db_save_files(fp, index_flags, files, num_files, &write_failed);
+    file_block_size = db_save_block(fp,
+                                    index_flags,
+                                    compression,
+                                    DATABASE_ENTRY_TYPE_FILE,
+                                    files,
+                                    snapshot->file_parent_indexes,
+                                    num_files,
+                                    file_chunk_offsets,
+                                    progress,
+                                    &write_failed);
     bytes_written += file_block_size;
     if (write_failed == true) {
         goto save_fail;
     }
     g_debug("[db_save] saving sorted arrays...");
-    bytes_written += db_save_sorted_arrays(fp, db, num_files, num_folders, &write_failed);
+    bytes_written += db_save_sorted_arrays(fp, snapshot, &write_failed);
+    if (write_failed == true || db_progress_is_cancelled(progress)) {
+        goto save_fail;
+    }
+    g_debug("[db_save] saving trigram indexes...");
+    bytes_written += db_save_trigram_indexes(fp, snapshot, &write_failed);
+    if (write_failed == true || db_progress_is_cancelled(progress)) {
+        goto save_fail;
+    }
+    g_debug("[db_save] saving extended attributes...");
+    bytes_written += db_save_xattrs(fp, snapshot, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    g_debug("[db_save] saving folder identities...");
+    bytes_written += db_save_folder_identities(fp, snapshot, &write_failed);
     if (write_failed == true) {
         goto save_fail;
     }
@@ -1118,14 +3141,37 @@ db_save(FsearchDatabase *db, const char *path) {
         goto save_fail;
     }
 
-    g_debug("[db_save] removing current database file...");
-    // remove current database file
-    unlink(path_full->str);
+    if (fseek(fp, (long int)chunk_table_offset, SEEK_SET) != 0) {
+        goto save_fail;
+    }
+    g_debug("[db_save] updating chunk tables: %u folder chunks, %u file chunks", num_folder_chunks, num_file_chunks);
+    bytes_written += write_data_to_file(fp, folder_chunk_offsets, 8, num_folder_chunks, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    bytes_written += write_data_to_file(fp, file_chunk_offsets, 8, num_file_chunks, &write_failed);
+    if (write_failed == true) {
+        goto save_fail;
+    }
+    g_clear_pointer(&folder_chunk_offsets, free);
+    g_clear_pointer(&file_chunk_offsets, free);
+
+    // make sure the file is complete before it replaces the current one, a single sync at the end is enough
+    // since most of it was already written back while saving
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+        goto save_fail;
+    }
+    // the current file is only replaced by saves which weren't cancelled
+    if (db_progress_is_cancelled(progress)) {
+        goto save_fail;
+    }
+    // the file won't be read again until the next start, don't keep it in the page cache
+    posix_fadvise(fileno(fp), 0, 0, POSIX_FADV_DONTNEED);
 
     g_clear_pointer(&fp, fclose);
 
     g_debug("[db_save] renaming temporary database file: %s -> %s", path_full_temp->str, path_full->str);
-    // rename temporary fsearch.db.tmp to fsearch.db
+    // rename temporary fsearch.db.tmp to fsearch.db, this replaces the current database file
     if (rename(path_full_temp->str, path_full->str) != 0) {
         goto save_fail;
     }
@@ -1138,9 +3184,16 @@ db_save(FsearchDatabase *db, const char *path) {
     return true;
 
 save_fail:
-    g_warning("[db_save] saving failed");
+    if (db_progress_is_cancelled(progress)) {
+        g_debug("[db_save] saving cancelled");
+    }
+    else {
+        g_warning("[db_save] saving failed");
+    }
 
     g_clear_pointer(&fp, fclose);
+    g_clear_pointer(&folder_chunk_offsets, free);
+    g_clear_pointer(&file_chunk_offsets, free);
 
     // remove temporary fsearch.db.tmp file
     unlink(path_full_temp->str);
@@ -1149,34 +3202,170 @@ save_fail:
 }
 
 static bool
-file_is_excluded(const char *name, char **exclude_files) {
-    if (exclude_files) {
-        for (int i = 0; exclude_files[i]; ++i) {
-            if (!fnmatch(exclude_files[i], name, 0)) {
-                return true;
-            }
-        }
+db_save_snapshot_write(DatabaseSaveSnapshot *snapshot, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    // the file is written by the calling thread alone
+    FsearchOperationTimer timer = {};
+    fsearch_operation_timer_start(&timer, NULL);
+    DatabaseProgress progress = {0};
+    db_progress_init(&progress, cancellable, status_cb, snapshot->num_folders + snapshot->num_files);
+    const int64_t span = fsearch_trace_begin();
+    const bool res = db_save_snapshot_write_file(snapshot, &progress);
+    fsearch_trace_end(span, "save", "write file");
+    db_progress_clear(&progress);
+    if (res) {
+        const uint32_t num_entries = snapshot->num_folders + snapshot->num_files;
+        db_finish_operation(snapshot->db, FSEARCH_OPERATION_SAVE, &timer, num_entries, num_entries);
+    }
+    return res;
+}
+
+static void
+db_build_missing_indexes(FsearchDatabase *db);
+
+static void
+db_wait_for_background_indexes(void);
+
+bool
+db_save(FsearchDatabase *db, const char *path, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    g_assert(path);
+    g_assert(db);
+
+    if (db->background_indexes_pending) {
+        // the file should contain all of them, waiting for the background task would need the database lock
+        db_build_missing_indexes(db);
     }
-    return false;
+
+    const int64_t span = fsearch_trace_begin();
+    DatabaseSaveSnapshot *snapshot = db_save_snapshot_new(db, path);
+    fsearch_trace_end(span, "save", "snapshot");
+    const bool res = db_save_snapshot_write(snapshot, cancellable, status_cb);
+    g_clear_pointer(&snapshot, db_save_snapshot_free);
+    if (res) {
+        // all changes are part of the database file now
+        g_autofree char *file_path = db_get_file_path(path);
+        db_journal_start(db, file_path, true);
+    }
+    return res;
 }
 
-static bool
-directory_is_excluded(const char *name, GList *excludes) {
-    while (excludes) {
-        FsearchExcludePath *fs_path = excludes->data;
-        if (!strcmp(name, fs_path->path)) {
-            if (fs_path->enabled) {
-                return true;
-            }
-            return false;
+// Saves are queued on a single thread, so they never write the same file at the same time
+static GMutex save_queue_mutex;
+static FsearchTaskQueue *save_queue = NULL;
+
+static void
+db_save_set_low_io_priority(void) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    // not exported by glibc, see ioprio_set(2)
+    const int ioprio_class_idle = 3;
+    const int ioprio_class_shift = 13;
+    const int ioprio_who_process = 1;
+    // only changes the priority of the calling thread
+    syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift);
+#endif
+}
+
+static gpointer
+db_save_task(gpointer data, GCancellable *cancellable) {
+    DatabaseSaveSnapshot *snapshot = data;
+    db_save_set_low_io_priority();
+
+    const bool res = db_save_snapshot_write(snapshot, cancellable, NULL);
+
+    FsearchDatabase *db = snapshot->db;
+    db_lock(db);
+    if (res) {
+        g_autofree char *file_path = db_get_file_path(snapshot->path);
+        if (db->journal) {
+            // changes which happened while saving aren't part of the file
+            db_journal_remove_records_before(db->journal, snapshot->journal_size);
+        }
+        else {
+            db_journal_start(db, file_path, true);
         }
-        excludes = excludes->next;
     }
-    return false;
+    // the save which cancelled this one is still pending then
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        db->background_save_pending = false;
+    }
+    db_unlock(db);
+    return NULL;
+}
+
+static void
+db_save_task_cancelled(gpointer data) {
+    DatabaseSaveSnapshot *snapshot = data;
+    g_clear_pointer(&snapshot, db_save_snapshot_free);
+}
+
+static void
+db_save_task_finished(gpointer result, gpointer data) {
+    db_save_task_cancelled(data);
+}
+
+void
+db_save_in_background(FsearchDatabase *db, const char *path) {
+    g_assert(path);
+    g_assert(db);
+
+    if (db->background_indexes_pending) {
+        // the snapshot would miss the sorted arrays which aren't built yet, db_finish_background_indexes saves it
+        g_free(db->pending_save_path);
+        db->pending_save_path = g_strdup(path);
+        db->background_save_pending = true;
+        return;
+    }
+
+    const int64_t span = fsearch_trace_begin();
+    DatabaseSaveSnapshot *snapshot = db_save_snapshot_new(db, path);
+    fsearch_trace_end(span, "save", "snapshot");
+    db->background_save_pending = true;
+
+    g_mutex_lock(&save_queue_mutex);
+    if (!save_queue) {
+        save_queue = fsearch_task_queue_new("fsearch_save_queue");
+    }
+    // every snapshot holds the whole database, so older ones don't need to be written anymore. The one which is
+    // written right now gets cancelled, which leaves the current database file as it is.
+    fsearch_task_queue(save_queue,
+                       FSEARCH_TASK_ID_SAVE,
+                       db_save_task,
+                       db_save_task_finished,
+                       db_save_task_cancelled,
+                       FSEARCH_TASK_CLEAR_SAME_ID,
+                       FSEARCH_TASK_PRIORITY_SAVE,
+                       snapshot);
+    g_mutex_unlock(&save_queue_mutex);
+}
+
+void
+db_save_wait_for_background_saves(void) {
+    // saves which wait for their sorted arrays get queued once they're built
+    db_wait_for_background_indexes();
+
+    g_mutex_lock(&save_queue_mutex);
+    if (save_queue) {
+        g_debug("[db_save] waiting for background saves...");
+        fsearch_task_queue_wait(save_queue);
+        g_clear_pointer(&save_queue, fsearch_task_queue_free);
+    }
+    g_mutex_unlock(&save_queue_mutex);
+}
+
+static bool
+file_is_excluded(FsearchDatabase *db, const char *name, size_t name_len) {
+    return fsearch_exclude_matcher_file_is_excluded(db->exclude_matcher, name, name_len);
+}
+
+static bool
+directory_is_excluded(FsearchDatabase *db, const char *path) {
+    return fsearch_exclude_matcher_path_is_excluded(db->exclude_matcher, path);
 }
 
 typedef struct DatabaseWalkContext {
     FsearchDatabase *db;
+    // new entries get appended to those arrays
+    DynamicArray *folders;
+    DynamicArray *files;
     GString *path;
     GTimer *timer;
     GCancellable *cancellable;
@@ -1185,29 +3374,162 @@ typedef struct DatabaseWalkContext {
     dev_t root_device_id;
     bool one_filesystem;
     bool exclude_hidden;
+    // add the size of every file to its parents right away, otherwise db_update_folder_sizes does it after the walk
+    bool update_folder_sizes;
 } DatabaseWalkContext;
 
-static int
-db_folder_scan_recursive(DatabaseWalkContext *walk_context, FsearchDatabaseEntryFolder *parent) {
-    if (walk_context->cancellable && g_cancellable_is_cancelled(walk_context->cancellable)) {
-        g_debug("[db_scan] cancelled");
-        return WALK_CANCEL;
+static FsearchDirectoryStatFields
+db_get_stat_fields(FsearchDatabase *db) {
+    FsearchDirectoryStatFields fields = 0;
+    if (db->entry_optional_values & DATABASE_INDEX_FLAG_ACCESS_TIME) {
+        fields |= FSEARCH_DIRECTORY_STAT_ACCESS_TIME;
+    }
+    if (db->entry_optional_values & DATABASE_INDEX_FLAG_CREATION_TIME) {
+        fields |= FSEARCH_DIRECTORY_STAT_CREATION_TIME;
+    }
+    if (db->entry_optional_values & DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME) {
+        fields |= FSEARCH_DIRECTORY_STAT_STATUS_CHANGE_TIME;
     }
+    if (db->entry_optional_values & DATABASE_INDEX_FLAG_OWNER) {
+        fields |= FSEARCH_DIRECTORY_STAT_OWNER;
+    }
+    // the rescan uses it to tell whether folders changed
+    fields |= FSEARCH_DIRECTORY_STAT_IDENTITY;
+    return fields;
+}
 
-    GString *path = walk_context->path;
-    g_string_append_c(path, G_DIR_SEPARATOR);
+// Returns when a filesystem call of a scan starts, only needed if the scan is paced
+static int64_t
+db_scan_throttle_start(FsearchDatabase *db) {
+    return db->scan_throttle ? g_get_monotonic_time() : 0;
+}
+
+// Charges the calls since start_us to the budget of the scan and waits if it's used up
+static void
+db_scan_throttle_charge(FsearchDatabase *db, uint32_t num_calls, uint64_t num_bytes, int64_t start_us) {
+    if (db->scan_throttle) {
+        fsearch_scan_throttle_charge_and_wait(db->scan_throttle,
+                                              num_calls,
+                                              num_bytes,
+                                              num_calls > 0 ? g_get_monotonic_time() - start_us : 0);
+    }
+}
+
+// Mixes the device, inode and status change time of a folder into a hash which is never 0, 0 stands for unknown
+static uint32_t
+db_get_folder_identity(dev_t device_id, ino_t inode, time_t ctime) {
+    uint64_t h = (uint64_t)device_id * 0x9e3779b97f4a7c15ull;
+    h = (h ^ (uint64_t)inode) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (uint64_t)ctime) * 0x94d049bb133111ebull;
+    const uint32_t identity = (uint32_t)(h ^ (h >> 32));
+    return identity ? identity : 1;
+}
+
+static uint32_t
+db_get_stat_identity(const FsearchDirectoryEntryStat *st) {
+    return db_get_folder_identity(st->device_id, st->inode, st->ctime);
+}
+
+// the optional times of st in the order of db_optional_times
+static void
+db_get_stat_times_array(const FsearchDirectoryEntryStat *st, time_t times[3]) {
+    times[0] = st->atime;
+    times[1] = st->btime;
+    times[2] = st->ctime;
+}
+
+static bool
+db_entry_stat_values_differ(FsearchDatabaseEntry *entry, const FsearchDirectoryEntryStat *st) {
+    time_t times[G_N_ELEMENTS(db_optional_times)];
+    db_get_stat_times_array(st, times);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_optional_times); i++) {
+        const FsearchDatabaseIndexType type = db_optional_times[i].type;
+        if (db_entry_has_time(entry, type) && db_entry_get_time(entry, type) != times[i]) {
+            return true;
+        }
+    }
+    return db_entry_has_owner(entry)
+        && (db_entry_get_user_id(entry) != db_entry_get_user_id_for_uid(st->uid)
+            || db_entry_get_group_id(entry) != db_entry_get_group_id_for_gid(st->gid)
+            || db_entry_get_mode(entry) != (uint16_t)st->mode);
+}
+
+// Only sets the optional values entry has room for
+static void
+db_entry_set_stat_values(FsearchDatabaseEntry *entry, const FsearchDirectoryEntryStat *st) {
+    time_t times[G_N_ELEMENTS(db_optional_times)];
+    db_get_stat_times_array(st, times);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_optional_times); i++) {
+        db_entry_set_time(entry, db_optional_times[i].type, times[i]);
+    }
+    db_entry_set_owner(entry, st->uid, st->gid, st->mode);
+}
+
+// Gives a new entry, whose type has to be set already, room for the optional values of the database and sets them
+static void
+db_entry_init_stat_values(FsearchDatabase *db, FsearchDatabaseEntry *entry, const FsearchDirectoryEntryStat *st) {
+    db_entry_init_optional_values(entry, db->entry_optional_values);
+    if (st) {
+        db_entry_set_stat_values(entry, st);
+        if (db_entry_is_folder(entry)) {
+            db_entry_folder_set_identity((FsearchDatabaseEntryFolder *)entry, db_get_stat_identity(st));
+        }
+    }
+}
+
+// Whether the extended attributes of the entries in the folder at path get read
+static bool
+db_folder_wants_xattrs(FsearchDatabase *db, const char *path) {
+    if (!(db->entry_optional_values & DATABASE_INDEX_FLAG_XATTRS) || !db->xattr_names) {
+        return false;
+    }
+    if (!db->xattr_paths) {
+        return true;
+    }
+    for (uint32_t i = 0; db->xattr_paths[i]; i++) {
+        const size_t len = strlen(db->xattr_paths[i]);
+        if (strncmp(path, db->xattr_paths[i], len) == 0 && (path[len] == G_DIR_SEPARATOR || path[len] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads the extended attributes of the entry at path into buffer and stores them in entry.
+// Returns true if they changed.
+static bool
+db_entry_read_xattrs(FsearchDatabase *db, FsearchDatabaseEntry *entry, const char *path, GString *buffer) {
+    fsearch_xattr_read(path, (const char *const *)db->xattr_names, buffer);
+    const uint32_t xattrs_id = db_entry_get_xattrs_id_for_xattrs(buffer->str, buffer->len);
+    if (xattrs_id == db_entry_get_xattrs_id(entry)) {
+        return false;
+    }
+    db_entry_set_xattrs_id(entry, xattrs_id);
+    return true;
+}
+
+static int
+db_folder_scan_recursive(DatabaseWalkContext *walk_context, FsearchDatabaseEntryFolder *parent) {
+    if (walk_context->cancellable && g_cancellable_is_cancelled(walk_context->cancellable)) {
+        g_debug("[db_scan] cancelled");
+        return WALK_CANCEL;
+    }
+
+    GString *path = walk_context->path;
+    g_string_append_c(path, G_DIR_SEPARATOR);
 
     // remember end of parent path
     const gsize path_len = path->len;
 
-    DIR *dir = NULL;
-    if (!(dir = opendir(path->str))) {
+    FsearchDatabase *db = walk_context->db;
+    const int64_t open_start_us = db_scan_throttle_start(db);
+    FsearchDirectoryReader *dir = fsearch_directory_reader_open(path->str);
+    db_scan_throttle_charge(db, 1, 0, open_start_us);
+    if (!dir) {
         g_debug("[db_scan] failed to open directory: %s", path->str);
         return WALK_BADIO;
     }
 
-    const int dir_fd = dirfd(dir);
-
     const double elapsed_seconds = g_timer_elapsed(walk_context->timer, NULL);
     if (elapsed_seconds > 0.1) {
         if (walk_context->status_cb) {
@@ -1216,437 +3538,3765 @@ db_folder_scan_recursive(DatabaseWalkContext *walk_context, FsearchDatabaseEntry
         g_timer_start(walk_context->timer);
     }
 
-    FsearchDatabase *db = walk_context->db;
+    g_autoptr(GString) xattrs = db_folder_wants_xattrs(db, path->str) ? g_string_new(NULL) : NULL;
 
-    struct dirent *dent = NULL;
-    while ((dent = readdir(dir))) {
+    const FsearchDirectoryEntry *dent = NULL;
+    while ((dent = fsearch_directory_reader_next(dir))) {
         if (walk_context->cancellable && g_cancellable_is_cancelled(walk_context->cancellable)) {
             g_debug("[db_scan] cancelled");
-            g_clear_pointer(&dir, closedir);
+            g_clear_pointer(&dir, fsearch_directory_reader_close);
             return WALK_CANCEL;
         }
-        if (walk_context->exclude_hidden && dent->d_name[0] == '.') {
+        if (walk_context->exclude_hidden && dent->name[0] == '.') {
             // file is dotfile, skip
-            // g_debug("[db_scan] exclude hidden: %s", dent->d_name);
-            continue;
-        }
-        if (!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, "..")) {
+            // g_debug("[db_scan] exclude hidden: %s", dent->name);
             continue;
         }
-        if (file_is_excluded(dent->d_name, db->exclude_files)) {
-            // g_debug("[db_scan] excluded: %s", dent->d_name);
+        if (file_is_excluded(db, dent->name, dent->name_len)) {
+            // g_debug("[db_scan] excluded: %s", dent->name);
             continue;
         }
 
-        const size_t d_name_len = strlen(dent->d_name);
-        if (d_name_len >= 256) {
-            g_warning("[db_scan] file name too long, skipping: \"%s\" (len: %zd)", dent->d_name, d_name_len);
+        if (dent->name_len >= 256) {
+            g_warning("[db_scan] file name too long, skipping: \"%s\" (len: %zd)", dent->name, dent->name_len);
             continue;
         }
 
         // create full path of file/folder
         g_string_truncate(path, path_len);
-        g_string_append(path, dent->d_name);
+        g_string_append_len(path, dent->name, (gssize)dent->name_len);
 
-        struct stat st;
-        int stat_flags = AT_SYMLINK_NOFOLLOW;
-#ifdef AT_NO_AUTOMOUNT
-        stat_flags |= AT_NO_AUTOMOUNT;
-#endif
-        if (fstatat(dir_fd, dent->d_name, &st, stat_flags)) {
+        if (dent->type == FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER && directory_is_excluded(db, path->str)) {
+            // the type is already known, so the stat call can be skipped
+            g_debug("[db_scan] excluded directory: %s", path->str);
+            continue;
+        }
+
+        FsearchDirectoryEntryStat st;
+        const int64_t stat_start_us = db_scan_throttle_start(db);
+        const bool stat_failed = !fsearch_directory_reader_stat(dir, dent, db_get_stat_fields(db), &st);
+        db_scan_throttle_charge(db, 1, 0, stat_start_us);
+        if (stat_failed) {
             g_debug("[db_scan] can't stat: %s", path->str);
             continue;
         }
 
-        if (walk_context->one_filesystem && walk_context->root_device_id != st.st_dev) {
+        if (walk_context->one_filesystem && walk_context->root_device_id != st.device_id) {
             g_debug("[db_scan] different filesystem, skipping: %s", path->str);
             continue;
         }
 
-        const bool is_dir = S_ISDIR(st.st_mode);
-        if (is_dir && directory_is_excluded(path->str, db->excludes)) {
+        const bool is_dir = st.is_folder;
+        if (is_dir && dent->type != FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER
+            && directory_is_excluded(db, path->str)) {
             g_debug("[db_scan] excluded directory: %s", path->str);
             continue;
         }
 
         if (is_dir) {
             FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->folder_pool);
-            db_entry_set_name(entry, dent->d_name);
+            db_entry_set_pooled_name(db->name_pool, entry, dent->name, dent->name_len);
             db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
-            db_entry_set_mtime(entry, st.st_mtime);
+            db_entry_set_mtime(entry, st.mtime);
+            db_entry_init_stat_values(db, entry, &st);
+            if (xattrs) {
+                db_entry_read_xattrs(db, entry, path->str, xattrs);
+            }
             db_entry_set_parent(entry, parent);
 
-            darray_add_item(db->sorted_folders[DATABASE_INDEX_TYPE_NAME], entry);
+            darray_add_item(walk_context->folders, entry);
 
             db_folder_scan_recursive(walk_context, (FsearchDatabaseEntryFolder *)entry);
         }
         else {
             FsearchDatabaseEntry *file_entry = fsearch_memory_pool_malloc(db->file_pool);
-            db_entry_set_name(file_entry, dent->d_name);
-            db_entry_set_size(file_entry, st.st_size);
-            db_entry_set_mtime(file_entry, st.st_mtime);
+            db_entry_set_pooled_name(db->name_pool, file_entry, dent->name, dent->name_len);
+            db_entry_set_size(file_entry, st.size);
+            db_entry_set_mtime(file_entry, st.mtime);
             db_entry_set_type(file_entry, DATABASE_ENTRY_TYPE_FILE);
+            db_entry_init_stat_values(db, file_entry, &st);
+            if (xattrs) {
+                db_entry_read_xattrs(db, file_entry, path->str, xattrs);
+            }
             db_entry_set_parent(file_entry, parent);
-            db_entry_update_parent_size(file_entry);
+            if (walk_context->update_folder_sizes) {
+                db_entry_update_parent_size(file_entry);
+            }
 
-            darray_add_item(db->sorted_files[DATABASE_INDEX_TYPE_NAME], file_entry);
+            darray_add_item(walk_context->files, file_entry);
         }
     }
 
-    g_clear_pointer(&dir, closedir);
+    db_scan_throttle_charge(db, 0, fsearch_directory_reader_get_bytes_read(dir), 0);
+    g_clear_pointer(&dir, fsearch_directory_reader_close);
     return WALK_OK;
 }
 
-static bool
-db_scan_folder(FsearchDatabase *db,
-               const char *dname,
-               bool one_filesystem,
-               GCancellable *cancellable,
-               void (*status_cb)(const char *)) {
-    g_assert(dname);
-    g_assert(dname[0] == G_DIR_SEPARATOR);
-    g_debug("[db_scan] scan path: %s", dname);
+typedef struct DatabaseParallelWalkContext DatabaseParallelWalkContext;
 
-    if (!g_file_test(dname, G_FILE_TEST_IS_DIR)) {
-        g_warning("[db_scan] %s doesn't exist", dname);
-        return false;
-    }
+// The entries found by the tasks of one thread of the scan pool
+typedef struct DatabaseScanWorker {
+    DatabaseParallelWalkContext *ctx;
 
-    g_autoptr(GString) path = g_string_new(dname);
-    // remove leading path separator '/' for root directory
-    if (strcmp(path->str, G_DIR_SEPARATOR_S) == 0) {
-        g_string_erase(path, 0, 1);
-    }
+    FsearchMemoryPool *file_pool;
+    FsearchMemoryPool *folder_pool;
+    FsearchStringPool *name_pool;
+    DynamicArray *files;
+    DynamicArray *folders;
 
-    g_autoptr(GTimer) timer = g_timer_new();
-    g_timer_start(timer);
+    GString *path;
+} DatabaseScanWorker;
+
+// One of the locations a scan starts from
+typedef struct {
+    FsearchIndex *index;
+    // the name of the root entry, which is empty for /
+    const char *name;
+    FsearchDatabaseEntryFolder *entry;
+    dev_t device_id;
+    int res;
+} DatabaseScanRoot;
+
+// rotational disks are scanned by that many tasks at once
+#define DB_SCAN_ROTATIONAL_MAX_TASKS 2
+
+// The folders of one device. A spinning disk is only read by a few tasks at once, which take the waiting folders in
+// the order of their inodes, since filesystems mostly place them that way on the disk. Other devices (SSDs, network
+// filesystems, ...) get as many tasks as there are threads, and all devices are scanned at the same time.
+typedef struct {
+    dev_t device_id;
+    // 0 if there's no limit
+    uint32_t max_tasks;
+    uint32_t num_tasks;
+    // the tasks waiting for a running one to finish, sorted by inode
+    GSequence *pending;
+} DatabaseScanDevice;
+
+struct DatabaseParallelWalkContext {
+    FsearchDatabase *db;
+    GCancellable *cancellable;
+    void (*status_cb)(const char *);
+    GTimer *timer;
+    GMutex status_mutex;
 
-    struct stat root_st;
-    if (lstat(dname, &root_st)) {
-        g_debug("[db_scan] can't stat: %s", dname);
-    }
+    // every folder is scanned by its own task
+    FsearchThreadPool *pool;
+    FsearchThreadPoolGroup *group;
+    // one for every thread of the pool
+    DatabaseScanWorker *workers;
+    uint32_t num_workers;
 
-    DatabaseWalkContext walk_context = {
-        .db = db,
-        .path = path,
-        .timer = timer,
-        .cancellable = cancellable,
-        .status_cb = status_cb,
-        .root_device_id = root_st.st_dev,
-        .one_filesystem = one_filesystem,
-        .exclude_hidden = db->exclude_hidden,
-    };
+    // the DatabaseScanDevice of every device found so far, there are only a few of them
+    GPtrArray *devices;
+    GMutex devices_mutex;
 
-    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->folder_pool);
-    db_entry_set_name(entry, path->str);
-    db_entry_set_parent(entry, NULL);
-    db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+    volatile gint cancelled;
 
-    darray_add_item(db->sorted_folders[DATABASE_INDEX_TYPE_NAME], entry);
+    bool exclude_hidden;
+};
 
-    uint32_t res = db_folder_scan_recursive(&walk_context, (FsearchDatabaseEntryFolder *)entry);
+typedef struct {
+    DatabaseParallelWalkContext *ctx;
+    DatabaseScanRoot *root;
+    DatabaseScanDevice *device;
+    FsearchDatabaseEntryFolder *folder;
+    ino_t inode;
+} DatabaseScanTask;
 
-    if (res == WALK_OK) {
-        g_debug("[db_scan] scanned: %d files, %d folders -> %d total",
-                db_get_num_files(db),
-                db_get_num_folders(db),
-                db_get_num_entries(db));
-        return true;
+// Returns true if the block device is a spinning disk. Partitions have no queue of their own, the one of the disk
+// they're on is used then. Network and other virtual filesystems have no block device at all.
+static bool
+db_device_is_rotational(dev_t device_id) {
+#ifdef __linux__
+    const char *queues[] = {"queue", "../queue"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(queues); i++) {
+        g_autofree char *path =
+            g_strdup_printf("/sys/dev/block/%u:%u/%s/rotational", major(device_id), minor(device_id), queues[i]);
+        g_autofree char *contents = NULL;
+        if (g_file_get_contents(path, &contents, NULL, NULL)) {
+            return contents[0] == '1';
+        }
     }
+#endif
+    return false;
+}
 
-    if (res == WALK_CANCEL) {
-        g_debug("[db_scan] scan cancelled.");
-    }
-    else {
-        g_warning("[db_scan] walk error: %d", res);
+static void
+db_scan_device_free(DatabaseScanDevice *device) {
+    if (!device) {
+        return;
     }
-    return false;
+    g_assert(g_sequence_is_empty(device->pending));
+    g_clear_pointer(&device->pending, g_sequence_free);
+    g_clear_pointer(&device, g_free);
 }
 
-static gint
-compare_index_path(FsearchIndex *p1, FsearchIndex *p2) {
-    return strcmp(p1->path, p2->path);
+static DatabaseScanDevice *
+db_scan_get_device(DatabaseParallelWalkContext *ctx, dev_t device_id) {
+    g_mutex_lock(&ctx->devices_mutex);
+    DatabaseScanDevice *device = NULL;
+    for (uint32_t i = 0; i < ctx->devices->len; i++) {
+        DatabaseScanDevice *d = g_ptr_array_index(ctx->devices, i);
+        if (d->device_id == device_id) {
+            device = d;
+            break;
+        }
+    }
+    if (!device) {
+        device = g_new0(DatabaseScanDevice, 1);
+        device->device_id = device_id;
+        device->pending = g_sequence_new(NULL);
+        if (db_device_is_rotational(device_id)) {
+            g_debug("[db_scan] rotational device: %u:%u", major(device_id), minor(device_id));
+            device->max_tasks = DB_SCAN_ROTATIONAL_MAX_TASKS;
+        }
+        g_ptr_array_add(ctx->devices, device);
+    }
+    g_mutex_unlock(&ctx->devices_mutex);
+    return device;
 }
 
 static gint
-compare_exclude_path(FsearchExcludePath *p1, FsearchExcludePath *p2) {
-    return strcmp(p1->path, p2->path);
+db_scan_task_compare_inode(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const DatabaseScanTask *t1 = a;
+    const DatabaseScanTask *t2 = b;
+    return t1->inode < t2->inode ? -1 : t1->inode > t2->inode;
 }
 
-FsearchDatabase *
-db_new(GList *indexes, GList *excludes, char **exclude_files, bool exclude_hidden) {
-    FsearchDatabase *db = g_new0(FsearchDatabase, 1);
-    g_assert(db);
-    g_mutex_init(&db->mutex);
-    if (indexes) {
-        db->indexes = g_list_copy_deep(indexes, (GCopyFunc)fsearch_index_copy, NULL);
+static void
+db_scan_folder_task(void *data);
 
-        db->indexes = g_list_sort(db->indexes, (GCompareFunc)compare_index_path);
+static void
+db_scan_push_folder(DatabaseParallelWalkContext *ctx,
+                    DatabaseScanRoot *root,
+                    DatabaseScanDevice *device,
+                    FsearchDatabaseEntryFolder *folder,
+                    ino_t inode) {
+    DatabaseScanTask *task = g_new0(DatabaseScanTask, 1);
+    task->ctx = ctx;
+    task->root = root;
+    task->device = device;
+    task->folder = folder;
+    task->inode = inode;
+    if (device->max_tasks > 0) {
+        g_mutex_lock(&ctx->devices_mutex);
+        if (device->num_tasks >= device->max_tasks) {
+            // one of the running tasks of the device starts it once it's done
+            g_sequence_insert_sorted(device->pending, task, db_scan_task_compare_inode, NULL);
+            g_mutex_unlock(&ctx->devices_mutex);
+            return;
+        }
+        device->num_tasks++;
+        g_mutex_unlock(&ctx->devices_mutex);
     }
-    if (excludes) {
-        db->excludes = g_list_copy_deep(excludes, (GCopyFunc)fsearch_exclude_path_copy, NULL);
-        db->excludes = g_list_sort(db->excludes, (GCompareFunc)compare_exclude_path);
+    fsearch_thread_pool_group_push(ctx->group, db_scan_folder_task, task);
+}
+
+// Hands the slot of a finished task of a limited device over to the waiting folder with the lowest inode
+static void
+db_scan_finish_task(DatabaseParallelWalkContext *ctx, DatabaseScanDevice *device) {
+    if (device->max_tasks == 0) {
+        return;
     }
-    if (exclude_files) {
-        db->exclude_files = g_strdupv(exclude_files);
+    DatabaseScanTask *next = NULL;
+    g_mutex_lock(&ctx->devices_mutex);
+    if (!g_sequence_is_empty(device->pending)) {
+        GSequenceIter *first = g_sequence_get_begin_iter(device->pending);
+        next = g_sequence_get(first);
+        g_sequence_remove(first);
     }
-
-    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
-        db->sorted_files[i] = NULL;
-        db->sorted_folders[i] = NULL;
+    else {
+        device->num_tasks--;
     }
-    db->file_pool = fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK,
-                                            db_entry_get_sizeof_file_entry(),
-                                            (GDestroyNotify)db_entry_destroy);
-    db->folder_pool = fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK,
-                                              db_entry_get_sizeof_folder_entry(),
-                                              (GDestroyNotify)db_entry_destroy);
+    g_mutex_unlock(&ctx->devices_mutex);
+    if (next) {
+        fsearch_thread_pool_group_push(ctx->group, db_scan_folder_task, next);
+    }
+}
 
-    db->thread_pool = fsearch_thread_pool_init();
+static bool
+db_scan_worker_is_cancelled(DatabaseParallelWalkContext *ctx) {
+    if (g_atomic_int_get(&ctx->cancelled)) {
+        return true;
+    }
+    if (ctx->cancellable && g_cancellable_is_cancelled(ctx->cancellable)) {
+        g_debug("[db_scan] cancelled");
+        g_atomic_int_set(&ctx->cancelled, 1);
+        return true;
+    }
+    return false;
+}
 
-    db->exclude_hidden = exclude_hidden;
-    db->ref_count = 1;
-    return db;
+static void
+db_scan_worker_notify_status(DatabaseParallelWalkContext *ctx, const char *path) {
+    if (!ctx->status_cb) {
+        return;
+    }
+    // other workers will report their progress soon enough, no need to wait for the lock
+    if (!g_mutex_trylock(&ctx->status_mutex)) {
+        return;
+    }
+    const double elapsed_seconds = g_timer_elapsed(ctx->timer, NULL);
+    if (elapsed_seconds > 0.1) {
+        ctx->status_cb(path);
+        g_timer_start(ctx->timer);
+    }
+    g_mutex_unlock(&ctx->status_mutex);
 }
 
 static void
-db_free(FsearchDatabase *db) {
-    g_assert(db);
+db_scan_worker_scan_folder(DatabaseScanWorker *worker, DatabaseScanTask *task) {
+    DatabaseParallelWalkContext *ctx = worker->ctx;
+    FsearchDatabase *db = ctx->db;
+    FsearchDatabaseEntryFolder *parent = task->folder;
 
-    g_debug("[db_free] freeing...");
-    db_lock(db);
-    if (db->ref_count > 0) {
-        g_warning("[db_free] pending references on free: %d", db->ref_count);
+    GString *path = worker->path;
+    g_string_truncate(path, 0);
+    db_entry_append_full_path((FsearchDatabaseEntry *)parent, path);
+    if (path->len == 0 || path->str[path->len - 1] != G_DIR_SEPARATOR) {
+        g_string_append_c(path, G_DIR_SEPARATOR);
     }
 
-    db_sorted_entries_free(db);
-
-    g_clear_pointer(&db->file_pool, fsearch_memory_pool_free_pool);
-    g_clear_pointer(&db->folder_pool, fsearch_memory_pool_free_pool);
+    // remember end of parent path
+    const gsize path_len = path->len;
 
-    if (db->indexes) {
-        g_list_free_full(g_steal_pointer(&db->indexes), (GDestroyNotify)fsearch_index_free);
-    }
-    if (db->excludes) {
-        g_list_free_full(g_steal_pointer(&db->excludes), (GDestroyNotify)fsearch_exclude_path_free);
+    FsearchDirectoryReader *dir = NULL;
+    if (!(dir = fsearch_directory_reader_open(path->str))) {
+        g_debug("[db_scan] failed to open directory: %s", path->str);
+        if (parent == task->root->entry) {
+            // only the task of the root sets it
+            task->root->res = WALK_BADIO;
+        }
+        return;
     }
 
-    g_clear_pointer(&db->exclude_files, g_strfreev);
-    g_clear_pointer(&db->thread_pool, fsearch_thread_pool_free);
+    db_scan_worker_notify_status(ctx, path->str);
+    g_autoptr(GString) xattrs = db_folder_wants_xattrs(db, path->str) ? g_string_new(NULL) : NULL;
 
-    db_unlock(db);
+    const FsearchDirectoryEntry *dent = NULL;
+    while ((dent = fsearch_directory_reader_next(dir))) {
+        if (db_scan_worker_is_cancelled(ctx)) {
+            break;
+        }
+        if (ctx->exclude_hidden && dent->name[0] == '.') {
+            // file is dotfile, skip
+            continue;
+        }
+        if (file_is_excluded(db, dent->name, dent->name_len)) {
+            continue;
+        }
 
-    g_mutex_clear(&db->mutex);
+        if (dent->name_len >= 256) {
+            g_warning("[db_scan] file name too long, skipping: \"%s\" (len: %zd)", dent->name, dent->name_len);
+            continue;
+        }
 
-    g_clear_pointer(&db, free);
+        // create full path of file/folder
+        g_string_truncate(path, path_len);
+        g_string_append_len(path, dent->name, (gssize)dent->name_len);
 
-#ifdef HAVE_MALLOC_TRIM
-    malloc_trim(0);
-#endif
+        if (dent->type == FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER && directory_is_excluded(db, path->str)) {
+            // the type is already known, so the stat call can be skipped
+            g_debug("[db_scan] excluded directory: %s", path->str);
+            continue;
+        }
 
-    g_debug("[db_free] freed");
-}
+        FsearchDirectoryEntryStat st;
+        if (!fsearch_directory_reader_stat(dir, dent, db_get_stat_fields(db), &st)) {
+            g_debug("[db_scan] can't stat: %s", path->str);
+            continue;
+        }
 
-time_t
-db_get_timestamp(FsearchDatabase *db) {
-    g_assert(db);
-    return db->timestamp;
-}
+        if (task->root->index->one_filesystem && task->root->device_id != st.device_id) {
+            g_debug("[db_scan] different filesystem, skipping: %s", path->str);
+            continue;
+        }
 
-uint32_t
-db_get_num_files(FsearchDatabase *db) {
-    g_assert(db);
-    return db->sorted_files[DATABASE_INDEX_TYPE_NAME] ? darray_get_num_items(db->sorted_files[DATABASE_INDEX_TYPE_NAME])
-                                                      : 0;
+        const bool is_dir = st.is_folder;
+        if (is_dir && dent->type != FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER
+            && directory_is_excluded(db, path->str)) {
+            g_debug("[db_scan] excluded directory: %s", path->str);
+            continue;
+        }
+
+        if (is_dir) {
+            FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(worker->folder_pool);
+            db_entry_set_pooled_name(worker->name_pool, entry, dent->name, dent->name_len);
+            db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+            db_entry_set_mtime(entry, st.mtime);
+            db_entry_init_stat_values(db, entry, &st);
+            if (xattrs) {
+                db_entry_read_xattrs(db, entry, path->str, xattrs);
+            }
+            db_entry_set_parent(entry, parent);
+
+            darray_add_item(worker->folders, entry);
+
+            // Only the task which scans a folder modifies it, so it's safe to hand it over
+            // to a new task once it's fully initialized.
+            DatabaseScanDevice *device =
+                st.device_id == task->device->device_id ? task->device : db_scan_get_device(ctx, st.device_id);
+            db_scan_push_folder(ctx, task->root, device, (FsearchDatabaseEntryFolder *)entry, st.inode);
+        }
+        else {
+            // The folder sizes are accumulated after all workers are done, see db_update_folder_sizes
+            FsearchDatabaseEntry *file_entry = fsearch_memory_pool_malloc(worker->file_pool);
+            db_entry_set_pooled_name(worker->name_pool, file_entry, dent->name, dent->name_len);
+            db_entry_set_size(file_entry, st.size);
+            db_entry_set_mtime(file_entry, st.mtime);
+            db_entry_set_type(file_entry, DATABASE_ENTRY_TYPE_FILE);
+            db_entry_init_stat_values(db, file_entry, &st);
+            if (xattrs) {
+                db_entry_read_xattrs(db, file_entry, path->str, xattrs);
+            }
+            db_entry_set_parent(file_entry, parent);
+
+            darray_add_item(worker->files, file_entry);
+        }
+    }
+
+    g_clear_pointer(&dir, fsearch_directory_reader_close);
 }
 
-uint32_t
-db_get_num_folders(FsearchDatabase *db) {
-    g_assert(db);
-    return db->sorted_folders[DATABASE_INDEX_TYPE_NAME]
-             ? darray_get_num_items(db->sorted_folders[DATABASE_INDEX_TYPE_NAME])
-             : 0;
+static void
+db_scan_folder_task(void *data) {
+    DatabaseScanTask *task = data;
+    DatabaseParallelWalkContext *ctx = task->ctx;
+    if (!db_scan_worker_is_cancelled(ctx)) {
+        // the tasks never wait, so those of one thread run one after another and can share its worker
+        const int32_t thread_idx = fsearch_thread_pool_get_thread_index(ctx->pool);
+        g_assert(thread_idx >= 0);
+        db_scan_worker_scan_folder(&ctx->workers[thread_idx], task);
+    }
+    // cancelled tasks still pass their slot on, so the waiting ones of the device are released as well
+    db_scan_finish_task(ctx, task->device);
+    g_clear_pointer(&task, g_free);
 }
 
-uint32_t
-db_get_num_entries(FsearchDatabase *db) {
+// Scans all roots at once, the result of every root is stored in its res
+static int
+db_folder_scan_parallel(DatabaseWalkContext *walk_context,
+                        DatabaseScanRoot *roots,
+                        uint32_t num_roots,
+                        uint32_t num_workers) {
+    FsearchDatabase *db = walk_context->db;
+
+    DatabaseParallelWalkContext ctx = {
+        .db = db,
+        .cancellable = walk_context->cancellable,
+        .status_cb = walk_context->status_cb,
+        .timer = walk_context->timer,
+        .devices = g_ptr_array_new_with_free_func((GDestroyNotify)db_scan_device_free),
+        .cancelled = 0,
+        .exclude_hidden = walk_context->exclude_hidden,
+    };
+    g_mutex_init(&ctx.status_mutex);
+    g_mutex_init(&ctx.devices_mutex);
+
+    // Scanning mostly waits for the file system, so it has its own pool with as many threads as configured
+    ctx.pool = fsearch_thread_pool_new_with_affinity(num_workers, db->worker_cpu_list, false);
+    ctx.group = fsearch_thread_pool_group_new(ctx.pool);
+    ctx.num_workers = num_workers = fsearch_thread_pool_get_num_threads(ctx.pool);
+    ctx.workers = calloc(num_workers, sizeof(DatabaseScanWorker));
+    g_assert(ctx.workers);
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        DatabaseScanWorker *worker = &ctx.workers[i];
+        worker->ctx = &ctx;
+        // the pools get merged into the ones of the database, so their entries must have the same size
+        const FsearchDatabaseIndexFlags optional_values = db->entry_optional_values;
+        worker->file_pool =
+            fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK,
+                                    db_entry_get_sizeof_file_entry_with_optional_values(optional_values),
+                                    NULL);
+        worker->folder_pool =
+            fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK,
+                                    db_entry_get_sizeof_folder_entry_with_optional_values(optional_values),
+                                    NULL);
+        fsearch_memory_pool_set_huge_pages(worker->file_pool, db->huge_pages);
+        fsearch_memory_pool_set_huge_pages(worker->folder_pool, db->huge_pages);
+        worker->name_pool = fsearch_string_pool_new(true);
+        worker->files = darray_new(1024);
+        worker->folders = darray_new(1024);
+        worker->path = g_string_new(NULL);
+    }
+
+    for (uint32_t i = 0; i < num_roots; i++) {
+        DatabaseScanRoot *root = &roots[i];
+        root->res = WALK_OK;
+        db_scan_push_folder(&ctx, root, db_scan_get_device(&ctx, root->device_id), root->entry, 0);
+    }
+    g_clear_pointer(&ctx.group, fsearch_thread_pool_group_free);
+    g_clear_pointer(&ctx.pool, fsearch_thread_pool_free);
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        DatabaseScanWorker *worker = &ctx.workers[i];
+
+        // Entries are merged even if the scan was cancelled, the database owns them from now on
+        // and releases them together with its own pools.
+        darray_add_array(walk_context->files, worker->files);
+        darray_add_array(walk_context->folders, worker->folders);
+
+        fsearch_memory_pool_merge(db->file_pool, g_steal_pointer(&worker->file_pool));
+        fsearch_memory_pool_merge(db->folder_pool, g_steal_pointer(&worker->folder_pool));
+        fsearch_string_pool_merge(db->name_pool, g_steal_pointer(&worker->name_pool));
+
+        g_clear_pointer(&worker->files, darray_unref);
+        g_clear_pointer(&worker->folders, darray_unref);
+        g_string_free(g_steal_pointer(&worker->path), TRUE);
+    }
+
+    g_clear_pointer(&ctx.workers, free);
+    g_clear_pointer(&ctx.devices, g_ptr_array_unref);
+    g_mutex_clear(&ctx.devices_mutex);
+    g_mutex_clear(&ctx.status_mutex);
+
+    if (ctx.cancelled) {
+        for (uint32_t i = 0; i < num_roots; i++) {
+            roots[i].res = WALK_CANCEL;
+        }
+        return WALK_CANCEL;
+    }
+    return WALK_OK;
+}
+
+// the entries of one depth are added to their parents in ranges of that many
+#define DB_FOLDER_SIZES_GRAIN_SIZE (1 << 14)
+
+typedef struct {
+    DynamicArray *entries;
+    // the positions in entries of the folders of one depth, NULL for ranges of entries itself
+    const uint32_t *order;
+} DatabaseFolderSizesContext;
+
+static void
+db_add_sizes_to_parents_range(uint32_t start, uint32_t end, void *data) {
+    DatabaseFolderSizesContext *ctx = data;
+    // siblings are mostly next to each other, so their sizes are summed up before they're added to their parent
+    FsearchDatabaseEntryFolder *parent = NULL;
+    off_t size = 0;
+    for (uint32_t i = start; i < end; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(ctx->entries, ctx->order ? ctx->order[i] : i);
+        FsearchDatabaseEntryFolder *entry_parent = db_entry_get_parent(entry);
+        if (entry_parent != parent) {
+            if (parent && size != 0) {
+                db_entry_folder_add_size(parent, size);
+            }
+            parent = entry_parent;
+            size = 0;
+        }
+        size += db_entry_get_size(entry);
+    }
+    if (parent && size != 0) {
+        db_entry_folder_add_size(parent, size);
+    }
+}
+
+// Sets the sizes of the folders from first_folder on to the sums of the sizes of the files below them, which must
+// be the files from first_file on. Instead of adding every file to all its parents one after the other, which takes
+// as many steps as the file is deep, the files are added to their parents first and then the folders of every depth
+// to theirs, starting with the deepest ones. Every step runs in parallel.
+static void
+db_update_folder_sizes(FsearchDatabase *db,
+                       DynamicArray *folders,
+                       uint32_t first_folder,
+                       DynamicArray *files,
+                       uint32_t first_file) {
+    const uint32_t num_folders = darray_get_num_items(folders);
+    if (first_folder >= num_folders) {
+        return;
+    }
+    const int64_t span = fsearch_trace_begin();
+
+    // sort the folders by depth
+    g_autofree uint32_t *depths = g_new(uint32_t, num_folders - first_folder);
+    uint32_t max_depth = 0;
+    for (uint32_t i = first_folder; i < num_folders; i++) {
+        FsearchDatabaseEntry *folder = darray_get_item(folders, i);
+        db_entry_set_size(folder, 0);
+        depths[i - first_folder] = db_entry_get_depth(folder);
+        max_depth = MAX(max_depth, depths[i - first_folder]);
+    }
+    // depth_starts[d] is the position of the first folder of depth d in order
+    g_autofree uint32_t *depth_starts = g_new0(uint32_t, max_depth + 2);
+    for (uint32_t i = 0; i < num_folders - first_folder; i++) {
+        depth_starts[depths[i] + 1]++;
+    }
+    for (uint32_t d = 1; d <= max_depth + 1; d++) {
+        depth_starts[d] += depth_starts[d - 1];
+    }
+    g_autofree uint32_t *next = g_new(uint32_t, max_depth + 1);
+    memcpy(next, depth_starts, (max_depth + 1) * sizeof(uint32_t));
+    g_autofree uint32_t *order = g_new(uint32_t, num_folders - first_folder);
+    for (uint32_t i = 0; i < num_folders - first_folder; i++) {
+        order[next[depths[i]]++] = first_folder + i;
+    }
+
+    DatabaseFolderSizesContext files_ctx = {.entries = files};
+    fsearch_thread_pool_parallel_for(db->thread_pool,
+                                     first_file,
+                                     darray_get_num_items(files),
+                                     DB_FOLDER_SIZES_GRAIN_SIZE,
+                                     db_add_sizes_to_parents_range,
+                                     &files_ctx);
+    // a folder has its final size once all deeper ones were added, the roots of depth 0 have no parent
+    DatabaseFolderSizesContext folders_ctx = {.entries = folders, .order = order};
+    for (uint32_t d = max_depth; d > 0; d--) {
+        fsearch_thread_pool_parallel_for(db->thread_pool,
+                                         depth_starts[d],
+                                         depth_starts[d + 1],
+                                         DB_FOLDER_SIZES_GRAIN_SIZE,
+                                         db_add_sizes_to_parents_range,
+                                         &folders_ctx);
+    }
+    fsearch_trace_end(span, "scan", "folder sizes");
+}
+
+// Scans the locations of indexes from scratch. With multiple scan threads they're all scanned at once, so the
+// devices they're on are busy at the same time. Returns true if at least one of them was scanned.
+static bool
+db_scan_folders(FsearchDatabase *db,
+                FsearchIndex **indexes,
+                uint32_t num_indexes,
+                GCancellable *cancellable,
+                void (*status_cb)(const char *)) {
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_timer_start(timer);
+
+    DatabaseWalkContext walk_context = {
+        .db = db,
+        .folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME],
+        .files = db->sorted_files[DATABASE_INDEX_TYPE_NAME],
+        .timer = timer,
+        .cancellable = cancellable,
+        .status_cb = status_cb,
+        .exclude_hidden = db->exclude_hidden,
+    };
+    const uint32_t first_folder = darray_get_num_items(walk_context.folders);
+    const uint32_t first_file = darray_get_num_items(walk_context.files);
+
+    g_autofree DatabaseScanRoot *roots = g_new0(DatabaseScanRoot, num_indexes);
+    uint32_t num_roots = 0;
+    for (uint32_t i = 0; i < num_indexes; i++) {
+        const char *dname = indexes[i]->path;
+        g_assert(dname);
+        g_assert(dname[0] == G_DIR_SEPARATOR);
+        g_debug("[db_scan] scan path: %s", dname);
+
+        if (!g_file_test(dname, G_FILE_TEST_IS_DIR)) {
+            g_warning("[db_scan] %s doesn't exist", dname);
+            continue;
+        }
+
+        // remove leading path separator '/' for root directory
+        const char *name = strcmp(dname, G_DIR_SEPARATOR_S) == 0 ? "" : dname;
+
+        struct stat root_st = {};
+        // the identity of the root stays unknown then
+        uint32_t root_identity = 0;
+        if (lstat(dname, &root_st)) {
+            g_debug("[db_scan] can't stat: %s", dname);
+        }
+        else {
+            root_identity = db_get_folder_identity(root_st.st_dev, root_st.st_ino, root_st.st_ctime);
+        }
+
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->folder_pool);
+        db_entry_set_pooled_name(db->name_pool, entry, name, strlen(name));
+        db_entry_set_parent(entry, NULL);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+        db_entry_init_stat_values(db, entry, NULL);
+        db_entry_folder_set_identity((FsearchDatabaseEntryFolder *)entry, root_identity);
+        darray_add_item(walk_context.folders, entry);
+
+        DatabaseScanRoot *root = &roots[num_roots++];
+        root->index = indexes[i];
+        root->name = name;
+        root->entry = (FsearchDatabaseEntryFolder *)entry;
+        root->device_id = root_st.st_dev;
+    }
+
+    const int64_t span = fsearch_trace_begin();
+    if (num_roots > 0 && db->num_scan_threads > 1 && !db->scan_throttle) {
+        db_folder_scan_parallel(&walk_context, roots, num_roots, db->num_scan_threads);
+    }
+    else {
+        for (uint32_t i = 0; i < num_roots; i++) {
+            DatabaseScanRoot *root = &roots[i];
+            g_autoptr(GString) path = g_string_new(root->name);
+            walk_context.path = path;
+            walk_context.root_device_id = root->device_id;
+            walk_context.one_filesystem = root->index->one_filesystem;
+            root->res = db_folder_scan_recursive(&walk_context, root->entry);
+            walk_context.path = NULL;
+            if (root->res == WALK_CANCEL) {
+                break;
+            }
+        }
+    }
+    fsearch_trace_end(span, "scan", "scan folder");
+    // the entries of the walk are new, so it's the whole tree below the roots
+    db_update_folder_sizes(db, walk_context.folders, first_folder, walk_context.files, first_file);
+
+    bool ret = false;
+    for (uint32_t i = 0; i < num_roots; i++) {
+        const int res = roots[i].res;
+        if (res == WALK_OK) {
+            ret = true;
+        }
+        else if (res == WALK_CANCEL) {
+            g_debug("[db_scan] scan cancelled: %s", roots[i].index->path);
+        }
+        else {
+            g_warning("[db_scan] walk error: %d (%s)", res, roots[i].index->path);
+        }
+    }
+    if (ret) {
+        g_debug("[db_scan] scanned: %d files, %d folders -> %d total",
+                db_get_num_files(db),
+                db_get_num_folders(db),
+                db_get_num_entries(db));
+    }
+    return ret;
+}
+
+static bool
+db_scan_folder(FsearchDatabase *db, FsearchIndex *index, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    return db_scan_folders(db, &index, 1, cancellable, status_cb);
+}
+
+static gint
+compare_index_path(FsearchIndex *p1, FsearchIndex *p2) {
+    return strcmp(p1->path, p2->path);
+}
+
+static gint
+compare_exclude_path(FsearchExcludePath *p1, FsearchExcludePath *p2) {
+    return strcmp(p1->path, p2->path);
+}
+
+FsearchDatabase *
+db_new(GList *indexes, GList *excludes, char **exclude_files, bool exclude_hidden) {
+    FsearchDatabase *db = g_new0(FsearchDatabase, 1);
+    g_assert(db);
+    g_mutex_init(&db->mutex);
+    g_mutex_init(&db->snapshot_mutex);
+    g_mutex_init(&db->operation_stats_mutex);
+    db->shared_results = fsearch_shared_results_new();
+    if (indexes) {
+        db->indexes = g_list_copy_deep(indexes, (GCopyFunc)fsearch_index_copy, NULL);
+
+        db->indexes = g_list_sort(db->indexes, (GCompareFunc)compare_index_path);
+    }
+    if (excludes) {
+        db->excludes = g_list_copy_deep(excludes, (GCopyFunc)fsearch_exclude_path_copy, NULL);
+        db->excludes = g_list_sort(db->excludes, (GCompareFunc)compare_exclude_path);
+    }
+    if (exclude_files) {
+        db->exclude_files = g_strdupv(exclude_files);
+    }
+    db->exclude_matcher = fsearch_exclude_matcher_new(db->excludes, db->exclude_files);
+
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        db->sorted_files[i] = NULL;
+        db->sorted_folders[i] = NULL;
+    }
+    // entry names are owned by the name pool, so the entries themselves don't need to be destroyed
+    db->file_pool = fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK, db_entry_get_sizeof_file_entry(), NULL);
+    db->folder_pool = fsearch_memory_pool_new(NUM_DB_ENTRIES_FOR_POOL_BLOCK, db_entry_get_sizeof_folder_entry(), NULL);
+    db->name_pool = fsearch_string_pool_new(true);
+
+    db->thread_pool = fsearch_thread_pool_init();
+
+    db->exclude_hidden = exclude_hidden;
+    db->num_scan_threads = 1;
+    db->ref_count = 1;
+    // an empty version, so readers always get a snapshot
+    db_publish_snapshot(db);
+    return db;
+}
+
+void
+db_set_num_scan_threads(FsearchDatabase *db, uint32_t num_threads) {
+    g_assert(db);
+    if (num_threads == 0) {
+        num_threads = g_get_num_processors();
+    }
+    db->num_scan_threads = MIN(num_threads, FSEARCH_THREAD_LIMIT);
+}
+
+void
+db_set_scan_throttle(FsearchDatabase *db, FsearchScanThrottle *throttle) {
+    g_assert(db);
+    g_clear_pointer(&db->scan_throttle, fsearch_scan_throttle_unref);
+    db->scan_throttle = fsearch_scan_throttle_ref(throttle);
+}
+
+void
+db_set_worker_threads(FsearchDatabase *db, uint32_t num_threads, const char *cpu_list, bool numa_aware) {
+    g_assert(db);
+    g_clear_pointer(&db->worker_cpu_list, g_free);
+    db->worker_cpu_list = g_strdup(cpu_list);
+    g_clear_pointer(&db->thread_pool, fsearch_thread_pool_free);
+    db->thread_pool = fsearch_thread_pool_new_with_affinity(num_threads, cpu_list, numa_aware);
+}
+
+void
+db_set_huge_pages(FsearchDatabase *db, bool huge_pages) {
+    g_assert(db);
+    db->huge_pages = huge_pages;
+    fsearch_memory_pool_set_huge_pages(db->file_pool, huge_pages);
+    fsearch_memory_pool_set_huge_pages(db->folder_pool, huge_pages);
+}
+
+static FsearchDatabaseIndexFlags
+db_get_optional_values(FsearchDatabase *db) {
+    return db->optional_times | (db->index_owners ? DATABASE_INDEX_FLAG_OWNER : 0)
+         | (db->xattr_names ? DATABASE_INDEX_FLAG_XATTRS : 0);
+}
+
+void
+db_set_optional_times(FsearchDatabase *db, FsearchDatabaseIndexFlags time_flags) {
+    g_assert(db);
+    db->optional_times = time_flags & DATABASE_INDEX_FLAGS_OPTIONAL_TIMES;
+    db_set_entry_optional_values(db, db_get_optional_values(db));
+}
+
+void
+db_set_index_owners(FsearchDatabase *db, bool index_owners) {
+    g_assert(db);
+    db->index_owners = index_owners;
+    db_set_entry_optional_values(db, db_get_optional_values(db));
+}
+
+void
+db_set_xattrs(FsearchDatabase *db, char **names, char **paths) {
+    g_assert(db);
+    g_clear_pointer(&db->xattr_names, g_strfreev);
+    g_clear_pointer(&db->xattr_paths, g_strfreev);
+    if (fsearch_xattr_is_supported() && names && names[0]) {
+        db->xattr_names = g_strdupv(names);
+        if (paths && paths[0]) {
+            db->xattr_paths = g_new0(char *, g_strv_length(paths) + 1);
+            for (uint32_t i = 0; paths[i]; i++) {
+                // without the trailing separators, so they can be matched against the start of other paths
+                size_t len = strlen(paths[i]);
+                while (len > 0 && paths[i][len - 1] == G_DIR_SEPARATOR) {
+                    len--;
+                }
+                db->xattr_paths[i] = g_strndup(paths[i], len);
+            }
+        }
+    }
+    db_set_entry_optional_values(db, db_get_optional_values(db));
+}
+
+void
+db_set_memory_budget(FsearchDatabase *db, size_t memory_budget) {
+    g_assert(db);
+    db->memory_budget = memory_budget;
+}
+
+void
+db_set_front_coded_names(FsearchDatabase *db, bool front_coded_names) {
+    g_assert(db);
+    db->front_coded_names = front_coded_names;
+}
+
+void
+db_set_compact_indexes(FsearchDatabase *db, bool compact_indexes) {
+    g_assert(db);
+    db->compact_indexes = compact_indexes;
+}
+
+void
+db_set_index_priority(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+    if (0 <= sort_type && sort_type < NUM_DATABASE_INDEX_TYPES) {
+        // views raise it while they sort, without locking the database
+        g_atomic_int_set(&db->index_priority, sort_type);
+    }
+}
+
+void
+db_set_trigram_indexes(FsearchDatabase *db, bool trigram_indexes) {
+    g_assert(db);
+    db->trigram_indexes = trigram_indexes;
+}
+
+void
+db_set_name_indexes(FsearchDatabase *db, bool name_indexes) {
+    g_assert(db);
+    db->name_indexes = name_indexes;
+}
+
+void
+db_set_folder_path_cache(FsearchDatabase *db, bool folder_path_cache) {
+    g_assert(db);
+    db->folder_path_cache = folder_path_cache;
+}
+
+void
+db_set_folded_name_cache(FsearchDatabase *db, bool folded_name_cache) {
+    g_assert(db);
+    db->folded_name_cache = folded_name_cache;
+}
+
+void
+db_set_subtree_filters(FsearchDatabase *db, bool subtree_filters) {
+    g_assert(db);
+    db->subtree_filters = subtree_filters;
+}
+
+void
+db_set_compression(FsearchDatabase *db, FsearchDatabaseCompression compression) {
+    g_assert(db);
+    db->compression = compression;
+}
+
+void
+db_set_read_only_file(FsearchDatabase *db, bool read_only_file) {
+    g_assert(db);
+    db->read_only_file = read_only_file;
+}
+
+static void
+db_free(FsearchDatabase *db) {
+    g_assert(db);
+
+    g_debug("[db_free] freeing...");
+    db_lock(db);
+    if (db->ref_count > 0) {
+        g_warning("[db_free] pending references on free: %d", db->ref_count);
+    }
+#ifdef HAVE_MALLOC_TRIM
+    // e.g. the previous database after a rescan, whose arrays and entries weren't carried over
+    const bool trim = db_get_own_memory_usage(db) >= DATABASE_MALLOC_TRIM_MIN_SIZE;
+#endif
+
+    db_sorted_entries_free(db);
+    g_clear_pointer(&db->snapshot, db_snapshot_unref);
+
+    g_clear_pointer(&db->file_pool, fsearch_memory_pool_unref);
+    g_clear_pointer(&db->folder_pool, fsearch_memory_pool_unref);
+    g_clear_pointer(&db->name_pool, fsearch_string_pool_unref);
+    if (db->shared_pools) {
+        g_list_free_full(g_steal_pointer(&db->shared_pools), (GDestroyNotify)fsearch_memory_pool_unref);
+    }
+    if (db->shared_name_pools) {
+        g_list_free_full(g_steal_pointer(&db->shared_name_pools), (GDestroyNotify)fsearch_string_pool_unref);
+    }
+    g_clear_pointer(&db->name_blocks, fsearch_name_blocks_unref);
+    if (db->shared_name_blocks) {
+        g_list_free_full(g_steal_pointer(&db->shared_name_blocks), (GDestroyNotify)fsearch_name_blocks_unref);
+    }
+
+    if (db->indexes) {
+        g_list_free_full(g_steal_pointer(&db->indexes), (GDestroyNotify)fsearch_index_free);
+    }
+    if (db->excludes) {
+        g_list_free_full(g_steal_pointer(&db->excludes), (GDestroyNotify)fsearch_exclude_path_free);
+    }
+
+    g_clear_pointer(&db->exclude_files, g_strfreev);
+    g_clear_pointer(&db->exclude_matcher, fsearch_exclude_matcher_free);
+    g_clear_pointer(&db->scan_throttle, fsearch_scan_throttle_unref);
+    g_clear_pointer(&db->xattr_names, g_strfreev);
+    g_clear_pointer(&db->xattr_paths, g_strfreev);
+    g_clear_pointer(&db->thread_pool, fsearch_thread_pool_free);
+    g_clear_pointer(&db->worker_cpu_list, g_free);
+    g_clear_pointer(&db->journal, db_journal_close);
+    g_clear_pointer(&db->save_dir, g_free);
+    g_clear_pointer(&db->pending_save_path, g_free);
+    g_clear_pointer(&db->shared_results, fsearch_shared_results_unref);
+
+    db_unlock(db);
+
+    g_mutex_clear(&db->mutex);
+    g_mutex_clear(&db->snapshot_mutex);
+    g_mutex_clear(&db->operation_stats_mutex);
+
+    g_clear_pointer(&db, free);
+
+#ifdef HAVE_MALLOC_TRIM
+    if (trim) {
+        malloc_trim(0);
+    }
+#endif
+
+    g_debug("[db_free] freed");
+}
+
+time_t
+db_get_timestamp(FsearchDatabase *db) {
+    g_assert(db);
+    return db->timestamp;
+}
+
+uint32_t
+db_get_num_files(FsearchDatabase *db) {
+    g_assert(db);
+    return db->sorted_files[DATABASE_INDEX_TYPE_NAME] ? darray_get_num_items(db->sorted_files[DATABASE_INDEX_TYPE_NAME])
+                                                      : 0;
+}
+
+uint32_t
+db_get_num_folders(FsearchDatabase *db) {
+    g_assert(db);
+    return db->sorted_folders[DATABASE_INDEX_TYPE_NAME]
+             ? darray_get_num_items(db->sorted_folders[DATABASE_INDEX_TYPE_NAME])
+             : 0;
+}
+
+uint32_t
+db_get_num_entries(FsearchDatabase *db) {
+    g_assert(db);
+    return db_get_num_files(db) + db_get_num_folders(db);
+}
+
+void
+db_unlock(FsearchDatabase *db) {
+    g_assert(db);
+    g_mutex_unlock(&db->mutex);
+}
+
+void
+db_lock(FsearchDatabase *db) {
+    g_assert(db);
+    fsearch_trace_lock(&db->mutex, "db_lock wait");
+}
+
+bool
+db_try_lock(FsearchDatabase *db) {
+    g_assert(db);
+    return g_mutex_trylock(&db->mutex);
+}
+
+static bool
+is_valid_sort_type(FsearchDatabaseIndexType sort_type) {
+    if (0 <= sort_type && sort_type < NUM_DATABASE_INDEX_TYPES) {
+        return true;
+    }
+    return false;
+}
+
+bool
+db_has_entries_sorted_by_type(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+
+    if (is_valid_sort_type(sort_type)) {
+        db_load_pending_sorted_arrays(db, sort_type);
+        return db->sorted_folders[sort_type] ? true : false;
+    }
+    return false;
+}
+
+DynamicArray *
+db_get_folders_sorted_copy(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+    db_load_pending_sorted_arrays(db, sort_type);
+    DynamicArray *folders = db->sorted_folders[sort_type];
+    return folders ? darray_copy(folders) : NULL;
+}
+
+DynamicArray *
+db_get_files_sorted_copy(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+    db_load_pending_sorted_arrays(db, sort_type);
+    DynamicArray *files = db->sorted_files[sort_type];
+    return files ? darray_copy(files) : NULL;
+}
+
+// Sorts entries, a copy of the name or (for sort_type name) path sorted array, into sort_type like db_sort does
+static void
+db_sort_entries_copy(FsearchDatabase *db,
+                     DynamicArray **entries,
+                     FsearchDatabaseIndexType sort_type,
+                     bool is_folder,
+                     GCancellable *cancellable) {
+    switch (sort_type) {
+    case DATABASE_INDEX_TYPE_NAME:
+        darray_sort_by_key_and_compare(*entries,
+                                       (DynamicArrayKeyFunc)db_entry_get_name_sort_key,
+                                       (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_name,
+                                       db->thread_pool,
+                                       cancellable,
+                                       NULL);
+        return;
+    case DATABASE_INDEX_TYPE_PATH:
+        darray_sort_multi_threaded(*entries,
+                                   (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path,
+                                   db->thread_pool,
+                                   cancellable,
+                                   NULL);
+        return;
+    case DATABASE_INDEX_TYPE_EXTENSION:
+        if (!is_folder) {
+            darray_sort_multi_threaded(*entries,
+                                       (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_extension,
+                                       db->thread_pool,
+                                       cancellable,
+                                       NULL);
+        }
+        return;
+    case DATABASE_INDEX_TYPE_FILETYPE:
+        if (!is_folder) {
+            DynamicArray *sorted = db_sort_files_by_file_type(*entries, cancellable);
+            g_clear_pointer(entries, darray_unref);
+            *entries = sorted;
+        }
+        return;
+    default:
+        break;
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_key_sorted_types); i++) {
+        if (db_key_sorted_types[i].type == sort_type) {
+            darray_sort_by_key(*entries, db_key_sorted_types[i].key_func, db->thread_pool, cancellable, NULL);
+            return;
+        }
+    }
+}
+
+double
+db_time_sort(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+
+    db_lock(db);
+    if (!is_valid_sort_type(sort_type) || !db_has_entries_sorted_by_type(db, sort_type)) {
+        db_unlock(db);
+        return -1;
+    }
+    // db_sort builds the name order from the path order and all other ones from the name order
+    const FsearchDatabaseIndexType base_type =
+        sort_type == DATABASE_INDEX_TYPE_NAME ? DATABASE_INDEX_TYPE_PATH : DATABASE_INDEX_TYPE_NAME;
+    DynamicArray *folders = db_get_folders_sorted_copy(db, base_type);
+    DynamicArray *files = db_get_files_sorted_copy(db, base_type);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    if (folders) {
+        db_sort_entries_copy(db, &folders, sort_type, true, NULL);
+    }
+    if (files) {
+        db_sort_entries_copy(db, &files, sort_type, false, NULL);
+    }
+    const double ms = g_timer_elapsed(timer, NULL) * 1000;
+    db_unlock(db);
+
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
+    return ms;
+}
+
+// Background tasks build the sorted arrays db_sort leaves out, one task per database at a time
+static GMutex index_queue_mutex;
+static FsearchTaskQueue *index_queue = NULL;
+
+static bool
+db_index_is_built_in_background(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    if (sort_type == DATABASE_INDEX_TYPE_EXTENSION || sort_type == DATABASE_INDEX_TYPE_FILETYPE) {
+        return true;
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_key_sorted_types); i++) {
+        if (db_key_sorted_types[i].type == sort_type) {
+            return (db->index_flags & db_key_sorted_types[i].flag) != 0;
+        }
+    }
+    return false;
+}
+
+// The database must be locked
+static bool
+db_index_is_missing(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    if (!db_index_is_built_in_background(db, sort_type) || !db->sorted_files[DATABASE_INDEX_TYPE_NAME]
+        || !db->sorted_folders[DATABASE_INDEX_TYPE_NAME]) {
+        return false;
+    }
+    if (db->pending_sorted_arrays && db->pending_sorted_arrays->offsets[sort_type] != 0) {
+        return false;
+    }
+    return !db->sorted_files[sort_type] && !db->sorted_folders[sort_type] && !db->file_blocks[sort_type]
+        && !db->folder_blocks[sort_type];
+}
+
+// The missing index which gets built next, the one of db_set_index_priority first and then the others in the order
+// of FsearchDatabaseIndexType. Types in skipped (a bit per type) are left out. The database must be locked.
+static int32_t
+db_get_next_missing_index(FsearchDatabase *db, uint32_t skipped) {
+    const int32_t priority = g_atomic_int_get(&db->index_priority);
+    if ((skipped & (1u << priority)) == 0 && db_index_is_missing(db, priority)) {
+        return priority;
+    }
+    for (int32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if ((skipped & (1u << i)) == 0 && db_index_is_missing(db, i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Sorts copies of the name sorted entries into sort_type, like db_scan did before the database got published
+static void
+db_build_index(FsearchDatabase *db,
+               DynamicArray *folders,
+               DynamicArray *files,
+               FsearchDatabaseIndexType sort_type,
+               GCancellable *cancellable,
+               DynamicArray **sorted_folders,
+               DynamicArray **sorted_files) {
+    *sorted_files = darray_copy(files);
+    db_sort_entries_copy(db, sorted_files, sort_type, false, cancellable);
+    if (sort_type == DATABASE_INDEX_TYPE_EXTENSION || sort_type == DATABASE_INDEX_TYPE_FILETYPE) {
+        // Folders don't have a file extension or type -> use the name array instead
+        *sorted_folders = darray_ref(folders);
+    }
+    else {
+        *sorted_folders = darray_copy(folders);
+        db_sort_entries_copy(db, sorted_folders, sort_type, true, cancellable);
+    }
+}
+
+// Adds the sorted arrays of sort_type to the database, unless they don't fit into its memory budget. The current
+// snapshot picks them up once they're requested. The database must be locked.
+static bool
+db_add_index(FsearchDatabase *db, FsearchDatabaseIndexType sort_type, DynamicArray *folders, DynamicArray *files) {
+    DynamicArray *folders_by_name = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    DynamicArray *files_by_name = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    if (db->memory_budget > 0) {
+        size_t usage = db_get_own_memory_usage(db) + darray_get_memory_usage(files);
+        if (folders != folders_by_name) {
+            usage += darray_get_memory_usage(folders);
+        }
+        if (usage > db->memory_budget) {
+            g_debug("[db_index] sorted arrays of type %d don't fit into the memory budget", sort_type);
+            return false;
+        }
+    }
+    if (db->compact_indexes) {
+        // the idx of an entry is its position in the name array
+        db_entry_update_folder_indices(db);
+        db_entry_update_file_indices(db);
+        darray_compact(files, files_by_name, (DynamicArrayIndexFunc)db_entry_get_name_array_idx, NULL);
+        if (folders != folders_by_name) {
+            darray_compact(folders, folders_by_name, (DynamicArrayIndexFunc)db_entry_get_name_array_idx, NULL);
+        }
+    }
+    db->sorted_folders[sort_type] = darray_ref(folders);
+    db->sorted_files[sort_type] = darray_ref(files);
+    return true;
+}
+
+// Builds everything db_build_indexes_in_background didn't get to yet on the calling thread. The database must be
+// locked.
+static void
+db_build_missing_indexes(FsearchDatabase *db) {
+    uint32_t skipped = 0;
+    int32_t sort_type = -1;
+    while ((sort_type = db_get_next_missing_index(db, skipped)) >= 0) {
+        skipped |= 1u << sort_type;
+        DynamicArray *folders = NULL;
+        DynamicArray *files = NULL;
+        db_build_index(db,
+                       db->sorted_folders[DATABASE_INDEX_TYPE_NAME],
+                       db->sorted_files[DATABASE_INDEX_TYPE_NAME],
+                       sort_type,
+                       NULL,
+                       &folders,
+                       &files);
+        db_add_index(db, sort_type, folders, files);
+        g_clear_pointer(&folders, darray_unref);
+        g_clear_pointer(&files, darray_unref);
+    }
+}
+
+// The database must be locked
+static void
+db_finish_background_indexes(FsearchDatabase *db) {
+    db->background_indexes_pending = false;
+    if (db->pending_save_path) {
+        g_autofree char *path = g_steal_pointer(&db->pending_save_path);
+        db_save_in_background(db, path);
+    }
+}
+
+static gpointer
+db_build_indexes_task(gpointer data, GCancellable *cancellable) {
+    FsearchDatabase *db = data;
+    // the types which didn't fit into the memory budget
+    uint32_t skipped = 0;
+
+    // nothing is left to build once this task holds the only reference, e.g. after a rescan replaced the database
+    while (!is_cancelled(cancellable) && g_atomic_int_get(&db->ref_count) > 1) {
+        db_lock(db);
+        const int32_t sort_type = db_get_next_missing_index(db, skipped);
+        FsearchDatabaseSnapshot *snapshot = sort_type >= 0 ? db_get_snapshot(db) : NULL;
+        db_unlock(db);
+        if (!snapshot) {
+            break;
+        }
+
+        // the arrays of the snapshot don't change, so the database doesn't need to be locked while they're sorted
+        g_autoptr(GTimer) timer = g_timer_new();
+        DynamicArray *folders_by_name = db_snapshot_get_folders(snapshot);
+        DynamicArray *files_by_name = db_snapshot_get_files(snapshot);
+        DynamicArray *folders = NULL;
+        DynamicArray *files = NULL;
+        db_build_index(db, folders_by_name, files_by_name, sort_type, cancellable, &folders, &files);
+        g_clear_pointer(&folders_by_name, darray_unref);
+        g_clear_pointer(&files_by_name, darray_unref);
+
+        GList *views = NULL;
+        db_lock(db);
+        // the arrays only belong to the version they were sorted for, a newer one gets them sorted again
+        if (!is_cancelled(cancellable) && folders && files && db->snapshot == snapshot
+            && db_index_is_missing(db, sort_type)) {
+            if (db_add_index(db, sort_type, folders, files)) {
+                views = g_list_copy_deep(db->db_views, (GCopyFunc)db_view_ref, NULL);
+                g_debug("[db_index] built sorted arrays of type %d in %f s", sort_type, g_timer_elapsed(timer, NULL));
+            }
+            else {
+                skipped |= 1u << sort_type;
+            }
+        }
+        db_unlock(db);
+        g_clear_pointer(&folders, darray_unref);
+        g_clear_pointer(&files, darray_unref);
+        g_clear_pointer(&snapshot, db_snapshot_unref);
+
+        // views lock the database while they hold their own lock, so they're notified without the database lock
+        for (GList *v = views; v != NULL; v = v->next) {
+            db_view_index_ready(v->data, sort_type);
+        }
+        g_list_free_full(g_steal_pointer(&views), (GDestroyNotify)db_view_unref);
+    }
+
+    db_lock(db);
+    db_finish_background_indexes(db);
+    db_unlock(db);
+    return NULL;
+}
+
+static void
+db_build_indexes_task_cancelled(gpointer data) {
+    FsearchDatabase *db = data;
+    db_lock(db);
+    db_finish_background_indexes(db);
+    db_unlock(db);
+    g_clear_pointer(&db, db_unref);
+}
+
+static void
+db_build_indexes_task_finished(gpointer result, gpointer data) {
+    FsearchDatabase *db = data;
+    g_clear_pointer(&db, db_unref);
+}
+
+// Queues a task which builds the sorted arrays db_sort left out, so the database can be used in the meantime.
+// The database must not be locked.
+static void
+db_build_indexes_in_background(FsearchDatabase *db) {
+    db_lock(db);
+    const bool build = !db->background_indexes_pending && db_get_next_missing_index(db, 0) >= 0;
+    db->background_indexes_pending = db->background_indexes_pending || build;
+    db_unlock(db);
+    if (!build) {
+        return;
+    }
+
+    g_mutex_lock(&index_queue_mutex);
+    if (!index_queue) {
+        index_queue = fsearch_task_queue_new("fsearch_index_queue");
+    }
+    fsearch_task_queue(index_queue,
+                       FSEARCH_TASK_ID_INDEX,
+                       db_build_indexes_task,
+                       db_build_indexes_task_finished,
+                       db_build_indexes_task_cancelled,
+                       FSEARCH_TASK_CLEAR_NONE,
+                       FSEARCH_TASK_PRIORITY_INDEX,
+                       db_ref(db));
+    g_mutex_unlock(&index_queue_mutex);
+}
+
+static void
+db_wait_for_background_indexes(void) {
+    g_mutex_lock(&index_queue_mutex);
+    if (index_queue) {
+        g_debug("[db_index] waiting for background indexes...");
+        fsearch_task_queue_wait(index_queue);
+        g_clear_pointer(&index_queue, fsearch_task_queue_free);
+    }
+    g_mutex_unlock(&index_queue_mutex);
+}
+
+DynamicArray *
+db_get_folders_copy(FsearchDatabase *db) {
+    return db_get_folders_sorted_copy(db, DATABASE_INDEX_TYPE_NAME);
+}
+
+DynamicArray *
+db_get_files_copy(FsearchDatabase *db) {
+    return db_get_files_sorted_copy(db, DATABASE_INDEX_TYPE_NAME);
+}
+
+bool
+db_get_entries_sorted(FsearchDatabase *db,
+                      FsearchDatabaseIndexType requested_sort_type,
+                      FsearchDatabaseIndexType *returned_sort_type,
+                      DynamicArray **folders,
+                      DynamicArray **files) {
+    g_assert(db);
+    g_assert(returned_sort_type);
+    g_assert(folders);
+    g_assert(files);
+    if (!is_valid_sort_type(requested_sort_type)) {
+        return false;
+    }
+
+    FsearchDatabaseIndexType sort_type = requested_sort_type;
+    if (!db_has_entries_sorted_by_type(db, requested_sort_type)) {
+        sort_type = DATABASE_INDEX_TYPE_NAME;
+    }
+
+    if (!db_has_entries_sorted_by_type(db, sort_type)) {
+        return false;
+    }
+
+    *folders = darray_ref(db->sorted_folders[sort_type]);
+    *files = darray_ref(db->sorted_files[sort_type]);
+    *returned_sort_type = sort_type;
+    return true;
+}
+
+DynamicArray *
+db_get_folders_sorted(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+
+    db_load_pending_sorted_arrays(db, sort_type);
+    DynamicArray *folders = db->sorted_folders[sort_type];
+    return darray_ref(folders);
+}
+
+DynamicArray *
+db_get_files_sorted(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    g_assert(db);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+
+    db_load_pending_sorted_arrays(db, sort_type);
+    DynamicArray *files = db->sorted_files[sort_type];
+    return darray_ref(files);
+}
+
+DynamicArray *
+db_get_files(FsearchDatabase *db) {
+    g_assert(db);
+    return db_get_files_sorted(db, DATABASE_INDEX_TYPE_NAME);
+}
+
+DynamicArray *
+db_get_folders(FsearchDatabase *db) {
+    g_assert(db);
+    return db_get_folders_sorted(db, DATABASE_INDEX_TYPE_NAME);
+}
+
+FsearchThreadPool *
+db_get_thread_pool(FsearchDatabase *db) {
+    g_assert(db);
+    return db->thread_pool;
+}
+
+FsearchSharedResults *
+db_get_shared_results(FsearchDatabase *db) {
+    g_assert(db);
+    return db->shared_results;
+}
+
+void
+db_get_operation_stats(FsearchDatabase *db, FsearchOperation operation, FsearchOperationStats *stats) {
+    g_assert(db);
+    g_assert(stats);
+    g_mutex_lock(&db->operation_stats_mutex);
+    *stats = db->operation_stats[operation];
+    g_mutex_unlock(&db->operation_stats_mutex);
+}
+
+FsearchTrigramIndex *
+db_get_folder_trigram_index(FsearchDatabase *db) {
+    g_assert(db);
+    return db->folder_trigram_index;
+}
+
+FsearchTrigramIndex *
+db_get_file_trigram_index(FsearchDatabase *db) {
+    g_assert(db);
+    return db->file_trigram_index;
+}
+
+FsearchFolderPaths *
+db_get_folder_paths(FsearchDatabase *db) {
+    g_assert(db);
+    return db->folder_paths;
+}
+
+void
+db_get_memory_usage(FsearchDatabase *db, FsearchDatabaseMemoryUsage *usage) {
+    g_assert(db);
+    g_assert(usage);
+
+    memset(usage, 0, sizeof(FsearchDatabaseMemoryUsage));
+    GHashTable *counted_arrays = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    db_lock(db);
+    db_get_memory_usage_locked(db, usage, counted_arrays);
+    GList *views = g_list_copy_deep(db->db_views, (GCopyFunc)db_view_ref, NULL);
+    // keeps the counted arrays alive, so views can't have new arrays at their addresses
+    FsearchDatabaseSnapshot *snapshot = db_get_snapshot(db);
+    db_unlock(db);
+
+    // views lock the database while they hold their own lock, so they're asked without the database lock
+    for (GList *v = views; v != NULL; v = v->next) {
+        db_view_get_memory_usage(v->data, usage, counted_arrays);
+    }
+    g_list_free_full(g_steal_pointer(&views), (GDestroyNotify)db_view_unref);
+    g_clear_pointer(&snapshot, db_snapshot_unref);
+    g_clear_pointer(&counted_arrays, g_hash_table_unref);
+}
+
+size_t
+db_memory_usage_get_total(const FsearchDatabaseMemoryUsage *usage) {
+    g_assert(usage);
+    size_t total = usage->entries + usage->names + usage->trigram_indexes + usage->name_indexes + usage->folder_paths
+                 + usage->folded_names + usage->subtree_filters + usage->entry_columns + usage->view_results
+                 + usage->view_selections + usage->view_result_caches;
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        total += usage->sorted_arrays[i];
+    }
+    return total;
+}
+
+static void
+db_memory_usage_append(GString *report, const char *name, size_t size) {
+    g_autofree char *size_str = g_format_size_full(size, G_FORMAT_SIZE_IEC_UNITS);
+    g_string_append_printf(report, "%s: %s\n", name, size_str);
+}
+
+char *
+db_memory_usage_to_string(const FsearchDatabaseMemoryUsage *usage) {
+    g_assert(usage);
+    const char *index_type_names[NUM_DATABASE_INDEX_TYPES] = {
+        [DATABASE_INDEX_TYPE_NAME] = DATABASE_INDEX_TYPE_NAME_STRING,
+        [DATABASE_INDEX_TYPE_PATH] = DATABASE_INDEX_TYPE_PATH_STRING,
+        [DATABASE_INDEX_TYPE_SIZE] = DATABASE_INDEX_TYPE_SIZE_STRING,
+        [DATABASE_INDEX_TYPE_MODIFICATION_TIME] = DATABASE_INDEX_TYPE_MODIFICATION_TIME_STRING,
+        [DATABASE_INDEX_TYPE_ACCESS_TIME] = "Date Accessed",
+        [DATABASE_INDEX_TYPE_CREATION_TIME] = "Date Created",
+        [DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME] = "Date Changed",
+        [DATABASE_INDEX_TYPE_FILETYPE] = DATABASE_INDEX_TYPE_FILETYPE_STRING,
+        [DATABASE_INDEX_TYPE_EXTENSION] = DATABASE_INDEX_TYPE_EXTENSION_STRING,
+        [DATABASE_INDEX_TYPE_OWNER] = DATABASE_INDEX_TYPE_OWNER_STRING,
+        [DATABASE_INDEX_TYPE_RELEVANCE] = DATABASE_INDEX_TYPE_RELEVANCE_STRING,
+    };
+
+    GString *report = g_string_new(NULL);
+    db_memory_usage_append(report, "Entries", usage->entries);
+    db_memory_usage_append(report, "Names", usage->names);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (usage->sorted_arrays[i] > 0) {
+            g_autofree char *name = g_strdup_printf("Sorted by %s", index_type_names[i]);
+            db_memory_usage_append(report, name, usage->sorted_arrays[i]);
+        }
+    }
+    db_memory_usage_append(report, "Trigram indexes", usage->trigram_indexes);
+    db_memory_usage_append(report, "Name indexes", usage->name_indexes);
+    db_memory_usage_append(report, "Folder paths", usage->folder_paths);
+    db_memory_usage_append(report, "Folded names", usage->folded_names);
+    db_memory_usage_append(report, "Subtree filters", usage->subtree_filters);
+    db_memory_usage_append(report, "Entry columns", usage->entry_columns);
+    db_memory_usage_append(report, "Results", usage->view_results);
+    db_memory_usage_append(report, "Selections", usage->view_selections);
+    db_memory_usage_append(report, "Result caches", usage->view_result_caches);
+    db_memory_usage_append(report, "Total", db_memory_usage_get_total(usage));
+    return g_string_free(report, FALSE);
+}
+
+FsearchFoldedNames *
+db_get_folded_names(FsearchDatabase *db) {
+    g_assert(db);
+    return db->folded_names;
+}
+
+FsearchDatabaseSnapshot *
+db_get_snapshot(FsearchDatabase *db) {
+    g_assert(db);
+    g_mutex_lock(&db->snapshot_mutex);
+    FsearchDatabaseSnapshot *snapshot = db_snapshot_ref(db->snapshot);
+    g_mutex_unlock(&db->snapshot_mutex);
+    return snapshot;
+}
+
+// Adds the sorted arrays of sort_type, if they're only missing because they weren't requested from the database
+// yet when the snapshot was published
+static void
+db_snapshot_load_sorted_arrays(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type) {
+    if (g_atomic_pointer_get(&snapshot->sorted_folders[sort_type])
+        && g_atomic_pointer_get(&snapshot->sorted_files[sort_type])) {
+        return;
+    }
+    FsearchDatabase *db = snapshot->db;
+    db_lock(db);
+    // the arrays of the database only belong to this version as long as no newer one was published
+    if (db->snapshot == snapshot) {
+        db_load_pending_sorted_arrays(db, sort_type);
+        if (!snapshot->sorted_folders[sort_type] && db->sorted_folders[sort_type]) {
+            g_atomic_pointer_set(&snapshot->sorted_folders[sort_type], darray_ref(db->sorted_folders[sort_type]));
+        }
+        if (!snapshot->sorted_files[sort_type] && db->sorted_files[sort_type]) {
+            g_atomic_pointer_set(&snapshot->sorted_files[sort_type], darray_ref(db->sorted_files[sort_type]));
+        }
+    }
+    db_unlock(db);
+}
+
+bool
+db_snapshot_has_entries_sorted_by_type(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type) {
+    g_assert(snapshot);
+
+    if (is_valid_sort_type(sort_type)) {
+        db_snapshot_load_sorted_arrays(snapshot, sort_type);
+        return g_atomic_pointer_get(&snapshot->sorted_folders[sort_type]) ? true : false;
+    }
+    return false;
+}
+
+bool
+db_snapshot_get_entries_sorted(FsearchDatabaseSnapshot *snapshot,
+                               FsearchDatabaseIndexType requested_sort_type,
+                               FsearchDatabaseIndexType *returned_sort_type,
+                               DynamicArray **folders,
+                               DynamicArray **files) {
+    g_assert(snapshot);
+    g_assert(returned_sort_type);
+    g_assert(folders);
+    g_assert(files);
+    if (!is_valid_sort_type(requested_sort_type)) {
+        return false;
+    }
+
+    FsearchDatabaseIndexType sort_type = requested_sort_type;
+    if (!db_snapshot_has_entries_sorted_by_type(snapshot, requested_sort_type)) {
+        sort_type = DATABASE_INDEX_TYPE_NAME;
+    }
+
+    if (!db_snapshot_has_entries_sorted_by_type(snapshot, sort_type)) {
+        return false;
+    }
+
+    *folders = darray_ref(g_atomic_pointer_get(&snapshot->sorted_folders[sort_type]));
+    *files = darray_ref(g_atomic_pointer_get(&snapshot->sorted_files[sort_type]));
+    *returned_sort_type = sort_type;
+    return true;
+}
+
+DynamicArray *
+db_snapshot_get_folders_sorted(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type) {
+    g_assert(snapshot);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+
+    db_snapshot_load_sorted_arrays(snapshot, sort_type);
+    return darray_ref(g_atomic_pointer_get(&snapshot->sorted_folders[sort_type]));
+}
+
+DynamicArray *
+db_snapshot_get_files_sorted(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type) {
+    g_assert(snapshot);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+
+    db_snapshot_load_sorted_arrays(snapshot, sort_type);
+    return darray_ref(g_atomic_pointer_get(&snapshot->sorted_files[sort_type]));
+}
+
+#define DB_SNAPSHOT_RANKS_GRAIN_SIZE (1 << 16)
+
+typedef struct {
+    DynamicArray *sorted;
+    DynamicArray *by_name;
+    uint32_t *ranks;
+} DatabaseSnapshotRanksContext;
+
+static void
+db_snapshot_build_ranks_range(uint32_t start, uint32_t end, void *data) {
+    DatabaseSnapshotRanksContext *ctx = data;
+    const uint32_t num_entries = darray_get_num_items(ctx->by_name);
+    for (uint32_t i = start; i < end; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(ctx->sorted, i);
+        const uint32_t idx = db_entry_get_idx(entry);
+        // every entry has a different idx, so the ranges can be written concurrently
+        if (idx < num_entries && darray_get_item(ctx->by_name, idx) == entry) {
+            ctx->ranks[idx] = i;
+        }
+    }
+}
+
+static const uint32_t *
+db_snapshot_get_ranks(uint32_t **ranks_slot, DynamicArray *sorted, DynamicArray *by_name, FsearchThreadPool *pool) {
+    uint32_t *ranks = g_atomic_pointer_get(ranks_slot);
+    if (ranks || !sorted || !by_name) {
+        return ranks;
+    }
+    g_autoptr(GTimer) timer = g_timer_new();
+    const uint32_t num_entries = darray_get_num_items(by_name);
+    ranks = malloc(MAX(num_entries, 1) * sizeof(uint32_t));
+    g_assert(ranks);
+    memset(ranks, 0xff, num_entries * sizeof(uint32_t));
+    DatabaseSnapshotRanksContext ctx = {.sorted = sorted, .by_name = by_name, .ranks = ranks};
+    fsearch_thread_pool_parallel_for(pool,
+                                     0,
+                                     darray_get_num_items(sorted),
+                                     DB_SNAPSHOT_RANKS_GRAIN_SIZE,
+                                     db_snapshot_build_ranks_range,
+                                     &ctx);
+    if (!g_atomic_pointer_compare_and_exchange(ranks_slot, NULL, ranks)) {
+        // another thread was faster
+        g_clear_pointer(&ranks, free);
+        return g_atomic_pointer_get(ranks_slot);
+    }
+    g_debug("[db_snapshot] built %d ranks in %f s", num_entries, g_timer_elapsed(timer, NULL));
+    return ranks;
+}
+
+const uint32_t *
+db_snapshot_get_folder_ranks(FsearchDatabaseSnapshot *snapshot,
+                             FsearchDatabaseIndexType sort_type,
+                             FsearchThreadPool *pool) {
+    g_assert(snapshot);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+    db_snapshot_load_sorted_arrays(snapshot, sort_type);
+    return db_snapshot_get_ranks(&snapshot->folder_ranks[sort_type],
+                                 g_atomic_pointer_get(&snapshot->sorted_folders[sort_type]),
+                                 g_atomic_pointer_get(&snapshot->sorted_folders[DATABASE_INDEX_TYPE_NAME]),
+                                 pool);
+}
+
+const uint32_t *
+db_snapshot_get_file_ranks(FsearchDatabaseSnapshot *snapshot,
+                           FsearchDatabaseIndexType sort_type,
+                           FsearchThreadPool *pool) {
+    g_assert(snapshot);
+    if (!is_valid_sort_type(sort_type)) {
+        return NULL;
+    }
+    db_snapshot_load_sorted_arrays(snapshot, sort_type);
+    return db_snapshot_get_ranks(&snapshot->file_ranks[sort_type],
+                                 g_atomic_pointer_get(&snapshot->sorted_files[sort_type]),
+                                 g_atomic_pointer_get(&snapshot->sorted_files[DATABASE_INDEX_TYPE_NAME]),
+                                 pool);
+}
+
+DynamicArray *
+db_snapshot_get_folders(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return darray_ref(g_atomic_pointer_get(&snapshot->sorted_folders[DATABASE_INDEX_TYPE_NAME]));
+}
+
+DynamicArray *
+db_snapshot_get_files(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return darray_ref(g_atomic_pointer_get(&snapshot->sorted_files[DATABASE_INDEX_TYPE_NAME]));
+}
+
+FsearchTrigramIndex *
+db_snapshot_get_folder_trigram_index(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->folder_trigram_index;
+}
+
+FsearchTrigramIndex *
+db_snapshot_get_file_trigram_index(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->file_trigram_index;
+}
+
+FsearchNameIndex *
+db_snapshot_get_folder_name_index(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->folder_name_index;
+}
+
+FsearchNameIndex *
+db_snapshot_get_file_name_index(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->file_name_index;
+}
+
+FsearchFolderPaths *
+db_snapshot_get_folder_paths(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->folder_paths;
+}
+
+FsearchFoldedNames *
+db_snapshot_get_folded_names(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->folded_names;
+}
+
+FsearchSubtreeFilter *
+db_snapshot_get_subtree_filter(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->subtree_filter;
+}
+
+uint64_t
+db_snapshot_get_version(FsearchDatabaseSnapshot *snapshot) {
+    g_assert(snapshot);
+    return snapshot->version;
+}
+
+static bool
+db_scan_indexes(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    g_assert(db);
+
+    bool ret = false;
+
+    db_sorted_entries_free(db);
+
+    db->index_flags |= DATABASE_INDEX_FLAG_NAME;
+    db->index_flags |= DATABASE_INDEX_FLAG_SIZE;
+    db->index_flags |= DATABASE_INDEX_FLAG_MODIFICATION_TIME;
+    db->index_flags |= db->entry_optional_values;
+
+    db->sorted_files[DATABASE_INDEX_TYPE_NAME] = darray_new(1024);
+    db->sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(1024);
+
+    g_autoptr(GPtrArray) indexes = g_ptr_array_new();
+    for (GList *l = db->indexes; l != NULL; l = l->next) {
+        FsearchIndex *fs_path = l->data;
+        if (!fs_path->path) {
+            continue;
+        }
+        if (!fs_path->enabled) {
+            continue;
+        }
+        if (fs_path->update) {
+            g_ptr_array_add(indexes, fs_path);
+        }
+    }
+    ret = db_scan_folders(db, (FsearchIndex **)indexes->pdata, indexes->len, cancellable, status_cb);
+    if (is_cancelled(cancellable)) {
+        return false;
+    }
+    // all names are known now, the intern table would only waste memory from here on
+    fsearch_string_pool_stop_interning(db->name_pool);
+
+    if (status_cb) {
+        status_cb(_("Sorting…"));
+    }
+    db_sort(db, cancellable);
+    if (is_cancelled(cancellable)) {
+        return false;
+    }
+    db_entry_update_folder_indices(db);
+    db_entry_update_file_indices(db);
+    db_front_code_names(db);
+    db_build_trigram_indexes(db);
+    db_build_name_indexes(db);
+    db_build_folder_paths(db);
+    db_build_folded_names(db);
+    db_build_subtree_filter(db);
+    db_publish_snapshot(db);
+    db_build_indexes_in_background(db);
+    return ret;
+}
+
+static bool
+db_scan_run(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    FsearchOperationTimer timer = {};
+    fsearch_operation_timer_start(&timer, db->thread_pool);
+    const bool res = db_scan_indexes(db, cancellable, status_cb);
+    if (res && !is_cancelled(cancellable)) {
+        const uint32_t num_entries = db_get_num_entries(db);
+        db_finish_operation(db, FSEARCH_OPERATION_SCAN, &timer, num_entries, num_entries);
+    }
+    return res;
+}
+
+// folders which get stat'ed by one task before a rescan
+#define DB_RESCAN_STAT_GRAIN_SIZE 256
+// they decide whether a folder is read again, so network filesystems must not answer from their attribute cache
+#define DB_RESCAN_FOLDER_STAT_FIELDS (FSEARCH_DIRECTORY_STAT_IDENTITY | FSEARCH_DIRECTORY_STAT_SYNC)
+
+// What a folder of the previous database looked like right before the rescan
+typedef struct {
+    FsearchDatabaseEntry *folder;
+    time_t mtime;
+    uint32_t identity;
+    bool is_folder;
+} DatabaseRescanFolderStat;
+
+// The rescan doesn't change the entries of the previous database, which can still be searched while it runs and
+// stays in use if the rescan gets cancelled. Every entry which is kept gets copied to the pools of the new database
+// instead and the changes are made to the copies only.
+typedef struct DatabaseRescanContext {
+    DatabaseWalkContext walk_context;
+    // maps every folder of the previous database to a GPtrArray of its direct children,
+    // the root folders are stored with the key NULL
+    GHashTable *children;
+    // indexes of the previous database
+    GList *old_indexes;
+    // the paths of the folders of the previous database, may be NULL
+    FsearchFolderPaths *old_folder_paths;
+    // the folders of the previous database by name and what db_rescan_stat_folders found for them, at the same
+    // positions
+    DynamicArray *old_folders;
+    DatabaseRescanFolderStat *folder_stats;
+    DynamicArray *old_files;
+
+    // the copies of the entries of indexes which were carried over without walking them, at the positions of the
+    // entries they copy in old_folders and old_files
+    FsearchDatabaseEntry **carried_folders;
+    FsearchDatabaseEntry **carried_files;
+    uint32_t num_carried;
+    // an entry which got carried over wasn't at its idx, so the copies can't be found through the sorted arrays of
+    // the previous database
+    bool carried_unknown;
+    // the entries the walks added, that's everything which wasn't carried over
+    DynamicArray *walked_folders;
+    DynamicArray *walked_files;
+
+    uint32_t num_reused;
+    // reused entries whose size, modification time or other values changed
+    uint32_t num_changed;
+    uint32_t num_removed;
+    uint32_t num_folders_read;
+} DatabaseRescanContext;
+
+static void
+db_rescan_add_children(GHashTable *children, DynamicArray *entries) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+        GPtrArray *siblings = g_hash_table_lookup(children, parent);
+        if (!siblings) {
+            siblings = g_ptr_array_new();
+            g_hash_table_insert(children, parent, siblings);
+        }
+        g_ptr_array_add(siblings, entry);
+    }
+}
+
+static uint32_t
+db_rescan_count_subtree(DatabaseRescanContext *ctx, FsearchDatabaseEntry *entry) {
+    uint32_t num_entries = 1;
+    if (db_entry_is_folder(entry)) {
+        GPtrArray *children = g_hash_table_lookup(ctx->children, entry);
+        for (uint32_t i = 0; children && i < children->len; i++) {
+            num_entries += db_rescan_count_subtree(ctx, g_ptr_array_index(children, i));
+        }
+    }
+    return num_entries;
+}
+
+static void
+db_rescan_remove_entry(DatabaseRescanContext *ctx, FsearchDatabaseEntry *entry) {
+    // the entry and its subtree just don't get copied
+    ctx->num_removed += db_rescan_count_subtree(ctx, entry);
+}
+
+// Copies entry of the previous database to the new one, below the copy of its parent
+static FsearchDatabaseEntry *
+db_rescan_copy_entry(DatabaseRescanContext *ctx, FsearchDatabaseEntry *entry, FsearchDatabaseEntryFolder *parent) {
+    FsearchDatabase *db = ctx->walk_context.db;
+    ctx->num_reused++;
+    const bool is_folder = db_entry_is_folder(entry);
+    FsearchDatabaseEntry *copy = fsearch_memory_pool_malloc(is_folder ? db->folder_pool : db->file_pool);
+    db_entry_copy(entry, copy, parent);
+    DynamicArray *entries = is_folder ? db->sorted_folders[DATABASE_INDEX_TYPE_NAME]
+                                      : db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    darray_add_item(entries, copy);
+    return copy;
+}
+
+static void
+db_rescan_add_carried_entry(DatabaseRescanContext *ctx, FsearchDatabaseEntry *entry, FsearchDatabaseEntry *copy) {
+    const bool is_folder = db_entry_is_folder(entry);
+    DynamicArray *old_entries = is_folder ? ctx->old_folders : ctx->old_files;
+    FsearchDatabaseEntry ***carried = is_folder ? &ctx->carried_folders : &ctx->carried_files;
+    const uint32_t idx = db_entry_get_idx(entry);
+    if (idx >= darray_get_num_items(old_entries) || darray_get_item(old_entries, idx) != entry) {
+        ctx->carried_unknown = true;
+        return;
+    }
+    if (!*carried) {
+        *carried = g_new0(FsearchDatabaseEntry *, darray_get_num_items(old_entries));
+    }
+    (*carried)[idx] = copy;
+    ctx->num_carried++;
+}
+
+static void
+db_rescan_carry_over_subtree(DatabaseRescanContext *ctx,
+                             FsearchDatabaseEntry *entry,
+                             FsearchDatabaseEntryFolder *parent) {
+    FsearchDatabaseEntry *copy = db_rescan_copy_entry(ctx, entry, parent);
+    db_rescan_add_carried_entry(ctx, entry, copy);
+    if (db_entry_is_file(entry)) {
+        return;
+    }
+    GPtrArray *children = g_hash_table_lookup(ctx->children, entry);
+    for (uint32_t i = 0; children && i < children->len; i++) {
+        db_rescan_carry_over_subtree(ctx, g_ptr_array_index(children, i), (FsearchDatabaseEntryFolder *)copy);
+    }
+}
+
+static void
+db_rescan_collect_folders(DatabaseRescanContext *ctx, FsearchDatabaseEntry *folder, GPtrArray *folders) {
+    GPtrArray *children = g_hash_table_lookup(ctx->children, folder);
+    for (uint32_t i = 0; children && i < children->len; i++) {
+        FsearchDatabaseEntry *child = g_ptr_array_index(children, i);
+        if (!db_entry_is_folder(child)) {
+            continue;
+        }
+        // only the ones at their idx get a slot, every slot must be written by one task only
+        if (darray_get_item(ctx->old_folders, db_entry_get_idx(child)) == child) {
+            g_ptr_array_add(folders, child);
+        }
+        db_rescan_collect_folders(ctx, child, folders);
+    }
+}
+
+typedef struct {
+    DatabaseRescanContext *ctx;
+    GPtrArray *folders;
+} DatabaseRescanStatContext;
+
+static void
+db_rescan_stat_folders_range(uint32_t start, uint32_t end, void *data) {
+    DatabaseRescanStatContext *stat_ctx = data;
+    DatabaseRescanContext *ctx = stat_ctx->ctx;
+    g_autoptr(GString) path = g_string_new(NULL);
+    for (uint32_t i = start; i < end; i++) {
+        FsearchDatabaseEntry *folder = g_ptr_array_index(stat_ctx->folders, i);
+        g_string_truncate(path, 0);
+        fsearch_folder_paths_append_full_path(ctx->old_folder_paths, folder, path);
+
+        DatabaseRescanFolderStat *folder_stat = &ctx->folder_stats[db_entry_get_idx(folder)];
+        FsearchDirectoryEntryStat st;
+        if (fsearch_directory_stat_path(path->str, DB_RESCAN_FOLDER_STAT_FIELDS, &st)) {
+            folder_stat->mtime = st.mtime;
+            folder_stat->identity = db_get_stat_identity(&st);
+            folder_stat->is_folder = st.is_folder;
+        }
+        folder_stat->folder = folder;
+    }
+}
+
+// Stats all folders below root in parallel, so the walk of the unchanged folders mostly doesn't have to wait for
+// the filesystem. The stat calls are the bulk of the work if little changed, and on network filesystems every one
+// of them costs a round trip.
+static void
+db_rescan_stat_folders(DatabaseRescanContext *ctx, FsearchDatabaseEntry *root) {
+    FsearchDatabase *db = ctx->walk_context.db;
+    if (db->scan_throttle || !db->thread_pool || fsearch_thread_pool_get_num_threads(db->thread_pool) < 2) {
+        // paced scans make one call at a time
+        return;
+    }
+    g_autoptr(GPtrArray) folders = g_ptr_array_new();
+    db_rescan_collect_folders(ctx, root, folders);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    DatabaseRescanStatContext stat_ctx = {.ctx = ctx, .folders = folders};
+    fsearch_thread_pool_parallel_for(db->thread_pool,
+                                     0,
+                                     folders->len,
+                                     DB_RESCAN_STAT_GRAIN_SIZE,
+                                     db_rescan_stat_folders_range,
+                                     &stat_ctx);
+    g_debug("[db_rescan] stat'ed %u folders in %f s", folders->len, g_timer_elapsed(timer, NULL));
+}
+
+// Looks up what db_rescan_stat_folders found for folder, or stats it now. Returns false if it's not a folder
+// anymore or can't be stat'ed.
+static bool
+db_rescan_get_folder_stat(DatabaseRescanContext *ctx,
+                          FsearchDatabaseEntry *folder,
+                          const char *path,
+                          time_t *mtime,
+                          uint32_t *identity) {
+    const uint32_t idx = db_entry_get_idx(folder);
+    if (idx < darray_get_num_items(ctx->old_folders) && ctx->folder_stats[idx].folder == folder) {
+        const DatabaseRescanFolderStat *folder_stat = &ctx->folder_stats[idx];
+        *mtime = folder_stat->mtime;
+        *identity = folder_stat->identity;
+        return folder_stat->is_folder;
+    }
+    FsearchDatabase *db = ctx->walk_context.db;
+    FsearchDirectoryEntryStat st;
+    const int64_t start_us = db_scan_throttle_start(db);
+    const bool stat_failed = !fsearch_directory_stat_path(path, DB_RESCAN_FOLDER_STAT_FIELDS, &st);
+    db_scan_throttle_charge(db, 1, 0, start_us);
+    if (stat_failed) {
+        return false;
+    }
+    *mtime = st.mtime;
+    *identity = db_get_stat_identity(&st);
+    return st.is_folder;
+}
+
+static int
+db_folder_rescan_recursive(DatabaseRescanContext *ctx,
+                           FsearchDatabaseEntryFolder *folder,
+                           FsearchDatabaseEntryFolder *copy,
+                           bool folder_changed);
+
+// child is a folder of the previous database and copy the copy of it
+static int
+db_folder_rescan_child_folder(DatabaseRescanContext *ctx,
+                              FsearchDatabaseEntry *child,
+                              FsearchDatabaseEntry *copy,
+                              time_t mtime,
+                              uint32_t identity) {
+    const bool mtime_changed = db_entry_get_mtime(child) != mtime;
+    // The modification time alone misses folders which were replaced by another one with the same time (e.g. by
+    // rsync or when restoring a backup), or whose time was set back. Folders which were scanned before their
+    // identity was stored only get compared by their modification time.
+    const uint32_t old_identity = db_entry_folder_get_identity((FsearchDatabaseEntryFolder *)child);
+    const bool identity_changed = old_identity != 0 && old_identity != identity;
+    // a newly known identity doesn't need the folder to be read, but has to end up in the new database
+    if (mtime_changed || old_identity != identity) {
+        ctx->num_changed++;
+    }
+    db_entry_set_mtime(copy, mtime);
+    db_entry_folder_set_identity((FsearchDatabaseEntryFolder *)copy, identity);
+    return db_folder_rescan_recursive(ctx,
+                                      (FsearchDatabaseEntryFolder *)child,
+                                      (FsearchDatabaseEntryFolder *)copy,
+                                      mtime_changed || identity_changed);
+}
+
+static int
+db_folder_rescan_unchanged(DatabaseRescanContext *ctx, FsearchDatabaseEntryFolder *copy, GPtrArray *children) {
+    GString *path = ctx->walk_context.path;
+    g_string_append_c(path, G_DIR_SEPARATOR);
+    const gsize path_len = path->len;
+
+    for (uint32_t i = 0; children && i < children->len; i++) {
+        FsearchDatabaseEntry *child = g_ptr_array_index(children, i);
+        if (db_entry_is_file(child)) {
+            // the directory listing didn't change, so the file entry can be carried over as is
+            db_rescan_copy_entry(ctx, child, copy);
+            continue;
+        }
+
+        g_string_truncate(path, path_len);
+        g_string_append(path, db_entry_get_name_raw(child));
+
+        time_t mtime = 0;
+        uint32_t identity = 0;
+        if (!db_rescan_get_folder_stat(ctx, child, path->str, &mtime, &identity)) {
+            // Can only happen if the folder was replaced in the short time between the
+            // stat of its parent and now
+            db_rescan_remove_entry(ctx, child);
+            continue;
+        }
+
+        FsearchDatabaseEntry *child_copy = db_rescan_copy_entry(ctx, child, copy);
+        if (db_folder_rescan_child_folder(ctx, child, child_copy, mtime, identity) == WALK_CANCEL) {
+            return WALK_CANCEL;
+        }
+    }
+    return WALK_OK;
+}
+
+// Reads the folder again, children are the entries of the previous database in it. New entries get copy, the copy
+// of the folder, as their parent.
+static int
+db_folder_rescan_changed(DatabaseRescanContext *ctx, FsearchDatabaseEntryFolder *copy, GPtrArray *children) {
+    DatabaseWalkContext *walk_context = &ctx->walk_context;
+    FsearchDatabase *db = walk_context->db;
+    GString *path = walk_context->path;
+    g_string_append_c(path, G_DIR_SEPARATOR);
+    const gsize path_len = path->len;
+
+    // the names are copied, front coded ones are only decoded into a temporary buffer
+    g_autoptr(GHashTable) old_children = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (uint32_t i = 0; children && i < children->len; i++) {
+        FsearchDatabaseEntry *child = g_ptr_array_index(children, i);
+        g_hash_table_insert(old_children, g_strdup(db_entry_get_name_raw(child)), child);
+    }
+
+    int res = WALK_OK;
+
+    const int64_t open_start_us = db_scan_throttle_start(db);
+    FsearchDirectoryReader *dir = fsearch_directory_reader_open(path->str);
+    db_scan_throttle_charge(db, 1, 0, open_start_us);
+    if (!dir) {
+        g_debug("[db_rescan] failed to open directory: %s", path->str);
+        res = WALK_BADIO;
+        goto remove_old_children;
+    }
+    ctx->num_folders_read++;
+    g_autoptr(GString) xattrs = db_folder_wants_xattrs(db, path->str) ? g_string_new(NULL) : NULL;
+
+    const double elapsed_seconds = g_timer_elapsed(walk_context->timer, NULL);
+    if (elapsed_seconds > 0.1) {
+        if (walk_context->status_cb) {
+            walk_context->status_cb(path->str);
+        }
+        g_timer_start(walk_context->timer);
+    }
+
+    const FsearchDirectoryEntry *dent = NULL;
+    while ((dent = fsearch_directory_reader_next(dir))) {
+        if (is_cancelled(walk_context->cancellable)) {
+            g_debug("[db_rescan] cancelled");
+            g_clear_pointer(&dir, fsearch_directory_reader_close);
+            return WALK_CANCEL;
+        }
+        if (walk_context->exclude_hidden && dent->name[0] == '.') {
+            continue;
+        }
+        if (file_is_excluded(db, dent->name, dent->name_len)) {
+            continue;
+        }
+
+        if (dent->name_len >= 256) {
+            g_warning("[db_rescan] file name too long, skipping: \"%s\" (len: %zd)", dent->name, dent->name_len);
+            continue;
+        }
+
+        g_string_truncate(path, path_len);
+        g_string_append_len(path, dent->name, (gssize)dent->name_len);
+
+        if (dent->type == FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER && directory_is_excluded(db, path->str)) {
+            g_debug("[db_rescan] excluded directory: %s", path->str);
+            continue;
+        }
+
+        // the modification time and identity of folders decide whether they're read again, so they must not come
+        // from the attribute cache of a network filesystem
+        FsearchDirectoryStatFields stat_fields = db_get_stat_fields(db);
+        if (dent->type != FSEARCH_DIRECTORY_ENTRY_TYPE_FILE) {
+            stat_fields |= FSEARCH_DIRECTORY_STAT_SYNC;
+        }
+        FsearchDirectoryEntryStat st;
+        const int64_t stat_start_us = db_scan_throttle_start(db);
+        const bool stat_failed = !fsearch_directory_reader_stat(dir, dent, stat_fields, &st);
+        db_scan_throttle_charge(db, 1, 0, stat_start_us);
+        if (stat_failed) {
+            g_debug("[db_rescan] can't stat: %s", path->str);
+            continue;
+        }
+
+        if (walk_context->one_filesystem && walk_context->root_device_id != st.device_id) {
+            g_debug("[db_rescan] different filesystem, skipping: %s", path->str);
+            continue;
+        }
+
+        const bool is_dir = st.is_folder;
+        if (is_dir && dent->type != FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER
+            && directory_is_excluded(db, path->str)) {
+            g_debug("[db_rescan] excluded directory: %s", path->str);
+            continue;
+        }
+
+        FsearchDatabaseEntry *old_child = g_hash_table_lookup(old_children, dent->name);
+        if (old_child && db_entry_is_folder(old_child) == is_dir) {
+            g_hash_table_remove(old_children, dent->name);
+            FsearchDatabaseEntry *child_copy = db_rescan_copy_entry(ctx, old_child, copy);
+            const bool xattrs_changed = xattrs && db_entry_read_xattrs(db, child_copy, path->str, xattrs);
+            if (db_entry_stat_values_differ(child_copy, &st)) {
+                db_entry_set_stat_values(child_copy, &st);
+                ctx->num_changed++;
+            }
+            else if (xattrs_changed) {
+                ctx->num_changed++;
+            }
+            if (is_dir) {
+                if (db_folder_rescan_child_folder(ctx, old_child, child_copy, st.mtime, db_get_stat_identity(&st))
+                    == WALK_CANCEL) {
+                    g_clear_pointer(&dir, fsearch_directory_reader_close);
+                    return WALK_CANCEL;
+                }
+            }
+            else {
+                if (db_entry_get_size(old_child) != st.size || db_entry_get_mtime(old_child) != st.mtime) {
+                    ctx->num_changed++;
+                }
+                // the folder sizes get summed up after the walk
+                db_entry_set_size(child_copy, st.size);
+                db_entry_set_mtime(child_copy, st.mtime);
+            }
+            continue;
+        }
+
+        if (is_dir) {
+            FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->folder_pool);
+            db_entry_set_pooled_name(db->name_pool, entry, dent->name, dent->name_len);
+            db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+            db_entry_set_mtime(entry, st.mtime);
+            db_entry_init_stat_values(db, entry, &st);
+            if (xattrs) {
+                db_entry_read_xattrs(db, entry, path->str, xattrs);
+            }
+            db_entry_set_parent(entry, copy);
+
+            darray_add_item(db->sorted_folders[DATABASE_INDEX_TYPE_NAME], entry);
+
+            // a new folder, so everything below it needs to be scanned
+            if (db_folder_scan_recursive(walk_context, (FsearchDatabaseEntryFolder *)entry) == WALK_CANCEL) {
+                g_clear_pointer(&dir, fsearch_directory_reader_close);
+                return WALK_CANCEL;
+            }
+        }
+        else {
+            FsearchDatabaseEntry *file_entry = fsearch_memory_pool_malloc(db->file_pool);
+            db_entry_set_pooled_name(db->name_pool, file_entry, dent->name, dent->name_len);
+            db_entry_set_size(file_entry, st.size);
+            db_entry_set_mtime(file_entry, st.mtime);
+            db_entry_set_type(file_entry, DATABASE_ENTRY_TYPE_FILE);
+            db_entry_init_stat_values(db, file_entry, &st);
+            if (xattrs) {
+                db_entry_read_xattrs(db, file_entry, path->str, xattrs);
+            }
+            db_entry_set_parent(file_entry, copy);
+
+            darray_add_item(db->sorted_files[DATABASE_INDEX_TYPE_NAME], file_entry);
+        }
+    }
+
+    db_scan_throttle_charge(db, 0, fsearch_directory_reader_get_bytes_read(dir), 0);
+    g_clear_pointer(&dir, fsearch_directory_reader_close);
+
+remove_old_children:;
+    // everything which is left wasn't found in the folder anymore
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, old_children);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        db_rescan_remove_entry(ctx, value);
+    }
+
+    return res;
+}
+
+static int
+db_folder_rescan_recursive(DatabaseRescanContext *ctx,
+                           FsearchDatabaseEntryFolder *folder,
+                           FsearchDatabaseEntryFolder *copy,
+                           bool folder_changed) {
+    if (is_cancelled(ctx->walk_context.cancellable)) {
+        g_debug("[db_rescan] cancelled");
+        return WALK_CANCEL;
+    }
+
+    GString *path = ctx->walk_context.path;
+    // remember end of the folder path
+    const gsize path_len = path->len;
+
+    GPtrArray *children = g_hash_table_lookup(ctx->children, folder);
+    const int res = folder_changed ? db_folder_rescan_changed(ctx, copy, children)
+                                   : db_folder_rescan_unchanged(ctx, copy, children);
+
+    g_string_truncate(path, path_len);
+    return res;
+}
+
+static FsearchDatabaseEntry *
+db_rescan_find_root(DatabaseRescanContext *ctx, const char *name) {
+    GPtrArray *roots = g_hash_table_lookup(ctx->children, NULL);
+    for (uint32_t i = 0; roots && i < roots->len; i++) {
+        FsearchDatabaseEntry *root = g_ptr_array_index(roots, i);
+        if (!strcmp(db_entry_get_name_raw(root), name)) {
+            return root;
+        }
+    }
+    return NULL;
+}
+
+static FsearchIndex *
+db_rescan_find_old_index(DatabaseRescanContext *ctx, const char *path) {
+    for (GList *l = ctx->old_indexes; l != NULL; l = l->next) {
+        FsearchIndex *index = l->data;
+        if (index->enabled && !g_strcmp0(index->path, path)) {
+            return index;
+        }
+    }
+    return NULL;
+}
+
+static const char *
+db_rescan_get_root_name(const char *path) {
+    // the root directory is stored with an empty name
+    return strcmp(path, G_DIR_SEPARATOR_S) == 0 ? "" : path;
+}
+
+static FsearchDatabaseEntry *
+db_rescan_find_reusable_root(DatabaseRescanContext *ctx, FsearchIndex *index) {
+    FsearchIndex *old_index = db_rescan_find_old_index(ctx, index->path);
+    if (!old_index || old_index->one_filesystem != index->one_filesystem) {
+        // the index is new or was scanned with different settings
+        return NULL;
+    }
+    return db_rescan_find_root(ctx, db_rescan_get_root_name(index->path));
+}
+
+static bool
+db_rescan_folder(DatabaseRescanContext *ctx,
+                 FsearchIndex *index,
+                 GCancellable *cancellable,
+                 void (*status_cb)(const char *)) {
+    const char *dname = index->path;
+    const bool one_filesystem = index->one_filesystem;
+    g_assert(dname);
+    g_assert(dname[0] == G_DIR_SEPARATOR);
+
+    FsearchDatabase *db = ctx->walk_context.db;
+
+    g_autoptr(GString) path = g_string_new(db_rescan_get_root_name(dname));
+
+    FsearchDatabaseEntry *root = db_rescan_find_reusable_root(ctx, index);
+    struct stat root_st;
+    if (!root || lstat(dname, &root_st) || !S_ISDIR(root_st.st_mode)) {
+        // the location wasn't part of the previous database, so it has to be scanned from scratch
+        return db_scan_folder(db, index, cancellable, status_cb);
+    }
+    g_debug("[db_rescan] rescan path: %s", dname);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_timer_start(timer);
+
+    ctx->walk_context.folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+    ctx->walk_context.files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+    ctx->walk_context.path = path;
+    ctx->walk_context.timer = timer;
+    ctx->walk_context.cancellable = cancellable;
+    ctx->walk_context.status_cb = status_cb;
+    ctx->walk_context.root_device_id = root_st.st_dev;
+    ctx->walk_context.one_filesystem = one_filesystem;
+    ctx->walk_context.exclude_hidden = db->exclude_hidden;
+
+    db_rescan_stat_folders(ctx, root);
+    const int res = db_folder_rescan_child_folder(
+        ctx,
+        root,
+        db_rescan_copy_entry(ctx, root, NULL),
+        root_st.st_mtime,
+        db_get_folder_identity(root_st.st_dev, root_st.st_ino, root_st.st_ctime));
+
+    ctx->walk_context.path = NULL;
+    ctx->walk_context.timer = NULL;
+
+    if (res == WALK_CANCEL) {
+        g_debug("[db_rescan] rescan cancelled.");
+        return false;
+    }
+    return true;
+}
+
+static gint
+db_rescan_compare_exclude_path(FsearchExcludePath *p1, FsearchExcludePath *p2) {
+    if (p1->enabled != p2->enabled) {
+        return 1;
+    }
+    return g_strcmp0(p1->path, p2->path);
+}
+
+static bool
+db_rescan_list_equal(GList *l1, GList *l2, GCompareFunc cmp_func) {
+    while (l1 && l2) {
+        if (cmp_func(l1->data, l2->data) != 0) {
+            return false;
+        }
+        l1 = l1->next;
+        l2 = l2->next;
+    }
+    return !l1 && !l2;
+}
+
+static bool
+db_rescan_strv_equal(char **v1, char **v2) {
+    if (!v1 || !v2) {
+        return v1 == v2;
+    }
+    return g_strv_equal((const gchar *const *)v1, (const gchar *const *)v2);
+}
+
+static bool
+db_rescan_is_possible(FsearchDatabase *db, FsearchDatabase *old_db) {
+    if (!old_db || !old_db->sorted_folders[DATABASE_INDEX_TYPE_NAME] || !old_db->sorted_files[DATABASE_INDEX_TYPE_NAME]) {
+        return false;
+    }
+    if ((old_db->index_flags & DATABASE_INDEX_FLAG_MODIFICATION_TIME) == 0) {
+        // the folder modification times are required to detect changes
+        return false;
+    }
+    if ((old_db->index_flags & DATABASE_INDEX_FLAGS_OPTIONAL) != db->entry_optional_values) {
+        // entries are carried over, so they need room for the same optional values
+        return false;
+    }
+    if (db->exclude_hidden != old_db->exclude_hidden) {
+        return false;
+    }
+    // Changes to the indexes themselves are handled per index by db_rescan, only the settings
+    // which apply to all of them require a full scan.
+    if (!db_rescan_list_equal(db->excludes, old_db->excludes, (GCompareFunc)db_rescan_compare_exclude_path)) {
+        return false;
+    }
+    if (!db_rescan_strv_equal(db->exclude_files, old_db->exclude_files)) {
+        return false;
+    }
+    // The extended attributes of unchanged entries are read again by the rescan, but those of entries whose
+    // attributes were never read or read with different settings might not be found
+    if (old_db->xattrs_outdated || !db_rescan_strv_equal(db->xattr_names, old_db->xattr_names)
+        || !db_rescan_strv_equal(db->xattr_paths, old_db->xattr_paths)) {
+        return false;
+    }
+    const uint32_t num_old_entries = db_get_num_entries(old_db);
+    if (old_db->num_stale_entries > num_old_entries / 4) {
+        // The names of entries which were removed by previous rescans are kept alive by the shared name pools.
+        // Once there are too many of them a full scan is done, which allows releasing them.
+        g_debug("[db_rescan] too many stale entries: %d, full scan required", old_db->num_stale_entries);
+        return false;
+    }
+    return true;
+}
+
+// Takes over the sorted arrays and indexes of old_db, which is only possible if the rescan found exactly the entries
+// of old_snapshot with the same values and old_db didn't get updated since. That avoids sorting all entries and
+// building the indexes again, and the previous and new database don't keep two copies of them in memory. The copies
+// of the entries made by the rescan are dropped, db keeps the memory pools of old_db alive instead.
+static bool
+db_rescan_share_sorted_entries(FsearchDatabase *db, FsearchDatabase *old_db, FsearchDatabaseSnapshot *old_snapshot) {
+    if (db->index_flags != old_db->index_flags || db->compact_indexes != old_db->compact_indexes
+        || db->trigram_indexes != old_db->trigram_indexes || db->name_indexes != old_db->name_indexes
+        || db->folder_path_cache != old_db->folder_path_cache || db->folded_name_cache != old_db->folded_name_cache
+        || db->subtree_filters != old_db->subtree_filters) {
+        return false;
+    }
+
+    db_lock(old_db);
+    const bool unchanged = old_db->snapshot == old_snapshot;
+    if (unchanged) {
+        db_sorted_entries_free(db);
+        for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+            db_load_pending_sorted_arrays(old_db, i);
+            db->sorted_files[i] = darray_ref(old_db->sorted_files[i]);
+            db->sorted_folders[i] = darray_ref(old_db->sorted_folders[i]);
+        }
+        db->folder_trigram_index = fsearch_trigram_index_ref(old_db->folder_trigram_index);
+        db->file_trigram_index = fsearch_trigram_index_ref(old_db->file_trigram_index);
+        db->folder_name_index = fsearch_name_index_ref(old_db->folder_name_index);
+        db->file_name_index = fsearch_name_index_ref(old_db->file_name_index);
+        db->folder_paths = fsearch_folder_paths_ref(old_db->folder_paths);
+        db->folded_names = fsearch_folded_names_ref(old_db->folded_names);
+        db->subtree_filter = fsearch_subtree_filter_ref(old_db->subtree_filter);
+
+        fsearch_memory_pool_reset(db->file_pool);
+        fsearch_memory_pool_reset(db->folder_pool);
+        db->shared_pools = g_list_prepend(db->shared_pools, fsearch_memory_pool_ref(old_db->file_pool));
+        db->shared_pools = g_list_prepend(db->shared_pools, fsearch_memory_pool_ref(old_db->folder_pool));
+        for (GList *p = old_db->shared_pools; p != NULL; p = p->next) {
+            db->shared_pools = g_list_prepend(db->shared_pools, fsearch_memory_pool_ref(p->data));
+        }
+    }
+    db_unlock(old_db);
+
+    if (!unchanged) {
+        return false;
+    }
+    // the settings are the same, but the previous database might have been loaded without them
+    if (db->trigram_indexes && (!db->folder_trigram_index || !db->file_trigram_index)) {
+        db_build_trigram_indexes(db);
+    }
+    if (db->name_indexes && (!db->folder_name_index || !db->file_name_index)) {
+        db_build_name_indexes(db);
+    }
+    if (!db->folder_paths) {
+        db_build_folder_paths(db);
+    }
+    if (!db->folded_names) {
+        db_build_folded_names(db);
+    }
+    if (!db->subtree_filter) {
+        db_build_subtree_filter(db);
+    }
+    return true;
+}
+
+static DynamicArrayCompareDataFunc
+db_update_get_compare_func(FsearchDatabaseIndexType type);
+
+// Merges the sorted arrays first and second into a new one, items of first come before equal items of second
+static DynamicArray *
+db_merge_sorted_arrays(FsearchDatabase *db,
+                       DynamicArray *first,
+                       DynamicArray *second,
+                       DynamicArrayCompareDataFunc compare_func) {
+    FsearchArrayMerge *merge = fsearch_array_merge_new(first, second, compare_func, NULL, db->thread_pool);
+    const uint32_t num_items = fsearch_array_merge_get_num_items(merge);
+    DynamicArray *merged = darray_new(num_items + 1);
+    void *items[FSEARCH_ARRAY_MERGE_BLOCK_SIZE];
+    for (uint32_t start = 0; start < num_items; start += G_N_ELEMENTS(items)) {
+        const uint32_t num_block_items = fsearch_array_merge_get_items(merge, start, G_N_ELEMENTS(items), items);
+        darray_add_items(merged, items, num_block_items);
+    }
+    g_clear_pointer(&merge, fsearch_array_merge_free);
+    return merged;
+}
+
+// Returns the entries of old_sorted, which is sorted by sort_type, merged with the walked ones. The carried over
+// entries take the positions of the ones they copy, so only the walked entries need to be sorted.
+static DynamicArray *
+db_rescan_merge_sorted_array(DatabaseRescanContext *ctx,
+                             DynamicArray *old_sorted,
+                             bool is_folder,
+                             FsearchDatabaseIndexType sort_type,
+                             GCancellable *cancellable) {
+    FsearchDatabase *db = ctx->walk_context.db;
+    DynamicArray *old_entries = is_folder ? ctx->old_folders : ctx->old_files;
+    FsearchDatabaseEntry **carried = is_folder ? ctx->carried_folders : ctx->carried_files;
+    const uint32_t num_old_entries = darray_get_num_items(old_entries);
+
+    const uint32_t num_old_sorted = darray_get_num_items(old_sorted);
+    g_autoptr(DynamicArray) kept = darray_new(num_old_sorted + 1);
+    for (uint32_t i = 0; carried && i < num_old_sorted; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(old_sorted, i);
+        const uint32_t idx = db_entry_get_idx(entry);
+        if (idx < num_old_entries && carried[idx] && darray_get_item(old_entries, idx) == entry) {
+            darray_add_item(kept, carried[idx]);
+        }
+    }
+
+    // The name arrays are merged first and determine the idx of the entries, which the other orders use for
+    // entries with equal values. The walked entries stay sorted by name, so the stable sorts of the other orders
+    // keep them in that order. The old arrays are in that order as well, since the carried over entries keep their
+    // order by name.
+    DynamicArray *walked_by_name = is_folder ? ctx->walked_folders : ctx->walked_files;
+    if (sort_type == DATABASE_INDEX_TYPE_NAME) {
+        db_sort_entries_copy(db, &walked_by_name, sort_type, is_folder, cancellable);
+        if (is_cancelled(cancellable)) {
+            return NULL;
+        }
+        return db_merge_sorted_arrays(db,
+                                      kept,
+                                      walked_by_name,
+                                      (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_name);
+    }
+
+    DynamicArrayCompareDataFunc compare_func = db_update_get_compare_func(sort_type);
+    g_autoptr(DynamicArray) walked = darray_copy(walked_by_name);
+    if (sort_type == DATABASE_INDEX_TYPE_EXTENSION) {
+        // the sort by extension alone doesn't keep the order of equal entries
+        darray_sort_multi_threaded(walked, compare_func, db->thread_pool, cancellable, NULL);
+    }
+    else {
+        db_sort_entries_copy(db, &walked, sort_type, is_folder, cancellable);
+    }
+    if (!walked || is_cancelled(cancellable)) {
+        return NULL;
+    }
+    return db_merge_sorted_arrays(db, kept, walked, compare_func);
+}
+
+// Builds the sorted arrays by merging the walked entries into the sorted arrays of old_db, instead of sorting all
+// entries again. When a single index gets rescanned that keeps the cost proportional to its size. That's only
+// possible if old_db didn't get updated since old_snapshot and all carried over entries were found at their idx.
+// Orders which old_db doesn't have are built in the background like after a full sort.
+static bool
+db_rescan_merge_sorted_entries(DatabaseRescanContext *ctx,
+                               FsearchDatabase *old_db,
+                               FsearchDatabaseSnapshot *old_snapshot,
+                               GCancellable *cancellable) {
+    FsearchDatabase *db = ctx->walk_context.db;
+    if (ctx->num_carried == 0 || ctx->carried_unknown) {
+        return false;
+    }
+
+    DynamicArray *old_sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    DynamicArray *old_sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    db_lock(old_db);
+    const bool unchanged = old_db->snapshot == old_snapshot;
+    for (uint32_t i = 0; unchanged && i < NUM_DATABASE_INDEX_TYPES; i++) {
+        db_load_pending_sorted_arrays(old_db, i);
+        if (old_db->sorted_folders[i] && old_db->sorted_files[i]) {
+            old_sorted_folders[i] = darray_ref(old_db->sorted_folders[i]);
+            old_sorted_files[i] = darray_ref(old_db->sorted_files[i]);
+        }
+    }
+    db_unlock(old_db);
+
+    bool merged =
+        unchanged && old_sorted_folders[DATABASE_INDEX_TYPE_NAME] && old_sorted_folders[DATABASE_INDEX_TYPE_PATH];
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_TYPES] = {NULL};
+    for (uint32_t i = 0; merged && i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (!old_sorted_folders[i]) {
+            continue;
+        }
+        if (i == DATABASE_INDEX_TYPE_EXTENSION || i == DATABASE_INDEX_TYPE_FILETYPE) {
+            // folders don't have a file extension or type, like in db_build_index they use the name array
+            sorted_folders[i] = darray_ref(sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+        }
+        else {
+            sorted_folders[i] = db_rescan_merge_sorted_array(ctx, old_sorted_folders[i], true, i, cancellable);
+        }
+        sorted_files[i] = db_rescan_merge_sorted_array(ctx, old_sorted_files[i], false, i, cancellable);
+        merged = sorted_folders[i] && sorted_files[i];
+        if (merged && i == DATABASE_INDEX_TYPE_NAME) {
+            db_entry_update_indices(db, sorted_folders[i]);
+            db_entry_update_indices(db, sorted_files[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_clear_pointer(&old_sorted_folders[i], darray_unref);
+        g_clear_pointer(&old_sorted_files[i], darray_unref);
+        if (merged) {
+            g_clear_pointer(&db->sorted_folders[i], darray_unref);
+            g_clear_pointer(&db->sorted_files[i], darray_unref);
+            db->sorted_folders[i] = g_steal_pointer(&sorted_folders[i]);
+            db->sorted_files[i] = g_steal_pointer(&sorted_files[i]);
+        }
+        g_clear_pointer(&sorted_folders[i], darray_unref);
+        g_clear_pointer(&sorted_files[i], darray_unref);
+    }
+    if (merged) {
+        db_compact_sorted_entries(db);
+    }
+    return merged;
+}
+
+// Rescans the indexes of db, or only only_index if it's not NULL, see db_rescan
+static bool
+db_rescan_indexes(FsearchDatabase *db,
+                  FsearchDatabase *old_db,
+                  FsearchIndex *only_index,
+                  GCancellable *cancellable,
+                  void (*status_cb)(const char *),
+                  FsearchOperationTimer *operation_timer) {
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_timer_start(timer);
+
+    fsearch_operation_timer_lock(operation_timer, &old_db->mutex);
+    DynamicArray *old_folders = darray_ref(old_db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+    DynamicArray *old_files = darray_ref(old_db->sorted_files[DATABASE_INDEX_TYPE_NAME]);
+    // the version the entries are taken from, see db_rescan_share_sorted_entries
+    FsearchDatabaseSnapshot *old_snapshot = db_get_snapshot(old_db);
+    const uint32_t num_old_entries = darray_get_num_items(old_folders) + darray_get_num_items(old_files);
+
+    // The copies of the entries share their names with the previous database, so the new one has to keep its name
+    // pools alive.
+    db->shared_name_pools = g_list_prepend(db->shared_name_pools, fsearch_string_pool_ref(old_db->name_pool));
+    for (GList *p = old_db->shared_name_pools; p != NULL; p = p->next) {
+        db->shared_name_pools = g_list_prepend(db->shared_name_pools, fsearch_string_pool_ref(p->data));
+    }
+    if (old_db->name_blocks) {
+        db->shared_name_blocks = g_list_prepend(db->shared_name_blocks, fsearch_name_blocks_ref(old_db->name_blocks));
+    }
+    for (GList *p = old_db->shared_name_blocks; p != NULL; p = p->next) {
+        db->shared_name_blocks = g_list_prepend(db->shared_name_blocks, fsearch_name_blocks_ref(p->data));
+    }
+    db->num_stale_entries = old_db->num_stale_entries;
+    db_unlock(old_db);
+
+    DatabaseRescanContext ctx = {
+        .walk_context.db = db,
+        // the sizes of all folders get summed up after the walk
+        .walk_context.update_folder_sizes = false,
+        .children = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_ptr_array_unref),
+        .old_indexes = old_db->indexes,
+        .old_folder_paths = old_snapshot ? db_snapshot_get_folder_paths(old_snapshot) : NULL,
+        .old_folders = old_folders,
+        .folder_stats = g_new0(DatabaseRescanFolderStat, darray_get_num_items(old_folders)),
+        .old_files = old_files,
+        .walked_folders = darray_new(1024),
+        .walked_files = darray_new(1024),
+    };
+    db_rescan_add_children(ctx.children, old_folders);
+    db_rescan_add_children(ctx.children, old_files);
+
+    db_sorted_entries_free(db);
+
+    db->index_flags |= DATABASE_INDEX_FLAG_NAME;
+    db->index_flags |= DATABASE_INDEX_FLAG_SIZE;
+    db->index_flags |= DATABASE_INDEX_FLAG_MODIFICATION_TIME;
+    db->index_flags |= db->entry_optional_values;
+
+    db->sorted_files[DATABASE_INDEX_TYPE_NAME] = darray_new(darray_get_num_items(old_files) + 1024);
+    db->sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(darray_get_num_items(old_folders) + 1024);
+
+    bool ret = false;
+    for (GList *l = db->indexes; l != NULL; l = l->next) {
+        FsearchIndex *fs_path = l->data;
+        if (!fs_path->path) {
+            continue;
+        }
+        if (!fs_path->enabled) {
+            continue;
+        }
+        const bool update = only_index ? !g_strcmp0(fs_path->path, only_index->path) : fs_path->update;
+        FsearchDatabaseEntry *root = NULL;
+        if (!update && (root = db_rescan_find_reusable_root(&ctx, fs_path))) {
+            // indexes which aren't supposed to be updated are carried over without touching the filesystem
+            g_debug("[db_rescan] keep path: %s", fs_path->path);
+            db_rescan_carry_over_subtree(&ctx, root, NULL);
+            ret = true;
+        }
+        else {
+            DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_NAME];
+            DynamicArray *files = db->sorted_files[DATABASE_INDEX_TYPE_NAME];
+            const uint32_t first_folder = darray_get_num_items(folders);
+            const uint32_t first_file = darray_get_num_items(files);
+            ret = db_rescan_folder(&ctx, fs_path, cancellable, status_cb) || ret;
+            for (uint32_t i = first_folder; i < darray_get_num_items(folders); i++) {
+                darray_add_item(ctx.walked_folders, darray_get_item(folders, i));
+            }
+            for (uint32_t i = first_file; i < darray_get_num_items(files); i++) {
+                darray_add_item(ctx.walked_files, darray_get_item(files, i));
+            }
+        }
+        if (is_cancelled(cancellable)) {
+            break;
+        }
+    }
+
+    // entries of indexes which were removed or disabled aren't part of the database anymore
+    GPtrArray *old_roots = g_hash_table_lookup(ctx.children, NULL);
+    for (uint32_t i = 0; old_roots && i < old_roots->len; i++) {
+        FsearchDatabaseEntry *old_root = g_ptr_array_index(old_roots, i);
+        bool still_indexed = false;
+        for (GList *l = db->indexes; l != NULL && !still_indexed; l = l->next) {
+            FsearchIndex *fs_path = l->data;
+            still_indexed = fs_path->path && fs_path->enabled && db_rescan_find_reusable_root(&ctx, fs_path) == old_root;
+        }
+        if (!still_indexed) {
+            ctx.num_removed += db_rescan_count_subtree(&ctx, old_root);
+        }
+    }
+    g_clear_pointer(&ctx.children, g_hash_table_unref);
+    g_clear_pointer(&ctx.folder_stats, g_free);
+
+    bool res = false;
+    if (is_cancelled(cancellable)) {
+        goto out;
+    }
+
+    db->num_stale_entries += ctx.num_removed;
+
+    g_debug("[db_rescan] reused %d entries, changed %d entries, removed %d entries, read %d folders in %f s",
+            ctx.num_reused,
+            ctx.num_changed,
+            ctx.num_removed,
+            ctx.num_folders_read,
+            g_timer_elapsed(timer, NULL));
+
+    // all names are known now, the intern table would only waste memory from here on
+    fsearch_string_pool_stop_interning(db->name_pool);
+
+    const uint32_t num_entries = db_get_num_entries(db);
+    const bool shared = ctx.num_removed == 0 && ctx.num_changed == 0 && ctx.num_reused == num_entries
+                     && num_entries == num_old_entries && db_rescan_share_sorted_entries(db, old_db, old_snapshot);
+    if (shared) {
+        g_debug("[db_rescan] nothing changed, sharing the sorted arrays of the previous database");
+        db_publish_snapshot(db);
+        // the previous database might not have been done with them yet
+        db_build_indexes_in_background(db);
+        res = ret;
+        goto out;
+    }
+
+    // the copies which were carried over have their sizes already, the walked indexes are whole subtrees
+    db_update_folder_sizes(db, ctx.walked_folders, 0, ctx.walked_files, 0);
+
+    if (status_cb) {
+        status_cb(_("Sorting…"));
+    }
+    if (db_rescan_merge_sorted_entries(&ctx, old_db, old_snapshot, cancellable)) {
+        g_debug("[db_rescan] merged %u walked entries into the sorted arrays of the previous database",
+                darray_get_num_items(ctx.walked_folders) + darray_get_num_items(ctx.walked_files));
+    }
+    else if (!is_cancelled(cancellable)) {
+        db_sort(db, cancellable);
+        db_entry_update_folder_indices(db);
+        db_entry_update_file_indices(db);
+    }
+    if (is_cancelled(cancellable)) {
+        goto out;
+    }
+    db_build_trigram_indexes(db);
+    db_build_name_indexes(db);
+    db_build_folder_paths(db);
+    db_build_folded_names(db);
+    db_build_subtree_filter(db);
+    db_publish_snapshot(db);
+    db_build_indexes_in_background(db);
+    res = ret;
+
+out:
+    g_clear_pointer(&old_snapshot, db_snapshot_unref);
+    g_clear_pointer(&ctx.carried_folders, g_free);
+    g_clear_pointer(&ctx.carried_files, g_free);
+    g_clear_pointer(&ctx.walked_folders, darray_unref);
+    g_clear_pointer(&ctx.walked_files, darray_unref);
+    g_clear_pointer(&old_folders, darray_unref);
+    g_clear_pointer(&old_files, darray_unref);
+    return res;
+}
+
+static bool
+db_rescan_run(FsearchDatabase *db,
+              FsearchDatabase *old_db,
+              FsearchIndex *only_index,
+              GCancellable *cancellable,
+              void (*status_cb)(const char *)) {
+    if (!db_rescan_is_possible(db, old_db)) {
+        return db_scan_run(db, cancellable, status_cb);
+    }
+
+    FsearchOperationTimer timer = {};
+    fsearch_operation_timer_start(&timer, db->thread_pool);
+    const bool res = db_rescan_indexes(db, old_db, only_index, cancellable, status_cb, &timer);
+    if (res && !is_cancelled(cancellable)) {
+        const uint32_t num_entries = db_get_num_entries(db);
+        db_finish_operation(db, FSEARCH_OPERATION_SCAN, &timer, num_entries, num_entries);
+    }
+    return res;
+}
+
+typedef struct {
+    FsearchDatabase *db;
+    FsearchDatabase *old_db;
+    FsearchIndex *only_index;
+    GCancellable *cancellable;
+    void (*status_cb)(const char *);
+    bool res;
+} DatabaseThrottledScan;
+
+static gpointer
+db_throttled_scan_thread(gpointer data) {
+    DatabaseThrottledScan *ctx = data;
+    // the thread exits after the scan, so its priority never has to be raised again
+    fsearch_scan_throttle_lower_thread_priority();
+    ctx->res = ctx->old_db ? db_rescan_run(ctx->db, ctx->old_db, ctx->only_index, ctx->cancellable, ctx->status_cb)
+                           : db_scan_run(ctx->db, ctx->cancellable, ctx->status_cb);
+    return NULL;
+}
+
+// Paced scans walk the filesystem on a thread of their own with idle I/O and the lowest CPU priority, sorting the
+// entries afterwards still happens on the thread pool of the database
+static bool
+db_throttled_scan(FsearchDatabase *db,
+                  FsearchDatabase *old_db,
+                  FsearchIndex *only_index,
+                  GCancellable *cancellable,
+                  void (*status_cb)(const char *)) {
+    DatabaseThrottledScan ctx = {
+        .db = db,
+        .old_db = old_db,
+        .only_index = only_index,
+        .cancellable = cancellable,
+        .status_cb = status_cb,
+    };
+    GThread *thread = g_thread_new("fsearch_throttled_scan", db_throttled_scan_thread, &ctx);
+    g_thread_join(thread);
+    return ctx.res;
+}
+
+bool
+db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *)) {
     g_assert(db);
-    return db_get_num_files(db) + db_get_num_folders(db);
+    if (db->scan_throttle) {
+        return db_throttled_scan(db, NULL, NULL, cancellable, status_cb);
+    }
+    return db_scan_run(db, cancellable, status_cb);
+}
+
+bool
+db_rescan(FsearchDatabase *db, FsearchDatabase *old_db, GCancellable *cancellable, void (*status_cb)(const char *)) {
+    g_assert(db);
+    if (db->scan_throttle) {
+        return db_throttled_scan(db, old_db, NULL, cancellable, status_cb);
+    }
+    return db_rescan_run(db, old_db, NULL, cancellable, status_cb);
+}
+
+bool
+db_rescan_index(FsearchDatabase *db,
+                FsearchDatabase *old_db,
+                FsearchIndex *index,
+                GCancellable *cancellable,
+                void (*status_cb)(const char *)) {
+    g_assert(db);
+    g_assert(index);
+    if (db->scan_throttle) {
+        return db_throttled_scan(db, old_db, index, cancellable, status_cb);
+    }
+    return db_rescan_run(db, old_db, index, cancellable, status_cb);
+}
+
+#define DATABASE_UPDATE_MARK_REMOVED 1
+#define DATABASE_UPDATE_MARK_MOVED 2
+
+typedef struct {
+    off_t size;
+    time_t mtime;
+    // the optional times in the order of db_optional_times
+    time_t times[G_N_ELEMENTS(db_optional_times)];
+    uint16_t user_id;
+    uint16_t group_id;
+    uint16_t mode;
+} DatabaseUpdateEntryValues;
+
+typedef struct DatabaseUpdateContext {
+    FsearchDatabase *db;
+
+    // entries which were created by this update
+    DynamicArray *new_files;
+    DynamicArray *new_folders;
+
+    // entries whose size or modification time changed and whose position
+    // in the size and modification time indexes has to be updated
+    GPtrArray *moved;
+    // all entries which were marked, so their marks can be reset at the end
+    GPtrArray *marked;
+    // the size and modification time of the marked entries before the update, in the same order
+    GArray *marked_values;
+
+    uint32_t num_removed;
+} DatabaseUpdateContext;
+
+static FsearchDatabaseEntry *
+db_find_child(DynamicArray *sorted_by_path,
+              FsearchDatabaseEntryFolder *parent,
+              const char *name,
+              FsearchDatabaseEntryType type) {
+    if (!sorted_by_path) {
+        return NULL;
+    }
+    FsearchDatabaseEntry *needle = db_entry_get_dummy_for_name_and_parent(parent, name, type);
+
+    FsearchDatabaseEntry *child = NULL;
+    uint32_t idx = 0;
+    if (darray_binary_search_with_data(sorted_by_path,
+                                       needle,
+                                       (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path,
+                                       NULL,
+                                       &idx)) {
+        child = darray_get_item(sorted_by_path, idx);
+    }
+    g_clear_pointer(&needle, db_entry_free_dummy);
+    return child;
+}
+
+static FsearchDatabaseEntryFolder *
+db_find_folder_for_path(FsearchDatabase *db, const char *path) {
+    DynamicArray *folders = db->sorted_folders[DATABASE_INDEX_TYPE_PATH];
+    if (!folders) {
+        return NULL;
+    }
+
+    // Root folders don't have a parent and are sorted in front of all other folders.
+    // Their name is the full path of the index, or an empty string for "/".
+    FsearchDatabaseEntryFolder *folder = NULL;
+    size_t root_len = 0;
+    const uint32_t num_folders = darray_get_num_items(folders);
+    for (uint32_t i = 0; i < num_folders; i++) {
+        FsearchDatabaseEntry *root = darray_get_item(folders, i);
+        if (db_entry_get_parent(root)) {
+            break;
+        }
+        const char *root_name = db_entry_get_name_raw(root);
+        const size_t len = strlen(root_name);
+        if (strncmp(path, root_name, len) != 0 || (path[len] != G_DIR_SEPARATOR && path[len] != '\0')) {
+            continue;
+        }
+        if (!folder || len > root_len) {
+            folder = (FsearchDatabaseEntryFolder *)root;
+            root_len = len;
+        }
+    }
+
+    if (!folder) {
+        return NULL;
+    }
+
+    g_auto(GStrv) components = g_strsplit(path + root_len, G_DIR_SEPARATOR_S, -1);
+    for (uint32_t i = 0; folder && components[i]; i++) {
+        if (db_entry_get_mark((FsearchDatabaseEntry *)folder) == DATABASE_UPDATE_MARK_REMOVED) {
+            // the folder was removed by the current update
+            return NULL;
+        }
+        if (components[i][0] == '\0') {
+            continue;
+        }
+        folder = (FsearchDatabaseEntryFolder *)db_find_child(folders, folder, components[i], DATABASE_ENTRY_TYPE_FOLDER);
+    }
+    if (folder && db_entry_get_mark((FsearchDatabaseEntry *)folder) == DATABASE_UPDATE_MARK_REMOVED) {
+        return NULL;
+    }
+    return folder;
+}
+
+static FsearchIndex *
+db_find_index_for_path(FsearchDatabase *db, const char *path) {
+    FsearchIndex *index = NULL;
+    size_t index_len = 0;
+    for (GList *l = db->indexes; l != NULL; l = l->next) {
+        FsearchIndex *fs_path = l->data;
+        if (!fs_path->path || !fs_path->enabled) {
+            continue;
+        }
+        const size_t len = strlen(fs_path->path);
+        if (!g_str_has_prefix(path, fs_path->path)) {
+            continue;
+        }
+        if (len > 1 && path[len] != G_DIR_SEPARATOR && path[len] != '\0') {
+            continue;
+        }
+        if (!index || len > index_len) {
+            index = fs_path;
+            index_len = len;
+        }
+    }
+    return index;
+}
+
+static void
+db_update_get_optional_values(FsearchDatabaseEntry *entry, DatabaseUpdateEntryValues *values) {
+    for (uint32_t i = 0; i < G_N_ELEMENTS(db_optional_times); i++) {
+        values->times[i] = db_entry_get_time(entry, db_optional_times[i].type);
+    }
+    values->user_id = db_entry_get_user_id(entry);
+    values->group_id = db_entry_get_group_id(entry);
+    values->mode = db_entry_get_mode(entry);
+}
+
+// Entries must be marked before their size or any of their times change, so their old position in the indexes
+// can still be found, see db_update_sorted_arrays
+static void
+db_update_mark(DatabaseUpdateContext *ctx, FsearchDatabaseEntry *entry, uint8_t mark) {
+    const uint8_t current_mark = db_entry_get_mark(entry);
+    if (current_mark == DATABASE_UPDATE_MARK_REMOVED || current_mark == mark) {
+        return;
+    }
+    if (current_mark == 0) {
+        g_ptr_array_add(ctx->marked, entry);
+        DatabaseUpdateEntryValues values = {
+            .size = db_entry_get_size(entry),
+            .mtime = db_entry_get_mtime(entry),
+        };
+        db_update_get_optional_values(entry, &values);
+        g_array_append_val(ctx->marked_values, values);
+    }
+    if (mark == DATABASE_UPDATE_MARK_MOVED) {
+        g_ptr_array_add(ctx->moved, entry);
+    }
+    db_entry_set_mark(entry, mark);
+}
+
+static void
+db_update_mark_parents_moved(DatabaseUpdateContext *ctx, FsearchDatabaseEntry *entry) {
+    // the size of every parent folder changes too
+    FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+    while (parent) {
+        db_update_mark(ctx, (FsearchDatabaseEntry *)parent, DATABASE_UPDATE_MARK_MOVED);
+        parent = db_entry_get_parent((FsearchDatabaseEntry *)parent);
+    }
+}
+
+static void
+db_update_remove_entry(DatabaseUpdateContext *ctx, FsearchDatabaseEntry *entry) {
+    if (db_entry_get_mark(entry) == DATABASE_UPDATE_MARK_REMOVED) {
+        return;
+    }
+    db_update_mark_parents_moved(ctx, entry);
+    db_update_mark(ctx, entry, DATABASE_UPDATE_MARK_REMOVED);
+    // Views might still reference the entry, so it stays allocated until the database gets freed
+    db_entry_detach_from_parent(entry);
+    ctx->num_removed++;
+}
+
+static void
+db_update_read_xattrs(FsearchDatabase *db, FsearchDatabaseEntry *entry, const char *path) {
+    if (db_folder_wants_xattrs(db, path)) {
+        g_autoptr(GString) xattrs = g_string_new(NULL);
+        db_entry_read_xattrs(db, entry, path, xattrs);
+    }
+}
+
+static void
+db_update_add_entry(DatabaseUpdateContext *ctx,
+                    FsearchDatabaseEntryFolder *parent,
+                    const char *path,
+                    const char *name,
+                    const FsearchDirectoryEntryStat *st) {
+    FsearchDatabase *db = ctx->db;
+
+    if (!st->is_folder) {
+        FsearchDatabaseEntry *file_entry = fsearch_memory_pool_malloc(db->file_pool);
+        db_entry_set_pooled_name(ctx->db->name_pool, file_entry, name, strlen(name));
+        db_entry_set_size(file_entry, st->size);
+        db_entry_set_mtime(file_entry, st->mtime);
+        db_entry_set_type(file_entry, DATABASE_ENTRY_TYPE_FILE);
+        db_entry_init_stat_values(db, file_entry, st);
+        db_update_read_xattrs(db, file_entry, path);
+        db_entry_set_parent(file_entry, parent);
+        db_update_mark_parents_moved(ctx, file_entry);
+        db_entry_update_parent_size(file_entry);
+
+        darray_add_item(ctx->new_files, file_entry);
+        return;
+    }
+
+    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(db->folder_pool);
+    db_entry_set_pooled_name(ctx->db->name_pool, entry, name, strlen(name));
+    db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+    db_entry_set_mtime(entry, st->mtime);
+    db_entry_init_stat_values(db, entry, st);
+    db_update_read_xattrs(db, entry, path);
+    db_entry_set_parent(entry, parent);
+    // the sizes of the files below it get added to the parents
+    db_update_mark_parents_moved(ctx, entry);
+
+    darray_add_item(ctx->new_folders, entry);
+
+    // The folder might have been moved here with all its content, so everything below it has to be scanned
+    FsearchIndex *index = db_find_index_for_path(db, path);
+    struct stat root_st = {};
+    if (index && lstat(index->path, &root_st)) {
+        g_debug("[db_update] can't stat: %s", index->path);
+    }
+
+    g_autoptr(GString) walk_path = g_string_new(path);
+    g_autoptr(GTimer) timer = g_timer_new();
+    DatabaseWalkContext walk_context = {
+        .db = db,
+        .folders = ctx->new_folders,
+        .files = ctx->new_files,
+        .path = walk_path,
+        .timer = timer,
+        .cancellable = NULL,
+        .status_cb = NULL,
+        .root_device_id = root_st.st_dev,
+        .one_filesystem = index ? index->one_filesystem : false,
+        .exclude_hidden = db->exclude_hidden,
+        // the new folder is already attached to the tree
+        .update_folder_sizes = true,
+    };
+    db_folder_scan_recursive(&walk_context, (FsearchDatabaseEntryFolder *)entry);
+}
+
+static void
+db_update_path(DatabaseUpdateContext *ctx, const char *path) {
+    FsearchDatabase *db = ctx->db;
+
+    g_autofree char *parent_path = g_path_get_dirname(path);
+    g_autofree char *name = g_path_get_basename(path);
+
+    FsearchDatabaseEntryFolder *parent = db_find_folder_for_path(db, parent_path);
+    if (!parent) {
+        // Either the path isn't part of the database or one of its parent folders was created or removed
+        // by this update, in which case the path was already taken care of.
+        return;
+    }
+
+    FsearchDatabaseEntry *entry =
+        db_find_child(db->sorted_files[DATABASE_INDEX_TYPE_PATH], parent, name, DATABASE_ENTRY_TYPE_FILE);
+    if (!entry) {
+        entry = db_find_child(db->sorted_folders[DATABASE_INDEX_TYPE_PATH], parent, name, DATABASE_ENTRY_TYPE_FOLDER);
+    }
+    if (entry && db_entry_get_mark(entry) == DATABASE_UPDATE_MARK_REMOVED) {
+        entry = NULL;
+    }
+
+    int stat_flags = AT_SYMLINK_NOFOLLOW;
+#ifdef AT_NO_AUTOMOUNT
+    stat_flags |= AT_NO_AUTOMOUNT;
+#endif
+    // adding or removing an entry changes the modification time of its parent folder
+    struct stat parent_st;
+    if (!fstatat(AT_FDCWD, parent_path, &parent_st, stat_flags)
+        && db_entry_get_mtime((FsearchDatabaseEntry *)parent) != parent_st.st_mtime) {
+        db_update_mark(ctx, (FsearchDatabaseEntry *)parent, DATABASE_UPDATE_MARK_MOVED);
+        db_entry_set_mtime((FsearchDatabaseEntry *)parent, parent_st.st_mtime);
+    }
+
+    FsearchDirectoryEntryStat st;
+    bool exists = fsearch_directory_stat_path(path, db_get_stat_fields(db), &st);
+    if (exists) {
+        if ((db->exclude_hidden && name[0] == '.') || file_is_excluded(db, name, strlen(name))
+            || (st.is_folder && directory_is_excluded(db, path))) {
+            exists = false;
+        }
+    }
+
+    if (!exists) {
+        if (entry) {
+            db_update_remove_entry(ctx, entry);
+        }
+        return;
+    }
+
+    const bool is_dir = st.is_folder;
+    if (entry && db_entry_is_folder(entry) != is_dir) {
+        db_update_remove_entry(ctx, entry);
+        entry = NULL;
+    }
+
+    if (!entry) {
+        db_update_add_entry(ctx, parent, path, name, &st);
+        return;
+    }
+
+    if (db_entry_stat_values_differ(entry, &st)) {
+        db_update_mark(ctx, entry, DATABASE_UPDATE_MARK_MOVED);
+        db_entry_set_stat_values(entry, &st);
+    }
+    // no index depends on the extended attributes, so the entry doesn't need to be marked for them
+    db_update_read_xattrs(db, entry, path);
+
+    if (is_dir) {
+        // changes of the folder content are reported for the individual children
+        if (db_entry_get_mtime(entry) != st.mtime) {
+            db_update_mark(ctx, entry, DATABASE_UPDATE_MARK_MOVED);
+            db_entry_set_mtime(entry, st.mtime);
+        }
+        return;
+    }
+
+    if (db_entry_get_size(entry) != st.size || db_entry_get_mtime(entry) != st.mtime) {
+        db_update_mark(ctx, entry, DATABASE_UPDATE_MARK_MOVED);
+        db_update_mark_parents_moved(ctx, entry);
+        db_entry_update_size(entry, st.size);
+        db_entry_set_mtime(entry, st.mtime);
+    }
 }
 
-void
-db_unlock(FsearchDatabase *db) {
-    g_assert(db);
-    g_mutex_unlock(&db->mutex);
+// The block arrays order entries which are equal for an index by their idx, which is how they end up in the sorted
+// arrays too: those get sorted from the name sorted arrays with a stable sort.
+static int32_t
+db_update_compare_idx(FsearchDatabaseEntry *a, FsearchDatabaseEntry *b) {
+    const uint32_t idx_a = db_entry_get_idx(a);
+    const uint32_t idx_b = db_entry_get_idx(b);
+    return idx_a < idx_b ? -1 : idx_a > idx_b;
 }
 
-void
-db_lock(FsearchDatabase *db) {
-    g_assert(db);
-    g_mutex_lock(&db->mutex);
+static int32_t
+db_update_compare_by_name(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const int32_t res = db_entry_compare_entries_by_name(a, b);
+    return res ? res : db_update_compare_idx(*a, *b);
 }
 
-bool
-db_try_lock(FsearchDatabase *db) {
-    g_assert(db);
-    return g_mutex_trylock(&db->mutex);
+static int32_t
+db_update_compare_by_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const int32_t res = db_entry_compare_entries_by_path(a, b);
+    return res ? res : db_update_compare_idx(*a, *b);
 }
 
-static bool
-is_valid_sort_type(FsearchDatabaseIndexType sort_type) {
-    if (0 <= sort_type && sort_type < NUM_DATABASE_INDEX_TYPES) {
-        return true;
+static int32_t
+db_update_compare_by_size(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const off_t size_a = db_entry_get_size(*a);
+    const off_t size_b = db_entry_get_size(*b);
+    if (size_a != size_b) {
+        return size_a < size_b ? -1 : 1;
     }
-    return false;
+    return db_update_compare_idx(*a, *b);
 }
 
-bool
-db_has_entries_sorted_by_type(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
-    g_assert(db);
-
-    if (is_valid_sort_type(sort_type)) {
-        return db->sorted_folders[sort_type] ? true : false;
+static int32_t
+db_update_compare_by_modification_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const time_t mtime_a = db_entry_get_mtime(*a);
+    const time_t mtime_b = db_entry_get_mtime(*b);
+    if (mtime_a != mtime_b) {
+        return mtime_a < mtime_b ? -1 : 1;
     }
-    return false;
+    return db_update_compare_idx(*a, *b);
 }
 
-DynamicArray *
-db_get_folders_sorted_copy(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
-    g_assert(db);
-    if (!is_valid_sort_type(sort_type)) {
-        return NULL;
+static int32_t
+db_update_compare_by_time(FsearchDatabaseEntry *a, FsearchDatabaseEntry *b, FsearchDatabaseIndexType type) {
+    const time_t time_a = db_entry_get_time(a, type);
+    const time_t time_b = db_entry_get_time(b, type);
+    if (time_a != time_b) {
+        return time_a < time_b ? -1 : 1;
     }
-    DynamicArray *folders = db->sorted_folders[sort_type];
-    return folders ? darray_copy(folders) : NULL;
+    return db_update_compare_idx(a, b);
 }
 
-DynamicArray *
-db_get_files_sorted_copy(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
-    g_assert(db);
-    if (!is_valid_sort_type(sort_type)) {
-        return NULL;
-    }
-    DynamicArray *files = db->sorted_files[sort_type];
-    return files ? darray_copy(files) : NULL;
+static int32_t
+db_update_compare_by_access_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    return db_update_compare_by_time(*a, *b, DATABASE_INDEX_TYPE_ACCESS_TIME);
 }
 
-DynamicArray *
-db_get_folders_copy(FsearchDatabase *db) {
-    return db_get_folders_sorted_copy(db, DATABASE_INDEX_TYPE_NAME);
+static int32_t
+db_update_compare_by_creation_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    return db_update_compare_by_time(*a, *b, DATABASE_INDEX_TYPE_CREATION_TIME);
 }
 
-DynamicArray *
-db_get_files_copy(FsearchDatabase *db) {
-    return db_get_files_sorted_copy(db, DATABASE_INDEX_TYPE_NAME);
+static int32_t
+db_update_compare_by_status_change_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    return db_update_compare_by_time(*a, *b, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME);
 }
 
-bool
-db_get_entries_sorted(FsearchDatabase *db,
-                      FsearchDatabaseIndexType requested_sort_type,
-                      FsearchDatabaseIndexType *returned_sort_type,
-                      DynamicArray **folders,
-                      DynamicArray **files) {
-    g_assert(db);
-    g_assert(returned_sort_type);
-    g_assert(folders);
-    g_assert(files);
-    if (!is_valid_sort_type(requested_sort_type)) {
-        return false;
+static int32_t
+db_update_compare_by_owner(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const uint64_t key_a = db_entry_get_owner_sort_key(*a, NULL);
+    const uint64_t key_b = db_entry_get_owner_sort_key(*b, NULL);
+    if (key_a != key_b) {
+        return key_a < key_b ? -1 : 1;
     }
+    return db_update_compare_idx(*a, *b);
+}
 
-    FsearchDatabaseIndexType sort_type = requested_sort_type;
-    if (!db_has_entries_sorted_by_type(db, requested_sort_type)) {
-        sort_type = DATABASE_INDEX_TYPE_NAME;
+static int32_t
+db_update_compare_by_extension(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const int32_t res = db_entry_compare_entries_by_extension(a, b);
+    return res ? res : db_update_compare_idx(*a, *b);
+}
+
+static int32_t
+db_update_compare_by_type(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    const int32_t res = db_entry_compare_entries_by_type(a, b, NULL);
+    return res ? res : db_update_compare_idx(*a, *b);
+}
+
+static DynamicArrayCompareDataFunc
+db_update_get_compare_func(FsearchDatabaseIndexType type) {
+    switch (type) {
+    case DATABASE_INDEX_TYPE_NAME:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_name;
+    case DATABASE_INDEX_TYPE_PATH:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_path;
+    case DATABASE_INDEX_TYPE_SIZE:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_size;
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_modification_time;
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_access_time;
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_creation_time;
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_status_change_time;
+    case DATABASE_INDEX_TYPE_OWNER:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_owner;
+    case DATABASE_INDEX_TYPE_EXTENSION:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_extension;
+    case DATABASE_INDEX_TYPE_FILETYPE:
+        return (DynamicArrayCompareDataFunc)db_update_compare_by_type;
+    default:
+        return NULL;
     }
+}
 
-    if (!db_has_entries_sorted_by_type(db, sort_type)) {
+static bool
+db_update_index_depends_on_values(FsearchDatabaseIndexType type) {
+    switch (type) {
+    case DATABASE_INDEX_TYPE_SIZE:
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+    case DATABASE_INDEX_TYPE_OWNER:
+        return true;
+    default:
         return false;
     }
-
-    *folders = darray_ref(db->sorted_folders[sort_type]);
-    *files = darray_ref(db->sorted_files[sort_type]);
-    *returned_sort_type = sort_type;
-    return true;
 }
 
-DynamicArray *
-db_get_folders_sorted(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
-    g_assert(db);
-    if (!is_valid_sort_type(sort_type)) {
-        return NULL;
+// Swaps the current size and times of the marked entries with the ones from before the update
+static void
+db_update_swap_marked_values(DatabaseUpdateContext *ctx) {
+    for (uint32_t i = 0; i < ctx->marked->len; i++) {
+        FsearchDatabaseEntry *entry = g_ptr_array_index(ctx->marked, i);
+        DatabaseUpdateEntryValues *values = &g_array_index(ctx->marked_values, DatabaseUpdateEntryValues, i);
+        DatabaseUpdateEntryValues current = {
+            .size = db_entry_get_size(entry),
+            .mtime = db_entry_get_mtime(entry),
+        };
+        db_update_get_optional_values(entry, &current);
+        db_entry_set_size(entry, values->size);
+        db_entry_set_mtime(entry, values->mtime);
+        for (uint32_t j = 0; j < G_N_ELEMENTS(db_optional_times); j++) {
+            db_entry_set_time(entry, db_optional_times[j].type, values->times[j]);
+        }
+        db_entry_set_owner_ids(entry, values->user_id, values->group_id, values->mode);
+        *values = current;
     }
+}
 
-    DynamicArray *folders = db->sorted_folders[sort_type];
-    return darray_ref(folders);
+static void
+db_update_insert_entries(DatabaseUpdateContext *ctx,
+                         FsearchBlockArray *blocks,
+                         DynamicArray *new_entries,
+                         FsearchDatabaseEntryType entry_type,
+                         FsearchDatabaseIndexType index_type) {
+    const uint32_t num_new_entries = darray_get_num_items(new_entries);
+    for (uint32_t i = 0; i < num_new_entries; i++) {
+        fsearch_block_array_insert(blocks, darray_get_item(new_entries, i));
+    }
+    if (!db_update_index_depends_on_values(index_type)) {
+        return;
+    }
+    for (uint32_t i = 0; i < ctx->moved->len; i++) {
+        FsearchDatabaseEntry *entry = g_ptr_array_index(ctx->moved, i);
+        if (db_entry_get_type(entry) == entry_type && db_entry_get_mark(entry) == DATABASE_UPDATE_MARK_MOVED) {
+            fsearch_block_array_insert(blocks, entry);
+        }
+    }
 }
 
-DynamicArray *
-db_get_files_sorted(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
-    g_assert(db);
-    if (!is_valid_sort_type(sort_type)) {
-        return NULL;
+// Applies the changes of the update to the block arrays of all indexes, which get created from the sorted arrays
+// first if needed. That way only the changed entries have to be sorted in, instead of merging them with all others.
+// Folders don't have their own extension and type sorted arrays, see db_update_paths.
+static void
+db_update_sorted_arrays(DatabaseUpdateContext *ctx) {
+    FsearchDatabase *db = ctx->db;
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    // the block arrays rely on the idx being the position in the name arrays from before the update
+    db_entry_update_folder_indices(db);
+    db_entry_update_file_indices(db);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        DynamicArrayCompareDataFunc func = db_update_get_compare_func(i);
+        if (!db->file_blocks[i] && db->sorted_files[i]) {
+            db->file_blocks[i] = fsearch_block_array_new(db->sorted_files[i], func, NULL);
+        }
+        const bool has_folder_blocks = i != DATABASE_INDEX_TYPE_EXTENSION && i != DATABASE_INDEX_TYPE_FILETYPE;
+        if (has_folder_blocks && !db->folder_blocks[i] && db->sorted_folders[i]) {
+            db->folder_blocks[i] = fsearch_block_array_new(db->sorted_folders[i], func, NULL);
+        }
     }
 
-    DynamicArray *files = db->sorted_files[sort_type];
-    return darray_ref(files);
+    // The entries are still sorted by their old size and times, so that's what they need while
+    // they get removed
+    db_update_swap_marked_values(ctx);
+    for (uint32_t i = 0; i < ctx->marked->len; i++) {
+        FsearchDatabaseEntry *entry = g_ptr_array_index(ctx->marked, i);
+        const uint8_t mark = db_entry_get_mark(entry);
+        FsearchBlockArray **blocks = db_entry_is_folder(entry) ? db->folder_blocks : db->file_blocks;
+        for (uint32_t j = 0; j < NUM_DATABASE_INDEX_TYPES; j++) {
+            if (blocks[j]
+                && (mark == DATABASE_UPDATE_MARK_REMOVED
+                    || (mark == DATABASE_UPDATE_MARK_MOVED && db_update_index_depends_on_values(j)))) {
+                fsearch_block_array_remove(blocks[j], entry);
+            }
+        }
+    }
+    db_update_swap_marked_values(ctx);
+
+    // The name arrays determine the idx of the new entries, which the other indexes need, so they get updated
+    // first. Together with the path arrays, which are used to look up entries, they're always needed.
+    const FsearchDatabaseIndexType eager_types[] = {
+        DATABASE_INDEX_TYPE_NAME,
+        DATABASE_INDEX_TYPE_PATH,
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(eager_types); i++) {
+        const FsearchDatabaseIndexType type = eager_types[i];
+        g_clear_pointer(&db->sorted_files[type], darray_unref);
+        if (db->file_blocks[type]) {
+            db_update_insert_entries(ctx, db->file_blocks[type], ctx->new_files, DATABASE_ENTRY_TYPE_FILE, type);
+            db->sorted_files[type] = fsearch_block_array_to_darray(db->file_blocks[type]);
+        }
+        g_clear_pointer(&db->sorted_folders[type], darray_unref);
+        if (db->folder_blocks[type]) {
+            db_update_insert_entries(ctx, db->folder_blocks[type], ctx->new_folders, DATABASE_ENTRY_TYPE_FOLDER, type);
+            db->sorted_folders[type] = fsearch_block_array_to_darray(db->folder_blocks[type]);
+        }
+        if (type == DATABASE_INDEX_TYPE_NAME) {
+            db_entry_update_folder_indices(db);
+            db_entry_update_file_indices(db);
+        }
+    }
+
+    // the other sorted arrays get created from the block arrays once they're requested
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        if (i == DATABASE_INDEX_TYPE_NAME || i == DATABASE_INDEX_TYPE_PATH) {
+            continue;
+        }
+        if (db->file_blocks[i]) {
+            db_update_insert_entries(ctx, db->file_blocks[i], ctx->new_files, DATABASE_ENTRY_TYPE_FILE, i);
+            g_clear_pointer(&db->sorted_files[i], darray_unref);
+        }
+        if (db->folder_blocks[i]) {
+            db_update_insert_entries(ctx, db->folder_blocks[i], ctx->new_folders, DATABASE_ENTRY_TYPE_FOLDER, i);
+            g_clear_pointer(&db->sorted_folders[i], darray_unref);
+        }
+    }
+    g_debug("[db_update] updated sorted arrays in %f s", g_timer_elapsed(timer, NULL));
 }
 
-DynamicArray *
-db_get_files(FsearchDatabase *db) {
-    g_assert(db);
-    return db_get_files_sorted(db, DATABASE_INDEX_TYPE_NAME);
+static void
+db_update_mark_removed_children(DatabaseUpdateContext *ctx, DynamicArray *entries) {
+    // Parents are always sorted in front of their children by path,
+    // so the removal propagates through whole subtrees in a single pass.
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+        if (!parent || db_entry_get_mark((FsearchDatabaseEntry *)parent) != DATABASE_UPDATE_MARK_REMOVED) {
+            continue;
+        }
+        if (db_entry_get_mark(entry) != DATABASE_UPDATE_MARK_REMOVED) {
+            db_update_mark(ctx, entry, DATABASE_UPDATE_MARK_REMOVED);
+            ctx->num_removed++;
+        }
+    }
 }
 
-DynamicArray *
-db_get_folders(FsearchDatabase *db) {
-    g_assert(db);
-    return db_get_folders_sorted(db, DATABASE_INDEX_TYPE_NAME);
+static gint
+compare_path_strings(const char **p1, const char **p2) {
+    return strcmp(*p1, *p2);
 }
 
-FsearchThreadPool *
-db_get_thread_pool(FsearchDatabase *db) {
-    g_assert(db);
-    return db->thread_pool;
+static void
+db_journal_append(FsearchDatabase *db, GPtrArray *paths) {
+    if (!db->journal || !db->save_dir) {
+        return;
+    }
+    if (!db_journal_append_paths(db->journal, paths)) {
+        g_debug("[db_update] failed to append to journal");
+    }
+
+    const time_t first_record_time = db_journal_get_first_record_time(db->journal);
+    const bool too_old = first_record_time > 0 && time(NULL) - first_record_time > DATABASE_JOURNAL_MAX_AGE;
+    if (!db->background_save_pending && (db_journal_get_size(db->journal) > DATABASE_JOURNAL_MAX_SIZE || too_old)) {
+        g_debug("[db_update] compacting journal into a new database file");
+        db_save_in_background(db, db->save_dir);
+    }
 }
 
 bool
-db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *)) {
+db_update_paths(FsearchDatabase *db, GPtrArray *paths) {
     g_assert(db);
+    g_assert(paths);
 
-    bool ret = false;
+    if (paths->len == 0) {
+        return false;
+    }
 
-    db_sorted_entries_free(db);
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_timer_start(timer);
 
-    db->index_flags |= DATABASE_INDEX_FLAG_NAME;
-    db->index_flags |= DATABASE_INDEX_FLAG_SIZE;
-    db->index_flags |= DATABASE_INDEX_FLAG_MODIFICATION_TIME;
+    // Process every path only once and parents before their children
+    g_autoptr(GHashTable) unique_paths = g_hash_table_new(g_str_hash, g_str_equal);
+    g_autoptr(GPtrArray) sorted_paths = g_ptr_array_sized_new(paths->len);
+    for (uint32_t i = 0; i < paths->len; i++) {
+        char *path = g_ptr_array_index(paths, i);
+        if (path && g_hash_table_add(unique_paths, path)) {
+            g_ptr_array_add(sorted_paths, path);
+        }
+    }
+    g_ptr_array_sort(sorted_paths, (GCompareFunc)compare_path_strings);
 
-    db->sorted_files[DATABASE_INDEX_TYPE_NAME] = darray_new(1024);
-    db->sorted_folders[DATABASE_INDEX_TYPE_NAME] = darray_new(1024);
+    db_lock(db);
 
-    for (GList *l = db->indexes; l != NULL; l = l->next) {
-        FsearchIndex *fs_path = l->data;
-        if (!fs_path->path) {
-            continue;
-        }
-        if (!fs_path->enabled) {
-            continue;
-        }
-        if (fs_path->update) {
-            ret = db_scan_folder(db, fs_path->path, fs_path->one_filesystem, cancellable, status_cb) || ret;
-        }
-        if (is_cancelled(cancellable)) {
-            return false;
+    // the name sorted arrays are about to change
+    db_load_all_pending_sorted_arrays(db);
+
+    if (!db->sorted_files[DATABASE_INDEX_TYPE_PATH] || !db->sorted_folders[DATABASE_INDEX_TYPE_PATH]) {
+        // no way to look up entries by their path
+        db_unlock(db);
+        return false;
+    }
+
+    DatabaseUpdateContext ctx = {
+        .db = db,
+        .new_files = darray_new(128),
+        .new_folders = darray_new(128),
+        .moved = g_ptr_array_new(),
+        .marked = g_ptr_array_new(),
+        .marked_values = g_array_new(FALSE, FALSE, sizeof(DatabaseUpdateEntryValues)),
+    };
+
+    for (uint32_t i = 0; i < sorted_paths->len; i++) {
+        db_update_path(&ctx, g_ptr_array_index(sorted_paths, i));
+    }
+
+    const bool changed = ctx.marked->len > 0 || darray_get_num_items(ctx.new_files) > 0
+                      || darray_get_num_items(ctx.new_folders) > 0;
+    if (changed) {
+        db_update_mark_removed_children(&ctx, db->sorted_folders[DATABASE_INDEX_TYPE_PATH]);
+        db_update_mark_removed_children(&ctx, db->sorted_files[DATABASE_INDEX_TYPE_PATH]);
+
+        // The sorted arrays might be shared with views, so instead of modifying them in place
+        // new arrays get created, which replace the old ones.
+        db_update_sorted_arrays(&ctx);
+        // Folders don't have a file extension or type -> use the name array instead
+        const FsearchDatabaseIndexType name_sorted_folder_types[] = {
+            DATABASE_INDEX_TYPE_EXTENSION,
+            DATABASE_INDEX_TYPE_FILETYPE,
+        };
+        for (uint32_t i = 0; i < G_N_ELEMENTS(name_sorted_folder_types); i++) {
+            const FsearchDatabaseIndexType type = name_sorted_folder_types[i];
+            if (db->sorted_folders[type]) {
+                g_clear_pointer(&db->sorted_folders[type], darray_unref);
+                db->sorted_folders[type] = darray_ref(db->sorted_folders[DATABASE_INDEX_TYPE_NAME]);
+            }
         }
+        db_entry_update_folder_indices(db);
+        db_compact_sorted_entries(db);
+        db_update_trigram_indexes(db, ctx.new_folders, ctx.new_files);
+        db_update_name_indexes(db, ctx.new_folders, ctx.new_files);
+        db_build_folder_paths(db);
+        db_build_folded_names(db);
+        db_build_subtree_filter(db);
+
+        db->num_stale_entries += ctx.num_removed;
+        db_update_timestamp(db);
+        // All sorted arrays were replaced, so the entry columns of the previous ones, which might be outdated by
+        // sizes and modification times that were updated in place, go away with them. Readers of the previous
+        // snapshot keep using those until they're done.
+        db_publish_snapshot(db);
     }
-    if (status_cb) {
-        status_cb(_("Sorting…"));
+
+    for (uint32_t i = 0; i < ctx.marked->len; i++) {
+        db_entry_set_mark(g_ptr_array_index(ctx.marked, i), 0);
     }
-    db_sort(db, cancellable);
-    if (is_cancelled(cancellable)) {
-        return false;
+
+    db_journal_append(db, sorted_paths);
+
+    g_debug("[db_update] %d paths: %d new files, %d new folders, %d removed, %d moved in %f s",
+            sorted_paths->len,
+            darray_get_num_items(ctx.new_files),
+            darray_get_num_items(ctx.new_folders),
+            ctx.num_removed,
+            ctx.moved->len,
+            g_timer_elapsed(timer, NULL));
+
+    g_clear_pointer(&ctx.new_files, darray_unref);
+    g_clear_pointer(&ctx.new_folders, darray_unref);
+    g_clear_pointer(&ctx.moved, g_ptr_array_unref);
+    g_clear_pointer(&ctx.marked, g_ptr_array_unref);
+    g_clear_pointer(&ctx.marked_values, g_array_unref);
+
+    GList *views = changed ? g_list_copy_deep(db->db_views, (GCopyFunc)db_view_ref, NULL) : NULL;
+
+    db_unlock(db);
+
+    // let all views run their current query again
+    for (GList *v = views; v != NULL; v = v->next) {
+        db_view_refresh(v->data);
     }
-    return ret;
+    g_list_free_full(g_steal_pointer(&views), (GDestroyNotify)db_view_unref);
+
+    return changed;
 }
 
 FsearchDatabase *
@@ -1659,6 +7309,70 @@ db_ref(FsearchDatabase *db) {
     return db;
 }
 
+// Replaced databases are freed one after the other by a single thread
+static GMutex free_queue_mutex;
+static FsearchTaskQueue *free_queue = NULL;
+
+static gpointer
+db_free_task(gpointer data, GCancellable *cancellable) {
+    fsearch_scan_throttle_lower_thread_priority();
+    FsearchDatabase *db = data;
+    g_clear_pointer(&db, db_free);
+    return NULL;
+}
+
+static void
+db_free_task_cancelled(gpointer data) {
+    FsearchDatabase *db = data;
+    g_clear_pointer(&db, db_free);
+}
+
+static void
+db_free_task_finished(gpointer result, gpointer data) {
+}
+
+static void
+db_free_in_background(FsearchDatabase *db) {
+    // the journal file gets closed right away, so it doesn't stay open behind the one of the new database
+    db_lock(db);
+    g_clear_pointer(&db->journal, db_journal_close);
+    db_unlock(db);
+
+    g_mutex_lock(&free_queue_mutex);
+    if (!free_queue) {
+        free_queue = fsearch_task_queue_new("fsearch_free_queue");
+    }
+    fsearch_task_queue(free_queue,
+                       FSEARCH_TASK_ID_FREE,
+                       db_free_task,
+                       db_free_task_finished,
+                       db_free_task_cancelled,
+                       FSEARCH_TASK_CLEAR_NONE,
+                       FSEARCH_TASK_PRIORITY_FREE,
+                       db);
+    g_mutex_unlock(&free_queue_mutex);
+}
+
+static void
+db_release(FsearchDatabase *db) {
+    db_lock(db);
+    const bool save_pending = db->background_save_pending || db->background_indexes_pending;
+    db_unlock(db);
+    if (db->release_on_exit && !save_pending) {
+        // flushes the last changes, everything else is released by the system much faster than by db_free
+        g_debug("[db_unref] released on exit");
+        db_lock(db);
+        g_clear_pointer(&db->journal, db_journal_close);
+        db_unlock(db);
+    }
+    else if (db->free_in_background) {
+        db_free_in_background(db);
+    }
+    else {
+        db_free(db);
+    }
+}
+
 void
 db_unref(FsearchDatabase *db) {
     if (!db || g_atomic_int_get(&db->ref_count) <= 0) {
@@ -1666,6 +7380,24 @@ db_unref(FsearchDatabase *db) {
     }
     g_debug("[db_unref] dropped to: %d", db->ref_count - 1);
     if (g_atomic_int_dec_and_test(&db->ref_count)) {
-        g_clear_pointer(&db, db_free);
+        g_clear_pointer(&db, db_release);
+    }
+}
+
+void
+db_unref_in_background(FsearchDatabase *db) {
+    if (!db) {
+        return;
+    }
+    db->free_in_background = true;
+    db_unref(db);
+}
+
+void
+db_unref_on_exit(FsearchDatabase *db) {
+    if (!db) {
+        return;
     }
+    db->release_on_exit = true;
+    db_unref(db);
 }
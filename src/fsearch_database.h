@@ -19,8 +19,18 @@
 #pragma once
 
 #include "fsearch_array.h"
+#include "fsearch_database_compression.h"
 #include "fsearch_database_index.h"
+#include "fsearch_folded_names.h"
+#include "fsearch_folder_paths.h"
+#include "fsearch_index.h"
+#include "fsearch_name_index.h"
+#include "fsearch_operation_stats.h"
+#include "fsearch_scan_throttle.h"
+#include "fsearch_shared_results.h"
+#include "fsearch_subtree_filter.h"
 #include "fsearch_thread_pool.h"
+#include "fsearch_trigram_index.h"
 
 #include <gio/gio.h>
 #include <glib.h>
@@ -29,29 +39,204 @@
 
 typedef struct FsearchDatabase FsearchDatabase;
 
+// An immutable version of the sorted arrays and indexes of a database. Every change of the database publishes a new
+// snapshot, which shares everything that didn't change with the previous one. Readers which hold a reference to a
+// snapshot can use it without the database lock while the database gets updated, and the arrays and indexes which
+// were replaced are released with the last snapshot that uses them.
+typedef struct FsearchDatabaseSnapshot FsearchDatabaseSnapshot;
+
+// The number of bytes allocated for the parts of a database and its views
+typedef struct {
+    // the entries and their names, including the ones of previous databases they're shared with
+    size_t entries;
+    size_t names;
+    // the sorted arrays of every index type and the block arrays which keep them up to date
+    size_t sorted_arrays[NUM_DATABASE_INDEX_TYPES];
+    size_t trigram_indexes;
+    size_t name_indexes;
+    size_t folder_paths;
+    size_t folded_names;
+    size_t subtree_filters;
+    // the attribute columns searches attach to the arrays they filter
+    size_t entry_columns;
+    // the results, selections and cached results of all registered views
+    size_t view_results;
+    size_t view_selections;
+    size_t view_result_caches;
+} FsearchDatabaseMemoryUsage;
+
 bool
 db_register_view(FsearchDatabase *db, gpointer view);
 
 bool
 db_unregister_view(FsearchDatabase *db, gpointer view);
 
+// Reports the percentage of the entries which are loaded through status_cb. A cancelled load returns false and
+// leaves the database empty. The file is mapped to avoid reading it into a buffer first, but all entries and names
+// get copied into the memory of the database, only sorted arrays other than the name ones are decoded on first use.
+bool
+db_load(FsearchDatabase *db, const char *path, GCancellable *cancellable, void (*status_cb)(const char *));
+
+// Updates db based on the content of old_db: only folders whose modification time, inode or status change time
+// changed are read again, everything else is carried over. Each index is handled on its own: new or changed indexes are scanned
+// from scratch and indexes which aren't marked for updates are carried over as they are.
+// Falls back to db_scan if the exclude settings of old_db are different.
 bool
-db_load(FsearchDatabase *db, const char *path, void (*status_cb)(const char *));
+db_rescan(FsearchDatabase *db, FsearchDatabase *old_db, GCancellable *cancellable, void (*status_cb)(const char *));
 
+// Like db_rescan, but only the index of db with the path of index is rescanned, even if it isn't marked for updates.
+// The other indexes are carried over from old_db without touching the filesystem, and the rescanned entries get
+// merged into the sorted arrays of old_db instead of sorting all entries again.
+bool
+db_rescan_index(FsearchDatabase *db,
+                FsearchDatabase *old_db,
+                FsearchIndex *index,
+                GCancellable *cancellable,
+                void (*status_cb)(const char *));
+
+// The database is published as soon as its entries are sorted by name and path, the other sorted arrays are built
+// in the background afterwards (the first one is set by db_set_index_priority). Registered views get notified
+// whenever one of them is done, until then they sort their results by those types on their own.
 bool
 db_scan(FsearchDatabase *db, GCancellable *cancellable, void (*status_cb)(const char *));
 
+// Brings the entries for the given paths up to date with the filesystem, i.e. entries get added, removed or updated
+// depending on whether the path exists. All sorted indexes are kept up to date and registered views get refreshed.
+bool
+db_update_paths(FsearchDatabase *db, GPtrArray *paths);
+
 FsearchDatabase *
 db_ref(FsearchDatabase *db);
 
 void
 db_unref(FsearchDatabase *db);
 
+// Like db_unref, but once the last reference is gone the database is freed by a low priority background thread, e.g.
+// the previous database after a rescan
+void
+db_unref_in_background(FsearchDatabase *db);
+
+// Like db_unref right before the process exits. Once the last reference is gone only the journal gets closed, the
+// memory of the entries, names and arrays is left to the system. Background saves must be finished by then, see
+// db_save_wait_for_background_saves.
+void
+db_unref_on_exit(FsearchDatabase *db);
+
 FsearchDatabase *
 db_new(GList *includes, GList *excludes, char **exclude_files, bool exclude_hidden);
 
+void
+db_set_num_scan_threads(FsearchDatabase *db, uint32_t num_threads);
+
+// Paces the filesystem calls of the following scans and rescans with throttle, or runs them at full speed if it's
+// NULL. Paced scans walk the filesystem on one thread with idle I/O and the lowest CPU priority.
+void
+db_set_scan_throttle(FsearchDatabase *db, FsearchScanThrottle *throttle);
+
+// Replaces the thread pool which loads, sorts and searches the entries, see fsearch_thread_pool_new_with_affinity.
+// The threads which scan the file system are also restricted to cpu_list. Must be called before the database
+// gets loaded or scanned.
+void
+db_set_worker_threads(FsearchDatabase *db, uint32_t num_threads, const char *cpu_list, bool numa_aware);
+
+// Allocate the entries from memory backed by huge pages if possible, which reduces TLB misses while searching
+// large databases. Must be called before the database gets loaded or scanned.
+void
+db_set_huge_pages(FsearchDatabase *db, bool huge_pages);
+
+// Keep the memory usage of the database itself (i.e. without its views) below memory_budget bytes, 0 for no limit.
+// Whenever it changes, sorted arrays other than the name and path ones get dropped until it fits again. Views sort
+// their results by those types on their own then.
+void
+db_set_memory_budget(FsearchDatabase *db, size_t memory_budget);
+
+// Store the names of all entries front coded once the database was scanned or loaded: every name only keeps the
+// part which differs from the name sorted before it. Saves memory at the cost of decoding names whenever they're
+// accessed. Names of entries added by later updates and rescans are stored as usual.
+void
+db_set_front_coded_names(FsearchDatabase *db, bool front_coded_names);
+
+// Store the sorted arrays as 32-bit positions into the name sorted array, instead of
+// as pointers to entries. This halves their memory usage, at the cost of an additional
+// indirection when resolving entries sorted by anything other than name.
+void
+db_set_compact_indexes(FsearchDatabase *db, bool compact_indexes);
+
+// The sorted array db_scan and db_rescan build first in the background, e.g. the one of the order views restore.
+// Also raised by views which have to sort their results on their own because the array isn't there yet.
+void
+db_set_index_priority(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
+
+// Maintain a trigram index of the entry names, which lets searches for substrings of names skip most
+// entries. It's built after scanning or loading, kept up to date by db_update_paths and saved by db_save.
+void
+db_set_trigram_indexes(FsearchDatabase *db, bool trigram_indexes);
+
+// Maintain an index of the whole entry names, which lets exact name searches (exact:) look up the entries with
+// the name instead of comparing all of them. It's built after scanning and loading and kept up to date by updates.
+void
+db_set_name_indexes(FsearchDatabase *db, bool name_indexes);
+
+// Keep the paths of all folders in memory, so the paths of entries don't have to be built from all of their
+// parents. They're built after scanning, loading and every update.
+void
+db_set_folder_path_cache(FsearchDatabase *db, bool folder_path_cache);
+
+// Keep the case folded and normalized forms of all non-ASCII names in memory, so searches which need them
+// don't have to compute them for every entry. They're built after scanning, loading and every update.
+void
+db_set_folded_name_cache(FsearchDatabase *db, bool folded_name_cache);
+
+// Keep Bloom filters of the names below every folder, which let searches for substrings of names skip whole
+// subtrees of the path sorted arrays (and of the name sorted ones, see FsearchSubtreeFilter). They're built after
+// scanning, loading and every update.
+void
+db_set_subtree_filters(FsearchDatabase *db, bool subtree_filters);
+
+// Also index the access, creation and status change times in time_flags (see DATABASE_INDEX_FLAGS_OPTIONAL_TIMES).
+// Entries only get room for the enabled ones, so every time costs 8 bytes per entry. Loaded databases keep the
+// times they were saved with until the next scan. Must be called before the database gets loaded or scanned.
+void
+db_set_optional_times(FsearchDatabase *db, FsearchDatabaseIndexFlags time_flags);
+
+// Also index the owner, group and permissions of every entry (for owner:, group: and perm:). Entries grow by one
+// slot, nothing is stored when it's disabled. Must be called before the database gets loaded or scanned.
+void
+db_set_index_owners(FsearchDatabase *db, bool index_owners);
+
+// Also index the extended attributes in names (for xattr:) of the entries below the folders in paths, or of all
+// entries if paths is NULL or empty. Entries grow by one slot, the attributes themselves are stored once for
+// all entries which share them. Passing no names disables it. Must be called before the database gets loaded or
+// scanned.
+void
+db_set_xattrs(FsearchDatabase *db, char **names, char **paths);
+
+// The compression used for the entry and sorted index blocks by db_save. Falls back to no
+// compression if support for it wasn't compiled in.
+void
+db_set_compression(FsearchDatabase *db, FsearchDatabaseCompression compression);
+
+// The database file which gets loaded is kept up to date by another process (e.g. fsearchd), so updates are only
+// applied in memory and aren't written to its journal
+void
+db_set_read_only_file(FsearchDatabase *db, bool read_only_file);
+
+// The database must be locked. Sorted arrays which are still built in the background are built right away then.
+// Reports the percentage of the entries which are written through status_cb. A cancelled save returns false and
+// leaves the current database file as it is.
 bool
-db_save(FsearchDatabase *db, const char *path);
+db_save(FsearchDatabase *db, const char *path, GCancellable *cancellable, void (*status_cb)(const char *));
+
+// Takes a snapshot of the database and writes it to path on a background thread with idle I/O
+// priority. The database must be locked. Changes which happen while the file is written are kept
+// in the journal. While sorted arrays are still built in the background, the snapshot is taken once they're done.
+void
+db_save_in_background(FsearchDatabase *db, const char *path);
+
+// Blocks until all database files which are saved in the background are written, including the ones which wait for
+// their sorted arrays to be built
+void
+db_save_wait_for_background_saves(void);
 
 time_t
 db_get_timestamp(FsearchDatabase *db);
@@ -89,6 +274,45 @@ db_get_files(FsearchDatabase *db);
 FsearchThreadPool *
 db_get_thread_pool(FsearchDatabase *db);
 
+// Shared by all views of db, it's thread safe and doesn't need the database lock
+FsearchSharedResults *
+db_get_shared_results(FsearchDatabase *db);
+
+// How the latest scan (or rescan), load or save of db went, it doesn't need the database lock
+void
+db_get_operation_stats(FsearchDatabase *db, FsearchOperation operation, FsearchOperationStats *stats);
+
+// The trigram indexes of the name sorted arrays, NULL if there are none. The database lock must be held
+// while they're used.
+FsearchTrigramIndex *
+db_get_folder_trigram_index(FsearchDatabase *db);
+
+FsearchTrigramIndex *
+db_get_file_trigram_index(FsearchDatabase *db);
+
+// The paths of the name sorted folders, NULL if there are none. The paths don't change, so they can be used
+// without the database lock while a reference is held.
+FsearchFolderPaths *
+db_get_folder_paths(FsearchDatabase *db);
+
+// The folded names of the name sorted arrays, NULL unless the folded name cache is enabled. Like the folder
+// paths they don't change, so they can be used without the database lock while a reference is held.
+FsearchFoldedNames *
+db_get_folded_names(FsearchDatabase *db);
+
+// Fills usage with what db and its registered views take up in memory. Must be called without the database lock.
+void
+db_get_memory_usage(FsearchDatabase *db, FsearchDatabaseMemoryUsage *usage);
+
+size_t
+db_memory_usage_get_total(const FsearchDatabaseMemoryUsage *usage);
+
+// Returns a report with one line per part of usage, which must be freed with g_free
+char *
+db_memory_usage_to_string(const FsearchDatabaseMemoryUsage *usage);
+
+// Sorted arrays other than the name ones might still need to be decoded from the database file. This happens on
+// the first request for them, so the database lock must be held for these functions.
 bool
 db_has_entries_sorted_by_type(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
 
@@ -110,3 +334,83 @@ db_get_folders_sorted(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
 
 DynamicArray *
 db_get_files_sorted(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
+
+// Sorts copies of the entries of db into sort_type the same way db_scan does and returns how long that took in ms,
+// or a negative time if db has no entries sorted by sort_type. Nothing in db changes, it's meant for benchmarks.
+double
+db_time_sort(FsearchDatabase *db, FsearchDatabaseIndexType sort_type);
+
+// The current snapshot of db, it's never NULL
+FsearchDatabaseSnapshot *
+db_get_snapshot(FsearchDatabase *db);
+
+FsearchDatabaseSnapshot *
+db_snapshot_ref(FsearchDatabaseSnapshot *snapshot);
+
+void
+db_snapshot_unref(FsearchDatabaseSnapshot *snapshot);
+
+// Sorted arrays other than the name ones might not have been created yet when the snapshot was published. They're
+// added on the first request as long as the snapshot is the current one of its database, which gets locked for
+// that, otherwise the snapshot doesn't have them. A reference to the database must be held while these are called.
+bool
+db_snapshot_has_entries_sorted_by_type(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type);
+
+bool
+db_snapshot_get_entries_sorted(FsearchDatabaseSnapshot *snapshot,
+                               FsearchDatabaseIndexType requested_sort_type,
+                               FsearchDatabaseIndexType *returned_sort_type,
+                               DynamicArray **folders,
+                               DynamicArray **files);
+
+DynamicArray *
+db_snapshot_get_folders_sorted(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type);
+
+DynamicArray *
+db_snapshot_get_files_sorted(FsearchDatabaseSnapshot *snapshot, FsearchDatabaseIndexType sort_type);
+
+DynamicArray *
+db_snapshot_get_folders(FsearchDatabaseSnapshot *snapshot);
+
+DynamicArray *
+db_snapshot_get_files(FsearchDatabaseSnapshot *snapshot);
+
+// The position of every entry in the sorted arrays of sort_type, indexed by the idx of the entry (its position in the
+// name sorted array, see db_entry_get_idx), so subsets of them can be sorted by a radix sort on the ranks. Entries
+// which aren't part of the snapshot have the rank UINT32_MAX. Built on the threads of pool on the first request and
+// owned by the snapshot, NULL if the snapshot has no arrays sorted by sort_type.
+const uint32_t *
+db_snapshot_get_folder_ranks(FsearchDatabaseSnapshot *snapshot,
+                             FsearchDatabaseIndexType sort_type,
+                             FsearchThreadPool *pool);
+
+const uint32_t *
+db_snapshot_get_file_ranks(FsearchDatabaseSnapshot *snapshot,
+                           FsearchDatabaseIndexType sort_type,
+                           FsearchThreadPool *pool);
+
+// These are owned by the snapshot and stay valid as long as a reference to it is held
+FsearchTrigramIndex *
+db_snapshot_get_folder_trigram_index(FsearchDatabaseSnapshot *snapshot);
+
+FsearchTrigramIndex *
+db_snapshot_get_file_trigram_index(FsearchDatabaseSnapshot *snapshot);
+
+FsearchNameIndex *
+db_snapshot_get_folder_name_index(FsearchDatabaseSnapshot *snapshot);
+
+FsearchNameIndex *
+db_snapshot_get_file_name_index(FsearchDatabaseSnapshot *snapshot);
+
+FsearchFolderPaths *
+db_snapshot_get_folder_paths(FsearchDatabaseSnapshot *snapshot);
+
+FsearchFoldedNames *
+db_snapshot_get_folded_names(FsearchDatabaseSnapshot *snapshot);
+
+FsearchSubtreeFilter *
+db_snapshot_get_subtree_filter(FsearchDatabaseSnapshot *snapshot);
+
+// Snapshots of a database are numbered consecutively
+uint64_t
+db_snapshot_get_version(FsearchDatabaseSnapshot *snapshot);
@@ -0,0 +1,199 @@
+#define G_LOG_DOMAIN "fsearch-database-compression"
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "fsearch_database_compression.h"
+
+#include <glib.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// A good trade-off between speed and size, higher levels hardly make the files any smaller
+#define DATABASE_COMPRESSION_ZSTD_LEVEL 3
+// An uint32_t takes at most 5 bytes with 7 bits per byte
+#define DATABASE_COMPRESSION_MAX_VARINT_LEN 5
+
+bool
+db_compression_is_supported(FsearchDatabaseCompression compression) {
+    switch (compression) {
+    case DATABASE_COMPRESSION_NONE:
+        return true;
+    case DATABASE_COMPRESSION_LZ4:
+#ifdef HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case DATABASE_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+uint8_t *
+db_compression_compress(FsearchDatabaseCompression compression, const uint8_t *src, size_t src_len, size_t *dest_len) {
+    g_assert(src || src_len == 0);
+    g_assert(dest_len);
+
+    uint8_t *dest = NULL;
+    switch (compression) {
+    case DATABASE_COMPRESSION_NONE:
+        dest = malloc(src_len + 1);
+        g_assert(dest);
+        if (src_len > 0) {
+            memcpy(dest, src, src_len);
+        }
+        *dest_len = src_len;
+        return dest;
+#ifdef HAVE_LZ4
+    case DATABASE_COMPRESSION_LZ4: {
+        if (src_len > LZ4_MAX_INPUT_SIZE) {
+            return NULL;
+        }
+        const int bound = LZ4_compressBound((int)src_len);
+        dest = malloc(bound + 1);
+        g_assert(dest);
+        const int res = LZ4_compress_default((const char *)src, (char *)dest, (int)src_len, bound);
+        if (res <= 0 && src_len > 0) {
+            g_debug("lz4 compression failed");
+            g_clear_pointer(&dest, free);
+            return NULL;
+        }
+        *dest_len = res;
+        return dest;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case DATABASE_COMPRESSION_ZSTD: {
+        const size_t bound = ZSTD_compressBound(src_len);
+        dest = malloc(bound + 1);
+        g_assert(dest);
+        const size_t res = ZSTD_compress(dest, bound, src, src_len, DATABASE_COMPRESSION_ZSTD_LEVEL);
+        if (ZSTD_isError(res)) {
+            g_debug("zstd compression failed: %s", ZSTD_getErrorName(res));
+            g_clear_pointer(&dest, free);
+            return NULL;
+        }
+        *dest_len = res;
+        return dest;
+    }
+#endif
+    default:
+        g_debug("compression isn't supported: %d", compression);
+        return NULL;
+    }
+}
+
+bool
+db_compression_decompress(FsearchDatabaseCompression compression,
+                          const uint8_t *src,
+                          size_t src_len,
+                          uint8_t *dest,
+                          size_t dest_len) {
+    g_assert(src || src_len == 0);
+    g_assert(dest || dest_len == 0);
+
+    switch (compression) {
+    case DATABASE_COMPRESSION_NONE:
+        if (src_len != dest_len) {
+            return false;
+        }
+        if (src_len > 0) {
+            memcpy(dest, src, src_len);
+        }
+        return true;
+#ifdef HAVE_LZ4
+    case DATABASE_COMPRESSION_LZ4: {
+        if (src_len > INT_MAX || dest_len > INT_MAX) {
+            return false;
+        }
+        if (dest_len == 0) {
+            return src_len <= 1;
+        }
+        const int res = LZ4_decompress_safe((const char *)src, (char *)dest, (int)src_len, (int)dest_len);
+        return res >= 0 && (size_t)res == dest_len;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case DATABASE_COMPRESSION_ZSTD: {
+        const size_t res = ZSTD_decompress(dest, dest_len, src, src_len);
+        return !ZSTD_isError(res) && res == dest_len;
+    }
+#endif
+    default:
+        g_debug("compression isn't supported: %d", compression);
+        return false;
+    }
+}
+
+size_t
+db_compression_get_max_encoded_indexes_size(uint32_t num_indexes) {
+    return (size_t)num_indexes * DATABASE_COMPRESSION_MAX_VARINT_LEN;
+}
+
+uint8_t *
+db_compression_encode_indexes(const uint32_t *indexes, uint32_t num_indexes, size_t *dest_len) {
+    g_assert(indexes || num_indexes == 0);
+    g_assert(dest_len);
+
+    uint8_t *dest = malloc(db_compression_get_max_encoded_indexes_size(num_indexes) + 1);
+    g_assert(dest);
+
+    size_t pos = 0;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < num_indexes; i++) {
+        // zigzag encoding, so small negative differences are small numbers as well
+        const int32_t delta = (int32_t)(indexes[i] - prev);
+        uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        prev = indexes[i];
+
+        while (value >= 0x80) {
+            dest[pos++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        dest[pos++] = (uint8_t)value;
+    }
+    *dest_len = pos;
+    return dest;
+}
+
+bool
+db_compression_decode_indexes(const uint8_t *src, size_t src_len, uint32_t *indexes, uint32_t num_indexes) {
+    g_assert(src || src_len == 0);
+    g_assert(indexes || num_indexes == 0);
+
+    size_t pos = 0;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < num_indexes; i++) {
+        uint32_t value = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            if (pos >= src_len || shift >= 7 * DATABASE_COMPRESSION_MAX_VARINT_LEN) {
+                return false;
+            }
+            const uint8_t byte = src[pos++];
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        const uint32_t delta = (value >> 1) ^ (0 - (value & 1));
+        prev += delta;
+        indexes[i] = prev;
+    }
+    return pos == src_len;
+}
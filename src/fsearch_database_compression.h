@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The values are stored in the database file, don't change them
+typedef enum FsearchDatabaseCompression {
+    DATABASE_COMPRESSION_NONE = 0,
+    DATABASE_COMPRESSION_LZ4 = 1,
+    DATABASE_COMPRESSION_ZSTD = 2,
+    NUM_DATABASE_COMPRESSION_TYPES,
+} FsearchDatabaseCompression;
+
+// Whether support for compression was compiled in
+bool
+db_compression_is_supported(FsearchDatabaseCompression compression);
+
+// Returns a newly allocated buffer with the compressed data or NULL on failure
+uint8_t *
+db_compression_compress(FsearchDatabaseCompression compression, const uint8_t *src, size_t src_len, size_t *dest_len);
+
+// Decompresses src into dest, which must have room for exactly dest_len bytes. Fails if the
+// decompressed size doesn't match dest_len.
+bool
+db_compression_decompress(FsearchDatabaseCompression compression,
+                          const uint8_t *src,
+                          size_t src_len,
+                          uint8_t *dest,
+                          size_t dest_len);
+
+// Encodes the differences between consecutive indexes as variable length integers. Sorted index
+// lists are mostly ascending, so most differences fit into one or two bytes.
+uint8_t *
+db_compression_encode_indexes(const uint32_t *indexes, uint32_t num_indexes, size_t *dest_len);
+
+bool
+db_compression_decode_indexes(const uint8_t *src, size_t src_len, uint32_t *indexes, uint32_t num_indexes);
+
+// The largest number of bytes db_compression_encode_indexes needs for num_indexes
+size_t
+db_compression_get_max_encoded_indexes_size(uint32_t num_indexes);
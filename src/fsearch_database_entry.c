@@ -1,6 +1,9 @@
 #include "fsearch_database_entry.h"
 #include "fsearch_file_utils.h"
+#include "fsearch_id_dictionary.h"
+#include "fsearch_name_blocks.h"
 #include "fsearch_string_utils.h"
+#include "fsearch_xattr.h"
 
 #include <gio/gio.h>
 #include <stdlib.h>
@@ -18,10 +21,45 @@ struct FsearchDatabaseEntry {
 
     // idx: index of this entry in the sorted list at pos DATABASE_INDEX_TYPE_NAME
     uint32_t idx;
-    uint8_t type;
-    uint8_t mark;
+    uint8_t type : 2;
+    // times: ENTRY_TIME_* bits of the optional times, which are stored in that order right after the entry
+    uint8_t times : 3;
+    // has_owner: the owner, group and mode are stored in a slot after the optional times
+    uint8_t has_owner : 1;
+    // name_is_front_coded: name is a handle of a front coded name block and has to be decoded
+    uint8_t name_is_front_coded : 1;
+    // name_is_ascii: the name has no bytes outside of ASCII, so it can be case folded without ICU
+    uint8_t name_is_ascii : 1;
+    uint8_t mark : 2;
+    // has_xattrs: the id of the extended attributes is stored in a slot after the owner
+    uint8_t has_xattrs : 1;
+    // depth: number of parents, DEPTH_UNKNOWN if it doesn't fit and has to be computed
+    uint8_t depth;
+    // ext_offset: position of the extension in name, 0 if there's none and
+    // EXT_OFFSET_UNKNOWN if it doesn't fit and has to be looked up
+    uint8_t ext_offset;
 };
 
+#define ENTRY_TIME_ACCESS (1 << 0)
+#define ENTRY_TIME_CREATION (1 << 1)
+#define ENTRY_TIME_STATUS_CHANGE (1 << 2)
+
+// the user and group are ids of the dictionaries of db_entry_get_user_id_for_uid and
+// db_entry_get_group_id_for_gid, so all three fit into a single slot
+typedef struct {
+    uint16_t user_id;
+    uint16_t group_id;
+    uint16_t mode;
+} EntryOwner;
+
+#define ENTRY_SLOT_SIZE sizeof(int64_t)
+G_STATIC_ASSERT(sizeof(EntryOwner) <= ENTRY_SLOT_SIZE);
+
+#define DEPTH_UNKNOWN UINT8_MAX
+#define EXT_OFFSET_UNKNOWN UINT8_MAX
+// the content type caches of search threads get cleared once they're this large
+#define CONTENT_TYPE_CACHE_MAX_SIZE 4096
+
 struct FsearchDatabaseEntryFile {
     struct FsearchDatabaseEntry super;
 };
@@ -33,8 +71,19 @@ struct FsearchDatabaseEntryFolder {
     uint32_t db_idx;
     uint32_t num_files;
     uint32_t num_folders;
+    // a hash of the device, inode and status change time of the folder, 0 if it's unknown. It fits into the
+    // padding after the counters.
+    uint32_t identity;
 };
 
+static inline const char *
+entry_get_name(FsearchDatabaseEntry *entry) {
+    if (G_UNLIKELY(entry->name_is_front_coded)) {
+        return fsearch_name_blocks_decode(entry->name);
+    }
+    return entry->name;
+}
+
 static void
 build_path_recursively(FsearchDatabaseEntryFolder *folder, GString *str) {
     if (G_UNLIKELY(!folder)) {
@@ -44,8 +93,9 @@ build_path_recursively(FsearchDatabaseEntryFolder *folder, GString *str) {
     if (G_LIKELY(entry->parent)) {
         build_path_recursively(entry->parent, str);
     }
-    if (G_LIKELY(strcmp(entry->name, "") != 0)) {
-        g_string_append(str, entry->name);
+    const char *name = entry_get_name(entry);
+    if (G_LIKELY(strcmp(name, "") != 0)) {
+        g_string_append(str, name);
     }
     g_string_append_c(str, G_DIR_SEPARATOR);
 }
@@ -78,6 +128,18 @@ db_entry_folder_get_num_folders(FsearchDatabaseEntryFolder *entry) {
     return entry->num_folders;
 }
 
+uint32_t
+db_entry_folder_get_identity(FsearchDatabaseEntryFolder *entry) {
+    g_assert(entry->super.type == DATABASE_ENTRY_TYPE_FOLDER);
+    return entry->identity;
+}
+
+void
+db_entry_folder_set_identity(FsearchDatabaseEntryFolder *entry, uint32_t identity) {
+    g_assert(entry->super.type == DATABASE_ENTRY_TYPE_FOLDER);
+    entry->identity = identity;
+}
+
 size_t
 db_entry_get_sizeof_folder_entry() {
     return sizeof(FsearchDatabaseEntryFolder);
@@ -88,6 +150,278 @@ db_entry_get_sizeof_file_entry() {
     return sizeof(FsearchDatabaseEntryFile);
 }
 
+static uint8_t
+get_entry_times(FsearchDatabaseIndexFlags index_flags) {
+    uint8_t times = 0;
+    if (index_flags & DATABASE_INDEX_FLAG_ACCESS_TIME) {
+        times |= ENTRY_TIME_ACCESS;
+    }
+    if (index_flags & DATABASE_INDEX_FLAG_CREATION_TIME) {
+        times |= ENTRY_TIME_CREATION;
+    }
+    if (index_flags & DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME) {
+        times |= ENTRY_TIME_STATUS_CHANGE;
+    }
+    return times;
+}
+
+static size_t
+get_optional_values_size(FsearchDatabaseIndexFlags index_flags) {
+    const uint32_t num_slots = __builtin_popcount(get_entry_times(index_flags))
+                             + ((index_flags & DATABASE_INDEX_FLAG_OWNER) ? 1 : 0)
+                             + ((index_flags & DATABASE_INDEX_FLAG_XATTRS) ? 1 : 0);
+    return num_slots * ENTRY_SLOT_SIZE;
+}
+
+size_t
+db_entry_get_sizeof_folder_entry_with_optional_values(FsearchDatabaseIndexFlags index_flags) {
+    return sizeof(FsearchDatabaseEntryFolder) + get_optional_values_size(index_flags);
+}
+
+size_t
+db_entry_get_sizeof_file_entry_with_optional_values(FsearchDatabaseIndexFlags index_flags) {
+    return sizeof(FsearchDatabaseEntryFile) + get_optional_values_size(index_flags);
+}
+
+static uint8_t
+get_entry_time(FsearchDatabaseIndexType type) {
+    switch (type) {
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+        return ENTRY_TIME_ACCESS;
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+        return ENTRY_TIME_CREATION;
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+        return ENTRY_TIME_STATUS_CHANGE;
+    default:
+        return 0;
+    }
+}
+
+static inline int64_t *
+entry_get_slots(FsearchDatabaseEntry *entry) {
+    const size_t entry_size = entry->type == DATABASE_ENTRY_TYPE_FOLDER ? sizeof(FsearchDatabaseEntryFolder)
+                                                                       : sizeof(FsearchDatabaseEntryFile);
+    return (int64_t *)((uint8_t *)entry + entry_size);
+}
+
+// Returns NULL if entry doesn't store the time
+static inline int64_t *
+entry_get_time_slot(FsearchDatabaseEntry *entry, uint8_t time) {
+    if (G_LIKELY((entry->times & time) == 0)) {
+        return NULL;
+    }
+    return entry_get_slots(entry) + __builtin_popcount(entry->times & (time - 1));
+}
+
+// Returns NULL if entry doesn't store its owner
+static inline EntryOwner *
+entry_get_owner(FsearchDatabaseEntry *entry) {
+    if (G_LIKELY(!entry->has_owner)) {
+        return NULL;
+    }
+    return (EntryOwner *)(entry_get_slots(entry) + __builtin_popcount(entry->times));
+}
+
+// Returns NULL if entry doesn't store its extended attributes
+static inline uint32_t *
+entry_get_xattrs_id(FsearchDatabaseEntry *entry) {
+    if (G_LIKELY(!entry->has_xattrs)) {
+        return NULL;
+    }
+    return (uint32_t *)(entry_get_slots(entry) + __builtin_popcount(entry->times) + entry->has_owner);
+}
+
+void
+db_entry_init_optional_values(FsearchDatabaseEntry *entry, FsearchDatabaseIndexFlags index_flags) {
+    entry->times = get_entry_times(index_flags);
+    entry->has_owner = (index_flags & DATABASE_INDEX_FLAG_OWNER) != 0;
+    entry->has_xattrs = (index_flags & DATABASE_INDEX_FLAG_XATTRS) != 0;
+    for (uint8_t time = ENTRY_TIME_ACCESS; time <= ENTRY_TIME_STATUS_CHANGE; time <<= 1) {
+        int64_t *slot = entry_get_time_slot(entry, time);
+        if (slot) {
+            *slot = 0;
+        }
+    }
+    EntryOwner *owner = entry_get_owner(entry);
+    if (owner) {
+        owner->user_id = FSEARCH_ID_DICTIONARY_NO_ID;
+        owner->group_id = FSEARCH_ID_DICTIONARY_NO_ID;
+        owner->mode = 0;
+    }
+    uint32_t *xattrs_id = entry_get_xattrs_id(entry);
+    if (xattrs_id) {
+        *xattrs_id = FSEARCH_STRING_TABLE_NO_ID;
+    }
+}
+
+void
+db_entry_set_time(FsearchDatabaseEntry *entry, FsearchDatabaseIndexType type, time_t time) {
+    if (type == DATABASE_INDEX_TYPE_MODIFICATION_TIME) {
+        entry->mtime = time;
+        return;
+    }
+    int64_t *slot = entry_get_time_slot(entry, get_entry_time(type));
+    if (slot) {
+        *slot = time;
+    }
+}
+
+bool
+db_entry_has_time(FsearchDatabaseEntry *entry, FsearchDatabaseIndexType type) {
+    if (type == DATABASE_INDEX_TYPE_MODIFICATION_TIME) {
+        return true;
+    }
+    return (entry->times & get_entry_time(type)) != 0;
+}
+
+time_t
+db_entry_get_time(FsearchDatabaseEntry *entry, FsearchDatabaseIndexType type) {
+    if (G_UNLIKELY(!entry)) {
+        return 0;
+    }
+    if (type == DATABASE_INDEX_TYPE_MODIFICATION_TIME) {
+        return entry->mtime;
+    }
+    const int64_t *slot = entry_get_time_slot(entry, get_entry_time(type));
+    return slot ? (time_t)*slot : 0;
+}
+
+static FsearchIdDictionary *
+get_user_dictionary(void) {
+    static gsize user_dictionary = 0;
+    if (g_once_init_enter(&user_dictionary)) {
+        g_once_init_leave(&user_dictionary, (gsize)fsearch_id_dictionary_new());
+    }
+    return (FsearchIdDictionary *)user_dictionary;
+}
+
+static FsearchIdDictionary *
+get_group_dictionary(void) {
+    static gsize group_dictionary = 0;
+    if (g_once_init_enter(&group_dictionary)) {
+        g_once_init_leave(&group_dictionary, (gsize)fsearch_id_dictionary_new());
+    }
+    return (FsearchIdDictionary *)group_dictionary;
+}
+
+uint16_t
+db_entry_get_user_id_for_uid(uint32_t uid) {
+    return fsearch_id_dictionary_get_id(get_user_dictionary(), uid);
+}
+
+uint16_t
+db_entry_get_group_id_for_gid(uint32_t gid) {
+    return fsearch_id_dictionary_get_id(get_group_dictionary(), gid);
+}
+
+void
+db_entry_set_owner_ids(FsearchDatabaseEntry *entry, uint16_t user_id, uint16_t group_id, uint16_t mode) {
+    EntryOwner *owner = entry_get_owner(entry);
+    if (owner) {
+        owner->user_id = user_id;
+        owner->group_id = group_id;
+        owner->mode = mode;
+    }
+}
+
+void
+db_entry_set_owner(FsearchDatabaseEntry *entry, uint32_t uid, uint32_t gid, uint32_t mode) {
+    if (entry->has_owner) {
+        db_entry_set_owner_ids(entry, db_entry_get_user_id_for_uid(uid), db_entry_get_group_id_for_gid(gid), mode);
+    }
+}
+
+bool
+db_entry_has_owner(FsearchDatabaseEntry *entry) {
+    return entry->has_owner;
+}
+
+uint16_t
+db_entry_get_user_id(FsearchDatabaseEntry *entry) {
+    EntryOwner *owner = entry ? entry_get_owner(entry) : NULL;
+    return owner ? owner->user_id : FSEARCH_ID_DICTIONARY_NO_ID;
+}
+
+uint16_t
+db_entry_get_group_id(FsearchDatabaseEntry *entry) {
+    EntryOwner *owner = entry ? entry_get_owner(entry) : NULL;
+    return owner ? owner->group_id : FSEARCH_ID_DICTIONARY_NO_ID;
+}
+
+uint16_t
+db_entry_get_mode(FsearchDatabaseEntry *entry) {
+    EntryOwner *owner = entry ? entry_get_owner(entry) : NULL;
+    return owner ? owner->mode : 0;
+}
+
+static FsearchStringTable *
+get_xattrs_table(void) {
+    static gsize xattrs_table = 0;
+    if (g_once_init_enter(&xattrs_table)) {
+        g_once_init_leave(&xattrs_table, (gsize)fsearch_string_table_new());
+    }
+    return (FsearchStringTable *)xattrs_table;
+}
+
+uint32_t
+db_entry_get_xattrs_id_for_xattrs(const char *xattrs, size_t xattrs_len) {
+    if (xattrs_len == 0) {
+        return FSEARCH_STRING_TABLE_NO_ID;
+    }
+    return fsearch_string_table_add(get_xattrs_table(), xattrs, xattrs_len);
+}
+
+const char *
+db_entry_get_xattrs_for_id(uint32_t xattrs_id, size_t *xattrs_len) {
+    if (xattrs_id == FSEARCH_STRING_TABLE_NO_ID) {
+        return NULL;
+    }
+    return fsearch_string_table_get(get_xattrs_table(), xattrs_id, xattrs_len);
+}
+
+void
+db_entry_set_xattrs_id(FsearchDatabaseEntry *entry, uint32_t xattrs_id) {
+    uint32_t *slot = entry_get_xattrs_id(entry);
+    if (slot) {
+        *slot = xattrs_id;
+    }
+}
+
+void
+db_entry_set_xattrs(FsearchDatabaseEntry *entry, const char *xattrs, size_t xattrs_len) {
+    if (entry->has_xattrs) {
+        db_entry_set_xattrs_id(entry, db_entry_get_xattrs_id_for_xattrs(xattrs, xattrs_len));
+    }
+}
+
+bool
+db_entry_has_xattrs(FsearchDatabaseEntry *entry) {
+    return entry->has_xattrs;
+}
+
+uint32_t
+db_entry_get_xattrs_id(FsearchDatabaseEntry *entry) {
+    uint32_t *slot = entry ? entry_get_xattrs_id(entry) : NULL;
+    return slot ? *slot : FSEARCH_STRING_TABLE_NO_ID;
+}
+
+const char *
+db_entry_get_xattr(FsearchDatabaseEntry *entry, const char *name, size_t *value_len) {
+    size_t xattrs_len = 0;
+    const char *xattrs = db_entry_get_xattrs_for_id(db_entry_get_xattrs_id(entry), &xattrs_len);
+    return xattrs ? fsearch_xattr_lookup(xattrs, xattrs_len, name, value_len) : NULL;
+}
+
+bool
+db_entry_get_uid(FsearchDatabaseEntry *entry, uint32_t *uid) {
+    return fsearch_id_dictionary_get_value(get_user_dictionary(), db_entry_get_user_id(entry), uid);
+}
+
+bool
+db_entry_get_gid(FsearchDatabaseEntry *entry, uint32_t *gid) {
+    return fsearch_id_dictionary_get_value(get_group_dictionary(), db_entry_get_group_id(entry), gid);
+}
+
 GString *
 db_entry_get_path(FsearchDatabaseEntry *entry) {
     GString *path = g_string_new(NULL);
@@ -104,8 +438,10 @@ db_entry_get_path_full(FsearchDatabaseEntry *entry) {
 
 void
 db_entry_append_path(FsearchDatabaseEntry *entry, GString *str) {
+    const size_t start_len = str->len;
     build_path_recursively(entry->parent, str);
-    if (str->len > 1) {
+    // the trailing separator goes, unless the path is just the root
+    if (str->len - start_len > 1) {
         g_string_set_size(str, str->len - 1);
     }
 }
@@ -113,7 +449,8 @@ db_entry_append_path(FsearchDatabaseEntry *entry, GString *str) {
 void
 db_entry_append_full_path(FsearchDatabaseEntry *entry, GString *str) {
     build_path_recursively(entry->parent, str);
-    g_string_append(str, entry->name[0] == '\0' ? G_DIR_SEPARATOR_S : entry->name);
+    const char *name = entry_get_name(entry);
+    g_string_append(str, name[0] == '\0' ? G_DIR_SEPARATOR_S : name);
 }
 
 time_t
@@ -134,7 +471,10 @@ db_entry_get_extension(FsearchDatabaseEntry *entry) {
     if (entry->type == DATABASE_ENTRY_TYPE_FOLDER) {
         return NULL;
     }
-    return fsearch_string_get_extension(entry->name);
+    if (G_UNLIKELY(entry->ext_offset == EXT_OFFSET_UNKNOWN)) {
+        return fsearch_string_get_extension(entry_get_name(entry));
+    }
+    return entry->ext_offset ? entry_get_name(entry) + entry->ext_offset : "";
 }
 
 const char *
@@ -142,8 +482,9 @@ db_entry_get_name_raw_for_display(FsearchDatabaseEntry *entry) {
     if (G_UNLIKELY(!entry)) {
         return NULL;
     }
-    if (strcmp(entry->name, "") != 0) {
-        return entry->name;
+    const char *name = entry_get_name(entry);
+    if (strcmp(name, "") != 0) {
+        return name;
     }
     return G_DIR_SEPARATOR_S;
 }
@@ -156,7 +497,7 @@ db_entry_get_name_for_display(FsearchDatabaseEntry *entry) {
 
 const char *
 db_entry_get_name_raw(FsearchDatabaseEntry *entry) {
-    return entry ? entry->name : NULL;
+    return entry ? entry_get_name(entry) : NULL;
 }
 
 FsearchDatabaseEntryFolder *
@@ -169,8 +510,72 @@ db_entry_get_type(FsearchDatabaseEntry *entry) {
     return entry ? entry->type : DATABASE_ENTRY_TYPE_NONE;
 }
 
+bool
+db_entry_name_is_ascii(FsearchDatabaseEntry *entry) {
+    return entry && entry->name_is_ascii;
+}
+
+// The type of a file is guessed from its name only, so it's the same for all names which share the
+// part starting at the first dot (e.g. ".tar.gz"). Names without such a part are cached as a whole.
+static GRWLock file_type_lock;
+// maps those name patterns to their type
+static GHashTable *file_type_table = NULL;
+// every type is only stored once
+static GHashTable *file_type_names = NULL;
+
+static const char *
+get_file_type_key(const char *name) {
+    // the dot of hidden files doesn't start an extension
+    const char *dot = name[0] != '\0' ? strchr(name + 1, '.') : NULL;
+    return dot ? dot : name;
+}
+
+// Content types which could be determined by name alone, every search thread has its own cache so they
+// don't contend for the lock GIO uses while guessing
+static GPrivate content_type_cache_private = G_PRIVATE_INIT((GDestroyNotify)g_hash_table_unref);
+
+// Returns NULL if the content type can't be determined without looking at the content of the file
+static const char *
+get_content_type_for_name(const char *name) {
+    GHashTable *cache = g_private_get(&content_type_cache_private);
+    if (!cache) {
+        cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        g_private_set(&content_type_cache_private, cache);
+    }
+
+    // same name patterns as the file type cache, they share the content type guessed by name as well
+    const char *key = get_file_type_key(name);
+    gpointer cached_content_type = NULL;
+    if (g_hash_table_lookup_extended(cache, key, NULL, &cached_content_type)) {
+        return cached_content_type;
+    }
+
+    gboolean uncertain = FALSE;
+    char *content_type = g_content_type_guess(name, NULL, 0, &uncertain);
+    if (uncertain) {
+        g_clear_pointer(&content_type, g_free);
+    }
+    if (g_hash_table_size(cache) >= CONTENT_TYPE_CACHE_MAX_SIZE) {
+        g_hash_table_remove_all(cache);
+    }
+    g_hash_table_insert(cache, g_strdup(key), content_type);
+    return content_type;
+}
+
 void
 db_entry_append_content_type(FsearchDatabaseEntry *entry, GString *str) {
+    if (db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER) {
+        g_string_append(str, "inode/directory");
+        return;
+    }
+    // GIO only looks at the content of a file if its name isn't enough to determine the content type,
+    // do the same without accessing the filesystem for every single file
+    const char *content_type_for_name = get_content_type_for_name(db_entry_get_name_raw_for_display(entry));
+    if (content_type_for_name) {
+        g_string_append(str, content_type_for_name);
+        return;
+    }
+
     g_autoptr(GString) path = db_entry_get_path_full(entry);
     g_autoptr(GFile) file = g_file_new_for_path(path->str);
     g_autoptr(GError) error = NULL;
@@ -198,11 +603,15 @@ db_entry_destroy(FsearchDatabaseEntry *entry) {
     if (G_UNLIKELY(!entry)) {
         return;
     }
+    if (entry->name_is_front_coded) {
+        entry->name = NULL;
+        return;
+    }
     g_clear_pointer(&entry->name, free);
 }
 
-uint32_t
-db_entry_get_depth(FsearchDatabaseEntry *entry) {
+static uint32_t
+db_entry_compute_depth(FsearchDatabaseEntry *entry) {
     uint32_t depth = 0;
     while (entry && entry->parent) {
         entry = (FsearchDatabaseEntry *)entry->parent;
@@ -211,6 +620,40 @@ db_entry_get_depth(FsearchDatabaseEntry *entry) {
     return depth;
 }
 
+uint32_t
+db_entry_get_depth(FsearchDatabaseEntry *entry) {
+    if (G_UNLIKELY(!entry)) {
+        return 0;
+    }
+    if (G_UNLIKELY(entry->depth == DEPTH_UNKNOWN)) {
+        return db_entry_compute_depth(entry);
+    }
+    return entry->depth;
+}
+
+static void
+db_entry_set_depth(FsearchDatabaseEntry *entry, uint32_t depth) {
+    entry->depth = depth < DEPTH_UNKNOWN ? depth : DEPTH_UNKNOWN;
+}
+
+void
+db_entry_update_depth(FsearchDatabaseEntry *entry) {
+    db_entry_set_depth(entry, db_entry_compute_depth(entry));
+}
+
+static void
+db_entry_update_name_info(FsearchDatabaseEntry *entry) {
+    entry->name_is_ascii = g_str_is_ascii(entry->name);
+
+    const char *ext = fsearch_string_get_extension(entry->name);
+    if (ext[0] == '\0') {
+        entry->ext_offset = 0;
+        return;
+    }
+    const size_t offset = ext - entry->name;
+    entry->ext_offset = offset < EXT_OFFSET_UNKNOWN ? offset : EXT_OFFSET_UNKNOWN;
+}
+
 static FsearchDatabaseEntryFolder *
 db_entry_get_parent_nth(FsearchDatabaseEntryFolder *entry, uint32_t nth) {
     while (entry && nth > 0) {
@@ -231,7 +674,7 @@ sort_entry_by_path_recursive(FsearchDatabaseEntryFolder *entry_a, FsearchDatabas
     if (*res != 0) {
         return;
     }
-    *res = strverscmp(entry_a->super.name, entry_b->super.name);
+    *res = strverscmp(entry_get_name(&entry_a->super), entry_get_name(&entry_b->super));
 }
 
 int
@@ -241,34 +684,42 @@ db_entry_compare_entries_by_size(FsearchDatabaseEntry **a, FsearchDatabaseEntry
     return (size_a > size_b) ? 1 : -1;
 }
 
-static const char *
-get_file_type(FsearchDatabaseEntry *entry, GHashTable *file_type_table, GHashTable *entry_table) {
-    const FsearchDatabaseEntryType type_a = db_entry_get_type(entry);
-
+const char *
+db_entry_get_file_type(FsearchDatabaseEntry *entry) {
+    if (db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER) {
+        return "Folder";
+    }
     const char *name = db_entry_get_name_raw_for_display(entry);
-    g_autofree char *type =
-        fsearch_file_utils_get_file_type_non_localized(name, type_a == DATABASE_ENTRY_TYPE_FOLDER ? TRUE : FALSE);
-    char *cached_type = g_hash_table_lookup(file_type_table, type);
+    const char *key = get_file_type_key(name);
+
+    g_rw_lock_reader_lock(&file_type_lock);
+    const char *cached_type = file_type_table ? g_hash_table_lookup(file_type_table, key) : NULL;
+    g_rw_lock_reader_unlock(&file_type_lock);
+    if (cached_type) {
+        return cached_type;
+    }
+
+    g_autofree char *type = fsearch_file_utils_get_file_type_non_localized(name, FALSE);
+
+    g_rw_lock_writer_lock(&file_type_lock);
+    if (!file_type_table) {
+        file_type_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        file_type_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+    cached_type = g_hash_table_lookup(file_type_names, type);
     if (!cached_type) {
-        g_hash_table_add(file_type_table, type);
-        cached_type = g_steal_pointer(&type);
+        cached_type = type;
+        g_hash_table_add(file_type_names, g_steal_pointer(&type));
     }
-    g_hash_table_insert(entry_table, entry, cached_type);
+    g_hash_table_insert(file_type_table, g_strdup(key), (gpointer)cached_type);
+    g_rw_lock_writer_unlock(&file_type_lock);
+
     return cached_type;
 }
 
 int
 db_entry_compare_entries_by_type(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
-    FsearchDatabaseEntryCompareContext *comp_ctx = data;
-    const char *file_type_a = g_hash_table_lookup(comp_ctx->entry_to_file_type_table, *a);
-    const char *file_type_b = g_hash_table_lookup(comp_ctx->entry_to_file_type_table, *b);
-    if (!file_type_a) {
-        file_type_a = get_file_type(*a, comp_ctx->file_type_table, comp_ctx->entry_to_file_type_table);
-    }
-    if (!file_type_b) {
-        file_type_b = get_file_type(*b, comp_ctx->file_type_table, comp_ctx->entry_to_file_type_table);
-    }
-    return strcmp(file_type_a, file_type_b);
+    return strcmp(db_entry_get_file_type(*a), db_entry_get_file_type(*b));
 }
 
 int
@@ -276,11 +727,82 @@ db_entry_compare_entries_by_modification_time(FsearchDatabaseEntry **a, FsearchD
     return ((*a)->mtime > (*b)->mtime) ? 1 : -1;
 }
 
+int
+db_entry_compare_entries_by_access_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b) {
+    const time_t time_a = db_entry_get_time(*a, DATABASE_INDEX_TYPE_ACCESS_TIME);
+    const time_t time_b = db_entry_get_time(*b, DATABASE_INDEX_TYPE_ACCESS_TIME);
+    return (time_a > time_b) ? 1 : -1;
+}
+
+int
+db_entry_compare_entries_by_creation_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b) {
+    const time_t time_a = db_entry_get_time(*a, DATABASE_INDEX_TYPE_CREATION_TIME);
+    const time_t time_b = db_entry_get_time(*b, DATABASE_INDEX_TYPE_CREATION_TIME);
+    return (time_a > time_b) ? 1 : -1;
+}
+
+int
+db_entry_compare_entries_by_status_change_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b) {
+    const time_t time_a = db_entry_get_time(*a, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME);
+    const time_t time_b = db_entry_get_time(*b, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME);
+    return (time_a > time_b) ? 1 : -1;
+}
+
+int
+db_entry_compare_entries_by_owner(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b) {
+    const uint64_t key_a = db_entry_get_owner_sort_key(*a, NULL);
+    const uint64_t key_b = db_entry_get_owner_sort_key(*b, NULL);
+    return (key_a > key_b) ? 1 : -1;
+}
+
 int
 db_entry_compare_entries_by_position(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b) {
     return 0;
 }
 
+// flipping the sign bit keeps the order of signed values as unsigned keys
+static inline uint64_t
+signed_sort_key(int64_t value) {
+    return (uint64_t)value ^ (UINT64_C(1) << 63);
+}
+
+uint64_t
+db_entry_get_size_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    return signed_sort_key(db_entry_get_size(entry));
+}
+
+uint64_t
+db_entry_get_modification_time_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    return signed_sort_key(entry->mtime);
+}
+
+uint64_t
+db_entry_get_access_time_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    return signed_sort_key(db_entry_get_time(entry, DATABASE_INDEX_TYPE_ACCESS_TIME));
+}
+
+uint64_t
+db_entry_get_creation_time_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    return signed_sort_key(db_entry_get_time(entry, DATABASE_INDEX_TYPE_CREATION_TIME));
+}
+
+uint64_t
+db_entry_get_status_change_time_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    return signed_sort_key(db_entry_get_time(entry, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME));
+}
+
+uint64_t
+db_entry_get_owner_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    uint32_t uid = 0;
+    // entries without an owner end up last
+    return db_entry_get_uid(entry, &uid) ? uid : UINT64_MAX;
+}
+
+uint64_t
+db_entry_get_name_sort_key(FsearchDatabaseEntry *entry, void *data) {
+    return fsearch_string_get_version_sort_key(entry->name ? entry_get_name(entry) : "");
+}
+
 int
 db_entry_compare_entries_by_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b) {
     FsearchDatabaseEntry *entry_a = *a;
@@ -328,8 +850,8 @@ db_entry_compare_entries_by_name(FsearchDatabaseEntry **a, FsearchDatabaseEntry
     if (G_UNLIKELY(*a == NULL || *b == NULL)) {
         return 0;
     }
-    const char *name_a = (*a)->name;
-    const char *name_b = (*b)->name;
+    const char *name_a = (*a)->name ? entry_get_name(*a) : NULL;
+    const char *name_b = (*b)->name ? entry_get_name(*b) : NULL;
     return strverscmp(name_a ? name_a : "", name_b ? name_b : "");
 }
 
@@ -343,18 +865,37 @@ db_entry_set_size(FsearchDatabaseEntry *entry, off_t size) {
     entry->size = size;
 }
 
+void
+db_entry_set_name_no_copy(FsearchDatabaseEntry *entry, const char *name) {
+    entry->name = (char *)name;
+    entry->name_is_front_coded = 0;
+    db_entry_update_name_info(entry);
+}
+
+void
+db_entry_set_name_front_coded(FsearchDatabaseEntry *entry, const char *handle) {
+    // the name didn't change, so neither did its extension
+    entry->name = (char *)handle;
+    entry->name_is_front_coded = 1;
+}
+
 void
 db_entry_set_name(FsearchDatabaseEntry *entry, const char *name) {
-    if (entry->name) {
+    if (entry->name && !entry->name_is_front_coded) {
         free(entry->name);
     }
     entry->name = strdup(name ? name : "");
+    entry->name_is_front_coded = 0;
+    db_entry_update_name_info(entry);
 }
 
 void
 db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntryFolder *parent) {
     entry->parent = parent;
+    entry->depth = 0;
     if (parent) {
+        const uint8_t parent_depth = parent->super.depth;
+        entry->depth = parent_depth == DEPTH_UNKNOWN ? DEPTH_UNKNOWN : parent_depth + 1;
         g_assert(parent->super.type == DATABASE_ENTRY_TYPE_FOLDER);
         if (entry->type == DATABASE_ENTRY_TYPE_FOLDER) {
             parent->num_folders++;
@@ -365,6 +906,21 @@ db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntryFolder *par
     }
 }
 
+void
+db_entry_copy(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *copy, FsearchDatabaseEntryFolder *parent) {
+    const size_t entry_size = entry->type == DATABASE_ENTRY_TYPE_FOLDER ? sizeof(FsearchDatabaseEntryFolder)
+                                                                       : sizeof(FsearchDatabaseEntryFile);
+    const uint32_t num_slots = __builtin_popcount(entry->times) + entry->has_owner + entry->has_xattrs;
+    memcpy(copy, entry, entry_size + num_slots * ENTRY_SLOT_SIZE);
+    copy->mark = 0;
+    if (copy->type == DATABASE_ENTRY_TYPE_FOLDER) {
+        FsearchDatabaseEntryFolder *folder = (FsearchDatabaseEntryFolder *)copy;
+        folder->num_files = 0;
+        folder->num_folders = 0;
+    }
+    db_entry_set_parent(copy, parent);
+}
+
 void
 db_entry_set_type(FsearchDatabaseEntry *entry, FsearchDatabaseEntryType type) {
     entry->type = type;
@@ -384,3 +940,57 @@ void
 db_entry_update_parent_size(FsearchDatabaseEntry *entry) {
     db_entry_update_folder_size(entry->parent, entry->size);
 }
+
+void
+db_entry_folder_add_size(FsearchDatabaseEntryFolder *folder, off_t size) {
+    __atomic_fetch_add(&folder->super.size, size, __ATOMIC_RELAXED);
+}
+
+void
+db_entry_update_size(FsearchDatabaseEntry *entry, off_t size) {
+    const off_t diff = size - entry->size;
+    entry->size = size;
+    db_entry_update_folder_size(entry->parent, diff);
+}
+
+void
+db_entry_detach_from_parent(FsearchDatabaseEntry *entry) {
+    FsearchDatabaseEntryFolder *parent = entry->parent;
+    if (!parent) {
+        return;
+    }
+    if (entry->type == DATABASE_ENTRY_TYPE_FOLDER && parent->num_folders > 0) {
+        parent->num_folders--;
+    }
+    else if (entry->type == DATABASE_ENTRY_TYPE_FILE && parent->num_files > 0) {
+        parent->num_files--;
+    }
+    // folder sizes already contain the sizes of all their children
+    db_entry_update_folder_size(parent, -entry->size);
+}
+
+FsearchDatabaseEntry *
+db_entry_get_dummy_for_name_and_parent(FsearchDatabaseEntryFolder *parent,
+                                       const char *name,
+                                       FsearchDatabaseEntryType type) {
+    FsearchDatabaseEntry *entry = calloc(1, type == DATABASE_ENTRY_TYPE_FOLDER ? sizeof(FsearchDatabaseEntryFolder)
+                                                                                 : sizeof(FsearchDatabaseEntryFile));
+    g_assert(entry);
+
+    db_entry_set_name(entry, name);
+    db_entry_set_type(entry, type);
+    // don't use db_entry_set_parent, the dummy must not show up in the child counts of the parent
+    entry->parent = parent;
+    db_entry_update_depth(entry);
+
+    return entry;
+}
+
+void
+db_entry_free_dummy(FsearchDatabaseEntry *entry) {
+    if (!entry) {
+        return;
+    }
+    db_entry_destroy(entry);
+    g_clear_pointer(&entry, free);
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "fsearch_database_index.h"
+#include "fsearch_id_dictionary.h"
+#include "fsearch_string_table.h"
+
 #include <glib.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -15,11 +19,6 @@ typedef struct FsearchDatabaseEntry FsearchDatabaseEntry;
 typedef struct FsearchDatabaseEntryFile FsearchDatabaseEntryFile;
 typedef struct FsearchDatabaseEntryFolder FsearchDatabaseEntryFolder;
 
-typedef struct FsearchDatabaseEntryCompareContext {
-    GHashTable *file_type_table;
-    GHashTable *entry_to_file_type_table;
-} FsearchDatabaseEntryCompareContext;
-
 bool
 db_entry_is_folder(FsearchDatabaseEntry *entry);
 
@@ -32,6 +31,15 @@ db_entry_get_sizeof_folder_entry();
 size_t
 db_entry_get_sizeof_file_entry();
 
+// The access, creation and status change times, the owner (DATABASE_INDEX_FLAG_OWNER) and the extended attributes
+// (DATABASE_INDEX_FLAG_XATTRS) are optional. Entries which store some of them are larger, by one slot per time in
+// index_flags, one for the owner and one for the extended attributes; the other flags are ignored.
+size_t
+db_entry_get_sizeof_folder_entry_with_optional_values(FsearchDatabaseIndexFlags index_flags);
+
+size_t
+db_entry_get_sizeof_file_entry_with_optional_values(FsearchDatabaseIndexFlags index_flags);
+
 uint32_t
 db_entry_folder_get_num_children(FsearchDatabaseEntryFolder *entry);
 
@@ -41,6 +49,14 @@ db_entry_folder_get_num_files(FsearchDatabaseEntryFolder *entry);
 uint32_t
 db_entry_folder_get_num_folders(FsearchDatabaseEntryFolder *entry);
 
+// A hash of the device, inode and status change time of the folder, which the rescan uses to tell whether it was
+// replaced or changed without a new modification time. 0 if it's unknown.
+uint32_t
+db_entry_folder_get_identity(FsearchDatabaseEntryFolder *entry);
+
+void
+db_entry_folder_set_identity(FsearchDatabaseEntryFolder *entry, uint32_t identity);
+
 void
 db_entry_set_idx(FsearchDatabaseEntry *entry, uint32_t idx);
 
@@ -50,21 +66,78 @@ db_entry_set_mtime(FsearchDatabaseEntry *entry, time_t mtime);
 void
 db_entry_set_size(FsearchDatabaseEntry *entry, off_t size);
 
+// Makes entry store the optional values in index_flags, it must have been allocated with the size of
+// db_entry_get_sizeof_*_entry_with_optional_values for them and its type must be set already. All times start at 0,
+// the owner and group are FSEARCH_ID_DICTIONARY_NO_ID and there are no extended attributes.
+void
+db_entry_init_optional_values(FsearchDatabaseEntry *entry, FsearchDatabaseIndexFlags index_flags);
+
+// Only sets times which entry stores (see db_entry_init_optional_values), apart from the modification time
+void
+db_entry_set_time(FsearchDatabaseEntry *entry, FsearchDatabaseIndexType type, time_t time);
+
+// Only sets the owner, group and permissions if entry stores them (see db_entry_init_optional_values)
+void
+db_entry_set_owner(FsearchDatabaseEntry *entry, uint32_t uid, uint32_t gid, uint32_t mode);
+
+// Like db_entry_set_owner, with the dictionary ids of the user and group (see db_entry_get_user_id_for_uid)
+void
+db_entry_set_owner_ids(FsearchDatabaseEntry *entry, uint16_t user_id, uint16_t group_id, uint16_t mode);
+
+// Only sets the extended attributes (encoded like in fsearch_xattr.h) if entry stores them.
+// An empty list means that it has none.
+void
+db_entry_set_xattrs(FsearchDatabaseEntry *entry, const char *xattrs, size_t xattrs_len);
+
+// Like db_entry_set_xattrs, with the id of db_entry_get_xattrs_id_for_xattrs
+void
+db_entry_set_xattrs_id(FsearchDatabaseEntry *entry, uint32_t xattrs_id);
+
+// Marks can only be 0 to 3
 void
 db_entry_set_mark(FsearchDatabaseEntry *entry, uint8_t mark);
 
 void
 db_entry_set_name(FsearchDatabaseEntry *entry, const char *name);
 
+// Uses name without copying it, so it must outlive the entry (e.g. because it's stored in a string pool).
+// Entries with such a name must not be passed to db_entry_destroy.
+void
+db_entry_set_name_no_copy(FsearchDatabaseEntry *entry, const char *name);
+
+// Replaces the name of entry with the handle of the same name in a front coded name block (see
+// fsearch_name_blocks.h), which must outlive the entry.
+void
+db_entry_set_name_front_coded(FsearchDatabaseEntry *entry, const char *handle);
+
 void
 db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntryFolder *parent);
 
+// Copies entry with its optional values to copy, which must have been allocated with the same size, and makes parent
+// its parent. The name is shared with entry. A copied folder has no children yet and no mark.
+void
+db_entry_copy(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *copy, FsearchDatabaseEntryFolder *parent);
+
 void
 db_entry_set_type(FsearchDatabaseEntry *entry, FsearchDatabaseEntryType type);
 
 void
 db_entry_update_parent_size(FsearchDatabaseEntry *entry);
 
+// Adds size to the size of folder only, not to the ones of its parents. Several threads may add to the same
+// folder at once.
+void
+db_entry_folder_add_size(FsearchDatabaseEntryFolder *folder, off_t size);
+
+// Sets the size of an entry and updates the sizes of all its parents accordingly
+void
+db_entry_update_size(FsearchDatabaseEntry *entry, off_t size);
+
+// Removes an entry from the child counts and sizes of its parents. The parent pointer
+// of the entry itself is left untouched.
+void
+db_entry_detach_from_parent(FsearchDatabaseEntry *entry);
+
 uint8_t
 db_entry_get_mark(FsearchDatabaseEntry *entry);
 
@@ -74,6 +147,11 @@ db_entry_get_idx(FsearchDatabaseEntry *entry);
 uint32_t
 db_entry_get_depth(FsearchDatabaseEntry *entry);
 
+// The depth is derived from the parent when it gets set, this recomputes it in case
+// the parents of entry weren't set up yet at that point
+void
+db_entry_update_depth(FsearchDatabaseEntry *entry);
+
 GString *
 db_entry_get_path(FsearchDatabaseEntry *entry);
 
@@ -89,9 +167,66 @@ db_entry_append_full_path(FsearchDatabaseEntry *entry, GString *str);
 time_t
 db_entry_get_mtime(FsearchDatabaseEntry *entry);
 
+// Returns the modification, access, creation or status change time of entry, 0 if it doesn't store that time
+time_t
+db_entry_get_time(FsearchDatabaseEntry *entry, FsearchDatabaseIndexType type);
+
+bool
+db_entry_has_time(FsearchDatabaseEntry *entry, FsearchDatabaseIndexType type);
+
 off_t
 db_entry_get_size(FsearchDatabaseEntry *entry);
 
+bool
+db_entry_has_owner(FsearchDatabaseEntry *entry);
+
+// Users and groups are stored as ids of process wide dictionaries (see fsearch_id_dictionary.h), which stay the
+// same for all databases. These return the ids of the value, it gets added to the dictionary if needed.
+uint16_t
+db_entry_get_user_id_for_uid(uint32_t uid);
+
+uint16_t
+db_entry_get_group_id_for_gid(uint32_t gid);
+
+// FSEARCH_ID_DICTIONARY_NO_ID if entry doesn't store its owner
+uint16_t
+db_entry_get_user_id(FsearchDatabaseEntry *entry);
+
+uint16_t
+db_entry_get_group_id(FsearchDatabaseEntry *entry);
+
+// The mode of entry as reported by stat, 0 if it doesn't store its owner
+uint16_t
+db_entry_get_mode(FsearchDatabaseEntry *entry);
+
+// Return false if entry doesn't store its owner or it had too many other owners to get an id of its own
+bool
+db_entry_get_uid(FsearchDatabaseEntry *entry, uint32_t *uid);
+
+bool
+db_entry_get_gid(FsearchDatabaseEntry *entry, uint32_t *gid);
+
+bool
+db_entry_has_xattrs(FsearchDatabaseEntry *entry);
+
+// The extended attributes of all entries are stored in a process wide table of distinct attribute lists
+// (see fsearch_string_table.h), entries only store the id of their list. Returns the id of xattrs, it gets
+// added to the table if needed. FSEARCH_STRING_TABLE_NO_ID stands for the empty list.
+uint32_t
+db_entry_get_xattrs_id_for_xattrs(const char *xattrs, size_t xattrs_len);
+
+// Returns NULL for FSEARCH_STRING_TABLE_NO_ID
+const char *
+db_entry_get_xattrs_for_id(uint32_t xattrs_id, size_t *xattrs_len);
+
+// FSEARCH_STRING_TABLE_NO_ID if entry doesn't store them or has none
+uint32_t
+db_entry_get_xattrs_id(FsearchDatabaseEntry *entry);
+
+// Returns the value of the extended attribute name, NULL if entry doesn't have it
+const char *
+db_entry_get_xattr(FsearchDatabaseEntry *entry, const char *name, size_t *value_len);
+
 const char *
 db_entry_get_extension(FsearchDatabaseEntry *entry);
 
@@ -101,6 +236,8 @@ db_entry_get_name_for_display(FsearchDatabaseEntry *entry);
 const char *
 db_entry_get_name_raw_for_display(FsearchDatabaseEntry *entry);
 
+// Front coded names are decoded into a buffer of the calling thread, which only stays valid for the next few
+// names decoded on it (NAME_BLOCKS_NUM_DECODED). Copy the name if it's needed any longer.
 const char *
 db_entry_get_name_raw(FsearchDatabaseEntry *entry);
 
@@ -110,12 +247,31 @@ db_entry_get_parent(FsearchDatabaseEntry *entry);
 FsearchDatabaseEntryType
 db_entry_get_type(FsearchDatabaseEntry *entry);
 
+// Whether the name of entry only consists of ASCII characters, which is determined once when it's set
+bool
+db_entry_name_is_ascii(FsearchDatabaseEntry *entry);
+
 void
 db_entry_append_content_type(FsearchDatabaseEntry *entry, GString *str);
 
+// The non-localized description of the type of entry, as guessed from its name. It's computed only once per
+// name pattern (e.g. extension) and the returned string stays valid until the program exits.
+const char *
+db_entry_get_file_type(FsearchDatabaseEntry *entry);
+
 void
 db_entry_destroy(FsearchDatabaseEntry *entry);
 
+// Creates an entry which isn't part of any database, e.g. to look up
+// the entry with the given name and parent in a sorted array
+FsearchDatabaseEntry *
+db_entry_get_dummy_for_name_and_parent(FsearchDatabaseEntryFolder *parent,
+                                       const char *name,
+                                       FsearchDatabaseEntryType type);
+
+void
+db_entry_free_dummy(FsearchDatabaseEntry *entry);
+
 int
 db_entry_compare_entries_by_extension(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
 
@@ -128,9 +284,46 @@ db_entry_compare_entries_by_type(FsearchDatabaseEntry **a, FsearchDatabaseEntry
 int
 db_entry_compare_entries_by_modification_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
 
+int
+db_entry_compare_entries_by_access_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
+
+int
+db_entry_compare_entries_by_creation_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
+
+int
+db_entry_compare_entries_by_status_change_time(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
+
+int
+db_entry_compare_entries_by_owner(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
+
 int
 db_entry_compare_entries_by_position(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
 
+// Keys for darray_sort_by_key, which result in the same order as the compare functions
+uint64_t
+db_entry_get_size_sort_key(FsearchDatabaseEntry *entry, void *data);
+
+uint64_t
+db_entry_get_modification_time_sort_key(FsearchDatabaseEntry *entry, void *data);
+
+uint64_t
+db_entry_get_access_time_sort_key(FsearchDatabaseEntry *entry, void *data);
+
+uint64_t
+db_entry_get_creation_time_sort_key(FsearchDatabaseEntry *entry, void *data);
+
+uint64_t
+db_entry_get_status_change_time_sort_key(FsearchDatabaseEntry *entry, void *data);
+
+// Orders entries by the uid of their owner
+uint64_t
+db_entry_get_owner_sort_key(FsearchDatabaseEntry *entry, void *data);
+
+// Only consistent with db_entry_compare_entries_by_name, entries with the same key have to be compared,
+// see darray_sort_by_key_and_compare
+uint64_t
+db_entry_get_name_sort_key(FsearchDatabaseEntry *entry, void *data);
+
 int
 db_entry_compare_entries_by_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b);
 
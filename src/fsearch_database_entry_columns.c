@@ -0,0 +1,153 @@
+#define G_LOG_DOMAIN "fsearch-entry-columns"
+
+#include "fsearch_database_entry_columns.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+// Searches of different views might request the columns of the same array
+static GMutex columns_mutex;
+
+// All entries of a database store the same optional times, so the first one tells which columns are needed
+static int64_t *
+new_time_column(DynamicArray *entries, FsearchDatabaseIndexType type) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry) {
+            continue;
+        }
+        if (!db_entry_has_time(entry, type)) {
+            return NULL;
+        }
+        int64_t *times = calloc(num_entries + 1, sizeof(int64_t));
+        g_assert(times);
+        return times;
+    }
+    return NULL;
+}
+
+static bool
+entries_have_owners(DynamicArray *entries) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (entry) {
+            return db_entry_has_owner(entry);
+        }
+    }
+    return false;
+}
+
+static uint16_t *
+new_owner_column(uint32_t num_entries) {
+    uint16_t *values = calloc(num_entries + 1, sizeof(uint16_t));
+    g_assert(values);
+    return values;
+}
+
+FsearchDatabaseEntryColumns *
+db_entry_columns_new(DynamicArray *entries) {
+    g_assert(entries);
+
+    FsearchDatabaseEntryColumns *columns = calloc(1, sizeof(FsearchDatabaseEntryColumns));
+    g_assert(columns);
+
+    const uint32_t num_entries = darray_get_num_items(entries);
+    columns->num_entries = num_entries;
+    columns->sizes = calloc(num_entries + 1, sizeof(int64_t));
+    g_assert(columns->sizes);
+    columns->mtimes = calloc(num_entries + 1, sizeof(int64_t));
+    g_assert(columns->mtimes);
+    columns->types = calloc(num_entries + 1, sizeof(uint8_t));
+    g_assert(columns->types);
+    columns->atimes = new_time_column(entries, DATABASE_INDEX_TYPE_ACCESS_TIME);
+    columns->btimes = new_time_column(entries, DATABASE_INDEX_TYPE_CREATION_TIME);
+    columns->ctimes = new_time_column(entries, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME);
+    if (entries_have_owners(entries)) {
+        columns->user_ids = new_owner_column(num_entries);
+        columns->group_ids = new_owner_column(num_entries);
+        columns->modes = new_owner_column(num_entries);
+    }
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry) {
+            continue;
+        }
+        columns->sizes[i] = db_entry_get_size(entry);
+        columns->mtimes[i] = db_entry_get_mtime(entry);
+        columns->types[i] = db_entry_get_type(entry);
+        if (columns->atimes) {
+            columns->atimes[i] = db_entry_get_time(entry, DATABASE_INDEX_TYPE_ACCESS_TIME);
+        }
+        if (columns->btimes) {
+            columns->btimes[i] = db_entry_get_time(entry, DATABASE_INDEX_TYPE_CREATION_TIME);
+        }
+        if (columns->ctimes) {
+            columns->ctimes[i] = db_entry_get_time(entry, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME);
+        }
+        if (columns->user_ids) {
+            columns->user_ids[i] = db_entry_get_user_id(entry);
+            columns->group_ids[i] = db_entry_get_group_id(entry);
+            columns->modes[i] = db_entry_get_mode(entry);
+        }
+    }
+
+    return columns;
+}
+
+void
+db_entry_columns_free(FsearchDatabaseEntryColumns *columns) {
+    if (!columns) {
+        return;
+    }
+    g_clear_pointer(&columns->sizes, free);
+    g_clear_pointer(&columns->mtimes, free);
+    g_clear_pointer(&columns->atimes, free);
+    g_clear_pointer(&columns->btimes, free);
+    g_clear_pointer(&columns->ctimes, free);
+    g_clear_pointer(&columns->user_ids, free);
+    g_clear_pointer(&columns->group_ids, free);
+    g_clear_pointer(&columns->modes, free);
+    g_clear_pointer(&columns->types, free);
+    g_clear_pointer(&columns, free);
+}
+
+FsearchDatabaseEntryColumns *
+db_entry_columns_get(DynamicArray *entries) {
+    g_assert(entries);
+
+    g_mutex_lock(&columns_mutex);
+    FsearchDatabaseEntryColumns *columns = darray_get_user_data(entries);
+    if (!columns || columns->num_entries != darray_get_num_items(entries)) {
+        g_autoptr(GTimer) timer = g_timer_new();
+        columns = db_entry_columns_new(entries);
+        darray_set_user_data(entries, columns, (GDestroyNotify)db_entry_columns_free);
+        g_debug("[columns] built for %d entries in %f s", columns->num_entries, g_timer_elapsed(timer, NULL));
+    }
+    g_mutex_unlock(&columns_mutex);
+
+    return columns;
+}
+
+size_t
+db_entry_columns_get_memory_usage(DynamicArray *entries) {
+    g_assert(entries);
+
+    g_mutex_lock(&columns_mutex);
+    FsearchDatabaseEntryColumns *columns = darray_get_user_data(entries);
+    size_t size = 0;
+    if (columns) {
+        const size_t num_time_columns = (columns->atimes ? 1 : 0) + (columns->btimes ? 1 : 0)
+                                      + (columns->ctimes ? 1 : 0);
+        size = sizeof(FsearchDatabaseEntryColumns)
+             + (columns->num_entries + 1) * ((2 + num_time_columns) * sizeof(int64_t) + sizeof(uint8_t));
+        if (columns->user_ids) {
+            size += 3 * (columns->num_entries + 1) * sizeof(uint16_t);
+        }
+    }
+    g_mutex_unlock(&columns_mutex);
+
+    return size;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_entry.h"
+
+// Copies of the numeric entry attributes in separate, contiguous arrays which are aligned with
+// the entry array they were built from: the attributes of darray_get_item(entries, i) are
+// found at index i. This allows numeric filters to scan large databases without touching
+// the entries themselves.
+typedef struct FsearchDatabaseEntryColumns {
+    uint32_t num_entries;
+    int64_t *sizes;
+    int64_t *mtimes;
+    // the optional times, NULL unless the entries store them (see db_set_optional_times)
+    int64_t *atimes;
+    int64_t *btimes;
+    int64_t *ctimes;
+    // the dictionary ids of the owner and group and the mode, NULL unless the entries store them
+    // (see db_set_index_owners)
+    uint16_t *user_ids;
+    uint16_t *group_ids;
+    uint16_t *modes;
+    uint8_t *types;
+} FsearchDatabaseEntryColumns;
+
+FsearchDatabaseEntryColumns *
+db_entry_columns_new(DynamicArray *entries);
+
+void
+db_entry_columns_free(FsearchDatabaseEntryColumns *columns);
+
+// Returns the columns for entries, they are built on first use and stay attached to the array
+// until its content changes. The caller must prevent concurrent modifications of entries and
+// of the attributes of its items (i.e. hold the database lock).
+FsearchDatabaseEntryColumns *
+db_entry_columns_get(DynamicArray *entries);
+
+// Returns the number of bytes allocated for the columns which are attached to entries, 0 if there are none
+size_t
+db_entry_columns_get_memory_usage(DynamicArray *entries);
@@ -1 +1,36 @@
 #include "fsearch_database_index.h"
+
+#include <glib.h>
+#include <string.h>
+
+FsearchDatabaseIndexType
+db_index_type_from_name(const char *name) {
+    if (!name) {
+        g_warning("[db_index_type_from_name] name is nullptr");
+        return DATABASE_INDEX_TYPE_NAME;
+    }
+    if (!strcmp(name, DATABASE_INDEX_TYPE_NAME_STRING)) {
+        return DATABASE_INDEX_TYPE_NAME;
+    }
+    else if (!strcmp(name, DATABASE_INDEX_TYPE_PATH_STRING)) {
+        return DATABASE_INDEX_TYPE_PATH;
+    }
+    else if (!strcmp(name, DATABASE_INDEX_TYPE_SIZE_STRING)) {
+        return DATABASE_INDEX_TYPE_SIZE;
+    }
+    else if (!strcmp(name, DATABASE_INDEX_TYPE_MODIFICATION_TIME_STRING)) {
+        return DATABASE_INDEX_TYPE_MODIFICATION_TIME;
+    }
+    else if (!strcmp(name, DATABASE_INDEX_TYPE_EXTENSION_STRING)) {
+        return DATABASE_INDEX_TYPE_EXTENSION;
+    }
+    else if (!strcmp(name, DATABASE_INDEX_TYPE_FILETYPE_STRING)) {
+        return DATABASE_INDEX_TYPE_FILETYPE;
+    }
+    else if (!strcmp(name, DATABASE_INDEX_TYPE_RELEVANCE_STRING)) {
+        return DATABASE_INDEX_TYPE_RELEVANCE;
+    }
+    else {
+        return DATABASE_INDEX_TYPE_NAME;
+    }
+}
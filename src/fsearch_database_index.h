@@ -6,6 +6,8 @@
 #define DATABASE_INDEX_TYPE_MODIFICATION_TIME_STRING "Date Modified"
 #define DATABASE_INDEX_TYPE_FILETYPE_STRING "Type"
 #define DATABASE_INDEX_TYPE_EXTENSION_STRING "Extension"
+#define DATABASE_INDEX_TYPE_OWNER_STRING "Owner"
+#define DATABASE_INDEX_TYPE_RELEVANCE_STRING "Relevance"
 
 typedef enum {
     DATABASE_INDEX_FLAG_NAME = 1 << 0,
@@ -15,8 +17,19 @@ typedef enum {
     DATABASE_INDEX_FLAG_ACCESS_TIME = 1 << 4,
     DATABASE_INDEX_FLAG_CREATION_TIME = 1 << 5,
     DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME = 1 << 6,
+    // the owner, group and permissions
+    DATABASE_INDEX_FLAG_OWNER = 1 << 7,
+    // the extended attributes which were selected with db_set_xattrs
+    DATABASE_INDEX_FLAG_XATTRS = 1 << 8,
 } FsearchDatabaseIndexFlags;
 
+// the times which only get indexed if they're enabled, see db_set_optional_times
+#define DATABASE_INDEX_FLAGS_OPTIONAL_TIMES                                                                          \
+    (DATABASE_INDEX_FLAG_ACCESS_TIME | DATABASE_INDEX_FLAG_CREATION_TIME | DATABASE_INDEX_FLAG_STATUS_CHANGE_TIME)
+// everything entries only store if it's enabled, see db_set_optional_times, db_set_index_owners and db_set_xattrs
+#define DATABASE_INDEX_FLAGS_OPTIONAL                                                                                \
+    (DATABASE_INDEX_FLAGS_OPTIONAL_TIMES | DATABASE_INDEX_FLAG_OWNER | DATABASE_INDEX_FLAG_XATTRS)
+
 typedef enum {
     DATABASE_INDEX_TYPE_NAME,
     DATABASE_INDEX_TYPE_PATH,
@@ -27,5 +40,13 @@ typedef enum {
     DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME,
     DATABASE_INDEX_TYPE_FILETYPE,
     DATABASE_INDEX_TYPE_EXTENSION,
+    DATABASE_INDEX_TYPE_OWNER,
+    // how well the entries match the query, there's no sorted array of the database for that
+    DATABASE_INDEX_TYPE_RELEVANCE,
     NUM_DATABASE_INDEX_TYPES,
 } FsearchDatabaseIndexType;
+
+// The type of one of the DATABASE_INDEX_TYPE_*_STRING names, e.g. the sort order stored in the config. Unknown
+// names are DATABASE_INDEX_TYPE_NAME.
+FsearchDatabaseIndexType
+db_index_type_from_name(const char *name);
@@ -0,0 +1,217 @@
+#define G_LOG_DOMAIN "fsearch-database-journal"
+
+#include "fsearch_database_journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DATABASE_JOURNAL_MAGIC_NUMBER "FSJL"
+#define DATABASE_JOURNAL_VERSION 0
+// magic number, version and the time of the first record
+#define DATABASE_JOURNAL_HEADER_SIZE (4 + 1 + 8)
+// records with longer paths are considered to be corrupted
+#define DATABASE_JOURNAL_MAX_PATH_LEN (64 * 1024)
+
+struct FsearchDatabaseJournal {
+    FILE *fp;
+    uint64_t size;
+    time_t first_record_time;
+};
+
+static bool
+db_journal_read_header(FILE *fp, time_t *first_record_time) {
+    char magic[4] = "";
+    uint8_t version = 0;
+    int64_t timestamp = 0;
+    if (fread(magic, 1, 4, fp) != 4 || fread(&version, 1, 1, fp) != 1 || fread(&timestamp, 8, 1, fp) != 1) {
+        return false;
+    }
+    if (strncmp(magic, DATABASE_JOURNAL_MAGIC_NUMBER, 4) != 0 || version != DATABASE_JOURNAL_VERSION) {
+        g_debug("invalid journal header");
+        return false;
+    }
+    *first_record_time = (time_t)timestamp;
+    return true;
+}
+
+static bool
+db_journal_write_header(FILE *fp, time_t first_record_time) {
+    const uint8_t version = DATABASE_JOURNAL_VERSION;
+    const int64_t timestamp = first_record_time;
+    return fwrite(DATABASE_JOURNAL_MAGIC_NUMBER, 1, 4, fp) == 4 && fwrite(&version, 1, 1, fp) == 1
+        && fwrite(&timestamp, 8, 1, fp) == 1;
+}
+
+// Reads the record at the current position, returns NULL at the end of the journal or if the record is incomplete
+static char *
+db_journal_read_record(FILE *fp) {
+    uint32_t path_len = 0;
+    if (fread(&path_len, 4, 1, fp) != 1) {
+        return NULL;
+    }
+    if (path_len == 0 || path_len > DATABASE_JOURNAL_MAX_PATH_LEN) {
+        g_debug("invalid journal record");
+        return NULL;
+    }
+    char *path = g_malloc(path_len + 1);
+    if (fread(path, 1, path_len, fp) != path_len) {
+        g_clear_pointer(&path, g_free);
+        return NULL;
+    }
+    path[path_len] = '\0';
+    return path;
+}
+
+FsearchDatabaseJournal *
+db_journal_open(const char *path) {
+    g_assert(path);
+
+    time_t first_record_time = 0;
+    FILE *fp = fopen(path, "r+b");
+    if (fp && !db_journal_read_header(fp, &first_record_time)) {
+        // start over with an empty journal
+        g_clear_pointer(&fp, fclose);
+    }
+    if (fp) {
+        // new records are appended after the last complete one
+        off_t end = ftello(fp);
+        char *record = NULL;
+        while ((record = db_journal_read_record(fp))) {
+            g_clear_pointer(&record, g_free);
+            end = ftello(fp);
+        }
+        if (fseeko(fp, end, SEEK_SET) != 0 || ftruncate(fileno(fp), end) != 0) {
+            g_clear_pointer(&fp, fclose);
+            return NULL;
+        }
+    }
+    if (!fp) {
+        fp = fopen(path, "w+b");
+        if (!fp || !db_journal_write_header(fp, 0)) {
+            g_debug("failed to create journal: %s", path);
+            g_clear_pointer(&fp, fclose);
+            return NULL;
+        }
+    }
+    if (fseeko(fp, 0, SEEK_END) != 0) {
+        g_clear_pointer(&fp, fclose);
+        return NULL;
+    }
+
+    FsearchDatabaseJournal *journal = calloc(1, sizeof(FsearchDatabaseJournal));
+    g_assert(journal);
+    journal->fp = fp;
+    journal->size = ftello(fp);
+    journal->first_record_time = first_record_time;
+    return journal;
+}
+
+void
+db_journal_close(FsearchDatabaseJournal *journal) {
+    if (!journal) {
+        return;
+    }
+    g_clear_pointer(&journal->fp, fclose);
+    g_clear_pointer(&journal, free);
+}
+
+bool
+db_journal_append_paths(FsearchDatabaseJournal *journal, GPtrArray *paths) {
+    g_assert(journal);
+    g_assert(paths);
+
+    if (paths->len == 0) {
+        return true;
+    }
+
+    if (journal->first_record_time == 0) {
+        journal->first_record_time = time(NULL);
+        if (fseeko(journal->fp, 0, SEEK_SET) != 0 || !db_journal_write_header(journal->fp, journal->first_record_time)
+            || fseeko(journal->fp, 0, SEEK_END) != 0) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < paths->len; i++) {
+        const char *path = g_ptr_array_index(paths, i);
+        const size_t len = strlen(path);
+        if (len > DATABASE_JOURNAL_MAX_PATH_LEN) {
+            continue;
+        }
+        const uint32_t path_len = (uint32_t)len;
+        if (fwrite(&path_len, 4, 1, journal->fp) != 1 || fwrite(path, 1, len, journal->fp) != len) {
+            g_debug("failed to append to journal");
+            return false;
+        }
+        journal->size += 4 + len;
+    }
+    // the records should survive a crash of the application
+    return fflush(journal->fp) == 0;
+}
+
+bool
+db_journal_remove_records_before(FsearchDatabaseJournal *journal, uint64_t offset) {
+    g_assert(journal);
+
+    if (offset <= DATABASE_JOURNAL_HEADER_SIZE) {
+        return true;
+    }
+
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+    if (offset < journal->size) {
+        if (fseeko(journal->fp, (off_t)offset, SEEK_SET) != 0) {
+            return false;
+        }
+        char *record = NULL;
+        while ((record = db_journal_read_record(journal->fp))) {
+            g_ptr_array_add(paths, record);
+        }
+    }
+
+    if (fseeko(journal->fp, 0, SEEK_SET) != 0 || ftruncate(fileno(journal->fp), 0) != 0
+        || !db_journal_write_header(journal->fp, 0)) {
+        g_debug("failed to rewrite journal");
+        return false;
+    }
+    journal->size = DATABASE_JOURNAL_HEADER_SIZE;
+    journal->first_record_time = 0;
+    const bool res = db_journal_append_paths(journal, paths);
+    return fflush(journal->fp) == 0 && res;
+}
+
+uint64_t
+db_journal_get_size(FsearchDatabaseJournal *journal) {
+    g_assert(journal);
+    return journal->size;
+}
+
+time_t
+db_journal_get_first_record_time(FsearchDatabaseJournal *journal) {
+    g_assert(journal);
+    return journal->first_record_time;
+}
+
+GPtrArray *
+db_journal_read_paths(const char *path) {
+    g_assert(path);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    time_t first_record_time = 0;
+    if (!db_journal_read_header(fp, &first_record_time)) {
+        g_clear_pointer(&fp, fclose);
+        return NULL;
+    }
+
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    char *record = NULL;
+    while ((record = db_journal_read_record(fp))) {
+        g_ptr_array_add(paths, record);
+    }
+    g_clear_pointer(&fp, fclose);
+    return paths;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// A journal of the paths which were updated since the database file was written. Replaying it means
+// bringing those paths up to date with the filesystem again, so replaying a record twice or replaying
+// records which are already part of the database file is harmless.
+typedef struct FsearchDatabaseJournal FsearchDatabaseJournal;
+
+// Opens the journal at path for appending, it gets created if it doesn't exist yet
+FsearchDatabaseJournal *
+db_journal_open(const char *path);
+
+void
+db_journal_close(FsearchDatabaseJournal *journal);
+
+bool
+db_journal_append_paths(FsearchDatabaseJournal *journal, GPtrArray *paths);
+
+// Removes all records which were appended before the journal had a size of offset bytes
+bool
+db_journal_remove_records_before(FsearchDatabaseJournal *journal, uint64_t offset);
+
+// Size of the journal file in bytes
+uint64_t
+db_journal_get_size(FsearchDatabaseJournal *journal);
+
+// Time when the first record was added to the journal, 0 if it's empty
+time_t
+db_journal_get_first_record_time(FsearchDatabaseJournal *journal);
+
+// Returns the paths of all complete records of the journal at path, or NULL if there's no valid journal.
+// A truncated record at the end (e.g. from a crash while appending) is ignored.
+GPtrArray *
+db_journal_read_paths(const char *path);
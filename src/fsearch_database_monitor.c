@@ -0,0 +1,519 @@
+#define G_LOG_DOMAIN "fsearch-database-monitor"
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "fsearch_database_monitor.h"
+#include "fsearch_database_entry.h"
+#include "fsearch_index.h"
+#include "fsearch_limits.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#endif
+
+// Events are collected until nothing happened for this amount of time...
+#define MONITOR_BATCH_QUIET_TIME_MS 250
+// ...but they're never held back longer than this
+#define MONITOR_BATCH_MAX_DELAY_MS 2000
+
+#define MONITOR_EVENT_BUFFER_SIZE (64 * 1024)
+
+#ifdef __linux__
+#define MONITOR_INOTIFY_MASK                                                                                           \
+    (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR | IN_DONT_FOLLOW     \
+     | IN_EXCL_UNLINK)
+#ifdef FAN_REPORT_DFID_NAME
+#define MONITOR_FANOTIFY_MASK                                                                                          \
+    (FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_ONDIR)
+#endif
+#endif
+
+typedef struct {
+    // a file descriptor on the filesystem, required to resolve file handles
+    int fd;
+    fsid_t fsid;
+} FsearchDatabaseMonitorMount;
+
+struct FsearchDatabaseMonitor {
+    FsearchDatabase *db;
+    FsearchDatabaseMonitorBackend backend;
+
+    int fd;
+    int wakeup_pipe[2];
+
+    // paths of all monitored indexes
+    GPtrArray *index_paths;
+    // fanotify: all filesystems with a mark
+    GArray *mounts;
+    // inotify: maps watch descriptors to folder paths
+    GHashTable *watches;
+    bool watch_limit_reached;
+
+    // paths which changed since the last update of the database
+    GHashTable *pending_paths;
+    gint64 first_event_time;
+    gint64 last_event_time;
+
+    FsearchDatabaseMonitorOverflowFunc overflow_func;
+    gpointer overflow_func_data;
+
+    GThread *thread;
+};
+
+static bool
+monitor_path_is_indexed(FsearchDatabaseMonitor *monitor, const char *path) {
+    for (uint32_t i = 0; i < monitor->index_paths->len; i++) {
+        const char *index_path = g_ptr_array_index(monitor->index_paths, i);
+        if (!strcmp(index_path, G_DIR_SEPARATOR_S)) {
+            return true;
+        }
+        const size_t len = strlen(index_path);
+        if (!strncmp(path, index_path, len) && (path[len] == G_DIR_SEPARATOR || path[len] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+monitor_add_pending_path(FsearchDatabaseMonitor *monitor, char *path) {
+    if (!monitor_path_is_indexed(monitor, path)) {
+        g_free(path);
+        return;
+    }
+    const gint64 now = g_get_monotonic_time();
+    if (g_hash_table_size(monitor->pending_paths) == 0) {
+        monitor->first_event_time = now;
+    }
+    monitor->last_event_time = now;
+    g_hash_table_add(monitor->pending_paths, path);
+}
+
+static void
+monitor_notify_overflow(FsearchDatabaseMonitor *monitor) {
+    g_debug("[monitor] event queue overflow");
+    if (monitor->overflow_func) {
+        monitor->overflow_func(monitor->overflow_func_data);
+    }
+}
+
+#ifdef __linux__
+static void
+monitor_inotify_add_watch(FsearchDatabaseMonitor *monitor, const char *path) {
+    if (monitor->watch_limit_reached) {
+        return;
+    }
+    const int wd = inotify_add_watch(monitor->fd, path, MONITOR_INOTIFY_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC) {
+            g_warning("[monitor] inotify watch limit reached, changes below %s won't be noticed. "
+                      "Consider raising fs.inotify.max_user_watches",
+                      path);
+            monitor->watch_limit_reached = true;
+        }
+        return;
+    }
+    // Adding a watch for a folder which is already watched returns the same watch descriptor,
+    // so moved folders get their path updated here.
+    g_hash_table_insert(monitor->watches, GINT_TO_POINTER(wd), g_strdup(path));
+}
+
+static void
+monitor_inotify_add_watches_recursive(FsearchDatabaseMonitor *monitor, GString *path) {
+    monitor_inotify_add_watch(monitor, path->str);
+
+    DIR *dir = opendir(path->str);
+    if (!dir) {
+        return;
+    }
+    const gsize path_len = path->len;
+
+    struct dirent *dent = NULL;
+    while ((dent = readdir(dir))) {
+        if (!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, "..")) {
+            continue;
+        }
+        g_string_truncate(path, path_len);
+        if (path_len == 0 || path->str[path_len - 1] != G_DIR_SEPARATOR) {
+            g_string_append_c(path, G_DIR_SEPARATOR);
+        }
+        g_string_append(path, dent->d_name);
+
+        bool is_dir = dent->d_type == DT_DIR;
+        if (dent->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = !lstat(path->str, &st) && S_ISDIR(st.st_mode);
+        }
+        if (is_dir) {
+            monitor_inotify_add_watches_recursive(monitor, path);
+        }
+    }
+    g_string_truncate(path, path_len);
+    g_clear_pointer(&dir, closedir);
+}
+
+static void
+monitor_inotify_add_database_watches(FsearchDatabaseMonitor *monitor) {
+    db_lock(monitor->db);
+    DynamicArray *folders = db_get_folders(monitor->db);
+    db_unlock(monitor->db);
+    if (!folders) {
+        return;
+    }
+
+    g_autoptr(GString) path = g_string_sized_new(PATH_MAX);
+    const uint32_t num_folders = darray_get_num_items(folders);
+    for (uint32_t i = 0; i < num_folders && !monitor->watch_limit_reached; i++) {
+        FsearchDatabaseEntry *folder = darray_get_item(folders, i);
+        g_string_truncate(path, 0);
+        db_entry_append_full_path(folder, path);
+        monitor_inotify_add_watch(monitor, path->str);
+    }
+    g_clear_pointer(&folders, darray_unref);
+
+    g_debug("[monitor] watching %d folders with inotify", g_hash_table_size(monitor->watches));
+}
+
+static void
+monitor_inotify_read_events(FsearchDatabaseMonitor *monitor) {
+    char buffer[MONITOR_EVENT_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        const ssize_t len = read(monitor->fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            return;
+        }
+        for (char *ptr = buffer; ptr < buffer + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                monitor_notify_overflow(monitor);
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                g_hash_table_remove(monitor->watches, GINT_TO_POINTER(event->wd));
+                continue;
+            }
+            const char *dir_path = g_hash_table_lookup(monitor->watches, GINT_TO_POINTER(event->wd));
+            if (!dir_path) {
+                continue;
+            }
+            if (event->len > 0) {
+                monitor_add_pending_path(monitor, g_build_filename(dir_path, event->name, NULL));
+            }
+            else {
+                monitor_add_pending_path(monitor, g_strdup(dir_path));
+            }
+        }
+    }
+}
+
+#ifdef FAN_REPORT_DFID_NAME
+static int
+monitor_fanotify_get_mount_fd(FsearchDatabaseMonitor *monitor, const void *fsid) {
+    for (uint32_t i = 0; i < monitor->mounts->len; i++) {
+        FsearchDatabaseMonitorMount *mount = &g_array_index(monitor->mounts, FsearchDatabaseMonitorMount, i);
+        if (!memcmp(&mount->fsid, fsid, sizeof(mount->fsid))) {
+            return mount->fd;
+        }
+    }
+    return -1;
+}
+
+static void
+monitor_fanotify_read_events(FsearchDatabaseMonitor *monitor) {
+    char buffer[MONITOR_EVENT_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+    while (true) {
+        ssize_t len = read(monitor->fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            return;
+        }
+        struct fanotify_event_metadata *metadata = (struct fanotify_event_metadata *)buffer;
+        for (; FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len)) {
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                g_warning("[monitor] unexpected fanotify metadata version");
+                return;
+            }
+            if (metadata->fd >= 0) {
+                close(metadata->fd);
+            }
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                monitor_notify_overflow(monitor);
+                continue;
+            }
+
+            struct fanotify_event_info_fid *fid = (struct fanotify_event_info_fid *)(metadata + 1);
+            if (fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                continue;
+            }
+            struct file_handle *handle = (struct file_handle *)fid->handle;
+            const char *name = (const char *)(handle->f_handle + handle->handle_bytes);
+
+            const int mount_fd = monitor_fanotify_get_mount_fd(monitor, &fid->fsid);
+            if (mount_fd < 0) {
+                continue;
+            }
+            const int dir_fd = open_by_handle_at(mount_fd, handle, O_PATH);
+            if (dir_fd < 0) {
+                // the parent folder is already gone, its own deletion event takes care of the entry
+                continue;
+            }
+
+            char proc_path[64] = "";
+            snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", dir_fd);
+            char dir_path[PATH_MAX] = "";
+            const ssize_t dir_path_len = readlink(proc_path, dir_path, sizeof(dir_path) - 1);
+            close(dir_fd);
+            if (dir_path_len <= 0) {
+                continue;
+            }
+            dir_path[dir_path_len] = '\0';
+
+            if (name[0] == '\0' || !strcmp(name, ".")) {
+                monitor_add_pending_path(monitor, g_strdup(dir_path));
+            }
+            else {
+                monitor_add_pending_path(monitor, g_build_filename(dir_path, name, NULL));
+            }
+        }
+    }
+}
+
+static bool
+monitor_fanotify_init(FsearchDatabaseMonitor *monitor) {
+    monitor->fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY);
+    if (monitor->fd < 0) {
+        g_debug("[monitor] fanotify not available: %s", g_strerror(errno));
+        return false;
+    }
+
+    monitor->mounts = g_array_new(FALSE, TRUE, sizeof(FsearchDatabaseMonitorMount));
+    for (uint32_t i = 0; i < monitor->index_paths->len; i++) {
+        const char *path = g_ptr_array_index(monitor->index_paths, i);
+        if (fanotify_mark(monitor->fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, MONITOR_FANOTIFY_MASK, AT_FDCWD, path)) {
+            g_debug("[monitor] fanotify mark failed for %s: %s", path, g_strerror(errno));
+            goto fail;
+        }
+        FsearchDatabaseMonitorMount mount = {};
+        struct statfs st;
+        mount.fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (mount.fd < 0 || fstatfs(mount.fd, &st)) {
+            if (mount.fd >= 0) {
+                close(mount.fd);
+            }
+            goto fail;
+        }
+        memcpy(&mount.fsid, &st.f_fsid, sizeof(mount.fsid));
+        g_array_append_val(monitor->mounts, mount);
+    }
+    return true;
+
+fail:
+    for (uint32_t i = 0; i < monitor->mounts->len; i++) {
+        close(g_array_index(monitor->mounts, FsearchDatabaseMonitorMount, i).fd);
+    }
+    g_clear_pointer(&monitor->mounts, g_array_unref);
+    close(monitor->fd);
+    monitor->fd = -1;
+    return false;
+}
+#endif
+
+static bool
+monitor_inotify_init(FsearchDatabaseMonitor *monitor) {
+    monitor->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (monitor->fd < 0) {
+        g_warning("[monitor] inotify not available: %s", g_strerror(errno));
+        return false;
+    }
+    monitor->watches = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    return true;
+}
+#endif
+
+static void
+monitor_flush(FsearchDatabaseMonitor *monitor) {
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_full(g_hash_table_size(monitor->pending_paths), g_free);
+    GHashTableIter iter;
+    gpointer key = NULL;
+    g_hash_table_iter_init(&iter, monitor->pending_paths);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        g_ptr_array_add(paths, key);
+        g_hash_table_iter_steal(&iter);
+    }
+
+#ifdef __linux__
+    if (monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_INOTIFY) {
+        // new or moved folders need to be watched too
+        g_autoptr(GString) path = g_string_sized_new(PATH_MAX);
+        for (uint32_t i = 0; i < paths->len; i++) {
+            struct stat st;
+            const char *p = g_ptr_array_index(paths, i);
+            if (!lstat(p, &st) && S_ISDIR(st.st_mode)) {
+                g_string_assign(path, p);
+                monitor_inotify_add_watches_recursive(monitor, path);
+            }
+        }
+    }
+#endif
+
+    db_update_paths(monitor->db, paths);
+}
+
+static gpointer
+monitor_thread_func(gpointer data) {
+    FsearchDatabaseMonitor *monitor = data;
+
+#ifdef __linux__
+    if (monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_INOTIFY) {
+        monitor_inotify_add_database_watches(monitor);
+    }
+#endif
+
+    struct pollfd fds[2] = {
+        {.fd = monitor->fd, .events = POLLIN},
+        {.fd = monitor->wakeup_pipe[0], .events = POLLIN},
+    };
+
+    while (true) {
+        const bool has_pending_paths = g_hash_table_size(monitor->pending_paths) > 0;
+        const int res = poll(fds, G_N_ELEMENTS(fds), has_pending_paths ? MONITOR_BATCH_QUIET_TIME_MS : -1);
+        if (res < 0 && errno != EINTR) {
+            g_warning("[monitor] poll failed: %s", g_strerror(errno));
+            break;
+        }
+        if (fds[1].revents) {
+            // the monitor is getting freed
+            break;
+        }
+        if (res > 0 && (fds[0].revents & POLLIN)) {
+#ifdef __linux__
+#ifdef FAN_REPORT_DFID_NAME
+            if (monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_FANOTIFY) {
+                monitor_fanotify_read_events(monitor);
+            }
+#endif
+            if (monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_INOTIFY) {
+                monitor_inotify_read_events(monitor);
+            }
+#endif
+        }
+
+        if (g_hash_table_size(monitor->pending_paths) == 0) {
+            continue;
+        }
+        const gint64 now = g_get_monotonic_time();
+        if (now - monitor->last_event_time >= MONITOR_BATCH_QUIET_TIME_MS * 1000
+            || now - monitor->first_event_time >= MONITOR_BATCH_MAX_DELAY_MS * 1000) {
+            monitor_flush(monitor);
+        }
+    }
+    return NULL;
+}
+
+FsearchDatabaseMonitor *
+fsearch_database_monitor_new(FsearchDatabase *db,
+                             GList *indexes,
+                             FsearchDatabaseMonitorOverflowFunc overflow_func,
+                             gpointer overflow_func_data) {
+    g_assert(db);
+#ifndef __linux__
+    g_debug("[monitor] filesystem monitoring is only supported on Linux");
+    return NULL;
+#else
+    FsearchDatabaseMonitor *monitor = calloc(1, sizeof(FsearchDatabaseMonitor));
+    g_assert(monitor);
+
+    monitor->fd = -1;
+    monitor->wakeup_pipe[0] = -1;
+    monitor->wakeup_pipe[1] = -1;
+    monitor->overflow_func = overflow_func;
+    monitor->overflow_func_data = overflow_func_data;
+    monitor->pending_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    monitor->index_paths = g_ptr_array_new_with_free_func(g_free);
+    for (GList *l = indexes; l != NULL; l = l->next) {
+        FsearchIndex *index = l->data;
+        if (index->path && index->enabled) {
+            g_ptr_array_add(monitor->index_paths, g_strdup(index->path));
+        }
+    }
+
+    if (monitor->index_paths->len == 0 || pipe2(monitor->wakeup_pipe, O_CLOEXEC)) {
+        g_clear_pointer(&monitor, fsearch_database_monitor_free);
+        return NULL;
+    }
+
+#ifdef FAN_REPORT_DFID_NAME
+    if (monitor_fanotify_init(monitor)) {
+        monitor->backend = FSEARCH_DATABASE_MONITOR_BACKEND_FANOTIFY;
+    }
+#endif
+    if (monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_NONE && monitor_inotify_init(monitor)) {
+        monitor->backend = FSEARCH_DATABASE_MONITOR_BACKEND_INOTIFY;
+    }
+    if (monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_NONE) {
+        g_clear_pointer(&monitor, fsearch_database_monitor_free);
+        return NULL;
+    }
+    g_debug("[monitor] using %s", monitor->backend == FSEARCH_DATABASE_MONITOR_BACKEND_FANOTIFY ? "fanotify" : "inotify");
+
+    monitor->db = db_ref(db);
+    monitor->thread = g_thread_new("fsearch_database_monitor", monitor_thread_func, monitor);
+
+    return monitor;
+#endif
+}
+
+void
+fsearch_database_monitor_free(FsearchDatabaseMonitor *monitor) {
+    if (!monitor) {
+        return;
+    }
+    if (monitor->thread) {
+        const char quit = 'q';
+        if (write(monitor->wakeup_pipe[1], &quit, 1) != 1) {
+            g_warning("[monitor] failed to stop monitor thread");
+        }
+        g_thread_join(g_steal_pointer(&monitor->thread));
+    }
+
+    if (monitor->mounts) {
+        for (uint32_t i = 0; i < monitor->mounts->len; i++) {
+            close(g_array_index(monitor->mounts, FsearchDatabaseMonitorMount, i).fd);
+        }
+        g_clear_pointer(&monitor->mounts, g_array_unref);
+    }
+    if (monitor->fd >= 0) {
+        close(monitor->fd);
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(monitor->wakeup_pipe); i++) {
+        if (monitor->wakeup_pipe[i] >= 0) {
+            close(monitor->wakeup_pipe[i]);
+        }
+    }
+
+    g_clear_pointer(&monitor->watches, g_hash_table_unref);
+    g_clear_pointer(&monitor->pending_paths, g_hash_table_unref);
+    g_clear_pointer(&monitor->index_paths, g_ptr_array_unref);
+    g_clear_pointer(&monitor->db, db_unref);
+    g_clear_pointer(&monitor, free);
+}
+
+FsearchDatabaseMonitorBackend
+fsearch_database_monitor_get_backend(FsearchDatabaseMonitor *monitor) {
+    return monitor ? monitor->backend : FSEARCH_DATABASE_MONITOR_BACKEND_NONE;
+}
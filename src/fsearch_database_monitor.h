@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include "fsearch_database.h"
+
+typedef struct FsearchDatabaseMonitor FsearchDatabaseMonitor;
+
+typedef enum {
+    FSEARCH_DATABASE_MONITOR_BACKEND_NONE,
+    FSEARCH_DATABASE_MONITOR_BACKEND_FANOTIFY,
+    FSEARCH_DATABASE_MONITOR_BACKEND_INOTIFY,
+} FsearchDatabaseMonitorBackend;
+
+// Called from the monitor thread when events got lost (e.g. the kernel event queue overflowed),
+// which means the database can only be brought up to date again by a rescan.
+typedef void (*FsearchDatabaseMonitorOverflowFunc)(gpointer user_data);
+
+FsearchDatabaseMonitor *
+fsearch_database_monitor_new(FsearchDatabase *db,
+                             GList *indexes,
+                             FsearchDatabaseMonitorOverflowFunc overflow_func,
+                             gpointer overflow_func_data);
+
+void
+fsearch_database_monitor_free(FsearchDatabaseMonitor *monitor);
+
+FsearchDatabaseMonitorBackend
+fsearch_database_monitor_get_backend(FsearchDatabaseMonitor *monitor);
@@ -25,167 +25,731 @@
 #include <string.h>
 
 #include "fsearch_array.h"
+#include "fsearch_database_entry_columns.h"
+#include "fsearch_name_index.h"
 #include "fsearch_query_match_data.h"
+#include "fsearch_trace.h"
+#include "fsearch_trigram_index.h"
 
 #define THRESHOLD_FOR_PARALLEL_SEARCH 1000
-
-typedef struct DatabaseSearchWorkerContext {
-    FsearchQuery *query;
-    void **results;
+// Threads grab chunks of this many entries until none are left, so threads which happen to get the entries
+// which are expensive to match don't hold up all others
+#define SEARCH_CHUNK_NUM_ENTRIES 16384
+// Arrays the trigram and name indexes weren't built for (e.g. the ones sorted by size) can only skip the entries
+// which aren't candidates one by one, which only pays off if there are lots of them
+#define THRESHOLD_FOR_CANDIDATE_BITMAP 100000
+// Searches which take longer than this publish the results they found so far, after that at most once per interval
+#define SEARCH_PROGRESS_FIRST_DELAY_US (50 * 1000)
+#define SEARCH_PROGRESS_INTERVAL_US (100 * 1000)
+// Every thread keeps up to this many result buffers of SEARCH_CHUNK_NUM_ENTRIES items for the following searches
+#define SEARCH_NUM_KEPT_RESULT_CHUNKS 8
+
+enum {
+    DATABASE_SEARCH_PASS_FOLDERS,
+    DATABASE_SEARCH_PASS_FILES,
+    NUM_DATABASE_SEARCH_PASSES,
+};
+
+// The search of one entry array
+typedef struct DatabaseSearchPass {
     DynamicArray *entries;
+    FsearchDatabaseEntryColumns *columns;
+    // the program of the query for the type of entries
+    FsearchQueryProgram *program;
+    uint32_t num_entries;
+    // if set, only the entries at these positions get searched, num_entries is the number of positions then
+    uint32_t *positions;
+    // otherwise the entries [first_position, first_position + num_entries) get searched
+    uint32_t first_position;
+    // if set, entries which are part of index_entries but not marked as candidates can't match
+    uint64_t *candidates;
+    DynamicArray *index_entries;
+    uint32_t num_index_entries;
+    uint32_t num_chunks;
+    // the results of every chunk are stored in their own buffer of SEARCH_CHUNK_NUM_ENTRIES items, so they can be
+    // concatenated in order once all chunks are done. Chunks only get a buffer once they have their first result.
+    void ***chunk_results;
+    uint32_t *num_chunk_results;
+    // only set if progress gets published or the results are limited
+    bool *chunk_done;
+    // chunks [0, num_done_chunks) are done, so their results are final
+    uint32_t num_done_chunks;
+    // at most this many results are kept, UINT32_MAX if they aren't limited
+    uint32_t max_results;
+    // if set, the results which come first in this order are kept, the threads collect them in heaps then
+    DynamicArrayCompareDataFunc compare_func;
+    // the results with the highest scores are kept instead, also collected in heaps
+    bool by_relevance;
+    // the number of results of chunks [0, num_done_chunks), once it reaches max_results the remaining chunks
+    // are skipped
+    uint32_t num_done_results;
+    volatile int limit_reached;
+    // the result of passes which were decided without searching any entry
+    DynamicArray *result;
+} DatabaseSearchPass;
+
+typedef struct DatabaseSearchContext {
+    FsearchQuery *query;
     GCancellable *cancellable;
-    int32_t thread_id;
-    uint32_t num_results;
-    uint32_t start_pos;
-    uint32_t end_pos;
-} DatabaseSearchWorkerContext;
+    FsearchFolderPaths *folder_paths;
+    FsearchFoldedNames *folded_names;
+    // The chunks of all passes are numbered consecutively and grabbed by the same threads, so once no folder
+    // chunks are left threads move on to the files instead of waiting for the last folder chunk to be done
+    DatabaseSearchPass passes[NUM_DATABASE_SEARCH_PASSES];
+    uint32_t num_chunks;
+    // the chunks which weren't grabbed by any thread yet. In NUMA aware pools threads grab the chunks of the part of
+    // a pass which was loaded by the same thread first, see fsearch_thread_pool_ranges_new.
+    FsearchThreadPoolRanges *chunks;
+    // if set, the results of the chunks which are done are published while the search is still running
+    DatabaseSearchProgressFunc progress_func;
+    void *progress_data;
+    GMutex progress_mutex;
+    int64_t next_publish_time;
+    bool publishing;
+} DatabaseSearchContext;
+
+// The memory a search task needs, the pool keeps one for every thread index and it gets reused by every search
+typedef struct DatabaseSearchScratch {
+    FsearchQueryMatchData *match_data;
+    // result buffers of SEARCH_CHUNK_NUM_ENTRIES items which aren't in use
+    void **free_result_chunks[SEARCH_NUM_KEPT_RESULT_CHUNKS];
+    uint32_t num_free_result_chunks;
+    // the scratch is kept by the pool and a search is using it, guarded by db_search_scratch_mutex
+    bool kept_by_pool;
+    bool in_use;
+} DatabaseSearchScratch;
+
+G_DEFINE_QUARK(fsearch-search-scratch, db_search_scratch)
+
+static GMutex db_search_scratch_mutex;
 
 static void
-db_search_worker_context_free(DatabaseSearchWorkerContext *ctx) {
-    if (!ctx) {
-        return;
+db_search_scratch_free(DatabaseSearchScratch *scratch) {
+    g_clear_pointer(&scratch->match_data, fsearch_query_match_data_free);
+    for (uint32_t i = 0; i < scratch->num_free_result_chunks; i++) {
+        free(scratch->free_result_chunks[i]);
     }
-
-    g_clear_pointer(&ctx->results, free);
-    g_clear_pointer(&ctx->entries, darray_unref);
-    g_clear_pointer(&ctx, free);
+    g_clear_pointer(&scratch, free);
 }
 
-static DatabaseSearchWorkerContext *
-db_search_worker_context_new(FsearchQuery *query,
-                             GCancellable *cancellable,
-                             DynamicArray *entries,
-                             int32_t thread_id,
-                             uint32_t start_pos,
-                             uint32_t end_pos) {
-    DatabaseSearchWorkerContext *ctx = calloc(1, sizeof(DatabaseSearchWorkerContext));
-    g_assert(ctx);
-    g_assert(end_pos >= start_pos);
-
-    ctx->query = query;
-    ctx->cancellable = cancellable;
-    ctx->results = calloc(end_pos - start_pos + 1, sizeof(void *));
-    g_assert(ctx->results);
+static DatabaseSearchScratch *
+db_search_scratch_new(void) {
+    DatabaseSearchScratch *scratch = calloc(1, sizeof(DatabaseSearchScratch));
+    g_assert(scratch);
+    scratch->match_data = fsearch_query_match_data_new();
+    return scratch;
+}
 
-    ctx->num_results = 0;
-    ctx->entries = darray_ref(entries);
-    ctx->start_pos = start_pos;
-    ctx->end_pos = end_pos;
-    ctx->thread_id = thread_id;
-    return ctx;
+// The scratch a pool keeps for thread_idx goes to the first search which asks for it. Other searches which run on
+// the same pool at that time (e.g. the ones of several views) get a scratch of their own, which is freed by
+// db_search_scratch_release.
+static DatabaseSearchScratch *
+db_search_scratch_acquire(FsearchThreadPool *pool, uint32_t thread_idx) {
+    g_mutex_lock(&db_search_scratch_mutex);
+    DatabaseSearchScratch *scratch = fsearch_thread_pool_get_local_data(pool, thread_idx, db_search_scratch_quark());
+    if (!scratch) {
+        scratch = db_search_scratch_new();
+        fsearch_thread_pool_set_local_data(pool,
+                                           thread_idx,
+                                           db_search_scratch_quark(),
+                                           scratch,
+                                           (GDestroyNotify)db_search_scratch_free);
+        // pools don't keep data for indexes they don't have threads for
+        scratch->kept_by_pool =
+            fsearch_thread_pool_get_local_data(pool, thread_idx, db_search_scratch_quark()) == scratch;
+    }
+    else if (scratch->in_use) {
+        scratch = db_search_scratch_new();
+    }
+    scratch->in_use = true;
+    g_mutex_unlock(&db_search_scratch_mutex);
+    return scratch;
 }
 
 static void
-db_search_worker(void *data) {
-    DatabaseSearchWorkerContext *ctx = data;
-    g_assert(ctx);
-    g_assert(ctx->results);
+db_search_scratch_release(DatabaseSearchScratch *scratch) {
+    g_mutex_lock(&db_search_scratch_mutex);
+    scratch->in_use = false;
+    const bool kept_by_pool = scratch->kept_by_pool;
+    g_mutex_unlock(&db_search_scratch_mutex);
+    if (!kept_by_pool) {
+        g_clear_pointer(&scratch, db_search_scratch_free);
+    }
+}
 
-    FsearchQueryMatchData *match_data = fsearch_query_match_data_new();
+static void **
+db_search_scratch_take_result_chunk(DatabaseSearchScratch *scratch) {
+    if (scratch->num_free_result_chunks > 0) {
+        return scratch->free_result_chunks[--scratch->num_free_result_chunks];
+    }
+    void **chunk = malloc(SEARCH_CHUNK_NUM_ENTRIES * sizeof(void *));
+    g_assert(chunk);
+    return chunk;
+}
 
-    fsearch_query_match_data_set_thread_id(match_data, ctx->thread_id);
-    FsearchQuery *query = ctx->query;
-    const uint32_t start = ctx->start_pos;
-    const uint32_t end = ctx->end_pos;
-    FsearchDatabaseEntry **results = (FsearchDatabaseEntry **)ctx->results;
-    DynamicArray *entries = ctx->entries;
-
-    if (!entries) {
-        ctx->num_results = 0;
-        g_debug("[db_search] entries empty");
+static void
+db_search_scratch_return_result_chunk(DatabaseSearchScratch *scratch, void **chunk) {
+    if (scratch->num_free_result_chunks >= SEARCH_NUM_KEPT_RESULT_CHUNKS) {
+        free(chunk);
         return;
     }
+    scratch->free_result_chunks[scratch->num_free_result_chunks++] = chunk;
+}
 
-    uint32_t num_results = 0;
-    for (uint32_t i = start; i <= end; i++) {
-        if (G_UNLIKELY(g_cancellable_is_cancelled(ctx->cancellable))) {
+typedef struct DatabaseSearchHeapItem {
+    void *entry;
+    // the position of entry in the searched array, which decides between entries compare_func considers equal
+    uint32_t pos;
+    // the score of the match, only set for heaps ordered by relevance
+    uint32_t score;
+} DatabaseSearchHeapItem;
+
+// The max_items results which come first in the order of compare_func (or with the highest scores if
+// by_relevance is set), the one which comes last is at the top
+typedef struct DatabaseSearchHeap {
+    DatabaseSearchHeapItem *items;
+    uint32_t num_items;
+    uint32_t capacity;
+    uint32_t max_items;
+    DynamicArrayCompareDataFunc compare_func;
+    bool by_relevance;
+} DatabaseSearchHeap;
+
+static int32_t
+db_search_heap_compare(DatabaseSearchHeap *heap, DatabaseSearchHeapItem *a, DatabaseSearchHeapItem *b) {
+    if (heap->by_relevance) {
+        if (a->score != b->score) {
+            return a->score > b->score ? -1 : 1;
+        }
+    }
+    else {
+        const int32_t res = heap->compare_func(&a->entry, &b->entry, NULL);
+        if (res != 0) {
+            return res;
+        }
+    }
+    return a->pos < b->pos ? -1 : (a->pos > b->pos ? 1 : 0);
+}
+
+static void
+db_search_heap_sift_down(DatabaseSearchHeap *heap, uint32_t i, uint32_t num_items) {
+    DatabaseSearchHeapItem *items = heap->items;
+    while (true) {
+        const uint32_t left = 2 * i + 1;
+        if (left >= num_items) {
             break;
         }
-        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
-        fsearch_query_match_data_set_entry(match_data, entry);
-        if (fsearch_query_match(query, match_data)) {
-            results[num_results++] = entry;
+        uint32_t largest = left;
+        if (left + 1 < num_items && db_search_heap_compare(heap, &items[left + 1], &items[left]) > 0) {
+            largest = left + 1;
+        }
+        if (db_search_heap_compare(heap, &items[largest], &items[i]) <= 0) {
+            break;
         }
+        const DatabaseSearchHeapItem tmp = items[i];
+        items[i] = items[largest];
+        items[largest] = tmp;
+        i = largest;
     }
-    g_clear_pointer(&match_data, fsearch_query_match_data_free);
+}
 
-    ctx->num_results = num_results;
+static void
+db_search_heap_push(DatabaseSearchHeap *heap, void *entry, uint32_t pos, uint32_t score) {
+    DatabaseSearchHeapItem item = {.entry = entry, .pos = pos, .score = score};
+    if (heap->num_items == heap->max_items) {
+        // only replaces the result which comes last, if entry comes before it
+        if (db_search_heap_compare(heap, &item, &heap->items[0]) >= 0) {
+            return;
+        }
+        heap->items[0] = item;
+        db_search_heap_sift_down(heap, 0, heap->num_items);
+        return;
+    }
+    if (heap->num_items == heap->capacity) {
+        heap->capacity = MIN(MAX(heap->capacity * 2, 64), heap->max_items);
+        heap->items = realloc(heap->items, heap->capacity * sizeof(DatabaseSearchHeapItem));
+        g_assert(heap->items);
+    }
+    uint32_t i = heap->num_items++;
+    while (i > 0) {
+        const uint32_t parent = (i - 1) / 2;
+        if (db_search_heap_compare(heap, &heap->items[parent], &item) >= 0) {
+            break;
+        }
+        heap->items[i] = heap->items[parent];
+        i = parent;
+    }
+    heap->items[i] = item;
 }
 
+// Returns the entries of the heap in order, the heap is left empty
 static DynamicArray *
-db_search_entries(FsearchQuery *q,
-                  FsearchThreadPool *pool,
-                  GCancellable *cancellable,
-                  DynamicArray *entries,
-                  FsearchThreadPoolFunc search_func) {
+db_search_heap_drain(DatabaseSearchHeap *heap) {
+    for (uint32_t n = heap->num_items; n > 1; n--) {
+        const DatabaseSearchHeapItem tmp = heap->items[0];
+        heap->items[0] = heap->items[n - 1];
+        heap->items[n - 1] = tmp;
+        db_search_heap_sift_down(heap, 0, n - 1);
+    }
+    DynamicArray *entries = darray_new(heap->num_items);
+    for (uint32_t i = 0; i < heap->num_items; i++) {
+        darray_add_item(entries, heap->items[i].entry);
+    }
+    heap->num_items = 0;
+    return entries;
+}
+
+static void
+db_search_heap_clear(DatabaseSearchHeap *heap) {
+    g_clear_pointer(&heap->items, free);
+    heap->num_items = 0;
+    heap->capacity = 0;
+}
+
+static inline bool
+db_search_is_ruled_out(DatabaseSearchPass *pass, FsearchDatabaseEntry *entry) {
+    const uint32_t idx = db_entry_get_idx(entry);
+    if (idx >= pass->num_index_entries || darray_get_item(pass->index_entries, idx) != entry) {
+        // not part of the index, so all we know is that it might match
+        return false;
+    }
+    return !(pass->candidates[idx / 64] & (UINT64_C(1) << (idx % 64)));
+}
+
+static inline bool
+db_search_pass_uses_heap(DatabaseSearchPass *pass) {
+    return pass->compare_func || pass->by_relevance;
+}
+
+static int
+db_search_compare_positions(const void *a, const void *b) {
+    const uint32_t pos_a = *(const uint32_t *)a;
+    const uint32_t pos_b = *(const uint32_t *)b;
+    return pos_a < pos_b ? -1 : pos_a > pos_b;
+}
+
+// Looks up the candidates of entries in the subtree filters. Their positions refer to the path arrays, but they can
+// also be mapped to the name arrays, because the idx of the entries is their position in those.
+static bool
+db_search_lookup_subtrees(FsearchSubtreeFilter *filter,
+                          const char *needle,
+                          DynamicArray *entries,
+                          FsearchDatabaseEntryType type,
+                          uint32_t **positions,
+                          uint32_t *num_positions) {
+    DynamicArray *path_entries = fsearch_subtree_filter_get_entries(filter, type);
     const uint32_t num_entries = darray_get_num_items(entries);
-    if (num_entries == 0) {
-        return NULL;
+    // arrays with other entries (e.g. the results of a previous query) can't use the positions
+    if (darray_get_num_items(path_entries) != num_entries
+        || !fsearch_subtree_filter_lookup(filter, type, needle, strlen(needle), positions, num_positions)) {
+        return false;
     }
-    const uint32_t num_threads = (num_entries < THRESHOLD_FOR_PARALLEL_SEARCH || q->wants_single_threaded_search)
-                                   ? 1
-                                   : fsearch_thread_pool_get_num_threads(pool);
-    const uint32_t num_items_per_thread = num_entries / num_threads;
+    if (entries == path_entries) {
+        return true;
+    }
+    for (uint32_t i = 0; i < *num_positions; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(path_entries, (*positions)[i]);
+        const uint32_t idx = db_entry_get_idx(entry);
+        if (idx >= num_entries || darray_get_item(entries, idx) != entry) {
+            // not the name array
+            g_clear_pointer(positions, free);
+            *num_positions = 0;
+            return false;
+        }
+        (*positions)[i] = idx;
+    }
+    if (*num_positions > 0) {
+        qsort(*positions, *num_positions, sizeof(uint32_t), db_search_compare_positions);
+    }
+    return true;
+}
 
-    DatabaseSearchWorkerContext *thread_data[num_threads];
-    memset(thread_data, 0, sizeof(thread_data));
+static inline const char *
+db_search_get_name(DynamicArray *entries, uint32_t pos) {
+    const char *name = db_entry_get_name_raw(darray_get_item(entries, pos));
+    return name ? name : "";
+}
 
-    uint32_t start_pos = 0;
-    uint32_t end_pos = num_items_per_thread - 1;
+// The names which start with the prefix are next to each other in arrays sorted by name (see
+// FsearchQueryNode::name_prefix) and none of them comes before the prefix itself, so their range is found with two
+// binary searches
+static void
+db_search_find_prefix_range(DynamicArray *entries, const char *prefix, uint32_t *start, uint32_t *end) {
+    const size_t prefix_len = strlen(prefix);
+    const uint32_t num_entries = darray_get_num_items(entries);
+    uint32_t lo = 0;
+    uint32_t hi = num_entries;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (strverscmp(db_search_get_name(entries, mid), prefix) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    *start = lo;
+
+    hi = num_entries;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (strncmp(db_search_get_name(entries, mid), prefix, prefix_len) == 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    *end = lo;
+}
+
+static inline bool
+db_search_can_use_index(DynamicArray *entries, DynamicArray *index_entries, uint32_t num_entries) {
+    return entries == index_entries || num_entries >= THRESHOLD_FOR_CANDIDATE_BITMAP;
+}
+
+static void
+db_search_pass_init(DatabaseSearchPass *pass,
+                    FsearchQuery *q,
+                    DynamicArray *entries,
+                    FsearchDatabaseEntryType type,
+                    FsearchTrigramIndex *index,
+                    FsearchNameIndex *name_index,
+                    FsearchSubtreeFilter *subtree_filter,
+                    const DatabaseSearchLimit *limit,
+                    bool sorted_by_name,
+                    bool track_progress) {
+    uint32_t num_entries = entries ? darray_get_num_items(entries) : 0;
+    if (num_entries == 0 || fsearch_query_never_matches(q, type)) {
+        return;
+    }
+    pass->max_results = UINT32_MAX;
+    if (limit && limit->max_results > 0) {
+        pass->max_results = limit->max_results;
+        pass->compare_func = type == DATABASE_ENTRY_TYPE_FOLDER ? limit->folder_compare_func : limit->file_compare_func;
+    }
+    if (limit && limit->by_relevance) {
+        pass->by_relevance = true;
+        pass->compare_func = NULL;
+    }
+
+    // Every match starts with the name prefix, has the exact name or contains the name literal, so the range of the
+    // prefix or the name or trigram index can narrow down the entries which need to be matched at all. The range
+    // is searched like the whole array and its results are in name order already.
+    DynamicArray *index_entries = NULL;
+    uint32_t num_positions = 0;
+    bool use_index = false;
+    bool use_range = false;
+    if (sorted_by_name && q->name_prefix) {
+        uint32_t end = 0;
+        db_search_find_prefix_range(entries, q->name_prefix, &pass->first_position, &end);
+        if (pass->first_position == end) {
+            pass->result = darray_new(0);
+            return;
+        }
+        num_entries = end - pass->first_position;
+        use_range = true;
+    }
+    else if (name_index && q->exact_name
+        && db_search_can_use_index(entries, fsearch_name_index_get_entries(name_index), num_entries)) {
+        index_entries = fsearch_name_index_get_entries(name_index);
+        fsearch_name_index_lookup(name_index, q->exact_name, strlen(q->exact_name), &pass->positions, &num_positions);
+        use_index = true;
+    }
+    else if (index && q->name_literal
+             && db_search_can_use_index(entries, fsearch_trigram_index_get_entries(index), num_entries)) {
+        index_entries = fsearch_trigram_index_get_entries(index);
+        use_index = fsearch_trigram_index_lookup(index,
+                                                 q->name_literal,
+                                                 strlen(q->name_literal),
+                                                 &pass->positions,
+                                                 &num_positions);
+    }
+    if (use_index) {
+        if (entries == index_entries) {
+            if (num_positions == 0) {
+                g_clear_pointer(&pass->positions, free);
+                pass->result = darray_new(0);
+                return;
+            }
+            num_entries = num_positions;
+        }
+        else {
+            const uint32_t num_index_entries = darray_get_num_items(index_entries);
+            pass->candidates = calloc(num_index_entries / 64 + 1, sizeof(uint64_t));
+            g_assert(pass->candidates);
+            for (uint32_t i = 0; i < num_positions; i++) {
+                pass->candidates[pass->positions[i] / 64] |= UINT64_C(1) << (pass->positions[i] % 64);
+            }
+            g_clear_pointer(&pass->positions, free);
+            pass->index_entries = index_entries;
+            pass->num_index_entries = num_index_entries;
+        }
+    }
+    // Without the trigram index the subtree filters can still rule out the folders whose subtrees contain no name
+    // with the literal
+    else if (!use_range && subtree_filter && q->name_literal
+             && db_search_lookup_subtrees(subtree_filter,
+                                          q->name_literal,
+                                          entries,
+                                          type,
+                                          &pass->positions,
+                                          &num_positions)) {
+        if (num_positions == 0) {
+            pass->result = darray_new(0);
+            return;
+        }
+        num_entries = num_positions;
+    }
 
     if (!q->query_tree) {
         g_assert_not_reached();
     }
 
-    GList *threads = fsearch_thread_pool_get_threads(pool);
-    for (uint32_t i = 0; i < num_threads; i++) {
+    pass->entries = entries;
+    pass->program = q->programs[type];
+    pass->num_entries = num_entries;
+    pass->num_chunks = (num_entries + SEARCH_CHUNK_NUM_ENTRIES - 1) / SEARCH_CHUNK_NUM_ENTRIES;
 
-        thread_data[i] = db_search_worker_context_new(q,
-                                                      cancellable,
-                                                      entries,
-                                                      (int32_t)i,
-                                                      start_pos,
-                                                      i == num_threads - 1 ? num_entries - 1 : end_pos);
+    // Numeric filters on large arrays scan contiguous copies of the entry attributes
+    // instead of dereferencing every single entry
+    if (q->wants_entry_columns && num_entries >= THRESHOLD_FOR_PARALLEL_SEARCH) {
+        pass->columns = db_entry_columns_get(entries);
+    }
 
-        start_pos = end_pos + 1;
-        end_pos += num_items_per_thread;
+    pass->chunk_results = calloc(pass->num_chunks, sizeof(void **));
+    g_assert(pass->chunk_results);
+    pass->num_chunk_results = calloc(pass->num_chunks + 1, sizeof(uint32_t));
+    g_assert(pass->num_chunk_results);
+    if (track_progress || (pass->max_results != UINT32_MAX && !db_search_pass_uses_heap(pass))) {
+        pass->chunk_done = calloc(pass->num_chunks, sizeof(bool));
+        g_assert(pass->chunk_done);
+    }
+}
 
-        fsearch_thread_pool_push_data(pool, threads, search_func, thread_data[i]);
-        threads = threads->next;
+// The result buffers of the chunks are handed back to the scratches they're reused from
+static void
+db_search_pass_clear(DatabaseSearchPass *pass, DatabaseSearchScratch **scratches, uint32_t num_scratches) {
+    g_clear_pointer(&pass->positions, free);
+    g_clear_pointer(&pass->candidates, free);
+    if (pass->chunk_results) {
+        for (uint32_t i = 0; i < pass->num_chunks; i++) {
+            if (pass->chunk_results[i]) {
+                db_search_scratch_return_result_chunk(scratches[i % num_scratches], pass->chunk_results[i]);
+            }
+        }
+        g_clear_pointer(&pass->chunk_results, free);
     }
+    g_clear_pointer(&pass->num_chunk_results, free);
+    g_clear_pointer(&pass->chunk_done, free);
+    g_clear_pointer(&pass->result, darray_unref);
+}
 
-    threads = fsearch_thread_pool_get_threads(pool);
-    while (threads) {
-        fsearch_thread_pool_wait_for_thread(pool, threads);
-        threads = threads->next;
+// Returns the concatenated results of chunks [0, num_chunks), or NULL if the pass had nothing to search
+static DynamicArray *
+db_search_pass_get_results(DatabaseSearchPass *pass, uint32_t num_chunks) {
+    if (pass->result) {
+        return darray_ref(pass->result);
     }
-    if (g_cancellable_is_cancelled(cancellable)) {
-        for (uint32_t i = 0; i < num_threads; i++) {
-            g_clear_pointer(&thread_data[i], db_search_worker_context_free);
-        }
+    if (!pass->chunk_results) {
         return NULL;
     }
 
-    // get total number of entries found
     uint32_t num_results = 0;
-    for (uint32_t i = 0; i < num_threads; ++i) {
-        num_results += thread_data[i]->num_results;
+    for (uint32_t i = 0; i < num_chunks; ++i) {
+        num_results += pass->num_chunk_results[i];
     }
+    num_results = MIN(num_results, pass->max_results);
 
     DynamicArray *results = darray_new(num_results);
+    for (uint32_t i = 0; i < num_chunks && darray_get_num_items(results) < num_results; i++) {
+        const uint32_t num_chunk_results =
+            MIN(pass->num_chunk_results[i], num_results - darray_get_num_items(results));
+        if (num_chunk_results > 0) {
+            darray_add_items(results, pass->chunk_results[i], num_chunk_results);
+        }
+    }
+    return results;
+}
 
-    for (uint32_t i = 0; i < num_threads; i++) {
-        DatabaseSearchWorkerContext *ctx = thread_data[i];
-        if (!ctx) {
-            break;
+// Must be called with the progress mutex locked
+static void
+db_search_pass_set_chunk_done(DatabaseSearchPass *pass, uint32_t chunk) {
+    pass->chunk_done[chunk] = true;
+    while (pass->num_done_chunks < pass->num_chunks && pass->chunk_done[pass->num_done_chunks]) {
+        pass->num_done_results += pass->num_chunk_results[pass->num_done_chunks];
+        pass->num_done_chunks++;
+    }
+    if (pass->num_done_results >= pass->max_results) {
+        g_atomic_int_set(&pass->limit_reached, 1);
+    }
+}
+
+static void
+db_search_publish_progress(DatabaseSearchContext *search_ctx, DatabaseSearchPass *pass, uint32_t chunk) {
+    uint32_t num_done_chunks[NUM_DATABASE_SEARCH_PASSES] = {0};
+    bool all_done = true;
+
+    g_mutex_lock(&search_ctx->progress_mutex);
+    db_search_pass_set_chunk_done(pass, chunk);
+    for (uint32_t i = 0; i < NUM_DATABASE_SEARCH_PASSES; i++) {
+        num_done_chunks[i] = search_ctx->passes[i].num_done_chunks;
+        if (num_done_chunks[i] < search_ctx->passes[i].num_chunks) {
+            all_done = false;
         }
+    }
+    const int64_t now = g_get_monotonic_time();
+    // once all chunks are done the final results follow right away
+    const bool publish = !search_ctx->publishing && !all_done && now >= search_ctx->next_publish_time;
+    if (publish) {
+        search_ctx->publishing = true;
+        search_ctx->next_publish_time = now + SEARCH_PROGRESS_INTERVAL_US;
+    }
+    g_mutex_unlock(&search_ctx->progress_mutex);
 
-        darray_add_items(results, (void **)ctx->results, ctx->num_results);
+    if (!publish) {
+        return;
+    }
 
-        g_clear_pointer(&ctx, db_search_worker_context_free);
+    // the results of done chunks don't change anymore, so they can be collected without holding the lock
+    DynamicArray *results[NUM_DATABASE_SEARCH_PASSES] = {NULL};
+    for (uint32_t i = 0; i < NUM_DATABASE_SEARCH_PASSES; i++) {
+        results[i] = db_search_pass_get_results(&search_ctx->passes[i], num_done_chunks[i]);
+    }
+    search_ctx->progress_func(results[DATABASE_SEARCH_PASS_FOLDERS],
+                              results[DATABASE_SEARCH_PASS_FILES],
+                              search_ctx->progress_data);
+    for (uint32_t i = 0; i < NUM_DATABASE_SEARCH_PASSES; i++) {
+        g_clear_pointer(&results[i], darray_unref);
     }
 
-    return results;
+    g_mutex_lock(&search_ctx->progress_mutex);
+    search_ctx->publishing = false;
+    g_mutex_unlock(&search_ctx->progress_mutex);
+}
+
+static void
+db_search_chunk(FsearchQuery *query,
+                DatabaseSearchPass *pass,
+                uint32_t chunk,
+                DatabaseSearchScratch *scratch,
+                DatabaseSearchHeap *heap,
+                uint64_t *column_matches) {
+    DynamicArray *entries = pass->entries;
+    const FsearchDatabaseEntryColumns *columns = pass->columns;
+    FsearchQueryMatchData *match_data = scratch->match_data;
+    const uint32_t start = chunk * SEARCH_CHUNK_NUM_ENTRIES;
+    const uint32_t end = MIN(start + SEARCH_CHUNK_NUM_ENTRIES, pass->num_entries);
+    void **results = NULL;
+    if (!columns) {
+        // the columns of the other pass don't belong to these entries
+        fsearch_query_match_data_set_columns(match_data, NULL, 0);
+    }
+
+    // the numeric filters every match must pass are checked for the whole chunk at once
+    const bool filtered = columns && !pass->positions
+                       && fsearch_query_program_filter_columns(pass->program,
+                                                               columns,
+                                                               pass->first_position + start,
+                                                               end - start,
+                                                               column_matches);
+
+    uint32_t num_results = 0;
+    for (uint32_t i = start; i < end; i++) {
+        if (filtered) {
+            const uint32_t offset = i - start;
+            const uint64_t word = column_matches[offset / 64] >> (offset % 64);
+            if (!word) {
+                // skip the rest of the word
+                i += 63 - offset % 64;
+                continue;
+            }
+            i += __builtin_ctzll(word);
+        }
+        const uint32_t pos = pass->positions ? pass->positions[i] : pass->first_position + i;
+        FsearchDatabaseEntry *entry = darray_get_item(entries, pos);
+        if (pass->candidates && entry && db_search_is_ruled_out(pass, entry)) {
+            continue;
+        }
+        fsearch_query_match_data_set_entry(match_data, entry);
+        if (columns) {
+            fsearch_query_match_data_set_columns(match_data, columns, pos);
+        }
+        if (!fsearch_query_match(query, match_data)) {
+            continue;
+        }
+        if (heap) {
+            const uint32_t score = heap->by_relevance ? fsearch_query_match_data_get_score(match_data) : 0;
+            db_search_heap_push(heap, entry, pos, score);
+        }
+        else {
+            if (!results) {
+                results = db_search_scratch_take_result_chunk(scratch);
+                pass->chunk_results[chunk] = results;
+            }
+            results[num_results++] = entry;
+            if (num_results >= pass->max_results) {
+                // the results of the following entries would be cut off anyway
+                break;
+            }
+        }
+    }
+    pass->num_chunk_results[chunk] = num_results;
+}
+
+typedef struct DatabaseSearchWorkerContext {
+    DatabaseSearchContext *search_ctx;
+    DatabaseSearchScratch *scratch;
+    // only used by the passes which keep the results that come first in the order of a compare function
+    DatabaseSearchHeap heaps[NUM_DATABASE_SEARCH_PASSES];
+    int32_t thread_id;
+} DatabaseSearchWorkerContext;
+
+static void
+db_search_worker(void *data) {
+    DatabaseSearchWorkerContext *ctx = data;
+    g_assert(ctx);
+    DatabaseSearchContext *search_ctx = ctx->search_ctx;
+
+    // the match data is kept with the thread, but whatever it knows about the previous query and its entries
+    // (which might have been freed since then) mustn't be used anymore
+    FsearchQueryMatchData *match_data = ctx->scratch->match_data;
+    fsearch_query_match_data_reset(match_data);
+
+    fsearch_query_match_data_set_thread_id(match_data, ctx->thread_id);
+    fsearch_query_match_data_set_folder_paths(match_data, search_ctx->folder_paths);
+    fsearch_query_match_data_set_folded_names(match_data, search_ctx->folded_names);
+    fsearch_query_match_data_set_cancellable(match_data, search_ctx->cancellable);
+    uint64_t column_matches[SEARCH_CHUNK_NUM_ENTRIES / 64];
+
+    uint32_t chunk = 0;
+    while (fsearch_thread_pool_ranges_next(search_ctx->chunks, &chunk)) {
+        if (G_UNLIKELY(g_cancellable_is_cancelled(search_ctx->cancellable))) {
+            break;
+        }
+        // find the pass the chunk belongs to
+        uint32_t pass_chunk = chunk;
+        DatabaseSearchPass *pass = search_ctx->passes;
+        while (pass_chunk >= pass->num_chunks) {
+            pass_chunk -= pass->num_chunks;
+            pass++;
+        }
+        if (g_atomic_int_get(&pass->limit_reached)) {
+            continue;
+        }
+        DatabaseSearchHeap *heap = db_search_pass_uses_heap(pass) ? &ctx->heaps[pass - search_ctx->passes] : NULL;
+        const int64_t span = fsearch_trace_begin();
+        db_search_chunk(search_ctx->query, pass, pass_chunk, ctx->scratch, heap, column_matches);
+        fsearch_trace_end(span, "search", "search chunk");
+        if (search_ctx->progress_func) {
+            db_search_publish_progress(search_ctx, pass, pass_chunk);
+        }
+        else if (pass->chunk_done) {
+            g_mutex_lock(&search_ctx->progress_mutex);
+            db_search_pass_set_chunk_done(pass, pass_chunk);
+            g_mutex_unlock(&search_ctx->progress_mutex);
+        }
+    }
 }
 
 DatabaseSearchResult *
@@ -203,35 +767,140 @@ db_search(FsearchQuery *q,
           FsearchThreadPool *pool,
           DynamicArray *folders,
           DynamicArray *files,
+          FsearchTrigramIndex *folder_index,
+          FsearchTrigramIndex *file_index,
+          FsearchNameIndex *folder_name_index,
+          FsearchNameIndex *file_name_index,
+          FsearchSubtreeFilter *subtree_filter,
+          FsearchFolderPaths *folder_paths,
+          FsearchFoldedNames *folded_names,
+          const DatabaseSearchLimit *limit,
           FsearchDatabaseIndexType sort_type,
+          DatabaseSearchProgressFunc progress_func,
+          void *progress_data,
           GCancellable *cancellable) {
     g_assert(files);
     g_assert(folders);
 
-    DynamicArray *files_res = NULL;
-    DynamicArray *folders_res = NULL;
+    if (limit && (limit->max_results > 0 || limit->by_relevance)) {
+        // the partial results wouldn't be a prefix of the final ones
+        progress_func = NULL;
+    }
+    else {
+        limit = NULL;
+    }
 
-    const uint32_t num_folders = folders ? darray_get_num_items(folders) : 0;
-    folders_res = num_folders > 0 ? db_search_entries(q, pool, cancellable, folders, db_search_worker) : NULL;
-    if (g_cancellable_is_cancelled(cancellable)) {
-        goto search_was_cancelled;
+    DatabaseSearchContext search_ctx = {
+        .query = q,
+        .cancellable = cancellable,
+        .folder_paths = folder_paths,
+        .folded_names = folded_names,
+        .progress_func = progress_func,
+        .progress_data = progress_data,
+        .next_publish_time = g_get_monotonic_time() + SEARCH_PROGRESS_FIRST_DELAY_US,
+    };
+    // the results keep the order of the arrays, unless the first ones in another order are kept
+    const bool sorted_by_name = sort_type == DATABASE_INDEX_TYPE_NAME;
+    DatabaseSearchPass *passes = search_ctx.passes;
+    db_search_pass_init(&passes[DATABASE_SEARCH_PASS_FOLDERS],
+                        q,
+                        folders,
+                        DATABASE_ENTRY_TYPE_FOLDER,
+                        folder_index,
+                        folder_name_index,
+                        subtree_filter,
+                        limit,
+                        sorted_by_name,
+                        progress_func != NULL);
+    db_search_pass_init(&passes[DATABASE_SEARCH_PASS_FILES],
+                        q,
+                        files,
+                        DATABASE_ENTRY_TYPE_FILE,
+                        file_index,
+                        file_name_index,
+                        subtree_filter,
+                        limit,
+                        sorted_by_name,
+                        progress_func != NULL);
+
+    uint32_t num_entries = 0;
+    uint32_t num_pass_chunks[NUM_DATABASE_SEARCH_PASSES];
+    for (uint32_t i = 0; i < NUM_DATABASE_SEARCH_PASSES; i++) {
+        num_entries += passes[i].num_entries;
+        search_ctx.num_chunks += passes[i].num_chunks;
+        num_pass_chunks[i] = passes[i].num_chunks;
     }
-    const uint32_t num_files = files ? darray_get_num_items(files) : 0;
-    files_res = num_files > 0 ? db_search_entries(q, pool, cancellable, files, db_search_worker) : NULL;
-    if (g_cancellable_is_cancelled(cancellable)) {
-        goto search_was_cancelled;
+
+    const uint32_t num_threads = (num_entries < THRESHOLD_FOR_PARALLEL_SEARCH || q->wants_single_threaded_search)
+                                   ? 1
+                                   : MAX(MIN(fsearch_thread_pool_get_num_threads(pool), search_ctx.num_chunks), 1);
+    DatabaseSearchScratch *scratches[num_threads];
+    for (uint32_t i = 0; i < num_threads; i++) {
+        scratches[i] = db_search_scratch_acquire(pool, i);
     }
 
-    DatabaseSearchResult *result = calloc(1, sizeof(DatabaseSearchResult));
-    result->files = files_res;
-    result->folders = folders_res;
-    result->sort_type = sort_type;
+    if (search_ctx.num_chunks > 0) {
+        g_mutex_init(&search_ctx.progress_mutex);
 
-    return result;
+        DatabaseSearchWorkerContext thread_data[num_threads];
+        for (uint32_t i = 0; i < num_threads; i++) {
+            thread_data[i].search_ctx = &search_ctx;
+            thread_data[i].scratch = scratches[i];
+            thread_data[i].thread_id = (int32_t)i;
+            for (uint32_t j = 0; j < NUM_DATABASE_SEARCH_PASSES; j++) {
+                thread_data[i].heaps[j] = (DatabaseSearchHeap){
+                    .max_items = passes[j].max_results,
+                    .compare_func = passes[j].compare_func,
+                    .by_relevance = passes[j].by_relevance,
+                };
+            }
+        }
+        search_ctx.chunks = fsearch_thread_pool_ranges_new(pool, num_pass_chunks, NUM_DATABASE_SEARCH_PASSES);
+        fsearch_thread_pool_run(pool, db_search_worker, thread_data, sizeof(DatabaseSearchWorkerContext), num_threads);
+        g_clear_pointer(&search_ctx.chunks, fsearch_thread_pool_ranges_free);
+
+        // the results which come first overall are among the ones which come first for every thread
+        for (uint32_t i = 0; i < NUM_DATABASE_SEARCH_PASSES; i++) {
+            if (!db_search_pass_uses_heap(&passes[i])) {
+                continue;
+            }
+            DatabaseSearchHeap heap = {
+                .max_items = passes[i].max_results,
+                .compare_func = passes[i].compare_func,
+                .by_relevance = passes[i].by_relevance,
+            };
+            for (uint32_t j = 0; j < num_threads; j++) {
+                DatabaseSearchHeap *thread_heap = &thread_data[j].heaps[i];
+                for (uint32_t k = 0; k < thread_heap->num_items; k++) {
+                    const DatabaseSearchHeapItem *item = &thread_heap->items[k];
+                    db_search_heap_push(&heap, item->entry, item->pos, item->score);
+                }
+                db_search_heap_clear(thread_heap);
+            }
+            g_clear_pointer(&passes[i].result, darray_unref);
+            passes[i].result = db_search_heap_drain(&heap);
+            db_search_heap_clear(&heap);
+        }
+
+        g_mutex_clear(&search_ctx.progress_mutex);
+    }
 
-search_was_cancelled:
-    g_clear_pointer(&folders_res, darray_unref);
-    g_clear_pointer(&files_res, darray_unref);
+    DatabaseSearchResult *result = NULL;
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        result = calloc(1, sizeof(DatabaseSearchResult));
+        result->folders = db_search_pass_get_results(&passes[DATABASE_SEARCH_PASS_FOLDERS],
+                                                     passes[DATABASE_SEARCH_PASS_FOLDERS].num_chunks);
+        result->files = db_search_pass_get_results(&passes[DATABASE_SEARCH_PASS_FILES],
+                                                   passes[DATABASE_SEARCH_PASS_FILES].num_chunks);
+        result->sort_type = sort_type;
+    }
 
-    return NULL;
-}
\ No newline at end of file
+    for (uint32_t i = 0; i < NUM_DATABASE_SEARCH_PASSES; i++) {
+        db_search_pass_clear(&passes[i], scratches, num_threads);
+    }
+    for (uint32_t i = 0; i < num_threads; i++) {
+        db_search_scratch_release(scratches[i]);
+    }
+
+    return result;
+}
@@ -21,7 +21,12 @@
 #include "fsearch_array.h"
 #include "fsearch_database_entry.h"
 #include "fsearch_filter.h"
+#include "fsearch_folded_names.h"
+#include "fsearch_folder_paths.h"
+#include "fsearch_name_index.h"
 #include "fsearch_query.h"
+#include "fsearch_subtree_filter.h"
+#include "fsearch_trigram_index.h"
 
 #include <gio/gio.h>
 
@@ -31,13 +36,48 @@ typedef struct DatabaseSearchResult {
     FsearchDatabaseIndexType sort_type;
 } DatabaseSearchResult;
 
+// Keeps at most max_results folders and files. Without a compare function for the type of entries those are the
+// first matches in the order of the searched array, so the search of that array stops as soon as they're found.
+// Otherwise they're the first matches in the order of the compare function, which every thread collects in a heap.
+// The result isn't sorted any further than that, so compare functions should only be passed if the arrays
+// aren't sorted in the wanted order already.
+// With by_relevance the results with the highest scores (see fsearch_query_match_data_get_score) are kept
+// instead and sorted by them, matches with the same score stay in the order of the searched array. That also
+// works without max_results, all results get sorted then.
+typedef struct DatabaseSearchLimit {
+    uint32_t max_results;
+    DynamicArrayCompareDataFunc folder_compare_func;
+    DynamicArrayCompareDataFunc file_compare_func;
+    bool by_relevance;
+} DatabaseSearchLimit;
+
+// Called from the search threads with the results found so far, which are a prefix of the final results
+// in the same order. The arrays are only borrowed, the callback must take a reference to keep them.
+typedef void (*DatabaseSearchProgressFunc)(DynamicArray *folders, DynamicArray *files, void *user_data);
+
 DatabaseSearchResult *
 db_search_empty(DynamicArray *folders, DynamicArray *files, FsearchDatabaseIndexType sort_type);
 
+// The name indexes (may be NULL) narrow down the entries of queries for exact names, the trigram indexes the ones of
+// all other queries with a name literal. subtree_filter (may be NULL) narrows down the entries like the trigram
+// indexes, if those weren't built for them.
+// folder_paths (may be NULL) are used to build the paths of the entries, if the query needs them,
+// folded_names (may be NULL) to look up the folded forms of their names. If limit is set (and max_results isn't 0
+// or it's by relevance) only the results it selects are returned and progress_func isn't called.
 DatabaseSearchResult *
 db_search(FsearchQuery *q,
           FsearchThreadPool *pool,
           DynamicArray *folders,
           DynamicArray *files,
+          FsearchTrigramIndex *folder_index,
+          FsearchTrigramIndex *file_index,
+          FsearchNameIndex *folder_name_index,
+          FsearchNameIndex *file_name_index,
+          FsearchSubtreeFilter *subtree_filter,
+          FsearchFolderPaths *folder_paths,
+          FsearchFoldedNames *folded_names,
+          const DatabaseSearchLimit *limit,
           FsearchDatabaseIndexType sort_type,
+          DatabaseSearchProgressFunc progress_func,
+          void *progress_data,
           GCancellable *cancellable);
@@ -1,14 +1,29 @@
 #define G_LOG_DOMAIN "fsearch-database-view"
 
 #include "fsearch_database_view.h"
+#include "fsearch_array_merge.h"
+#include "fsearch_bitset.h"
 #include "fsearch_database.h"
+#include "fsearch_database_entry_columns.h"
 #include "fsearch_database_search.h"
+#include "fsearch_query_log.h"
+#include "fsearch_result_cache.h"
 #include "fsearch_selection.h"
 #include "fsearch_task.h"
 #include "fsearch_task_ids.h"
+#include "fsearch_trace.h"
 
+#include <inttypes.h>
 #include <string.h>
 
+// the result cache is disabled until a size is set for it
+#define DEFAULT_RESULT_CACHE_SIZE 0
+// sorts of fewer results with a compare function are fast enough to not need a preview of the visible rows
+#define SORT_PREVIEW_MIN_ENTRIES 100000
+// Results which are fewer than 1/8 of the entries are sorted by their ranks in the sorted index instead of walking
+// the whole index: the radix sort needs a few passes over the results, the walk a lookup for every entry
+#define SORT_BY_RANK_MAX_SHARE 8
+
 // A DatabaseView provides a unique view into a registered database
 // It provides:
 // * filtering
@@ -26,7 +41,15 @@ struct FsearchDatabaseView {
 
     DynamicArray *files;
     DynamicArray *folders;
-    GHashTable *selection;
+    // if set, folders and files are shown mixed in sort_order instead of the folders first. Their merge is only
+    // computed when the rows are read after the results or their order changed, see db_view_get_merge.
+    bool mix_entries;
+    FsearchArrayMerge *merge;
+    FsearchDatabaseIndexType merge_sort_order;
+    FsearchSelection *selection;
+    // the paths of the folders of the database the results were found in, used to build the paths of the
+    // results without the database lock, NULL if the database doesn't keep them
+    FsearchFolderPaths *folder_paths;
 
     FsearchDatabaseIndexType sort_order;
     GtkSortType sort_type;
@@ -36,6 +59,29 @@ struct FsearchDatabaseView {
     FsearchFilterManager *filters;
     FsearchQueryFlags query_flags;
     uint32_t query_id;
+    // incremented whenever the results of the current query might be outdated, e.g. because the database content
+    // changed, then they can't be used to refine the search for the next query
+    uint32_t search_generation;
+    uint32_t results_generation;
+    // set while files and folders hold what a running search found so far, they can't be refined then
+    bool results_are_partial;
+    // set while only the visible entries are in sort_order, see publish_sort_preview. They can't be refined or
+    // used for sorting by the same order again then.
+    bool results_sorted_partially;
+    // see db_view_set_visible_rows
+    uint32_t visible_idx;
+    uint32_t num_visible;
+    // results of recent queries of the current generation, so going back to one of them doesn't need a search
+    FsearchResultCache *result_cache;
+    // the shared result files and folders belong to, NULL if they weren't shared, see db_get_shared_results
+    FsearchSharedResult *shared_result;
+    // the rows files and folders were taken from until a database gets registered, see db_view_set_warm_start
+    FsearchWarmStart *warm_start;
+    // how long recent searches took, see db_view_get_search_delay
+    FsearchSearchLatency search_latency;
+    // how the latest search and sort which finished went, see db_view_get_operation_stats
+    FsearchOperationStats search_stats;
+    FsearchOperationStats sort_stats;
 
     FsearchTaskQueue *task_queue;
 
@@ -52,7 +98,24 @@ typedef struct {
     FsearchDatabase *db;
     FsearchQuery *query;
     FsearchDatabaseIndexType sort_order;
+    uint32_t generation;
+    char *cache_key;
     bool reset_selection;
+    // the cancellable of the running search and the order the searched arrays are sorted in, for publishing
+    // partial results
+    GCancellable *cancellable;
+    FsearchDatabaseIndexType results_sort_order;
+    bool published_partial_results;
+    // false if the results were taken from the cache, the folder paths of the view stay valid for them then
+    bool searched_database;
+    FsearchFolderPaths *folder_paths;
+    FsearchSharedResult *shared_result;
+    FsearchOperationTimer timer;
+    // the folders and files which were searched
+    uint64_t num_searched;
+    // when the search was requested, only set if searches get logged
+    int64_t request_time;
+    double log_time;
 } FsearchSearchContext;
 
 static void
@@ -63,6 +126,53 @@ db_view_sort(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order, Gtk
 
 // Implementation
 
+static void
+db_view_set_folder_paths(FsearchDatabaseView *view, FsearchFolderPaths *folder_paths) {
+    g_clear_pointer(&view->folder_paths, fsearch_folder_paths_unref);
+    view->folder_paths = folder_paths ? fsearch_folder_paths_ref(folder_paths) : NULL;
+}
+
+static void
+db_view_invalidate_results(FsearchDatabaseView *view) {
+    view->search_generation++;
+    fsearch_result_cache_clear(view->result_cache);
+}
+
+static void
+db_view_set_shared_result(FsearchDatabaseView *view, FsearchSharedResult *shared_result) {
+    g_clear_pointer(&view->shared_result, fsearch_shared_result_unref);
+    view->shared_result = shared_result;
+}
+
+static void
+db_view_clear_warm_start(FsearchDatabaseView *view) {
+    if (!view->warm_start) {
+        return;
+    }
+    // the search or order changed, the rows of the last launch don't match it anymore
+    if (view->selection) {
+        fsearch_selection_unselect_all(view->selection);
+    }
+    g_clear_pointer(&view->files, darray_unref);
+    g_clear_pointer(&view->folders, darray_unref);
+    g_clear_pointer(&view->warm_start, fsearch_warm_start_unref);
+    if (view->notify_func) {
+        view->notify_func(view, DATABASE_VIEW_NOTIFY_CONTENT_CHANGED, view->notify_func_data);
+    }
+}
+
+static char *
+get_result_cache_key(FsearchQuery *query, FsearchDatabaseIndexType sort_order) {
+    const char *filter_query = query->filter && query->filter->query ? query->filter->query : "";
+    return g_strdup_printf("%d:%u:%u:%zu:%s%s",
+                           sort_order,
+                           query->flags,
+                           query->filter ? query->filter->flags : 0,
+                           strlen(filter_query),
+                           filter_query,
+                           query->search_term);
+}
+
 void
 db_view_free(FsearchDatabaseView *view) {
     if (!view) {
@@ -77,6 +187,10 @@ db_view_free(FsearchDatabaseView *view) {
     g_clear_pointer(&view->task_queue, fsearch_task_queue_free);
     g_clear_pointer(&view->query, fsearch_query_unref);
     g_clear_pointer(&view->selection, fsearch_selection_free);
+    g_clear_pointer(&view->result_cache, fsearch_result_cache_free);
+    g_clear_pointer(&view->folder_paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&view->shared_result, fsearch_shared_result_unref);
+    g_clear_pointer(&view->merge, fsearch_array_merge_free);
 
     db_view_unlock(view);
 
@@ -116,6 +230,10 @@ db_view_unregister_database(FsearchDatabaseView *view) {
     }
     g_clear_pointer(&view->files, darray_unref);
     g_clear_pointer(&view->folders, darray_unref);
+    g_clear_pointer(&view->merge, fsearch_array_merge_free);
+    g_clear_pointer(&view->folder_paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&view->shared_result, fsearch_shared_result_unref);
+    g_clear_pointer(&view->warm_start, fsearch_warm_start_unref);
     if (view->db) {
         db_unregister_view(view->db, view);
         g_clear_pointer(&view->db, db_unref);
@@ -125,66 +243,25 @@ db_view_unregister_database(FsearchDatabaseView *view) {
     db_view_unlock(view);
 }
 
-static int32_t
-cmp_entries_by_name_and_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, void *data) {
-    const int res = db_entry_compare_entries_by_name(a, b);
-    if (res == 0) {
-        return db_entry_compare_entries_by_path(a, b);
+static FsearchSelection *
+migrate_selection(FsearchDatabase *db_old, FsearchDatabase *db_new, FsearchSelection *old_selection) {
+    if (db_old) {
+        db_lock(db_old);
     }
-    return res;
-}
-
-static void
-copy_selection(DynamicArray *old_entries, DynamicArray *new_entries, GHashTable *old_selection, GHashTable *new_selection) {
-    if (!fsearch_selection_get_num_selected(old_selection) || darray_get_num_items(old_entries) == 0
-        || darray_get_num_items(new_entries) == 0) {
-        goto out;
-    }
-
-    uint32_t num_selected = 0;
-    const uint32_t num_new_entries = darray_get_num_items(new_entries);
-
-    for (uint32_t i = 0; i < darray_get_num_items(old_entries); ++i) {
-        FsearchDatabaseEntry *entry = darray_get_item(old_entries, i);
-        if (fsearch_selection_is_selected(old_selection, entry)) {
-            uint32_t found_idx = 0;
-            // We have to perform a binary search to find the matching item in the new database.
-            // That's not a huge issue for small selections, but when millions of items have been selected
-            // in the old database, it can take quite a few seconds.
-            // We should consider running this in a non-blocking way for the main thread.
-            if (darray_binary_search_with_data(new_entries,
-                                               entry,
-                                               (DynamicArrayCompareDataFunc)cmp_entries_by_name_and_path,
-                                               NULL,
-                                               &found_idx)) {
-                FsearchDatabaseEntry *entry_to_be_selected = darray_get_item(new_entries, found_idx);
-                fsearch_selection_select(new_selection, entry_to_be_selected);
-                num_selected++;
-
-                if (num_selected >= num_new_entries) {
-                    // This should almost never happen, but we've selected every element in new_entries,
-                    // so we're done here. Even when there are still more selected items in old_entries.
-                    break;
-                }
-            }
-        }
-    }
-out:
-    g_clear_pointer(&old_entries, darray_unref);
-    g_clear_pointer(&new_entries, darray_unref);
-}
-
-static GHashTable *
-migrate_selection(FsearchDatabase *db_old, FsearchDatabase *db_new, GHashTable *old_selection) {
-    db_lock(db_old);
     db_lock(db_new);
 
-    GHashTable *new_selection = fsearch_selection_new();
-    copy_selection(db_get_files(db_old), db_get_files(db_new), old_selection, new_selection);
-    copy_selection(db_get_folders(db_old), db_get_folders(db_new), old_selection, new_selection);
+    // the selected entries get looked up in the new database by their path
+    DynamicArray *folders = db_get_folders(db_new);
+    DynamicArray *files = db_get_files(db_new);
+    FsearchSelection *new_selection =
+        fsearch_selection_new_rebased(old_selection, folders, files, db_get_thread_pool(db_new));
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
 
-    db_unlock(db_old);
     db_unlock(db_new);
+    if (db_old) {
+        db_unlock(db_old);
+    }
 
     return new_selection;
 }
@@ -204,15 +281,15 @@ db_view_register_database(FsearchDatabaseView *view, FsearchDatabase *db) {
 
     g_autoptr(GTimer) timer = g_timer_new();
     g_timer_start(timer);
-    GHashTable *new_selection = NULL;
-    if (view->db) {
-        db_view_lock(view);
-        new_selection = migrate_selection(view->db, db, view->selection);
-        db_view_unlock(view);
-        g_debug("[db_view_register_database] old_selection_count: %d",
-                fsearch_selection_get_num_selected(view->selection));
-        g_debug("[db_view_register_database] new_selection_count: %d", fsearch_selection_get_num_selected(new_selection));
+    db_view_lock(view);
+    if (view->warm_start && view->selection) {
+        // the rows of the last launch aren't entries of any database, they can't be looked up in the new one
+        fsearch_selection_unselect_all(view->selection);
     }
+    FsearchSelection *new_selection = migrate_selection(view->db, db, view->selection);
+    db_view_unlock(view);
+    g_debug("[db_view_register_database] old_selection_count: %d", fsearch_selection_get_num_selected(view->selection));
+    g_debug("[db_view_register_database] new_selection_count: %d", fsearch_selection_get_num_selected(new_selection));
     const double seconds = g_timer_elapsed(timer, NULL);
     g_timer_reset(timer);
     g_debug("[db_view_register_database] migrated selection in %f seconds", seconds);
@@ -222,14 +299,13 @@ db_view_register_database(FsearchDatabaseView *view, FsearchDatabase *db) {
     db_view_lock(view);
 
     view->db = db_ref(db);
-    if (new_selection) {
-        g_clear_pointer(&view->selection, fsearch_selection_free);
-        view->selection = new_selection;
-    }
+    g_clear_pointer(&view->selection, fsearch_selection_free);
+    view->selection = new_selection;
     view->pool = db_get_thread_pool(db);
     view->files = db_get_files(db);
     view->folders = db_get_folders(db);
 
+    db_view_invalidate_results(view);
     db_view_search(view, false);
     db_view_sort(view, view->sort_order, view->sort_type);
 
@@ -258,6 +334,7 @@ db_view_new(const char *query_text,
     view->filters = fsearch_filter_manager_copy(filters);
     view->sort_order = sort_order;
     view->sort_type = sort_type;
+    view->result_cache = fsearch_result_cache_new(DEFAULT_RESULT_CACHE_SIZE);
 
     view->notify_func = notify_func;
     view->notify_func_data = notify_func_data;
@@ -279,12 +356,38 @@ search_context_free(FsearchSearchContext *ctx) {
     g_clear_pointer(&ctx->db, db_unref);
     g_clear_pointer(&ctx->view, db_view_unref);
     g_clear_pointer(&ctx->query, fsearch_query_unref);
+    g_clear_pointer(&ctx->cache_key, g_free);
+    g_clear_pointer(&ctx->folder_paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&ctx->shared_result, fsearch_shared_result_unref);
     g_clear_pointer(&ctx, free);
 }
 
+static void
+db_view_search_log(FsearchSearchContext *ctx, FsearchQueryLogStatus status, uint32_t num_results) {
+    if (ctx->request_time == 0) {
+        return;
+    }
+    const int64_t now = g_get_monotonic_time();
+    // the timer only gets started once the search runs
+    const int64_t start_time = ctx->timer.start_time ? ctx->timer.start_time : now;
+    FsearchQuery *query = ctx->query;
+    FsearchQueryLogRecord record = {
+        .time_ms = ctx->log_time,
+        .flags = query->flags,
+        .filter = query->filter ? query->filter->name : NULL,
+        .query = query->search_term,
+        .num_results = num_results,
+        .queued_ms = (double)(start_time - ctx->request_time) / 1000,
+        .search_ms = (double)(now - start_time) / 1000,
+        .status = status,
+    };
+    fsearch_query_log_add(&record);
+}
+
 static void
 db_view_search_task_cancelled(gpointer data) {
     FsearchSearchContext *ctx = data;
+    db_view_search_log(ctx, FSEARCH_QUERY_LOG_STATUS_CANCELLED, 0);
 
     if (ctx->view->notify_func) {
         ctx->view->notify_func(ctx->view, DATABASE_VIEW_NOTIFY_SEARCH_FINISHED, ctx->view->notify_func_data);
@@ -303,6 +406,10 @@ db_view_search_task_finished(gpointer result, gpointer data) {
 
     if (result) {
         DatabaseSearchResult *res = result;
+        db_view_search_log(ctx,
+                           FSEARCH_QUERY_LOG_STATUS_FINISHED,
+                           (res->folders ? darray_get_num_items(res->folders) : 0)
+                               + (res->files ? darray_get_num_items(res->files) : 0));
 
         FsearchDatabase *db = ctx->db;
         if (ctx->view->db == db) {
@@ -315,11 +422,30 @@ db_view_search_task_finished(gpointer result, gpointer data) {
             g_clear_pointer(&ctx->view->folders, darray_unref);
             ctx->view->folders = g_steal_pointer(&res->folders);
 
+            if (ctx->searched_database) {
+                db_view_set_folder_paths(ctx->view, ctx->folder_paths);
+            }
+            db_view_set_shared_result(ctx->view, g_steal_pointer(&ctx->shared_result));
+
             ctx->view->sort_order = res->sort_type;
+            ctx->view->results_generation = ctx->generation;
+            ctx->view->results_are_partial = false;
+            ctx->view->results_sorted_partially = false;
+
+            if (ctx->cache_key && ctx->generation == ctx->view->search_generation) {
+                fsearch_result_cache_insert(ctx->view->result_cache,
+                                            ctx->cache_key,
+                                            ctx->view->folders,
+                                            ctx->view->files,
+                                            ctx->view->sort_order);
+            }
         }
 
         g_clear_pointer(&res, free);
     }
+    else {
+        db_view_search_log(ctx, FSEARCH_QUERY_LOG_STATUS_CANCELLED, 0);
+    }
 
     db_view_unlock(ctx->view);
 
@@ -336,25 +462,10 @@ typedef struct {
     FsearchDatabaseView *view;
     FsearchDatabaseIndexType sort_order;
     GtkSortType sort_type;
+    uint32_t visible_idx;
+    uint32_t num_visible;
 } FsearchSortContext;
 
-static void
-sort_array(DynamicArray *array,
-           DynamicArrayCompareDataFunc sort_func,
-           GCancellable *cancellable,
-           bool parallel_sort,
-           void *data) {
-    if (!array) {
-        return;
-    }
-    if (parallel_sort) {
-        darray_sort_multi_threaded(array, sort_func, cancellable, data);
-    }
-    else {
-        darray_sort(array, sort_func, cancellable, data);
-    }
-}
-
 static DynamicArrayCompareDataFunc
 get_sort_func(FsearchDatabaseIndexType sort_order) {
     DynamicArrayCompareDataFunc func = NULL;
@@ -377,30 +488,163 @@ get_sort_func(FsearchDatabaseIndexType sort_order) {
     case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
         func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_modification_time;
         break;
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_access_time;
+        break;
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_creation_time;
+        break;
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_status_change_time;
+        break;
+    case DATABASE_INDEX_TYPE_OWNER:
+        func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_owner;
+        break;
     default:
         func = (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_position;
     }
     return func;
 }
 
+// Folders and files can only be mixed in orders which compare them the same way. The order of the relevance is only
+// known within the folders or files, so they aren't mixed then.
+static DynamicArrayCompareDataFunc
+get_mix_compare_func(FsearchDatabaseIndexType sort_order) {
+    if (sort_order == DATABASE_INDEX_TYPE_RELEVANCE || sort_order >= NUM_DATABASE_INDEX_TYPES) {
+        return NULL;
+    }
+    return get_sort_func(sort_order);
+}
+
+// Orders by integer attributes can be sorted with darray_sort_by_key instead of comparing the entries
+static DynamicArrayKeyFunc
+get_sort_key_func(FsearchDatabaseIndexType sort_order) {
+    switch (sort_order) {
+    case DATABASE_INDEX_TYPE_SIZE:
+        return (DynamicArrayKeyFunc)db_entry_get_size_sort_key;
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_modification_time_sort_key;
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_access_time_sort_key;
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_creation_time_sort_key;
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+        return (DynamicArrayKeyFunc)db_entry_get_status_change_time_sort_key;
+    case DATABASE_INDEX_TYPE_OWNER:
+        return (DynamicArrayKeyFunc)db_entry_get_owner_sort_key;
+    default:
+        return NULL;
+    }
+}
+
+static void
+sort_array(DynamicArray *array,
+           FsearchDatabaseIndexType sort_order,
+           FsearchThreadPool *pool,
+           GCancellable *cancellable) {
+    if (!array) {
+        return;
+    }
+    DynamicArrayKeyFunc key_func = get_sort_key_func(sort_order);
+    if (key_func) {
+        darray_sort_by_key(array, key_func, pool, cancellable, NULL);
+    }
+    else {
+        darray_sort_multi_threaded(array, get_sort_func(sort_order), pool, cancellable, NULL);
+    }
+}
+
+static bool
+entry_is_wanted(FsearchDatabaseEntry *entry, FsearchBitset *wanted) {
+    return fsearch_bitset_contains(wanted, db_entry_get_idx(entry));
+}
+
+// The idx of the entries is their position in entries_by_name, so the entries of old_list can be collected in a bitset
+// by their positions, which is then checked for every entry of the sorted reference list. The view owns the bitset,
+// so unlike marks on the entries themselves, it doesn't get in the way of other views, and the reference list can be
+// split into ranges which are checked on the threads of pool.
 static DynamicArray *
-get_entries_sorted_from_reference_list(DynamicArray *old_list, DynamicArray *sorted_reference_list) {
+get_entries_sorted_from_reference_list(DynamicArray *old_list,
+                                       DynamicArray *sorted_reference_list,
+                                       DynamicArray *entries_by_name,
+                                       FsearchThreadPool *pool) {
+    if (!old_list) {
+        return NULL;
+    }
     const uint32_t num_items = darray_get_num_items(old_list);
-    DynamicArray *new = darray_new(num_items);
+    const uint32_t num_entries_by_name = darray_get_num_items(entries_by_name);
+    FsearchBitset *wanted = fsearch_bitset_new();
     for (uint32_t i = 0; i < num_items; ++i) {
         FsearchDatabaseEntry *entry = darray_get_item(old_list, i);
-        db_entry_set_mark(entry, 1);
-    }
-    uint32_t num_marked_found = 0;
-    const uint32_t num_items_in_sorted_reference_list = darray_get_num_items(sorted_reference_list);
-    for (uint32_t i = 0; i < num_items_in_sorted_reference_list && num_marked_found < num_items; ++i) {
-        FsearchDatabaseEntry *entry = darray_get_item(sorted_reference_list, i);
-        if (db_entry_get_mark(entry)) {
-            db_entry_set_mark(entry, 0);
-            darray_add_item(new, entry);
-            num_marked_found++;
+        const uint32_t idx = db_entry_get_idx(entry);
+        // entries which were removed from the database aren't part of the reference list either
+        if (idx < num_entries_by_name && darray_get_item(entries_by_name, idx) == entry) {
+            fsearch_bitset_add(wanted, idx);
         }
     }
+    DynamicArray *new = darray_filter(sorted_reference_list, (DynamicArrayFilterFunc)entry_is_wanted, pool, wanted);
+    g_clear_pointer(&wanted, fsearch_bitset_free);
+    return new;
+}
+
+typedef struct {
+    const uint32_t *ranks;
+    DynamicArray *entries_by_name;
+} FsearchSortRankContext;
+
+static bool
+entry_has_rank(FsearchDatabaseEntry *entry, FsearchSortRankContext *ctx) {
+    const uint32_t idx = db_entry_get_idx(entry);
+    // like in get_entries_sorted_from_reference_list, entries which were removed from the database are dropped
+    return idx < darray_get_num_items(ctx->entries_by_name) && darray_get_item(ctx->entries_by_name, idx) == entry;
+}
+
+static uint64_t
+get_rank_sort_key(FsearchDatabaseEntry *entry, FsearchSortRankContext *ctx) {
+    return ctx->ranks[db_entry_get_idx(entry)];
+}
+
+static DynamicArray *
+get_entries_sorted_by_rank(DynamicArray *old_list,
+                           const uint32_t *ranks,
+                           DynamicArray *entries_by_name,
+                           FsearchThreadPool *pool,
+                           GCancellable *cancellable) {
+    FsearchSortRankContext ctx = {.ranks = ranks, .entries_by_name = entries_by_name};
+    DynamicArray *new = darray_filter(old_list, (DynamicArrayFilterFunc)entry_has_rank, pool, &ctx);
+    darray_sort_by_key(new, (DynamicArrayKeyFunc)get_rank_sort_key, pool, cancellable, &ctx);
+    return new;
+}
+
+// Puts the entries of old_list into the order of the sorted arrays of the snapshot, either by walking them or by
+// sorting old_list by the ranks of its entries, whatever is cheaper
+static DynamicArray *
+get_entries_sorted_from_snapshot(DynamicArray *old_list,
+                                 FsearchDatabaseSnapshot *snapshot,
+                                 FsearchDatabaseIndexType sort_order,
+                                 bool folders,
+                                 FsearchThreadPool *pool,
+                                 GCancellable *cancellable) {
+    if (!old_list) {
+        return NULL;
+    }
+    DynamicArray *new = NULL;
+    DynamicArray *entries_by_name = folders ? db_snapshot_get_folders(snapshot) : db_snapshot_get_files(snapshot);
+    const uint64_t num_items = darray_get_num_items(old_list);
+    if (num_items * SORT_BY_RANK_MAX_SHARE < darray_get_num_items(entries_by_name)) {
+        const uint32_t *ranks = folders ? db_snapshot_get_folder_ranks(snapshot, sort_order, pool)
+                                        : db_snapshot_get_file_ranks(snapshot, sort_order, pool);
+        if (ranks) {
+            new = get_entries_sorted_by_rank(old_list, ranks, entries_by_name, pool, cancellable);
+        }
+    }
+    if (!new) {
+        DynamicArray *sorted = folders ? db_snapshot_get_folders_sorted(snapshot, sort_order)
+                                       : db_snapshot_get_files_sorted(snapshot, sort_order);
+        new = get_entries_sorted_from_reference_list(old_list, sorted, entries_by_name, pool);
+        g_clear_pointer(&sorted, darray_unref);
+    }
+    g_clear_pointer(&entries_by_name, darray_unref);
     return new;
 }
 
@@ -414,6 +658,55 @@ sort_order_affects_folders(FsearchDatabaseIndexType sort_order) {
     return true;
 }
 
+// Sorting many results with a compare function takes a while. The entries which are visible can be put into place
+// much faster though, so they're shown in the new order until the whole sort is done.
+static void
+publish_sort_preview(FsearchSortContext *ctx, DynamicArray *folders, DynamicArray *files, GCancellable *cancellable) {
+    FsearchDatabaseView *view = ctx->view;
+    const uint32_t num_folders = folders ? darray_get_num_items(folders) : 0;
+    const uint32_t num_files = files ? darray_get_num_items(files) : 0;
+    if (get_sort_key_func(ctx->sort_order) || ctx->num_visible == 0
+        || num_folders + num_files < SORT_PREVIEW_MIN_ENTRIES) {
+        return;
+    }
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    DynamicArrayCompareDataFunc func = get_sort_func(ctx->sort_order);
+    const uint32_t start = ctx->visible_idx;
+    const uint32_t end = start + ctx->num_visible;
+    DynamicArray *preview_folders = folders ? darray_copy(folders) : NULL;
+    DynamicArray *preview_files = files ? darray_copy(files) : NULL;
+    // folders come first
+    if (preview_folders && sort_order_affects_folders(ctx->sort_order) && start < num_folders) {
+        darray_partial_sort(preview_folders, start, MIN(end, num_folders), func, NULL);
+    }
+    if (preview_files && end > num_folders) {
+        darray_partial_sort(preview_files, MAX(start, num_folders) - num_folders, end - num_folders, func, NULL);
+    }
+
+    bool published = false;
+    db_view_lock(view);
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        g_clear_pointer(&view->folders, darray_unref);
+        g_clear_pointer(&view->files, darray_unref);
+        view->folders = g_steal_pointer(&preview_folders);
+        view->files = g_steal_pointer(&preview_files);
+        view->sort_order = ctx->sort_order;
+        view->sort_type = ctx->sort_type;
+        view->results_sorted_partially = true;
+        db_view_set_shared_result(view, NULL);
+        published = true;
+        g_debug("[sort] preview of %d entries after %2.fms", end - start, g_timer_elapsed(timer, NULL) * 1000);
+    }
+    db_view_unlock(view);
+    g_clear_pointer(&preview_folders, darray_unref);
+    g_clear_pointer(&preview_files, darray_unref);
+
+    if (published && view->notify_func) {
+        view->notify_func(view, DATABASE_VIEW_NOTIFY_CONTENT_CHANGED, view->notify_func_data);
+    }
+}
+
 static gpointer
 db_view_sort_task(gpointer data, GCancellable *cancellable) {
     FsearchSortContext *ctx = data;
@@ -425,6 +718,8 @@ db_view_sort_task(gpointer data, GCancellable *cancellable) {
 
     DynamicArray *files = NULL;
     DynamicArray *folders = NULL;
+    FsearchDatabaseSnapshot *snapshot = NULL;
+    FsearchSharedResult *shared_result = NULL;
 
     if (view->notify_func) {
         view->notify_func(view, DATABASE_VIEW_NOTIFY_SORT_STARTED, view->notify_func_data);
@@ -432,71 +727,82 @@ db_view_sort_task(gpointer data, GCancellable *cancellable) {
 
     g_autoptr(GTimer) timer = g_timer_new();
     g_timer_start(timer);
+    FsearchOperationTimer operation_timer = {};
+    fsearch_operation_timer_start(&operation_timer, view->pool);
+    // keeping the current order isn't worth reporting, it would only hide how long the search took
+    bool sorted = true;
 
-    db_view_lock(view);
-    db_lock(view->db);
+    fsearch_operation_timer_lock(&operation_timer, &view->mutex);
 
-    if (view->sort_order == ctx->sort_order) {
+    if (view->sort_order == ctx->sort_order && !view->results_sorted_partially) {
         // Sort order didn't change, use the old results
+        sorted = false;
         files = darray_ref(view->files);
         folders = darray_ref(view->folders);
+        shared_result = fsearch_shared_result_ref(view->shared_result);
         goto out;
     }
 
-    if (db_has_entries_sorted_by_type(view->db, ctx->sort_order)) {
+    // the sorted arrays of the snapshot don't change, so the database doesn't need to be locked while they're used
+    snapshot = db_get_snapshot(view->db);
+    if (db_snapshot_has_entries_sorted_by_type(snapshot, ctx->sort_order)) {
         if (!view->query || fsearch_query_matches_everything(view->query)) {
             // We're matching everything, and we have the entries already sorted in our index.
             // So we can just return references to the sorted indices.
-            files = db_get_files_sorted(view->db, ctx->sort_order);
-            folders = db_get_folders_sorted(view->db, ctx->sort_order);
+            files = db_snapshot_get_files_sorted(snapshot, ctx->sort_order);
+            folders = db_snapshot_get_folders_sorted(snapshot, ctx->sort_order);
         }
         else {
-            // Another fast path. First we mark all entries we have currently in the view, then we walk the sorted
-            // index in order and add all marked entries to a new array.
-            DynamicArray *sorted_folders = db_get_folders_sorted(view->db, ctx->sort_order);
-            DynamicArray *sorted_files = db_get_files_sorted(view->db, ctx->sort_order);
-            folders = get_entries_sorted_from_reference_list(view->folders, sorted_folders);
-            files = get_entries_sorted_from_reference_list(view->files, sorted_files);
-            g_clear_pointer(&sorted_folders, darray_unref);
-            g_clear_pointer(&sorted_files, darray_unref);
+            // Another fast path. The entries we have currently in the view are put into the order of the sorted
+            // index, either by walking it or by their ranks in it.
+            folders = get_entries_sorted_from_snapshot(view->folders,
+                                                       snapshot,
+                                                       ctx->sort_order,
+                                                       true,
+                                                       view->pool,
+                                                       cancellable);
+            files = get_entries_sorted_from_snapshot(view->files,
+                                                     snapshot,
+                                                     ctx->sort_order,
+                                                     false,
+                                                     view->pool,
+                                                     cancellable);
         }
         goto out;
     }
-    else {
-        files = darray_copy(view->files);
-        folders = darray_copy(view->folders);
-    }
 
-    DynamicArrayCompareDataFunc func = get_sort_func(ctx->sort_order);
-    bool parallel_sort = true;
-
-    FsearchDatabaseEntryCompareContext *comp_ctx = NULL;
-    if (ctx->sort_order == DATABASE_INDEX_TYPE_FILETYPE) {
-        // Sorting by type can be really slow, because it accesses the filesystem to determine the type of files
-        // To mitigate that issue to a certain degree we cache the filetype for each file
-        // To avoid duplicating the filetype in memory for each file, we also store each filetype only once in
-        // a separate hash table.
-        // We also disable parallel sorting.
-        comp_ctx = calloc(1, sizeof(FsearchDatabaseEntryCompareContext));
-        comp_ctx->file_type_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-        comp_ctx->entry_to_file_type_table = g_hash_table_new(NULL, NULL);
-        parallel_sort = false;
+    // the database isn't done building that order yet, it's the next one it builds then
+    db_set_index_priority(view->db, ctx->sort_order);
+
+    // other views with the same results might sort them in the same order as well
+    if (view->shared_result) {
+        g_autofree char *key =
+            g_strdup_printf("sort:%d:%s", ctx->sort_order, fsearch_shared_result_get_key(view->shared_result));
+        bool compute = false;
+        shared_result = fsearch_shared_results_attach(db_get_shared_results(view->db), key, &compute);
+        if (!compute) {
+            db_view_unlock(view);
+            const bool found = fsearch_shared_result_wait(shared_result, cancellable, &folders, &files, NULL);
+            fsearch_operation_timer_lock(&operation_timer, &view->mutex);
+            if (found) {
+                g_debug("[sort] another view sorted the results already");
+                goto out;
+            }
+            g_clear_pointer(&shared_result, fsearch_shared_result_unref);
+        }
     }
+    files = darray_copy(view->files);
+    folders = darray_copy(view->folders);
 
     g_debug("[sort] started: %d", ctx->sort_order);
 
     db_view_unlock(view);
+    publish_sort_preview(ctx, folders, files, cancellable);
     if (sort_order_affects_folders(ctx->sort_order)) {
-        sort_array(folders, func, cancellable, parallel_sort, comp_ctx);
-    }
-    sort_array(files, func, cancellable, parallel_sort, comp_ctx);
-    db_view_lock(view);
-
-    if (comp_ctx) {
-        g_clear_pointer(&comp_ctx->entry_to_file_type_table, g_hash_table_unref);
-        g_clear_pointer(&comp_ctx->file_type_table, g_hash_table_unref);
-        g_clear_pointer(&comp_ctx, free);
+        sort_array(folders, ctx->sort_order, view->pool, cancellable);
     }
+    sort_array(files, ctx->sort_order, view->pool, cancellable);
+    fsearch_operation_timer_lock(&operation_timer, &view->mutex);
 
 out:
     g_timer_stop(timer);
@@ -509,15 +815,29 @@ out:
         view->files = g_steal_pointer(&files);
         view->sort_order = ctx->sort_order;
         view->sort_type = ctx->sort_type;
+        view->results_sorted_partially = false;
+        if (shared_result) {
+            fsearch_shared_result_publish(shared_result, view->folders, view->files, ctx->sort_order);
+        }
+        db_view_set_shared_result(view, g_steal_pointer(&shared_result));
+        if (sorted) {
+            const uint64_t num_entries = (view->folders ? darray_get_num_items(view->folders) : 0)
+                                       + (view->files ? darray_get_num_items(view->files) : 0);
+            fsearch_operation_timer_finish(&operation_timer, num_entries, num_entries, &view->sort_stats);
+        }
         g_debug("[sort] finished in %2.fms", seconds * 1000);
     }
     else {
         g_clear_pointer(&folders, darray_unref);
         g_clear_pointer(&files, darray_unref);
+        if (shared_result) {
+            fsearch_shared_result_abandon(shared_result);
+            g_clear_pointer(&shared_result, fsearch_shared_result_unref);
+        }
         g_debug("[sort] cancelled after %2.fms", seconds * 1000);
     }
-    db_unlock(view->db);
     db_view_unlock(view);
+    g_clear_pointer(&snapshot, db_snapshot_unref);
 
     if (view->notify_func) {
         view->notify_func(view, DATABASE_VIEW_NOTIFY_SORT_FINISHED, view->notify_func_data);
@@ -539,12 +859,19 @@ db_view_sort_task_finished(gpointer result, gpointer data) {
 
 static void
 db_view_sort(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order, GtkSortType sort_type) {
+    if (!view->db) {
+        db_view_clear_warm_start(view);
+        return;
+    }
+
     FsearchSortContext *ctx = calloc(1, sizeof(FsearchSortContext));
     g_assert(ctx);
 
     ctx->view = view;
     ctx->sort_order = sort_order;
     ctx->sort_type = sort_type;
+    ctx->visible_idx = view->visible_idx;
+    ctx->num_visible = view->num_visible;
 
     fsearch_task_queue(view->task_queue,
                        FSEARCH_TASK_ID_SORT,
@@ -552,17 +879,48 @@ db_view_sort(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order, Gtk
                        db_view_sort_task_finished,
                        db_view_sort_task_cancelled,
                        FSEARCH_TASK_CLEAR_SAME_ID,
+                       FSEARCH_TASK_PRIORITY_INTERACTIVE,
                        g_steal_pointer(&ctx));
 }
 
-static gpointer
-db_view_search_task(gpointer data, GCancellable *cancellable) {
+static void
+db_view_search_task_progress(DynamicArray *folders, DynamicArray *files, void *data) {
     FsearchSearchContext *ctx = data;
+    FsearchDatabaseView *view = ctx->view;
 
-    if (ctx->view->notify_func) {
-        ctx->view->notify_func(ctx->view, DATABASE_VIEW_NOTIFY_SEARCH_STARTED, ctx->view->notify_func_data);
+    // Threads which hold the view lock might wait for the thread pool the search runs on, so waiting for the lock
+    // here could deadlock. The next update will be along shortly.
+    if (!g_mutex_trylock(&view->mutex)) {
+        return;
     }
+    // a newer search cancels this one while holding the view lock, so if it's not cancelled it's still current
+    if (g_cancellable_is_cancelled(ctx->cancellable) || view->db != ctx->db) {
+        db_view_unlock(view);
+        return;
+    }
+    if (!ctx->published_partial_results && view->selection && ctx->reset_selection) {
+        fsearch_selection_unselect_all(view->selection);
+    }
+    ctx->published_partial_results = true;
+
+    g_clear_pointer(&view->folders, darray_unref);
+    view->folders = folders ? darray_ref(folders) : NULL;
+    g_clear_pointer(&view->files, darray_unref);
+    view->files = files ? darray_ref(files) : NULL;
+    view->sort_order = ctx->results_sort_order;
+    view->results_are_partial = true;
+    view->results_sorted_partially = false;
+    db_view_set_folder_paths(view, ctx->folder_paths);
+    db_view_set_shared_result(view, NULL);
+    db_view_unlock(view);
 
+    if (view->notify_func) {
+        view->notify_func(view, DATABASE_VIEW_NOTIFY_CONTENT_CHANGED, view->notify_func_data);
+    }
+}
+
+static DatabaseSearchResult *
+db_view_search_run(FsearchSearchContext *ctx, GCancellable *cancellable) {
     g_autoptr(GTimer) timer = g_timer_new();
     g_timer_start(timer);
 
@@ -571,16 +929,80 @@ db_view_search_task(gpointer data, GCancellable *cancellable) {
     DynamicArray *files = NULL;
     DynamicArray *folders = NULL;
 
-    db_lock(ctx->db);
-    db_get_entries_sorted(ctx->db, ctx->sort_order, &sort_order, &folders, &files);
+    // When the new query only narrows down the current one, e.g. because more characters were typed, only the
+    // current results need to be searched
+    bool refine = false;
+    fsearch_operation_timer_lock(&ctx->timer, &ctx->view->mutex);
+    // the results of queries which match everything are the sorted arrays of the database, there's no point in
+    // caching those
+    if (!fsearch_query_matches_everything(ctx->query)) {
+        ctx->cache_key = get_result_cache_key(ctx->query, ctx->sort_order);
+        if (ctx->generation == ctx->view->search_generation
+            && fsearch_result_cache_lookup(ctx->view->result_cache, ctx->cache_key, &folders, &files, &sort_order)) {
+            db_view_unlock(ctx->view);
+            g_debug("[%s] found results in cache", ctx->query->query_id);
+            // the results are already cached
+            g_clear_pointer(&ctx->cache_key, g_free);
+            result = db_search_empty(folders, files, sort_order);
+            g_clear_pointer(&files, darray_unref);
+            g_clear_pointer(&folders, darray_unref);
+            return result;
+        }
+    }
+    // results sorted by relevance get scored again anyway
+    const bool by_relevance = ctx->sort_order == DATABASE_INDEX_TYPE_RELEVANCE;
+    if (ctx->view->db == ctx->db && ctx->view->results_generation == ctx->generation && !by_relevance
+        && !ctx->view->results_are_partial && !ctx->view->results_sorted_partially
+        && fsearch_query_is_refinement_of(ctx->query, ctx->view->query)) {
+        refine = true;
+        sort_order = ctx->view->sort_order;
+        files = ctx->view->files ? darray_ref(ctx->view->files) : darray_new(0);
+        folders = ctx->view->folders ? darray_ref(ctx->view->folders) : darray_new(0);
+    }
+    db_view_unlock(ctx->view);
 
+    // the snapshot stays the same while the database gets updated, so it doesn't need to be locked
+    FsearchDatabaseSnapshot *snapshot = db_get_snapshot(ctx->db);
+    ctx->searched_database = true;
+    ctx->folder_paths = fsearch_folder_paths_ref(db_snapshot_get_folder_paths(snapshot));
+    if (refine) {
+        g_debug("[%s] refining the results of the previous query", ctx->query->query_id);
+    }
+    else {
+        db_snapshot_get_entries_sorted(snapshot, ctx->sort_order, &sort_order, &folders, &files);
+    }
+
+    ctx->num_searched = darray_get_num_items(folders) + darray_get_num_items(files);
     if (fsearch_query_matches_everything(ctx->query)) {
-        result = db_search_empty(folders, files, sort_order);
+        // all entries are equally relevant then, so they stay in the order of the name array
+        result = db_search_empty(folders, files, by_relevance ? ctx->sort_order : sort_order);
     }
     else {
-        result = db_search(ctx->query, ctx->view->pool, folders, files, sort_order, cancellable);
+        DatabaseSearchLimit limit = {.by_relevance = by_relevance};
+        if (by_relevance) {
+            // the scores are only known while searching
+            sort_order = ctx->sort_order;
+        }
+        ctx->cancellable = cancellable;
+        ctx->results_sort_order = sort_order;
+        result = db_search(ctx->query,
+                           ctx->view->pool,
+                           folders,
+                           files,
+                           db_snapshot_get_folder_trigram_index(snapshot),
+                           db_snapshot_get_file_trigram_index(snapshot),
+                           db_snapshot_get_folder_name_index(snapshot),
+                           db_snapshot_get_file_name_index(snapshot),
+                           db_snapshot_get_subtree_filter(snapshot),
+                           ctx->folder_paths,
+                           db_snapshot_get_folded_names(snapshot),
+                           &limit,
+                           sort_order,
+                           db_view_search_task_progress,
+                           ctx,
+                           cancellable);
     }
-    db_unlock(ctx->db);
+    g_clear_pointer(&snapshot, db_snapshot_unref);
 
     g_clear_pointer(&files, darray_unref);
     g_clear_pointer(&folders, darray_unref);
@@ -597,12 +1019,98 @@ db_view_search_task(gpointer data, GCancellable *cancellable) {
 
     g_debug(debug_message, ctx->query->query_id, seconds * 1000);
 
+    if (!fsearch_query_matches_everything(ctx->query)) {
+        // queries which match everything don't search at all, they would make searches look faster than they are
+        fsearch_operation_timer_lock(&ctx->timer, &ctx->view->mutex);
+        fsearch_search_latency_add(&ctx->view->search_latency,
+                                   refine ? FSEARCH_SEARCH_CLASS_REFINE : FSEARCH_SEARCH_CLASS_FULL,
+                                   seconds * 1000,
+                                   g_cancellable_is_cancelled(cancellable));
+        db_view_unlock(ctx->view);
+    }
+
+    return result;
+}
+
+// Attaches ctx to the shared result of its query. Returns true if another view computed it already, result is set
+// to it then (or NULL if the search got cancelled while waiting for it).
+static bool
+db_view_search_attach_shared(FsearchSearchContext *ctx, GCancellable *cancellable, DatabaseSearchResult **result) {
+    // queries which match everything only hand out the sorted arrays of the database
+    if (fsearch_query_matches_everything(ctx->query)) {
+        return false;
+    }
+    FsearchDatabaseSnapshot *snapshot = db_get_snapshot(ctx->db);
+    g_autofree char *cache_key = get_result_cache_key(ctx->query, ctx->sort_order);
+    g_autofree char *key =
+        g_strdup_printf("%" PRIu64 ":%s", db_snapshot_get_version(snapshot), cache_key);
+
+    bool compute = false;
+    ctx->shared_result = fsearch_shared_results_attach(db_get_shared_results(ctx->db), key, &compute);
+    if (compute) {
+        g_clear_pointer(&snapshot, db_snapshot_unref);
+        return false;
+    }
+
+    DynamicArray *folders = NULL;
+    DynamicArray *files = NULL;
+    FsearchDatabaseIndexType sort_order = DATABASE_INDEX_TYPE_NAME;
+    bool found = fsearch_shared_result_wait(ctx->shared_result, cancellable, &folders, &files, &sort_order);
+    if (found) {
+        g_debug("[%s] another view found the results already", ctx->query->query_id);
+        // the results were found in this snapshot
+        ctx->searched_database = true;
+        ctx->folder_paths = fsearch_folder_paths_ref(db_snapshot_get_folder_paths(snapshot));
+        *result = db_search_empty(folders, files, sort_order);
+    }
+    else {
+        // the view which computed it was cancelled, so this one searches on its own
+        g_clear_pointer(&ctx->shared_result, fsearch_shared_result_unref);
+        found = g_cancellable_is_cancelled(cancellable);
+        *result = NULL;
+    }
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&snapshot, db_snapshot_unref);
+    return found;
+}
+
+static gpointer
+db_view_search_task(gpointer data, GCancellable *cancellable) {
+    FsearchSearchContext *ctx = data;
+
+    if (ctx->view->notify_func) {
+        ctx->view->notify_func(ctx->view, DATABASE_VIEW_NOTIFY_SEARCH_STARTED, ctx->view->notify_func_data);
+    }
+
+    fsearch_operation_timer_start(&ctx->timer, ctx->view->pool);
+    DatabaseSearchResult *result = NULL;
+    if (!db_view_search_attach_shared(ctx, cancellable, &result)) {
+        result = db_view_search_run(ctx, cancellable);
+        if (ctx->shared_result) {
+            if (result && !g_cancellable_is_cancelled(cancellable)) {
+                fsearch_shared_result_publish(ctx->shared_result, result->folders, result->files, result->sort_type);
+            }
+            else {
+                fsearch_shared_result_abandon(ctx->shared_result);
+                g_clear_pointer(&ctx->shared_result, fsearch_shared_result_unref);
+            }
+        }
+    }
+    if (result && !g_cancellable_is_cancelled(cancellable)) {
+        const uint64_t num_results = (result->folders ? darray_get_num_items(result->folders) : 0)
+                                   + (result->files ? darray_get_num_items(result->files) : 0);
+        db_view_lock(ctx->view);
+        fsearch_operation_timer_finish(&ctx->timer, ctx->num_searched, num_results, &ctx->view->search_stats);
+        db_view_unlock(ctx->view);
+    }
     return result;
 }
 
 static void
 db_view_search(FsearchDatabaseView *view, bool reset_selection) {
     if (!view->db || !view->pool) {
+        db_view_clear_warm_start(view);
         return;
     }
 
@@ -612,12 +1120,17 @@ db_view_search(FsearchDatabaseView *view, bool reset_selection) {
     ctx->view = db_view_ref(view);
     ctx->db = db_ref(view->db);
     ctx->sort_order = view->sort_order;
+    ctx->generation = view->search_generation;
     ctx->reset_selection = reset_selection;
 
     g_autoptr(GString) query_id = g_string_new(NULL);
     g_string_printf(query_id, "query:%02d.%04d", view->id, view->query_id++);
     ctx->query = fsearch_query_new(view->query_text, view->filter, view->filters, view->query_flags, query_id->str);
     g_assert(ctx->query);
+    if (fsearch_query_log_is_enabled()) {
+        ctx->request_time = g_get_monotonic_time();
+        ctx->log_time = fsearch_query_log_get_time();
+    }
 
     fsearch_task_queue(view->task_queue,
                        FSEARCH_TASK_ID_SEARCH,
@@ -625,9 +1138,45 @@ db_view_search(FsearchDatabaseView *view, bool reset_selection) {
                        db_view_search_task_finished,
                        db_view_search_task_cancelled,
                        FSEARCH_TASK_CLEAR_SAME_ID,
+                       FSEARCH_TASK_PRIORITY_INTERACTIVE,
                        g_steal_pointer(&ctx));
 }
 
+void
+db_view_index_ready(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_type) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    g_debug("[db_view] sorted arrays of type %d are ready", sort_type);
+    if (view->notify_func) {
+        view->notify_func(view, DATABASE_VIEW_NOTIFY_INDEX_READY, view->notify_func_data);
+    }
+    db_view_unlock(view);
+}
+
+void
+db_view_refresh(FsearchDatabaseView *view) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+
+    // the positions of the entries in the database changed
+    if (view->db) {
+        FsearchSelection *selection = migrate_selection(NULL, view->db, view->selection);
+        g_clear_pointer(&view->selection, fsearch_selection_free);
+        view->selection = selection;
+    }
+
+    // the database content changed, so the current query has to run again
+    db_view_invalidate_results(view);
+    db_view_search(view, false);
+    db_view_sort(view, view->sort_order, view->sort_type);
+
+    db_view_unlock(view);
+}
+
 void
 db_view_set_filters(FsearchDatabaseView *view, FsearchFilterManager *filters) {
     if (!view) {
@@ -638,6 +1187,8 @@ db_view_set_filters(FsearchDatabaseView *view, FsearchFilterManager *filters) {
     g_clear_pointer(&view->filters, fsearch_filter_manager_free);
     view->filters = fsearch_filter_manager_copy(filters);
 
+    // filter macros might have changed
+    db_view_invalidate_results(view);
     db_view_search(view, true);
 
     db_view_unlock(view);
@@ -689,6 +1240,52 @@ db_view_set_query_flags(FsearchDatabaseView *view, FsearchQueryFlags query_flags
     db_view_unlock(view);
 }
 
+uint32_t
+db_view_get_search_delay(FsearchDatabaseView *view, const char *query_text) {
+    if (!view || !query_text) {
+        return 0;
+    }
+    db_view_lock(view);
+    // typing more characters usually narrows down the current query, so only its results get searched
+    const bool refine = view->query_text[0] != '\0' && strlen(query_text) > strlen(view->query_text)
+                     && g_str_has_prefix(query_text, view->query_text);
+    const uint32_t delay = fsearch_search_latency_get_delay(&view->search_latency,
+                                                            refine ? FSEARCH_SEARCH_CLASS_REFINE
+                                                                   : FSEARCH_SEARCH_CLASS_FULL);
+    db_view_unlock(view);
+    return delay;
+}
+
+FsearchSearchLatency
+db_view_get_search_latency(FsearchDatabaseView *view) {
+    FsearchSearchLatency latency = {};
+    if (!view) {
+        return latency;
+    }
+    db_view_lock(view);
+    latency = view->search_latency;
+    db_view_unlock(view);
+    return latency;
+}
+
+void
+db_view_get_operation_stats(FsearchDatabaseView *view, FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS]) {
+    g_assert(stats);
+    memset(stats, 0, NUM_FSEARCH_OPERATIONS * sizeof(FsearchOperationStats));
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    stats[FSEARCH_OPERATION_SEARCH] = view->search_stats;
+    stats[FSEARCH_OPERATION_SORT] = view->sort_stats;
+    if (view->db) {
+        db_get_operation_stats(view->db, FSEARCH_OPERATION_SCAN, &stats[FSEARCH_OPERATION_SCAN]);
+        db_get_operation_stats(view->db, FSEARCH_OPERATION_LOAD, &stats[FSEARCH_OPERATION_LOAD]);
+        db_get_operation_stats(view->db, FSEARCH_OPERATION_SAVE, &stats[FSEARCH_OPERATION_SAVE]);
+    }
+    db_view_unlock(view);
+}
+
 void
 db_view_set_query_text(FsearchDatabaseView *view, const char *query_text) {
     if (!view) {
@@ -704,18 +1301,91 @@ db_view_set_query_text(FsearchDatabaseView *view, const char *query_text) {
     db_view_unlock(view);
 }
 
+void
+db_view_set_result_cache_size(FsearchDatabaseView *view, size_t size) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    fsearch_result_cache_set_max_size(view->result_cache, size);
+    db_view_unlock(view);
+}
+
 void
 db_view_set_sort_order(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order, GtkSortType sort_type) {
     if (!view) {
         return;
     }
     db_view_lock(view);
-    if (view->sort_order != sort_order || view->sort_type != sort_type) {
+    if (sort_order == DATABASE_INDEX_TYPE_RELEVANCE && view->sort_order != sort_order) {
+        // the scores of the results are only known while searching
+        view->sort_order = sort_order;
+        view->sort_type = sort_type;
+        db_view_search(view, false);
+    }
+    else if (view->sort_order != sort_order || view->sort_type != sort_type) {
         db_view_sort(view, sort_order, sort_type);
     }
     db_view_unlock(view);
 }
 
+void
+db_view_set_mix_entries(FsearchDatabaseView *view, bool mix_entries) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    if (view->mix_entries != mix_entries) {
+        view->mix_entries = mix_entries;
+        g_clear_pointer(&view->merge, fsearch_array_merge_free);
+        if (view->notify_func) {
+            view->notify_func(view, DATABASE_VIEW_NOTIFY_CONTENT_CHANGED, view->notify_func_data);
+        }
+    }
+    db_view_unlock(view);
+}
+
+void
+db_view_set_visible_rows(FsearchDatabaseView *view, uint32_t first_idx, uint32_t num_entries) {
+    if (!view) {
+        return;
+    }
+    db_view_lock(view);
+    view->visible_idx = first_idx;
+    view->num_visible = num_entries;
+    db_view_unlock(view);
+}
+
+static void
+db_view_add_result_memory_usage(DynamicArray *results, FsearchDatabaseMemoryUsage *usage, GHashTable *counted_arrays) {
+    if (!results || !g_hash_table_add(counted_arrays, results)) {
+        return;
+    }
+    usage->view_results += darray_get_memory_usage(results);
+    usage->entry_columns += db_entry_columns_get_memory_usage(results);
+}
+
+void
+db_view_get_memory_usage(FsearchDatabaseView *view, FsearchDatabaseMemoryUsage *usage, GHashTable *counted_arrays) {
+    g_assert(view);
+    g_assert(usage);
+    g_assert(counted_arrays);
+
+    db_view_lock(view);
+    db_view_add_result_memory_usage(view->folders, usage, counted_arrays);
+    db_view_add_result_memory_usage(view->files, usage, counted_arrays);
+    if (view->merge) {
+        usage->view_results += fsearch_array_merge_get_memory_usage(view->merge);
+    }
+    if (view->selection) {
+        usage->view_selections += fsearch_selection_get_memory_usage(view->selection);
+    }
+    if (view->result_cache) {
+        usage->view_result_caches += fsearch_result_cache_get_size(view->result_cache);
+    }
+    db_view_unlock(view);
+}
+
 uint32_t
 db_view_get_num_folders(FsearchDatabaseView *view) {
     g_assert(view);
@@ -746,8 +1416,31 @@ db_view_get_sort_order(FsearchDatabaseView *view) {
     return view->sort_order;
 }
 
+// Returns the merge of the folders and files if they're mixed, NULL if the folders come first. It's computed again
+// once the arrays or their order changed.
+static FsearchArrayMerge *
+db_view_get_merge(FsearchDatabaseView *view) {
+    DynamicArrayCompareDataFunc compare_func = get_mix_compare_func(view->sort_order);
+    if (!view->mix_entries || !compare_func || !view->folders || !view->files) {
+        g_clear_pointer(&view->merge, fsearch_array_merge_free);
+        return NULL;
+    }
+    if (view->merge && fsearch_array_merge_get_first(view->merge) == view->folders
+        && fsearch_array_merge_get_second(view->merge) == view->files && view->merge_sort_order == view->sort_order) {
+        return view->merge;
+    }
+    g_clear_pointer(&view->merge, fsearch_array_merge_free);
+    view->merge = fsearch_array_merge_new(view->folders, view->files, compare_func, NULL, view->pool);
+    view->merge_sort_order = view->sort_order;
+    return view->merge;
+}
+
 static FsearchDatabaseEntry *
 db_view_get_entry_for_idx(FsearchDatabaseView *view, uint32_t idx) {
+    FsearchArrayMerge *merge = db_view_get_merge(view);
+    if (merge) {
+        return fsearch_array_merge_get_item(merge, idx);
+    }
     const uint32_t num_folders = darray_get_num_items(view->folders);
     if (idx < num_folders) {
         return darray_get_item(view->folders, idx);
@@ -767,7 +1460,8 @@ db_view_entry_get_path_for_idx(FsearchDatabaseView *view, uint32_t idx) {
     GString *res = NULL;
     FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, idx);
     if (entry) {
-        res = db_entry_get_path(entry);
+        res = g_string_new(NULL);
+        fsearch_folder_paths_append_path(view->folder_paths, entry, res);
     }
     return res;
 }
@@ -776,7 +1470,12 @@ GString *
 db_view_entry_get_path_full_for_idx(FsearchDatabaseView *view, uint32_t idx) {
     g_assert(view);
     FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, idx);
-    return entry ? db_entry_get_path_full(entry) : NULL;
+    if (!entry) {
+        return NULL;
+    }
+    GString *path_full = g_string_new(NULL);
+    fsearch_folder_paths_append_full_path(view->folder_paths, entry, path_full);
+    return path_full;
 }
 
 void
@@ -784,7 +1483,7 @@ db_view_entry_append_path_for_idx(FsearchDatabaseView *view, uint32_t idx, GStri
     g_assert(view);
     FsearchDatabaseEntry *entry = db_view_get_entry_for_idx(view, idx);
     if (entry) {
-        db_entry_append_path(entry, str);
+        fsearch_folder_paths_append_path(view->folder_paths, entry, str);
     }
 }
 
@@ -857,6 +1556,57 @@ db_view_entry_get_type_for_idx(FsearchDatabaseView *view, uint32_t idx) {
     return entry ? db_entry_get_type(entry) : DATABASE_ENTRY_TYPE_NONE;
 }
 
+static void
+db_view_row_init(FsearchDatabaseViewRow *row, FsearchDatabaseEntry *entry, GStringChunk *names) {
+    FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+    row->entry = entry;
+    row->name = g_string_chunk_insert(names, db_entry_get_name_raw_for_display(entry));
+    row->size = db_entry_get_size(entry);
+    row->mtime = db_entry_get_mtime(entry);
+    row->type = db_entry_get_type(entry);
+    row->parent_idx = parent ? (int32_t)db_entry_get_idx((FsearchDatabaseEntry *)parent) : -1;
+}
+
+uint32_t
+db_view_get_rows(FsearchDatabaseView *view,
+                 uint32_t start_idx,
+                 uint32_t end_idx,
+                 FsearchDatabaseViewRow *rows,
+                 GStringChunk *names) {
+    g_assert(view);
+    g_assert(rows);
+    g_assert(names);
+
+    db_view_lock(view);
+    const uint32_t num_folders = db_view_get_num_folders(view);
+    end_idx = MIN(end_idx, num_folders + db_view_get_num_files(view));
+    uint32_t num_rows = 0;
+    FsearchArrayMerge *merge = db_view_get_merge(view);
+    if (merge) {
+        // only the first entry of every batch needs to be searched for
+        void *entries[256];
+        while (start_idx + num_rows < end_idx) {
+            const uint32_t num_entries = fsearch_array_merge_get_items(merge,
+                                                                       start_idx + num_rows,
+                                                                       MIN(G_N_ELEMENTS(entries),
+                                                                           end_idx - start_idx - num_rows),
+                                                                       entries);
+            for (uint32_t i = 0; i < num_entries; i++, num_rows++) {
+                db_view_row_init(&rows[num_rows], entries[i], names);
+            }
+        }
+        db_view_unlock(view);
+        return num_rows;
+    }
+    for (uint32_t idx = start_idx; idx < end_idx; idx++, num_rows++) {
+        FsearchDatabaseEntry *entry = idx < num_folders ? darray_get_item(view->folders, idx)
+                                                        : darray_get_item(view->files, idx - num_folders);
+        db_view_row_init(&rows[num_rows], entry, names);
+    }
+    db_view_unlock(view);
+    return num_rows;
+}
+
 static void
 notify_selection_changed(FsearchDatabaseView *view) {
     if (view->notify_func) {
@@ -978,8 +1728,101 @@ void
 db_view_selection_for_each(FsearchDatabaseView *view, GHFunc func, gpointer user_data) {
     g_assert(view);
     db_view_lock(view);
-    g_hash_table_foreach(view->selection, func, user_data);
+    fsearch_selection_for_each(view->selection, func, user_data);
+    db_view_unlock(view);
+}
+
+static void
+add_selected_entry(gpointer key, gpointer value, gpointer user_data) {
+    darray_add_item(user_data, value);
+}
+
+FsearchSelectionExport *
+db_view_selection_export_new(FsearchDatabaseView *view, FsearchSelectionExportFormat format) {
+    g_assert(view);
+    db_view_lock(view);
+    const uint32_t num_selected = fsearch_selection_get_num_selected(view->selection);
+    if (!num_selected || !view->db) {
+        db_view_unlock(view);
+        return NULL;
+    }
+    // only the entries are collected here, their paths are built by the export
+    g_autoptr(DynamicArray) entries = darray_new(num_selected);
+    fsearch_selection_for_each(view->selection, add_selected_entry, entries);
+    FsearchSelectionExport *export = fsearch_selection_export_new(view->db, entries, view->folder_paths, format);
+    db_view_unlock(view);
+    return export;
+}
+
+bool
+db_view_set_warm_start(FsearchDatabaseView *view, FsearchWarmStart *warm_start) {
+    g_assert(view);
+    g_assert(warm_start);
+    db_view_lock(view);
+    if (view->db || view->warm_start
+        || !fsearch_warm_start_matches(warm_start,
+                                       view->query_text,
+                                       view->filter ? view->filter->name : NULL,
+                                       view->query_flags,
+                                       view->sort_order,
+                                       view->sort_type == GTK_SORT_ASCENDING)) {
+        db_view_unlock(view);
+        return false;
+    }
+    view->warm_start = fsearch_warm_start_ref(warm_start);
+    view->folders = fsearch_warm_start_get_folders(warm_start);
+    view->files = fsearch_warm_start_get_files(warm_start);
+    if (view->notify_func) {
+        view->notify_func(view, DATABASE_VIEW_NOTIFY_CONTENT_CHANGED, view->notify_func_data);
+    }
+    db_view_unlock(view);
+    return true;
+}
+
+bool
+db_view_save_warm_start(FsearchDatabaseView *view, const char *file_path, uint32_t max_rows) {
+    g_assert(view);
+    g_assert(file_path);
+    db_view_lock(view);
+    // the rows of a search which didn't finish yet aren't worth showing again
+    if (!view->db || view->results_are_partial || view->results_sorted_partially) {
+        db_view_unlock(view);
+        return false;
+    }
+    // descending orders show the entries from the back
+    const uint32_t num_entries = db_view_get_num_entries(view);
+    const bool ascending = view->sort_type == GTK_SORT_ASCENDING;
+    uint32_t first_row = ascending || num_entries < max_rows ? 0 : num_entries - max_rows;
+    g_autoptr(DynamicArray) folders = NULL;
+    g_autoptr(DynamicArray) files = NULL;
+    FsearchArrayMerge *merge = db_view_get_merge(view);
+    if (!merge) {
+        folders = view->folders ? darray_ref(view->folders) : NULL;
+        files = view->files ? darray_ref(view->files) : NULL;
+    }
+    else {
+        // the rows are saved as folders and files, which get mixed in the same order again when they're shown
+        folders = darray_new(128);
+        files = darray_new(128);
+        for (uint32_t i = 0; i < max_rows && first_row + i < num_entries; i++) {
+            FsearchDatabaseEntry *entry = fsearch_array_merge_get_item(merge, first_row + i);
+            darray_add_item(db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER ? folders : files, entry);
+        }
+        first_row = 0;
+    }
+    const bool saved = fsearch_warm_start_save(file_path,
+                                               view->query_text,
+                                               view->filter ? view->filter->name : NULL,
+                                               view->query_flags,
+                                               view->sort_order,
+                                               ascending,
+                                               folders,
+                                               files,
+                                               view->folder_paths,
+                                               first_row,
+                                               max_rows);
     db_view_unlock(view);
+    return saved;
 }
 
 void
@@ -989,5 +1832,5 @@ db_view_unlock(FsearchDatabaseView *view) {
 
 void
 db_view_lock(FsearchDatabaseView *view) {
-    g_mutex_lock(&view->mutex);
+    fsearch_trace_lock(&view->mutex, "db_view_lock wait");
 }
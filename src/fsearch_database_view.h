@@ -5,6 +5,9 @@
 #include "fsearch_filter_manager.h"
 #include "fsearch_query.h"
 #include "fsearch_query_flags.h"
+#include "fsearch_search_latency.h"
+#include "fsearch_selection_export.h"
+#include "fsearch_warm_start.h"
 
 typedef enum {
     DATABASE_VIEW_NOTIFY_CONTENT_CHANGED,
@@ -13,10 +16,25 @@ typedef enum {
     DATABASE_VIEW_NOTIFY_SEARCH_FINISHED,
     DATABASE_VIEW_NOTIFY_SORT_STARTED,
     DATABASE_VIEW_NOTIFY_SORT_FINISHED,
+    // the database finished building one of its sorted arrays in the background
+    DATABASE_VIEW_NOTIFY_INDEX_READY,
 } FsearchDatabaseViewNotify;
 
 typedef struct FsearchDatabaseView FsearchDatabaseView;
 
+// What painting a row needs to know about its entry, see db_view_get_rows
+typedef struct {
+    // only used to tell which entry the row shows, it must not be dereferenced without holding the lock of the view
+    FsearchDatabaseEntry *entry;
+    // the name for display, it's stored in the string chunk passed to db_view_get_rows
+    const char *name;
+    off_t size;
+    time_t mtime;
+    FsearchDatabaseEntryType type;
+    // the index of the parent folder, -1 for the root folder
+    int32_t parent_idx;
+} FsearchDatabaseViewRow;
+
 typedef void (*FsearchDatabaseViewNotifyFunc)(FsearchDatabaseView *view, FsearchDatabaseViewNotify id, gpointer user_data);
 
 void
@@ -38,6 +56,13 @@ db_view_new(const char *query_text,
 void
 db_view_cancel_current_task(FsearchDatabaseView *view);
 
+void
+db_view_refresh(FsearchDatabaseView *view);
+
+// Called by the database whenever it finished building the sorted arrays of sort_type in the background
+void
+db_view_index_ready(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_type);
+
 void
 db_view_set_thread_pool(FsearchDatabaseView *view, FsearchThreadPool *pool);
 
@@ -53,9 +78,52 @@ db_view_set_query_flags(FsearchDatabaseView *view, FsearchQueryFlags query_flags
 void
 db_view_set_query_text(FsearchDatabaseView *view, const char *query_text);
 
+// Returns how many milliseconds to wait for more input before searching for query_text while typing, depending on
+// how long recent searches took
+uint32_t
+db_view_get_search_delay(FsearchDatabaseView *view, const char *query_text);
+
+// The measured latencies of recent searches
+FsearchSearchLatency
+db_view_get_search_latency(FsearchDatabaseView *view);
+
+// How the latest search and sort of view and the latest scan, load and save of its database went
+void
+db_view_get_operation_stats(FsearchDatabaseView *view, FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS]);
+
+// Memory in bytes the results of recent queries may use, so switching back to them doesn't require a search.
+// 0 disables the cache.
+void
+db_view_set_result_cache_size(FsearchDatabaseView *view, size_t size);
+
 void
 db_view_set_sort_order(FsearchDatabaseView *view, FsearchDatabaseIndexType sort_order, GtkSortType sort_type);
 
+// Show the folders and files mixed in the sort order instead of all folders before the files. The orders of the
+// relevance still show the folders first.
+void
+db_view_set_mix_entries(FsearchDatabaseView *view, bool mix_entries);
+
+// The entries [first_idx, first_idx + num_entries) are the visible ones. Long sorts put those in place first and
+// show them while the rest gets sorted.
+void
+db_view_set_visible_rows(FsearchDatabaseView *view, uint32_t first_idx, uint32_t num_entries);
+
+// Adds the memory used by the results, selection and result cache of view to usage. Result arrays which are
+// part of counted_arrays (e.g. because they're sorted arrays of the database) aren't counted again, all others
+// get added to it. Must be called without the database lock, see db_get_memory_usage.
+void
+db_view_get_memory_usage(FsearchDatabaseView *view, FsearchDatabaseMemoryUsage *usage, GHashTable *counted_arrays);
+
+// Fills rows with the entries [start_idx, end_idx) while holding the lock of the view once and returns how many of
+// them exist. The names are copied to names, so they stay valid until names gets cleared.
+uint32_t
+db_view_get_rows(FsearchDatabaseView *view,
+                 uint32_t start_idx,
+                 uint32_t end_idx,
+                 FsearchDatabaseViewRow *rows,
+                 GStringChunk *names);
+
 // NOTE: Getters are not thread save, they need to be wrapped with db_view_lock/db_view_unlock
 uint32_t
 db_view_get_num_folders(FsearchDatabaseView *view);
@@ -148,6 +216,20 @@ db_view_get_num_selected(FsearchDatabaseView *view);
 void
 db_view_selection_for_each(FsearchDatabaseView *view, GHFunc func, gpointer user_data);
 
+// Returns an export of the selected entries, which doesn't need the view anymore, or NULL if nothing is selected
+FsearchSelectionExport *
+db_view_selection_export_new(FsearchDatabaseView *view, FsearchSelectionExportFormat format);
+
+// Shows the rows of warm_start until a database gets registered, if they're the results of the search and order of
+// view, and returns whether it did. They're dropped as soon as either changes.
+bool
+db_view_set_warm_start(FsearchDatabaseView *view, FsearchWarmStart *warm_start);
+
+// Saves the first max_rows rows of view in the order they're shown, see fsearch_warm_start_save. Returns false if
+// the results aren't complete.
+bool
+db_view_save_warm_start(FsearchDatabaseView *view, const char *file_path, uint32_t max_rows);
+
 void
 db_view_unlock(FsearchDatabaseView *view);
 
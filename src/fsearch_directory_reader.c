@@ -0,0 +1,296 @@
+#define G_LOG_DOMAIN "fsearch-directory-reader"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "fsearch_directory_reader.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#if defined(SYS_getdents64)
+#define FSEARCH_DIRECTORY_READER_GETDENTS
+#endif
+#if defined(STATX_TYPE)
+#define FSEARCH_DIRECTORY_READER_STATX
+#endif
+#endif
+
+// Large enough to read most directories with a single syscall
+#define DIRECTORY_READER_BUFFER_SIZE (32 * 1024)
+
+#ifdef FSEARCH_DIRECTORY_READER_GETDENTS
+// Not exported by glibc, see getdents64(2)
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+struct FsearchDirectoryReader {
+    int fd;
+#ifdef FSEARCH_DIRECTORY_READER_GETDENTS
+    char *buffer;
+    long buffer_len;
+    long buffer_pos;
+#else
+    DIR *dir;
+#endif
+    size_t bytes_read;
+    FsearchDirectoryEntry entry;
+};
+
+#ifdef FSEARCH_DIRECTORY_READER_STATX
+// statx might be blocked (e.g. by seccomp filters in sandboxes) or unsupported by the kernel
+static volatile int statx_unsupported = 0;
+#endif
+
+static int
+get_stat_flags(void) {
+    int stat_flags = AT_SYMLINK_NOFOLLOW;
+#ifdef AT_NO_AUTOMOUNT
+    stat_flags |= AT_NO_AUTOMOUNT;
+#endif
+    return stat_flags;
+}
+
+static FsearchDirectoryEntryType
+get_entry_type(unsigned char d_type) {
+#ifdef DT_DIR
+    switch (d_type) {
+    case DT_UNKNOWN:
+        return FSEARCH_DIRECTORY_ENTRY_TYPE_UNKNOWN;
+    case DT_DIR:
+        return FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER;
+    default:
+        return FSEARCH_DIRECTORY_ENTRY_TYPE_FILE;
+    }
+#else
+    return FSEARCH_DIRECTORY_ENTRY_TYPE_UNKNOWN;
+#endif
+}
+
+static bool
+is_dot_or_dot_dot(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+FsearchDirectoryReader *
+fsearch_directory_reader_open(const char *path) {
+    const int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    FsearchDirectoryReader *reader = calloc(1, sizeof(FsearchDirectoryReader));
+    g_assert(reader);
+    reader->fd = fd;
+
+#ifdef FSEARCH_DIRECTORY_READER_GETDENTS
+    reader->buffer = malloc(DIRECTORY_READER_BUFFER_SIZE);
+    g_assert(reader->buffer);
+#else
+    reader->dir = fdopendir(fd);
+    if (!reader->dir) {
+        close(fd);
+        g_clear_pointer(&reader, free);
+        return NULL;
+    }
+#endif
+    return reader;
+}
+
+void
+fsearch_directory_reader_close(FsearchDirectoryReader *reader) {
+    if (!reader) {
+        return;
+    }
+#ifdef FSEARCH_DIRECTORY_READER_GETDENTS
+    g_clear_pointer(&reader->buffer, free);
+    close(reader->fd);
+#else
+    // closes the file descriptor too
+    g_clear_pointer(&reader->dir, closedir);
+#endif
+    g_clear_pointer(&reader, free);
+}
+
+const FsearchDirectoryEntry *
+fsearch_directory_reader_next(FsearchDirectoryReader *reader) {
+    g_assert(reader);
+#ifdef FSEARCH_DIRECTORY_READER_GETDENTS
+    while (true) {
+        if (reader->buffer_pos >= reader->buffer_len) {
+            long res = 0;
+            do {
+                res = syscall(SYS_getdents64, reader->fd, reader->buffer, DIRECTORY_READER_BUFFER_SIZE);
+            } while (res < 0 && errno == EINTR);
+            if (res <= 0) {
+                return NULL;
+            }
+            reader->buffer_len = res;
+            reader->buffer_pos = 0;
+            reader->bytes_read += (size_t)res;
+        }
+        struct linux_dirent64 *dent = (struct linux_dirent64 *)(reader->buffer + reader->buffer_pos);
+        reader->buffer_pos += dent->d_reclen;
+        if (is_dot_or_dot_dot(dent->d_name)) {
+            continue;
+        }
+        reader->entry.name = dent->d_name;
+        reader->entry.name_len = strlen(dent->d_name);
+        reader->entry.type = get_entry_type(dent->d_type);
+        return &reader->entry;
+    }
+#else
+    struct dirent *dent = NULL;
+    while ((dent = readdir(reader->dir))) {
+        const size_t name_len = strlen(dent->d_name);
+        reader->bytes_read += offsetof(struct dirent, d_name) + name_len + 1;
+        if (is_dot_or_dot_dot(dent->d_name)) {
+            continue;
+        }
+        reader->entry.name = dent->d_name;
+        reader->entry.name_len = name_len;
+#ifdef DT_DIR
+        reader->entry.type = get_entry_type(dent->d_type);
+#else
+        reader->entry.type = FSEARCH_DIRECTORY_ENTRY_TYPE_UNKNOWN;
+#endif
+        return &reader->entry;
+    }
+    return NULL;
+#endif
+}
+
+#ifdef FSEARCH_DIRECTORY_READER_STATX
+// Returns 0 if the time wasn't requested or the filesystem doesn't report it, e.g. the creation time
+static time_t
+statx_get_time(const struct statx *stx, unsigned int requested, const struct statx_timestamp *timestamp) {
+    return requested && (stx->stx_mask & requested) ? (time_t)timestamp->tv_sec : 0;
+}
+
+static int
+directory_statx(int dir_fd,
+                const char *name,
+                FsearchDirectoryEntryType type,
+                FsearchDirectoryStatFields fields,
+                FsearchDirectoryEntryStat *st) {
+    // Only request what the database stores: the size of folders isn't needed, it's computed
+    // from their children. Unless FSEARCH_DIRECTORY_STAT_SYNC is set, AT_STATX_DONT_SYNC allows network
+    // filesystems to answer from their attribute cache instead of doing a round trip to the server for every entry.
+    unsigned int mask = STATX_TYPE | STATX_MTIME;
+    if (type != FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER) {
+        mask |= STATX_SIZE;
+    }
+    if (fields & FSEARCH_DIRECTORY_STAT_ACCESS_TIME) {
+        mask |= STATX_ATIME;
+    }
+    if (fields & FSEARCH_DIRECTORY_STAT_CREATION_TIME) {
+        mask |= STATX_BTIME;
+    }
+    if (fields & (FSEARCH_DIRECTORY_STAT_STATUS_CHANGE_TIME | FSEARCH_DIRECTORY_STAT_IDENTITY)) {
+        mask |= STATX_CTIME;
+    }
+    if (fields & FSEARCH_DIRECTORY_STAT_IDENTITY) {
+        mask |= STATX_INO;
+    }
+    if (fields & FSEARCH_DIRECTORY_STAT_OWNER) {
+        mask |= STATX_MODE | STATX_UID | STATX_GID;
+    }
+    const int sync_flag = (fields & FSEARCH_DIRECTORY_STAT_SYNC) ? AT_STATX_SYNC_AS_STAT : AT_STATX_DONT_SYNC;
+    struct statx stx;
+    if (statx(dir_fd, name, get_stat_flags() | sync_flag, mask, &stx)) {
+        return errno;
+    }
+    st->is_folder = S_ISDIR(stx.stx_mode);
+    st->size = st->is_folder ? 0 : (off_t)stx.stx_size;
+    st->mtime = stx.stx_mtime.tv_sec;
+    st->atime = statx_get_time(&stx, mask & STATX_ATIME, &stx.stx_atime);
+    st->btime = statx_get_time(&stx, mask & STATX_BTIME, &stx.stx_btime);
+    st->ctime = statx_get_time(&stx, mask & STATX_CTIME, &stx.stx_ctime);
+    const bool has_owner = (mask & STATX_UID) != 0;
+    st->uid = has_owner ? stx.stx_uid : 0;
+    st->gid = has_owner ? stx.stx_gid : 0;
+    st->mode = has_owner ? stx.stx_mode : 0;
+    st->device_id = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    st->inode = (mask & STATX_INO) && (stx.stx_mask & STATX_INO) ? (ino_t)stx.stx_ino : 0;
+    return 0;
+}
+#endif
+
+static bool
+directory_stat(int dir_fd,
+               const char *name,
+               FsearchDirectoryEntryType type,
+               FsearchDirectoryStatFields fields,
+               FsearchDirectoryEntryStat *st) {
+#ifdef FSEARCH_DIRECTORY_READER_STATX
+    if (!g_atomic_int_get(&statx_unsupported)) {
+        const int res = directory_statx(dir_fd, name, type, fields, st);
+        if (res != ENOSYS && res != EPERM) {
+            return res == 0;
+        }
+        g_debug("statx isn't available, falling back to fstatat");
+        g_atomic_int_set(&statx_unsupported, 1);
+    }
+#endif
+
+    // fstatat always behaves like FSEARCH_DIRECTORY_STAT_SYNC
+    struct stat s;
+    if (fstatat(dir_fd, name, &s, get_stat_flags())) {
+        return false;
+    }
+    st->is_folder = S_ISDIR(s.st_mode);
+    st->size = st->is_folder ? 0 : s.st_size;
+    st->mtime = s.st_mtime;
+    // the creation time isn't part of struct stat
+    st->atime = (fields & FSEARCH_DIRECTORY_STAT_ACCESS_TIME) ? s.st_atime : 0;
+    st->btime = 0;
+    st->ctime = (fields & (FSEARCH_DIRECTORY_STAT_STATUS_CHANGE_TIME | FSEARCH_DIRECTORY_STAT_IDENTITY)) ? s.st_ctime : 0;
+    const bool has_owner = (fields & FSEARCH_DIRECTORY_STAT_OWNER) != 0;
+    st->uid = has_owner ? s.st_uid : 0;
+    st->gid = has_owner ? s.st_gid : 0;
+    st->mode = has_owner ? s.st_mode : 0;
+    st->device_id = s.st_dev;
+    st->inode = (fields & FSEARCH_DIRECTORY_STAT_IDENTITY) ? s.st_ino : 0;
+    return true;
+}
+
+size_t
+fsearch_directory_reader_get_bytes_read(FsearchDirectoryReader *reader) {
+    g_assert(reader);
+    return reader->bytes_read;
+}
+
+bool
+fsearch_directory_reader_stat(FsearchDirectoryReader *reader,
+                              const FsearchDirectoryEntry *entry,
+                              FsearchDirectoryStatFields fields,
+                              FsearchDirectoryEntryStat *st) {
+    g_assert(reader);
+    g_assert(entry);
+    g_assert(st);
+    return directory_stat(reader->fd, entry->name, entry->type, fields, st);
+}
+
+bool
+fsearch_directory_stat_path(const char *path, FsearchDirectoryStatFields fields, FsearchDirectoryEntryStat *st) {
+    g_assert(path);
+    g_assert(st);
+    return directory_stat(AT_FDCWD, path, FSEARCH_DIRECTORY_ENTRY_TYPE_UNKNOWN, fields, st);
+}
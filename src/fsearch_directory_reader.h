@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Reads the entries of a single directory. On Linux the entries are fetched in large batches with
+// getdents64 and only the attributes the database needs are requested with statx. Other platforms
+// use readdir and fstatat.
+typedef struct FsearchDirectoryReader FsearchDirectoryReader;
+
+typedef enum {
+    // the filesystem doesn't report the type, it's only known after a stat call
+    FSEARCH_DIRECTORY_ENTRY_TYPE_UNKNOWN,
+    FSEARCH_DIRECTORY_ENTRY_TYPE_FOLDER,
+    // everything which isn't a folder (regular files, symlinks, sockets, ...)
+    FSEARCH_DIRECTORY_ENTRY_TYPE_FILE,
+} FsearchDirectoryEntryType;
+
+typedef struct {
+    const char *name;
+    size_t name_len;
+    FsearchDirectoryEntryType type;
+} FsearchDirectoryEntry;
+
+// What fsearch_directory_reader_stat gets apart from the type, size and modification time
+typedef enum {
+    FSEARCH_DIRECTORY_STAT_ACCESS_TIME = 1 << 0,
+    FSEARCH_DIRECTORY_STAT_CREATION_TIME = 1 << 1,
+    FSEARCH_DIRECTORY_STAT_STATUS_CHANGE_TIME = 1 << 2,
+    // uid, gid and mode
+    FSEARCH_DIRECTORY_STAT_OWNER = 1 << 3,
+    // the inode and the status change time (even without FSEARCH_DIRECTORY_STAT_STATUS_CHANGE_TIME), which tell
+    // whether a folder was replaced or changed in place
+    FSEARCH_DIRECTORY_STAT_IDENTITY = 1 << 4,
+    // Not a field: network filesystems (e.g. NFS) have to ask the server instead of answering from their attribute
+    // cache. Stats which decide whether a folder gets read again need it, because a cached modification time would
+    // skip changed folders. The attributes of the entries of a folder which is read anyway may be cached.
+    FSEARCH_DIRECTORY_STAT_SYNC = 1 << 5,
+} FsearchDirectoryStatFields;
+
+typedef struct {
+    bool is_folder;
+    // size is only set for files, folder sizes are accumulated from their children
+    off_t size;
+    time_t mtime;
+    // only set if they were requested, otherwise 0. btime is also 0 if the filesystem doesn't report it.
+    time_t atime;
+    time_t btime;
+    time_t ctime;
+    // only set if FSEARCH_DIRECTORY_STAT_OWNER was requested, otherwise 0
+    uid_t uid;
+    gid_t gid;
+    mode_t mode;
+    dev_t device_id;
+    // only set if FSEARCH_DIRECTORY_STAT_IDENTITY was requested, otherwise 0
+    ino_t inode;
+} FsearchDirectoryEntryStat;
+
+// Returns NULL if the directory can't be opened. The entries "." and ".." are never returned.
+FsearchDirectoryReader *
+fsearch_directory_reader_open(const char *path);
+
+void
+fsearch_directory_reader_close(FsearchDirectoryReader *reader);
+
+// The returned entry is only valid until the next call.
+const FsearchDirectoryEntry *
+fsearch_directory_reader_next(FsearchDirectoryReader *reader);
+
+// Returns how many bytes of directory entries were read so far
+size_t
+fsearch_directory_reader_get_bytes_read(FsearchDirectoryReader *reader);
+
+bool
+fsearch_directory_reader_stat(FsearchDirectoryReader *reader,
+                              const FsearchDirectoryEntry *entry,
+                              FsearchDirectoryStatFields fields,
+                              FsearchDirectoryEntryStat *st);
+
+// Like fsearch_directory_reader_stat, for a single path which isn't read from a directory
+bool
+fsearch_directory_stat_path(const char *path, FsearchDirectoryStatFields fields, FsearchDirectoryEntryStat *st);
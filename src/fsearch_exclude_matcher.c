@@ -0,0 +1,243 @@
+#define G_LOG_DOMAIN "fsearch-exclude-matcher"
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+#include "fsearch_exclude_matcher.h"
+#include "fsearch_exclude_path.h"
+#include "fsearch_string_utils.h"
+
+#include <fnmatch.h>
+#include <pcre2.h>
+#include <stdlib.h>
+#include <string.h>
+
+// file names longer than this are never indexed
+#define EXCLUDE_MATCHER_MAX_NAME_LEN 256
+
+struct FsearchExcludeMatcher {
+    // maps folder paths to whether they're excluded
+    GHashTable *paths;
+
+    bool match_all;
+    // patterns without wildcards
+    GHashTable *names;
+    // patterns of the form "*literal", only the literal part is stored
+    GHashTable *suffixes;
+    GArray *suffix_lengths;
+    // patterns of the form "literal*", only the literal part is stored
+    GHashTable *prefixes;
+    GArray *prefix_lengths;
+    // all other patterns which only use '*' and '?' are combined into a single regex
+    pcre2_code *regex;
+    // patterns which need the full fnmatch semantics (bracket expressions and escapes)
+    GPtrArray *globs;
+};
+
+static GPrivate match_data_private = G_PRIVATE_INIT((GDestroyNotify)pcre2_match_data_free);
+
+static bool
+has_wildcards(const char *pattern, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        switch (pattern[i]) {
+        case '*':
+        case '?':
+        case '[':
+        case '\\':
+            return true;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+static bool
+can_be_converted_to_regex(const char *pattern) {
+    if (strpbrk(pattern, "[\\")) {
+        return false;
+    }
+#ifndef PCRE2_MATCH_INVALID_UTF
+    // without support for invalid UTF-8 the regex works on bytes, so '?' would only match
+    // a single byte instead of a multibyte character like fnmatch does
+    if (strchr(pattern, '?')) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void
+add_length(GArray *lengths, size_t len) {
+    for (uint32_t i = 0; i < lengths->len; i++) {
+        if (g_array_index(lengths, size_t, i) == len) {
+            return;
+        }
+    }
+    g_array_append_val(lengths, len);
+}
+
+static pcre2_code *
+compile_regex(GString *expression) {
+    uint32_t options = PCRE2_DOTALL | PCRE2_DOLLAR_ENDONLY;
+#ifdef PCRE2_MATCH_INVALID_UTF
+    options |= PCRE2_UTF | PCRE2_MATCH_INVALID_UTF;
+#endif
+    int error_code = 0;
+    PCRE2_SIZE error_offset = 0;
+    pcre2_code *regex =
+        pcre2_compile((PCRE2_SPTR)expression->str, expression->len, options, &error_code, &error_offset, NULL);
+    if (!regex) {
+        PCRE2_UCHAR buffer[256] = "";
+        pcre2_get_error_message(error_code, buffer, sizeof(buffer));
+        g_debug("PCRE2 compilation failed at offset %d: %s", (int)error_offset, buffer);
+        return NULL;
+    }
+    if (pcre2_jit_compile(regex, PCRE2_JIT_COMPLETE) != 0) {
+        g_debug("JIT compilation failed");
+    }
+    return regex;
+}
+
+static void
+add_pattern(FsearchExcludeMatcher *matcher, const char *pattern, GString *regex_expression, GPtrArray *regex_patterns) {
+    const size_t len = strlen(pattern);
+    if (!has_wildcards(pattern, len)) {
+        g_hash_table_add(matcher->names, g_strdup(pattern));
+    }
+    else if (!strcmp(pattern, "*")) {
+        matcher->match_all = true;
+    }
+    else if (pattern[0] == '*' && !has_wildcards(pattern + 1, len - 1)) {
+        g_hash_table_add(matcher->suffixes, g_strdup(pattern + 1));
+        add_length(matcher->suffix_lengths, len - 1);
+    }
+    else if (pattern[len - 1] == '*' && !has_wildcards(pattern, len - 1)) {
+        g_hash_table_add(matcher->prefixes, g_strndup(pattern, len - 1));
+        add_length(matcher->prefix_lengths, len - 1);
+    }
+    else if (can_be_converted_to_regex(pattern)) {
+        g_autofree char *expression = fsearch_string_convert_wildcard_to_regex_expression(pattern);
+        if (regex_expression->len > 0) {
+            g_string_append_c(regex_expression, '|');
+        }
+        g_string_append_printf(regex_expression, "(?:%s)", expression);
+        g_ptr_array_add(regex_patterns, (gpointer)pattern);
+    }
+    else {
+        g_ptr_array_add(matcher->globs, g_strdup(pattern));
+    }
+}
+
+FsearchExcludeMatcher *
+fsearch_exclude_matcher_new(GList *exclude_paths, char **exclude_files) {
+    FsearchExcludeMatcher *matcher = calloc(1, sizeof(FsearchExcludeMatcher));
+    g_assert(matcher);
+
+    matcher->paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (GList *l = exclude_paths; l != NULL; l = l->next) {
+        FsearchExcludePath *fs_path = l->data;
+        // the first entry for a path determines whether it's excluded
+        if (fs_path->path && !g_hash_table_contains(matcher->paths, fs_path->path)) {
+            g_hash_table_insert(matcher->paths, g_strdup(fs_path->path), GINT_TO_POINTER(fs_path->enabled));
+        }
+    }
+
+    matcher->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    matcher->suffixes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    matcher->prefixes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    matcher->suffix_lengths = g_array_new(FALSE, FALSE, sizeof(size_t));
+    matcher->prefix_lengths = g_array_new(FALSE, FALSE, sizeof(size_t));
+    matcher->globs = g_ptr_array_new_with_free_func(g_free);
+
+    g_autoptr(GString) regex_expression = g_string_new(NULL);
+    g_autoptr(GPtrArray) regex_patterns = g_ptr_array_new();
+    for (uint32_t i = 0; exclude_files && exclude_files[i]; i++) {
+        add_pattern(matcher, exclude_files[i], regex_expression, regex_patterns);
+    }
+    if (regex_expression->len > 0) {
+        matcher->regex = compile_regex(regex_expression);
+        if (!matcher->regex) {
+            // fall back to matching those patterns one by one
+            for (uint32_t i = 0; i < regex_patterns->len; i++) {
+                g_ptr_array_add(matcher->globs, g_strdup(g_ptr_array_index(regex_patterns, i)));
+            }
+        }
+    }
+
+    return matcher;
+}
+
+void
+fsearch_exclude_matcher_free(FsearchExcludeMatcher *matcher) {
+    if (!matcher) {
+        return;
+    }
+    g_clear_pointer(&matcher->paths, g_hash_table_unref);
+    g_clear_pointer(&matcher->names, g_hash_table_unref);
+    g_clear_pointer(&matcher->suffixes, g_hash_table_unref);
+    g_clear_pointer(&matcher->prefixes, g_hash_table_unref);
+    g_clear_pointer(&matcher->suffix_lengths, g_array_unref);
+    g_clear_pointer(&matcher->prefix_lengths, g_array_unref);
+    g_clear_pointer(&matcher->regex, pcre2_code_free);
+    g_clear_pointer(&matcher->globs, g_ptr_array_unref);
+    g_clear_pointer(&matcher, free);
+}
+
+static bool
+regex_matches(pcre2_code *regex, const char *name, size_t name_len) {
+    pcre2_match_data *match_data = g_private_get(&match_data_private);
+    if (!match_data) {
+        match_data = pcre2_match_data_create(1, NULL);
+        g_private_set(&match_data_private, match_data);
+    }
+    return pcre2_match(regex, (PCRE2_SPTR)name, name_len, 0, 0, match_data, NULL) >= 0;
+}
+
+bool
+fsearch_exclude_matcher_file_is_excluded(FsearchExcludeMatcher *matcher, const char *name, size_t name_len) {
+    g_assert(matcher);
+    g_assert(name);
+
+    if (matcher->match_all) {
+        return true;
+    }
+    if (g_hash_table_size(matcher->names) > 0 && g_hash_table_contains(matcher->names, name)) {
+        return true;
+    }
+    for (uint32_t i = 0; i < matcher->suffix_lengths->len; i++) {
+        const size_t len = g_array_index(matcher->suffix_lengths, size_t, i);
+        if (len <= name_len && g_hash_table_contains(matcher->suffixes, name + name_len - len)) {
+            return true;
+        }
+    }
+    if (matcher->prefix_lengths->len > 0 && name_len < EXCLUDE_MATCHER_MAX_NAME_LEN) {
+        char prefix[EXCLUDE_MATCHER_MAX_NAME_LEN];
+        for (uint32_t i = 0; i < matcher->prefix_lengths->len; i++) {
+            const size_t len = g_array_index(matcher->prefix_lengths, size_t, i);
+            if (len > name_len) {
+                continue;
+            }
+            memcpy(prefix, name, len);
+            prefix[len] = '\0';
+            if (g_hash_table_contains(matcher->prefixes, prefix)) {
+                return true;
+            }
+        }
+    }
+    if (matcher->regex && regex_matches(matcher->regex, name, name_len)) {
+        return true;
+    }
+    for (uint32_t i = 0; i < matcher->globs->len; i++) {
+        if (!fnmatch(g_ptr_array_index(matcher->globs, i), name, 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+fsearch_exclude_matcher_path_is_excluded(FsearchExcludeMatcher *matcher, const char *path) {
+    g_assert(matcher);
+    g_assert(path);
+    return GPOINTER_TO_INT(g_hash_table_lookup(matcher->paths, path));
+}
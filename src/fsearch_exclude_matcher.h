@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Checks file names against a set of fnmatch patterns and paths against a list of excluded
+// folders. Everything is compiled once when the matcher is created. Afterwards the matcher
+// is read-only, so it can be shared by multiple scan threads.
+typedef struct FsearchExcludeMatcher FsearchExcludeMatcher;
+
+FsearchExcludeMatcher *
+fsearch_exclude_matcher_new(GList *exclude_paths, char **exclude_files);
+
+void
+fsearch_exclude_matcher_free(FsearchExcludeMatcher *matcher);
+
+bool
+fsearch_exclude_matcher_file_is_excluded(FsearchExcludeMatcher *matcher, const char *name, size_t name_len);
+
+bool
+fsearch_exclude_matcher_path_is_excluded(FsearchExcludeMatcher *matcher, const char *path);
@@ -0,0 +1,319 @@
+#define G_LOG_DOMAIN "fsearch-federation"
+
+#include "fsearch_federation.h"
+#include "fsearch_string_utils.h"
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __MACH__
+#include "strverscmp.h"
+#endif
+
+// a source which is that much ahead of the others has to wait until they caught up
+#define MERGER_MAX_WAITING_ROWS (64 * 1024)
+
+FsearchFederationSource *
+fsearch_federation_source_new(const char *name, const char *location) {
+    g_assert(name);
+    g_assert(location);
+    FsearchFederationSource *source = calloc(1, sizeof(FsearchFederationSource));
+    g_assert(source);
+    source->name = g_strdup(name);
+    source->location = g_strdup(location);
+    return source;
+}
+
+FsearchFederationSource *
+fsearch_federation_source_copy(FsearchFederationSource *source) {
+    g_assert(source);
+    return fsearch_federation_source_new(source->name, source->location);
+}
+
+void
+fsearch_federation_source_free(FsearchFederationSource *source) {
+    if (!source) {
+        return;
+    }
+    g_clear_pointer(&source->name, g_free);
+    g_clear_pointer(&source->location, g_free);
+    g_clear_pointer(&source, free);
+}
+
+bool
+fsearch_federation_source_equal(FsearchFederationSource *source_1, FsearchFederationSource *source_2) {
+    return !g_strcmp0(source_1->name, source_2->name) && !g_strcmp0(source_1->location, source_2->location);
+}
+
+bool
+fsearch_federation_source_is_remote(FsearchFederationSource *source) {
+    g_assert(source);
+    // database files are given by their absolute path, addresses start with their transport, e.g. unix: or tcp:
+    return source->location[0] != '/' && g_dbus_is_address(source->location);
+}
+
+typedef struct {
+    // the rows from head on are waiting to be merged
+    GArray *rows;
+    uint32_t head;
+    bool finished;
+} MergerQueue;
+
+struct FsearchFederationMerger {
+    MergerQueue *queues;
+    uint32_t num_sources;
+    FsearchDatabaseIndexType sort_order;
+    bool cancelled;
+
+    GMutex mutex;
+    // signalled whenever rows were pushed or popped, a source finished or the merger was cancelled
+    GCond cond;
+};
+
+static void
+row_clear(FsearchFederationRow *row) {
+    g_clear_pointer(&row->path, g_free);
+}
+
+FsearchFederationMerger *
+fsearch_federation_merger_new(uint32_t num_sources, FsearchDatabaseIndexType sort_order) {
+    FsearchFederationMerger *merger = calloc(1, sizeof(FsearchFederationMerger));
+    g_assert(merger);
+    merger->queues = calloc(MAX(num_sources, 1), sizeof(MergerQueue));
+    g_assert(merger->queues);
+    for (uint32_t i = 0; i < num_sources; i++) {
+        merger->queues[i].rows = g_array_new(FALSE, FALSE, sizeof(FsearchFederationRow));
+        g_array_set_clear_func(merger->queues[i].rows, (GDestroyNotify)row_clear);
+    }
+    merger->num_sources = num_sources;
+    merger->sort_order = sort_order;
+    g_mutex_init(&merger->mutex);
+    g_cond_init(&merger->cond);
+    return merger;
+}
+
+void
+fsearch_federation_merger_free(FsearchFederationMerger *merger) {
+    if (!merger) {
+        return;
+    }
+    for (uint32_t i = 0; i < merger->num_sources; i++) {
+        g_clear_pointer(&merger->queues[i].rows, g_array_unref);
+    }
+    g_clear_pointer(&merger->queues, free);
+    g_mutex_clear(&merger->mutex);
+    g_cond_clear(&merger->cond);
+    g_clear_pointer(&merger, free);
+}
+
+static uint32_t
+queue_get_num_waiting(MergerQueue *queue) {
+    return queue->rows->len - queue->head;
+}
+
+bool
+fsearch_federation_merger_push(FsearchFederationMerger *merger,
+                               uint32_t source,
+                               FsearchFederationRow *rows,
+                               uint32_t num_rows) {
+    g_assert(merger);
+    g_assert(source < merger->num_sources);
+
+    g_mutex_lock(&merger->mutex);
+    MergerQueue *queue = &merger->queues[source];
+    while (!merger->cancelled && queue_get_num_waiting(queue) >= MERGER_MAX_WAITING_ROWS) {
+        g_cond_wait(&merger->cond, &merger->mutex);
+    }
+    const bool cancelled = merger->cancelled;
+    if (!cancelled) {
+        if (queue->head > 0 && queue->head == queue->rows->len) {
+            // the paths of the popped rows belong to the caller of pop and were reset already
+            g_array_set_size(queue->rows, 0);
+            queue->head = 0;
+        }
+        g_array_append_vals(queue->rows, rows, num_rows);
+        g_cond_broadcast(&merger->cond);
+    }
+    g_mutex_unlock(&merger->mutex);
+
+    if (cancelled) {
+        for (uint32_t i = 0; i < num_rows; i++) {
+            row_clear(&rows[i]);
+        }
+    }
+    return !cancelled;
+}
+
+void
+fsearch_federation_merger_finish(FsearchFederationMerger *merger, uint32_t source) {
+    g_assert(merger);
+    g_assert(source < merger->num_sources);
+
+    g_mutex_lock(&merger->mutex);
+    merger->queues[source].finished = true;
+    g_cond_broadcast(&merger->cond);
+    g_mutex_unlock(&merger->mutex);
+}
+
+void
+fsearch_federation_merger_cancel(FsearchFederationMerger *merger) {
+    g_assert(merger);
+
+    g_mutex_lock(&merger->mutex);
+    merger->cancelled = true;
+    g_cond_broadcast(&merger->cond);
+    g_mutex_unlock(&merger->mutex);
+}
+
+static const char *
+get_name(const char *path) {
+    const char *name = strrchr(path, '/');
+    return name ? name + 1 : path;
+}
+
+static const char *
+get_extension(const FsearchFederationRow *row) {
+    // like db_entry_get_extension, folders don't have one
+    const char *ext = row->is_folder ? NULL : fsearch_string_get_extension(get_name(row->path));
+    return ext ? ext : "";
+}
+
+static int
+compare_components(const char *a, size_t a_len, const char *b, size_t b_len) {
+    g_autofree char *a_copy = g_strndup(a, a_len);
+    g_autofree char *b_copy = g_strndup(b, b_len);
+    return strverscmp(a_copy, b_copy);
+}
+
+static const char *
+get_component_end(const char *component) {
+    const char *end = strchr(component, '/');
+    return end ? end : component + strlen(component);
+}
+
+static uint32_t
+get_num_components(const char *path) {
+    uint32_t num_components = 1;
+    for (const char *c = path; *c; c++) {
+        num_components += *c == '/';
+    }
+    return num_components;
+}
+
+// Compares the first num_components components of the paths one by one
+static int
+compare_path_prefixes(const char *a, const char *b, uint32_t num_components) {
+    for (uint32_t i = 0; i < num_components; i++) {
+        const char *a_end = get_component_end(a);
+        const char *b_end = get_component_end(b);
+        const int res = compare_components(a, a_end - a, b, b_end - b);
+        if (res != 0 || !*a_end || !*b_end) {
+            return res;
+        }
+        a = a_end + 1;
+        b = b_end + 1;
+    }
+    return 0;
+}
+
+// The same order as db_entry_compare_entries_by_path: entries in folders of the same depth are ordered by the paths
+// of their folders and then by their names. Otherwise the folders are compared at the depth of the shallower one and
+// the entry whose folder is deeper comes last if they're the same.
+static int
+compare_paths(const char *a, const char *b) {
+    const uint32_t a_depth = get_num_components(a);
+    const uint32_t b_depth = get_num_components(b);
+    if (a_depth == b_depth) {
+        return compare_path_prefixes(a, b, a_depth);
+    }
+    const int res = compare_path_prefixes(a, b, MIN(a_depth, b_depth) - 1);
+    if (res != 0) {
+        return res;
+    }
+    return a_depth > b_depth ? 1 : -1;
+}
+
+static int
+compare_rows(FsearchFederationMerger *merger, const FsearchFederationRow *a, const FsearchFederationRow *b) {
+    if (a->is_folder != b->is_folder) {
+        return a->is_folder ? -1 : 1;
+    }
+    switch (merger->sort_order) {
+    case DATABASE_INDEX_TYPE_NAME:
+        return strverscmp(get_name(a->path), get_name(b->path));
+    case DATABASE_INDEX_TYPE_PATH:
+        return compare_paths(a->path, b->path);
+    case DATABASE_INDEX_TYPE_EXTENSION:
+        return strcmp(get_extension(a), get_extension(b));
+    case DATABASE_INDEX_TYPE_SIZE:
+    case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+    case DATABASE_INDEX_TYPE_ACCESS_TIME:
+    case DATABASE_INDEX_TYPE_CREATION_TIME:
+    case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+    case DATABASE_INDEX_TYPE_OWNER:
+        return a->key < b->key ? -1 : a->key > b->key;
+    default:
+        // e.g. the file type, which only the sources can compute, or the relevance
+        return 0;
+    }
+}
+
+bool
+fsearch_federation_merger_pop(FsearchFederationMerger *merger, FsearchFederationRow *row, uint32_t *source) {
+    g_assert(merger);
+    g_assert(row);
+
+    g_mutex_lock(&merger->mutex);
+    while (true) {
+        if (merger->cancelled) {
+            break;
+        }
+        // rows can only be merged once every source which didn't finish has one waiting
+        int32_t min_source = -1;
+        bool waiting = false;
+        for (uint32_t i = 0; i < merger->num_sources; i++) {
+            MergerQueue *queue = &merger->queues[i];
+            if (queue_get_num_waiting(queue) == 0) {
+                if (!queue->finished) {
+                    waiting = true;
+                    break;
+                }
+                continue;
+            }
+            const FsearchFederationRow *head = &g_array_index(queue->rows, FsearchFederationRow, queue->head);
+            if (min_source < 0) {
+                min_source = (int32_t)i;
+                continue;
+            }
+            MergerQueue *min_queue = &merger->queues[min_source];
+            const FsearchFederationRow *min_head =
+                &g_array_index(min_queue->rows, FsearchFederationRow, min_queue->head);
+            if (compare_rows(merger, head, min_head) < 0) {
+                min_source = (int32_t)i;
+            }
+        }
+        if (waiting) {
+            g_cond_wait(&merger->cond, &merger->mutex);
+            continue;
+        }
+        if (min_source < 0) {
+            // every source finished and all of their rows were taken
+            break;
+        }
+
+        MergerQueue *queue = &merger->queues[min_source];
+        FsearchFederationRow *head = &g_array_index(queue->rows, FsearchFederationRow, queue->head);
+        *row = *head;
+        head->path = NULL;
+        queue->head++;
+        if (source) {
+            *source = (uint32_t)min_source;
+        }
+        g_cond_broadcast(&merger->cond);
+        g_mutex_unlock(&merger->mutex);
+        return true;
+    }
+    g_mutex_unlock(&merger->mutex);
+    return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_database_index.h"
+
+// A database which gets searched together with the local one by fsearch --print. Its location is either the path of
+// a database file (e.g. one which was synced from another machine), which gets loaded read-only, or the D-Bus address
+// an fsearchd on another machine accepts searches on (see remote_search_address). Its results are tagged with name.
+typedef struct {
+    char *name;
+    char *location;
+} FsearchFederationSource;
+
+FsearchFederationSource *
+fsearch_federation_source_new(const char *name, const char *location);
+
+FsearchFederationSource *
+fsearch_federation_source_copy(FsearchFederationSource *source);
+
+void
+fsearch_federation_source_free(FsearchFederationSource *source);
+
+bool
+fsearch_federation_source_equal(FsearchFederationSource *source_1, FsearchFederationSource *source_2);
+
+// Whether the source is searched by an fsearchd it connects to, instead of a database file which is loaded
+bool
+fsearch_federation_source_is_remote(FsearchFederationSource *source);
+
+// A result of one of the sources
+typedef struct {
+    char *path;
+    // for numeric sort orders the sort key of the entry (e.g. db_entry_get_size_sort_key), 0 otherwise
+    uint64_t key;
+    bool is_folder;
+} FsearchFederationRow;
+
+// Merges the results of several sources, which arrive sorted by the same sort order (folders first) from their own
+// threads, into one sorted stream. Rows of sort orders which can't be compared across sources (e.g. by relevance)
+// keep the order of their source, rows of the first source come first then.
+typedef struct FsearchFederationMerger FsearchFederationMerger;
+
+FsearchFederationMerger *
+fsearch_federation_merger_new(uint32_t num_sources, FsearchDatabaseIndexType sort_order);
+
+void
+fsearch_federation_merger_free(FsearchFederationMerger *merger);
+
+// Takes over the rows and their paths. Blocks while too many rows of the source are waiting to be merged.
+// Returns false once the merger was cancelled, the rows are freed then.
+bool
+fsearch_federation_merger_push(FsearchFederationMerger *merger,
+                               uint32_t source,
+                               FsearchFederationRow *rows,
+                               uint32_t num_rows);
+
+// The source won't push any more rows
+void
+fsearch_federation_merger_finish(FsearchFederationMerger *merger, uint32_t source);
+
+// Wakes up everyone who waits for the merger, no more rows get pushed or popped
+void
+fsearch_federation_merger_cancel(FsearchFederationMerger *merger);
+
+// Waits until the next row is known, i.e. every source which didn't finish yet pushed one. The path of row belongs to
+// the caller then. Returns false once all rows were popped or the merger was cancelled.
+bool
+fsearch_federation_merger_pop(FsearchFederationMerger *merger, FsearchFederationRow *row, uint32_t *source);
@@ -0,0 +1,216 @@
+#define G_LOG_DOMAIN "fsearch-file-operation"
+
+#include "fsearch_file_operation.h"
+#include "fsearch_file_utils.h"
+#include "fsearch_thread_pool.h"
+#include "fsearch_trace.h"
+
+#include <stdlib.h>
+
+// in µs
+#define FILE_OPERATION_PROGRESS_INTERVAL (200 * 1000)
+
+typedef struct {
+    FsearchFileOperationType type;
+    GPtrArray *paths;
+    FsearchDatabase *db;
+    uint32_t num_threads;
+    FsearchFileOperationProgressFunc progress_func;
+    gpointer progress_data;
+
+    // the next path a worker takes and how many were processed
+    volatile gint next_path;
+    volatile gint num_processed;
+    // protects last_progress_time
+    GMutex progress_mutex;
+    int64_t last_progress_time;
+
+    // the results, set before the task returns
+    uint32_t num_removed;
+    GString *error_messages;
+    bool database_updated;
+} FileOperation;
+
+typedef struct {
+    FileOperation *op;
+    GTask *task;
+    GCancellable *cancellable;
+    // the paths this worker removed, owned by op->paths
+    GPtrArray *removed;
+    GString *error_messages;
+} FileOperationWorker;
+
+typedef struct {
+    GTask *task;
+    uint32_t num_processed;
+} FileOperationProgress;
+
+static void
+file_operation_free(FileOperation *op) {
+    if (!op) {
+        return;
+    }
+    g_clear_pointer(&op->paths, g_ptr_array_unref);
+    g_clear_pointer(&op->db, db_unref);
+    if (op->error_messages) {
+        g_string_free(g_steal_pointer(&op->error_messages), TRUE);
+    }
+    g_mutex_clear(&op->progress_mutex);
+    g_clear_pointer(&op, free);
+}
+
+static void
+file_operation_progress_free(FileOperationProgress *progress) {
+    if (!progress) {
+        return;
+    }
+    g_clear_object(&progress->task);
+    g_clear_pointer(&progress, free);
+}
+
+static gboolean
+file_operation_progress_cb(gpointer user_data) {
+    FileOperationProgress *progress = user_data;
+    // the caller might be gone once it got the result
+    if (!g_task_get_completed(progress->task)) {
+        FileOperation *op = g_task_get_task_data(progress->task);
+        op->progress_func(progress->num_processed, op->paths->len, op->progress_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+file_operation_report_progress(FileOperation *op, GTask *task, uint32_t num_processed) {
+    if (!op->progress_func) {
+        return;
+    }
+    const int64_t now = g_get_monotonic_time();
+    g_mutex_lock(&op->progress_mutex);
+    const bool report = now - op->last_progress_time >= FILE_OPERATION_PROGRESS_INTERVAL;
+    if (report) {
+        op->last_progress_time = now;
+    }
+    g_mutex_unlock(&op->progress_mutex);
+    if (!report) {
+        return;
+    }
+
+    FileOperationProgress *progress = calloc(1, sizeof(FileOperationProgress));
+    g_assert(progress);
+    progress->task = g_object_ref(task);
+    progress->num_processed = num_processed;
+    g_main_context_invoke_full(g_task_get_context(task),
+                               G_PRIORITY_DEFAULT,
+                               file_operation_progress_cb,
+                               progress,
+                               (GDestroyNotify)file_operation_progress_free);
+}
+
+static void
+file_operation_worker(void *data) {
+    FileOperationWorker *worker = data;
+    FileOperation *op = worker->op;
+    // the workers take the next path whenever they're done with one, so slow paths don't hold up the others
+    while (!g_cancellable_is_cancelled(worker->cancellable)) {
+        const uint32_t idx = (uint32_t)g_atomic_int_add(&op->next_path, 1);
+        if (idx >= op->paths->len) {
+            break;
+        }
+        const char *path = g_ptr_array_index(op->paths, idx);
+        const bool removed = op->type == FSEARCH_FILE_OPERATION_DELETE
+                               ? fsearch_file_utils_remove(path, worker->error_messages)
+                               : fsearch_file_utils_trash(path, worker->error_messages);
+        if (removed) {
+            g_ptr_array_add(worker->removed, (gpointer)path);
+        }
+        file_operation_report_progress(op, worker->task, (uint32_t)g_atomic_int_add(&op->num_processed, 1) + 1);
+    }
+}
+
+static void
+file_operation_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    FileOperation *op = task_data;
+    const int64_t trace_start = fsearch_trace_begin();
+
+    // the work is mostly waiting for the filesystem, so it gets its own threads instead of the database ones
+    const uint32_t num_workers = MAX(1, MIN(op->num_threads, op->paths->len));
+    FileOperationWorker *workers = calloc(num_workers, sizeof(FileOperationWorker));
+    g_assert(workers);
+    for (uint32_t i = 0; i < num_workers; i++) {
+        workers[i].op = op;
+        workers[i].task = task;
+        workers[i].cancellable = cancellable;
+        workers[i].removed = g_ptr_array_new();
+        workers[i].error_messages = g_string_new(NULL);
+    }
+    FsearchThreadPool *pool = num_workers > 1 ? fsearch_thread_pool_new(num_workers) : NULL;
+    fsearch_thread_pool_run(pool, file_operation_worker, workers, sizeof(FileOperationWorker), num_workers);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+
+    g_autoptr(GPtrArray) removed = g_ptr_array_new();
+    op->error_messages = g_string_new(NULL);
+    for (uint32_t i = 0; i < num_workers; i++) {
+        for (uint32_t j = 0; j < workers[i].removed->len; j++) {
+            g_ptr_array_add(removed, g_ptr_array_index(workers[i].removed, j));
+        }
+        g_string_append_len(op->error_messages, workers[i].error_messages->str, workers[i].error_messages->len);
+        g_clear_pointer(&workers[i].removed, g_ptr_array_unref);
+        g_string_free(g_steal_pointer(&workers[i].error_messages), TRUE);
+    }
+    g_clear_pointer(&workers, free);
+    op->num_removed = removed->len;
+    fsearch_trace_end(trace_start, "file operation", op->type == FSEARCH_FILE_OPERATION_DELETE ? "delete" : "trash");
+
+    if (op->db && removed->len > 0) {
+        op->database_updated = db_update_paths(op->db, removed);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+void
+fsearch_file_operation_run_async(FsearchFileOperationType type,
+                                 GPtrArray *paths,
+                                 FsearchDatabase *db,
+                                 uint32_t num_threads,
+                                 GCancellable *cancellable,
+                                 FsearchFileOperationProgressFunc progress_func,
+                                 gpointer progress_data,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data) {
+    g_assert(type >= 0 && type < NUM_FSEARCH_FILE_OPERATIONS);
+    g_assert(paths);
+
+    FileOperation *op = calloc(1, sizeof(FileOperation));
+    g_assert(op);
+    op->type = type;
+    op->paths = g_ptr_array_ref(paths);
+    op->db = db ? db_ref(db) : NULL;
+    op->num_threads = num_threads;
+    op->progress_func = progress_func;
+    op->progress_data = progress_data;
+    g_mutex_init(&op->progress_mutex);
+    // the first progress is reported after one interval, small operations don't need any
+    op->last_progress_time = g_get_monotonic_time();
+
+    g_autoptr(GTask) task = g_task_new(NULL, cancellable, callback, user_data);
+    // what was done until it got cancelled is still reported
+    g_task_set_check_cancellable(task, FALSE);
+    g_task_set_task_data(task, op, (GDestroyNotify)file_operation_free);
+    g_task_run_in_thread(task, file_operation_thread);
+}
+
+uint32_t
+fsearch_file_operation_run_finish(GAsyncResult *result, char **error_messages, bool *database_updated) {
+    g_return_val_if_fail(g_task_is_valid(result, NULL), 0);
+    GTask *task = G_TASK(result);
+    g_task_propagate_boolean(task, NULL);
+
+    FileOperation *op = g_task_get_task_data(task);
+    if (error_messages) {
+        *error_messages = op->error_messages->len > 0 ? g_strdup(op->error_messages->str) : NULL;
+    }
+    if (database_updated) {
+        *database_updated = op->database_updated;
+    }
+    return op->num_removed;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_database.h"
+
+// Moves many files to the trash or deletes them on background threads, without blocking the caller.
+
+typedef enum {
+    FSEARCH_FILE_OPERATION_TRASH,
+    FSEARCH_FILE_OPERATION_DELETE,
+    NUM_FSEARCH_FILE_OPERATIONS,
+} FsearchFileOperationType;
+
+// Called in the thread-default main context of the caller of fsearch_file_operation_run_async, at most every few
+// hundred ms
+typedef void (*FsearchFileOperationProgressFunc)(uint32_t num_processed, uint32_t num_paths, gpointer user_data);
+
+// Trashes or deletes paths on up to num_threads threads. A path which fails doesn't stop the others. When
+// cancellable gets cancelled the remaining paths are skipped. Afterwards the entries of the removed paths are
+// removed from db right away, if db isn't NULL, so it doesn't need to be rescanned. progress_func may be NULL, it
+// isn't called anymore once callback ran.
+void
+fsearch_file_operation_run_async(FsearchFileOperationType type,
+                                 GPtrArray *paths,
+                                 FsearchDatabase *db,
+                                 uint32_t num_threads,
+                                 GCancellable *cancellable,
+                                 FsearchFileOperationProgressFunc progress_func,
+                                 gpointer progress_data,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data);
+
+// Returns how many paths were removed. error_messages, which may be NULL, is set to the errors of the paths which
+// failed, one per line, or NULL if none did. database_updated, which may be NULL, is set to whether the database
+// could remove the entries itself.
+uint32_t
+fsearch_file_operation_run_finish(GAsyncResult *result, char **error_messages, bool *database_updated);
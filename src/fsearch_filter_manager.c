@@ -1,18 +1,33 @@
 #include "fsearch_filter_manager.h"
+#include "fsearch_query_tree.h"
 
 #include <stdint.h>
 #include <stdlib.h>
 
 struct FsearchFilterManager {
     GList *filters;
+
+    // "flags:query" -> FsearchQuerySharedTree, the trees of the filter queries which were used so far.
+    // Macros are expanded in them, so any change of the filters drops all of them.
+    GHashTable *query_trees;
+    GMutex query_trees_mutex;
 };
 
+static void
+invalidate_query_trees(FsearchFilterManager *manager) {
+    g_mutex_lock(&manager->query_trees_mutex);
+    g_hash_table_remove_all(manager->query_trees);
+    g_mutex_unlock(&manager->query_trees_mutex);
+}
+
 void
 fsearch_filter_manager_free(FsearchFilterManager *manager) {
     if (!manager) {
         return;
     }
     g_list_free_full(g_steal_pointer(&manager->filters), (GDestroyNotify)fsearch_filter_unref);
+    g_clear_pointer(&manager->query_trees, g_hash_table_unref);
+    g_mutex_clear(&manager->query_trees_mutex);
     g_clear_pointer(&manager, free);
 }
 
@@ -22,6 +37,9 @@ fsearch_filter_manager_new(void) {
     g_assert(manager);
 
     manager->filters = NULL;
+    manager->query_trees =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)fsearch_query_shared_tree_unref);
+    g_mutex_init(&manager->query_trees_mutex);
     return manager;
 }
 
@@ -79,6 +97,7 @@ void
 fsearch_filter_manager_append_filter(FsearchFilterManager *manager, FsearchFilter *filter) {
     update_filter_to_unique_name(manager->filters, filter);
     manager->filters = g_list_append(manager->filters, fsearch_filter_ref(filter));
+    invalidate_query_trees(manager);
 }
 
 void
@@ -94,6 +113,8 @@ fsearch_filter_manager_reorder(FsearchFilterManager *manager, gint *new_order, s
     }
     g_list_free(manager->filters);
     manager->filters = reordered_filters;
+    // macros are looked up in order, so this might change which filter a macro refers to
+    invalidate_query_trees(manager);
 }
 
 void
@@ -103,6 +124,7 @@ fsearch_filter_manager_remove(FsearchFilterManager *manager, FsearchFilter *filt
     }
     manager->filters = g_list_remove(manager->filters, filter);
     g_clear_pointer(&filter, fsearch_filter_unref);
+    invalidate_query_trees(manager);
 }
 
 void
@@ -122,6 +144,7 @@ fsearch_filter_manager_edit(FsearchFilterManager *manager,
     filter->macro = g_strdup(macro ? macro : "");
     filter->flags = flags;
     update_filter_to_unique_name(manager->filters, filter);
+    invalidate_query_trees(manager);
 }
 
 FsearchFilter *
@@ -153,6 +176,23 @@ fsearch_filter_manager_get_filter(FsearchFilterManager *manager, guint idx) {
     return filter ? fsearch_filter_ref(filter) : NULL;
 }
 
+FsearchQuerySharedTree *
+fsearch_filter_manager_get_query_tree(FsearchFilterManager *manager, const char *query, FsearchQueryFlags flags) {
+    g_assert(manager);
+    g_assert(query);
+
+    g_autofree char *key = g_strdup_printf("%u:%s", flags, query);
+    g_mutex_lock(&manager->query_trees_mutex);
+    FsearchQuerySharedTree *tree = g_hash_table_lookup(manager->query_trees, key);
+    if (!tree) {
+        tree = fsearch_query_shared_tree_new(query, manager, flags);
+        g_hash_table_insert(manager->query_trees, g_steal_pointer(&key), tree);
+    }
+    fsearch_query_shared_tree_ref(tree);
+    g_mutex_unlock(&manager->query_trees_mutex);
+    return tree;
+}
+
 bool
 fsearch_filter_manager_cmp(FsearchFilterManager *manager_1, FsearchFilterManager *manager_2) {
     g_assert(manager_1);
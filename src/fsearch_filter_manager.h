@@ -6,6 +6,8 @@
 #include "fsearch_filter.h"
 
 typedef struct FsearchFilterManager FsearchFilterManager;
+// defined in fsearch_query_tree.h
+typedef struct FsearchQuerySharedTree FsearchQuerySharedTree;
 
 void
 fsearch_filter_manager_free(FsearchFilterManager *manager);
@@ -45,5 +47,10 @@ fsearch_filter_manager_edit(FsearchFilterManager *manager,
                             const char *query,
                             FsearchQueryFlags flags);
 
+// Returns the planned tree of query, which is parsed only once as long as the filters and their macros don't change.
+// The caller owns a reference to it.
+FsearchQuerySharedTree *
+fsearch_filter_manager_get_query_tree(FsearchFilterManager *manager, const char *query, FsearchQueryFlags flags);
+
 bool
 fsearch_filter_manager_cmp(FsearchFilterManager *manager_1, FsearchFilterManager *manager_2);
@@ -0,0 +1,159 @@
+#define G_LOG_DOMAIN "fsearch-folded-names"
+
+#include "fsearch_folded_names.h"
+#include "fsearch_limits.h"
+#include "fsearch_utf.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    DynamicArray *entries;
+    uint32_t num_entries;
+
+    // the sorted positions of the entries with non-ASCII names, the folded name of positions[i] is stored at
+    // buffer + offsets[i] and has lens[i] code units
+    uint32_t *positions;
+    uint64_t *offsets;
+    int32_t *lens;
+    uint32_t num_names;
+    UChar *buffer;
+} FoldedNamesTable;
+
+struct FsearchFoldedNames {
+    FoldedNamesTable folders;
+    FoldedNamesTable files;
+
+    volatile int ref_count;
+};
+
+static void
+table_build(FoldedNamesTable *table, DynamicArray *entries, FsearchUtfBuilder *builder) {
+    if (!entries) {
+        return;
+    }
+    table->entries = darray_ref(entries);
+    table->num_entries = darray_get_num_items(entries);
+
+    uint32_t capacity = 0;
+    uint64_t buffer_len = 0;
+    uint64_t buffer_capacity = 0;
+    for (uint32_t i = 0; i < table->num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry || db_entry_name_is_ascii(entry)
+            || !fsearch_utf_builder_normalize_and_fold_case(builder, db_entry_get_name_raw_for_display(entry))) {
+            continue;
+        }
+        const int32_t len = builder->string_normalized_folded_len;
+        if (table->num_names == capacity) {
+            capacity = MAX(capacity * 2, 1024);
+            table->positions = realloc(table->positions, capacity * sizeof(uint32_t));
+            table->offsets = realloc(table->offsets, capacity * sizeof(uint64_t));
+            table->lens = realloc(table->lens, capacity * sizeof(int32_t));
+            g_assert(table->positions && table->offsets && table->lens);
+        }
+        if (buffer_len + len > buffer_capacity) {
+            buffer_capacity = MAX(buffer_capacity * 2, buffer_len + len);
+            table->buffer = realloc(table->buffer, buffer_capacity * sizeof(UChar));
+            g_assert(table->buffer);
+        }
+        memcpy(table->buffer + buffer_len, builder->string_normalized_folded, len * sizeof(UChar));
+        table->positions[table->num_names] = i;
+        table->offsets[table->num_names] = buffer_len;
+        table->lens[table->num_names] = len;
+        table->num_names++;
+        buffer_len += len;
+    }
+}
+
+static void
+table_clear(FoldedNamesTable *table) {
+    g_clear_pointer(&table->entries, darray_unref);
+    g_clear_pointer(&table->positions, free);
+    g_clear_pointer(&table->offsets, free);
+    g_clear_pointer(&table->lens, free);
+    g_clear_pointer(&table->buffer, free);
+}
+
+FsearchFoldedNames *
+fsearch_folded_names_new(DynamicArray *folders, DynamicArray *files) {
+    FsearchFoldedNames *names = calloc(1, sizeof(FsearchFoldedNames));
+    g_assert(names);
+
+    FsearchUtfBuilder builder = {};
+    fsearch_utf_builder_init(&builder, 4 * PATH_MAX);
+    table_build(&names->folders, folders, &builder);
+    table_build(&names->files, files, &builder);
+    fsearch_utf_builder_clear(&builder);
+
+    names->ref_count = 1;
+    return names;
+}
+
+FsearchFoldedNames *
+fsearch_folded_names_ref(FsearchFoldedNames *names) {
+    if (!names || g_atomic_int_get(&names->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&names->ref_count);
+    return names;
+}
+
+void
+fsearch_folded_names_unref(FsearchFoldedNames *names) {
+    if (!names || g_atomic_int_get(&names->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&names->ref_count)) {
+        table_clear(&names->folders);
+        table_clear(&names->files);
+        g_clear_pointer(&names, free);
+    }
+}
+
+const UChar *
+fsearch_folded_names_lookup(FsearchFoldedNames *names, FsearchDatabaseEntry *entry, int32_t *len) {
+    if (!names || !entry) {
+        return NULL;
+    }
+    FoldedNamesTable *table = db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER ? &names->folders : &names->files;
+    const uint32_t idx = db_entry_get_idx(entry);
+    if (idx >= table->num_entries || darray_get_item(table->entries, idx) != entry) {
+        return NULL;
+    }
+
+    uint32_t left = 0;
+    uint32_t right = table->num_names;
+    while (left < right) {
+        const uint32_t mid = left + (right - left) / 2;
+        if (table->positions[mid] < idx) {
+            left = mid + 1;
+        }
+        else {
+            right = mid;
+        }
+    }
+    if (left == table->num_names || table->positions[left] != idx) {
+        return NULL;
+    }
+    *len = table->lens[left];
+    return table->buffer + table->offsets[left];
+}
+
+static size_t
+table_get_memory_usage(FoldedNamesTable *table) {
+    if (table->num_names == 0) {
+        return 0;
+    }
+    const uint64_t buffer_len = table->offsets[table->num_names - 1] + table->lens[table->num_names - 1];
+    return table->num_names * (sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int32_t)) + buffer_len * sizeof(UChar);
+}
+
+size_t
+fsearch_folded_names_get_memory_usage(FsearchFoldedNames *names) {
+    if (!names) {
+        return 0;
+    }
+    return sizeof(FsearchFoldedNames) + table_get_memory_usage(&names->folders) + table_get_memory_usage(&names->files);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unicode/utypes.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_entry.h"
+
+// The case folded and NFD normalized UTF-16 forms of all entry names which aren't pure ASCII, exactly as
+// fsearch_utf_builder_normalize_and_fold_case produces them. They're computed once for the name sorted
+// arrays of a database, so searches with non-ASCII needles don't have to run every name through ICU.
+// ASCII names aren't stored, they're folded without ICU anyway.
+//
+// Entries are looked up by their idx, which must be their position in the arrays the names were built for.
+// The names don't change once they're built, so they can be shared by several threads.
+typedef struct FsearchFoldedNames FsearchFoldedNames;
+
+FsearchFoldedNames *
+fsearch_folded_names_new(DynamicArray *folders, DynamicArray *files);
+
+FsearchFoldedNames *
+fsearch_folded_names_ref(FsearchFoldedNames *names);
+
+void
+fsearch_folded_names_unref(FsearchFoldedNames *names);
+
+// Returns about the number of bytes allocated for the names, names may be NULL
+size_t
+fsearch_folded_names_get_memory_usage(FsearchFoldedNames *names);
+
+// Returns the folded name of entry or NULL if it's not stored (e.g. because it's ASCII or entry was added after
+// the names were built). *len is set to its number of code units then. names may be NULL.
+const UChar *
+fsearch_folded_names_lookup(FsearchFoldedNames *names, FsearchDatabaseEntry *entry, int32_t *len);
@@ -0,0 +1,197 @@
+#define G_LOG_DOMAIN "fsearch-folder-paths"
+
+#include "fsearch_folder_paths.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// offsets[i] while the path of the folder at position i isn't built yet
+#define FOLDER_PATH_NOT_BUILT SIZE_MAX
+
+struct FsearchFolderPaths {
+    DynamicArray *folders;
+    uint32_t num_folders;
+
+    // the NUL terminated path of the folder at position i starts at buffer + offsets[i]
+    char *buffer;
+    size_t buffer_len;
+    size_t buffer_capacity;
+    size_t *offsets;
+    uint32_t *lens;
+
+    volatile int ref_count;
+};
+
+static bool
+get_position(FsearchFolderPaths *paths, FsearchDatabaseEntryFolder *folder, uint32_t *pos) {
+    if (!folder) {
+        return false;
+    }
+    const uint32_t idx = db_entry_get_idx((FsearchDatabaseEntry *)folder);
+    if (idx >= paths->num_folders || darray_get_item(paths->folders, idx) != folder) {
+        return false;
+    }
+    *pos = idx;
+    return true;
+}
+
+static void
+reserve_buffer(FsearchFolderPaths *paths, size_t len) {
+    if (paths->buffer_len + len <= paths->buffer_capacity) {
+        return;
+    }
+    paths->buffer_capacity = MAX(paths->buffer_capacity * 2, paths->buffer_len + len);
+    paths->buffer = realloc(paths->buffer, paths->buffer_capacity);
+    g_assert(paths->buffer);
+}
+
+// Builds the path of the folder at pos, the path of its parent must be built already (if it's part of paths)
+static void
+build_path(FsearchFolderPaths *paths, uint32_t pos) {
+    FsearchDatabaseEntry *folder = darray_get_item(paths->folders, pos);
+    FsearchDatabaseEntryFolder *parent = db_entry_get_parent(folder);
+    g_autoptr(GString) parent_path = NULL;
+    uint32_t parent_pos = 0;
+    size_t parent_len = 0;
+    if (get_position(paths, parent, &parent_pos)) {
+        parent_len = paths->lens[parent_pos];
+    }
+    else if (parent) {
+        parent_path = g_string_new(NULL);
+        db_entry_append_full_path((FsearchDatabaseEntry *)parent, parent_path);
+        parent_len = parent_path->len;
+    }
+    // only after the parent path was built, that might decode other names
+    const char *name = db_entry_get_name_raw(folder);
+    const size_t name_len = strlen(name);
+
+    // the parent path, a separator unless the parent is the root folder, the name and the NUL
+    reserve_buffer(paths, parent_len + 1 + MAX(name_len, 1) + 1);
+    char *dest = paths->buffer + paths->buffer_len;
+    char *start = dest;
+    if (parent_len > 0) {
+        memcpy(dest, parent_path ? parent_path->str : paths->buffer + paths->offsets[parent_pos], parent_len);
+        dest += parent_len;
+        if (parent_len > 1 || start[0] != G_DIR_SEPARATOR) {
+            *dest++ = G_DIR_SEPARATOR;
+        }
+    }
+    memcpy(dest, name, name_len);
+    dest += name_len;
+    if (dest == start) {
+        // the root folder
+        *dest++ = G_DIR_SEPARATOR;
+    }
+    *dest = '\0';
+
+    paths->offsets[pos] = paths->buffer_len;
+    paths->lens[pos] = (uint32_t)(dest - start);
+    paths->buffer_len += dest - start + 1;
+}
+
+FsearchFolderPaths *
+fsearch_folder_paths_new(DynamicArray *folders) {
+    g_assert(folders);
+
+    FsearchFolderPaths *paths = calloc(1, sizeof(FsearchFolderPaths));
+    g_assert(paths);
+    paths->folders = darray_ref(folders);
+    paths->num_folders = darray_get_num_items(folders);
+    paths->offsets = malloc(MAX(paths->num_folders, 1) * sizeof(size_t));
+    g_assert(paths->offsets);
+    paths->lens = calloc(MAX(paths->num_folders, 1), sizeof(uint32_t));
+    g_assert(paths->lens);
+    for (uint32_t i = 0; i < paths->num_folders; i++) {
+        paths->offsets[i] = FOLDER_PATH_NOT_BUILT;
+    }
+
+    // the folders are sorted by name, so the parents which aren't built yet are collected first
+    GArray *pending = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    for (uint32_t i = 0; i < paths->num_folders; i++) {
+        uint32_t pos = i;
+        while (paths->offsets[pos] == FOLDER_PATH_NOT_BUILT) {
+            g_array_append_val(pending, pos);
+            FsearchDatabaseEntry *folder = darray_get_item(folders, pos);
+            if (!get_position(paths, db_entry_get_parent(folder), &pos)) {
+                break;
+            }
+        }
+        while (pending->len > 0) {
+            build_path(paths, g_array_index(pending, uint32_t, pending->len - 1));
+            g_array_set_size(pending, pending->len - 1);
+        }
+    }
+    g_clear_pointer(&pending, g_array_unref);
+
+    paths->ref_count = 1;
+    return paths;
+}
+
+FsearchFolderPaths *
+fsearch_folder_paths_ref(FsearchFolderPaths *paths) {
+    if (!paths || g_atomic_int_get(&paths->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&paths->ref_count);
+    return paths;
+}
+
+void
+fsearch_folder_paths_unref(FsearchFolderPaths *paths) {
+    if (!paths || g_atomic_int_get(&paths->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&paths->ref_count)) {
+        g_clear_pointer(&paths->folders, darray_unref);
+        g_clear_pointer(&paths->buffer, free);
+        g_clear_pointer(&paths->offsets, free);
+        g_clear_pointer(&paths->lens, free);
+        g_clear_pointer(&paths, free);
+    }
+}
+
+const char *
+fsearch_folder_paths_lookup(FsearchFolderPaths *paths, FsearchDatabaseEntryFolder *folder, size_t *len) {
+    uint32_t pos = 0;
+    if (!paths || !get_position(paths, folder, &pos)) {
+        return NULL;
+    }
+    *len = paths->lens[pos];
+    return paths->buffer + paths->offsets[pos];
+}
+
+void
+fsearch_folder_paths_append_path(FsearchFolderPaths *paths, FsearchDatabaseEntry *entry, GString *str) {
+    size_t len = 0;
+    const char *path = fsearch_folder_paths_lookup(paths, db_entry_get_parent(entry), &len);
+    if (!path) {
+        db_entry_append_path(entry, str);
+        return;
+    }
+    g_string_append_len(str, path, (gssize)len);
+}
+
+void
+fsearch_folder_paths_append_full_path(FsearchFolderPaths *paths, FsearchDatabaseEntry *entry, GString *str) {
+    size_t len = 0;
+    const char *path = fsearch_folder_paths_lookup(paths, db_entry_get_parent(entry), &len);
+    if (!path) {
+        db_entry_append_full_path(entry, str);
+        return;
+    }
+    g_string_append_len(str, path, (gssize)len);
+    if (len > 1 || path[0] != G_DIR_SEPARATOR) {
+        g_string_append_c(str, G_DIR_SEPARATOR);
+    }
+    const char *name = db_entry_get_name_raw(entry);
+    g_string_append(str, name[0] == '\0' ? G_DIR_SEPARATOR_S : name);
+}
+
+size_t
+fsearch_folder_paths_get_memory_usage(FsearchFolderPaths *paths) {
+    if (!paths) {
+        return 0;
+    }
+    return sizeof(FsearchFolderPaths) + paths->buffer_capacity
+         + paths->num_folders * (sizeof(size_t) + sizeof(uint32_t));
+}
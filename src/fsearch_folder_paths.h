@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_entry.h"
+
+// The paths of all folders of a database, built once and stored one after another in a single buffer.
+// They're looked up by the idx of the folders, which must be their position in the array the paths were
+// built for. This way the path of an entry is a lookup and a copy instead of a walk over all of its parents.
+//
+// The paths don't change once they're built, so they can be shared by several threads. Folders which
+// aren't part of the array (e.g. because they were added later) still get their paths built the slow way.
+typedef struct FsearchFolderPaths FsearchFolderPaths;
+
+FsearchFolderPaths *
+fsearch_folder_paths_new(DynamicArray *folders);
+
+FsearchFolderPaths *
+fsearch_folder_paths_ref(FsearchFolderPaths *paths);
+
+void
+fsearch_folder_paths_unref(FsearchFolderPaths *paths);
+
+// Returns the number of bytes allocated for the paths, paths may be NULL
+size_t
+fsearch_folder_paths_get_memory_usage(FsearchFolderPaths *paths);
+
+// Returns the full path of folder, as db_entry_append_full_path would build it, or NULL if folder
+// isn't part of paths. *len is set to its length then.
+const char *
+fsearch_folder_paths_lookup(FsearchFolderPaths *paths, FsearchDatabaseEntryFolder *folder, size_t *len);
+
+// Like db_entry_append_path, paths may be NULL
+void
+fsearch_folder_paths_append_path(FsearchFolderPaths *paths, FsearchDatabaseEntry *entry, GString *str);
+
+// Like db_entry_append_full_path, paths may be NULL
+void
+fsearch_folder_paths_append_full_path(FsearchFolderPaths *paths, FsearchDatabaseEntry *entry, GString *str);
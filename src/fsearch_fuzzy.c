@@ -0,0 +1,193 @@
+#define G_LOG_DOMAIN "fsearch-fuzzy"
+
+#include "fsearch_fuzzy.h"
+#include "fsearch_string_search.h"
+
+#include <glib.h>
+#include <string.h>
+
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_BONUS_CONSECUTIVE 8
+#define FUZZY_BONUS_FIRST 12
+#define FUZZY_BONUS_BOUNDARY 10
+#define FUZZY_BONUS_CAMEL_CASE 8
+#define FUZZY_PENALTY_GAP_START 3
+#define FUZZY_PENALTY_GAP_EXTENSION 1
+// every this many bytes of the haystack cost one point, so shorter names are preferred
+#define FUZZY_PENALTY_LENGTH_DIVISOR 16
+
+size_t
+fsearch_fuzzy_char_len(const char *s, size_t max_len) {
+    const unsigned char c = (unsigned char)s[0];
+    size_t len = 1;
+    if (c >= 0xf0) {
+        len = 4;
+    }
+    else if (c >= 0xe0) {
+        len = 3;
+    }
+    else if (c >= 0xc0) {
+        len = 2;
+    }
+    return MIN(len, max_len);
+}
+
+static inline bool
+chars_equal(const char *a, const char *b, size_t len, bool ignore_ascii_case) {
+    if (len == 1 && ignore_ascii_case) {
+        return g_ascii_tolower(*a) == g_ascii_tolower(*b);
+    }
+    return !memcmp(a, b, len);
+}
+
+// Finds the first occurrence of the character c with c_len bytes in haystack[start, end)
+static const char *
+find_char_forward(const char *haystack,
+                  size_t start,
+                  size_t end,
+                  const char *c,
+                  size_t c_len,
+                  bool ignore_ascii_case) {
+    if (start + c_len > end) {
+        return NULL;
+    }
+    if (c_len == 1 && ignore_ascii_case && g_ascii_isalpha(*c)) {
+        // both cases have to be looked for, the vectorized search does that at once
+        return fsearch_string_search_ascii_icase(haystack + start, end - start, c, 1);
+    }
+    const char *p = haystack + start;
+    const char *last = haystack + end - c_len;
+    while (p <= last) {
+        p = memchr(p, (unsigned char)*c, last - p + 1);
+        if (!p) {
+            return NULL;
+        }
+        if (!memcmp(p, c, c_len)) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+// Finds the last occurrence of the character c with c_len bytes in haystack[start, end)
+static const char *
+find_char_backward(const char *haystack,
+                   size_t start,
+                   size_t end,
+                   const char *c,
+                   size_t c_len,
+                   bool ignore_ascii_case) {
+    if (start + c_len > end) {
+        return NULL;
+    }
+    for (size_t i = end - c_len + 1; i-- > start;) {
+        if (chars_equal(haystack + i, c, c_len, ignore_ascii_case)) {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+static inline bool
+is_boundary(char c) {
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+static uint32_t
+get_char_bonus(const char *haystack, size_t pos) {
+    if (pos == 0) {
+        return FUZZY_BONUS_FIRST;
+    }
+    const char prev = haystack[pos - 1];
+    if (is_boundary(prev)) {
+        return FUZZY_BONUS_BOUNDARY;
+    }
+    if (g_ascii_islower(prev) && g_ascii_isupper(haystack[pos])) {
+        return FUZZY_BONUS_CAMEL_CASE;
+    }
+    return 0;
+}
+
+bool
+fsearch_fuzzy_match(const char *haystack,
+                     size_t haystack_len,
+                     const char *needle,
+                     size_t needle_len,
+                     bool ignore_ascii_case,
+                     uint32_t *score,
+                     uint32_t *positions) {
+    if (needle_len == 0) {
+        if (score) {
+            *score = 1;
+        }
+        return true;
+    }
+    if (!haystack || haystack_len < needle_len) {
+        return false;
+    }
+
+    // find the first place where all characters occur in order, most haystacks are rejected here already
+    size_t end = 0;
+    for (size_t i = 0; i < needle_len;) {
+        const size_t c_len = fsearch_fuzzy_char_len(needle + i, needle_len - i);
+        const char *match = find_char_forward(haystack, end, haystack_len, needle + i, c_len, ignore_ascii_case);
+        if (!match) {
+            return false;
+        }
+        end = match - haystack + c_len;
+        i += c_len;
+    }
+
+    // walk back from the end of that match to find the shortest window which ends there
+    size_t start = end;
+    for (size_t i = needle_len; i > 0;) {
+        // step back to the start of the previous needle character
+        size_t c_start = i - 1;
+        while (c_start > 0 && ((unsigned char)needle[c_start] & 0xc0) == 0x80) {
+            c_start--;
+        }
+        const size_t c_len = i - c_start;
+        const char *match = find_char_backward(haystack, 0, start, needle + c_start, c_len, ignore_ascii_case);
+        // the forward search found every character in this range already
+        g_assert(match);
+        start = match - haystack;
+        i = c_start;
+    }
+
+    // score the leftmost matches in that window
+    int64_t total = 0;
+    size_t prev_end = 0;
+    size_t pos = start;
+    uint32_t num_chars = 0;
+    for (size_t i = 0; i < needle_len;) {
+        const size_t c_len = fsearch_fuzzy_char_len(needle + i, needle_len - i);
+        const char *match = find_char_forward(haystack, pos, end, needle + i, c_len, ignore_ascii_case);
+        g_assert(match);
+        const size_t match_pos = match - haystack;
+
+        total += FUZZY_SCORE_MATCH + get_char_bonus(haystack, match_pos);
+        if (num_chars > 0) {
+            const size_t gap = match_pos - prev_end;
+            if (gap == 0) {
+                total += FUZZY_BONUS_CONSECUTIVE;
+            }
+            else {
+                total -= FUZZY_PENALTY_GAP_START + (int64_t)(gap - 1) * FUZZY_PENALTY_GAP_EXTENSION;
+            }
+        }
+        if (positions) {
+            positions[num_chars] = (uint32_t)match_pos;
+        }
+        num_chars++;
+        prev_end = match_pos + c_len;
+        pos = prev_end;
+        i += c_len;
+    }
+    total -= (int64_t)(haystack_len / FUZZY_PENALTY_LENGTH_DIVISOR);
+
+    if (score) {
+        *score = (uint32_t)CLAMP(total, 1, (int64_t)G_MAXUINT32);
+    }
+    return true;
+}
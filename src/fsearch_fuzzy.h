@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fuzzy matching: the haystack matches if it contains all characters of the needle in the same order, but
+// not necessarily next to each other (e.g. "fsdbc" matches "fsearch_database.c"). Neither string needs to be
+// NUL terminated and both are treated as UTF-8, characters are only compared byte by byte though.
+//
+// Of all the places the needle can be found at, the shortest one which ends first is picked and scored:
+// matches right after a separator, at the start of a camel case word or next to each other score higher,
+// gaps between them and long haystacks lower. The score is always > 0 for a match.
+// If positions isn't NULL, it receives the byte offset of every needle character in the haystack, so it must
+// have room for needle_len offsets.
+//
+// With ignore_ascii_case, ASCII letters are compared regardless of their case, other characters must be
+// folded by the caller.
+bool
+fsearch_fuzzy_match(const char *haystack,
+                     size_t haystack_len,
+                     const char *needle,
+                     size_t needle_len,
+                     bool ignore_ascii_case,
+                     uint32_t *score,
+                     uint32_t *positions);
+
+// Returns the number of bytes of the UTF-8 character starting at s, which has at most max_len bytes left
+size_t
+fsearch_fuzzy_char_len(const char *s, size_t max_len);
@@ -0,0 +1,91 @@
+#define G_LOG_DOMAIN "fsearch-id-dictionary"
+
+#include "fsearch_id_dictionary.h"
+
+#include <stdlib.h>
+
+#define ID_DICTIONARY_MAX_IDS FSEARCH_ID_DICTIONARY_OVERFLOW_ID
+
+struct FsearchIdDictionary {
+    // value -> id + 1, so a missing value can be told apart from id 0
+    GHashTable *ids;
+    // id -> value, only the first num_ids are set
+    uint32_t *values;
+    volatile uint32_t num_ids;
+    // the value which was looked up last and its id, most entries of a folder share their owner
+    volatile uint64_t last_lookup;
+
+    GMutex mutex;
+};
+
+static inline uint64_t
+pack_lookup(uint32_t value, uint16_t id) {
+    // id + 1, so the initial 0 never matches
+    return ((uint64_t)value << 32) | ((uint64_t)id + 1);
+}
+
+FsearchIdDictionary *
+fsearch_id_dictionary_new(void) {
+    FsearchIdDictionary *dict = calloc(1, sizeof(FsearchIdDictionary));
+    g_assert(dict);
+    dict->ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    dict->values = calloc(ID_DICTIONARY_MAX_IDS, sizeof(uint32_t));
+    g_assert(dict->values);
+    g_mutex_init(&dict->mutex);
+    return dict;
+}
+
+void
+fsearch_id_dictionary_free(FsearchIdDictionary *dict) {
+    if (!dict) {
+        return;
+    }
+    g_clear_pointer(&dict->ids, g_hash_table_unref);
+    g_clear_pointer(&dict->values, free);
+    g_mutex_clear(&dict->mutex);
+    g_clear_pointer(&dict, free);
+}
+
+uint16_t
+fsearch_id_dictionary_get_id(FsearchIdDictionary *dict, uint32_t value) {
+    g_assert(dict);
+
+    const uint64_t last_lookup = __atomic_load_n(&dict->last_lookup, __ATOMIC_RELAXED);
+    if (last_lookup >> 32 == value && (last_lookup & UINT32_MAX) != 0) {
+        return (uint16_t)((last_lookup & UINT32_MAX) - 1);
+    }
+
+    g_mutex_lock(&dict->mutex);
+    gpointer stored_id = g_hash_table_lookup(dict->ids, GUINT_TO_POINTER(value));
+    uint16_t id = FSEARCH_ID_DICTIONARY_OVERFLOW_ID;
+    if (stored_id) {
+        id = (uint16_t)(GPOINTER_TO_UINT(stored_id) - 1);
+    }
+    else if (dict->num_ids < ID_DICTIONARY_MAX_IDS) {
+        id = (uint16_t)dict->num_ids;
+        dict->values[id] = value;
+        g_hash_table_insert(dict->ids, GUINT_TO_POINTER(value), GUINT_TO_POINTER((guint)id + 1));
+        g_atomic_int_set(&dict->num_ids, dict->num_ids + 1);
+    }
+    g_mutex_unlock(&dict->mutex);
+
+    __atomic_store_n(&dict->last_lookup, pack_lookup(value, id), __ATOMIC_RELAXED);
+    return id;
+}
+
+bool
+fsearch_id_dictionary_get_value(FsearchIdDictionary *dict, uint16_t id, uint32_t *value) {
+    g_assert(dict);
+    g_assert(value);
+    if (id >= g_atomic_int_get(&dict->num_ids)) {
+        return false;
+    }
+    *value = dict->values[id];
+    return true;
+}
+
+uint32_t
+fsearch_id_dictionary_get_num_ids(FsearchIdDictionary *dict) {
+    g_assert(dict);
+    return g_atomic_int_get(&dict->num_ids);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Maps 32 bit values (e.g. user or group ids) to dense 16 bit ids, in the order they were added first.
+// Ids are never removed, so an id stays valid for the lifetime of the dictionary. The dictionary is thread safe.
+typedef struct FsearchIdDictionary FsearchIdDictionary;
+
+// All values which get added once the dictionary is full share this id
+#define FSEARCH_ID_DICTIONARY_OVERFLOW_ID (UINT16_MAX - 1)
+// Never returned for a value, e.g. for entries which don't have one
+#define FSEARCH_ID_DICTIONARY_NO_ID UINT16_MAX
+
+FsearchIdDictionary *
+fsearch_id_dictionary_new(void);
+
+void
+fsearch_id_dictionary_free(FsearchIdDictionary *dict);
+
+// Returns the id of value, value gets added if it's not part of the dictionary yet
+uint16_t
+fsearch_id_dictionary_get_id(FsearchIdDictionary *dict, uint32_t value);
+
+// Returns false if id wasn't handed out for a single value (yet)
+bool
+fsearch_id_dictionary_get_value(FsearchIdDictionary *dict, uint16_t id, uint32_t *value);
+
+uint32_t
+fsearch_id_dictionary_get_num_ids(FsearchIdDictionary *dict);
@@ -0,0 +1,192 @@
+#define G_LOG_DOMAIN "fsearch-index-delta"
+
+#include "fsearch_index_delta.h"
+#include "fsearch_database_entry.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Entries which get added later are indexed on their own, until there are this many of them or they make up
+// a this large fraction of the whole index. Then the index gets rebuilt from scratch.
+#define INDEX_DELTA_MIN_ENTRIES_FOR_REBUILD 16384
+#define INDEX_DELTA_REBUILD_FRACTION 16
+
+static FsearchIndexDeltaTable *
+index_delta_table_ref(FsearchIndexDeltaTable *table) {
+    if (!table || g_atomic_int_get(&table->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&table->ref_count);
+    return table;
+}
+
+static void
+index_delta_table_unref(const FsearchIndexDeltaFuncs *funcs, FsearchIndexDeltaTable *table) {
+    if (!table || g_atomic_int_get(&table->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&table->ref_count)) {
+        funcs->table_free(table);
+    }
+}
+
+// Turns the positions in table->entries into positions in entries, entries which aren't part of it anymore are
+// dropped. Entries keep their order when others get added or removed, so the resolved positions are still sorted.
+static uint32_t
+index_delta_table_resolve(FsearchIndexDeltaTable *table,
+                          DynamicArray *entries,
+                          uint32_t *positions,
+                          uint32_t num_positions) {
+    if (table->entries == entries) {
+        return num_positions;
+    }
+    const uint32_t num_entries = darray_get_num_items(entries);
+    uint32_t num_resolved = 0;
+    for (uint32_t i = 0; i < num_positions; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(table->entries, positions[i]);
+        const uint32_t idx = db_entry_get_idx(entry);
+        if (idx < num_entries && darray_get_item(entries, idx) == entry) {
+            positions[num_resolved++] = idx;
+        }
+    }
+    return num_resolved;
+}
+
+// Returns the resolved positions of the candidates for query in table, NULL if there are none
+static uint32_t *
+index_delta_table_lookup(const FsearchIndexDelta *delta,
+                         FsearchIndexDeltaTable *table,
+                         const void *query,
+                         uint32_t *num_positions) {
+    *num_positions = 0;
+    if (!table) {
+        return NULL;
+    }
+    uint32_t *positions = delta->funcs->table_lookup(table, query, num_positions);
+    *num_positions = positions ? index_delta_table_resolve(table, delta->entries, positions, *num_positions) : 0;
+    if (*num_positions == 0) {
+        g_clear_pointer(&positions, free);
+    }
+    return positions;
+}
+
+static int
+compare_positions(const void *a, const void *b) {
+    const uint32_t pos_a = *(const uint32_t *)a;
+    const uint32_t pos_b = *(const uint32_t *)b;
+    return pos_a < pos_b ? -1 : pos_a > pos_b;
+}
+
+void
+fsearch_index_delta_table_init(FsearchIndexDeltaTable *table, DynamicArray *entries) {
+    g_assert(table);
+    g_assert(entries);
+    table->entries = darray_ref(entries);
+    table->num_entries = darray_get_num_items(entries);
+    table->ref_count = 1;
+}
+
+void
+fsearch_index_delta_init(FsearchIndexDelta *delta,
+                         const FsearchIndexDeltaFuncs *funcs,
+                         FsearchIndexDeltaTable *base,
+                         DynamicArray *entries) {
+    g_assert(delta);
+    g_assert(funcs);
+    g_assert(base);
+    g_assert(entries);
+    delta->funcs = funcs;
+    delta->base = base;
+    delta->added = NULL;
+    delta->entries = darray_ref(entries);
+}
+
+bool
+fsearch_index_delta_init_updated(FsearchIndexDelta *delta,
+                                 const FsearchIndexDelta *old,
+                                 DynamicArray *entries,
+                                 DynamicArray *added_entries,
+                                 FsearchThreadPool *pool) {
+    g_assert(delta);
+    g_assert(old);
+    g_assert(entries);
+
+    const uint32_t num_added = (old->added ? old->added->num_entries : 0)
+                             + (added_entries ? darray_get_num_items(added_entries) : 0);
+    if (num_added > MAX(INDEX_DELTA_MIN_ENTRIES_FOR_REBUILD, old->base->num_entries / INDEX_DELTA_REBUILD_FRACTION)) {
+        return false;
+    }
+
+    fsearch_index_delta_init(delta, old->funcs, index_delta_table_ref(old->base), entries);
+    if (num_added > 0) {
+        g_autoptr(DynamicArray) all_added = darray_new(num_added);
+        if (old->added) {
+            darray_add_array(all_added, old->added->entries);
+        }
+        if (added_entries) {
+            darray_add_array(all_added, added_entries);
+        }
+        delta->added = old->funcs->table_new(all_added, pool);
+    }
+    return true;
+}
+
+void
+fsearch_index_delta_clear(FsearchIndexDelta *delta) {
+    g_assert(delta);
+    index_delta_table_unref(delta->funcs, g_steal_pointer(&delta->base));
+    index_delta_table_unref(delta->funcs, g_steal_pointer(&delta->added));
+    g_clear_pointer(&delta->entries, darray_unref);
+}
+
+size_t
+fsearch_index_delta_get_memory_usage(const FsearchIndexDelta *delta) {
+    g_assert(delta);
+    size_t size = delta->funcs->table_get_memory_usage(delta->base);
+    if (delta->added) {
+        size += delta->funcs->table_get_memory_usage(delta->added);
+    }
+    return size;
+}
+
+void
+fsearch_index_delta_lookup(const FsearchIndexDelta *delta,
+                           const void *query,
+                           uint32_t **positions,
+                           uint32_t *num_positions) {
+    g_assert(delta);
+    g_assert(positions);
+    g_assert(num_positions);
+
+    uint32_t num_base = 0;
+    uint32_t *base = index_delta_table_lookup(delta, delta->base, query, &num_base);
+    uint32_t num_added = 0;
+    uint32_t *added = index_delta_table_lookup(delta, delta->added, query, &num_added);
+    if (num_added == 0) {
+        *positions = base;
+        *num_positions = num_base;
+        return;
+    }
+    // the added entries can be anywhere in the array
+    qsort(added, num_added, sizeof(uint32_t), compare_positions);
+
+    uint32_t *merged = malloc((num_base + num_added) * sizeof(uint32_t));
+    g_assert(merged);
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t num_merged = 0;
+    while (i < num_base || j < num_added) {
+        if (j == num_added || (i < num_base && base[i] < added[j])) {
+            merged[num_merged++] = base[i++];
+        }
+        else {
+            merged[num_merged++] = added[j++];
+        }
+    }
+    g_clear_pointer(&base, free);
+    g_clear_pointer(&added, free);
+
+    *positions = merged;
+    *num_positions = num_merged;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_thread_pool.h"
+
+// The part the trigram and the name index share: the table built for the array an index was created for (the base
+// table) is kept when entries get added, the added entries get a table of their own. Lookups resolve the
+// positions of both tables to positions in the current array and merge them. Once the added entries make up a
+// significant part of the index, it has to be rebuilt from scratch.
+
+// The common part of the tables, which must be their first member
+typedef struct {
+    // the array the positions of the table refer to
+    DynamicArray *entries;
+    uint32_t num_entries;
+
+    volatile int ref_count;
+} FsearchIndexDeltaTable;
+
+typedef struct {
+    FsearchIndexDeltaTable *(*table_new)(DynamicArray *entries, FsearchThreadPool *pool);
+    // frees the table, including its common part
+    void (*table_free)(FsearchIndexDeltaTable *table);
+    // Returns the sorted positions in table->entries of the candidates for query, free'd with free
+    uint32_t *(*table_lookup)(FsearchIndexDeltaTable *table, const void *query, uint32_t *num_positions);
+    size_t (*table_get_memory_usage)(FsearchIndexDeltaTable *table);
+} FsearchIndexDeltaFuncs;
+
+typedef struct {
+    const FsearchIndexDeltaFuncs *funcs;
+    // built for the array the index was created for
+    FsearchIndexDeltaTable *base;
+    // built for the entries which were added since then, NULL if there are none
+    FsearchIndexDeltaTable *added;
+    // the array lookups resolve positions for
+    DynamicArray *entries;
+} FsearchIndexDelta;
+
+// Sets up the common part of a new table for entries
+void
+fsearch_index_delta_table_init(FsearchIndexDeltaTable *table, DynamicArray *entries);
+
+// Takes the reference of base, which was built for entries
+void
+fsearch_index_delta_init(FsearchIndexDelta *delta,
+                         const FsearchIndexDeltaFuncs *funcs,
+                         FsearchIndexDeltaTable *base,
+                         DynamicArray *entries);
+
+// Sets up delta for entries, which contain all entries of the array old is for (apart from removed ones) and the
+// ones in added_entries. Returns false if the index should be rebuilt instead, delta isn't set up then.
+bool
+fsearch_index_delta_init_updated(FsearchIndexDelta *delta,
+                                 const FsearchIndexDelta *old,
+                                 DynamicArray *entries,
+                                 DynamicArray *added_entries,
+                                 FsearchThreadPool *pool);
+
+void
+fsearch_index_delta_clear(FsearchIndexDelta *delta);
+
+size_t
+fsearch_index_delta_get_memory_usage(const FsearchIndexDelta *delta);
+
+// Looks up query in both tables, *positions is set to the sorted positions in delta->entries of the candidates,
+// which must be freed with free (it's NULL if there are none).
+void
+fsearch_index_delta_lookup(const FsearchIndexDelta *delta,
+                           const void *query,
+                           uint32_t **positions,
+                           uint32_t *num_positions);
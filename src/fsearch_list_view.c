@@ -1,5 +1,6 @@
 
 #include "fsearch_list_view.h"
+#include "fsearch_trace.h"
 #include "pango/pango-attributes.h"
 #include "pango/pango-layout.h"
 #include <math.h>
@@ -571,6 +572,7 @@ fsearch_list_view_draw(GtkWidget *widget, cairo_t *cr) {
     const int height = gtk_widget_get_allocated_height(widget);
 
     if (gtk_cairo_should_draw_window(cr, gtk_widget_get_window(widget))) {
+        const int64_t span = fsearch_trace_begin();
         gtk_render_background(context, cr, 0, 0, width, height);
 
         if (clip_rec.y + clip_rec.height > view->header_height) {
@@ -580,6 +582,7 @@ fsearch_list_view_draw(GtkWidget *widget, cairo_t *cr) {
         if (clip_rec.y < view->header_height) {
             fsearch_list_view_draw_column_header(widget, context, cr);
         }
+        fsearch_trace_end(span, "ui", "draw list view");
     }
 
     return GDK_EVENT_PROPAGATE;
@@ -2294,6 +2297,21 @@ fsearch_list_view_get_sort_type(FsearchListView *view) {
     return view->sort_type;
 }
 
+void
+fsearch_list_view_get_visible_rows(FsearchListView *view, uint32_t *first_row, uint32_t *num_rows) {
+    const int first = view->row_height > 0 ? get_vscroll_pos(view) / view->row_height : 0;
+    *first_row = MAX(first, 0);
+    *num_rows = MAX(fsearch_list_view_num_rows_for_view_height(view), 0) + 2;
+}
+
+void
+fsearch_list_view_redraw_row(FsearchListView *view, uint32_t row) {
+    if (!view || row > G_MAXINT) {
+        return;
+    }
+    redraw_row(view, (int)row);
+}
+
 void
 fsearch_list_view_set_single_click_activate(FsearchListView *view, gboolean value) {
     if (!view) {
@@ -127,6 +127,14 @@ fsearch_list_view_get_sort_order(FsearchListView *view);
 GtkSortType
 fsearch_list_view_get_sort_type(FsearchListView *view);
 
+// The rows which are (at least partially) visible right now, in the order they're displayed
+void
+fsearch_list_view_get_visible_rows(FsearchListView *view, uint32_t *first_row, uint32_t *num_rows);
+
+// Queues a redraw of row, if it's visible
+void
+fsearch_list_view_redraw_row(FsearchListView *view, uint32_t row);
+
 void
 fsearch_list_view_set_sort_func(FsearchListView *view, FsearchListViewSortFunc func, gpointer sort_func_data);
 
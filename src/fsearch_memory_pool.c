@@ -2,6 +2,13 @@
 
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Blocks grow with the pool, so large databases only need a few of them, but not beyond this size
+#define MEMORY_POOL_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+// Size of a huge page on most systems, smaller blocks aren't worth mapping with huge pages
+#define MEMORY_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
 typedef struct FsearchMemoryPoolFreed {
     struct FsearchMemoryPoolFreed *next;
@@ -11,26 +18,70 @@ typedef struct {
     uint32_t num_used;
     uint32_t capacity;
     void *items;
+    // the size of the mapping if the items were mapped with huge pages, 0 if they were allocated with calloc
+    size_t mapped_size;
 } FsearchMemoryPoolBlock;
 
 struct FsearchMemoryPool {
     GList *blocks;
     FsearchMemoryPoolFreed *freed_items;
+    // the capacity of the first block
     uint32_t block_size;
+    // the capacity of all blocks
+    size_t capacity;
     size_t item_size;
+    bool huge_pages;
     GDestroyNotify item_free_func;
+
+    volatile int ref_count;
 };
 
-void
-fsearch_memory_pool_new_block(FsearchMemoryPool *pool) {
+static void *
+fsearch_memory_pool_map_items(size_t size) {
+#if defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE)
+    void *items = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // only succeeds if huge pages were reserved by the administrator
+    items = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (items == MAP_FAILED) {
+        items = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (items != MAP_FAILED) {
+            // otherwise ask for transparent huge pages
+            madvise(items, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    return items != MAP_FAILED ? items : NULL;
+#else
+    return NULL;
+#endif
+}
+
+static void
+fsearch_memory_pool_new_block(FsearchMemoryPool *pool, uint32_t capacity) {
     FsearchMemoryPoolBlock *block = calloc(1, sizeof(FsearchMemoryPoolBlock));
     g_assert(block);
 
-    block->items = calloc(pool->block_size + 1, pool->item_size);
-    g_assert(block->items);
+    const size_t size = capacity * pool->item_size;
+    if (pool->huge_pages && size >= MEMORY_POOL_HUGE_PAGE_SIZE) {
+        // anonymous mappings are zeroed like calloc'd memory
+        const size_t mapped_size = (size + MEMORY_POOL_HUGE_PAGE_SIZE - 1) & ~((size_t)MEMORY_POOL_HUGE_PAGE_SIZE - 1);
+        block->items = fsearch_memory_pool_map_items(mapped_size);
+        if (block->items) {
+            block->mapped_size = mapped_size;
+            capacity = MIN(mapped_size / pool->item_size, UINT32_MAX);
+        }
+    }
+    if (!block->items) {
+        block->items = calloc(capacity, pool->item_size);
+        g_assert(block->items);
+    }
 
     block->num_used = 0;
-    block->capacity = pool->block_size;
+    block->capacity = capacity;
+    pool->capacity += capacity;
     pool->blocks = g_list_prepend(pool->blocks, block);
 }
 
@@ -39,52 +90,123 @@ fsearch_memory_pool_new(uint32_t block_size, size_t item_size, GDestroyNotify it
     FsearchMemoryPool *pool = calloc(1, sizeof(FsearchMemoryPool));
     g_assert(pool);
     pool->item_free_func = item_free_func;
-    pool->block_size = block_size;
+    pool->block_size = MAX(block_size, 1);
     pool->item_size = MAX(item_size, sizeof(FsearchMemoryPoolFreed));
-    fsearch_memory_pool_new_block(pool);
+    pool->ref_count = 1;
 
+    // the first block gets allocated with the first item, so fsearch_memory_pool_reserve can still decide its size
     return pool;
 }
 
+void
+fsearch_memory_pool_set_huge_pages(FsearchMemoryPool *pool, bool huge_pages) {
+    g_assert(pool);
+    pool->huge_pages = huge_pages;
+}
+
+static GHashTable *
+fsearch_memory_pool_get_freed_items(FsearchMemoryPool *pool) {
+    GHashTable *freed_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (FsearchMemoryPoolFreed *freed = pool->freed_items; freed != NULL; freed = freed->next) {
+        g_hash_table_add(freed_items, freed);
+    }
+    return freed_items;
+}
+
 static void
-fsearch_memory_pool_free_block(FsearchMemoryPool *pool, FsearchMemoryPoolBlock *block) {
-    if (pool->item_free_func) {
-        for (int i = 0; i < block->num_used; i++) {
+fsearch_memory_pool_free_block(FsearchMemoryPool *pool,
+                               FsearchMemoryPoolBlock *block,
+                               bool clear_items,
+                               GHashTable *freed_items) {
+    if (clear_items && pool->item_free_func) {
+        for (uint32_t i = 0; i < block->num_used; i++) {
             void *data = block->items + i * pool->item_size;
-            if (!data) {
-                break;
+            // freed items only hold the free list now
+            if (freed_items && g_hash_table_contains(freed_items, data)) {
+                continue;
             }
             pool->item_free_func(data);
         }
     }
+    if (block->mapped_size > 0) {
+        munmap(block->items, block->mapped_size);
+        block->items = NULL;
+    }
     g_clear_pointer(&block->items, free);
     g_clear_pointer(&block, free);
 }
 
-void
-fsearch_memory_pool_free_pool(FsearchMemoryPool *pool) {
-    if (!pool) {
-        return;
+static void
+fsearch_memory_pool_free_blocks(FsearchMemoryPool *pool, bool clear_items) {
+    GHashTable *freed_items = NULL;
+    if (clear_items && pool->item_free_func && pool->freed_items) {
+        freed_items = fsearch_memory_pool_get_freed_items(pool);
     }
     for (GList *b = pool->blocks; b != NULL; b = b->next) {
         FsearchMemoryPoolBlock *block = b->data;
         g_assert(block);
-        fsearch_memory_pool_free_block(pool, g_steal_pointer(&block));
+        fsearch_memory_pool_free_block(pool, g_steal_pointer(&block), clear_items, freed_items);
     }
     pool->freed_items = NULL;
+    pool->capacity = 0;
 
     g_clear_pointer(&pool->blocks, g_list_free);
+    g_clear_pointer(&freed_items, g_hash_table_unref);
+}
+
+void
+fsearch_memory_pool_free_pool(FsearchMemoryPool *pool) {
+    if (!pool) {
+        return;
+    }
+    fsearch_memory_pool_free_blocks(pool, true);
     g_clear_pointer(&pool, free);
 }
 
-bool
-fsearch_memory_pool_is_block_full(FsearchMemoryPool *pool) {
+void
+fsearch_memory_pool_reset(FsearchMemoryPool *pool) {
+    if (!pool) {
+        return;
+    }
+    fsearch_memory_pool_free_blocks(pool, false);
+}
+
+FsearchMemoryPool *
+fsearch_memory_pool_ref(FsearchMemoryPool *pool) {
+    if (!pool || g_atomic_int_get(&pool->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&pool->ref_count);
+    return pool;
+}
+
+void
+fsearch_memory_pool_unref(FsearchMemoryPool *pool) {
+    if (!pool || g_atomic_int_get(&pool->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&pool->ref_count)) {
+        g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+    }
+}
+
+static uint32_t
+fsearch_memory_pool_get_num_unused(FsearchMemoryPool *pool) {
+    if (!pool->blocks) {
+        return 0;
+    }
     FsearchMemoryPoolBlock *block = pool->blocks->data;
     g_assert(block);
-    if (block->num_used < block->capacity) {
-        return false;
+    return block->capacity - block->num_used;
+}
+
+void
+fsearch_memory_pool_reserve(FsearchMemoryPool *pool, uint32_t num_items) {
+    g_assert(pool);
+    if (num_items == 0 || fsearch_memory_pool_get_num_unused(pool) >= num_items) {
+        return;
     }
-    return true;
+    fsearch_memory_pool_new_block(pool, num_items);
 }
 
 void
@@ -108,14 +230,56 @@ fsearch_memory_pool_malloc(FsearchMemoryPool *pool) {
     if (pool->freed_items) {
         void *freed_head = pool->freed_items;
         pool->freed_items = pool->freed_items->next;
+        // like all other items it's handed out zeroed
+        memset(freed_head, 0, pool->item_size);
         return freed_head;
     }
 
-    if (!pool->blocks || fsearch_memory_pool_is_block_full(pool)) {
-        fsearch_memory_pool_new_block(pool);
+    if (fsearch_memory_pool_get_num_unused(pool) == 0) {
+        // the pool doubles in size with every block
+        const size_t max_block_size = MAX(MEMORY_POOL_MAX_BLOCK_SIZE / pool->item_size, pool->block_size);
+        fsearch_memory_pool_new_block(pool, CLAMP(pool->capacity, pool->block_size, max_block_size));
     }
     FsearchMemoryPoolBlock *block = pool->blocks->data;
     g_assert(block);
 
     return block->items + block->num_used++ * pool->item_size;
 }
+
+void
+fsearch_memory_pool_merge(FsearchMemoryPool *pool, FsearchMemoryPool *other) {
+    if (!pool || !other) {
+        return;
+    }
+    g_assert(pool->item_size == other->item_size);
+
+    // The first block of a pool is the one new items get allocated from,
+    // so the blocks of the other pool are appended behind it.
+    pool->blocks = g_list_concat(pool->blocks, g_steal_pointer(&other->blocks));
+    pool->capacity += other->capacity;
+
+    if (other->freed_items) {
+        FsearchMemoryPoolFreed *last = other->freed_items;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = pool->freed_items;
+        pool->freed_items = g_steal_pointer(&other->freed_items);
+    }
+
+    g_clear_pointer(&other, free);
+}
+
+size_t
+fsearch_memory_pool_get_memory_usage(FsearchMemoryPool *pool) {
+    if (!pool) {
+        return 0;
+    }
+    size_t size = sizeof(FsearchMemoryPool);
+    for (GList *b = pool->blocks; b != NULL; b = b->next) {
+        FsearchMemoryPoolBlock *block = b->data;
+        size += sizeof(FsearchMemoryPoolBlock)
+              + (block->mapped_size > 0 ? block->mapped_size : (size_t)block->capacity * pool->item_size);
+    }
+    return size;
+}
@@ -5,16 +5,47 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+// Hands out zeroed items of a fixed size from large blocks. Freed items are kept in a free list and handed out
+// again before new ones.
 typedef struct FsearchMemoryPool FsearchMemoryPool;
 
+// block_size is the number of items of the first block, every further block is as large as all previous ones
+// together, up to a limit. That way the number of blocks stays small no matter how many items the pool holds.
 FsearchMemoryPool *
 fsearch_memory_pool_new(uint32_t block_size, size_t item_size, GDestroyNotify item_free_func);
 
+// Back blocks which are allocated afterwards with huge pages if they're large enough. Explicitly reserved huge
+// pages are used if there are any, otherwise transparent huge pages are requested for them.
+void
+fsearch_memory_pool_set_huge_pages(FsearchMemoryPool *pool, bool huge_pages);
+
+// Makes sure the next num_items items come from a single block, e.g. because the number of items is known
+// upfront. Unused items of the current block are lost if it has less room than that.
+void
+fsearch_memory_pool_reserve(FsearchMemoryPool *pool, uint32_t num_items);
+
 void
 fsearch_memory_pool_free(FsearchMemoryPool *pool, void *item, bool item_clear);
 
 void
 fsearch_memory_pool_free_pool(FsearchMemoryPool *pool);
 
+// Releases all items at once, without calling item_free_func for them. The pool can be used again afterwards.
+void
+fsearch_memory_pool_reset(FsearchMemoryPool *pool);
+
+FsearchMemoryPool *
+fsearch_memory_pool_ref(FsearchMemoryPool *pool);
+
+void
+fsearch_memory_pool_unref(FsearchMemoryPool *pool);
+
 void *
 fsearch_memory_pool_malloc(FsearchMemoryPool *pool);
+
+void
+fsearch_memory_pool_merge(FsearchMemoryPool *pool, FsearchMemoryPool *other);
+
+// Returns the number of bytes allocated for the blocks of pool, including unused and freed items
+size_t
+fsearch_memory_pool_get_memory_usage(FsearchMemoryPool *pool);
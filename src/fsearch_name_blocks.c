@@ -0,0 +1,197 @@
+#include "fsearch_name_blocks.h"
+
+#include <glib.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the number of names per block, every block starts with a full name
+#define NAME_BLOCKS_BLOCK_SIZE 32
+// Every name is stored as a record: the length of the prefix it shares with the previous name, the length of the
+// rest, the distance of the record to the start of its block (2 bytes) and the rest of the name (not NUL
+// terminated).
+#define NAME_BLOCKS_RECORD_HEADER_SIZE 4
+#define NAME_BLOCKS_MAX_RECORD_SIZE (NAME_BLOCKS_RECORD_HEADER_SIZE + NAME_BLOCKS_MAX_NAME_LEN)
+#define NAME_BLOCKS_CHUNK_SIZE (256 * 1024)
+
+typedef struct {
+    size_t num_used;
+    char data[NAME_BLOCKS_CHUNK_SIZE];
+} FsearchNameBlocksChunk;
+
+struct FsearchNameBlocks {
+    // the first chunk is the one new names get added to
+    GList *chunks;
+    const char *block_start;
+    uint32_t num_block_names;
+    // the name which was added last
+    char prev_name[NAME_BLOCKS_MAX_NAME_LEN + 1];
+    size_t prev_name_len;
+
+    volatile int ref_count;
+};
+
+typedef struct {
+    // the record decoded last on this thread and its name
+    const char *cursor;
+    char cursor_name[NAME_BLOCKS_MAX_NAME_LEN + 1];
+    // see name_blocks_generation
+    int generation;
+
+    char decoded[NAME_BLOCKS_NUM_DECODED][NAME_BLOCKS_MAX_NAME_LEN + 1];
+    uint32_t next_decoded;
+} FsearchNameBlocksDecoder;
+
+static GPrivate decoder_private = G_PRIVATE_INIT(free);
+// Incremented whenever names get freed. The cursors of all threads are outdated then, the memory they point
+// to might hold other names by now.
+static volatile int name_blocks_generation = 0;
+
+FsearchNameBlocks *
+fsearch_name_blocks_new(void) {
+    FsearchNameBlocks *blocks = calloc(1, sizeof(FsearchNameBlocks));
+    g_assert(blocks);
+    blocks->ref_count = 1;
+    return blocks;
+}
+
+static void
+fsearch_name_blocks_free(FsearchNameBlocks *blocks) {
+    if (!blocks) {
+        return;
+    }
+    g_list_free_full(g_steal_pointer(&blocks->chunks), free);
+    g_clear_pointer(&blocks, free);
+    g_atomic_int_inc(&name_blocks_generation);
+}
+
+FsearchNameBlocks *
+fsearch_name_blocks_ref(FsearchNameBlocks *blocks) {
+    if (!blocks || g_atomic_int_get(&blocks->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&blocks->ref_count);
+    return blocks;
+}
+
+void
+fsearch_name_blocks_unref(FsearchNameBlocks *blocks) {
+    if (!blocks || g_atomic_int_get(&blocks->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&blocks->ref_count)) {
+        g_clear_pointer(&blocks, fsearch_name_blocks_free);
+    }
+}
+
+static void
+fsearch_name_blocks_start_block(FsearchNameBlocks *blocks) {
+    FsearchNameBlocksChunk *chunk = blocks->chunks ? blocks->chunks->data : NULL;
+    // a block never spans chunks, so the distance of its records to its start is small
+    if (!chunk || NAME_BLOCKS_CHUNK_SIZE - chunk->num_used < NAME_BLOCKS_BLOCK_SIZE * NAME_BLOCKS_MAX_RECORD_SIZE) {
+        chunk = malloc(sizeof(FsearchNameBlocksChunk));
+        g_assert(chunk);
+        chunk->num_used = 0;
+        blocks->chunks = g_list_prepend(blocks->chunks, chunk);
+    }
+    blocks->block_start = chunk->data + chunk->num_used;
+    blocks->num_block_names = 0;
+    blocks->prev_name_len = 0;
+}
+
+const char *
+fsearch_name_blocks_add(FsearchNameBlocks *blocks, const char *name) {
+    g_assert(blocks);
+    g_assert(name);
+
+    const size_t len = strlen(name);
+    if (len > NAME_BLOCKS_MAX_NAME_LEN) {
+        return NULL;
+    }
+    if (!blocks->block_start || blocks->num_block_names == NAME_BLOCKS_BLOCK_SIZE) {
+        fsearch_name_blocks_start_block(blocks);
+    }
+
+    size_t prefix_len = 0;
+    const size_t max_prefix_len = MIN(len, blocks->prev_name_len);
+    while (prefix_len < max_prefix_len && blocks->prev_name[prefix_len] == name[prefix_len]) {
+        prefix_len++;
+    }
+    const size_t suffix_len = len - prefix_len;
+
+    FsearchNameBlocksChunk *chunk = blocks->chunks->data;
+    uint8_t *record = (uint8_t *)chunk->data + chunk->num_used;
+    const size_t distance = (const char *)record - blocks->block_start;
+    record[0] = prefix_len;
+    record[1] = suffix_len;
+    record[2] = distance & 0xff;
+    record[3] = distance >> 8;
+    memcpy(record + NAME_BLOCKS_RECORD_HEADER_SIZE, name + prefix_len, suffix_len);
+    chunk->num_used += NAME_BLOCKS_RECORD_HEADER_SIZE + suffix_len;
+
+    memcpy(blocks->prev_name + prefix_len, name + prefix_len, suffix_len);
+    blocks->prev_name_len = len;
+    blocks->num_block_names++;
+
+    return (const char *)record;
+}
+
+static inline const uint8_t *
+record_get_next(const uint8_t *record) {
+    return record + NAME_BLOCKS_RECORD_HEADER_SIZE + record[1];
+}
+
+static inline void
+record_apply(const uint8_t *record, char *name) {
+    memcpy(name + record[0], record + NAME_BLOCKS_RECORD_HEADER_SIZE, record[1]);
+}
+
+static FsearchNameBlocksDecoder *
+get_decoder(void) {
+    FsearchNameBlocksDecoder *decoder = g_private_get(&decoder_private);
+    if (G_UNLIKELY(!decoder)) {
+        decoder = calloc(1, sizeof(FsearchNameBlocksDecoder));
+        g_assert(decoder);
+        g_private_set(&decoder_private, decoder);
+    }
+    return decoder;
+}
+
+const char *
+fsearch_name_blocks_decode(const char *handle) {
+    g_assert(handle);
+
+    FsearchNameBlocksDecoder *decoder = get_decoder();
+    const uint8_t *target = (const uint8_t *)handle;
+    const uint8_t *block_start = target - (target[2] | target[3] << 8);
+
+    // The cursor can only be used if it's in front of target in the same block. Every record between the start of
+    // the block and target belongs to that block.
+    const uint8_t *cursor = (const uint8_t *)decoder->cursor;
+    const int generation = g_atomic_int_get(&name_blocks_generation);
+    if (!cursor || decoder->generation != generation || cursor < block_start || cursor > target) {
+        cursor = block_start;
+        record_apply(cursor, decoder->cursor_name);
+    }
+    while (cursor != target) {
+        cursor = record_get_next(cursor);
+        record_apply(cursor, decoder->cursor_name);
+    }
+    decoder->cursor = handle;
+    decoder->generation = generation;
+
+    const size_t len = target[0] + target[1];
+    char *name = decoder->decoded[decoder->next_decoded];
+    decoder->next_decoded = (decoder->next_decoded + 1) % NAME_BLOCKS_NUM_DECODED;
+    memcpy(name, decoder->cursor_name, len);
+    name[len] = '\0';
+    return name;
+}
+
+size_t
+fsearch_name_blocks_get_memory_usage(FsearchNameBlocks *blocks) {
+    if (!blocks) {
+        return 0;
+    }
+    return sizeof(FsearchNameBlocks) + g_list_length(blocks->chunks) * sizeof(FsearchNameBlocksChunk);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Front coded names: every name only stores the part which differs from the name in front of it, apart from the
+// first name of every block of a few dozen names, which is stored in full. Names which get added in sorted order
+// share long prefixes (e.g. IMG_2023…), so that takes much less memory than storing every name on its own.
+//
+// Names are referred to by the handles fsearch_name_blocks_add returns. Decoding a name walks its block up to it.
+// Every thread remembers the name it decoded last, so going through the names in the order they were added only
+// decodes the part of every name which differs from the previous one.
+typedef struct FsearchNameBlocks FsearchNameBlocks;
+
+// the longest name which can be front coded, as long as the longest file name on most systems
+#define NAME_BLOCKS_MAX_NAME_LEN 255
+// how many names returned by fsearch_name_blocks_decode stay valid on the same thread
+#define NAME_BLOCKS_NUM_DECODED 16
+
+FsearchNameBlocks *
+fsearch_name_blocks_new(void);
+
+FsearchNameBlocks *
+fsearch_name_blocks_ref(FsearchNameBlocks *blocks);
+
+void
+fsearch_name_blocks_unref(FsearchNameBlocks *blocks);
+
+// Appends name and returns its handle, which stays valid as long as blocks does. Returns NULL if name is longer
+// than NAME_BLOCKS_MAX_NAME_LEN bytes. The pool isn't thread safe.
+const char *
+fsearch_name_blocks_add(FsearchNameBlocks *blocks, const char *name);
+
+// Returns the name handle refers to. It's stored in a buffer of the calling thread, which gets reused once
+// NAME_BLOCKS_NUM_DECODED further names were decoded on that thread. Names can be decoded by several threads at once.
+const char *
+fsearch_name_blocks_decode(const char *handle);
+
+// Returns the number of bytes allocated for the names
+size_t
+fsearch_name_blocks_get_memory_usage(FsearchNameBlocks *blocks);
@@ -0,0 +1,281 @@
+#define G_LOG_DOMAIN "fsearch-name-index"
+
+#include "fsearch_name_index.h"
+#include "fsearch_database_entry.h"
+#include "fsearch_index_delta.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the names are hashed in ranges of this many entries
+#define NAME_INDEX_GRAIN_SIZE (1 << 16)
+
+typedef struct {
+    FsearchIndexDeltaTable table;
+    // open addressing table of the hashes, every slot holds the number of a group plus one, or 0 if it's empty
+    uint32_t *slots;
+    uint32_t slot_mask;
+    // the entries of group g have names with the hash group_hashes[g], their positions are stored at
+    // positions[group_offsets[g]]..positions[group_offsets[g + 1]]
+    uint64_t *group_hashes;
+    uint32_t *group_offsets;
+    uint32_t num_groups;
+    uint32_t *positions;
+} NameTable;
+
+struct FsearchNameIndex {
+    FsearchIndexDelta delta;
+
+    volatile int ref_count;
+};
+
+typedef struct {
+    NameTable *table;
+    // 0 for entries without a name
+    uint64_t *hashes;
+} NameHashContext;
+
+static uint64_t
+name_hash(const char *name, size_t len) {
+    // FNV-1a of the folded name, the finalizer of MurmurHash3 spreads it over the slots
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)g_ascii_tolower(name[i]);
+        h *= UINT64_C(0x100000001b3);
+    }
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    // 0 marks entries without a name, sharing the hash of another name only adds candidates
+    return h ? h : 1;
+}
+
+static void
+name_hash_range(uint32_t start, uint32_t end, void *data) {
+    NameHashContext *ctx = data;
+    for (uint32_t pos = start; pos < end; pos++) {
+        FsearchDatabaseEntry *entry = darray_get_item(ctx->table->table.entries, pos);
+        const char *name = entry ? db_entry_get_name_raw(entry) : NULL;
+        ctx->hashes[pos] = name ? name_hash(name, strlen(name)) : 0;
+    }
+}
+
+// Returns the slot of hash, which is either empty or holds the group with that hash
+static uint32_t
+name_table_find_slot(NameTable *table, uint64_t hash) {
+    uint32_t slot = (uint32_t)hash & table->slot_mask;
+    while (table->slots[slot] && table->group_hashes[table->slots[slot] - 1] != hash) {
+        slot = (slot + 1) & table->slot_mask;
+    }
+    return slot;
+}
+
+static FsearchIndexDeltaTable *
+name_table_new(DynamicArray *entries, FsearchThreadPool *pool) {
+    NameTable *table = calloc(1, sizeof(NameTable));
+    g_assert(table);
+    fsearch_index_delta_table_init(&table->table, entries);
+
+    const uint32_t num_entries = table->table.num_entries;
+    NameHashContext ctx = {
+        .table = table,
+        .hashes = malloc(MAX(num_entries, 1) * sizeof(uint64_t)),
+    };
+    g_assert(ctx.hashes);
+    fsearch_thread_pool_parallel_for(pool, 0, num_entries, NAME_INDEX_GRAIN_SIZE, name_hash_range, &ctx);
+
+    // at most three out of four slots are used
+    uint64_t num_slots = 16;
+    while (num_slots / 4 * 3 < num_entries) {
+        num_slots *= 2;
+    }
+    table->slot_mask = (uint32_t)(num_slots - 1);
+    table->slots = calloc(num_slots, sizeof(uint32_t));
+    g_assert(table->slots);
+    table->group_hashes = malloc(MAX(num_entries, 1) * sizeof(uint64_t));
+    g_assert(table->group_hashes);
+    // the number of entries of group g is counted in group_offsets[g + 1] first
+    table->group_offsets = calloc(num_entries + 1, sizeof(uint32_t));
+    g_assert(table->group_offsets);
+
+    // the group of every entry, UINT32_MAX for the ones without a name
+    uint32_t *groups = malloc(MAX(num_entries, 1) * sizeof(uint32_t));
+    g_assert(groups);
+    for (uint32_t pos = 0; pos < num_entries; pos++) {
+        const uint64_t hash = ctx.hashes[pos];
+        if (!hash) {
+            groups[pos] = UINT32_MAX;
+            continue;
+        }
+        const uint32_t slot = name_table_find_slot(table, hash);
+        if (!table->slots[slot]) {
+            table->group_hashes[table->num_groups] = hash;
+            table->slots[slot] = ++table->num_groups;
+        }
+        groups[pos] = table->slots[slot] - 1;
+        table->group_offsets[groups[pos] + 1]++;
+    }
+    g_clear_pointer(&ctx.hashes, free);
+
+    for (uint32_t g = 1; g <= table->num_groups; g++) {
+        table->group_offsets[g] += table->group_offsets[g - 1];
+    }
+    table->group_hashes = realloc(table->group_hashes, MAX(table->num_groups, 1) * sizeof(uint64_t));
+    g_assert(table->group_hashes);
+    table->group_offsets = realloc(table->group_offsets, (table->num_groups + 1) * sizeof(uint32_t));
+    g_assert(table->group_offsets);
+
+    // the entries are visited in order, so the positions of every group are sorted
+    const uint32_t num_positions = table->group_offsets[table->num_groups];
+    table->positions = malloc(MAX(num_positions, 1) * sizeof(uint32_t));
+    g_assert(table->positions);
+    uint32_t *next = malloc(MAX(table->num_groups, 1) * sizeof(uint32_t));
+    g_assert(next);
+    memcpy(next, table->group_offsets, table->num_groups * sizeof(uint32_t));
+    for (uint32_t pos = 0; pos < num_entries; pos++) {
+        if (groups[pos] != UINT32_MAX) {
+            table->positions[next[groups[pos]]++] = pos;
+        }
+    }
+    g_clear_pointer(&next, free);
+    g_clear_pointer(&groups, free);
+
+    return &table->table;
+}
+
+static void
+name_table_free(FsearchIndexDeltaTable *delta_table) {
+    NameTable *table = (NameTable *)delta_table;
+    g_clear_pointer(&table->table.entries, darray_unref);
+    g_clear_pointer(&table->slots, free);
+    g_clear_pointer(&table->group_hashes, free);
+    g_clear_pointer(&table->group_offsets, free);
+    g_clear_pointer(&table->positions, free);
+    g_clear_pointer(&table, free);
+}
+
+static size_t
+name_table_get_memory_usage(FsearchIndexDeltaTable *delta_table) {
+    NameTable *table = (NameTable *)delta_table;
+    return sizeof(NameTable) + ((size_t)table->slot_mask + 1) * sizeof(uint32_t)
+         + table->num_groups * (sizeof(uint64_t) + sizeof(uint32_t))
+         + table->group_offsets[table->num_groups] * sizeof(uint32_t);
+}
+
+// Returns the positions of the entries whose name has the hash query points to
+static uint32_t *
+name_table_lookup(FsearchIndexDeltaTable *delta_table, const void *query, uint32_t *num_positions) {
+    NameTable *table = (NameTable *)delta_table;
+    *num_positions = 0;
+    const uint32_t group = table->slots[name_table_find_slot(table, *(const uint64_t *)query)];
+    if (!group) {
+        return NULL;
+    }
+    const uint32_t offset = table->group_offsets[group - 1];
+    *num_positions = table->group_offsets[group] - offset;
+    uint32_t *positions = malloc(*num_positions * sizeof(uint32_t));
+    g_assert(positions);
+    memcpy(positions, table->positions + offset, *num_positions * sizeof(uint32_t));
+    return positions;
+}
+
+static const FsearchIndexDeltaFuncs name_table_funcs = {
+    .table_new = name_table_new,
+    .table_free = name_table_free,
+    .table_lookup = name_table_lookup,
+    .table_get_memory_usage = name_table_get_memory_usage,
+};
+
+static FsearchNameIndex *
+name_index_new(void) {
+    FsearchNameIndex *index = calloc(1, sizeof(FsearchNameIndex));
+    g_assert(index);
+    index->ref_count = 1;
+    return index;
+}
+
+FsearchNameIndex *
+fsearch_name_index_new(DynamicArray *entries, FsearchThreadPool *pool) {
+    g_assert(entries);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    NameTable *table = (NameTable *)name_table_new(entries, pool);
+    g_debug("[name_index] indexed %d entries with %d names in %f s",
+            table->table.num_entries,
+            table->num_groups,
+            g_timer_elapsed(timer, NULL));
+
+    FsearchNameIndex *index = name_index_new();
+    fsearch_index_delta_init(&index->delta, &name_table_funcs, &table->table, entries);
+    return index;
+}
+
+FsearchNameIndex *
+fsearch_name_index_new_updated(FsearchNameIndex *index,
+                               DynamicArray *entries,
+                               DynamicArray *added_entries,
+                               FsearchThreadPool *pool) {
+    g_assert(entries);
+    if (!index) {
+        return fsearch_name_index_new(entries, pool);
+    }
+
+    FsearchNameIndex *updated = name_index_new();
+    if (!fsearch_index_delta_init_updated(&updated->delta, &index->delta, entries, added_entries, pool)) {
+        g_clear_pointer(&updated, free);
+        return fsearch_name_index_new(entries, pool);
+    }
+    return updated;
+}
+
+FsearchNameIndex *
+fsearch_name_index_ref(FsearchNameIndex *index) {
+    if (!index || g_atomic_int_get(&index->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&index->ref_count);
+    return index;
+}
+
+void
+fsearch_name_index_unref(FsearchNameIndex *index) {
+    if (!index || g_atomic_int_get(&index->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&index->ref_count)) {
+        fsearch_index_delta_clear(&index->delta);
+        g_clear_pointer(&index, free);
+    }
+}
+
+DynamicArray *
+fsearch_name_index_get_entries(FsearchNameIndex *index) {
+    g_assert(index);
+    return index->delta.entries;
+}
+
+size_t
+fsearch_name_index_get_memory_usage(FsearchNameIndex *index) {
+    if (!index) {
+        return 0;
+    }
+    return sizeof(FsearchNameIndex) + fsearch_index_delta_get_memory_usage(&index->delta);
+}
+
+void
+fsearch_name_index_lookup(FsearchNameIndex *index,
+                          const char *name,
+                          size_t name_len,
+                          uint32_t **positions,
+                          uint32_t *num_positions) {
+    g_assert(index);
+    g_assert(name);
+    g_assert(positions);
+    g_assert(num_positions);
+
+    const uint64_t hash = name_hash(name, name_len);
+    fsearch_index_delta_lookup(&index->delta, &hash, positions, num_positions);
+}
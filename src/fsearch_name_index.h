@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_thread_pool.h"
+
+// Maps the names of the entries, with ASCII letters folded to lower case, to the sorted list of positions of the
+// entries with that name. This lets exact name searches (e.g. exact:CMakeLists.txt) visit only the entries with
+// that name instead of comparing all of them.
+//
+// Names are only kept as 64-bit hashes, so a lookup can return a few entries with other names, which the matchers
+// rule out. Like the trigram index, lookups return positions in the entry array the index belongs to, which
+// requires the idx of every entry to be its position in that array.
+typedef struct FsearchNameIndex FsearchNameIndex;
+
+// Builds the index for entries, the names are hashed by the threads of pool (if it's not NULL).
+FsearchNameIndex *
+fsearch_name_index_new(DynamicArray *entries, FsearchThreadPool *pool);
+
+// Returns an index for entries, which contain all entries of the array index was built for (apart from removed
+// ones) and the ones in added_entries. Like fsearch_trigram_index_new_updated, only the added entries are indexed
+// until they make up a significant part of the index.
+FsearchNameIndex *
+fsearch_name_index_new_updated(FsearchNameIndex *index,
+                               DynamicArray *entries,
+                               DynamicArray *added_entries,
+                               FsearchThreadPool *pool);
+
+FsearchNameIndex *
+fsearch_name_index_ref(FsearchNameIndex *index);
+
+void
+fsearch_name_index_unref(FsearchNameIndex *index);
+
+// The array the positions returned by fsearch_name_index_lookup refer to
+DynamicArray *
+fsearch_name_index_get_entries(FsearchNameIndex *index);
+
+size_t
+fsearch_name_index_get_memory_usage(FsearchNameIndex *index);
+
+// Looks up the candidates for entries named name (ignoring the case of ASCII letters). *positions is set to their
+// sorted positions, which must be freed with free (it's NULL if there are none).
+void
+fsearch_name_index_lookup(FsearchNameIndex *index,
+                          const char *name,
+                          size_t name_len,
+                          uint32_t **positions,
+                          uint32_t *num_positions);
@@ -0,0 +1,144 @@
+#include <config.h>
+
+#include "fsearch_operation_stats.h"
+#include "fsearch_trace.h"
+
+#include <glib/gi18n.h>
+#include <inttypes.h>
+
+void
+fsearch_operation_timer_start(FsearchOperationTimer *timer, FsearchThreadPool *pool) {
+    g_assert(timer);
+    timer->pool = pool;
+    timer->start_time = g_get_monotonic_time();
+    timer->start_busy_time = fsearch_thread_pool_get_busy_time(pool);
+    timer->lock_wait_time = 0;
+}
+
+void
+fsearch_operation_timer_lock(FsearchOperationTimer *timer, GMutex *mutex) {
+    g_assert(timer);
+    if (g_mutex_trylock(mutex)) {
+        return;
+    }
+    const int64_t start = g_get_monotonic_time();
+    g_mutex_lock(mutex);
+    const int64_t end = g_get_monotonic_time();
+    timer->lock_wait_time += end - start;
+    fsearch_trace_add("lock", "operation lock wait", start, end);
+}
+
+void
+fsearch_operation_timer_finish(FsearchOperationTimer *timer,
+                               uint64_t num_entries,
+                               uint64_t num_results,
+                               FsearchOperationStats *stats) {
+    g_assert(timer);
+    g_assert(stats);
+    stats->finish_time = g_get_monotonic_time();
+    stats->num_entries = num_entries;
+    stats->num_results = num_results;
+    stats->wall_ms = (double)(stats->finish_time - timer->start_time) / 1000;
+    stats->lock_wait_ms = (double)timer->lock_wait_time / 1000;
+    if (timer->pool) {
+        stats->num_threads = fsearch_thread_pool_get_num_threads(timer->pool);
+        stats->thread_ms = (double)(fsearch_thread_pool_get_busy_time(timer->pool) - timer->start_busy_time) / 1000;
+    }
+    else {
+        // it ran on the calling thread only
+        stats->num_threads = 1;
+        stats->thread_ms = MAX(stats->wall_ms - stats->lock_wait_ms, 0);
+    }
+}
+
+char *
+fsearch_operation_stats_format_count(uint64_t count) {
+    if (count < 1000) {
+        return g_strdup_printf("%" PRIu64, count);
+    }
+    const char *suffixes[] = {"K", "M", "G", "T"};
+    uint32_t i = 0;
+    double value = (double)count / 1000;
+    // values which would be rounded up to 1000 get the next suffix
+    while (value >= 999.5 && i < G_N_ELEMENTS(suffixes) - 1) {
+        value /= 1000;
+        i++;
+    }
+    return value < 9.95 ? g_strdup_printf("%.1f%s", value, suffixes[i])
+                        : g_strdup_printf("%.0f%s", value, suffixes[i]);
+}
+
+char *
+fsearch_operation_stats_format_duration(double ms) {
+    if (ms < 9.95) {
+        return g_strdup_printf(_("%.1f ms"), ms);
+    }
+    if (ms < 999.5) {
+        return g_strdup_printf(_("%.0f ms"), ms);
+    }
+    return g_strdup_printf(_("%.1f s"), ms / 1000);
+}
+
+static const char *
+get_operation_name(FsearchOperation operation) {
+    switch (operation) {
+    case FSEARCH_OPERATION_SEARCH:
+        return _("Search");
+    case FSEARCH_OPERATION_SORT:
+        return _("Sort");
+    case FSEARCH_OPERATION_SCAN:
+        return _("Scan");
+    case FSEARCH_OPERATION_LOAD:
+        return _("Load");
+    case FSEARCH_OPERATION_SAVE:
+        return _("Save");
+    default:
+        return NULL;
+    }
+}
+
+char *
+fsearch_operation_stats_get_summary(const FsearchOperationStats *stats, FsearchOperation operation) {
+    g_assert(stats);
+    g_autofree char *count = fsearch_operation_stats_format_count(stats->num_results);
+    g_autofree char *duration = fsearch_operation_stats_format_duration(stats->wall_ms);
+    const bool one = stats->num_results == 1;
+    switch (operation) {
+    case FSEARCH_OPERATION_SEARCH:
+        return g_strdup_printf(one ? _("%s result in %s") : _("%s results in %s"), count, duration);
+    case FSEARCH_OPERATION_SORT:
+        return g_strdup_printf(one ? _("%s result sorted in %s") : _("%s results sorted in %s"), count, duration);
+    default:
+        return g_strdup_printf(one ? _("%s entry in %s") : _("%s entries in %s"), count, duration);
+    }
+}
+
+char *
+fsearch_operation_stats_get_details(const FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS]) {
+    g_assert(stats);
+    GString *details = g_string_new(NULL);
+    for (uint32_t i = 0; i < NUM_FSEARCH_OPERATIONS; i++) {
+        const FsearchOperationStats *s = &stats[i];
+        if (!s->finish_time) {
+            continue;
+        }
+        g_autofree char *num_entries = fsearch_operation_stats_format_count(s->num_entries);
+        g_autofree char *num_results = fsearch_operation_stats_format_count(s->num_results);
+        g_autofree char *wall = fsearch_operation_stats_format_duration(s->wall_ms);
+        g_autofree char *threads = fsearch_operation_stats_format_duration(s->thread_ms);
+        g_autofree char *lock_wait = fsearch_operation_stats_format_duration(s->lock_wait_ms);
+        if (details->len > 0) {
+            g_string_append_c(details, '\n');
+        }
+        g_string_append_printf(details,
+                               _("%s: %s entries, %s results in %s, %s on %u threads, %s waiting for locks"),
+                               get_operation_name(i),
+                               num_entries,
+                               num_results,
+                               wall,
+                               threads,
+                               s->num_threads,
+                               lock_wait);
+    }
+    return g_string_free(details, FALSE);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_thread_pool.h"
+
+typedef enum {
+    FSEARCH_OPERATION_SEARCH,
+    FSEARCH_OPERATION_SORT,
+    FSEARCH_OPERATION_SCAN,
+    FSEARCH_OPERATION_LOAD,
+    FSEARCH_OPERATION_SAVE,
+    NUM_FSEARCH_OPERATIONS,
+} FsearchOperation;
+
+// What the latest run of an operation did and where its time went
+typedef struct {
+    // monotonic time the operation finished at, 0 if it didn't finish yet
+    int64_t finish_time;
+    // the entries which were looked at and the ones it ended up with, e.g. the matches of a search
+    uint64_t num_entries;
+    uint64_t num_results;
+    double wall_ms;
+    // summed up over all threads of the pool it ran on, wall_ms times the number of threads at most
+    double thread_ms;
+    uint32_t num_threads;
+    // how long it waited for the locks of the database or the view
+    double lock_wait_ms;
+} FsearchOperationStats;
+
+// Measures an operation from start to finish
+typedef struct {
+    FsearchThreadPool *pool;
+    int64_t start_time;
+    int64_t start_busy_time;
+    int64_t lock_wait_time;
+} FsearchOperationTimer;
+
+void
+fsearch_operation_timer_start(FsearchOperationTimer *timer, FsearchThreadPool *pool);
+
+// Locks mutex and counts the time until it got it as waiting for locks
+void
+fsearch_operation_timer_lock(FsearchOperationTimer *timer, GMutex *mutex);
+
+void
+fsearch_operation_timer_finish(FsearchOperationTimer *timer,
+                               uint64_t num_entries,
+                               uint64_t num_results,
+                               FsearchOperationStats *stats);
+
+// Returns a short summary like "1.2M results in 38 ms"
+char *
+fsearch_operation_stats_get_summary(const FsearchOperationStats *stats, FsearchOperation operation);
+
+// Returns one line with all numbers for every operation in stats which finished
+char *
+fsearch_operation_stats_get_details(const FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS]);
+
+// Returns compact counts like "512", "38K" or "1.2M"
+char *
+fsearch_operation_stats_format_count(uint64_t count);
+
+char *
+fsearch_operation_stats_format_duration(double ms);
@@ -19,6 +19,7 @@
 #define G_LOG_DOMAIN "fsearch-preferences-ui"
 
 #include "fsearch_preferences_ui.h"
+#include "fsearch.h"
 #include "fsearch_exclude_path.h"
 #include "fsearch_filter_editor.h"
 #include "fsearch_index.h"
@@ -81,6 +82,7 @@ typedef struct {
     GtkBox *auto_update_spin_box;
     GtkWidget *auto_update_hours_spin_button;
     GtkWidget *auto_update_minutes_spin_button;
+    GtkWidget *memory_usage_label;
 
     // Dialog page
     GtkToggleButton *show_dialog_failed_opening;
@@ -712,6 +714,14 @@ preferences_ui_init(FsearchPreferencesInterface *ui, FsearchPreferencesPage page
     gtk_widget_set_sensitive(GTK_WIDGET(ui->auto_update_spin_box), new_config->update_database_every);
     g_signal_connect(ui->auto_update_checkbox, "toggled", G_CALLBACK(on_toggle_set_sensitive), ui->auto_update_spin_box);
 
+    ui->memory_usage_label = builder_init_widget(ui->builder, "memory_usage_label", "help_memory_usage");
+    g_autofree char *memory_usage = fsearch_application_get_memory_usage_report(FSEARCH_APPLICATION_DEFAULT);
+    if (memory_usage) {
+        g_autofree char *memory_usage_text = g_strdup_printf(_("Memory usage:\n%s"), g_strchomp(memory_usage));
+        gtk_label_set_text(GTK_LABEL(ui->memory_usage_label), memory_usage_text);
+    }
+    gtk_widget_set_visible(ui->memory_usage_label, memory_usage != NULL);
+
     ui->auto_update_hours_spin_button =
         builder_init_widget(ui->builder, "auto_update_hours_spin_button", "help_update_database_every");
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(ui->auto_update_hours_spin_button),
@@ -19,12 +19,73 @@
 #include "fsearch_preview.h"
 #include "fsearch.h"
 
+#include <fcntl.h>
 #include <gio/gio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define PREVIEWER_DBUS_NAME "org.gnome.NautilusPreviewer"
 #define PREVIEWER_DBUS_IFACE "org.gnome.NautilusPreviewer"
 #define PREVIEWER_DBUS_PATH "/org/gnome/NautilusPreviewer"
 
+// how much of a single file and of all files of one prefetch is read ahead
+#define PREFETCH_MAX_FILE_SIZE (16 * 1024 * 1024)
+#define PREFETCH_MAX_TOTAL_SIZE (32 * 1024 * 1024)
+
+static bool preview_visible = false;
+static GCancellable *prefetch_cancellable = NULL;
+
+static void
+prefetch_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    GPtrArray *paths = task_data;
+    off_t remaining = PREFETCH_MAX_TOTAL_SIZE;
+    for (guint i = 0; i < paths->len && remaining > 0; i++) {
+        if (g_cancellable_is_cancelled(cancellable)) {
+            break;
+        }
+        const int fd = open(g_ptr_array_index(paths, i), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            const off_t len = MIN(st.st_size, MIN(PREFETCH_MAX_FILE_SIZE, remaining));
+            // only starts the reads, it doesn't wait for them
+            posix_fadvise(fd, 0, len, POSIX_FADV_WILLNEED);
+            remaining -= len;
+        }
+        close(fd);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+void
+fsearch_preview_prefetch_cancel(void) {
+    if (prefetch_cancellable) {
+        g_cancellable_cancel(prefetch_cancellable);
+        g_clear_object(&prefetch_cancellable);
+    }
+}
+
+void
+fsearch_preview_prefetch(GPtrArray *paths) {
+    g_assert(paths);
+    fsearch_preview_prefetch_cancel();
+    if (paths->len == 0) {
+        return;
+    }
+
+    prefetch_cancellable = g_cancellable_new();
+    g_autoptr(GTask) task = g_task_new(NULL, prefetch_cancellable, NULL, NULL);
+    g_task_set_task_data(task, g_ptr_array_ref(paths), (GDestroyNotify)g_ptr_array_unref);
+    g_task_run_in_thread(task, prefetch_thread);
+}
+
+bool
+fsearch_preview_is_visible(void) {
+    return preview_visible;
+}
+
 static void
 preview_show_file_ready_cb(GObject *source, GAsyncResult *res, gpointer user_data) {
     g_autoptr(GError) error = NULL;
@@ -49,6 +110,10 @@ void
 fsearch_preview_call_show_file(const gchar *uri, guint xid, gboolean close_if_already_visible) {
     GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(FSEARCH_APPLICATION_DEFAULT));
     GVariant *variant = g_variant_new("(sib)", uri, xid, close_if_already_visible);
+    preview_visible = close_if_already_visible ? !preview_visible : true;
+    if (!preview_visible) {
+        fsearch_preview_prefetch_cancel();
+    }
 
     g_dbus_connection_call(connection,
                            PREVIEWER_DBUS_NAME,
@@ -66,6 +131,9 @@ fsearch_preview_call_show_file(const gchar *uri, guint xid, gboolean close_if_al
 
 void
 fsearch_preview_call_close(void) {
+    preview_visible = false;
+    fsearch_preview_prefetch_cancel();
+
     GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(FSEARCH_APPLICATION_DEFAULT));
 
     g_dbus_connection_call(connection,
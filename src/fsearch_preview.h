@@ -19,9 +19,23 @@
 #pragma once
 
 #include <glib.h>
+#include <stdbool.h>
 
 void
 fsearch_preview_call_show_file(const gchar *uri, guint xid, gboolean close_if_already_visible);
 
 void
-fsearch_preview_call_close(void);
\ No newline at end of file
+fsearch_preview_call_close(void);
+
+// Whether the previewer was last asked to show a file rather than to close. It can also be closed by the user, so
+// this is only a hint.
+bool
+fsearch_preview_is_visible(void);
+
+// Reads the beginning of the files at paths into the page cache in the background, so the previewer can show them
+// sooner. Only a bounded amount of every file is read. Cancels the previous prefetch, if it's still running.
+void
+fsearch_preview_prefetch(GPtrArray *paths);
+
+void
+fsearch_preview_prefetch_cancel(void);
@@ -38,10 +38,49 @@ fsearch_query_new(const char *search_term,
         q->triggers_auto_match_case = fsearch_query_node_tree_triggers_auto_match_case(q->query_tree);
         q->triggers_auto_match_path = fsearch_query_node_tree_triggers_auto_match_path(q->query_tree);
         q->wants_single_threaded_search = fsearch_query_node_tree_wants_single_threaded_search(q->query_tree);
+        q->wants_entry_columns = fsearch_query_node_tree_wants_entry_columns(q->query_tree);
     }
 
     if (filter && filter->query) {
-        q->filter_tree = fsearch_query_node_tree_new(filter->query, filters, filter->flags);
+        // filters change rarely, so their trees are kept by the filter manager instead of being parsed again
+        // for every query
+        q->filter_shared_tree = filters ? fsearch_filter_manager_get_query_tree(filters, filter->query, filter->flags)
+                                        : fsearch_query_shared_tree_new(filter->query, NULL, filter->flags);
+        q->filter_tree = q->filter_shared_tree->root;
+        if (q->filter_tree && fsearch_query_node_tree_wants_entry_columns(q->filter_tree)) {
+            q->wants_entry_columns = true;
+        }
+    }
+
+    const char *query_literal = q->query_tree ? fsearch_query_node_tree_get_name_literal(q->query_tree) : NULL;
+    const char *filter_literal = q->filter_tree ? fsearch_query_node_tree_get_name_literal(q->filter_tree) : NULL;
+    if (filter_literal && (!query_literal || strlen(filter_literal) > strlen(query_literal))) {
+        query_literal = filter_literal;
+    }
+    q->name_literal = query_literal ? strdup(query_literal) : NULL;
+
+    const char *exact_name = q->query_tree ? fsearch_query_node_tree_get_exact_name(q->query_tree) : NULL;
+    if (!exact_name && q->filter_tree) {
+        exact_name = fsearch_query_node_tree_get_exact_name(q->filter_tree);
+    }
+    q->exact_name = exact_name ? strdup(exact_name) : NULL;
+
+    const char *query_prefix = q->query_tree ? fsearch_query_node_tree_get_name_prefix(q->query_tree) : NULL;
+    const char *filter_prefix = q->filter_tree ? fsearch_query_node_tree_get_name_prefix(q->filter_tree) : NULL;
+    if (filter_prefix && (!query_prefix || strlen(filter_prefix) > strlen(query_prefix))) {
+        query_prefix = filter_prefix;
+    }
+    q->name_prefix = query_prefix ? strdup(query_prefix) : NULL;
+
+    // the slots of the filter tree are assigned already, the ones of the query tree follow them
+    fsearch_query_node_tree_assign_folder_verdict_slots(
+        q->query_tree,
+        q->filter_shared_tree ? q->filter_shared_tree->num_folder_verdict_slots : 0);
+
+    // the filter only applies if it has a query, see filter_entry
+    GNode *filter_tree = filter && filter->query && !fsearch_string_is_empty(filter->query) ? q->filter_tree : NULL;
+    for (uint32_t i = 0; i < NUM_DATABASE_ENTRY_TYPES; i++) {
+        q->programs[i] = fsearch_query_program_new(filter_tree, q->query_tree, i);
     }
 
     q->filter = fsearch_filter_ref(filter);
@@ -56,7 +95,15 @@ fsearch_query_free(FsearchQuery *query) {
     g_clear_pointer(&query->query_id, free);
     g_clear_pointer(&query->filter, fsearch_filter_unref);
     g_clear_pointer(&query->search_term, free);
+    g_clear_pointer(&query->name_literal, free);
+    g_clear_pointer(&query->exact_name, free);
+    g_clear_pointer(&query->name_prefix, free);
+    for (uint32_t i = 0; i < NUM_DATABASE_ENTRY_TYPES; i++) {
+        g_clear_pointer(&query->programs[i], fsearch_query_program_free);
+    }
     g_clear_pointer(&query->query_tree, fsearch_query_node_tree_free);
+    query->filter_tree = NULL;
+    g_clear_pointer(&query->filter_shared_tree, fsearch_query_shared_tree_unref);
     g_clear_pointer(&query, free);
 }
 
@@ -88,6 +135,68 @@ fsearch_query_matches_everything(FsearchQuery *query) {
     return false;
 }
 
+// Plain search terms are a list of words which are matched as substrings of the name and combined with AND
+static bool
+is_plain_search_term(const char *search_term) {
+    // reserved characters of the query syntax, wildcards and path separators (which trigger searching in paths)
+    if (strpbrk(search_term, ":=<>()!\"\\*?&|/")) {
+        return false;
+    }
+    g_auto(GStrv) words = g_strsplit_set(search_term, " \t\n\r\f\v", -1);
+    for (uint32_t i = 0; words[i]; i++) {
+        if (!strcmp(words[i], "AND") || !strcmp(words[i], "OR") || !strcmp(words[i], "NOT")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+starts_with_mark(const char *str) {
+    return *str != '\0' && g_unichar_ismark(g_utf8_get_char_validated(str, -1));
+}
+
+static bool
+word_is_refinement_of(const char *word, const char *other_word, bool exact_match) {
+    if (exact_match) {
+        return !strcmp(word, other_word);
+    }
+    const char *pos = strstr(word, other_word);
+    // a combining mark might get composed with the last character of other_word when the strings are normalized
+    return pos && !starts_with_mark(other_word) && !starts_with_mark(pos + strlen(other_word));
+}
+
+bool
+fsearch_query_is_refinement_of(FsearchQuery *query, FsearchQuery *other) {
+    if (!query || !other || query->flags != other->flags || query->filter != other->filter) {
+        return false;
+    }
+    if (query->flags & QUERY_FLAG_REGEX || fsearch_string_is_empty(other->search_term)) {
+        return false;
+    }
+    if (!is_plain_search_term(query->search_term) || !is_plain_search_term(other->search_term)) {
+        return false;
+    }
+
+    // every word of other must be part of a word of query, e.g. "foo" -> "foob" or "foo" -> "foo bar"
+    g_auto(GStrv) words = g_strsplit_set(query->search_term, " \t\n\r\f\v", -1);
+    g_auto(GStrv) other_words = g_strsplit_set(other->search_term, " \t\n\r\f\v", -1);
+    const bool exact_match = query->flags & QUERY_FLAG_EXACT_MATCH;
+    for (uint32_t i = 0; other_words[i]; i++) {
+        if (other_words[i][0] == '\0') {
+            continue;
+        }
+        bool found = false;
+        for (uint32_t j = 0; words[j] && !found; j++) {
+            found = word_is_refinement_of(words[j], other_words[i], exact_match);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static bool
 highlight(GNode *node, FsearchDatabaseEntry *entry, FsearchQueryMatchData *match_data, FsearchDatabaseEntryType type) {
     if (!node) {
@@ -166,7 +275,7 @@ filter_entry(FsearchDatabaseEntry *entry, FsearchQueryMatchData *match_data, Fse
     if (query->filter->query == NULL || fsearch_string_is_empty(query->filter->query)) {
         return true;
     }
-    FsearchDatabaseEntryType type = db_entry_get_type(entry);
+    FsearchDatabaseEntryType type = fsearch_query_match_data_get_entry_type(match_data);
     if (query->filter_tree) {
         return matches(query->filter_tree, entry, match_data, type);
     }
@@ -190,6 +299,12 @@ fsearch_query_highlight(FsearchQuery *query, FsearchQueryMatchData *match_data)
     return highlight(token, entry, match_data, type);
 }
 
+bool
+fsearch_query_never_matches(FsearchQuery *query, FsearchDatabaseEntryType type) {
+    bool result = false;
+    return fsearch_query_program_is_constant(query->programs[type], &result) && !result;
+}
+
 bool
 fsearch_query_match(FsearchQuery *query, FsearchQueryMatchData *match_data) {
     FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
@@ -197,12 +312,6 @@ fsearch_query_match(FsearchQuery *query, FsearchQueryMatchData *match_data) {
         return false;
     }
 
-    FsearchDatabaseEntryType type = db_entry_get_type(entry);
-    GNode *token = query->query_tree;
-
-    if (!filter_entry(entry, match_data, query)) {
-        return false;
-    }
-
-    return matches(token, entry, match_data, type);
+    const FsearchDatabaseEntryType type = fsearch_query_match_data_get_entry_type(match_data);
+    return fsearch_query_program_run(query->programs[type], match_data);
 }
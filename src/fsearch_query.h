@@ -29,6 +29,7 @@
 #include "fsearch_query_flags.h"
 #include "fsearch_query_match_data.h"
 #include "fsearch_query_node.h"
+#include "fsearch_query_program.h"
 #include "fsearch_query_tree.h"
 #include "fsearch_thread_pool.h"
 
@@ -39,7 +40,11 @@ typedef struct FsearchQuery {
     FsearchFilterManager *filters;
 
     GNode *query_tree;
+    // the root of filter_shared_tree, it's shared with other queries and must not be changed
     GNode *filter_tree;
+    FsearchQuerySharedTree *filter_shared_tree;
+    // filter_tree AND query_tree compiled for each entry type
+    FsearchQueryProgram *programs[NUM_DATABASE_ENTRY_TYPES];
 
     char *query_id;
 
@@ -48,6 +53,14 @@ typedef struct FsearchQuery {
     bool triggers_auto_match_case;
     bool triggers_auto_match_path;
     bool wants_single_threaded_search;
+    bool wants_entry_columns;
+    // part of the name of every entry the query matches, NULL if there's no such string
+    char *name_literal;
+    // the name of every entry the query matches (ignoring the case of ASCII letters), NULL if there's none
+    char *exact_name;
+    // a string the name of every entry the query matches starts with (see FsearchQueryNode::name_prefix), NULL if
+    // there's none
+    char *name_prefix;
 
     volatile int ref_count;
 } FsearchQuery;
@@ -68,6 +81,15 @@ fsearch_query_unref(FsearchQuery *query);
 bool
 fsearch_query_matches_everything(FsearchQuery *query);
 
+// Returns true if it can be proven that every entry which matches query also matches other (e.g. because query
+// only appends characters to the search term of other), so query can be run on the results of other alone.
+bool
+fsearch_query_is_refinement_of(FsearchQuery *query, FsearchQuery *other);
+
+// Returns true if it's known without looking at them that no entry of type matches query
+bool
+fsearch_query_never_matches(FsearchQuery *query, FsearchDatabaseEntryType type);
+
 bool
 fsearch_query_match(FsearchQuery *queyr, FsearchQueryMatchData *match_data);
 
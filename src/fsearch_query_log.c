@@ -0,0 +1,294 @@
+#define G_LOG_DOMAIN "fsearch-query-log"
+
+#include "fsearch_query_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUERY_LOG_NUM_FIELDS 8
+
+static const char *status_names[NUM_FSEARCH_QUERY_LOG_STATUSES] = {
+    [FSEARCH_QUERY_LOG_STATUS_FINISHED] = "finished",
+    [FSEARCH_QUERY_LOG_STATUS_CANCELLED] = "cancelled",
+};
+
+typedef struct {
+    FILE *fp;
+    GMutex mutex;
+    int64_t start_time;
+    bool anonymize;
+    uint64_t key;
+} QueryLog;
+
+static QueryLog *query_log = NULL;
+
+void
+fsearch_query_log_record_clear(FsearchQueryLogRecord *record) {
+    if (!record) {
+        return;
+    }
+    g_clear_pointer(&record->filter, g_free);
+    g_clear_pointer(&record->query, g_free);
+}
+
+static QueryLog *
+query_log_get(void) {
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        const char *file_path = g_getenv("FSEARCH_QUERY_LOG");
+        FILE *fp = file_path && *file_path ? fopen(file_path, "a") : NULL;
+        if (fp) {
+            QueryLog *log = calloc(1, sizeof(QueryLog));
+            g_assert(log);
+            log->fp = fp;
+            g_mutex_init(&log->mutex);
+            log->start_time = g_get_monotonic_time();
+            log->anonymize = !g_strcmp0(g_getenv("FSEARCH_QUERY_LOG_ANONYMIZE"), "1");
+            log->key = (uint64_t)g_random_int() << 32 | g_random_int();
+
+            g_autoptr(GDateTime) now = g_date_time_new_now_local();
+            g_autofree char *date = g_date_time_format(now, "%F %T");
+            fprintf(fp,
+                    "# fsearch query log, started %s%s\n"
+                    "# time_ms\tflags\tfilter\tresults\tqueued_ms\tsearch_ms\tstatus\tquery\n",
+                    date,
+                    log->anonymize ? ", anonymized" : "");
+            fflush(fp);
+            query_log = log;
+        }
+        else if (file_path && *file_path) {
+            g_warning("[query_log] failed to open %s", file_path);
+        }
+        g_once_init_leave(&initialized, 1);
+    }
+    return query_log;
+}
+
+bool
+fsearch_query_log_is_enabled(void) {
+    return query_log_get() != NULL;
+}
+
+double
+fsearch_query_log_get_time(void) {
+    QueryLog *log = query_log_get();
+    return log ? (double)(g_get_monotonic_time() - log->start_time) / 1000 : 0;
+}
+
+void
+fsearch_query_log_add(const FsearchQueryLogRecord *record) {
+    QueryLog *log = query_log_get();
+    if (!log) {
+        return;
+    }
+    FsearchQueryLogRecord copy = *record;
+    g_autofree char *filter = NULL;
+    g_autofree char *query = NULL;
+    if (log->anonymize) {
+        copy.filter = filter = record->filter ? fsearch_query_log_anonymize(record->filter, log->key) : NULL;
+        copy.query = query = fsearch_query_log_anonymize(record->query, log->key);
+    }
+    g_autofree char *line = fsearch_query_log_format_record(&copy);
+
+    g_mutex_lock(&log->mutex);
+    fprintf(log->fp, "%s\n", line);
+    // the log should be complete when the application crashes
+    fflush(log->fp);
+    g_mutex_unlock(&log->mutex);
+}
+
+static void
+append_escaped(GString *line, const char *text) {
+    for (const char *c = text; c && *c; c++) {
+        switch (*c) {
+        case '\\':
+            g_string_append(line, "\\\\");
+            break;
+        case '\t':
+            g_string_append(line, "\\t");
+            break;
+        case '\n':
+            g_string_append(line, "\\n");
+            break;
+        case '\r':
+            g_string_append(line, "\\r");
+            break;
+        default:
+            g_string_append_c(line, *c);
+        }
+    }
+}
+
+static char *
+unescape(const char *text) {
+    GString *res = g_string_sized_new(strlen(text));
+    for (const char *c = text; *c; c++) {
+        if (*c != '\\' || !c[1]) {
+            g_string_append_c(res, *c);
+            continue;
+        }
+        c++;
+        switch (*c) {
+        case 't':
+            g_string_append_c(res, '\t');
+            break;
+        case 'n':
+            g_string_append_c(res, '\n');
+            break;
+        case 'r':
+            g_string_append_c(res, '\r');
+            break;
+        default:
+            g_string_append_c(res, *c);
+        }
+    }
+    return g_string_free(res, FALSE);
+}
+
+char *
+fsearch_query_log_format_record(const FsearchQueryLogRecord *record) {
+    g_assert(record);
+    g_assert(record->status >= 0 && record->status < NUM_FSEARCH_QUERY_LOG_STATUSES);
+
+    char buffers[3][G_ASCII_DTOSTR_BUF_SIZE];
+    GString *line = g_string_new(NULL);
+    g_string_append_printf(line,
+                           "%s\t%u\t",
+                           g_ascii_formatd(buffers[0], sizeof(buffers[0]), "%.3f", record->time_ms),
+                           record->flags);
+    append_escaped(line, record->filter);
+    g_string_append_printf(line,
+                           "\t%u\t%s\t%s\t%s\t",
+                           record->num_results,
+                           g_ascii_formatd(buffers[1], sizeof(buffers[1]), "%.3f", record->queued_ms),
+                           g_ascii_formatd(buffers[2], sizeof(buffers[2]), "%.3f", record->search_ms),
+                           status_names[record->status]);
+    append_escaped(line, record->query);
+    return g_string_free(line, FALSE);
+}
+
+static bool
+parse_double(const char *text, double *value) {
+    char *end = NULL;
+    *value = g_ascii_strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool
+parse_uint32(const char *text, uint32_t *value) {
+    char *end = NULL;
+    const guint64 v = g_ascii_strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || v > UINT32_MAX) {
+        return false;
+    }
+    *value = (uint32_t)v;
+    return true;
+}
+
+bool
+fsearch_query_log_parse_record(const char *line, FsearchQueryLogRecord *record) {
+    g_assert(line);
+    g_assert(record);
+    memset(record, 0, sizeof(FsearchQueryLogRecord));
+    if (line[0] == '#') {
+        return false;
+    }
+    g_autofree char *stripped = g_strdup(line);
+    const size_t len = strlen(stripped);
+    if (len > 0 && stripped[len - 1] == '\n') {
+        stripped[len - 1] = '\0';
+    }
+    g_auto(GStrv) fields = g_strsplit(stripped, "\t", QUERY_LOG_NUM_FIELDS);
+    if (g_strv_length(fields) != QUERY_LOG_NUM_FIELDS) {
+        return false;
+    }
+    uint32_t flags = 0;
+    if (!parse_double(fields[0], &record->time_ms) || !parse_uint32(fields[1], &flags)
+        || !parse_uint32(fields[3], &record->num_results) || !parse_double(fields[4], &record->queued_ms)
+        || !parse_double(fields[5], &record->search_ms)) {
+        return false;
+    }
+    record->flags = flags;
+    uint32_t status = 0;
+    while (status < NUM_FSEARCH_QUERY_LOG_STATUSES && strcmp(fields[6], status_names[status]) != 0) {
+        status++;
+    }
+    if (status == NUM_FSEARCH_QUERY_LOG_STATUSES) {
+        return false;
+    }
+    record->status = status;
+    record->filter = fields[2][0] ? unescape(fields[2]) : NULL;
+    record->query = unescape(fields[7]);
+    return true;
+}
+
+static uint64_t
+hash_step(uint64_t hash, const char *bytes, size_t num_bytes) {
+    // FNV-1a
+    for (size_t i = 0; i < num_bytes; i++) {
+        hash ^= (uint8_t)bytes[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+static bool
+is_keyword(const char *word, size_t len) {
+    static const char *keywords[] = {"AND", "OR", "NOT"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(keywords); i++) {
+        if (strlen(keywords[i]) == len && !strncmp(word, keywords[i], len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+char *
+fsearch_query_log_anonymize(const char *text, uint64_t key) {
+    if (!text) {
+        return NULL;
+    }
+    if (!g_utf8_validate(text, -1, NULL)) {
+        // nothing of it can be kept
+        return g_strnfill(strlen(text), 'x');
+    }
+    GString *res = g_string_sized_new(strlen(text));
+    const char *c = text;
+    while (*c) {
+        if (!g_unichar_isalnum(g_utf8_get_char(c))) {
+            const char *next = g_utf8_next_char(c);
+            g_string_append_len(res, c, next - c);
+            c = next;
+            continue;
+        }
+        const char *word_end = c;
+        while (*word_end && g_unichar_isalnum(g_utf8_get_char(word_end))) {
+            word_end = g_utf8_next_char(word_end);
+        }
+        if (*word_end == ':' || is_keyword(c, word_end - c)) {
+            g_string_append_len(res, c, word_end - c);
+            c = word_end;
+            continue;
+        }
+        uint64_t hash = hash_step(UINT64_C(14695981039346656037), (const char *)&key, sizeof(key));
+        while (c < word_end) {
+            const char *next = g_utf8_next_char(c);
+            hash = hash_step(hash, c, next - c);
+            const gunichar uc = g_utf8_get_char(c);
+            // the high bits of FNV-1a are mixed better
+            const uint32_t h = (uint32_t)(hash >> 32);
+            if (g_unichar_isdigit(uc)) {
+                g_string_append_c(res, (char)('0' + h % 10));
+            }
+            else if (g_unichar_isupper(uc)) {
+                g_string_append_c(res, (char)('A' + h % 26));
+            }
+            else {
+                g_string_append_c(res, (char)('a' + h % 26));
+            }
+            c = next;
+        }
+    }
+    return g_string_free(res, FALSE);
+}
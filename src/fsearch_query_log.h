@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_query_flags.h"
+
+// A log of the searches views run, which can be replayed against a database later (see
+// benchmarks/replay_query_log.c).
+//
+// It's off unless the environment variable FSEARCH_QUERY_LOG names the file the searches get appended to. With
+// FSEARCH_QUERY_LOG_ANONYMIZE=1 the letters and digits of the queries and filter names are replaced, see
+// fsearch_query_log_anonymize.
+
+typedef enum {
+    FSEARCH_QUERY_LOG_STATUS_FINISHED,
+    // a newer search replaced it before or while it ran
+    FSEARCH_QUERY_LOG_STATUS_CANCELLED,
+    NUM_FSEARCH_QUERY_LOG_STATUSES,
+} FsearchQueryLogStatus;
+
+typedef struct {
+    // when the search was requested, in ms since the log was started
+    double time_ms;
+    FsearchQueryFlags flags;
+    // NULL if no filter was selected
+    char *filter;
+    char *query;
+    uint32_t num_results;
+    // how long it waited in the task queue until it started and how long it ran
+    double queued_ms;
+    double search_ms;
+    FsearchQueryLogStatus status;
+} FsearchQueryLogRecord;
+
+void
+fsearch_query_log_record_clear(FsearchQueryLogRecord *record);
+
+bool
+fsearch_query_log_is_enabled(void);
+
+// Returns the time_ms of a search which gets requested now
+double
+fsearch_query_log_get_time(void);
+
+// Appends record to the log, anonymizing it if that was asked for
+void
+fsearch_query_log_add(const FsearchQueryLogRecord *record);
+
+// Returns one line of the log (without the newline)
+char *
+fsearch_query_log_format_record(const FsearchQueryLogRecord *record);
+
+// Parses a line of fsearch_query_log_format_record into record, which must be cleared afterwards. Returns false for
+// comments and malformed lines.
+bool
+fsearch_query_log_parse_record(const char *line, FsearchQueryLogRecord *record);
+
+// Replaces every letter of text with a lower case ASCII letter (upper case ones with upper case ones) and every digit
+// with a digit, derived from key and everything before it in the same word. So the same words map to the same
+// replacements and typing a word one character after the other still extends the previous query. The syntax of
+// queries is kept: the names of functions (the words before a ':'), AND, OR and NOT, spaces and punctuation.
+char *
+fsearch_query_log_anonymize(const char *text, uint64_t key);
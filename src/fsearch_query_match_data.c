@@ -1,23 +1,55 @@
 #include <glib.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "fsearch_database_entry_columns.h"
 #include "fsearch_limits.h"
 #include "fsearch_query_match_data.h"
 #include "fsearch_utf.h"
 
+#define FOLDED_UTF8_BUFFER_SIZE (4 * PATH_MAX)
+
 struct FsearchQueryMatchData {
     FsearchDatabaseEntry *entry;
 
+    // when set, the numeric attributes of entry are read from there instead
+    const FsearchDatabaseEntryColumns *columns;
+    uint32_t column_idx;
+
+    // when set, the paths of the parent folders are taken from there
+    FsearchFolderPaths *folder_paths;
+    // when set, the folded forms of non-ASCII names are taken from there
+    FsearchFoldedNames *folded_names;
+    GCancellable *cancellable;
+    // the parent path of entry, points into parent_path_buffer or folder_paths
+    const char *parent_path;
+    // the value of the extended attribute selected last, see fsearch_query_match_data_select_xattr
+    const char *xattr_value;
+
     FsearchUtfBuilder *utf_name_builder;
     FsearchUtfBuilder *utf_path_builder;
     FsearchUtfBuilder *utf_parent_path_builder;
     GString *path_buffer;
     GString *parent_path_buffer;
     GString *content_type_buffer;
+    // case folded UTF-8 strings, see fsearch_query_match_data_fold_utf8
+    char *folded_utf8_buffer;
+    // see fsearch_query_match_data_get_regex_match_data
+    pcre2_match_data *regex_match_data;
 
     PangoAttrList **highlights;
 
+    // FsearchDatabaseEntryFolder * -> two bits for every folder verdict slot: whether the verdict is known and
+    // the verdict itself. It's kept across entries, since match data is only used while the database is locked.
+    GHashTable *folder_verdicts;
+
+    // cached strlen of the entry name, SIZE_MAX if it's not known yet
+    size_t name_len;
+
+    // how well the current entry matches the query, for sorting by relevance
+    uint32_t score;
+
     int32_t thread_id;
 
     bool utf_name_ready;
@@ -43,9 +75,20 @@ fsearch_query_match_data_get_utf_parent_path_builder(FsearchQueryMatchData *matc
 FsearchUtfBuilder *
 fsearch_query_match_data_get_utf_name_builder(FsearchQueryMatchData *match_data) {
     if (!match_data->utf_name_ready) {
-        match_data->utf_name_ready =
-            fsearch_utf_builder_normalize_and_fold_case(match_data->utf_name_builder,
-                                                        db_entry_get_name_raw_for_display(match_data->entry));
+        FsearchUtfBuilder *builder = match_data->utf_name_builder;
+        const char *name = db_entry_get_name_raw_for_display(match_data->entry);
+        int32_t folded_len = 0;
+        const UChar *folded = NULL;
+        if (db_entry_name_is_ascii(match_data->entry)) {
+            match_data->utf_name_ready =
+                fsearch_utf_builder_fold_case_ascii(builder, name, fsearch_query_match_data_get_name_len(match_data));
+        }
+        else if ((folded = fsearch_folded_names_lookup(match_data->folded_names, match_data->entry, &folded_len))) {
+            match_data->utf_name_ready = fsearch_utf_builder_set_normalized_folded(builder, folded, folded_len);
+        }
+        else {
+            match_data->utf_name_ready = fsearch_utf_builder_normalize_and_fold_case(builder, name);
+        }
     }
     return match_data->utf_name_builder;
 }
@@ -60,24 +103,64 @@ fsearch_query_match_data_get_utf_path_builder(FsearchQueryMatchData *match_data)
     return match_data->utf_path_builder;
 }
 
+const char *
+fsearch_query_match_data_fold_utf8(FsearchQueryMatchData *match_data, const char *string, size_t *len) {
+    if (!string) {
+        return NULL;
+    }
+    if (!match_data->folded_utf8_buffer) {
+        match_data->folded_utf8_buffer = malloc(FOLDED_UTF8_BUFFER_SIZE);
+        g_assert(match_data->folded_utf8_buffer);
+    }
+    // the name builder isn't used for that, so the folded and normalized name it might hold stays valid
+    UErrorCode status = U_ZERO_ERROR;
+    const int32_t folded_len = ucasemap_utf8FoldCase(match_data->utf_name_builder->case_map,
+                                                     match_data->folded_utf8_buffer,
+                                                     FOLDED_UTF8_BUFFER_SIZE,
+                                                     string,
+                                                     -1,
+                                                     &status);
+    if (U_FAILURE(status)) {
+        return NULL;
+    }
+    *len = folded_len;
+    return match_data->folded_utf8_buffer;
+}
+
 const char *
 fsearch_query_match_data_get_name_str(FsearchQueryMatchData *match_data) {
     return db_entry_get_name_raw_for_display(match_data->entry);
 }
 
+size_t
+fsearch_query_match_data_get_name_len(FsearchQueryMatchData *match_data) {
+    if (match_data->name_len == SIZE_MAX) {
+        const char *name = fsearch_query_match_data_get_name_str(match_data);
+        match_data->name_len = name ? strlen(name) : 0;
+    }
+    return match_data->name_len;
+}
+
 const char *
 fsearch_query_match_data_get_parent_path_str(FsearchQueryMatchData *match_data) {
     if (!match_data->entry) {
         return NULL;
     }
     if (!match_data->parent_path_ready) {
-        g_string_truncate(match_data->parent_path_buffer, 0);
-        db_entry_append_path(match_data->entry, match_data->parent_path_buffer);
+        size_t len = 0;
+        match_data->parent_path = fsearch_folder_paths_lookup(match_data->folder_paths,
+                                                              db_entry_get_parent(match_data->entry),
+                                                              &len);
+        if (!match_data->parent_path) {
+            g_string_truncate(match_data->parent_path_buffer, 0);
+            db_entry_append_path(match_data->entry, match_data->parent_path_buffer);
+            match_data->parent_path = match_data->parent_path_buffer->str;
+        }
 
         match_data->parent_path_ready = true;
     }
 
-    return match_data->parent_path_buffer->str;
+    return match_data->parent_path;
 }
 
 const char *
@@ -87,7 +170,7 @@ fsearch_query_match_data_get_path_str(FsearchQueryMatchData *match_data) {
     }
     if (!match_data->path_ready) {
         g_string_truncate(match_data->path_buffer, 0);
-        db_entry_append_full_path(match_data->entry, match_data->path_buffer);
+        fsearch_folder_paths_append_full_path(match_data->folder_paths, match_data->entry, match_data->path_buffer);
 
         match_data->path_ready = true;
     }
@@ -95,6 +178,46 @@ fsearch_query_match_data_get_path_str(FsearchQueryMatchData *match_data) {
     return match_data->path_buffer->str;
 }
 
+bool
+fsearch_query_match_data_get_folder_verdict(FsearchQueryMatchData *match_data,
+                                            FsearchDatabaseEntryFolder *folder,
+                                            uint32_t slot,
+                                            bool *verdict) {
+    if (!match_data->folder_verdicts || slot == 0 || slot > FSEARCH_QUERY_MATCH_DATA_NUM_FOLDER_VERDICT_SLOTS) {
+        return false;
+    }
+    const uint32_t bits = GPOINTER_TO_UINT(g_hash_table_lookup(match_data->folder_verdicts, folder));
+    const uint32_t shift = (slot - 1) * 2;
+    if (!(bits & (1u << shift))) {
+        return false;
+    }
+    *verdict = bits & (2u << shift);
+    return true;
+}
+
+void
+fsearch_query_match_data_set_folder_verdict(FsearchQueryMatchData *match_data,
+                                            FsearchDatabaseEntryFolder *folder,
+                                            uint32_t slot,
+                                            bool verdict) {
+    if (slot == 0 || slot > FSEARCH_QUERY_MATCH_DATA_NUM_FOLDER_VERDICT_SLOTS) {
+        return;
+    }
+    if (!match_data->folder_verdicts) {
+        match_data->folder_verdicts = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    const uint32_t shift = (slot - 1) * 2;
+    uint32_t bits = GPOINTER_TO_UINT(g_hash_table_lookup(match_data->folder_verdicts, folder));
+    bits &= ~(3u << shift);
+    bits |= (verdict ? 3u : 1u) << shift;
+    g_hash_table_insert(match_data->folder_verdicts, folder, GUINT_TO_POINTER(bits));
+}
+
+size_t
+fsearch_query_match_data_get_path_len(FsearchQueryMatchData *match_data) {
+    return fsearch_query_match_data_get_path_str(match_data) ? match_data->path_buffer->len : 0;
+}
+
 const char *
 fsearch_query_match_data_get_content_type_str(FsearchQueryMatchData *match_data) {
     if (!match_data->entry) {
@@ -110,11 +233,98 @@ fsearch_query_match_data_get_content_type_str(FsearchQueryMatchData *match_data)
     return match_data->content_type_buffer->str;
 }
 
+bool
+fsearch_query_match_data_select_xattr(FsearchQueryMatchData *match_data, const char *name) {
+    match_data->xattr_value = match_data->entry ? db_entry_get_xattr(match_data->entry, name, NULL) : NULL;
+    return match_data->xattr_value != NULL;
+}
+
+const char *
+fsearch_query_match_data_get_xattr_value_str(FsearchQueryMatchData *match_data) {
+    return match_data->xattr_value ? match_data->xattr_value : "";
+}
+
 FsearchDatabaseEntry *
 fsearch_query_match_data_get_entry(FsearchQueryMatchData *match_data) {
     return match_data->entry;
 }
 
+FsearchDatabaseEntryType
+fsearch_query_match_data_get_entry_type(FsearchQueryMatchData *match_data) {
+    if (match_data->columns) {
+        return match_data->columns->types[match_data->column_idx];
+    }
+    return match_data->entry ? db_entry_get_type(match_data->entry) : DATABASE_ENTRY_TYPE_NONE;
+}
+
+int64_t
+fsearch_query_match_data_get_size(FsearchQueryMatchData *match_data) {
+    if (match_data->columns) {
+        return match_data->columns->sizes[match_data->column_idx];
+    }
+    return match_data->entry ? db_entry_get_size(match_data->entry) : 0;
+}
+
+int64_t
+fsearch_query_match_data_get_mtime(FsearchQueryMatchData *match_data) {
+    if (match_data->columns) {
+        return match_data->columns->mtimes[match_data->column_idx];
+    }
+    return match_data->entry ? db_entry_get_mtime(match_data->entry) : 0;
+}
+
+int64_t
+fsearch_query_match_data_get_time(FsearchQueryMatchData *match_data, FsearchDatabaseIndexType type) {
+    if (match_data->columns) {
+        const int64_t *times = NULL;
+        switch (type) {
+        case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
+            times = match_data->columns->mtimes;
+            break;
+        case DATABASE_INDEX_TYPE_ACCESS_TIME:
+            times = match_data->columns->atimes;
+            break;
+        case DATABASE_INDEX_TYPE_CREATION_TIME:
+            times = match_data->columns->btimes;
+            break;
+        case DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME:
+            times = match_data->columns->ctimes;
+            break;
+        default:
+            break;
+        }
+        return times ? times[match_data->column_idx] : 0;
+    }
+    return db_entry_get_time(match_data->entry, type);
+}
+
+uint16_t
+fsearch_query_match_data_get_user_id(FsearchQueryMatchData *match_data) {
+    if (match_data->columns) {
+        const uint16_t *user_ids = match_data->columns->user_ids;
+        return user_ids ? user_ids[match_data->column_idx] : FSEARCH_ID_DICTIONARY_NO_ID;
+    }
+    return db_entry_get_user_id(match_data->entry);
+}
+
+uint16_t
+fsearch_query_match_data_get_group_id(FsearchQueryMatchData *match_data) {
+    if (match_data->columns) {
+        const uint16_t *group_ids = match_data->columns->group_ids;
+        return group_ids ? group_ids[match_data->column_idx] : FSEARCH_ID_DICTIONARY_NO_ID;
+    }
+    return db_entry_get_group_id(match_data->entry);
+}
+
+uint16_t
+fsearch_query_match_data_get_mode(FsearchQueryMatchData *match_data) {
+    if (match_data->columns) {
+        const uint16_t *modes = match_data->columns->modes;
+        return modes ? modes[match_data->column_idx] : 0;
+    }
+    return db_entry_get_mode(match_data->entry);
+}
+
 FsearchQueryMatchData *
 fsearch_query_match_data_new(void) {
     FsearchQueryMatchData *match_data = calloc(1, sizeof(FsearchQueryMatchData));
@@ -138,6 +348,7 @@ fsearch_query_match_data_new(void) {
     match_data->path_ready = false;
     match_data->parent_path_ready = false;
     match_data->content_type_ready = false;
+    match_data->name_len = SIZE_MAX;
 
     return match_data;
 }
@@ -174,10 +385,34 @@ fsearch_query_match_data_free(FsearchQueryMatchData *match_data) {
     g_string_free(g_steal_pointer(&match_data->path_buffer), TRUE);
     g_string_free(g_steal_pointer(&match_data->parent_path_buffer), TRUE);
     g_string_free(g_steal_pointer(&match_data->content_type_buffer), TRUE);
+    g_clear_pointer(&match_data->folded_utf8_buffer, free);
+    g_clear_pointer(&match_data->regex_match_data, pcre2_match_data_free);
+
+    g_clear_pointer(&match_data->folder_verdicts, g_hash_table_destroy);
 
     g_clear_pointer(&match_data, free);
 }
 
+void
+fsearch_query_match_data_reset(FsearchQueryMatchData *match_data) {
+    if (!match_data) {
+        return;
+    }
+    fsearch_query_match_data_set_entry(match_data, NULL);
+    match_data->columns = NULL;
+    match_data->column_idx = 0;
+    match_data->folder_paths = NULL;
+    match_data->folded_names = NULL;
+    match_data->cancellable = NULL;
+    match_data->parent_path = NULL;
+    match_data->thread_id = 0;
+    match_data->matches = false;
+    if (match_data->folder_verdicts) {
+        // keeps the buckets around for the next query
+        g_hash_table_remove_all(match_data->folder_verdicts);
+    }
+}
+
 void
 fsearch_query_match_data_set_entry(FsearchQueryMatchData *match_data, FsearchDatabaseEntry *entry) {
     if (!match_data) {
@@ -192,10 +427,70 @@ fsearch_query_match_data_set_entry(FsearchQueryMatchData *match_data, FsearchDat
     match_data->path_ready = false;
     match_data->parent_path_ready = false;
     match_data->content_type_ready = false;
+    match_data->xattr_value = NULL;
+    match_data->name_len = SIZE_MAX;
+    match_data->score = 0;
 
     match_data->entry = entry;
 }
 
+void
+fsearch_query_match_data_set_folder_paths(FsearchQueryMatchData *match_data, FsearchFolderPaths *folder_paths) {
+    if (!match_data) {
+        return;
+    }
+    match_data->folder_paths = folder_paths;
+    match_data->path_ready = false;
+    match_data->parent_path_ready = false;
+}
+
+void
+fsearch_query_match_data_set_folded_names(FsearchQueryMatchData *match_data, FsearchFoldedNames *folded_names) {
+    if (!match_data) {
+        return;
+    }
+    match_data->folded_names = folded_names;
+    match_data->utf_name_ready = false;
+}
+
+void
+fsearch_query_match_data_set_cancellable(FsearchQueryMatchData *match_data, GCancellable *cancellable) {
+    if (!match_data) {
+        return;
+    }
+    match_data->cancellable = cancellable;
+}
+
+GCancellable *
+fsearch_query_match_data_get_cancellable(FsearchQueryMatchData *match_data) {
+    return match_data ? match_data->cancellable : NULL;
+}
+
+void
+fsearch_query_match_data_set_columns(FsearchQueryMatchData *match_data,
+                                     const FsearchDatabaseEntryColumns *columns,
+                                     uint32_t column_idx) {
+    if (!match_data) {
+        return;
+    }
+    g_assert(!columns || column_idx < columns->num_entries);
+
+    match_data->columns = columns;
+    match_data->column_idx = column_idx;
+}
+
+pcre2_match_data *
+fsearch_query_match_data_get_regex_match_data(FsearchQueryMatchData *match_data, const pcre2_code *regex) {
+    uint32_t num_captures = 0;
+    pcre2_pattern_info(regex, PCRE2_INFO_CAPTURECOUNT, &num_captures);
+    // one pair for the whole match and one for every capture group
+    if (!match_data->regex_match_data || pcre2_get_ovector_count(match_data->regex_match_data) <= num_captures) {
+        g_clear_pointer(&match_data->regex_match_data, pcre2_match_data_free);
+        match_data->regex_match_data = pcre2_match_data_create(num_captures + 1, NULL);
+    }
+    return match_data->regex_match_data;
+}
+
 void
 fsearch_query_match_data_set_result(FsearchQueryMatchData *match_data, bool result) {
     match_data->matches = result;
@@ -206,6 +501,16 @@ fsearch_query_match_data_get_result(FsearchQueryMatchData *match_data) {
     return match_data->matches;
 }
 
+void
+fsearch_query_match_data_add_score(FsearchQueryMatchData *match_data, uint32_t score) {
+    match_data->score = match_data->score > UINT32_MAX - score ? UINT32_MAX : match_data->score + score;
+}
+
+uint32_t
+fsearch_query_match_data_get_score(FsearchQueryMatchData *match_data) {
+    return match_data->score;
+}
+
 void
 fsearch_query_match_data_set_thread_id(FsearchQueryMatchData *match_data, int32_t thread_id) {
     match_data->thread_id = thread_id;
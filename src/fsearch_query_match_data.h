@@ -1,11 +1,21 @@
 #pragma once
 
 #include "fsearch_database_entry.h"
+#include "fsearch_database_entry_columns.h"
 #include "fsearch_database_index.h"
+#include "fsearch_folded_names.h"
+#include "fsearch_folder_paths.h"
 #include "fsearch_utf.h"
 
+#ifndef PCRE2_CODE_UNIT_WIDTH
+#define PCRE2_CODE_UNIT_WIDTH 8
+#endif
+
+#include <gio/gio.h>
 #include <pango/pango-attributes.h>
+#include <pcre2.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct FsearchQueryMatchData FsearchQueryMatchData;
@@ -16,9 +26,39 @@ fsearch_query_match_data_new(void);
 void
 fsearch_query_match_data_free(FsearchQueryMatchData *match_data);
 
+// Forgets everything about the previous query and its entries, so match_data can be reused for another one
+// without allocating all of its buffers again
+void
+fsearch_query_match_data_reset(FsearchQueryMatchData *match_data);
+
 void
 fsearch_query_match_data_set_entry(FsearchQueryMatchData *match_data, FsearchDatabaseEntry *entry);
 
+// Makes the numeric attributes of the current entry be read from columns at column_idx
+// (which must belong to that entry), instead of from the entry itself.
+// Pass NULL to drop the columns again.
+void
+fsearch_query_match_data_set_columns(FsearchQueryMatchData *match_data,
+                                     const FsearchDatabaseEntryColumns *columns,
+                                     uint32_t column_idx);
+
+// Makes the paths of entries be built from folder_paths (which must outlive match_data), may be NULL
+void
+fsearch_query_match_data_set_folder_paths(FsearchQueryMatchData *match_data, FsearchFolderPaths *folder_paths);
+
+// Makes the folded forms of non-ASCII names be taken from folded_names (which must outlive match_data),
+// instead of being computed for every entry. May be NULL.
+void
+fsearch_query_match_data_set_folded_names(FsearchQueryMatchData *match_data, FsearchFoldedNames *folded_names);
+
+// Makes nodes which take long to match an entry (e.g. because they read the file) stop once cancellable is
+// cancelled. May be NULL.
+void
+fsearch_query_match_data_set_cancellable(FsearchQueryMatchData *match_data, GCancellable *cancellable);
+
+GCancellable *
+fsearch_query_match_data_get_cancellable(FsearchQueryMatchData *match_data);
+
 void
 fsearch_query_match_data_add_highlight(FsearchQueryMatchData *match_data,
                                        PangoAttribute *attribute,
@@ -27,12 +67,24 @@ fsearch_query_match_data_add_highlight(FsearchQueryMatchData *match_data,
 PangoAttrList *
 fsearch_query_match_get_highlight(FsearchQueryMatchData *match_data, FsearchDatabaseIndexType idx);
 
+// Several nodes of a query can add to the score of an entry, it's reset for every new entry
+void
+fsearch_query_match_data_add_score(FsearchQueryMatchData *match_data, uint32_t score);
+
+uint32_t
+fsearch_query_match_data_get_score(FsearchQueryMatchData *match_data);
+
 void
 fsearch_query_match_data_set_thread_id(FsearchQueryMatchData *match_data, int32_t thread_id);
 
 int32_t
 fsearch_query_match_data_get_thread_id(FsearchQueryMatchData *match_data);
 
+// Returns match data which is large enough for regex. It's reused for all regex nodes, so query nodes don't need
+// match data of their own and can be shared by queries which run at the same time.
+pcre2_match_data *
+fsearch_query_match_data_get_regex_match_data(FsearchQueryMatchData *match_data, const pcre2_code *regex);
+
 void
 fsearch_query_match_data_set_result(FsearchQueryMatchData *match_data, bool result);
 
@@ -42,15 +94,52 @@ fsearch_query_match_data_get_result(FsearchQueryMatchData *match_data);
 const char *
 fsearch_query_match_data_get_name_str(FsearchQueryMatchData *match_data);
 
+// Case folds string into a buffer of match_data, without normalizing it. The result stays valid until the next
+// call and is NULL if the string couldn't be folded. *len is set to its length in bytes.
+const char *
+fsearch_query_match_data_fold_utf8(FsearchQueryMatchData *match_data, const char *string, size_t *len);
+
+// Length of the name, computed only once per entry.
+size_t
+fsearch_query_match_data_get_name_len(FsearchQueryMatchData *match_data);
+
 const char *
 fsearch_query_match_data_get_parent_path_str(FsearchQueryMatchData *match_data);
 
+// Nodes whose result only depends on a folder of the entry (e.g. its parent) can store that result for every
+// folder in one of these slots, numbered from 1, so it's computed only once per folder and search.
+#define FSEARCH_QUERY_MATCH_DATA_NUM_FOLDER_VERDICT_SLOTS 16
+
+// Returns true and sets *verdict if a result was stored for folder in slot
+bool
+fsearch_query_match_data_get_folder_verdict(FsearchQueryMatchData *match_data,
+                                            FsearchDatabaseEntryFolder *folder,
+                                            uint32_t slot,
+                                            bool *verdict);
+
+void
+fsearch_query_match_data_set_folder_verdict(FsearchQueryMatchData *match_data,
+                                            FsearchDatabaseEntryFolder *folder,
+                                            uint32_t slot,
+                                            bool verdict);
+
 const char *
 fsearch_query_match_data_get_path_str(FsearchQueryMatchData *match_data);
 
+size_t
+fsearch_query_match_data_get_path_len(FsearchQueryMatchData *match_data);
+
 const char *
 fsearch_query_match_data_get_content_type_str(FsearchQueryMatchData *match_data);
 
+// Returns false if the entry doesn't have the extended attribute name, otherwise its value is returned by
+// fsearch_query_match_data_get_xattr_value_str until another one is selected
+bool
+fsearch_query_match_data_select_xattr(FsearchQueryMatchData *match_data, const char *name);
+
+const char *
+fsearch_query_match_data_get_xattr_value_str(FsearchQueryMatchData *match_data);
+
 FsearchUtfBuilder *
 fsearch_query_match_data_get_utf_parent_path_builder(FsearchQueryMatchData *match_data);
 
@@ -62,3 +151,28 @@ fsearch_query_match_data_get_utf_name_builder(FsearchQueryMatchData *match_data)
 
 FsearchDatabaseEntry *
 fsearch_query_match_data_get_entry(FsearchQueryMatchData *match_data);
+
+FsearchDatabaseEntryType
+fsearch_query_match_data_get_entry_type(FsearchQueryMatchData *match_data);
+
+int64_t
+fsearch_query_match_data_get_size(FsearchQueryMatchData *match_data);
+
+int64_t
+fsearch_query_match_data_get_mtime(FsearchQueryMatchData *match_data);
+
+// The modification time or one of the optional times, 0 if the entries don't store it
+int64_t
+fsearch_query_match_data_get_time(FsearchQueryMatchData *match_data, FsearchDatabaseIndexType type);
+
+// The dictionary ids of the owner and group (see db_entry_get_user_id), FSEARCH_ID_DICTIONARY_NO_ID if the entries
+// don't store them
+uint16_t
+fsearch_query_match_data_get_user_id(FsearchQueryMatchData *match_data);
+
+uint16_t
+fsearch_query_match_data_get_group_id(FsearchQueryMatchData *match_data);
+
+// 0 if the entries don't store the owner
+uint16_t
+fsearch_query_match_data_get_mode(FsearchQueryMatchData *match_data);
@@ -1,5 +1,7 @@
 #include "fsearch_query_matchers.h"
+#include "fsearch_fuzzy.h"
 #include "fsearch_query_node.h"
+#include "fsearch_string_search.h"
 #include <string.h>
 
 uint32_t
@@ -22,22 +24,18 @@ fsearch_query_matcher_extension(FsearchQueryNode *node, FsearchQueryMatchData *m
     if (!ext) {
         return 0;
     }
-    for (uint32_t i = 0; i < node->search_term_list->len; i++) {
-        int32_t res = 0;
-        if (node->flags & QUERY_FLAG_MATCH_CASE) {
-            res = strcmp(ext, g_ptr_array_index(node->search_term_list, i));
-        }
-        else {
-            res = strcasecmp(ext, g_ptr_array_index(node->search_term_list, i));
-        }
-        if (res == 0) {
-            return 1;
-        }
-        else if (res < 0) {
-            return 0;
-        }
+    if (node->flags & QUERY_FLAG_MATCH_CASE) {
+        return g_hash_table_contains(node->search_term_set, ext) ? 1 : 0;
     }
-    return 0;
+    const size_t ext_len = strlen(ext);
+    if (ext_len > node->max_search_term_len) {
+        return 0;
+    }
+    char folded_ext[ext_len + 1];
+    for (size_t i = 0; i <= ext_len; i++) {
+        folded_ext[i] = g_ascii_tolower(ext[i]);
+    }
+    return g_hash_table_contains(node->search_term_set, folded_ext) ? 1 : 0;
 }
 
 static inline uint32_t
@@ -64,12 +62,56 @@ uint32_t
 fsearch_query_matcher_date_modified(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
     if (entry) {
-        const time_t time = db_entry_get_mtime(entry);
+        const int64_t time = fsearch_query_match_data_get_mtime(match_data);
         return cmp_num(time, node);
     }
     return 0;
 }
 
+static inline uint32_t
+cmp_time(FsearchQueryNode *node, FsearchQueryMatchData *match_data, FsearchDatabaseIndexType type) {
+    FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
+    if (entry) {
+        return cmp_num(fsearch_query_match_data_get_time(match_data, type), node);
+    }
+    return 0;
+}
+
+uint32_t
+fsearch_query_matcher_date_accessed(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return cmp_time(node, match_data, DATABASE_INDEX_TYPE_ACCESS_TIME);
+}
+
+uint32_t
+fsearch_query_matcher_date_created(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return cmp_time(node, match_data, DATABASE_INDEX_TYPE_CREATION_TIME);
+}
+
+uint32_t
+fsearch_query_matcher_date_changed(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return cmp_time(node, match_data, DATABASE_INDEX_TYPE_STATUS_CHANGE_TIME);
+}
+
+uint32_t
+fsearch_query_matcher_owner(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return fsearch_query_match_data_get_user_id(match_data) == node->num_start;
+}
+
+uint32_t
+fsearch_query_matcher_group(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return fsearch_query_match_data_get_group_id(match_data) == node->num_start;
+}
+
+uint32_t
+fsearch_query_matcher_perm(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return (fsearch_query_match_data_get_mode(match_data) & node->num_end) == node->num_start;
+}
+
+uint32_t
+fsearch_query_matcher_perm_any(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    return (fsearch_query_match_data_get_mode(match_data) & node->num_end) != 0;
+}
+
 uint32_t
 fsearch_query_matcher_depth(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
@@ -114,7 +156,7 @@ uint32_t
 fsearch_query_matcher_size(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
     if (entry) {
-        const int64_t size = db_entry_get_size(entry);
+        const int64_t size = fsearch_query_match_data_get_size(match_data);
         return cmp_num(size, node);
     }
     return 0;
@@ -123,9 +165,9 @@ fsearch_query_matcher_size(FsearchQueryNode *node, FsearchQueryMatchData *match_
 static void
 add_path_highlight(FsearchQueryMatchData *match_data, uint32_t start_idx, uint32_t needle_len) {
     // It's possible that the path highlighting spans across both the path and name string
-    const char *name = fsearch_query_match_data_get_name_str(match_data);
+    // the name might be decoded into a temporary buffer which building the path reuses
+    const size_t name_len = fsearch_query_match_data_get_name_len(match_data);
     const char *path = fsearch_query_match_data_get_path_str(match_data);
-    const size_t name_len = strlen(name);
     const size_t path_len = strlen(path);
     const size_t parent_len = path_len - name_len;
 
@@ -156,6 +198,62 @@ add_path_highlight(FsearchQueryMatchData *match_data, uint32_t start_idx, uint32
     }
 }
 
+static bool
+regex_literal_equals(FsearchQueryNode *node, const char *s) {
+    if (node->flags & QUERY_FLAG_MATCH_CASE) {
+        return !memcmp(s, node->regex_literal, node->regex_literal_len);
+    }
+    return !g_ascii_strncasecmp(s, node->regex_literal, node->regex_literal_len);
+}
+
+// Returns false if the haystack can't match the regex because it doesn't contain its literal
+static bool
+regex_literal_matches(FsearchQueryNode *node, const char *haystack, size_t haystack_len) {
+    const size_t literal_len = node->regex_literal_len;
+    if (haystack_len < literal_len) {
+        return false;
+    }
+    if (node->regex_literal_is_prefix) {
+        return regex_literal_equals(node, haystack);
+    }
+    if (node->regex_literal_is_suffix) {
+        // $ also matches right before a trailing newline
+        if (regex_literal_equals(node, haystack + haystack_len - literal_len)) {
+            return true;
+        }
+        return haystack_len > literal_len && haystack[haystack_len - 1] == '\n'
+            && regex_literal_equals(node, haystack + haystack_len - literal_len - 1);
+    }
+    if (node->flags & QUERY_FLAG_MATCH_CASE) {
+        return memmem(haystack, haystack_len, node->regex_literal, literal_len) != NULL;
+    }
+    return fsearch_string_search_ascii_icase(haystack, haystack_len, node->regex_literal, literal_len) != NULL;
+}
+
+uint32_t
+fsearch_query_matcher_content(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    if (fsearch_query_match_data_get_entry_type(match_data) != DATABASE_ENTRY_TYPE_FILE) {
+        return 0;
+    }
+    return fsearch_content_search_matches_file(node->content_search,
+                                               fsearch_query_match_data_get_path_str(match_data),
+                                               fsearch_query_match_data_get_cancellable(match_data))
+             ? 1
+             : 0;
+}
+
+uint32_t
+fsearch_query_matcher_xattr(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    if (!fsearch_query_match_data_select_xattr(match_data, node->xattr_name)) {
+        return 0;
+    }
+    FsearchQueryNode *value_node = node->xattr_value_node;
+    if (!value_node) {
+        return 1;
+    }
+    return value_node->search_func(value_node, match_data) ? 1 : 0;
+}
+
 uint32_t
 fsearch_query_matcher_regex(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     const char *haystack = node->haystack_func(match_data);
@@ -163,8 +261,10 @@ fsearch_query_matcher_regex(FsearchQueryNode *node, FsearchQueryMatchData *match
     if (G_UNLIKELY(!node->regex)) {
         return 0;
     }
-    const int32_t thread_id = fsearch_query_match_data_get_thread_id(match_data);
-    pcre2_match_data *regex_match_data = g_ptr_array_index(node->regex_match_data_for_threads, thread_id);
+    if (node->regex_literal && !regex_literal_matches(node, haystack, haystack_len)) {
+        return 0;
+    }
+    pcre2_match_data *regex_match_data = fsearch_query_match_data_get_regex_match_data(match_data, node->regex);
     if (G_UNLIKELY(!regex_match_data)) {
         return 0;
     }
@@ -180,10 +280,24 @@ fsearch_query_matcher_regex(FsearchQueryNode *node, FsearchQueryMatchData *match
     return num_matches > 0 ? 1 : 0;
 }
 
+static inline bool
+utf8_forms_available(FsearchUtfBuilder *haystack_builder, FsearchUtfBuilder *needle_builder) {
+    return haystack_builder->string_utf8_is_folded_and_normalized && needle_builder->string_utf8_is_folded_and_normalized;
+}
+
 uint32_t
 fsearch_query_matcher_utf_strcasestr(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     FsearchUtfBuilder *haystack_builder = node->haystack_func(match_data);
     FsearchUtfBuilder *needle_builder = node->needle_builder;
+    if (utf8_forms_available(haystack_builder, needle_builder)) {
+        // both were folded without ICU, the UTF-8 forms can be compared without converting the haystack to UTF-16
+        return memmem(haystack_builder->string_utf8_normalized_folded,
+                      haystack_builder->string_utf8_normalized_folded_len,
+                      needle_builder->string_utf8_normalized_folded,
+                      needle_builder->string_utf8_normalized_folded_len)
+                 ? 1
+                 : 0;
+    }
     if (G_LIKELY(haystack_builder->string_is_folded_and_normalized)) {
         return u_strFindFirst(haystack_builder->string_normalized_folded,
                               haystack_builder->string_normalized_folded_len,
@@ -199,6 +313,14 @@ uint32_t
 fsearch_query_matcher_utf_strcasecmp(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     FsearchUtfBuilder *haystack_builder = node->haystack_func(match_data);
     FsearchUtfBuilder *needle_builder = node->needle_builder;
+    if (utf8_forms_available(haystack_builder, needle_builder)) {
+        return haystack_builder->string_utf8_normalized_folded_len == needle_builder->string_utf8_normalized_folded_len
+                    && !memcmp(haystack_builder->string_utf8_normalized_folded,
+                               needle_builder->string_utf8_normalized_folded,
+                               needle_builder->string_utf8_normalized_folded_len)
+                 ? 1
+                 : 0;
+    }
     if (G_LIKELY(haystack_builder->string_is_folded_and_normalized)) {
         return !u_strCompare(haystack_builder->string_normalized_folded,
                              haystack_builder->string_normalized_folded_len,
@@ -216,9 +338,158 @@ fsearch_query_matcher_strstr(FsearchQueryNode *node, FsearchQueryMatchData *matc
     return strstr(node->haystack_func(match_data), node->needle) ? 1 : 0;
 }
 
+static size_t
+get_haystack_len(FsearchQueryNode *node, FsearchQueryMatchData *match_data, const char *haystack) {
+    if (node->haystack_func == (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_path_str) {
+        return fsearch_query_match_data_get_path_len(match_data);
+    }
+    else if (node->haystack_func == (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_name_str) {
+        return fsearch_query_match_data_get_name_len(match_data);
+    }
+    // e.g. the content type
+    return strlen(haystack);
+}
+
+static const char *
+ascii_icase_search(FsearchQueryNode *node, FsearchQueryMatchData *match_data, const char *haystack) {
+    return fsearch_string_search_ascii_icase(haystack,
+                                             get_haystack_len(node, match_data, haystack),
+                                             node->needle,
+                                             node->needle_len);
+}
+
+uint32_t
+fsearch_query_matcher_ascii_strcasestr(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    const char *haystack = node->haystack_func(match_data);
+    if (!haystack) {
+        return 0;
+    }
+    return ascii_icase_search(node, match_data, haystack) ? 1 : 0;
+}
+
+uint32_t
+fsearch_query_matcher_wildcard(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    const char *haystack = node->haystack_func(match_data);
+    if (!haystack) {
+        return 0;
+    }
+    return fsearch_wildcard_match(node->wildcard, haystack, get_haystack_len(node, match_data, haystack), NULL) ? 1 : 0;
+}
+
 uint32_t
-fsearch_query_matcher_strcasestr(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
-    return strcasestr(node->haystack_func(match_data), node->needle) ? 1 : 0;
+fsearch_query_matcher_aho_corasick(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    const char *haystack = node->haystack_func(match_data);
+    if (!haystack) {
+        return 0;
+    }
+    const size_t haystack_len = node->flags & QUERY_FLAG_SEARCH_IN_PATH
+                                  ? fsearch_query_match_data_get_path_len(match_data)
+                                  : fsearch_query_match_data_get_name_len(match_data);
+    return fsearch_aho_corasick_contains_any(node->aho_corasick, haystack, haystack_len) ? 1 : 0;
+}
+
+// Returns the haystack of a fuzzy node, it's case folded if the node needs that. *is_folded is set then.
+static const char *
+fuzzy_get_haystack(FsearchQueryNode *node, FsearchQueryMatchData *match_data, size_t *len, bool *is_folded) {
+    const bool search_in_path = node->flags & QUERY_FLAG_SEARCH_IN_PATH;
+    const char *haystack = node->haystack_func(match_data);
+    *is_folded = false;
+    if (!haystack) {
+        return NULL;
+    }
+    *len = search_in_path ? fsearch_query_match_data_get_path_len(match_data)
+                          : fsearch_query_match_data_get_name_len(match_data);
+    if (!node->fold_haystack) {
+        return haystack;
+    }
+    // ASCII letters are compared regardless of their case anyway
+    const bool is_ascii = search_in_path ? g_str_is_ascii(haystack)
+                                         : db_entry_name_is_ascii(fsearch_query_match_data_get_entry(match_data));
+    if (is_ascii) {
+        return haystack;
+    }
+    *is_folded = true;
+    return fsearch_query_match_data_fold_utf8(match_data, haystack, len);
+}
+
+uint32_t
+fsearch_query_matcher_fuzzy(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    size_t haystack_len = 0;
+    bool is_folded = false;
+    const char *haystack = fuzzy_get_haystack(node, match_data, &haystack_len, &is_folded);
+    if (!haystack) {
+        return 0;
+    }
+    uint32_t score = 0;
+    if (!fsearch_fuzzy_match(haystack,
+                             haystack_len,
+                             node->needle,
+                             node->needle_len,
+                             !(node->flags & QUERY_FLAG_MATCH_CASE),
+                             &score,
+                             NULL)) {
+        return 0;
+    }
+    fsearch_query_match_data_add_score(match_data, score);
+    return 1;
+}
+
+static bool
+name_contains_needle(FsearchQueryNode *node, const char *name, size_t name_len) {
+    if (node->flags & QUERY_FLAG_MATCH_CASE) {
+        return strstr(name, node->needle);
+    }
+    return fsearch_string_search_ascii_icase(name, name_len, node->needle, node->needle_len);
+}
+
+static bool
+folder_path_contains_needle(FsearchQueryNode *node,
+                            FsearchQueryMatchData *match_data,
+                            FsearchDatabaseEntryFolder *folder) {
+    if (!folder) {
+        return false;
+    }
+    bool verdict = false;
+    if (fsearch_query_match_data_get_folder_verdict(match_data, folder, node->folder_verdict_slot, &verdict)) {
+        return verdict;
+    }
+    FsearchDatabaseEntry *entry = (FsearchDatabaseEntry *)folder;
+    const char *name = db_entry_get_name_raw(entry);
+    // once a folder contains the needle, so do the paths of all entries below it
+    verdict = name_contains_needle(node, name, strlen(name))
+           || folder_path_contains_needle(node, match_data, db_entry_get_parent(entry));
+    fsearch_query_match_data_set_folder_verdict(match_data, folder, node->folder_verdict_slot, verdict);
+    return verdict;
+}
+
+uint32_t
+fsearch_query_matcher_path_substring(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
+    if (!entry) {
+        return 0;
+    }
+    if (name_contains_needle(node,
+                             fsearch_query_match_data_get_name_str(match_data),
+                             fsearch_query_match_data_get_name_len(match_data))) {
+        return 1;
+    }
+    return folder_path_contains_needle(node, match_data, db_entry_get_parent(entry)) ? 1 : 0;
+}
+
+uint32_t
+fsearch_query_matcher_parent(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    FsearchDatabaseEntry *entry = fsearch_query_match_data_get_entry(match_data);
+    FsearchDatabaseEntryFolder *parent = entry ? db_entry_get_parent(entry) : NULL;
+    const uint32_t slot = node->folder_verdict_slot;
+    bool verdict = false;
+    if (parent && fsearch_query_match_data_get_folder_verdict(match_data, parent, slot, &verdict)) {
+        return verdict ? 1 : 0;
+    }
+    verdict = node->folder_func(node, match_data);
+    if (parent) {
+        fsearch_query_match_data_set_folder_verdict(match_data, parent, slot, verdict);
+    }
+    return verdict ? 1 : 0;
 }
 
 uint32_t
@@ -277,14 +548,20 @@ uint32_t
 fsearch_query_matcher_highlight_regex(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     const bool search_in_path = node->flags & QUERY_FLAG_SEARCH_IN_PATH;
     const char *haystack = node->haystack_func(match_data);
-    const int32_t thread_id = fsearch_query_match_data_get_thread_id(match_data);
     const size_t haystack_len = strlen(haystack);
-    pcre2_match_data *regex_match_data = g_ptr_array_index(node->regex_match_data_for_threads, thread_id);
+    pcre2_match_data *regex_match_data = fsearch_query_match_data_get_regex_match_data(match_data, node->regex);
     if (!regex_match_data) {
         return 0;
     }
-    const int num_matches =
-        pcre2_match(node->regex, (PCRE2_SPTR)haystack, (PCRE2_SIZE)haystack_len, 0, 0, regex_match_data, NULL);
+    int num_matches = 0;
+    if (G_LIKELY(node->regex_jit_available)) {
+        num_matches =
+            pcre2_jit_match(node->regex, (PCRE2_SPTR)haystack, (PCRE2_SIZE)haystack_len, 0, 0, regex_match_data, NULL);
+    }
+    else {
+        num_matches =
+            pcre2_match(node->regex, (PCRE2_SPTR)haystack, (PCRE2_SIZE)haystack_len, 0, 0, regex_match_data, NULL);
+    }
     if (num_matches <= 0) {
         return 0;
     }
@@ -322,20 +599,102 @@ fsearch_query_matcher_highlight_ascii(FsearchQueryNode *node, FsearchQueryMatchD
         }
         return 0;
     }
-    char *dest = node->flags & QUERY_FLAG_MATCH_CASE ? strstr(haystack, node->needle)
-                                                     : strcasestr(haystack, node->needle);
+    const char *dest = node->flags & QUERY_FLAG_MATCH_CASE ? strstr(haystack, node->needle)
+                                                           : ascii_icase_search(node, match_data, haystack);
     if (!dest) {
         return 0;
     }
     if (search_in_path) {
-        const size_t needle_len = strlen(node->needle);
-        add_path_highlight(match_data, dest - haystack, needle_len);
+        add_path_highlight(match_data, dest - haystack, node->needle_len);
     }
     else {
         PangoAttribute *pa = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
         pa->start_index = dest - haystack;
-        pa->end_index = pa->start_index + strlen(node->needle);
+        pa->end_index = pa->start_index + node->needle_len;
         fsearch_query_match_data_add_highlight(match_data, pa, DATABASE_INDEX_TYPE_NAME);
     }
     return 1;
 }
+
+uint32_t
+fsearch_query_matcher_highlight_wildcard(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    const char *haystack = node->haystack_func(match_data);
+    if (!haystack) {
+        return 0;
+    }
+    const uint32_t num_segments = fsearch_wildcard_get_num_segments(node->wildcard);
+    uint32_t offsets[num_segments + 1];
+    if (!fsearch_wildcard_match(node->wildcard, haystack, get_haystack_len(node, match_data, haystack), offsets)) {
+        return 0;
+    }
+
+    // only the literal parts of the pattern get highlighted, not what the wildcards matched
+    const bool search_in_path = node->flags & QUERY_FLAG_SEARCH_IN_PATH;
+    for (uint32_t i = 0; i < num_segments; i++) {
+        const size_t len = fsearch_wildcard_get_segment_len(node->wildcard, i);
+        if (len == 0) {
+            continue;
+        }
+        if (search_in_path) {
+            add_path_highlight(match_data, offsets[i], len);
+        }
+        else {
+            PangoAttribute *pa = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
+            pa->start_index = offsets[i];
+            pa->end_index = pa->start_index + len;
+            fsearch_query_match_data_add_highlight(match_data, pa, DATABASE_INDEX_TYPE_NAME);
+        }
+    }
+    return 1;
+}
+
+uint32_t
+fsearch_query_matcher_highlight_fuzzy(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
+    size_t haystack_len = 0;
+    bool is_folded = false;
+    const char *haystack = fuzzy_get_haystack(node, match_data, &haystack_len, &is_folded);
+    if (!haystack) {
+        return 0;
+    }
+    uint32_t positions[node->needle_len + 1];
+    uint32_t score = 0;
+    if (!fsearch_fuzzy_match(haystack,
+                             haystack_len,
+                             node->needle,
+                             node->needle_len,
+                             !(node->flags & QUERY_FLAG_MATCH_CASE),
+                             &score,
+                             positions)) {
+        return 0;
+    }
+    if (is_folded) {
+        // the offsets in the folded haystack don't match the ones in the displayed name
+        return 1;
+    }
+    uint32_t num_chars = 0;
+    for (size_t i = 0; i < node->needle_len; num_chars++) {
+        i += fsearch_fuzzy_char_len(node->needle + i, node->needle_len - i);
+    }
+
+    // characters next to each other get a single highlight
+    const bool search_in_path = node->flags & QUERY_FLAG_SEARCH_IN_PATH;
+    for (uint32_t i = 0; i < num_chars;) {
+        const uint32_t start_idx = positions[i];
+        uint32_t end_idx = start_idx;
+        do {
+            end_idx += fsearch_fuzzy_char_len(haystack + positions[i], haystack_len - positions[i]);
+            i++;
+        } while (i < num_chars && positions[i] == end_idx);
+
+        if (search_in_path) {
+            add_path_highlight(match_data, start_idx, end_idx - start_idx);
+        }
+        else {
+            PangoAttribute *pa = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
+            pa->start_index = start_idx;
+            pa->end_index = end_idx;
+            fsearch_query_match_data_add_highlight(match_data, pa, DATABASE_INDEX_TYPE_NAME);
+        }
+    }
+    return 1;
+}
@@ -18,6 +18,30 @@ fsearch_query_matcher_extension(FsearchQueryNode *node, FsearchQueryMatchData *m
 uint32_t
 fsearch_query_matcher_date_modified(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
+uint32_t
+fsearch_query_matcher_date_accessed(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+uint32_t
+fsearch_query_matcher_date_created(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+uint32_t
+fsearch_query_matcher_date_changed(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// The owner and group match if their dictionary id is num_start
+uint32_t
+fsearch_query_matcher_owner(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+uint32_t
+fsearch_query_matcher_group(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Matches if the bits num_end of the mode are num_start
+uint32_t
+fsearch_query_matcher_perm(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Matches if any of the bits num_end of the mode is set
+uint32_t
+fsearch_query_matcher_perm_any(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
 uint32_t
 fsearch_query_matcher_depth(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
@@ -33,9 +57,22 @@ fsearch_query_matcher_childfoldercount(FsearchQueryNode *node, FsearchQueryMatch
 uint32_t
 fsearch_query_matcher_size(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
+// Matches files whose contents match the content search of the node, see fsearch_content_search.h
+uint32_t
+fsearch_query_matcher_content(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Matches entries which have the extended attribute of the node, with a value which matches its value node
+uint32_t
+fsearch_query_matcher_xattr(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
 uint32_t
 fsearch_query_matcher_regex(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
+// Fuzzy matching with fsearch_fuzzy_match, adds the score of the match to the match data.
+// The haystack must be the name or the path of the entry.
+uint32_t
+fsearch_query_matcher_fuzzy(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
 uint32_t
 fsearch_query_matcher_utf_strcasecmp(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
@@ -45,8 +82,30 @@ fsearch_query_matcher_utf_strcasestr(FsearchQueryNode *node, FsearchQueryMatchDa
 uint32_t
 fsearch_query_matcher_strstr(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
+// Case insensitive substring search for ASCII needles, based on fsearch_string_search_ascii_icase.
+// The haystack must be the name or the path of the entry.
+uint32_t
+fsearch_query_matcher_ascii_strcasestr(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Matches the whole haystack against the wildcard pattern of the node, see fsearch_wildcard.h
+uint32_t
+fsearch_query_matcher_wildcard(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Matches if the haystack contains any of the needles of a substring set node.
+// The haystack must be the name or the path of the entry.
 uint32_t
-fsearch_query_matcher_strcasestr(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+fsearch_query_matcher_aho_corasick(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Substring search in the path of the entry for needles without a separator, see node_init_path_substring.
+// Only the names of the entry and its parents are searched and the result for every folder is kept in the
+// folder verdict slot of the node.
+uint32_t
+fsearch_query_matcher_path_substring(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+// Looks up the result of node->folder_func for the parent of the entry in the folder verdicts and only
+// calls it if it's not known yet.
+uint32_t
+fsearch_query_matcher_parent(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
 
 uint32_t
 fsearch_query_matcher_strcmp(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
@@ -68,3 +127,9 @@ fsearch_query_matcher_highlight_regex(FsearchQueryNode *node, FsearchQueryMatchD
 
 uint32_t
 fsearch_query_matcher_highlight_ascii(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+uint32_t
+fsearch_query_matcher_highlight_wildcard(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
+
+uint32_t
+fsearch_query_matcher_highlight_fuzzy(FsearchQueryNode *node, FsearchQueryMatchData *match_data);
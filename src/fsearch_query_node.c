@@ -1,7 +1,6 @@
 #define G_LOG_DOMAIN "fsearch-query-node"
 
 #include "fsearch_query_node.h"
-#include "fsearch_limits.h"
 #include "fsearch_query_matchers.h"
 #include "fsearch_size_utils.h"
 #include "fsearch_string_utils.h"
@@ -11,6 +10,26 @@
 #include <stdbool.h>
 #include <string.h>
 
+// Relative costs of the different kinds of nodes
+#define QUERY_NODE_COST_CONSTANT 0
+#define QUERY_NODE_COST_NUMERIC 1
+#define QUERY_NODE_COST_EXTENSION 2
+#define QUERY_NODE_COST_ASCII 4
+#define QUERY_NODE_COST_WILDCARD 8
+#define QUERY_NODE_COST_UTF 16
+#define QUERY_NODE_COST_REGEX 32
+// the content type has to be guessed from the file contents
+#define QUERY_NODE_COST_CONTENT_TYPE 1024
+// the file has to be read
+#define QUERY_NODE_COST_FILE_CONTENT 65536
+// the path has to be built from the names of all parents first
+#define QUERY_NODE_COST_PATH_FACTOR 2
+
+static uint32_t
+get_haystack_cost(uint32_t cost, FsearchQueryFlags flags) {
+    return flags & QUERY_FLAG_SEARCH_IN_PATH ? cost * QUERY_NODE_COST_PATH_FACTOR : cost;
+}
+
 static void
 node_init_needle(FsearchQueryNode *node, const char *needle) {
     g_assert(node);
@@ -38,13 +57,20 @@ fsearch_query_node_free(FsearchQueryNode *node) {
         g_string_free(g_steal_pointer(&node->description), TRUE);
     }
     g_clear_pointer(&node->search_term_list, g_ptr_array_unref);
+    g_clear_pointer(&node->search_term_set, g_hash_table_destroy);
+    g_clear_pointer(&node->aho_corasick, fsearch_aho_corasick_free);
     g_clear_pointer(&node->needle_builder, free);
     g_clear_pointer(&node->needle, g_free);
-
-    if (node->regex_match_data_for_threads) {
-        g_ptr_array_free(g_steal_pointer(&node->regex_match_data_for_threads), TRUE);
-    }
+    g_clear_pointer(&node->name_literal, g_free);
+    g_clear_pointer(&node->exact_name, g_free);
+    g_clear_pointer(&node->name_prefix, g_free);
+    g_clear_pointer(&node->regex_literal, g_free);
+    g_clear_pointer(&node->regex_prefix, g_free);
     g_clear_pointer(&node->regex, pcre2_code_free);
+    g_clear_pointer(&node->wildcard, fsearch_wildcard_free);
+    g_clear_pointer(&node->content_search, fsearch_content_search_free);
+    g_clear_pointer(&node->xattr_name, g_free);
+    g_clear_pointer(&node->xattr_value_node, fsearch_query_node_free);
 
     g_clear_pointer(&node, g_free);
 }
@@ -89,20 +115,100 @@ new_numeric_node(int64_t num_start,
     qnode->search_func = search_func;
     qnode->highlight_func = highlight_func;
     qnode->flags = flags;
+    qnode->cost = QUERY_NODE_COST_NUMERIC;
     return qnode;
 }
 
-FsearchQueryNode *
-fsearch_query_node_new_date_modified(FsearchQueryFlags flags,
-                                     int64_t dm_start,
-                                     int64_t dm_end,
-                                     FsearchQueryNodeComparison comp_type) {
+static FsearchQueryNode *
+new_date_node(int64_t start,
+              int64_t end,
+              FsearchQueryNodeComparison comp_type,
+              const char *description,
+              FsearchQueryNodeMatchFunc search_func,
+              FsearchQueryFlags flags) {
     if (comp_type == FSEARCH_QUERY_NODE_COMPARISON_EQUAL) {
         // For dates we need to convert comparisons for equality to ranges.
         // E.g. dm:=january doesn't mean 1 January 00:00 but the whole January
         comp_type = FSEARCH_QUERY_NODE_COMPARISON_RANGE;
     }
-    return new_numeric_node(dm_start, dm_end, comp_type, "date-modified", fsearch_query_matcher_date_modified, NULL, flags);
+    FsearchQueryNode *qnode = new_numeric_node(start, end, comp_type, description, search_func, NULL, flags);
+    qnode->wants_entry_columns = true;
+    return qnode;
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_date_modified(FsearchQueryFlags flags,
+                                     int64_t dm_start,
+                                     int64_t dm_end,
+                                     FsearchQueryNodeComparison comp_type) {
+    return new_date_node(dm_start, dm_end, comp_type, "date-modified", fsearch_query_matcher_date_modified, flags);
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_date_accessed(FsearchQueryFlags flags,
+                                     int64_t da_start,
+                                     int64_t da_end,
+                                     FsearchQueryNodeComparison comp_type) {
+    return new_date_node(da_start, da_end, comp_type, "date-accessed", fsearch_query_matcher_date_accessed, flags);
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_date_created(FsearchQueryFlags flags,
+                                    int64_t dc_start,
+                                    int64_t dc_end,
+                                    FsearchQueryNodeComparison comp_type) {
+    return new_date_node(dc_start, dc_end, comp_type, "date-created", fsearch_query_matcher_date_created, flags);
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_date_changed(FsearchQueryFlags flags,
+                                    int64_t dstat_start,
+                                    int64_t dstat_end,
+                                    FsearchQueryNodeComparison comp_type) {
+    return new_date_node(dstat_start, dstat_end, comp_type, "date-changed", fsearch_query_matcher_date_changed, flags);
+}
+
+static FsearchQueryNode *
+new_owner_node(const char *needle,
+               int64_t value,
+               int64_t mask,
+               const char *description,
+               FsearchQueryNodeMatchFunc search_func,
+               FsearchQueryFlags flags) {
+    FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
+    g_assert(qnode);
+
+    qnode->needle = g_strdup(needle);
+    qnode->description = g_string_new(description);
+    qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
+    qnode->num_start = value;
+    qnode->num_end = mask;
+    qnode->comparison_type = FSEARCH_QUERY_NODE_COMPARISON_EQUAL;
+    qnode->search_func = search_func;
+    qnode->flags = flags;
+    qnode->cost = QUERY_NODE_COST_NUMERIC;
+    qnode->wants_entry_columns = true;
+    return qnode;
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_owner(FsearchQueryFlags flags, const char *name, uint16_t user_id) {
+    return new_owner_node(name, user_id, UINT16_MAX, "owner", fsearch_query_matcher_owner, flags);
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_group(FsearchQueryFlags flags, const char *name, uint16_t group_id) {
+    return new_owner_node(name, group_id, UINT16_MAX, "group", fsearch_query_matcher_group, flags);
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_perm(FsearchQueryFlags flags, const char *needle, uint16_t mask, uint16_t bits, bool any) {
+    return new_owner_node(needle,
+                          any ? 0 : bits & mask,
+                          mask,
+                          "perm",
+                          any ? fsearch_query_matcher_perm_any : fsearch_query_matcher_perm,
+                          flags);
 }
 
 FsearchQueryNode *
@@ -110,13 +216,15 @@ fsearch_query_node_new_size(FsearchQueryFlags flags,
                             int64_t size_start,
                             int64_t size_end,
                             FsearchQueryNodeComparison comp_type) {
-    return new_numeric_node(size_start,
-                            size_end,
-                            comp_type,
-                            "size",
-                            fsearch_query_matcher_size,
-                            fsearch_query_matcher_highlight_size,
-                            flags);
+    FsearchQueryNode *qnode = new_numeric_node(size_start,
+                                               size_end,
+                                               comp_type,
+                                               "size",
+                                               fsearch_query_matcher_size,
+                                               fsearch_query_matcher_highlight_size,
+                                               flags);
+    qnode->wants_entry_columns = true;
+    return qnode;
 }
 
 FsearchQueryNode *
@@ -192,6 +300,7 @@ fsearch_query_node_new_match_nothing(void) {
     qnode->search_func = fsearch_query_matcher_false;
     qnode->highlight_func = fsearch_query_matcher_highlight_none;
     qnode->flags = 0;
+    qnode->cost = QUERY_NODE_COST_CONSTANT;
     return qnode;
 }
 
@@ -205,9 +314,127 @@ fsearch_query_node_new_match_everything(FsearchQueryFlags flags) {
     qnode->search_func = fsearch_query_matcher_true;
     qnode->highlight_func = fsearch_query_matcher_highlight_none;
     qnode->flags = flags;
+    qnode->cost = QUERY_NODE_COST_CONSTANT;
     return qnode;
 }
 
+static bool
+is_utf8_continuation_byte(char c) {
+    return ((uint8_t)c & 0xc0) == 0x80;
+}
+
+static void
+remove_last_char(GString *str) {
+    while (str->len > 0 && is_utf8_continuation_byte(str->str[str->len - 1])) {
+        g_string_truncate(str, str->len - 1);
+    }
+    if (str->len > 0) {
+        g_string_truncate(str, str->len - 1);
+    }
+}
+
+typedef struct {
+    GString *str;
+    // the literal must be at the start/end of the haystack
+    bool is_prefix;
+    bool is_suffix;
+    // only used by the longest literal: the run at the start of the haystack
+    GString *prefix;
+} RegexLiteral;
+
+static void
+keep_longest_run(RegexLiteral *longest, RegexLiteral *run) {
+    if (run->is_prefix) {
+        g_string_assign(longest->prefix, run->str->str);
+    }
+    if (run->str->len > longest->str->len) {
+        g_string_assign(longest->str, run->str->str);
+        longest->is_prefix = run->is_prefix;
+        longest->is_suffix = run->is_suffix;
+    }
+    g_string_truncate(run->str, 0);
+    run->is_prefix = false;
+    run->is_suffix = false;
+}
+
+// Finds the longest run of literal characters every match of the regex must contain and whether it's anchored
+// to the start or end of the haystack, and the literal every match starts with (if it's not the longest one).
+// Only the simple parts of the syntax are understood, the scan stops at anything else (groups, classes and escape
+// sequences like \d). Returns false if there's no such literal.
+static bool
+get_regex_literal(const char *regex, bool caseless, char **literal, bool *is_prefix, bool *is_suffix, char **prefix) {
+    // there's no single literal which is part of all alternatives
+    for (const char *s = regex; *s != '\0'; s++) {
+        if (*s == '\\' && s[1] != '\0') {
+            s++;
+        }
+        else if (*s == '|') {
+            return false;
+        }
+    }
+
+    g_autoptr(GString) longest_str = g_string_new(NULL);
+    g_autoptr(GString) run_str = g_string_new(NULL);
+    g_autoptr(GString) prefix_str = g_string_new(NULL);
+    RegexLiteral longest = {.str = longest_str, .prefix = prefix_str};
+    RegexLiteral run = {.str = run_str, .is_prefix = regex[0] == '^'};
+    for (const char *s = regex; *s != '\0'; s++) {
+        char c = *s;
+        if (c == '(' || c == '[') {
+            break;
+        }
+        if (c == '\\') {
+            // only escaped punctuation is a literal character
+            if (!g_ascii_ispunct(s[1]) && s[1] != ' ') {
+                break;
+            }
+            c = *++s;
+        }
+        else if (c == '^' && s == regex) {
+            continue;
+        }
+        else if (c == '.' || c == '^' || c == '$') {
+            run.is_suffix = c == '$' && s[1] == '\0';
+            keep_longest_run(&longest, &run);
+            continue;
+        }
+        else if (c == '?' || c == '*' || c == '{') {
+            // the previous character is optional
+            remove_last_char(run.str);
+            keep_longest_run(&longest, &run);
+            if (c == '{') {
+                const char *end = strchr(s, '}');
+                if (!end) {
+                    break;
+                }
+                s = end;
+            }
+            continue;
+        }
+        else if (c == '+') {
+            keep_longest_run(&longest, &run);
+            continue;
+        }
+        else if (caseless && ((uint8_t)c >= 0x80 || g_ascii_tolower(c) == 'k' || g_ascii_tolower(c) == 's')) {
+            // matched case insensitively with other characters than their ASCII counterparts,
+            // e.g. k with the Kelvin sign or s with the long s
+            keep_longest_run(&longest, &run);
+            continue;
+        }
+        g_string_append_c(run.str, c);
+    }
+    keep_longest_run(&longest, &run);
+
+    if (longest.str->len == 0) {
+        return false;
+    }
+    *literal = g_strdup(longest.str->str);
+    *is_prefix = longest.is_prefix;
+    *is_suffix = longest.is_suffix;
+    *prefix = prefix_str->len > 0 ? g_strdup(prefix_str->str) : NULL;
+    return true;
+}
+
 FsearchQueryNode *
 fsearch_query_node_new_regex(const char *search_term, FsearchQueryFlags flags) {
     int error_code;
@@ -243,17 +470,22 @@ fsearch_query_node_new_regex(const char *search_term, FsearchQueryFlags flags) {
     else {
         qnode->regex_jit_available = true;
     }
-    qnode->regex_match_data_for_threads = g_ptr_array_sized_new(FSEARCH_THREAD_LIMIT);
-    g_ptr_array_set_free_func(qnode->regex_match_data_for_threads, (GDestroyNotify)pcre2_match_data_free);
-    for (int32_t i = 0; i < FSEARCH_THREAD_LIMIT; i++) {
-        g_ptr_array_add(qnode->regex_match_data_for_threads, pcre2_match_data_create_from_pattern(qnode->regex, NULL));
-    }
 
     qnode->search_func = fsearch_query_matcher_regex;
     qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)(flags & QUERY_FLAG_SEARCH_IN_PATH
                                                                 ? fsearch_query_match_data_get_path_str
                                                                 : fsearch_query_match_data_get_name_str);
     qnode->highlight_func = fsearch_query_matcher_highlight_regex;
+    qnode->cost = get_haystack_cost(QUERY_NODE_COST_REGEX, flags);
+
+    if (get_regex_literal(search_term,
+                          !(flags & QUERY_FLAG_MATCH_CASE),
+                          &qnode->regex_literal,
+                          &qnode->regex_literal_is_prefix,
+                          &qnode->regex_literal_is_suffix,
+                          &qnode->regex_prefix)) {
+        qnode->regex_literal_len = strlen(qnode->regex_literal);
+    }
     return qnode;
 }
 
@@ -268,16 +500,21 @@ fsearch_query_node_new_parent(const char *search_term, FsearchQueryFlags flags)
     qnode->highlight_func = NULL;
     qnode->flags = flags;
     if (fsearch_string_is_ascii_icase(qnode->needle) || flags & QUERY_FLAG_MATCH_CASE) {
-        qnode->search_func = flags & QUERY_FLAG_MATCH_CASE ? fsearch_query_matcher_strcmp
+        qnode->folder_func = flags & QUERY_FLAG_MATCH_CASE ? fsearch_query_matcher_strcmp
                                                            : fsearch_query_matcher_strcasecmp;
         qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_parent_path_str;
         qnode->description = g_string_new("parent_ascii");
+        qnode->cost = QUERY_NODE_COST_ASCII * QUERY_NODE_COST_PATH_FACTOR;
     }
     else {
-        qnode->search_func = fsearch_query_matcher_utf_strcasecmp;
+        qnode->folder_func = fsearch_query_matcher_utf_strcasecmp;
         qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_utf_parent_path_builder;
         qnode->description = g_string_new("parent_utf");
+        qnode->cost = QUERY_NODE_COST_UTF * QUERY_NODE_COST_PATH_FACTOR;
     }
+    // all entries of a folder have the same parent path, so it's compared only once per folder
+    qnode->search_func = fsearch_query_matcher_parent;
+    qnode->wants_folder_verdicts = true;
     return qnode;
 }
 
@@ -306,6 +543,7 @@ fsearch_query_node_new_extension(const char *search_term, FsearchQueryFlags flag
     qnode->search_func = fsearch_query_matcher_extension;
     qnode->highlight_func = fsearch_query_matcher_highlight_extension;
     qnode->flags = flags | QUERY_FLAG_FILES_ONLY;
+    qnode->cost = QUERY_NODE_COST_EXTENSION;
     qnode->search_term_list = g_ptr_array_new_full(16, g_free);
     if (!search_term) {
         // Show all files with no extension
@@ -321,12 +559,40 @@ fsearch_query_node_new_extension(const char *search_term, FsearchQueryFlags flag
         }
         g_ptr_array_sort(qnode->search_term_list, (qnode->flags & QUERY_FLAG_MATCH_CASE) ? cmp_strcmp : cmp_strcasecmp);
     }
+
+    // the filters have long lists of extensions, comparing them one by one would be slow
+    qnode->search_term_set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (uint32_t i = 0; i < qnode->search_term_list->len; i++) {
+        const char *term = g_ptr_array_index(qnode->search_term_list, i);
+        qnode->max_search_term_len = MAX(qnode->max_search_term_len, strlen(term));
+        g_hash_table_add(qnode->search_term_set,
+                         qnode->flags & QUERY_FLAG_MATCH_CASE ? g_strdup(term) : g_ascii_strdown(term, -1));
+    }
     return qnode;
 }
 
 FsearchQueryNode *
 fsearch_query_node_new_wildcard(const char *search_term, FsearchQueryFlags flags) {
-    // We convert the wildcard pattern to a regex pattern
+    FsearchWildcard *wildcard = fsearch_wildcard_new(search_term, !(flags & QUERY_FLAG_MATCH_CASE));
+    if (wildcard) {
+        FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
+        g_assert(qnode);
+
+        qnode->description = g_string_new("wildcard");
+        qnode->needle = g_strdup(search_term);
+        qnode->wildcard = wildcard;
+        qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
+        qnode->flags = flags;
+        qnode->search_func = fsearch_query_matcher_wildcard;
+        qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)(flags & QUERY_FLAG_SEARCH_IN_PATH
+                                                                    ? fsearch_query_match_data_get_path_str
+                                                                    : fsearch_query_match_data_get_name_str);
+        qnode->highlight_func = fsearch_query_matcher_highlight_wildcard;
+        qnode->cost = get_haystack_cost(QUERY_NODE_COST_WILDCARD, flags);
+        return qnode;
+    }
+
+    // Patterns which need Unicode case folding are converted to a regex pattern instead
     // The regex engine is not only faster than fnmatch, but it also handles utf8 strings better
     // and it provides matching information, which are useful for the highlighting engine
     g_autofree char *regex_search_term = fsearch_string_convert_wildcard_to_regex_expression(search_term);
@@ -336,6 +602,34 @@ fsearch_query_node_new_wildcard(const char *search_term, FsearchQueryFlags flags
     return fsearch_query_node_new_regex(regex_search_term, flags);
 }
 
+FsearchQueryNode *
+fsearch_query_node_new_fuzzy(const char *search_term, FsearchQueryFlags flags) {
+    FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
+    g_assert(qnode);
+
+    qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
+    qnode->flags = flags;
+    node_init_needle(qnode, search_term);
+
+    const bool is_ascii = fsearch_string_is_ascii_icase(search_term);
+    if (!is_ascii && !(flags & QUERY_FLAG_MATCH_CASE)) {
+        // non-ASCII letters are compared byte by byte, so both sides have to be folded
+        FsearchUtfBuilder *builder = qnode->needle_builder;
+        g_free(qnode->needle);
+        qnode->needle = g_strndup(builder->string_utf8_folded, builder->string_utf8_folded_len);
+        qnode->needle_len = builder->string_utf8_folded_len;
+        qnode->fold_haystack = true;
+    }
+    qnode->search_func = fsearch_query_matcher_fuzzy;
+    qnode->highlight_func = fsearch_query_matcher_highlight_fuzzy;
+    qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)(flags & QUERY_FLAG_SEARCH_IN_PATH
+                                                                ? fsearch_query_match_data_get_path_str
+                                                                : fsearch_query_match_data_get_name_str);
+    qnode->description = g_string_new("fuzzy");
+    qnode->cost = get_haystack_cost(is_ascii ? QUERY_NODE_COST_ASCII : QUERY_NODE_COST_UTF, flags);
+    return qnode;
+}
+
 static FsearchQueryNode *
 query_node_new_string_comparison(const char *search_term, FsearchQueryFlags flags) {
     FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
@@ -352,13 +646,14 @@ query_node_new_string_comparison(const char *search_term, FsearchQueryFlags flag
         }
         else {
             qnode->search_func = flags & QUERY_FLAG_MATCH_CASE ? fsearch_query_matcher_strstr
-                                                               : fsearch_query_matcher_strcasestr;
+                                                               : fsearch_query_matcher_ascii_strcasestr;
         }
         qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)(flags & QUERY_FLAG_SEARCH_IN_PATH
                                                                     ? fsearch_query_match_data_get_path_str
                                                                     : fsearch_query_match_data_get_name_str);
         qnode->highlight_func = fsearch_query_matcher_highlight_ascii;
         qnode->description = g_string_new("ascii_icase");
+        qnode->cost = get_haystack_cost(QUERY_NODE_COST_ASCII, flags);
     }
     else {
         qnode->search_func = flags & QUERY_FLAG_EXACT_MATCH ? fsearch_query_matcher_utf_strcasecmp
@@ -368,6 +663,7 @@ query_node_new_string_comparison(const char *search_term, FsearchQueryFlags flag
                                                                     : fsearch_query_match_data_get_utf_name_builder);
         qnode->highlight_func = NULL;
         qnode->description = g_string_new("utf_icase");
+        qnode->cost = get_haystack_cost(QUERY_NODE_COST_UTF, flags);
     }
     return qnode;
 }
@@ -389,12 +685,151 @@ fsearch_query_node_new_contenttype(const char *search_term, FsearchQueryFlags fl
         g_string_prepend(res->description, "contenttype_");
         res->haystack_func = (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_content_type_str;
         res->highlight_func = fsearch_query_matcher_highlight_none;
-        res->wants_single_threaded_search = true;
+        res->cost = QUERY_NODE_COST_CONTENT_TYPE;
     }
 
     return res;
 }
 
+static FsearchQueryNode *
+query_node_new_xattr_value(const char *value, FsearchQueryFlags flags) {
+    // values are never matched against the path
+    flags &= ~QUERY_FLAG_SEARCH_IN_PATH;
+
+    FsearchQueryNode *res = NULL;
+    if (flags & QUERY_FLAG_REGEX) {
+        res = fsearch_query_node_new_regex(value, flags);
+    }
+    else if (fsearch_string_has_wildcards(value)) {
+        res = fsearch_query_node_new_wildcard(value, flags);
+    }
+    else if (flags & QUERY_FLAG_MATCH_CASE || fsearch_string_is_ascii_icase(value)) {
+        res = query_node_new_string_comparison(value, flags);
+    }
+    else {
+        // the UTF-8 matchers only work on names and paths, case folding of other strings is left to the regex engine
+        g_autofree char *escaped = g_regex_escape_string(value, -1);
+        g_autofree char *pattern =
+            flags & QUERY_FLAG_EXACT_MATCH ? g_strdup_printf("^%s$", escaped) : g_steal_pointer(&escaped);
+        res = fsearch_query_node_new_regex(pattern, flags | QUERY_FLAG_REGEX);
+    }
+
+    if (res && res->haystack_func) {
+        res->haystack_func = (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_xattr_value_str;
+        res->highlight_func = fsearch_query_matcher_highlight_none;
+    }
+    return res;
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_xattr(const char *name, const char *value, FsearchQueryFlags flags) {
+    g_assert(name);
+
+    FsearchQueryNode *value_node = NULL;
+    if (value) {
+        value_node = query_node_new_xattr_value(value, flags);
+        if (!value_node || !value_node->haystack_func) {
+            // e.g. an invalid regex
+            return value_node ? value_node : fsearch_query_node_new_match_nothing();
+        }
+    }
+
+    FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
+    g_assert(qnode);
+
+    qnode->description = g_string_new("xattr");
+    qnode->needle = value ? g_strdup_printf("%s=%s", name, value) : g_strdup(name);
+    qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
+    qnode->flags = flags;
+    qnode->xattr_name = g_strdup(name);
+    qnode->xattr_value_node = value_node;
+    qnode->search_func = fsearch_query_matcher_xattr;
+    qnode->highlight_func = fsearch_query_matcher_highlight_none;
+    qnode->cost = QUERY_NODE_COST_ASCII + (value_node ? value_node->cost : 0);
+    return qnode;
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_content(const char *search_term, FsearchQueryFlags flags) {
+    FsearchContentSearch *content_search =
+        fsearch_content_search_new(search_term, flags & QUERY_FLAG_MATCH_CASE, flags & QUERY_FLAG_REGEX);
+    if (!content_search) {
+        return fsearch_query_node_new_match_nothing();
+    }
+
+    FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
+    g_assert(qnode);
+
+    qnode->description = g_string_new("content");
+    qnode->needle = g_strdup(search_term);
+    qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
+    qnode->flags = flags;
+    qnode->content_search = content_search;
+    qnode->search_func = fsearch_query_matcher_content;
+    qnode->highlight_func = fsearch_query_matcher_highlight_none;
+    qnode->cost = QUERY_NODE_COST_FILE_CONTENT;
+    return qnode;
+}
+
+// The name arrays are sorted case sensitively, so the prefix of a node which ignores the case can only be looked up
+// in them if it has no letters
+static void
+node_init_name_prefix(FsearchQueryNode *node, const char *prefix) {
+    const size_t prefix_len = prefix ? strlen(prefix) : 0;
+    if (prefix_len == 0 || g_ascii_isdigit(prefix[prefix_len - 1])) {
+        return;
+    }
+    if (!(node->flags & QUERY_FLAG_MATCH_CASE)) {
+        for (const char *s = prefix; *s != '\0'; s++) {
+            if (g_ascii_isalpha(*s)) {
+                return;
+            }
+        }
+    }
+    node->name_prefix = g_strdup(prefix);
+}
+
+static void
+node_init_name_literal(FsearchQueryNode *node) {
+    if (node->haystack_func != (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_name_str
+        || node->search_func == fsearch_query_matcher_fuzzy) {
+        return;
+    }
+    if (node->regex) {
+        node->name_literal = g_strdup(node->regex_literal);
+        node_init_name_prefix(node, node->regex_prefix);
+    }
+    else if (node->wildcard) {
+        node->name_literal = g_strdup(fsearch_wildcard_get_longest_literal(node->wildcard));
+        node_init_name_prefix(node, fsearch_wildcard_get_prefix(node->wildcard));
+    }
+    else {
+        // the needle is matched as a whole, either exactly or with ASCII case folding
+        node->name_literal = g_strdup(node->needle);
+        if (node->search_func == fsearch_query_matcher_strcmp
+            || node->search_func == fsearch_query_matcher_strcasecmp) {
+            node->exact_name = g_strdup(node->needle);
+            node_init_name_prefix(node, node->needle);
+        }
+    }
+}
+
+// A needle without a separator can't span several names of the path, so the path contains it if the name of the entry
+// or of one of its parent folders does. Whether the path of a folder contains it is only computed once per folder
+// then and the full path doesn't have to be built at all.
+static void
+node_init_path_substring(FsearchQueryNode *node) {
+    if (!(node->flags & QUERY_FLAG_SEARCH_IN_PATH) || node->flags & QUERY_FLAG_EXACT_MATCH
+        || (node->search_func != fsearch_query_matcher_strstr
+            && node->search_func != fsearch_query_matcher_ascii_strcasestr)
+        || strchr(node->needle, G_DIR_SEPARATOR)) {
+        return;
+    }
+    node->search_func = fsearch_query_matcher_path_substring;
+    node->wants_folder_verdicts = true;
+    node->cost = QUERY_NODE_COST_ASCII;
+}
+
 FsearchQueryNode *
 fsearch_query_node_new(const char *search_term, FsearchQueryFlags flags) {
     const bool has_separator = strchr(search_term, G_DIR_SEPARATOR) ? 1 : 0;
@@ -415,6 +850,9 @@ fsearch_query_node_new(const char *search_term, FsearchQueryFlags flags) {
     if (flags & QUERY_FLAG_REGEX) {
         res = fsearch_query_node_new_regex(search_term, flags);
     }
+    else if (flags & QUERY_FLAG_FUZZY) {
+        res = fsearch_query_node_new_fuzzy(search_term, flags);
+    }
     else if (fsearch_string_has_wildcards(search_term)) {
         res = fsearch_query_node_new_wildcard(search_term, flags);
     }
@@ -424,6 +862,40 @@ fsearch_query_node_new(const char *search_term, FsearchQueryFlags flags) {
     if (res) {
         res->triggers_auto_match_case = triggers_auto_match_case;
         res->triggers_auto_match_path = triggers_auto_match_path;
+        node_init_name_literal(res);
+        node_init_path_substring(res);
     }
     return res;
 }
+
+bool
+fsearch_query_node_is_substring(FsearchQueryNode *node) {
+    return node->type == FSEARCH_QUERY_NODE_TYPE_QUERY
+        && (node->search_func == fsearch_query_matcher_strstr
+            || node->search_func == fsearch_query_matcher_ascii_strcasestr);
+}
+
+FsearchQueryNode *
+fsearch_query_node_new_substring_set(FsearchQueryNode **nodes, uint32_t num_nodes) {
+    g_assert(num_nodes > 0);
+
+    FsearchQueryNode *qnode = calloc(1, sizeof(FsearchQueryNode));
+    g_assert(qnode);
+
+    g_autofree const char **needles = calloc(num_nodes, sizeof(char *));
+    g_assert(needles);
+    qnode->description = g_string_new("substring_set");
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        g_assert(fsearch_query_node_is_substring(nodes[i]));
+        g_assert(nodes[i]->flags == nodes[0]->flags);
+        needles[i] = nodes[i]->needle;
+        qnode->cost += nodes[i]->cost;
+    }
+    qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
+    qnode->flags = nodes[0]->flags;
+    qnode->aho_corasick = fsearch_aho_corasick_new(needles, num_nodes, !(qnode->flags & QUERY_FLAG_MATCH_CASE));
+    qnode->search_func = fsearch_query_matcher_aho_corasick;
+    qnode->haystack_func = nodes[0]->haystack_func;
+    qnode->highlight_func = fsearch_query_matcher_highlight_none;
+    return qnode;
+}
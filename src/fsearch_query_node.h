@@ -10,11 +10,14 @@
 #include <unicode/ucasemap.h>
 #include <unicode/unorm2.h>
 
+#include "fsearch_aho_corasick.h"
+#include "fsearch_content_search.h"
 #include "fsearch_database_index.h"
 #include "fsearch_filter_manager.h"
 #include "fsearch_query_flags.h"
 #include "fsearch_query_match_data.h"
 #include "fsearch_utf.h"
+#include "fsearch_wildcard.h"
 
 typedef struct FsearchQueryNode FsearchQueryNode;
 typedef uint32_t(FsearchQueryNodeMatchFunc)(FsearchQueryNode *, FsearchQueryMatchData *);
@@ -51,8 +54,22 @@ struct FsearchQueryNode {
 
     char *needle;
     size_t needle_len;
+    // a string which is part of the name of every entry the node matches (ignoring the case of ASCII letters),
+    // NULL if there's none
+    char *name_literal;
+    // the name of every entry the node matches (ignoring the case of ASCII letters), NULL if there's none
+    char *exact_name;
+    // a string the name of every entry the node matches starts with, case included. NULL if there's none or if the
+    // names with it aren't next to each other in the version sort order of the name arrays (if it ends with a digit).
+    char *name_prefix;
 
     GPtrArray *search_term_list;
+    // the search terms (folded to lower case unless the case must match) for lookups in a single step
+    GHashTable *search_term_set;
+    size_t max_search_term_len;
+
+    // the needles of several substring nodes, which of them the haystack contains is found in a single scan
+    FsearchAhoCorasick *aho_corasick;
 
     int64_t num_start;
     int64_t num_end;
@@ -61,22 +78,52 @@ struct FsearchQueryNode {
     FsearchQueryNodeMatchFunc *search_func;
     FsearchQueryNodeMatchFunc *highlight_func;
     FsearchQueryNodeHaystackFunc *haystack_func;
+    // for nodes whose result only depends on the parent folder of an entry: computes it for the folder of the
+    // current entry, search_func looks it up in the folder verdicts of the match data first
+    FsearchQueryNodeMatchFunc *folder_func;
+    // the folder verdict slot of the match data the node stores its results in, 0 if it doesn't use one
+    uint32_t folder_verdict_slot;
 
     FsearchUtfBuilder *needle_builder;
 
-    // Using the pcre2_code with multiple threads is safe.
-    // However, pcre2_match_data can't be shared across threads.
-    // So to avoid frequent calls to pcre2_match_data_create_from_pattern during the matching process,
-    // we simply generate an array which holds a unique instance for each thread per regex node.
+    // Using the pcre2_code with multiple threads is safe, the pcre2_match_data comes from the match data of
+    // each thread (see fsearch_query_match_data_get_regex_match_data)
     pcre2_code *regex;
-    GPtrArray *regex_match_data_for_threads;
     bool regex_jit_available;
+    // a literal every match of the regex contains, so haystacks without it don't need to be run through the regex
+    char *regex_literal;
+    size_t regex_literal_len;
+    bool regex_literal_is_prefix;
+    bool regex_literal_is_suffix;
+    // the literal every match of the regex starts with, NULL if there's none
+    char *regex_prefix;
+
+    // wildcard patterns which don't need the regex engine, see fsearch_wildcard_new
+    FsearchWildcard *wildcard;
+
+    // searches the contents of files, for content nodes
+    FsearchContentSearch *content_search;
+
+    // xattr nodes: the attribute entries must have and the node their value must match, NULL if any value matches
+    char *xattr_name;
+    FsearchQueryNode *xattr_value_node;
+
+    // fuzzy nodes with a non-ASCII needle which ignore the case: the needle is case folded already and
+    // haystacks which aren't pure ASCII have to be folded before they're matched
+    bool fold_haystack;
 
     FsearchQueryFlags flags;
 
     bool triggers_auto_match_case;
     bool triggers_auto_match_path;
     bool wants_single_threaded_search;
+    // the node only needs the numeric entry attributes, which can be read from entry columns
+    bool wants_entry_columns;
+    // the node can store its results per folder in a folder verdict slot, see fsearch_query_match_data.h
+    bool wants_folder_verdicts;
+    // rough cost of matching the node against a single entry, the operands of operators get evaluated in
+    // order of their cost
+    uint32_t cost;
 };
 
 void
@@ -88,6 +135,36 @@ fsearch_query_node_new_date_modified(FsearchQueryFlags flags,
                                      int64_t dm_end,
                                      FsearchQueryNodeComparison comp_type);
 
+FsearchQueryNode *
+fsearch_query_node_new_date_accessed(FsearchQueryFlags flags,
+                                     int64_t da_start,
+                                     int64_t da_end,
+                                     FsearchQueryNodeComparison comp_type);
+
+FsearchQueryNode *
+fsearch_query_node_new_date_created(FsearchQueryFlags flags,
+                                    int64_t dc_start,
+                                    int64_t dc_end,
+                                    FsearchQueryNodeComparison comp_type);
+
+FsearchQueryNode *
+fsearch_query_node_new_date_changed(FsearchQueryFlags flags,
+                                    int64_t dstat_start,
+                                    int64_t dstat_end,
+                                    FsearchQueryNodeComparison comp_type);
+
+// Matches entries whose owner (or group) has the dictionary id user_id (see db_entry_get_user_id_for_uid), name is
+// only used for the description
+FsearchQueryNode *
+fsearch_query_node_new_owner(FsearchQueryFlags flags, const char *name, uint16_t user_id);
+
+FsearchQueryNode *
+fsearch_query_node_new_group(FsearchQueryFlags flags, const char *name, uint16_t group_id);
+
+// Matches entries whose mode has the bits in mask set like in bits, or with any of the bits in mask set if any is true
+FsearchQueryNode *
+fsearch_query_node_new_perm(FsearchQueryFlags flags, const char *needle, uint16_t mask, uint16_t bits, bool any);
+
 FsearchQueryNode *
 fsearch_query_node_new_size(FsearchQueryFlags flags,
                             int64_t size_start,
@@ -129,6 +206,11 @@ fsearch_query_node_new_match_everything(FsearchQueryFlags flags);
 FsearchQueryNode *
 fsearch_query_node_new_regex(const char *search_term, FsearchQueryFlags flags);
 
+// Matches entries whose name (or path) contains all characters of search_term in the same order,
+// see fsearch_fuzzy_match. The score of the match is added to the match data.
+FsearchQueryNode *
+fsearch_query_node_new_fuzzy(const char *search_term, FsearchQueryFlags flags);
+
 FsearchQueryNode *
 fsearch_query_node_new_wildcard(const char *search_term, FsearchQueryFlags flags);
 
@@ -141,5 +223,24 @@ fsearch_query_node_new_extension(const char *search_term, FsearchQueryFlags flag
 FsearchQueryNode *
 fsearch_query_node_new_contenttype(const char *search_term, FsearchQueryFlags flags);
 
+// Matches entries which have the extended attribute name with a value which matches value (like the needle of a
+// contenttype node), or any value if value is NULL. Only the attributes which get indexed are known.
+FsearchQueryNode *
+fsearch_query_node_new_xattr(const char *name, const char *value, FsearchQueryFlags flags);
+
+// Matches files which contain search_term (or a match of the regex search_term) and aren't binary.
+// Every file needs to be read, so this is evaluated after all other operands of an AND.
+FsearchQueryNode *
+fsearch_query_node_new_content(const char *search_term, FsearchQueryFlags flags);
+
 FsearchQueryNode *
 fsearch_query_node_new(const char *search_term, FsearchQueryFlags flags);
+
+// Returns true if node is a plain substring search, which can be part of a substring set
+bool
+fsearch_query_node_is_substring(FsearchQueryNode *node);
+
+// Creates a node which matches if any of nodes matches. They must be substring nodes (see
+// fsearch_query_node_is_substring) with the same flags.
+FsearchQueryNode *
+fsearch_query_node_new_substring_set(FsearchQueryNode **nodes, uint32_t num_nodes);
@@ -1,11 +1,17 @@
 #include "fsearch_query_parser.h"
+#include "fsearch_database_entry.h"
 #include "fsearch_query_lexer.h"
 #include "fsearch_query_node.h"
 #include "fsearch_size_utils.h"
 #include "fsearch_string_utils.h"
 #include "fsearch_time_utils.h"
 
+#include <grp.h>
+#include <pwd.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 typedef FsearchQueryNode *(FsearchQueryComparisonNewNodeFunc)(FsearchQueryFlags,
                                                               int64_t,
@@ -34,6 +40,15 @@ parse_modifier(FsearchQueryParseContext *parse_ctx, bool is_empty_field, Fsearch
 static GList *
 parse_function_date_modified(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
 
+static GList *
+parse_function_date_accessed(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
+static GList *
+parse_function_date_created(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
+static GList *
+parse_function_date_changed(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
 static GList *
 parse_function_depth(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
 
@@ -52,6 +67,9 @@ parse_function_childfilecount(FsearchQueryParseContext *parse_ctx, bool is_empty
 static GList *
 parse_function_childfoldercount(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
 
+static GList *
+parse_function_content(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
 static GList *
 parse_function_contenttype(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
 
@@ -61,6 +79,18 @@ parse_function_extension(FsearchQueryParseContext *parse_ctx, bool is_empty_fiel
 static GList *
 parse_function_parent(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
 
+static GList *
+parse_function_owner(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
+static GList *
+parse_function_group(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
+static GList *
+parse_function_perm(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
+static GList *
+parse_function_xattr(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags);
+
 static GList *
 get_implicit_and_if_necessary(FsearchQueryParseContext *parse_ctx,
                               FsearchQueryToken last_token,
@@ -96,6 +126,8 @@ FsearchTokenModifier supported_modifiers[] = {
     {"nofolderonly", QUERY_FLAG_FOLDERS_ONLY, REMOVE_FLAG},
     {"folders", QUERY_FLAG_FOLDERS_ONLY, ADD_FLAG},
     {"nofoldersonly", QUERY_FLAG_FOLDERS_ONLY, REMOVE_FLAG},
+    {"fuzzy", QUERY_FLAG_FUZZY, ADD_FLAG},
+    {"nofuzzy", QUERY_FLAG_FUZZY, REMOVE_FLAG},
     {"path", QUERY_FLAG_SEARCH_IN_PATH, ADD_FLAG},
     {"nopath", QUERY_FLAG_SEARCH_IN_PATH, REMOVE_FLAG},
     {"regex", QUERY_FLAG_REGEX, ADD_FLAG},
@@ -106,15 +138,26 @@ FsearchTokenFunction supported_functions[] = {
     {"childcount", parse_function_childcount},
     {"childfilecount", parse_function_childfilecount},
     {"childfoldercount", parse_function_childfoldercount},
+    {"content", parse_function_content},
     {"contenttype", parse_function_contenttype},
+    {"da", parse_function_date_accessed},
+    {"dateaccessed", parse_function_date_accessed},
+    {"dc", parse_function_date_created},
+    {"datecreated", parse_function_date_created},
     {"depth", parse_function_depth},
     {"dm", parse_function_date_modified},
     {"datemodified", parse_function_date_modified},
+    {"dstat", parse_function_date_changed},
+    {"datechanged", parse_function_date_changed},
     {"empty", parse_function_empty},
     {"ext", parse_function_extension},
+    {"group", parse_function_group},
+    {"owner", parse_function_owner},
     {"parent", parse_function_parent},
     {"parents", parse_function_depth},
+    {"perm", parse_function_perm},
     {"size", parse_function_size},
+    {"xattr", parse_function_xattr},
 };
 
 static GList *
@@ -320,6 +363,36 @@ parse_function_date_modified(FsearchQueryParseContext *parse_ctx, bool is_empty_
                                   (FsearchQueryIntegerParserFunc *)fsearch_date_time_parse_interval);
 }
 
+static GList *
+parse_function_date_accessed(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    return parse_numeric_function(parse_ctx,
+                                  is_empty_field,
+                                  flags,
+                                  "date-accessed",
+                                  fsearch_query_node_new_date_accessed,
+                                  (FsearchQueryIntegerParserFunc *)fsearch_date_time_parse_interval);
+}
+
+static GList *
+parse_function_date_created(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    return parse_numeric_function(parse_ctx,
+                                  is_empty_field,
+                                  flags,
+                                  "date-created",
+                                  fsearch_query_node_new_date_created,
+                                  (FsearchQueryIntegerParserFunc *)fsearch_date_time_parse_interval);
+}
+
+static GList *
+parse_function_date_changed(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    return parse_numeric_function(parse_ctx,
+                                  is_empty_field,
+                                  flags,
+                                  "date-changed",
+                                  fsearch_query_node_new_date_changed,
+                                  (FsearchQueryIntegerParserFunc *)fsearch_date_time_parse_interval);
+}
+
 static GList *
 parse_function_extension(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
     if (is_empty_field) {
@@ -334,6 +407,19 @@ parse_function_extension(FsearchQueryParseContext *parse_ctx, bool is_empty_fiel
     return new_list(fsearch_query_node_new_match_nothing());
 }
 
+static GList *
+parse_function_content(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    if (is_empty_field) {
+        return new_list(fsearch_query_node_new_match_everything(flags));
+    }
+
+    g_autoptr(GString) token_value = NULL;
+    if (expect_word(parse_ctx->lexer, &token_value)) {
+        return new_list(fsearch_query_node_new_content(token_value->str, flags));
+    }
+    return new_list(fsearch_query_node_new_match_nothing());
+}
+
 static GList *
 parse_function_contenttype(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
     if (is_empty_field) {
@@ -347,6 +433,35 @@ parse_function_contenttype(FsearchQueryParseContext *parse_ctx, bool is_empty_fi
     return new_list(fsearch_query_node_new_match_nothing());
 }
 
+// xattr:name matches entries which have the attribute, xattr:name=value those where it has a matching value
+static GList *
+parse_function_xattr(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    if (is_empty_field) {
+        return new_list(fsearch_query_node_new_match_everything(flags));
+    }
+
+    g_autoptr(GString) name = NULL;
+    if (!expect_word(parse_ctx->lexer, &name)) {
+        return new_list(fsearch_query_node_new_match_nothing());
+    }
+    // = ends a word, unless it's part of a quoted one
+    char *separator = strchr(name->str, '=');
+    if (separator) {
+        *separator = '\0';
+        return new_list(fsearch_query_node_new_xattr(name->str, separator + 1, flags));
+    }
+    if (fsearch_query_lexer_peek_next_token(parse_ctx->lexer, NULL) != FSEARCH_QUERY_TOKEN_EQUAL) {
+        return new_list(fsearch_query_node_new_xattr(name->str, NULL, flags));
+    }
+    fsearch_query_lexer_get_next_token(parse_ctx->lexer, NULL);
+
+    g_autoptr(GString) value = NULL;
+    if (expect_word(parse_ctx->lexer, &value)) {
+        return new_list(fsearch_query_node_new_xattr(name->str, value->str, flags));
+    }
+    return new_list(fsearch_query_node_new_match_nothing());
+}
+
 static GList *
 parse_function_parent(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
     FsearchQueryFlags parent_flags = flags | QUERY_FLAG_EXACT_MATCH;
@@ -362,6 +477,126 @@ parse_function_parent(FsearchQueryParseContext *parse_ctx, bool is_empty_field,
     return new_list(fsearch_query_node_new_match_nothing());
 }
 
+static bool
+parse_unsigned(const char *str, int base, uint64_t max, uint64_t *value) {
+    if (!g_ascii_isdigit(*str)) {
+        return false;
+    }
+    char *end = NULL;
+    const guint64 res = g_ascii_strtoull(str, &end, base);
+    if (*end != '\0' || res > max) {
+        return false;
+    }
+    *value = res;
+    return true;
+}
+
+static size_t
+get_name_buffer_size(int name) {
+    const long size = sysconf(name);
+    return size > 0 ? (size_t)size : 16384;
+}
+
+// Accepts user names and numeric user ids
+static bool
+lookup_uid(const char *name, uint32_t *uid) {
+    uint64_t value = 0;
+    if (parse_unsigned(name, 10, UINT32_MAX - 1, &value)) {
+        *uid = (uint32_t)value;
+        return true;
+    }
+    const size_t buffer_size = get_name_buffer_size(_SC_GETPW_R_SIZE_MAX);
+    g_autofree char *buffer = g_malloc(buffer_size);
+    struct passwd pw;
+    struct passwd *res = NULL;
+    if (getpwnam_r(name, &pw, buffer, buffer_size, &res) != 0 || !res) {
+        return false;
+    }
+    *uid = res->pw_uid;
+    return true;
+}
+
+// Accepts group names and numeric group ids
+static bool
+lookup_gid(const char *name, uint32_t *gid) {
+    uint64_t value = 0;
+    if (parse_unsigned(name, 10, UINT32_MAX - 1, &value)) {
+        *gid = (uint32_t)value;
+        return true;
+    }
+    const size_t buffer_size = get_name_buffer_size(_SC_GETGR_R_SIZE_MAX);
+    g_autofree char *buffer = g_malloc(buffer_size);
+    struct group gr;
+    struct group *res = NULL;
+    if (getgrnam_r(name, &gr, buffer, buffer_size, &res) != 0 || !res) {
+        return false;
+    }
+    *gid = res->gr_gid;
+    return true;
+}
+
+static GList *
+parse_function_owner(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    if (is_empty_field) {
+        return new_list(fsearch_query_node_new_match_everything(flags));
+    }
+
+    g_autoptr(GString) token_value = NULL;
+    uint32_t uid = 0;
+    if (expect_word(parse_ctx->lexer, &token_value) && lookup_uid(token_value->str, &uid)) {
+        return new_list(fsearch_query_node_new_owner(flags, token_value->str, db_entry_get_user_id_for_uid(uid)));
+    }
+    return new_list(fsearch_query_node_new_match_nothing());
+}
+
+static GList *
+parse_function_group(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    if (is_empty_field) {
+        return new_list(fsearch_query_node_new_match_everything(flags));
+    }
+
+    g_autoptr(GString) token_value = NULL;
+    uint32_t gid = 0;
+    if (expect_word(parse_ctx->lexer, &token_value) && lookup_gid(token_value->str, &gid)) {
+        return new_list(fsearch_query_node_new_group(flags, token_value->str, db_entry_get_group_id_for_gid(gid)));
+    }
+    return new_list(fsearch_query_node_new_match_nothing());
+}
+
+static GList *
+parse_function_perm(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
+    if (is_empty_field) {
+        return new_list(fsearch_query_node_new_match_everything(flags));
+    }
+
+    g_autoptr(GString) token_value = NULL;
+    if (!expect_word(parse_ctx->lexer, &token_value)) {
+        return new_list(fsearch_query_node_new_match_nothing());
+    }
+
+    // like find -perm: 644 matches exactly these permissions, -644 all of these bits and /644 any of them
+    const char *mode_str = token_value->str;
+    const char prefix = *mode_str;
+    if (prefix == '-' || prefix == '/') {
+        mode_str++;
+    }
+    uint64_t mode = 0;
+    if (!parse_unsigned(mode_str, 8, 07777, &mode)) {
+        return new_list(fsearch_query_node_new_match_nothing());
+    }
+    if (prefix == '-') {
+        return new_list(fsearch_query_node_new_perm(flags, token_value->str, (uint16_t)mode, (uint16_t)mode, false));
+    }
+    else if (prefix == '/') {
+        if (mode == 0) {
+            // find -perm /000 matches everything as well
+            return new_list(fsearch_query_node_new_match_everything(flags));
+        }
+        return new_list(fsearch_query_node_new_perm(flags, token_value->str, (uint16_t)mode, 0, true));
+    }
+    return new_list(fsearch_query_node_new_perm(flags, token_value->str, 07777, (uint16_t)mode, false));
+}
+
 static GList *
 parse_modifier(FsearchQueryParseContext *parse_ctx, bool is_empty_field, FsearchQueryFlags flags) {
     if (is_empty_field) {
@@ -0,0 +1,588 @@
+#define G_LOG_DOMAIN "fsearch-query-program"
+
+#include "fsearch_query_program.h"
+#include "fsearch_column_filter.h"
+#include "fsearch_query_matchers.h"
+#include "fsearch_query_node.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    // result = matches(node)
+    QUERY_INSTRUCTION_MATCH,
+    // result = !result
+    QUERY_INSTRUCTION_NOT,
+    // continue at target if result is false
+    QUERY_INSTRUCTION_JUMP_IF_FALSE,
+    // continue at target if result is true
+    QUERY_INSTRUCTION_JUMP_IF_TRUE,
+} FsearchQueryInstructionType;
+
+typedef struct {
+    FsearchQueryInstructionType type;
+    uint32_t target;
+    FsearchQueryNode *node;
+} FsearchQueryInstruction;
+
+typedef enum {
+    COMPILE_RESULT_FALSE,
+    COMPILE_RESULT_TRUE,
+    // instructions were emitted, the result depends on the entry
+    COMPILE_RESULT_CODE,
+} FsearchQueryCompileResult;
+
+typedef struct {
+    bool active;
+    int64_t min;
+    int64_t max;
+} FsearchQueryColumnRange;
+
+// the entry columns numeric filters can be checked on
+typedef enum {
+    QUERY_COLUMN_SIZE,
+    QUERY_COLUMN_MODIFICATION_TIME,
+    QUERY_COLUMN_ACCESS_TIME,
+    QUERY_COLUMN_CREATION_TIME,
+    QUERY_COLUMN_STATUS_CHANGE_TIME,
+    NUM_QUERY_COLUMNS,
+} FsearchQueryColumn;
+
+// the 16 bit entry columns, which are checked with masks
+typedef enum {
+    QUERY_OWNER_COLUMN_USER,
+    QUERY_OWNER_COLUMN_GROUP,
+    QUERY_OWNER_COLUMN_MODE,
+} FsearchQueryOwnerColumn;
+
+typedef struct {
+    FsearchQueryOwnerColumn column;
+    uint16_t mask;
+    uint16_t value;
+    // whether (value & mask) == value must hold or must not hold
+    bool equal;
+} FsearchQueryColumnMask;
+
+struct FsearchQueryProgram {
+    GArray *instructions;
+    // nodes which were created while compiling, e.g. fused substring sets
+    GPtrArray *nodes;
+    // the result if there are no instructions
+    bool result;
+
+    // ranges every match must be within, from the numeric filters of the top level AND chain
+    FsearchQueryColumnRange ranges[NUM_QUERY_COLUMNS];
+    // masks every match must pass, from the owner, group and permission filters of the top level AND chain
+    GArray *masks;
+};
+
+static void
+append_instruction(GArray *code, FsearchQueryInstructionType type, FsearchQueryNode *node) {
+    FsearchQueryInstruction instruction = {.type = type, .target = 0, .node = node};
+    g_array_append_val(code, instruction);
+}
+
+static FsearchQueryCompileResult
+compile_node(FsearchQueryProgram *program, GNode *node, FsearchDatabaseEntryType type);
+
+static FsearchQueryCompileResult
+compile_operator(FsearchQueryProgram *program,
+                 FsearchQueryNodeOperator op,
+                 GNode *left,
+                 GNode *right,
+                 FsearchDatabaseEntryType type) {
+    GArray *code = program->instructions;
+    // the constant which decides the result on its own, the other one doesn't change it
+    const FsearchQueryCompileResult deciding_result =
+        op == FSEARCH_QUERY_NODE_OPERATOR_AND ? COMPILE_RESULT_FALSE : COMPILE_RESULT_TRUE;
+
+    const uint32_t start = code->len;
+    const FsearchQueryCompileResult left_result = compile_node(program, left, type);
+    if (left_result == deciding_result) {
+        return left_result;
+    }
+    if (left_result != COMPILE_RESULT_CODE) {
+        return compile_node(program, right, type);
+    }
+
+    const uint32_t jump = code->len;
+    append_instruction(code,
+                       op == FSEARCH_QUERY_NODE_OPERATOR_AND ? QUERY_INSTRUCTION_JUMP_IF_FALSE
+                                                             : QUERY_INSTRUCTION_JUMP_IF_TRUE,
+                       NULL);
+    const FsearchQueryCompileResult right_result = compile_node(program, right, type);
+    if (right_result == deciding_result) {
+        // matchers have no side effects, so the left operand can be dropped as well
+        g_array_set_size(code, start);
+        return right_result;
+    }
+    if (right_result != COMPILE_RESULT_CODE) {
+        g_array_set_size(code, jump);
+        return COMPILE_RESULT_CODE;
+    }
+    g_array_index(code, FsearchQueryInstruction, jump).target = code->len;
+    return COMPILE_RESULT_CODE;
+}
+
+static FsearchQueryCompileResult
+compile_query_node(FsearchQueryProgram *program, FsearchQueryNode *n, FsearchDatabaseEntryType type) {
+    if (n->flags & QUERY_FLAG_FOLDERS_ONLY && type != DATABASE_ENTRY_TYPE_FOLDER) {
+        return COMPILE_RESULT_FALSE;
+    }
+    if (n->flags & QUERY_FLAG_FILES_ONLY && type != DATABASE_ENTRY_TYPE_FILE) {
+        return COMPILE_RESULT_FALSE;
+    }
+    if (n->search_func == fsearch_query_matcher_true) {
+        return COMPILE_RESULT_TRUE;
+    }
+    if (n->search_func == fsearch_query_matcher_false) {
+        return COMPILE_RESULT_FALSE;
+    }
+    append_instruction(program->instructions, QUERY_INSTRUCTION_MATCH, n);
+    return COMPILE_RESULT_CODE;
+}
+
+static void
+collect_or_operands(GNode *node, GPtrArray *operands) {
+    FsearchQueryNode *n = node->data;
+    if (n && n->type == FSEARCH_QUERY_NODE_TYPE_OPERATOR && n->operator== FSEARCH_QUERY_NODE_OPERATOR_OR) {
+        collect_or_operands(node->children, operands);
+        collect_or_operands(node->children->next, operands);
+        return;
+    }
+    g_ptr_array_add(operands, node);
+}
+
+static bool
+is_fusable_substring(GNode *node, FsearchQueryNode *first) {
+    FsearchQueryNode *n = node->data;
+    return n && fsearch_query_node_is_substring(n) && n->flags == first->flags;
+}
+
+// The substring operands of an OR chain (e.g. foo OR bar OR baz) are fused into a single node, which finds all
+// of them in one scan of the haystack. The other operands are evaluated one after another as usual.
+static FsearchQueryCompileResult
+compile_or_chain(FsearchQueryProgram *program, GNode *node, FsearchDatabaseEntryType type) {
+    g_autoptr(GPtrArray) operands = g_ptr_array_new();
+    collect_or_operands(node, operands);
+
+    FsearchQueryNode *first = NULL;
+    g_autoptr(GPtrArray) substrings = g_ptr_array_new();
+    for (uint32_t i = 0; i < operands->len; i++) {
+        GNode *operand = g_ptr_array_index(operands, i);
+        FsearchQueryNode *n = operand->data;
+        if (!first && n && fsearch_query_node_is_substring(n)) {
+            first = n;
+        }
+        if (first && is_fusable_substring(operand, first)) {
+            g_ptr_array_add(substrings, n);
+        }
+    }
+    if (substrings->len < 2) {
+        return compile_operator(program, FSEARCH_QUERY_NODE_OPERATOR_OR, node->children, node->children->next, type);
+    }
+
+    GArray *code = program->instructions;
+    const uint32_t start = code->len;
+    g_autoptr(GArray) jumps = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    bool fused = false;
+    for (uint32_t i = 0; i < operands->len; i++) {
+        GNode *operand = g_ptr_array_index(operands, i);
+        FsearchQueryCompileResult result = COMPILE_RESULT_FALSE;
+        if (is_fusable_substring(operand, first)) {
+            if (fused) {
+                continue;
+            }
+            fused = true;
+            FsearchQueryNode *set =
+                fsearch_query_node_new_substring_set((FsearchQueryNode **)substrings->pdata, substrings->len);
+            g_ptr_array_add(program->nodes, set);
+            result = compile_query_node(program, set, type);
+        }
+        else {
+            result = compile_node(program, operand, type);
+        }
+        if (result == COMPILE_RESULT_TRUE) {
+            g_array_set_size(code, start);
+            return COMPILE_RESULT_TRUE;
+        }
+        if (result == COMPILE_RESULT_CODE) {
+            const uint32_t jump = code->len;
+            g_array_append_val(jumps, jump);
+            append_instruction(code, QUERY_INSTRUCTION_JUMP_IF_TRUE, NULL);
+        }
+    }
+    if (jumps->len == 0) {
+        return COMPILE_RESULT_FALSE;
+    }
+    // the result of the last operand is the result of the chain
+    g_array_set_size(code, code->len - 1);
+    g_array_set_size(jumps, jumps->len - 1);
+    for (uint32_t i = 0; i < jumps->len; i++) {
+        g_array_index(code, FsearchQueryInstruction, g_array_index(jumps, uint32_t, i)).target = code->len;
+    }
+    return COMPILE_RESULT_CODE;
+}
+
+static FsearchQueryCompileResult
+compile_node(FsearchQueryProgram *program, GNode *node, FsearchDatabaseEntryType type) {
+    if (!node) {
+        return COMPILE_RESULT_TRUE;
+    }
+    FsearchQueryNode *n = node->data;
+    if (!n) {
+        return COMPILE_RESULT_FALSE;
+    }
+    if (n->type == FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        GNode *left = node->children;
+        g_assert(left);
+        if (n->operator== FSEARCH_QUERY_NODE_OPERATOR_NOT) {
+            switch (compile_node(program, left, type)) {
+            case COMPILE_RESULT_FALSE:
+                return COMPILE_RESULT_TRUE;
+            case COMPILE_RESULT_TRUE:
+                return COMPILE_RESULT_FALSE;
+            default:
+                append_instruction(program->instructions, QUERY_INSTRUCTION_NOT, NULL);
+                return COMPILE_RESULT_CODE;
+            }
+        }
+        if (n->operator== FSEARCH_QUERY_NODE_OPERATOR_OR) {
+            return compile_or_chain(program, node, type);
+        }
+        return compile_operator(program, n->operator, left, left->next, type);
+    }
+    return compile_query_node(program, n, type);
+}
+
+// A jump which lands on another jump doesn't change the result, so it can continue right where
+// the second one would, e.g. at the end of a chain of ANDs once an operand doesn't match.
+static bool
+is_jump(const FsearchQueryInstruction *instruction) {
+    return instruction->type == QUERY_INSTRUCTION_JUMP_IF_FALSE || instruction->type == QUERY_INSTRUCTION_JUMP_IF_TRUE;
+}
+
+static void
+thread_jumps(GArray *code) {
+    FsearchQueryInstruction *instructions = (FsearchQueryInstruction *)code->data;
+    for (uint32_t i = 0; i < code->len; i++) {
+        FsearchQueryInstruction *instruction = &instructions[i];
+        if (!is_jump(instruction)) {
+            continue;
+        }
+        uint32_t target = instruction->target;
+        while (target < code->len) {
+            FsearchQueryInstruction *next = &instructions[target];
+            if (next->type == instruction->type) {
+                target = next->target;
+            }
+            else if (is_jump(next)) {
+                target++;
+            }
+            else {
+                break;
+            }
+        }
+        instruction->target = target;
+    }
+}
+
+static bool
+get_comparison_range(FsearchQueryNode *n, int64_t *min, int64_t *max) {
+    const int64_t num = n->num_start;
+    switch (n->comparison_type) {
+    case FSEARCH_QUERY_NODE_COMPARISON_EQUAL:
+        *min = num;
+        *max = num;
+        return true;
+    case FSEARCH_QUERY_NODE_COMPARISON_GREATER:
+        if (num == INT64_MAX) {
+            // an empty range
+            *min = INT64_MAX;
+            *max = INT64_MIN;
+            return true;
+        }
+        *min = num + 1;
+        *max = INT64_MAX;
+        return true;
+    case FSEARCH_QUERY_NODE_COMPARISON_GREATER_EQ:
+        *min = num;
+        *max = INT64_MAX;
+        return true;
+    case FSEARCH_QUERY_NODE_COMPARISON_SMALLER:
+        if (num == INT64_MIN) {
+            *min = INT64_MAX;
+            *max = INT64_MIN;
+            return true;
+        }
+        *min = INT64_MIN;
+        *max = num - 1;
+        return true;
+    case FSEARCH_QUERY_NODE_COMPARISON_SMALLER_EQ:
+        *min = INT64_MIN;
+        *max = num;
+        return true;
+    case FSEARCH_QUERY_NODE_COMPARISON_RANGE:
+        if (n->num_end == INT64_MIN) {
+            *min = INT64_MAX;
+            *max = INT64_MIN;
+            return true;
+        }
+        *min = num;
+        *max = n->num_end - 1;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool
+get_column_mask(FsearchQueryNode *n, FsearchQueryColumnMask *mask) {
+    mask->mask = (uint16_t)n->num_end;
+    mask->value = (uint16_t)n->num_start;
+    mask->equal = true;
+    if (n->search_func == fsearch_query_matcher_owner) {
+        mask->column = QUERY_OWNER_COLUMN_USER;
+    }
+    else if (n->search_func == fsearch_query_matcher_group) {
+        mask->column = QUERY_OWNER_COLUMN_GROUP;
+    }
+    else if (n->search_func == fsearch_query_matcher_perm) {
+        mask->column = QUERY_OWNER_COLUMN_MODE;
+    }
+    else if (n->search_func == fsearch_query_matcher_perm_any) {
+        mask->column = QUERY_OWNER_COLUMN_MODE;
+        mask->value = 0;
+        mask->equal = false;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+static void
+narrow_range(FsearchQueryColumnRange *range, int64_t min, int64_t max) {
+    if (!range->active) {
+        range->active = true;
+        range->min = min;
+        range->max = max;
+        return;
+    }
+    range->min = MAX(range->min, min);
+    range->max = MIN(range->max, max);
+}
+
+// Numeric filters on columns which are operands of the top level AND chain must hold for every match,
+// so they can be checked for large batches of entries at once before anything else
+static void
+collect_column_ranges(FsearchQueryProgram *program, GNode *node, FsearchDatabaseEntryType type) {
+    if (!node || !node->data) {
+        return;
+    }
+    FsearchQueryNode *n = node->data;
+    if (n->type == FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        if (n->operator== FSEARCH_QUERY_NODE_OPERATOR_AND) {
+            collect_column_ranges(program, node->children, type);
+            collect_column_ranges(program, node->children->next, type);
+        }
+        return;
+    }
+    if (n->flags & QUERY_FLAG_FOLDERS_ONLY && type != DATABASE_ENTRY_TYPE_FOLDER) {
+        return;
+    }
+    if (n->flags & QUERY_FLAG_FILES_ONLY && type != DATABASE_ENTRY_TYPE_FILE) {
+        return;
+    }
+    FsearchQueryColumnRange *range = NULL;
+    if (n->search_func == fsearch_query_matcher_size) {
+        range = &program->ranges[QUERY_COLUMN_SIZE];
+    }
+    else if (n->search_func == fsearch_query_matcher_date_modified) {
+        range = &program->ranges[QUERY_COLUMN_MODIFICATION_TIME];
+    }
+    else if (n->search_func == fsearch_query_matcher_date_accessed) {
+        range = &program->ranges[QUERY_COLUMN_ACCESS_TIME];
+    }
+    else if (n->search_func == fsearch_query_matcher_date_created) {
+        range = &program->ranges[QUERY_COLUMN_CREATION_TIME];
+    }
+    else if (n->search_func == fsearch_query_matcher_date_changed) {
+        range = &program->ranges[QUERY_COLUMN_STATUS_CHANGE_TIME];
+    }
+    int64_t min = 0;
+    int64_t max = 0;
+    if (range && get_comparison_range(n, &min, &max)) {
+        narrow_range(range, min, max);
+    }
+    FsearchQueryColumnMask mask = {0};
+    if (get_column_mask(n, &mask)) {
+        g_array_append_val(program->masks, mask);
+    }
+}
+
+FsearchQueryProgram *
+fsearch_query_program_new(GNode *filter_tree, GNode *query_tree, FsearchDatabaseEntryType type) {
+    FsearchQueryProgram *program = calloc(1, sizeof(FsearchQueryProgram));
+    g_assert(program);
+
+    program->instructions = g_array_new(FALSE, FALSE, sizeof(FsearchQueryInstruction));
+    program->nodes = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_query_node_free);
+    program->masks = g_array_new(FALSE, FALSE, sizeof(FsearchQueryColumnMask));
+    const FsearchQueryCompileResult result =
+        compile_operator(program, FSEARCH_QUERY_NODE_OPERATOR_AND, filter_tree, query_tree, type);
+    if (result == COMPILE_RESULT_CODE) {
+        thread_jumps(program->instructions);
+        collect_column_ranges(program, filter_tree, type);
+        collect_column_ranges(program, query_tree, type);
+    }
+    else {
+        g_array_set_size(program->instructions, 0);
+        program->result = result == COMPILE_RESULT_TRUE;
+    }
+    return program;
+}
+
+void
+fsearch_query_program_free(FsearchQueryProgram *program) {
+    if (!program) {
+        return;
+    }
+    g_clear_pointer(&program->instructions, g_array_unref);
+    g_clear_pointer(&program->nodes, g_ptr_array_unref);
+    g_clear_pointer(&program->masks, g_array_unref);
+    g_clear_pointer(&program, free);
+}
+
+bool
+fsearch_query_program_is_constant(FsearchQueryProgram *program, bool *result) {
+    g_assert(program);
+    if (program->instructions->len > 0) {
+        return false;
+    }
+    if (result) {
+        *result = program->result;
+    }
+    return true;
+}
+
+// Returns NULL if the entries don't store the values of column
+static const int64_t *
+get_column_values(const FsearchDatabaseEntryColumns *columns, FsearchQueryColumn column) {
+    switch (column) {
+    case QUERY_COLUMN_SIZE:
+        return columns->sizes;
+    case QUERY_COLUMN_MODIFICATION_TIME:
+        return columns->mtimes;
+    case QUERY_COLUMN_ACCESS_TIME:
+        return columns->atimes;
+    case QUERY_COLUMN_CREATION_TIME:
+        return columns->btimes;
+    case QUERY_COLUMN_STATUS_CHANGE_TIME:
+        return columns->ctimes;
+    default:
+        return NULL;
+    }
+}
+
+// Returns NULL if the entries don't store their owners, *missing_value is what the matchers see instead
+static const uint16_t *
+get_owner_column_values(const FsearchDatabaseEntryColumns *columns,
+                        FsearchQueryOwnerColumn column,
+                        uint16_t *missing_value) {
+    switch (column) {
+    case QUERY_OWNER_COLUMN_USER:
+        *missing_value = FSEARCH_ID_DICTIONARY_NO_ID;
+        return columns->user_ids;
+    case QUERY_OWNER_COLUMN_GROUP:
+        *missing_value = FSEARCH_ID_DICTIONARY_NO_ID;
+        return columns->group_ids;
+    case QUERY_OWNER_COLUMN_MODE:
+        *missing_value = 0;
+        return columns->modes;
+    }
+    *missing_value = 0;
+    return NULL;
+}
+
+bool
+fsearch_query_program_filter_columns(FsearchQueryProgram *program,
+                                     const FsearchDatabaseEntryColumns *columns,
+                                     uint32_t start,
+                                     uint32_t num_entries,
+                                     uint64_t *bitmap) {
+    g_assert(program);
+    g_assert(columns);
+    g_assert(start + num_entries <= columns->num_entries);
+    bool has_ranges = false;
+    for (uint32_t i = 0; i < NUM_QUERY_COLUMNS; i++) {
+        has_ranges = has_ranges || program->ranges[i].active;
+    }
+    if (!has_ranges && program->masks->len == 0) {
+        return false;
+    }
+
+    const uint32_t num_words = (num_entries + 63) / 64;
+    for (uint32_t i = 0; i < num_words; i++) {
+        bitmap[i] = UINT64_MAX;
+    }
+    if (num_entries % 64) {
+        // columns which aren't stored don't clear the bits past the last entry
+        bitmap[num_words - 1] = (UINT64_C(1) << (num_entries % 64)) - 1;
+    }
+    for (uint32_t i = 0; i < NUM_QUERY_COLUMNS; i++) {
+        const FsearchQueryColumnRange *range = &program->ranges[i];
+        if (!range->active) {
+            continue;
+        }
+        const int64_t *values = get_column_values(columns, i);
+        if (values) {
+            fsearch_column_filter_range(values + start, num_entries, range->min, range->max, bitmap);
+        }
+        else if (range->min > 0 || range->max < 0) {
+            // the matchers see 0 for times which aren't stored
+            memset(bitmap, 0, num_words * sizeof(uint64_t));
+        }
+    }
+    for (uint32_t i = 0; i < program->masks->len; i++) {
+        const FsearchQueryColumnMask *mask = &g_array_index(program->masks, FsearchQueryColumnMask, i);
+        uint16_t missing_value = 0;
+        const uint16_t *values = get_owner_column_values(columns, mask->column, &missing_value);
+        if (values) {
+            fsearch_column_filter_masked(values + start, num_entries, mask->mask, mask->value, mask->equal, bitmap);
+        }
+        else if (((missing_value & mask->mask) == mask->value) != mask->equal) {
+            memset(bitmap, 0, num_words * sizeof(uint64_t));
+        }
+    }
+    return true;
+}
+
+bool
+fsearch_query_program_run(FsearchQueryProgram *program, FsearchQueryMatchData *match_data) {
+    const FsearchQueryInstruction *instructions = (const FsearchQueryInstruction *)program->instructions->data;
+    const uint32_t num_instructions = program->instructions->len;
+
+    bool result = program->result;
+    uint32_t pc = 0;
+    while (pc < num_instructions) {
+        const FsearchQueryInstruction *instruction = &instructions[pc];
+        switch (instruction->type) {
+        case QUERY_INSTRUCTION_MATCH:
+            result = instruction->node->search_func(instruction->node, match_data);
+            pc++;
+            break;
+        case QUERY_INSTRUCTION_NOT:
+            result = !result;
+            pc++;
+            break;
+        case QUERY_INSTRUCTION_JUMP_IF_FALSE:
+            pc = result ? pc + 1 : instruction->target;
+            break;
+        case QUERY_INSTRUCTION_JUMP_IF_TRUE:
+            pc = result ? instruction->target : pc + 1;
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include "fsearch_database_entry.h"
+#include "fsearch_database_entry_columns.h"
+#include "fsearch_query_match_data.h"
+
+// A query tree compiled into a flat list of instructions for entries of a single type. AND and OR
+// become conditional jumps over the instructions of their right operand, so evaluating an entry is a
+// single loop without any recursion. Everything which doesn't depend on the entry itself (operands
+// which are restricted to the other entry type, operands which match everything or nothing) is
+// folded away while compiling.
+typedef struct FsearchQueryProgram FsearchQueryProgram;
+
+// Compiles filter_tree AND query_tree for entries of type, a NULL tree matches everything.
+FsearchQueryProgram *
+fsearch_query_program_new(GNode *filter_tree, GNode *query_tree, FsearchDatabaseEntryType type);
+
+void
+fsearch_query_program_free(FsearchQueryProgram *program);
+
+// Returns true if the result of the program doesn't depend on the entry, it's stored in *result then.
+bool
+fsearch_query_program_is_constant(FsearchQueryProgram *program, bool *result);
+
+// Sets bit i of bitmap if the entry at start + i of columns passes the numeric filters every match must pass
+// (e.g. size:>1gb in size:>1gb dm:thisweek foo), so only those entries need to be run through the program.
+// Returns false if there are no such filters, bitmap is left untouched then.
+bool
+fsearch_query_program_filter_columns(FsearchQueryProgram *program,
+                                     const FsearchDatabaseEntryColumns *columns,
+                                     uint32_t start,
+                                     uint32_t num_entries,
+                                     uint64_t *bitmap);
+
+bool
+fsearch_query_program_run(FsearchQueryProgram *program, FsearchQueryMatchData *match_data);
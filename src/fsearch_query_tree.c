@@ -5,6 +5,9 @@
 #include "fsearch_query_parser.h"
 #include "fsearch_string_utils.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 static gboolean
 free_tree_node(GNode *node, gpointer data);
 
@@ -98,6 +101,10 @@ query_flags_to_string_expressive(FsearchQueryFlags flags) {
         g_string_append_printf(flag_string, "%sFiles only", num_flags ? sep : "");
         num_flags++;
     }
+    if (flags & QUERY_FLAG_FUZZY) {
+        g_string_append_printf(flag_string, "%sFuzzy", num_flags ? sep : "");
+        num_flags++;
+    }
     return g_string_free(flag_string, FALSE);
 }
 
@@ -128,6 +135,9 @@ query_flags_to_string(FsearchQueryFlags flags) {
     if (flags & QUERY_FLAG_FILES_ONLY) {
         g_string_append_c(flag_string, 'f');
     }
+    if (flags & QUERY_FLAG_FUZZY) {
+        g_string_append_c(flag_string, 'z');
+    }
     return g_string_free(flag_string, FALSE);
 }
 
@@ -272,6 +282,176 @@ fsearch_query_node_tree_wants_single_threaded_search(GNode *tree) {
     return wants_single_threaded_search;
 }
 
+static gboolean
+node_wants_entry_columns(GNode *node, gpointer data) {
+    FsearchQueryNode *n = node->data;
+    g_assert(data);
+    g_assert(n);
+
+    bool *wants_entry_columns = data;
+    if (n && n->wants_entry_columns) {
+        *wants_entry_columns = true;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+bool
+fsearch_query_node_tree_wants_entry_columns(GNode *tree) {
+    g_assert(tree);
+    bool wants_entry_columns = false;
+
+    g_node_traverse(tree, G_IN_ORDER, G_TRAVERSE_ALL, -1, node_wants_entry_columns, &wants_entry_columns);
+
+    return wants_entry_columns;
+}
+
+const char *
+fsearch_query_node_tree_get_name_literal(GNode *tree) {
+    g_assert(tree);
+    FsearchQueryNode *n = tree->data;
+    if (!n) {
+        return NULL;
+    }
+    if (n->type != FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        return n->name_literal;
+    }
+    if (n->operator!= FSEARCH_QUERY_NODE_OPERATOR_AND) {
+        // only one side of OR has to match, NOT matches entries which don't contain it
+        return NULL;
+    }
+    // both sides have to match, so the longer literal narrows the entries down the most
+    const char *longest = NULL;
+    for (GNode *child = tree->children; child != NULL; child = child->next) {
+        const char *literal = fsearch_query_node_tree_get_name_literal(child);
+        if (literal && (!longest || strlen(literal) > strlen(longest))) {
+            longest = literal;
+        }
+    }
+    return longest;
+}
+
+const char *
+fsearch_query_node_tree_get_exact_name(GNode *tree) {
+    g_assert(tree);
+    FsearchQueryNode *n = tree->data;
+    if (!n) {
+        return NULL;
+    }
+    if (n->type != FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        return n->exact_name;
+    }
+    if (n->operator!= FSEARCH_QUERY_NODE_OPERATOR_AND) {
+        return NULL;
+    }
+    // every side has to match, so the name of any of them will do
+    for (GNode *child = tree->children; child != NULL; child = child->next) {
+        const char *name = fsearch_query_node_tree_get_exact_name(child);
+        if (name) {
+            return name;
+        }
+    }
+    return NULL;
+}
+
+const char *
+fsearch_query_node_tree_get_name_prefix(GNode *tree) {
+    g_assert(tree);
+    FsearchQueryNode *n = tree->data;
+    if (!n) {
+        return NULL;
+    }
+    if (n->type != FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        return n->name_prefix;
+    }
+    if (n->operator!= FSEARCH_QUERY_NODE_OPERATOR_AND) {
+        return NULL;
+    }
+    // every side has to match, so the longest prefix narrows the names down the most
+    const char *longest = NULL;
+    for (GNode *child = tree->children; child != NULL; child = child->next) {
+        const char *prefix = fsearch_query_node_tree_get_name_prefix(child);
+        if (prefix && (!longest || strlen(prefix) > strlen(longest))) {
+            longest = prefix;
+        }
+    }
+    return longest;
+}
+
+static void
+collect_operands(GNode *node, FsearchQueryNodeOperator operator, GPtrArray *operands, GPtrArray *operators) {
+    for (GNode *child = node->children; child != NULL; child = child->next) {
+        FsearchQueryNode *n = child->data;
+        if (n && n->type == FSEARCH_QUERY_NODE_TYPE_OPERATOR && n->operator== operator) {
+            g_ptr_array_add(operators, child);
+            collect_operands(child, operator, operands, operators);
+        }
+        else {
+            g_ptr_array_add(operands, child);
+        }
+    }
+}
+
+static gint
+compare_operand_costs(GNode **a, GNode **b) {
+    FsearchQueryNode *node_a = (*a)->data;
+    FsearchQueryNode *node_b = (*b)->data;
+    const uint32_t cost_a = node_a ? node_a->cost : 0;
+    const uint32_t cost_b = node_b ? node_b->cost : 0;
+    return cost_a < cost_b ? -1 : cost_a > cost_b;
+}
+
+// AND and OR are commutative, so their operands can be evaluated in any order. Evaluating the cheap ones first
+// lets them short-circuit the expensive ones. Chains of the same operator (e.g. a AND b AND c) are reordered as
+// a whole. Returns the cost of the tree.
+static uint32_t
+plan_tree(GNode *node) {
+    FsearchQueryNode *n = node->data;
+    if (!n) {
+        return 0;
+    }
+    if (n->type != FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        return n->cost;
+    }
+    if (n->operator== FSEARCH_QUERY_NODE_OPERATOR_NOT) {
+        n->cost = node->children ? plan_tree(node->children) : 0;
+        return n->cost;
+    }
+
+    g_autoptr(GPtrArray) operands = g_ptr_array_new();
+    g_autoptr(GPtrArray) operators = g_ptr_array_new();
+    collect_operands(node, n->operator, operands, operators);
+
+    n->cost = 0;
+    for (uint32_t i = 0; i < operands->len; i++) {
+        n->cost += plan_tree(g_ptr_array_index(operands, i));
+    }
+    if (operands->len < 2 || operators->len + 2 != operands->len) {
+        // only well formed chains get reordered
+        return n->cost;
+    }
+
+    for (uint32_t i = 0; i < operands->len; i++) {
+        g_node_unlink(g_ptr_array_index(operands, i));
+    }
+    for (uint32_t i = 0; i < operators->len; i++) {
+        g_node_unlink(g_ptr_array_index(operators, i));
+    }
+    // stable, so operands of the same cost keep their order
+    g_ptr_array_sort(operands, (GCompareFunc)compare_operand_costs);
+
+    // rebuild the chain from the bottom up, with the cheapest operands at the bottom left where evaluation starts
+    g_ptr_array_add(operators, node);
+    GNode *chain = g_ptr_array_index(operands, 0);
+    for (uint32_t i = 1; i < operands->len; i++) {
+        GNode *op_node = g_ptr_array_index(operators, i - 1);
+        g_node_append(op_node, chain);
+        g_node_append(op_node, g_ptr_array_index(operands, i));
+        chain = op_node;
+    }
+    return n->cost;
+}
+
 GNode *
 fsearch_query_node_tree_new(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags) {
     g_autofree char *query = g_strdup(search_term);
@@ -285,6 +465,9 @@ fsearch_query_node_tree_new(const char *search_term, FsearchFilterManager *filte
     else {
         res = get_query_tree(query_stripped, filters, flags);
     }
+    if (res) {
+        plan_tree(res);
+    }
     return res;
 }
 
@@ -295,3 +478,54 @@ fsearch_query_node_tree_free(GNode *node) {
     }
     g_clear_pointer(&node, free_tree);
 }
+
+static gboolean
+assign_folder_verdict_slot(GNode *node, gpointer user_data) {
+    uint32_t *num_slots = user_data;
+    FsearchQueryNode *qnode = node->data;
+    if (qnode && qnode->wants_folder_verdicts && *num_slots < FSEARCH_QUERY_MATCH_DATA_NUM_FOLDER_VERDICT_SLOTS) {
+        qnode->folder_verdict_slot = ++(*num_slots);
+    }
+    return FALSE;
+}
+
+uint32_t
+fsearch_query_node_tree_assign_folder_verdict_slots(GNode *tree, uint32_t num_slots) {
+    // nodes without a slot still work, they just compute their result for every entry
+    if (tree) {
+        g_node_traverse(tree, G_PRE_ORDER, G_TRAVERSE_LEAVES, -1, assign_folder_verdict_slot, &num_slots);
+    }
+    return num_slots;
+}
+
+FsearchQuerySharedTree *
+fsearch_query_shared_tree_new(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags) {
+    g_assert(search_term);
+
+    FsearchQuerySharedTree *tree = calloc(1, sizeof(FsearchQuerySharedTree));
+    g_assert(tree);
+    tree->root = fsearch_query_node_tree_new(search_term, filters, flags);
+    tree->num_folder_verdict_slots = fsearch_query_node_tree_assign_folder_verdict_slots(tree->root, 0);
+    tree->ref_count = 1;
+    return tree;
+}
+
+FsearchQuerySharedTree *
+fsearch_query_shared_tree_ref(FsearchQuerySharedTree *tree) {
+    if (!tree || g_atomic_int_get(&tree->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&tree->ref_count);
+    return tree;
+}
+
+void
+fsearch_query_shared_tree_unref(FsearchQuerySharedTree *tree) {
+    if (!tree || g_atomic_int_get(&tree->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&tree->ref_count)) {
+        g_clear_pointer(&tree->root, fsearch_query_node_tree_free);
+        g_clear_pointer(&tree, free);
+    }
+}
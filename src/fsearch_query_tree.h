@@ -3,6 +3,17 @@
 #include "fsearch_filter_manager.h"
 
 #include <glib.h>
+#include <stdint.h>
+
+// A planned tree whose nodes don't change anymore, so several queries can use it at the same time
+// (e.g. the tree of a filter, see fsearch_filter_manager_get_query_tree)
+struct FsearchQuerySharedTree {
+    GNode *root;
+    // its nodes use the folder verdict slots from 1 to num_folder_verdict_slots
+    uint32_t num_folder_verdict_slots;
+
+    volatile int ref_count;
+};
 
 bool
 fsearch_query_node_tree_triggers_auto_match_path(GNode *tree);
@@ -13,8 +24,40 @@ fsearch_query_node_tree_triggers_auto_match_case(GNode *tree);
 bool
 fsearch_query_node_tree_wants_single_threaded_search(GNode *tree);
 
+bool
+fsearch_query_node_tree_wants_entry_columns(GNode *tree);
+
+// Returns a string which is part of the name of every entry the tree matches (see FsearchQueryNode::name_literal),
+// NULL if there's none. The string belongs to one of the nodes of the tree.
+const char *
+fsearch_query_node_tree_get_name_literal(GNode *tree);
+
+// Returns the name of every entry the tree matches (see FsearchQueryNode::exact_name), NULL if there's none. The
+// string belongs to one of the nodes of the tree.
+const char *
+fsearch_query_node_tree_get_exact_name(GNode *tree);
+
+// Returns a string the name of every entry the tree matches starts with (see FsearchQueryNode::name_prefix), NULL if
+// there's none. The string belongs to one of the nodes of the tree.
+const char *
+fsearch_query_node_tree_get_name_prefix(GNode *tree);
+
 GNode *
 fsearch_query_node_tree_new(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags);
 
 void
 fsearch_query_node_tree_free(GNode *node);
+
+// Gives the nodes of tree which want one a folder verdict slot, numbered from num_slots + 1.
+// Returns the number of slots which are in use afterwards.
+uint32_t
+fsearch_query_node_tree_assign_folder_verdict_slots(GNode *tree, uint32_t num_slots);
+
+FsearchQuerySharedTree *
+fsearch_query_shared_tree_new(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags);
+
+FsearchQuerySharedTree *
+fsearch_query_shared_tree_ref(FsearchQuerySharedTree *tree);
+
+void
+fsearch_query_shared_tree_unref(FsearchQuerySharedTree *tree);
@@ -0,0 +1,160 @@
+#define G_LOG_DOMAIN "fsearch-result-cache"
+
+#include "fsearch_result_cache.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *key;
+    DynamicArray *folders;
+    DynamicArray *files;
+    FsearchDatabaseIndexType sort_order;
+    size_t size;
+} FsearchResultCacheEntry;
+
+struct FsearchResultCache {
+    // the most recently used entries are at the head
+    GQueue *entries;
+    // maps keys to their links in entries
+    GHashTable *links;
+    size_t size;
+    size_t max_size;
+};
+
+static void
+result_cache_entry_free(FsearchResultCacheEntry *entry) {
+    if (!entry) {
+        return;
+    }
+    g_clear_pointer(&entry->key, g_free);
+    g_clear_pointer(&entry->folders, darray_unref);
+    g_clear_pointer(&entry->files, darray_unref);
+    g_clear_pointer(&entry, free);
+}
+
+static size_t
+get_array_size(DynamicArray *array) {
+    return array ? darray_get_num_items(array) * sizeof(void *) : 0;
+}
+
+static void
+result_cache_remove_link(FsearchResultCache *cache, GList *link) {
+    FsearchResultCacheEntry *entry = link->data;
+    g_hash_table_remove(cache->links, entry->key);
+    g_queue_delete_link(cache->entries, link);
+    cache->size -= entry->size;
+    g_clear_pointer(&entry, result_cache_entry_free);
+}
+
+static void
+result_cache_evict(FsearchResultCache *cache, size_t max_size) {
+    while (cache->size > max_size && cache->entries->tail) {
+        result_cache_remove_link(cache, cache->entries->tail);
+    }
+}
+
+FsearchResultCache *
+fsearch_result_cache_new(size_t max_size) {
+    FsearchResultCache *cache = calloc(1, sizeof(FsearchResultCache));
+    g_assert(cache);
+    cache->entries = g_queue_new();
+    cache->links = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->max_size = max_size;
+    return cache;
+}
+
+void
+fsearch_result_cache_free(FsearchResultCache *cache) {
+    if (!cache) {
+        return;
+    }
+    fsearch_result_cache_clear(cache);
+    g_clear_pointer(&cache->links, g_hash_table_unref);
+    g_clear_pointer(&cache->entries, g_queue_free);
+    g_clear_pointer(&cache, free);
+}
+
+void
+fsearch_result_cache_set_max_size(FsearchResultCache *cache, size_t max_size) {
+    g_assert(cache);
+    cache->max_size = max_size;
+    result_cache_evict(cache, max_size);
+}
+
+void
+fsearch_result_cache_clear(FsearchResultCache *cache) {
+    g_assert(cache);
+    result_cache_evict(cache, 0);
+}
+
+bool
+fsearch_result_cache_lookup(FsearchResultCache *cache,
+                            const char *key,
+                            DynamicArray **folders,
+                            DynamicArray **files,
+                            FsearchDatabaseIndexType *sort_order) {
+    g_assert(cache);
+    g_assert(key);
+
+    GList *link = g_hash_table_lookup(cache->links, key);
+    if (!link) {
+        return false;
+    }
+    g_queue_unlink(cache->entries, link);
+    g_queue_push_head_link(cache->entries, link);
+
+    FsearchResultCacheEntry *entry = link->data;
+    if (folders) {
+        *folders = entry->folders ? darray_ref(entry->folders) : NULL;
+    }
+    if (files) {
+        *files = entry->files ? darray_ref(entry->files) : NULL;
+    }
+    if (sort_order) {
+        *sort_order = entry->sort_order;
+    }
+    return true;
+}
+
+void
+fsearch_result_cache_insert(FsearchResultCache *cache,
+                            const char *key,
+                            DynamicArray *folders,
+                            DynamicArray *files,
+                            FsearchDatabaseIndexType sort_order) {
+    g_assert(cache);
+    g_assert(key);
+
+    GList *link = g_hash_table_lookup(cache->links, key);
+    if (link) {
+        result_cache_remove_link(cache, link);
+    }
+
+    // empty results still take up some space, so there can't be an unlimited number of them
+    const size_t size =
+        get_array_size(folders) + get_array_size(files) + sizeof(FsearchResultCacheEntry) + strlen(key) + 1;
+    if (size > cache->max_size || cache->max_size == 0) {
+        return;
+    }
+    result_cache_evict(cache, cache->max_size - size);
+
+    FsearchResultCacheEntry *entry = calloc(1, sizeof(FsearchResultCacheEntry));
+    g_assert(entry);
+    entry->key = g_strdup(key);
+    entry->folders = folders ? darray_ref(folders) : NULL;
+    entry->files = files ? darray_ref(files) : NULL;
+    entry->sort_order = sort_order;
+    entry->size = size;
+
+    g_queue_push_head(cache->entries, entry);
+    g_hash_table_insert(cache->links, entry->key, cache->entries->head);
+    cache->size += size;
+}
+
+size_t
+fsearch_result_cache_get_size(FsearchResultCache *cache) {
+    g_assert(cache);
+    return cache->size;
+}
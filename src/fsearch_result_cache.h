@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_index.h"
+
+// A least recently used cache of search results, bounded by the memory of the cached arrays.
+// The cached arrays must not be modified anymore.
+typedef struct FsearchResultCache FsearchResultCache;
+
+FsearchResultCache *
+fsearch_result_cache_new(size_t max_size);
+
+void
+fsearch_result_cache_free(FsearchResultCache *cache);
+
+// Evicts results until the cache fits into max_size bytes, 0 disables the cache
+void
+fsearch_result_cache_set_max_size(FsearchResultCache *cache, size_t max_size);
+
+void
+fsearch_result_cache_clear(FsearchResultCache *cache);
+
+// Returns new references to the cached results of key, if there are any
+bool
+fsearch_result_cache_lookup(FsearchResultCache *cache,
+                            const char *key,
+                            DynamicArray **folders,
+                            DynamicArray **files,
+                            FsearchDatabaseIndexType *sort_order);
+
+void
+fsearch_result_cache_insert(FsearchResultCache *cache,
+                            const char *key,
+                            DynamicArray *folders,
+                            DynamicArray *files,
+                            FsearchDatabaseIndexType sort_order);
+
+// Memory used by the cached results in bytes
+size_t
+fsearch_result_cache_get_size(FsearchResultCache *cache);
@@ -6,13 +6,25 @@
 #include "fsearch_config.h"
 #include "fsearch_file_utils.h"
 #include "fsearch_query.h"
+#include "fsearch_string_utils.h"
 
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/stat.h>
 
+// how many viewports of rows the row cache holds
+#define ROW_CACHE_NUM_VIEWPORTS 4
+#define ROW_CACHE_MIN_CAPACITY 100
+// the most rows which are read from the view at once, see row_cache_fill
+#define ROW_CACHE_FILL_MAX_ROWS 64
+// the file types and icons of rows are looked up by this many threads, they might have to wait for network mounts
+#define ROW_INFO_NUM_THREADS 2
+// the number of extensions whose file type is kept
+#define FILE_TYPE_CACHE_MAX_SIZE 1000
+
 static int32_t
 get_icon_size_for_height(int32_t height) {
     if (height < 24) {
@@ -30,7 +42,6 @@ get_icon_size_for_height(int32_t height) {
 static void
 reset_icon_caches(FsearchResultView *result_view) {
     g_hash_table_remove_all(result_view->pixbuf_cache);
-    g_hash_table_remove_all(result_view->app_gicon_cache);
 }
 
 static void
@@ -39,23 +50,12 @@ maybe_reset_icon_caches(FsearchResultView *result_view) {
     if (g_hash_table_size(result_view->pixbuf_cache) > cached_icon_limit) {
         g_hash_table_remove_all(result_view->pixbuf_cache);
     }
-    if (g_hash_table_size(result_view->app_gicon_cache) > cached_icon_limit) {
-        g_hash_table_remove_all(result_view->app_gicon_cache);
-    }
-}
-
-static GIcon *
-get_desktop_file_icon(FsearchResultView *result_view, const char *path) {
-    GIcon *icon = g_hash_table_lookup(result_view->app_gicon_cache, path);
-    if (!icon) {
-        icon = fsearch_file_utils_get_desktop_file_icon(path);
-        g_hash_table_insert(result_view->app_gicon_cache, g_strdup(path), icon);
-    }
-    return g_object_ref(icon);
 }
 
+// Themed icons are loaded on the main thread, the icon theme isn't thread safe. The pixbufs are shared by all
+// rows with the same icon.
 static GdkPixbuf *
-get_pixbuf_from_gicon(FsearchResultView *result_view, GIcon *icon, int32_t icon_size, int32_t scale_factor) {
+get_pixbuf_from_themed_icon(FsearchResultView *result_view, GIcon *icon, int32_t icon_size, int32_t scale_factor) {
     GdkPixbuf *pixbuf = g_hash_table_lookup(result_view->pixbuf_cache, icon);
     if (pixbuf) {
         return pixbuf;
@@ -64,90 +64,283 @@ get_pixbuf_from_gicon(FsearchResultView *result_view, GIcon *icon, int32_t icon_
     GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
     g_return_val_if_fail(icon_theme, NULL);
 
-    if (G_IS_THEMED_ICON(icon)) {
-        const char *const *names = g_themed_icon_get_names(G_THEMED_ICON(icon));
-        if (!names) {
-            return NULL;
-        }
-
-        g_autoptr(GtkIconInfo) icon_info = gtk_icon_theme_choose_icon_for_scale(icon_theme,
-                                                                                (const char **)names,
-                                                                                icon_size,
-                                                                                scale_factor,
-                                                                                GTK_ICON_LOOKUP_FORCE_SIZE);
-        if (!icon_info) {
-            return NULL;
-        }
-
-        pixbuf = gtk_icon_info_load_icon(icon_info, NULL);
+    const char *const *names = g_themed_icon_get_names(G_THEMED_ICON(icon));
+    if (!names) {
+        return NULL;
     }
-    else if (G_IS_LOADABLE_ICON(icon)) {
-        g_autoptr(GInputStream) stream = g_loadable_icon_load(G_LOADABLE_ICON(icon), icon_size, NULL, NULL, NULL);
-        if (stream) {
-            pixbuf = gdk_pixbuf_new_from_stream_at_scale(stream, icon_size, icon_size, TRUE, NULL, NULL);
-        }
+
+    g_autoptr(GtkIconInfo) icon_info = gtk_icon_theme_choose_icon_for_scale(icon_theme,
+                                                                            (const char **)names,
+                                                                            icon_size,
+                                                                            scale_factor,
+                                                                            GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (!icon_info) {
+        return NULL;
     }
 
+    pixbuf = gtk_icon_info_load_icon(icon_info, NULL);
     if (pixbuf) {
         g_hash_table_insert(result_view->pixbuf_cache, g_object_ref(icon), pixbuf);
     }
     return pixbuf;
 }
 
-static cairo_surface_t *
-get_icon_surface(FsearchResultView *result_view,
-                 GdkWindow *win,
-                 const char *name,
-                 const char *path,
-                 FsearchDatabaseEntryType type,
-                 int32_t icon_size,
-                 int32_t scale_factor) {
-    maybe_reset_icon_caches(result_view);
-
-    g_autoptr(GIcon) icon = NULL;
-    struct stat buffer;
-    if (lstat(path, &buffer)) {
-        icon = g_themed_icon_new("edit-delete");
-    }
-    else if (type == DATABASE_ENTRY_TYPE_FILE && fsearch_file_utils_is_desktop_file(path)) {
-        icon = get_desktop_file_icon(result_view, path);
-    }
-    else {
-        icon = fsearch_file_utils_guess_icon(name, path, type == DATABASE_ENTRY_TYPE_FOLDER);
+// the highlights of an entry are kept for at most this many entries
+#define HIGHLIGHT_CACHE_MAX_ENTRIES 1000
+
+typedef struct {
+    PangoAttrList *highlights[NUM_DATABASE_INDEX_TYPES];
+} HighlightCacheItem;
+
+static void
+highlight_cache_item_free(HighlightCacheItem *item) {
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_clear_pointer(&item->highlights[i], pango_attr_list_unref);
     }
+    g_clear_pointer(&item, free);
+}
 
-    GdkPixbuf *pixbuf = get_pixbuf_from_gicon(result_view, icon, icon_size, scale_factor);
-    if (!pixbuf) {
-        return NULL;
+static HighlightCacheItem *
+get_highlights(FsearchResultView *result_view, FsearchQuery *query, FsearchDatabaseEntry *entry) {
+    if (result_view->highlight_query != query) {
+        g_hash_table_remove_all(result_view->highlight_cache);
+        g_clear_pointer(&result_view->highlight_query, fsearch_query_unref);
+        result_view->highlight_query = fsearch_query_ref(query);
+        // the folder verdicts of the previous query belong to other nodes
+        fsearch_query_match_data_reset(result_view->highlight_match_data);
+    }
+    HighlightCacheItem *item = g_hash_table_lookup(result_view->highlight_cache, entry);
+    if (item) {
+        return item;
+    }
+    if (g_hash_table_size(result_view->highlight_cache) >= HIGHLIGHT_CACHE_MAX_ENTRIES) {
+        g_hash_table_remove_all(result_view->highlight_cache);
     }
 
-    return gdk_cairo_surface_create_from_pixbuf(pixbuf, scale_factor, win);
+    FsearchQueryMatchData *match_data = result_view->highlight_match_data;
+    fsearch_query_match_data_set_entry(match_data, entry);
+    fsearch_query_highlight(query, match_data);
+
+    item = calloc(1, sizeof(HighlightCacheItem));
+    g_assert(item);
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        PangoAttrList *attrs = fsearch_query_match_get_highlight(match_data, i);
+        item->highlights[i] = attrs ? pango_attr_list_ref(attrs) : NULL;
+    }
+    // drops the highlights of the match data
+    fsearch_query_match_data_set_entry(match_data, NULL);
+    g_hash_table_insert(result_view->highlight_cache, entry, item);
+    return item;
 }
 
 typedef struct {
-    char *display_name;
-
-    FsearchQueryMatchData *match_data;
-    PangoAttrList *highlights[NUM_DATABASE_INDEX_TYPES];
+    // the link of the row in row_cache_lru, its data is the context itself
+    GList lru_link;
+    uint32_t row;
+    // Only used to tell whether the row still shows the same entry, it's never dereferenced without holding the
+    // lock of the view
+    FsearchDatabaseEntry *entry;
 
     FsearchDatabaseEntryType entry_type;
-
     GString *name;
-    GString *path;
+    off_t size_bytes;
+    time_t mtime;
+
+    // Everything else is only computed once a column needs it, see the draw_row_ctx_get_* functions
+    char *display_name;
+    // the path is the beginning of the full path
     GString *full_path;
+    size_t path_len;
     char *size;
-    char *type;
     char *extension;
     char time[100];
+    bool highlights_set;
+    PangoAttrList *highlights[NUM_DATABASE_INDEX_TYPES];
+
+    // the file type is NULL and the icon isn't set until they were looked up, see row_info_resolve
+    char *type;
+    bool type_requested;
+    GIcon *icon;
+    // loadable icons, like thumbnails, are loaded along with the icon
+    GdkPixbuf *pixbuf;
 } DrawRowContext;
 
+typedef struct RowInfoResolver {
+    // only accessed on the main thread, NULL once the result view is gone
+    FsearchResultView *result_view;
+
+    volatile int ref_count;
+} RowInfoResolver;
+
+typedef struct {
+    RowInfoResolver *resolver;
+    uint32_t serial;
+    uint32_t row;
+    // never dereferenced, see DrawRowContext
+    FsearchDatabaseEntry *entry;
+
+    char *name;
+    char *path;
+    bool is_folder;
+    // the key of the file type in file_type_cache, NULL if the file type is known already
+    char *file_type_key;
+    // 0 if no icon is needed
+    int32_t icon_size;
+
+    char *file_type;
+    GIcon *icon;
+    GdkPixbuf *pixbuf;
+} RowInfoRequest;
+
+static GThreadPool *row_info_pool = NULL;
+// incremented for every request, newer requests are handled first since their rows are more likely to be visible
+static uint32_t row_info_serial = 0;
+
+// File types only depend on the name, which mostly boils down to the extension
+static GHashTable *file_type_cache = NULL;
+static GMutex file_type_cache_mutex;
+
+static char *
+get_file_type_cache_key(const char *name) {
+    const char *ext = fsearch_string_get_extension(name);
+    return ext[0] != '\0' ? g_strconcat("*.", ext, NULL) : g_strdup(name);
+}
+
+static char *
+file_type_cache_lookup(const char *key) {
+    g_mutex_lock(&file_type_cache_mutex);
+    char *file_type = file_type_cache ? g_strdup(g_hash_table_lookup(file_type_cache, key)) : NULL;
+    g_mutex_unlock(&file_type_cache_mutex);
+    return file_type;
+}
+
+static void
+file_type_cache_insert(const char *key, const char *file_type) {
+    g_mutex_lock(&file_type_cache_mutex);
+    if (!file_type_cache) {
+        file_type_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+    else if (g_hash_table_size(file_type_cache) >= FILE_TYPE_CACHE_MAX_SIZE) {
+        g_hash_table_remove_all(file_type_cache);
+    }
+    g_hash_table_replace(file_type_cache, g_strdup(key), g_strdup(file_type));
+    g_mutex_unlock(&file_type_cache_mutex);
+}
+
+static RowInfoResolver *
+row_info_resolver_ref(RowInfoResolver *resolver) {
+    g_atomic_int_inc(&resolver->ref_count);
+    return resolver;
+}
+
+static void
+row_info_resolver_unref(RowInfoResolver *resolver) {
+    if (g_atomic_int_dec_and_test(&resolver->ref_count)) {
+        g_clear_pointer(&resolver, free);
+    }
+}
+
+static void
+row_info_request_free(RowInfoRequest *request) {
+    g_clear_pointer(&request->resolver, row_info_resolver_unref);
+    g_clear_pointer(&request->name, g_free);
+    g_clear_pointer(&request->path, g_free);
+    g_clear_pointer(&request->file_type_key, g_free);
+    g_clear_pointer(&request->file_type, g_free);
+    g_clear_object(&request->icon);
+    g_clear_object(&request->pixbuf);
+    g_clear_pointer(&request, free);
+}
+
+static gint
+row_info_request_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const uint32_t serial_a = ((const RowInfoRequest *)a)->serial;
+    const uint32_t serial_b = ((const RowInfoRequest *)b)->serial;
+    return (serial_a < serial_b) - (serial_a > serial_b);
+}
+
+static gboolean
+row_info_apply_cb(gpointer data) {
+    RowInfoRequest *request = data;
+    FsearchResultView *result_view = request->resolver->result_view;
+    DrawRowContext *ctx =
+        result_view ? g_hash_table_lookup(result_view->row_cache, GINT_TO_POINTER(request->row + 1)) : NULL;
+    // the row might have been dropped from the cache or show a different entry by now
+    if (ctx && ctx->entry == request->entry) {
+        if (request->file_type) {
+            g_clear_pointer(&ctx->type, g_free);
+            ctx->type = g_steal_pointer(&request->file_type);
+        }
+        if (request->icon) {
+            g_clear_object(&ctx->icon);
+            g_clear_object(&ctx->pixbuf);
+            ctx->icon = g_steal_pointer(&request->icon);
+            ctx->pixbuf = g_steal_pointer(&request->pixbuf);
+        }
+        fsearch_list_view_redraw_row(result_view->list_view, request->row);
+    }
+    g_clear_pointer(&request, row_info_request_free);
+    return G_SOURCE_REMOVE;
+}
+
+// Runs on the threads of row_info_pool, everything which might have to access the filesystem happens here
+static void
+row_info_resolve(gpointer data, gpointer user_data) {
+    RowInfoRequest *request = data;
+    if (request->file_type_key) {
+        request->file_type = fsearch_file_utils_get_file_type(request->name, request->is_folder);
+        file_type_cache_insert(request->file_type_key, request->file_type);
+    }
+    if (request->icon_size > 0) {
+        struct stat buffer;
+        if (lstat(request->path, &buffer)) {
+            request->icon = g_themed_icon_new("edit-delete");
+        }
+        else if (!request->is_folder && fsearch_file_utils_is_desktop_file(request->path)) {
+            request->icon = fsearch_file_utils_get_desktop_file_icon(request->path);
+        }
+        else {
+            request->icon = fsearch_file_utils_guess_icon(request->name, request->path, request->is_folder);
+        }
+
+        if (request->icon && !G_IS_THEMED_ICON(request->icon) && G_IS_LOADABLE_ICON(request->icon)) {
+            g_autoptr(GInputStream) stream =
+                g_loadable_icon_load(G_LOADABLE_ICON(request->icon), request->icon_size, NULL, NULL, NULL);
+            if (stream) {
+                request->pixbuf = gdk_pixbuf_new_from_stream_at_scale(stream,
+                                                                      request->icon_size,
+                                                                      request->icon_size,
+                                                                      TRUE,
+                                                                      NULL,
+                                                                      NULL);
+            }
+        }
+    }
+    g_idle_add(row_info_apply_cb, request);
+}
+
+static cairo_surface_t *
+get_icon_surface(FsearchResultView *result_view, GdkWindow *win, DrawRowContext *ctx, int32_t icon_size) {
+    const int32_t scale_factor = gdk_window_get_scale_factor(win);
+    GdkPixbuf *pixbuf = ctx->pixbuf;
+    if (!pixbuf && ctx->icon && G_IS_THEMED_ICON(ctx->icon)) {
+        maybe_reset_icon_caches(result_view);
+        pixbuf = get_pixbuf_from_themed_icon(result_view, ctx->icon, icon_size, scale_factor);
+    }
+    if (!pixbuf) {
+        return NULL;
+    }
+    return gdk_cairo_surface_create_from_pixbuf(pixbuf, scale_factor, win);
+}
+
 static void
 draw_row_ctx_free(DrawRowContext *ctx) {
-    g_clear_pointer(&ctx->match_data, fsearch_query_match_data_free);
     g_clear_pointer(&ctx->display_name, g_free);
     g_clear_pointer(&ctx->extension, g_free);
     g_clear_pointer(&ctx->type, g_free);
     g_clear_pointer(&ctx->size, g_free);
+    g_clear_object(&ctx->icon);
+    g_clear_object(&ctx->pixbuf);
     for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
         if (ctx->highlights[i]) {
             g_clear_pointer(&ctx->highlights[i], pango_attr_list_unref);
@@ -156,99 +349,291 @@ draw_row_ctx_free(DrawRowContext *ctx) {
     if (ctx->name) {
         g_string_free(g_steal_pointer(&ctx->name), TRUE);
     }
-    if (ctx->path) {
-        g_string_free(g_steal_pointer(&ctx->path), TRUE);
-    }
     if (ctx->full_path) {
         g_string_free(g_steal_pointer(&ctx->full_path), TRUE);
     }
     g_clear_pointer(&ctx, free);
 }
 
-static DrawRowContext *
-draw_row_ctx_new(FsearchDatabaseView *view, uint32_t row, GdkWindow *bin_window, int32_t icon_size) {
-    DrawRowContext *ctx = calloc(1, sizeof(DrawRowContext));
-    g_assert(ctx);
-
-    FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
+// Locks the view and returns the entry of the row, or NULL (and the view is unlocked) if the row shows another
+// entry by now
+static FsearchDatabaseEntry *
+draw_row_ctx_lock_entry(FsearchResultView *result_view, DrawRowContext *ctx) {
+    db_view_lock(result_view->database_view);
+    FsearchDatabaseEntry *entry = db_view_entry_get_for_idx(result_view->database_view, ctx->row);
+    if (!entry || entry != ctx->entry) {
+        db_view_unlock(result_view->database_view);
+        return NULL;
+    }
+    return entry;
+}
 
-    bool ret = true;
-    db_view_lock(view);
+static const char *
+draw_row_ctx_get_display_name(DrawRowContext *ctx) {
+    if (!ctx->display_name) {
+        ctx->display_name = g_filename_display_name(ctx->name->str);
+    }
+    return ctx->display_name;
+}
 
-    const uint32_t num_items = db_view_get_num_entries(view);
-    if (row >= num_items) {
-        g_debug("[draw_row] row idx out of bound");
-        ret = false;
-        goto out;
+static GString *
+draw_row_ctx_get_full_path(FsearchResultView *result_view, DrawRowContext *ctx) {
+    if (ctx->full_path || !draw_row_ctx_lock_entry(result_view, ctx)) {
+        return ctx->full_path;
     }
+    ctx->full_path = db_view_entry_get_path_full_for_idx(result_view->database_view, ctx->row);
+    db_view_unlock(result_view->database_view);
 
-    ctx->name = db_view_entry_get_name_for_idx(view, row);
-    if (!ctx->name) {
-        g_debug("[draw_row] failed to get entry name");
-        ret = false;
-        goto out;
+    // Names never contain a separator, so the path ends before the last one. The path of entries in the root folder
+    // is the root folder itself, the root folder has no path.
+    const char *sep = strrchr(ctx->full_path->str, G_DIR_SEPARATOR);
+    const size_t sep_pos = sep ? sep - ctx->full_path->str : 0;
+    ctx->path_len = sep_pos > 0 ? sep_pos : (ctx->full_path->len > 1 ? 1 : 0);
+    return ctx->full_path;
+}
+
+static const char *
+draw_row_ctx_get_extension(FsearchResultView *result_view, DrawRowContext *ctx) {
+    if (!ctx->extension && draw_row_ctx_lock_entry(result_view, ctx)) {
+        ctx->extension = db_view_entry_get_extension_for_idx(result_view->database_view, ctx->row);
+        db_view_unlock(result_view->database_view);
     }
-    ctx->display_name = g_filename_display_name(ctx->name->str);
+    return ctx->extension;
+}
 
-    ctx->extension = db_view_entry_get_extension_for_idx(view, row);
+static const char *
+draw_row_ctx_get_size(DrawRowContext *ctx) {
+    if (!ctx->size) {
+        FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
+        ctx->size = fsearch_file_utils_get_size_formatted(ctx->size_bytes, config->show_base_2_units);
+    }
+    return ctx->size;
+}
 
-    ctx->path = db_view_entry_get_path_for_idx(view, row);
+static const char *
+draw_row_ctx_get_time(DrawRowContext *ctx) {
+    if (ctx->time[0] == '\0') {
+        strftime(ctx->time,
+                 sizeof(ctx->time),
+                 "%Y-%m-%d %H:%M", //"%Y-%m-%d %H:%M",
+                 localtime(&ctx->mtime));
+    }
+    return ctx->time;
+}
 
-    FsearchQuery *query = db_view_get_query(view);
+static PangoAttrList *
+draw_row_ctx_get_highlights(FsearchResultView *result_view, DrawRowContext *ctx, FsearchDatabaseIndexType idx) {
+    g_assert(idx >= 0 && idx < NUM_DATABASE_INDEX_TYPES);
+    if (ctx->highlights_set) {
+        return ctx->highlights[idx];
+    }
+    FsearchDatabaseEntry *entry = draw_row_ctx_lock_entry(result_view, ctx);
+    if (!entry) {
+        return NULL;
+    }
+    // all columns get their highlights at once
+    FsearchQuery *query = db_view_get_query(result_view->database_view);
     if (query) {
-        FsearchDatabaseEntry *entry = db_view_entry_get_for_idx(view, row);
-        ctx->match_data = fsearch_query_match_data_new();
-        fsearch_query_match_data_set_entry(ctx->match_data, entry);
-
-        fsearch_query_highlight(query, ctx->match_data);
+        HighlightCacheItem *item = get_highlights(result_view, query, entry);
+        for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+            ctx->highlights[i] = item->highlights[i] ? pango_attr_list_ref(item->highlights[i]) : NULL;
+        }
+    }
+    g_clear_pointer(&query, fsearch_query_unref);
+    db_view_unlock(result_view->database_view);
+    ctx->highlights_set = true;
+    return ctx->highlights[idx];
+}
 
-        g_clear_pointer(&query, fsearch_query_unref);
+static void
+row_info_request_queue(FsearchResultView *result_view, DrawRowContext *ctx, int32_t icon_size, bool need_type) {
+    // the types of folders and of files whose extension was seen before are known right away
+    bool resolve_type = false;
+    if (need_type && !ctx->type_requested) {
+        ctx->type_requested = true;
+        if (ctx->entry_type == DATABASE_ENTRY_TYPE_FOLDER) {
+            ctx->type = fsearch_file_utils_get_file_type(ctx->name->str, TRUE);
+        }
+        else {
+            g_autofree char *file_type_key = get_file_type_cache_key(ctx->name->str);
+            ctx->type = file_type_cache_lookup(file_type_key);
+        }
+        resolve_type = !ctx->type;
+    }
+    if (!resolve_type && icon_size <= 0) {
+        return;
+    }
+    GString *full_path = draw_row_ctx_get_full_path(result_view, ctx);
+    if (!full_path) {
+        return;
     }
+    if (!row_info_pool) {
+        row_info_pool = g_thread_pool_new(row_info_resolve, NULL, ROW_INFO_NUM_THREADS, FALSE, NULL);
+        g_thread_pool_set_sort_function(row_info_pool, row_info_request_compare, NULL);
+    }
+
+    RowInfoRequest *request = calloc(1, sizeof(RowInfoRequest));
+    g_assert(request);
+    request->resolver = row_info_resolver_ref(result_view->row_info_resolver);
+    request->serial = ++row_info_serial;
+    request->row = ctx->row;
+    request->entry = ctx->entry;
+    request->name = g_strdup(ctx->name->str);
+    request->path = g_strdup(full_path->str);
+    request->is_folder = ctx->entry_type == DATABASE_ENTRY_TYPE_FOLDER;
+    request->file_type_key = resolve_type ? get_file_type_cache_key(ctx->name->str) : NULL;
+    request->icon_size = icon_size;
+    g_thread_pool_push(row_info_pool, request, NULL);
+}
 
-    ctx->full_path = db_view_entry_get_path_full_for_idx(view, row);
+static const char *
+draw_row_ctx_get_type(FsearchResultView *result_view, DrawRowContext *ctx) {
+    if (!ctx->type_requested) {
+        // the type column was hidden when the row was created
+        row_info_request_queue(result_view, ctx, 0, true);
+    }
+    return ctx->type;
+}
 
-    ctx->entry_type = db_view_entry_get_type_for_idx(view, row);
-    ctx->type = fsearch_file_utils_get_file_type(ctx->name->str,
-                                                 ctx->entry_type == DATABASE_ENTRY_TYPE_FOLDER ? TRUE : FALSE);
+static DrawRowContext *
+draw_row_ctx_new(const FsearchDatabaseViewRow *view_row, uint32_t row) {
+    DrawRowContext *ctx = calloc(1, sizeof(DrawRowContext));
+    g_assert(ctx);
+    ctx->row = row;
+    ctx->entry = view_row->entry;
+    ctx->name = g_string_new(view_row->name);
+    ctx->entry_type = view_row->type;
+    ctx->size_bytes = view_row->size;
+    ctx->mtime = view_row->mtime;
+    return ctx;
+}
 
-    off_t size = db_view_entry_get_size_for_idx(view, row);
-    ctx->size = fsearch_file_utils_get_size_formatted(size, config->show_base_2_units);
+static void
+row_cache_evict(FsearchResultView *result_view) {
+    while (result_view->row_cache_lru.length > result_view->row_cache_capacity) {
+        GList *link = g_queue_pop_tail_link(&result_view->row_cache_lru);
+        DrawRowContext *ctx = link->data;
+        g_hash_table_remove(result_view->row_cache, GINT_TO_POINTER(ctx->row + 1));
+    }
+}
 
-    const time_t mtime = db_view_entry_get_mtime_for_idx(view, row);
-    strftime(ctx->time,
-             100,
-             "%Y-%m-%d %H:%M", //"%Y-%m-%d %H:%M",
-             localtime(&mtime));
+// Adds the rows [start, end) which aren't cached yet, their entries are read from the view in batches of
+// ROW_CACHE_FILL_MAX_ROWS rows, so the view gets locked only once per batch
+static void
+row_cache_fill(FsearchResultView *result_view, uint32_t start, uint32_t end, int32_t icon_size) {
+    FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
+    g_autoptr(GStringChunk) names = g_string_chunk_new(4096);
+    FsearchDatabaseViewRow view_rows[ROW_CACHE_FILL_MAX_ROWS];
 
-out:
-    db_view_unlock(view);
-    if (ret) {
-        return ctx;
+    while (start < end) {
+        // skip the cached rows, the batch ends before the next cached one
+        while (start < end && g_hash_table_contains(result_view->row_cache, GINT_TO_POINTER(start + 1))) {
+            start++;
+        }
+        if (start == end) {
+            break;
+        }
+        uint32_t batch_end = start + 1;
+        while (batch_end < end && batch_end - start < ROW_CACHE_FILL_MAX_ROWS
+               && !g_hash_table_contains(result_view->row_cache, GINT_TO_POINTER(batch_end + 1))) {
+            batch_end++;
+        }
+        const uint32_t num_rows = db_view_get_rows(result_view->database_view, start, batch_end, view_rows, names);
+        for (uint32_t i = 0; i < num_rows; i++) {
+            DrawRowContext *ctx = draw_row_ctx_new(&view_rows[i], start + i);
+            ctx->lru_link.data = ctx;
+            g_hash_table_insert(result_view->row_cache, GINT_TO_POINTER(ctx->row + 1), ctx);
+            g_queue_push_head_link(&result_view->row_cache_lru, &ctx->lru_link);
+            row_info_request_queue(result_view,
+                                   ctx,
+                                   config->show_listview_icons ? icon_size : 0,
+                                   config->show_type_column);
+        }
+        if (num_rows < batch_end - start) {
+            // the view has fewer entries
+            break;
+        }
+        start = batch_end;
+        g_string_chunk_clear(names);
     }
-    g_clear_pointer(&ctx, draw_row_ctx_free);
-    return NULL;
+    row_cache_evict(result_view);
 }
 
 static DrawRowContext *
-draw_row_ctx_get(FsearchResultView *result_view, uint32_t row, GdkWindow *bin_window, int32_t icon_size) {
+draw_row_ctx_get(FsearchResultView *result_view, uint32_t row, int32_t icon_size) {
     g_return_val_if_fail(result_view, NULL);
 
-    if (g_hash_table_size(result_view->row_cache) > 100) {
-        fsearch_result_view_row_cache_reset(result_view);
-    }
-
     DrawRowContext *ctx = g_hash_table_lookup(result_view->row_cache, GINT_TO_POINTER(row + 1));
-    if (ctx) {
-        return ctx;
-    }
-    ctx = draw_row_ctx_new(result_view->database_view, row, bin_window, icon_size);
     if (!ctx) {
-        return NULL;
+        // Rows get painted one after the other, so the rest of the viewport most likely follows in the direction of
+        // the sort order. They're all read from the view at once.
+        uint32_t first_row = 0;
+        uint32_t num_rows = 1;
+        if (result_view->list_view) {
+            fsearch_list_view_get_visible_rows(result_view->list_view, &first_row, &num_rows);
+        }
+        if (result_view->list_view && fsearch_list_view_get_sort_type(result_view->list_view) == GTK_SORT_DESCENDING) {
+            row_cache_fill(result_view, row >= num_rows ? row + 1 - num_rows : 0, row + 1, icon_size);
+        }
+        else {
+            row_cache_fill(result_view, row, row + num_rows, icon_size);
+        }
+        ctx = g_hash_table_lookup(result_view->row_cache, GINT_TO_POINTER(row + 1));
+        if (!ctx) {
+            g_debug("[draw_row] failed to get entry for row %d", row);
+            return NULL;
+        }
     }
-    g_hash_table_insert(result_view->row_cache, GINT_TO_POINTER(row + 1), ctx);
+    // it's the most recently used row now
+    g_queue_unlink(&result_view->row_cache_lru, &ctx->lru_link);
+    g_queue_push_head_link(&result_view->row_cache_lru, &ctx->lru_link);
     return ctx;
 }
 
+static gboolean
+prefetch_rows_cb(gpointer user_data) {
+    FsearchResultView *result_view = user_data;
+    result_view->prefetch_source_id = 0;
+    if (!result_view->database_view || !result_view->list_view) {
+        return G_SOURCE_REMOVE;
+    }
+
+    uint32_t first_row = 0;
+    uint32_t num_rows = 0;
+    fsearch_list_view_get_visible_rows(result_view->list_view, &first_row, &num_rows);
+    if (first_row != result_view->prefetch_first_row) {
+        result_view->prefetch_backwards = first_row < result_view->prefetch_first_row;
+        result_view->prefetch_first_row = first_row;
+    }
+    result_view->row_cache_capacity = MAX(num_rows * ROW_CACHE_NUM_VIEWPORTS, ROW_CACHE_MIN_CAPACITY);
+
+    db_view_lock(result_view->database_view);
+    const uint32_t num_entries = db_view_get_num_entries(result_view->database_view);
+    db_view_unlock(result_view->database_view);
+
+    // one viewport ahead, the visible rows stay the most recently used ones
+    uint32_t start = 0;
+    uint32_t end = 0;
+    if (result_view->prefetch_backwards) {
+        start = first_row > num_rows ? first_row - num_rows : 0;
+        end = first_row;
+    }
+    else {
+        start = first_row + num_rows;
+        end = MIN(start + num_rows, num_entries);
+    }
+    const int32_t icon_size = get_icon_size_for_height(result_view->row_height - ROW_PADDING_X);
+    row_cache_fill(result_view, start, MIN(end, num_entries), icon_size);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+prefetch_rows(FsearchResultView *result_view) {
+    if (result_view->prefetch_source_id == 0) {
+        result_view->prefetch_source_id = g_idle_add_full(G_PRIORITY_LOW, prefetch_rows_cb, result_view, NULL);
+    }
+}
+
 char *
 fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
                                   uint32_t row,
@@ -325,9 +710,8 @@ fsearch_result_view_query_tooltip(FsearchDatabaseView *view,
 }
 
 static void
-set_attributes(PangoLayout *layout, FsearchQueryMatchData *match_data, FsearchDatabaseIndexType idx) {
-    g_assert(idx >= 0 && idx < NUM_DATABASE_INDEX_TYPES);
-    PangoAttrList *attrs = fsearch_query_match_get_highlight(match_data, idx);
+set_attributes(FsearchResultView *result_view, PangoLayout *layout, DrawRowContext *ctx, FsearchDatabaseIndexType idx) {
+    PangoAttrList *attrs = draw_row_ctx_get_highlights(result_view, ctx, idx);
     if (attrs) {
         pango_layout_set_attributes(layout, attrs);
     }
@@ -353,14 +737,17 @@ fsearch_result_view_draw_row(FsearchResultView *result_view,
     const int32_t icon_size = get_icon_size_for_height(rect->height - ROW_PADDING_X);
 
     if (result_view->row_height != rect->height) {
+        // the icons of the cached rows have the wrong size
         reset_icon_caches(result_view);
+        fsearch_result_view_row_cache_reset(result_view);
     }
     result_view->row_height = rect->height;
 
-    DrawRowContext *ctx = draw_row_ctx_get(result_view, row, bin_window, icon_size);
+    DrawRowContext *ctx = draw_row_ctx_get(result_view, row, icon_size);
     if (!ctx) {
         return;
     }
+    prefetch_rows(result_view);
 
     GtkStateFlags flags = gtk_style_context_get_state(context);
     if (row_selected) {
@@ -389,6 +776,12 @@ fsearch_result_view_draw_row(FsearchResultView *result_view,
 
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
 
+    // columns which are scrolled out of view are skipped, so their row data never gets computed
+    GdkRectangle clip_rect = {};
+    if (!gdk_cairo_get_clip_rectangle(cr, &clip_rect)) {
+        clip_rect = *rect;
+    }
+
     // Render row foreground
     int32_t x = rect->x;
     for (GList *col = columns; col != NULL; col = col->next) {
@@ -396,6 +789,10 @@ fsearch_result_view_draw_row(FsearchResultView *result_view,
         if (!column->visible) {
             continue;
         }
+        if (x + column->effective_width <= clip_rect.x || x >= clip_rect.x + clip_rect.width) {
+            x += column->effective_width;
+            continue;
+        }
         cairo_save(cr);
         cairo_rectangle(cr, x, rect->y, column->effective_width, rect->height);
         cairo_clip(cr);
@@ -409,25 +806,18 @@ fsearch_result_view_draw_row(FsearchResultView *result_view,
         switch (column->type) {
         case DATABASE_INDEX_TYPE_NAME: {
             if (config->show_listview_icons) {
-                cairo_surface_t *icon_surface = config->show_listview_icons
-                                                  ? get_icon_surface(result_view,
-                                                                     bin_window,
-                                                                     ctx->name->str,
-                                                                     ctx->full_path->str,
-                                                                     ctx->entry_type,
-                                                                     icon_size,
-                                                                     gdk_window_get_scale_factor(bin_window))
-                                                  : NULL;
+                // until the icon was looked up its space is left empty, so the name doesn't move once it's there
+                cairo_surface_t *icon_surface = get_icon_surface(result_view, bin_window, ctx, icon_size);
+                int32_t x_icon = x;
+                if (right_to_left_text) {
+                    x_icon += column->effective_width - icon_size - ROW_PADDING_X;
+                }
+                else {
+                    x_icon += ROW_PADDING_X;
+                    dx += icon_size + 2 * ROW_PADDING_X;
+                }
+                dw += icon_size + 2 * ROW_PADDING_X;
                 if (icon_surface) {
-                    int32_t x_icon = x;
-                    if (right_to_left_text) {
-                        x_icon += column->effective_width - icon_size - ROW_PADDING_X;
-                    }
-                    else {
-                        x_icon += ROW_PADDING_X;
-                        dx += icon_size + 2 * ROW_PADDING_X;
-                    }
-                    dw += icon_size + 2 * ROW_PADDING_X;
                     gtk_render_icon_surface(context,
                                             cr,
                                             icon_surface,
@@ -436,30 +826,35 @@ fsearch_result_view_draw_row(FsearchResultView *result_view,
                     g_clear_pointer(&icon_surface, cairo_surface_destroy);
                 }
             }
-            text = ctx->display_name;
+            text = draw_row_ctx_get_display_name(ctx);
+        } break;
+        case DATABASE_INDEX_TYPE_PATH: {
+            GString *full_path = draw_row_ctx_get_full_path(result_view, ctx);
+            if (full_path) {
+                text = full_path->str;
+                text_len = (int32_t)ctx->path_len;
+            }
         } break;
-        case DATABASE_INDEX_TYPE_PATH:
-            text = ctx->path->str;
-            text_len = (int32_t)ctx->path->len;
-            break;
         case DATABASE_INDEX_TYPE_SIZE:
-            text = ctx->size;
+            text = draw_row_ctx_get_size(ctx);
             break;
         case DATABASE_INDEX_TYPE_EXTENSION:
-            text = ctx->extension;
-            break;
-        case DATABASE_INDEX_TYPE_FILETYPE:
-            text = ctx->type;
+            text = draw_row_ctx_get_extension(result_view, ctx);
             break;
+        case DATABASE_INDEX_TYPE_FILETYPE: {
+            // still being looked up
+            const char *type = draw_row_ctx_get_type(result_view, ctx);
+            text = type ? type : "";
+        } break;
         case DATABASE_INDEX_TYPE_MODIFICATION_TIME:
-            text = ctx->time;
+            text = draw_row_ctx_get_time(ctx);
             break;
         default:
             text = NULL;
         }
 
         if (config->highlight_search_terms) {
-            set_attributes(layout, ctx->match_data, column->type);
+            set_attributes(result_view, layout, ctx, column->type);
         }
 
         pango_layout_set_text(layout, text ? text : _("Invalid row data"), text_len);
@@ -477,7 +872,9 @@ fsearch_result_view_draw_row(FsearchResultView *result_view,
 void
 fsearch_result_view_row_cache_reset(FsearchResultView *result_view) {
     g_return_if_fail(result_view);
+    // the contexts own the links of row_cache_lru
     g_hash_table_remove_all(result_view->row_cache);
+    g_queue_init(&result_view->row_cache_lru);
 }
 
 FsearchResultView *
@@ -486,16 +883,33 @@ fsearch_result_view_new(void) {
     g_assert(result_view);
 
     result_view->row_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)draw_row_ctx_free);
+    g_queue_init(&result_view->row_cache_lru);
+    result_view->row_cache_capacity = ROW_CACHE_MIN_CAPACITY;
     result_view->pixbuf_cache =
         g_hash_table_new_full(g_icon_hash, (GEqualFunc)g_icon_equal, g_object_unref, g_object_unref);
-    result_view->app_gicon_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+    result_view->row_info_resolver = calloc(1, sizeof(RowInfoResolver));
+    g_assert(result_view->row_info_resolver);
+    result_view->row_info_resolver->result_view = result_view;
+    result_view->row_info_resolver->ref_count = 1;
+    result_view->highlight_cache =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)highlight_cache_item_free);
+    result_view->highlight_match_data = fsearch_query_match_data_new();
     return result_view;
 }
 
 void
 fsearch_result_view_free(FsearchResultView *result_view) {
+    if (result_view->prefetch_source_id) {
+        g_source_remove(result_view->prefetch_source_id);
+        result_view->prefetch_source_id = 0;
+    }
     g_clear_pointer(&result_view->pixbuf_cache, g_hash_table_unref);
-    g_clear_pointer(&result_view->app_gicon_cache, g_hash_table_unref);
+    // requests which are still being resolved drop their results
+    result_view->row_info_resolver->result_view = NULL;
+    g_clear_pointer(&result_view->row_info_resolver, row_info_resolver_unref);
     g_clear_pointer(&result_view->row_cache, g_hash_table_unref);
+    g_clear_pointer(&result_view->highlight_cache, g_hash_table_unref);
+    g_clear_pointer(&result_view->highlight_query, fsearch_query_unref);
+    g_clear_pointer(&result_view->highlight_match_data, fsearch_query_match_data_free);
     g_clear_pointer(&result_view, free);
 }
@@ -2,14 +2,31 @@
 
 #include "fsearch_database_view.h"
 #include "fsearch_list_view.h"
+#include "fsearch_query.h"
 
 typedef struct {
     FsearchDatabaseView *database_view;
     FsearchListView *list_view;
 
+    // row + 1 -> the drawing context of the row, the least recently drawn rows get dropped from row_cache_lru
+    // once there are more than a few viewports of them
     GHashTable *row_cache;
+    GQueue row_cache_lru;
+    uint32_t row_cache_capacity;
+    // the rows ahead of the viewport in the scroll direction get cached while the main loop is idle
+    guint prefetch_source_id;
+    uint32_t prefetch_first_row;
+    bool prefetch_backwards;
     GHashTable *pixbuf_cache;
-    GHashTable *app_gicon_cache;
+    // the file types and icons of new rows are looked up in the background, see row_info_resolve
+    struct RowInfoResolver *row_info_resolver;
+
+    // FsearchDatabaseEntry * -> the highlights of the entry for highlight_query, so they're computed only once
+    // per entry and query, no matter how often its row gets drawn or moves
+    GHashTable *highlight_cache;
+    FsearchQuery *highlight_query;
+    // reused for computing the highlights of all entries
+    FsearchQueryMatchData *highlight_match_data;
 
     // remember the row height from the last draw call
     // when it changes we need to reset the icon cache
@@ -0,0 +1,240 @@
+#define G_LOG_DOMAIN "fsearch-scan-throttle"
+
+#include "fsearch_scan_throttle.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+// Calls may run ahead of the budget by that much before the caller has to wait, and then it waits until it's only
+// half of that ahead, so short bursts don't sleep after every call
+#define THROTTLE_BURST_US (100 * 1000)
+// how often the share gets adjusted to the latency of the calls
+#define THROTTLE_ADJUST_INTERVAL_US (100 * 1000)
+// weight of a new sample in the average latency
+#define THROTTLE_LATENCY_SMOOTHING (1.0 / 8)
+// The usual latency is the lowest average seen so far, it slowly rises towards the current one, so a filesystem
+// which stays busy doesn't slow the scan down forever
+#define THROTTLE_BASE_LATENCY_DRIFT 1.005
+// the filesystem is considered busy while calls take that much longer than usual, and idle again below the other
+#define THROTTLE_BUSY_RATIO 2.0
+#define THROTTLE_IDLE_RATIO 1.5
+#define THROTTLE_BATTERY_CHECK_INTERVAL_US (30 * G_USEC_PER_SEC)
+#define THROTTLE_POWER_SUPPLY_DIR "/sys/class/power_supply"
+
+struct FsearchScanThrottle {
+    GMutex mutex;
+
+    double max_calls_per_second;
+    double max_bytes_per_second;
+    // the time the charged calls are allowed to take up to
+    int64_t budget_end_us;
+
+    double latency_us;
+    double base_latency_us;
+    bool has_latency;
+    double share;
+    int64_t adjusted_us;
+
+    char *power_supply_dir;
+    bool on_battery;
+    bool battery_checked;
+    int64_t battery_checked_us;
+
+    volatile int ref_count;
+};
+
+FsearchScanThrottle *
+fsearch_scan_throttle_new(uint32_t max_calls_per_second, uint32_t max_kib_per_second) {
+    FsearchScanThrottle *throttle = calloc(1, sizeof(FsearchScanThrottle));
+    g_assert(throttle);
+    g_mutex_init(&throttle->mutex);
+    throttle->max_calls_per_second = max_calls_per_second;
+    throttle->max_bytes_per_second = (double)max_kib_per_second * 1024;
+    throttle->share = 1;
+    throttle->ref_count = 1;
+    return throttle;
+}
+
+FsearchScanThrottle *
+fsearch_scan_throttle_ref(FsearchScanThrottle *throttle) {
+    if (!throttle || g_atomic_int_get(&throttle->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&throttle->ref_count);
+    return throttle;
+}
+
+void
+fsearch_scan_throttle_unref(FsearchScanThrottle *throttle) {
+    if (!throttle || g_atomic_int_get(&throttle->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&throttle->ref_count)) {
+        g_clear_pointer(&throttle->power_supply_dir, g_free);
+        g_mutex_clear(&throttle->mutex);
+        g_clear_pointer(&throttle, free);
+    }
+}
+
+void
+fsearch_scan_throttle_set_power_supply_dir(FsearchScanThrottle *throttle, const char *dir) {
+    g_assert(throttle);
+    g_mutex_lock(&throttle->mutex);
+    g_clear_pointer(&throttle->power_supply_dir, g_free);
+    throttle->power_supply_dir = g_strdup(dir);
+    throttle->battery_checked = false;
+    g_mutex_unlock(&throttle->mutex);
+}
+
+static void
+throttle_update_share(FsearchScanThrottle *throttle, uint32_t num_calls, int64_t duration_us, int64_t now_us) {
+    if (num_calls == 0 || duration_us < 0) {
+        return;
+    }
+    const double latency_us = (double)duration_us / num_calls;
+    if (!throttle->has_latency) {
+        throttle->latency_us = throttle->base_latency_us = latency_us;
+        throttle->has_latency = true;
+        throttle->adjusted_us = now_us;
+        return;
+    }
+    throttle->latency_us += THROTTLE_LATENCY_SMOOTHING * (latency_us - throttle->latency_us);
+    if (now_us - throttle->adjusted_us < THROTTLE_ADJUST_INTERVAL_US) {
+        return;
+    }
+    throttle->adjusted_us = now_us;
+    throttle->base_latency_us = MIN(throttle->base_latency_us * THROTTLE_BASE_LATENCY_DRIFT, throttle->latency_us);
+    if (throttle->latency_us > THROTTLE_BUSY_RATIO * throttle->base_latency_us) {
+        // back off quickly and speed up slowly, like TCP does
+        throttle->share = MAX(FSEARCH_SCAN_THROTTLE_MIN_SHARE, throttle->share * 0.75);
+    }
+    else if (throttle->latency_us < THROTTLE_IDLE_RATIO * throttle->base_latency_us) {
+        throttle->share = MIN(1.0, throttle->share + FSEARCH_SCAN_THROTTLE_MIN_SHARE);
+    }
+}
+
+int64_t
+fsearch_scan_throttle_charge(FsearchScanThrottle *throttle,
+                             uint32_t num_calls,
+                             uint64_t num_bytes,
+                             int64_t duration_us,
+                             int64_t now_us) {
+    g_assert(throttle);
+    g_mutex_lock(&throttle->mutex);
+
+    if (!throttle->battery_checked || now_us - throttle->battery_checked_us >= THROTTLE_BATTERY_CHECK_INTERVAL_US) {
+        throttle->on_battery = fsearch_scan_throttle_is_on_battery(throttle->power_supply_dir);
+        throttle->battery_checked = true;
+        throttle->battery_checked_us = now_us;
+    }
+    throttle_update_share(throttle, num_calls, duration_us, now_us);
+    const double share = throttle->share * (throttle->on_battery ? FSEARCH_SCAN_THROTTLE_BATTERY_SHARE : 1.0);
+
+    // The calls may take up as much time as their duration (the filesystem is only used that long of the time) and
+    // their share of the budgets allows, whatever is longer
+    duration_us = MAX(duration_us, 0);
+    double slot_us = duration_us / share;
+    if (throttle->max_calls_per_second > 0) {
+        slot_us = MAX(slot_us, num_calls * G_USEC_PER_SEC / (throttle->max_calls_per_second * share));
+    }
+    if (throttle->max_bytes_per_second > 0) {
+        slot_us = MAX(slot_us, (double)num_bytes * G_USEC_PER_SEC / (throttle->max_bytes_per_second * share));
+    }
+    throttle->budget_end_us = MAX(throttle->budget_end_us, now_us - duration_us) + (int64_t)slot_us;
+
+    int64_t wait_us = 0;
+    if (throttle->budget_end_us - now_us > THROTTLE_BURST_US) {
+        wait_us = throttle->budget_end_us - now_us - THROTTLE_BURST_US / 2;
+    }
+    g_mutex_unlock(&throttle->mutex);
+    return wait_us;
+}
+
+void
+fsearch_scan_throttle_charge_and_wait(FsearchScanThrottle *throttle,
+                                      uint32_t num_calls,
+                                      uint64_t num_bytes,
+                                      int64_t duration_us) {
+    const int64_t wait_us =
+        fsearch_scan_throttle_charge(throttle, num_calls, num_bytes, duration_us, g_get_monotonic_time());
+    if (wait_us > 0) {
+        g_usleep((gulong)wait_us);
+    }
+}
+
+double
+fsearch_scan_throttle_get_share(FsearchScanThrottle *throttle) {
+    g_assert(throttle);
+    g_mutex_lock(&throttle->mutex);
+    const double share = throttle->share;
+    g_mutex_unlock(&throttle->mutex);
+    return share;
+}
+
+// Returns the content of the attribute name of a power supply without the trailing newline, or NULL
+static char *
+power_supply_get_attribute(const char *dir, const char *supply, const char *name) {
+    g_autofree char *path = g_build_filename(dir, supply, name, NULL);
+    char *contents = NULL;
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+        return NULL;
+    }
+    return g_strstrip(contents);
+}
+
+bool
+fsearch_scan_throttle_is_on_battery(const char *dir) {
+    if (!dir) {
+        dir = THROTTLE_POWER_SUPPLY_DIR;
+    }
+    GDir *supplies = g_dir_open(dir, 0, NULL);
+    if (!supplies) {
+        return false;
+    }
+    bool discharging = false;
+    bool online = false;
+    const char *supply = NULL;
+    while ((supply = g_dir_read_name(supplies))) {
+        // the batteries of mice, keyboards, etc. don't power the system
+        g_autofree char *scope = power_supply_get_attribute(dir, supply, "scope");
+        if (scope && !strcmp(scope, "Device")) {
+            continue;
+        }
+        g_autofree char *type = power_supply_get_attribute(dir, supply, "type");
+        if (!type) {
+            continue;
+        }
+        if (!strcmp(type, "Battery")) {
+            g_autofree char *status = power_supply_get_attribute(dir, supply, "status");
+            discharging = discharging || (status && !strcmp(status, "Discharging"));
+        }
+        else {
+            g_autofree char *supply_online = power_supply_get_attribute(dir, supply, "online");
+            online = online || (supply_online && !strcmp(supply_online, "1"));
+        }
+    }
+    g_dir_close(supplies);
+    return discharging && !online;
+}
+
+void
+fsearch_scan_throttle_lower_thread_priority(void) {
+#if defined(__linux__) && defined(SYS_ioprio_set) && defined(SYS_gettid)
+    // not exported by glibc, see ioprio_set(2)
+    const int ioprio_class_idle = 3;
+    const int ioprio_class_shift = 13;
+    const int ioprio_who_process = 1;
+    // both only change the priority of the calling thread on Linux
+    syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift);
+    if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19)) {
+        g_debug("[scan_throttle] failed to lower the CPU priority");
+    }
+#endif
+}
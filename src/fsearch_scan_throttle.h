@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Paces the filesystem calls of background scans, so scheduled updates don't compete with builds or flood network
+// filesystems with metadata requests. Every batch of calls is charged against a budget of calls and bytes per second.
+// On top of that the scan slows itself down while the calls take longer than usual, i.e. while the filesystem is busy
+// with other work, and while the system runs on battery.
+typedef struct FsearchScanThrottle FsearchScanThrottle;
+
+// the scan gets at most this share of the time of the filesystem while it's busy or the system runs on battery
+#define FSEARCH_SCAN_THROTTLE_MIN_SHARE (1.0 / 16)
+#define FSEARCH_SCAN_THROTTLE_BATTERY_SHARE (1.0 / 4)
+
+// A limit of 0 means no limit
+FsearchScanThrottle *
+fsearch_scan_throttle_new(uint32_t max_calls_per_second, uint32_t max_kib_per_second);
+
+FsearchScanThrottle *
+fsearch_scan_throttle_ref(FsearchScanThrottle *throttle);
+
+void
+fsearch_scan_throttle_unref(FsearchScanThrottle *throttle);
+
+// Where the power supplies are looked up, NULL for /sys/class/power_supply
+void
+fsearch_scan_throttle_set_power_supply_dir(FsearchScanThrottle *throttle, const char *dir);
+
+// Charges num_calls calls, which read num_bytes and took duration_us microseconds together, and returns how many
+// microseconds the caller has to wait at now_us before the next call. Several threads may charge calls at once.
+int64_t
+fsearch_scan_throttle_charge(FsearchScanThrottle *throttle,
+                             uint32_t num_calls,
+                             uint64_t num_bytes,
+                             int64_t duration_us,
+                             int64_t now_us);
+
+// Like fsearch_scan_throttle_charge at the current monotonic time, but waits right away
+void
+fsearch_scan_throttle_charge_and_wait(FsearchScanThrottle *throttle,
+                                      uint32_t num_calls,
+                                      uint64_t num_bytes,
+                                      int64_t duration_us);
+
+// The share of the time of the filesystem the scan currently gets, between FSEARCH_SCAN_THROTTLE_MIN_SHARE and 1
+double
+fsearch_scan_throttle_get_share(FsearchScanThrottle *throttle);
+
+// Whether a battery discharges and no other power supply is online. dir is where the power supplies are listed,
+// NULL for /sys/class/power_supply.
+bool
+fsearch_scan_throttle_is_on_battery(const char *dir);
+
+// Gives the calling thread idle I/O priority and the lowest CPU priority. Without privileges neither can be undone,
+// so this is only meant for threads which exit once the scan is done.
+void
+fsearch_scan_throttle_lower_thread_priority(void);
@@ -0,0 +1,50 @@
+#define G_LOG_DOMAIN "fsearch-search-latency"
+
+#include "fsearch_search_latency.h"
+
+#include <glib.h>
+
+// weight of a new sample, the average follows changes of the database within a few searches
+#define LATENCY_SMOOTHING 0.3
+
+void
+fsearch_search_latency_add(FsearchSearchLatency *latency, FsearchSearchClass search_class, double ms, bool cancelled) {
+    g_return_if_fail(latency);
+    g_return_if_fail(search_class < NUM_FSEARCH_SEARCH_CLASSES);
+
+    if (latency->num_samples[search_class] == 0) {
+        if (cancelled) {
+            return;
+        }
+        latency->average_ms[search_class] = ms;
+    }
+    else {
+        if (cancelled && ms <= latency->average_ms[search_class]) {
+            return;
+        }
+        latency->average_ms[search_class] += LATENCY_SMOOTHING * (ms - latency->average_ms[search_class]);
+    }
+    latency->num_samples[search_class]++;
+    g_debug("[latency] class %d: %.2f ms -> average %.2f ms (%u samples)",
+            search_class,
+            ms,
+            latency->average_ms[search_class],
+            latency->num_samples[search_class]);
+}
+
+double
+fsearch_search_latency_get_average(const FsearchSearchLatency *latency, FsearchSearchClass search_class) {
+    g_return_val_if_fail(latency, 0);
+    g_return_val_if_fail(search_class < NUM_FSEARCH_SEARCH_CLASSES, 0);
+    return latency->num_samples[search_class] > 0 ? latency->average_ms[search_class] : 0;
+}
+
+uint32_t
+fsearch_search_latency_get_delay(const FsearchSearchLatency *latency, FsearchSearchClass search_class) {
+    const double average_ms = fsearch_search_latency_get_average(latency, search_class);
+    if (average_ms < FSEARCH_SEARCH_LATENCY_NO_DELAY_MS) {
+        return 0;
+    }
+    // while keys are pressed faster than searches finish, only the query after the last key press gets searched
+    return (uint32_t)MIN(average_ms, FSEARCH_SEARCH_LATENCY_MAX_DELAY_MS);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// How a search found its results, searches of the same class usually take about the same time
+typedef enum {
+    // all entries of the database were searched
+    FSEARCH_SEARCH_CLASS_FULL,
+    // only the results of the previous query were searched, e.g. because more characters were typed
+    FSEARCH_SEARCH_CLASS_REFINE,
+    NUM_FSEARCH_SEARCH_CLASSES,
+} FsearchSearchClass;
+
+// Moving averages of the time searches took, used to delay searches while typing when they're slow
+typedef struct {
+    double average_ms[NUM_FSEARCH_SEARCH_CLASSES];
+    uint32_t num_samples[NUM_FSEARCH_SEARCH_CLASSES];
+} FsearchSearchLatency;
+
+// A cancelled search took at least ms, it only counts if that's more than the average
+void
+fsearch_search_latency_add(FsearchSearchLatency *latency, FsearchSearchClass search_class, double ms, bool cancelled);
+
+// Returns 0 if no search of that class finished yet
+double
+fsearch_search_latency_get_average(const FsearchSearchLatency *latency, FsearchSearchClass search_class);
+
+// Returns how many milliseconds a search should wait for more input before it starts. Fast searches start right away,
+// slower ones wait about as long as they take, up to FSEARCH_SEARCH_LATENCY_MAX_DELAY_MS.
+uint32_t
+fsearch_search_latency_get_delay(const FsearchSearchLatency *latency, FsearchSearchClass search_class);
+
+// searches which take less than this aren't delayed
+#define FSEARCH_SEARCH_LATENCY_NO_DELAY_MS 10
+#define FSEARCH_SEARCH_LATENCY_MAX_DELAY_MS 300
@@ -1,93 +1,481 @@
 #define G_LOG_DOMAIN "fsearch-selection"
 
 #include "fsearch_selection.h"
+#include "fsearch_bitset.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Below this many entries of other databases the new positions are looked up with binary searches, above it they
+// get joined with the new entries by the hashes of their paths
+#define SELECTION_HASH_JOIN_MIN_ENTRIES 1000
+#define SELECTION_HASH_JOIN_GRAIN_SIZE 8192
+// FNV-1a
+#define SELECTION_PATH_HASH_OFFSET 0xcbf29ce484222325ULL
+#define SELECTION_PATH_HASH_PRIME 0x100000001b3ULL
+
+typedef struct {
+    // the name sorted entries of a database, entries are selected by their position in it
+    DynamicArray *entries;
+    FsearchBitset *selected;
+} FsearchSelectionDomain;
+
+enum {
+    SELECTION_DOMAIN_FOLDERS,
+    SELECTION_DOMAIN_FILES,
+    NUM_SELECTION_DOMAINS,
+};
+
+struct FsearchSelection {
+    FsearchSelectionDomain domains[NUM_SELECTION_DOMAINS];
+    // selected entries which aren't part of the domains, e.g. because they were removed from the database
+    GHashTable *others;
+};
+
+static FsearchSelectionDomain *
+get_domain(FsearchSelection *selection, FsearchDatabaseEntry *entry) {
+    return &selection->domains[db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER ? SELECTION_DOMAIN_FOLDERS
+                                                                                       : SELECTION_DOMAIN_FILES];
+}
+
+static bool
+get_position(FsearchSelectionDomain *domain, FsearchDatabaseEntry *entry, uint32_t *pos) {
+    if (!domain->entries) {
+        return false;
+    }
+    const uint32_t idx = db_entry_get_idx(entry);
+    if (idx >= darray_get_num_items(domain->entries) || darray_get_item(domain->entries, idx) != entry) {
+        return false;
+    }
+    *pos = idx;
+    return true;
+}
+
+static int32_t
+cmp_entries_by_name_and_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, void *data) {
+    const int res = db_entry_compare_entries_by_name(a, b);
+    if (res == 0) {
+        return db_entry_compare_entries_by_path(a, b);
+    }
+    return res;
+}
+
+// Like get_position, but also finds entries of other databases which have the same path
+static bool
+find_position(FsearchSelectionDomain *domain, FsearchDatabaseEntry *entry, uint32_t *pos) {
+    if (get_position(domain, entry, pos)) {
+        return true;
+    }
+    return domain->entries
+        && darray_binary_search_with_data(domain->entries,
+                                          entry,
+                                          (DynamicArrayCompareDataFunc)cmp_entries_by_name_and_path,
+                                          NULL,
+                                          pos);
+}
+
+FsearchSelection *
+fsearch_selection_new(void) {
+    FsearchSelection *selection = calloc(1, sizeof(FsearchSelection));
+    g_assert(selection);
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        selection->domains[i].selected = fsearch_bitset_new();
+    }
+    selection->others = g_hash_table_new(g_direct_hash, g_direct_equal);
+    return selection;
+}
 
 void
-fsearch_selection_free(GHashTable *selection) {
+fsearch_selection_free(FsearchSelection *selection) {
     g_assert(selection);
-    g_clear_pointer(&selection, g_hash_table_destroy);
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        g_clear_pointer(&selection->domains[i].entries, darray_unref);
+        g_clear_pointer(&selection->domains[i].selected, fsearch_bitset_free);
+    }
+    g_clear_pointer(&selection->others, g_hash_table_destroy);
+    g_clear_pointer(&selection, free);
 }
 
-GHashTable *
-fsearch_selection_new(void) {
-    return g_hash_table_new(g_direct_hash, g_direct_equal);
+// The hash of the path of an entry is the hash of the path of its parent continued with a separator and its name,
+// so the hashes of all entries of a database can be computed without building their paths
+static uint64_t
+path_hash_append(uint64_t hash, const char *name) {
+    hash = (hash ^ G_DIR_SEPARATOR) * SELECTION_PATH_HASH_PRIME;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+        hash = (hash ^ *c) * SELECTION_PATH_HASH_PRIME;
+    }
+    // 0 marks unused slots and folders whose hash wasn't computed yet
+    return hash != 0 ? hash : 1;
+}
+
+static uint64_t
+get_path_hash(FsearchDatabaseEntry *entry) {
+    FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(entry);
+    const uint64_t hash = parent ? get_path_hash(parent) : SELECTION_PATH_HASH_OFFSET;
+    return path_hash_append(hash, db_entry_get_name_raw(entry));
+}
+
+// Compares the names of both entries and their parents, which is the same as comparing their paths
+static bool
+have_same_path(FsearchDatabaseEntry *a, FsearchDatabaseEntry *b) {
+    while (a && b && a != b) {
+        if (strcmp(db_entry_get_name_raw(a), db_entry_get_name_raw(b)) != 0) {
+            return false;
+        }
+        a = (FsearchDatabaseEntry *)db_entry_get_parent(a);
+        b = (FsearchDatabaseEntry *)db_entry_get_parent(b);
+    }
+    return a == b;
+}
+
+typedef struct {
+    uint64_t hash;
+    FsearchDatabaseEntry *entry;
+    // the position of the entry with the same path in the new domain, UINT32_MAX if there's none
+    uint32_t pos;
+} FsearchSelectionJoinSlot;
+
+typedef struct {
+    // open addressing with linear probing, the slots of the selected entries never change during the join
+    FsearchSelectionJoinSlot *slots;
+    uint32_t mask;
+    DynamicArray *entries;
+    // the path hashes of the folders of the new database by their position
+    DynamicArray *folders;
+    uint64_t *folder_hashes;
+} FsearchSelectionJoinContext;
+
+static bool
+is_new_folder(FsearchSelectionJoinContext *ctx, FsearchDatabaseEntry *folder) {
+    const uint32_t idx = db_entry_get_idx(folder);
+    return ctx->folders && idx < darray_get_num_items(ctx->folders) && darray_get_item(ctx->folders, idx) == folder;
+}
+
+static uint64_t
+get_folder_hash(FsearchSelectionJoinContext *ctx, FsearchDatabaseEntry *folder) {
+    if (!is_new_folder(ctx, folder)) {
+        return get_path_hash(folder);
+    }
+    const uint32_t idx = db_entry_get_idx(folder);
+    if (ctx->folder_hashes[idx] != 0) {
+        return ctx->folder_hashes[idx];
+    }
+    FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(folder);
+    ctx->folder_hashes[idx] = path_hash_append(parent ? get_folder_hash(ctx, parent) : SELECTION_PATH_HASH_OFFSET,
+                                               db_entry_get_name_raw(folder));
+    return ctx->folder_hashes[idx];
+}
+
+static void
+join_range(uint32_t start, uint32_t end, void *data) {
+    FsearchSelectionJoinContext *ctx = data;
+    for (uint32_t i = start; i < end; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(ctx->entries, i);
+        if (!entry) {
+            continue;
+        }
+        uint64_t hash = 0;
+        if (db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER) {
+            hash = get_folder_hash(ctx, entry);
+        }
+        else {
+            FsearchDatabaseEntry *parent = (FsearchDatabaseEntry *)db_entry_get_parent(entry);
+            hash = path_hash_append(parent ? get_folder_hash(ctx, parent) : SELECTION_PATH_HASH_OFFSET,
+                                    db_entry_get_name_raw(entry));
+        }
+        for (uint32_t slot = hash & ctx->mask; ctx->slots[slot].entry; slot = (slot + 1) & ctx->mask) {
+            // every selected entry has a single path, so no other thread writes to its slot
+            if (ctx->slots[slot].hash == hash && have_same_path(ctx->slots[slot].entry, entry)) {
+                ctx->slots[slot].pos = i;
+                break;
+            }
+        }
+    }
+}
+
+// Looks up the positions of entries in domain with a single pass over the entries of the domain, which is much
+// faster than a binary search for every one of them (which compares their paths) if there are many
+static void
+join_entries(FsearchSelectionDomain *domain, GPtrArray *entries, DynamicArray *folders, FsearchThreadPool *pool) {
+    const uint32_t num_entries = darray_get_num_items(domain->entries);
+    const uint32_t num_folders = folders ? darray_get_num_items(folders) : 0;
+    if (num_entries == 0) {
+        return;
+    }
+
+    FsearchSelectionJoinContext ctx = {.entries = domain->entries, .folders = folders};
+    ctx.folder_hashes = calloc(MAX(num_folders, 1), sizeof(uint64_t));
+    g_assert(ctx.folder_hashes);
+    for (uint32_t i = 0; i < num_folders; i++) {
+        FsearchDatabaseEntry *folder = darray_get_item(folders, i);
+        if (folder) {
+            get_folder_hash(&ctx, folder);
+        }
+    }
+
+    uint32_t num_slots = 1;
+    while (num_slots < 2 * entries->len) {
+        num_slots <<= 1;
+    }
+    ctx.mask = num_slots - 1;
+    ctx.slots = calloc(num_slots, sizeof(FsearchSelectionJoinSlot));
+    g_assert(ctx.slots);
+    for (uint32_t i = 0; i < entries->len; i++) {
+        FsearchDatabaseEntry *entry = g_ptr_array_index(entries, i);
+        const uint64_t hash = get_path_hash(entry);
+        uint32_t slot = hash & ctx.mask;
+        while (ctx.slots[slot].entry) {
+            slot = (slot + 1) & ctx.mask;
+        }
+        ctx.slots[slot] = (FsearchSelectionJoinSlot){.hash = hash, .entry = entry, .pos = UINT32_MAX};
+    }
+
+    fsearch_thread_pool_parallel_for(pool, 0, num_entries, SELECTION_HASH_JOIN_GRAIN_SIZE, join_range, &ctx);
+
+    for (uint32_t i = 0; i < num_slots; i++) {
+        if (ctx.slots[i].entry && ctx.slots[i].pos != UINT32_MAX) {
+            fsearch_bitset_add(domain->selected, ctx.slots[i].pos);
+        }
+    }
+    g_clear_pointer(&ctx.slots, free);
+    g_clear_pointer(&ctx.folder_hashes, free);
+}
+
+typedef struct {
+    DynamicArray *old_entries;
+    FsearchSelection *new_selection;
+    // the entries which aren't part of the new domains, by domain
+    GPtrArray *missing[NUM_SELECTION_DOMAINS];
+} FsearchSelectionRebaseContext;
+
+static void
+rebase_entry(FsearchSelectionRebaseContext *ctx, FsearchDatabaseEntry *entry) {
+    FsearchSelectionDomain *domain = get_domain(ctx->new_selection, entry);
+    uint32_t pos = 0;
+    if (get_position(domain, entry, &pos)) {
+        fsearch_bitset_add(domain->selected, pos);
+    }
+    else if (domain->entries) {
+        g_ptr_array_add(ctx->missing[domain - ctx->new_selection->domains], entry);
+    }
+}
+
+static void
+rebase_position(uint32_t pos, void *user_data) {
+    FsearchSelectionRebaseContext *ctx = user_data;
+    FsearchDatabaseEntry *entry = darray_get_item(ctx->old_entries, pos);
+    if (entry) {
+        rebase_entry(ctx, entry);
+    }
+}
+
+static void
+rebase_other(gpointer key, gpointer value, gpointer user_data) {
+    rebase_entry(user_data, key);
+}
+
+FsearchSelection *
+fsearch_selection_new_rebased(FsearchSelection *selection,
+                              DynamicArray *folders,
+                              DynamicArray *files,
+                              FsearchThreadPool *pool) {
+    g_assert(selection);
+
+    FsearchSelection *new_selection = fsearch_selection_new();
+    new_selection->domains[SELECTION_DOMAIN_FOLDERS].entries = folders ? darray_ref(folders) : NULL;
+    new_selection->domains[SELECTION_DOMAIN_FILES].entries = files ? darray_ref(files) : NULL;
+
+    // entries which are already part of the new domains only need their positions, all others are looked up
+    // by their paths afterwards
+    FsearchSelectionRebaseContext ctx = {.new_selection = new_selection};
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        ctx.missing[i] = g_ptr_array_new();
+    }
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        FsearchSelectionDomain *domain = &selection->domains[i];
+        if (!domain->entries) {
+            continue;
+        }
+        ctx.old_entries = domain->entries;
+        fsearch_bitset_for_each(domain->selected, rebase_position, &ctx);
+    }
+    g_hash_table_foreach(selection->others, rebase_other, &ctx);
+
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        FsearchSelectionDomain *domain = &new_selection->domains[i];
+        GPtrArray *missing = ctx.missing[i];
+        if (missing->len >= SELECTION_HASH_JOIN_MIN_ENTRIES) {
+            join_entries(domain, missing, folders, pool);
+        }
+        else {
+            for (uint32_t j = 0; j < missing->len; j++) {
+                uint32_t pos = 0;
+                if (find_position(domain, g_ptr_array_index(missing, j), &pos)) {
+                    fsearch_bitset_add(domain->selected, pos);
+                }
+            }
+        }
+        g_clear_pointer(&ctx.missing[i], g_ptr_array_unref);
+    }
+
+    return new_selection;
 }
 
 void
-fsearch_selection_select_toggle(GHashTable *selection, gpointer item) {
+fsearch_selection_select_toggle(FsearchSelection *selection, FsearchDatabaseEntry *entry) {
     g_assert(selection);
-    g_assert(item);
+    g_assert(entry);
 
-    if (g_hash_table_steal(selection, item)) {
+    FsearchSelectionDomain *domain = get_domain(selection, entry);
+    uint32_t pos = 0;
+    if (get_position(domain, entry, &pos)) {
+        fsearch_bitset_toggle(domain->selected, pos);
+        return;
+    }
+    if (g_hash_table_steal(selection->others, entry)) {
         return;
     }
-    g_hash_table_add(selection, item);
+    g_hash_table_add(selection->others, entry);
 }
 
 void
-fsearch_selection_select(GHashTable *selection, gpointer item) {
+fsearch_selection_select(FsearchSelection *selection, FsearchDatabaseEntry *entry) {
     g_assert(selection);
-    g_assert(item);
+    g_assert(entry);
 
-    g_hash_table_add(selection, item);
+    FsearchSelectionDomain *domain = get_domain(selection, entry);
+    uint32_t pos = 0;
+    if (get_position(domain, entry, &pos)) {
+        fsearch_bitset_add(domain->selected, pos);
+        return;
+    }
+    g_hash_table_add(selection->others, entry);
 }
 
 bool
-fsearch_selection_is_selected(GHashTable *selection, gpointer item) {
+fsearch_selection_is_selected(FsearchSelection *selection, FsearchDatabaseEntry *entry) {
     g_assert(selection);
-    g_assert(item);
+    g_assert(entry);
+
+    FsearchSelectionDomain *domain = get_domain(selection, entry);
+    uint32_t pos = 0;
+    if (get_position(domain, entry, &pos)) {
+        return fsearch_bitset_contains(domain->selected, pos);
+    }
+    return g_hash_table_contains(selection->others, entry);
+}
 
-    return g_hash_table_contains(selection, item);
+// Returns the domain if entries is the array of one, so positions can be changed as whole ranges
+static FsearchSelectionDomain *
+get_domain_of_array(FsearchSelection *selection, DynamicArray *entries) {
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        if (selection->domains[i].entries == entries) {
+            return &selection->domains[i];
+        }
+    }
+    return NULL;
 }
 
 void
-fsearch_selection_select_all(GHashTable *selection, DynamicArray *items) {
+fsearch_selection_select_all(FsearchSelection *selection, DynamicArray *entries) {
     g_assert(selection);
-    g_assert(items);
+    g_assert(entries);
 
-    const uint32_t num_items = darray_get_num_items(items);
+    const uint32_t num_entries = darray_get_num_items(entries);
+    FsearchSelectionDomain *domain = get_domain_of_array(selection, entries);
+    if (domain) {
+        fsearch_bitset_add_range(domain->selected, 0, num_entries);
+        return;
+    }
 
-    for (uint32_t i = 0; i < num_items; i++) {
-        void *item = darray_get_item(items, i);
-        if (!item) {
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry) {
             g_debug("[select_all] item is NULL");
+            continue;
         }
-        g_hash_table_add(selection, item);
+        fsearch_selection_select(selection, entry);
     }
 }
 
 void
-fsearch_selection_unselect_all(GHashTable *selection) {
+fsearch_selection_unselect_all(FsearchSelection *selection) {
     g_assert(selection);
-    g_hash_table_remove_all(selection);
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        fsearch_bitset_clear(selection->domains[i].selected);
+    }
+    g_hash_table_remove_all(selection->others);
 }
 
 void
-fsearch_selection_invert(GHashTable *selection, DynamicArray *items) {
+fsearch_selection_invert(FsearchSelection *selection, DynamicArray *entries) {
     g_assert(selection);
-    g_assert(items);
+    g_assert(entries);
 
-    const uint32_t num_items = darray_get_num_items(items);
+    const uint32_t num_entries = darray_get_num_items(entries);
+    FsearchSelectionDomain *domain = get_domain_of_array(selection, entries);
+    if (domain) {
+        fsearch_bitset_toggle_range(domain->selected, 0, num_entries);
+        return;
+    }
 
-    for (uint32_t i = 0; i < num_items; i++) {
-        void *item = darray_get_item(items, i);
-        if (!item) {
-            g_debug("[select_all] item is NULL");
-        }
-        if (g_hash_table_steal(selection, item)) {
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!entry) {
+            g_debug("[invert] item is NULL");
             continue;
         }
-        g_hash_table_add(selection, item);
+        fsearch_selection_select_toggle(selection, entry);
     }
 }
 
 uint32_t
-fsearch_selection_get_num_selected(GHashTable *selection) {
+fsearch_selection_get_num_selected(FsearchSelection *selection) {
     g_assert(selection);
-    return g_hash_table_size(selection);
+    uint32_t num_selected = g_hash_table_size(selection->others);
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        num_selected += fsearch_bitset_get_cardinality(selection->domains[i].selected);
+    }
+    return num_selected;
+}
+
+size_t
+fsearch_selection_get_memory_usage(FsearchSelection *selection) {
+    g_assert(selection);
+    // roughly what GHashTable needs per key: the key itself, its hash and the slot of its value
+    size_t size = sizeof(FsearchSelection);
+    size += g_hash_table_size(selection->others) * (sizeof(void *) * 2 + sizeof(guint));
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        size += fsearch_bitset_get_memory_usage(selection->domains[i].selected);
+    }
+    return size;
+}
+
+typedef struct {
+    DynamicArray *entries;
+    GHFunc func;
+    gpointer user_data;
+} FsearchSelectionForEachContext;
+
+static void
+for_each_position(uint32_t pos, void *user_data) {
+    FsearchSelectionForEachContext *ctx = user_data;
+    FsearchDatabaseEntry *entry = darray_get_item(ctx->entries, pos);
+    if (entry) {
+        ctx->func(entry, entry, ctx->user_data);
+    }
 }
+
 void
-fsearch_selection_for_each(GHashTable *selection, GHFunc func, gpointer user_data) {
+fsearch_selection_for_each(FsearchSelection *selection, GHFunc func, gpointer user_data) {
     g_assert(selection);
-    g_hash_table_foreach(selection, func, user_data);
+    for (uint32_t i = 0; i < NUM_SELECTION_DOMAINS; i++) {
+        FsearchSelectionDomain *domain = &selection->domains[i];
+        if (!domain->entries) {
+            continue;
+        }
+        FsearchSelectionForEachContext ctx = {.entries = domain->entries, .func = func, .user_data = user_data};
+        fsearch_bitset_for_each(domain->selected, for_each_position, &ctx);
+    }
+    g_hash_table_foreach(selection->others, func, user_data);
 }
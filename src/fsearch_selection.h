@@ -1,37 +1,60 @@
 #pragma once
 
 #include "fsearch_array.h"
+#include "fsearch_database_entry.h"
+#include "fsearch_thread_pool.h"
 
 #include <glib.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+// The selected entries of a view. Entries of the database are stored as their positions in the name
+// sorted entry arrays of the database (their idx) in compressed bitsets, so selecting millions of them
+// costs about a bit each. Entries which can't be found in those arrays are kept in a hash table.
+typedef struct FsearchSelection FsearchSelection;
+
 void
-fsearch_selection_free(GHashTable *selection);
+fsearch_selection_free(FsearchSelection *selection);
 
-GHashTable *
+FsearchSelection *
 fsearch_selection_new(void);
 
+// Returns a copy of selection whose positions refer to folders and files (the name sorted arrays of a database).
+// Every selected entry gets looked up there (by its path if it's not part of them, e.g. because they belong to a
+// new database) and stays selected if it's found, all others are dropped. This must be done whenever the
+// positions of the entries change. Many entries of another database are looked up together on the threads of pool,
+// which may be NULL. The caller must hold the locks of the databases both selections belong to.
+FsearchSelection *
+fsearch_selection_new_rebased(FsearchSelection *selection,
+                              DynamicArray *folders,
+                              DynamicArray *files,
+                              FsearchThreadPool *pool);
+
 void
-fsearch_selection_select_toggle(GHashTable *selection, gpointer item);
+fsearch_selection_select_toggle(FsearchSelection *selection, FsearchDatabaseEntry *entry);
 
 void
-fsearch_selection_select(GHashTable *selection, gpointer item);
+fsearch_selection_select(FsearchSelection *selection, FsearchDatabaseEntry *entry);
 
 bool
-fsearch_selection_is_selected(GHashTable *selection, gpointer item);
+fsearch_selection_is_selected(FsearchSelection *selection, FsearchDatabaseEntry *entry);
 
 void
-fsearch_selection_select_all(GHashTable *selection, DynamicArray *items);
+fsearch_selection_select_all(FsearchSelection *selection, DynamicArray *entries);
 
 void
-fsearch_selection_unselect_all(GHashTable *selection);
+fsearch_selection_unselect_all(FsearchSelection *selection);
 
 void
-fsearch_selection_invert(GHashTable *selection, DynamicArray *items);
+fsearch_selection_invert(FsearchSelection *selection, DynamicArray *entries);
 
 uint32_t
-fsearch_selection_get_num_selected(GHashTable *selection);
+fsearch_selection_get_num_selected(FsearchSelection *selection);
+
+// Returns about the number of bytes allocated for the selected entries
+size_t
+fsearch_selection_get_memory_usage(FsearchSelection *selection);
 
+// Calls func with every selected entry as key and value
 void
-fsearch_selection_for_each(GHashTable *selection, GHFunc func, gpointer user_data);
+fsearch_selection_for_each(FsearchSelection *selection, GHFunc func, gpointer user_data);
@@ -0,0 +1,248 @@
+#define G_LOG_DOMAIN "fsearch-selection-export"
+
+#include "fsearch_selection_export.h"
+#include "fsearch_trace.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the output is written whenever this much is buffered
+#define EXPORT_CHUNK_SIZE (64 * 1024)
+// in µs
+#define EXPORT_PROGRESS_INTERVAL (200 * 1000)
+
+struct FsearchSelectionExport {
+    FsearchDatabase *db;
+    DynamicArray *entries;
+    FsearchFolderPaths *folder_paths;
+    FsearchSelectionExportFormat format;
+};
+
+typedef struct {
+    FsearchSelectionExport *export;
+    GOutputStream *stream;
+    FsearchSelectionExportProgressFunc progress_func;
+    gpointer progress_data;
+} ExportTaskData;
+
+typedef struct {
+    GTask *task;
+    uint32_t num_exported;
+} ExportProgress;
+
+typedef struct {
+    GTask *task;
+    int64_t last_progress_time;
+} ExportChunkContext;
+
+typedef void (*ExportChunkFunc)(uint32_t num_exported, gpointer user_data);
+
+FsearchSelectionExport *
+fsearch_selection_export_new(FsearchDatabase *db,
+                             DynamicArray *entries,
+                             FsearchFolderPaths *folder_paths,
+                             FsearchSelectionExportFormat format) {
+    g_assert(entries);
+    g_assert(format >= 0 && format < NUM_FSEARCH_SELECTION_EXPORT_FORMATS);
+
+    FsearchSelectionExport *export = calloc(1, sizeof(FsearchSelectionExport));
+    g_assert(export);
+    export->db = db ? db_ref(db) : NULL;
+    export->entries = darray_ref(entries);
+    export->folder_paths = folder_paths ? fsearch_folder_paths_ref(folder_paths) : NULL;
+    export->format = format;
+    return export;
+}
+
+void
+fsearch_selection_export_free(FsearchSelectionExport *export) {
+    if (!export) {
+        return;
+    }
+    g_clear_pointer(&export->entries, darray_unref);
+    g_clear_pointer(&export->folder_paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&export->db, db_unref);
+    g_clear_pointer(&export, free);
+}
+
+uint32_t
+fsearch_selection_export_get_num_entries(FsearchSelectionExport *export) {
+    g_assert(export);
+    return darray_get_num_items(export->entries);
+}
+
+static void
+append_line(FsearchSelectionExport *export, FsearchDatabaseEntry *entry, GString *buffer, GString *path) {
+    switch (export->format) {
+    case FSEARCH_SELECTION_EXPORT_FULL_PATH:
+        fsearch_folder_paths_append_full_path(export->folder_paths, entry, buffer);
+        break;
+    case FSEARCH_SELECTION_EXPORT_PATH:
+        fsearch_folder_paths_append_path(export->folder_paths, entry, buffer);
+        break;
+    case FSEARCH_SELECTION_EXPORT_NAME:
+        g_string_append(buffer, db_entry_get_name_raw_for_display(entry));
+        break;
+    case FSEARCH_SELECTION_EXPORT_URI: {
+        g_string_truncate(path, 0);
+        fsearch_folder_paths_append_full_path(export->folder_paths, entry, path);
+        g_autofree char *uri = g_filename_to_uri(path->str, NULL, NULL);
+        if (!uri) {
+            g_debug("[export] failed to convert %s to a URI", path->str);
+            return;
+        }
+        g_string_append(buffer, uri);
+        break;
+    }
+    default:
+        g_assert_not_reached();
+    }
+    g_string_append_c(buffer, '\n');
+}
+
+static bool
+export_write(FsearchSelectionExport *export,
+             GOutputStream *stream,
+             GCancellable *cancellable,
+             ExportChunkFunc chunk_func,
+             gpointer chunk_data,
+             GError **error) {
+    g_assert(export);
+    g_assert(G_IS_OUTPUT_STREAM(stream));
+
+    const int64_t trace_start = fsearch_trace_begin();
+    // a bit more than a chunk, so the last line doesn't make it grow
+    g_autoptr(GString) buffer = g_string_sized_new(EXPORT_CHUNK_SIZE + PATH_MAX);
+    g_autoptr(GString) path = g_string_sized_new(PATH_MAX);
+    bool res = true;
+
+    const uint32_t num_entries = darray_get_num_items(export->entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        append_line(export, darray_get_item(export->entries, i), buffer, path);
+        if (buffer->len < EXPORT_CHUNK_SIZE && i + 1 < num_entries) {
+            continue;
+        }
+        // not every stream checks the cancellable itself
+        if (g_cancellable_set_error_if_cancelled(cancellable, error)
+            || !g_output_stream_write_all(stream, buffer->str, buffer->len, NULL, cancellable, error)) {
+            res = false;
+            break;
+        }
+        g_string_truncate(buffer, 0);
+        if (chunk_func) {
+            chunk_func(i + 1, chunk_data);
+        }
+    }
+    fsearch_trace_end(trace_start, "export", "write");
+    return res;
+}
+
+bool
+fsearch_selection_export_write(FsearchSelectionExport *export,
+                               GOutputStream *stream,
+                               GCancellable *cancellable,
+                               GError **error) {
+    return export_write(export, stream, cancellable, NULL, NULL, error);
+}
+
+static void
+export_task_data_free(ExportTaskData *data) {
+    if (!data) {
+        return;
+    }
+    g_clear_pointer(&data->export, fsearch_selection_export_free);
+    g_clear_object(&data->stream);
+    g_clear_pointer(&data, free);
+}
+
+static void
+export_progress_free(ExportProgress *progress) {
+    if (!progress) {
+        return;
+    }
+    g_clear_object(&progress->task);
+    g_clear_pointer(&progress, free);
+}
+
+static gboolean
+export_progress_cb(gpointer user_data) {
+    ExportProgress *progress = user_data;
+    // the caller might be gone once it got the result
+    if (!g_task_get_completed(progress->task)) {
+        ExportTaskData *data = g_task_get_task_data(progress->task);
+        data->progress_func(progress->num_exported,
+                            fsearch_selection_export_get_num_entries(data->export),
+                            data->progress_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+export_chunk_written(uint32_t num_exported, gpointer user_data) {
+    ExportChunkContext *ctx = user_data;
+    const int64_t now = g_get_monotonic_time();
+    if (now - ctx->last_progress_time < EXPORT_PROGRESS_INTERVAL) {
+        return;
+    }
+    ctx->last_progress_time = now;
+
+    ExportProgress *progress = calloc(1, sizeof(ExportProgress));
+    g_assert(progress);
+    progress->task = g_object_ref(ctx->task);
+    progress->num_exported = num_exported;
+    g_main_context_invoke_full(g_task_get_context(ctx->task),
+                               G_PRIORITY_DEFAULT,
+                               export_progress_cb,
+                               progress,
+                               (GDestroyNotify)export_progress_free);
+}
+
+static void
+export_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    ExportTaskData *data = task_data;
+    // the first progress is reported after one interval, small exports don't need any
+    ExportChunkContext ctx = {.task = task, .last_progress_time = g_get_monotonic_time()};
+
+    GError *error = NULL;
+    if (export_write(data->export,
+                     data->stream,
+                     cancellable,
+                     data->progress_func ? export_chunk_written : NULL,
+                     &ctx,
+                     &error)) {
+        g_task_return_boolean(task, TRUE);
+    }
+    else {
+        g_task_return_error(task, error);
+    }
+}
+
+void
+fsearch_selection_export_write_async(FsearchSelectionExport *export,
+                                     GOutputStream *stream,
+                                     GCancellable *cancellable,
+                                     FsearchSelectionExportProgressFunc progress_func,
+                                     gpointer progress_data,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data) {
+    g_assert(export);
+    g_assert(G_IS_OUTPUT_STREAM(stream));
+
+    ExportTaskData *data = calloc(1, sizeof(ExportTaskData));
+    g_assert(data);
+    data->export = export;
+    data->stream = g_object_ref(stream);
+    data->progress_func = progress_func;
+    data->progress_data = progress_data;
+
+    g_autoptr(GTask) task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, data, (GDestroyNotify)export_task_data_free);
+    g_task_run_in_thread(task, export_thread);
+}
+
+bool
+fsearch_selection_export_write_finish(GAsyncResult *result, GError **error) {
+    g_return_val_if_fail(g_task_is_valid(result, NULL), false);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
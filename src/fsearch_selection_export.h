@@ -0,0 +1,65 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database.h"
+#include "fsearch_folder_paths.h"
+
+// Writes one line per selected entry to an output stream, e.g. for the clipboard or a file. Only a small chunk of
+// the output is buffered at a time, so large selections don't need all their paths in memory at once.
+
+typedef enum {
+    FSEARCH_SELECTION_EXPORT_FULL_PATH,
+    // the path of the parent folder
+    FSEARCH_SELECTION_EXPORT_PATH,
+    FSEARCH_SELECTION_EXPORT_NAME,
+    // the file:// URI of the full path
+    FSEARCH_SELECTION_EXPORT_URI,
+    NUM_FSEARCH_SELECTION_EXPORT_FORMATS,
+} FsearchSelectionExportFormat;
+
+typedef struct FsearchSelectionExport FsearchSelectionExport;
+
+// Called in the thread-default main context of the caller of fsearch_selection_export_write_async, at most every
+// few hundred ms
+typedef void (*FsearchSelectionExportProgressFunc)(uint32_t num_exported, uint32_t num_entries, gpointer user_data);
+
+// The entries belong to db, which stays referenced so they remain valid while they're exported. db may be NULL if the
+// caller keeps them alive otherwise. folder_paths, which may be NULL, is used to build the paths without walking
+// up the parents of every entry.
+FsearchSelectionExport *
+fsearch_selection_export_new(FsearchDatabase *db,
+                             DynamicArray *entries,
+                             FsearchFolderPaths *folder_paths,
+                             FsearchSelectionExportFormat format);
+
+void
+fsearch_selection_export_free(FsearchSelectionExport *export);
+
+uint32_t
+fsearch_selection_export_get_num_entries(FsearchSelectionExport *export);
+
+// Every line is terminated by a newline
+bool
+fsearch_selection_export_write(FsearchSelectionExport *export,
+                               GOutputStream *stream,
+                               GCancellable *cancellable,
+                               GError **error);
+
+// Like fsearch_selection_export_write, but on a worker thread. Takes ownership of export. progress_func may be
+// NULL, it isn't called anymore once callback ran.
+void
+fsearch_selection_export_write_async(FsearchSelectionExport *export,
+                                     GOutputStream *stream,
+                                     GCancellable *cancellable,
+                                     FsearchSelectionExportProgressFunc progress_func,
+                                     gpointer progress_data,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data);
+
+bool
+fsearch_selection_export_write_finish(GAsyncResult *result, GError **error);
@@ -0,0 +1,207 @@
+#define G_LOG_DOMAIN "fsearch-shared-results"
+
+#include "fsearch_shared_results.h"
+
+#include <stdlib.h>
+
+// how often waiting callers check whether they got cancelled
+#define SHARED_RESULTS_WAIT_INTERVAL (50 * G_TIME_SPAN_MILLISECOND)
+
+typedef enum {
+    SHARED_RESULT_STATE_PENDING,
+    SHARED_RESULT_STATE_PUBLISHED,
+    SHARED_RESULT_STATE_ABANDONED,
+} FsearchSharedResultState;
+
+struct FsearchSharedResult {
+    FsearchSharedResults *results;
+    char *key;
+    FsearchSharedResultState state;
+    DynamicArray *folders;
+    DynamicArray *files;
+    FsearchDatabaseIndexType sort_order;
+
+    // guarded by the mutex of results, so it can't be found and referenced while it gets freed
+    int ref_count;
+};
+
+struct FsearchSharedResults {
+    // maps keys to the results which are pending or published
+    GHashTable *results;
+    GMutex mutex;
+    // signalled whenever a result gets published or abandoned
+    GCond cond;
+
+    volatile int ref_count;
+};
+
+FsearchSharedResults *
+fsearch_shared_results_new(void) {
+    FsearchSharedResults *results = calloc(1, sizeof(FsearchSharedResults));
+    g_assert(results);
+    results->results = g_hash_table_new(g_str_hash, g_str_equal);
+    g_mutex_init(&results->mutex);
+    g_cond_init(&results->cond);
+    results->ref_count = 1;
+    return results;
+}
+
+static void
+fsearch_shared_results_free(FsearchSharedResults *results) {
+    // every result holds a reference, so there are none left
+    g_clear_pointer(&results->results, g_hash_table_unref);
+    g_mutex_clear(&results->mutex);
+    g_cond_clear(&results->cond);
+    g_clear_pointer(&results, free);
+}
+
+FsearchSharedResults *
+fsearch_shared_results_ref(FsearchSharedResults *results) {
+    if (!results || g_atomic_int_get(&results->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&results->ref_count);
+    return results;
+}
+
+void
+fsearch_shared_results_unref(FsearchSharedResults *results) {
+    if (!results || g_atomic_int_get(&results->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&results->ref_count)) {
+        g_clear_pointer(&results, fsearch_shared_results_free);
+    }
+}
+
+// Must be called with the mutex of result->results held
+static void
+shared_result_remove(FsearchSharedResult *result) {
+    if (g_hash_table_lookup(result->results->results, result->key) == result) {
+        g_hash_table_remove(result->results->results, result->key);
+    }
+}
+
+FsearchSharedResult *
+fsearch_shared_results_attach(FsearchSharedResults *results, const char *key, bool *compute) {
+    g_assert(results);
+    g_assert(key);
+    g_assert(compute);
+
+    g_mutex_lock(&results->mutex);
+    FsearchSharedResult *result = g_hash_table_lookup(results->results, key);
+    if (result) {
+        result->ref_count++;
+        *compute = false;
+    }
+    else {
+        result = calloc(1, sizeof(FsearchSharedResult));
+        g_assert(result);
+        result->results = fsearch_shared_results_ref(results);
+        result->key = g_strdup(key);
+        result->state = SHARED_RESULT_STATE_PENDING;
+        result->ref_count = 1;
+        g_hash_table_insert(results->results, result->key, result);
+        *compute = true;
+    }
+    g_mutex_unlock(&results->mutex);
+    return result;
+}
+
+FsearchSharedResult *
+fsearch_shared_result_ref(FsearchSharedResult *result) {
+    if (!result) {
+        return NULL;
+    }
+    g_mutex_lock(&result->results->mutex);
+    result->ref_count++;
+    g_mutex_unlock(&result->results->mutex);
+    return result;
+}
+
+void
+fsearch_shared_result_unref(FsearchSharedResult *result) {
+    if (!result) {
+        return;
+    }
+    FsearchSharedResults *results = result->results;
+    g_mutex_lock(&results->mutex);
+    const bool last_ref = --result->ref_count == 0;
+    if (last_ref) {
+        shared_result_remove(result);
+    }
+    g_mutex_unlock(&results->mutex);
+    if (!last_ref) {
+        return;
+    }
+    g_clear_pointer(&result->folders, darray_unref);
+    g_clear_pointer(&result->files, darray_unref);
+    g_clear_pointer(&result->key, g_free);
+    g_clear_pointer(&result->results, fsearch_shared_results_unref);
+    g_clear_pointer(&result, free);
+}
+
+const char *
+fsearch_shared_result_get_key(FsearchSharedResult *result) {
+    g_assert(result);
+    return result->key;
+}
+
+void
+fsearch_shared_result_publish(FsearchSharedResult *result,
+                              DynamicArray *folders,
+                              DynamicArray *files,
+                              FsearchDatabaseIndexType sort_order) {
+    g_assert(result);
+    FsearchSharedResults *results = result->results;
+    g_mutex_lock(&results->mutex);
+    if (result->state == SHARED_RESULT_STATE_PENDING) {
+        result->folders = folders ? darray_ref(folders) : NULL;
+        result->files = files ? darray_ref(files) : NULL;
+        result->sort_order = sort_order;
+        result->state = SHARED_RESULT_STATE_PUBLISHED;
+        g_cond_broadcast(&results->cond);
+    }
+    g_mutex_unlock(&results->mutex);
+}
+
+void
+fsearch_shared_result_abandon(FsearchSharedResult *result) {
+    g_assert(result);
+    FsearchSharedResults *results = result->results;
+    g_mutex_lock(&results->mutex);
+    if (result->state == SHARED_RESULT_STATE_PENDING) {
+        result->state = SHARED_RESULT_STATE_ABANDONED;
+        shared_result_remove(result);
+        g_cond_broadcast(&results->cond);
+    }
+    g_mutex_unlock(&results->mutex);
+}
+
+bool
+fsearch_shared_result_wait(FsearchSharedResult *result,
+                           GCancellable *cancellable,
+                           DynamicArray **folders,
+                           DynamicArray **files,
+                           FsearchDatabaseIndexType *sort_order) {
+    g_assert(result);
+    FsearchSharedResults *results = result->results;
+    g_mutex_lock(&results->mutex);
+    while (result->state == SHARED_RESULT_STATE_PENDING && !g_cancellable_is_cancelled(cancellable)) {
+        g_cond_wait_until(&results->cond, &results->mutex, g_get_monotonic_time() + SHARED_RESULTS_WAIT_INTERVAL);
+    }
+    const bool published = result->state == SHARED_RESULT_STATE_PUBLISHED;
+    if (published) {
+        if (folders) {
+            *folders = result->folders ? darray_ref(result->folders) : NULL;
+        }
+        if (files) {
+            *files = result->files ? darray_ref(result->files) : NULL;
+        }
+        if (sort_order) {
+            *sort_order = result->sort_order;
+        }
+    }
+    g_mutex_unlock(&results->mutex);
+    return published;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <stdbool.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_index.h"
+
+// Results which are shared by all views of a database that search for the same thing. The first view which asks
+// for a key computes its results, the others wait for them and get references to the same arrays. A result stays
+// in the store as long as a reference to it is held, e.g. by the views which show it. The results must not be
+// modified anymore once they're published.
+typedef struct FsearchSharedResults FsearchSharedResults;
+
+typedef struct FsearchSharedResult FsearchSharedResult;
+
+FsearchSharedResults *
+fsearch_shared_results_new(void);
+
+FsearchSharedResults *
+fsearch_shared_results_ref(FsearchSharedResults *results);
+
+void
+fsearch_shared_results_unref(FsearchSharedResults *results);
+
+// Returns a new reference to the result of key. If nobody computes it yet compute is set to true, then the caller
+// must either publish or abandon the result.
+FsearchSharedResult *
+fsearch_shared_results_attach(FsearchSharedResults *results, const char *key, bool *compute);
+
+FsearchSharedResult *
+fsearch_shared_result_ref(FsearchSharedResult *result);
+
+void
+fsearch_shared_result_unref(FsearchSharedResult *result);
+
+const char *
+fsearch_shared_result_get_key(FsearchSharedResult *result);
+
+void
+fsearch_shared_result_publish(FsearchSharedResult *result,
+                              DynamicArray *folders,
+                              DynamicArray *files,
+                              FsearchDatabaseIndexType sort_order);
+
+// Drops the result from the store, e.g. because its computation was cancelled. Waiting callers give up and the next
+// one to attach computes it again.
+void
+fsearch_shared_result_abandon(FsearchSharedResult *result);
+
+// Waits until the result gets published and returns new references to its arrays. Returns false if it was abandoned
+// or cancellable got cancelled meanwhile.
+bool
+fsearch_shared_result_wait(FsearchSharedResult *result,
+                           GCancellable *cancellable,
+                           DynamicArray **folders,
+                           DynamicArray **files,
+                           FsearchDatabaseIndexType *sort_order);
@@ -15,6 +15,9 @@ struct _FsearchStatusbar {
     GtkWidget *statusbar_database_updating_label;
     GtkWidget *statusbar_database_updating_spinner;
     GtkWidget *statusbar_match_case_revealer;
+    GtkWidget *statusbar_operation_stats_button;
+    GtkWidget *statusbar_operation_stats_label;
+    GtkWidget *statusbar_operation_stats_summary_label;
     GtkWidget *statusbar_scan_label;
     GtkWidget *statusbar_scan_status_label;
     GtkWidget *statusbar_search_stack;
@@ -57,6 +60,22 @@ fsearch_statusbar_set_num_search_results(FsearchStatusbar *sb, uint32_t num_resu
     gtk_label_set_text(GTK_LABEL(sb->statusbar_search_label), sb_text);
 }
 
+void
+fsearch_statusbar_set_operation_stats(FsearchStatusbar *sb, const FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS]) {
+    // the summary is about the search or the sort, whichever finished last
+    const bool sorted_last = stats[FSEARCH_OPERATION_SORT].finish_time > stats[FSEARCH_OPERATION_SEARCH].finish_time;
+    const FsearchOperation operation = sorted_last ? FSEARCH_OPERATION_SORT : FSEARCH_OPERATION_SEARCH;
+    if (!stats[operation].finish_time) {
+        gtk_widget_hide(sb->statusbar_operation_stats_button);
+        return;
+    }
+    g_autofree char *summary = fsearch_operation_stats_get_summary(&stats[operation], operation);
+    g_autofree char *details = fsearch_operation_stats_get_details(stats);
+    gtk_label_set_text(GTK_LABEL(sb->statusbar_operation_stats_summary_label), summary);
+    gtk_label_set_text(GTK_LABEL(sb->statusbar_operation_stats_label), details);
+    gtk_widget_show(sb->statusbar_operation_stats_button);
+}
+
 static void
 set_task_status(FsearchStatusbar *sb, const char *label) {
     gtk_label_set_text(GTK_LABEL(sb->statusbar_search_task_label), label);
@@ -91,6 +110,12 @@ fsearch_statusbar_set_query_status_delayed(FsearchStatusbar *sb) {
     sb->statusbar_timeout_id = g_timeout_add(200, on_statusbar_set_query_status, sb);
 }
 
+void
+fsearch_statusbar_set_task_progress(FsearchStatusbar *sb, const char *text) {
+    statusbar_remove_status_update_timeout(sb);
+    set_task_status(sb, text);
+}
+
 void
 fsearch_statusbar_set_revealer_visibility(FsearchStatusbar *sb, FsearchStatusbarRevealer revealer, gboolean visible) {
     GtkRevealer *r = NULL;
@@ -314,6 +339,9 @@ fsearch_statusbar_class_init(FsearchStatusbarClass *klass) {
     gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_database_updating_label);
     gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_database_updating_spinner);
     gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_match_case_revealer);
+    gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_operation_stats_button);
+    gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_operation_stats_label);
+    gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_operation_stats_summary_label);
     gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_scan_label);
     gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_scan_status_label);
     gtk_widget_class_bind_template_child(widget_class, FsearchStatusbar, statusbar_search_filter_label);
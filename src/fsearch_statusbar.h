@@ -4,6 +4,8 @@
 #include <gtk/gtk.h>
 #include <stdint.h>
 
+#include "fsearch_operation_stats.h"
+
 G_BEGIN_DECLS
 
 #define FSEARCH_STATUSBAR_TYPE (fsearch_statusbar_get_type())
@@ -37,9 +39,17 @@ fsearch_statusbar_set_query_text(FsearchStatusbar *sb, const char *text);
 void
 fsearch_statusbar_set_num_search_results(FsearchStatusbar *sb, uint32_t num_results);
 
+// Shows how long the latest search or sort took, the popover of the readout lists all stats
+void
+fsearch_statusbar_set_operation_stats(FsearchStatusbar *sb, const FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS]);
+
 void
 fsearch_statusbar_set_query_status_delayed(FsearchStatusbar *sb);
 
+// Shows the progress of a background task, e.g. an export, until the next fsearch_statusbar_set_num_search_results
+void
+fsearch_statusbar_set_task_progress(FsearchStatusbar *sb, const char *text);
+
 void
 fsearch_statusbar_set_sort_status_delayed(FsearchStatusbar *sb);
 
@@ -0,0 +1,157 @@
+#include "fsearch_string_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STRING_POOL_BLOCK_SIZE (256 * 1024)
+// Strings which are longer than this get a block of their own
+#define STRING_POOL_MAX_SHARED_LEN (STRING_POOL_BLOCK_SIZE / 16)
+// Only short strings are interned, long file names are hardly ever repeated and
+// would only grow the intern table
+#define STRING_POOL_MAX_INTERN_LEN 32
+
+typedef struct {
+    size_t num_used;
+    size_t capacity;
+    char data[];
+} FsearchStringPoolBlock;
+
+struct FsearchStringPool {
+    // the first block is the one new strings get added to
+    GList *blocks;
+    GHashTable *intern_table;
+
+    volatile int ref_count;
+};
+
+static FsearchStringPoolBlock *
+fsearch_string_pool_block_new(size_t capacity) {
+    FsearchStringPoolBlock *block = malloc(sizeof(FsearchStringPoolBlock) + capacity);
+    g_assert(block);
+    block->num_used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+FsearchStringPool *
+fsearch_string_pool_new(bool intern) {
+    FsearchStringPool *pool = calloc(1, sizeof(FsearchStringPool));
+    g_assert(pool);
+    pool->blocks = g_list_prepend(NULL, fsearch_string_pool_block_new(STRING_POOL_BLOCK_SIZE));
+    if (intern) {
+        pool->intern_table = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    pool->ref_count = 1;
+    return pool;
+}
+
+static void
+fsearch_string_pool_free(FsearchStringPool *pool) {
+    if (!pool) {
+        return;
+    }
+    g_clear_pointer(&pool->intern_table, g_hash_table_unref);
+    g_list_free_full(g_steal_pointer(&pool->blocks), free);
+    g_clear_pointer(&pool, free);
+}
+
+FsearchStringPool *
+fsearch_string_pool_ref(FsearchStringPool *pool) {
+    if (!pool || g_atomic_int_get(&pool->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&pool->ref_count);
+    return pool;
+}
+
+void
+fsearch_string_pool_unref(FsearchStringPool *pool) {
+    if (!pool || g_atomic_int_get(&pool->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&pool->ref_count)) {
+        g_clear_pointer(&pool, fsearch_string_pool_free);
+    }
+}
+
+static char *
+fsearch_string_pool_copy(FsearchStringPool *pool, const char *str, size_t len) {
+    FsearchStringPoolBlock *block = NULL;
+    if (len + 1 > STRING_POOL_MAX_SHARED_LEN) {
+        // Put it behind the current block, so the remaining space of that can still be used
+        block = fsearch_string_pool_block_new(len + 1);
+        pool->blocks = g_list_insert(pool->blocks, block, 1);
+    }
+    else {
+        block = pool->blocks->data;
+        if (block->capacity - block->num_used < len + 1) {
+            block = fsearch_string_pool_block_new(STRING_POOL_BLOCK_SIZE);
+            pool->blocks = g_list_prepend(pool->blocks, block);
+        }
+    }
+
+    char *dest = block->data + block->num_used;
+    memcpy(dest, str, len);
+    dest[len] = '\0';
+    block->num_used += len + 1;
+    return dest;
+}
+
+const char *
+fsearch_string_pool_add(FsearchStringPool *pool, const char *str, size_t len) {
+    g_assert(pool);
+    g_assert(str);
+
+    const bool intern = pool->intern_table && len <= STRING_POOL_MAX_INTERN_LEN;
+    if (intern) {
+        char key[STRING_POOL_MAX_INTERN_LEN + 1];
+        memcpy(key, str, len);
+        key[len] = '\0';
+        const char *existing = g_hash_table_lookup(pool->intern_table, key);
+        if (existing) {
+            return existing;
+        }
+    }
+
+    char *copy = fsearch_string_pool_copy(pool, str, len);
+    if (intern) {
+        g_hash_table_add(pool->intern_table, copy);
+    }
+    return copy;
+}
+
+void
+fsearch_string_pool_stop_interning(FsearchStringPool *pool) {
+    g_assert(pool);
+    g_clear_pointer(&pool->intern_table, g_hash_table_unref);
+}
+
+void
+fsearch_string_pool_merge(FsearchStringPool *pool, FsearchStringPool *other) {
+    if (!pool || !other) {
+        return;
+    }
+    g_assert(g_atomic_int_get(&other->ref_count) == 1);
+
+    // keep the first block of pool in front, new strings are still added to it
+    pool->blocks = g_list_concat(pool->blocks, g_steal_pointer(&other->blocks));
+    g_clear_pointer(&other->intern_table, g_hash_table_unref);
+    g_clear_pointer(&other, free);
+}
+
+size_t
+fsearch_string_pool_get_memory_usage(FsearchStringPool *pool) {
+    if (!pool) {
+        return 0;
+    }
+    size_t size = sizeof(FsearchStringPool);
+    for (GList *b = pool->blocks; b != NULL; b = b->next) {
+        FsearchStringPoolBlock *block = b->data;
+        size += sizeof(FsearchStringPoolBlock) + block->capacity;
+    }
+    if (pool->intern_table) {
+        // roughly what GHashTable needs per key: the key itself, its hash and the slot of its value
+        size += g_hash_table_size(pool->intern_table) * (sizeof(void *) * 2 + sizeof(guint));
+    }
+    return size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Stores strings in large blocks which are released at once when the pool is freed.
+// With interning enabled, adding a string which is already part of the pool returns the
+// existing copy. The pool isn't thread safe.
+typedef struct FsearchStringPool FsearchStringPool;
+
+FsearchStringPool *
+fsearch_string_pool_new(bool intern);
+
+FsearchStringPool *
+fsearch_string_pool_ref(FsearchStringPool *pool);
+
+void
+fsearch_string_pool_unref(FsearchStringPool *pool);
+
+// Returns a copy of the first len bytes of str, which stays valid as long as the pool does.
+const char *
+fsearch_string_pool_add(FsearchStringPool *pool, const char *str, size_t len);
+
+// Releases the intern table. Strings which get added afterwards are always copied.
+void
+fsearch_string_pool_stop_interning(FsearchStringPool *pool);
+
+// Moves all strings of other into pool and frees other.
+void
+fsearch_string_pool_merge(FsearchStringPool *pool, FsearchStringPool *other);
+
+// Returns the number of bytes allocated for the blocks of pool and its intern table
+size_t
+fsearch_string_pool_get_memory_usage(FsearchStringPool *pool);
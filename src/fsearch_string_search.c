@@ -0,0 +1,195 @@
+#define G_LOG_DOMAIN "fsearch-string-search"
+
+#include "fsearch_string_search.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FSEARCH_STRING_SEARCH_SSE2
+#define FSEARCH_STRING_SEARCH_AVX2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FSEARCH_STRING_SEARCH_NEON
+#endif
+
+typedef const char *(FsearchStringSearchFunc)(const char *, size_t, const char *, size_t);
+
+// Candidate positions are found by comparing the first and the last byte of the needle with
+// the haystack, a whole vector of positions at once. Only the few positions where both match
+// are compared byte by byte.
+//
+// Case folding: for ASCII letters exactly the lower and upper case form only differ in the bit
+// 0x20, so OR'ing a haystack byte with 0x20 folds it to lower case. For all other needle bytes
+// the mask is 0, which makes it a plain comparison. Bytes outside of the ASCII range never match
+// an (ASCII) needle byte either way.
+
+static inline char
+ascii_tolower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c | 0x20) : c;
+}
+
+static inline uint8_t
+ascii_fold_mask(char c) {
+    const char lower = ascii_tolower(c);
+    return (lower >= 'a' && lower <= 'z') ? 0x20 : 0;
+}
+
+static inline bool
+ascii_icase_equal(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (ascii_tolower(a[i]) != ascii_tolower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char *
+search_ascii_icase_scalar(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const char first = ascii_tolower(needle[0]);
+    const char last = ascii_tolower(needle[needle_len - 1]);
+    const size_t end = haystack_len - needle_len;
+    for (size_t i = 0; i <= end; i++) {
+        if (ascii_tolower(haystack[i]) == first && ascii_tolower(haystack[i + needle_len - 1]) == last
+            && ascii_icase_equal(haystack + i + 1, needle + 1, needle_len - 1)) {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+#ifdef FSEARCH_STRING_SEARCH_SSE2
+static const char *
+search_ascii_icase_sse2(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const __m128i first = _mm_set1_epi8(ascii_tolower(needle[0]));
+    const __m128i first_mask = _mm_set1_epi8((char)ascii_fold_mask(needle[0]));
+    const __m128i last = _mm_set1_epi8(ascii_tolower(needle[needle_len - 1]));
+    const __m128i last_mask = _mm_set1_epi8((char)ascii_fold_mask(needle[needle_len - 1]));
+
+    size_t i = 0;
+    // both loads must stay within the haystack
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+        const __m128i block_first = _mm_or_si128(_mm_loadu_si128((const __m128i *)(haystack + i)), first_mask);
+        const __m128i block_last =
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)(haystack + i + needle_len - 1)), last_mask);
+        uint32_t candidates = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        while (candidates) {
+            const uint32_t offset = __builtin_ctz(candidates);
+            if (ascii_icase_equal(haystack + i + offset + 1, needle + 1, needle_len - 2)) {
+                return haystack + i + offset;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    if (i + needle_len > haystack_len) {
+        return NULL;
+    }
+    return search_ascii_icase_scalar(haystack + i, haystack_len - i, needle, needle_len);
+}
+#endif
+
+#ifdef FSEARCH_STRING_SEARCH_AVX2
+__attribute__((target("avx2"))) static const char *
+search_ascii_icase_avx2(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const __m256i first = _mm256_set1_epi8(ascii_tolower(needle[0]));
+    const __m256i first_mask = _mm256_set1_epi8((char)ascii_fold_mask(needle[0]));
+    const __m256i last = _mm256_set1_epi8(ascii_tolower(needle[needle_len - 1]));
+    const __m256i last_mask = _mm256_set1_epi8((char)ascii_fold_mask(needle[needle_len - 1]));
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+        const __m256i block_first =
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(haystack + i)), first_mask);
+        const __m256i block_last =
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(haystack + i + needle_len - 1)), last_mask);
+        uint32_t candidates = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        while (candidates) {
+            const uint32_t offset = __builtin_ctz(candidates);
+            if (ascii_icase_equal(haystack + i + offset + 1, needle + 1, needle_len - 2)) {
+                return haystack + i + offset;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    if (i + needle_len > haystack_len) {
+        return NULL;
+    }
+    // most file names are shorter than a single AVX2 vector
+    return search_ascii_icase_sse2(haystack + i, haystack_len - i, needle, needle_len);
+}
+#endif
+
+#ifdef FSEARCH_STRING_SEARCH_NEON
+static const char *
+search_ascii_icase_neon(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const uint8x16_t first = vdupq_n_u8((uint8_t)ascii_tolower(needle[0]));
+    const uint8x16_t first_mask = vdupq_n_u8(ascii_fold_mask(needle[0]));
+    const uint8x16_t last = vdupq_n_u8((uint8_t)ascii_tolower(needle[needle_len - 1]));
+    const uint8x16_t last_mask = vdupq_n_u8(ascii_fold_mask(needle[needle_len - 1]));
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+        const uint8x16_t block_first = vorrq_u8(vld1q_u8((const uint8_t *)(haystack + i)), first_mask);
+        const uint8x16_t block_last = vorrq_u8(vld1q_u8((const uint8_t *)(haystack + i + needle_len - 1)), last_mask);
+        const uint8x16_t eq = vandq_u8(vceqq_u8(block_first, first), vceqq_u8(block_last, last));
+        // NEON has no movemask, narrowing every byte to 4 bits gives a 64 bit mask instead
+        uint64_t candidates = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (candidates) {
+            const uint32_t offset = __builtin_ctzll(candidates) / 4;
+            if (ascii_icase_equal(haystack + i + offset + 1, needle + 1, needle_len - 2)) {
+                return haystack + i + offset;
+            }
+            candidates &= ~(UINT64_C(0xf) << (offset * 4));
+        }
+    }
+    if (i + needle_len > haystack_len) {
+        return NULL;
+    }
+    return search_ascii_icase_scalar(haystack + i, haystack_len - i, needle, needle_len);
+}
+#endif
+
+static FsearchStringSearchFunc *
+get_search_ascii_icase_func(void) {
+    static FsearchStringSearchFunc *search_func = NULL;
+    FsearchStringSearchFunc *func = g_atomic_pointer_get(&search_func);
+    if (G_LIKELY(func)) {
+        return func;
+    }
+#if defined(FSEARCH_STRING_SEARCH_AVX2)
+    __builtin_cpu_init();
+    func = __builtin_cpu_supports("avx2") ? search_ascii_icase_avx2 : search_ascii_icase_sse2;
+#elif defined(FSEARCH_STRING_SEARCH_NEON)
+    func = search_ascii_icase_neon;
+#else
+    func = search_ascii_icase_scalar;
+#endif
+    g_atomic_pointer_set(&search_func, func);
+    return func;
+}
+
+const char *
+fsearch_string_search_ascii_icase(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    if (needle_len == 0) {
+        return haystack;
+    }
+    if (needle_len > haystack_len) {
+        return NULL;
+    }
+    if (needle_len == 1) {
+        // the kernels only verify the bytes between the first and the last one
+        const char c = ascii_tolower(needle[0]);
+        for (size_t i = 0; i < haystack_len; i++) {
+            if (ascii_tolower(haystack[i]) == c) {
+                return haystack + i;
+            }
+        }
+        return NULL;
+    }
+    return get_search_ascii_icase_func()(haystack, haystack_len, needle, needle_len);
+}
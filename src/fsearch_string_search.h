@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+
+// Finds the first occurrence of needle in haystack, ignoring the case of ASCII letters.
+// The needle must only consist of ASCII characters, the haystack may contain any bytes, which
+// gives the same results as strcasestr for UTF-8 strings. Neither of them needs to be NUL terminated.
+// The fastest implementation the CPU supports (AVX2, SSE2 or NEON) is picked at runtime.
+const char *
+fsearch_string_search_ascii_icase(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len);
@@ -0,0 +1,155 @@
+#define G_LOG_DOMAIN "fsearch-string-table"
+
+#include "fsearch_string_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The strings are found through blocks which never move once they're allocated, so they can be read while
+// other strings get added
+#define STRING_TABLE_BLOCK_SIZE 4096
+#define STRING_TABLE_MAX_BLOCKS 16384
+
+typedef struct {
+    uint32_t len;
+    guint hash;
+    // points right behind the item for the stored strings
+    const char *str;
+} StringTableItem;
+
+struct FsearchStringTable {
+    // StringTableItem -> itself, its id is stored as the value
+    GHashTable *ids;
+    StringTableItem **blocks[STRING_TABLE_MAX_BLOCKS];
+    volatile uint32_t num_strings;
+    size_t memory_usage;
+
+    GMutex mutex;
+};
+
+static guint
+string_table_item_hash(gconstpointer key) {
+    return ((const StringTableItem *)key)->hash;
+}
+
+static gboolean
+string_table_item_equal(gconstpointer a, gconstpointer b) {
+    const StringTableItem *i1 = a;
+    const StringTableItem *i2 = b;
+    return i1->len == i2->len && memcmp(i1->str, i2->str, i1->len) == 0;
+}
+
+static guint
+get_hash(const char *str, size_t len) {
+    // djb2, like g_str_hash, but for strings with NUL bytes
+    guint hash = 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash << 5) + hash + (guchar)str[i];
+    }
+    return hash;
+}
+
+FsearchStringTable *
+fsearch_string_table_new(void) {
+    FsearchStringTable *table = calloc(1, sizeof(FsearchStringTable));
+    g_assert(table);
+    table->ids = g_hash_table_new(string_table_item_hash, string_table_item_equal);
+    g_mutex_init(&table->mutex);
+    return table;
+}
+
+void
+fsearch_string_table_free(FsearchStringTable *table) {
+    if (!table) {
+        return;
+    }
+    for (uint32_t i = 0; i < table->num_strings; i++) {
+        free(table->blocks[i / STRING_TABLE_BLOCK_SIZE][i % STRING_TABLE_BLOCK_SIZE]);
+    }
+    for (uint32_t i = 0; i < STRING_TABLE_MAX_BLOCKS && table->blocks[i]; i++) {
+        g_clear_pointer(&table->blocks[i], free);
+    }
+    g_clear_pointer(&table->ids, g_hash_table_unref);
+    g_mutex_clear(&table->mutex);
+    g_clear_pointer(&table, free);
+}
+
+uint32_t
+fsearch_string_table_add(FsearchStringTable *table, const char *str, size_t len) {
+    g_assert(table);
+    g_assert(str || len == 0);
+
+    if (len > UINT32_MAX) {
+        return FSEARCH_STRING_TABLE_NO_ID;
+    }
+    const StringTableItem key = {.len = (uint32_t)len, .hash = get_hash(str, len), .str = str ? str : ""};
+
+    g_mutex_lock(&table->mutex);
+    uint32_t id = GPOINTER_TO_UINT(g_hash_table_lookup(table->ids, &key));
+    if (id != FSEARCH_STRING_TABLE_NO_ID) {
+        g_mutex_unlock(&table->mutex);
+        return id;
+    }
+
+    const uint32_t idx = table->num_strings;
+    const uint32_t block_idx = idx / STRING_TABLE_BLOCK_SIZE;
+    if (block_idx >= STRING_TABLE_MAX_BLOCKS) {
+        g_mutex_unlock(&table->mutex);
+        g_debug("table is full");
+        return FSEARCH_STRING_TABLE_NO_ID;
+    }
+    if (!table->blocks[block_idx]) {
+        table->blocks[block_idx] = calloc(STRING_TABLE_BLOCK_SIZE, sizeof(StringTableItem *));
+        g_assert(table->blocks[block_idx]);
+        table->memory_usage += STRING_TABLE_BLOCK_SIZE * sizeof(StringTableItem *);
+    }
+
+    StringTableItem *item = malloc(sizeof(StringTableItem) + len + 1);
+    g_assert(item);
+    char *item_str = (char *)(item + 1);
+    if (len > 0) {
+        memcpy(item_str, str, len);
+    }
+    item_str[len] = '\0';
+    item->len = key.len;
+    item->hash = key.hash;
+    item->str = item_str;
+    table->blocks[block_idx][idx % STRING_TABLE_BLOCK_SIZE] = item;
+    table->memory_usage += sizeof(StringTableItem) + len + 1;
+
+    id = idx + 1;
+    g_hash_table_insert(table->ids, item, GUINT_TO_POINTER(id));
+    // readers only look at strings below num_strings, so it's increased once the string is in its block
+    g_atomic_int_set(&table->num_strings, idx + 1);
+    g_mutex_unlock(&table->mutex);
+    return id;
+}
+
+const char *
+fsearch_string_table_get(FsearchStringTable *table, uint32_t id, size_t *len) {
+    g_assert(table);
+    if (id == FSEARCH_STRING_TABLE_NO_ID || id > (uint32_t)g_atomic_int_get(&table->num_strings)) {
+        return NULL;
+    }
+    const uint32_t idx = id - 1;
+    const StringTableItem *item = table->blocks[idx / STRING_TABLE_BLOCK_SIZE][idx % STRING_TABLE_BLOCK_SIZE];
+    if (len) {
+        *len = item->len;
+    }
+    return item->str;
+}
+
+uint32_t
+fsearch_string_table_get_num_strings(FsearchStringTable *table) {
+    g_assert(table);
+    return g_atomic_int_get(&table->num_strings);
+}
+
+size_t
+fsearch_string_table_get_memory_usage(FsearchStringTable *table) {
+    g_assert(table);
+    g_mutex_lock(&table->mutex);
+    const size_t usage = table->memory_usage;
+    g_mutex_unlock(&table->mutex);
+    return usage;
+}
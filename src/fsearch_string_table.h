@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Stores every distinct string only once and hands out a 32 bit id for it. Strings can contain NUL bytes and are
+// never removed, so their ids and data stay valid for the lifetime of the table. Strings can be added and looked
+// up by several threads at once, looking them up doesn't take a lock.
+typedef struct FsearchStringTable FsearchStringTable;
+
+// Never handed out, e.g. for entries which don't have a string
+#define FSEARCH_STRING_TABLE_NO_ID 0
+
+FsearchStringTable *
+fsearch_string_table_new(void);
+
+void
+fsearch_string_table_free(FsearchStringTable *table);
+
+// Returns the id of the len bytes at str, they get added if they're not part of the table yet.
+// Returns FSEARCH_STRING_TABLE_NO_ID if the table is full.
+uint32_t
+fsearch_string_table_add(FsearchStringTable *table, const char *str, size_t len);
+
+// Returns NULL if id wasn't handed out. The string is followed by a NUL byte, which isn't part of *len.
+const char *
+fsearch_string_table_get(FsearchStringTable *table, uint32_t id, size_t *len);
+
+uint32_t
+fsearch_string_table_get_num_strings(FsearchStringTable *table);
+
+size_t
+fsearch_string_table_get_memory_usage(FsearchStringTable *table);
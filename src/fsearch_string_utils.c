@@ -164,3 +164,48 @@ fsearch_string_starts_with_interval(char *str, char **end_ptr) {
     *end_ptr = str;
     return false;
 }
+
+uint64_t
+fsearch_string_get_version_sort_key(const char *str) {
+    g_assert(str);
+    const unsigned char *s = (const unsigned char *)str;
+    uint8_t key[sizeof(uint64_t)] = {};
+    uint32_t k = 0;
+    while (*s && k < sizeof(key)) {
+        if (!g_ascii_isdigit(*s)) {
+            key[k++] = *s++;
+            continue;
+        }
+        if (*s == '0') {
+            // strverscmp compares numbers with leading zeros as fractional parts, which the key doesn't cover.
+            // Any digit sorts after a '0' though and other characters aren't in between.
+            key[k++] = '0';
+            break;
+        }
+        // all numbers without leading zeros share the marker, then the longer one is larger, then the first
+        // differing digit decides
+        key[k++] = '1';
+        size_t num_digits = 0;
+        while (g_ascii_isdigit(s[num_digits])) {
+            num_digits++;
+        }
+        if (k == sizeof(key)) {
+            break;
+        }
+        if (num_digits >= UINT8_MAX) {
+            key[k++] = UINT8_MAX;
+            break;
+        }
+        key[k++] = (uint8_t)num_digits;
+        for (size_t i = 0; i < num_digits && k < sizeof(key); i++) {
+            key[k++] = s[i];
+        }
+        s += num_digits;
+    }
+
+    uint64_t res = 0;
+    for (uint32_t i = 0; i < sizeof(key); i++) {
+        res = (res << 8) | key[i];
+    }
+    return res;
+}
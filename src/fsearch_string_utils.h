@@ -18,6 +18,7 @@
 
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
 #include <unistd.h>
 
 bool
@@ -51,3 +52,9 @@ fsearch_string_convert_wildcard_to_regex_expression(const char *str);
 // If no interval was detected end_ptr will point to str.
 bool
 fsearch_string_starts_with_interval(char *str, char **end_ptr);
+
+// Returns a key for the start of str, which is consistent with strverscmp: if the key of a is smaller than the key
+// of b, strverscmp(a, b) is negative. Strings with the same key have to be compared with strverscmp.
+// Numbers without leading zeros are encoded by their length and digits, so they're ordered by value.
+uint64_t
+fsearch_string_get_version_sort_key(const char *str);
@@ -0,0 +1,329 @@
+#define G_LOG_DOMAIN "fsearch-subtree-filter"
+
+#include "fsearch_subtree_filter.h"
+#include "fsearch_trigram_index.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The filter of a whole subtree gets more trigrams, so it has more bits than the ones of a folder's files and name
+#define SUBTREE_FILTER_NUM_WORDS 4
+#define FILES_FILTER_NUM_WORDS 2
+#define NAME_FILTER_NUM_WORDS 1
+// the parent of folders without a parent in the array
+#define NO_PARENT UINT32_MAX
+
+typedef struct {
+    // the trigrams of the names of all folders and files below the folder
+    uint64_t subtree_filter[SUBTREE_FILTER_NUM_WORDS];
+    // the trigrams of the names of the folder's files
+    uint64_t files_filter[FILES_FILTER_NUM_WORDS];
+    // the trigrams of the folder's own name
+    uint64_t name_filter[NAME_FILTER_NUM_WORDS];
+    // the folders and files right in the folder are at [first_child, first_child + num_children) and
+    // [first_file, first_file + num_files)
+    uint32_t first_child;
+    uint32_t num_children;
+    uint32_t first_file;
+    uint32_t num_files;
+} SubtreeFilterFolder;
+
+struct FsearchSubtreeFilter {
+    DynamicArray *folders;
+    DynamicArray *files;
+    uint32_t num_folders;
+    SubtreeFilterFolder *nodes;
+    // the folders without a parent, they come first
+    uint32_t num_roots;
+
+    volatile int ref_count;
+};
+
+typedef struct {
+    uint32_t *positions;
+    uint32_t num_positions;
+    uint32_t capacity;
+} SubtreeFilterPositions;
+
+// Every trigram sets two bits, which are taken from different parts of the hash of its key
+static inline void
+add_key(uint64_t *filter, uint32_t num_words, uint32_t key) {
+    const uint32_t hash = key * 0x9e3779b1u;
+    const uint32_t num_bits = num_words * 64;
+    const uint32_t bit_1 = (hash >> 24) & (num_bits - 1);
+    const uint32_t bit_2 = (hash >> 12) & (num_bits - 1);
+    filter[bit_1 / 64] |= UINT64_C(1) << (bit_1 % 64);
+    filter[bit_2 / 64] |= UINT64_C(1) << (bit_2 % 64);
+}
+
+// Adds the trigrams of name to filter and, if it's not NULL, to subtree_filter
+static void
+add_name(uint64_t *filter, uint32_t num_words, uint64_t *subtree_filter, const char *name) {
+    const size_t len = name ? strlen(name) : 0;
+    for (size_t i = 0; i + 2 < len; i++) {
+        const uint32_t key = fsearch_trigram_get_key(name + i);
+        add_key(filter, num_words, key);
+        if (subtree_filter) {
+            add_key(subtree_filter, SUBTREE_FILTER_NUM_WORDS, key);
+        }
+    }
+}
+
+static inline bool
+contains_all(const uint64_t *filter, const uint64_t *keys, uint32_t num_words) {
+    for (uint32_t i = 0; i < num_words; i++) {
+        if ((filter[i] & keys[i]) != keys[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t
+get_parent_position(GHashTable *positions, FsearchDatabaseEntry *entry) {
+    FsearchDatabaseEntryFolder *parent = db_entry_get_parent(entry);
+    gpointer value = parent ? g_hash_table_lookup(positions, parent) : NULL;
+    return value ? GPOINTER_TO_UINT(value) - 1 : NO_PARENT;
+}
+
+static void
+add_positions(SubtreeFilterPositions *positions, uint32_t first, uint32_t num) {
+    if (positions->num_positions + num > positions->capacity) {
+        positions->capacity = MAX(positions->capacity * 2, positions->num_positions + num);
+        positions->positions = realloc(positions->positions, positions->capacity * sizeof(uint32_t));
+        g_assert(positions->positions);
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        positions->positions[positions->num_positions++] = first + i;
+    }
+}
+
+// Visits the folders depth first, in the order of their positions, and collects the candidates of type. Folders
+// whose subtree doesn't contain all bits of subtree_keys are skipped with everything below them. Without any keys
+// every folder (or file) is a candidate.
+static void
+collect_candidates(FsearchSubtreeFilter *filter,
+                   FsearchDatabaseEntryType type,
+                   const uint64_t *subtree_keys,
+                   const uint64_t *files_keys,
+                   const uint64_t *name_keys,
+                   SubtreeFilterPositions *candidates) {
+    if (type == DATABASE_ENTRY_TYPE_FOLDER) {
+        for (uint32_t i = 0; i < filter->num_roots; i++) {
+            if (contains_all(filter->nodes[i].name_filter, name_keys, NAME_FILTER_NUM_WORDS)) {
+                add_positions(candidates, i, 1);
+            }
+        }
+    }
+
+    uint32_t *stack = malloc((filter->num_folders + 1) * sizeof(uint32_t));
+    g_assert(stack);
+    uint32_t stack_len = 0;
+    for (uint32_t i = filter->num_roots; i > 0; i--) {
+        stack[stack_len++] = i - 1;
+    }
+    while (stack_len > 0) {
+        SubtreeFilterFolder *node = &filter->nodes[stack[--stack_len]];
+        if (!contains_all(node->subtree_filter, subtree_keys, SUBTREE_FILTER_NUM_WORDS)) {
+            continue;
+        }
+        if (type == DATABASE_ENTRY_TYPE_FOLDER) {
+            for (uint32_t i = node->first_child; i < node->first_child + node->num_children; i++) {
+                if (contains_all(filter->nodes[i].name_filter, name_keys, NAME_FILTER_NUM_WORDS)) {
+                    add_positions(candidates, i, 1);
+                }
+            }
+        }
+        else if (node->num_files > 0 && contains_all(node->files_filter, files_keys, FILES_FILTER_NUM_WORDS)) {
+            add_positions(candidates, node->first_file, node->num_files);
+        }
+        // the first child gets visited next
+        for (uint32_t i = node->num_children; i > 0; i--) {
+            stack[stack_len++] = node->first_child + i - 1;
+        }
+    }
+    g_clear_pointer(&stack, free);
+}
+
+// The positions the traversal visits must be all positions in order, otherwise the candidates wouldn't be sorted
+static bool
+is_traversal_ordered(FsearchSubtreeFilter *filter, FsearchDatabaseEntryType type, uint32_t num_entries) {
+    const uint64_t no_keys[SUBTREE_FILTER_NUM_WORDS] = {0};
+    SubtreeFilterPositions visited = {};
+    collect_candidates(filter, type, no_keys, no_keys, no_keys, &visited);
+    bool ordered = visited.num_positions == num_entries;
+    for (uint32_t i = 0; i < visited.num_positions && ordered; i++) {
+        ordered = visited.positions[i] == i;
+    }
+    g_clear_pointer(&visited.positions, free);
+    return ordered;
+}
+
+static bool
+build_filters(FsearchSubtreeFilter *filter) {
+    const uint32_t num_folders = filter->num_folders;
+    const uint32_t num_files = darray_get_num_items(filter->files);
+
+    // the folders -> their position + 1
+    g_autoptr(GHashTable) positions = g_hash_table_new(g_direct_hash, g_direct_equal);
+    uint32_t *parents = calloc(num_folders + 1, sizeof(uint32_t));
+    g_assert(parents);
+    bool valid = true;
+    // the folders and files right in a folder must be next to each other
+    uint32_t prev_parent = NO_PARENT;
+    for (uint32_t pos = 0; pos < num_folders; pos++) {
+        FsearchDatabaseEntry *folder = darray_get_item(filter->folders, pos);
+        if (!folder) {
+            valid = false;
+            break;
+        }
+        const uint32_t parent = get_parent_position(positions, folder);
+        if (parent == NO_PARENT) {
+            // the roots must come first
+            valid = pos == filter->num_roots++;
+        }
+        else if (parent != prev_parent) {
+            valid = filter->nodes[parent].num_children == 0;
+            filter->nodes[parent].first_child = pos;
+        }
+        if (!valid) {
+            break;
+        }
+        if (parent != NO_PARENT) {
+            filter->nodes[parent].num_children++;
+        }
+        parents[pos] = parent;
+        prev_parent = parent;
+        add_name(filter->nodes[pos].name_filter,
+                 NAME_FILTER_NUM_WORDS,
+                 parent != NO_PARENT ? filter->nodes[parent].subtree_filter : NULL,
+                 db_entry_get_name_raw(folder));
+        g_hash_table_insert(positions, folder, GUINT_TO_POINTER(pos + 1));
+    }
+
+    prev_parent = NO_PARENT;
+    for (uint32_t pos = 0; pos < num_files && valid; pos++) {
+        FsearchDatabaseEntry *file = darray_get_item(filter->files, pos);
+        const uint32_t parent = file ? get_parent_position(positions, file) : NO_PARENT;
+        if (parent == NO_PARENT || (parent != prev_parent && filter->nodes[parent].num_files > 0)) {
+            valid = false;
+            break;
+        }
+        SubtreeFilterFolder *node = &filter->nodes[parent];
+        if (parent != prev_parent) {
+            node->first_file = pos;
+            prev_parent = parent;
+        }
+        node->num_files++;
+        add_name(node->files_filter, FILES_FILTER_NUM_WORDS, node->subtree_filter, db_entry_get_name_raw(file));
+    }
+
+    // parents come before their children, so the subtrees of the children are done before the ones of their parents
+    for (uint32_t pos = num_folders; pos > 0 && valid; pos--) {
+        const uint32_t parent = parents[pos - 1];
+        if (parent == NO_PARENT) {
+            continue;
+        }
+        if (parent >= pos - 1) {
+            valid = false;
+            break;
+        }
+        for (uint32_t i = 0; i < SUBTREE_FILTER_NUM_WORDS; i++) {
+            filter->nodes[parent].subtree_filter[i] |= filter->nodes[pos - 1].subtree_filter[i];
+        }
+    }
+    g_clear_pointer(&parents, free);
+
+    return valid && is_traversal_ordered(filter, DATABASE_ENTRY_TYPE_FOLDER, num_folders)
+        && is_traversal_ordered(filter, DATABASE_ENTRY_TYPE_FILE, num_files);
+}
+
+FsearchSubtreeFilter *
+fsearch_subtree_filter_new(DynamicArray *folders, DynamicArray *files) {
+    g_assert(folders);
+    g_assert(files);
+
+    FsearchSubtreeFilter *filter = calloc(1, sizeof(FsearchSubtreeFilter));
+    g_assert(filter);
+    filter->folders = darray_ref(folders);
+    filter->files = darray_ref(files);
+    filter->num_folders = darray_get_num_items(folders);
+    filter->nodes = calloc(filter->num_folders + 1, sizeof(SubtreeFilterFolder));
+    g_assert(filter->nodes);
+    filter->ref_count = 1;
+
+    if (!build_filters(filter)) {
+        g_debug("[subtree_filter] the entries aren't in path order");
+        g_clear_pointer(&filter, fsearch_subtree_filter_unref);
+    }
+    return filter;
+}
+
+FsearchSubtreeFilter *
+fsearch_subtree_filter_ref(FsearchSubtreeFilter *filter) {
+    if (!filter || g_atomic_int_get(&filter->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&filter->ref_count);
+    return filter;
+}
+
+void
+fsearch_subtree_filter_unref(FsearchSubtreeFilter *filter) {
+    if (!filter || g_atomic_int_get(&filter->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&filter->ref_count)) {
+        g_clear_pointer(&filter->folders, darray_unref);
+        g_clear_pointer(&filter->files, darray_unref);
+        g_clear_pointer(&filter->nodes, free);
+        g_clear_pointer(&filter, free);
+    }
+}
+
+DynamicArray *
+fsearch_subtree_filter_get_entries(FsearchSubtreeFilter *filter, FsearchDatabaseEntryType type) {
+    g_assert(filter);
+    return type == DATABASE_ENTRY_TYPE_FOLDER ? filter->folders : filter->files;
+}
+
+size_t
+fsearch_subtree_filter_get_memory_usage(FsearchSubtreeFilter *filter) {
+    return filter ? sizeof(FsearchSubtreeFilter) + (filter->num_folders + 1) * sizeof(SubtreeFilterFolder) : 0;
+}
+
+bool
+fsearch_subtree_filter_lookup(FsearchSubtreeFilter *filter,
+                              FsearchDatabaseEntryType type,
+                              const char *needle,
+                              size_t needle_len,
+                              uint32_t **positions,
+                              uint32_t *num_positions) {
+    g_assert(filter);
+    g_assert(needle);
+    g_assert(positions);
+    g_assert(num_positions);
+
+    if (needle_len < 3) {
+        return false;
+    }
+    uint64_t subtree_keys[SUBTREE_FILTER_NUM_WORDS] = {0};
+    uint64_t files_keys[FILES_FILTER_NUM_WORDS] = {0};
+    uint64_t name_keys[NAME_FILTER_NUM_WORDS] = {0};
+    for (size_t i = 0; i + 2 < needle_len; i++) {
+        const uint32_t key = fsearch_trigram_get_key(needle + i);
+        add_key(subtree_keys, SUBTREE_FILTER_NUM_WORDS, key);
+        add_key(files_keys, FILES_FILTER_NUM_WORDS, key);
+        add_key(name_keys, NAME_FILTER_NUM_WORDS, key);
+    }
+
+    SubtreeFilterPositions candidates = {};
+    collect_candidates(filter, type, subtree_keys, files_keys, name_keys, &candidates);
+    if (candidates.num_positions == 0) {
+        g_clear_pointer(&candidates.positions, free);
+    }
+    *positions = candidates.positions;
+    *num_positions = candidates.num_positions;
+    return true;
+}
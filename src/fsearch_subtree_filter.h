@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_entry.h"
+
+// Small Bloom filters of the trigrams in the names below every folder, built for the path sorted arrays. In those
+// the folders and files right in a folder are next to each other, in the order of the paths of their folders. So
+// the folders can be walked depth first while the candidates still come out sorted, and a folder whose subtree
+// can't contain a name with the trigrams of a substring rules out all folders and files below it at once.
+//
+// Trigrams are mapped to bits like the slots of the trigram index (see fsearch_trigram_get_key), so lookups only
+// add candidates and never drop any. The filters don't change once they're built and can be shared by several
+// threads.
+typedef struct FsearchSubtreeFilter FsearchSubtreeFilter;
+
+// Builds the filters for folders and files in path order. Returns NULL if they aren't in that order, e.g. because
+// a file's folder isn't part of folders.
+FsearchSubtreeFilter *
+fsearch_subtree_filter_new(DynamicArray *folders, DynamicArray *files);
+
+FsearchSubtreeFilter *
+fsearch_subtree_filter_ref(FsearchSubtreeFilter *filter);
+
+void
+fsearch_subtree_filter_unref(FsearchSubtreeFilter *filter);
+
+// The array of type the positions returned by fsearch_subtree_filter_lookup refer to
+DynamicArray *
+fsearch_subtree_filter_get_entries(FsearchSubtreeFilter *filter, FsearchDatabaseEntryType type);
+
+// Returns the number of bytes allocated for the filters, filter may be NULL
+size_t
+fsearch_subtree_filter_get_memory_usage(FsearchSubtreeFilter *filter);
+
+// Looks up the candidates of type for names which contain needle. Returns false if needle is too short to narrow
+// the entries down. Otherwise *positions is set to the sorted positions of the candidates, which must be freed with
+// free (it's NULL if there are none).
+bool
+fsearch_subtree_filter_lookup(FsearchSubtreeFilter *filter,
+                              FsearchDatabaseEntryType type,
+                              const char *needle,
+                              size_t needle_len,
+                              uint32_t **positions,
+                              uint32_t *num_positions);
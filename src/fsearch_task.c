@@ -1,6 +1,7 @@
 #define G_LOG_DOMAIN "fsearch-task"
 
 #include "fsearch_task.h"
+#include "fsearch_trace.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -11,6 +12,11 @@ typedef struct FsearchTask {
         FSEARCH_TASK_TYPE_NORMAL,
     } type;
     int id;
+    int priority;
+    // tasks with the same priority are run in the order they were queued
+    uint64_t seq;
+    // monotonic time it was queued at
+    int64_t queue_time;
     GCancellable *task_cancellable;
     FsearchTaskFunc task_func;
     FsearchTaskFinishedFunc task_finished_func;
@@ -21,8 +27,14 @@ typedef struct FsearchTask {
 struct FsearchTaskQueue {
     GAsyncQueue *queue;
     GThread *queue_thread;
+    // protected by the lock of the async queue
+    uint64_t next_seq;
+
     FsearchTask *current_task;
     GMutex current_task_lock;
+    // number of queued tasks which are neither finished nor cleared yet, protected by current_task_lock
+    uint32_t num_unfinished;
+    GCond finished_cond;
 };
 
 static void
@@ -36,6 +48,7 @@ fsearch_task_new(int id,
                  FsearchTaskFunc task_func,
                  FsearchTaskFinishedFunc task_finished_func,
                  FsearchTaskCancelledFunc task_cancelled_func,
+                 FsearchTaskPriority priority,
                  gpointer data) {
     FsearchTask *task = calloc(1, sizeof(FsearchTask));
     g_assert(task);
@@ -44,12 +57,42 @@ fsearch_task_new(int id,
     task->task_func = task_func;
     task->task_finished_func = task_finished_func;
     task->task_cancelled_func = task_cancelled_func;
+    task->priority = priority;
     task->data = data;
     task->id = id;
+    task->queue_time = fsearch_trace_begin();
 
     return task;
 }
 
+static gint
+fsearch_task_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const FsearchTask *task_a = a;
+    const FsearchTask *task_b = b;
+    if (task_a->priority != task_b->priority) {
+        return task_a->priority < task_b->priority ? -1 : 1;
+    }
+    if (task_a->seq != task_b->seq) {
+        return task_a->seq < task_b->seq ? -1 : 1;
+    }
+    return 0;
+}
+
+static void
+fsearch_task_queue_push_unlocked(FsearchTaskQueue *queue, FsearchTask *task) {
+    task->seq = queue->next_seq++;
+    g_async_queue_push_sorted_unlocked(queue->queue, task, fsearch_task_compare, NULL);
+}
+
+static void
+fsearch_task_queue_task_done(FsearchTaskQueue *queue) {
+    g_mutex_lock(&queue->current_task_lock);
+    if (--queue->num_unfinished == 0) {
+        g_cond_broadcast(&queue->finished_cond);
+    }
+    g_mutex_unlock(&queue->current_task_lock);
+}
+
 static gpointer
 fsearch_task_queue_thread(FsearchTaskQueue *queue) {
     while (true) {
@@ -68,7 +111,10 @@ fsearch_task_queue_thread(FsearchTaskQueue *queue) {
         g_mutex_unlock(&queue->current_task_lock);
 
         g_cancellable_reset(task->task_cancellable);
+        const int64_t span = fsearch_trace_begin();
+        fsearch_trace_add("task", "queued", task->queue_time, span);
         gpointer result = task->task_func(task->data, task->task_cancellable);
+        fsearch_trace_end(span, "task", "run");
 
         g_mutex_lock(&queue->current_task_lock);
         queue->current_task = NULL;
@@ -78,6 +124,7 @@ fsearch_task_queue_thread(FsearchTaskQueue *queue) {
         task->task_finished_func(result, task->data);
 
         g_clear_pointer(&task, fsearch_task_free);
+        fsearch_task_queue_task_done(queue);
     }
     return NULL;
 }
@@ -91,11 +138,23 @@ fsearch_task_queue_cancel_current(FsearchTaskQueue *queue) {
     g_mutex_unlock(&queue->current_task_lock);
 }
 
+void
+fsearch_task_queue_wait(FsearchTaskQueue *queue) {
+    g_assert(queue);
+
+    g_mutex_lock(&queue->current_task_lock);
+    while (queue->num_unfinished > 0) {
+        g_cond_wait(&queue->finished_cond, &queue->current_task_lock);
+    }
+    g_mutex_unlock(&queue->current_task_lock);
+}
+
 static void
 fsearch_task_queue_clear(FsearchTaskQueue *queue, FsearchTaskQueueClearPolicy clear_policy, int id) {
     if (clear_policy == FSEARCH_TASK_CLEAR_NONE) {
         return;
     }
+    const bool same_id_only = clear_policy != FSEARCH_TASK_CLEAR_ALL;
 
     GQueue *task_queue = g_queue_new();
 
@@ -106,7 +165,7 @@ fsearch_task_queue_clear(FsearchTaskQueue *queue, FsearchTaskQueueClearPolicy cl
         if (!task) {
             break;
         }
-        if (clear_policy == FSEARCH_TASK_CLEAR_SAME_ID && task->id != id) {
+        if ((same_id_only && task->id != id) || task->type == FSEARCH_TASK_TYPE_QUIT) {
             // remember tasks which need to be inserted back into the async queue later
             g_queue_push_tail(task_queue, g_steal_pointer(&task));
             continue;
@@ -116,13 +175,14 @@ fsearch_task_queue_clear(FsearchTaskQueue *queue, FsearchTaskQueueClearPolicy cl
             task->task_cancelled_func(task->data);
         }
         g_clear_pointer(&task, fsearch_task_free);
+        fsearch_task_queue_task_done(queue);
     }
 
     // insert all the tasks back into the async queue, which still need to be processed
     while (true) {
         FsearchTask *task = g_queue_pop_head(task_queue);
         if (task) {
-            g_async_queue_push_unlocked(queue->queue, g_steal_pointer(&task));
+            g_async_queue_push_sorted_unlocked(queue->queue, g_steal_pointer(&task), fsearch_task_compare, NULL);
         }
         else {
             break;
@@ -145,11 +205,16 @@ fsearch_task_queue_free(FsearchTaskQueue *queue) {
     FsearchTask *task = calloc(1, sizeof(FsearchTask));
     g_assert(task);
     task->type = FSEARCH_TASK_TYPE_QUIT;
-    g_async_queue_push(queue->queue, g_steal_pointer(&task));
+    // behind all tasks which might have been queued in the meantime
+    task->priority = G_MAXINT;
+    g_async_queue_lock(queue->queue);
+    fsearch_task_queue_push_unlocked(queue, g_steal_pointer(&task));
+    g_async_queue_unlock(queue->queue);
 
     g_thread_join(g_steal_pointer(&queue->queue_thread));
 
     g_mutex_clear(&queue->current_task_lock);
+    g_cond_clear(&queue->finished_cond);
 
     g_clear_pointer(&queue->queue, g_async_queue_unref);
     g_clear_pointer(&queue, g_free);
@@ -161,9 +226,10 @@ fsearch_task_queue_new(const char *name) {
     g_assert(queue);
 
     queue->queue = g_async_queue_new();
-    queue->queue_thread = g_thread_new(name, (GThreadFunc)fsearch_task_queue_thread, queue);
-
     g_mutex_init(&queue->current_task_lock);
+    g_cond_init(&queue->finished_cond);
+
+    queue->queue_thread = g_thread_new(name, (GThreadFunc)fsearch_task_queue_thread, queue);
 
     return queue;
 }
@@ -175,18 +241,25 @@ fsearch_task_queue(FsearchTaskQueue *queue,
                    FsearchTaskFinishedFunc task_finished_func,
                    FsearchTaskCancelledFunc task_cancelled_func,
                    FsearchTaskQueueClearPolicy clear_policy,
+                   FsearchTaskPriority priority,
                    gpointer data) {
-    FsearchTask *task = fsearch_task_new(id, task_func, task_finished_func, task_cancelled_func, data);
+    FsearchTask *task = fsearch_task_new(id, task_func, task_finished_func, task_cancelled_func, priority, data);
     if (clear_policy != FSEARCH_TASK_CLEAR_NONE) {
         fsearch_task_queue_clear(queue, clear_policy, task->id);
         g_mutex_lock(&queue->current_task_lock);
-        if (queue->current_task) {
+        if (queue->current_task && clear_policy != FSEARCH_TASK_CLEAR_QUEUED_SAME_ID) {
             if (clear_policy != FSEARCH_TASK_CLEAR_SAME_ID || queue->current_task->id == task->id) {
                 g_cancellable_cancel(queue->current_task->task_cancellable);
             }
         }
         g_mutex_unlock(&queue->current_task_lock);
     }
-    g_async_queue_push(queue->queue, g_steal_pointer(&task));
-}
 
+    g_mutex_lock(&queue->current_task_lock);
+    queue->num_unfinished++;
+    g_mutex_unlock(&queue->current_task_lock);
+
+    g_async_queue_lock(queue->queue);
+    fsearch_task_queue_push_unlocked(queue, g_steal_pointer(&task));
+    g_async_queue_unlock(queue->queue);
+}
@@ -12,10 +12,25 @@ typedef void (*FsearchTaskFinishedFunc)(gpointer result, gpointer data);
 
 typedef enum {
     FSEARCH_TASK_CLEAR_NONE = -1,
+    // queued tasks with the same id are dropped and the running one gets cancelled
     FSEARCH_TASK_CLEAR_SAME_ID,
     FSEARCH_TASK_CLEAR_ALL,
+    // queued tasks with the same id are dropped, but the running one is left alone
+    FSEARCH_TASK_CLEAR_QUEUED_SAME_ID,
 } FsearchTaskQueueClearPolicy;
 
+// Tasks with a higher priority run first, those with the same priority in the order they were queued
+typedef enum {
+    // searching and sorting
+    FSEARCH_TASK_PRIORITY_INTERACTIVE,
+    FSEARCH_TASK_PRIORITY_HIGHLIGHT,
+    // building indexes in the background
+    FSEARCH_TASK_PRIORITY_INDEX,
+    FSEARCH_TASK_PRIORITY_SAVE,
+    // releasing databases which got replaced
+    FSEARCH_TASK_PRIORITY_FREE,
+} FsearchTaskPriority;
+
 void
 fsearch_task_queue_free(FsearchTaskQueue *queue);
 
@@ -29,7 +44,12 @@ fsearch_task_queue(FsearchTaskQueue *queue,
                    FsearchTaskFinishedFunc task_finished_func,
                    FsearchTaskCancelledFunc task_cancelled_func,
                    FsearchTaskQueueClearPolicy clear_policy,
+                   FsearchTaskPriority priority,
                    gpointer data);
 
 void
 fsearch_task_queue_cancel_current(FsearchTaskQueue *queue);
+
+// Blocks until all queued tasks are either finished or cleared
+void
+fsearch_task_queue_wait(FsearchTaskQueue *queue);
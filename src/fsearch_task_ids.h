@@ -3,4 +3,7 @@
 typedef enum FsearchTaskId {
     FSEARCH_TASK_ID_SEARCH,
     FSEARCH_TASK_ID_SORT,
+    FSEARCH_TASK_ID_SAVE,
+    FSEARCH_TASK_ID_INDEX,
+    FSEARCH_TASK_ID_FREE,
 } FsearchTaskId;
\ No newline at end of file
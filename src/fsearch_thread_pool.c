@@ -19,215 +19,733 @@
 #define G_LOG_DOMAIN "fsearch-thread-pool"
 
 #include <stdio.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 #include "fsearch_limits.h"
 #include "fsearch_thread_pool.h"
 
-struct FsearchThreadPool {
-    GList *threads;
-    uint32_t num_threads;
-};
+// how long a thread which waits for a group sleeps before it looks for new tasks again
+#define GROUP_WAIT_TIMEOUT_US 1000
+// CPU lists may only contain CPUs below this number
+#define CPU_LIST_MAX_CPUS 1024
 
 typedef struct {
+    FsearchThreadPoolFunc func;
+    void *data;
+    FsearchThreadPoolGroup *group;
+} FsearchThreadPoolTask;
+
+typedef struct {
+    FsearchThreadPool *pool;
+    uint32_t idx;
     GThread *thread;
-    FsearchThreadPoolFunc thread_func;
+    // the CPU the thread is bound to in NUMA aware pools, -1 otherwise
+    int32_t cpu;
+    // the NUMA node of cpu
+    uint32_t node;
+    // the other threads in the order the thread steals from them, the ones on the same node come first
+    uint32_t *victims;
+
+    // the thread pops the newest tasks from the tail, other threads steal the oldest ones from the head
+    GQueue tasks;
+    GMutex tasks_mutex;
+
+    // number of tasks the thread is running, tasks which wait for a group run other tasks meanwhile
+    uint32_t task_depth;
+} FsearchThreadPoolWorker;
+
+struct FsearchThreadPool {
+    FsearchThreadPoolWorker *workers;
+    uint32_t num_threads;
+    // the CPUs the threads may run on, they aren't restricted if num_cpus is 0
+    uint32_t *cpus;
+    uint32_t num_cpus;
+    bool numa_aware;
+
+    // tasks which were pushed from outside of the pool
+    GQueue tasks;
+    GMutex tasks_mutex;
 
-    gpointer *thread_data;
+    // number of tasks in all queues
+    volatile gint num_queued;
 
+    // idle threads wait for new tasks
     GMutex mutex;
-    GCond start_cond;
-    GCond finished_cond;
-    FsearchThreadStatus status;
+    GCond cond;
+    uint32_t num_sleeping;
     bool terminate;
-} FsearchThreadPoolContext;
 
-static bool
-thread_pool_has_thread(FsearchThreadPool *pool, GList *thread) {
-    GList *temp = pool->threads;
-    while (temp) {
-        if (temp == thread) {
-            return true;
+    // kept across tasks, see fsearch_thread_pool_get_local_data
+    GData **local_data;
+
+    // see fsearch_thread_pool_get_busy_time
+    int64_t busy_time;
+};
+
+struct FsearchThreadPoolGroup {
+    FsearchThreadPool *pool;
+
+    GMutex mutex;
+    GCond cond;
+    // number of tasks which are either queued or running
+    uint32_t num_pending;
+};
+
+typedef struct {
+    FsearchThreadPoolGroup *group;
+    FsearchThreadPoolRangeFunc func;
+    void *data;
+    uint32_t start;
+    uint32_t end;
+    uint32_t grain_size;
+} FsearchThreadPoolRange;
+
+typedef struct {
+    volatile gint next;
+    uint32_t end;
+} FsearchThreadPoolCursor;
+
+struct FsearchThreadPoolRanges {
+    FsearchThreadPool *pool;
+    uint32_t num_parts;
+    // the first item of every part
+    uint32_t *part_offsets;
+    // every part is split into one range per thread in NUMA aware pools, otherwise it's a single range
+    uint32_t num_ranges;
+    // the cursor of range r of part p is at p * num_ranges + r
+    FsearchThreadPoolCursor *cursors;
+};
+
+// the worker the current thread belongs to
+static GPrivate current_worker = G_PRIVATE_INIT(NULL);
+
+static FsearchThreadPoolWorker *
+get_current_worker(FsearchThreadPool *pool) {
+    FsearchThreadPoolWorker *worker = g_private_get(&current_worker);
+    return worker && worker->pool == pool ? worker : NULL;
+}
+
+static FsearchThreadPoolTask *
+pop_task(GQueue *tasks, GMutex *mutex, bool newest) {
+    g_mutex_lock(mutex);
+    FsearchThreadPoolTask *task = newest ? g_queue_pop_tail(tasks) : g_queue_pop_head(tasks);
+    g_mutex_unlock(mutex);
+    return task;
+}
+
+static FsearchThreadPoolTask *
+find_task(FsearchThreadPool *pool, FsearchThreadPoolWorker *worker) {
+    if (!g_atomic_int_get(&pool->num_queued)) {
+        return NULL;
+    }
+    FsearchThreadPoolTask *task = NULL;
+    if (worker) {
+        task = pop_task(&worker->tasks, &worker->tasks_mutex, true);
+    }
+    if (!task) {
+        task = pop_task(&pool->tasks, &pool->tasks_mutex, false);
+    }
+    const uint32_t num_victims = worker ? pool->num_threads - 1 : pool->num_threads;
+    for (uint32_t i = 0; !task && i < num_victims; i++) {
+        FsearchThreadPoolWorker *victim = &pool->workers[worker ? worker->victims[i] : i];
+        // the oldest task is most likely the largest one
+        task = pop_task(&victim->tasks, &victim->tasks_mutex, false);
+    }
+    if (task) {
+        g_atomic_int_add(&pool->num_queued, -1);
+    }
+    return task;
+}
+
+// Adds the time since start to the busy time of pool, unless it's part of a task which is counted already
+static void
+add_busy_time(FsearchThreadPool *pool, FsearchThreadPoolWorker *worker, int64_t start) {
+    if (!worker || worker->task_depth == 0) {
+        __atomic_fetch_add(&pool->busy_time, g_get_monotonic_time() - start, __ATOMIC_RELAXED);
+    }
+}
+
+static void
+run_task(FsearchThreadPoolTask *task) {
+    FsearchThreadPoolGroup *group = task->group;
+    FsearchThreadPool *pool = group->pool;
+    FsearchThreadPoolWorker *worker = get_current_worker(pool);
+    const int64_t start = g_get_monotonic_time();
+    if (worker) {
+        worker->task_depth++;
+    }
+    task->func(task->data);
+    if (worker) {
+        worker->task_depth--;
+    }
+    add_busy_time(pool, worker, start);
+    g_clear_pointer(&task, g_free);
+
+    // the group can be freed as soon as the waiting thread sees that no tasks are pending,
+    // so it's only touched while the lock is held
+    g_mutex_lock(&group->mutex);
+    if (--group->num_pending == 0) {
+        g_cond_broadcast(&group->cond);
+    }
+    g_mutex_unlock(&group->mutex);
+}
+
+static void
+apply_affinity(FsearchThreadPoolWorker *worker) {
+#ifdef __linux__
+    FsearchThreadPool *pool = worker->pool;
+    if (pool->num_cpus == 0) {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (worker->cpu >= 0) {
+        CPU_SET(worker->cpu, &cpus);
+    }
+    else {
+        for (uint32_t i = 0; i < pool->num_cpus; i++) {
+            CPU_SET(pool->cpus[i], &cpus);
         }
-        temp = temp->next;
     }
-    return false;
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        g_debug("[thread_pool] failed to set the CPU affinity of thread %d", worker->idx);
+    }
+#endif
 }
 
 static gpointer
 fsearch_thread_pool_thread(gpointer user_data) {
-    FsearchThreadPoolContext *ctx = user_data;
+    FsearchThreadPoolWorker *worker = user_data;
+    FsearchThreadPool *pool = worker->pool;
+    g_private_set(&current_worker, worker);
+    apply_affinity(worker);
+
+    while (true) {
+        FsearchThreadPoolTask *task = find_task(pool, worker);
+        if (task) {
+            run_task(task);
+            continue;
+        }
 
-    g_mutex_lock(&ctx->mutex);
-    while (!ctx->terminate) {
-        g_cond_wait(&ctx->start_cond, &ctx->mutex);
-        ctx->status = THREAD_BUSY;
-        if (ctx->thread_data) {
-            ctx->thread_func(ctx->thread_data);
-            ctx->status = THREAD_FINISHED;
-            ctx->thread_data = NULL;
-            g_cond_signal(&ctx->finished_cond);
+        g_mutex_lock(&pool->mutex);
+        while (!g_atomic_int_get(&pool->num_queued) && !pool->terminate) {
+            pool->num_sleeping++;
+            g_cond_wait(&pool->cond, &pool->mutex);
+            pool->num_sleeping--;
+        }
+        const bool terminate = pool->terminate && !g_atomic_int_get(&pool->num_queued);
+        g_mutex_unlock(&pool->mutex);
+        if (terminate) {
+            break;
         }
-        ctx->status = THREAD_IDLE;
     }
-    g_mutex_unlock(&ctx->mutex);
     return NULL;
 }
 
-static void
-thread_context_free(FsearchThreadPoolContext *ctx) {
-    g_return_if_fail(ctx);
+#ifdef __linux__
+static uint32_t
+get_cpu_node(uint32_t cpu) {
+    g_autofree char *path = g_strdup_printf("/sys/devices/system/cpu/cpu%u", cpu);
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (!dir) {
+        return 0;
+    }
+    uint32_t node = 0;
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir))) {
+        // the directory links to the node the CPU belongs to
+        if (g_str_has_prefix(name, "node") && g_ascii_isdigit(name[4])) {
+            node = (uint32_t)g_ascii_strtoull(name + 4, NULL, 10);
+            break;
+        }
+    }
+    g_dir_close(dir);
+    return node;
+}
 
-    g_mutex_lock(&ctx->mutex);
-    if (ctx->thread_data) {
-        g_debug("[thread_pool] search data still there");
+// Returns the CPUs of cpu_list the process may run on, or all of them if cpu_list is empty
+static uint32_t *
+get_allowed_cpus(const char *cpu_list, uint32_t *num_cpus) {
+    *num_cpus = 0;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return NULL;
     }
 
-    // terminate thread
-    ctx->terminate = true;
-    g_cond_signal(&ctx->start_cond);
-    g_mutex_unlock(&ctx->mutex);
-    g_thread_join(g_steal_pointer(&ctx->thread));
+    uint32_t num_listed = 0;
+    g_autofree uint32_t *listed = NULL;
+    if (cpu_list && cpu_list[0] != '\0') {
+        listed = fsearch_thread_pool_parse_cpu_list(cpu_list, &num_listed);
+        if (!listed) {
+            g_warning("[thread_pool] invalid CPU list: %s", cpu_list);
+        }
+    }
 
-    g_mutex_clear(&ctx->mutex);
-    g_cond_clear(&ctx->start_cond);
-    g_cond_clear(&ctx->finished_cond);
+    uint32_t *cpus = g_new0(uint32_t, MAX(CPU_COUNT(&allowed), 1));
+    if (listed) {
+        for (uint32_t i = 0; i < num_listed; i++) {
+            if (listed[i] < CPU_SETSIZE && CPU_ISSET(listed[i], &allowed) && *num_cpus < CPU_COUNT(&allowed)) {
+                cpus[(*num_cpus)++] = listed[i];
+            }
+        }
+    }
+    else {
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE && *num_cpus < CPU_COUNT(&allowed); cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus[(*num_cpus)++] = cpu;
+            }
+        }
+    }
+    if (*num_cpus == 0) {
+        g_debug("[thread_pool] none of the CPUs %s can be used", cpu_list);
+        g_clear_pointer(&cpus, g_free);
+    }
+    return cpus;
+}
+#endif
+
+typedef struct {
+    uint32_t cpu;
+    uint32_t node;
+} FsearchThreadPoolCpu;
+
+static int
+compare_cpus(const void *a, const void *b) {
+    const FsearchThreadPoolCpu *cpu_a = a;
+    const FsearchThreadPoolCpu *cpu_b = b;
+    if (cpu_a->node != cpu_b->node) {
+        return cpu_a->node < cpu_b->node ? -1 : 1;
+    }
+    return cpu_a->cpu < cpu_b->cpu ? -1 : cpu_a->cpu > cpu_b->cpu;
+}
 
-    g_clear_pointer(&ctx, g_free);
+// Binds every thread to a single CPU, consecutive threads to the CPUs of the same node
+static void
+assign_cpus(FsearchThreadPool *pool) {
+    FsearchThreadPoolCpu *cpus = g_new0(FsearchThreadPoolCpu, pool->num_cpus);
+    for (uint32_t i = 0; i < pool->num_cpus; i++) {
+        cpus[i].cpu = pool->cpus[i];
+#ifdef __linux__
+        cpus[i].node = get_cpu_node(pool->cpus[i]);
+#endif
+    }
+    qsort(cpus, pool->num_cpus, sizeof(FsearchThreadPoolCpu), compare_cpus);
+    for (uint32_t i = 0; i < pool->num_threads; i++) {
+        const FsearchThreadPoolCpu *cpu = &cpus[i % pool->num_cpus];
+        pool->workers[i].cpu = (int32_t)cpu->cpu;
+        pool->workers[i].node = cpu->node;
+    }
+    g_clear_pointer(&cpus, g_free);
 }
 
-static FsearchThreadPoolContext *
-thread_context_new(void) {
-    FsearchThreadPoolContext *ctx = g_new0(FsearchThreadPoolContext, 1);
-    g_assert(ctx);
+static void
+init_victims(FsearchThreadPool *pool, FsearchThreadPoolWorker *worker) {
+    worker->victims = g_new0(uint32_t, MAX(pool->num_threads - 1, 1));
+    uint32_t num_victims = 0;
+    // both the threads on the same node and the other ones are visited round robin, starting behind the thread
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        const bool same_node = pass == 0;
+        for (uint32_t i = 1; i < pool->num_threads; i++) {
+            FsearchThreadPoolWorker *victim = &pool->workers[(worker->idx + i) % pool->num_threads];
+            if ((victim->node == worker->node) == same_node) {
+                worker->victims[num_victims++] = victim->idx;
+            }
+        }
+    }
+}
 
-    ctx->thread_data = NULL;
-    ctx->thread_func = NULL;
-    ctx->terminate = false;
-    ctx->status = THREAD_IDLE;
-    g_mutex_init(&ctx->mutex);
-    g_cond_init(&ctx->start_cond);
-    g_cond_init(&ctx->finished_cond);
+// Takes ownership of cpus
+static FsearchThreadPool *
+thread_pool_new(uint32_t num_threads, uint32_t *cpus, uint32_t num_cpus, bool numa_aware) {
+    FsearchThreadPool *pool = g_new0(FsearchThreadPool, 1);
+    pool->num_threads = CLAMP(num_threads, 1, FSEARCH_THREAD_LIMIT);
+    pool->workers = g_new0(FsearchThreadPoolWorker, pool->num_threads);
+    pool->local_data = g_new0(GData *, pool->num_threads);
+    pool->cpus = cpus;
+    pool->num_cpus = cpus ? num_cpus : 0;
+    pool->numa_aware = numa_aware && pool->num_cpus > 0;
+    g_queue_init(&pool->tasks);
+    g_mutex_init(&pool->tasks_mutex);
+    g_mutex_init(&pool->mutex);
+    g_cond_init(&pool->cond);
+
+    for (uint32_t i = 0; i < pool->num_threads; i++) {
+        FsearchThreadPoolWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->idx = i;
+        worker->cpu = -1;
+        g_queue_init(&worker->tasks);
+        g_mutex_init(&worker->tasks_mutex);
+        g_datalist_init(&pool->local_data[i]);
+    }
+    if (pool->numa_aware) {
+        assign_cpus(pool);
+    }
+    for (uint32_t i = 0; i < pool->num_threads; i++) {
+        init_victims(pool, &pool->workers[i]);
+    }
+    g_debug("[thread_pool] %d threads, %d CPUs%s",
+            pool->num_threads,
+            pool->num_cpus,
+            pool->numa_aware ? ", NUMA aware" : "");
+    // all queues must exist before the first thread starts stealing
+    for (uint32_t i = 0; i < pool->num_threads; i++) {
+        pool->workers[i].thread = g_thread_new("thread pool", fsearch_thread_pool_thread, &pool->workers[i]);
+    }
 
-    ctx->thread = g_thread_new("thread pool", fsearch_thread_pool_thread, ctx);
-    return ctx;
+    return pool;
 }
 
 FsearchThreadPool *
-fsearch_thread_pool_init(void) {
-    FsearchThreadPool *pool = g_new0(FsearchThreadPool, 1);
-    pool->threads = NULL;
-    pool->num_threads = 0;
+fsearch_thread_pool_new(uint32_t num_threads) {
+    return thread_pool_new(num_threads, NULL, 0, false);
+}
 
-    uint32_t num_cpus = MIN(g_get_num_processors(), FSEARCH_THREAD_LIMIT);
-    for (uint32_t i = 0; i < num_cpus; i++) {
-        FsearchThreadPoolContext *ctx = thread_context_new();
-        if (ctx) {
-            pool->threads = g_list_prepend(pool->threads, ctx);
-            pool->num_threads++;
-        }
+FsearchThreadPool *
+fsearch_thread_pool_new_with_affinity(uint32_t num_threads, const char *cpu_list, bool numa_aware) {
+    uint32_t num_cpus = 0;
+    uint32_t *cpus = NULL;
+#ifdef __linux__
+    if ((cpu_list && cpu_list[0] != '\0') || numa_aware) {
+        cpus = get_allowed_cpus(cpu_list, &num_cpus);
     }
+#endif
+    if (num_threads == 0) {
+        num_threads = num_cpus > 0 ? num_cpus : g_get_num_processors();
+    }
+    return thread_pool_new(num_threads, cpus, num_cpus, numa_aware);
+}
 
-    return pool;
+FsearchThreadPool *
+fsearch_thread_pool_init(void) {
+    return fsearch_thread_pool_new(g_get_num_processors());
 }
 
 void
 fsearch_thread_pool_free(FsearchThreadPool *pool) {
     g_return_if_fail(pool);
 
-    g_list_free_full(g_steal_pointer(&pool->threads), (GDestroyNotify)thread_context_free);
+    g_mutex_lock(&pool->mutex);
+    pool->terminate = true;
+    g_cond_broadcast(&pool->cond);
+    g_mutex_unlock(&pool->mutex);
+
+    for (uint32_t i = 0; i < pool->num_threads; i++) {
+        FsearchThreadPoolWorker *worker = &pool->workers[i];
+        g_thread_join(g_steal_pointer(&worker->thread));
+        g_mutex_clear(&worker->tasks_mutex);
+        g_clear_pointer(&worker->victims, g_free);
+        g_datalist_clear(&pool->local_data[i]);
+    }
+    g_clear_pointer(&pool->workers, g_free);
+    g_clear_pointer(&pool->cpus, g_free);
+    g_clear_pointer(&pool->local_data, g_free);
+    g_mutex_clear(&pool->tasks_mutex);
+    g_mutex_clear(&pool->mutex);
+    g_cond_clear(&pool->cond);
+
     g_clear_pointer(&pool, g_free);
 }
 
-GList *
-fsearch_thread_pool_get_threads(FsearchThreadPool *pool) {
+uint32_t
+fsearch_thread_pool_get_num_threads(FsearchThreadPool *pool) {
+    g_return_val_if_fail(pool, 0);
+    return pool->num_threads;
+}
+
+int32_t
+fsearch_thread_pool_get_thread_index(FsearchThreadPool *pool) {
+    g_return_val_if_fail(pool, -1);
+    FsearchThreadPoolWorker *worker = get_current_worker(pool);
+    return worker ? (int32_t)worker->idx : -1;
+}
+
+int64_t
+fsearch_thread_pool_get_busy_time(FsearchThreadPool *pool) {
+    return pool ? __atomic_load_n(&pool->busy_time, __ATOMIC_RELAXED) : 0;
+}
+
+FsearchThreadPoolGroup *
+fsearch_thread_pool_group_new(FsearchThreadPool *pool) {
     g_return_val_if_fail(pool, NULL);
-    return pool->threads;
+
+    FsearchThreadPoolGroup *group = g_new0(FsearchThreadPoolGroup, 1);
+    group->pool = pool;
+    g_mutex_init(&group->mutex);
+    g_cond_init(&group->cond);
+    return group;
 }
 
-gpointer
-fsearch_thread_pool_get_data(FsearchThreadPool *pool, GList *thread) {
-    if (!pool || !thread) {
-        return NULL;
+void
+fsearch_thread_pool_group_free(FsearchThreadPoolGroup *group) {
+    g_return_if_fail(group);
+
+    fsearch_thread_pool_group_wait(group);
+    g_mutex_clear(&group->mutex);
+    g_cond_clear(&group->cond);
+    g_clear_pointer(&group, g_free);
+}
+
+void
+fsearch_thread_pool_group_push(FsearchThreadPoolGroup *group, FsearchThreadPoolFunc func, void *data) {
+    g_return_if_fail(group);
+    g_return_if_fail(func);
+
+    FsearchThreadPool *pool = group->pool;
+    FsearchThreadPoolTask *task = g_new0(FsearchThreadPoolTask, 1);
+    task->func = func;
+    task->data = data;
+    task->group = group;
+
+    g_mutex_lock(&group->mutex);
+    group->num_pending++;
+    g_mutex_unlock(&group->mutex);
+
+    FsearchThreadPoolWorker *worker = get_current_worker(pool);
+    GQueue *tasks = worker ? &worker->tasks : &pool->tasks;
+    GMutex *tasks_mutex = worker ? &worker->tasks_mutex : &pool->tasks_mutex;
+    g_mutex_lock(tasks_mutex);
+    g_queue_push_tail(tasks, task);
+    g_mutex_unlock(tasks_mutex);
+
+    // idle threads check the number of queued tasks with the lock held before they go to sleep,
+    // so they either see the new task or get woken up
+    g_atomic_int_inc(&pool->num_queued);
+    g_mutex_lock(&pool->mutex);
+    if (pool->num_sleeping > 0) {
+        g_cond_signal(&pool->cond);
     }
-    if (!thread_pool_has_thread(pool, thread)) {
-        return NULL;
+    g_mutex_unlock(&pool->mutex);
+}
+
+void
+fsearch_thread_pool_group_wait(FsearchThreadPoolGroup *group) {
+    g_return_if_fail(group);
+
+    FsearchThreadPoolWorker *worker = get_current_worker(group->pool);
+    if (!worker) {
+        g_mutex_lock(&group->mutex);
+        while (group->num_pending > 0) {
+            g_cond_wait(&group->cond, &group->mutex);
+        }
+        g_mutex_unlock(&group->mutex);
+        return;
     }
-    FsearchThreadPoolContext *ctx = thread->data;
-    if (!ctx) {
-        return NULL;
+
+    // A thread of the pool helps with the queued tasks, otherwise the pool would run out of threads when tasks
+    // wait for other tasks.
+    while (true) {
+        FsearchThreadPoolTask *task = find_task(group->pool, worker);
+        if (task) {
+            run_task(task);
+            continue;
+        }
+        g_mutex_lock(&group->mutex);
+        if (group->num_pending > 0) {
+            g_cond_wait_until(&group->cond, &group->mutex, g_get_monotonic_time() + GROUP_WAIT_TIMEOUT_US);
+        }
+        const bool done = group->num_pending == 0;
+        g_mutex_unlock(&group->mutex);
+        if (done) {
+            break;
+        }
     }
-    return ctx->thread_data;
 }
 
-bool
-fsearch_thread_pool_task_is_idle(FsearchThreadPool *pool, GList *thread) {
-    bool res = false;
-    if (!thread_pool_has_thread(pool, thread)) {
-        return res;
+void
+fsearch_thread_pool_run(FsearchThreadPool *pool,
+                        FsearchThreadPoolFunc func,
+                        void *contexts,
+                        size_t context_size,
+                        uint32_t num_contexts) {
+    if (!pool || num_contexts < 2) {
+        const int64_t start = g_get_monotonic_time();
+        for (uint32_t i = 0; i < num_contexts; i++) {
+            func((char *)contexts + i * context_size);
+        }
+        if (pool) {
+            add_busy_time(pool, get_current_worker(pool), start);
+        }
+        return;
     }
-    FsearchThreadPoolContext *ctx = thread->data;
-    if (!ctx) {
-        return res;
+    FsearchThreadPoolGroup *group = fsearch_thread_pool_group_new(pool);
+    for (uint32_t i = 0; i < num_contexts; i++) {
+        fsearch_thread_pool_group_push(group, func, (char *)contexts + i * context_size);
     }
+    g_clear_pointer(&group, fsearch_thread_pool_group_free);
+}
 
-    res = ctx->status == THREAD_IDLE ? true : false;
+static void
+parallel_for_range(void *data) {
+    FsearchThreadPoolRange *range = data;
+    // the upper halves are left to other threads, the lower one is split further
+    while (range->end - range->start > range->grain_size) {
+        const uint32_t mid = range->start + (range->end - range->start) / 2;
+        FsearchThreadPoolRange *upper = g_new0(FsearchThreadPoolRange, 1);
+        *upper = *range;
+        upper->start = mid;
+        range->end = mid;
+        fsearch_thread_pool_group_push(range->group, parallel_for_range, upper);
+    }
+    range->func(range->start, range->end, range->data);
+    g_clear_pointer(&range, g_free);
+}
 
-    return res;
+void
+fsearch_thread_pool_parallel_for(FsearchThreadPool *pool,
+                                 uint32_t start,
+                                 uint32_t end,
+                                 uint32_t grain_size,
+                                 FsearchThreadPoolRangeFunc func,
+                                 void *data) {
+    if (start >= end) {
+        return;
+    }
+    grain_size = MAX(grain_size, 1);
+    if (!pool || end - start <= grain_size) {
+        const int64_t start_time = g_get_monotonic_time();
+        func(start, end, data);
+        if (pool) {
+            add_busy_time(pool, get_current_worker(pool), start_time);
+        }
+        return;
+    }
+    FsearchThreadPoolGroup *group = fsearch_thread_pool_group_new(pool);
+    FsearchThreadPoolRange *range = g_new0(FsearchThreadPoolRange, 1);
+    *range = (FsearchThreadPoolRange){
+        .group = group,
+        .func = func,
+        .data = data,
+        .start = start,
+        .end = end,
+        .grain_size = grain_size,
+    };
+    fsearch_thread_pool_group_push(group, parallel_for_range, range);
+    g_clear_pointer(&group, fsearch_thread_pool_group_free);
 }
 
-bool
-fsearch_thread_pool_task_is_busy(FsearchThreadPool *pool, GList *thread) {
-    bool res = false;
-    if (!thread_pool_has_thread(pool, thread)) {
-        return res;
+gpointer
+fsearch_thread_pool_get_local_data(FsearchThreadPool *pool, uint32_t thread_idx, GQuark key) {
+    if (!pool || thread_idx >= pool->num_threads) {
+        return NULL;
     }
-    FsearchThreadPoolContext *ctx = thread->data;
-    if (!ctx) {
-        return res;
+    return g_datalist_id_get_data(&pool->local_data[thread_idx], key);
+}
+
+void
+fsearch_thread_pool_set_local_data(FsearchThreadPool *pool,
+                                   uint32_t thread_idx,
+                                   GQuark key,
+                                   gpointer data,
+                                   GDestroyNotify destroy_func) {
+    if (!pool || thread_idx >= pool->num_threads) {
+        return;
     }
+    g_datalist_id_set_data_full(&pool->local_data[thread_idx], key, data, destroy_func);
+}
 
-    res = ctx->status == THREAD_BUSY ? true : false;
+uint32_t *
+fsearch_thread_pool_parse_cpu_list(const char *cpu_list, uint32_t *num_cpus) {
+    g_return_val_if_fail(num_cpus, NULL);
+    *num_cpus = 0;
+    if (!cpu_list) {
+        return NULL;
+    }
 
-    return res;
+    bool listed[CPU_LIST_MAX_CPUS] = {false};
+    g_auto(GStrv) items = g_strsplit(cpu_list, ",", -1);
+    for (char **item = items; *item; item++) {
+        const char *start = g_strstrip(*item);
+        char *end = NULL;
+        if (!g_ascii_isdigit(start[0])) {
+            return NULL;
+        }
+        const guint64 first = g_ascii_strtoull(start, &end, 10);
+        guint64 last = first;
+        if (end[0] == '-') {
+            if (!g_ascii_isdigit(end[1])) {
+                return NULL;
+            }
+            last = g_ascii_strtoull(end + 1, &end, 10);
+        }
+        if (end[0] != '\0' || last < first || last >= CPU_LIST_MAX_CPUS) {
+            return NULL;
+        }
+        for (guint64 cpu = first; cpu <= last; cpu++) {
+            listed[cpu] = true;
+        }
+    }
+
+    for (uint32_t cpu = 0; cpu < CPU_LIST_MAX_CPUS; cpu++) {
+        *num_cpus += listed[cpu] ? 1 : 0;
+    }
+    if (*num_cpus == 0) {
+        return NULL;
+    }
+    uint32_t *cpus = g_new0(uint32_t, *num_cpus);
+    uint32_t num_added = 0;
+    for (uint32_t cpu = 0; cpu < CPU_LIST_MAX_CPUS; cpu++) {
+        if (listed[cpu]) {
+            cpus[num_added++] = cpu;
+        }
+    }
+    return cpus;
 }
 
-bool
-fsearch_thread_pool_wait_for_thread(FsearchThreadPool *pool, GList *thread) {
-    FsearchThreadPoolContext *ctx = thread->data;
-    g_mutex_lock(&ctx->mutex);
-    while (fsearch_thread_pool_task_is_busy(pool, thread)) {
-        g_debug("[thread_pool] busy, waiting...");
-        g_cond_wait(&ctx->finished_cond, &ctx->mutex);
-        g_debug("[thread_pool] continue...");
+FsearchThreadPoolRanges *
+fsearch_thread_pool_ranges_new(FsearchThreadPool *pool, const uint32_t *part_sizes, uint32_t num_parts) {
+    FsearchThreadPoolRanges *ranges = g_new0(FsearchThreadPoolRanges, 1);
+    ranges->pool = pool;
+    ranges->num_parts = num_parts;
+    ranges->num_ranges = pool && pool->numa_aware ? pool->num_threads : 1;
+    ranges->part_offsets = g_new0(uint32_t, MAX(num_parts, 1));
+    ranges->cursors = g_new0(FsearchThreadPoolCursor, MAX(num_parts * ranges->num_ranges, 1));
+
+    uint32_t offset = 0;
+    for (uint32_t p = 0; p < num_parts; p++) {
+        ranges->part_offsets[p] = offset;
+        offset += part_sizes[p];
+        for (uint32_t r = 0; r < ranges->num_ranges; r++) {
+            FsearchThreadPoolCursor *cursor = &ranges->cursors[p * ranges->num_ranges + r];
+            cursor->next = (gint)((uint64_t)part_sizes[p] * r / ranges->num_ranges);
+            cursor->end = (uint32_t)((uint64_t)part_sizes[p] * (r + 1) / ranges->num_ranges);
+        }
     }
-    g_mutex_unlock(&ctx->mutex);
-    return true;
+    return ranges;
 }
 
-uint32_t
-fsearch_thread_pool_get_num_threads(FsearchThreadPool *pool) {
-    g_return_val_if_fail(pool, 0);
-    return pool->num_threads;
+void
+fsearch_thread_pool_ranges_free(FsearchThreadPoolRanges *ranges) {
+    g_return_if_fail(ranges);
+    g_clear_pointer(&ranges->part_offsets, g_free);
+    g_clear_pointer(&ranges->cursors, g_free);
+    g_clear_pointer(&ranges, g_free);
 }
 
 bool
-fsearch_thread_pool_push_data(FsearchThreadPool *pool,
-                              GList *thread,
-                              FsearchThreadPoolFunc thread_func,
-                              gpointer thread_data) {
-    if (!pool || !thread || !thread_func || !thread_data) {
-        return false;
-    }
-    if (!thread_pool_has_thread(pool, thread)) {
-        return false;
-    }
-    FsearchThreadPoolContext *ctx = thread->data;
-    g_mutex_lock(&ctx->mutex);
-    ctx->thread_func = thread_func;
-    ctx->thread_data = thread_data;
-    ctx->status = THREAD_BUSY;
-
-    g_cond_signal(&ctx->start_cond);
-    g_mutex_unlock(&ctx->mutex);
-    return true;
+fsearch_thread_pool_ranges_next(FsearchThreadPoolRanges *ranges, uint32_t *item) {
+    g_return_val_if_fail(ranges, false);
+
+    FsearchThreadPoolWorker *worker = ranges->num_ranges > 1 ? get_current_worker(ranges->pool) : NULL;
+    for (uint32_t p = 0; p < ranges->num_parts; p++) {
+        FsearchThreadPoolCursor *cursors = &ranges->cursors[p * ranges->num_ranges];
+        // the range of the thread itself comes first, then the ones of the threads it would steal tasks from
+        for (uint32_t i = 0; i < ranges->num_ranges; i++) {
+            const uint32_t r = !worker ? i : i == 0 ? worker->idx : worker->victims[i - 1];
+            FsearchThreadPoolCursor *cursor = &cursors[r];
+            if ((uint32_t)g_atomic_int_get(&cursor->next) >= cursor->end) {
+                continue;
+            }
+            const uint32_t next = (uint32_t)g_atomic_int_add(&cursor->next, 1);
+            if (next < cursor->end) {
+                *item = ranges->part_offsets[p] + next;
+                return true;
+            }
+        }
+    }
+    return false;
 }
@@ -22,41 +22,114 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// A work stealing scheduler: every thread has its own queue of tasks. Tasks pushed by a task go to the queue of its
+// thread and are run from the newest to the oldest, threads without tasks steal the oldest ones of other threads.
+// Tasks pushed from outside of the pool are queued in a shared queue.
 typedef struct FsearchThreadPool FsearchThreadPool;
-typedef void (*FsearchThreadPoolFunc)(void *data);
-;
 
-typedef enum FsearchThreadStatus { THREAD_IDLE, THREAD_BUSY, THREAD_FINISHED } FsearchThreadStatus;
+// A set of tasks which can be waited for, tasks of a group can push more tasks to it
+typedef struct FsearchThreadPoolGroup FsearchThreadPoolGroup;
+
+typedef void (*FsearchThreadPoolFunc)(void *data);
+typedef void (*FsearchThreadPoolRangeFunc)(uint32_t start, uint32_t end, void *data);
 
+// Creates a pool with one thread per processor
 FsearchThreadPool *
 fsearch_thread_pool_init(void);
 
+FsearchThreadPool *
+fsearch_thread_pool_new(uint32_t num_threads);
+
+// Creates a pool with num_threads threads, 0 means one per CPU they may run on. If cpu_list (e.g. "0-3,8") is set
+// the threads only run on those CPUs. In NUMA aware pools every thread is bound to a single CPU and consecutive
+// threads to the CPUs of the same node, threads steal from the ones on their own node first and each of them gets
+// its own range of the items handed out by FsearchThreadPoolRanges. CPU affinity is only supported on Linux.
+FsearchThreadPool *
+fsearch_thread_pool_new_with_affinity(uint32_t num_threads, const char *cpu_list, bool numa_aware);
+
+// Parses a list of CPUs and ranges of CPUs like "0-3,8". Returns the CPUs in ascending order, or NULL if the list
+// is empty or invalid.
+uint32_t *
+fsearch_thread_pool_parse_cpu_list(const char *cpu_list, uint32_t *num_cpus);
+
+// Waits for all queued tasks
 void
 fsearch_thread_pool_free(FsearchThreadPool *pool);
 
-GList *
-fsearch_thread_pool_get_threads(FsearchThreadPool *pool);
-
 uint32_t
 fsearch_thread_pool_get_num_threads(FsearchThreadPool *pool);
 
-bool
-fsearch_thread_pool_push_data(FsearchThreadPool *pool,
-                              GList *thread,
-                              FsearchThreadPoolFunc thread_func,
-                              gpointer thread_data);
+// Returns the index of the thread of pool the caller is running on, or -1 if it's not one of them
+int32_t
+fsearch_thread_pool_get_thread_index(FsearchThreadPool *pool);
 
-bool
-fsearch_thread_pool_wait_for_thread(FsearchThreadPool *pool, GList *thread);
+// Returns how many microseconds all threads spent running tasks of pool so far, including the ones callers ran
+// themselves because they weren't worth handing out. The difference before and after an operation is the time
+// the threads worked on it (and on whatever else ran on the pool meanwhile).
+int64_t
+fsearch_thread_pool_get_busy_time(FsearchThreadPool *pool);
 
-bool
-fsearch_thread_pool_task_is_busy(FsearchThreadPool *pool, GList *thread);
+FsearchThreadPoolGroup *
+fsearch_thread_pool_group_new(FsearchThreadPool *pool);
 
-bool
-fsearch_thread_pool_task_is_idle(FsearchThreadPool *pool, GList *thread);
+// Waits for all tasks of the group
+void
+fsearch_thread_pool_group_free(FsearchThreadPoolGroup *group);
+
+void
+fsearch_thread_pool_group_push(FsearchThreadPoolGroup *group, FsearchThreadPoolFunc func, void *data);
+
+// Returns once all tasks of the group are done. Threads of the pool run other tasks meanwhile, so tasks can wait
+// for the tasks they pushed.
+void
+fsearch_thread_pool_group_wait(FsearchThreadPoolGroup *group);
 
+// Calls func for each of the num_contexts contexts, which are context_size bytes apart, and waits for all of them.
+// Without a pool they're run one after another by the caller.
+void
+fsearch_thread_pool_run(FsearchThreadPool *pool,
+                        FsearchThreadPoolFunc func,
+                        void *contexts,
+                        size_t context_size,
+                        uint32_t num_contexts);
+
+// Splits the range [start, end) in halves until they have no more than grain_size items, calls func for every range
+// and waits for all of them. Without a pool func is called once for the whole range.
+void
+fsearch_thread_pool_parallel_for(FsearchThreadPool *pool,
+                                 uint32_t start,
+                                 uint32_t end,
+                                 uint32_t grain_size,
+                                 FsearchThreadPoolRangeFunc func,
+                                 void *data);
+
+// The pool can keep data for every thread index, so tasks can reuse e.g. scratch buffers instead of allocating them
+// every time. The data is freed with destroy_func together with the pool. Tasks can run on any thread, so the data
+// of an index must only be used by one task at a time, e.g. the i-th of the contexts passed to
+// fsearch_thread_pool_run.
 gpointer
-fsearch_thread_pool_get_data(FsearchThreadPool *pool, GList *thread);
+fsearch_thread_pool_get_local_data(FsearchThreadPool *pool, uint32_t thread_idx, GQuark key);
+
+void
+fsearch_thread_pool_set_local_data(FsearchThreadPool *pool,
+                                   uint32_t thread_idx,
+                                   GQuark key,
+                                   gpointer data,
+                                   GDestroyNotify destroy_func);
+
+// Hands out the items of num_parts parts, which have part_sizes[i] items each and are numbered consecutively, to the
+// tasks of a pool. The items of a part are handed out before the ones of the next part. In NUMA aware pools every
+// part is split into one range per thread, tasks get items of the range of the thread they run on first, then of
+// the threads on the same node. So memory which was first touched by the tasks of a thread, e.g. while the items
+// were loaded, is mostly used by tasks on the same node later on.
+typedef struct FsearchThreadPoolRanges FsearchThreadPoolRanges;
+
+FsearchThreadPoolRanges *
+fsearch_thread_pool_ranges_new(FsearchThreadPool *pool, const uint32_t *part_sizes, uint32_t num_parts);
+
+void
+fsearch_thread_pool_ranges_free(FsearchThreadPoolRanges *ranges);
 
+// Returns false once all items are handed out
 bool
-fsearch_thread_pool_set_task_finished(FsearchThreadPool *pool, GList *thread);
+fsearch_thread_pool_ranges_next(FsearchThreadPoolRanges *ranges, uint32_t *item);
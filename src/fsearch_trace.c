@@ -0,0 +1,199 @@
+#define G_LOG_DOMAIN "fsearch-trace"
+
+#include <config.h>
+
+#include "fsearch_trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef HAVE_TRACING
+
+// a trace which gets that large is cut off, so a forgotten FSEARCH_TRACE_FILE can't use up all memory
+#define TRACE_MAX_EVENTS (4 * 1024 * 1024)
+
+typedef struct {
+    const char *category;
+    const char *name;
+    int64_t start;
+    int64_t duration;
+    uint32_t thread_id;
+} TraceEvent;
+
+typedef struct {
+    char *file_path;
+    GMutex mutex;
+    GArray *events;
+    // the names of the threads, indexed by their trace thread id
+    GPtrArray *thread_names;
+    uint64_t num_dropped;
+} Trace;
+
+static Trace *trace = NULL;
+static GPrivate trace_thread_id = G_PRIVATE_INIT(NULL);
+
+static void
+trace_write_string(FILE *fp, const char *string) {
+    fputc('"', fp);
+    for (const char *c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(fp, "\\%c", *c);
+        }
+        else if ((unsigned char)*c < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*c);
+        }
+        else {
+            fputc(*c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void
+trace_write(void) {
+    g_mutex_lock(&trace->mutex);
+    FILE *fp = fopen(trace->file_path, "w");
+    if (!fp) {
+        g_warning("[trace] failed to open %s", trace->file_path);
+        g_mutex_unlock(&trace->mutex);
+        return;
+    }
+    const int pid = (int)getpid();
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (uint32_t i = 0; i < trace->thread_names->len; i++) {
+        fprintf(fp, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", pid, i + 1);
+        trace_write_string(fp, g_ptr_array_index(trace->thread_names, i));
+        fprintf(fp, "}},\n");
+    }
+    for (uint32_t i = 0; i < trace->events->len; i++) {
+        TraceEvent *event = &g_array_index(trace->events, TraceEvent, i);
+        fprintf(fp, "{\"ph\":\"X\",\"cat\":");
+        trace_write_string(fp, event->category);
+        fprintf(fp, ",\"name\":");
+        trace_write_string(fp, event->name);
+        fprintf(fp,
+                ",\"pid\":%d,\"tid\":%u,\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT "},\n",
+                pid,
+                event->thread_id,
+                event->start,
+                event->duration);
+    }
+    fprintf(fp,
+            "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,"
+            "\"args\":{\"name\":\"fsearch\",\"dropped_events\":%" G_GUINT64_FORMAT "}}\n]}\n",
+            pid,
+            trace->num_dropped);
+    if (fclose(fp) != 0) {
+        g_warning("[trace] failed to write %s", trace->file_path);
+    }
+    g_mutex_unlock(&trace->mutex);
+}
+
+static bool
+trace_is_enabled(void) {
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        const char *file_path = g_getenv("FSEARCH_TRACE_FILE");
+        if (file_path && *file_path) {
+            Trace *t = calloc(1, sizeof(Trace));
+            g_assert(t);
+            t->file_path = g_strdup(file_path);
+            g_mutex_init(&t->mutex);
+            t->events = g_array_sized_new(FALSE, FALSE, sizeof(TraceEvent), 4096);
+            t->thread_names = g_ptr_array_new_with_free_func(g_free);
+            trace = t;
+            atexit(trace_write);
+        }
+        g_once_init_leave(&initialized, 1);
+    }
+    return trace != NULL;
+}
+
+// Must be called with the lock of the trace held
+static uint32_t
+trace_get_thread_id(void) {
+    uint32_t thread_id = GPOINTER_TO_UINT(g_private_get(&trace_thread_id));
+    if (thread_id == 0) {
+        char name[64] = "";
+#ifdef __linux__
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+#endif
+        g_ptr_array_add(trace->thread_names, g_strdup(name));
+        thread_id = trace->thread_names->len;
+        g_private_set(&trace_thread_id, GUINT_TO_POINTER(thread_id));
+    }
+    return thread_id;
+}
+
+int64_t
+fsearch_trace_begin(void) {
+    return trace_is_enabled() ? g_get_monotonic_time() : 0;
+}
+
+void
+fsearch_trace_end(int64_t start, const char *category, const char *name) {
+    if (start == 0 || !trace_is_enabled()) {
+        return;
+    }
+    fsearch_trace_add(category, name, start, g_get_monotonic_time());
+}
+
+void
+fsearch_trace_add(const char *category, const char *name, int64_t start, int64_t end) {
+    if (start == 0 || !trace_is_enabled()) {
+        return;
+    }
+    g_mutex_lock(&trace->mutex);
+    if (trace->events->len < TRACE_MAX_EVENTS) {
+        TraceEvent event = {
+            .category = category,
+            .name = name,
+            .start = start,
+            .duration = MAX(end - start, 0),
+            .thread_id = trace_get_thread_id(),
+        };
+        g_array_append_val(trace->events, event);
+    }
+    else {
+        trace->num_dropped++;
+    }
+    g_mutex_unlock(&trace->mutex);
+}
+
+void
+fsearch_trace_lock(GMutex *mutex, const char *name) {
+    if (!trace_is_enabled()) {
+        g_mutex_lock(mutex);
+        return;
+    }
+    if (g_mutex_trylock(mutex)) {
+        return;
+    }
+    const int64_t start = g_get_monotonic_time();
+    g_mutex_lock(mutex);
+    fsearch_trace_add("lock", name, start, g_get_monotonic_time());
+}
+
+#else
+
+int64_t
+fsearch_trace_begin(void) {
+    return 0;
+}
+
+void
+fsearch_trace_end(int64_t start, const char *category, const char *name) {
+}
+
+void
+fsearch_trace_add(const char *category, const char *name, int64_t start, int64_t end) {
+}
+
+void
+fsearch_trace_lock(GMutex *mutex, const char *name) {
+    g_mutex_lock(mutex);
+}
+
+#endif
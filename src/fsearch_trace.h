@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Spans of the expensive phases (scanning, loading, saving, searching, sorting, drawing) in the Chrome trace event
+// format, which Perfetto (ui.perfetto.dev), chrome://tracing and sysprof can open.
+//
+// Tracing is off unless the environment variable FSEARCH_TRACE_FILE names the file the trace gets written to when
+// the process exits. Builds with -Dtracing=false leave it out completely.
+
+// Returns the start of a span, or 0 if tracing is off
+int64_t
+fsearch_trace_begin(void);
+
+// Adds the span from start (see fsearch_trace_begin) until now. category and name must be static strings.
+void
+fsearch_trace_end(int64_t start, const char *category, const char *name);
+
+// Adds a span with the given monotonic start and end times, e.g. how long a task was queued before it ran
+void
+fsearch_trace_add(const char *category, const char *name, int64_t start, int64_t end);
+
+// Locks mutex, and if it was held by another thread adds how long that took as a span
+void
+fsearch_trace_lock(GMutex *mutex, const char *name);
@@ -0,0 +1,481 @@
+#define G_LOG_DOMAIN "fsearch-trigram-index"
+
+#include "fsearch_trigram_index.h"
+#include "fsearch_database_entry.h"
+#include "fsearch_index_delta.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every byte is mapped to one of 64 classes, so a trigram key fits into 18 bits
+#define TRIGRAM_NUM_KEYS (64 * 64 * 64)
+// Building the index in parallel only pays off for large arrays
+#define TRIGRAM_MIN_ENTRIES_PER_THREAD 65536
+// Lists which are this much longer than the current candidates get searched instead of merged
+#define TRIGRAM_GALLOP_FACTOR 16
+
+typedef struct {
+    FsearchIndexDeltaTable table;
+    // the positions of the entries which contain the trigram key are stored at offsets[key]..offsets[key + 1]
+    uint64_t *offsets;
+    uint32_t *positions;
+} TrigramPostings;
+
+struct FsearchTrigramIndex {
+    FsearchIndexDelta delta;
+
+    volatile int ref_count;
+};
+
+typedef struct {
+    TrigramPostings *postings;
+    uint32_t start;
+    uint32_t end;
+    // the number of entries per key in the first pass, the next write position per key in the second one
+    uint64_t *counts;
+    bool write_positions;
+} TrigramBuildContext;
+
+static inline uint32_t
+get_byte_class(uint8_t c) {
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 1;
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 1;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 27;
+    }
+    if (c >= 0x80) {
+        return 37 + (c % 16);
+    }
+    return 53 + (c % 11);
+}
+
+uint32_t
+fsearch_trigram_get_key(const char *str) {
+    const uint8_t *s = (const uint8_t *)str;
+    return get_byte_class(s[0]) << 12 | get_byte_class(s[1]) << 6 | get_byte_class(s[2]);
+}
+
+// Stores the distinct trigram keys of str in keys. seen must be cleared, it's cleared again when done.
+static void
+get_trigram_keys(const char *str, size_t len, uint64_t *seen, GArray *keys) {
+    g_array_set_size(keys, 0);
+    if (len < 3) {
+        return;
+    }
+    const uint8_t *s = (const uint8_t *)str;
+    uint32_t key = get_byte_class(s[0]) << 6 | get_byte_class(s[1]);
+    for (size_t i = 2; i < len; i++) {
+        key = ((key << 6) | get_byte_class(s[i])) & (TRIGRAM_NUM_KEYS - 1);
+        const uint64_t bit = UINT64_C(1) << (key % 64);
+        if (!(seen[key / 64] & bit)) {
+            seen[key / 64] |= bit;
+            g_array_append_val(keys, key);
+        }
+    }
+    for (uint32_t i = 0; i < keys->len; i++) {
+        const uint32_t k = g_array_index(keys, uint32_t, i);
+        seen[k / 64] &= ~(UINT64_C(1) << (k % 64));
+    }
+}
+
+static void
+trigram_build_worker(void *data) {
+    TrigramBuildContext *ctx = data;
+    TrigramPostings *postings = ctx->postings;
+
+    uint64_t *seen = calloc(TRIGRAM_NUM_KEYS / 64, sizeof(uint64_t));
+    g_assert(seen);
+    g_autoptr(GArray) keys = g_array_sized_new(FALSE, FALSE, sizeof(uint32_t), 256);
+
+    for (uint32_t pos = ctx->start; pos < ctx->end; pos++) {
+        FsearchDatabaseEntry *entry = darray_get_item(postings->table.entries, pos);
+        const char *name = entry ? db_entry_get_name_raw(entry) : NULL;
+        if (!name) {
+            continue;
+        }
+        get_trigram_keys(name, strlen(name), seen, keys);
+        for (uint32_t i = 0; i < keys->len; i++) {
+            const uint32_t key = g_array_index(keys, uint32_t, i);
+            if (ctx->write_positions) {
+                postings->positions[ctx->counts[key]++] = pos;
+            }
+            else {
+                ctx->counts[key]++;
+            }
+        }
+    }
+    g_clear_pointer(&seen, free);
+}
+
+static FsearchIndexDeltaTable *
+trigram_postings_new(DynamicArray *entries, FsearchThreadPool *pool) {
+    TrigramPostings *postings = calloc(1, sizeof(TrigramPostings));
+    g_assert(postings);
+    fsearch_index_delta_table_init(&postings->table, entries);
+    postings->offsets = calloc(TRIGRAM_NUM_KEYS + 1, sizeof(uint64_t));
+    g_assert(postings->offsets);
+    const uint32_t num_entries = postings->table.num_entries;
+
+    const uint32_t max_threads = pool ? fsearch_thread_pool_get_num_threads(pool) : 1;
+    const uint32_t num_threads = CLAMP(num_entries / TRIGRAM_MIN_ENTRIES_PER_THREAD, 1, max_threads);
+    const uint32_t num_entries_per_thread = num_entries / num_threads;
+
+    TrigramBuildContext *contexts = calloc(num_threads, sizeof(TrigramBuildContext));
+    g_assert(contexts);
+    for (uint32_t i = 0; i < num_threads; i++) {
+        contexts[i].postings = postings;
+        contexts[i].start = i * num_entries_per_thread;
+        contexts[i].end = i == num_threads - 1 ? num_entries : (i + 1) * num_entries_per_thread;
+        contexts[i].counts = calloc(TRIGRAM_NUM_KEYS, sizeof(uint64_t));
+        g_assert(contexts[i].counts);
+    }
+    fsearch_thread_pool_run(pool, trigram_build_worker, contexts, sizeof(TrigramBuildContext), num_threads);
+
+    // The lists are filled by all threads at once, each one starts where the entries of the previous
+    // threads end. This way the positions in every list are sorted.
+    uint64_t num_positions = 0;
+    for (uint32_t key = 0; key < TRIGRAM_NUM_KEYS; key++) {
+        postings->offsets[key] = num_positions;
+        for (uint32_t i = 0; i < num_threads; i++) {
+            const uint64_t count = contexts[i].counts[key];
+            contexts[i].counts[key] = num_positions;
+            num_positions += count;
+        }
+    }
+    postings->offsets[TRIGRAM_NUM_KEYS] = num_positions;
+    postings->positions = malloc((num_positions + 1) * sizeof(uint32_t));
+    g_assert(postings->positions);
+
+    for (uint32_t i = 0; i < num_threads; i++) {
+        contexts[i].write_positions = true;
+    }
+    fsearch_thread_pool_run(pool, trigram_build_worker, contexts, sizeof(TrigramBuildContext), num_threads);
+
+    for (uint32_t i = 0; i < num_threads; i++) {
+        g_clear_pointer(&contexts[i].counts, free);
+    }
+    g_clear_pointer(&contexts, free);
+
+    return &postings->table;
+}
+
+static void
+trigram_postings_free(FsearchIndexDeltaTable *table) {
+    TrigramPostings *postings = (TrigramPostings *)table;
+    g_clear_pointer(&postings->table.entries, darray_unref);
+    g_clear_pointer(&postings->offsets, free);
+    g_clear_pointer(&postings->positions, free);
+    g_clear_pointer(&postings, free);
+}
+
+static uint32_t
+intersect_merge(uint32_t *candidates, uint32_t num_candidates, const uint32_t *list, uint32_t list_len) {
+    uint32_t num_results = 0;
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < num_candidates && j < list_len; i++) {
+        while (j < list_len && list[j] < candidates[i]) {
+            j++;
+        }
+        if (j < list_len && list[j] == candidates[i]) {
+            candidates[num_results++] = candidates[i];
+        }
+    }
+    return num_results;
+}
+
+static uint32_t
+intersect_search(uint32_t *candidates, uint32_t num_candidates, const uint32_t *list, uint32_t list_len) {
+    uint32_t num_results = 0;
+    uint32_t lower = 0;
+    for (uint32_t i = 0; i < num_candidates; i++) {
+        uint32_t upper = list_len;
+        while (lower < upper) {
+            const uint32_t mid = lower + (upper - lower) / 2;
+            if (list[mid] < candidates[i]) {
+                lower = mid + 1;
+            }
+            else {
+                upper = mid;
+            }
+        }
+        if (lower == list_len) {
+            break;
+        }
+        if (list[lower] == candidates[i]) {
+            candidates[num_results++] = candidates[i];
+        }
+    }
+    return num_results;
+}
+
+static gint
+compare_list_lengths(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const uint64_t *offsets = user_data;
+    const uint32_t key_a = *(const uint32_t *)a;
+    const uint32_t key_b = *(const uint32_t *)b;
+    const uint64_t len_a = offsets[key_a + 1] - offsets[key_a];
+    const uint64_t len_b = offsets[key_b + 1] - offsets[key_b];
+    return len_a < len_b ? -1 : len_a > len_b;
+}
+
+// Returns the sorted positions of the entries which contain all keys, query is the GArray of the keys
+static uint32_t *
+trigram_postings_lookup(FsearchIndexDeltaTable *table, const void *query, uint32_t *num_positions) {
+    TrigramPostings *postings = (TrigramPostings *)table;
+    GArray *keys = (GArray *)query;
+    *num_positions = 0;
+    if (keys->len == 0 || postings->table.num_entries == 0) {
+        return NULL;
+    }
+    // start with the shortest list, so every further intersection only has to deal with a few candidates
+    g_array_sort_with_data(keys, compare_list_lengths, postings->offsets);
+
+    const uint32_t first_key = g_array_index(keys, uint32_t, 0);
+    uint32_t num_candidates = postings->offsets[first_key + 1] - postings->offsets[first_key];
+    if (num_candidates == 0) {
+        return NULL;
+    }
+    uint32_t *candidates = malloc(num_candidates * sizeof(uint32_t));
+    g_assert(candidates);
+    memcpy(candidates, postings->positions + postings->offsets[first_key], num_candidates * sizeof(uint32_t));
+
+    for (uint32_t i = 1; i < keys->len && num_candidates > 0; i++) {
+        const uint32_t key = g_array_index(keys, uint32_t, i);
+        const uint32_t *list = postings->positions + postings->offsets[key];
+        const uint32_t list_len = postings->offsets[key + 1] - postings->offsets[key];
+        if (list_len / TRIGRAM_GALLOP_FACTOR > num_candidates) {
+            num_candidates = intersect_search(candidates, num_candidates, list, list_len);
+        }
+        else {
+            num_candidates = intersect_merge(candidates, num_candidates, list, list_len);
+        }
+    }
+    if (num_candidates == 0) {
+        g_clear_pointer(&candidates, free);
+    }
+    *num_positions = num_candidates;
+    return candidates;
+}
+
+static size_t
+trigram_postings_get_memory_usage(FsearchIndexDeltaTable *table) {
+    TrigramPostings *postings = (TrigramPostings *)table;
+    return sizeof(TrigramPostings) + (TRIGRAM_NUM_KEYS + 1) * sizeof(uint64_t)
+         + postings->offsets[TRIGRAM_NUM_KEYS] * sizeof(uint32_t);
+}
+
+static const FsearchIndexDeltaFuncs trigram_postings_funcs = {
+    .table_new = trigram_postings_new,
+    .table_free = trigram_postings_free,
+    .table_lookup = trigram_postings_lookup,
+    .table_get_memory_usage = trigram_postings_get_memory_usage,
+};
+
+static FsearchTrigramIndex *
+trigram_index_new(void) {
+    FsearchTrigramIndex *index = calloc(1, sizeof(FsearchTrigramIndex));
+    g_assert(index);
+    index->ref_count = 1;
+    return index;
+}
+
+static FsearchTrigramIndex *
+trigram_index_new_for_postings(TrigramPostings *postings, DynamicArray *entries) {
+    FsearchTrigramIndex *index = trigram_index_new();
+    fsearch_index_delta_init(&index->delta, &trigram_postings_funcs, &postings->table, entries);
+    return index;
+}
+
+FsearchTrigramIndex *
+fsearch_trigram_index_new(DynamicArray *entries, FsearchThreadPool *pool) {
+    g_assert(entries);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    TrigramPostings *postings = (TrigramPostings *)trigram_postings_new(entries, pool);
+    g_debug("[trigram_index] indexed %d entries with %" G_GUINT64_FORMAT " positions in %f s",
+            postings->table.num_entries,
+            postings->offsets[TRIGRAM_NUM_KEYS],
+            g_timer_elapsed(timer, NULL));
+
+    return trigram_index_new_for_postings(postings, entries);
+}
+
+FsearchTrigramIndex *
+fsearch_trigram_index_new_from_data(DynamicArray *entries, const uint8_t *data, size_t size, size_t *bytes_read) {
+    g_assert(entries);
+    g_assert(bytes_read);
+
+    uint32_t num_entries = 0;
+    uint32_t num_keys = 0;
+    const size_t offsets_size = (TRIGRAM_NUM_KEYS + 1) * sizeof(uint64_t);
+    if (size < 8 + offsets_size) {
+        return NULL;
+    }
+    memcpy(&num_entries, data, 4);
+    memcpy(&num_keys, data + 4, 4);
+    if (num_entries != darray_get_num_items(entries) || num_keys != TRIGRAM_NUM_KEYS) {
+        g_debug("[trigram_index] index doesn't belong to the entries: %d entries, %d keys", num_entries, num_keys);
+        return NULL;
+    }
+
+    TrigramPostings *postings = calloc(1, sizeof(TrigramPostings));
+    g_assert(postings);
+    fsearch_index_delta_table_init(&postings->table, entries);
+    postings->offsets = malloc(offsets_size);
+    g_assert(postings->offsets);
+    memcpy(postings->offsets, data + 8, offsets_size);
+
+    const uint64_t num_positions = postings->offsets[TRIGRAM_NUM_KEYS];
+    if (postings->offsets[0] != 0 || num_positions > (size - 8 - offsets_size) / sizeof(uint32_t)) {
+        goto load_fail;
+    }
+    postings->positions = malloc((num_positions + 1) * sizeof(uint32_t));
+    g_assert(postings->positions);
+    memcpy(postings->positions, data + 8 + offsets_size, num_positions * sizeof(uint32_t));
+
+    // lookups rely on lists which are sorted and only contain valid positions
+    for (uint32_t key = 0; key < TRIGRAM_NUM_KEYS; key++) {
+        const uint64_t start = postings->offsets[key];
+        const uint64_t end = postings->offsets[key + 1];
+        if (start > end || end > num_positions) {
+            goto load_fail;
+        }
+        for (uint64_t i = start; i < end; i++) {
+            if (postings->positions[i] >= num_entries || (i > start && postings->positions[i] <= postings->positions[i - 1])) {
+                goto load_fail;
+            }
+        }
+    }
+
+    *bytes_read = 8 + offsets_size + num_positions * sizeof(uint32_t);
+    return trigram_index_new_for_postings(postings, entries);
+
+load_fail:
+    g_debug("[trigram_index] index data is invalid");
+    trigram_postings_free(&postings->table);
+    return NULL;
+}
+
+FsearchTrigramIndex *
+fsearch_trigram_index_new_updated(FsearchTrigramIndex *index,
+                                  DynamicArray *entries,
+                                  DynamicArray *added_entries,
+                                  FsearchThreadPool *pool) {
+    g_assert(entries);
+    if (!index) {
+        return fsearch_trigram_index_new(entries, pool);
+    }
+
+    FsearchTrigramIndex *updated = trigram_index_new();
+    if (!fsearch_index_delta_init_updated(&updated->delta, &index->delta, entries, added_entries, pool)) {
+        g_clear_pointer(&updated, free);
+        return fsearch_trigram_index_new(entries, pool);
+    }
+    return updated;
+}
+
+FsearchTrigramIndex *
+fsearch_trigram_index_ref(FsearchTrigramIndex *index) {
+    if (!index || g_atomic_int_get(&index->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&index->ref_count);
+    return index;
+}
+
+void
+fsearch_trigram_index_unref(FsearchTrigramIndex *index) {
+    if (!index || g_atomic_int_get(&index->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&index->ref_count)) {
+        fsearch_index_delta_clear(&index->delta);
+        g_clear_pointer(&index, free);
+    }
+}
+
+DynamicArray *
+fsearch_trigram_index_get_entries(FsearchTrigramIndex *index) {
+    g_assert(index);
+    return index->delta.entries;
+}
+
+bool
+fsearch_trigram_index_is_built_for(FsearchTrigramIndex *index, DynamicArray *entries) {
+    g_assert(index);
+    return !index->delta.added && index->delta.base->entries == entries;
+}
+
+size_t
+fsearch_trigram_index_get_write_size(FsearchTrigramIndex *index) {
+    g_assert(index);
+    const TrigramPostings *postings = (TrigramPostings *)index->delta.base;
+    return 8 + (TRIGRAM_NUM_KEYS + 1) * sizeof(uint64_t) + postings->offsets[TRIGRAM_NUM_KEYS] * sizeof(uint32_t);
+}
+
+size_t
+fsearch_trigram_index_get_memory_usage(FsearchTrigramIndex *index) {
+    if (!index) {
+        return 0;
+    }
+    return sizeof(FsearchTrigramIndex) + fsearch_index_delta_get_memory_usage(&index->delta);
+}
+
+static size_t
+write_data(FILE *fp, const void *data, size_t data_size, size_t num_elements, bool *write_failed) {
+    if (data_size == 0 || num_elements == 0) {
+        return 0;
+    }
+    if (fwrite(data, data_size, num_elements, fp) != num_elements) {
+        *write_failed = true;
+        return 0;
+    }
+    return data_size * num_elements;
+}
+
+size_t
+fsearch_trigram_index_write(FsearchTrigramIndex *index, FILE *fp, bool *write_failed) {
+    g_assert(index);
+    g_assert(fp);
+
+    TrigramPostings *postings = (TrigramPostings *)index->delta.base;
+    const uint32_t num_entries = postings->table.num_entries;
+    const uint32_t num_keys = TRIGRAM_NUM_KEYS;
+
+    size_t bytes_written = 0;
+    bytes_written += write_data(fp, &num_entries, 4, 1, write_failed);
+    bytes_written += write_data(fp, &num_keys, 4, 1, write_failed);
+    bytes_written += write_data(fp, postings->offsets, 8, TRIGRAM_NUM_KEYS + 1, write_failed);
+    bytes_written += write_data(fp, postings->positions, 4, postings->offsets[TRIGRAM_NUM_KEYS], write_failed);
+    return bytes_written;
+}
+
+bool
+fsearch_trigram_index_lookup(FsearchTrigramIndex *index,
+                             const char *needle,
+                             size_t needle_len,
+                             uint32_t **positions,
+                             uint32_t *num_positions) {
+    g_assert(index);
+    g_assert(needle);
+    g_assert(positions);
+    g_assert(num_positions);
+
+    if (needle_len < 3) {
+        return false;
+    }
+
+    uint64_t *seen = calloc(TRIGRAM_NUM_KEYS / 64, sizeof(uint64_t));
+    g_assert(seen);
+    g_autoptr(GArray) keys = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    get_trigram_keys(needle, needle_len, seen, keys);
+    g_clear_pointer(&seen, free);
+
+    fsearch_index_delta_lookup(&index->delta, keys, positions, num_positions);
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fsearch_array.h"
+#include "fsearch_thread_pool.h"
+
+// Maps every trigram (three consecutive bytes, ASCII letters folded to lower case) of the entry names
+// to the sorted list of positions of the entries which contain it. Intersecting these lists for the
+// trigrams of a substring gives a small superset of the entries whose name contains the substring,
+// so only those have to be checked with the matchers.
+//
+// Lookups return positions in the entry array the index belongs to, which requires the idx of every
+// entry to be its position in that array. Trigrams share the slots of the index when they consist of
+// rarely used bytes, which only adds candidates and never drops any.
+typedef struct FsearchTrigramIndex FsearchTrigramIndex;
+
+// Returns the slot of the trigram at the start of str, which must be at least three bytes long
+uint32_t
+fsearch_trigram_get_key(const char *str);
+
+// Builds the index for entries, the work is split across the threads of pool (if it's not NULL).
+FsearchTrigramIndex *
+fsearch_trigram_index_new(DynamicArray *entries, FsearchThreadPool *pool);
+
+// Loads an index from data, which was written by fsearch_trigram_index_write for entries.
+// Returns NULL if data is invalid or doesn't belong to entries. Otherwise *bytes_read is set to the
+// number of bytes the index occupied in data.
+FsearchTrigramIndex *
+fsearch_trigram_index_new_from_data(DynamicArray *entries, const uint8_t *data, size_t size, size_t *bytes_read);
+
+// Returns an index for entries, which contain all entries of the array index was built for (apart from
+// removed ones) and the ones in added_entries. Instead of building the index from scratch, the existing
+// one gets reused and only the added entries are indexed, until they make up a significant part of it.
+FsearchTrigramIndex *
+fsearch_trigram_index_new_updated(FsearchTrigramIndex *index,
+                                  DynamicArray *entries,
+                                  DynamicArray *added_entries,
+                                  FsearchThreadPool *pool);
+
+FsearchTrigramIndex *
+fsearch_trigram_index_ref(FsearchTrigramIndex *index);
+
+void
+fsearch_trigram_index_unref(FsearchTrigramIndex *index);
+
+// The array the positions returned by fsearch_trigram_index_lookup refer to
+DynamicArray *
+fsearch_trigram_index_get_entries(FsearchTrigramIndex *index);
+
+// Returns true if index was built for exactly entries, i.e. it can be written for them
+bool
+fsearch_trigram_index_is_built_for(FsearchTrigramIndex *index, DynamicArray *entries);
+
+size_t
+fsearch_trigram_index_get_write_size(FsearchTrigramIndex *index);
+
+// Returns the number of bytes allocated for the postings of index, postings which are shared with other indexes
+// are included
+size_t
+fsearch_trigram_index_get_memory_usage(FsearchTrigramIndex *index);
+
+size_t
+fsearch_trigram_index_write(FsearchTrigramIndex *index, FILE *fp, bool *write_failed);
+
+// Looks up the candidates for names which contain needle. Returns false if needle is too short to
+// narrow the entries down. Otherwise *positions is set to the sorted positions of the candidates,
+// which must be freed with free (it's NULL if there are none).
+bool
+fsearch_trigram_index_lookup(FsearchTrigramIndex *index,
+                             const char *needle,
+                             size_t needle_len,
+                             uint32_t **positions,
+                             uint32_t *num_positions);
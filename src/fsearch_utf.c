@@ -5,8 +5,24 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <unicode/uchar.h>
 #include <unicode/ustring.h>
 
+// the characters below that get folded with a table instead of ICU
+#define UTF_FOLD_TABLE_END 0x0500
+// no character in the table folds or decomposes to more code units
+#define UTF_FOLD_TABLE_MAX_UNITS 3
+
+typedef struct {
+    UChar folded[UTF_FOLD_TABLE_MAX_UNITS];
+    UChar decomposed[UTF_FOLD_TABLE_MAX_UNITS];
+    // 0 if the character must be folded by ICU
+    uint8_t folded_len;
+    uint8_t decomposed_len;
+} UtfFoldTableEntry;
+
+static UtfFoldTableEntry utf_fold_table[UTF_FOLD_TABLE_END];
+
 void
 fsearch_utf_builder_init(FsearchUtfBuilder *builder, int32_t num_characters) {
     g_return_if_fail(builder);
@@ -36,6 +52,9 @@ fsearch_utf_builder_init(FsearchUtfBuilder *builder, int32_t num_characters) {
     builder->string_folded_len = 0;
     builder->string_normalized_folded = calloc(builder->num_characters, sizeof(UChar));
     builder->string_normalized_folded_len = 0;
+    builder->string_utf8_is_folded_and_normalized = false;
+    builder->string_utf8_normalized_folded = calloc(builder->num_characters, sizeof(char));
+    builder->string_utf8_normalized_folded_len = 0;
 }
 
 void
@@ -45,10 +64,10 @@ fsearch_utf_builder_clear(FsearchUtfBuilder *builder) {
     }
     builder->initialized = false;
     g_clear_pointer(&builder->case_map, ucasemap_close);
-    g_clear_pointer(&builder->string, free);
     g_clear_pointer(&builder->string_utf8_folded, free);
     g_clear_pointer(&builder->string_folded, free);
     g_clear_pointer(&builder->string_normalized_folded, free);
+    g_clear_pointer(&builder->string_utf8_normalized_folded, free);
 }
 
 bool
@@ -79,9 +98,16 @@ fsearch_utf_builder_normalize_and_fold_case(FsearchUtfBuilder *builder,
         goto fail;
     }
 
+    const size_t len = strlen(string);
+    if (g_str_is_ascii(string)) {
+        return fsearch_utf_builder_fold_case_ascii(builder, string, len);
+    }
+    if (fsearch_utf_builder_fold_case_table(builder, string, len)) {
+        return true;
+    }
+
     UErrorCode status = U_ZERO_ERROR;
 
-    builder->string = g_strdup(string);
     // first perform case folding (this can be done while our string is still in UTF8 form)
     builder->string_utf8_folded_len =
         ucasemap_utf8FoldCase(builder->case_map, builder->string_utf8_folded, builder->num_characters, string, -1, &status);
@@ -89,6 +115,8 @@ fsearch_utf_builder_normalize_and_fold_case(FsearchUtfBuilder *builder,
         goto fail;
     }
     builder->string_utf8_is_folded = true;
+    builder->string_utf8_is_folded_and_normalized = false;
+    builder->string_utf8_normalized_folded_len = 0;
 
     // then convert folded UTF8 string to UTF16 for normalizer
     u_strFromUTF8(builder->string_folded,
@@ -141,7 +169,205 @@ fail:
     builder->string_utf8_folded_len = 0;
     builder->string_folded_len = 0;
     builder->string_normalized_folded_len = 0;
+    builder->string_utf8_normalized_folded_len = 0;
     builder->string_is_folded_and_normalized = false;
     builder->string_utf8_is_folded = false;
+    builder->string_utf8_is_folded_and_normalized = false;
     return false;
 }
+
+bool
+fsearch_utf_builder_fold_case_ascii(FsearchUtfBuilder *builder, const char *string, size_t len) {
+    g_assert(builder);
+    // a Turkic capital I folds to the two byte dotless i
+    if (!builder->initialized || len * 2 >= (size_t)builder->num_characters) {
+        builder->string_utf8_folded_len = 0;
+        builder->string_folded_len = 0;
+        builder->string_normalized_folded_len = 0;
+        builder->string_utf8_normalized_folded_len = 0;
+        builder->string_is_folded_and_normalized = false;
+        builder->string_utf8_is_folded = false;
+        builder->string_utf8_is_folded_and_normalized = false;
+        return false;
+    }
+
+    const bool turkic = builder->fold_options == U_FOLD_CASE_EXCLUDE_SPECIAL_I;
+    int32_t utf8_len = 0;
+    for (size_t i = 0; i < len; i++) {
+        const char c = string[i];
+        if (c == 'I' && turkic) {
+            // U+0131 LATIN SMALL LETTER DOTLESS I
+            builder->string_utf8_folded[utf8_len++] = (char)0xc4;
+            builder->string_utf8_folded[utf8_len++] = (char)0xb1;
+            builder->string_normalized_folded[i] = 0x0131;
+            continue;
+        }
+        const char folded = g_ascii_tolower(c);
+        builder->string_utf8_folded[utf8_len++] = folded;
+        builder->string_normalized_folded[i] = (UChar)folded;
+    }
+    builder->string_utf8_folded[utf8_len] = '\0';
+    builder->string_utf8_folded_len = utf8_len;
+    memcpy(builder->string_folded, builder->string_normalized_folded, len * sizeof(UChar));
+    builder->string_folded_len = (int32_t)len;
+    builder->string_normalized_folded_len = (int32_t)len;
+    // ASCII and the dotless i are normalized already
+    memcpy(builder->string_utf8_normalized_folded, builder->string_utf8_folded, utf8_len + 1);
+    builder->string_utf8_normalized_folded_len = utf8_len;
+    builder->string_utf8_is_folded = true;
+    builder->string_is_folded_and_normalized = true;
+    builder->string_utf8_is_folded_and_normalized = true;
+    return true;
+}
+
+// Fills in the folded and decomposed form of every character below UTF_FOLD_TABLE_END which can be folded and
+// decomposed on its own. ICU computes them, so the table can't disagree with the ICU path.
+static void
+utf_fold_table_init(void) {
+    UErrorCode status = U_ZERO_ERROR;
+    const UNormalizer2 *normalizer = unorm2_getNFDInstance(&status);
+    g_assert(U_SUCCESS(status));
+
+    for (UChar c = 0x80; c < UTF_FOLD_TABLE_END; c++) {
+        // U+0130 LATIN CAPITAL LETTER I WITH DOT ABOVE folds differently for Turkic languages
+        if (c == 0x0130) {
+            continue;
+        }
+        UChar folded[8] = {0};
+        UChar decomposed[8] = {0};
+        status = U_ZERO_ERROR;
+        const int32_t folded_len = u_strFoldCase(folded, G_N_ELEMENTS(folded), &c, 1, U_FOLD_CASE_DEFAULT, &status);
+        const int32_t decomposed_len =
+            unorm2_normalize(normalizer, folded, folded_len, decomposed, G_N_ELEMENTS(decomposed), &status);
+        if (U_FAILURE(status) || folded_len > UTF_FOLD_TABLE_MAX_UNITS || decomposed_len > UTF_FOLD_TABLE_MAX_UNITS
+            || decomposed_len == 0) {
+            continue;
+        }
+        // Decomposing characters one by one only gives the normalized string if no combining mark has to be
+        // reordered with a mark of the character before, so every character has to start with a base character
+        if (u_getCombiningClass(decomposed[0]) != 0) {
+            continue;
+        }
+        bool is_bmp = true;
+        for (int32_t i = 0; i < folded_len; i++) {
+            is_bmp = is_bmp && !U16_IS_SURROGATE(folded[i]);
+        }
+        for (int32_t i = 0; i < decomposed_len; i++) {
+            is_bmp = is_bmp && !U16_IS_SURROGATE(decomposed[i]);
+        }
+        if (!is_bmp) {
+            continue;
+        }
+        UtfFoldTableEntry *entry = &utf_fold_table[c];
+        memcpy(entry->folded, folded, folded_len * sizeof(UChar));
+        memcpy(entry->decomposed, decomposed, decomposed_len * sizeof(UChar));
+        entry->folded_len = (uint8_t)folded_len;
+        entry->decomposed_len = (uint8_t)decomposed_len;
+    }
+}
+
+static inline int32_t
+utf8_append(char *dest, UChar c) {
+    if (c < 0x80) {
+        dest[0] = (char)c;
+        return 1;
+    }
+    if (c < 0x800) {
+        dest[0] = (char)(0xc0 | (c >> 6));
+        dest[1] = (char)(0x80 | (c & 0x3f));
+        return 2;
+    }
+    dest[0] = (char)(0xe0 | (c >> 12));
+    dest[1] = (char)(0x80 | ((c >> 6) & 0x3f));
+    dest[2] = (char)(0x80 | (c & 0x3f));
+    return 3;
+}
+
+bool
+fsearch_utf_builder_fold_case_table(FsearchUtfBuilder *builder, const char *string, size_t len) {
+    g_assert(builder);
+    if (!builder->initialized) {
+        return false;
+    }
+    static gsize table_initialized = 0;
+    if (g_once_init_enter(&table_initialized)) {
+        utf_fold_table_init();
+        g_once_init_leave(&table_initialized, 1);
+    }
+
+    // Every (two byte) character becomes at most three code units and each of them at most two bytes again, the
+    // last character must leave room for that and the terminating NUL
+    const int32_t capacity = builder->num_characters - 2 * UTF_FOLD_TABLE_MAX_UNITS - 1;
+    if (capacity <= 0) {
+        return false;
+    }
+    const bool turkic = builder->fold_options == U_FOLD_CASE_EXCLUDE_SPECIAL_I;
+    int32_t utf8_len = 0;
+    int32_t normalized_len = 0;
+    int32_t utf8_normalized_len = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (utf8_len >= capacity || normalized_len >= capacity || utf8_normalized_len >= capacity) {
+            return false;
+        }
+        const uint8_t c = (uint8_t)string[i];
+        if (c < 0x80) {
+            UChar folded = (UChar)g_ascii_tolower(c);
+            if (c == 'I' && turkic) {
+                // U+0131 LATIN SMALL LETTER DOTLESS I
+                folded = 0x0131;
+            }
+            utf8_len += utf8_append(builder->string_utf8_folded + utf8_len, folded);
+            utf8_normalized_len += utf8_append(builder->string_utf8_normalized_folded + utf8_normalized_len, folded);
+            builder->string_normalized_folded[normalized_len++] = folded;
+            continue;
+        }
+        // only two byte sequences get below UTF_FOLD_TABLE_END, 0xc0 and 0xc1 would be overlong
+        if (c < 0xc2 || c > 0xdf || i + 1 >= len || ((uint8_t)string[i + 1] & 0xc0) != 0x80) {
+            return false;
+        }
+        const uint32_t code_point = ((c & 0x1f) << 6) | ((uint8_t)string[++i] & 0x3f);
+        if (code_point >= UTF_FOLD_TABLE_END || utf_fold_table[code_point].folded_len == 0) {
+            return false;
+        }
+        const UtfFoldTableEntry *entry = &utf_fold_table[code_point];
+        for (uint32_t j = 0; j < entry->folded_len; j++) {
+            utf8_len += utf8_append(builder->string_utf8_folded + utf8_len, entry->folded[j]);
+        }
+        for (uint32_t j = 0; j < entry->decomposed_len; j++) {
+            utf8_normalized_len +=
+                utf8_append(builder->string_utf8_normalized_folded + utf8_normalized_len, entry->decomposed[j]);
+            builder->string_normalized_folded[normalized_len++] = entry->decomposed[j];
+        }
+    }
+    builder->string_utf8_folded[utf8_len] = '\0';
+    builder->string_utf8_folded_len = utf8_len;
+    builder->string_utf8_normalized_folded[utf8_normalized_len] = '\0';
+    builder->string_utf8_normalized_folded_len = utf8_normalized_len;
+    builder->string_normalized_folded_len = normalized_len;
+    // the folded UTF-16 string without normalization isn't needed by anyone
+    builder->string_folded_len = 0;
+    builder->string_utf8_is_folded = true;
+    builder->string_is_folded_and_normalized = true;
+    builder->string_utf8_is_folded_and_normalized = true;
+    return true;
+}
+
+bool
+fsearch_utf_builder_set_normalized_folded(FsearchUtfBuilder *builder, const UChar *folded, int32_t folded_len) {
+    g_assert(builder);
+    if (!builder->initialized || folded_len >= builder->num_characters) {
+        builder->string_normalized_folded_len = 0;
+        builder->string_is_folded_and_normalized = false;
+        return false;
+    }
+    memcpy(builder->string_normalized_folded, folded, folded_len * sizeof(UChar));
+    builder->string_normalized_folded_len = folded_len;
+    // the other forms aren't known
+    builder->string_folded_len = 0;
+    builder->string_utf8_folded_len = 0;
+    builder->string_utf8_normalized_folded_len = 0;
+    builder->string_utf8_is_folded = false;
+    builder->string_utf8_is_folded_and_normalized = false;
+    builder->string_is_folded_and_normalized = true;
+    return true;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <unicode/ucasemap.h>
 #include <unicode/unorm2.h>
 #include <unicode/utypes.h>
@@ -9,14 +10,16 @@ typedef struct FsearchUtfBuilder {
     UCaseMap *case_map;
     const UNormalizer2 *normalizer;
 
-    char *string;
     char *string_utf8_folded;
     UChar *string_folded;
     UChar *string_normalized_folded;
+    // the UTF-8 form of string_normalized_folded, only computed without ICU (see fsearch_utf_builder_fold_case_table)
+    char *string_utf8_normalized_folded;
 
     int32_t string_folded_len;
     int32_t string_normalized_folded_len;
     int32_t string_utf8_folded_len;
+    int32_t string_utf8_normalized_folded_len;
 
     uint32_t fold_options;
 
@@ -24,6 +27,7 @@ typedef struct FsearchUtfBuilder {
     bool initialized;
     bool string_is_folded_and_normalized;
     bool string_utf8_is_folded;
+    bool string_utf8_is_folded_and_normalized;
 } FsearchUtfBuilder;
 
 void
@@ -35,6 +39,25 @@ fsearch_utf_builder_clear(FsearchUtfBuilder *builder);
 bool
 fsearch_utf_fold_case_utf8(UCaseMap *case_map, FsearchUtfBuilder *builder, const char *string);
 
+// ASCII strings and most Latin, Greek and Cyrillic ones are folded without ICU, see
+// fsearch_utf_builder_fold_case_ascii and fsearch_utf_builder_fold_case_table
 bool
 fsearch_utf_builder_normalize_and_fold_case(FsearchUtfBuilder *builder,
                                             const char *string);
+
+// Produces the same result as fsearch_utf_builder_normalize_and_fold_case for strings which only consist of
+// ASCII characters: those are normalized already and folding them only maps letters to lower case.
+bool
+fsearch_utf_builder_fold_case_ascii(FsearchUtfBuilder *builder, const char *string, size_t len);
+
+// Produces the same result as fsearch_utf_builder_normalize_and_fold_case for strings which only consist of characters
+// below U+0500, with a table of their folded and decomposed forms. Returns false without touching the builder if the
+// string contains other characters, combining marks or invalid UTF-8: those need ICU to be normalized. Unlike ICU it
+// also sets the UTF-8 form of the folded and normalized string.
+bool
+fsearch_utf_builder_fold_case_table(FsearchUtfBuilder *builder, const char *string, size_t len);
+
+// Sets the folded and normalized form of the string to folded, as computed by
+// fsearch_utf_builder_normalize_and_fold_case before
+bool
+fsearch_utf_builder_set_normalized_folded(FsearchUtfBuilder *builder, const UChar *folded, int32_t folded_len);
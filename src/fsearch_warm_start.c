@@ -0,0 +1,227 @@
+#define G_LOG_DOMAIN "fsearch-warm-start"
+
+#include "fsearch_warm_start.h"
+#include "fsearch_database_entry.h"
+#include "fsearch_memory_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// bump it whenever the format changes, older files are ignored then
+#define WARM_START_VERSION 1
+// version, query text, filter name, query flags, sort order, ascending, rows of
+// (is folder, path of the parent, name, size, modification time)
+#define WARM_START_FORMAT "(ussuiba(bayayxx))"
+
+struct FsearchWarmStart {
+    char *query_text;
+    char *filter_name;
+    FsearchQueryFlags query_flags;
+    FsearchDatabaseIndexType sort_order;
+    bool sort_ascending;
+
+    // the rows and the folders they're in, as single entries named after their whole path
+    FsearchMemoryPool *folder_pool;
+    FsearchMemoryPool *file_pool;
+    DynamicArray *folders;
+    DynamicArray *files;
+
+    volatile int ref_count;
+};
+
+static void
+add_row(GVariantBuilder *rows, FsearchDatabaseEntry *entry, FsearchFolderPaths *folder_paths, GString *parent_path) {
+    g_string_truncate(parent_path, 0);
+    // the root folder has no parent, the empty path stands for that
+    if (db_entry_get_parent(entry)) {
+        fsearch_folder_paths_append_path(folder_paths, entry, parent_path);
+    }
+    g_variant_builder_add(rows,
+                          "(b@ay@ayxx)",
+                          db_entry_get_type(entry) == DATABASE_ENTRY_TYPE_FOLDER,
+                          g_variant_new_bytestring(parent_path->str),
+                          g_variant_new_bytestring(db_entry_get_name_raw(entry)),
+                          (gint64)db_entry_get_size(entry),
+                          (gint64)db_entry_get_mtime(entry));
+}
+
+bool
+fsearch_warm_start_save(const char *file_path,
+                        const char *query_text,
+                        const char *filter_name,
+                        FsearchQueryFlags query_flags,
+                        FsearchDatabaseIndexType sort_order,
+                        bool sort_ascending,
+                        DynamicArray *folders,
+                        DynamicArray *files,
+                        FsearchFolderPaths *folder_paths,
+                        uint32_t first_row,
+                        uint32_t max_rows) {
+    g_assert(file_path);
+
+    const uint32_t num_folders = folders ? darray_get_num_items(folders) : 0;
+    const uint32_t num_rows = num_folders + (files ? darray_get_num_items(files) : 0);
+    const uint32_t start = MIN(first_row, num_rows);
+    const uint32_t end = start + MIN(max_rows, num_rows - start);
+
+    GVariantBuilder rows;
+    g_variant_builder_init(&rows, G_VARIANT_TYPE("a(bayayxx)"));
+    g_autoptr(GString) parent_path = g_string_new(NULL);
+    for (uint32_t i = start; i < end; i++) {
+        add_row(&rows,
+                i < num_folders ? darray_get_item(folders, i) : darray_get_item(files, i - num_folders),
+                folder_paths,
+                parent_path);
+    }
+
+    g_autoptr(GVariant) variant = g_variant_ref_sink(g_variant_new(WARM_START_FORMAT,
+                                                                   WARM_START_VERSION,
+                                                                   query_text ? query_text : "",
+                                                                   filter_name ? filter_name : "",
+                                                                   query_flags,
+                                                                   sort_order,
+                                                                   sort_ascending,
+                                                                   &rows));
+    g_autoptr(GError) error = NULL;
+    if (!g_file_set_contents(file_path, g_variant_get_data(variant), (gssize)g_variant_get_size(variant), &error)) {
+        g_debug("[warm_start] failed to save %s: %s", file_path, error->message);
+        return false;
+    }
+    return true;
+}
+
+static FsearchDatabaseEntry *
+get_parent(FsearchWarmStart *warm_start, GHashTable *parents, const char *parent_path) {
+    FsearchDatabaseEntry *parent = g_hash_table_lookup(parents, parent_path);
+    if (!parent) {
+        parent = fsearch_memory_pool_malloc(warm_start->folder_pool);
+        db_entry_set_type(parent, DATABASE_ENTRY_TYPE_FOLDER);
+        // the paths are built from the names of all parents, the root folder has no name
+        db_entry_set_name(parent, strcmp(parent_path, G_DIR_SEPARATOR_S) == 0 ? "" : parent_path);
+        g_hash_table_insert(parents, g_strdup(parent_path), parent);
+    }
+    return parent;
+}
+
+FsearchWarmStart *
+fsearch_warm_start_load(const char *file_path) {
+    g_assert(file_path);
+
+    char *contents = NULL;
+    gsize len = 0;
+    if (!g_file_get_contents(file_path, &contents, &len, NULL)) {
+        return NULL;
+    }
+    g_autoptr(GBytes) bytes = g_bytes_new_take(contents, len);
+    g_autoptr(GVariant) variant =
+        g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(WARM_START_FORMAT), bytes, FALSE));
+
+    uint32_t version = 0;
+    const char *query_text = NULL;
+    const char *filter_name = NULL;
+    uint32_t query_flags = 0;
+    int32_t sort_order = 0;
+    gboolean sort_ascending = TRUE;
+    g_autoptr(GVariantIter) rows = NULL;
+    g_variant_get(variant,
+                  "(u&s&suiba(bayayxx))",
+                  &version,
+                  &query_text,
+                  &filter_name,
+                  &query_flags,
+                  &sort_order,
+                  &sort_ascending,
+                  &rows);
+    if (version != WARM_START_VERSION || sort_order < 0 || sort_order >= NUM_DATABASE_INDEX_TYPES) {
+        g_debug("[warm_start] ignoring %s, it's from another version", file_path);
+        return NULL;
+    }
+
+    FsearchWarmStart *warm_start = calloc(1, sizeof(FsearchWarmStart));
+    g_assert(warm_start);
+    warm_start->query_text = g_strdup(query_text);
+    warm_start->filter_name = g_strdup(filter_name);
+    warm_start->query_flags = query_flags;
+    warm_start->sort_order = sort_order;
+    warm_start->sort_ascending = sort_ascending;
+    warm_start->folder_pool =
+        fsearch_memory_pool_new(1024, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    warm_start->file_pool =
+        fsearch_memory_pool_new(1024, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    const size_t num_rows = g_variant_iter_n_children(rows);
+    warm_start->folders = darray_new(num_rows);
+    warm_start->files = darray_new(num_rows);
+    warm_start->ref_count = 1;
+
+    // the paths of the parents -> their entries
+    g_autoptr(GHashTable) parents = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gboolean is_folder = FALSE;
+    const char *parent_path = NULL;
+    const char *name = NULL;
+    gint64 size = 0;
+    gint64 mtime = 0;
+    while (g_variant_iter_next(rows, "(b^&ay^&ayxx)", &is_folder, &parent_path, &name, &size, &mtime)) {
+        FsearchDatabaseEntry *entry =
+            fsearch_memory_pool_malloc(is_folder ? warm_start->folder_pool : warm_start->file_pool);
+        db_entry_set_type(entry, is_folder ? DATABASE_ENTRY_TYPE_FOLDER : DATABASE_ENTRY_TYPE_FILE);
+        db_entry_set_name(entry, name);
+        db_entry_set_size(entry, (off_t)size);
+        db_entry_set_mtime(entry, (time_t)mtime);
+        if (parent_path[0] != '\0') {
+            db_entry_set_parent(entry, (FsearchDatabaseEntryFolder *)get_parent(warm_start, parents, parent_path));
+        }
+        darray_add_item(is_folder ? warm_start->folders : warm_start->files, entry);
+    }
+    return warm_start;
+}
+
+FsearchWarmStart *
+fsearch_warm_start_ref(FsearchWarmStart *warm_start) {
+    if (!warm_start || g_atomic_int_get(&warm_start->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&warm_start->ref_count);
+    return warm_start;
+}
+
+void
+fsearch_warm_start_unref(FsearchWarmStart *warm_start) {
+    if (!warm_start || g_atomic_int_get(&warm_start->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&warm_start->ref_count)) {
+        g_clear_pointer(&warm_start->folders, darray_unref);
+        g_clear_pointer(&warm_start->files, darray_unref);
+        g_clear_pointer(&warm_start->file_pool, fsearch_memory_pool_free_pool);
+        g_clear_pointer(&warm_start->folder_pool, fsearch_memory_pool_free_pool);
+        g_clear_pointer(&warm_start->filter_name, g_free);
+        g_clear_pointer(&warm_start->query_text, g_free);
+        g_clear_pointer(&warm_start, free);
+    }
+}
+
+bool
+fsearch_warm_start_matches(FsearchWarmStart *warm_start,
+                           const char *query_text,
+                           const char *filter_name,
+                           FsearchQueryFlags query_flags,
+                           FsearchDatabaseIndexType sort_order,
+                           bool sort_ascending) {
+    g_assert(warm_start);
+    return g_strcmp0(warm_start->query_text, query_text ? query_text : "") == 0
+        && g_strcmp0(warm_start->filter_name, filter_name ? filter_name : "") == 0
+        && warm_start->query_flags == query_flags && warm_start->sort_order == sort_order
+        && warm_start->sort_ascending == sort_ascending;
+}
+
+DynamicArray *
+fsearch_warm_start_get_folders(FsearchWarmStart *warm_start) {
+    g_assert(warm_start);
+    return darray_ref(warm_start->folders);
+}
+
+DynamicArray *
+fsearch_warm_start_get_files(FsearchWarmStart *warm_start) {
+    g_assert(warm_start);
+    return darray_ref(warm_start->files);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsearch_array.h"
+#include "fsearch_database_index.h"
+#include "fsearch_folder_paths.h"
+#include "fsearch_query_flags.h"
+
+// The first rows of the results a window showed when it was closed, so the next launch can show them right away,
+// before the database is loaded. The rows only carry what the list view displays: their name, path, size and
+// modification time.
+
+typedef struct FsearchWarmStart FsearchWarmStart;
+
+// Saves the rows of folders followed by files which start at first_row, at most max_rows of them. folder_paths may
+// be NULL.
+bool
+fsearch_warm_start_save(const char *file_path,
+                        const char *query_text,
+                        const char *filter_name,
+                        FsearchQueryFlags query_flags,
+                        FsearchDatabaseIndexType sort_order,
+                        bool sort_ascending,
+                        DynamicArray *folders,
+                        DynamicArray *files,
+                        FsearchFolderPaths *folder_paths,
+                        uint32_t first_row,
+                        uint32_t max_rows);
+
+// Returns NULL if file_path doesn't exist or wasn't written by fsearch_warm_start_save
+FsearchWarmStart *
+fsearch_warm_start_load(const char *file_path);
+
+FsearchWarmStart *
+fsearch_warm_start_ref(FsearchWarmStart *warm_start);
+
+void
+fsearch_warm_start_unref(FsearchWarmStart *warm_start);
+
+// Whether the rows are the results of a search with these settings. filter_name may be NULL.
+bool
+fsearch_warm_start_matches(FsearchWarmStart *warm_start,
+                           const char *query_text,
+                           const char *filter_name,
+                           FsearchQueryFlags query_flags,
+                           FsearchDatabaseIndexType sort_order,
+                           bool sort_ascending);
+
+// The entries stay valid as long as warm_start is referenced
+DynamicArray *
+fsearch_warm_start_get_folders(FsearchWarmStart *warm_start);
+
+DynamicArray *
+fsearch_warm_start_get_files(FsearchWarmStart *warm_start);
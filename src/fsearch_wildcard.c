@@ -0,0 +1,310 @@
+#define G_LOG_DOMAIN "fsearch-wildcard"
+
+#include "fsearch_wildcard.h"
+#include "fsearch_fuzzy.h"
+#include "fsearch_string_search.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    // the number of ? in front of the literal
+    uint32_t num_any;
+    // points into the pattern, it's not NUL terminated
+    const char *literal;
+    size_t literal_len;
+} WildcardSegment;
+
+// the segments between two *
+typedef struct {
+    uint32_t first_segment;
+    uint32_t num_segments;
+    // the piece has no ?, so it always matches this many bytes
+    bool has_fixed_len;
+    size_t len;
+} WildcardPiece;
+
+struct FsearchWildcard {
+    char *pattern;
+    bool ignore_case;
+
+    WildcardSegment *segments;
+    uint32_t num_segments;
+    WildcardPiece *pieces;
+    uint32_t num_pieces;
+
+    // no haystack which is shorter can match
+    size_t min_len;
+    char *longest_literal;
+    // the literal in front of the first wildcard
+    char *prefix;
+};
+
+static bool
+pattern_needs_regex(const char *pattern, bool ignore_case) {
+    if (strchr(pattern, '\n')) {
+        return true;
+    }
+    if (!ignore_case) {
+        return false;
+    }
+    for (const char *s = pattern; *s != '\0'; s++) {
+        const char c = g_ascii_tolower(*s);
+        if ((uint8_t)c >= 0x80 || c == 'k' || c == 's') {
+            return true;
+        }
+    }
+    return false;
+}
+
+FsearchWildcard *
+fsearch_wildcard_new(const char *pattern, bool ignore_case) {
+    g_assert(pattern);
+    if (pattern_needs_regex(pattern, ignore_case)) {
+        return NULL;
+    }
+
+    FsearchWildcard *wildcard = calloc(1, sizeof(FsearchWildcard));
+    g_assert(wildcard);
+    wildcard->pattern = g_strdup(pattern);
+    wildcard->ignore_case = ignore_case;
+    wildcard->prefix = g_strndup(pattern, strcspn(pattern, "*?"));
+
+    // there can't be more segments and pieces than characters and * plus one
+    const size_t pattern_len = strlen(pattern);
+    wildcard->segments = calloc(pattern_len + 1, sizeof(WildcardSegment));
+    g_assert(wildcard->segments);
+    wildcard->pieces = calloc(pattern_len + 1, sizeof(WildcardPiece));
+    g_assert(wildcard->pieces);
+
+    WildcardPiece *piece = &wildcard->pieces[wildcard->num_pieces++];
+    piece->has_fixed_len = true;
+    WildcardSegment segment = {};
+    size_t longest_literal_len = 0;
+    for (const char *s = wildcard->pattern;; s++) {
+        const bool ends_segment = *s == '*' || *s == '\0' || (*s == '?' && segment.literal_len > 0);
+        if (ends_segment && (segment.num_any > 0 || segment.literal_len > 0)) {
+            wildcard->segments[wildcard->num_segments++] = segment;
+            piece->num_segments++;
+            piece->len += segment.literal_len;
+            wildcard->min_len += segment.num_any + segment.literal_len;
+            if (segment.literal_len > longest_literal_len) {
+                longest_literal_len = segment.literal_len;
+                g_clear_pointer(&wildcard->longest_literal, g_free);
+                wildcard->longest_literal = g_strndup(segment.literal, segment.literal_len);
+            }
+            segment = (WildcardSegment){};
+        }
+        if (*s == '\0') {
+            break;
+        }
+        else if (*s == '*') {
+            piece = &wildcard->pieces[wildcard->num_pieces++];
+            piece->first_segment = wildcard->num_segments;
+            piece->has_fixed_len = true;
+        }
+        else if (*s == '?') {
+            segment.num_any++;
+            piece->has_fixed_len = false;
+        }
+        else {
+            if (segment.literal_len == 0) {
+                segment.literal = s;
+            }
+            segment.literal_len++;
+        }
+    }
+    return wildcard;
+}
+
+void
+fsearch_wildcard_free(FsearchWildcard *wildcard) {
+    if (!wildcard) {
+        return;
+    }
+    g_clear_pointer(&wildcard->pattern, g_free);
+    g_clear_pointer(&wildcard->longest_literal, g_free);
+    g_clear_pointer(&wildcard->prefix, g_free);
+    g_clear_pointer(&wildcard->segments, free);
+    g_clear_pointer(&wildcard->pieces, free);
+    g_clear_pointer(&wildcard, free);
+}
+
+uint32_t
+fsearch_wildcard_get_num_segments(FsearchWildcard *wildcard) {
+    g_assert(wildcard);
+    return wildcard->num_segments;
+}
+
+size_t
+fsearch_wildcard_get_segment_len(FsearchWildcard *wildcard, uint32_t idx) {
+    g_assert(wildcard);
+    g_assert(idx < wildcard->num_segments);
+    return wildcard->segments[idx].literal_len;
+}
+
+const char *
+fsearch_wildcard_get_longest_literal(FsearchWildcard *wildcard) {
+    g_assert(wildcard);
+    return wildcard->longest_literal;
+}
+
+const char *
+fsearch_wildcard_get_prefix(FsearchWildcard *wildcard) {
+    g_assert(wildcard);
+    return wildcard->prefix;
+}
+
+static inline bool
+literal_equals(FsearchWildcard *wildcard, const char *s, const char *literal, size_t len) {
+    if (!wildcard->ignore_case) {
+        return !memcmp(s, literal, len);
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (g_ascii_tolower(s[i]) != g_ascii_tolower(literal[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns true if piece matches the haystack at pos without going past end, *match_end is set to where it ends then
+static bool
+piece_match_at(FsearchWildcard *wildcard,
+               WildcardPiece *piece,
+               const char *haystack,
+               size_t pos,
+               size_t end,
+               size_t *match_end,
+               uint32_t *offsets) {
+    for (uint32_t i = piece->first_segment; i < piece->first_segment + piece->num_segments; i++) {
+        WildcardSegment *segment = &wildcard->segments[i];
+        for (uint32_t j = 0; j < segment->num_any; j++) {
+            if (pos >= end) {
+                return false;
+            }
+            pos += fsearch_fuzzy_char_len(haystack + pos, end - pos);
+        }
+        if (segment->literal_len == 0) {
+            // the segment only consists of ?
+            continue;
+        }
+        if (segment->literal_len > end - pos
+            || !literal_equals(wildcard, haystack + pos, segment->literal, segment->literal_len)) {
+            return false;
+        }
+        if (offsets) {
+            offsets[i] = (uint32_t)pos;
+        }
+        pos += segment->literal_len;
+    }
+    *match_end = pos;
+    return true;
+}
+
+static const char *
+literal_search(FsearchWildcard *wildcard, const char *haystack, size_t haystack_len, WildcardSegment *segment) {
+    if (wildcard->ignore_case) {
+        return fsearch_string_search_ascii_icase(haystack, haystack_len, segment->literal, segment->literal_len);
+    }
+    return memmem(haystack, haystack_len, segment->literal, segment->literal_len);
+}
+
+// Finds the first place after pos where piece matches without going past end, *pos is set to where it ends then
+static bool
+piece_find(FsearchWildcard *wildcard,
+           WildcardPiece *piece,
+           const char *haystack,
+           size_t *pos,
+           size_t end,
+           uint32_t *offsets) {
+    WildcardSegment *first = &wildcard->segments[piece->first_segment];
+    size_t start = *pos;
+    if (first->num_any == 0) {
+        // only the places where the first literal is found can be the start
+        const char *candidate = NULL;
+        while (start < end && (candidate = literal_search(wildcard, haystack + start, end - start, first))) {
+            start = candidate - haystack;
+            if (piece_match_at(wildcard, piece, haystack, start, end, pos, offsets)) {
+                return true;
+            }
+            start++;
+        }
+        return false;
+    }
+    for (; start < end; start += fsearch_fuzzy_char_len(haystack + start, end - start)) {
+        if (piece_match_at(wildcard, piece, haystack, start, end, pos, offsets)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+fsearch_wildcard_match(FsearchWildcard *wildcard, const char *haystack, size_t haystack_len, uint32_t *offsets) {
+    g_assert(wildcard);
+    g_assert(haystack);
+
+    // the pattern can't contain newlines and neither * nor ? match them, only a trailing one is ignored
+    const char *newline = memchr(haystack, '\n', haystack_len);
+    if (newline) {
+        if (newline != haystack + haystack_len - 1) {
+            return false;
+        }
+        haystack_len--;
+    }
+    if (haystack_len < wildcard->min_len) {
+        return false;
+    }
+
+    WildcardPiece *first = &wildcard->pieces[0];
+    size_t pos = 0;
+    if (!piece_match_at(wildcard, first, haystack, 0, haystack_len, &pos, offsets)) {
+        return false;
+    }
+    if (wildcard->num_pieces == 1) {
+        // there's no *
+        return pos == haystack_len;
+    }
+
+    // the last piece must end with the haystack, if its length is fixed that's where it starts
+    WildcardPiece *last = &wildcard->pieces[wildcard->num_pieces - 1];
+    size_t last_start = haystack_len;
+    if (last->has_fixed_len) {
+        if (haystack_len - pos < last->len) {
+            return false;
+        }
+        last_start = haystack_len - last->len;
+        size_t last_end = 0;
+        if (!piece_match_at(wildcard, last, haystack, last_start, haystack_len, &last_end, offsets)) {
+            return false;
+        }
+    }
+
+    // There's a * on both sides of the pieces in between, so matching each of them as early as possible leaves the
+    // most room for the following ones
+    for (uint32_t i = 1; i < wildcard->num_pieces - 1; i++) {
+        WildcardPiece *piece = &wildcard->pieces[i];
+        if (piece->num_segments > 0 && !piece_find(wildcard, piece, haystack, &pos, last_start, offsets)) {
+            return false;
+        }
+    }
+    if (last->has_fixed_len) {
+        return true;
+    }
+
+    // the ? of the last piece match characters of different lengths, so every start after the other pieces is tried
+    for (size_t start = pos; start <= haystack_len;) {
+        size_t last_end = 0;
+        if (piece_match_at(wildcard, last, haystack, start, haystack_len, &last_end, offsets)
+            && last_end == haystack_len) {
+            return true;
+        }
+        if (start == haystack_len) {
+            break;
+        }
+        start += fsearch_fuzzy_char_len(haystack + start, haystack_len - start);
+    }
+    return false;
+}
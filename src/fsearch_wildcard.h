@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Wildcard patterns like *.log or IMG_????.jpg, which must match the whole haystack: * matches any number of
+// characters and ? a single UTF-8 character. Neither of them matches a newline and a trailing newline of the
+// haystack is ignored, like the regular expression the pattern was converted to before.
+//
+// The pattern is split at the * into pieces and at the ? into literal segments. The first piece must match at the
+// start and the last one at the end of the haystack, which is a single comparison unless it contains a ?. The
+// pieces in between are looked up one after the other with the fast substring search (see fsearch_string_search.h).
+typedef struct FsearchWildcard FsearchWildcard;
+
+// Returns NULL if the pattern can't be matched without the regex engine. That's the case if ignore_case is set and
+// the pattern contains non-ASCII characters (they would have to be case folded) or the letters k or s (they also
+// match the Kelvin sign and the long s).
+FsearchWildcard *
+fsearch_wildcard_new(const char *pattern, bool ignore_case);
+
+void
+fsearch_wildcard_free(FsearchWildcard *wildcard);
+
+// The number of segments the pattern was split into, see fsearch_wildcard_match
+uint32_t
+fsearch_wildcard_get_num_segments(FsearchWildcard *wildcard);
+
+// The length of the literal of segment idx in bytes, 0 if the segment only consists of ?
+size_t
+fsearch_wildcard_get_segment_len(FsearchWildcard *wildcard, uint32_t idx);
+
+// The longest literal every matching haystack contains, NULL if the pattern only consists of wildcards
+const char *
+fsearch_wildcard_get_longest_literal(FsearchWildcard *wildcard);
+
+// The literal every matching haystack starts with, the empty string if the pattern starts with a wildcard
+const char *
+fsearch_wildcard_get_prefix(FsearchWildcard *wildcard);
+
+// Returns true if haystack, which doesn't need to be NUL terminated, matches the pattern. If offsets isn't NULL,
+// it receives the byte offset of the literal of every segment in the haystack (segments without a literal are left
+// out), so it must have room for fsearch_wildcard_get_num_segments offsets.
+bool
+fsearch_wildcard_match(FsearchWildcard *wildcard, const char *haystack, size_t haystack_len, uint32_t *offsets);
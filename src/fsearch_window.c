@@ -29,6 +29,7 @@
 #include "fsearch_file_utils.h"
 #include "fsearch_list_view.h"
 #include "fsearch_listview_popup.h"
+#include "fsearch_preview.h"
 #include "fsearch_result_view.h"
 #include "fsearch_statusbar.h"
 #include "fsearch_string_utils.h"
@@ -38,6 +39,13 @@
 #include "fsearch_window_actions.h"
 #include <glib/gi18n.h>
 
+// trashing and deleting files mostly waits for the filesystem, a few of them can do that at once
+#define FILE_OPERATION_NUM_THREADS 4
+// how many rows before and after the cursor are prefetched while the previewer is open
+#define PREVIEW_PREFETCH_NUM_ROWS 1
+// how many rows are saved when the window gets closed, to be shown at the next launch until the database is loaded
+#define WARM_START_NUM_ROWS 5000
+
 struct _FsearchApplicationWindow {
     GtkApplicationWindow parent_instance;
 
@@ -67,6 +75,17 @@ struct _FsearchApplicationWindow {
 
     char *active_filter_name;
 
+    // set while a search as you type waits for more input, see on_search_entry_changed
+    guint search_delay_timeout_id;
+
+    // of the running selection export and file operation, the cancel_task action cancels them too
+    GCancellable *export_cancellable;
+    GCancellable *file_operation_cancellable;
+    // set while the statusbar shows the progress of one of them
+    bool task_progress_shown;
+    // set while the results are the rows of the last launch, see db_view_set_warm_start
+    bool warm_start_shown;
+
     FsearchResultView *result_view;
 };
 
@@ -85,6 +104,14 @@ typedef enum {
 static void
 perform_search(FsearchApplicationWindow *win);
 
+static void
+remove_search_delay_timeout(FsearchApplicationWindow *win) {
+    if (win->search_delay_timeout_id) {
+        g_source_remove(win->search_delay_timeout_id);
+        win->search_delay_timeout_id = 0;
+    }
+}
+
 static void
 show_overlay(FsearchApplicationWindow *win, FsearchOverlay overlay);
 
@@ -102,24 +129,7 @@ get_active_filter(FsearchApplicationWindow *win) {
 static FsearchQueryFlags
 get_query_flags() {
     FsearchApplication *app = FSEARCH_APPLICATION_DEFAULT;
-    FsearchConfig *config = fsearch_application_get_config(app);
-    FsearchQueryFlags flags = 0;
-    if (config->match_case) {
-        flags |= QUERY_FLAG_MATCH_CASE;
-    }
-    if (config->auto_match_case) {
-        flags |= QUERY_FLAG_AUTO_MATCH_CASE;
-    }
-    if (config->enable_regex) {
-        flags |= QUERY_FLAG_REGEX;
-    }
-    if (config->search_in_path) {
-        flags |= QUERY_FLAG_SEARCH_IN_PATH;
-    }
-    if (config->auto_search_in_path) {
-        flags |= QUERY_FLAG_AUTO_SEARCH_IN_PATH;
-    }
-    return flags;
+    return config_get_query_flags(fsearch_application_get_config(app));
 }
 
 static const char *
@@ -297,6 +307,9 @@ fsearch_application_window_finalize(GObject *object) {
     FsearchApplicationWindow *self = (FsearchApplicationWindow *)object;
     g_assert(FSEARCH_IS_APPLICATION_WINDOW(self));
 
+    remove_search_delay_timeout(self);
+    g_clear_object(&self->export_cancellable);
+    g_clear_object(&self->file_operation_cancellable);
     g_clear_pointer(&self->active_filter_name, free);
     g_clear_pointer(&self->result_view->database_view, db_view_unref);
     g_clear_pointer(&self->result_view, fsearch_result_view_free);
@@ -359,6 +372,9 @@ fsearch_window_db_view_apply_changes(FsearchApplicationWindow *win) {
     db_view_unlock(win->result_view->database_view);
 
     fsearch_statusbar_set_num_search_results(FSEARCH_STATUSBAR(win->statusbar), num_rows);
+    FsearchOperationStats stats[NUM_FSEARCH_OPERATIONS];
+    db_view_get_operation_stats(win->result_view->database_view, stats);
+    fsearch_statusbar_set_operation_stats(FSEARCH_STATUSBAR(win->statusbar), stats);
 
     fsearch_result_view_row_cache_reset(win->result_view);
     fsearch_list_view_set_config(win->result_view->list_view,
@@ -417,11 +433,20 @@ perform_search(FsearchApplicationWindow *win) {
     if (!win || !win->result_view->database_view) {
         return;
     }
+    remove_search_delay_timeout(win);
 
     const gchar *text = get_query_text(win);
     db_view_set_query_text(win->result_view->database_view, text);
 }
 
+static gboolean
+on_search_delay_timeout(gpointer user_data) {
+    FsearchApplicationWindow *win = user_data;
+    win->search_delay_timeout_id = 0;
+    perform_search(win);
+    return G_SOURCE_REMOVE;
+}
+
 typedef struct {
     uint32_t num_folders;
     uint32_t num_files;
@@ -542,9 +567,18 @@ on_search_entry_changed(GtkEntry *entry, gpointer user_data) {
 
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
 
-    if (config->search_as_you_type) {
+    if (!config->search_as_you_type) {
+        return;
+    }
+    // When searches are slow, the search only starts once no more keys were pressed for about as long as a search
+    // takes, so they don't pile up while typing
+    const uint32_t delay = db_view_get_search_delay(win->result_view->database_view, get_query_text(win));
+    if (delay == 0) {
         perform_search(win);
+        return;
     }
+    remove_search_delay_timeout(win);
+    win->search_delay_timeout_id = g_timeout_add(delay, on_search_delay_timeout, win);
 }
 
 static char *
@@ -606,6 +640,19 @@ fsearch_results_sort_func(int sort_order, GtkSortType sort_type, gpointer user_d
     // win->result_view->sort_type = fsearch_list_view_get_sort_type(win->result_view->list_view);
     // win->result_view->sort_order = sort_order;
 
+    // the rows at the current scroll position get sorted first, descending orders show the entries from the back
+    uint32_t first_row = 0;
+    uint32_t num_rows = 0;
+    fsearch_list_view_get_visible_rows(win->result_view->list_view, &first_row, &num_rows);
+    db_view_lock(win->result_view->database_view);
+    const uint32_t num_entries = db_view_get_num_entries(win->result_view->database_view);
+    db_view_unlock(win->result_view->database_view);
+    if (sort_type == GTK_SORT_DESCENDING) {
+        const uint32_t end = MIN(first_row + num_rows, num_entries);
+        first_row = num_entries - end;
+    }
+    db_view_set_visible_rows(win->result_view->database_view, first_row, num_rows);
+
     db_view_set_sort_order(win->result_view->database_view, sort_order, sort_type);
 }
 
@@ -804,6 +851,7 @@ on_database_update_finished(gpointer data, gpointer user_data) {
     g_assert(FSEARCH_IS_APPLICATION_WINDOW(win));
 
     fsearch_statusbar_set_num_search_results(FSEARCH_STATUSBAR(win->statusbar), 0);
+    win->warm_start_shown = false;
 
     GtkWidget *update_database_button = gtk_stack_get_child_by_name(GTK_STACK(win->popover_update_button_stack),
                                                                     "update_database");
@@ -895,6 +943,11 @@ on_search_entry_activate(GtkButton *widget, gpointer user_data) {
 
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
     if (config->search_as_you_type) {
+        if (win->search_delay_timeout_id) {
+            // the results have to match what was typed
+            perform_search(win);
+            return;
+        }
         if (db_view_get_num_entries(win->result_view->database_view) > 0) {
             if (db_view_get_num_selected(win->result_view->database_view) < 1) {
                 db_view_select(win->result_view->database_view, 0);
@@ -924,6 +977,36 @@ fsearch_application_window_redraw_listview(FsearchApplicationWindow *self) {
     gtk_widget_queue_draw(GTK_WIDGET(self->result_view->list_view));
 }
 
+static void
+fsearch_window_prefetch_preview(FsearchApplicationWindow *win) {
+    FsearchDatabaseView *view = win->result_view->database_view;
+    const int cursor_idx = fsearch_list_view_get_cursor(win->result_view->list_view);
+    if (!view || cursor_idx < 0) {
+        return;
+    }
+
+    // the rows the user is most likely to preview next, in the order they're displayed
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+    db_view_lock(view);
+    const int num_rows = (int)db_view_get_num_entries(view);
+    for (int offset = 1; offset <= PREVIEW_PREFETCH_NUM_ROWS; offset++) {
+        const int rows[] = {cursor_idx + offset, cursor_idx - offset};
+        for (uint32_t i = 0; i < G_N_ELEMENTS(rows); i++) {
+            if (rows[i] < 0 || rows[i] >= num_rows
+                || db_view_entry_get_type_for_idx(view, rows[i]) != DATABASE_ENTRY_TYPE_FILE) {
+                continue;
+            }
+            GString *path = db_view_entry_get_path_full_for_idx(view, rows[i]);
+            if (path) {
+                g_ptr_array_add(paths, g_string_free(path, FALSE));
+            }
+        }
+    }
+    db_view_unlock(view);
+
+    fsearch_preview_prefetch(paths);
+}
+
 static gboolean
 fsearch_window_db_view_selection_changed_cb(gpointer data) {
     const guint win_id = GPOINTER_TO_UINT(data);
@@ -932,6 +1015,10 @@ fsearch_window_db_view_selection_changed_cb(gpointer data) {
     fsearch_application_window_redraw_listview(win);
     fsearch_window_actions_update(win);
 
+    if (fsearch_preview_is_visible()) {
+        fsearch_window_prefetch_preview(win);
+    }
+
     uint32_t num_folders = 0;
     uint32_t num_files = 0;
     if (win->result_view->database_view) {
@@ -969,6 +1056,12 @@ fsearch_window_db_view_content_changed_cb(gpointer data) {
     const uint32_t num_rows = is_empty_search(win) ? 0 : db_view_get_num_entries(win->result_view->database_view);
     db_view_unlock(win->result_view->database_view);
 
+    if (win->warm_start_shown && num_rows == 0) {
+        // the rows of the last launch were dropped before the database was there
+        win->warm_start_shown = false;
+        fsearch_window_set_overlay_for_database_state(win);
+    }
+
     if (is_empty_search(win)) {
         show_overlay(win, OVERLAY_QUERY_EMPTY);
         gtk_widget_show(win->main_search_overlay_stack);
@@ -1007,6 +1100,9 @@ fsearch_window_db_view_notify(FsearchDatabaseView *view, FsearchDatabaseViewNoti
     case DATABASE_VIEW_NOTIFY_SORT_FINISHED:
         g_idle_add(fsearch_window_db_view_sort_finished_cb, user_data);
         break;
+    case DATABASE_VIEW_NOTIFY_INDEX_READY:
+        // the next sort picks it up on its own, the current results are already in order
+        break;
     default:
         g_debug("[view_notify] unknown id: %d", id);
         break;
@@ -1096,35 +1192,6 @@ fsearch_application_window_update_query_flags(FsearchApplicationWindow *win) {
     db_view_set_query_flags(win->result_view->database_view, get_query_flags());
 }
 
-static FsearchDatabaseIndexType
-get_sort_type_for_name(const char *name) {
-    if (!name) {
-        g_warning("[get_sort_type_for_name] name is nullptr");
-        return DATABASE_INDEX_TYPE_NAME;
-    }
-    if (!strcmp(name, DATABASE_INDEX_TYPE_NAME_STRING)) {
-        return DATABASE_INDEX_TYPE_NAME;
-    }
-    else if (!strcmp(name, DATABASE_INDEX_TYPE_PATH_STRING)) {
-        return DATABASE_INDEX_TYPE_PATH;
-    }
-    else if (!strcmp(name, DATABASE_INDEX_TYPE_SIZE_STRING)) {
-        return DATABASE_INDEX_TYPE_SIZE;
-    }
-    else if (!strcmp(name, DATABASE_INDEX_TYPE_MODIFICATION_TIME_STRING)) {
-        return DATABASE_INDEX_TYPE_MODIFICATION_TIME;
-    }
-    else if (!strcmp(name, DATABASE_INDEX_TYPE_EXTENSION_STRING)) {
-        return DATABASE_INDEX_TYPE_EXTENSION;
-    }
-    else if (!strcmp(name, DATABASE_INDEX_TYPE_FILETYPE_STRING)) {
-        return DATABASE_INDEX_TYPE_FILETYPE;
-    }
-    else {
-        return DATABASE_INDEX_TYPE_NAME;
-    }
-}
-
 static char *
 get_sort_name_for_type(FsearchDatabaseIndexType type) {
     const char *name = NULL;
@@ -1147,6 +1214,9 @@ get_sort_name_for_type(FsearchDatabaseIndexType type) {
     case DATABASE_INDEX_TYPE_SIZE:
         name = DATABASE_INDEX_TYPE_SIZE_STRING;
         break;
+    case DATABASE_INDEX_TYPE_RELEVANCE:
+        name = DATABASE_INDEX_TYPE_RELEVANCE_STRING;
+        break;
     default:
         name = DATABASE_INDEX_TYPE_NAME_STRING;
     }
@@ -1177,6 +1247,9 @@ fsearch_application_window_prepare_shutdown(gpointer self) {
             }
             config->sort_by = get_sort_name_for_type(db_view_get_sort_order(db_view));
             db_view_unlock(db_view);
+
+            g_autofree char *warm_start_path = fsearch_application_get_warm_start_file_path();
+            db_view_save_warm_start(db_view, warm_start_path, WARM_START_NUM_ROWS);
         }
 
         if (win->result_view->list_view) {
@@ -1229,7 +1302,7 @@ fsearch_application_window_added(FsearchApplicationWindow *win, FsearchApplicati
 
     FsearchConfig *config = fsearch_application_get_config(app);
 
-    FsearchDatabaseIndexType sort_order = config->restore_sort_order ? get_sort_type_for_name(config->sort_by)
+    FsearchDatabaseIndexType sort_order = config->restore_sort_order ? db_index_type_from_name(config->sort_by)
                                                                      : DATABASE_INDEX_TYPE_NAME;
     if (sort_order == DATABASE_INDEX_TYPE_FILETYPE) {
         // file type order is not indexed, so it would make startup really slow
@@ -1250,11 +1323,24 @@ fsearch_application_window_added(FsearchApplicationWindow *win, FsearchApplicati
                                                   fsearch_window_db_view_notify,
                                                   GUINT_TO_POINTER(win_id));
     g_clear_pointer(&filter, fsearch_filter_unref);
+    db_view_set_result_cache_size(win->result_view->database_view, (size_t)config->result_cache_size * 1024 * 1024);
+    db_view_set_mix_entries(win->result_view->database_view, config->mix_files_and_folders);
 
     FsearchDatabase *db = fsearch_application_get_db(FSEARCH_APPLICATION_DEFAULT);
     if (db) {
         db_view_register_database(win->result_view->database_view, db);
         g_clear_pointer(&db, db_unref);
+        return;
+    }
+
+    // show the rows of the last launch while the database loads
+    FsearchWarmStart *warm_start = fsearch_application_get_warm_start(app);
+    if (warm_start) {
+        win->warm_start_shown = db_view_set_warm_start(win->result_view->database_view, warm_start);
+        if (win->warm_start_shown) {
+            show_overlay(win, OVERLAY_RESULTS);
+        }
+        g_clear_pointer(&warm_start, fsearch_warm_start_unref);
     }
 }
 
@@ -1264,6 +1350,12 @@ fsearch_application_window_cancel_current_task(FsearchApplicationWindow *win) {
     if (win->result_view && win->result_view->database_view) {
         db_view_cancel_current_task(win->result_view->database_view);
     }
+    if (win->export_cancellable) {
+        g_cancellable_cancel(win->export_cancellable);
+    }
+    if (win->file_operation_cancellable) {
+        g_cancellable_cancel(win->file_operation_cancellable);
+    }
 }
 
 void
@@ -1312,6 +1404,138 @@ fsearch_application_window_selection_for_each(FsearchApplicationWindow *self, GH
     }
 }
 
+typedef struct {
+    FsearchApplicationWindow *win;
+    // the window's cancellable for this kind of task and the one of this task
+    GCancellable **cancellable_slot;
+    GCancellable *cancellable;
+    // whether a newer task of the same kind cancels this one, otherwise they share the cancellable
+    bool replace_running;
+    // the statusbar text, which gets the number of processed and all items
+    const char *progress_format;
+    GAsyncReadyCallback callback;
+    gpointer user_data;
+} FsearchWindowTaskContext;
+
+static FsearchWindowTaskContext *
+window_task_context_new(FsearchApplicationWindow *win,
+                        GCancellable **cancellable_slot,
+                        bool replace_running,
+                        const char *progress_format,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data) {
+    if (*cancellable_slot && replace_running) {
+        g_cancellable_cancel(*cancellable_slot);
+    }
+    if (*cancellable_slot && g_cancellable_is_cancelled(*cancellable_slot)) {
+        g_clear_object(cancellable_slot);
+    }
+    if (!*cancellable_slot) {
+        *cancellable_slot = g_cancellable_new();
+    }
+
+    FsearchWindowTaskContext *ctx = g_slice_new0(FsearchWindowTaskContext);
+    ctx->win = g_object_ref(win);
+    ctx->cancellable_slot = cancellable_slot;
+    ctx->cancellable = g_object_ref(*cancellable_slot);
+    ctx->replace_running = replace_running;
+    ctx->progress_format = progress_format;
+    ctx->callback = callback;
+    ctx->user_data = user_data;
+    return ctx;
+}
+
+static void
+on_window_task_progress(uint32_t num_processed, uint32_t num_items, gpointer user_data) {
+    FsearchWindowTaskContext *ctx = user_data;
+    gchar text[100] = "";
+    snprintf(text, sizeof(text), ctx->progress_format, num_processed, num_items);
+    fsearch_statusbar_set_task_progress(FSEARCH_STATUSBAR(ctx->win->statusbar), text);
+    ctx->win->task_progress_shown = true;
+}
+
+static void
+on_window_task_finished(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+    FsearchWindowTaskContext *ctx = user_data;
+    FsearchApplicationWindow *win = ctx->win;
+
+    // a newer task might be running already
+    if (ctx->replace_running && *ctx->cancellable_slot == ctx->cancellable) {
+        g_clear_object(ctx->cancellable_slot);
+    }
+    if (win->task_progress_shown) {
+        fsearch_statusbar_set_num_search_results(FSEARCH_STATUSBAR(win->statusbar),
+                                                 fsearch_application_window_get_num_results(win));
+        win->task_progress_shown = false;
+    }
+    ctx->callback(source_object, result, ctx->user_data);
+
+    g_clear_object(&ctx->cancellable);
+    g_clear_object(&ctx->win);
+    g_slice_free(FsearchWindowTaskContext, ctx);
+}
+
+bool
+fsearch_application_window_export_selection(FsearchApplicationWindow *self,
+                                            FsearchSelectionExportFormat format,
+                                            GOutputStream *stream,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data) {
+    g_assert(FSEARCH_IS_APPLICATION_WINDOW(self));
+    if (!self->result_view->database_view) {
+        return false;
+    }
+    FsearchSelectionExport *export = db_view_selection_export_new(self->result_view->database_view, format);
+    if (!export) {
+        return false;
+    }
+
+    FsearchWindowTaskContext *ctx = window_task_context_new(self,
+                                                            &self->export_cancellable,
+                                                            true,
+                                                            _("Exporting %'d/%'d…"),
+                                                            callback,
+                                                            user_data);
+    fsearch_selection_export_write_async(export,
+                                         stream,
+                                         ctx->cancellable,
+                                         on_window_task_progress,
+                                         ctx,
+                                         on_window_task_finished,
+                                         ctx);
+    return true;
+}
+
+void
+fsearch_application_window_run_file_operation(FsearchApplicationWindow *self,
+                                              FsearchFileOperationType type,
+                                              GPtrArray *paths,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data) {
+    g_assert(FSEARCH_IS_APPLICATION_WINDOW(self));
+    g_assert(paths);
+
+    FsearchWindowTaskContext *ctx =
+        window_task_context_new(self,
+                                &self->file_operation_cancellable,
+                                false,
+                                type == FSEARCH_FILE_OPERATION_DELETE ? _("Deleting %'d/%'d…")
+                                                                      : _("Moving to trash %'d/%'d…"),
+                                callback,
+                                user_data);
+    FsearchDatabase *db = fsearch_application_get_db(FSEARCH_APPLICATION_DEFAULT);
+    fsearch_file_operation_run_async(type,
+                                     paths,
+                                     db,
+                                     FILE_OPERATION_NUM_THREADS,
+                                     ctx->cancellable,
+                                     on_window_task_progress,
+                                     ctx,
+                                     on_window_task_finished,
+                                     ctx);
+    g_clear_pointer(&db, db_unref);
+}
+
 void
 fsearch_application_window_focus_search_entry(FsearchApplicationWindow *win) {
     g_assert(FSEARCH_IS_APPLICATION_WINDOW(win));
@@ -1365,7 +1589,10 @@ fsearch_application_window_update_listview_config(FsearchApplicationWindow *win)
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
     fsearch_list_view_set_single_click_activate(win->result_view->list_view, config->single_click_open);
     gtk_widget_set_has_tooltip(GTK_WIDGET(win->result_view->list_view), config->enable_list_tooltips);
+    db_view_set_mix_entries(win->result_view->database_view, config->mix_files_and_folders);
 
+    // the cached rows were formatted with the previous config
+    fsearch_result_view_row_cache_reset(win->result_view);
     fsearch_application_window_redraw_listview(win);
 }
 
@@ -24,8 +24,10 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include "fsearch.h"
 #include "fsearch_database.h"
+#include "fsearch_file_operation.h"
 #include "fsearch_list_view.h"
 #include "fsearch_query.h"
+#include "fsearch_selection_export.h"
 #include "fsearch_statusbar.h"
 
 G_BEGIN_DECLS
@@ -103,6 +105,26 @@ fsearch_application_window_get_num_selected(FsearchApplicationWindow *self);
 void
 fsearch_application_window_selection_for_each(FsearchApplicationWindow *self, GHFunc func, gpointer user_data);
 
+// Writes the selected entries in format to stream on a worker thread and shows the progress in the statusbar. A
+// previous export which is still running gets cancelled. callback receives the result for
+// fsearch_selection_export_write_finish in the main thread. Returns false if nothing is selected.
+bool
+fsearch_application_window_export_selection(FsearchApplicationWindow *self,
+                                            FsearchSelectionExportFormat format,
+                                            GOutputStream *stream,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data);
+
+// Trashes or deletes paths on background threads and removes them from the database, with the progress in the
+// statusbar. Several of them can run at once, the cancel_task action cancels all. callback receives the result for
+// fsearch_file_operation_run_finish in the main thread.
+void
+fsearch_application_window_run_file_operation(FsearchApplicationWindow *self,
+                                              FsearchFileOperationType type,
+                                              GPtrArray *paths,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+
 void
 fsearch_application_window_toggle_app_menu(FsearchApplicationWindow *self);
 G_END_DECLS
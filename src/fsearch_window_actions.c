@@ -129,101 +129,50 @@ prepend_string_to_list(GList **string_list,
     *string_list = g_list_prepend(*string_list, g_string_free(g_steal_pointer(&string), FALSE));
 }
 
-static void
-append_line(GString *str, const char *text) {
-    if (str->len > 0) {
-        g_string_append_c(str, '\n');
-    }
-    g_string_append(str, text);
-}
-
-static void
-append_line_to_string(GString *buffer, FsearchDatabaseEntry *entry, GString *(*get_string_func)(FsearchDatabaseEntry *)) {
-    if (!entry || !buffer || !get_string_func) {
-        return;
-    }
-
-    g_autoptr(GString) string = get_string_func(entry);
-    if (!string) {
-        return;
-    }
-    append_line(buffer, string->str);
-}
-
 static void
 prepend_full_path_to_list(gpointer key, gpointer value, gpointer user_data) {
     prepend_string_to_list(user_data, value, db_entry_get_path_full);
 }
 
 static void
-append_full_path_to_string(gpointer key, gpointer value, gpointer user_data) {
-    append_line_to_string(user_data, value, db_entry_get_path_full);
-}
+append_full_path_to_array(gpointer key, gpointer value, gpointer user_data) {
+    g_return_if_fail(value);
 
-static void
-append_path_to_string(gpointer key, gpointer value, gpointer user_data) {
-    append_line_to_string(user_data, value, db_entry_get_path);
+    GString *path_full = db_entry_get_path_full(value);
+    g_return_if_fail(path_full);
+    g_ptr_array_add(user_data, g_string_free(path_full, FALSE));
 }
 
-static void
-append_name_to_string(gpointer key, gpointer value, gpointer user_data) {
-    append_line_to_string(user_data, value, db_entry_get_name_for_display);
-}
+typedef struct {
+    FsearchApplicationWindow *win;
+    bool delete;
+} FsearchFileOperationContext;
 
 static void
-fsearch_delete_selection(GSimpleAction *action, GVariant *variant, bool delete, gpointer user_data) {
-    FsearchApplicationWindow *self = user_data;
+on_file_operation_finished(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+    FsearchFileOperationContext *ctx = user_data;
 
-    g_autoptr(GString) error_message = g_string_new(NULL);
-
-    const guint num_selected_rows = fsearch_application_window_get_num_selected(self);
-    GList *file_list = NULL;
-    fsearch_application_window_selection_for_each(self, prepend_full_path_to_list, &file_list);
+    g_autofree char *error_messages = NULL;
+    bool database_updated = false;
+    const uint32_t num_trashed_or_deleted =
+        fsearch_file_operation_run_finish(result, &error_messages, &database_updated);
 
-    if (delete || num_selected_rows > 20) {
-        g_autoptr(GString) warning_message = g_string_new(NULL);
-        g_string_printf(warning_message, _("Do you really want to remove %d file(s)?"), num_selected_rows);
-        gint response = ui_utils_run_gtk_dialog(GTK_WIDGET(self),
-                                                GTK_MESSAGE_WARNING,
-                                                GTK_BUTTONS_OK_CANCEL,
-                                                delete ? _("Deleting files…") : _("Moving files to trash…"),
-                                                warning_message->str);
-
-        if (response != GTK_RESPONSE_OK) {
-            goto save_fail;
-        }
-    }
-
-    uint32_t num_trashed_or_deleted = 0;
-    for (GList *f = file_list; f != NULL; f = f->next) {
-        char *path = f->data;
-        if (delete) {
-            if (fsearch_file_utils_remove(path, error_message)) {
-                num_trashed_or_deleted++;
-            }
-        }
-        else {
-            if (fsearch_file_utils_trash(path, error_message)) {
-                num_trashed_or_deleted++;
-            }
-        }
-    }
-
-    if (error_message->len > 0) {
-        ui_utils_run_gtk_dialog_async(GTK_WIDGET(self),
+    if (error_messages) {
+        ui_utils_run_gtk_dialog_async(GTK_WIDGET(ctx->win),
                                       GTK_MESSAGE_WARNING,
                                       GTK_BUTTONS_OK,
                                       _("Something went wrong."),
-                                      error_message->str,
+                                      error_messages,
                                       G_CALLBACK(gtk_widget_destroy),
                                       NULL);
     }
-    if (num_trashed_or_deleted > 0) {
+    // otherwise the removed files are gone from the results already
+    if (num_trashed_or_deleted > 0 && !database_updated) {
         g_autoptr(GString) trashed_or_deleted_message = g_string_new(NULL);
         g_string_printf(trashed_or_deleted_message,
-                        delete ? _("Deleted %d file(s).") : _("Moved %d file(s) to the trash."),
+                        ctx->delete ? _("Deleted %d file(s).") : _("Moved %d file(s) to the trash."),
                         num_trashed_or_deleted);
-        ui_utils_run_gtk_dialog_async(GTK_WIDGET(self),
+        ui_utils_run_gtk_dialog_async(GTK_WIDGET(ctx->win),
                                       GTK_MESSAGE_INFO,
                                       GTK_BUTTONS_OK,
                                       trashed_or_deleted_message->str,
@@ -233,10 +182,44 @@ fsearch_delete_selection(GSimpleAction *action, GVariant *variant, bool delete,
                                       NULL);
     }
 
-save_fail:
-    if (file_list) {
-        g_list_free_full(g_steal_pointer(&file_list), (GDestroyNotify)g_free);
+    g_clear_object(&ctx->win);
+    g_slice_free(FsearchFileOperationContext, ctx);
+}
+
+static void
+fsearch_delete_selection(GSimpleAction *action, GVariant *variant, bool delete, gpointer user_data) {
+    FsearchApplicationWindow *self = user_data;
+
+    const guint num_selected_rows = fsearch_application_window_get_num_selected(self);
+    if (num_selected_rows == 0) {
+        return;
     }
+
+    if (delete || num_selected_rows > 20) {
+        g_autoptr(GString) warning_message = g_string_new(NULL);
+        g_string_printf(warning_message, _("Do you really want to remove %d file(s)?"), num_selected_rows);
+        gint response = ui_utils_run_gtk_dialog(GTK_WIDGET(self),
+                                                GTK_MESSAGE_WARNING,
+                                                GTK_BUTTONS_OK_CANCEL,
+                                                delete ? _("Deleting files…") : _("Moving files to trash…"),
+                                                warning_message->str);
+
+        if (response != GTK_RESPONSE_OK) {
+            return;
+        }
+    }
+
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_full(num_selected_rows, g_free);
+    fsearch_application_window_selection_for_each(self, append_full_path_to_array, paths);
+
+    FsearchFileOperationContext *ctx = g_slice_new0(FsearchFileOperationContext);
+    ctx->win = g_object_ref(self);
+    ctx->delete = delete;
+    fsearch_application_window_run_file_operation(self,
+                                                  delete ? FSEARCH_FILE_OPERATION_DELETE : FSEARCH_FILE_OPERATION_TRASH,
+                                                  paths,
+                                                  on_file_operation_finished,
+                                                  ctx);
 }
 
 static void
@@ -323,13 +306,75 @@ fsearch_window_action_select_all(GSimpleAction *action, GVariant *variant, gpoin
     }
 }
 
+typedef struct {
+    GOutputStream *stream;
+    FsearchSelectionExportFormat format;
+    // false if the files should be cut
+    bool copy;
+} FsearchClipboardExportContext;
+
+// Returns the exported lines without the trailing newline, or NULL if nothing was exported
+static char *
+steal_exported_lines(GOutputStream *stream, size_t *len) {
+    GMemoryOutputStream *memory_stream = G_MEMORY_OUTPUT_STREAM(stream);
+    g_output_stream_close(stream, NULL, NULL);
+    size_t data_len = g_memory_output_stream_get_data_size(memory_stream);
+    char *data = g_memory_output_stream_steal_data(memory_stream);
+    if (!data || data_len == 0) {
+        g_free(data);
+        return NULL;
+    }
+    data[--data_len] = '\0';
+    *len = data_len;
+    return data;
+}
+
+static void
+on_export_to_clipboard_finished(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+    FsearchClipboardExportContext *ctx = user_data;
+
+    g_autoptr(GError) error = NULL;
+    if (fsearch_selection_export_write_finish(result, &error)) {
+        size_t len = 0;
+        char *lines = steal_exported_lines(ctx->stream, &len);
+        if (lines && ctx->format == FSEARCH_SELECTION_EXPORT_URI) {
+            clipboard_copy_uri_list(lines, len, ctx->copy);
+        }
+        else if (lines) {
+            GtkClipboard *clip = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+            gtk_clipboard_set_text(clip, lines, (gint)len);
+            g_clear_pointer(&lines, g_free);
+        }
+    }
+    else if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_warning("[clipboard] failed to export the selection: %s", error->message);
+    }
+
+    g_clear_object(&ctx->stream);
+    g_slice_free(FsearchClipboardExportContext, ctx);
+}
+
+static void
+export_selection_to_clipboard(FsearchApplicationWindow *win, FsearchSelectionExportFormat format, bool copy) {
+    // the clipboard needs all of it when something gets pasted, but it's built off the main thread
+    FsearchClipboardExportContext *ctx = g_slice_new0(FsearchClipboardExportContext);
+    ctx->stream = g_memory_output_stream_new_resizable();
+    ctx->format = format;
+    ctx->copy = copy;
+    if (!fsearch_application_window_export_selection(win,
+                                                     format,
+                                                     ctx->stream,
+                                                     on_export_to_clipboard_finished,
+                                                     ctx)) {
+        g_clear_object(&ctx->stream);
+        g_slice_free(FsearchClipboardExportContext, ctx);
+    }
+}
+
 static void
 fsearch_window_action_cut_or_copy(GSimpleAction *action, GVariant *variant, bool copy, gpointer user_data) {
     FsearchApplicationWindow *self = user_data;
-    GList *file_list = NULL;
-    fsearch_application_window_selection_for_each(self, prepend_full_path_to_list, &file_list);
-    file_list = g_list_reverse(file_list);
-    clipboard_copy_file_list(file_list, copy);
+    export_selection_to_clipboard(self, FSEARCH_SELECTION_EXPORT_URI, copy);
 }
 
 static void
@@ -343,30 +388,140 @@ fsearch_window_action_copy(GSimpleAction *action, GVariant *variant, gpointer us
 }
 
 static void
-copy_selection_as_text(FsearchApplicationWindow *win, GHFunc text_copy_func) {
-    g_autoptr(GString) file_list_buffer = g_string_sized_new(8192);
-    fsearch_application_window_selection_for_each(win, text_copy_func, file_list_buffer);
+fsearch_window_action_copy_full_path(GSimpleAction *action, GVariant *variant, gpointer user_data) {
+    FsearchApplicationWindow *win = user_data;
+    export_selection_to_clipboard(win, FSEARCH_SELECTION_EXPORT_FULL_PATH, true);
+}
 
-    GtkClipboard *clip = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
-    gtk_clipboard_set_text(clip, file_list_buffer->str, (gint)file_list_buffer->len);
+static void
+fsearch_window_action_copy_path(GSimpleAction *action, GVariant *variant, gpointer user_data) {
+    FsearchApplicationWindow *win = user_data;
+    export_selection_to_clipboard(win, FSEARCH_SELECTION_EXPORT_PATH, true);
 }
 
 static void
-fsearch_window_action_copy_full_path(GSimpleAction *action, GVariant *variant, gpointer user_data) {
+fsearch_window_action_copy_name(GSimpleAction *action, GVariant *variant, gpointer user_data) {
     FsearchApplicationWindow *win = user_data;
-    copy_selection_as_text(win, append_full_path_to_string);
+    export_selection_to_clipboard(win, FSEARCH_SELECTION_EXPORT_NAME, true);
+}
+
+typedef struct {
+    FsearchApplicationWindow *win;
+    GOutputStream *stream;
+    char *file_name;
+} FsearchFileExportContext;
+
+static void
+file_export_context_free(FsearchFileExportContext *ctx) {
+    g_clear_object(&ctx->win);
+    g_clear_object(&ctx->stream);
+    g_clear_pointer(&ctx->file_name, g_free);
+    g_slice_free(FsearchFileExportContext, ctx);
 }
 
 static void
-fsearch_window_action_copy_path(GSimpleAction *action, GVariant *variant, gpointer user_data) {
+show_export_error(FsearchApplicationWindow *win, const char *file_name, const char *message) {
+    g_autofree char *text = g_strdup_printf(_("Failed to export the selection to %s: %s"), file_name, message);
+    ui_utils_run_gtk_dialog_async(GTK_WIDGET(win),
+                                  GTK_MESSAGE_WARNING,
+                                  GTK_BUTTONS_OK,
+                                  _("Something went wrong."),
+                                  text,
+                                  G_CALLBACK(gtk_widget_destroy),
+                                  NULL);
+}
+
+static void
+on_export_to_file_finished(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+    FsearchFileExportContext *ctx = user_data;
+
+    g_autoptr(GError) error = NULL;
+    if (fsearch_selection_export_write_finish(result, &error)) {
+        g_output_stream_close(ctx->stream, NULL, &error);
+    }
+    else {
+        // cancelling the close keeps the file which was there instead of the incomplete one, where that's supported
+        g_autoptr(GCancellable) cancellable = g_cancellable_new();
+        g_cancellable_cancel(cancellable);
+        g_output_stream_close(ctx->stream, cancellable, NULL);
+    }
+    if (error && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        show_export_error(ctx->win, ctx->file_name, error->message);
+    }
+    g_clear_pointer(&ctx, file_export_context_free);
+}
+
+static void
+export_selection_to_file(FsearchApplicationWindow *win, GFile *file) {
+    FsearchFileExportContext *ctx = g_slice_new0(FsearchFileExportContext);
+    ctx->win = g_object_ref(win);
+    ctx->file_name = g_file_get_parse_name(file);
+
+    g_autoptr(GError) error = NULL;
+    ctx->stream = G_OUTPUT_STREAM(g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
+    if (!ctx->stream) {
+        show_export_error(win, ctx->file_name, error->message);
+        g_clear_pointer(&ctx, file_export_context_free);
+        return;
+    }
+    if (!fsearch_application_window_export_selection(win,
+                                                     FSEARCH_SELECTION_EXPORT_FULL_PATH,
+                                                     ctx->stream,
+                                                     on_export_to_file_finished,
+                                                     ctx)) {
+        g_output_stream_close(ctx->stream, NULL, NULL);
+        g_clear_pointer(&ctx, file_export_context_free);
+    }
+}
+
+#if !GTK_CHECK_VERSION(3, 20, 0)
+static void
+on_export_file_chooser_response(GtkFileChooserDialog *dialog, GtkResponseType response, gpointer user_data) {
+#else
+static void
+on_export_file_chooser_response(GtkNativeDialog *dialog, GtkResponseType response, gpointer user_data) {
+#endif
     FsearchApplicationWindow *win = user_data;
-    copy_selection_as_text(win, append_path_to_string);
+    if (response == GTK_RESPONSE_ACCEPT) {
+        g_autoptr(GFile) file = gtk_file_chooser_get_file(GTK_FILE_CHOOSER(dialog));
+        if (file) {
+            export_selection_to_file(win, file);
+        }
+    }
+#if !GTK_CHECK_VERSION(3, 20, 0)
+    gtk_widget_destroy(GTK_WIDGET(dialog));
+#else
+    g_clear_object(&dialog);
+#endif
 }
 
 static void
-fsearch_window_action_copy_name(GSimpleAction *action, GVariant *variant, gpointer user_data) {
+fsearch_window_action_export_selection(GSimpleAction *action, GVariant *variant, gpointer user_data) {
     FsearchApplicationWindow *win = user_data;
-    copy_selection_as_text(win, append_name_to_string);
+    const GtkFileChooserAction chooser_action = GTK_FILE_CHOOSER_ACTION_SAVE;
+#if !GTK_CHECK_VERSION(3, 20, 0)
+    GtkWidget *dialog = gtk_file_chooser_dialog_new(_("Export Selection"),
+                                                    GTK_WINDOW(win),
+                                                    chooser_action,
+                                                    _("_Cancel"),
+                                                    GTK_RESPONSE_CANCEL,
+                                                    _("_Export"),
+                                                    GTK_RESPONSE_ACCEPT,
+                                                    NULL);
+    g_signal_connect(dialog, "response", G_CALLBACK(on_export_file_chooser_response), win);
+    gtk_window_set_modal(GTK_WINDOW(dialog), TRUE);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), "selection.txt");
+    gtk_widget_show(dialog);
+#else
+    GtkFileChooserNative *dialog =
+        gtk_file_chooser_native_new(_("Export Selection"), GTK_WINDOW(win), chooser_action, _("_Export"), _("_Cancel"));
+    g_signal_connect(dialog, "response", G_CALLBACK(on_export_file_chooser_response), win);
+    gtk_native_dialog_set_modal(GTK_NATIVE_DIALOG(dialog), true);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), "selection.txt");
+    gtk_native_dialog_show(GTK_NATIVE_DIALOG(dialog));
+#endif
 }
 
 static void
@@ -862,6 +1017,7 @@ static GActionEntry FsearchWindowActions[] = {
     {"copy_as_text_name_clipboard", fsearch_window_action_copy_name},
     {"copy_as_text_path_clipboard", fsearch_window_action_copy_path},
     {"cut_clipboard", fsearch_window_action_cut},
+    {"export_selection", fsearch_window_action_export_selection},
     {"file_properties", fsearch_window_action_file_properties},
     {"move_to_trash", fsearch_window_action_move_to_trash},
     {"delete_selection", fsearch_window_action_delete},
@@ -915,6 +1071,7 @@ fsearch_window_actions_update(FsearchApplicationWindow *self) {
     action_set_enabled(group, "copy_as_text_path_and_name_clipboard", num_rows_selected);
     action_set_enabled(group, "copy_as_text_name_clipboard", num_rows_selected);
     action_set_enabled(group, "copy_as_text_path_clipboard", num_rows_selected);
+    action_set_enabled(group, "export_selection", num_rows_selected);
     action_set_enabled(group, "cut_clipboard", num_rows_selected);
     action_set_enabled(group, "delete_selection", FALSE);
     action_set_enabled(group, "file_properties", has_file_manager_on_bus && num_rows_selected >= 1 ? TRUE : FALSE);
@@ -0,0 +1,91 @@
+#define G_LOG_DOMAIN "fsearch-xattr"
+
+#include "fsearch_xattr.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/xattr.h>
+#define FSEARCH_XATTR_SUPPORTED
+#endif
+
+// larger values are skipped, attributes which are meant to be searched are short
+#define XATTR_MAX_VALUE_SIZE 4096
+
+bool
+fsearch_xattr_is_supported(void) {
+#ifdef FSEARCH_XATTR_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef FSEARCH_XATTR_SUPPORTED
+static ssize_t
+get_xattr(const char *path, const char *name, char *value, size_t size) {
+#ifdef __APPLE__
+    return getxattr(path, name, value, size, 0, XATTR_NOFOLLOW);
+#else
+    return lgetxattr(path, name, value, size);
+#endif
+}
+#endif
+
+bool
+fsearch_xattr_read(const char *path, const char *const *names, GString *xattrs) {
+    g_assert(path);
+    g_assert(xattrs);
+
+    g_string_truncate(xattrs, 0);
+#ifdef FSEARCH_XATTR_SUPPORTED
+    char value[XATTR_MAX_VALUE_SIZE];
+    for (uint32_t i = 0; names && names[i]; i++) {
+        const ssize_t len = get_xattr(path, names[i], value, sizeof(value));
+        if (len < 0) {
+            if (errno == ENOTSUP || errno == ENOENT || errno == EACCES) {
+                // the filesystem doesn't support them or the file can't be read, the other names won't work either
+                break;
+            }
+            // most likely ENODATA (or ENOATTR), the file doesn't have that attribute, or ERANGE
+            continue;
+        }
+        g_string_append(xattrs, names[i]);
+        g_string_append_c(xattrs, '\0');
+        g_string_append_len(xattrs, value, (gssize)strnlen(value, len));
+        g_string_append_c(xattrs, '\0');
+    }
+#endif
+    return xattrs->len > 0;
+}
+
+const char *
+fsearch_xattr_lookup(const char *xattrs, size_t xattrs_len, const char *name, size_t *value_len) {
+    g_assert(name);
+    if (!xattrs) {
+        return NULL;
+    }
+    const char *end = xattrs + xattrs_len;
+    const char *pos = xattrs;
+    while (pos < end) {
+        const char *name_end = memchr(pos, '\0', end - pos);
+        if (!name_end || name_end + 1 >= end) {
+            return NULL;
+        }
+        const char *value = name_end + 1;
+        const char *value_end = memchr(value, '\0', end - value);
+        if (!value_end) {
+            return NULL;
+        }
+        if (strcmp(pos, name) == 0) {
+            if (value_len) {
+                *value_len = value_end - value;
+            }
+            return value;
+        }
+        pos = value_end + 1;
+    }
+    return NULL;
+}
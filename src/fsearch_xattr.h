@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Extended attributes of files are stored as a list of "name\0value\0" pairs, in the order of the names
+// they were read for. Values are cut at their first NUL byte.
+
+// Whether extended attributes can be read on this platform
+bool
+fsearch_xattr_is_supported(void);
+
+// Replaces the contents of xattrs with the attributes of the file at path (symlinks aren't followed) which are
+// part of names. Returns false if the file has none of them.
+bool
+fsearch_xattr_read(const char *path, const char *const *names, GString *xattrs);
+
+// Returns the value of name in the xattrs_len bytes of xattrs, NULL if it's not part of them
+const char *
+fsearch_xattr_lookup(const char *xattrs, size_t xattrs_len, const char *name, size_t *value_len);
@@ -0,0 +1,204 @@
+#include <glib.h>
+#include <pwd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_aggregate.h>
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+
+#include "test_tree.h"
+
+#define TEST_UID_WITHOUT_NAME 4000000
+
+static const TestFolder folders[] = {
+    {-1, ""},
+    {0, "home"},
+    {1, "user"},
+    {2, "docs"},
+    {0, "tmp"},
+};
+
+// -1 as uid for files without an owner
+static const struct {
+    uint32_t parent;
+    const char *name;
+    off_t size;
+    int64_t uid;
+} files[] = {
+    {2, "a.txt", 100, 0},
+    {3, "b.txt", 50, 0},
+    {3, "c.pdf", 1000, TEST_UID_WITHOUT_NAME},
+    {4, "d", 7, -1},
+    {0, "e.pdf", 3, 0},
+};
+
+typedef struct {
+    const char *name;
+    uint64_t num_entries;
+    uint64_t size;
+} ExpectedGroup;
+
+static DynamicArray *
+new_entries(FsearchMemoryPool *folder_pool, FsearchMemoryPool *file_pool) {
+    DynamicArray *entries = darray_new(G_N_ELEMENTS(folders) + G_N_ELEMENTS(files));
+    test_tree_add_folders(entries, folder_pool, folders, G_N_ELEMENTS(folders), DATABASE_INDEX_FLAG_OWNER);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(files); i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(file_pool);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+        db_entry_init_optional_values(entry, DATABASE_INDEX_FLAG_OWNER);
+        db_entry_set_name(entry, files[i].name);
+        db_entry_set_idx(entry, i);
+        db_entry_set_parent(entry, darray_get_item(entries, files[i].parent));
+        db_entry_set_size(entry, files[i].size);
+        if (files[i].uid >= 0) {
+            db_entry_set_owner(entry, (uint32_t)files[i].uid, 0, 0644);
+        }
+        darray_add_item(entries, entry);
+    }
+    return entries;
+}
+
+static void
+check_groups(GArray *groups, const ExpectedGroup *expected, uint32_t num_expected) {
+    g_assert_cmpuint(groups->len, ==, num_expected);
+    for (uint32_t i = 0; i < num_expected; i++) {
+        FsearchAggregateGroup *group = &g_array_index(groups, FsearchAggregateGroup, i);
+        g_assert_cmpstr(group->name, ==, expected[i].name);
+        g_assert_cmpuint(group->num_entries, ==, expected[i].num_entries);
+        g_assert_cmpuint(group->size, ==, expected[i].size);
+    }
+}
+
+static void
+check_aggregate(DynamicArray *entries,
+                FsearchAggregateKey key,
+                uint32_t depth,
+                FsearchThreadPool *pool,
+                const ExpectedGroup *expected,
+                uint32_t num_expected) {
+    GArray *groups = fsearch_aggregate_entries(entries, key, depth, NULL, pool);
+    check_groups(groups, expected, num_expected);
+    g_clear_pointer(&groups, g_array_unref);
+}
+
+static void
+test_aggregate_key_parse(void) {
+    FsearchAggregateKey key = FSEARCH_AGGREGATE_BY_OWNER;
+    uint32_t depth = 0;
+    g_assert_true(fsearch_aggregate_key_parse("extension", &key, &depth));
+    g_assert_cmpint(key, ==, FSEARCH_AGGREGATE_BY_EXTENSION);
+    g_assert_true(fsearch_aggregate_key_parse("owner", &key, &depth));
+    g_assert_cmpint(key, ==, FSEARCH_AGGREGATE_BY_OWNER);
+    g_assert_true(fsearch_aggregate_key_parse("folder", &key, &depth));
+    g_assert_cmpint(key, ==, FSEARCH_AGGREGATE_BY_FOLDER);
+    g_assert_cmpuint(depth, ==, 1);
+    g_assert_true(fsearch_aggregate_key_parse("folder:3", &key, &depth));
+    g_assert_cmpuint(depth, ==, 3);
+    g_assert_true(fsearch_aggregate_key_parse("folder:0", &key, &depth));
+    g_assert_cmpuint(depth, ==, 0);
+
+    g_assert_false(fsearch_aggregate_key_parse(NULL, &key, &depth));
+    g_assert_false(fsearch_aggregate_key_parse("", &key, &depth));
+    g_assert_false(fsearch_aggregate_key_parse("size", &key, &depth));
+    g_assert_false(fsearch_aggregate_key_parse("folder:", &key, &depth));
+    g_assert_false(fsearch_aggregate_key_parse("folder:-1", &key, &depth));
+    g_assert_false(fsearch_aggregate_key_parse("folder:2x", &key, &depth));
+    g_assert_false(fsearch_aggregate_key_parse("folder:99999999999999999999", &key, &depth));
+}
+
+static void
+test_aggregate_groups(void) {
+    FsearchMemoryPool *folder_pool =
+        fsearch_memory_pool_new(100,
+                                db_entry_get_sizeof_folder_entry_with_optional_values(DATABASE_INDEX_FLAG_OWNER),
+                                (GDestroyNotify)db_entry_destroy);
+    FsearchMemoryPool *file_pool =
+        fsearch_memory_pool_new(100,
+                                db_entry_get_sizeof_file_entry_with_optional_values(DATABASE_INDEX_FLAG_OWNER),
+                                (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = new_entries(folder_pool, file_pool);
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+
+    // folders are left out, their sizes would count their contents twice
+    const ExpectedGroup by_extension[] = {{"pdf", 2, 1003}, {"txt", 2, 150}, {"", 1, 7}};
+    check_aggregate(entries, FSEARCH_AGGREGATE_BY_EXTENSION, 0, pool, by_extension, G_N_ELEMENTS(by_extension));
+    check_aggregate(entries, FSEARCH_AGGREGATE_BY_EXTENSION, 0, NULL, by_extension, G_N_ELEMENTS(by_extension));
+
+    const ExpectedGroup by_root[] = {{"/", 5, 1160}};
+    check_aggregate(entries, FSEARCH_AGGREGATE_BY_FOLDER, 0, pool, by_root, G_N_ELEMENTS(by_root));
+    // files above the depth are grouped by their own folder
+    const ExpectedGroup by_folder[] = {{"/home", 3, 1150}, {"/tmp", 1, 7}, {"/", 1, 3}};
+    check_aggregate(entries, FSEARCH_AGGREGATE_BY_FOLDER, 1, pool, by_folder, G_N_ELEMENTS(by_folder));
+    const ExpectedGroup by_subfolder[] = {
+        {"/home/user/docs", 2, 1050},
+        {"/home/user", 1, 100},
+        {"/tmp", 1, 7},
+        {"/", 1, 3},
+    };
+    check_aggregate(entries, FSEARCH_AGGREGATE_BY_FOLDER, 3, pool, by_subfolder, G_N_ELEMENTS(by_subfolder));
+
+    struct passwd *pw = getpwuid(0);
+    g_autofree char *root_name = g_strdup(pw ? pw->pw_name : "0");
+    const ExpectedGroup by_owner[] = {{G_STRINGIFY(TEST_UID_WITHOUT_NAME), 1, 1000}, {root_name, 3, 153}, {"-", 1, 7}};
+    check_aggregate(entries, FSEARCH_AGGREGATE_BY_OWNER, 0, pool, by_owner, G_N_ELEMENTS(by_owner));
+
+    GArray *groups = fsearch_aggregate_entries(NULL, FSEARCH_AGGREGATE_BY_EXTENSION, 0, NULL, pool);
+    g_assert_cmpuint(groups->len, ==, 0);
+    g_clear_pointer(&groups, g_array_unref);
+
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&folder_pool, fsearch_memory_pool_free_pool);
+}
+
+// Enough files for every thread to aggregate several blocks, whose groups get merged
+static void
+test_aggregate_many(void) {
+    const uint32_t num_files = 200000;
+    const uint32_t num_extensions = 7;
+    FsearchMemoryPool *file_pool =
+        fsearch_memory_pool_new(4096, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = darray_new(num_files);
+    uint64_t expected_sizes[7] = {0};
+    for (uint32_t i = 0; i < num_files; i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(file_pool);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+        g_autofree char *name = g_strdup_printf("file_%u.ext%u", i, i % num_extensions);
+        db_entry_set_name(entry, name);
+        db_entry_set_idx(entry, i);
+        db_entry_set_size(entry, i);
+        expected_sizes[i % num_extensions] += i;
+        darray_add_item(entries, entry);
+    }
+
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+    GArray *groups = fsearch_aggregate_entries(entries, FSEARCH_AGGREGATE_BY_EXTENSION, 0, NULL, pool);
+    g_assert_cmpuint(groups->len, ==, num_extensions);
+    uint64_t num_entries = 0;
+    for (uint32_t i = 0; i < groups->len; i++) {
+        FsearchAggregateGroup *group = &g_array_index(groups, FsearchAggregateGroup, i);
+        const uint32_t ext = (uint32_t)atoi(group->name + strlen("ext"));
+        g_assert_cmpuint(group->size, ==, expected_sizes[ext]);
+        if (i > 0) {
+            g_assert_cmpuint(group->size, <=, g_array_index(groups, FsearchAggregateGroup, i - 1).size);
+        }
+        num_entries += group->num_entries;
+    }
+    g_assert_cmpuint(num_entries, ==, num_files);
+
+    g_clear_pointer(&groups, g_array_unref);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&file_pool, fsearch_memory_pool_free_pool);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/aggregate/key_parse", test_aggregate_key_parse);
+    g_test_add_func("/FSearch/aggregate/groups", test_aggregate_groups);
+    g_test_add_func("/FSearch/aggregate/many", test_aggregate_many);
+    return g_test_run();
+}
@@ -0,0 +1,89 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <src/fsearch_aho_corasick.h>
+
+static bool
+contains_any_naive(const char **patterns, uint32_t num_patterns, const char *haystack, bool ignore_case) {
+    for (uint32_t i = 0; i < num_patterns; i++) {
+        const size_t len = strlen(patterns[i]);
+        for (const char *s = haystack; strlen(s) >= len; s++) {
+            if (ignore_case ? !g_ascii_strncasecmp(s, patterns[i], len) : !strncmp(s, patterns[i], len)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void
+test_patterns(void) {
+    struct {
+        const char *haystack;
+        bool result;
+        bool result_ignore_case;
+    } tests[] = {
+        {"", false, false},
+        {"she sells", true, true},
+        {"HIS", false, true},
+        {"ushers", true, true},
+        {"hershey", true, true},
+        {"hhe", true, true},
+        {"h", false, false},
+        {"xyz", false, false},
+        {"Ährhers", true, true},
+        {"ährh", false, false},
+        {"hÄrs", true, true},
+    };
+    const char *patterns[] = {"he", "she", "his", "hers", "Ärs"};
+    FsearchAhoCorasick *ac = fsearch_aho_corasick_new(patterns, G_N_ELEMENTS(patterns), false);
+    FsearchAhoCorasick *ac_icase = fsearch_aho_corasick_new(patterns, G_N_ELEMENTS(patterns), true);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        const char *haystack = tests[i].haystack;
+        g_assert_true(fsearch_aho_corasick_contains_any(ac, haystack, strlen(haystack)) == tests[i].result);
+        g_assert_true(fsearch_aho_corasick_contains_any(ac_icase, haystack, strlen(haystack))
+                      == tests[i].result_ignore_case);
+    }
+    g_clear_pointer(&ac, fsearch_aho_corasick_free);
+    g_clear_pointer(&ac_icase, fsearch_aho_corasick_free);
+}
+
+static void
+test_random(void) {
+    const char alphabet[] = "abAB.c";
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < 200; i++) {
+        char pattern_data[8][5] = {{0}};
+        const char *patterns[8];
+        const uint32_t num_patterns = g_rand_int_range(rand, 1, 8);
+        for (uint32_t j = 0; j < num_patterns; j++) {
+            const int32_t len = g_rand_int_range(rand, 1, 5);
+            for (int32_t k = 0; k < len; k++) {
+                pattern_data[j][k] = alphabet[g_rand_int_range(rand, 0, sizeof(alphabet) - 1)];
+            }
+            patterns[j] = pattern_data[j];
+        }
+        const bool ignore_case = i % 2;
+        FsearchAhoCorasick *ac = fsearch_aho_corasick_new(patterns, num_patterns, ignore_case);
+        for (uint32_t j = 0; j < 50; j++) {
+            char haystack[17] = "";
+            const int32_t len = g_rand_int_range(rand, 0, 17);
+            for (int32_t k = 0; k < len; k++) {
+                haystack[k] = alphabet[g_rand_int_range(rand, 0, sizeof(alphabet) - 1)];
+            }
+            g_assert_true(fsearch_aho_corasick_contains_any(ac, haystack, strlen(haystack))
+                          == contains_any_naive(patterns, num_patterns, haystack, ignore_case));
+        }
+        g_clear_pointer(&ac, fsearch_aho_corasick_free);
+    }
+    g_rand_free(rand);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/aho_corasick/patterns", test_patterns);
+    g_test_add_func("/FSearch/aho_corasick/random", test_random);
+    return g_test_run();
+}
@@ -61,7 +61,7 @@ test_main(void) {
         }
     }
 
-    darray_sort_multi_threaded(array, (DynamicArrayCompareDataFunc)sort_int_ascending, NULL, NULL);
+    darray_sort_multi_threaded(array, (DynamicArrayCompareDataFunc)sort_int_ascending, NULL, NULL, NULL);
     for (int32_t i = 0; i < upper_limit; ++i) {
         int32_t j = GPOINTER_TO_INT(darray_get_item(array, i));
         g_print("%d:%d\n", i, j);
@@ -138,16 +138,20 @@ sort_version(void **a, void **b, void *data) {
 
 static void
 test_single_and_multi_threaded_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func) {
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
     DynamicArray *a1 = darray_copy(array);
     DynamicArray *a2 = darray_copy(array);
-    darray_sort(a1, (DynamicArrayCompareDataFunc)sort_version, NULL, NULL);
-    darray_sort_multi_threaded(a2, (DynamicArrayCompareDataFunc)sort_version, NULL, NULL);
+    darray_sort(a1, comp_func, NULL, NULL);
+    darray_sort_multi_threaded(a2, comp_func, pool, NULL, NULL);
+    g_assert_cmpuint(darray_get_num_items(a1), ==, darray_get_num_items(a2));
     for (uint32_t i = 0; i < darray_get_num_items(a1); ++i) {
         Version *v1 = darray_get_item(a1, i);
         Version *v2 = darray_get_item(a2, i);
-        g_print("%d.%d / %d.%d\n", v1->major, v1->minor, v2->major, v2->minor);
         g_assert(v1 == v2);
     }
+    g_clear_pointer(&a1, darray_unref);
+    g_clear_pointer(&a2, darray_unref);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
 }
 
 static void
@@ -176,6 +180,195 @@ test_sort(void) {
         darray_add_item(array, &versions[i]);
     }
     test_single_and_multi_threaded_sort(array, (DynamicArrayCompareDataFunc)sort_version);
+    g_clear_pointer(&array, darray_unref);
+
+    // large enough to be sorted by several threads, with many equal items
+    const uint32_t num_items = 300000;
+    Version *many_versions = calloc(num_items, sizeof(Version));
+    GRand *rand = g_rand_new_with_seed(num_items);
+    array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        many_versions[i].major = g_rand_int_range(rand, 0, 1000);
+        darray_add_item(array, &many_versions[i]);
+    }
+    test_single_and_multi_threaded_sort(array, (DynamicArrayCompareDataFunc)sort_version);
+    g_clear_pointer(&rand, g_rand_free);
+    g_clear_pointer(&array, darray_unref);
+    g_clear_pointer(&many_versions, free);
+}
+
+static uint64_t
+get_int_key(void *item, void *data) {
+    const uint64_t *keys = data;
+    return keys[GPOINTER_TO_INT(item)];
+}
+
+static void
+test_sort_by_key_with_num_items(int32_t num_items, uint64_t key_mask) {
+    uint64_t *keys = calloc(num_items, sizeof(uint64_t));
+    DynamicArray *array = darray_new(num_items);
+    GRand *rand = g_rand_new_with_seed(num_items);
+    for (int32_t i = 0; i < num_items; ++i) {
+        keys[i] = (((uint64_t)g_rand_int(rand) << 32) | g_rand_int(rand)) & key_mask;
+        darray_add_item(array, GINT_TO_POINTER(i));
+    }
+
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+    darray_sort_by_key(array, get_int_key, pool, NULL, keys);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+    g_assert_cmpuint(darray_get_num_items(array), ==, num_items);
+    for (int32_t i = 1; i < num_items; ++i) {
+        const int32_t prev = GPOINTER_TO_INT(darray_get_item(array, i - 1));
+        const int32_t cur = GPOINTER_TO_INT(darray_get_item(array, i));
+        g_assert_cmpuint(keys[prev], <=, keys[cur]);
+        // items with the same key keep their order
+        if (keys[prev] == keys[cur]) {
+            g_assert_cmpint(prev, <, cur);
+        }
+    }
+
+    g_clear_pointer(&rand, g_rand_free);
+    g_clear_pointer(&array, darray_unref);
+    g_clear_pointer(&keys, free);
+}
+
+static void
+test_sort_by_key(void) {
+    test_sort_by_key_with_num_items(0, UINT64_MAX);
+    test_sort_by_key_with_num_items(1, UINT64_MAX);
+    test_sort_by_key_with_num_items(100, UINT64_MAX);
+    // only some digits differ
+    test_sort_by_key_with_num_items(1000, 0xff00ff00);
+    // all keys are the same
+    test_sort_by_key_with_num_items(1000, 0);
+    // large enough to be sorted by several threads
+    test_sort_by_key_with_num_items(500000, UINT64_MAX);
+    test_sort_by_key_with_num_items(500000, 0xfff);
+}
+
+static uint64_t
+get_major_key(void *item, void *data) {
+    Version *v = item;
+    return v->major / 2;
+}
+
+static int32_t
+sort_version_major_minor(void **a, void **b, void *data) {
+    Version *v1 = *a;
+    Version *v2 = *b;
+    return v1->major != v2->major ? v1->major - v2->major : v1->minor - v2->minor;
+}
+
+static void
+test_sort_by_key_and_compare(void) {
+    const int32_t num_items = 1000;
+    Version *versions = calloc(num_items, sizeof(Version));
+    DynamicArray *array = darray_new(num_items);
+    GRand *rand = g_rand_new_with_seed(42);
+    for (int32_t i = 0; i < num_items; ++i) {
+        versions[i].major = g_rand_int_range(rand, 0, 50);
+        versions[i].minor = g_rand_int_range(rand, 0, 10);
+        darray_add_item(array, &versions[i]);
+    }
+
+    // the key only orders by half of the major version, the rest is up to the compare function
+    darray_sort_by_key_and_compare(array,
+                                   get_major_key,
+                                   (DynamicArrayCompareDataFunc)sort_version_major_minor,
+                                   NULL,
+                                   NULL,
+                                   NULL);
+    for (int32_t i = 1; i < num_items; ++i) {
+        Version *prev = darray_get_item(array, i - 1);
+        Version *cur = darray_get_item(array, i);
+        const int32_t res = sort_version_major_minor((void **)&prev, (void **)&cur, NULL);
+        g_assert_cmpint(res, <=, 0);
+        // equal items keep their order
+        if (res == 0) {
+            g_assert_true(prev < cur);
+        }
+    }
+
+    g_clear_pointer(&rand, g_rand_free);
+    g_clear_pointer(&array, darray_unref);
+    g_clear_pointer(&versions, free);
+}
+
+static void
+test_partial_sort(void) {
+    const int32_t num_items = 10000;
+    DynamicArray *array = darray_new(num_items);
+    GRand *rand = g_rand_new_with_seed(num_items);
+    for (int32_t i = 0; i < num_items; ++i) {
+        // with many duplicates
+        darray_add_item(array, GINT_TO_POINTER(g_rand_int_range(rand, 0, num_items / 10)));
+    }
+    DynamicArray *sorted = darray_copy(array);
+    darray_sort(sorted, (DynamicArrayCompareDataFunc)sort_int_ascending, NULL, NULL);
+
+    const uint32_t ranges[][2] = {{0, 50}, {5000, 5050}, {9990, 10000}, {9990, 20000}, {0, 10000}, {42, 43}};
+    for (uint32_t r = 0; r < G_N_ELEMENTS(ranges); ++r) {
+        DynamicArray *partial = darray_copy(array);
+        const uint32_t start = ranges[r][0];
+        const uint32_t end = MIN(ranges[r][1], num_items);
+        darray_partial_sort(partial, start, end, (DynamicArrayCompareDataFunc)sort_int_ascending, NULL);
+        g_assert_cmpuint(darray_get_num_items(partial), ==, num_items);
+        for (uint32_t i = 0; i < num_items; ++i) {
+            const int32_t value = GPOINTER_TO_INT(darray_get_item(partial, i));
+            if (i < start) {
+                g_assert_cmpint(value, <=, GPOINTER_TO_INT(darray_get_item(sorted, start)));
+            }
+            else if (i < end) {
+                g_assert_cmpint(value, ==, GPOINTER_TO_INT(darray_get_item(sorted, i)));
+            }
+            else {
+                g_assert_cmpint(value, >=, GPOINTER_TO_INT(darray_get_item(sorted, end - 1)));
+            }
+        }
+        g_clear_pointer(&partial, darray_unref);
+    }
+
+    g_clear_pointer(&rand, g_rand_free);
+    g_clear_pointer(&sorted, darray_unref);
+    g_clear_pointer(&array, darray_unref);
+}
+
+static bool
+is_multiple_of(void *item, void *data) {
+    return GPOINTER_TO_INT(item) % GPOINTER_TO_INT(data) == 0;
+}
+
+static void
+test_filter(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+    // large enough to be split across threads
+    const int32_t num_items = 300000;
+    DynamicArray *array = darray_new(num_items);
+    for (int32_t i = 0; i < num_items; ++i) {
+        darray_add_item(array, GINT_TO_POINTER(i));
+    }
+    const int32_t divisors[] = {1, 7, 1000, num_items + 1};
+    for (uint32_t d = 0; d < G_N_ELEMENTS(divisors); ++d) {
+        const int32_t divisor = divisors[d];
+        FsearchThreadPool *pools[] = {NULL, pool};
+        for (uint32_t p = 0; p < G_N_ELEMENTS(pools); ++p) {
+            DynamicArray *filtered = darray_filter(array, is_multiple_of, pools[p], GINT_TO_POINTER(divisor));
+            g_assert_cmpuint(darray_get_num_items(filtered), ==, (num_items - 1) / divisor + 1);
+            for (uint32_t i = 0; i < darray_get_num_items(filtered); ++i) {
+                g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(filtered, i)), ==, i * divisor);
+            }
+            g_clear_pointer(&filtered, darray_unref);
+        }
+    }
+
+    DynamicArray *empty = darray_new(1);
+    DynamicArray *filtered = darray_filter(empty, is_multiple_of, pool, GINT_TO_POINTER(1));
+    g_assert_cmpuint(darray_get_num_items(filtered), ==, 0);
+    g_clear_pointer(&filtered, darray_unref);
+    g_clear_pointer(&empty, darray_unref);
+
+    g_clear_pointer(&array, darray_unref);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
 }
 
 static void
@@ -183,11 +376,121 @@ test_search(void) {
     same_elements();
 }
 
+static void
+count_destroyed(gpointer data) {
+    int32_t *num_destroyed = data;
+    (*num_destroyed)++;
+}
+
+static void
+test_user_data(void) {
+    int32_t num_destroyed = 0;
+    DynamicArray *array = darray_new(10);
+    g_assert_null(darray_get_user_data(array));
+
+    darray_set_user_data(array, &num_destroyed, count_destroyed);
+    g_assert_true(darray_get_user_data(array) == &num_destroyed);
+
+    // replacing the data frees the old one
+    darray_set_user_data(array, &num_destroyed, count_destroyed);
+    g_assert_cmpint(num_destroyed, ==, 1);
+
+    // modifying the array drops the data
+    darray_add_item(array, GINT_TO_POINTER(1));
+    g_assert_null(darray_get_user_data(array));
+    g_assert_cmpint(num_destroyed, ==, 2);
+
+    darray_set_user_data(array, &num_destroyed, count_destroyed);
+    darray_sort(array, (DynamicArrayCompareDataFunc)sort_int_ascending, NULL, NULL);
+    g_assert_null(darray_get_user_data(array));
+    g_assert_cmpint(num_destroyed, ==, 3);
+
+    // copies don't share it
+    darray_set_user_data(array, &num_destroyed, count_destroyed);
+    DynamicArray *copy = darray_copy(array);
+    g_assert_null(darray_get_user_data(copy));
+    g_clear_pointer(&copy, darray_unref);
+    g_assert_cmpint(num_destroyed, ==, 3);
+
+    g_clear_pointer(&array, darray_unref);
+    g_assert_cmpint(num_destroyed, ==, 4);
+}
+
+static uint32_t
+get_int_idx(void *item, void *data) {
+    // the base array holds the numbers 0..n in ascending order
+    return GPOINTER_TO_INT(item);
+}
+
+static void
+test_compact(void) {
+    const int32_t num_items = 100;
+    DynamicArray *base = darray_new(num_items);
+    DynamicArray *array = darray_new(num_items);
+    for (int32_t i = 0; i < num_items; ++i) {
+        darray_add_item(base, GINT_TO_POINTER(i));
+        darray_add_item(array, GINT_TO_POINTER(num_items - i - 1));
+    }
+
+    g_assert_false(darray_compact(base, base, get_int_idx, NULL));
+    g_assert_true(darray_compact(array, base, get_int_idx, NULL));
+    g_assert_cmpuint(darray_get_num_items(array), ==, num_items);
+    for (int32_t i = 0; i < num_items; ++i) {
+        g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(array, i)), ==, num_items - i - 1);
+    }
+
+    uint32_t idx = 0;
+    g_assert_true(darray_binary_search_with_data(array,
+                                                 GINT_TO_POINTER(10),
+                                                 (DynamicArrayCompareDataFunc)sort_int_descending,
+                                                 NULL,
+                                                 &idx));
+    g_assert_cmpuint(idx, ==, num_items - 11);
+
+    DynamicArray *copy = darray_copy(array);
+    g_assert_true(darray_get_item(copy, 0) == darray_get_item(array, 0));
+    g_clear_pointer(&copy, darray_unref);
+
+    // modifying a compact array turns it back into a regular one
+    darray_add_item(array, GINT_TO_POINTER(num_items));
+    g_assert_cmpuint(darray_get_num_items(array), ==, num_items + 1);
+    g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(array, 0)), ==, num_items - 1);
+    g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(array, num_items)), ==, num_items);
+
+    // items which aren't part of base can't be compacted
+    g_assert_false(darray_compact(array, base, get_int_idx, NULL));
+
+    uint32_t *indices = calloc(3, sizeof(uint32_t));
+    indices[0] = 5;
+    indices[1] = 0;
+    indices[2] = 7;
+    DynamicArray *from_indices = darray_new_compact(base, indices, 3);
+    g_assert_nonnull(from_indices);
+    g_assert_cmpuint(darray_get_num_items(from_indices), ==, 3);
+    g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(from_indices, 0)), ==, 5);
+    g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(from_indices, 2)), ==, 7);
+    g_assert_null(darray_get_item(from_indices, 3));
+    g_clear_pointer(&from_indices, darray_unref);
+
+    indices = calloc(1, sizeof(uint32_t));
+    indices[0] = num_items;
+    g_assert_null(darray_new_compact(base, indices, 1));
+
+    g_clear_pointer(&array, darray_unref);
+    g_clear_pointer(&base, darray_unref);
+}
+
 int
 main(int argc, char *argv[]) {
     g_test_init(&argc, &argv, NULL);
     g_test_add_func("/FSearch/array/main", test_main);
     g_test_add_func("/FSearch/array/sort", test_sort);
+    g_test_add_func("/FSearch/array/sort_by_key", test_sort_by_key);
+    g_test_add_func("/FSearch/array/sort_by_key_and_compare", test_sort_by_key_and_compare);
+    g_test_add_func("/FSearch/array/partial_sort", test_partial_sort);
+    g_test_add_func("/FSearch/array/filter", test_filter);
     g_test_add_func("/FSearch/array/search", test_search);
+    g_test_add_func("/FSearch/array/user_data", test_user_data);
+    g_test_add_func("/FSearch/array/compact", test_compact);
     return g_test_run();
 }
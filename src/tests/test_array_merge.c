@@ -0,0 +1,101 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_array_merge.h>
+
+// The items are values shifted by one, the lowest bit tells which array they belong to
+static int32_t
+compare_values(void **a, void **b, void *data) {
+    const uintptr_t value_a = (uintptr_t)*a >> 1;
+    const uintptr_t value_b = (uintptr_t)*b >> 1;
+    return value_a < value_b ? -1 : value_a > value_b;
+}
+
+static int
+compare_uints(const void *a, const void *b) {
+    const uint32_t value_a = *(const uint32_t *)a;
+    const uint32_t value_b = *(const uint32_t *)b;
+    return value_a < value_b ? -1 : value_a > value_b;
+}
+
+static DynamicArray *
+new_sorted_array(uint32_t num_items, uint32_t max_value, uintptr_t side) {
+    uint32_t *values = calloc(MAX(num_items, 1), sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_items; i++) {
+        values[i] = 1 + g_random_int_range(0, (int32_t)max_value);
+    }
+    qsort(values, num_items, sizeof(uint32_t), compare_uints);
+    DynamicArray *array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        darray_add_item(array, (void *)(((uintptr_t)values[i] << 1) | side));
+    }
+    free(values);
+    return array;
+}
+
+static void
+check_merge(FsearchThreadPool *pool, uint32_t num_first, uint32_t num_second, uint32_t max_value) {
+    DynamicArray *first = new_sorted_array(num_first, max_value, 0);
+    DynamicArray *second = new_sorted_array(num_second, max_value, 1);
+    FsearchArrayMerge *merge =
+        fsearch_array_merge_new(first, second, (DynamicArrayCompareDataFunc)compare_values, NULL, pool);
+    g_assert_cmpuint(fsearch_array_merge_get_num_items(merge), ==, num_first + num_second);
+
+    // the items of the first array come first if they're equal
+    DynamicArray *expected = darray_new(num_first + num_second);
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < num_first || j < num_second) {
+        void *a = i < num_first ? darray_get_item(first, i) : NULL;
+        void *b = j < num_second ? darray_get_item(second, j) : NULL;
+        if (a && (!b || compare_values(&a, &b, NULL) <= 0)) {
+            darray_add_item(expected, a);
+            i++;
+        }
+        else {
+            darray_add_item(expected, b);
+            j++;
+        }
+    }
+
+    for (uint32_t idx = 0; idx < num_first + num_second; idx++) {
+        g_assert_true(fsearch_array_merge_get_item(merge, idx) == darray_get_item(expected, idx));
+    }
+    g_assert_null(fsearch_array_merge_get_item(merge, num_first + num_second));
+
+    void *items[100];
+    for (uint32_t start = 0; start < num_first + num_second; start += 37) {
+        const uint32_t num_items = fsearch_array_merge_get_items(merge, start, G_N_ELEMENTS(items), items);
+        g_assert_cmpuint(num_items, ==, MIN(G_N_ELEMENTS(items), num_first + num_second - start));
+        for (uint32_t k = 0; k < num_items; k++) {
+            g_assert_true(items[k] == darray_get_item(expected, start + k));
+        }
+    }
+    g_assert_cmpuint(fsearch_array_merge_get_items(merge, num_first + num_second, 1, items), ==, 0);
+
+    g_clear_pointer(&merge, fsearch_array_merge_free);
+    g_clear_pointer(&expected, darray_unref);
+    g_clear_pointer(&second, darray_unref);
+    g_clear_pointer(&first, darray_unref);
+}
+
+static void
+test_array_merge(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+    check_merge(pool, 0, 0, 10);
+    check_merge(pool, 10, 0, 10);
+    check_merge(pool, 0, 10, 10);
+    check_merge(pool, 3, 5000, 1000000);
+    // lots of equal items across the blocks
+    check_merge(pool, 5000, 3000, 50);
+    check_merge(pool, 20000, 30000, 1000000);
+    check_merge(NULL, 4096, 4096, 100);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/array_merge/merge", test_array_merge);
+    return g_test_run();
+}
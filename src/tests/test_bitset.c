@@ -0,0 +1,146 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <src/fsearch_bitset.h>
+
+// spans several containers
+#define NUM_VALUES (4 * 65536 + 1000)
+
+typedef struct {
+    const bool *expected;
+    uint32_t num_values;
+    uint32_t last_value;
+} ForEachContext;
+
+static void
+check_value(uint32_t value, void *user_data) {
+    ForEachContext *ctx = user_data;
+    g_assert_true(ctx->num_values == 0 || value > ctx->last_value);
+    g_assert_true(ctx->expected[value]);
+    ctx->last_value = value;
+    ctx->num_values++;
+}
+
+static void
+check_set(FsearchBitset *set, const bool *expected) {
+    uint32_t cardinality = 0;
+    for (uint32_t i = 0; i < NUM_VALUES; i++) {
+        if (expected[i]) {
+            cardinality++;
+        }
+        if (fsearch_bitset_contains(set, i) != expected[i]) {
+            g_printerr("%u should%s be part of the set\n", i, expected[i] ? "" : " NOT");
+        }
+        g_assert_true(fsearch_bitset_contains(set, i) == expected[i]);
+    }
+    g_assert_cmpuint(fsearch_bitset_get_cardinality(set), ==, cardinality);
+
+    ForEachContext ctx = {.expected = expected};
+    fsearch_bitset_for_each(set, check_value, &ctx);
+    g_assert_cmpuint(ctx.num_values, ==, cardinality);
+}
+
+static void
+test_bitset_single_values(void) {
+    FsearchBitset *set = fsearch_bitset_new();
+    g_autofree bool *expected = calloc(NUM_VALUES, sizeof(bool));
+
+    g_assert_true(fsearch_bitset_add(set, 42));
+    g_assert_false(fsearch_bitset_add(set, 42));
+    expected[42] = true;
+    g_assert_false(fsearch_bitset_remove(set, 43));
+    check_set(set, expected);
+
+    // enough values for a container to switch to a bitmap and back again
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < 20000; i++) {
+        const uint32_t value = g_rand_int_range(rand, 65536, 2 * 65536);
+        fsearch_bitset_toggle(set, value);
+        expected[value] = !expected[value];
+    }
+    check_set(set, expected);
+    for (uint32_t i = 65536; i < 2 * 65536; i++) {
+        if (expected[i] && i % 4 != 0) {
+            g_assert_true(fsearch_bitset_remove(set, i));
+            expected[i] = false;
+        }
+    }
+    check_set(set, expected);
+    g_clear_pointer(&rand, g_rand_free);
+
+    fsearch_bitset_clear(set);
+    g_assert_cmpuint(fsearch_bitset_get_cardinality(set), ==, 0);
+    g_assert_false(fsearch_bitset_contains(set, 42));
+    g_clear_pointer(&set, fsearch_bitset_free);
+}
+
+static void
+apply_expected_range(bool *expected, uint32_t start, uint32_t end, bool toggle) {
+    for (uint32_t i = start; i < end; i++) {
+        expected[i] = toggle ? !expected[i] : true;
+    }
+}
+
+static void
+test_bitset_ranges(void) {
+    FsearchBitset *set = fsearch_bitset_new();
+    g_autofree bool *expected = calloc(NUM_VALUES, sizeof(bool));
+
+    const uint32_t ranges[][3] = {
+        // start, end, toggle
+        {0, NUM_VALUES, 0},
+        {10, 100, 1},
+        {65530, 65600, 1},
+        {100000, 3 * 65536 + 7, 1},
+        {5, 20, 0},
+        {2 * 65536, 2 * 65536, 0},
+        {3 * 65536 - 1, 3 * 65536 + 1, 1},
+        {0, NUM_VALUES, 1},
+        {70000, 70003, 1},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ranges); i++) {
+        if (ranges[i][2]) {
+            fsearch_bitset_toggle_range(set, ranges[i][0], ranges[i][1]);
+        }
+        else {
+            fsearch_bitset_add_range(set, ranges[i][0], ranges[i][1]);
+        }
+        apply_expected_range(expected, ranges[i][0], ranges[i][1], ranges[i][2]);
+        check_set(set, expected);
+    }
+    g_clear_pointer(&set, fsearch_bitset_free);
+}
+
+static void
+test_bitset_memory_usage(void) {
+    FsearchBitset *set = fsearch_bitset_new();
+    const size_t empty_size = fsearch_bitset_get_memory_usage(set);
+
+    // sparse members cost a few bytes each
+    for (uint32_t i = 0; i < 100; i++) {
+        fsearch_bitset_add(set, i * 3);
+    }
+    const size_t sparse_size = fsearch_bitset_get_memory_usage(set);
+    g_assert_cmpuint(sparse_size, >, empty_size);
+    g_assert_cmpuint(sparse_size, <, empty_size + 1024);
+
+    // a full container is a bitmap of 8 KiB
+    fsearch_bitset_add_range(set, 0, 65536);
+    const size_t dense_size = fsearch_bitset_get_memory_usage(set);
+    g_assert_cmpuint(dense_size, >=, empty_size + 8192);
+    g_assert_cmpuint(dense_size, <, empty_size + 8192 + 1024);
+
+    fsearch_bitset_clear(set);
+    g_assert_cmpuint(fsearch_bitset_get_memory_usage(set), ==, empty_size);
+    g_clear_pointer(&set, fsearch_bitset_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/bitset/single_values", test_bitset_single_values);
+    g_test_add_func("/FSearch/bitset/ranges", test_bitset_ranges);
+    g_test_add_func("/FSearch/bitset/memory_usage", test_bitset_memory_usage);
+    return g_test_run();
+}
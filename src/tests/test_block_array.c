@@ -0,0 +1,182 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_block_array.h>
+
+// enough for many blocks
+#define NUM_ITEMS 20000
+
+typedef struct {
+    uint32_t value;
+    uint32_t id;
+} TestItem;
+
+// orders by value and then by id, so only the same item compares equal
+static int32_t
+compare_items(TestItem **a, TestItem **b, void *data) {
+    if ((*a)->value != (*b)->value) {
+        return (*a)->value < (*b)->value ? -1 : 1;
+    }
+    if ((*a)->id != (*b)->id) {
+        return (*a)->id < (*b)->id ? -1 : 1;
+    }
+    return 0;
+}
+
+static void
+check_array(FsearchBlockArray *array, DynamicArray *expected) {
+    const uint32_t num_items = darray_get_num_items(expected);
+    g_assert_cmpuint(fsearch_block_array_get_num_items(array), ==, num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        g_assert_true(fsearch_block_array_get_item(array, i) == darray_get_item(expected, i));
+    }
+    g_assert_null(fsearch_block_array_get_item(array, num_items));
+
+    DynamicArray *items = fsearch_block_array_to_darray(array);
+    g_assert_cmpuint(darray_get_num_items(items), ==, num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        g_assert_true(darray_get_item(items, i) == darray_get_item(expected, i));
+    }
+    g_clear_pointer(&items, darray_unref);
+}
+
+static DynamicArray *
+expected_insert(DynamicArray *expected, TestItem *item) {
+    DynamicArray *items = darray_new(darray_get_num_items(expected) + 1);
+    bool inserted = false;
+    for (uint32_t i = 0; i < darray_get_num_items(expected); i++) {
+        TestItem *other = darray_get_item(expected, i);
+        if (!inserted && compare_items(&item, &other, NULL) < 0) {
+            darray_add_item(items, item);
+            inserted = true;
+        }
+        darray_add_item(items, other);
+    }
+    if (!inserted) {
+        darray_add_item(items, item);
+    }
+    darray_unref(expected);
+    return items;
+}
+
+static void
+test_block_array_modify(void) {
+    g_autofree TestItem *test_items = calloc(NUM_ITEMS, sizeof(TestItem));
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < NUM_ITEMS; i++) {
+        // lots of equal values
+        test_items[i].value = g_rand_int_range(rand, 0, 1000);
+        test_items[i].id = i;
+    }
+
+    // the first half is added to the array when it's created
+    DynamicArray *expected = darray_new(NUM_ITEMS);
+    for (uint32_t i = 0; i < NUM_ITEMS / 2; i++) {
+        darray_add_item(expected, &test_items[i]);
+    }
+    darray_sort(expected, (DynamicArrayCompareDataFunc)compare_items, NULL, NULL);
+    FsearchBlockArray *array = fsearch_block_array_new(expected, (DynamicArrayCompareDataFunc)compare_items, NULL);
+    check_array(array, expected);
+
+    // the second half gets inserted, which splits blocks
+    for (uint32_t i = NUM_ITEMS / 2; i < NUM_ITEMS; i++) {
+        fsearch_block_array_insert(array, &test_items[i]);
+    }
+    g_clear_pointer(&expected, darray_unref);
+    expected = darray_new(NUM_ITEMS);
+    for (uint32_t i = 0; i < NUM_ITEMS; i++) {
+        darray_add_item(expected, &test_items[i]);
+    }
+    darray_sort(expected, (DynamicArrayCompareDataFunc)compare_items, NULL, NULL);
+    check_array(array, expected);
+
+    for (uint32_t i = 0; i < NUM_ITEMS; i += 1000) {
+        uint32_t idx = 0;
+        g_assert_true(fsearch_block_array_get_item_idx(array, &test_items[i], &idx));
+        g_assert_true(darray_get_item(expected, idx) == &test_items[i]);
+    }
+
+    // removing most items empties and merges blocks
+    g_autofree bool *removed = calloc(NUM_ITEMS, sizeof(bool));
+    for (uint32_t i = 0; i < NUM_ITEMS; i++) {
+        if (i % 10 != 0) {
+            g_assert_true(fsearch_block_array_remove(array, &test_items[i]));
+            removed[i] = true;
+        }
+    }
+    g_assert_false(fsearch_block_array_remove(array, &test_items[1]));
+    DynamicArray *remaining = darray_new(NUM_ITEMS);
+    for (uint32_t i = 0; i < NUM_ITEMS; i++) {
+        TestItem *item = darray_get_item(expected, i);
+        if (!removed[item->id]) {
+            darray_add_item(remaining, item);
+        }
+    }
+    check_array(array, remaining);
+    g_assert_false(fsearch_block_array_get_item_idx(array, &test_items[1], NULL));
+
+    // items which end up between the remaining ones
+    for (uint32_t i = 1; i < NUM_ITEMS; i += 100) {
+        fsearch_block_array_insert(array, &test_items[i]);
+        remaining = expected_insert(remaining, &test_items[i]);
+    }
+    check_array(array, remaining);
+
+    g_clear_pointer(&remaining, darray_unref);
+    g_clear_pointer(&expected, darray_unref);
+    g_clear_pointer(&array, fsearch_block_array_free);
+    g_rand_free(rand);
+}
+
+static void
+test_block_array_get_items(void) {
+    TestItem test_items[2000];
+    DynamicArray *items = darray_new(G_N_ELEMENTS(test_items));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(test_items); i++) {
+        test_items[i].value = i;
+        test_items[i].id = 0;
+        darray_add_item(items, &test_items[i]);
+    }
+    FsearchBlockArray *array = fsearch_block_array_new(items, (DynamicArrayCompareDataFunc)compare_items, NULL);
+
+    void *dest[600] = {};
+    // spans several blocks
+    g_assert_cmpuint(fsearch_block_array_get_items(array, 300, G_N_ELEMENTS(dest), dest), ==, G_N_ELEMENTS(dest));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(dest); i++) {
+        g_assert_true(dest[i] == &test_items[300 + i]);
+    }
+    // only the items up to the end
+    g_assert_cmpuint(fsearch_block_array_get_items(array, 1900, G_N_ELEMENTS(dest), dest), ==, 100);
+    g_assert_true(dest[99] == &test_items[1999]);
+    g_assert_cmpuint(fsearch_block_array_get_items(array, 2000, G_N_ELEMENTS(dest), dest), ==, 0);
+
+    g_clear_pointer(&array, fsearch_block_array_free);
+    g_clear_pointer(&items, darray_unref);
+}
+
+static void
+test_block_array_empty(void) {
+    FsearchBlockArray *array = fsearch_block_array_new(NULL, (DynamicArrayCompareDataFunc)compare_items, NULL);
+    g_assert_cmpuint(fsearch_block_array_get_num_items(array), ==, 0);
+    g_assert_null(fsearch_block_array_get_item(array, 0));
+
+    TestItem item = {.value = 1};
+    g_assert_false(fsearch_block_array_remove(array, &item));
+    fsearch_block_array_insert(array, &item);
+    g_assert_true(fsearch_block_array_get_item(array, 0) == &item);
+    g_assert_true(fsearch_block_array_remove(array, &item));
+    g_assert_cmpuint(fsearch_block_array_get_num_items(array), ==, 0);
+    fsearch_block_array_insert(array, &item);
+    g_assert_cmpuint(fsearch_block_array_get_num_items(array), ==, 1);
+
+    g_clear_pointer(&array, fsearch_block_array_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/block_array/modify", test_block_array_modify);
+    g_test_add_func("/FSearch/block_array/get_items", test_block_array_get_items);
+    g_test_add_func("/FSearch/block_array/empty", test_block_array_empty);
+    return g_test_run();
+}
@@ -0,0 +1,126 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <src/fsearch_column_filter.h>
+
+static void
+check_range(const int64_t *values, uint32_t num_values, int64_t min, int64_t max) {
+    const uint32_t num_words = (num_values + 63) / 64;
+    g_autofree uint64_t *bitmap = calloc(num_words + 1, sizeof(uint64_t));
+    for (uint32_t i = 0; i < num_words; i++) {
+        bitmap[i] = UINT64_MAX;
+    }
+    // bits which were already cleared stay cleared
+    if (num_words > 0) {
+        bitmap[0] &= ~UINT64_C(2);
+    }
+    fsearch_column_filter_range(values, num_values, min, max, bitmap);
+
+    for (uint32_t i = 0; i < num_words * 64; i++) {
+        const bool expected = i < num_values && i != 1 && values[i] >= min && values[i] <= max;
+        const bool set = bitmap[i / 64] & (UINT64_C(1) << (i % 64));
+        if (set != expected) {
+            g_printerr("bit %u should%s be set for [%" G_GINT64_FORMAT ", %" G_GINT64_FORMAT "]\n",
+                       i,
+                       expected ? "" : " NOT",
+                       min,
+                       max);
+        }
+        g_assert_true(set == expected);
+    }
+}
+
+static void
+test_column_filter_range(void) {
+    // long enough for multiple full words and a tail
+    const uint32_t num_values = 1000;
+    g_autofree int64_t *values = calloc(num_values, sizeof(int64_t));
+    const int64_t special_values[] = {INT64_MIN, INT64_MIN + 1, -1, 0, 1, 1024, INT64_MAX - 1, INT64_MAX};
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < num_values; i++) {
+        if (i % 3 == 0) {
+            values[i] = special_values[g_rand_int_range(rand, 0, G_N_ELEMENTS(special_values))];
+        }
+        else {
+            values[i] = g_rand_int_range(rand, -2000, 2000);
+        }
+    }
+    g_clear_pointer(&rand, g_rand_free);
+
+    const int64_t ranges[][2] = {
+        {0, 0},
+        {-100, 100},
+        {1, INT64_MAX},
+        {INT64_MIN, -1},
+        {INT64_MIN, INT64_MAX},
+        {INT64_MAX, INT64_MAX},
+        {INT64_MIN, INT64_MIN},
+        // empty
+        {10, 9},
+        {INT64_MAX, INT64_MIN},
+    };
+    const uint32_t lengths[] = {0, 1, 63, 64, 65, 128, 999, 1000};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ranges); i++) {
+        for (uint32_t j = 0; j < G_N_ELEMENTS(lengths); j++) {
+            check_range(values, lengths[j], ranges[i][0], ranges[i][1]);
+        }
+    }
+}
+
+static void
+check_masked(const uint16_t *values, uint32_t num_values, uint16_t mask, uint16_t value, bool equal) {
+    const uint32_t num_words = (num_values + 63) / 64;
+    g_autofree uint64_t *bitmap = calloc(num_words + 1, sizeof(uint64_t));
+    for (uint32_t i = 0; i < num_words; i++) {
+        bitmap[i] = UINT64_MAX;
+    }
+    if (num_words > 0) {
+        bitmap[0] &= ~UINT64_C(2);
+    }
+    fsearch_column_filter_masked(values, num_values, mask, value, equal, bitmap);
+
+    for (uint32_t i = 0; i < num_words * 64; i++) {
+        const bool expected = i < num_values && i != 1 && ((values[i] & mask) == value) == equal;
+        const bool set = bitmap[i / 64] & (UINT64_C(1) << (i % 64));
+        if (set != expected) {
+            g_printerr("bit %u should%s be set for mask %o value %o\n", i, expected ? "" : " NOT", mask, value);
+        }
+        g_assert_true(set == expected);
+    }
+}
+
+static void
+test_column_filter_masked(void) {
+    const uint32_t num_values = 1000;
+    g_autofree uint16_t *values = calloc(num_values, sizeof(uint16_t));
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < num_values; i++) {
+        values[i] = i % 5 == 0 ? UINT16_MAX : (uint16_t)g_rand_int_range(rand, 0, 010000);
+    }
+    g_clear_pointer(&rand, g_rand_free);
+
+    const uint16_t masks[][2] = {
+        {UINT16_MAX, 0},
+        {UINT16_MAX, UINT16_MAX},
+        {07777, 0755},
+        {0002, 0002},
+        {0022, 0},
+        {0, 0},
+    };
+    const uint32_t lengths[] = {0, 1, 63, 64, 65, 128, 999, 1000};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(masks); i++) {
+        for (uint32_t j = 0; j < G_N_ELEMENTS(lengths); j++) {
+            check_masked(values, lengths[j], masks[i][0], masks[i][1], true);
+            check_masked(values, lengths[j], masks[i][0], masks[i][1], false);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/column_filter/range", test_column_filter_range);
+    g_test_add_func("/FSearch/column_filter/masked", test_column_filter_masked);
+    return g_test_run();
+}
@@ -0,0 +1,139 @@
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <src/fsearch_content_search.h>
+
+typedef struct {
+    char *dir;
+    char *path;
+} TestFile;
+
+static void
+test_file_init(TestFile *file, const char *contents, size_t len) {
+    file->dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_nonnull(file->dir);
+    file->path = g_build_filename(file->dir, "file", NULL);
+    g_assert_true(g_file_set_contents(file->path, contents, (gssize)len, NULL));
+}
+
+static void
+test_file_clear(TestFile *file) {
+    g_unlink(file->path);
+    g_rmdir(file->dir);
+    g_clear_pointer(&file->path, g_free);
+    g_clear_pointer(&file->dir, g_free);
+}
+
+static bool
+file_matches(const char *contents, const char *needle, bool match_case, bool regex) {
+    TestFile file = {};
+    test_file_init(&file, contents, strlen(contents));
+    FsearchContentSearch *search = fsearch_content_search_new(needle, match_case, regex);
+    g_assert_nonnull(search);
+    const bool matches = fsearch_content_search_matches_file(search, file.path, NULL);
+    g_clear_pointer(&search, fsearch_content_search_free);
+    test_file_clear(&file);
+    return matches;
+}
+
+static void
+test_content_search_literal(void) {
+    g_assert_true(file_matches("first line\nsecond line\n", "second", true, false));
+    g_assert_false(file_matches("first line\nsecond line\n", "Second", true, false));
+    g_assert_true(file_matches("first line\nsecond line\n", "SECOND", false, false));
+    g_assert_true(file_matches("Grüße", "GRÜßE", false, false));
+    g_assert_false(file_matches("first line", "third", false, false));
+}
+
+static void
+test_content_search_regex(void) {
+    g_assert_true(file_matches("first line\nsecond line\n", "^second", false, true));
+    g_assert_false(file_matches("first line\nsecond line\n", "^line", false, true));
+    g_assert_null(fsearch_content_search_new("(", false, true));
+}
+
+static void
+test_content_search_skipped_files(void) {
+    FsearchContentSearch *search = fsearch_content_search_new("needle", true, false);
+
+    TestFile file = {};
+    test_file_init(&file, "binary\0needle", 13);
+    g_assert_false(fsearch_content_search_matches_file(search, file.path, NULL));
+    test_file_clear(&file);
+
+    // folders and missing files
+    g_autofree char *dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_false(fsearch_content_search_matches_file(search, dir, NULL));
+    g_rmdir(dir);
+    g_assert_false(fsearch_content_search_matches_file(search, dir, NULL));
+
+    g_clear_pointer(&search, fsearch_content_search_free);
+}
+
+static void
+set_mtime(const char *path, time_t mtime) {
+    const struct timespec times[2] = {{.tv_nsec = UTIME_OMIT}, {.tv_sec = mtime}};
+    g_assert_cmpint(utimensat(AT_FDCWD, path, times, 0), ==, 0);
+}
+
+static void
+overwrite(const char *path, const char *contents) {
+    FILE *fp = fopen(path, "r+");
+    g_assert_nonnull(fp);
+    fputs(contents, fp);
+    fclose(fp);
+}
+
+static void
+test_content_search_cache(void) {
+    TestFile file = {};
+    test_file_init(&file, "cached contents", 15);
+    set_mtime(file.path, 1000);
+
+    FsearchContentSearch *search = fsearch_content_search_new("cached", true, false);
+    g_assert_true(fsearch_content_search_matches_file(search, file.path, NULL));
+    g_clear_pointer(&search, fsearch_content_search_free);
+
+    // the file looks unchanged, so the result of the earlier search for the same needle is used
+    overwrite(file.path, "change");
+    set_mtime(file.path, 1000);
+    search = fsearch_content_search_new("cached", true, false);
+    g_assert_true(fsearch_content_search_matches_file(search, file.path, NULL));
+
+    set_mtime(file.path, 2000);
+    g_assert_false(fsearch_content_search_matches_file(search, file.path, NULL));
+    g_clear_pointer(&search, fsearch_content_search_free);
+
+    test_file_clear(&file);
+}
+
+static void
+test_content_search_cancelled(void) {
+    TestFile file = {};
+    test_file_init(&file, "contents", 8);
+
+    g_autoptr(GCancellable) cancellable = g_cancellable_new();
+    g_cancellable_cancel(cancellable);
+    FsearchContentSearch *search = fsearch_content_search_new("contents", true, false);
+    g_assert_false(fsearch_content_search_matches_file(search, file.path, cancellable));
+    g_assert_true(fsearch_content_search_matches_file(search, file.path, NULL));
+    g_clear_pointer(&search, fsearch_content_search_free);
+
+    test_file_clear(&file);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/content_search/literal", test_content_search_literal);
+    g_test_add_func("/FSearch/content_search/regex", test_content_search_regex);
+    g_test_add_func("/FSearch/content_search/skipped_files", test_content_search_skipped_files);
+    g_test_add_func("/FSearch/content_search/cache", test_content_search_cache);
+    g_test_add_func("/FSearch/content_search/cancelled", test_content_search_cancelled);
+    return g_test_run();
+}
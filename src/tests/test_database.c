@@ -0,0 +1,310 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <src/fsearch_database.h>
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_index.h>
+
+#include "test_files.h"
+
+typedef struct {
+    char *dir;
+    char *one;
+    char *two;
+    GList *indexes;
+} DatabaseFixture;
+
+static void
+write_file(const char *dir, const char *name, size_t size) {
+    g_autofree char *path = g_build_filename(dir, name, NULL);
+    g_autofree char *content = g_malloc0(size + 1);
+    memset(content, 'x', size);
+    g_assert_true(g_file_set_contents(path, content, (gssize)size, NULL));
+}
+
+static void
+make_dir(const char *dir, const char *name) {
+    g_autofree char *path = g_build_filename(dir, name, NULL);
+    g_assert_cmpint(g_mkdir(path, 0755), ==, 0);
+}
+
+// Two indexes with a few folders and files each, all names and sizes are unique
+static void
+fixture_init(DatabaseFixture *fixture) {
+    fixture->dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+    fixture->one = g_build_filename(fixture->dir, "one", NULL);
+    fixture->two = g_build_filename(fixture->dir, "two", NULL);
+    g_assert_cmpint(g_mkdir(fixture->one, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(fixture->two, 0755), ==, 0);
+
+    make_dir(fixture->one, "alpha");
+    make_dir(fixture->one, "alpha/beta");
+    write_file(fixture->one, "a.txt", 1);
+    write_file(fixture->one, "alpha/b.pdf", 2);
+    write_file(fixture->one, "alpha/beta/c.txt", 3);
+    make_dir(fixture->two, "gamma");
+    make_dir(fixture->two, "delta");
+    write_file(fixture->two, "d.txt", 4);
+    write_file(fixture->two, "gamma/e.pdf", 5);
+    write_file(fixture->two, "delta/f", 6);
+
+    // both are marked for updates, db_rescan_index has to leave the other one alone anyway
+    fixture->indexes = g_list_append(fixture->indexes,
+                                     fsearch_index_new(FSEARCH_INDEX_FOLDER_TYPE, fixture->one, true, true, false, 0));
+    fixture->indexes = g_list_append(fixture->indexes,
+                                     fsearch_index_new(FSEARCH_INDEX_FOLDER_TYPE, fixture->two, true, true, false, 0));
+}
+
+static void
+fixture_clear(DatabaseFixture *fixture) {
+    test_files_remove_recursive(fixture->dir);
+    g_list_free_full(g_steal_pointer(&fixture->indexes), (GDestroyNotify)fsearch_index_free);
+    g_clear_pointer(&fixture->two, g_free);
+    g_clear_pointer(&fixture->one, g_free);
+    g_clear_pointer(&fixture->dir, g_free);
+}
+
+// The full paths of the entries sorted by sort_type, folders first, or NULL if db isn't sorted by sort_type.
+// The positions of the entries sorted by name must match their indices.
+static GPtrArray *
+get_sorted_paths(FsearchDatabase *db, FsearchDatabaseIndexType sort_type) {
+    db_lock(db);
+    if (!db_has_entries_sorted_by_type(db, sort_type)) {
+        db_unlock(db);
+        return NULL;
+    }
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    DynamicArray *arrays[2] = {db_get_folders_sorted(db, sort_type), db_get_files_sorted(db, sort_type)};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(arrays); i++) {
+        for (uint32_t j = 0; j < darray_get_num_items(arrays[i]); j++) {
+            FsearchDatabaseEntry *entry = darray_get_item(arrays[i], j);
+            if (sort_type == DATABASE_INDEX_TYPE_NAME) {
+                g_assert_cmpuint(db_entry_get_idx(entry), ==, j);
+            }
+            if (sort_type == DATABASE_INDEX_TYPE_MODIFICATION_TIME && j > 0) {
+                FsearchDatabaseEntry *prev = darray_get_item(arrays[i], j - 1);
+                g_assert_cmpint(db_entry_get_mtime(prev), <=, db_entry_get_mtime(entry));
+            }
+            GString *path = g_string_new(NULL);
+            db_entry_append_full_path(entry, path);
+            g_ptr_array_add(paths, g_string_free(path, FALSE));
+        }
+        g_clear_pointer(&arrays[i], darray_unref);
+    }
+    db_unlock(db);
+    return paths;
+}
+
+static void
+assert_paths_equal(GPtrArray *paths, GPtrArray *expected) {
+    g_assert_cmpuint(paths->len, ==, expected->len);
+    for (uint32_t i = 0; i < paths->len; i++) {
+        g_assert_cmpstr(g_ptr_array_index(paths, i), ==, g_ptr_array_index(expected, i));
+    }
+}
+
+static gint
+compare_paths(gconstpointer a, gconstpointer b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static void
+assert_databases_equal(FsearchDatabase *db, FsearchDatabase *expected) {
+    g_assert_cmpuint(db_get_num_files(db), ==, db_get_num_files(expected));
+    g_assert_cmpuint(db_get_num_folders(db), ==, db_get_num_folders(expected));
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_TYPES; i++) {
+        g_autoptr(GPtrArray) paths = get_sorted_paths(db, i);
+        g_autoptr(GPtrArray) expected_paths = get_sorted_paths(expected, i);
+        if (!paths || !expected_paths) {
+            continue;
+        }
+        // entries with the same times, types or extensions can be in any order
+        if (i > DATABASE_INDEX_TYPE_SIZE) {
+            g_ptr_array_sort(paths, compare_paths);
+            g_ptr_array_sort(expected_paths, compare_paths);
+        }
+        assert_paths_equal(paths, expected_paths);
+    }
+}
+
+// Compares the entries of db with those of expected, which are sorted by name in both
+static void
+assert_entries_equal(FsearchDatabase *db, FsearchDatabase *expected) {
+    db_lock(db);
+    db_lock(expected);
+    for (uint32_t i = 0; i < 2; i++) {
+        g_autoptr(DynamicArray) entries = i == 0 ? db_get_folders_sorted(db, DATABASE_INDEX_TYPE_NAME)
+                                                 : db_get_files_sorted(db, DATABASE_INDEX_TYPE_NAME);
+        g_autoptr(DynamicArray) expected_entries = i == 0 ? db_get_folders_sorted(expected, DATABASE_INDEX_TYPE_NAME)
+                                                          : db_get_files_sorted(expected, DATABASE_INDEX_TYPE_NAME);
+        g_assert_cmpuint(darray_get_num_items(entries), ==, darray_get_num_items(expected_entries));
+        for (uint32_t j = 0; j < darray_get_num_items(entries); j++) {
+            FsearchDatabaseEntry *entry = darray_get_item(entries, j);
+            FsearchDatabaseEntry *expected_entry = darray_get_item(expected_entries, j);
+            g_assert_cmpint(db_entry_get_type(entry), ==, db_entry_get_type(expected_entry));
+            g_assert_cmpstr(db_entry_get_name_raw(entry), ==, db_entry_get_name_raw(expected_entry));
+            g_assert_cmpint(db_entry_get_size(entry), ==, db_entry_get_size(expected_entry));
+            g_assert_cmpint(db_entry_get_mtime(entry), ==, db_entry_get_mtime(expected_entry));
+            g_autoptr(GString) path = db_entry_get_path_full(entry);
+            g_autoptr(GString) expected_path = db_entry_get_path_full(expected_entry);
+            g_assert_cmpstr(path->str, ==, expected_path->str);
+        }
+    }
+    db_unlock(expected);
+    db_unlock(db);
+}
+
+static FsearchDatabase *
+scan_database(GList *indexes) {
+    FsearchDatabase *db = db_new(indexes, NULL, NULL, false);
+    g_assert_true(db_scan(db, NULL, NULL));
+    return db;
+}
+
+static void
+test_database_rescan_index(void) {
+    DatabaseFixture fixture = {};
+    fixture_init(&fixture);
+    FsearchDatabase *old_db = scan_database(fixture.indexes);
+    g_autoptr(GPtrArray) old_paths = get_sorted_paths(old_db, DATABASE_INDEX_TYPE_PATH);
+    g_assert_nonnull(old_paths);
+
+    // the modification times of the folders only have a resolution of seconds
+    g_usleep(G_USEC_PER_SEC + G_USEC_PER_SEC / 10);
+    write_file(fixture.two, "gamma/g.txt", 7);
+    write_file(fixture.two, "d.txt", 40);
+    make_dir(fixture.two, "epsilon");
+    write_file(fixture.two, "epsilon/h", 8);
+    g_autofree char *removed = g_build_filename(fixture.two, "delta", NULL);
+    test_files_remove_recursive(removed);
+    FsearchDatabase *expected = scan_database(fixture.indexes);
+
+    // changes of the other index mustn't show up, it's carried over without looking at the filesystem
+    write_file(fixture.one, "alpha/i.txt", 9);
+
+    FsearchDatabase *db = db_new(fixture.indexes, NULL, NULL, false);
+    g_assert_true(db_rescan_index(db, old_db, g_list_last(fixture.indexes)->data, NULL, NULL));
+    assert_databases_equal(db, expected);
+
+    // old_db is left as it was
+    g_autoptr(GPtrArray) paths = get_sorted_paths(old_db, DATABASE_INDEX_TYPE_PATH);
+    assert_paths_equal(paths, old_paths);
+
+    // the other index shows its changes once it's rescanned as well
+    FsearchDatabase *next_db = db_new(fixture.indexes, NULL, NULL, false);
+    g_assert_true(db_rescan_index(next_db, db, fixture.indexes->data, NULL, NULL));
+    g_clear_pointer(&expected, db_unref);
+    expected = scan_database(fixture.indexes);
+    assert_databases_equal(next_db, expected);
+
+    g_clear_pointer(&next_db, db_unref);
+    g_clear_pointer(&db, db_unref);
+    g_clear_pointer(&expected, db_unref);
+    g_clear_pointer(&old_db, db_unref);
+    fixture_clear(&fixture);
+}
+
+static FsearchDatabase *
+save_database(DatabaseFixture *fixture, FsearchDatabaseCompression compression, bool compact_indexes) {
+    FsearchDatabase *db = db_new(fixture->indexes, NULL, NULL, false);
+    db_set_compression(db, compression);
+    db_set_compact_indexes(db, compact_indexes);
+    g_assert_true(db_scan(db, NULL, NULL));
+    g_assert_true(db_save(db, fixture->dir, NULL, NULL));
+    return db;
+}
+
+static FsearchDatabase *
+load_database(const char *file_path, bool compact_indexes, bool expect_success) {
+    FsearchDatabase *db = db_new(NULL, NULL, NULL, false);
+    db_set_compact_indexes(db, compact_indexes);
+    g_assert_true(db_load(db, file_path, NULL, NULL) == expect_success);
+    if (!expect_success) {
+        g_assert_cmpuint(db_get_num_entries(db), ==, 0);
+    }
+    return db;
+}
+
+static void
+test_database_save_load(void) {
+    for (FsearchDatabaseCompression compression = 0; compression < NUM_DATABASE_COMPRESSION_TYPES; compression++) {
+        for (uint32_t compact = 0; compact < 2; compact++) {
+            DatabaseFixture fixture = {};
+            fixture_init(&fixture);
+            FsearchDatabase *db = save_database(&fixture, compression, compact);
+            g_autofree char *file_path = g_build_filename(fixture.dir, "fsearch.db", NULL);
+
+            FsearchDatabase *loaded_db = load_database(file_path, compact, true);
+            assert_entries_equal(loaded_db, db);
+            assert_databases_equal(loaded_db, db);
+
+            g_clear_pointer(&loaded_db, db_unref);
+            g_clear_pointer(&db, db_unref);
+            fixture_clear(&fixture);
+        }
+    }
+}
+
+static void
+test_database_load_truncated(void) {
+    DatabaseFixture fixture = {};
+    fixture_init(&fixture);
+    FsearchDatabase *db = save_database(&fixture, DATABASE_COMPRESSION_NONE, false);
+    g_autofree char *file_path = g_build_filename(fixture.dir, "fsearch.db", NULL);
+    g_autofree char *contents = NULL;
+    gsize size = 0;
+    g_assert_true(g_file_get_contents(file_path, &contents, &size, NULL));
+
+    // cut off in the header, in the entry blocks and in the sorted arrays
+    const gsize sizes[] = {0, 3, 20, size / 2, size - 8};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(sizes); i++) {
+        g_assert_true(g_file_set_contents(file_path, contents, (gssize)sizes[i], NULL));
+        FsearchDatabase *loaded_db = load_database(file_path, false, false);
+        g_clear_pointer(&loaded_db, db_unref);
+    }
+
+    g_clear_pointer(&db, db_unref);
+    fixture_clear(&fixture);
+}
+
+static void
+test_database_load_invalid_parent(void) {
+    DatabaseFixture fixture = {};
+    fixture_init(&fixture);
+    FsearchDatabase *db = save_database(&fixture, DATABASE_COMPRESSION_NONE, false);
+    g_autofree char *file_path = g_build_filename(fixture.dir, "fsearch.db", NULL);
+    g_autofree char *contents = NULL;
+    gsize size = 0;
+    g_assert_true(g_file_get_contents(file_path, &contents, &size, NULL));
+
+    // No other name starts like gamma/e.pdf, so it's stored in full. Its size and modification time are followed
+    // by the index of its parent folder.
+    const char *name = "e.pdf";
+    char *pos = memmem(contents, size, name, strlen(name));
+    g_assert_nonnull(pos);
+    pos += strlen(name) + 8 + 8;
+    g_assert_cmpuint(pos + 4 - contents, <=, size);
+    const uint32_t parent_idx = UINT32_MAX / 2;
+    memcpy(pos, &parent_idx, 4);
+    g_assert_true(g_file_set_contents(file_path, contents, (gssize)size, NULL));
+
+    FsearchDatabase *loaded_db = load_database(file_path, false, false);
+    g_clear_pointer(&loaded_db, db_unref);
+    g_clear_pointer(&db, db_unref);
+    fixture_clear(&fixture);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/database/rescan_index", test_database_rescan_index);
+    g_test_add_func("/FSearch/database/save_load", test_database_save_load);
+    g_test_add_func("/FSearch/database/load_truncated", test_database_load_truncated);
+    g_test_add_func("/FSearch/database/load_invalid_parent", test_database_load_invalid_parent);
+    return g_test_run();
+}
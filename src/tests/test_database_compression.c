@@ -0,0 +1,73 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_database_compression.h>
+
+void
+test_encode_indexes(void) {
+    const uint32_t indexes[] = {0, 1, 2, 3, 1000, 999, 70000, 5, UINT32_MAX, 0, 42};
+    const uint32_t num_indexes = G_N_ELEMENTS(indexes);
+
+    size_t encoded_len = 0;
+    g_autofree uint8_t *encoded = db_compression_encode_indexes(indexes, num_indexes, &encoded_len);
+    g_assert_nonnull(encoded);
+    g_assert_cmpuint(encoded_len, <=, db_compression_get_max_encoded_indexes_size(num_indexes));
+
+    uint32_t decoded[G_N_ELEMENTS(indexes)] = {0};
+    g_assert_true(db_compression_decode_indexes(encoded, encoded_len, decoded, num_indexes));
+    g_assert_cmpmem(decoded, sizeof(decoded), indexes, sizeof(indexes));
+
+    // truncated or trailing data
+    g_assert_false(db_compression_decode_indexes(encoded, encoded_len - 1, decoded, num_indexes));
+    g_assert_false(db_compression_decode_indexes(encoded, encoded_len, decoded, num_indexes - 1));
+
+    // ascending indexes only need a single byte each
+    uint32_t ascending[1000];
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ascending); i++) {
+        ascending[i] = i * 2;
+    }
+    g_autofree uint8_t *encoded_ascending =
+        db_compression_encode_indexes(ascending, G_N_ELEMENTS(ascending), &encoded_len);
+    g_assert_cmpuint(encoded_len, ==, G_N_ELEMENTS(ascending));
+}
+
+void
+test_compress(void) {
+    GString *data = g_string_new(NULL);
+    for (uint32_t i = 0; i < 10000; i++) {
+        g_string_append_printf(data, "file_%d.txt", i % 100);
+    }
+
+    for (uint32_t c = 0; c < NUM_DATABASE_COMPRESSION_TYPES; c++) {
+        if (!db_compression_is_supported(c)) {
+            continue;
+        }
+        size_t compressed_len = 0;
+        g_autofree uint8_t *compressed =
+            db_compression_compress(c, (const uint8_t *)data->str, data->len, &compressed_len);
+        g_assert_nonnull(compressed);
+        if (c != DATABASE_COMPRESSION_NONE) {
+            g_assert_cmpuint(compressed_len, <, data->len);
+        }
+
+        g_autofree uint8_t *decompressed = malloc(data->len + 1);
+        g_assert_true(db_compression_decompress(c, compressed, compressed_len, decompressed, data->len));
+        g_assert_cmpmem(decompressed, data->len, data->str, data->len);
+
+        // the size of the decompressed data must match
+        g_assert_false(db_compression_decompress(c, compressed, compressed_len, decompressed, data->len - 1));
+    }
+    g_assert_true(db_compression_is_supported(DATABASE_COMPRESSION_NONE));
+    g_assert_false(db_compression_is_supported(NUM_DATABASE_COMPRESSION_TYPES));
+
+    g_string_free(data, TRUE);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/database_compression/encode_indexes", test_encode_indexes);
+    g_test_add_func("/FSearch/database_compression/compress", test_compress);
+    return g_test_run();
+}
@@ -0,0 +1,95 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <src/fsearch_database_journal.h>
+
+static char *
+get_journal_path(void) {
+    g_autofree char *dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_nonnull(dir);
+    return g_build_filename(dir, "fsearch.db.journal", NULL);
+}
+
+static void
+remove_journal(const char *path) {
+    g_unlink(path);
+    g_autofree char *dir = g_path_get_dirname(path);
+    g_rmdir(dir);
+}
+
+static void
+append_path(FsearchDatabaseJournal *journal, const char *path) {
+    g_autoptr(GPtrArray) paths = g_ptr_array_new();
+    g_ptr_array_add(paths, (gpointer)path);
+    g_assert_true(db_journal_append_paths(journal, paths));
+}
+
+void
+test_journal_append(void) {
+    g_autofree char *path = get_journal_path();
+
+    FsearchDatabaseJournal *journal = db_journal_open(path);
+    g_assert_nonnull(journal);
+    g_assert_cmpint(db_journal_get_first_record_time(journal), ==, 0);
+    append_path(journal, "/home/user/a");
+    append_path(journal, "/home/user/b");
+    g_assert_cmpint(db_journal_get_first_record_time(journal), >, 0);
+    const uint64_t size = db_journal_get_size(journal);
+    g_clear_pointer(&journal, db_journal_close);
+
+    // records are appended to an existing journal
+    journal = db_journal_open(path);
+    g_assert_nonnull(journal);
+    g_assert_cmpuint(db_journal_get_size(journal), ==, size);
+    g_assert_cmpint(db_journal_get_first_record_time(journal), >, 0);
+    append_path(journal, "/home/user/c");
+    g_clear_pointer(&journal, db_journal_close);
+
+    g_autoptr(GPtrArray) paths = db_journal_read_paths(path);
+    g_assert_nonnull(paths);
+    g_assert_cmpuint(paths->len, ==, 3);
+    g_assert_cmpstr(g_ptr_array_index(paths, 0), ==, "/home/user/a");
+    g_assert_cmpstr(g_ptr_array_index(paths, 1), ==, "/home/user/b");
+    g_assert_cmpstr(g_ptr_array_index(paths, 2), ==, "/home/user/c");
+
+    remove_journal(path);
+    g_assert_null(db_journal_read_paths(path));
+}
+
+void
+test_journal_truncated(void) {
+    g_autofree char *path = get_journal_path();
+
+    FsearchDatabaseJournal *journal = db_journal_open(path);
+    append_path(journal, "/home/user/a");
+    append_path(journal, "/home/user/b");
+    const uint64_t size = db_journal_get_size(journal);
+    g_clear_pointer(&journal, db_journal_close);
+
+    // simulate a crash while the last record was written
+    g_assert_cmpint(truncate(path, (off_t)size - 2), ==, 0);
+    g_autoptr(GPtrArray) paths = db_journal_read_paths(path);
+    g_assert_cmpuint(paths->len, ==, 1);
+
+    // new records must not end up behind the incomplete one
+    journal = db_journal_open(path);
+    append_path(journal, "/home/user/c");
+    g_clear_pointer(&journal, db_journal_close);
+
+    g_autoptr(GPtrArray) new_paths = db_journal_read_paths(path);
+    g_assert_cmpuint(new_paths->len, ==, 2);
+    g_assert_cmpstr(g_ptr_array_index(new_paths, 0), ==, "/home/user/a");
+    g_assert_cmpstr(g_ptr_array_index(new_paths, 1), ==, "/home/user/c");
+
+    remove_journal(path);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/database_journal/append", test_journal_append);
+    g_test_add_func("/FSearch/database_journal/truncated", test_journal_truncated);
+    return g_test_run();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <src/fsearch_array.h>
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+
+// Helpers for the tests of the indexes of the entry names
+
+typedef bool (*TestEntriesMatchFunc)(const char *name, const char *query);
+
+// Returns an array of file entries with the given names, the idx of every entry is its position
+static inline DynamicArray *
+test_entries_new(FsearchMemoryPool *pool, const char **entry_names, uint32_t num_names) {
+    DynamicArray *entries = darray_new(num_names);
+    for (uint32_t i = 0; i < num_names; i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+        db_entry_set_name(entry, entry_names[i]);
+        db_entry_set_idx(entry, i);
+        darray_add_item(entries, entry);
+    }
+    return entries;
+}
+
+// Returns entries without every third entry and with the entries of added in between, the idx of every entry is
+// set to its position in the returned array
+static inline DynamicArray *
+test_entries_new_updated(DynamicArray *entries, DynamicArray *added) {
+    DynamicArray *updated = darray_new(darray_get_num_items(entries) + darray_get_num_items(added));
+    for (uint32_t i = 0; i < darray_get_num_items(entries); i++) {
+        if (i % 3 == 0) {
+            continue;
+        }
+        darray_add_item(updated, darray_get_item(entries, i));
+        if (i % 3 == 1 && i / 3 < darray_get_num_items(added)) {
+            darray_add_item(updated, darray_get_item(added, i / 3));
+        }
+    }
+    for (uint32_t i = 0; i < darray_get_num_items(updated); i++) {
+        db_entry_set_idx(darray_get_item(updated, i), i);
+    }
+    return updated;
+}
+
+// The positions of a lookup for query must be sorted and contain every entry whose name matches query
+static inline void
+test_entries_check_candidates(DynamicArray *entries,
+                              const uint32_t *positions,
+                              uint32_t num_positions,
+                              TestEntriesMatchFunc match_func,
+                              const char *query) {
+    for (uint32_t i = 1; i < num_positions; i++) {
+        g_assert_cmpuint(positions[i - 1], <, positions[i]);
+    }
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < darray_get_num_items(entries); i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!match_func(db_entry_get_name_raw(entry), query)) {
+            continue;
+        }
+        while (j < num_positions && positions[j] < i) {
+            j++;
+        }
+        if (j == num_positions || positions[j] != i) {
+            g_printerr("[%s] should be a candidate for %s\n", db_entry_get_name_raw(entry), query);
+        }
+        g_assert_true(j < num_positions && positions[j] == i);
+    }
+}
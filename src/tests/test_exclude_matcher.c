@@ -0,0 +1,107 @@
+#include <fnmatch.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_exclude_matcher.h>
+#include <src/fsearch_exclude_path.h>
+
+static char *exclude_files[] = {
+    "node_modules",
+    "*.o",
+    "*~",
+    "build*",
+    ".#*",
+    "*.sw?",
+    "core.*.dump",
+    "*cache*",
+    "[Tt]humbs.db",
+    "\\*literal",
+    NULL,
+};
+
+void
+test_exclude_matcher_file_names(void) {
+    const char *file_names[] = {
+        "node_modules",
+        "node_modules2",
+        "main.o",
+        ".o",
+        "main.c",
+        "notes.txt~",
+        "build",
+        "build-release",
+        "rebuild",
+        ".#lock",
+        "file.swp",
+        "file.swo",
+        "file.sw",
+        "core.1234.dump",
+        "core.dump",
+        "my_cache_dir",
+        "thumbs.db",
+        "Thumbs.db",
+        "humbs.db",
+        "*literal",
+        "xliteral",
+        "",
+    };
+
+    FsearchExcludeMatcher *matcher = fsearch_exclude_matcher_new(NULL, exclude_files);
+    for (gint i = 0; i < G_N_ELEMENTS(file_names); ++i) {
+        const char *name = file_names[i];
+        bool expected = false;
+        for (gint j = 0; exclude_files[j]; ++j) {
+            if (!fnmatch(exclude_files[j], name, 0)) {
+                expected = true;
+                break;
+            }
+        }
+        const bool excluded = fsearch_exclude_matcher_file_is_excluded(matcher, name, strlen(name));
+        if (excluded != expected) {
+            g_print("Expected '%s' to%s be excluded!\n", name, expected ? "" : " not");
+        }
+        g_assert_true(excluded == expected);
+    }
+    g_clear_pointer(&matcher, fsearch_exclude_matcher_free);
+}
+
+void
+test_exclude_matcher_match_all(void) {
+    char *patterns[] = {"*", NULL};
+    FsearchExcludeMatcher *matcher = fsearch_exclude_matcher_new(NULL, patterns);
+    g_assert_true(fsearch_exclude_matcher_file_is_excluded(matcher, "anything", strlen("anything")));
+    g_assert_true(fsearch_exclude_matcher_file_is_excluded(matcher, ".hidden", strlen(".hidden")));
+    g_clear_pointer(&matcher, fsearch_exclude_matcher_free);
+
+    matcher = fsearch_exclude_matcher_new(NULL, NULL);
+    g_assert_false(fsearch_exclude_matcher_file_is_excluded(matcher, "anything", strlen("anything")));
+    g_clear_pointer(&matcher, fsearch_exclude_matcher_free);
+}
+
+void
+test_exclude_matcher_paths(void) {
+    GList *excludes = NULL;
+    excludes = g_list_append(excludes, fsearch_exclude_path_new("/home/user/.cache", true));
+    excludes = g_list_append(excludes, fsearch_exclude_path_new("/tmp", false));
+    excludes = g_list_append(excludes, fsearch_exclude_path_new("/tmp", true));
+
+    FsearchExcludeMatcher *matcher = fsearch_exclude_matcher_new(excludes, NULL);
+    g_assert_true(fsearch_exclude_matcher_path_is_excluded(matcher, "/home/user/.cache"));
+    g_assert_false(fsearch_exclude_matcher_path_is_excluded(matcher, "/home/user/.cache/fsearch"));
+    g_assert_false(fsearch_exclude_matcher_path_is_excluded(matcher, "/home/user"));
+    // the first entry for a path wins
+    g_assert_false(fsearch_exclude_matcher_path_is_excluded(matcher, "/tmp"));
+    g_clear_pointer(&matcher, fsearch_exclude_matcher_free);
+
+    g_list_free_full(g_steal_pointer(&excludes), (GDestroyNotify)fsearch_exclude_path_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/exclude_matcher/file_names", test_exclude_matcher_file_names);
+    g_test_add_func("/FSearch/exclude_matcher/match_all", test_exclude_matcher_match_all);
+    g_test_add_func("/FSearch/exclude_matcher/paths", test_exclude_matcher_paths);
+    return g_test_run();
+}
@@ -0,0 +1,168 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <src/fsearch_federation.h>
+
+static void
+push_paths(FsearchFederationMerger *merger, uint32_t source, const char **paths, bool is_folder) {
+    for (uint32_t i = 0; paths[i]; i++) {
+        FsearchFederationRow row = {.path = g_strdup(paths[i]), .key = 0, .is_folder = is_folder};
+        g_assert_true(fsearch_federation_merger_push(merger, source, &row, 1));
+    }
+}
+
+static void
+assert_popped(FsearchFederationMerger *merger, const char **expected_paths, const uint32_t *expected_sources) {
+    for (uint32_t i = 0; expected_paths[i]; i++) {
+        FsearchFederationRow row = {};
+        uint32_t source = UINT32_MAX;
+        g_assert_true(fsearch_federation_merger_pop(merger, &row, &source));
+        g_assert_cmpstr(row.path, ==, expected_paths[i]);
+        g_assert_cmpuint(source, ==, expected_sources[i]);
+        g_free(row.path);
+    }
+    FsearchFederationRow row = {};
+    g_assert_false(fsearch_federation_merger_pop(merger, &row, NULL));
+}
+
+static void
+test_federation_merge_by_name(void) {
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(3, DATABASE_INDEX_TYPE_NAME);
+    push_paths(merger, 0, (const char *[]){"/a/dir", NULL}, true);
+    push_paths(merger, 0, (const char *[]){"/a/file1", "/a/file10", NULL}, false);
+    push_paths(merger, 1, (const char *[]){"/b/file2", "/b/file3", NULL}, false);
+    push_paths(merger, 2, (const char *[]){"/c/zdir", NULL}, true);
+    for (uint32_t i = 0; i < 3; i++) {
+        fsearch_federation_merger_finish(merger, i);
+    }
+    // folders first, names are compared like versions
+    assert_popped(merger,
+                  (const char *[]){"/a/dir", "/c/zdir", "/a/file1", "/b/file2", "/b/file3", "/a/file10", NULL},
+                  (const uint32_t[]){0, 2, 0, 1, 1, 0});
+    fsearch_federation_merger_free(merger);
+}
+
+static void
+test_federation_merge_by_path(void) {
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(2, DATABASE_INDEX_TYPE_PATH);
+    push_paths(merger, 0, (const char *[]){"/x/b", "/x/a/deep", NULL}, false);
+    push_paths(merger, 1, (const char *[]){"/x/a", "/x/c", "/y/a/deep", NULL}, false);
+    fsearch_federation_merger_finish(merger, 0);
+    fsearch_federation_merger_finish(merger, 1);
+    assert_popped(merger,
+                  (const char *[]){"/x/a", "/x/b", "/x/c", "/x/a/deep", "/y/a/deep", NULL},
+                  (const uint32_t[]){1, 0, 1, 0, 1});
+    fsearch_federation_merger_free(merger);
+}
+
+static void
+test_federation_merge_by_key(void) {
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(2, DATABASE_INDEX_TYPE_SIZE);
+    FsearchFederationRow rows_0[] = {{g_strdup("/small"), 1, false}, {g_strdup("/large"), 100, false}};
+    FsearchFederationRow rows_1[] = {{g_strdup("/medium"), 50, false}};
+    g_assert_true(fsearch_federation_merger_push(merger, 0, rows_0, G_N_ELEMENTS(rows_0)));
+    g_assert_true(fsearch_federation_merger_push(merger, 1, rows_1, G_N_ELEMENTS(rows_1)));
+    fsearch_federation_merger_finish(merger, 0);
+    fsearch_federation_merger_finish(merger, 1);
+    assert_popped(merger, (const char *[]){"/small", "/medium", "/large", NULL}, (const uint32_t[]){0, 1, 0});
+    fsearch_federation_merger_free(merger);
+}
+
+static void
+test_federation_merge_unordered(void) {
+    // relevance can't be compared across sources, so every source keeps its order
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(2, DATABASE_INDEX_TYPE_RELEVANCE);
+    push_paths(merger, 1, (const char *[]){"/b", "/a", NULL}, false);
+    push_paths(merger, 0, (const char *[]){"/d", "/c", NULL}, false);
+    fsearch_federation_merger_finish(merger, 0);
+    fsearch_federation_merger_finish(merger, 1);
+    assert_popped(merger, (const char *[]){"/d", "/c", "/b", "/a", NULL}, (const uint32_t[]){0, 0, 1, 1});
+    fsearch_federation_merger_free(merger);
+}
+
+typedef struct {
+    FsearchFederationMerger *merger;
+    uint32_t source;
+    uint32_t num_rows;
+} PushThreadContext;
+
+static gpointer
+push_thread(gpointer data) {
+    PushThreadContext *ctx = data;
+    for (uint32_t i = 0; i < ctx->num_rows; i++) {
+        FsearchFederationRow row = {.path = g_strdup_printf("/%u", ctx->source), .key = i};
+        if (!fsearch_federation_merger_push(ctx->merger, ctx->source, &row, 1)) {
+            break;
+        }
+    }
+    fsearch_federation_merger_finish(ctx->merger, ctx->source);
+    return NULL;
+}
+
+static void
+test_federation_merge_threads(void) {
+    // more rows than a source may have waiting, so the sources have to wait for each other
+    const uint32_t num_rows = 200000;
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(2, DATABASE_INDEX_TYPE_SIZE);
+    PushThreadContext ctx[2] = {{merger, 0, num_rows}, {merger, 1, num_rows / 2}};
+    GThread *threads[2] = {g_thread_new("push_0", push_thread, &ctx[0]), g_thread_new("push_1", push_thread, &ctx[1])};
+
+    uint64_t last_key = 0;
+    uint32_t num_popped = 0;
+    FsearchFederationRow row = {};
+    while (fsearch_federation_merger_pop(merger, &row, NULL)) {
+        g_assert_cmpuint(row.key, >=, last_key);
+        last_key = row.key;
+        num_popped++;
+        g_free(row.path);
+    }
+    g_assert_cmpuint(num_popped, ==, num_rows + num_rows / 2);
+    g_thread_join(threads[0]);
+    g_thread_join(threads[1]);
+    fsearch_federation_merger_free(merger);
+}
+
+static void
+test_federation_cancel(void) {
+    FsearchFederationMerger *merger = fsearch_federation_merger_new(2, DATABASE_INDEX_TYPE_NAME);
+    PushThreadContext ctx = {merger, 0, 1000000};
+    GThread *thread = g_thread_new("push", push_thread, &ctx);
+    // source 1 never pushes anything, so source 0 has to wait until the merger gets cancelled
+    fsearch_federation_merger_cancel(merger);
+    g_thread_join(thread);
+
+    FsearchFederationRow row = {};
+    g_assert_false(fsearch_federation_merger_pop(merger, &row, NULL));
+    FsearchFederationRow late_row = {.path = g_strdup("/late")};
+    g_assert_false(fsearch_federation_merger_push(merger, 1, &late_row, 1));
+    g_assert_null(late_row.path);
+    fsearch_federation_merger_free(merger);
+}
+
+static void
+test_federation_sources(void) {
+    FsearchFederationSource *file = fsearch_federation_source_new("backup", "/srv/backup/fsearch.db");
+    FsearchFederationSource *remote = fsearch_federation_source_new("server", "unix:path=/tmp/fsearch-remote");
+    FsearchFederationSource *copy = fsearch_federation_source_copy(remote);
+    g_assert_false(fsearch_federation_source_is_remote(file));
+    g_assert_true(fsearch_federation_source_is_remote(remote));
+    g_assert_true(fsearch_federation_source_equal(remote, copy));
+    g_assert_false(fsearch_federation_source_equal(remote, file));
+    fsearch_federation_source_free(file);
+    fsearch_federation_source_free(remote);
+    fsearch_federation_source_free(copy);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/federation/merge_by_name", test_federation_merge_by_name);
+    g_test_add_func("/FSearch/federation/merge_by_path", test_federation_merge_by_path);
+    g_test_add_func("/FSearch/federation/merge_by_key", test_federation_merge_by_key);
+    g_test_add_func("/FSearch/federation/merge_unordered", test_federation_merge_unordered);
+    g_test_add_func("/FSearch/federation/merge_threads", test_federation_merge_threads);
+    g_test_add_func("/FSearch/federation/cancel", test_federation_cancel);
+    g_test_add_func("/FSearch/federation/sources", test_federation_sources);
+    return g_test_run();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+// Helpers for the tests which work on real files
+
+// Removes path and, if it's a folder, everything in it
+static inline void
+test_files_remove_recursive(const char *path) {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        const char *name = NULL;
+        while (dir && (name = g_dir_read_name(dir))) {
+            g_autofree char *child = g_build_filename(path, name, NULL);
+            test_files_remove_recursive(child);
+        }
+        g_clear_pointer(&dir, g_dir_close);
+        g_rmdir(path);
+        return;
+    }
+    g_unlink(path);
+}
@@ -0,0 +1,188 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_folded_names.h>
+#include <src/fsearch_limits.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_utf.h>
+
+static const char *names[] = {"file.txt", "Übung", "", "ÆØÅ", "README", "straße", "ǅ", "İstanbul"};
+
+static DynamicArray *
+new_entries(FsearchMemoryPool *pool, FsearchDatabaseEntryType type) {
+    DynamicArray *entries = darray_new(G_N_ELEMENTS(names));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+        db_entry_set_type(entry, type);
+        db_entry_set_name(entry, names[i]);
+        db_entry_set_idx(entry, i);
+        darray_add_item(entries, entry);
+    }
+    return entries;
+}
+
+static void
+check_names(FsearchFoldedNames *folded_names, DynamicArray *entries, FsearchUtfBuilder *builder) {
+    for (uint32_t i = 0; i < darray_get_num_items(entries); i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        int32_t len = 0;
+        const UChar *folded = fsearch_folded_names_lookup(folded_names, entry, &len);
+        if (db_entry_name_is_ascii(entry)) {
+            g_assert_null(folded);
+            continue;
+        }
+        g_assert_nonnull(folded);
+        g_assert_true(fsearch_utf_builder_normalize_and_fold_case(builder, db_entry_get_name_raw_for_display(entry)));
+        g_assert_cmpint(len, ==, builder->string_normalized_folded_len);
+        g_assert_cmpmem(folded, len * sizeof(UChar), builder->string_normalized_folded, len * sizeof(UChar));
+    }
+}
+
+static void
+test_folded_names(void) {
+    FsearchMemoryPool *folder_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    FsearchMemoryPool *file_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *folders = new_entries(folder_pool, DATABASE_ENTRY_TYPE_FOLDER);
+    DynamicArray *files = new_entries(file_pool, DATABASE_ENTRY_TYPE_FILE);
+
+    FsearchUtfBuilder builder = {};
+    fsearch_utf_builder_init(&builder, 4 * PATH_MAX);
+
+    FsearchFoldedNames *folded_names = fsearch_folded_names_new(folders, files);
+    check_names(folded_names, folders, &builder);
+    check_names(folded_names, files, &builder);
+
+    // entries which the names weren't built for aren't found
+    int32_t len = 0;
+    FsearchDatabaseEntry *added = fsearch_memory_pool_malloc(file_pool);
+    db_entry_set_type(added, DATABASE_ENTRY_TYPE_FILE);
+    db_entry_set_name(added, "Ärger");
+    db_entry_set_idx(added, 1);
+    g_assert_null(fsearch_folded_names_lookup(folded_names, added, &len));
+    g_assert_null(fsearch_folded_names_lookup(NULL, darray_get_item(files, 1), &len));
+
+    g_clear_pointer(&folded_names, fsearch_folded_names_unref);
+
+    // only files
+    folded_names = fsearch_folded_names_new(NULL, files);
+    g_assert_null(fsearch_folded_names_lookup(folded_names, darray_get_item(folders, 1), &len));
+    check_names(folded_names, files, &builder);
+    g_clear_pointer(&folded_names, fsearch_folded_names_unref);
+
+    fsearch_utf_builder_clear(&builder);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&folder_pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_fold_case_ascii(void) {
+    // the ASCII path has to produce exactly what ICU produces
+    const char *strings[] = {"", "abc", "ABC", "Hello World.TXT", "0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"};
+    FsearchUtfBuilder icu_builder = {};
+    fsearch_utf_builder_init(&icu_builder, 4 * PATH_MAX);
+    FsearchUtfBuilder ascii_builder = {};
+    fsearch_utf_builder_init(&ascii_builder, 4 * PATH_MAX);
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(strings); i++) {
+        const char *s = strings[i];
+        g_assert_true(fsearch_utf_builder_fold_case_ascii(&ascii_builder, s, strlen(s)));
+
+        // ucasemap_utf8FoldCase is called on ASCII input as well, with a non-ASCII suffix which is cut off again
+        g_autofree char *suffixed = g_strconcat(s, "é", NULL);
+        g_assert_true(fsearch_utf_builder_normalize_and_fold_case(&icu_builder, suffixed));
+        g_assert_cmpint(icu_builder.string_normalized_folded_len, >=, ascii_builder.string_normalized_folded_len);
+        g_assert_cmpmem(ascii_builder.string_normalized_folded,
+                        ascii_builder.string_normalized_folded_len * sizeof(UChar),
+                        icu_builder.string_normalized_folded,
+                        ascii_builder.string_normalized_folded_len * sizeof(UChar));
+        g_assert_cmpint(ascii_builder.string_utf8_folded_len, ==, strlen(s));
+    }
+
+    fsearch_utf_builder_clear(&ascii_builder);
+    fsearch_utf_builder_clear(&icu_builder);
+}
+
+// Folds s with the table and with ICU and checks that both agree
+static void
+check_fold_case_table(FsearchUtfBuilder *table_builder, FsearchUtfBuilder *icu_builder, const char *s) {
+    // a character the table doesn't cover makes sure ICU is used, it's cut off again
+    g_autofree char *suffixed = g_strconcat(s, "中", NULL);
+    g_assert_true(fsearch_utf_builder_normalize_and_fold_case(icu_builder, suffixed));
+    g_assert_false(icu_builder->string_utf8_is_folded_and_normalized);
+
+    // U+4E2D takes up one code unit and three bytes
+    const int32_t len = table_builder->string_normalized_folded_len;
+    g_assert_cmpint(icu_builder->string_normalized_folded_len, ==, len + 1);
+    g_assert_cmpmem(table_builder->string_normalized_folded,
+                    len * sizeof(UChar),
+                    icu_builder->string_normalized_folded,
+                    len * sizeof(UChar));
+    g_assert_cmpint(icu_builder->string_utf8_folded_len, ==, table_builder->string_utf8_folded_len + 3);
+    g_assert_cmpmem(table_builder->string_utf8_folded,
+                    table_builder->string_utf8_folded_len,
+                    icu_builder->string_utf8_folded,
+                    table_builder->string_utf8_folded_len);
+
+    g_autofree char *normalized = g_utf16_to_utf8(table_builder->string_normalized_folded, len, NULL, NULL, NULL);
+    g_assert_nonnull(normalized);
+    g_assert_cmpstr(table_builder->string_utf8_normalized_folded, ==, normalized);
+}
+
+static void
+test_fold_case_table(void) {
+    FsearchUtfBuilder icu_builder = {};
+    fsearch_utf_builder_init(&icu_builder, 4 * PATH_MAX);
+    FsearchUtfBuilder table_builder = {};
+    fsearch_utf_builder_init(&table_builder, 4 * PATH_MAX);
+
+    const char *strings[] = {"Ärger über Öl.txt", "ΣΊΣΥΦΟΣ ΐ", "Привет, Ёжик", "ŁÓDŹ", "ŉ ǰ ß", "MAẞ"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(strings); i++) {
+        const char *s = strings[i];
+        if (!fsearch_utf_builder_fold_case_table(&table_builder, s, strlen(s))) {
+            // U+1E9E is no table character
+            g_assert_cmpstr(s, ==, "MAẞ");
+            continue;
+        }
+        check_fold_case_table(&table_builder, &icu_builder, s);
+    }
+
+    // every character of the table on its own and between others
+    uint32_t num_covered = 0;
+    for (gunichar c = 0x80; c < 0x500; c++) {
+        char s[32] = "";
+        char *end = s + g_unichar_to_utf8(c, s);
+        strcpy(end, "Aé");
+        if (!fsearch_utf_builder_fold_case_table(&table_builder, s, strlen(s))) {
+            continue;
+        }
+        num_covered++;
+        check_fold_case_table(&table_builder, &icu_builder, s);
+    }
+    // the combining marks are missing
+    g_assert_cmpuint(num_covered, >, 1000);
+
+    // those need ICU
+    const char *icu_strings[] = {"e\xcc\x81", "İstanbul", "中文", "\xc3", "\xc3(", "\xc0\x80"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(icu_strings); i++) {
+        const char *s = icu_strings[i];
+        g_assert_false(fsearch_utf_builder_fold_case_table(&table_builder, s, strlen(s)));
+    }
+
+    fsearch_utf_builder_clear(&table_builder);
+    fsearch_utf_builder_clear(&icu_builder);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/folded_names/names", test_folded_names);
+    g_test_add_func("/FSearch/folded_names/fold_case_ascii", test_fold_case_ascii);
+    g_test_add_func("/FSearch/folded_names/fold_case_table", test_fold_case_table);
+    return g_test_run();
+}
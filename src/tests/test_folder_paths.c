@@ -0,0 +1,94 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_folder_paths.h>
+#include <src/fsearch_memory_pool.h>
+
+#include "test_tree.h"
+
+// parents don't have to come first
+static const TestFolder folders[] = {
+    {-1, ""},
+    {0, "home"},
+    {5, "out"},
+    {1, "user"},
+    {-1, "/mnt/data"},
+    {3, "build"},
+    {4, "a"},
+    {0, "b"},
+};
+
+static const char *file_names[] = {"file.txt", "", "b"};
+
+static void
+check_paths(FsearchFolderPaths *paths, FsearchDatabaseEntry *entry) {
+    g_autoptr(GString) expected_path = g_string_new(NULL);
+    g_autoptr(GString) path = g_string_new(NULL);
+    db_entry_append_path(entry, expected_path);
+    fsearch_folder_paths_append_path(paths, entry, path);
+    g_assert_cmpstr(path->str, ==, expected_path->str);
+
+    g_string_truncate(expected_path, 0);
+    g_string_truncate(path, 0);
+    db_entry_append_full_path(entry, expected_path);
+    fsearch_folder_paths_append_full_path(paths, entry, path);
+    g_assert_cmpstr(path->str, ==, expected_path->str);
+}
+
+static void
+test_folder_paths(void) {
+    FsearchMemoryPool *folder_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    FsearchMemoryPool *file_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = darray_new(G_N_ELEMENTS(folders));
+    test_tree_add_folders(entries, folder_pool, folders, G_N_ELEMENTS(folders), 0);
+    FsearchFolderPaths *paths = fsearch_folder_paths_new(entries);
+
+    size_t len = 0;
+    const char *path = fsearch_folder_paths_lookup(paths, darray_get_item(entries, 2), &len);
+    g_assert_cmpstr(path, ==, "/home/user/build/out");
+    g_assert_cmpuint(len, ==, strlen(path));
+    g_assert_cmpstr(fsearch_folder_paths_lookup(paths, darray_get_item(entries, 0), &len), ==, "/");
+    g_assert_cmpstr(fsearch_folder_paths_lookup(paths, darray_get_item(entries, 6), &len), ==, "/mnt/data/a");
+
+    for (uint32_t i = 0; i < darray_get_num_items(entries); i++) {
+        FsearchDatabaseEntry *folder = darray_get_item(entries, i);
+        check_paths(paths, folder);
+        for (uint32_t j = 0; j < G_N_ELEMENTS(file_names); j++) {
+            FsearchDatabaseEntry *file = fsearch_memory_pool_malloc(file_pool);
+            db_entry_set_type(file, DATABASE_ENTRY_TYPE_FILE);
+            db_entry_set_name(file, file_names[j]);
+            db_entry_set_parent(file, (FsearchDatabaseEntryFolder *)folder);
+            check_paths(paths, file);
+        }
+    }
+
+    // folders which the paths weren't built for are still resolved, just without the paths
+    FsearchDatabaseEntry *added = fsearch_memory_pool_malloc(folder_pool);
+    db_entry_set_type(added, DATABASE_ENTRY_TYPE_FOLDER);
+    db_entry_set_name(added, "added");
+    db_entry_set_idx(added, 1);
+    db_entry_set_parent(added, darray_get_item(entries, 2));
+    g_assert_null(fsearch_folder_paths_lookup(paths, (FsearchDatabaseEntryFolder *)added, &len));
+    FsearchDatabaseEntry *file = fsearch_memory_pool_malloc(file_pool);
+    db_entry_set_type(file, DATABASE_ENTRY_TYPE_FILE);
+    db_entry_set_name(file, "file");
+    db_entry_set_parent(file, (FsearchDatabaseEntryFolder *)added);
+    check_paths(paths, file);
+    check_paths(NULL, file);
+
+    g_clear_pointer(&paths, fsearch_folder_paths_unref);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&folder_pool, fsearch_memory_pool_free_pool);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/folder_paths/paths", test_folder_paths);
+    return g_test_run();
+}
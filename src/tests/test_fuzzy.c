@@ -0,0 +1,82 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_fuzzy.h>
+
+static bool
+fuzzy_match(const char *haystack, const char *needle, bool ignore_ascii_case, uint32_t *score, uint32_t *positions) {
+    return fsearch_fuzzy_match(haystack, strlen(haystack), needle, strlen(needle), ignore_ascii_case, score, positions);
+}
+
+static uint32_t
+fuzzy_score(const char *haystack, const char *needle) {
+    uint32_t score = 0;
+    g_assert_true(fuzzy_match(haystack, needle, true, &score, NULL));
+    g_assert_cmpuint(score, >, 0);
+    return score;
+}
+
+static void
+test_fuzzy_match(void) {
+    uint32_t score = 0;
+    g_assert_true(fuzzy_match("fsearch_database.c", "fsdbc", true, &score, NULL));
+    g_assert_true(fuzzy_match("fsearch_database.c", "FSDBC", true, &score, NULL));
+    g_assert_false(fuzzy_match("fsearch_database.c", "FSDBC", false, &score, NULL));
+    g_assert_true(fuzzy_match("fsearch_database.c", "fsearch_database.c", false, &score, NULL));
+    g_assert_false(fuzzy_match("fsearch_database.c", "fsdbcc", true, &score, NULL));
+    // the order matters
+    g_assert_false(fuzzy_match("fsearch_database.c", "cbdsf", true, &score, NULL));
+    g_assert_false(fuzzy_match("abc", "abcd", true, &score, NULL));
+    g_assert_false(fuzzy_match("", "a", true, &score, NULL));
+    g_assert_true(fuzzy_match("abc", "", true, &score, NULL));
+
+    // non-letters and multi byte characters are compared as they are
+    g_assert_true(fuzzy_match("Übung 2.txt", "Üb2.", true, &score, NULL));
+    g_assert_false(fuzzy_match("Übung 2.txt", "üb2.", true, &score, NULL));
+    g_assert_true(fuzzy_match("straße", "sße", false, &score, NULL));
+    g_assert_false(fuzzy_match("strase", "sße", false, &score, NULL));
+
+    // the haystack doesn't need to be NUL terminated
+    g_assert_false(fsearch_fuzzy_match("abcdef", 3, "ad", 2, true, &score, NULL));
+}
+
+static void
+test_fuzzy_positions(void) {
+    uint32_t score = 0;
+    uint32_t positions[8] = {};
+    g_assert_true(fuzzy_match("fsearch_database.c", "fsdbc", true, &score, positions));
+    const uint32_t expected[] = {0, 1, 8, 12, 17};
+    g_assert_cmpmem(positions, sizeof(expected), expected, sizeof(expected));
+
+    // the shortest window is picked
+    g_assert_true(fuzzy_match("a_xxxxxxx_abc", "abc", true, &score, positions));
+    const uint32_t expected_window[] = {10, 11, 12};
+    g_assert_cmpmem(positions, sizeof(expected_window), expected_window, sizeof(expected_window));
+
+    // offsets are in bytes
+    g_assert_true(fuzzy_match("äöü", "ü", false, &score, positions));
+    g_assert_cmpuint(positions[0], ==, 4);
+}
+
+static void
+test_fuzzy_score(void) {
+    // consecutive matches are better than scattered ones
+    g_assert_cmpuint(fuzzy_score("database", "data"), >, fuzzy_score("d_a_t_a_base", "data"));
+    // so are matches at the start of words
+    g_assert_cmpuint(fuzzy_score("fsearch_database.c", "fdc"), >, fuzzy_score("fsearchxdatabasexc", "fdc"));
+    g_assert_cmpuint(fuzzy_score("FsearchDatabase", "fd"), >, fuzzy_score("Fsearchdatabase", "fd"));
+    // and short haystacks
+    g_assert_cmpuint(fuzzy_score("main.c", "main"), >, fuzzy_score("main_window_with_a_long_name.c", "main"));
+    // the score never drops to 0 for a match
+    g_assert_cmpuint(fuzzy_score("a_______________________________________________________________b", "ab"), ==, 1);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/fuzzy/match", test_fuzzy_match);
+    g_test_add_func("/FSearch/fuzzy/positions", test_fuzzy_positions);
+    g_test_add_func("/FSearch/fuzzy/score", test_fuzzy_score);
+    return g_test_run();
+}
@@ -0,0 +1,52 @@
+#include <glib.h>
+#include <stdbool.h>
+
+#include <src/fsearch_id_dictionary.h>
+
+static void
+test_id_dictionary_ids(void) {
+    FsearchIdDictionary *dict = fsearch_id_dictionary_new();
+    g_assert_cmpuint(fsearch_id_dictionary_get_num_ids(dict), ==, 0);
+
+    const uint32_t values[] = {1000, 0, UINT32_MAX, 1000, 33, 0};
+    const uint16_t expected_ids[] = {0, 1, 2, 0, 3, 1};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(values); i++) {
+        g_assert_cmpuint(fsearch_id_dictionary_get_id(dict, values[i]), ==, expected_ids[i]);
+    }
+    g_assert_cmpuint(fsearch_id_dictionary_get_num_ids(dict), ==, 4);
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(values); i++) {
+        uint32_t value = 0;
+        g_assert_true(fsearch_id_dictionary_get_value(dict, expected_ids[i], &value));
+        g_assert_cmpuint(value, ==, values[i]);
+    }
+    uint32_t value = 0;
+    g_assert_false(fsearch_id_dictionary_get_value(dict, 4, &value));
+    g_assert_false(fsearch_id_dictionary_get_value(dict, FSEARCH_ID_DICTIONARY_NO_ID, &value));
+
+    g_clear_pointer(&dict, fsearch_id_dictionary_free);
+}
+
+static void
+test_id_dictionary_overflow(void) {
+    FsearchIdDictionary *dict = fsearch_id_dictionary_new();
+    for (uint32_t i = 0; i < FSEARCH_ID_DICTIONARY_OVERFLOW_ID; i++) {
+        g_assert_cmpuint(fsearch_id_dictionary_get_id(dict, i * 2), ==, i);
+    }
+    g_assert_cmpuint(fsearch_id_dictionary_get_id(dict, 1), ==, FSEARCH_ID_DICTIONARY_OVERFLOW_ID);
+    g_assert_cmpuint(fsearch_id_dictionary_get_id(dict, 3), ==, FSEARCH_ID_DICTIONARY_OVERFLOW_ID);
+    // values which were added before still have their own id
+    g_assert_cmpuint(fsearch_id_dictionary_get_id(dict, 10), ==, 5);
+
+    uint32_t value = 0;
+    g_assert_false(fsearch_id_dictionary_get_value(dict, FSEARCH_ID_DICTIONARY_OVERFLOW_ID, &value));
+    g_clear_pointer(&dict, fsearch_id_dictionary_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/id_dictionary/ids", test_id_dictionary_ids);
+    g_test_add_func("/FSearch/id_dictionary/overflow", test_id_dictionary_overflow);
+    return g_test_run();
+}
@@ -0,0 +1,122 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_memory_pool.h>
+
+typedef struct {
+    uint64_t value;
+    uint64_t padding[3];
+} TestItem;
+
+static uint32_t num_items_freed = 0;
+
+static void
+test_item_free(TestItem *item) {
+    num_items_freed++;
+}
+
+static void
+test_memory_pool_free_list(void) {
+    FsearchMemoryPool *pool = fsearch_memory_pool_new(4, sizeof(TestItem), (GDestroyNotify)test_item_free);
+
+    TestItem *items[10] = {};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(items); i++) {
+        items[i] = fsearch_memory_pool_malloc(pool);
+        g_assert_nonnull(items[i]);
+        g_assert_cmpuint(items[i]->value, ==, 0);
+        items[i]->value = i + 1;
+    }
+
+    // freed items are handed out again, zeroed like new ones
+    fsearch_memory_pool_free(pool, items[3], false);
+    fsearch_memory_pool_free(pool, items[7], false);
+    TestItem *reused = fsearch_memory_pool_malloc(pool);
+    g_assert_true(reused == items[7]);
+    g_assert_cmpuint(reused->value, ==, 0);
+    reused->value = 8;
+    g_assert_true(fsearch_memory_pool_malloc(pool) == items[3]);
+    fsearch_memory_pool_free(pool, items[3], true);
+    g_assert_cmpuint(num_items_freed, ==, 1);
+
+    // items on the free list don't get freed again with the pool
+    num_items_freed = 0;
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+    g_assert_cmpuint(num_items_freed, ==, G_N_ELEMENTS(items) - 1);
+}
+
+static void
+test_memory_pool_reserve(void) {
+    FsearchMemoryPool *pool = fsearch_memory_pool_new(4, sizeof(TestItem), NULL);
+
+    // reserved items come from a single block
+    const uint32_t num_items = 1000;
+    fsearch_memory_pool_reserve(pool, num_items);
+    TestItem *first = fsearch_memory_pool_malloc(pool);
+    for (uint32_t i = 1; i < num_items; i++) {
+        g_assert_true(fsearch_memory_pool_malloc(pool) == first + i);
+    }
+
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_memory_pool_reset(void) {
+    num_items_freed = 0;
+    FsearchMemoryPool *pool = fsearch_memory_pool_new(4, sizeof(TestItem), (GDestroyNotify)test_item_free);
+    for (uint32_t i = 0; i < 100; i++) {
+        TestItem *item = fsearch_memory_pool_malloc(pool);
+        item->value = i + 1;
+    }
+    fsearch_memory_pool_reset(pool);
+    g_assert_cmpuint(num_items_freed, ==, 0);
+
+    // the pool can still be used
+    TestItem *item = fsearch_memory_pool_malloc(pool);
+    g_assert_nonnull(item);
+    g_assert_cmpuint(item->value, ==, 0);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+    g_assert_cmpuint(num_items_freed, ==, 1);
+}
+
+static void
+test_memory_pool_huge_pages(void) {
+    // blocks which are large enough get mapped, if that fails they're allocated like all others
+    FsearchMemoryPool *pool = fsearch_memory_pool_new(4, sizeof(TestItem), NULL);
+    fsearch_memory_pool_set_huge_pages(pool, true);
+    const uint32_t num_items = 200000;
+    for (uint32_t i = 0; i < num_items; i++) {
+        TestItem *item = fsearch_memory_pool_malloc(pool);
+        g_assert_cmpuint(item->value, ==, 0);
+        item->value = i;
+    }
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_memory_pool_memory_usage(void) {
+    FsearchMemoryPool *pool = fsearch_memory_pool_new(4, sizeof(TestItem), NULL);
+    const size_t empty_size = fsearch_memory_pool_get_memory_usage(pool);
+
+    // unused items of a block count as well
+    const uint32_t num_items = 1000;
+    fsearch_memory_pool_reserve(pool, num_items);
+    const size_t reserved_size = fsearch_memory_pool_get_memory_usage(pool);
+    g_assert_cmpuint(reserved_size, >=, empty_size + num_items * sizeof(TestItem));
+    fsearch_memory_pool_malloc(pool);
+    g_assert_cmpuint(fsearch_memory_pool_get_memory_usage(pool), ==, reserved_size);
+
+    fsearch_memory_pool_reset(pool);
+    g_assert_cmpuint(fsearch_memory_pool_get_memory_usage(pool), ==, empty_size);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/memory_pool/free_list", test_memory_pool_free_list);
+    g_test_add_func("/FSearch/memory_pool/reserve", test_memory_pool_reserve);
+    g_test_add_func("/FSearch/memory_pool/reset", test_memory_pool_reset);
+    g_test_add_func("/FSearch/memory_pool/huge_pages", test_memory_pool_huge_pages);
+    g_test_add_func("/FSearch/memory_pool/memory_usage", test_memory_pool_memory_usage);
+    return g_test_run();
+}
@@ -0,0 +1,102 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_name_blocks.h>
+
+#define NUM_NAMES 5000
+
+static int
+compare_names(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static char **
+get_sorted_names(void) {
+    char **names = calloc(NUM_NAMES + 1, sizeof(char *));
+    GRand *rand = g_rand_new_with_seed(42);
+    for (uint32_t i = 0; i < NUM_NAMES; i++) {
+        // long shared prefixes, like the names of photos or libraries
+        names[i] = g_strdup_printf("IMG_2023%04d_%d.jpg", g_rand_int_range(rand, 0, 10000), i);
+    }
+    // a few names which don't share anything with their neighbours
+    g_free(names[7]);
+    names[7] = g_strdup("");
+    g_free(names[100]);
+    names[100] = g_strdup("äöü.txt");
+    qsort(names, NUM_NAMES, sizeof(char *), compare_names);
+    g_rand_free(rand);
+    return names;
+}
+
+static void
+test_name_blocks_decode(void) {
+    g_auto(GStrv) names = get_sorted_names();
+    FsearchNameBlocks *blocks = fsearch_name_blocks_new();
+    g_autofree const char **handles = calloc(NUM_NAMES, sizeof(char *));
+    for (uint32_t i = 0; i < NUM_NAMES; i++) {
+        handles[i] = fsearch_name_blocks_add(blocks, names[i]);
+        g_assert_nonnull(handles[i]);
+    }
+    g_assert_cmpuint(fsearch_name_blocks_get_memory_usage(blocks), >, 0);
+
+    // in order, which decodes every name from the previous one
+    for (uint32_t i = 0; i < NUM_NAMES; i++) {
+        g_assert_cmpstr(fsearch_name_blocks_decode(handles[i]), ==, names[i]);
+    }
+    // backwards and in random order, which decodes from the start of the blocks
+    for (int32_t i = NUM_NAMES - 1; i >= 0; i--) {
+        g_assert_cmpstr(fsearch_name_blocks_decode(handles[i]), ==, names[i]);
+    }
+    GRand *rand = g_rand_new_with_seed(7);
+    for (uint32_t i = 0; i < NUM_NAMES; i++) {
+        const uint32_t idx = g_rand_int_range(rand, 0, NUM_NAMES);
+        g_assert_cmpstr(fsearch_name_blocks_decode(handles[idx]), ==, names[idx]);
+    }
+    g_rand_free(rand);
+
+    // the last few decoded names stay valid
+    const char *decoded[NAME_BLOCKS_NUM_DECODED] = {};
+    for (uint32_t i = 0; i < NAME_BLOCKS_NUM_DECODED; i++) {
+        decoded[i] = fsearch_name_blocks_decode(handles[i * 50]);
+    }
+    for (uint32_t i = 0; i < NAME_BLOCKS_NUM_DECODED; i++) {
+        g_assert_cmpstr(decoded[i], ==, names[i * 50]);
+    }
+
+    g_clear_pointer(&blocks, fsearch_name_blocks_unref);
+}
+
+static void
+test_name_blocks_memory_usage(void) {
+    FsearchNameBlocks *blocks = fsearch_name_blocks_new();
+    const size_t empty_size = fsearch_name_blocks_get_memory_usage(blocks);
+
+    // names which only differ in their last few bytes take up much less than their full length
+    const uint32_t num_names = 20000;
+    size_t names_size = 0;
+    for (uint32_t i = 0; i < num_names; i++) {
+        g_autofree char *name = g_strdup_printf("libexample-component.so.1.2.%06d", i);
+        g_assert_nonnull(fsearch_name_blocks_add(blocks, name));
+        names_size += strlen(name) + 1;
+    }
+    g_assert_cmpuint(fsearch_name_blocks_get_memory_usage(blocks) - empty_size, <, names_size / 2);
+
+    // too long names can't be front coded
+    g_autofree char *long_name = g_strnfill(NAME_BLOCKS_MAX_NAME_LEN + 1, 'a');
+    g_assert_null(fsearch_name_blocks_add(blocks, long_name));
+    long_name[NAME_BLOCKS_MAX_NAME_LEN] = '\0';
+    const char *handle = fsearch_name_blocks_add(blocks, long_name);
+    g_assert_nonnull(handle);
+    g_assert_cmpstr(fsearch_name_blocks_decode(handle), ==, long_name);
+
+    g_clear_pointer(&blocks, fsearch_name_blocks_unref);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/name_blocks/decode", test_name_blocks_decode);
+    g_test_add_func("/FSearch/name_blocks/memory_usage", test_name_blocks_memory_usage);
+    return g_test_run();
+}
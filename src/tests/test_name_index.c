@@ -0,0 +1,123 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_name_index.h>
+
+#include "test_entries.h"
+
+static const char *names[] = {
+    "CMakeLists.txt", "main.c",     ".gitignore", "cmakelists.txt", "README.md", "main.c", "Main.C",
+    "main.cpp",       ".gitignore", "a",          "",               "Ärger.pdf", "ärger.pdf",
+};
+
+static bool
+equals_ascii_icase(const char *name, const char *query) {
+    return !g_ascii_strcasecmp(name, query);
+}
+
+// Every entry named name (ignoring the case of ASCII letters) must be a candidate
+static void
+check_lookup(FsearchNameIndex *index, DynamicArray *entries, const char *name) {
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    fsearch_name_index_lookup(index, name, strlen(name), &positions, &num_positions);
+    test_entries_check_candidates(entries, positions, num_positions, equals_ascii_icase, name);
+    g_clear_pointer(&positions, free);
+}
+
+static uint32_t
+count_candidates(FsearchNameIndex *index, const char *name) {
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    fsearch_name_index_lookup(index, name, strlen(name), &positions, &num_positions);
+    g_assert_true((positions == NULL) == (num_positions == 0));
+    g_clear_pointer(&positions, free);
+    return num_positions;
+}
+
+static void
+test_name_index_lookup(void) {
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = test_entries_new(pool, names, G_N_ELEMENTS(names));
+    FsearchNameIndex *index = fsearch_name_index_new(entries, NULL);
+    g_assert_true(fsearch_name_index_get_entries(index) == entries);
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); i++) {
+        check_lookup(index, entries, names[i]);
+    }
+    g_assert_cmpuint(count_candidates(index, "CMAKELISTS.TXT"), ==, 2);
+    g_assert_cmpuint(count_candidates(index, "main.c"), ==, 3);
+    g_assert_cmpuint(count_candidates(index, ".gitignore"), ==, 2);
+    g_assert_cmpuint(count_candidates(index, ""), ==, 1);
+    // only ASCII letters are folded
+    g_assert_cmpuint(count_candidates(index, "ärger.pdf"), ==, 1);
+    // names are matched as a whole
+    g_assert_cmpuint(count_candidates(index, "main"), ==, 0);
+    g_assert_cmpuint(count_candidates(index, "not_there"), ==, 0);
+    g_assert_cmpuint(fsearch_name_index_get_memory_usage(index), >, 0);
+
+    g_clear_pointer(&index, fsearch_name_index_unref);
+
+    // the table grows beyond its initial size
+    DynamicArray *many = darray_new(1000);
+    for (uint32_t i = 0; i < 1000; i++) {
+        g_autofree char *name = g_strdup_printf("file_%u.txt", i % 300);
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+        db_entry_set_name(entry, name);
+        db_entry_set_idx(entry, i);
+        darray_add_item(many, entry);
+    }
+    index = fsearch_name_index_new(many, NULL);
+    g_assert_cmpuint(count_candidates(index, "FILE_7.txt"), ==, 4);
+    g_assert_cmpuint(count_candidates(index, "file_299.txt"), ==, 3);
+    check_lookup(index, many, "file_42.txt");
+    g_clear_pointer(&index, fsearch_name_index_unref);
+
+    g_clear_pointer(&many, darray_unref);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_name_index_updated(void) {
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = test_entries_new(pool, names, G_N_ELEMENTS(names));
+    FsearchNameIndex *index = fsearch_name_index_new(entries, NULL);
+
+    // remove every third entry and add new ones in between
+    const char *added_names[] = {"main.c", "Makefile", ".GITIGNORE"};
+    DynamicArray *added = test_entries_new(pool, added_names, G_N_ELEMENTS(added_names));
+    DynamicArray *updated = test_entries_new_updated(entries, added);
+
+    FsearchNameIndex *updated_index = fsearch_name_index_new_updated(index, updated, added, NULL);
+    g_assert_true(fsearch_name_index_get_entries(updated_index) == updated);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); i++) {
+        check_lookup(updated_index, updated, names[i]);
+    }
+    check_lookup(updated_index, updated, "makefile");
+
+    // removed entries are no candidates anymore
+    g_assert_cmpuint(count_candidates(updated_index, "CMakeLists.txt"), ==, 0);
+    g_assert_cmpuint(count_candidates(updated_index, ".gitignore"), ==, 3);
+
+    g_clear_pointer(&updated_index, fsearch_name_index_unref);
+    g_clear_pointer(&index, fsearch_name_index_unref);
+    g_clear_pointer(&updated, darray_unref);
+    g_clear_pointer(&added, darray_unref);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/name_index/lookup", test_name_index_lookup);
+    g_test_add_func("/FSearch/name_index/updated", test_name_index_updated);
+    return g_test_run();
+}
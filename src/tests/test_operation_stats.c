@@ -0,0 +1,114 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_operation_stats.h>
+
+static void
+check_count(uint64_t count, const char *expected) {
+    g_autofree char *formatted = fsearch_operation_stats_format_count(count);
+    g_assert_cmpstr(formatted, ==, expected);
+}
+
+static void
+test_operation_stats_format_count(void) {
+    check_count(0, "0");
+    check_count(999, "999");
+    check_count(1000, "1.0K");
+    check_count(38000, "38K");
+    check_count(999499, "999K");
+    // would be rounded up to 1000K
+    check_count(999500, "1.0M");
+    check_count(1234567, "1.2M");
+    check_count(UINT64_C(5000000000000000), "5000T");
+}
+
+typedef struct {
+    GMutex *mutex;
+    gint locked;
+} LockContext;
+
+static gpointer
+lock_thread(gpointer data) {
+    LockContext *ctx = data;
+    g_mutex_lock(ctx->mutex);
+    g_atomic_int_set(&ctx->locked, 1);
+    g_usleep(20 * G_TIME_SPAN_MILLISECOND);
+    g_mutex_unlock(ctx->mutex);
+    return NULL;
+}
+
+static void
+test_operation_stats_timer(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_new(2);
+    FsearchOperationTimer timer = {};
+    fsearch_operation_timer_start(&timer, pool);
+
+    // the time until another thread releases the lock counts as waiting for it
+    GMutex mutex;
+    g_mutex_init(&mutex);
+    LockContext ctx = {.mutex = &mutex};
+    GThread *thread = g_thread_new("lock", lock_thread, &ctx);
+    while (!g_atomic_int_get(&ctx.locked)) {
+        g_usleep(100);
+    }
+    fsearch_operation_timer_lock(&timer, &mutex);
+    g_mutex_unlock(&mutex);
+    g_thread_join(thread);
+    g_mutex_clear(&mutex);
+
+    FsearchOperationStats stats = {};
+    fsearch_operation_timer_finish(&timer, 1000, 10, &stats);
+    g_assert_cmpint(stats.finish_time, >, 0);
+    g_assert_cmpuint(stats.num_entries, ==, 1000);
+    g_assert_cmpuint(stats.num_results, ==, 10);
+    g_assert_cmpuint(stats.num_threads, ==, 2);
+    g_assert_cmpfloat(stats.lock_wait_ms, >, 0);
+    g_assert_cmpfloat(stats.wall_ms, >=, stats.lock_wait_ms);
+    // nothing ran on the pool
+    g_assert_cmpfloat(stats.thread_ms, ==, 0);
+
+    g_autofree char *summary = fsearch_operation_stats_get_summary(&stats, FSEARCH_OPERATION_SEARCH);
+    g_assert_true(g_str_has_prefix(summary, "10 results in "));
+
+    FsearchOperationStats all_stats[NUM_FSEARCH_OPERATIONS] = {};
+    all_stats[FSEARCH_OPERATION_SORT] = stats;
+    all_stats[FSEARCH_OPERATION_SAVE] = stats;
+    g_autofree char *details = fsearch_operation_stats_get_details(all_stats);
+    g_auto(GStrv) lines = g_strsplit(details, "\n", -1);
+    // operations which didn't finish are left out
+    g_assert_cmpuint(g_strv_length(lines), ==, 2);
+    g_assert_true(g_str_has_prefix(lines[0], "Sort: 1.0K entries, 10 results in "));
+    g_assert_true(g_str_has_prefix(lines[1], "Save: "));
+
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+static void
+add_range(uint32_t start, uint32_t end, void *data) {
+    g_usleep((end - start) * 1000);
+}
+
+static void
+test_operation_stats_thread_time(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_new(2);
+    FsearchOperationTimer timer = {};
+    fsearch_operation_timer_start(&timer, pool);
+    fsearch_thread_pool_parallel_for(pool, 0, 20, 5, add_range, NULL);
+
+    FsearchOperationStats stats = {};
+    fsearch_operation_timer_finish(&timer, 20, 20, &stats);
+    // the time of every range is counted once
+    g_assert_cmpfloat(stats.thread_ms, >=, 20);
+    g_assert_cmpfloat(stats.thread_ms, <=, stats.wall_ms * stats.num_threads + 1);
+
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/operation_stats/format_count", test_operation_stats_format_count);
+    g_test_add_func("/FSearch/operation_stats/timer", test_operation_stats_timer);
+    g_test_add_func("/FSearch/operation_stats/thread_time", test_operation_stats_thread_time);
+    return g_test_run();
+}
@@ -1,6 +1,7 @@
 #include <glib.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <src/fsearch_limits.h>
 #include <src/fsearch_memory_pool.h>
@@ -145,6 +146,8 @@ test_main(void) {
             {"*c*f", "abcdef", false, 0, 0, true},
             {"ab*ef", "abcdef", false, 0, 0, true},
             {"abc?ef", "abcdef", false, 0, 0, true},
+            {"*.TXT", "notes.txt", false, 0, 0, true},
+            {"*.sh", "RUN.SH", false, 0, 0, true},
             // regex
             {"^b", "ba", false, 0, QUERY_FLAG_REGEX, true},
             {"^B", "ba", false, 0, QUERY_FLAG_REGEX, true},
@@ -209,6 +212,23 @@ test_main(void) {
             // bug #388
             {"size:1kb..2kb", "test", false, 1000, 0, true},
 
+            // entries without an indexed owner have no owner, group or permissions
+            {"owner:0", "test", false, 0, 0, false},
+            {"group:0", "test", false, 0, 0, false},
+            {"owner:unknown_user_name", "test", false, 0, 0, false},
+            {"perm:0", "test", false, 0, 0, true},
+            {"perm:644", "test", false, 0, 0, false},
+            {"perm:-0", "test", false, 0, 0, true},
+            {"perm:/644", "test", false, 0, 0, false},
+            {"perm:/0", "test", false, 0, 0, true},
+            {"perm:8", "test", false, 0, 0, false},
+            {"perm:-abc", "test", false, 0, 0, false},
+            // entries without indexed extended attributes have none
+            {"xattr:user.tag", "test", false, 0, 0, false},
+            {"xattr:user.tag=test", "test", false, 0, 0, false},
+            {"xattr:user.tag= test", "test", false, 0, 0, false},
+            {"xattr: test", "test", false, 0, 0, true},
+
             {"regex:suffix$", "suffix prefix", false, 0, 0, false},
             {"regex:suffix$", "prefix suffix", false, 0, 0, true},
             {"exact:ABC", "aBc", false, 0, 0, true},
@@ -237,6 +257,20 @@ test_main(void) {
             {"ext:pdf;jpg", "test.c", false, 0, 0, false},
             {"ext:", "test.c", false, 0, 0, false},
             {"ext:", "test", false, 0, 0, true},
+            {"ext:pdf;JPG;png", "test.jpg", false, 0, 0, true},
+            {"ext:pdf;jpg;png", "test.PNG", false, 0, 0, true},
+            {"ext:pdf;jpg;png", "test.jpeg", false, 0, 0, false},
+            {"case:ext:pdf;jpg", "test.JPG", false, 0, 0, false},
+            {"case:ext:pdf;JPG", "test.JPG", false, 0, 0, true},
+            // substring operands of OR chains are matched together
+            {"foo OR bar OR baz", "xbazx", false, 0, 0, true},
+            {"foo OR bar OR baz", "BAR", false, 0, 0, true},
+            {"foo OR bar OR baz", "fobaro", false, 0, 0, true},
+            {"foo OR bar OR baz", "fo ba", false, 0, 0, false},
+            {"foo OR size:>10 OR bar", "test", false, 11, 0, true},
+            {"foo OR size:>10 OR bar", "test", false, 10, 0, false},
+            {"foo OR case:Bar", "bar", false, 0, 0, false},
+            {"foo OR case:Bar", "Bar", false, 0, 0, true},
             {"case:(TE || AB) cd", "TEcd", false, 0, 0, true},
             {"case:(TE || AB) cd", "ABcd", false, 0, 0, true},
             {"case:(TE || AB) cd", "AB", false, 0, 0, false},
@@ -353,11 +387,332 @@ test_german_case_mapping(void) {
     }
 }
 
+typedef struct QueryRefinementTest {
+    const char *query;
+    const char *previous_query;
+    FsearchQueryFlags flags;
+    bool result;
+} QueryRefinementTest;
+
+static void
+test_refinement(void) {
+    QueryRefinementTest tests[] = {
+        // narrower queries
+        {"foob", "foo", 0, true},
+        {"xfoo", "foo", 0, true},
+        {"foo bar", "foo", 0, true},
+        {"bar foo", "foo", 0, true},
+        {"fooBar", "foo", QUERY_FLAG_AUTO_MATCH_CASE, true},
+        {"foo bar", "foo", QUERY_FLAG_EXACT_MATCH, true},
+
+        // broader or unrelated queries
+        {"fo", "foo", 0, false},
+        {"bar", "foo", 0, false},
+        {"foo", "", 0, false},
+        {"foob", "foo", QUERY_FLAG_EXACT_MATCH, false},
+        {"foob", "foo", QUERY_FLAG_REGEX, false},
+        // the relationship can't be proven for anything but plain words
+        {"foo OR bar", "foo", 0, false},
+        {"foo NOT", "foo", 0, false},
+        {"foo*", "foo", 0, false},
+        {"foo/", "foo", 0, false},
+        {"foo !bar", "foo", 0, false},
+        {"foo size:>1", "foo", 0, false},
+        {"foo\"bar\"", "foo", 0, false},
+        // the combining mark might get composed with the last character
+        {"e\xcc\x81", "e", 0, false},
+    };
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        QueryRefinementTest *t = &tests[i];
+        FsearchQuery *q = fsearch_query_new(t->query, NULL, NULL, t->flags, "debug_query");
+        FsearchQuery *previous = fsearch_query_new(t->previous_query, NULL, NULL, t->flags, "debug_query");
+        const bool result = fsearch_query_is_refinement_of(q, previous);
+        if (result != t->result) {
+            g_printerr("[%s] should%s refine [%s]\n", t->query, t->result ? "" : " NOT", t->previous_query);
+        }
+        g_assert_true(result == t->result);
+        g_clear_pointer(&q, fsearch_query_unref);
+        g_clear_pointer(&previous, fsearch_query_unref);
+    }
+
+    // queries with different flags are never related
+    FsearchQuery *q = fsearch_query_new("foob", NULL, NULL, QUERY_FLAG_MATCH_CASE, "debug_query");
+    FsearchQuery *previous = fsearch_query_new("foo", NULL, NULL, 0, "debug_query");
+    g_assert_false(fsearch_query_is_refinement_of(q, previous));
+    g_clear_pointer(&q, fsearch_query_unref);
+    g_clear_pointer(&previous, fsearch_query_unref);
+}
+
+static gboolean
+append_leaf_description(GNode *node, gpointer data) {
+    FsearchQueryNode *n = node->data;
+    GString *descriptions = data;
+    if (descriptions->len > 0) {
+        g_string_append_c(descriptions, ' ');
+    }
+    g_string_append(descriptions, n->description->str);
+    return FALSE;
+}
+
+static void
+test_planner(void) {
+    const char *tests[][2] = {
+        // the operands of AND and OR chains are evaluated from cheap to expensive
+        {"regex:^.*foo.*$ ext:jpg", "ext regex"},
+        {"regex:x ext:jpg size:>1 foo", "size ext ascii_icase regex"},
+        {"ä OR foo OR size:<10", "size ascii_icase utf_icase"},
+        // files are only read when all other operands match
+        {"content:foo ext:txt size:>1", "size ext content"},
+        // the NOT is evaluated as a whole
+        {"!regex:x ext:jpg", "ext regex"},
+        // operands of different operators stay where they are
+        {"regex:x (foo OR size:>1)", "size ascii_icase regex"},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        FsearchQuery *q = fsearch_query_new(tests[i][0], NULL, NULL, 0, "debug_query");
+        g_autoptr(GString) descriptions = g_string_new(NULL);
+        g_node_traverse(q->query_tree, G_IN_ORDER, G_TRAVERSE_LEAVES, -1, append_leaf_description, descriptions);
+        if (strcmp(descriptions->str, tests[i][1])) {
+            g_printerr("[%s] should be evaluated as [%s], not [%s]\n", tests[i][0], tests[i][1], descriptions->str);
+        }
+        g_assert_cmpstr(descriptions->str, ==, tests[i][1]);
+        g_clear_pointer(&q, fsearch_query_unref);
+    }
+}
+
+static void
+test_never_matches(void) {
+    struct {
+        const char *query;
+        bool never_matches_folders;
+        bool never_matches_files;
+    } tests[] = {
+        {"foo", false, false},
+        {"ext:jpg", true, false},
+        {"folder:foo", false, true},
+        {"ext:jpg OR folder:foo", false, false},
+        {"ext:jpg folder:foo", true, true},
+        {"!ext:jpg", false, false},
+        {"foo ext:jpg", true, false},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        FsearchQuery *q = fsearch_query_new(tests[i].query, NULL, NULL, 0, "debug_query");
+        g_assert_true(fsearch_query_never_matches(q, DATABASE_ENTRY_TYPE_FOLDER) == tests[i].never_matches_folders);
+        g_assert_true(fsearch_query_never_matches(q, DATABASE_ENTRY_TYPE_FILE) == tests[i].never_matches_files);
+        g_clear_pointer(&q, fsearch_query_unref);
+    }
+}
+
+static void
+test_regex_literal(void) {
+    // the literals of these patterns rule out haystacks before the regex is run, which must not change the results
+    QueryTest tests[] = {
+        {".*\\.tar\\.gz$", "backup.tar.gz", false, 0, QUERY_FLAG_REGEX, true},
+        {".*\\.tar\\.gz$", "BACKUP.TAR.GZ", false, 0, QUERY_FLAG_REGEX, true},
+        {".*\\.tar\\.gz$", "BACKUP.TAR.GZ", false, 0, QUERY_FLAG_REGEX | QUERY_FLAG_MATCH_CASE, false},
+        {".*\\.tar\\.gz$", "backup.tar.gz.old", false, 0, QUERY_FLAG_REGEX, false},
+        {"gz$", "backup.gz\n", false, 0, QUERY_FLAG_REGEX, true},
+        {"^IMG_\\d+", "IMG_0042.jpg", false, 0, QUERY_FLAG_REGEX, true},
+        {"^IMG_\\d+", "img_0042.jpg", false, 0, QUERY_FLAG_REGEX, true},
+        {"^IMG_\\d+", "old IMG_0042.jpg", false, 0, QUERY_FLAG_REGEX, false},
+        {"^IMG_\\d+", "IMG_x.jpg", false, 0, QUERY_FLAG_REGEX, false},
+        {"ab?c", "ac", false, 0, QUERY_FLAG_REGEX, true},
+        {"fo+bar", "fooobar", false, 0, QUERY_FLAG_REGEX, true},
+        {"x{2}yz", "xxyz", false, 0, QUERY_FLAG_REGEX, true},
+        {"foo|bar", "bar", false, 0, QUERY_FLAG_REGEX, true},
+        {"^abc$", "abc", false, 0, QUERY_FLAG_REGEX, true},
+        {"^abc$", "abcd", false, 0, QUERY_FLAG_REGEX, false},
+        {"*.jpg", "photo.JPG", false, 0, 0, true},
+        {"*.jpg", "photo.jpg.txt", false, 0, 0, false},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        test_query(&tests[i]);
+    }
+}
+
+static void
+test_name_prefix(void) {
+    // the names with the prefix are looked up in the name arrays, which are sorted case sensitively
+    struct {
+        const char *query;
+        FsearchQueryFlags flags;
+        const char *name_prefix;
+    } tests[] = {
+        {"foo*", QUERY_FLAG_MATCH_CASE, "foo"},
+        {"case:foo*", 0, "foo"},
+        {"foo*", 0, NULL},
+        {"2024-*.jpg", 0, "2024-"},
+        {"IMG_??.jpg", QUERY_FLAG_MATCH_CASE, "IMG_"},
+        {"*.jpg", QUERY_FLAG_MATCH_CASE, NULL},
+        // names with a digit after the prefix can be sorted in between
+        {"IMG_1*", QUERY_FLAG_MATCH_CASE, NULL},
+        {"case:exact:Makefile", 0, "Makefile"},
+        {"Makefile", QUERY_FLAG_MATCH_CASE, NULL},
+        {"^IMG_\\d+", QUERY_FLAG_MATCH_CASE | QUERY_FLAG_REGEX, "IMG_"},
+        {"^IMG_\\d+", QUERY_FLAG_REGEX, NULL},
+        {"^ab?c", QUERY_FLAG_MATCH_CASE | QUERY_FLAG_REGEX, "a"},
+        {"^foo|bar", QUERY_FLAG_MATCH_CASE | QUERY_FLAG_REGEX, NULL},
+        {"foo* bar", QUERY_FLAG_MATCH_CASE, "foo"},
+        {"foo* OR bar*", QUERY_FLAG_MATCH_CASE, NULL},
+        {"!foo*", QUERY_FLAG_MATCH_CASE, NULL},
+        {"foo*", QUERY_FLAG_MATCH_CASE | QUERY_FLAG_SEARCH_IN_PATH, NULL},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        FsearchQuery *q = fsearch_query_new(tests[i].query, NULL, NULL, tests[i].flags, "debug_query");
+        g_assert_cmpstr(q->name_prefix, ==, tests[i].name_prefix);
+        g_clear_pointer(&q, fsearch_query_unref);
+    }
+}
+
+static void
+test_fuzzy(void) {
+    QueryTest tests[] = {
+        {"fsdbc", "fsearch_database.c", false, 0, QUERY_FLAG_FUZZY, true},
+        {"fuzzy:fsdbc", "fsearch_database.c", false, 0, 0, true},
+        {"fuzzy:FSDBC", "fsearch_database.c", false, 0, 0, true},
+        {"fuzzy:FSDBC", "fsearch_database.c", false, 0, QUERY_FLAG_AUTO_MATCH_CASE, false},
+        {"fuzzy:case:fsdbc", "FSEARCH_DATABASE.C", false, 0, 0, false},
+        {"fuzzy:cbdsf", "fsearch_database.c", false, 0, 0, false},
+        {"fsdbc", "fsearch_database.c", false, 0, 0, false},
+        {"fuzzy:äbg", "Übung", false, 0, 0, false},
+        {"fuzzy:übg", "Übung", false, 0, 0, true},
+        {"fuzzy:ÜBG", "übung", false, 0, 0, true},
+        {"fuzzy:sße", "STRASSE", false, 0, 0, true},
+        {"fuzzy:hmsrc", "/home/src/main.c", false, 0, QUERY_FLAG_SEARCH_IN_PATH, true},
+        {"fuzzy:srchm", "/home/src/main.c", false, 0, QUERY_FLAG_SEARCH_IN_PATH, false},
+        {"fuzzy:f*c", "f*c", false, 0, 0, true},
+        {"fuzzy:f*c", "fsearch.c", false, 0, 0, false},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        test_query(&tests[i]);
+    }
+}
+
+static FsearchDatabaseEntry *
+new_folder_verdict_entry(FsearchMemoryPool *pool, const char *name, FsearchDatabaseEntry *parent) {
+    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+    db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+    db_entry_set_name(entry, name);
+    db_entry_set_parent(entry, (FsearchDatabaseEntryFolder *)parent);
+    return entry;
+}
+
+static void
+test_folder_verdicts(void) {
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    FsearchDatabaseEntry *root = new_folder_verdict_entry(pool, "", NULL);
+    FsearchDatabaseEntry *home = new_folder_verdict_entry(pool, "home", root);
+    FsearchDatabaseEntry *build = new_folder_verdict_entry(pool, "Build", home);
+    FsearchDatabaseEntry *out = new_folder_verdict_entry(pool, "out", build);
+    FsearchDatabaseEntry *src = new_folder_verdict_entry(pool, "src", home);
+    FsearchDatabaseEntry *entries[] = {
+        new_folder_verdict_entry(pool, "a", out),
+        new_folder_verdict_entry(pool, "b", out),
+        new_folder_verdict_entry(pool, "c", src),
+        new_folder_verdict_entry(pool, "build.log", src),
+        out,
+        root,
+    };
+
+    struct {
+        const char *query;
+        FsearchQueryFlags flags;
+        bool results[G_N_ELEMENTS(entries)];
+    } tests[] = {
+        {"path:build", 0, {true, true, false, true, true, false}},
+        {"path:Build", QUERY_FLAG_MATCH_CASE, {true, true, false, false, true, false}},
+        {"path:build/out", 0, {true, true, false, false, true, false}},
+        {"path:me", 0, {true, true, true, true, true, false}},
+        {"parent:/home/build/out", 0, {true, true, false, false, false, false}},
+        {"parent:/home/src", QUERY_FLAG_MATCH_CASE, {false, false, true, true, false, false}},
+        {"path:out parent:/home/build/out", 0, {true, true, false, false, false, false}},
+        {"!path:src", 0, {true, true, false, false, true, true}},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        FsearchQuery *q = fsearch_query_new(tests[i].query, NULL, NULL, tests[i].flags, "debug_query");
+        // the verdicts of the folders are kept in the match data, so all entries of a search share it
+        FsearchQueryMatchData *match_data = fsearch_query_match_data_new();
+        for (uint32_t j = 0; j < G_N_ELEMENTS(entries); j++) {
+            fsearch_query_match_data_set_entry(match_data, entries[j]);
+            const bool found = fsearch_query_match(q, match_data);
+            if (found != tests[i].results[j]) {
+                g_printerr("[%s] should%s match [%s]\n",
+                           tests[i].query,
+                           tests[i].results[j] ? "" : " NOT",
+                           fsearch_query_match_data_get_path_str(match_data));
+            }
+            g_assert_true(found == tests[i].results[j]);
+        }
+        g_clear_pointer(&match_data, fsearch_query_match_data_free);
+        g_clear_pointer(&q, fsearch_query_unref);
+    }
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_filter_trees(void) {
+    FsearchFilterManager *manager = fsearch_filter_manager_new();
+    FsearchFilter *macro = fsearch_filter_new("Text", "txt", "ext:txt;md", QUERY_FLAG_FILES_ONLY);
+    fsearch_filter_manager_append_filter(manager, macro);
+
+    // the tree of a filter is parsed once and shared by all queries which use it
+    FsearchQuerySharedTree *tree = fsearch_filter_manager_get_query_tree(manager, "txt: foo", 0);
+    FsearchQuerySharedTree *same_tree = fsearch_filter_manager_get_query_tree(manager, "txt: foo", 0);
+    FsearchQuerySharedTree *other_flags = fsearch_filter_manager_get_query_tree(manager, "txt: foo", QUERY_FLAG_REGEX);
+    g_assert_true(tree == same_tree);
+    g_assert_true(tree != other_flags);
+    g_clear_pointer(&same_tree, fsearch_query_shared_tree_unref);
+    g_clear_pointer(&other_flags, fsearch_query_shared_tree_unref);
+
+    FsearchFilter *filter = fsearch_filter_new("Foo", NULL, "txt: foo", 0);
+    FsearchQuery *q1 = fsearch_query_new("bar", filter, manager, 0, "debug_query");
+    FsearchQuery *q2 = fsearch_query_new("baz", filter, manager, 0, "debug_query");
+    g_assert_true(q1->filter_tree == tree->root);
+    g_assert_true(q2->filter_tree == tree->root);
+
+    // editing a macro changes what the filter matches, so it's parsed again
+    fsearch_filter_manager_edit(manager, macro, "Text", "txt", "ext:txt", QUERY_FLAG_FILES_ONLY);
+    FsearchQuery *q3 = fsearch_query_new("bar", filter, manager, 0, "debug_query");
+    g_assert_true(q3->filter_tree != tree->root);
+
+    // the queries which use the old tree keep it alive
+    g_clear_pointer(&tree, fsearch_query_shared_tree_unref);
+    g_clear_pointer(&manager, fsearch_filter_manager_free);
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(10, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+    db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+    db_entry_set_name(entry, "foo bar.md");
+    FsearchQueryMatchData *match_data = fsearch_query_match_data_new();
+    fsearch_query_match_data_set_entry(match_data, entry);
+    g_assert_true(fsearch_query_match(q1, match_data));
+    g_assert_false(fsearch_query_match(q2, match_data));
+    g_assert_false(fsearch_query_match(q3, match_data));
+
+    g_clear_pointer(&match_data, fsearch_query_match_data_free);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&q1, fsearch_query_unref);
+    g_clear_pointer(&q2, fsearch_query_unref);
+    g_clear_pointer(&q3, fsearch_query_unref);
+    g_clear_pointer(&filter, fsearch_filter_unref);
+    g_clear_pointer(&macro, fsearch_filter_unref);
+}
+
 int
 main(int argc, char *argv[]) {
     g_test_init(&argc, &argv, NULL);
     g_test_add_func("/FSearch/query/main", test_main);
     g_test_add_func("/FSearch/query/mappings_turkic", test_turkic_case_mapping);
     g_test_add_func("/FSearch/query/mappings_german", test_german_case_mapping);
+    g_test_add_func("/FSearch/query/refinement", test_refinement);
+    g_test_add_func("/FSearch/query/planner", test_planner);
+    g_test_add_func("/FSearch/query/never_matches", test_never_matches);
+    g_test_add_func("/FSearch/query/regex_literal", test_regex_literal);
+    g_test_add_func("/FSearch/query/name_prefix", test_name_prefix);
+    g_test_add_func("/FSearch/query/folder_verdicts", test_folder_verdicts);
+    g_test_add_func("/FSearch/query/fuzzy", test_fuzzy);
+    g_test_add_func("/FSearch/query/filter_trees", test_filter_trees);
     return g_test_run();
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <src/fsearch_query_log.h>
+
+static void
+test_query_log_round_trip(void) {
+    const FsearchQueryLogRecord record = {
+        .time_ms = 1234.5,
+        .flags = QUERY_FLAG_MATCH_CASE | QUERY_FLAG_REGEX,
+        .filter = "Music\tand more",
+        .query = "a\\b\tc\nd e ü",
+        .num_results = 42,
+        .queued_ms = 0.25,
+        .search_ms = 17,
+        .status = FSEARCH_QUERY_LOG_STATUS_CANCELLED,
+    };
+    g_autofree char *line = fsearch_query_log_format_record(&record);
+    // one record per line
+    g_assert_null(strchr(line, '\n'));
+
+    FsearchQueryLogRecord parsed = {};
+    g_assert_true(fsearch_query_log_parse_record(line, &parsed));
+    g_assert_cmpfloat(parsed.time_ms, ==, record.time_ms);
+    g_assert_cmpuint(parsed.flags, ==, record.flags);
+    g_assert_cmpstr(parsed.filter, ==, record.filter);
+    g_assert_cmpstr(parsed.query, ==, record.query);
+    g_assert_cmpuint(parsed.num_results, ==, record.num_results);
+    g_assert_cmpfloat(parsed.queued_ms, ==, record.queued_ms);
+    g_assert_cmpfloat(parsed.search_ms, ==, record.search_ms);
+    g_assert_cmpint(parsed.status, ==, record.status);
+    fsearch_query_log_record_clear(&parsed);
+
+    // no filter and an empty query
+    const FsearchQueryLogRecord empty = {.query = ""};
+    g_autofree char *empty_line = fsearch_query_log_format_record(&empty);
+    g_assert_true(fsearch_query_log_parse_record(empty_line, &parsed));
+    g_assert_null(parsed.filter);
+    g_assert_cmpstr(parsed.query, ==, "");
+    g_assert_cmpint(parsed.status, ==, FSEARCH_QUERY_LOG_STATUS_FINISHED);
+    fsearch_query_log_record_clear(&parsed);
+}
+
+static void
+test_query_log_parse_invalid(void) {
+    const char *lines[] = {
+        "# time_ms\tflags\tfilter\tresults\tqueued_ms\tsearch_ms\tstatus\tquery",
+        "",
+        "1.0\t0\t\t3\t0.1\t0.2\tfinished",
+        "x\t0\t\t3\t0.1\t0.2\tfinished\tquery",
+        "1.0\t0\t\t-3\t0.1\t0.2\tfinished\tquery",
+        "1.0\t0\t\t3\t0.1\t0.2\tunknown\tquery",
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(lines); i++) {
+        FsearchQueryLogRecord record = {};
+        g_assert_false(fsearch_query_log_parse_record(lines[i], &record));
+        fsearch_query_log_record_clear(&record);
+    }
+
+    // tabs in the query are escaped, so everything after the seventh tab belongs to it
+    FsearchQueryLogRecord record = {};
+    g_assert_true(fsearch_query_log_parse_record("1.0\t0\t\t3\t0.1\t0.2\tfinished\ta\tb\n", &record));
+    g_assert_cmpstr(record.query, ==, "a\tb");
+    fsearch_query_log_record_clear(&record);
+}
+
+static void
+test_query_log_anonymize(void) {
+    const uint64_t key = 7;
+    g_autofree char *anonymized = fsearch_query_log_anonymize("Report 2023 ext:pdf AND NOT size:>1mb", key);
+    g_assert_cmpuint(strlen(anonymized), ==, strlen("Report 2023 ext:pdf AND NOT size:>1mb"));
+    g_assert_cmpstr(anonymized, !=, "Report 2023 ext:pdf AND NOT size:>1mb");
+    // the syntax stays
+    g_assert_true(strstr(anonymized, " ext:") == anonymized + 11);
+    g_assert_true(strstr(anonymized, " AND NOT size:>") == anonymized + 19);
+    // and the kind of every character
+    g_assert_true(g_ascii_isupper(anonymized[0]));
+    for (uint32_t i = 1; i < 6; i++) {
+        g_assert_true(g_ascii_islower(anonymized[i]));
+    }
+    for (uint32_t i = 7; i < 11; i++) {
+        g_assert_true(g_ascii_isdigit(anonymized[i]));
+    }
+
+    // typing a word extends the previous query, the same words are replaced the same way
+    g_autofree char *prefix = fsearch_query_log_anonymize("Repo", key);
+    g_assert_true(g_str_has_prefix(anonymized, prefix));
+    g_autofree char *again = fsearch_query_log_anonymize("Report 2023 ext:pdf AND NOT size:>1mb", key);
+    g_assert_cmpstr(again, ==, anonymized);
+    g_autofree char *other_key = fsearch_query_log_anonymize("Report 2023 ext:pdf AND NOT size:>1mb", key + 1);
+    g_assert_cmpstr(other_key, !=, anonymized);
+
+    // non-ASCII letters get replaced by ASCII ones
+    g_autofree char *utf = fsearch_query_log_anonymize("Überweisung/写真", key);
+    g_assert_cmpuint(strlen(utf), ==, strlen("Uberweisung/xx"));
+    g_assert_true(g_ascii_isupper(utf[0]));
+    g_assert_cmpint(utf[11], ==, '/');
+
+    g_assert_null(fsearch_query_log_anonymize(NULL, key));
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/query_log/round_trip", test_query_log_round_trip);
+    g_test_add_func("/FSearch/query_log/parse_invalid", test_query_log_parse_invalid);
+    g_test_add_func("/FSearch/query_log/anonymize", test_query_log_anonymize);
+    return g_test_run();
+}
@@ -0,0 +1,88 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_result_cache.h>
+
+static DynamicArray *
+new_array(uint32_t num_items) {
+    DynamicArray *array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        darray_add_item(array, GUINT_TO_POINTER(i + 1));
+    }
+    return array;
+}
+
+static void
+test_result_cache_lookup(void) {
+    FsearchResultCache *cache = fsearch_result_cache_new(1024 * 1024);
+    DynamicArray *folders = new_array(10);
+    DynamicArray *files = new_array(20);
+
+    g_assert_false(fsearch_result_cache_lookup(cache, "foo", NULL, NULL, NULL));
+
+    fsearch_result_cache_insert(cache, "foo", folders, files, DATABASE_INDEX_TYPE_SIZE);
+    DynamicArray *cached_folders = NULL;
+    DynamicArray *cached_files = NULL;
+    FsearchDatabaseIndexType sort_order = DATABASE_INDEX_TYPE_NAME;
+    g_assert_true(fsearch_result_cache_lookup(cache, "foo", &cached_folders, &cached_files, &sort_order));
+    g_assert_true(cached_folders == folders);
+    g_assert_true(cached_files == files);
+    g_assert_cmpint(sort_order, ==, DATABASE_INDEX_TYPE_SIZE);
+    g_clear_pointer(&cached_folders, darray_unref);
+    g_clear_pointer(&cached_files, darray_unref);
+
+    // empty results are cached too
+    fsearch_result_cache_insert(cache, "bar", NULL, NULL, DATABASE_INDEX_TYPE_NAME);
+    g_assert_true(fsearch_result_cache_lookup(cache, "bar", &cached_folders, &cached_files, NULL));
+    g_assert_null(cached_folders);
+    g_assert_null(cached_files);
+
+    fsearch_result_cache_clear(cache);
+    g_assert_false(fsearch_result_cache_lookup(cache, "foo", NULL, NULL, NULL));
+    g_assert_cmpuint(fsearch_result_cache_get_size(cache), ==, 0);
+
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&cache, fsearch_result_cache_free);
+}
+
+static void
+test_result_cache_eviction(void) {
+    DynamicArray *files = new_array(1000);
+    const size_t max_size = 3000 * sizeof(void *);
+    FsearchResultCache *cache = fsearch_result_cache_new(max_size);
+
+    fsearch_result_cache_insert(cache, "a", NULL, files, DATABASE_INDEX_TYPE_NAME);
+    fsearch_result_cache_insert(cache, "b", NULL, files, DATABASE_INDEX_TYPE_NAME);
+    // "a" becomes the most recently used result
+    g_assert_true(fsearch_result_cache_lookup(cache, "a", NULL, NULL, NULL));
+    fsearch_result_cache_insert(cache, "c", NULL, files, DATABASE_INDEX_TYPE_NAME);
+    g_assert_cmpuint(fsearch_result_cache_get_size(cache), <=, max_size);
+
+    g_assert_true(fsearch_result_cache_lookup(cache, "a", NULL, NULL, NULL));
+    g_assert_false(fsearch_result_cache_lookup(cache, "b", NULL, NULL, NULL));
+    g_assert_true(fsearch_result_cache_lookup(cache, "c", NULL, NULL, NULL));
+
+    // results which are larger than the whole cache aren't stored at all
+    DynamicArray *large_files = new_array(4000);
+    fsearch_result_cache_insert(cache, "d", NULL, large_files, DATABASE_INDEX_TYPE_NAME);
+    g_assert_false(fsearch_result_cache_lookup(cache, "d", NULL, NULL, NULL));
+    g_assert_true(fsearch_result_cache_lookup(cache, "a", NULL, NULL, NULL));
+
+    fsearch_result_cache_set_max_size(cache, 0);
+    g_assert_cmpuint(fsearch_result_cache_get_size(cache), ==, 0);
+    fsearch_result_cache_insert(cache, "a", NULL, files, DATABASE_INDEX_TYPE_NAME);
+    g_assert_false(fsearch_result_cache_lookup(cache, "a", NULL, NULL, NULL));
+
+    g_clear_pointer(&large_files, darray_unref);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&cache, fsearch_result_cache_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/result_cache/lookup", test_result_cache_lookup);
+    g_test_add_func("/FSearch/result_cache/eviction", test_result_cache_eviction);
+    return g_test_run();
+}
@@ -0,0 +1,165 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <src/fsearch_scan_throttle.h>
+
+#include "test_files.h"
+
+// the simulated clock starts there, the throttle only looks at differences
+#define START_US ((int64_t)1000 * G_USEC_PER_SEC)
+
+typedef struct {
+    char *dir;
+} PowerSupplyFixture;
+
+// Charges num_batches batches of calls, each of which takes duration_us, and waits as told. Returns the simulated time
+// in microseconds all of them took.
+static int64_t
+run_batches(FsearchScanThrottle *throttle,
+            uint32_t num_batches,
+            uint32_t num_calls,
+            uint64_t num_bytes,
+            int64_t duration_us,
+            int64_t *now_us) {
+    const int64_t start_us = *now_us;
+    for (uint32_t i = 0; i < num_batches; i++) {
+        *now_us += duration_us;
+        const int64_t wait_us = fsearch_scan_throttle_charge(throttle, num_calls, num_bytes, duration_us, *now_us);
+        g_assert_cmpint(wait_us, >=, 0);
+        *now_us += wait_us;
+    }
+    return *now_us - start_us;
+}
+
+static void
+add_power_supply(PowerSupplyFixture *fixture, const char *name, const char *attributes[][2]) {
+    g_autofree char *supply_dir = g_build_filename(fixture->dir, name, NULL);
+    g_assert_cmpint(g_mkdir_with_parents(supply_dir, 0700), ==, 0);
+    for (uint32_t i = 0; attributes[i][0]; i++) {
+        g_autofree char *path = g_build_filename(supply_dir, attributes[i][0], NULL);
+        g_autofree char *contents = g_strconcat(attributes[i][1], "\n", NULL);
+        g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+    }
+}
+
+static void
+fixture_init(PowerSupplyFixture *fixture) {
+    fixture->dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+}
+
+static void
+fixture_clear(PowerSupplyFixture *fixture) {
+    test_files_remove_recursive(fixture->dir);
+    g_clear_pointer(&fixture->dir, g_free);
+}
+
+static void
+add_battery(PowerSupplyFixture *fixture, const char *status) {
+    const char *battery[][2] = {{"type", "Battery"}, {"status", status}, {NULL, NULL}};
+    add_power_supply(fixture, "BAT0", battery);
+}
+
+static void
+add_mains(PowerSupplyFixture *fixture, const char *online) {
+    const char *mains[][2] = {{"type", "Mains"}, {"online", online}, {NULL, NULL}};
+    add_power_supply(fixture, "AC", mains);
+}
+
+static void
+test_scan_throttle_unlimited(void) {
+    FsearchScanThrottle *throttle = fsearch_scan_throttle_new(0, 0);
+    fsearch_scan_throttle_set_power_supply_dir(throttle, "/nonexistent");
+    int64_t now_us = START_US;
+    // calls which always take the same time never wait
+    g_assert_cmpint(run_batches(throttle, 10000, 1, 4096, 50, &now_us), ==, 10000 * 50);
+    g_assert_cmpfloat(fsearch_scan_throttle_get_share(throttle), ==, 1.0);
+    g_clear_pointer(&throttle, fsearch_scan_throttle_unref);
+}
+
+static void
+test_scan_throttle_budgets(void) {
+    int64_t now_us = START_US;
+
+    // 1000 calls at 100 calls per second, only the first ones run ahead of the budget
+    FsearchScanThrottle *throttle = fsearch_scan_throttle_new(100, 0);
+    fsearch_scan_throttle_set_power_supply_dir(throttle, "/nonexistent");
+    g_assert_cmpint(fsearch_scan_throttle_charge(throttle, 1, 0, 0, now_us), ==, 0);
+    const int64_t calls_us = run_batches(throttle, 1000, 1, 0, 0, &now_us);
+    g_assert_cmpint(calls_us, >=, 9 * G_USEC_PER_SEC);
+    g_assert_cmpint(calls_us, <=, 11 * G_USEC_PER_SEC);
+    g_clear_pointer(&throttle, fsearch_scan_throttle_unref);
+
+    // 1000 KiB at 100 KiB per second
+    throttle = fsearch_scan_throttle_new(0, 100);
+    fsearch_scan_throttle_set_power_supply_dir(throttle, "/nonexistent");
+    const int64_t bytes_us = run_batches(throttle, 1000, 1, 1024, 0, &now_us);
+    g_assert_cmpint(bytes_us, >=, 9 * G_USEC_PER_SEC);
+    g_assert_cmpint(bytes_us, <=, 11 * G_USEC_PER_SEC);
+    g_clear_pointer(&throttle, fsearch_scan_throttle_unref);
+}
+
+static void
+test_scan_throttle_latency(void) {
+    FsearchScanThrottle *throttle = fsearch_scan_throttle_new(0, 0);
+    fsearch_scan_throttle_set_power_supply_dir(throttle, "/nonexistent");
+    int64_t now_us = START_US;
+    run_batches(throttle, 100000, 1, 0, 10, &now_us);
+    g_assert_cmpfloat(fsearch_scan_throttle_get_share(throttle), ==, 1.0);
+
+    // the filesystem got busy, the scan backs off as far as it can
+    const int64_t busy_us = run_batches(throttle, 100000, 1, 0, 100, &now_us);
+    g_assert_cmpfloat(fsearch_scan_throttle_get_share(throttle), <, 1.0);
+    g_assert_cmpint(busy_us, >, 2 * 100000 * 100);
+
+    // and speeds up again once the calls are fast again
+    run_batches(throttle, 1000000, 1, 0, 10, &now_us);
+    g_assert_cmpfloat(fsearch_scan_throttle_get_share(throttle), ==, 1.0);
+    g_clear_pointer(&throttle, fsearch_scan_throttle_unref);
+}
+
+static void
+test_scan_throttle_battery(void) {
+    PowerSupplyFixture fixture = {};
+    fixture_init(&fixture);
+
+    g_assert_false(fsearch_scan_throttle_is_on_battery(fixture.dir));
+    g_assert_false(fsearch_scan_throttle_is_on_battery("/nonexistent"));
+
+    add_battery(&fixture, "Charging");
+    g_assert_false(fsearch_scan_throttle_is_on_battery(fixture.dir));
+    add_battery(&fixture, "Discharging");
+    g_assert_true(fsearch_scan_throttle_is_on_battery(fixture.dir));
+    add_mains(&fixture, "0");
+    g_assert_true(fsearch_scan_throttle_is_on_battery(fixture.dir));
+
+    // the budget is cut down to a quarter
+    FsearchScanThrottle *throttle = fsearch_scan_throttle_new(100, 0);
+    fsearch_scan_throttle_set_power_supply_dir(throttle, fixture.dir);
+    int64_t now_us = START_US;
+    const int64_t battery_us = run_batches(throttle, 100, 1, 0, 0, &now_us);
+    g_assert_cmpint(battery_us, >=, 3 * G_USEC_PER_SEC);
+    g_assert_cmpint(battery_us, <=, 5 * G_USEC_PER_SEC);
+    g_clear_pointer(&throttle, fsearch_scan_throttle_unref);
+
+    add_mains(&fixture, "1");
+    g_assert_false(fsearch_scan_throttle_is_on_battery(fixture.dir));
+
+    // the batteries of devices don't count
+    test_files_remove_recursive(fixture.dir);
+    const char *mouse[][2] = {{"type", "Battery"}, {"status", "Discharging"}, {"scope", "Device"}, {NULL, NULL}};
+    add_power_supply(&fixture, "hid-mouse-battery", mouse);
+    g_assert_false(fsearch_scan_throttle_is_on_battery(fixture.dir));
+
+    fixture_clear(&fixture);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/scan_throttle/unlimited", test_scan_throttle_unlimited);
+    g_test_add_func("/FSearch/scan_throttle/budgets", test_scan_throttle_budgets);
+    g_test_add_func("/FSearch/scan_throttle/latency", test_scan_throttle_latency);
+    g_test_add_func("/FSearch/scan_throttle/battery", test_scan_throttle_battery);
+    return g_test_run();
+}
@@ -0,0 +1,61 @@
+#include <glib.h>
+#include <stdbool.h>
+
+#include <src/fsearch_search_latency.h>
+
+static void
+test_search_latency_average(void) {
+    FsearchSearchLatency latency = {};
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL), ==, 0);
+
+    // cancelled searches don't say how long a search would have taken
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 50, true);
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL), ==, 0);
+
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 100, false);
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL), ==, 100);
+    // the classes are independent
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_REFINE), ==, 0);
+
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 200, false);
+    const double average = fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL);
+    g_assert_cmpfloat(average, >, 100);
+    g_assert_cmpfloat(average, <, 200);
+
+    // but once searches got cancelled after a longer time they do
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 10, true);
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL), ==, average);
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 1000, true);
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL), >, average);
+
+    // the average follows faster searches
+    for (uint32_t i = 0; i < 50; i++) {
+        fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 2, false);
+    }
+    g_assert_cmpfloat(fsearch_search_latency_get_average(&latency, FSEARCH_SEARCH_CLASS_FULL), <, 3);
+}
+
+static void
+test_search_latency_delay(void) {
+    FsearchSearchLatency latency = {};
+    g_assert_cmpuint(fsearch_search_latency_get_delay(&latency, FSEARCH_SEARCH_CLASS_REFINE), ==, 0);
+
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_REFINE, 5, false);
+    g_assert_cmpuint(fsearch_search_latency_get_delay(&latency, FSEARCH_SEARCH_CLASS_REFINE), ==, 0);
+
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 120, false);
+    g_assert_cmpuint(fsearch_search_latency_get_delay(&latency, FSEARCH_SEARCH_CLASS_FULL), ==, 120);
+
+    fsearch_search_latency_add(&latency, FSEARCH_SEARCH_CLASS_FULL, 5000, false);
+    g_assert_cmpuint(fsearch_search_latency_get_delay(&latency, FSEARCH_SEARCH_CLASS_FULL),
+                     ==,
+                     FSEARCH_SEARCH_LATENCY_MAX_DELAY_MS);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/search_latency/average", test_search_latency_average);
+    g_test_add_func("/FSearch/search_latency/delay", test_search_latency_delay);
+    return g_test_run();
+}
@@ -0,0 +1,120 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_selection.h>
+
+#define NUM_FOLDERS 20
+#define NUM_FILES_PER_FOLDER 500
+
+typedef struct {
+    FsearchMemoryPool *folder_pool;
+    FsearchMemoryPool *file_pool;
+    DynamicArray *folders;
+    DynamicArray *files;
+} TestDatabase;
+
+// A root folder with NUM_FOLDERS folders in it, every file name is unique so the arrays are sorted by name and path.
+// Every file whose number is a multiple of skip_files (if it's not 0) is left out.
+static TestDatabase *
+test_database_new(uint32_t skip_files) {
+    TestDatabase *db = calloc(1, sizeof(TestDatabase));
+    db->folder_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    db->file_pool = fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    db->folders = darray_new(NUM_FOLDERS + 1);
+    db->files = darray_new(NUM_FOLDERS * NUM_FILES_PER_FOLDER);
+
+    FsearchDatabaseEntry *root = fsearch_memory_pool_malloc(db->folder_pool);
+    db_entry_set_type(root, DATABASE_ENTRY_TYPE_FOLDER);
+    db_entry_set_name(root, "");
+    db_entry_set_idx(root, 0);
+    darray_add_item(db->folders, root);
+
+    for (uint32_t i = 0; i < NUM_FOLDERS; i++) {
+        FsearchDatabaseEntry *folder = fsearch_memory_pool_malloc(db->folder_pool);
+        g_autofree char *folder_name = g_strdup_printf("dir%03d", i);
+        db_entry_set_type(folder, DATABASE_ENTRY_TYPE_FOLDER);
+        db_entry_set_name(folder, folder_name);
+        db_entry_set_parent(folder, (FsearchDatabaseEntryFolder *)root);
+        db_entry_set_idx(folder, i + 1);
+        darray_add_item(db->folders, folder);
+
+        for (uint32_t j = 0; j < NUM_FILES_PER_FOLDER; j++) {
+            const uint32_t num = i * NUM_FILES_PER_FOLDER + j;
+            if (skip_files && num % skip_files == 0) {
+                continue;
+            }
+            FsearchDatabaseEntry *file = fsearch_memory_pool_malloc(db->file_pool);
+            g_autofree char *file_name = g_strdup_printf("file%05d", num);
+            db_entry_set_type(file, DATABASE_ENTRY_TYPE_FILE);
+            db_entry_set_name(file, file_name);
+            db_entry_set_parent(file, (FsearchDatabaseEntryFolder *)folder);
+            db_entry_set_idx(file, darray_get_num_items(db->files));
+            darray_add_item(db->files, file);
+        }
+    }
+    return db;
+}
+
+static void
+test_database_free(TestDatabase *db) {
+    g_clear_pointer(&db->files, darray_unref);
+    g_clear_pointer(&db->folders, darray_unref);
+    g_clear_pointer(&db->file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&db->folder_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&db, free);
+}
+
+static void
+check_rebase(uint32_t select_every) {
+    TestDatabase *db_old = test_database_new(0);
+    TestDatabase *db_new = test_database_new(7);
+
+    FsearchSelection *selection = fsearch_selection_new();
+    fsearch_selection_select_all(selection, db_old->folders);
+    for (uint32_t i = 0; i < darray_get_num_items(db_old->files); i += select_every) {
+        fsearch_selection_select(selection, darray_get_item(db_old->files, i));
+    }
+
+    FsearchSelection *rebased = fsearch_selection_new_rebased(selection, db_new->folders, db_new->files, NULL);
+    uint32_t num_selected = NUM_FOLDERS + 1;
+    for (uint32_t i = 0; i < darray_get_num_items(db_new->folders); i++) {
+        g_assert_true(fsearch_selection_is_selected(rebased, darray_get_item(db_new->folders, i)));
+    }
+    for (uint32_t i = 0; i < darray_get_num_items(db_new->files); i++) {
+        FsearchDatabaseEntry *file = darray_get_item(db_new->files, i);
+        const uint32_t num = (uint32_t)g_ascii_strtoull(db_entry_get_name_raw(file) + 4, NULL, 10);
+        const bool was_selected = num % select_every == 0;
+        g_assert_true(fsearch_selection_is_selected(rebased, file) == was_selected);
+        num_selected += was_selected ? 1 : 0;
+    }
+    // the removed files aren't selected anymore
+    g_assert_cmpuint(fsearch_selection_get_num_selected(rebased), ==, num_selected);
+
+    g_clear_pointer(&rebased, fsearch_selection_free);
+    g_clear_pointer(&selection, fsearch_selection_free);
+    g_clear_pointer(&db_new, test_database_free);
+    g_clear_pointer(&db_old, test_database_free);
+}
+
+static void
+test_selection_rebase_few(void) {
+    // few entries are looked up one after another
+    check_rebase(50);
+}
+
+static void
+test_selection_rebase_many(void) {
+    // many entries are joined with the new entries by their path hashes
+    check_rebase(2);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/selection/rebase_few", test_selection_rebase_few);
+    g_test_add_func("/FSearch/selection/rebase_many", test_selection_rebase_many);
+    return g_test_run();
+}
@@ -0,0 +1,171 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_folder_paths.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_selection_export.h>
+
+#include "test_tree.h"
+
+// enough files for several chunks of output
+#define NUM_FILES 20000
+
+typedef struct {
+    TestTree tree;
+    // the folders followed by the files
+    DynamicArray *entries;
+} ExportFixture;
+
+static void
+fixture_init(ExportFixture *fixture) {
+    test_tree_init(&fixture->tree);
+    fixture->entries = darray_new(NUM_FILES + 3);
+    darray_add_array(fixture->entries, fixture->tree.folders);
+    for (uint32_t i = 0; i < NUM_FILES; i++) {
+        char name[32] = "";
+        snprintf(name, sizeof(name), "file %05u.txt", i);
+        darray_add_item(fixture->entries, test_tree_add_file(&fixture->tree, name, fixture->tree.docs));
+    }
+}
+
+static void
+fixture_clear(ExportFixture *fixture) {
+    g_clear_pointer(&fixture->entries, darray_unref);
+    test_tree_clear(&fixture->tree);
+}
+
+static char *
+get_expected_output(ExportFixture *fixture, FsearchSelectionExportFormat format) {
+    GString *expected = g_string_new(NULL);
+    for (uint32_t i = 0; i < darray_get_num_items(fixture->entries); i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(fixture->entries, i);
+        g_autoptr(GString) full_path = db_entry_get_path_full(entry);
+        g_autoptr(GString) path = db_entry_get_path(entry);
+        g_autoptr(GString) name = db_entry_get_name_for_display(entry);
+        g_autofree char *uri = g_filename_to_uri(full_path->str, NULL, NULL);
+        switch (format) {
+        case FSEARCH_SELECTION_EXPORT_FULL_PATH:
+            g_string_append(expected, full_path->str);
+            break;
+        case FSEARCH_SELECTION_EXPORT_PATH:
+            g_string_append(expected, path->str);
+            break;
+        case FSEARCH_SELECTION_EXPORT_NAME:
+            g_string_append(expected, name->str);
+            break;
+        case FSEARCH_SELECTION_EXPORT_URI:
+            g_string_append(expected, uri);
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        g_string_append_c(expected, '\n');
+    }
+    return g_string_free(expected, FALSE);
+}
+
+static char *
+steal_output(GOutputStream *stream) {
+    // for the terminating NUL
+    g_assert_true(g_output_stream_write_all(stream, "", 1, NULL, NULL, NULL));
+    g_assert_true(g_output_stream_close(stream, NULL, NULL));
+    return g_memory_output_stream_steal_data(G_MEMORY_OUTPUT_STREAM(stream));
+}
+
+static void
+test_selection_export_formats(void) {
+    ExportFixture fixture = {};
+    fixture_init(&fixture);
+    FsearchFolderPaths *folder_paths = fsearch_folder_paths_new(fixture.tree.folders);
+
+    for (FsearchSelectionExportFormat format = 0; format < NUM_FSEARCH_SELECTION_EXPORT_FORMATS; format++) {
+        // with and without the folder paths
+        for (uint32_t i = 0; i < 2; i++) {
+            FsearchSelectionExport *export =
+                fsearch_selection_export_new(NULL, fixture.entries, i == 0 ? folder_paths : NULL, format);
+            g_assert_cmpuint(fsearch_selection_export_get_num_entries(export), ==, NUM_FILES + 3);
+
+            g_autoptr(GOutputStream) stream = g_memory_output_stream_new_resizable();
+            g_autoptr(GError) error = NULL;
+            g_assert_true(fsearch_selection_export_write(export, stream, NULL, &error));
+            g_assert_no_error(error);
+
+            g_autofree char *output = steal_output(stream);
+            g_autofree char *expected = get_expected_output(&fixture, format);
+            g_assert_cmpstr(output, ==, expected);
+            g_clear_pointer(&export, fsearch_selection_export_free);
+        }
+    }
+
+    g_clear_pointer(&folder_paths, fsearch_folder_paths_unref);
+    fixture_clear(&fixture);
+}
+
+typedef struct {
+    GMainLoop *loop;
+    GError *error;
+    bool finished;
+} ExportAsyncResult;
+
+static void
+on_export_finished(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+    ExportAsyncResult *res = user_data;
+    res->finished = fsearch_selection_export_write_finish(result, &res->error);
+    g_main_loop_quit(res->loop);
+}
+
+static void
+test_selection_export_async(void) {
+    ExportFixture fixture = {};
+    fixture_init(&fixture);
+
+    g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+    g_autoptr(GOutputStream) stream = g_memory_output_stream_new_resizable();
+    ExportAsyncResult res = {.loop = loop};
+    fsearch_selection_export_write_async(
+        fsearch_selection_export_new(NULL, fixture.entries, NULL, FSEARCH_SELECTION_EXPORT_FULL_PATH),
+        stream,
+        NULL,
+        NULL,
+        NULL,
+        on_export_finished,
+        &res);
+    g_main_loop_run(loop);
+    g_assert_no_error(res.error);
+    g_assert_true(res.finished);
+    g_autofree char *output = steal_output(stream);
+    g_autofree char *expected = get_expected_output(&fixture, FSEARCH_SELECTION_EXPORT_FULL_PATH);
+    g_assert_cmpstr(output, ==, expected);
+
+    // nothing gets written once it's cancelled
+    g_autoptr(GOutputStream) cancelled_stream = g_memory_output_stream_new_resizable();
+    g_autoptr(GCancellable) cancellable = g_cancellable_new();
+    g_cancellable_cancel(cancellable);
+    ExportAsyncResult cancelled_res = {.loop = loop};
+    fsearch_selection_export_write_async(
+        fsearch_selection_export_new(NULL, fixture.entries, NULL, FSEARCH_SELECTION_EXPORT_NAME),
+        cancelled_stream,
+        cancellable,
+        NULL,
+        NULL,
+        on_export_finished,
+        &cancelled_res);
+    g_main_loop_run(loop);
+    g_assert_false(cancelled_res.finished);
+    g_assert_error(cancelled_res.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_clear_error(&cancelled_res.error);
+    g_assert_cmpuint(g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(cancelled_stream)), ==, 0);
+
+    fixture_clear(&fixture);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/selection_export/formats", test_selection_export_formats);
+    g_test_add_func("/FSearch/selection_export/async", test_selection_export_async);
+    return g_test_run();
+}
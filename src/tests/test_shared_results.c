@@ -0,0 +1,112 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <src/fsearch_shared_results.h>
+
+static DynamicArray *
+new_array(uint32_t num_items) {
+    DynamicArray *array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        darray_add_item(array, GUINT_TO_POINTER(i + 1));
+    }
+    return array;
+}
+
+typedef struct {
+    FsearchSharedResults *results;
+    DynamicArray *folders;
+    DynamicArray *files;
+    bool found;
+} WaitContext;
+
+static gpointer
+wait_thread(gpointer data) {
+    WaitContext *ctx = data;
+    bool compute = true;
+    FsearchSharedResult *result = fsearch_shared_results_attach(ctx->results, "foo", &compute);
+    g_assert_false(compute);
+    ctx->found = fsearch_shared_result_wait(result, NULL, &ctx->folders, &ctx->files, NULL);
+    g_clear_pointer(&result, fsearch_shared_result_unref);
+    return NULL;
+}
+
+static void
+test_shared_results_publish(void) {
+    FsearchSharedResults *results = fsearch_shared_results_new();
+    DynamicArray *folders = new_array(10);
+    DynamicArray *files = new_array(20);
+
+    bool compute = false;
+    FsearchSharedResult *result = fsearch_shared_results_attach(results, "foo", &compute);
+    g_assert_true(compute);
+    g_assert_cmpstr(fsearch_shared_result_get_key(result), ==, "foo");
+
+    // others wait for the first one to compute the result
+    WaitContext ctx = {.results = results};
+    GThread *thread = g_thread_new("wait", wait_thread, &ctx);
+    g_usleep(10 * G_TIME_SPAN_MILLISECOND);
+    fsearch_shared_result_publish(result, folders, files, DATABASE_INDEX_TYPE_SIZE);
+    g_thread_join(thread);
+    g_assert_true(ctx.found);
+    g_assert_true(ctx.folders == folders);
+    g_assert_true(ctx.files == files);
+    g_clear_pointer(&ctx.folders, darray_unref);
+    g_clear_pointer(&ctx.files, darray_unref);
+
+    // as long as a reference is held, later callers get the published result right away
+    FsearchSharedResult *other = fsearch_shared_results_attach(results, "foo", &compute);
+    g_assert_false(compute);
+    g_assert_true(other == result);
+    FsearchDatabaseIndexType sort_order = DATABASE_INDEX_TYPE_NAME;
+    g_assert_true(fsearch_shared_result_wait(other, NULL, NULL, NULL, &sort_order));
+    g_assert_cmpint(sort_order, ==, DATABASE_INDEX_TYPE_SIZE);
+    g_clear_pointer(&other, fsearch_shared_result_unref);
+    g_clear_pointer(&result, fsearch_shared_result_unref);
+
+    // without any references it's gone
+    result = fsearch_shared_results_attach(results, "foo", &compute);
+    g_assert_true(compute);
+    g_clear_pointer(&result, fsearch_shared_result_unref);
+
+    g_clear_pointer(&folders, darray_unref);
+    g_clear_pointer(&files, darray_unref);
+    g_clear_pointer(&results, fsearch_shared_results_unref);
+}
+
+static void
+test_shared_results_abandon(void) {
+    FsearchSharedResults *results = fsearch_shared_results_new();
+
+    bool compute = false;
+    FsearchSharedResult *result = fsearch_shared_results_attach(results, "foo", &compute);
+    FsearchSharedResult *waiting = fsearch_shared_results_attach(results, "foo", &compute);
+    g_assert_false(compute);
+
+    // waiting callers give up and the next one computes it again
+    fsearch_shared_result_abandon(result);
+    g_assert_false(fsearch_shared_result_wait(waiting, NULL, NULL, NULL, NULL));
+    FsearchSharedResult *next = fsearch_shared_results_attach(results, "foo", &compute);
+    g_assert_true(compute);
+    g_assert_true(next != result);
+
+    // a cancelled caller stops waiting
+    GCancellable *cancellable = g_cancellable_new();
+    g_cancellable_cancel(cancellable);
+    FsearchSharedResult *cancelled = fsearch_shared_results_attach(results, "foo", &compute);
+    g_assert_false(fsearch_shared_result_wait(cancelled, cancellable, NULL, NULL, NULL));
+    g_clear_object(&cancellable);
+
+    g_clear_pointer(&cancelled, fsearch_shared_result_unref);
+    g_clear_pointer(&next, fsearch_shared_result_unref);
+    g_clear_pointer(&waiting, fsearch_shared_result_unref);
+    g_clear_pointer(&result, fsearch_shared_result_unref);
+    g_clear_pointer(&results, fsearch_shared_results_unref);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/shared_results/publish", test_shared_results_publish);
+    g_test_add_func("/FSearch/shared_results/abandon", test_shared_results_abandon);
+    return g_test_run();
+}
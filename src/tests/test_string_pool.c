@@ -0,0 +1,82 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_string_pool.h>
+
+void
+test_string_pool_add(void) {
+    FsearchStringPool *pool = fsearch_string_pool_new(false);
+
+    const char *a = fsearch_string_pool_add(pool, "Makefile", strlen("Makefile"));
+    const char *b = fsearch_string_pool_add(pool, "Makefile.am", strlen("Makefile"));
+    g_assert_cmpstr(a, ==, "Makefile");
+    g_assert_cmpstr(b, ==, "Makefile");
+    // no interning, so every string gets its own copy
+    g_assert_true(a != b);
+
+    // strings which don't fit into a regular block
+    const size_t long_len = 1024 * 1024;
+    char *long_string = malloc(long_len + 1);
+    memset(long_string, 'x', long_len);
+    long_string[long_len] = '\0';
+    const char *c = fsearch_string_pool_add(pool, long_string, long_len);
+    g_assert_cmpstr(c, ==, long_string);
+    g_clear_pointer(&long_string, free);
+
+    // the strings added before must not be affected by new blocks
+    for (uint32_t i = 0; i < 100000; i++) {
+        fsearch_string_pool_add(pool, "some_file_name.txt", strlen("some_file_name.txt"));
+    }
+    g_assert_cmpstr(a, ==, "Makefile");
+
+    g_clear_pointer(&pool, fsearch_string_pool_unref);
+}
+
+void
+test_string_pool_intern(void) {
+    FsearchStringPool *pool = fsearch_string_pool_new(true);
+
+    const char *a = fsearch_string_pool_add(pool, "index.js", strlen("index.js"));
+    const char *b = fsearch_string_pool_add(pool, "index.js", strlen("index.js"));
+    const char *c = fsearch_string_pool_add(pool, "index.jsx", strlen("index.js"));
+    g_assert_true(a == b);
+    g_assert_true(a == c);
+
+    const char *d = fsearch_string_pool_add(pool, "__init__.py", strlen("__init__.py"));
+    g_assert_true(a != d);
+    g_assert_cmpstr(d, ==, "__init__.py");
+
+    fsearch_string_pool_stop_interning(pool);
+    const char *e = fsearch_string_pool_add(pool, "index.js", strlen("index.js"));
+    g_assert_true(a != e);
+    g_assert_cmpstr(e, ==, "index.js");
+
+    g_clear_pointer(&pool, fsearch_string_pool_unref);
+}
+
+void
+test_string_pool_merge(void) {
+    FsearchStringPool *pool = fsearch_string_pool_new(true);
+    FsearchStringPool *other = fsearch_string_pool_new(true);
+
+    const char *a = fsearch_string_pool_add(pool, "a", 1);
+    const char *b = fsearch_string_pool_add(other, "b", 1);
+    fsearch_string_pool_merge(pool, g_steal_pointer(&other));
+
+    const char *c = fsearch_string_pool_add(pool, "c", 1);
+    g_assert_cmpstr(a, ==, "a");
+    g_assert_cmpstr(b, ==, "b");
+    g_assert_cmpstr(c, ==, "c");
+
+    g_clear_pointer(&pool, fsearch_string_pool_unref);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/string_pool/add", test_string_pool_add);
+    g_test_add_func("/FSearch/string_pool/intern", test_string_pool_intern);
+    g_test_add_func("/FSearch/string_pool/merge", test_string_pool_merge);
+    return g_test_run();
+}
@@ -0,0 +1,64 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_string_search.h>
+
+static const char *
+search(const char *haystack, const char *needle) {
+    return fsearch_string_search_ascii_icase(haystack, strlen(haystack), needle, strlen(needle));
+}
+
+static void
+test_string_search_ascii_icase(void) {
+    const char *haystack = "Some_File-Name.TXT";
+    g_assert_true(search(haystack, "") == haystack);
+    g_assert_true(search(haystack, "s") == haystack);
+    g_assert_true(search(haystack, "file") == haystack + 5);
+    g_assert_true(search(haystack, "FILE-name") == haystack + 5);
+    g_assert_true(search(haystack, ".txt") == haystack + 14);
+    g_assert_true(search(haystack, haystack) == haystack);
+    g_assert_null(search(haystack, "files"));
+    g_assert_null(search(haystack, "Some_File-Name.TXT2"));
+    // only letters are folded
+    g_assert_null(search("some@file", "`"));
+    g_assert_null(search("some[file", "{"));
+    // multibyte characters don't get in the way
+    g_assert_true(search("Ärger.pdf", "ger") != NULL);
+    g_assert_null(search("\xc3\xa4", "\xc3"));
+
+    // the haystack doesn't need to be NUL terminated
+    g_assert_null(fsearch_string_search_ascii_icase("abcdef", 3, "cd", 2));
+}
+
+static void
+test_string_search_ascii_icase_long(void) {
+    // long enough for multiple iterations of the vectorized kernels, including the tails
+    g_autoptr(GString) haystack = g_string_new(NULL);
+    for (uint32_t i = 0; i < 200; i++) {
+        g_string_append_c(haystack, i % 2 ? 'a' : 'B');
+    }
+    for (uint32_t len = 2; len < 80; len++) {
+        char *needle = g_strnfill(len, 'x');
+        needle[0] = 'c';
+        for (uint32_t pos = 0; pos + len <= haystack->len; pos += 7) {
+            g_autoptr(GString) str = g_string_new(haystack->str);
+            memcpy(str->str + pos, needle, len);
+            str->str[pos] = 'C';
+            str->str[pos + len - 1] = 'X';
+            g_assert_true(search(str->str, needle) == str->str + pos);
+            // the last byte doesn't match
+            str->str[pos + len - 1] = 'y';
+            g_assert_null(search(str->str, needle));
+        }
+        g_clear_pointer(&needle, g_free);
+    }
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/string_search/ascii_icase", test_string_search_ascii_icase);
+    g_test_add_func("/FSearch/string_search/ascii_icase_long", test_string_search_ascii_icase_long);
+    return g_test_run();
+}
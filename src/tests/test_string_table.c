@@ -0,0 +1,105 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <src/fsearch_string_table.h>
+
+static void
+test_string_table_dedup(void) {
+    FsearchStringTable *table = fsearch_string_table_new();
+    g_assert_cmpuint(fsearch_string_table_get_num_strings(table), ==, 0);
+
+    const uint32_t id_1 = fsearch_string_table_add(table, "first", 5);
+    const uint32_t id_2 = fsearch_string_table_add(table, "second", 6);
+    g_assert_cmpuint(id_1, !=, FSEARCH_STRING_TABLE_NO_ID);
+    g_assert_cmpuint(id_2, !=, FSEARCH_STRING_TABLE_NO_ID);
+    g_assert_cmpuint(id_1, !=, id_2);
+    g_assert_cmpuint(fsearch_string_table_add(table, "first", 5), ==, id_1);
+    // only the given bytes are part of the string
+    g_assert_cmpuint(fsearch_string_table_add(table, "second line", 6), ==, id_2);
+    g_assert_cmpuint(fsearch_string_table_get_num_strings(table), ==, 2);
+
+    size_t len = 0;
+    const char *str = fsearch_string_table_get(table, id_2, &len);
+    g_assert_cmpuint(len, ==, 6);
+    g_assert_cmpstr(str, ==, "second");
+    g_assert_null(fsearch_string_table_get(table, FSEARCH_STRING_TABLE_NO_ID, &len));
+    g_assert_null(fsearch_string_table_get(table, id_2 + 1, &len));
+
+    g_clear_pointer(&table, fsearch_string_table_free);
+}
+
+static void
+test_string_table_binary(void) {
+    FsearchStringTable *table = fsearch_string_table_new();
+
+    const uint32_t id_1 = fsearch_string_table_add(table, "a\0b\0", 4);
+    const uint32_t id_2 = fsearch_string_table_add(table, "a\0c\0", 4);
+    const uint32_t id_3 = fsearch_string_table_add(table, "a", 1);
+    g_assert_cmpuint(id_1, !=, id_2);
+    g_assert_cmpuint(id_1, !=, id_3);
+    g_assert_cmpuint(fsearch_string_table_add(table, "a\0b\0", 4), ==, id_1);
+
+    size_t len = 0;
+    const char *str = fsearch_string_table_get(table, id_1, &len);
+    g_assert_cmpuint(len, ==, 4);
+    g_assert_cmpmem(str, len, "a\0b\0", 4);
+
+    // empty strings are strings too
+    const uint32_t id_empty = fsearch_string_table_add(table, "", 0);
+    g_assert_cmpuint(id_empty, !=, FSEARCH_STRING_TABLE_NO_ID);
+    g_assert_cmpstr(fsearch_string_table_get(table, id_empty, &len), ==, "");
+    g_assert_cmpuint(len, ==, 0);
+
+    g_clear_pointer(&table, fsearch_string_table_free);
+}
+
+typedef struct {
+    FsearchStringTable *table;
+    uint32_t ids[1000];
+} TestStringTableThread;
+
+static gpointer
+string_table_thread(gpointer user_data) {
+    TestStringTableThread *ctx = user_data;
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ctx->ids); i++) {
+        char str[16] = "";
+        const int len = g_snprintf(str, sizeof(str), "%u", i);
+        ctx->ids[i] = fsearch_string_table_add(ctx->table, str, len);
+    }
+    return NULL;
+}
+
+static void
+test_string_table_threads(void) {
+    FsearchStringTable *table = fsearch_string_table_new();
+    TestStringTableThread ctx[4] = {};
+    GThread *threads[G_N_ELEMENTS(ctx)] = {};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ctx); i++) {
+        ctx[i].table = table;
+        threads[i] = g_thread_new("string_table", string_table_thread, &ctx[i]);
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ctx); i++) {
+        g_thread_join(threads[i]);
+    }
+
+    g_assert_cmpuint(fsearch_string_table_get_num_strings(table), ==, G_N_ELEMENTS(ctx[0].ids));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ctx[0].ids); i++) {
+        for (uint32_t j = 1; j < G_N_ELEMENTS(ctx); j++) {
+            g_assert_cmpuint(ctx[j].ids[i], ==, ctx[0].ids[i]);
+        }
+        char str[16] = "";
+        g_snprintf(str, sizeof(str), "%u", i);
+        g_assert_cmpstr(fsearch_string_table_get(table, ctx[0].ids[i], NULL), ==, str);
+    }
+    g_clear_pointer(&table, fsearch_string_table_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/string_table/dedup", test_string_table_dedup);
+    g_test_add_func("/FSearch/string_table/binary", test_string_table_binary);
+    g_test_add_func("/FSearch/string_table/threads", test_string_table_threads);
+    return g_test_run();
+}
@@ -1,6 +1,7 @@
 #include <glib.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <src/fsearch_string_utils.h>
 
@@ -234,6 +235,39 @@ test_str_starts_with_interval(void) {
     }
 }
 
+void
+test_str_version_sort_key(void) {
+    const char *strings[] = {
+        "",           "a",        "abc",        "abcdefghijkl", "abcdefghijkm", "item#99",   "item#100",
+        "alpha1",     "alpha001", "part1_f012", "part1_f01",    "foo.009",      "foo.0",     "1",
+        "9",          "10",       "010",        "0",            "00",           "IMG_0001",  "IMG_1234",
+        "IMG_999",    "1a",       "12",         "12b",          "123",          "a1b2c3",    "a1b2c4",
+        "Zebra",      "zebra",    "_",          "~",            "v2.10.1",      "v2.9.11",   "v10",
+        "2023-01-02", "2023-1-3", "20230102",   "\xc3\xa4",   "a 1",          "a1",        "a\xff" "1",
+    };
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(strings); ++i) {
+        const uint64_t key_a = fsearch_string_get_version_sort_key(strings[i]);
+        for (uint32_t j = 0; j < G_N_ELEMENTS(strings); ++j) {
+            const uint64_t key_b = fsearch_string_get_version_sort_key(strings[j]);
+            const int res = strverscmp(strings[i], strings[j]);
+            if (res == 0) {
+                g_assert_true(key_a == key_b);
+            }
+            else if (key_a != key_b) {
+                if ((key_a < key_b) != (res < 0)) {
+                    g_print("Sort keys of '%s' and '%s' don't match strverscmp!\n", strings[i], strings[j]);
+                }
+                g_assert_true((key_a < key_b) == (res < 0));
+            }
+        }
+    }
+
+    // numbers are ordered by their value
+    g_assert_true(fsearch_string_get_version_sort_key("item#99") < fsearch_string_get_version_sort_key("item#100"));
+    g_assert_true(fsearch_string_get_version_sort_key("9") < fsearch_string_get_version_sort_key("10"));
+}
+
 int
 main(int argc, char *argv[]) {
     g_test_init(&argc, &argv, NULL);
@@ -244,5 +278,6 @@ main(int argc, char *argv[]) {
     g_test_add_func("/FSearch/string_utils/is_ascii_icase", test_str_icase_is_ascii);
     g_test_add_func("/FSearch/string_utils/convert_wildcard_to_regex", test_str_wildcard_to_regex);
     g_test_add_func("/FSearch/string_utils/starts_with_interval", test_str_starts_with_interval);
+    g_test_add_func("/FSearch/string_utils/version_sort_key", test_str_version_sort_key);
     return g_test_run();
 }
@@ -0,0 +1,187 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_subtree_filter.h>
+
+#include "test_tree.h"
+
+static const TestFolder folders[] = {
+    {-1, ""},
+    {0, "home"},
+    {1, "user"},
+    {2, "projects"},
+    {3, "fsearch"},
+    {4, "src"},
+    {2, "Music"},
+    {6, "Jazz"},
+    {0, "usr"},
+    {8, "include"},
+    {9, "glib-2.0"},
+    {0, "tmp"},
+};
+
+// every file is given as the position of its folder and its name
+static const struct {
+    int32_t parent;
+    const char *name;
+} files[] = {
+    {5, "fsearch_database.c"},
+    {5, "fsearch_subtree_filter.c"},
+    {4, "meson.build"},
+    {4, "README.md"},
+    {7, "Take Five.flac"},
+    {7, "So What.flac"},
+    {10, "glib.h"},
+    {10, "gio.h"},
+    {11, "build.log"},
+    {0, "swapfile"},
+};
+
+typedef struct {
+    FsearchMemoryPool *folder_pool;
+    FsearchMemoryPool *file_pool;
+    DynamicArray *folders;
+    DynamicArray *files;
+} SubtreeFilterFixture;
+
+static void
+fixture_init(SubtreeFilterFixture *fixture) {
+    fixture->folder_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    fixture->file_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    fixture->folders = darray_new(G_N_ELEMENTS(folders));
+    fixture->files = darray_new(G_N_ELEMENTS(files));
+    test_tree_add_folders(fixture->folders, fixture->folder_pool, folders, G_N_ELEMENTS(folders), 0);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(files); i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(fixture->file_pool);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+        db_entry_set_name(entry, files[i].name);
+        db_entry_set_parent(entry, darray_get_item(fixture->folders, files[i].parent));
+        darray_add_item(fixture->files, entry);
+    }
+    darray_sort(fixture->folders, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path, NULL, NULL);
+    darray_sort(fixture->files, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_path, NULL, NULL);
+}
+
+static void
+fixture_clear(SubtreeFilterFixture *fixture) {
+    g_clear_pointer(&fixture->files, darray_unref);
+    g_clear_pointer(&fixture->folders, darray_unref);
+    g_clear_pointer(&fixture->file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&fixture->folder_pool, fsearch_memory_pool_free_pool);
+}
+
+static FsearchDatabaseEntry *
+find_folder(SubtreeFilterFixture *fixture, const char *name) {
+    for (uint32_t i = 0; i < darray_get_num_items(fixture->folders); i++) {
+        FsearchDatabaseEntry *folder = darray_get_item(fixture->folders, i);
+        if (!strcmp(db_entry_get_name_raw(folder), name)) {
+            return folder;
+        }
+    }
+    g_assert_not_reached();
+}
+
+static bool
+contains_ascii_icase(const char *name, const char *needle) {
+    const size_t needle_len = strlen(needle);
+    for (const char *s = name; *s != '\0'; s++) {
+        if (!g_ascii_strncasecmp(s, needle, needle_len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Every entry which contains needle must be a candidate, returns the number of candidates
+static uint32_t
+check_lookup(FsearchSubtreeFilter *filter, FsearchDatabaseEntryType type, const char *needle) {
+    DynamicArray *entries = fsearch_subtree_filter_get_entries(filter, type);
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    g_assert_true(fsearch_subtree_filter_lookup(filter, type, needle, strlen(needle), &positions, &num_positions));
+    g_assert_true((positions == NULL) == (num_positions == 0));
+
+    for (uint32_t i = 1; i < num_positions; i++) {
+        g_assert_cmpuint(positions[i - 1], <, positions[i]);
+    }
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < darray_get_num_items(entries); i++) {
+        if (!contains_ascii_icase(db_entry_get_name_raw(darray_get_item(entries, i)), needle)) {
+            continue;
+        }
+        while (j < num_positions && positions[j] < i) {
+            j++;
+        }
+        g_assert_cmpuint(j, <, num_positions);
+        g_assert_cmpuint(positions[j], ==, i);
+    }
+    g_clear_pointer(&positions, free);
+    return num_positions;
+}
+
+static void
+test_subtree_filter_lookup(void) {
+    SubtreeFilterFixture fixture = {};
+    fixture_init(&fixture);
+    FsearchSubtreeFilter *filter = fsearch_subtree_filter_new(fixture.folders, fixture.files);
+    g_assert_nonnull(filter);
+    g_assert_true(fsearch_subtree_filter_get_entries(filter, DATABASE_ENTRY_TYPE_FOLDER) == fixture.folders);
+    g_assert_true(fsearch_subtree_filter_get_entries(filter, DATABASE_ENTRY_TYPE_FILE) == fixture.files);
+    g_assert_cmpuint(fsearch_subtree_filter_get_memory_usage(filter), >, 0);
+
+    const char *needles[] = {"fsearch", "FSEARCH", ".flac", "jazz", "glib", "o.h", "build", "use", "swap", "nothing"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(needles); i++) {
+        check_lookup(filter, DATABASE_ENTRY_TYPE_FOLDER, needles[i]);
+        check_lookup(filter, DATABASE_ENTRY_TYPE_FILE, needles[i]);
+    }
+    // the other subtrees get skipped
+    g_assert_cmpuint(check_lookup(filter, DATABASE_ENTRY_TYPE_FILE, "flac"), <, G_N_ELEMENTS(files));
+    g_assert_cmpuint(check_lookup(filter, DATABASE_ENTRY_TYPE_FOLDER, "Jazz"), <, G_N_ELEMENTS(folders));
+
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    g_assert_false(fsearch_subtree_filter_lookup(filter, DATABASE_ENTRY_TYPE_FILE, "gi", 2, &positions, &num_positions));
+
+    g_clear_pointer(&filter, fsearch_subtree_filter_unref);
+    fixture_clear(&fixture);
+}
+
+static void
+test_subtree_filter_unordered(void) {
+    SubtreeFilterFixture fixture = {};
+    fixture_init(&fixture);
+
+    // the files aren't grouped by their folders anymore
+    DynamicArray *reversed_files = darray_new(G_N_ELEMENTS(files));
+    for (uint32_t i = darray_get_num_items(fixture.files); i > 0; i--) {
+        darray_add_item(reversed_files, darray_get_item(fixture.files, i - 1));
+    }
+    g_assert_null(fsearch_subtree_filter_new(fixture.folders, reversed_files));
+    g_clear_pointer(&reversed_files, darray_unref);
+
+    // the folders right in the root aren't next to each other
+    DynamicArray *unordered_folders = darray_new(4);
+    darray_add_item(unordered_folders, find_folder(&fixture, ""));
+    darray_add_item(unordered_folders, find_folder(&fixture, "home"));
+    darray_add_item(unordered_folders, find_folder(&fixture, "user"));
+    darray_add_item(unordered_folders, find_folder(&fixture, "tmp"));
+    DynamicArray *no_files = darray_new(0);
+    g_assert_null(fsearch_subtree_filter_new(unordered_folders, no_files));
+    g_clear_pointer(&no_files, darray_unref);
+    g_clear_pointer(&unordered_folders, darray_unref);
+
+    fixture_clear(&fixture);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/subtree_filter/lookup", test_subtree_filter_lookup);
+    g_test_add_func("/FSearch/subtree_filter/unordered", test_subtree_filter_unordered);
+    return g_test_run();
+}
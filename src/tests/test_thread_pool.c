@@ -0,0 +1,223 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <src/fsearch_thread_pool.h>
+
+#define NUM_ITEMS 100000
+
+typedef struct {
+    FsearchThreadPool *pool;
+    uint32_t value;
+    uint32_t result;
+} FibContext;
+
+// every task pushes the two smaller numbers as new tasks and waits for them
+static void
+fib_task(void *data) {
+    FibContext *ctx = data;
+    if (ctx->value < 2) {
+        ctx->result = ctx->value;
+        return;
+    }
+    FibContext children[2] = {
+        {.pool = ctx->pool, .value = ctx->value - 1},
+        {.pool = ctx->pool, .value = ctx->value - 2},
+    };
+    FsearchThreadPoolGroup *group = fsearch_thread_pool_group_new(ctx->pool);
+    fsearch_thread_pool_group_push(group, fib_task, &children[0]);
+    fsearch_thread_pool_group_push(group, fib_task, &children[1]);
+    fsearch_thread_pool_group_wait(group);
+    g_clear_pointer(&group, fsearch_thread_pool_group_free);
+    ctx->result = children[0].result + children[1].result;
+}
+
+static void
+test_thread_pool_nested(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+    FibContext ctx = {.pool = pool, .value = 18};
+    FsearchThreadPoolGroup *group = fsearch_thread_pool_group_new(pool);
+    fsearch_thread_pool_group_push(group, fib_task, &ctx);
+    fsearch_thread_pool_group_wait(group);
+    g_assert_cmpuint(ctx.result, ==, 2584);
+    g_clear_pointer(&group, fsearch_thread_pool_group_free);
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+typedef struct {
+    FsearchThreadPool *pool;
+    volatile gint *counts;
+    volatile gint num_ranges;
+    uint32_t grain_size;
+} RangeContext;
+
+static void
+count_range(uint32_t start, uint32_t end, void *data) {
+    RangeContext *ctx = data;
+    g_assert_cmpuint(start, <, end);
+    g_assert_cmpuint(end - start, <=, ctx->grain_size);
+    if (ctx->pool) {
+        const int32_t thread_idx = fsearch_thread_pool_get_thread_index(ctx->pool);
+        g_assert_cmpint(thread_idx, >=, 0);
+        g_assert_cmpint(thread_idx, <, fsearch_thread_pool_get_num_threads(ctx->pool));
+    }
+    for (uint32_t i = start; i < end; i++) {
+        g_atomic_int_inc(&ctx->counts[i]);
+    }
+    g_atomic_int_inc(&ctx->num_ranges);
+}
+
+static void
+test_thread_pool_parallel_for(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_init();
+    const uint32_t grain_sizes[] = {1, 1000, NUM_ITEMS};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(grain_sizes); i++) {
+        g_autofree volatile gint *counts = calloc(NUM_ITEMS, sizeof(gint));
+        RangeContext ctx = {.pool = grain_sizes[i] < NUM_ITEMS ? pool : NULL, .counts = counts};
+        ctx.grain_size = grain_sizes[i];
+        fsearch_thread_pool_parallel_for(ctx.pool, 0, NUM_ITEMS, grain_sizes[i], count_range, &ctx);
+        // every item is part of exactly one range
+        for (uint32_t j = 0; j < NUM_ITEMS; j++) {
+            g_assert_cmpint(counts[j], ==, 1);
+        }
+        g_assert_cmpint(ctx.num_ranges, >=, NUM_ITEMS / grain_sizes[i]);
+    }
+
+    RangeContext ctx = {.pool = pool, .counts = NULL, .grain_size = 1};
+    fsearch_thread_pool_parallel_for(pool, 10, 10, 1, count_range, &ctx);
+    g_assert_cmpint(ctx.num_ranges, ==, 0);
+
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+typedef struct {
+    uint32_t value;
+    uint32_t result;
+} RunContext;
+
+static void
+square_task(void *data) {
+    RunContext *ctx = data;
+    ctx->result = ctx->value * ctx->value;
+}
+
+static void
+test_thread_pool_run(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_new(3);
+    g_assert_cmpuint(fsearch_thread_pool_get_num_threads(pool), ==, 3);
+    // the caller isn't one of the threads
+    g_assert_cmpint(fsearch_thread_pool_get_thread_index(pool), ==, -1);
+
+    RunContext contexts[100] = {};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(contexts); i++) {
+        contexts[i].value = i;
+    }
+    fsearch_thread_pool_run(pool, square_task, contexts, sizeof(RunContext), G_N_ELEMENTS(contexts));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(contexts); i++) {
+        g_assert_cmpuint(contexts[i].result, ==, i * i);
+    }
+
+    // waiting for a group without tasks returns right away
+    FsearchThreadPoolGroup *group = fsearch_thread_pool_group_new(pool);
+    fsearch_thread_pool_group_wait(group);
+    g_clear_pointer(&group, fsearch_thread_pool_group_free);
+
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+G_DEFINE_QUARK(test-thread-pool-local-data, test_local_data)
+
+static void
+test_thread_pool_local_data(void) {
+    FsearchThreadPool *pool = fsearch_thread_pool_new(2);
+    g_assert_null(fsearch_thread_pool_get_local_data(pool, 0, test_local_data_quark()));
+
+    fsearch_thread_pool_set_local_data(pool, 1, test_local_data_quark(), g_strdup("data"), g_free);
+    g_assert_null(fsearch_thread_pool_get_local_data(pool, 0, test_local_data_quark()));
+    g_assert_cmpstr(fsearch_thread_pool_get_local_data(pool, 1, test_local_data_quark()), ==, "data");
+    // unknown threads are ignored
+    fsearch_thread_pool_set_local_data(pool, 2, test_local_data_quark(), "other", NULL);
+    g_assert_null(fsearch_thread_pool_get_local_data(pool, 2, test_local_data_quark()));
+
+    g_clear_pointer(&pool, fsearch_thread_pool_free);
+}
+
+static void
+test_thread_pool_parse_cpu_list(void) {
+    uint32_t num_cpus = 0;
+    g_autofree uint32_t *cpus = fsearch_thread_pool_parse_cpu_list("8, 0-3,2", &num_cpus);
+    const uint32_t expected[] = {0, 1, 2, 3, 8};
+    g_assert_cmpuint(num_cpus, ==, G_N_ELEMENTS(expected));
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        g_assert_cmpuint(cpus[i], ==, expected[i]);
+    }
+
+    const char *invalid[] = {"", "a", "1,", "3-1", "1-", "-1", "1-2-3", "0-100000"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+        g_assert_null(fsearch_thread_pool_parse_cpu_list(invalid[i], &num_cpus));
+        g_assert_cmpuint(num_cpus, ==, 0);
+    }
+}
+
+typedef struct {
+    FsearchThreadPoolRanges *ranges;
+    volatile gint *counts;
+} RangesContext;
+
+static void
+count_items(void *data) {
+    RangesContext *ctx = data;
+    uint32_t item = 0;
+    while (fsearch_thread_pool_ranges_next(ctx->ranges, &item)) {
+        g_atomic_int_inc(&ctx->counts[item]);
+    }
+}
+
+static void
+test_thread_pool_ranges(void) {
+    const uint32_t part_sizes[] = {1000, 0, 5, NUM_ITEMS};
+    const uint32_t num_items = 1005 + NUM_ITEMS;
+
+    // without NUMA the parts are handed out in order
+    FsearchThreadPoolRanges *ranges = fsearch_thread_pool_ranges_new(NULL, part_sizes, G_N_ELEMENTS(part_sizes));
+    uint32_t item = 0;
+    for (uint32_t i = 0; i < num_items; i++) {
+        g_assert_true(fsearch_thread_pool_ranges_next(ranges, &item));
+        g_assert_cmpuint(item, ==, i);
+    }
+    g_assert_false(fsearch_thread_pool_ranges_next(ranges, &item));
+    g_clear_pointer(&ranges, fsearch_thread_pool_ranges_free);
+
+    FsearchThreadPool *pools[] = {
+        fsearch_thread_pool_new(4),
+        fsearch_thread_pool_new_with_affinity(4, NULL, true),
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(pools); i++) {
+        g_assert_cmpuint(fsearch_thread_pool_get_num_threads(pools[i]), ==, 4);
+        g_autofree volatile gint *counts = calloc(num_items, sizeof(gint));
+        RangesContext contexts[3];
+        ranges = fsearch_thread_pool_ranges_new(pools[i], part_sizes, G_N_ELEMENTS(part_sizes));
+        for (uint32_t j = 0; j < G_N_ELEMENTS(contexts); j++) {
+            contexts[j] = (RangesContext){.ranges = ranges, .counts = counts};
+        }
+        // there are fewer tasks than threads, so some ranges have to be taken over by other threads
+        fsearch_thread_pool_run(pools[i], count_items, contexts, sizeof(RangesContext), G_N_ELEMENTS(contexts));
+        for (uint32_t j = 0; j < num_items; j++) {
+            g_assert_cmpint(counts[j], ==, 1);
+        }
+        g_clear_pointer(&ranges, fsearch_thread_pool_ranges_free);
+        g_clear_pointer(&pools[i], fsearch_thread_pool_free);
+    }
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/thread_pool/run", test_thread_pool_run);
+    g_test_add_func("/FSearch/thread_pool/parallel_for", test_thread_pool_parallel_for);
+    g_test_add_func("/FSearch/thread_pool/nested", test_thread_pool_nested);
+    g_test_add_func("/FSearch/thread_pool/local_data", test_thread_pool_local_data);
+    g_test_add_func("/FSearch/thread_pool/parse_cpu_list", test_thread_pool_parse_cpu_list);
+    g_test_add_func("/FSearch/thread_pool/ranges", test_thread_pool_ranges);
+    return g_test_run();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+#include <src/fsearch_array.h>
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+
+// Helpers for the tests which need a tree of folders and files
+
+// A folder is given as the position of its parent (-1 for roots) and its name
+typedef struct {
+    int32_t parent;
+    const char *name;
+} TestFolder;
+
+typedef struct {
+    FsearchMemoryPool *folder_pool;
+    FsearchMemoryPool *file_pool;
+    // the root "", "home" and "home/my docs"
+    DynamicArray *folders;
+    FsearchDatabaseEntry *root;
+    FsearchDatabaseEntry *docs;
+} TestTree;
+
+// Adds the folders to array, allocated from pool. Parents don't have to come before their children. The idx of
+// every folder is its position in folders, index_flags are the optional values it stores (0 for none).
+static inline void
+test_tree_add_folders(DynamicArray *array,
+                      FsearchMemoryPool *pool,
+                      const TestFolder *folders,
+                      uint32_t num_folders,
+                      FsearchDatabaseIndexFlags index_flags) {
+    const uint32_t offset = darray_get_num_items(array);
+    for (uint32_t i = 0; i < num_folders; i++) {
+        FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(pool);
+        db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FOLDER);
+        if (index_flags) {
+            db_entry_init_optional_values(entry, index_flags);
+        }
+        db_entry_set_name(entry, folders[i].name);
+        db_entry_set_idx(entry, i);
+        darray_add_item(array, entry);
+    }
+    for (uint32_t i = 0; i < num_folders; i++) {
+        if (folders[i].parent >= 0) {
+            FsearchDatabaseEntry *parent = darray_get_item(array, offset + folders[i].parent);
+            db_entry_set_parent(darray_get_item(array, offset + i), (FsearchDatabaseEntryFolder *)parent);
+        }
+    }
+}
+
+static inline FsearchDatabaseEntry *
+test_tree_add_file(TestTree *tree, const char *name, FsearchDatabaseEntry *parent) {
+    FsearchDatabaseEntry *entry = fsearch_memory_pool_malloc(tree->file_pool);
+    db_entry_set_type(entry, DATABASE_ENTRY_TYPE_FILE);
+    db_entry_set_name(entry, name);
+    db_entry_set_parent(entry, (FsearchDatabaseEntryFolder *)parent);
+    return entry;
+}
+
+static inline void
+test_tree_init(TestTree *tree) {
+    static const TestFolder folders[] = {
+        {-1, ""},
+        {0, "home"},
+        {1, "my docs"},
+    };
+    tree->folder_pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_folder_entry(), (GDestroyNotify)db_entry_destroy);
+    tree->file_pool =
+        fsearch_memory_pool_new(1000, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    tree->folders = darray_new(G_N_ELEMENTS(folders));
+    test_tree_add_folders(tree->folders, tree->folder_pool, folders, G_N_ELEMENTS(folders), 0);
+    tree->root = darray_get_item(tree->folders, 0);
+    tree->docs = darray_get_item(tree->folders, 2);
+}
+
+static inline void
+test_tree_clear(TestTree *tree) {
+    g_clear_pointer(&tree->folders, darray_unref);
+    g_clear_pointer(&tree->file_pool, fsearch_memory_pool_free_pool);
+    g_clear_pointer(&tree->folder_pool, fsearch_memory_pool_free_pool);
+    tree->root = NULL;
+    tree->docs = NULL;
+}
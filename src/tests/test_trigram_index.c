@@ -0,0 +1,150 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_trigram_index.h>
+
+#include "test_entries.h"
+
+static const char *names[] = {
+    "Makefile", "README.md", "main.c",      "main.h",     "Documents", "holiday.JPG", "photo_001.jpg", "notes.txt",
+    "a",        "ab",        "config.json", "MAIN.o",     "mainline",  "Ärger.pdf",   "ärger.pdf",     "remain.c",
+    "xyz",      "XYZ.tar",   "tax_2021",    "tax_2022.ods",
+};
+
+static bool
+contains_ascii_icase(const char *name, const char *needle) {
+    const size_t needle_len = strlen(needle);
+    for (const char *s = name; *s != '\0'; s++) {
+        if (!g_ascii_strncasecmp(s, needle, needle_len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Every entry which contains needle must be a candidate
+static void
+check_lookup(FsearchTrigramIndex *index, DynamicArray *entries, const char *needle) {
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    g_assert_true(fsearch_trigram_index_lookup(index, needle, strlen(needle), &positions, &num_positions));
+    test_entries_check_candidates(entries, positions, num_positions, contains_ascii_icase, needle);
+    g_clear_pointer(&positions, free);
+}
+
+static const char *needles[] = {
+    "main", "MAIN", "e.c", "jpg", "tax_202", "ärger", "rger.pdf", "xyz", "not_there", "ile",
+};
+
+static void
+test_trigram_index_lookup(void) {
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = test_entries_new(pool, names, G_N_ELEMENTS(names));
+    FsearchTrigramIndex *index = fsearch_trigram_index_new(entries, NULL);
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(needles); i++) {
+        check_lookup(index, entries, needles[i]);
+    }
+
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    // too short to narrow anything down
+    g_assert_false(fsearch_trigram_index_lookup(index, "ma", 2, &positions, &num_positions));
+
+    g_assert_true(fsearch_trigram_index_lookup(index, "tax_2022", 8, &positions, &num_positions));
+    g_assert_cmpuint(num_positions, ==, 1);
+    g_assert_cmpuint(positions[0], ==, 19);
+    g_clear_pointer(&positions, free);
+
+    g_clear_pointer(&index, fsearch_trigram_index_unref);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_trigram_index_updated(void) {
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = test_entries_new(pool, names, G_N_ELEMENTS(names));
+    FsearchTrigramIndex *index = fsearch_trigram_index_new(entries, NULL);
+
+    // remove every third entry and add new ones in between
+    const char *added_names[] = {"domain.c", "maintenance", "tax_2023.ods"};
+    DynamicArray *added = test_entries_new(pool, added_names, G_N_ELEMENTS(added_names));
+    DynamicArray *updated = test_entries_new_updated(entries, added);
+
+    FsearchTrigramIndex *updated_index = fsearch_trigram_index_new_updated(index, updated, added, NULL);
+    g_assert_true(fsearch_trigram_index_get_entries(updated_index) == updated);
+    g_assert_false(fsearch_trigram_index_is_built_for(updated_index, updated));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(needles); i++) {
+        check_lookup(updated_index, updated, needles[i]);
+    }
+    check_lookup(updated_index, updated, "tax_2023");
+
+    // removed entries are no candidates anymore
+    uint32_t *positions = NULL;
+    uint32_t num_positions = 0;
+    g_assert_true(fsearch_trigram_index_lookup(updated_index, "Makefile", 8, &positions, &num_positions));
+    g_assert_cmpuint(num_positions, ==, 0);
+    g_assert_null(positions);
+
+    g_clear_pointer(&updated_index, fsearch_trigram_index_unref);
+    g_clear_pointer(&index, fsearch_trigram_index_unref);
+    g_clear_pointer(&updated, darray_unref);
+    g_clear_pointer(&added, darray_unref);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+static void
+test_trigram_index_write(void) {
+    FsearchMemoryPool *pool =
+        fsearch_memory_pool_new(100, db_entry_get_sizeof_file_entry(), (GDestroyNotify)db_entry_destroy);
+    DynamicArray *entries = test_entries_new(pool, names, G_N_ELEMENTS(names));
+    FsearchTrigramIndex *index = fsearch_trigram_index_new(entries, NULL);
+    g_assert_true(fsearch_trigram_index_is_built_for(index, entries));
+
+    FILE *fp = tmpfile();
+    g_assert_nonnull(fp);
+    bool write_failed = false;
+    const size_t size = fsearch_trigram_index_write(index, fp, &write_failed);
+    g_assert_false(write_failed);
+    g_assert_cmpuint(size, ==, fsearch_trigram_index_get_write_size(index));
+
+    g_autofree uint8_t *data = malloc(size);
+    rewind(fp);
+    g_assert_cmpuint(fread(data, 1, size, fp), ==, size);
+    g_clear_pointer(&fp, fclose);
+
+    size_t bytes_read = 0;
+    FsearchTrigramIndex *loaded = fsearch_trigram_index_new_from_data(entries, data, size, &bytes_read);
+    g_assert_nonnull(loaded);
+    g_assert_cmpuint(bytes_read, ==, size);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(needles); i++) {
+        check_lookup(loaded, entries, needles[i]);
+    }
+    g_clear_pointer(&loaded, fsearch_trigram_index_unref);
+
+    // truncated data and data for other entries get rejected
+    g_assert_null(fsearch_trigram_index_new_from_data(entries, data, size - 1, &bytes_read));
+    DynamicArray *other_entries = test_entries_new(pool, names, 3);
+    g_assert_null(fsearch_trigram_index_new_from_data(other_entries, data, size, &bytes_read));
+
+    g_clear_pointer(&other_entries, darray_unref);
+    g_clear_pointer(&index, fsearch_trigram_index_unref);
+    g_clear_pointer(&entries, darray_unref);
+    g_clear_pointer(&pool, fsearch_memory_pool_free_pool);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/trigram_index/lookup", test_trigram_index_lookup);
+    g_test_add_func("/FSearch/trigram_index/updated", test_trigram_index_updated);
+    g_test_add_func("/FSearch/trigram_index/write", test_trigram_index_write);
+    return g_test_run();
+}
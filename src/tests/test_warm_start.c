@@ -0,0 +1,174 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <src/fsearch_database_entry.h>
+#include <src/fsearch_memory_pool.h>
+#include <src/fsearch_warm_start.h>
+
+#include "test_tree.h"
+
+#define NUM_FILES 100
+
+typedef struct {
+    TestTree tree;
+    DynamicArray *files;
+    char *dir;
+    char *path;
+} WarmStartFixture;
+
+static void
+fixture_init(WarmStartFixture *fixture) {
+    test_tree_init(&fixture->tree);
+    fixture->files = darray_new(NUM_FILES);
+    for (uint32_t i = 0; i < NUM_FILES; i++) {
+        char name[32] = "";
+        snprintf(name, sizeof(name), "file %03u.txt", i);
+        // some of them right in the root folder
+        FsearchDatabaseEntry *file =
+            test_tree_add_file(&fixture->tree, name, i % 10 == 0 ? fixture->tree.root : fixture->tree.docs);
+        db_entry_set_size(file, (off_t)i * 1000);
+        db_entry_set_mtime(file, (time_t)1600000000 + i);
+        darray_add_item(fixture->files, file);
+    }
+
+    fixture->dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+    fixture->path = g_build_filename(fixture->dir, "warm_start", NULL);
+}
+
+static void
+fixture_clear(WarmStartFixture *fixture) {
+    g_unlink(fixture->path);
+    g_rmdir(fixture->dir);
+    g_clear_pointer(&fixture->path, g_free);
+    g_clear_pointer(&fixture->dir, g_free);
+    g_clear_pointer(&fixture->files, darray_unref);
+    test_tree_clear(&fixture->tree);
+}
+
+static FsearchDatabaseEntry *
+get_row(DynamicArray *folders, DynamicArray *files, uint32_t row) {
+    const uint32_t num_folders = darray_get_num_items(folders);
+    return row < num_folders ? darray_get_item(folders, row) : darray_get_item(files, row - num_folders);
+}
+
+static void
+assert_entries_equal(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *expected) {
+    g_assert_cmpint(db_entry_get_type(entry), ==, db_entry_get_type(expected));
+    g_assert_cmpstr(db_entry_get_name_raw(entry), ==, db_entry_get_name_raw(expected));
+    g_assert_cmpint(db_entry_get_size(entry), ==, db_entry_get_size(expected));
+    g_assert_cmpint(db_entry_get_mtime(entry), ==, db_entry_get_mtime(expected));
+
+    g_autoptr(GString) path = db_entry_get_path(entry);
+    g_autoptr(GString) expected_path = db_entry_get_path(expected);
+    g_assert_cmpstr(path->str, ==, expected_path->str);
+    g_autoptr(GString) full_path = db_entry_get_path_full(entry);
+    g_autoptr(GString) expected_full_path = db_entry_get_path_full(expected);
+    g_assert_cmpstr(full_path->str, ==, expected_full_path->str);
+}
+
+static void
+assert_rows(WarmStartFixture *fixture, FsearchWarmStart *warm_start, uint32_t first_row, uint32_t num_rows) {
+    g_autoptr(DynamicArray) folders = fsearch_warm_start_get_folders(warm_start);
+    g_autoptr(DynamicArray) files = fsearch_warm_start_get_files(warm_start);
+    g_assert_cmpuint(darray_get_num_items(folders) + darray_get_num_items(files), ==, num_rows);
+    for (uint32_t i = 0; i < num_rows; i++) {
+        assert_entries_equal(get_row(folders, files, i), get_row(fixture->tree.folders, fixture->files, first_row + i));
+    }
+}
+
+static void
+test_warm_start_save_load(void) {
+    WarmStartFixture fixture = {};
+    fixture_init(&fixture);
+
+    // the first rows (all folders and some files) and the last ones (only files)
+    const struct {
+        uint32_t first_row;
+        uint32_t max_rows;
+        uint32_t num_rows;
+    } ranges[] = {
+        {0, 20, 20},
+        {NUM_FILES + 3 - 20, 20, 20},
+        {0, 1000, NUM_FILES + 3},
+        {NUM_FILES + 3, 10, 0},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(ranges); i++) {
+        g_assert_true(fsearch_warm_start_save(fixture.path,
+                                              "my query",
+                                              "Documents",
+                                              QUERY_FLAG_MATCH_CASE,
+                                              DATABASE_INDEX_TYPE_SIZE,
+                                              false,
+                                              fixture.tree.folders,
+                                              fixture.files,
+                                              NULL,
+                                              ranges[i].first_row,
+                                              ranges[i].max_rows));
+        FsearchWarmStart *warm_start = fsearch_warm_start_load(fixture.path);
+        g_assert_nonnull(warm_start);
+        assert_rows(&fixture, warm_start, ranges[i].first_row, ranges[i].num_rows);
+        g_clear_pointer(&warm_start, fsearch_warm_start_unref);
+    }
+
+    fixture_clear(&fixture);
+}
+
+static void
+test_warm_start_matches(void) {
+    WarmStartFixture fixture = {};
+    fixture_init(&fixture);
+
+    g_assert_true(fsearch_warm_start_save(fixture.path,
+                                          "",
+                                          NULL,
+                                          0,
+                                          DATABASE_INDEX_TYPE_NAME,
+                                          true,
+                                          fixture.tree.folders,
+                                          fixture.files,
+                                          NULL,
+                                          0,
+                                          10));
+    FsearchWarmStart *warm_start = fsearch_warm_start_load(fixture.path);
+    g_assert_nonnull(warm_start);
+    g_assert_true(fsearch_warm_start_matches(warm_start, NULL, NULL, 0, DATABASE_INDEX_TYPE_NAME, true));
+    g_assert_true(fsearch_warm_start_matches(warm_start, "", "", 0, DATABASE_INDEX_TYPE_NAME, true));
+    g_assert_false(fsearch_warm_start_matches(warm_start, "a", NULL, 0, DATABASE_INDEX_TYPE_NAME, true));
+    g_assert_false(fsearch_warm_start_matches(warm_start, NULL, "Music", 0, DATABASE_INDEX_TYPE_NAME, true));
+    g_assert_false(
+        fsearch_warm_start_matches(warm_start, NULL, NULL, QUERY_FLAG_REGEX, DATABASE_INDEX_TYPE_NAME, true));
+    g_assert_false(fsearch_warm_start_matches(warm_start, NULL, NULL, 0, DATABASE_INDEX_TYPE_PATH, true));
+    g_assert_false(fsearch_warm_start_matches(warm_start, NULL, NULL, 0, DATABASE_INDEX_TYPE_NAME, false));
+    g_clear_pointer(&warm_start, fsearch_warm_start_unref);
+
+    fixture_clear(&fixture);
+}
+
+static void
+test_warm_start_invalid(void) {
+    WarmStartFixture fixture = {};
+    fixture_init(&fixture);
+
+    g_assert_null(fsearch_warm_start_load(fixture.path));
+
+    g_assert_true(g_file_set_contents(fixture.path, "not a warm start", -1, NULL));
+    g_assert_null(fsearch_warm_start_load(fixture.path));
+
+    g_assert_true(g_file_set_contents(fixture.path, "", 0, NULL));
+    g_assert_null(fsearch_warm_start_load(fixture.path));
+
+    fixture_clear(&fixture);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/warm_start/save_load", test_warm_start_save_load);
+    g_test_add_func("/FSearch/warm_start/matches", test_warm_start_matches);
+    g_test_add_func("/FSearch/warm_start/invalid", test_warm_start_invalid);
+    return g_test_run();
+}
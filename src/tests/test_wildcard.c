@@ -0,0 +1,140 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/fsearch_wildcard.h>
+
+typedef struct {
+    const char *pattern;
+    const char *haystack;
+    bool ignore_case;
+    bool result;
+} WildcardTest;
+
+static bool
+wildcard_match(const char *pattern, const char *haystack, bool ignore_case) {
+    FsearchWildcard *wildcard = fsearch_wildcard_new(pattern, ignore_case);
+    g_assert_nonnull(wildcard);
+    const bool res = fsearch_wildcard_match(wildcard, haystack, strlen(haystack), NULL);
+    g_clear_pointer(&wildcard, fsearch_wildcard_free);
+    return res;
+}
+
+static void
+test_wildcard_match(void) {
+    WildcardTest tests[] = {
+        {"*.log", "error.log", true, true},
+        {"*.log", "error.LOG", true, true},
+        {"*.log", "error.LOG", false, false},
+        {"*.log", "error.log.1", true, false},
+        {"*.log", ".log", true, true},
+        {"*.log", "log", true, false},
+        {"foo*", "foobar", true, true},
+        {"foo*", "foo", true, true},
+        {"foo*", "barfoo", true, false},
+        {"*bar*baz*", "foobarquxbaz", true, true},
+        {"*bar*baz*", "foobazquxbar", true, false},
+        {"*bar*baz*", "barbaz", true, true},
+        {"*bar*bar*", "bar", true, false},
+        {"*bar*bar*", "barbar", true, true},
+        {"a*b*c", "abc", true, true},
+        {"a*b*c", "aXbYc", true, true},
+        {"a*b*c", "abcX", true, false},
+        {"a*b*c", "ac", true, false},
+        // the suffix must not overlap the prefix
+        {"ab*ba", "aba", true, false},
+        {"ab*ba", "abba", true, true},
+        {"*", "", true, true},
+        {"*", "anything", true, true},
+        {"**a**", "xay", true, true},
+        {"?", "", true, false},
+        {"?", "a", true, true},
+        {"?", "aa", true, false},
+        {"???", "abc", true, true},
+        {"abc?ef", "abcdef", true, true},
+        {"abc?ef", "abcef", true, false},
+        {"IMG_????.jpg", "IMG_0042.jpg", true, true},
+        {"IMG_????.jpg", "IMG_042.jpg", true, false},
+        {"*?", "", true, false},
+        {"*?", "a", true, true},
+        {"*a?", "xab", true, true},
+        {"*a?", "xa", true, false},
+        {"?*?", "ab", true, true},
+        {"?*?", "a", true, false},
+        // ? matches a whole UTF-8 character
+        {"?", "ı", true, true},
+        {"??", "ı", true, false},
+        {"a?c", "aäc", true, true},
+        {"*?.txt", "ä.txt", true, true},
+        {"*ä*", "bär", false, true},
+        {"*ä*", "bÄr", false, false},
+        // neither * nor ? match a newline, a trailing one is ignored
+        {"*.txt", "a\nb.txt", true, false},
+        {"*.txt", "ab.txt\n", true, true},
+        {"a?b", "a\nb", true, false},
+        {"a*", "a\n", true, true},
+        {"a*", "a\n\n", true, false},
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(tests); i++) {
+        WildcardTest *t = &tests[i];
+        if (wildcard_match(t->pattern, t->haystack, t->ignore_case) != t->result) {
+            g_test_message("Wildcard test failed: %s %s %d -> %d", t->pattern, t->haystack, t->ignore_case, t->result);
+            g_test_fail();
+        }
+    }
+}
+
+static void
+test_wildcard_regex_fallback(void) {
+    // these need case folding beyond ASCII
+    g_assert_null(fsearch_wildcard_new("*ä*", true));
+    g_assert_null(fsearch_wildcard_new("*.sh", true));
+    g_assert_null(fsearch_wildcard_new("kit*", true));
+    g_assert_null(fsearch_wildcard_new("a\n*", false));
+
+    FsearchWildcard *wildcard = fsearch_wildcard_new("*.sh", false);
+    g_assert_nonnull(wildcard);
+    g_clear_pointer(&wildcard, fsearch_wildcard_free);
+}
+
+static void
+test_wildcard_segments(void) {
+    FsearchWildcard *wildcard = fsearch_wildcard_new("IMG_??*.jpeg", true);
+    g_assert_nonnull(wildcard);
+    g_assert_cmpuint(fsearch_wildcard_get_num_segments(wildcard), ==, 3);
+    g_assert_cmpuint(fsearch_wildcard_get_segment_len(wildcard, 0), ==, 4);
+    g_assert_cmpuint(fsearch_wildcard_get_segment_len(wildcard, 1), ==, 0);
+    g_assert_cmpuint(fsearch_wildcard_get_segment_len(wildcard, 2), ==, 5);
+    g_assert_cmpstr(fsearch_wildcard_get_longest_literal(wildcard), ==, ".jpeg");
+    g_assert_cmpstr(fsearch_wildcard_get_prefix(wildcard), ==, "IMG_");
+
+    uint32_t offsets[3] = {};
+    const char *haystack = "img_0042.JPEG";
+    g_assert_true(fsearch_wildcard_match(wildcard, haystack, strlen(haystack), offsets));
+    g_assert_cmpuint(offsets[0], ==, 0);
+    g_assert_cmpuint(offsets[2], ==, 8);
+    g_clear_pointer(&wildcard, fsearch_wildcard_free);
+
+    // the middle pieces are reported where they matched first
+    wildcard = fsearch_wildcard_new("*ab*ab", true);
+    haystack = "xabyabzab";
+    g_assert_true(fsearch_wildcard_match(wildcard, haystack, strlen(haystack), offsets));
+    g_assert_cmpuint(offsets[0], ==, 1);
+    g_assert_cmpuint(offsets[1], ==, 7);
+    g_clear_pointer(&wildcard, fsearch_wildcard_free);
+
+    wildcard = fsearch_wildcard_new("*", true);
+    g_assert_cmpuint(fsearch_wildcard_get_num_segments(wildcard), ==, 0);
+    g_assert_null(fsearch_wildcard_get_longest_literal(wildcard));
+    g_assert_cmpstr(fsearch_wildcard_get_prefix(wildcard), ==, "");
+    g_clear_pointer(&wildcard, fsearch_wildcard_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/wildcard/match", test_wildcard_match);
+    g_test_add_func("/FSearch/wildcard/regex_fallback", test_wildcard_regex_fallback);
+    g_test_add_func("/FSearch/wildcard/segments", test_wildcard_segments);
+    return g_test_run();
+}
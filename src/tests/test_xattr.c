@@ -0,0 +1,66 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/xattr.h>
+#endif
+
+#include <src/fsearch_xattr.h>
+
+static void
+test_xattr_lookup(void) {
+    const char xattrs[] = "user.a\0first\0user.b\0\0user.c\0third";
+    const size_t len = sizeof(xattrs);
+
+    size_t value_len = 0;
+    g_assert_cmpstr(fsearch_xattr_lookup(xattrs, len, "user.a", &value_len), ==, "first");
+    g_assert_cmpuint(value_len, ==, 5);
+    g_assert_cmpstr(fsearch_xattr_lookup(xattrs, len, "user.b", &value_len), ==, "");
+    g_assert_cmpuint(value_len, ==, 0);
+    g_assert_cmpstr(fsearch_xattr_lookup(xattrs, len, "user.c", NULL), ==, "third");
+    g_assert_null(fsearch_xattr_lookup(xattrs, len, "user", NULL));
+    g_assert_null(fsearch_xattr_lookup(xattrs, len, "first", NULL));
+    g_assert_null(fsearch_xattr_lookup(NULL, 0, "user.a", NULL));
+    // truncated lists
+    g_assert_null(fsearch_xattr_lookup(xattrs, 7, "user.a", NULL));
+    g_assert_null(fsearch_xattr_lookup(xattrs, 12, "user.a", NULL));
+}
+
+static void
+test_xattr_read(void) {
+#ifdef __linux__
+    g_autofree char *dir = g_dir_make_tmp("fsearch_test_XXXXXX", NULL);
+    g_assert_nonnull(dir);
+    g_autofree char *path = g_build_filename(dir, "file", NULL);
+    g_assert_true(g_file_set_contents(path, "", 0, NULL));
+
+    if (!fsearch_xattr_is_supported() || lsetxattr(path, "user.fsearch_test", "value", 5, 0) != 0) {
+        g_test_skip("extended attributes aren't supported");
+    }
+    else {
+        const char *names[] = {"user.fsearch_missing", "user.fsearch_test", NULL};
+        g_autoptr(GString) xattrs = g_string_new("old");
+        g_assert_true(fsearch_xattr_read(path, names, xattrs));
+        g_assert_cmpmem(xattrs->str, xattrs->len, "user.fsearch_test\0value", 24);
+
+        const char *other_names[] = {"user.fsearch_missing", NULL};
+        g_assert_false(fsearch_xattr_read(path, other_names, xattrs));
+        g_assert_cmpuint(xattrs->len, ==, 0);
+    }
+
+    g_unlink(path);
+    g_rmdir(dir);
+#else
+    g_test_skip("extended attributes are only tested on Linux");
+#endif
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/xattr/lookup", test_xattr_lookup);
+    g_test_add_func("/FSearch/xattr/read", test_xattr_read);
+    return g_test_run();
+}